@@ -25,16 +25,27 @@
 #include "itkBSplineInterpolateImageFunction.h"
 #include "itkReducedDimensionBSplineInterpolateImageFunction.h"
 #include "itkAdvancedLinearInterpolateImageFunction.h"
+#include "itkRecursiveBSplineInterpolateImageFunctionImplementation.h"
 #include "itkLimiterFunctionBase.h"
 #include "itkFixedArray.h"
 #include "itkAdvancedTransform.h"
+#include "itkTransformEvaluationCache.h"
+#include "itkCompiledImageMask.h"
 #include "vnl/vnl_sparse_matrix.h"
 
 // Needed for checking for B-spline for faster implementation
 #include "itkAdvancedBSplineDeformableTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedTransformDispatch.h"
+#include "itkRecursiveBSplineTransform.h"
+#include "itkEulerTransform.h"
 
 #include "itkMultiThreader.h"
+#include "itkRealTimeClock.h"
+#include "itkPersistentThreadPool.h"
+#include "itkAtomicAdd.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -139,6 +150,7 @@ public:
   typedef typename ImageSamplerType::Pointer                      ImageSamplerPointer;
   typedef typename ImageSamplerType::OutputVectorContainerType    ImageSampleContainerType;
   typedef typename ImageSamplerType::OutputVectorContainerPointer ImageSampleContainerPointer;
+  typedef typename ImageSamplerType::ImageSampleArraysType        ImageSampleArraysType;
 
   /** Typedefs for Limiter support. */
   typedef LimiterFunctionBase< RealType, FixedImageDimension >  FixedImageLimiterType;
@@ -153,6 +165,7 @@ public:
   typedef AdvancedTransform<
     ScalarType, FixedImageDimension, MovingImageDimension >      AdvancedTransformType;
   typedef typename AdvancedTransformType::NumberOfParametersType NumberOfParametersType;
+  typedef TransformEvaluationCache< AdvancedTransformType >      TransformEvaluationCacheType;
 
   /** Typedef's for the B-spline transform. */
   typedef AdvancedCombinationTransform< ScalarType, FixedImageDimension >          CombinationTransformType;
@@ -163,13 +176,30 @@ public:
   typedef typename BSplineOrder2TransformType::Pointer                             BSplineOrder2TransformPointer;
   typedef typename BSplineOrder3TransformType::Pointer                             BSplineOrder3TransformPointer;
 
+  /** The transforms that are evaluated without virtual calls, see
+   * SetUseTransformDispatch(). */
+  typedef RecursiveBSplineTransform< ScalarType, FixedImageDimension, 3 > RecursiveBSplineOrder3TransformType;
+  typedef AdvancedMatrixOffsetTransformBase<
+    ScalarType, FixedImageDimension, MovingImageDimension >              AffineTransformType;
+  typedef EulerTransform< ScalarType, FixedImageDimension >              EulerTransformType;
+  typedef typename typelist::MakeTypeList<
+    RecursiveBSplineOrder3TransformType, BSplineOrder3TransformType,
+    AffineTransformType, EulerTransformType >::Type                      DispatchTransformTypeList;
+  typedef AdvancedTransformDispatch< DispatchTransformTypeList >         TransformDispatchType;
+
   /** Hessian type; for SelfHessian (experimental feature) */
   typedef typename DerivativeType::ValueType    HessianValueType;
   typedef vnl_sparse_matrix< HessianValueType > HessianType;
 
+  /** The diagonal blocks of the self Hessian, see GetSelfHessianBlocks(). */
+  typedef Array< HessianValueType > SelfHessianBlocksType;
+
   /** Typedefs for multi-threading. */
-  typedef itk::MultiThreader                      ThreaderType;
-  typedef typename ThreaderType::ThreadInfoStruct ThreadInfoType;
+  typedef itk::MultiThreader                        ThreaderType;
+  typedef typename ThreaderType::ThreadInfoStruct   ThreadInfoType;
+  typedef typename ThreaderType::ThreadFunctionType ThreadFunctionType;
+  typedef PersistentThreadPool                      ThreadPoolType;
+  typedef typename ThreadPoolType::Pointer          ThreadPoolPointer;
 
   /** Public methods ********************/
 
@@ -264,6 +294,19 @@ public:
    */
   virtual void GetSelfHessian( const TransformParametersType & parameters, HessianType & H ) const;
 
+  /** Experimental feature: compute the diagonal blocks of the SelfHessian.
+   * With N parameters and a block size B, which must divide N, there are
+   * N / B blocks. Parameter i belongs to block i % ( N / B ), at position
+   * i / ( N / B ) in that block, so that for a B-spline transform with B equal
+   * to the dimension a block couples the coefficients of one control point.
+   * Block b is stored as a full B x B matrix, row by row, from index b B^2.
+   * With B = 1 this is the diagonal. Compared to GetSelfHessian() this needs
+   * only N B values, whatever the support of the transform.
+   * This base class returns identity blocks.
+   */
+  virtual void GetSelfHessianBlocks( const TransformParametersType & parameters,
+    const unsigned int blockSize, SelfHessianBlocksType & blocks ) const;
+
   /** Set number of threads to use for computations. */
   virtual void SetNumberOfThreads( ThreadIdType numberOfThreads );
 
@@ -278,6 +321,266 @@ public:
   itkGetConstReferenceMacro( UseMultiThread, bool );
   itkBooleanMacro( UseMultiThread );
 
+  /** Whether GetValueAndDerivative() can be called concurrently with that of
+   * other metrics that share the transform, i.e. whether it does not modify
+   * shared objects once BeforeThreadedGetValueAndDerivative() has been called
+   * with UseMetricSingleThreaded on. Used by the CombinationImageToImageMetric.
+   */
+  itkGetConstMacro( SupportsConcurrentEvaluation, bool );
+
+  /** Whether the threaded GetValue() and GetValueAndDerivative() evaluate
+   * only the part of the samples of this MPI process, see
+   * DistributedEvaluation, and sum the results over the processes.
+   */
+  itkGetConstMacro( SupportsDistributedEvaluation, bool );
+
+  /** Select the use of a persistent thread pool instead of the MultiThreader.
+   * The MultiThreader creates and joins threads at every call, which is
+   * relatively expensive for metrics that are evaluated many times with few
+   * samples. Workers in the pool stay alive between calls. Default: true.
+   */
+  itkSetMacro( UseThreadPool, bool );
+  itkGetConstReferenceMacro( UseThreadPool, bool );
+  itkBooleanMacro( UseThreadPool );
+
+  /** Set/Get the thread pool. When no pool is set and UseThreadPool is true,
+   * the process-wide pool is used, which is shared by all metrics.
+   */
+  itkSetObjectMacro( ThreadPool, ThreadPoolType );
+  itkGetObjectMacro( ThreadPool, ThreadPoolType );
+
+  /** Select NUMA-aware threading. The per-thread buffers, such as the
+   * per-thread derivatives and joint histograms, are then allocated and
+   * first touched by the threads that use them, instead of by the calling
+   * thread. On multi-socket machines this keeps every thread working on
+   * memory of its own node, if the threads are also pinned to a processor,
+   * see PersistentThreadPool::SetUseThreadAffinity(). The metric does not pin
+   * the threads itself, since the pool is shared. Default: false.
+   */
+  itkSetMacro( UseNUMAAwareThreading, bool );
+  itkGetConstReferenceMacro( UseNUMAAwareThreading, bool );
+  itkBooleanMacro( UseNUMAAwareThreading );
+
+  /** Select automatic tuning of the number of threads. At the start of every
+   * resolution the metric evaluates NumberOfThreadsTuningEvaluations + 1
+   * times with each of N, N/2, N/4, ..., 1 threads, with N the number of
+   * threads at Initialize(), discards the first evaluation of each as a
+   * warm-up, and continues with the fastest. The evaluation includes the
+   * reduction of the per-thread results. Useful for small sample sets, for
+   * which the overhead of many threads dominates. Default: false.
+   */
+  itkSetMacro( AutomaticNumberOfThreads, bool );
+  itkGetConstReferenceMacro( AutomaticNumberOfThreads, bool );
+  itkBooleanMacro( AutomaticNumberOfThreads );
+
+  /** The number of timed evaluations per number of threads. Default: 2. */
+  itkSetClampMacro( NumberOfThreadsTuningEvaluations, unsigned int,
+    1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( NumberOfThreadsTuningEvaluations, unsigned int );
+
+  /** The numbers of threads that were tried in this resolution, and the
+   * mean time of an evaluation with each of them, in seconds. The times are
+   * complete when GetNumberOfThreadsTuningFinished() is true.
+   */
+  itkGetConstReferenceMacro( NumberOfThreadsTuningCandidates, std::vector< ThreadIdType > );
+  itkGetConstReferenceMacro( NumberOfThreadsTuningTimes, std::vector< double > );
+  bool GetNumberOfThreadsTuningFinished( void ) const;
+
+  /** Select the use of the structure-of-arrays version of the samples,
+   * see ImageSamplerBase::GetSampleArrays(). Metrics that support it then
+   * read the samples from contiguous coordinate and value arrays, and
+   * transform them in small batches with AdvancedTransform::TransformPoints().
+   * Default: false.
+   */
+  itkSetMacro( UseSampleArrays, bool );
+  itkGetConstReferenceMacro( UseSampleArrays, bool );
+  itkBooleanMacro( UseSampleArrays );
+
+  /** Select caching of the parameter independent part of the transform
+   * Jacobian for the samples, see AdvancedTransform::PrecomputeJacobianStructure().
+   * The cache is built once the samples have not changed for two consecutive
+   * iterations, as with the full and grid samplers, and is kept until the
+   * samples or the transform grid change. It is only built for metrics that
+   * set m_SupportsTransformJacobianStructureCache, which then call
+   * EvaluateCachedJacobianWithImageGradientProduct() with the sample index,
+   * and not when the metric uses the nonzero Jacobian indices descriptor
+   * instead, which does not read the cache. Default: false.
+   */
+  itkSetMacro( CacheTransformJacobianStructure, bool );
+  itkGetConstReferenceMacro( CacheTransformJacobianStructure, bool );
+  itkBooleanMacro( CacheTransformJacobianStructure );
+
+  /** Set/Get the memory budget of the transform Jacobian structure cache in
+   * bytes. No cache is built when it would need more. Default: 512 MB.
+   */
+  itkSetMacro( MaximumJacobianStructureCacheSize, SizeValueType );
+  itkGetConstMacro( MaximumJacobianStructureCacheSize, SizeValueType );
+
+  /** Get the memory used by the transform Jacobian structure cache in bytes,
+   * or zero if it is not used.
+   */
+  virtual SizeValueType GetJacobianStructureCacheMemoryUsage( void ) const;
+
+  /** Select caching of the moving image gradient. For B-spline interpolators
+   * of order n from 2 to 5, the differences of neighbouring B-spline
+   * coefficients are then computed once for every dimension, when the metric
+   * is initialized. During the optimization, the derivative in each dimension
+   * is evaluated from these differences with B-spline kernels of order n - 1
+   * in that dimension, which gives the exact derivative of the interpolant.
+   * The cache is built from the padded B-spline coefficients, so it needs
+   * SetUseRecursiveBSplineInterpolation() as well. Default: false.
+   */
+  itkSetMacro( CacheMovingImageGradient, bool );
+  itkGetConstReferenceMacro( CacheMovingImageGradient, bool );
+  itkBooleanMacro( CacheMovingImageGradient );
+
+  /** Set/Get the memory budget of the moving image gradient cache in bytes.
+   * No cache is built when it would need more. Default: 512 MB.
+   */
+  itkSetMacro( MaximumMovingImageGradientCacheSize, SizeValueType );
+  itkGetConstMacro( MaximumMovingImageGradientCacheSize, SizeValueType );
+
+  /** Get the memory used by the moving image gradient cache in bytes,
+   * or zero if it is not used.
+   */
+  virtual SizeValueType GetMovingImageGradientCacheMemoryUsage( void ) const;
+
+  /** Select the recursive evaluation of B-spline interpolators. For the
+   * BSplineInterpolateImageFunction of order 1 to 5, in double or single
+   * precision, the metric then evaluates the moving image value and gradient
+   * itself, with loops over the dimensions and the spline support that are
+   * unrolled at compile time, see RecursiveBSplineInterpolateImageFunctionImplementation.
+   * When the metric is initialized, the B-spline coefficients of the
+   * interpolator, see BSplineCoefficientImageProvider, are copied to a buffer
+   * that is padded with the mirrored coefficients, so that the boundary
+   * condition is not applied for every coefficient. The results equal those of the interpolator, up to rounding. Default: true.
+   */
+  itkSetMacro( UseRecursiveBSplineInterpolation, bool );
+  itkGetConstReferenceMacro( UseRecursiveBSplineInterpolation, bool );
+  itkBooleanMacro( UseRecursiveBSplineInterpolation );
+
+  /** Set/Get the memory budget of the padded B-spline coefficients in bytes.
+   * The interpolator is used when they would need more. Default: 512 MB.
+   */
+  itkSetMacro( MaximumPaddedBSplineCoefficientsSize, SizeValueType );
+  itkGetConstMacro( MaximumPaddedBSplineCoefficientsSize, SizeValueType );
+
+  /** Set/Get the directory of the ImageFileCache in which the padded
+   * B-spline coefficients are looked up by the content of the moving image,
+   * and stored when they are computed. The interpolators of elastix use the
+   * same keys. Default: empty, no cache.
+   */
+  itkSetStringMacro( ArtifactCacheDirectory );
+  itkGetStringMacro( ArtifactCacheDirectory );
+
+  /** Get the memory used by the padded B-spline coefficients in bytes,
+   * or zero if they are not used.
+   */
+  virtual SizeValueType GetPaddedBSplineCoefficientsMemoryUsage( void ) const;
+
+  /** Release the memory that is only needed during a resolution: the
+   * per-thread variables, the moving image gradient cache, the padded
+   * B-spline coefficients and the transform Jacobian structure cache. They are recreated when the metric is used
+   * again, so this can be called between resolutions. Subclasses with their
+   * own per-thread buffers can extend it.
+   */
+  virtual void ReleaseMemory( void );
+
+  /** Get the memory held by the metric in bytes: the per-thread variables
+   * and the caches above. Subclasses add their own buffers.
+   */
+  virtual SizeValueType GetMemoryUsage( void ) const;
+
+  /** Estimate the memory in bytes that the metric allocates when it is
+   * initialized for a transform with numberOfParameters parameters, and
+   * evaluated with numberOfSamples samples, so that a warning can be given
+   * before the allocations are made. This implementation counts the
+   * per-thread derivatives.
+   */
+  virtual SizeValueType GetProjectedMemoryUsage(
+    const NumberOfParametersType numberOfParameters,
+    const SizeValueType numberOfSamples ) const;
+
+  /** Restrict the image sampler to the part of the fixed image region that
+   * the transform maps into the moving image, or into the bounding box of
+   * the moving mask. The region is estimated when the metric is initialized,
+   * at the start of each resolution, from a coarse grid of points: the
+   * bounding box of the grid points that map inside, enlarged by one grid
+   * cell for the deformation during the resolution. Samples outside the
+   * overlap would be evaluated and then rejected. Default: false.
+   */
+  itkSetMacro( RestrictSamplingToMovingImageOverlap, bool );
+  itkGetConstMacro( RestrictSamplingToMovingImageOverlap, bool );
+  itkBooleanMacro( RestrictSamplingToMovingImageOverlap );
+
+  /** Set a cache with the mapped points, and possibly the Jacobians, of the
+   * samples of the image sampler, for the current transform parameters. It
+   * is computed once by the CombinationImageToImageMetric, for all metrics
+   * that share the sampler and the transform. The cache is not owned, and
+   * setting it does not modify this metric. Set it to 0 after use.
+   */
+  void SetSharedTransformEvaluationCache( const TransformEvaluationCacheType * cache )
+  {
+    this->m_SharedTransformEvaluationCache = cache;
+  }
+
+
+  /** Whether the metric uses the shared transform evaluation cache. */
+  itkGetConstMacro( SupportsSharedTransformEvaluationCache, bool );
+
+  /** Select caching of the mapped samples during a line search. For
+   * transforms that are linear in their parameters, see
+   * AdvancedTransform::GetIsLinearInParameters(), the samples are mapped at
+   * the start position p0 and at p0 + d by BeginLineSearch(), and at every
+   * trial position p0 + a*d of the line search the mapped points follow from
+   * T( x; p0 ) + a * ( T( x; p0 + d ) - T( x; p0 ) ), without evaluating the
+   * transform. Only the metrics that support the shared transform evaluation
+   * cache use it, and the shared cache takes precedence. Default: false.
+   */
+  itkSetMacro( UseLineSearchTransformCache, bool );
+  itkGetConstMacro( UseLineSearchTransformCache, bool );
+  itkBooleanMacro( UseLineSearchTransformCache );
+
+  /** Select the evaluation of the common transforms without virtual calls.
+   * At the start of each resolution, Initialize() looks up the type of the
+   * transform, or of the current transform of a combination transform that
+   * has no initial transform or composes with it, in
+   * DispatchTransformTypeList: the cubic B-spline, affine and Euler
+   * transforms. TransformPoint() and
+   * EvaluateTransformJacobianWithImageGradientProduct() then call that type
+   * directly, which the compiler can inline in the loops of the metrics.
+   * Other transforms use the virtual functions. Default: true.
+   */
+  itkSetMacro( UseTransformDispatch, bool );
+  itkGetConstMacro( UseTransformDispatch, bool );
+  itkBooleanMacro( UseTransformDispatch );
+
+  /** Start a line search from position along direction, in the parameter
+   * space of the transform, and build the line search transform cache for
+   * the current samples of the image sampler, if it is used. The transform
+   * parameters are restored afterwards. Not thread-safe.
+   */
+  virtual void BeginLineSearch( const TransformParametersType & position,
+    const TransformParametersType & direction );
+
+  /** Release the line search transform cache. */
+  virtual void EndLineSearch( void );
+
+  /** Whether the line search transform cache is used for the current
+   * transform parameters, which are on the line of the line search.
+   */
+  bool GetLineSearchTransformCacheIsValid( void ) const
+  {
+    return this->m_LineSearchTransformCacheIsValid;
+  }
+
+
+  /** Set the transform parameters. During a line search with a line search
+   * transform cache, this also finds the step length of the parameters, or
+   * stops using the cache if they are not on the line.
+   */
+  void SetTransformParameters( const TransformParametersType & parameters ) const;
+
   /** Contains calls from GetValueAndDerivative that are thread-unsafe,
    * together with preparation for multi-threading.
    * Note that the only reason why this function is not protected, is
@@ -291,6 +594,15 @@ protected:
   /** Constructor. */
   AdvancedImageToImageMetric();
 
+  /** The size of the buffer of an image in bytes, zero for no image. */
+  template< class TImage >
+  static SizeValueType GetImageMemoryUsage( const TImage * image )
+  {
+    if( image == 0 ) { return 0; }
+    return image->GetBufferedRegion().GetNumberOfPixels()
+           * sizeof( typename TImage::PixelType );
+  }
+
   /** Destructor. */
   virtual ~AdvancedImageToImageMetric();
 
@@ -328,6 +640,8 @@ protected:
   /** Typedefs for support of sparse Jacobians and compact support of transformations. */
   typedef typename
     AdvancedTransformType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename
+    AdvancedTransformType::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
 
   /** Protected Variables **************/
 
@@ -336,6 +650,62 @@ protected:
    */
   mutable ImageSamplerPointer m_ImageSampler;
 
+  /** The structure-of-arrays samples of the current iteration, set in
+   * BeforeThreadedGetValueAndDerivative() when m_UseSampleArrays is true.
+   */
+  mutable const ImageSampleArraysType * m_SampleArrays;
+
+  /** The importance weights of the samples of the current iteration, see
+   * ImageSamplerBase::GetSampleWeights(), or 0 when all samples have weight
+   * one. Set in BeforeThreadedGetValueAndDerivative(). Metrics that multiply
+   * the contribution of sample i by GetSampleWeight( i ) set
+   * m_SupportsSampleWeights to true in their constructor; the others throw
+   * an exception when the sampler provides weights.
+   */
+  mutable const double * m_SampleWeights;
+  bool                   m_SupportsSampleWeights;
+
+  /** Get the importance weight of sample i, see m_SampleWeights. */
+  inline double GetSampleWeight( const unsigned long i ) const
+  {
+    return this->m_SampleWeights != 0 ? this->m_SampleWeights[ i ] : 1.0;
+  }
+
+
+  /** Whether the threaded functions can use
+   * EvaluateCachedJacobianWithImageGradientProduct(), set in
+   * BeforeThreadedGetValueAndDerivative() by UpdateJacobianStructureCache().
+   * The cache is only built for metrics that evaluate the Jacobian through
+   * the sample-indexed EvaluateTransformJacobianWithImageGradientProduct()
+   * and set m_SupportsTransformJacobianStructureCache to true in their
+   * constructor.
+   */
+  mutable bool m_UseJacobianStructureCache;
+  bool         m_SupportsTransformJacobianStructureCache;
+
+  /** The shared transform evaluation cache, see SetSharedTransformEvaluationCache().
+   * Metrics that use the sample-indexed TransformPoint() and
+   * EvaluateTransformJacobian() in GetValueAndDerivative() set
+   * m_SupportsSharedTransformEvaluationCache to true in their constructor.
+   */
+  const TransformEvaluationCacheType * m_SharedTransformEvaluationCache;
+  bool                                 m_SupportsSharedTransformEvaluationCache;
+
+  /** The line search transform cache, see SetUseLineSearchTransformCache().
+   * The fixed points are compared with those of the samples, so that the
+   * cache is not used for samples that changed during the line search.
+   */
+  typedef typename MovingImagePointType::VectorType MovingImageVectorType;
+  bool                                 m_UseLineSearchTransformCache;
+  std::vector< FixedImagePointType >   m_LineSearchFixedPoints;
+  std::vector< MovingImagePointType >  m_LineSearchMappedPoints;
+  std::vector< MovingImageVectorType > m_LineSearchDisplacements;
+  TransformParametersType              m_LineSearchPosition;
+  TransformParametersType              m_LineSearchDirection;
+  double                               m_LineSearchDirectionSquaredMagnitude;
+  mutable bool                         m_LineSearchTransformCacheIsValid;
+  mutable double                       m_LineSearchStepLength;
+
   /** Variables for image derivative computation. */
   bool                                   m_InterpolatorIsLinear;
   bool                                   m_InterpolatorIsBSpline;
@@ -348,11 +718,54 @@ protected:
 
   CentralDifferenceGradientFilterPointer m_CentralDifferenceGradientFilter;
 
+  /** The moving image gradient cache, see SetCacheMovingImageGradient().
+   * It stores one buffer per dimension d, with the geometry of the padded
+   * B-spline coefficients, of the differences c[ k ] - c[ k - e_d ]. It is
+   * empty if it is not used.
+   */
+  std::vector< double > m_MovingImageGradientCoefficients;
+
+  /** The padded B-spline coefficients of the moving image, see
+   * SetUseRecursiveBSplineInterpolation(). Only one of the buffers is used,
+   * with the precision of the interpolator. The start index is that of the
+   * first padded coefficient, and the spline order is zero if they are not used.
+   */
+  std::vector< double > m_PaddedBSplineCoefficients;
+  std::vector< float >  m_PaddedBSplineCoefficientsFloat;
+  OffsetValueType       m_PaddedBSplineCoefficientsOffsetTable[ MovingImageDimension + 1 ];
+  OffsetValueType       m_PaddedBSplineCoefficientsStartIndex[ MovingImageDimension ];
+  unsigned int          m_PaddedBSplineCoefficientsSplineOrder;
+  bool                  m_PaddedBSplineCoefficientsUseImageDirection;
+
+  /** A compiled copy of the moving mask, if it is an ImageMaskSpatialObject2,
+   * used by IsInsideMovingMask(). It is rebuilt by Initialize().
+   */
+  typedef ImageMaskSpatialObject2< MovingImageDimension >     MovingImageMaskSpatialObjectType;
+  typedef CompiledImageMask< MovingImageDimension >           CompiledMovingImageMaskType;
+  typedef typename CompiledMovingImageMaskType::Pointer       CompiledMovingImageMaskPointer;
+  CompiledMovingImageMaskPointer m_CompiledMovingImageMask;
+
   /** Variables to store the AdvancedTransform. */
   bool m_TransformIsAdvanced;
   typename AdvancedTransformType::Pointer m_AdvancedTransform;
   mutable bool m_TransformIsBSpline;
 
+  /** The transform that is evaluated without virtual calls, and its position
+   * in DispatchTransformTypeList, see InitializeTransformDispatch(). When the
+   * transform is the current transform of a combination transform with an
+   * initial transform, points are first mapped by m_DispatchCombinationTransform.
+   */
+  bool                             m_UseTransformDispatch;
+  const AdvancedTransformType *    m_DispatchTransform;
+  const CombinationTransformType * m_DispatchCombinationTransform;
+  int                              m_DispatchTransformPosition;
+
+  /** The continuous index range of the moving image buffer, for an inlined
+   * IsInsideBuffer() of the linear and B-spline interpolators. */
+  bool                           m_InlineIsInsideBuffer;
+  MovingImageContinuousIndexType m_MovingImageBufferStart;
+  MovingImageContinuousIndexType m_MovingImageBufferEnd;
+
   /** Variables for the Limiters. */
   FixedImageLimiterPointer     m_FixedImageLimiter;
   MovingImageLimiterPointer    m_MovingImageLimiter;
@@ -393,13 +806,94 @@ protected:
   /** Launch MultiThread GetValueAndDerivative. */
   void LaunchGetValueAndDerivativeThreaderCallback( void ) const;
 
+  /** Build the transform Jacobian structure cache for the current samples
+   * if needed, and set m_UseJacobianStructureCache. Not thread-safe.
+   */
+  virtual void UpdateJacobianStructureCache( void ) const;
+
   /** AccumulateDerivatives threader callback function. */
   static ITK_THREAD_RETURN_TYPE AccumulateDerivativesThreaderCallback( void * arg );
 
+  /** Execute a threader callback on m_NumberOfThreads threads, either using
+   * the persistent thread pool or the MultiThreader.
+   */
+  void ExecuteThreaderCallback( ThreadFunctionType callback, void * userData ) const;
+
+  /** Split a region of the fixed image, like the fixed image region, in
+   * contiguous slabs along its outermost axis of more than one voxel, for
+   * metrics whose threads iterate over the fixed image instead of over the
+   * samples. Returns false if thread threadId gets an empty slab.
+   */
+  bool SplitFixedImageRegionForThread( const FixedImageRegionType & fullRegion,
+    const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+    FixedImageRegionType & region ) const;
+
+  /** Start the tuning of the number of threads; called by Initialize. */
+  virtual void InitializeNumberOfThreadsTuning( void );
+
+  /** Time the previous evaluation, and select the number of threads of the
+   * next one; called by BeforeThreadedGetValueAndDerivative().
+   */
+  void TuneNumberOfThreads( void ) const;
+
+  /** Whether the samples are partitioned over the MPI processes: true if
+   * the metric supports it and there is more than one process.
+   */
+  bool GetUseDistributedEvaluation( void ) const;
+
+  /** The range [begin, end) of the n samples that this process evaluates;
+   * all samples if GetUseDistributedEvaluation() is false. The threads split
+   * this range, instead of all samples.
+   */
+  void GetProcessSampleRange( const unsigned long n,
+    unsigned long & begin, unsigned long & end ) const;
+
+  /** Sum the number of counted pixels, or the partial value and derivative,
+   * over the processes, if GetUseDistributedEvaluation() is true. Metrics
+   * that are normalized by the number of counted pixels first sum that
+   * number, then normalize, and then sum the value and derivative. The
+   * derivative is optional.
+   */
+  void SumOverProcesses( SizeValueType & numberOfPixelsCounted ) const;
+
+  void SumOverProcesses( MeasureType & value, DerivativeType * derivative ) const;
+
   /** Variables for multi-threading. */
-  bool m_UseMetricSingleThreaded;
-  bool m_UseMultiThread;
-  bool m_UseOpenMP;
+  bool              m_UseMetricSingleThreaded;
+  bool              m_UseMultiThread;
+  bool              m_UseOpenMP;
+  bool              m_UseThreadPool;
+  ThreadPoolPointer m_ThreadPool;
+  bool              m_UseNUMAAwareThreading;
+
+  /** Variables for the automatic tuning of the number of threads. */
+  bool                                m_AutomaticNumberOfThreads;
+  unsigned int                        m_NumberOfThreadsTuningEvaluations;
+  std::vector< ThreadIdType >         m_NumberOfThreadsTuningCandidates;
+  mutable std::vector< double >       m_NumberOfThreadsTuningTimes;
+  mutable SizeValueType               m_NumberOfThreadsTuningEvaluation;
+  mutable double                      m_NumberOfThreadsTuningStart;
+  RealTimeClock::Pointer              m_NumberOfThreadsTuningClock;
+  bool              m_UseSampleArrays;
+
+  /** Variables for the transform Jacobian structure cache. */
+  bool                     m_CacheTransformJacobianStructure;
+  SizeValueType            m_MaximumJacobianStructureCacheSize;
+  mutable ModifiedTimeType m_JacobianStructureSamplesMTime;
+  mutable ModifiedTimeType m_JacobianStructureCacheMTime;
+  mutable ModifiedTimeType m_JacobianStructureTransformMTime;
+
+  /** Variables for the moving image gradient cache. */
+  bool          m_CacheMovingImageGradient;
+  SizeValueType m_MaximumMovingImageGradientCacheSize;
+
+  /** Variables for the recursive B-spline interpolation. */
+  bool          m_UseRecursiveBSplineInterpolation;
+  SizeValueType m_MaximumPaddedBSplineCoefficientsSize;
+  std::string   m_ArtifactCacheDirectory;
+
+  /** Restrict the samples to the overlap with the moving image. */
+  bool m_RestrictSamplingToMovingImageOverlap;
 
   /** Helper structs that multi-threads the computation of
    * the metric derivative using ITK threads.
@@ -439,9 +933,16 @@ protected:
   // test per thread struct with padding and alignment
   struct GetValueAndDerivativePerThreadStruct
   {
-    SizeValueType  st_NumberOfPixelsCounted;
-    MeasureType    st_Value;
-    DerivativeType st_Derivative;
+    SizeValueType                st_NumberOfPixelsCounted;
+    MeasureType                  st_Value;
+    DerivativeType               st_Derivative;
+    std::vector< unsigned char > st_TouchedDerivativeBlocks;
+
+    /** Scratch buffers for the transform Jacobian of one sample, see
+     * InitializePerThreadVariables(). */
+    TransformJacobianType      st_TransformJacobian;
+    NonZeroJacobianIndicesType st_NonZeroJacobianIndices;
+    DerivativeType             st_ImageJacobian;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, GetValueAndDerivativePerThreadStruct,
     PaddedGetValueAndDerivativePerThreadStruct );
@@ -453,6 +954,132 @@ protected:
   /** Initialize some multi-threading related parameters. */
   virtual void InitializeThreadingParameters( void ) const;
 
+  /** Initialize the per-thread variables of one thread; called by
+   * InitializeThreadingParameters(), from the thread itself when
+   * m_UseNUMAAwareThreading is true. Subclasses with their own
+   * per-thread buffers can extend it.
+   *
+   * This also sizes the per-thread scratch buffers st_TransformJacobian,
+   * st_NonZeroJacobianIndices and st_ImageJacobian to the number of nonzero
+   * Jacobian indices of the transform, so that the threaded sample loops of the
+   * metrics and penalty terms can use them instead of allocating their own
+   * temporaries in every iteration. Their contents are undefined on entry. */
+  virtual void InitializePerThreadVariables( ThreadIdType threadId ) const;
+
+  /** Multi-threaded version of InitializePerThreadVariables(). */
+  static ITK_THREAD_RETURN_TYPE InitializePerThreadVariablesThreaderCallback( void * arg );
+
+  /** Sparse accumulation of the per-thread derivatives.
+   *
+   * With a transform with a compact support, such as the B-spline, every
+   * thread only writes the parameters in the support regions of its samples.
+   * The per-thread derivatives are therefore divided in blocks of
+   * 2^DerivativeBlockSizeLog2 parameters, and AccumulateDerivativesThreaderCallback()
+   * only merges the blocks that were marked as touched.
+   *
+   * Metrics that use AccumulateDerivativesThreaderCallback() can opt in by
+   * setting m_SupportsSparseDerivativeAccumulation to true in their constructor,
+   * in which case they must call MarkTouchedDerivativeBlocks() for every
+   * sample that is added to st_Derivative. The sparse accumulation is then
+   * used when the transform has fewer nonzero Jacobian indices than parameters.
+   * In debug builds AccumulateDerivativesThreaderCallback() asserts that the
+   * blocks that were not marked are still zero.
+   */
+  itkStaticConstMacro( DerivativeBlockSizeLog2, unsigned int, 7 );
+  bool         m_SupportsSparseDerivativeAccumulation;
+  mutable bool m_UseSparseDerivativeAccumulation;
+
+  /** Mark the derivative blocks containing the nonzero Jacobian indices
+   * as touched by this thread. */
+  void MarkTouchedDerivativeBlocks( const ThreadIdType threadId,
+    const NonZeroJacobianIndicesType & nzji ) const
+  {
+    if( !this->m_UseSparseDerivativeAccumulation )
+    {
+      return;
+    }
+    unsigned char * touched
+      = &( this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks[ 0 ] );
+    for( SizeValueType i = 0; i < nzji.size(); ++i )
+    {
+      touched[ nzji[ i ] >> DerivativeBlockSizeLog2 ] = 1;
+    }
+  }
+
+
+  /** Compact nonzero Jacobian indices.
+   *
+   * For transforms with GetHasNonZeroJacobianIndicesDescriptor(), such as the
+   * B-splines, the nonzero Jacobian indices of a sample are a box in the
+   * parameter grid. Metrics can then call the transform's
+   * EvaluateCompactJacobianWithImageGradientProduct(), and accumulate the
+   * derivative with the descriptor versions of AddDerivativeTerms() and
+   * MarkTouchedDerivativeBlocks(), so that no index list is written or read
+   * per sample. InitializeThreadingParameters() switches this on when the
+   * transform supports it, and then no Jacobian structure cache is built. Metrics
+   * should still check that m_SharedTransformEvaluationCache is not set.
+   */
+  mutable bool m_UseNonZeroJacobianIndicesDescriptor;
+
+  /** Add factor * imageJacobian to the derivative, at the indices given by
+   * the descriptor. */
+  void AddDerivativeTerms( const DerivativeValueType factor,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesDescriptorType & descriptor,
+    DerivativeType & derivative ) const;
+
+  /** Same as MarkTouchedDerivativeBlocks() above, for a descriptor. */
+  void MarkTouchedDerivativeBlocks( const ThreadIdType threadId,
+    const NonZeroJacobianIndicesDescriptorType & descriptor ) const;
+
+  /** Atomic accumulation of the derivative.
+   *
+   * Instead of adding to a per-thread copy of the derivative, which is
+   * reduced afterwards, the threads can also scatter their contributions
+   * directly into the shared derivative m_ThreaderMetricParameters.st_DerivativePointer,
+   * with atomic adds. This saves the memory of the per-thread copies and the
+   * reduction step, at the cost of an atomic add per nonzero Jacobian index
+   * and of a summation order that depends on the timing.
+   *
+   * Metrics can opt in by setting m_SupportsAtomicDerivativeAccumulation to
+   * true in their constructor. When m_UseAtomicDerivativeAccumulation is
+   * true, they must zero the shared derivative before launching the threads,
+   * add the contributions with AtomicScatterDerivativeTerms(), and only
+   * normalize afterwards. InitializeThreadingParameters() switches this
+   * mode on for transforms with a sparse Jacobian, when the per-thread
+   * copies would use more than AtomicDerivativeAccumulationMemoryThreshold
+   * bytes in total and at least AtomicDerivativeAccumulationMinimumNumberOfThreads
+   * threads are used. The per-thread derivatives are then not allocated.
+   */
+  itkStaticConstMacro( AtomicDerivativeAccumulationMinimumNumberOfThreads, unsigned int, 16 );
+  itkStaticConstMacro( AtomicDerivativeAccumulationMemoryThreshold, unsigned long, 256 * 1024 * 1024 );
+  bool         m_SupportsAtomicDerivativeAccumulation;
+  mutable bool m_UseAtomicDerivativeAccumulation;
+
+  /** Set to true in the constructor of metrics that support concurrent
+   * evaluation, see GetSupportsConcurrentEvaluation(). Default: false.
+   */
+  bool m_SupportsConcurrentEvaluation;
+
+  /** Set to true in the constructor of metrics that support distributed
+   * evaluation, see GetSupportsDistributedEvaluation(). Default: false.
+   */
+  bool m_SupportsDistributedEvaluation;
+
+  /** Atomically add factor * imageJacobian to the nonzero Jacobian indices
+   * of the shared derivative. */
+  void AtomicScatterDerivativeTerms( const DerivativeValueType factor,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji ) const
+  {
+    DerivativeValueType * derivative = this->m_ThreaderMetricParameters.st_DerivativePointer;
+    for( SizeValueType i = 0; i < nzji.size(); ++i )
+    {
+      AtomicAdd( derivative + nzji[ i ], factor * imageJacobian[ i ] );
+    }
+  }
+
+
   /** Protected methods ************** */
 
   /** Methods for image sampler support **********/
@@ -464,6 +1091,13 @@ protected:
    * Make sure to set it before calling Initialize; default: false. */
   itkSetMacro( UseImageSampler, bool );
 
+  /** Estimate the region of the fixed image that maps into the moving image,
+   * see RestrictSamplingToMovingImageOverlap, and pass it to the image
+   * sampler; called by Initialize. Returns the region, which is empty if no
+   * restriction applies.
+   */
+  virtual FixedImageRegionType ComputeMovingImageOverlapRegion( void ) const;
+
   /** Check if enough samples have been found to compute a reliable
    * estimate of the value/derivative; throws an exception if not. */
   virtual void CheckNumberOfSamples(
@@ -475,6 +1109,74 @@ protected:
    * method is called by Initialize. */
   virtual void CheckForBSplineInterpolator( void );
 
+  /** Compute the moving image gradient cache, if requested and supported;
+   * this method is called by Initialize.
+   */
+  virtual void ComputeMovingImageGradientCache( void );
+
+  /** Compute the part of the moving image gradient cache of one thread,
+   * from the padded B-spline coefficients. */
+  void ThreadedComputeMovingImageGradientCache(
+    ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+  /** ComputeMovingImageGradientCache threader callback function. */
+  static ITK_THREAD_RETURN_TYPE ComputeMovingImageGradientCacheThreaderCallback( void * arg );
+
+  /** Map the part of m_LineSearchFixedPoints of one thread to
+   * m_LineSearchMappedPoints, with the current transform parameters. */
+  void ThreadedTransformLineSearchSamples(
+    ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+  /** TransformLineSearchSamples threader callback function. */
+  static ITK_THREAD_RETURN_TYPE TransformLineSearchSamplesThreaderCallback( void * arg );
+
+  /** Compute the moving image gradient from the gradient cache. The
+   * continuous index should be inside the buffer.
+   */
+  void EvaluateMovingImageGradientCache(
+    const MovingImageContinuousIndexType & cindex,
+    MovingImageDerivativeType & gradient ) const;
+
+  /** The implementation of EvaluateMovingImageGradientCache() for one
+   * spline order, which should be 2 or higher.
+   */
+  template< unsigned int VSplineOrder >
+  void EvaluateMovingImageGradientCacheOfOrder(
+    const MovingImageContinuousIndexType & cindex,
+    MovingImageDerivativeType & gradient ) const;
+
+  /** Compute the padded B-spline coefficients, if requested and supported;
+   * this method is called by Initialize.
+   */
+  virtual void ComputePaddedBSplineCoefficients( void );
+
+  /** Copy the coefficients of the interpolator to the padded buffer. They
+   * are taken from the interpolator if it is a BSplineCoefficientImageProvider,
+   * else from the artifact cache or the decomposition filter of the interpolator.
+   */
+  template< class TCoefficientFilter, class TCoefficient >
+  void FillPaddedBSplineCoefficients( const unsigned int splineOrder,
+    std::vector< TCoefficient > & paddedCoefficients );
+
+  /** Compute the moving image value, and the gradient if it is not 0, from
+   * the padded B-spline coefficients. Returns false if they are not used.
+   * The continuous index should be inside the buffer.
+   */
+  inline bool EvaluatePaddedBSplineCoefficients(
+    const MovingImageContinuousIndexType & cindex,
+    RealType & movingImageValue,
+    MovingImageDerivativeType * gradient ) const;
+
+  /** The implementation of EvaluatePaddedBSplineCoefficients() for one
+   * spline order and precision.
+   */
+  template< unsigned int VSplineOrder, class TCoefficient >
+  void EvaluatePaddedBSplineCoefficientsOfOrder(
+    const TCoefficient * paddedCoefficients,
+    const MovingImageContinuousIndexType & cindex,
+    RealType & movingImageValue,
+    MovingImageDerivativeType * gradient ) const;
+
   /** Compute the image value (and possibly derivative) at a transformed point.
    * Checks if the point lies within the moving image buffer (bool return).
    * If no gradient is wanted, set the gradient argument to 0.
@@ -508,6 +1210,10 @@ protected:
   /** Check if the transform is a B-spline. Called by Initialize. */
   virtual void CheckForBSplineTransform( void ) const;
 
+  /** Look up the transform in DispatchTransformTypeList, and the range
+   * of the moving image buffer. Called by Initialize. */
+  virtual void InitializeTransformDispatch( void );
+
   /** Transform a point from FixedImage domain to MovingImage domain.
    * This function also checks if mapped point is within support region of
    * the transform. It returns true if so, and false otherwise.
@@ -527,14 +1233,60 @@ protected:
     TransformJacobianType & jacobian,
     NonZeroJacobianIndicesType & nzji ) const;
 
+  /** Same as TransformPoint() and EvaluateTransformJacobian(), for sample
+   * sampleIndex of the image sampler output. The results are read from the
+   * shared transform evaluation cache, when it is set. The mapped point is
+   * otherwise computed from the line search transform cache, when it is
+   * valid for the current parameters and the sample.
+   */
+  bool TransformPoint(
+    const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint,
+    MovingImagePointType & mappedPoint ) const;
+
+  /** Same as the sample-indexed TransformPoint(), for the numberOfPoints
+   * consecutive samples starting at firstSampleIndex. When no cache applies
+   * and the transform is not dispatched, the points are transformed with
+   * one call to AdvancedTransform::TransformPoints().
+   */
+  void TransformPoints(
+    const SizeValueType firstSampleIndex,
+    const SizeValueType numberOfPoints,
+    const FixedImagePointType * fixedImagePoints,
+    MovingImagePointType * mappedPoints ) const;
+
+  bool EvaluateTransformJacobian(
+    const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint,
+    TransformJacobianType & jacobian,
+    NonZeroJacobianIndicesType & nzji ) const;
+
+  /** Compute the inner product of the transform Jacobian and the moving image
+   * gradient for sample sampleIndex of the image sampler output. The shared
+   * transform evaluation cache is used when it has Jacobians, then the
+   * transform Jacobian structure cache, and otherwise the transform.
+   */
+  void EvaluateTransformJacobianWithImageGradientProduct(
+    const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint,
+    const MovingImageDerivativeType & movingImageDerivative,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nzji ) const;
+
   /** Convenience method: check if point is inside the moving mask. *****************/
   virtual bool IsInsideMovingMask( const MovingImagePointType & point ) const;
 
+  /** Compile the moving mask for IsInsideMovingMask(), if it is an image mask.
+   * Called by Initialize(). */
+  virtual void InitializeMovingImageMask( void );
+
   /** Methods for the support of gray value limiters. ***************/
 
   /** Compute the extrema of fixed image over a region
    * Initializes the m_Fixed[True]{Max,Min}[Limit]
-   * This method is called by InitializeLimiters() and uses the FixedLimitRangeRatio */
+   * This method is called by InitializeLimiters() and uses the FixedLimitRangeRatio.
+   * The scan is multi-threaded, and its result is kept in the ImageExtremaCache,
+   * so that other metrics and later resolutions on the same image skip it. */
   virtual void ComputeFixedImageExtrema(
     const FixedImageType * image,
     const FixedImageRegionType & region );
@@ -546,6 +1298,40 @@ protected:
     const MovingImageType * image,
     const MovingImageRegionType & region );
 
+  /** The parameters of the threaded scan for the image extrema. */
+  struct ImageExtremaThreaderParameterType
+  {
+    const Self *            m_Metric;
+    bool                    m_ScanMovingImage;
+    const FixedImageType *  m_FixedImage;
+    FixedImageRegionType    m_FixedImageRegion;
+    const MovingImageType * m_MovingImage;
+    MovingImageRegionType   m_MovingImageRegion;
+    std::vector< double >   m_Minima;
+    std::vector< double >   m_Maxima;
+  };
+
+  /** Scan the part of thread threadId of the fixed or moving image. */
+  void ThreadedComputeImageExtrema( ThreadIdType threadId, ThreadIdType numberOfThreads,
+    ImageExtremaThreaderParameterType & parameters ) const;
+
+  /** ComputeImageExtrema threader callback function. */
+  static ITK_THREAD_RETURN_TYPE ComputeImageExtremaThreaderCallback( void * arg );
+
+  /** Run the scan for the image extrema, on all threads if multi-threading
+   * is used, and combine the per-thread results. Returns false if the region
+   * has no voxels inside the mask. */
+  bool LaunchComputeImageExtrema( ImageExtremaThreaderParameterType & parameters,
+    double & minimum, double & maximum ) const;
+
+  /** Scan the slab of thread threadId of a region for the extrema of the
+   * voxels inside the mask, if any. */
+  template< class TImage, class TMask >
+  static void ScanImageExtrema( const TImage * image,
+    const typename TImage::RegionType & fullRegion,
+    const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+    const TMask * mask, double & minimum, double & maximum );
+
   /** Initialize the {Fixed,Moving}[True]{Max,Min}[Limit] and the {Fixed,Moving}ImageLimiter
    * Only does something when Use{Fixed,Moving}Limiter is set to true; */
   virtual void InitializeLimiters( void );
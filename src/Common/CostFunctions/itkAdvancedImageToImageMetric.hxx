@@ -23,6 +23,14 @@
 #include "itkImageRegionConstIterator.h"          // used for extrema computation
 #include "itkImageRegionConstIteratorWithIndex.h" // used for extrema computation
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkTraceEventRecorder.h"
+#include "itkHardwareCounters.h"
+#include "itkImageExtremaCache.h"
+#include "itkImageFileCache.h"
+#include "itkBSplineCoefficientImageProvider.h"
+#include "itkDistributedEvaluation.h"
+#include "itkRegistrationMonitor.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -64,6 +72,11 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   this->m_AdvancedTransform                                = 0;
   this->m_TransformIsAdvanced                              = false;
   this->m_TransformIsBSpline                               = false;
+  this->m_UseTransformDispatch                             = true;
+  this->m_DispatchTransform                                = 0;
+  this->m_DispatchCombinationTransform                     = 0;
+  this->m_DispatchTransformPosition                        = -1;
+  this->m_InlineIsInsideBuffer                             = false;
   this->m_UseMovingImageDerivativeScales                   = false;
   this->m_ScaleGradientWithRespectToMovingImageOrientation = false;
   this->m_MovingImageDerivativeScales.Fill( 1.0 );
@@ -87,6 +100,67 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   this->m_UseMetricSingleThreaded = true;
   this->m_Threader->SetUseThreadPool( false ); // setting to true makes elastix hang
                                                // at a WaitForSingleMethodThread()
+  this->m_UseThreadPool         = true;
+  this->m_ThreadPool            = 0;
+  this->m_UseNUMAAwareThreading = false;
+
+  this->m_AutomaticNumberOfThreads         = false;
+  this->m_NumberOfThreadsTuningEvaluations = 2;
+  this->m_NumberOfThreadsTuningEvaluation  = 0;
+  this->m_NumberOfThreadsTuningStart       = 0.0;
+  this->m_NumberOfThreadsTuningClock       = RealTimeClock::New();
+  this->m_UseSampleArrays       = false;
+  this->m_SampleArrays          = 0;
+  this->m_SampleWeights         = 0;
+  this->m_SupportsSampleWeights = false;
+
+  /** Sparse derivative accumulation related variables. */
+  this->m_SupportsSparseDerivativeAccumulation = false;
+  this->m_UseSparseDerivativeAccumulation      = false;
+  this->m_UseNonZeroJacobianIndicesDescriptor  = false;
+  this->m_SupportsAtomicDerivativeAccumulation = false;
+  this->m_UseAtomicDerivativeAccumulation      = false;
+  this->m_SupportsConcurrentEvaluation         = false;
+  this->m_SupportsDistributedEvaluation        = false;
+
+  /** Shared transform evaluation cache related variables. */
+  this->m_SharedTransformEvaluationCache         = 0;
+  this->m_SupportsSharedTransformEvaluationCache = false;
+
+  /** Line search transform cache related variables. */
+  this->m_UseLineSearchTransformCache         = false;
+  this->m_LineSearchDirectionSquaredMagnitude = 0.0;
+  this->m_LineSearchTransformCacheIsValid     = false;
+  this->m_LineSearchStepLength                = 0.0;
+
+  /** Transform Jacobian structure cache related variables. */
+  this->m_CacheTransformJacobianStructure   = false;
+  this->m_MaximumJacobianStructureCacheSize = 512 * 1024 * 1024;
+  this->m_UseJacobianStructureCache         = false;
+  this->m_SupportsTransformJacobianStructureCache = false;
+  this->m_JacobianStructureSamplesMTime     = 0;
+  this->m_JacobianStructureCacheMTime       = 0;
+  this->m_JacobianStructureTransformMTime   = 0;
+
+  /** Moving image gradient cache related variables. */
+  this->m_CacheMovingImageGradient            = false;
+  this->m_RestrictSamplingToMovingImageOverlap = false;
+  this->m_MaximumMovingImageGradientCacheSize = 512 * 1024 * 1024;
+  this->m_CompiledMovingImageMask             = 0;
+
+  /** Recursive B-spline interpolation related variables. */
+  this->m_UseRecursiveBSplineInterpolation           = true;
+  this->m_MaximumPaddedBSplineCoefficientsSize       = 512 * 1024 * 1024;
+  this->m_PaddedBSplineCoefficientsSplineOrder       = 0;
+  this->m_PaddedBSplineCoefficientsUseImageDirection = false;
+  for( unsigned int d = 0; d <= MovingImageDimension; ++d )
+  {
+    this->m_PaddedBSplineCoefficientsOffsetTable[ d ] = 0;
+  }
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    this->m_PaddedBSplineCoefficientsStartIndex[ d ] = 0;
+  }
 
   /** OpenMP related. Switch to on when available */
 #ifdef ELASTIX_USE_OPENMP
@@ -153,6 +227,9 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Initialize transform, interpolator, etc. */
   Superclass::Initialize();
 
+  /** Compile the moving mask; the limiters already use it. */
+  this->InitializeMovingImageMask();
+
   /** Setup the parameters for the gray value limiters. */
   this->InitializeLimiters();
 
@@ -162,18 +239,43 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Check if the interpolator is a B-spline interpolator. */
   this->CheckForBSplineInterpolator();
 
+  /** Compute the padded B-spline coefficients, if requested. */
+  this->ComputePaddedBSplineCoefficients();
+
+  /** Precompute the moving image gradient, if requested. It is built from
+   * the padded B-spline coefficients. */
+  this->ComputeMovingImageGradientCache();
+
   /** Check if the transform is an advanced transform. */
   this->CheckForAdvancedTransform();
 
   /** Check if the transform is a B-spline transform. */
   this->CheckForBSplineTransform();
 
+  /** Select the transform that is evaluated without virtual calls. */
+  this->InitializeTransformDispatch();
+
+  /** Use the shared, process-wide thread pool if no pool was set. */
+  if( this->m_UseThreadPool && this->m_ThreadPool.IsNull() )
+  {
+    this->m_ThreadPool = ThreadPoolType::GetGlobalThreadPool();
+  }
+
+  /** Start tuning the number of threads, for this resolution. */
+  this->InitializeNumberOfThreadsTuning();
+
   /** Initialize some threading related parameters. */
   if( this->m_UseMultiThread )
   {
     this->InitializeThreadingParameters();
   }
 
+  /** Start without a transform Jacobian structure cache. */
+  this->m_UseJacobianStructureCache       = false;
+  this->m_JacobianStructureSamplesMTime   = 0;
+  this->m_JacobianStructureCacheMTime     = 0;
+  this->m_JacobianStructureTransformMTime = 0;
+
 } // end Initialize()
 
 
@@ -212,21 +314,313 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariablesSize = this->m_NumberOfThreads;
   }
 
-  /** Some initialization. */
-  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  /** Only track the touched derivative blocks, or scatter atomically into
+   * the shared derivative, when the derivative of a single sample is sparse.
+   * The atomic mode is only worth it when the per-thread copies of the
+   * derivative are large and many threads would have to reduce them.
+   */
+  const NumberOfParametersType numberOfParameters = this->GetNumberOfParameters();
+  const bool                   sparseJacobian     = this->m_AdvancedTransform.IsNotNull()
+    && this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() < numberOfParameters;
+  const double perThreadDerivativesSize = static_cast< double >( numberOfParameters )
+    * sizeof( DerivativeValueType ) * this->m_NumberOfThreads;
+  this->m_UseAtomicDerivativeAccumulation = ELASTIX_HAVE_ATOMIC_ADD
+    && this->m_SupportsAtomicDerivativeAccumulation && sparseJacobian
+    && this->m_NumberOfThreads >= AtomicDerivativeAccumulationMinimumNumberOfThreads
+    && perThreadDerivativesSize > AtomicDerivativeAccumulationMemoryThreshold;
+  this->m_UseSparseDerivativeAccumulation = this->m_SupportsSparseDerivativeAccumulation
+    && sparseJacobian && !this->m_UseAtomicDerivativeAccumulation;
+  this->m_UseNonZeroJacobianIndicesDescriptor = this->m_AdvancedTransform.IsNotNull()
+    && this->m_AdvancedTransform->GetHasNonZeroJacobianIndicesDescriptor();
+
+  /** Some initialization. With NUMA-aware threading the per-thread buffers
+   * are allocated and first touched by the threads that use them, so that
+   * the operating system places their pages on the memory node of that thread.
+   */
+  if( this->m_UseNUMAAwareThreading )
   {
-    this->m_GetValuePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
-    this->m_GetValuePerThreadVariables[ i ].st_Value                 = NumericTraits< MeasureType >::Zero;
-
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value                 = NumericTraits< MeasureType >::Zero;
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.SetSize( this->GetNumberOfParameters() );
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    this->ExecuteThreaderCallback( this->InitializePerThreadVariablesThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  }
+  else
+  {
+    for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+    {
+      this->InitializePerThreadVariables( i );
+    }
   }
 
 } // end InitializeThreadingParameters()
 
 
+/**
+ * ********************* InitializeNumberOfThreadsTuning ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeNumberOfThreadsTuning( void )
+{
+  this->m_NumberOfThreadsTuningCandidates.clear();
+  this->m_NumberOfThreadsTuningTimes.clear();
+  this->m_NumberOfThreadsTuningEvaluation = 0;
+  if( !this->m_AutomaticNumberOfThreads || !this->m_UseMultiThread )
+  {
+    return;
+  }
+
+  /** Halve the number of threads until one is left. The first candidate is
+   * the current number, so the buffers need not be reallocated now. */
+  ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  while( numberOfThreads > 1 )
+  {
+    this->m_NumberOfThreadsTuningCandidates.push_back( numberOfThreads );
+    numberOfThreads = ( numberOfThreads + 1 ) / 2;
+  }
+  this->m_NumberOfThreadsTuningCandidates.push_back( 1 );
+  this->m_NumberOfThreadsTuningTimes.assign( this->m_NumberOfThreadsTuningCandidates.size(), 0.0 );
+
+} // end InitializeNumberOfThreadsTuning()
+
+
+/**
+ * ********************* GetNumberOfThreadsTuningFinished ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetNumberOfThreadsTuningFinished( void ) const
+{
+  const SizeValueType evaluationsPerCandidate = this->m_NumberOfThreadsTuningEvaluations + 1;
+  return !this->m_NumberOfThreadsTuningCandidates.empty()
+         && this->m_NumberOfThreadsTuningEvaluation
+         > this->m_NumberOfThreadsTuningCandidates.size() * evaluationsPerCandidate;
+
+} // end GetNumberOfThreadsTuningFinished()
+
+
+/**
+ * ********************* TuneNumberOfThreads ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TuneNumberOfThreads( void ) const
+{
+  const SizeValueType numberOfCandidates = this->m_NumberOfThreadsTuningCandidates.size();
+  if( numberOfCandidates == 0 || this->GetNumberOfThreadsTuningFinished() )
+  {
+    return;
+  }
+
+  /** The time since the start of the previous evaluation is that of the
+   * previous evaluation, including the work of the optimizer in between,
+   * which is the same for all candidates. The first evaluation of each
+   * candidate reallocates the per-thread buffers, and is not counted.
+   */
+  const SizeValueType evaluationsPerCandidate = this->m_NumberOfThreadsTuningEvaluations + 1;
+  const double        now                     = this->m_NumberOfThreadsTuningClock->GetTimeInSeconds();
+  const SizeValueType evaluation              = this->m_NumberOfThreadsTuningEvaluation;
+  if( evaluation > 0 && ( evaluation - 1 ) % evaluationsPerCandidate != 0 )
+  {
+    this->m_NumberOfThreadsTuningTimes[ ( evaluation - 1 ) / evaluationsPerCandidate ]
+      += ( now - this->m_NumberOfThreadsTuningStart ) / this->m_NumberOfThreadsTuningEvaluations;
+  }
+  ++this->m_NumberOfThreadsTuningEvaluation;
+
+  /** Select the number of threads of the next evaluation: the next candidate,
+   * or the fastest one when all candidates have been timed. */
+  ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  if( evaluation == numberOfCandidates * evaluationsPerCandidate )
+  {
+    const SizeValueType fastest = std::min_element( this->m_NumberOfThreadsTuningTimes.begin(),
+      this->m_NumberOfThreadsTuningTimes.end() ) - this->m_NumberOfThreadsTuningTimes.begin();
+    numberOfThreads = this->m_NumberOfThreadsTuningCandidates[ fastest ];
+  }
+  else if( evaluation % evaluationsPerCandidate == 0 )
+  {
+    numberOfThreads = this->m_NumberOfThreadsTuningCandidates[ evaluation / evaluationsPerCandidate ];
+  }
+
+  if( numberOfThreads != this->m_NumberOfThreads )
+  {
+    const_cast< Self * >( this )->SetNumberOfThreads( numberOfThreads );
+    this->InitializeThreadingParameters();
+  }
+  this->m_NumberOfThreadsTuningStart = this->m_NumberOfThreadsTuningClock->GetTimeInSeconds();
+
+} // end TuneNumberOfThreads()
+
+
+/**
+ * ********************* InitializePerThreadVariables ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializePerThreadVariables( ThreadIdType threadId ) const
+{
+  const NumberOfParametersType numberOfParameters = this->GetNumberOfParameters();
+  const SizeValueType          numberOfBlocks     = this->m_UseSparseDerivativeAccumulation
+    ? ( ( numberOfParameters - 1 ) >> DerivativeBlockSizeLog2 ) + 1 : 0;
+  const NumberOfParametersType perThreadDerivativeSize
+    = this->m_UseAtomicDerivativeAccumulation ? 0 : numberOfParameters;
+
+  this->m_GetValuePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+  this->m_GetValuePerThreadVariables[ threadId ].st_Value                 = NumericTraits< MeasureType >::Zero;
+
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = NumericTraits< MeasureType >::Zero;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative.SetSize( perThreadDerivativeSize );
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks.assign( numberOfBlocks, 0 );
+
+  /** Size the scratch buffers for the Jacobian of one sample. These keep their
+   * memory as long as the transform does not change.
+   */
+  if( this->m_AdvancedTransform.IsNotNull() )
+  {
+    const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
+    AlignedGetValueAndDerivativePerThreadStruct & perThread
+      = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+    if( perThread.st_TransformJacobian.cols() != nnzji
+      || perThread.st_TransformJacobian.rows() != MovingImageDimension )
+    {
+      perThread.st_TransformJacobian.set_size( MovingImageDimension, nnzji );
+    }
+    perThread.st_NonZeroJacobianIndices.resize( nnzji );
+    perThread.st_ImageJacobian.SetSize( nnzji );
+  }
+
+} // end InitializePerThreadVariables()
+
+
+/**
+ * ********************* AddDerivativeTerms ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::AddDerivativeTerms( const DerivativeValueType factor,
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesDescriptorType & descriptor,
+  DerivativeType & derivative ) const
+{
+  /** The rows along the first grid dimension are contiguous in the derivative,
+   * and the other dimensions are walked through like an odometer.
+   */
+  const unsigned int  inputDimension = FixedImageDimension;
+  const unsigned long rowLength      = descriptor.m_SupportSize[ 0 ];
+  const unsigned long rowStride      = descriptor.m_Strides[ 0 ];
+  unsigned long       numberOfRows   = 1;
+  for( unsigned int i = 1; i < inputDimension; ++i )
+  {
+    numberOfRows *= descriptor.m_SupportSize[ i ];
+  }
+
+  const DerivativeValueType * imjac = imageJacobian.begin();
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    unsigned long k[ FixedImageDimension ];
+    std::fill( k, k + inputDimension, 0 );
+    DerivativeValueType * rowStart = derivative.begin() + descriptor.m_Start
+      + d * descriptor.m_ParametersPerDimension;
+    for( unsigned long r = 0; r < numberOfRows; ++r )
+    {
+      DerivativeValueType * deriv = rowStart;
+      for( unsigned long x = 0; x < rowLength; ++x, deriv += rowStride )
+      {
+        *deriv += factor * ( *imjac++ );
+      }
+      for( unsigned int i = 1; i < inputDimension; ++i )
+      {
+        rowStart += descriptor.m_Strides[ i ];
+        if( ++k[ i ] < descriptor.m_SupportSize[ i ] ) { break; }
+        rowStart -= k[ i ] * descriptor.m_Strides[ i ];
+        k[ i ]    = 0;
+      }
+    }
+  }
+
+} // end AddDerivativeTerms()
+
+
+/**
+ * ********************* MarkTouchedDerivativeBlocks ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::MarkTouchedDerivativeBlocks( const ThreadIdType threadId,
+  const NonZeroJacobianIndicesDescriptorType & descriptor ) const
+{
+  if( !this->m_UseSparseDerivativeAccumulation )
+  {
+    return;
+  }
+
+  /** Mark the blocks of the first and last parameter of every row. The
+   * rows are much shorter than a block, so nothing lies in between.
+   */
+  unsigned char *     touched        = &( this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks[ 0 ] );
+  const unsigned int  inputDimension = FixedImageDimension;
+  const unsigned long rowExtent      = ( descriptor.m_SupportSize[ 0 ] - 1 ) * descriptor.m_Strides[ 0 ];
+  unsigned long       numberOfRows   = 1;
+  for( unsigned int i = 1; i < inputDimension; ++i )
+  {
+    numberOfRows *= descriptor.m_SupportSize[ i ];
+  }
+
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    unsigned long k[ FixedImageDimension ];
+    std::fill( k, k + inputDimension, 0 );
+    unsigned long rowStart = descriptor.m_Start + d * descriptor.m_ParametersPerDimension;
+    for( unsigned long r = 0; r < numberOfRows; ++r )
+    {
+      touched[ rowStart >> DerivativeBlockSizeLog2 ]               = 1;
+      touched[ ( rowStart + rowExtent ) >> DerivativeBlockSizeLog2 ] = 1;
+      for( unsigned int i = 1; i < inputDimension; ++i )
+      {
+        rowStart += descriptor.m_Strides[ i ];
+        if( ++k[ i ] < descriptor.m_SupportSize[ i ] ) { break; }
+        rowStart -= k[ i ] * descriptor.m_Strides[ i ];
+        k[ i ]    = 0;
+      }
+    }
+  }
+
+} // end MarkTouchedDerivativeBlocks()
+
+
+/**
+ * **************** InitializePerThreadVariablesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializePerThreadVariablesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID   = infoStruct->ThreadID;
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->st_Metric->InitializePerThreadVariables( threadID );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end InitializePerThreadVariablesThreaderCallback()
+
+
 /**
  * ****************** ComputeFixedImageExtrema ***************************
  */
@@ -240,43 +634,36 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 {
   /** NB: We can't use StatisticsImageFilterWithMask to do this because
    * the filter computes the min/max for the largest possible region.
-   * This filter is multi-threaded though.
    */
   FixedImagePixelType trueMinTemp = NumericTraits< FixedImagePixelType >::max();
   FixedImagePixelType trueMaxTemp = NumericTraits< FixedImagePixelType >::NonpositiveMin();
 
-  /** If no mask. */
-  if( this->m_FixedImageMask.IsNull() )
+  /** Look in the cache first; otherwise scan the image. */
+  ImageExtremaCache::Pointer      cache = ImageExtremaCache::GetInstance();
+  const ImageExtremaCache::KeyType key
+    = ImageExtremaCache::MakeKey( image, this->m_FixedImageMask.GetPointer(), region );
+  double minimum = 0.0;
+  double maximum = 0.0;
+  bool   found   = cache->GetExtrema( key, minimum, maximum );
+  if( !found )
   {
-    typedef ImageRegionConstIterator< FixedImageType > IteratorType;
-    IteratorType it( image, region );
-    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    ImageExtremaThreaderParameterType parameters;
+    parameters.m_ScanMovingImage  = false;
+    parameters.m_FixedImage       = image;
+    parameters.m_FixedImageRegion = region;
+    parameters.m_MovingImage      = 0;
+    found = this->LaunchComputeImageExtrema( parameters, minimum, maximum );
+    if( found )
     {
-      const FixedImagePixelType sample = it.Get();
-      trueMinTemp = vnl_math_min( trueMinTemp, sample );
-      trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
+      cache->SetExtrema( key, minimum, maximum );
     }
   }
-  /** Excluded extrema outside the mask.
-   * Because we have to call TransformIndexToPhysicalPoint() and
-   * check IsInside() this way is much (!) slower.
-   */
-  else
-  {
-    typedef ImageRegionConstIteratorWithIndex< FixedImageType > IteratorType;
-    IteratorType it( image, region );
 
-    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
-    {
-      OutputPointType point;
-      image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
-      if( this->m_FixedImageMask->IsInside( point ) )
-      {
-        const FixedImagePixelType sample = it.Get();
-        trueMinTemp = vnl_math_min( trueMinTemp, sample );
-        trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
-      }
-    }
+  /** A region without voxels inside the mask keeps the initial values. */
+  if( found )
+  {
+    trueMinTemp = static_cast< FixedImagePixelType >( minimum );
+    trueMaxTemp = static_cast< FixedImagePixelType >( maximum );
   }
 
   /** Update member variables. */
@@ -308,38 +695,33 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   MovingImagePixelType trueMinTemp = NumericTraits< MovingImagePixelType >::max();
   MovingImagePixelType trueMaxTemp = NumericTraits< MovingImagePixelType >::NonpositiveMin();
 
-  /** If no mask. */
-  if( this->m_MovingImageMask.IsNull() )
+  /** Look in the cache first; otherwise scan the image. The compiled mask
+   * is equivalent to the moving mask, so the latter is the key. */
+  ImageExtremaCache::Pointer      cache = ImageExtremaCache::GetInstance();
+  const ImageExtremaCache::KeyType key
+    = ImageExtremaCache::MakeKey( image, this->m_MovingImageMask.GetPointer(), region );
+  double minimum = 0.0;
+  double maximum = 0.0;
+  bool   found   = cache->GetExtrema( key, minimum, maximum );
+  if( !found )
   {
-    typedef ImageRegionConstIterator< MovingImageType > IteratorType;
-    IteratorType iterator( image, region );
-    for( iterator.GoToBegin(); !iterator.IsAtEnd(); ++iterator )
+    ImageExtremaThreaderParameterType parameters;
+    parameters.m_ScanMovingImage   = true;
+    parameters.m_FixedImage        = 0;
+    parameters.m_MovingImage       = image;
+    parameters.m_MovingImageRegion = region;
+    found = this->LaunchComputeImageExtrema( parameters, minimum, maximum );
+    if( found )
     {
-      const MovingImagePixelType sample = iterator.Get();
-      trueMinTemp = vnl_math_min( trueMinTemp, sample );
-      trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
+      cache->SetExtrema( key, minimum, maximum );
     }
   }
-  /** Excluded extrema outside the mask.
-   * Because we have to call TransformIndexToPhysicalPoint() and
-   * check IsInside() this way is much (!) slower.
-   */
-  else
-  {
-    typedef ImageRegionConstIteratorWithIndex< MovingImageType > IteratorType;
-    IteratorType it( image, region );
 
-    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
-    {
-      OutputPointType point;
-      image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
-      if( this->m_MovingImageMask->IsInside( point ) )
-      {
-        const MovingImagePixelType sample = it.Get();
-        trueMinTemp = vnl_math_min( trueMinTemp, sample );
-        trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
-      }
-    }
+  /** A region without voxels inside the mask keeps the initial values. */
+  if( found )
+  {
+    trueMinTemp = static_cast< MovingImagePixelType >( minimum );
+    trueMaxTemp = static_cast< MovingImagePixelType >( maximum );
   }
 
   /** Update member variables. */
@@ -355,75 +737,262 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ****************** InitializeLimiter *****************************
+ * ****************** LaunchComputeImageExtrema ***************************
  */
 
 template< class TFixedImage, class TMovingImage >
-void
+bool
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::InitializeLimiters( void )
+::LaunchComputeImageExtrema( ImageExtremaThreaderParameterType & parameters,
+  double & minimum, double & maximum ) const
 {
-  /** Set up fixed limiter. */
-  if( this->GetUseFixedImageLimiter() )
+  /** Every thread scans a slab; a thread without voxels inside the mask
+   * keeps an empty interval, with minimum above maximum.
+   */
+  const ThreadIdType numberOfThreads
+    = this->m_UseMultiThread ? this->m_NumberOfThreads : 1;
+  parameters.m_Metric = this;
+  parameters.m_Minima.assign( numberOfThreads, NumericTraits< double >::max() );
+  parameters.m_Maxima.assign( numberOfThreads, NumericTraits< double >::NonpositiveMin() );
+
+  if( this->m_UseMultiThread )
   {
-    if( this->GetFixedImageLimiter() == 0 )
-    {
-      itkExceptionMacro( << "No fixed image limiter has been set!" );
-    }
+    this->ExecuteThreaderCallback( this->ComputeImageExtremaThreaderCallback,
+      static_cast< void * >( &parameters ) );
+  }
+  else
+  {
+    this->ThreadedComputeImageExtrema( 0, 1, parameters );
+  }
 
-    this->ComputeFixedImageExtrema(
-      this->GetFixedImage(),
-      this->GetFixedImageRegion() );
+  /** Combine the results of the threads. */
+  minimum = NumericTraits< double >::max();
+  maximum = NumericTraits< double >::NonpositiveMin();
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    minimum = vnl_math_min( minimum, parameters.m_Minima[ i ] );
+    maximum = vnl_math_max( maximum, parameters.m_Maxima[ i ] );
+  }
 
-    this->m_FixedImageLimiter->SetLowerThreshold(
-      static_cast< RealType >( this->m_FixedImageTrueMin ) );
-    this->m_FixedImageLimiter->SetUpperThreshold(
-      static_cast< RealType >( this->m_FixedImageTrueMax ) );
-    this->m_FixedImageLimiter->SetLowerBound( this->m_FixedImageMinLimit );
-    this->m_FixedImageLimiter->SetUpperBound( this->m_FixedImageMaxLimit );
+  return minimum <= maximum;
 
-    this->m_FixedImageLimiter->Initialize();
-  }
+} // end LaunchComputeImageExtrema()
 
-  /** Set up moving limiter. */
-  if( this->GetUseMovingImageLimiter() )
-  {
-    if( this->GetMovingImageLimiter() == 0 )
-    {
-      itkExceptionMacro( << "No moving image limiter has been set!" );
-    }
 
-    this->ComputeMovingImageExtrema(
-      this->GetMovingImage(),
-      this->GetMovingImage()->GetBufferedRegion() );
+/**
+ * ****************** ComputeImageExtremaThreaderCallback *******************
+ */
 
-    this->m_MovingImageLimiter->SetLowerThreshold(
-      static_cast< RealType >( this->m_MovingImageTrueMin ) );
-    this->m_MovingImageLimiter->SetUpperThreshold(
-      static_cast< RealType >( this->m_MovingImageTrueMax ) );
-    this->m_MovingImageLimiter->SetLowerBound( this->m_MovingImageMinLimit );
-    this->m_MovingImageLimiter->SetUpperBound( this->m_MovingImageMaxLimit );
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeImageExtremaThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
 
-    this->m_MovingImageLimiter->Initialize();
-  }
+  ImageExtremaThreaderParameterType * temp
+    = static_cast< ImageExtremaThreaderParameterType * >( infoStruct->UserData );
 
-} // end InitializeLimiter()
+  temp->m_Metric->ThreadedComputeImageExtrema( threadID, nrOfThreads, *temp );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeImageExtremaThreaderCallback()
 
 
 /**
- * ********************* InitializeImageSampler ****************************
+ * ****************** ThreadedComputeImageExtrema ***************************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::InitializeImageSampler( void ) throw ( ExceptionObject )
+::ThreadedComputeImageExtrema( ThreadIdType threadId, ThreadIdType numberOfThreads,
+  ImageExtremaThreaderParameterType & parameters ) const
 {
-  if( this->GetUseImageSampler() )
+  /** The pool may run more threads than there are result slots. */
+  if( threadId >= parameters.m_Minima.size() )
   {
-    /** Check if the ImageSampler is set. */
-    if( !this->m_ImageSampler )
-    {
+    return;
+  }
+  double & minimum = parameters.m_Minima[ threadId ];
+  double & maximum = parameters.m_Maxima[ threadId ];
+
+  if( !parameters.m_ScanMovingImage )
+  {
+    ScanImageExtrema( parameters.m_FixedImage, parameters.m_FixedImageRegion,
+      threadId, numberOfThreads, this->m_FixedImageMask.GetPointer(), minimum, maximum );
+  }
+  else if( this->m_CompiledMovingImageMask.IsNotNull() )
+  {
+    ScanImageExtrema( parameters.m_MovingImage, parameters.m_MovingImageRegion,
+      threadId, numberOfThreads, this->m_CompiledMovingImageMask.GetPointer(), minimum, maximum );
+  }
+  else
+  {
+    ScanImageExtrema( parameters.m_MovingImage, parameters.m_MovingImageRegion,
+      threadId, numberOfThreads, this->m_MovingImageMask.GetPointer(), minimum, maximum );
+  }
+
+} // end ThreadedComputeImageExtrema()
+
+
+/**
+ * ****************** ScanImageExtrema ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage, class TMask >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ScanImageExtrema( const TImage * image,
+  const typename TImage::RegionType & fullRegion,
+  const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+  const TMask * mask, double & minimum, double & maximum )
+{
+  typedef typename TImage::RegionType RegionType;
+  typedef typename TImage::PixelType  PixelType;
+
+  /** Take the slab of this thread along the outermost axis of more than
+   * one voxel, as in SplitFixedImageRegionForThread(). */
+  RegionType   region    = fullRegion;
+  unsigned int splitAxis = TImage::ImageDimension - 1;
+  while( splitAxis > 0 && region.GetSize()[ splitAxis ] <= 1 )
+  {
+    --splitAxis;
+  }
+  const SizeValueType range     = region.GetSize()[ splitAxis ];
+  const SizeValueType chunkSize = ( range + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType begin     = vnl_math_min( range, threadId * chunkSize );
+  const SizeValueType end       = vnl_math_min( range, begin + chunkSize );
+  if( end <= begin )
+  {
+    return;
+  }
+  region.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + static_cast< OffsetValueType >( begin ) );
+  region.SetSize( splitAxis, end - begin );
+
+  /** Compare in the pixel type, and convert once at the end. */
+  PixelType trueMinTemp = NumericTraits< PixelType >::max();
+  PixelType trueMaxTemp = NumericTraits< PixelType >::NonpositiveMin();
+  bool      any         = false;
+
+  /** If no mask. */
+  if( mask == 0 )
+  {
+    typedef ImageRegionConstIterator< TImage > IteratorType;
+    IteratorType it( image, region );
+    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+      const PixelType sample = it.Get();
+      trueMinTemp = vnl_math_min( trueMinTemp, sample );
+      trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
+    }
+    any = true;
+  }
+  /** Excluded extrema outside the mask.
+   * Because we have to call TransformIndexToPhysicalPoint() and
+   * check IsInside() this way is much (!) slower.
+   */
+  else
+  {
+    typedef ImageRegionConstIteratorWithIndex< TImage > IteratorType;
+    IteratorType it( image, region );
+    typename TImage::PointType point;
+    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+      image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+      if( mask->IsInside( point ) )
+      {
+        const PixelType sample = it.Get();
+        trueMinTemp = vnl_math_min( trueMinTemp, sample );
+        trueMaxTemp = vnl_math_max( trueMaxTemp, sample );
+        any         = true;
+      }
+    }
+  }
+
+  if( any )
+  {
+    minimum = static_cast< double >( trueMinTemp );
+    maximum = static_cast< double >( trueMaxTemp );
+  }
+
+} // end ScanImageExtrema()
+
+
+/**
+ * ****************** InitializeLimiter *****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeLimiters( void )
+{
+  /** Set up fixed limiter. */
+  if( this->GetUseFixedImageLimiter() )
+  {
+    if( this->GetFixedImageLimiter() == 0 )
+    {
+      itkExceptionMacro( << "No fixed image limiter has been set!" );
+    }
+
+    this->ComputeFixedImageExtrema(
+      this->GetFixedImage(),
+      this->GetFixedImageRegion() );
+
+    this->m_FixedImageLimiter->SetLowerThreshold(
+      static_cast< RealType >( this->m_FixedImageTrueMin ) );
+    this->m_FixedImageLimiter->SetUpperThreshold(
+      static_cast< RealType >( this->m_FixedImageTrueMax ) );
+    this->m_FixedImageLimiter->SetLowerBound( this->m_FixedImageMinLimit );
+    this->m_FixedImageLimiter->SetUpperBound( this->m_FixedImageMaxLimit );
+
+    this->m_FixedImageLimiter->Initialize();
+  }
+
+  /** Set up moving limiter. */
+  if( this->GetUseMovingImageLimiter() )
+  {
+    if( this->GetMovingImageLimiter() == 0 )
+    {
+      itkExceptionMacro( << "No moving image limiter has been set!" );
+    }
+
+    this->ComputeMovingImageExtrema(
+      this->GetMovingImage(),
+      this->GetMovingImage()->GetBufferedRegion() );
+
+    this->m_MovingImageLimiter->SetLowerThreshold(
+      static_cast< RealType >( this->m_MovingImageTrueMin ) );
+    this->m_MovingImageLimiter->SetUpperThreshold(
+      static_cast< RealType >( this->m_MovingImageTrueMax ) );
+    this->m_MovingImageLimiter->SetLowerBound( this->m_MovingImageMinLimit );
+    this->m_MovingImageLimiter->SetUpperBound( this->m_MovingImageMaxLimit );
+
+    this->m_MovingImageLimiter->Initialize();
+  }
+
+} // end InitializeLimiter()
+
+
+/**
+ * ********************* InitializeImageSampler ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeImageSampler( void ) throw ( ExceptionObject )
+{
+  if( this->GetUseImageSampler() )
+  {
+    /** Check if the ImageSampler is set. */
+    if( !this->m_ImageSampler )
+    {
       itkExceptionMacro( << "ImageSampler is not present" );
     }
 
@@ -431,11 +1000,144 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ImageSampler->SetInput( this->m_FixedImage );
     this->m_ImageSampler->SetMask( this->m_FixedImageMask );
     this->m_ImageSampler->SetInputImageRegion( this->GetFixedImageRegion() );
+    this->m_ImageSampler->SetOverlapRegion( this->ComputeMovingImageOverlapRegion() );
   }
 
 } // end InitializeImageSampler()
 
 
+/**
+ * ****************** ComputeMovingImageOverlapRegion **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedImageToImageMetric< TFixedImage, TMovingImage >::FixedImageRegionType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMovingImageOverlapRegion( void ) const
+{
+  FixedImageRegionType overlapRegion;
+  if( !this->m_RestrictSamplingToMovingImageOverlap
+    || this->m_Transform.IsNull() || this->m_MovingImage.IsNull() )
+  {
+    return overlapRegion;
+  }
+
+  /** The bounding box of the moving mask, or of the moving image, in
+   * physical coordinates; the voxels extend half a voxel beyond their centers.
+   */
+  MovingImagePointType movingMinimum, movingMaximum;
+  if( this->m_MovingImageMask.IsNotNull() )
+  {
+    typename MovingImageMaskType::BoundingBoxType::ConstPointer bb
+      = this->m_MovingImageMask->GetBoundingBox();
+    movingMinimum = bb->GetMinimum();
+    movingMaximum = bb->GetMaximum();
+  }
+  else
+  {
+    const MovingImageRegionType & region = this->m_MovingImage->GetLargestPossibleRegion();
+    movingMinimum.Fill( NumericTraits< typename MovingImagePointType::ValueType >::max() );
+    movingMaximum.Fill( NumericTraits< typename MovingImagePointType::ValueType >::NonpositiveMin() );
+    const unsigned int numberOfCorners = 1u << MovingImageDimension;
+    for( unsigned int c = 0; c < numberOfCorners; ++c )
+    {
+      ContinuousIndex< double, MovingImageDimension > corner;
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        corner[ d ] = region.GetIndex()[ d ] - 0.5;
+        if( c & ( 1u << d ) )
+        {
+          corner[ d ] += region.GetSize()[ d ];
+        }
+      }
+      MovingImagePointType point;
+      this->m_MovingImage->TransformContinuousIndexToPhysicalPoint( corner, point );
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        movingMinimum[ d ] = std::min( movingMinimum[ d ], point[ d ] );
+        movingMaximum[ d ] = std::max( movingMaximum[ d ], point[ d ] );
+      }
+    }
+  }
+
+  /** Map a coarse grid of fixed image points, at most 16 per dimension. */
+  const FixedImageRegionType & fixedRegion = this->GetFixedImageRegion();
+  unsigned long                gridSize[ FixedImageDimension ];
+  unsigned long                numberOfGridPoints = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    gridSize[ d ]       = std::min( static_cast< unsigned long >( fixedRegion.GetSize()[ d ] ), 16UL );
+    numberOfGridPoints *= gridSize[ d ];
+  }
+
+  long minimumGridIndex[ FixedImageDimension ];
+  long maximumGridIndex[ FixedImageDimension ];
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    minimumGridIndex[ d ] = static_cast< long >( gridSize[ d ] );
+    maximumGridIndex[ d ] = -1;
+  }
+
+  FixedImageIndexType index;
+  FixedImagePointType fixedPoint;
+  long                gridIndex[ FixedImageDimension ];
+  for( unsigned long i = 0; i < numberOfGridPoints; ++i )
+  {
+    unsigned long rest = i;
+    for( unsigned int d = 0; d < FixedImageDimension; ++d )
+    {
+      gridIndex[ d ] = static_cast< long >( rest % gridSize[ d ] );
+      rest          /= gridSize[ d ];
+      const double step = gridSize[ d ] > 1
+        ? static_cast< double >( fixedRegion.GetSize()[ d ] - 1 ) / ( gridSize[ d ] - 1 ) : 0.0;
+      index[ d ] = fixedRegion.GetIndex()[ d ]
+        + static_cast< typename FixedImageIndexType::IndexValueType >( vcl_floor( gridIndex[ d ] * step + 0.5 ) );
+    }
+    this->m_FixedImage->TransformIndexToPhysicalPoint( index, fixedPoint );
+    const MovingImagePointType mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
+
+    bool inside = true;
+    for( unsigned int d = 0; d < MovingImageDimension && inside; ++d )
+    {
+      inside = mappedPoint[ d ] >= movingMinimum[ d ] && mappedPoint[ d ] <= movingMaximum[ d ];
+    }
+    if( inside )
+    {
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        minimumGridIndex[ d ] = std::min( minimumGridIndex[ d ], gridIndex[ d ] );
+        maximumGridIndex[ d ] = std::max( maximumGridIndex[ d ], gridIndex[ d ] );
+      }
+    }
+  }
+
+  /** No grid point maps inside: keep the full region, CheckNumberOfSamples() reports it. */
+  if( maximumGridIndex[ 0 ] < 0 )
+  {
+    return overlapRegion;
+  }
+
+  /** Enlarge the bounding box by one grid cell, and convert it to a region. */
+  FixedImageIndexType                     regionIndex;
+  typename FixedImageRegionType::SizeType regionSize;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    const double step = gridSize[ d ] > 1
+      ? static_cast< double >( fixedRegion.GetSize()[ d ] - 1 ) / ( gridSize[ d ] - 1 ) : 0.0;
+    const long first = static_cast< long >( vcl_floor( ( minimumGridIndex[ d ] - 1 ) * step ) );
+    const long last  = static_cast< long >( vcl_ceil( ( maximumGridIndex[ d ] + 1 ) * step ) );
+    const long lower = std::max( first, 0L );
+    const long upper = std::min( last, static_cast< long >( fixedRegion.GetSize()[ d ] ) - 1 );
+    regionIndex[ d ] = fixedRegion.GetIndex()[ d ] + lower;
+    regionSize[ d ]  = static_cast< SizeValueType >( upper - lower + 1 );
+  }
+  overlapRegion.SetIndex( regionIndex );
+  overlapRegion.SetSize( regionSize );
+  return overlapRegion;
+
+} // end ComputeMovingImageOverlapRegion()
+
+
 /**
  * ****************** CheckForBSplineInterpolator **********************
  */
@@ -496,63 +1198,797 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     itkDebugMacro( "Interpolator is not ReducedBSpline" );
   }
 
-  this->m_InterpolatorIsLinear = false;
-  LinearInterpolatorType * testPtr4
-    = dynamic_cast< LinearInterpolatorType * >( this->m_Interpolator.GetPointer() );
-  if( testPtr4 )
+  this->m_InterpolatorIsLinear = false;
+  LinearInterpolatorType * testPtr4
+    = dynamic_cast< LinearInterpolatorType * >( this->m_Interpolator.GetPointer() );
+  if( testPtr4 )
+  {
+    this->m_InterpolatorIsLinear = true;
+    this->m_LinearInterpolator   = testPtr4;
+  }
+  else
+  {
+    this->m_LinearInterpolator = 0;
+  }
+
+  /** Don't overwrite the gradient image if GetComputeGradient() == true.
+   * Otherwise we can use a forward difference derivative, or the derivative
+   * provided by the B-spline interpolator.
+   */
+  if( !this->GetComputeGradient() )
+  {
+    /** In addition, don't compute the moving image gradient for 2D/3D registration,
+     * i.e. whenever the interpolator is a ray cast interpolator.
+     * This is a bit of a hack that does not respect the setting of the boolean
+     * m_ComputeGradient. By doing this, there is no way to ask no gradient
+     * computation at all (to save memory).
+     * The best solution would be to remove everything below this point, and to
+     * override the ComputeGradient() function of ITK by computing a central
+     * difference derivative. This way SetComputeGradient will enable or disable
+     * the gradient computation and let derived classes choose if it needs the
+     * precomputation of the gradient.
+     *
+     * For more details see the post about "2D/3D registration memory issue" in
+     * elastix's mailing list (2 July 2012).
+     */
+    typedef itk::AdvancedRayCastInterpolateImageFunction<
+      MovingImageType, CoordinateRepresentationType >       RayCastInterpolatorType;
+    const bool interpolatorIsRayCast
+      = dynamic_cast< RayCastInterpolatorType * >( this->m_Interpolator.GetPointer() ) != 0;
+
+    if( !this->m_InterpolatorIsBSpline && !this->m_InterpolatorIsBSplineFloat
+      && !this->m_InterpolatorIsReducedBSpline
+      && !this->m_InterpolatorIsLinear
+      && !interpolatorIsRayCast )
+    {
+      this->m_CentralDifferenceGradientFilter = CentralDifferenceGradientFilterType::New();
+      this->m_CentralDifferenceGradientFilter->SetUseImageSpacing( true );
+      this->m_CentralDifferenceGradientFilter->SetInput( this->m_MovingImage );
+      this->m_CentralDifferenceGradientFilter->Update();
+      this->m_GradientImage = this->m_CentralDifferenceGradientFilter->GetOutput();
+    }
+    else
+    {
+      this->m_CentralDifferenceGradientFilter = 0;
+      this->m_GradientImage                   = 0;
+    }
+  }
+
+} // end CheckForBSplineInterpolator()
+
+
+/**
+ * ****************** ComputeMovingImageGradientCache **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMovingImageGradientCache( void )
+{
+  std::vector< double >().swap( this->m_MovingImageGradientCoefficients );
+  if( !this->m_CacheMovingImageGradient || this->GetComputeGradient() )
+  {
+    return;
+  }
+
+  /** The cache is built from the padded B-spline coefficients, of a
+   * B-spline interpolator with a continuous gradient.
+   */
+  if( this->m_PaddedBSplineCoefficientsSplineOrder < 2 )
+  {
+    itkDebugMacro( "Moving image gradient cache not supported for this interpolator" );
+    return;
+  }
+
+  /** Check the memory budget. */
+  const SizeValueType numberOfCoefficients
+    = this->m_PaddedBSplineCoefficientsOffsetTable[ MovingImageDimension ];
+  const SizeValueType memory
+    = MovingImageDimension * numberOfCoefficients * sizeof( double );
+  if( memory > this->m_MaximumMovingImageGradientCacheSize )
+  {
+    itkDebugMacro( "Moving image gradient cache exceeds the memory budget" );
+    return;
+  }
+  this->m_MovingImageGradientCoefficients.resize( MovingImageDimension * numberOfCoefficients );
+
+  /** Compute the coefficient differences. */
+  if( this->m_UseMultiThread )
+  {
+    this->ExecuteThreaderCallback( this->ComputeMovingImageGradientCacheThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  }
+  else
+  {
+    this->ThreadedComputeMovingImageGradientCache( 0, 1 );
+  }
+
+} // end ComputeMovingImageGradientCache()
+
+
+/**
+ * **************** ComputeMovingImageGradientCacheThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMovingImageGradientCacheThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->st_Metric->ThreadedComputeMovingImageGradientCache( threadID, nrOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeMovingImageGradientCacheThreaderCallback()
+
+
+/**
+ * ****************** ThreadedComputeMovingImageGradientCache **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputeMovingImageGradientCache(
+  ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  const OffsetValueType * offsetTable  = this->m_PaddedBSplineCoefficientsOffsetTable;
+  const double *          coefficients = this->m_PaddedBSplineCoefficients.empty()
+    ? 0 : &this->m_PaddedBSplineCoefficients[ 0 ];
+  const float * coefficientsFloat = this->m_PaddedBSplineCoefficientsFloat.empty()
+    ? 0 : &this->m_PaddedBSplineCoefficientsFloat[ 0 ];
+
+  /** Get the coefficients for this thread. */
+  const SizeValueType numberOfCoefficients = offsetTable[ MovingImageDimension ];
+  const SizeValueType nrOfCoefficientsPerThreads
+    = static_cast< SizeValueType >( vcl_ceil( static_cast< double >( numberOfCoefficients )
+    / static_cast< double >( numberOfThreads ) ) );
+  SizeValueType pos_begin = nrOfCoefficientsPerThreads * threadId;
+  SizeValueType pos_end   = nrOfCoefficientsPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfCoefficients ) ? numberOfCoefficients : pos_begin;
+  pos_end   = ( pos_end > numberOfCoefficients ) ? numberOfCoefficients : pos_end;
+
+  /** Store c[ k ] - c[ k - e_d ] for every dimension d. The first
+   * coefficient in dimension d has no neighbour. Its difference is never
+   * used by EvaluateMovingImageGradientCacheOfOrder(), since the kernel of
+   * order n - 1 only covers the last n of the n + 1 coefficients.
+   */
+  for( SizeValueType offset = pos_begin; offset < pos_end; ++offset )
+  {
+    const double value = coefficients
+      ? coefficients[ offset ] : static_cast< double >( coefficientsFloat[ offset ] );
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      const OffsetValueType paddedSize = offsetTable[ d + 1 ] / offsetTable[ d ];
+      const OffsetValueType index
+        = ( static_cast< OffsetValueType >( offset ) / offsetTable[ d ] ) % paddedSize;
+      double difference = 0.0;
+      if( index > 0 )
+      {
+        const SizeValueType neighbour = offset - offsetTable[ d ];
+        difference = value - ( coefficients
+          ? coefficients[ neighbour ] : static_cast< double >( coefficientsFloat[ neighbour ] ) );
+      }
+      this->m_MovingImageGradientCoefficients[ d * numberOfCoefficients + offset ] = difference;
+    }
+  }
+
+} // end ThreadedComputeMovingImageGradientCache()
+
+
+/**
+ * **************** TransformLineSearchSamplesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformLineSearchSamplesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->st_Metric->ThreadedTransformLineSearchSamples( threadID, nrOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TransformLineSearchSamplesThreaderCallback()
+
+
+/**
+ * ****************** ThreadedTransformLineSearchSamples **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedTransformLineSearchSamples(
+  ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  /** Get the samples for this thread. */
+  const SizeValueType numberOfSamples = this->m_LineSearchFixedPoints.size();
+  const SizeValueType nrOfSamplesPerThreads
+    = static_cast< SizeValueType >( vcl_ceil( static_cast< double >( numberOfSamples )
+    / static_cast< double >( numberOfThreads ) ) );
+  SizeValueType pos_begin = nrOfSamplesPerThreads * threadId;
+  SizeValueType pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfSamples ) ? numberOfSamples : pos_begin;
+  pos_end   = ( pos_end > numberOfSamples ) ? numberOfSamples : pos_end;
+  if( pos_end <= pos_begin )
+  {
+    return;
+  }
+
+  this->m_AdvancedTransform->TransformPoints(
+    &( this->m_LineSearchFixedPoints[ pos_begin ] ), pos_end - pos_begin,
+    &( this->m_LineSearchMappedPoints[ pos_begin ] ) );
+
+} // end ThreadedTransformLineSearchSamples()
+
+
+/**
+ * ****************** EvaluateMovingImageGradientCache **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateMovingImageGradientCache(
+  const MovingImageContinuousIndexType & cindex,
+  MovingImageDerivativeType & gradient ) const
+{
+  switch( this->m_PaddedBSplineCoefficientsSplineOrder )
+  {
+    case 2:
+      this->template EvaluateMovingImageGradientCacheOfOrder< 2 >( cindex, gradient );
+      break;
+    case 3:
+      this->template EvaluateMovingImageGradientCacheOfOrder< 3 >( cindex, gradient );
+      break;
+    case 4:
+      this->template EvaluateMovingImageGradientCacheOfOrder< 4 >( cindex, gradient );
+      break;
+    case 5:
+      this->template EvaluateMovingImageGradientCacheOfOrder< 5 >( cindex, gradient );
+      break;
+    default:
+      itkExceptionMacro( << "The moving image gradient cache does not support spline order "
+                         << this->m_PaddedBSplineCoefficientsSplineOrder );
+  }
+
+} // end EvaluateMovingImageGradientCache()
+
+
+/**
+ * ****************** EvaluateMovingImageGradientCacheOfOrder **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< unsigned int VSplineOrder >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateMovingImageGradientCacheOfOrder(
+  const MovingImageContinuousIndexType & cindex,
+  MovingImageDerivativeType & gradient ) const
+{
+  typedef RecursiveBSplineInterpolationWeights< VSplineOrder >     WeightsType;
+  typedef RecursiveBSplineInterpolationWeights< VSplineOrder - 1 > LowerOrderWeightsType;
+  typedef RecursiveBSplineInterpolateImageFunctionImplementation<
+    MovingImageDimension, VSplineOrder, double >                   ImplementationType;
+  const unsigned int numberOfWeights = MovingImageDimension * ( VSplineOrder + 1 );
+
+  /** Compute the first index of the support region, and the 1D weights,
+   * as EvaluatePaddedBSplineCoefficientsOfOrder() does.
+   */
+  double          u[ MovingImageDimension ];
+  double          weights1D[ numberOfWeights ];
+  OffsetValueType offset = 0;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const OffsetValueType startIndex = Math::Floor< OffsetValueType >(
+      cindex[ d ] - static_cast< double >( VSplineOrder - 1 ) / 2.0 );
+    u[ d ] = cindex[ d ] - static_cast< double >( startIndex );
+    WeightsType::Evaluate( u[ d ], &weights1D[ d * ( VSplineOrder + 1 ) ] );
+    offset += ( startIndex - this->m_PaddedBSplineCoefficientsStartIndex[ d ] )
+      * this->m_PaddedBSplineCoefficientsOffsetTable[ d ];
+  }
+
+  /** The derivative in dimension d is the sum of the differences, weighted
+   * with the kernel of order n - 1 at u - 0.5 in dimension d, and with the
+   * kernel of order n in the other dimensions. The support of the lower
+   * order kernel is the last n of the n + 1 coefficients.
+   */
+  const SizeValueType numberOfCoefficients
+    = this->m_PaddedBSplineCoefficientsOffsetTable[ MovingImageDimension ];
+  const typename MovingImageType::SpacingType & spacing = this->GetMovingImage()->GetSpacing();
+  double derivativeWeights1D[ numberOfWeights ];
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    std::copy( weights1D, weights1D + numberOfWeights, derivativeWeights1D );
+    double * weightsOfDimension = &derivativeWeights1D[ d * ( VSplineOrder + 1 ) ];
+    weightsOfDimension[ 0 ] = 0.0;
+    LowerOrderWeightsType::Evaluate( u[ d ] - 0.5, weightsOfDimension + 1 );
+
+    const double * differences
+      = &this->m_MovingImageGradientCoefficients[ d * numberOfCoefficients + offset ];
+    gradient[ d ] = ImplementationType::Evaluate( differences,
+      this->m_PaddedBSplineCoefficientsOffsetTable, derivativeWeights1D ) / spacing[ d ];
+  }
+
+  /** Convert to the physical gradient, as the interpolator does. */
+  if( this->m_PaddedBSplineCoefficientsUseImageDirection )
+  {
+    const MovingImageDerivativeType derivative = gradient;
+    this->GetMovingImage()->TransformLocalVectorToPhysicalVector( derivative, gradient );
+  }
+
+} // end EvaluateMovingImageGradientCacheOfOrder()
+
+
+/**
+ * *********************** GetMovingImageGradientCacheMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetMovingImageGradientCacheMemoryUsage( void ) const
+{
+  return this->m_MovingImageGradientCoefficients.size() * sizeof( double );
+
+} // end GetMovingImageGradientCacheMemoryUsage()
+
+
+/**
+ * ****************** ComputePaddedBSplineCoefficients **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePaddedBSplineCoefficients( void )
+{
+  /** Release the coefficients of a previous initialization. */
+  std::vector< double >().swap( this->m_PaddedBSplineCoefficients );
+  std::vector< float >().swap( this->m_PaddedBSplineCoefficientsFloat );
+  this->m_PaddedBSplineCoefficientsSplineOrder = 0;
+  if( !this->m_UseRecursiveBSplineInterpolation )
+  {
+    return;
+  }
+
+  /** Only B-spline interpolators of order 1 to 5 are supported. */
+  unsigned int  splineOrder       = 0;
+  bool          useImageDirection = false;
+  SizeValueType coefficientSize   = 0;
+  if( this->m_InterpolatorIsBSpline )
+  {
+    splineOrder       = this->m_BSplineInterpolator->GetSplineOrder();
+    useImageDirection = this->m_BSplineInterpolator->GetUseImageDirection();
+    coefficientSize   = sizeof( double );
+  }
+  else if( this->m_InterpolatorIsBSplineFloat )
+  {
+    splineOrder       = this->m_BSplineInterpolatorFloat->GetSplineOrder();
+    useImageDirection = this->m_BSplineInterpolatorFloat->GetUseImageDirection();
+    coefficientSize   = sizeof( float );
+  }
+  if( splineOrder < 1 || splineOrder > 5 )
+  {
+    itkDebugMacro( "Recursive B-spline interpolation not supported for this interpolator" );
+    return;
+  }
+
+  /** Check the memory budget. */
+  const MovingImageRegionType & region  = this->GetMovingImage()->GetBufferedRegion();
+  const SizeValueType           padding = splineOrder / 2 + 1;
+  SizeValueType                 numberOfCoefficients = 1;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    numberOfCoefficients *= region.GetSize()[ d ] + 2 * padding;
+  }
+  if( numberOfCoefficients * coefficientSize > this->m_MaximumPaddedBSplineCoefficientsSize )
+  {
+    itkDebugMacro( "Padded B-spline coefficients exceed the memory budget" );
+    return;
+  }
+
+  /** Compute the coefficients in the precision of the interpolator. */
+  if( this->m_InterpolatorIsBSpline )
+  {
+    this->template FillPaddedBSplineCoefficients< typename BSplineInterpolatorType::CoefficientFilter >(
+      splineOrder, this->m_PaddedBSplineCoefficients );
+  }
+  else
+  {
+    this->template FillPaddedBSplineCoefficients< typename BSplineInterpolatorFloatType::CoefficientFilter >(
+      splineOrder, this->m_PaddedBSplineCoefficientsFloat );
+  }
+  this->m_PaddedBSplineCoefficientsSplineOrder       = splineOrder;
+  this->m_PaddedBSplineCoefficientsUseImageDirection = useImageDirection;
+
+} // end ComputePaddedBSplineCoefficients()
+
+
+/**
+ * ****************** FillPaddedBSplineCoefficients **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TCoefficientFilter, class TCoefficient >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::FillPaddedBSplineCoefficients( const unsigned int splineOrder,
+  std::vector< TCoefficient > & paddedCoefficients )
+{
+  typedef typename TCoefficientFilter::OutputImageType         CoefficientImageType;
+  typedef ImageFileCache< CoefficientImageType >               CoefficientFileCacheType;
+  typedef BSplineCoefficientImageProvider< CoefficientImageType > CoefficientProviderType;
+
+  /** Take the coefficients that the interpolator computed for the moving
+   * image, if it gives access to them, e.g. the elastix B-spline interpolators.
+   */
+  typename CoefficientImageType::ConstPointer coefficientImage;
+  const CoefficientProviderType * coefficientProvider
+    = dynamic_cast< const CoefficientProviderType * >( this->m_Interpolator.GetPointer() );
+  if( coefficientProvider != 0
+    && this->m_Interpolator->GetInputImage() == this->GetMovingImage() )
+  {
+    coefficientImage = coefficientProvider->GetBSplineCoefficientImage();
+    if( coefficientImage.IsNotNull()
+      && coefficientImage->GetBufferedRegion() != this->GetMovingImage()->GetBufferedRegion() )
+    {
+      coefficientImage = 0;
+    }
+  }
+
+  /** Otherwise take them from the artifact cache, where the interpolator
+   * may have stored them already. For order 1 they are the image itself.
+   */
+  std::string cacheKey;
+  if( coefficientImage.IsNull()
+    && !this->m_ArtifactCacheDirectory.empty() && splineOrder > 1 )
+  {
+    cacheKey = CoefficientFileCacheType::CreateContentKey( this->GetMovingImage(),
+      CoefficientFileCacheType::GetBSplineCoefficientsDescription( splineOrder ) );
+    coefficientImage = CoefficientFileCacheType::LoadWithKey(
+      this->m_ArtifactCacheDirectory, cacheKey );
+  }
+
+  /** Otherwise compute the coefficients as the interpolator does. */
+  if( coefficientImage.IsNull() )
+  {
+    typename TCoefficientFilter::Pointer coefficientFilter = TCoefficientFilter::New();
+    coefficientFilter->SetSplineOrder( splineOrder );
+    coefficientFilter->SetInput( this->GetMovingImage() );
+    coefficientFilter->Update();
+    coefficientImage = coefficientFilter->GetOutput();
+    if( !cacheKey.empty()
+      && !CoefficientFileCacheType::Contains( this->m_ArtifactCacheDirectory, cacheKey ) )
+    {
+      CoefficientFileCacheType::StoreWithKey( this->m_ArtifactCacheDirectory,
+        cacheKey, coefficientFilter->GetOutput() );
+    }
+  }
+
+  const TCoefficient *         coefficients     = coefficientImage->GetBufferPointer();
+  const OffsetValueType *      offsetTable      = coefficientImage->GetOffsetTable();
+  const MovingImageRegionType  region           = coefficientImage->GetBufferedRegion();
+
+  /** The geometry of the padded buffer. The padding covers the support
+   * region of all points that IsInsideBuffer() accepts, i.e. up to half a
+   * voxel outside the image.
+   */
+  const OffsetValueType padding = splineOrder / 2 + 1;
+  OffsetValueType       paddedSize[ MovingImageDimension ];
+  this->m_PaddedBSplineCoefficientsOffsetTable[ 0 ] = 1;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    paddedSize[ d ] = static_cast< OffsetValueType >( region.GetSize()[ d ] ) + 2 * padding;
+    this->m_PaddedBSplineCoefficientsStartIndex[ d ] = region.GetIndex()[ d ] - padding;
+    this->m_PaddedBSplineCoefficientsOffsetTable[ d + 1 ]
+      = this->m_PaddedBSplineCoefficientsOffsetTable[ d ] * paddedSize[ d ];
+  }
+  paddedCoefficients.resize( this->m_PaddedBSplineCoefficientsOffsetTable[ MovingImageDimension ] );
+
+  /** Copy the coefficients, with the mirror boundary condition of the
+   * interpolator for the padding.
+   */
+  OffsetValueType paddedIndex[ MovingImageDimension ];
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    paddedIndex[ d ] = 0;
+  }
+  for( SizeValueType i = 0; i < paddedCoefficients.size(); ++i )
+  {
+    OffsetValueType offset = 0;
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      const OffsetValueType length = static_cast< OffsetValueType >( region.GetSize()[ d ] );
+      OffsetValueType       index  = 0;
+      if( length > 1 )
+      {
+        const OffsetValueType period = 2 * length - 2;
+        index = paddedIndex[ d ] - padding;
+        index = ( index < 0 ? -index : index ) % period;
+        index = ( index < length ) ? index : period - index;
+      }
+      offset += index * offsetTable[ d ];
+    }
+    paddedCoefficients[ i ] = coefficients[ offset ];
+
+    /** Go to the next padded index. */
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      if( ++paddedIndex[ d ] < paddedSize[ d ] )
+      {
+        break;
+      }
+      paddedIndex[ d ] = 0;
+    }
+  }
+
+} // end FillPaddedBSplineCoefficients()
+
+
+/**
+ * ****************** EvaluatePaddedBSplineCoefficients **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluatePaddedBSplineCoefficients(
+  const MovingImageContinuousIndexType & cindex,
+  RealType & movingImageValue,
+  MovingImageDerivativeType * gradient ) const
+{
+  if( !this->m_PaddedBSplineCoefficients.empty() )
+  {
+    const double * coefficients = &this->m_PaddedBSplineCoefficients[ 0 ];
+    switch( this->m_PaddedBSplineCoefficientsSplineOrder )
+    {
+      case 1:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 1 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 2:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 2 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 3:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 3 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 4:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 4 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 5:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 5 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      default:
+        return false;
+    }
+  }
+  else if( !this->m_PaddedBSplineCoefficientsFloat.empty() )
+  {
+    const float * coefficients = &this->m_PaddedBSplineCoefficientsFloat[ 0 ];
+    switch( this->m_PaddedBSplineCoefficientsSplineOrder )
+    {
+      case 1:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 1 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 2:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 2 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 3:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 3 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 4:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 4 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      case 5:
+        this->template EvaluatePaddedBSplineCoefficientsOfOrder< 5 >(
+          coefficients, cindex, movingImageValue, gradient );
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+
+} // end EvaluatePaddedBSplineCoefficients()
+
+
+/**
+ * ****************** EvaluatePaddedBSplineCoefficientsOfOrder **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< unsigned int VSplineOrder, class TCoefficient >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluatePaddedBSplineCoefficientsOfOrder(
+  const TCoefficient * paddedCoefficients,
+  const MovingImageContinuousIndexType & cindex,
+  RealType & movingImageValue,
+  MovingImageDerivativeType * gradient ) const
+{
+  typedef RecursiveBSplineInterpolationWeights< VSplineOrder > WeightsType;
+  typedef RecursiveBSplineInterpolateImageFunctionImplementation<
+    MovingImageDimension, VSplineOrder, TCoefficient >         ImplementationType;
+  const unsigned int numberOfWeights = MovingImageDimension * ( VSplineOrder + 1 );
+
+  /** Compute the first index of the support region, and the 1D weights. */
+  double          u[ MovingImageDimension ];
+  double          weights1D[ numberOfWeights ];
+  OffsetValueType offset = 0;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const OffsetValueType startIndex = Math::Floor< OffsetValueType >(
+      cindex[ d ] - static_cast< double >( VSplineOrder - 1 ) / 2.0 );
+    u[ d ] = cindex[ d ] - static_cast< double >( startIndex );
+    WeightsType::Evaluate( u[ d ], &weights1D[ d * ( VSplineOrder + 1 ) ] );
+    offset += ( startIndex - this->m_PaddedBSplineCoefficientsStartIndex[ d ] )
+      * this->m_PaddedBSplineCoefficientsOffsetTable[ d ];
+  }
+  const TCoefficient * coefficients = paddedCoefficients + offset;
+
+  /** Only the value. */
+  if( !gradient )
+  {
+    movingImageValue = ImplementationType::Evaluate(
+      coefficients, this->m_PaddedBSplineCoefficientsOffsetTable, weights1D );
+    return;
+  }
+
+  /** The value and the derivatives with respect to the continuous index. */
+  double derivativeWeights1D[ numberOfWeights ];
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    WeightsType::EvaluateDerivative( u[ d ], &derivativeWeights1D[ d * ( VSplineOrder + 1 ) ] );
+  }
+  double derivativeAndValue[ MovingImageDimension + 1 ];
+  ImplementationType::EvaluateValueAndDerivative( derivativeAndValue, coefficients,
+    this->m_PaddedBSplineCoefficientsOffsetTable, weights1D, derivativeWeights1D );
+  movingImageValue = derivativeAndValue[ MovingImageDimension ];
+
+  /** Convert to the physical gradient, as the interpolator does. */
+  const typename MovingImageType::SpacingType & spacing = this->GetMovingImage()->GetSpacing();
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    ( *gradient )[ d ] = derivativeAndValue[ d ] / spacing[ d ];
+  }
+  if( this->m_PaddedBSplineCoefficientsUseImageDirection )
+  {
+    const MovingImageDerivativeType derivative = *gradient;
+    this->GetMovingImage()->TransformLocalVectorToPhysicalVector( derivative, *gradient );
+  }
+
+} // end EvaluatePaddedBSplineCoefficientsOfOrder()
+
+
+/**
+ * *********************** GetPaddedBSplineCoefficientsMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetPaddedBSplineCoefficientsMemoryUsage( void ) const
+{
+  return this->m_PaddedBSplineCoefficients.capacity() * sizeof( double )
+         + this->m_PaddedBSplineCoefficientsFloat.capacity() * sizeof( float );
+
+} // end GetPaddedBSplineCoefficientsMemoryUsage()
+
+
+/**
+ * *********************** ReleaseMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ReleaseMemory( void )
+{
+  /** InitializeThreadingParameters() allocates them again. */
+  delete[] this->m_GetValuePerThreadVariables;
+  this->m_GetValuePerThreadVariables     = NULL;
+  this->m_GetValuePerThreadVariablesSize = 0;
+  delete[] this->m_GetValueAndDerivativePerThreadVariables;
+  this->m_GetValueAndDerivativePerThreadVariables     = NULL;
+  this->m_GetValueAndDerivativePerThreadVariablesSize = 0;
+
+  /** Initialize() builds them again. */
+  std::vector< double >().swap( this->m_MovingImageGradientCoefficients );
+  std::vector< double >().swap( this->m_PaddedBSplineCoefficients );
+  std::vector< float >().swap( this->m_PaddedBSplineCoefficientsFloat );
+  this->m_PaddedBSplineCoefficientsSplineOrder = 0;
+
+  /** Only release the Jacobian structure cache if it is ours, and not
+   * built by another metric that shares the transform. */
+  if( this->m_AdvancedTransform.IsNotNull() && this->m_JacobianStructureTransformMTime != 0
+    && this->m_AdvancedTransform->GetJacobianStructureMTime() == this->m_JacobianStructureTransformMTime )
   {
-    this->m_InterpolatorIsLinear = true;
-    this->m_LinearInterpolator   = testPtr4;
+    this->m_AdvancedTransform->ReleaseJacobianStructure();
   }
-  else
+  this->m_UseJacobianStructureCache       = false;
+  this->m_JacobianStructureSamplesMTime   = 0;
+  this->m_JacobianStructureCacheMTime     = 0;
+  this->m_JacobianStructureTransformMTime = 0;
+
+} // end ReleaseMemory()
+
+
+/**
+ * *********************** GetMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetMemoryUsage( void ) const
+{
+  typedef typename TransformJacobianType::element_type TransformJacobianValueType;
+  typedef typename NonZeroJacobianIndicesType::value_type NonZeroJacobianIndexType;
+
+  SizeValueType usage = this->GetMovingImageGradientCacheMemoryUsage()
+    + this->GetPaddedBSplineCoefficientsMemoryUsage()
+    + this->GetJacobianStructureCacheMemoryUsage();
+
+  for( ThreadIdType i = 0; i < this->m_GetValueAndDerivativePerThreadVariablesSize; ++i )
   {
-    this->m_LinearInterpolator = 0;
+    const GetValueAndDerivativePerThreadStruct & variables
+      = this->m_GetValueAndDerivativePerThreadVariables[ i ];
+    usage += ( variables.st_Derivative.Size() + variables.st_ImageJacobian.Size() )
+      * sizeof( DerivativeValueType )
+      + variables.st_TouchedDerivativeBlocks.capacity()
+      + variables.st_TransformJacobian.rows() * variables.st_TransformJacobian.cols()
+      * sizeof( TransformJacobianValueType )
+      + variables.st_NonZeroJacobianIndices.capacity() * sizeof( NonZeroJacobianIndexType );
   }
+  return usage;
 
-  /** Don't overwrite the gradient image if GetComputeGradient() == true.
-   * Otherwise we can use a forward difference derivative, or the derivative
-   * provided by the B-spline interpolator.
-   */
-  if( !this->GetComputeGradient() )
-  {
-    /** In addition, don't compute the moving image gradient for 2D/3D registration,
-     * i.e. whenever the interpolator is a ray cast interpolator.
-     * This is a bit of a hack that does not respect the setting of the boolean
-     * m_ComputeGradient. By doing this, there is no way to ask no gradient
-     * computation at all (to save memory).
-     * The best solution would be to remove everything below this point, and to
-     * override the ComputeGradient() function of ITK by computing a central
-     * difference derivative. This way SetComputeGradient will enable or disable
-     * the gradient computation and let derived classes choose if it needs the
-     * precomputation of the gradient.
-     *
-     * For more details see the post about "2D/3D registration memory issue" in
-     * elastix's mailing list (2 July 2012).
-     */
-    typedef itk::AdvancedRayCastInterpolateImageFunction<
-      MovingImageType, CoordinateRepresentationType >       RayCastInterpolatorType;
-    const bool interpolatorIsRayCast
-      = dynamic_cast< RayCastInterpolatorType * >( this->m_Interpolator.GetPointer() ) != 0;
+} // end GetMemoryUsage()
 
-    if( !this->m_InterpolatorIsBSpline && !this->m_InterpolatorIsBSplineFloat
-      && !this->m_InterpolatorIsReducedBSpline
-      && !this->m_InterpolatorIsLinear
-      && !interpolatorIsRayCast )
-    {
-      this->m_CentralDifferenceGradientFilter = CentralDifferenceGradientFilterType::New();
-      this->m_CentralDifferenceGradientFilter->SetUseImageSpacing( true );
-      this->m_CentralDifferenceGradientFilter->SetInput( this->m_MovingImage );
-      this->m_CentralDifferenceGradientFilter->Update();
-      this->m_GradientImage = this->m_CentralDifferenceGradientFilter->GetOutput();
-    }
-    else
-    {
-      this->m_CentralDifferenceGradientFilter = 0;
-      this->m_GradientImage                   = 0;
-    }
+
+/**
+ * *********************** GetProjectedMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetProjectedMemoryUsage( const NumberOfParametersType numberOfParameters,
+  const SizeValueType itkNotUsed( numberOfSamples ) ) const
+{
+  if( !this->m_UseMultiThread )
+  {
+    return 0;
   }
+  return static_cast< SizeValueType >( this->m_NumberOfThreads )
+         * numberOfParameters * sizeof( DerivativeValueType );
 
-} // end CheckForBSplineInterpolator()
+} // end GetProjectedMemoryUsage()
 
 
 /**
@@ -632,6 +2068,65 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 } // end CheckForBSplineTransform()
 
 
+/**
+ * ****************** InitializeTransformDispatch **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeTransformDispatch( void )
+{
+  this->m_DispatchTransform            = 0;
+  this->m_DispatchCombinationTransform = 0;
+  this->m_DispatchTransformPosition    = -1;
+
+  /** The IsInsideBuffer() of these interpolators is that of ImageFunction. */
+  this->m_InlineIsInsideBuffer = this->m_UseTransformDispatch
+    && ( this->m_InterpolatorIsLinear || this->m_InterpolatorIsBSpline
+    || this->m_InterpolatorIsBSplineFloat );
+  if( this->m_InlineIsInsideBuffer )
+  {
+    this->m_MovingImageBufferStart = this->m_Interpolator->GetStartContinuousIndex();
+    this->m_MovingImageBufferEnd   = this->m_Interpolator->GetEndContinuousIndex();
+  }
+
+  if( !this->m_UseTransformDispatch || this->m_AdvancedTransform.IsNull() )
+  {
+    return;
+  }
+
+  /** Look through a combination transform that adds nothing to its current
+   * transform, or composes it with an initial transform.
+   */
+  const AdvancedTransformType *    transform = this->m_AdvancedTransform.GetPointer();
+  const CombinationTransformType * combination
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  if( combination )
+  {
+    if( combination->GetCurrentTransform() == 0
+      || ( combination->GetInitialTransform() != 0 && !combination->GetUseComposition() ) )
+    {
+      return;
+    }
+    transform = combination->GetCurrentTransform();
+    if( combination->GetInitialTransform() == 0 )
+    {
+      combination = 0;
+    }
+  }
+
+  const int position = TransformDispatchType::Find( transform );
+  if( position >= 0 )
+  {
+    this->m_DispatchTransform            = transform;
+    this->m_DispatchCombinationTransform = combination;
+    this->m_DispatchTransformPosition    = position;
+  }
+
+} // end InitializeTransformDispatch()
+
+
 /**
  * ******************* EvaluateMovingImageValueAndDerivative ******************
  */
@@ -647,13 +2142,41 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Check if mapped point inside image buffer. */
   MovingImageContinuousIndexType cindex;
   this->m_Interpolator->ConvertPointToContinuousIndex( mappedPoint, cindex );
-  bool sampleOk = this->m_Interpolator->IsInsideBuffer( cindex );
+  bool sampleOk = true;
+  if( this->m_InlineIsInsideBuffer )
+  {
+    /** As ImageFunction::IsInsideBuffer(), which also rejects NaN's. */
+    for( unsigned int j = 0; j < MovingImageDimension; ++j )
+    {
+      sampleOk &= ( cindex[ j ] >= this->m_MovingImageBufferStart[ j ]
+        && cindex[ j ] < this->m_MovingImageBufferEnd[ j ] );
+    }
+  }
+  else
+  {
+    sampleOk = this->m_Interpolator->IsInsideBuffer( cindex );
+  }
   if( sampleOk )
   {
     /** Compute value and possibly derivative. */
     if( gradient )
     {
-      if( this->m_InterpolatorIsBSpline && !this->GetComputeGradient() )
+      if( !this->m_MovingImageGradientCoefficients.empty() )
+      {
+        /** Compute the moving image value from the padded coefficients, and
+         * the gradient from the coefficient differences in the cache.
+         */
+        this->EvaluatePaddedBSplineCoefficients( cindex, movingImageValue, 0 );
+        this->EvaluateMovingImageGradientCache( cindex, *gradient );
+      }
+      else if( !this->GetComputeGradient()
+        && this->EvaluatePaddedBSplineCoefficients( cindex, movingImageValue, gradient ) )
+      {
+        /** The moving image value and gradient are computed by the recursive
+         * B-spline evaluator from the padded coefficients.
+         */
+      }
+      else if( this->m_InterpolatorIsBSpline && !this->GetComputeGradient() )
       {
         /** Compute moving image value and gradient using the B-spline kernel. */
         this->m_BSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
@@ -668,10 +2191,8 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
       else if( this->m_InterpolatorIsReducedBSpline && !this->GetComputeGradient() )
       {
         /** Compute moving image value and gradient using the B-spline kernel. */
-        movingImageValue = this->m_Interpolator->EvaluateAtContinuousIndex( cindex );
-        ( *gradient )    = this->m_ReducedBSplineInterpolator->EvaluateDerivativeAtContinuousIndex( cindex );
-        //this->m_ReducedBSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
-        //  cindex, movingImageValue, *gradient );
+        this->m_ReducedBSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+          cindex, movingImageValue, *gradient );
       }
       else if( this->m_InterpolatorIsLinear && !this->GetComputeGradient() )
       {
@@ -733,7 +2254,7 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
         }
       } // end if m_UseMovingImageDerivativeScales
     } // end if gradient
-    else
+    else if( !this->EvaluatePaddedBSplineCoefficients( cindex, movingImageValue, 0 ) )
     {
       movingImageValue = this->m_Interpolator->EvaluateAtContinuousIndex( cindex );
     }
@@ -804,50 +2325,338 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     }
   }
 
-} // end EvaluateTransformJacobianInnerProduct()
+} // end EvaluateTransformJacobianInnerProduct()
+
+
+/**
+ * ********************** TransformPoint ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPoint(
+  const FixedImagePointType & fixedImagePoint,
+  MovingImagePointType & mappedPoint ) const
+{
+  if( this->m_DispatchTransform == 0 )
+  {
+    mappedPoint = this->m_Transform->TransformPoint( fixedImagePoint );
+  }
+  else if( this->m_DispatchCombinationTransform == 0 )
+  {
+    mappedPoint = TransformDispatchType::TransformPoint( this->m_DispatchTransformPosition,
+      this->m_DispatchTransform, fixedImagePoint );
+  }
+  else
+  {
+    mappedPoint = TransformDispatchType::TransformPoint( this->m_DispatchTransformPosition,
+      this->m_DispatchTransform,
+      this->m_DispatchCombinationTransform->TransformPointWithInitialTransform( fixedImagePoint ) );
+  }
+
+  /** For future use: return whether the sample is valid */
+  const bool valid = true;
+  return valid;
+
+} // end TransformPoint()
+
+
+/**
+ * *************** EvaluateTransformJacobian ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateTransformJacobian(
+  const FixedImagePointType & fixedImagePoint,
+  TransformJacobianType & jacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Advanced transform: generic sparse Jacobian support */
+  this->m_AdvancedTransform->GetJacobian(
+    fixedImagePoint, jacobian, nzji );
+
+  /** For future use: return whether the sample is valid */
+  const bool valid = true;
+  return valid;
+
+} // end EvaluateTransformJacobian()
+
+
+/**
+ * ********************** TransformPoint ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPoint(
+  const SizeValueType sampleIndex,
+  const FixedImagePointType & fixedImagePoint,
+  MovingImagePointType & mappedPoint ) const
+{
+  if( this->m_SharedTransformEvaluationCache )
+  {
+    mappedPoint = this->m_SharedTransformEvaluationCache->GetMappedPoint( sampleIndex );
+    return true;
+  }
+  if( this->m_LineSearchTransformCacheIsValid
+    && sampleIndex < this->m_LineSearchFixedPoints.size()
+    && this->m_LineSearchFixedPoints[ sampleIndex ] == fixedImagePoint )
+  {
+    mappedPoint = this->m_LineSearchMappedPoints[ sampleIndex ]
+      + this->m_LineSearchDisplacements[ sampleIndex ] * this->m_LineSearchStepLength;
+    return true;
+  }
+  return this->TransformPoint( fixedImagePoint, mappedPoint );
+
+} // end TransformPoint()
+
+
+/**
+ * ********************** TransformPoints ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPoints(
+  const SizeValueType firstSampleIndex,
+  const SizeValueType numberOfPoints,
+  const FixedImagePointType * fixedImagePoints,
+  MovingImagePointType * mappedPoints ) const
+{
+  if( !this->m_SharedTransformEvaluationCache
+    && !this->m_LineSearchTransformCacheIsValid
+    && this->m_DispatchTransform == 0 )
+  {
+    this->m_AdvancedTransform->TransformPoints( fixedImagePoints, numberOfPoints, mappedPoints );
+    return;
+  }
+
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    this->TransformPoint( firstSampleIndex + i, fixedImagePoints[ i ], mappedPoints[ i ] );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************** BeginLineSearch ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::BeginLineSearch( const TransformParametersType & position,
+  const TransformParametersType & direction )
+{
+  this->EndLineSearch();
+
+  /** Check if the cache is used and applies. */
+  if( !this->m_UseLineSearchTransformCache
+    || !this->m_SupportsSharedTransformEvaluationCache
+    || !this->m_UseImageSampler || !this->GetImageSampler()
+    || this->m_AdvancedTransform.IsNull()
+    || !this->m_AdvancedTransform->GetIsLinearInParameters()
+    || position.GetSize() != this->m_AdvancedTransform->GetNumberOfParameters()
+    || direction.GetSize() != position.GetSize() )
+  {
+    return;
+  }
+  const double squaredMagnitude = direction.squared_magnitude();
+  if( !( squaredMagnitude > 0.0 ) )
+  {
+    return;
+  }
+
+  /** Copy the fixed points of the current samples. */
+  this->GetImageSampler()->Update();
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  const SizeValueType              numberOfSamples = sampleContainer->Size();
+  this->m_LineSearchFixedPoints.resize( numberOfSamples );
+  this->m_LineSearchMappedPoints.resize( numberOfSamples );
+  this->m_LineSearchDisplacements.resize( numberOfSamples );
+  for( SizeValueType k = 0; k < numberOfSamples; ++k )
+  {
+    this->m_LineSearchFixedPoints[ k ] = sampleContainer->ElementAt( k ).m_ImageCoordinates;
+  }
+
+  /** Map the samples at p0 + d and at p0. The transform is given copies of
+   * the parameters, because some transforms keep a pointer to them.
+   */
+  TraceEventScope traceScope( "BeginLineSearch", "metric" );
+  const TransformParametersType currentParameters = this->m_Transform->GetParameters();
+  TransformParametersType       endPosition       = position;
+  endPosition += direction;
+  for( unsigned int pass = 0; pass < 2; ++pass )
+  {
+    this->m_Transform->SetParametersByValue( pass == 0 ? endPosition : position );
+    if( this->m_UseMultiThread )
+    {
+      this->ExecuteThreaderCallback( this->TransformLineSearchSamplesThreaderCallback,
+        const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+    }
+    else
+    {
+      this->ThreadedTransformLineSearchSamples( 0, 1 );
+    }
+
+    /** Keep the end points as displacements, and subtract the start points. */
+    for( SizeValueType k = 0; k < numberOfSamples; ++k )
+    {
+      if( pass == 0 )
+      {
+        this->m_LineSearchDisplacements[ k ] = this->m_LineSearchMappedPoints[ k ].GetVectorFromOrigin();
+      }
+      else
+      {
+        this->m_LineSearchDisplacements[ k ] -= this->m_LineSearchMappedPoints[ k ].GetVectorFromOrigin();
+      }
+    }
+  }
+  this->m_Transform->SetParametersByValue( currentParameters );
+
+  this->m_LineSearchPosition                  = position;
+  this->m_LineSearchDirection                 = direction;
+  this->m_LineSearchDirectionSquaredMagnitude = squaredMagnitude;
+
+} // end BeginLineSearch()
+
+
+/**
+ * ********************** EndLineSearch ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EndLineSearch( void )
+{
+  this->m_LineSearchTransformCacheIsValid = false;
+  this->m_LineSearchStepLength            = 0.0;
+  std::vector< FixedImagePointType >().swap( this->m_LineSearchFixedPoints );
+  std::vector< MovingImagePointType >().swap( this->m_LineSearchMappedPoints );
+  std::vector< MovingImageVectorType >().swap( this->m_LineSearchDisplacements );
+  this->m_LineSearchPosition.SetSize( 0 );
+  this->m_LineSearchDirection.SetSize( 0 );
+
+} // end EndLineSearch()
+
+
+/**
+ * ********************** SetTransformParameters ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SetTransformParameters( const TransformParametersType & parameters ) const
+{
+  this->Superclass::SetTransformParameters( parameters );
+
+  /** Find the step length a of p = p0 + a*d, and check that p is on the
+   * line, up to the rounding of the line search.
+   */
+  this->m_LineSearchTransformCacheIsValid = false;
+  const SizeValueType numberOfParameters = this->m_LineSearchPosition.GetSize();
+  if( this->m_LineSearchFixedPoints.empty() || parameters.GetSize() != numberOfParameters )
+  {
+    return;
+  }
+  const TransformParametersType & p0 = this->m_LineSearchPosition;
+  const TransformParametersType & d  = this->m_LineSearchDirection;
+  double                          dot = 0.0;
+  for( SizeValueType i = 0; i < numberOfParameters; ++i )
+  {
+    dot += ( parameters[ i ] - p0[ i ] ) * d[ i ];
+  }
+  const double stepLength = dot / this->m_LineSearchDirectionSquaredMagnitude;
+  for( SizeValueType i = 0; i < numberOfParameters; ++i )
+  {
+    const double step      = stepLength * d[ i ];
+    const double tolerance = 1e-10 * ( vcl_abs( p0[ i ] ) + vcl_abs( step ) );
+    if( vcl_abs( parameters[ i ] - p0[ i ] - step ) > tolerance )
+    {
+      return;
+    }
+  }
+  this->m_LineSearchStepLength            = stepLength;
+  this->m_LineSearchTransformCacheIsValid = true;
+
+} // end SetTransformParameters()
 
 
 /**
- * ********************** TransformPoint ************************
+ * *************** EvaluateTransformJacobian ****************
  */
 
 template< class TFixedImage, class TMovingImage >
 bool
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::TransformPoint(
+::EvaluateTransformJacobian(
+  const SizeValueType sampleIndex,
   const FixedImagePointType & fixedImagePoint,
-  MovingImagePointType & mappedPoint ) const
+  TransformJacobianType & jacobian,
+  NonZeroJacobianIndicesType & nzji ) const
 {
-  mappedPoint = this->m_Transform->TransformPoint( fixedImagePoint );
-
-  /** For future use: return whether the sample is valid */
-  const bool valid = true;
-  return valid;
+  if( this->m_SharedTransformEvaluationCache
+    && this->m_SharedTransformEvaluationCache->GetHasJacobians() )
+  {
+    jacobian.set_size( MovingImageDimension, nzji.size() );
+    this->m_SharedTransformEvaluationCache->GetJacobian( sampleIndex, jacobian, nzji );
+    return true;
+  }
+  return this->EvaluateTransformJacobian( fixedImagePoint, jacobian, nzji );
 
-} // end TransformPoint()
+} // end EvaluateTransformJacobian()
 
 
 /**
- * *************** EvaluateTransformJacobian ****************
+ * *************** EvaluateTransformJacobianWithImageGradientProduct ****************
  */
 
 template< class TFixedImage, class TMovingImage >
-bool
+void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::EvaluateTransformJacobian(
+::EvaluateTransformJacobianWithImageGradientProduct(
+  const SizeValueType sampleIndex,
   const FixedImagePointType & fixedImagePoint,
-  TransformJacobianType & jacobian,
+  const MovingImageDerivativeType & movingImageDerivative,
+  DerivativeType & imageJacobian,
   NonZeroJacobianIndicesType & nzji ) const
 {
-  /** Advanced transform: generic sparse Jacobian support */
-  this->m_AdvancedTransform->GetJacobian(
-    fixedImagePoint, jacobian, nzji );
-
-  /** For future use: return whether the sample is valid */
-  const bool valid = true;
-  return valid;
+  if( this->m_SharedTransformEvaluationCache
+    && this->m_SharedTransformEvaluationCache->GetHasJacobians() )
+  {
+    this->m_SharedTransformEvaluationCache->EvaluateJacobianWithImageGradientProduct(
+      sampleIndex, movingImageDerivative, imageJacobian, nzji );
+  }
+  else if( this->m_UseJacobianStructureCache )
+  {
+    this->m_AdvancedTransform->EvaluateCachedJacobianWithImageGradientProduct(
+      sampleIndex, fixedImagePoint, movingImageDerivative, imageJacobian, nzji );
+  }
+  else if( this->m_DispatchTransform == 0 )
+  {
+    this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+      fixedImagePoint, movingImageDerivative, imageJacobian, nzji );
+  }
+  else
+  {
+    /** With composition, the parameters are those of the current transform,
+     * evaluated at the point mapped by the initial transform. */
+    TransformDispatchType::EvaluateJacobianWithImageGradientProduct(
+      this->m_DispatchTransformPosition, this->m_DispatchTransform,
+      this->m_DispatchCombinationTransform == 0 ? fixedImagePoint
+      : this->m_DispatchCombinationTransform->TransformPointWithInitialTransform( fixedImagePoint ),
+      movingImageDerivative, imageJacobian, nzji );
+  }
 
-} // end EvaluateTransformJacobian()
+} // end EvaluateTransformJacobianWithImageGradientProduct()
 
 
 /**
@@ -859,6 +2668,12 @@ bool
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::IsInsideMovingMask( const MovingImagePointType & point ) const
 {
+  /** If a compiled mask is available, use it. */
+  if( this->m_CompiledMovingImageMask.IsNotNull() )
+  {
+    return this->m_CompiledMovingImageMask->IsInside( point );
+  }
+
   /** If a mask has been set: */
   if( this->m_MovingImageMask.IsNotNull() )
   {
@@ -871,6 +2686,37 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 } // end IsInsideMovingMask()
 
 
+/**
+ * ************************** InitializeMovingImageMask *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeMovingImageMask( void )
+{
+  /** Other kinds of spatial objects are queried directly. */
+  const MovingImageMaskSpatialObjectType * mask
+    = dynamic_cast< const MovingImageMaskSpatialObjectType * >(
+    this->m_MovingImageMask.GetPointer() );
+  if( mask == 0 )
+  {
+    this->m_CompiledMovingImageMask = 0;
+    return;
+  }
+
+  if( this->m_CompiledMovingImageMask.IsNull() )
+  {
+    this->m_CompiledMovingImageMask = CompiledMovingImageMaskType::New();
+  }
+  if( !this->m_CompiledMovingImageMask->IsUpToDate( mask ) )
+  {
+    this->m_CompiledMovingImageMask->Compile( mask );
+  }
+
+} // end InitializeMovingImageMask()
+
+
 /**
  * *********************** GetSelfHessian ***********************
  */
@@ -897,6 +2743,41 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetSelfHessian()
 
 
+/**
+ * *********************** GetSelfHessianBlocks ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetSelfHessianBlocks(
+  const TransformParametersType & itkNotUsed( parameters ),
+  const unsigned int blockSize, SelfHessianBlocksType & blocks ) const
+{
+  itkDebugMacro( "GetSelfHessianBlocks()" );
+
+  const NumberOfParametersType numberOfParameters = this->GetNumberOfParameters();
+  if( blockSize == 0 || numberOfParameters % blockSize != 0 )
+  {
+    itkExceptionMacro( << "ERROR: the self Hessian block size " << blockSize
+                       << " does not divide the number of parameters " << numberOfParameters );
+  }
+
+  /** Set identity blocks as default implementation. */
+  const SizeValueType numberOfBlocks = numberOfParameters / blockSize;
+  blocks.SetSize( numberOfParameters * blockSize );
+  blocks.Fill( 0.0 );
+  for( SizeValueType b = 0; b < numberOfBlocks; ++b )
+  {
+    for( unsigned int k = 0; k < blockSize; ++k )
+    {
+      blocks[ ( b * blockSize + k ) * blockSize + k ] = 1.0;
+    }
+  }
+
+} // end GetSelfHessianBlocks()
+
+
 /**
  * *********************** BeforeThreadedGetValueAndDerivative ***********************
  */
@@ -909,16 +2790,143 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** In this function do all stuff that cannot be multi-threaded. */
   if( this->m_UseMetricSingleThreaded )
   {
+    this->TuneNumberOfThreads();
     this->SetTransformParameters( parameters );
     if( this->m_UseImageSampler )
     {
       this->GetImageSampler()->Update();
     }
   }
+  else
+  {
+    /** The caller already did the preparations below with
+     * UseMetricSingleThreaded on, possibly followed by those of other
+     * metrics, and may now evaluate several metrics concurrently. Only
+     * check whether the Jacobian structure cache in the shared transform
+     * is still ours, which is read-only.
+     */
+    this->m_UseJacobianStructureCache = this->m_UseJacobianStructureCache
+      && this->m_AdvancedTransform->GetJacobianStructureMTime() == this->m_JacobianStructureTransformMTime;
+    return;
+  }
+
+  /** Convert the samples to a structure of arrays, which is not thread-safe. */
+  this->m_SampleArrays = 0;
+  if( this->m_UseSampleArrays && this->m_UseImageSampler )
+  {
+    this->m_SampleArrays = this->GetImageSampler()->GetSampleArrays();
+  }
+
+  /** Get the importance weights of the samples, if the sampler has them. */
+  this->m_SampleWeights = 0;
+  if( this->m_UseImageSampler && !this->GetImageSampler()->GetSampleWeights().empty() )
+  {
+    if( !this->m_SupportsSampleWeights )
+    {
+      itkExceptionMacro( << "ERROR: the image sampler provides sample weights, "
+                         << "which are not supported by this metric." );
+    }
+    this->m_SampleWeights = &( this->GetImageSampler()->GetSampleWeights()[ 0 ] );
+  }
+
+  /** Build the transform Jacobian structure cache, which is not thread-safe. */
+  this->UpdateJacobianStructureCache();
 
 } // end BeforeThreadedGetValueAndDerivative()
 
 
+/**
+ * *********************** UpdateJacobianStructureCache ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateJacobianStructureCache( void ) const
+{
+  this->m_UseJacobianStructureCache = false;
+  if( !this->m_CacheTransformJacobianStructure || !this->m_SupportsTransformJacobianStructureCache
+    || !this->m_UseImageSampler || this->m_AdvancedTransform.IsNull() )
+  {
+    return;
+  }
+
+  /** The multi-threaded derivative path with the nonzero Jacobian indices
+   * descriptor does not read the cache, so do not build it then.
+   */
+  if( this->m_UseMultiThread && this->m_UseNonZeroJacobianIndicesDescriptor
+    && !this->m_UseAtomicDerivativeAccumulation )
+  {
+    return;
+  }
+
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const ModifiedTimeType      samplesMTime    = sampleContainer->GetMTime();
+
+  /** Only cache samples that did not change since the previous iteration,
+   * so that no time is wasted when new samples are selected every iteration.
+   */
+  if( samplesMTime != this->m_JacobianStructureSamplesMTime )
+  {
+    this->m_JacobianStructureSamplesMTime = samplesMTime;
+    return;
+  }
+
+  /** Build the cache once for these samples. When the memory budget is
+   * exceeded, the transform does not build it and the cache stays off.
+   */
+  if( samplesMTime != this->m_JacobianStructureCacheMTime )
+  {
+    this->m_JacobianStructureCacheMTime = samplesMTime;
+
+    const unsigned long                sampleContainerSize = sampleContainer->Size();
+    std::vector< FixedImagePointType > points( sampleContainerSize );
+    typename ImageSampleContainerType::ConstIterator fiter;
+    typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
+    unsigned long                                    i      = 0;
+    for( fiter = fbegin; fiter != fend; ++fiter, ++i )
+    {
+      points[ i ] = ( *fiter ).Value().m_ImageCoordinates;
+    }
+
+    this->m_JacobianStructureTransformMTime = 0;
+    if( sampleContainerSize > 0
+      && this->m_AdvancedTransform->PrecomputeJacobianStructure(
+      &( points[ 0 ] ), sampleContainerSize, this->m_MaximumJacobianStructureCacheSize ) )
+    {
+      this->m_JacobianStructureTransformMTime
+        = this->m_AdvancedTransform->GetJacobianStructureMTime();
+    }
+  }
+
+  /** The cache may have been released by a grid change, or replaced by
+   * another metric that shares the transform.
+   */
+  this->m_UseJacobianStructureCache = this->m_JacobianStructureTransformMTime != 0
+    && this->m_AdvancedTransform->GetJacobianStructureMTime() == this->m_JacobianStructureTransformMTime;
+
+} // end UpdateJacobianStructureCache()
+
+
+/**
+ * *********************** GetJacobianStructureCacheMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetJacobianStructureCacheMemoryUsage( void ) const
+{
+  if( !this->m_UseJacobianStructureCache )
+  {
+    return 0;
+  }
+  return this->m_AdvancedTransform->GetJacobianStructureMemoryUsage();
+
+} // end GetJacobianStructureCacheMemoryUsage()
+
+
 /**
  * **************** GetValueThreaderCallback *******
  */
@@ -934,6 +2942,8 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   MultiThreaderParameterType * temp
     = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
 
+  TraceEventScope traceScope( "ThreadedGetValue", "metric", threadID + 1 );
+  HardwareCounterScope counterScope( "ThreadedGetValue", threadID + 1 );
   temp->st_Metric->ThreadedGetValue( threadID );
 
   return ITK_THREAD_RETURN_VALUE;
@@ -950,12 +2960,9 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-
   /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  this->ExecuteThreaderCallback( this->GetValueThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
 
 } // end LaunchGetValueThreaderCallback()
 
@@ -975,6 +2982,8 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   MultiThreaderParameterType * temp
     = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
 
+  TraceEventScope traceScope( "ThreadedGetValueAndDerivative", "metric", threadID + 1 );
+  HardwareCounterScope counterScope( "ThreadedGetValueAndDerivative", threadID + 1 );
   temp->st_Metric->ThreadedGetValueAndDerivative( threadID );
 
   return ITK_THREAD_RETURN_VALUE;
@@ -991,16 +3000,175 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueAndDerivativeThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueAndDerivativeThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-
   /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  this->ExecuteThreaderCallback( this->GetValueAndDerivativeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
 
 } // end LaunchGetValueAndDerivativeThreaderCallback()
 
 
+/**
+ *********** ExecuteThreaderCallback *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ExecuteThreaderCallback( ThreadFunctionType callback, void * userData ) const
+{
+  /** A cancelled registration starts no new threaded evaluations; the
+   * evaluations that are running finish. */
+  if( RegistrationMonitor::IsActiveCancelRequested() )
+  {
+    ProcessAborted excp( __FILE__, __LINE__ );
+    excp.SetDescription( "The registration was cancelled." );
+    throw excp;
+  }
+
+  /** The launch, including the wait for the slowest thread. */
+  TraceEventScope traceScope( "ExecuteThreaderCallback", "metric" );
+
+  if( this->m_UseThreadPool && this->m_ThreadPool.IsNotNull() )
+  {
+    /** The workers of the pool are reused between calls. */
+    this->m_ThreadPool->SingleMethodExecute( callback, userData, this->m_NumberOfThreads );
+  }
+  else
+  {
+    /** Setup threader and launch. */
+    this->m_Threader->SetSingleMethod( callback, userData );
+    this->m_Threader->SingleMethodExecute();
+  }
+
+} // end ExecuteThreaderCallback()
+
+
+/**
+ *********** SplitFixedImageRegionForThread *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SplitFixedImageRegionForThread( const FixedImageRegionType & fullRegion,
+  const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+  FixedImageRegionType & region ) const
+{
+  region = fullRegion;
+
+  /** Find the outermost axis of more than one voxel. */
+  int splitAxis = FixedImageDimension - 1;
+  while( splitAxis > 0 && region.GetSize()[ splitAxis ] <= 1 )
+  {
+    --splitAxis;
+  }
+
+  /** Give every thread an equal number of slices. */
+  const SizeValueType range     = region.GetSize()[ splitAxis ];
+  const SizeValueType chunkSize = ( range + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType begin     = vnl_math_min( range, threadId * chunkSize );
+  const SizeValueType end       = vnl_math_min( range, begin + chunkSize );
+
+  region.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + static_cast< OffsetValueType >( begin ) );
+  region.SetSize( splitAxis, end - begin );
+
+  return end > begin;
+
+} // end SplitFixedImageRegionForThread()
+
+
+/**
+ *********** GetUseDistributedEvaluation *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetUseDistributedEvaluation( void ) const
+{
+  return this->m_SupportsDistributedEvaluation
+         && DistributedEvaluation::GetNumberOfProcesses() > 1;
+
+} // end GetUseDistributedEvaluation()
+
+
+/**
+ *********** GetProcessSampleRange *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetProcessSampleRange( const unsigned long n,
+  unsigned long & begin, unsigned long & end ) const
+{
+  if( !this->GetUseDistributedEvaluation() )
+  {
+    begin = 0;
+    end   = n;
+    return;
+  }
+
+  SizeValueType processBegin = 0;
+  SizeValueType processEnd   = 0;
+  DistributedEvaluation::GetPartition( n, processBegin, processEnd );
+  begin = static_cast< unsigned long >( processBegin );
+  end   = static_cast< unsigned long >( processEnd );
+
+} // end GetProcessSampleRange()
+
+
+/**
+ *********** SumOverProcesses *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SumOverProcesses( SizeValueType & numberOfPixelsCounted ) const
+{
+  if( this->GetUseDistributedEvaluation() )
+  {
+    DistributedEvaluation::AllReduceSum( numberOfPixelsCounted );
+  }
+
+} // end SumOverProcesses()
+
+
+/**
+ *********** SumOverProcesses *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SumOverProcesses( MeasureType & value, DerivativeType * derivative ) const
+{
+  if( !this->GetUseDistributedEvaluation() )
+  {
+    return;
+  }
+
+  /** One reduction for the value and the derivative together. */
+  const SizeValueType   numberOfDerivatives = derivative ? derivative->GetSize() : 0;
+  std::vector< double > buffer( numberOfDerivatives + 1 );
+  buffer[ 0 ] = static_cast< double >( value );
+  for( SizeValueType i = 0; i < numberOfDerivatives; ++i )
+  {
+    buffer[ i + 1 ] = static_cast< double >( ( *derivative )[ i ] );
+  }
+
+  DistributedEvaluation::AllReduceSum( &buffer[ 0 ], numberOfDerivatives + 1 );
+
+  value = static_cast< MeasureType >( buffer[ 0 ] );
+  for( SizeValueType i = 0; i < numberOfDerivatives; ++i )
+  {
+    ( *derivative )[ i ] = static_cast< DerivativeValueType >( buffer[ i + 1 ] );
+  }
+
+} // end SumOverProcesses()
+
+
 /**
  *********** AccumulateDerivativesThreaderCallback *************
  */
@@ -1016,31 +3184,92 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 
   MultiThreaderParameterType * temp
     = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  Self * metric = temp->st_Metric;
+
+  TraceEventScope traceScope( "AccumulateDerivatives", "metric", threadID + 1 );
+  HardwareCounterScope counterScope( "AccumulateDerivatives", threadID + 1 );
 
-  const unsigned int numPar  = temp->st_Metric->GetNumberOfParameters();
-  const unsigned int subSize = static_cast< unsigned int >(
-    vcl_ceil( static_cast< double >( numPar )
+  /** With the sparse accumulation the blocks are those of the touched flags,
+   * otherwise they are chosen to fit in the L1 cache. The parameters are
+   * split between the threads at block boundaries, so that every block, and
+   * every touched flag, is owned by a single thread.
+   */
+  const bool         sparse    = metric->m_UseSparseDerivativeAccumulation;
+  const unsigned int blockSize = sparse ? ( 1u << DerivativeBlockSizeLog2 ) : 1024;
+  const unsigned int numPar    = metric->GetNumberOfParameters();
+  const unsigned int numBlocks = ( numPar + blockSize - 1 ) / blockSize;
+  const unsigned int subSize   = blockSize * static_cast< unsigned int >(
+    vcl_ceil( static_cast< double >( numBlocks )
     / static_cast< double >( nrOfThreads ) ) );
-  const unsigned int jmin = threadID * subSize;
-  unsigned int       jmax = ( threadID + 1 ) * subSize;
+  unsigned int jmin = threadID * subSize;
+  unsigned int jmax = ( threadID + 1 ) * subSize;
+  jmin = ( jmin > numPar ) ? numPar : jmin;
   jmax = ( jmax > numPar ) ? numPar : jmax;
 
   /** This thread accumulates all sub-derivatives into a single one, for the
    * range [ jmin, jmax [. Additionally, the sub-derivatives are reset.
+   *
+   * Within a block the sub-derivatives are added one thread at a time, so
+   * that only two arrays are streamed at once, instead of one per thread,
+   * which defeats the hardware prefetchers for large numbers of threads.
+   * With the sparse accumulation, the blocks that a thread did not touch
+   * contain only zeros and are skipped.
    */
   const DerivativeValueType zero          = NumericTraits< DerivativeValueType >::Zero;
   const DerivativeValueType normalization = 1.0 / temp->st_NormalizationFactor;
-  for( unsigned int j = jmin; j < jmax; ++j )
+  DerivativeValueType *     derivative    = temp->st_DerivativePointer;
+  for( unsigned int jb = jmin; jb < jmax; jb += blockSize )
   {
-    DerivativeValueType tmp = zero;
+    const unsigned int je = ( jb + blockSize < jmax ) ? jb + blockSize : jmax;
+    for( unsigned int j = jb; j < je; ++j )
+    {
+      derivative[ j ] = zero;
+    }
+
+    bool touched = false;
     for( ThreadIdType i = 0; i < nrOfThreads; ++i )
     {
-      tmp += temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative[ j ];
+      if( sparse )
+      {
+        unsigned char & flag
+          = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_TouchedDerivativeBlocks[ jb / blockSize ];
+        if( !flag )
+        {
+#ifndef NDEBUG
+          /** A thread that wrote to this block without marking it, i.e.
+           * without calling MarkTouchedDerivativeBlocks(), would silently
+           * lose its contributions here. */
+          const DerivativeValueType * untouched
+            = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.data_block();
+          for( unsigned int j = jb; j < je; ++j )
+          {
+            itkAssertInDebugAndIgnoreInReleaseMacro( untouched[ j ] == zero );
+          }
+#endif
+          continue;
+        }
+        flag = 0;
+      }
+      touched = true;
 
-      /** Reset this variable for the next iteration. */
-      temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative[ j ] = zero;
+      DerivativeValueType * subDerivative
+        = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.data_block();
+      for( unsigned int j = jb; j < je; ++j )
+      {
+        derivative[ j ] += subDerivative[ j ];
+
+        /** Reset this variable for the next iteration. */
+        subDerivative[ j ] = zero;
+      }
+    }
+
+    if( touched )
+    {
+      for( unsigned int j = jb; j < je; ++j )
+      {
+        derivative[ j ] *= normalization;
+      }
     }
-    temp->st_DerivativePointer[ j ] = tmp * normalization;
   }
 
   return ITK_THREAD_RETURN_VALUE;
@@ -1145,6 +3374,28 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
      << this->m_UseMovingImageDerivativeScales << std::endl;
   os << indent.GetNextIndent() << "MovingImageDerivativeScales: "
      << this->m_MovingImageDerivativeScales << std::endl;
+  os << indent.GetNextIndent() << "UseThreadPool: "
+     << this->m_UseThreadPool << std::endl;
+  os << indent.GetNextIndent() << "ThreadPool: "
+     << this->m_ThreadPool.GetPointer() << std::endl;
+  os << indent.GetNextIndent() << "UseNUMAAwareThreading: "
+     << this->m_UseNUMAAwareThreading << std::endl;
+  os << indent.GetNextIndent() << "AutomaticNumberOfThreads: "
+     << this->m_AutomaticNumberOfThreads << std::endl;
+  os << indent.GetNextIndent() << "NumberOfThreadsTuningEvaluations: "
+     << this->m_NumberOfThreadsTuningEvaluations << std::endl;
+  os << indent.GetNextIndent() << "UseSampleArrays: "
+     << this->m_UseSampleArrays << std::endl;
+  os << indent.GetNextIndent() << "CacheTransformJacobianStructure: "
+     << this->m_CacheTransformJacobianStructure << std::endl;
+  os << indent.GetNextIndent() << "MaximumJacobianStructureCacheSize: "
+     << this->m_MaximumJacobianStructureCacheSize << std::endl;
+  os << indent.GetNextIndent() << "CacheMovingImageGradient: "
+     << this->m_CacheMovingImageGradient << std::endl;
+  os << indent.GetNextIndent() << "MaximumMovingImageGradientCacheSize: "
+     << this->m_MaximumMovingImageGradientCacheSize << std::endl;
+  os << indent.GetNextIndent() << "UseLineSearchTransformCache: "
+     << this->m_UseLineSearchTransformCache << std::endl;
 
 } // end PrintSelf()
 
@@ -0,0 +1,166 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageExtremaCache.h"
+#include "itkMutexLockHolder.h"
+
+namespace itk
+{
+
+// static instance
+ImageExtremaCache::Pointer ImageExtremaCache::m_Instance = 0;
+
+/**
+ * **************** Constructor *****************************
+ */
+
+ImageExtremaCache
+::ImageExtremaCache()
+{
+  this->m_MaximumNumberOfEntries = 64;
+  this->m_Age                    = 0;
+  this->m_NumberOfHits           = 0;
+  this->m_NumberOfMisses         = 0;
+
+} // end Constructor
+
+
+/**
+ * **************** GetInstance *****************************
+ */
+
+ImageExtremaCache::Pointer
+ImageExtremaCache
+::GetInstance( void )
+{
+  if( !ImageExtremaCache::m_Instance )
+  {
+    ImageExtremaCache::m_Instance = ImageExtremaCache::New();
+  }
+  return ImageExtremaCache::m_Instance;
+
+} // end GetInstance()
+
+
+/**
+ * **************** KeyType::operator< *****************************
+ */
+
+bool
+ImageExtremaCache::KeyType
+::operator<( const KeyType & other ) const
+{
+  if( this->m_Image != other.m_Image ) { return this->m_Image < other.m_Image; }
+  if( this->m_ImageMTime != other.m_ImageMTime ) { return this->m_ImageMTime < other.m_ImageMTime; }
+  if( this->m_Mask != other.m_Mask ) { return this->m_Mask < other.m_Mask; }
+  if( this->m_MaskMTime != other.m_MaskMTime ) { return this->m_MaskMTime < other.m_MaskMTime; }
+  return this->m_Region < other.m_Region;
+
+} // end KeyType::operator<()
+
+
+/**
+ * **************** GetExtrema *****************************
+ */
+
+bool
+ImageExtremaCache
+::GetExtrema( const KeyType & key, double & minimum, double & maximum ) const
+{
+  MutexLockHolder< SimpleFastMutexLock > holder( this->m_Mutex );
+
+  EntryContainerType::const_iterator it = this->m_Entries.find( key );
+  if( it == this->m_Entries.end() )
+  {
+    ++this->m_NumberOfMisses;
+    return false;
+  }
+
+  ++this->m_NumberOfHits;
+  minimum = it->second.m_Minimum;
+  maximum = it->second.m_Maximum;
+  return true;
+
+} // end GetExtrema()
+
+
+/**
+ * **************** SetExtrema *****************************
+ */
+
+void
+ImageExtremaCache
+::SetExtrema( const KeyType & key, const double minimum, const double maximum )
+{
+  MutexLockHolder< SimpleFastMutexLock > holder( this->m_Mutex );
+
+  /** Make room by removing the oldest entry. The cache is small, so a
+   * linear search is fine. */
+  if( this->m_Entries.find( key ) == this->m_Entries.end()
+    && this->m_Entries.size() >= this->m_MaximumNumberOfEntries
+    && !this->m_Entries.empty() )
+  {
+    EntryContainerType::iterator oldest = this->m_Entries.begin();
+    for( EntryContainerType::iterator it = this->m_Entries.begin(); it != this->m_Entries.end(); ++it )
+    {
+      if( it->second.m_Age < oldest->second.m_Age ) { oldest = it; }
+    }
+    this->m_Entries.erase( oldest );
+  }
+
+  EntryType & entry = this->m_Entries[ key ];
+  entry.m_Minimum = minimum;
+  entry.m_Maximum = maximum;
+  entry.m_Age     = this->m_Age++;
+
+} // end SetExtrema()
+
+
+/**
+ * **************** Clear *****************************
+ */
+
+void
+ImageExtremaCache
+::Clear( void )
+{
+  MutexLockHolder< SimpleFastMutexLock > holder( this->m_Mutex );
+  this->m_Entries.clear();
+
+} // end Clear()
+
+
+/**
+ * **************** PrintSelf *****************************
+ */
+
+void
+ImageExtremaCache
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfEntries: " << this->m_Entries.size() << std::endl;
+  os << indent << "MaximumNumberOfEntries: " << this->m_MaximumNumberOfEntries << std::endl;
+  os << indent << "NumberOfHits: " << this->m_NumberOfHits << std::endl;
+  os << indent << "NumberOfMisses: " << this->m_NumberOfMisses << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
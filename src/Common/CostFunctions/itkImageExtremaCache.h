@@ -0,0 +1,153 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageExtremaCache_h
+#define __itkImageExtremaCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <map>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageExtremaCache
+ *
+ * \brief Process-wide store of the gray value extrema of images.
+ *
+ * The metrics compute the minimum and maximum of the fixed and moving image,
+ * inside their masks, for the limiters and the histogram ranges. With several
+ * metrics on the same images, and at every resolution with the same images,
+ * these scans would be repeated. This cache stores the extrema per image,
+ * mask and region. The modified times of the image and the mask are part of
+ * the key, so a modified image or mask is scanned again, and a new image at
+ * the address of a deleted one is never mistaken for it.
+ *
+ * The cache is shared by all metrics and may be used from several threads.
+ *
+ * \ingroup RegistrationMetrics
+ */
+
+class ImageExtremaCache : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageExtremaCache          Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageExtremaCache, Object );
+
+  /** Get the cache that is shared by all metrics. */
+  static Pointer GetInstance( void );
+
+  /** The key of an entry: the image, the mask and the region. The region is
+   * stored as its index followed by its size. */
+  struct KeyType
+  {
+    const void *                   m_Image;
+    ModifiedTimeType               m_ImageMTime;
+    const void *                   m_Mask;
+    ModifiedTimeType               m_MaskMTime;
+    std::vector< OffsetValueType > m_Region;
+
+    bool operator<( const KeyType & other ) const;
+  };
+
+  /** Make a key for an image, an optional mask and a region of the image. */
+  template< class TImage, class TMask >
+  static KeyType MakeKey( const TImage * image, const TMask * mask,
+    const typename TImage::RegionType & region )
+  {
+    KeyType key;
+    key.m_Image      = image;
+    key.m_ImageMTime = image->GetMTime();
+    key.m_Mask       = mask;
+    key.m_MaskMTime  = mask ? mask->GetMTime() : 0;
+    for( unsigned int d = 0; d < TImage::ImageDimension; ++d )
+    {
+      key.m_Region.push_back( region.GetIndex()[ d ] );
+    }
+    for( unsigned int d = 0; d < TImage::ImageDimension; ++d )
+    {
+      key.m_Region.push_back( static_cast< OffsetValueType >( region.GetSize()[ d ] ) );
+    }
+    return key;
+  }
+
+  /** Get the extrema of a key; returns false if they are not in the cache. */
+  bool GetExtrema( const KeyType & key, double & minimum, double & maximum ) const;
+
+  /** Store the extrema of a key. */
+  void SetExtrema( const KeyType & key, const double minimum, const double maximum );
+
+  /** Remove all entries. */
+  void Clear( void );
+
+  /** The maximum number of entries; the oldest entries are removed when more
+   * are stored. Default: 64. */
+  itkSetMacro( MaximumNumberOfEntries, SizeValueType );
+  itkGetConstMacro( MaximumNumberOfEntries, SizeValueType );
+
+  /** Statistics. */
+  itkGetConstMacro( NumberOfHits, SizeValueType );
+  itkGetConstMacro( NumberOfMisses, SizeValueType );
+
+protected:
+
+  ImageExtremaCache();
+  virtual ~ImageExtremaCache() {}
+
+  /** PrintSelf. */
+  virtual void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  ImageExtremaCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );    // purposely not implemented
+
+  struct EntryType
+  {
+    double        m_Minimum;
+    double        m_Maximum;
+    SizeValueType m_Age;
+  };
+  typedef std::map< KeyType, EntryType > EntryContainerType;
+
+  static Pointer m_Instance;
+
+  EntryContainerType            m_Entries;
+  SizeValueType                 m_MaximumNumberOfEntries;
+  SizeValueType                 m_Age;
+  mutable SizeValueType         m_NumberOfHits;
+  mutable SizeValueType         m_NumberOfMisses;
+  mutable SimpleFastMutexLock   m_Mutex;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageExtremaCache_h
@@ -40,6 +40,14 @@ namespace itk
  *
  * \brief Implements a metric base class that takes multiple inputs.
  *
+ * Subclasses that need the values of all moving images at a mapped point
+ * can call EvaluateMovingImageValuesAndDerivatives(). When all moving images
+ * share their geometry and are interpolated by B-spline interpolators of
+ * the same order, at most 3, the B-spline coefficients of all moving images
+ * are packed, interleaved per voxel, into one buffer in Initialize(). The
+ * B-spline weights are then computed once per mapped point, and all
+ * channels are gathered in one pass over the support. Otherwise, or with
+ * UseFusedMovingImageEvaluation off, every interpolator is called in turn.
  *
  * \ingroup RegistrationMetrics
  *
@@ -282,6 +290,15 @@ public:
   /** A function to check if all moving image interpolators are of type B-spline. */
   itkGetConstMacro( InterpolatorsAreBSpline, bool );
 
+  /** Set/Get whether the moving images are evaluated together, when possible.
+   * Default: true.
+   */
+  itkSetMacro( UseFusedMovingImageEvaluation, bool );
+  itkGetConstMacro( UseFusedMovingImageEvaluation, bool );
+
+  /** Whether Initialize() packed the moving images for fused evaluation. */
+  itkGetConstMacro( MovingImagesAreFused, bool );
+
   /** ******************** FixedImageInterpolators ********************
    * These interpolators are used for the fixed images.
    */
@@ -330,6 +347,9 @@ protected:
   typedef typename Superclass::MovingImageIndexType           MovingImageIndexType;
   typedef typename Superclass::MovingImageDerivativeType      MovingImageDerivativeType;
   typedef typename Superclass::MovingImageContinuousIndexType MovingImageContinuousIndexType;
+  typedef typename Superclass::MovingImageRegionType          MovingImageRegionType;
+  typedef typename Superclass::ImageSampleContainerType       ImageSampleContainerType;
+  typedef typename Superclass::ImageSampleContainerPointer    ImageSampleContainerPointer;
 
   /** Typedef's for the moving image interpolators. */
   typedef typename Superclass::BSplineInterpolatorType BSplineInterpolatorType;
@@ -352,6 +372,29 @@ protected:
     RealType & movingImageValue,
     MovingImageDerivativeType * gradient ) const;
 
+  /** Compute the values, and if gradients is not null the gradients, of all
+   * moving images at mappedPoint. The arrays should have one element per
+   * moving image. Returns false if the point is outside the moving images.
+   */
+  virtual bool EvaluateMovingImageValuesAndDerivatives(
+    const MovingImagePointType & mappedPoint,
+    RealType * values,
+    MovingImageDerivativeType * gradients ) const;
+
+  /** Pack the B-spline coefficients of the moving images, if they can be
+   * evaluated together; called by Initialize.
+   */
+  virtual void InitializeFusedMovingImages( void );
+
+  /** Evaluate the fixed images at all samples of the image sampler and store
+   * them in m_FixedFeatureValues: element j of sample i, i counted in the
+   * sample container, is at i * #fixed images + j. Image 0 is taken from the
+   * sample itself. The values are only recomputed when the sampler output
+   * was regenerated, so without new samples every iteration this is done
+   * once per resolution.
+   */
+  virtual void UpdateFixedFeatureValues( void ) const;
+
   /** IsInsideMovingMask: Returns the AND of all moving image masks. */
   virtual bool IsInsideMovingMask(
     const MovingImagePointType & mappedPoint ) const;
@@ -368,6 +411,21 @@ protected:
   bool                          m_InterpolatorsAreBSpline;
   BSplineInterpolatorVectorType m_BSplineInterpolatorVector;
 
+  /** The packed B-spline coefficients: element c of voxel i, counted in
+   * the buffered region of the moving images, is at i * #moving images + c.
+   */
+  bool                  m_UseFusedMovingImageEvaluation;
+  bool                  m_MovingImagesAreFused;
+  unsigned int          m_FusedSplineOrder;
+  std::vector< double > m_FusedCoefficients;
+
+  /** The fixed image values at the samples, and the sampler output they
+   * were computed for.
+   */
+  mutable std::vector< double >            m_FixedFeatureValues;
+  mutable const ImageSampleContainerType * m_FixedFeatureValuesSamples;
+  mutable ModifiedTimeType                 m_FixedFeatureValuesMTime;
+
 private:
 
   MultiInputImageToImageMetricBase( const Self & ); // purposely not implemented
@@ -19,6 +19,10 @@
 #define _itkMultiInputImageToImageMetricBase_hxx
 
 #include "itkMultiInputImageToImageMetricBase.h"
+#include "itkBSplineDecompositionImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include <algorithm>
+#include <cmath>
 
 /** Macros to reduce some copy-paste work.
  * These macros provide the implementation of
@@ -118,6 +122,13 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
 
   this->m_InterpolatorsAreBSpline = false;
 
+  this->m_UseFusedMovingImageEvaluation = true;
+  this->m_MovingImagesAreFused          = false;
+  this->m_FusedSplineOrder              = 0;
+
+  this->m_FixedFeatureValuesSamples = 0;
+  this->m_FixedFeatureValuesMTime   = 0;
+
 }   // end Constructor()
 
 
@@ -249,9 +260,154 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
   /** Call the superclass' implementation. */
   this->Superclass::Initialize();
 
+  /** Pack the moving images, if they can be evaluated together. */
+  this->InitializeFusedMovingImages();
+
+  /** The fixed images may have changed. */
+  this->m_FixedFeatureValues.clear();
+  this->m_FixedFeatureValuesSamples = 0;
+  this->m_FixedFeatureValuesMTime   = 0;
+
 }   // end Initialize()
 
 
+/**
+ * ****************** InitializeFusedMovingImages **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::InitializeFusedMovingImages( void )
+{
+  this->m_MovingImagesAreFused = false;
+  this->m_FusedCoefficients.clear();
+
+  /** The fused evaluation gives the same results as the B-spline
+   * interpolators, without gradient images and derivative scales.
+   */
+  const unsigned int numberOfChannels = this->GetNumberOfMovingImages();
+  if( !this->m_UseFusedMovingImageEvaluation || !this->m_InterpolatorsAreBSpline
+    || numberOfChannels < 2 || this->GetNumberOfInterpolators() != numberOfChannels
+    || this->GetComputeGradient() || this->m_UseMovingImageDerivativeScales )
+  {
+    return;
+  }
+
+  /** All moving images should share their geometry and spline order. */
+  const MovingImageType *    image0      = this->m_MovingImageVector[ 0 ];
+  const unsigned int         splineOrder = this->m_BSplineInterpolatorVector[ 0 ]->GetSplineOrder();
+  const MovingImageRegionType region     = image0->GetBufferedRegion();
+  if( splineOrder > 3 || region != image0->GetLargestPossibleRegion() )
+  {
+    return;
+  }
+  for( unsigned int c = 1; c < numberOfChannels; ++c )
+  {
+    const MovingImageType * image = this->m_MovingImageVector[ c ];
+    if( this->m_BSplineInterpolatorVector[ c ]->GetSplineOrder() != splineOrder
+      || this->m_BSplineInterpolatorVector[ c ]->GetUseImageDirection()
+      != this->m_BSplineInterpolatorVector[ 0 ]->GetUseImageDirection()
+      || image->GetBufferedRegion() != region
+      || image->GetLargestPossibleRegion() != region
+      || image->GetOrigin() != image0->GetOrigin()
+      || image->GetSpacing() != image0->GetSpacing()
+      || image->GetDirection() != image0->GetDirection() )
+    {
+      return;
+    }
+  }
+
+  /** Compute the coefficients, like the interpolators do, and interleave them. */
+  typedef Image< double, MovingImageDimension >                           CoefficientImageType;
+  typedef BSplineDecompositionImageFilter< MovingImageType, CoefficientImageType > DecompositionFilterType;
+
+  try
+  {
+    this->m_FusedCoefficients.resize( region.GetNumberOfPixels() * numberOfChannels );
+  }
+  catch( std::bad_alloc & )
+  {
+    itkWarningMacro( << "Not enough memory to evaluate the moving images together." );
+    this->m_FusedCoefficients.clear();
+    return;
+  }
+
+  for( unsigned int c = 0; c < numberOfChannels; ++c )
+  {
+    SizeValueType offset = c;
+    if( splineOrder < 2 )
+    {
+      /** For orders 0 and 1 the coefficients are the voxel values. */
+      ImageRegionConstIterator< MovingImageType > it( this->m_MovingImageVector[ c ], region );
+      for( it.GoToBegin(); !it.IsAtEnd(); ++it, offset += numberOfChannels )
+      {
+        this->m_FusedCoefficients[ offset ] = static_cast< double >( it.Get() );
+      }
+    }
+    else
+    {
+      typename DecompositionFilterType::Pointer decomposition = DecompositionFilterType::New();
+      decomposition->SetSplineOrder( splineOrder );
+      decomposition->SetInput( this->m_MovingImageVector[ c ] );
+      decomposition->Update();
+
+      ImageRegionConstIterator< CoefficientImageType > it(
+        decomposition->GetOutput(), decomposition->GetOutput()->GetBufferedRegion() );
+      for( it.GoToBegin(); !it.IsAtEnd(); ++it, offset += numberOfChannels )
+      {
+        this->m_FusedCoefficients[ offset ] = it.Get();
+      }
+    }
+  }
+
+  this->m_FusedSplineOrder     = splineOrder;
+  this->m_MovingImagesAreFused = true;
+
+}   // end InitializeFusedMovingImages()
+
+
+/**
+ * ****************** UpdateFixedFeatureValues **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::UpdateFixedFeatureValues( void ) const
+{
+  /** Check if the values are still up-to-date. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned int               numberOfFixed   = this->GetNumberOfFixedImages();
+  const SizeValueType              numberOfValues  = sampleContainer->Size() * numberOfFixed;
+  if( this->m_FixedFeatureValuesSamples == sampleContainer
+    && this->m_FixedFeatureValuesMTime == sampleContainer->GetUpdateMTime()
+    && this->m_FixedFeatureValues.size() == numberOfValues )
+  {
+    return;
+  }
+
+  /** Evaluate the fixed images, one sample at the time. */
+  this->m_FixedFeatureValues.resize( numberOfValues );
+  typename ImageSampleContainerType::ConstIterator fiter  = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
+  SizeValueType                                    offset = 0;
+  for( ; fiter != fend; ++fiter, offset += numberOfFixed )
+  {
+    this->m_FixedFeatureValues[ offset ] = static_cast< double >( ( *fiter ).Value().m_ImageValue );
+    for( unsigned int j = 1; j < numberOfFixed; ++j )
+    {
+      this->m_FixedFeatureValues[ offset + j ] = this->m_FixedImageInterpolatorVector[ j ]
+        ->Evaluate( ( *fiter ).Value().m_ImageCoordinates );
+    }
+  }
+
+  this->m_FixedFeatureValuesSamples = sampleContainer;
+  this->m_FixedFeatureValuesMTime   = sampleContainer->GetUpdateMTime();
+
+}   // end UpdateFixedFeatureValues()
+
+
 /**
  * ********************* InitializeImageSampler ****************************
  */
@@ -320,6 +476,211 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
 }   // end EvaluateMovingImageValueAndDerivative()
 
 
+/**
+ * ******************* EvaluateBSplineKernel ******************
+ *
+ * The centred B-spline of order 0 to 3.
+ */
+
+inline double
+MultiInputEvaluateBSplineKernel( const unsigned int order, const double u )
+{
+  const double absu = std::abs( u );
+  switch( order )
+  {
+    case 0:
+      return ( u >= -0.5 && u < 0.5 ) ? 1.0 : 0.0;
+    case 1:
+      return absu < 1.0 ? 1.0 - absu : 0.0;
+    case 2:
+      if( absu < 0.5 ) { return 0.75 - absu * absu; }
+      if( absu < 1.5 ) { return 0.5 * ( 1.5 - absu ) * ( 1.5 - absu ); }
+      return 0.0;
+    default:
+      if( absu < 1.0 ) { return ( 4.0 - 6.0 * absu * absu + 3.0 * absu * absu * absu ) / 6.0; }
+      if( absu < 2.0 ) { return ( 2.0 - absu ) * ( 2.0 - absu ) * ( 2.0 - absu ) / 6.0; }
+      return 0.0;
+  }
+
+} // end MultiInputEvaluateBSplineKernel()
+
+
+/**
+ * ******************* EvaluateMovingImageValuesAndDerivatives ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::EvaluateMovingImageValuesAndDerivatives(
+  const MovingImagePointType & mappedPoint,
+  RealType * values,
+  MovingImageDerivativeType * gradients ) const
+{
+  const unsigned int numberOfChannels = this->GetNumberOfMovingImages();
+
+  /** Without packed coefficients, call every interpolator in turn. */
+  if( !this->m_MovingImagesAreFused )
+  {
+    if( !this->EvaluateMovingImageValueAndDerivative( mappedPoint, values[ 0 ], gradients ) )
+    {
+      return false;
+    }
+
+    MovingImageContinuousIndexType cindex;
+    for( unsigned int c = 1; c < numberOfChannels; ++c )
+    {
+      this->m_InterpolatorVector[ c ]->ConvertPointToContinuousIndex( mappedPoint, cindex );
+      if( gradients )
+      {
+        this->m_BSplineInterpolatorVector[ c ]->EvaluateValueAndDerivativeAtContinuousIndex(
+          cindex, values[ c ], gradients[ c ] );
+      }
+      else
+      {
+        values[ c ] = this->m_InterpolatorVector[ c ]->EvaluateAtContinuousIndex( cindex );
+      }
+    }
+    return true;
+  }
+
+  /** All moving images share their geometry, so one check suffices. */
+  MovingImageContinuousIndexType cindex;
+  this->m_InterpolatorVector[ 0 ]->ConvertPointToContinuousIndex( mappedPoint, cindex );
+  if( !this->m_InterpolatorVector[ 0 ]->IsInsideBuffer( cindex ) )
+  {
+    return false;
+  }
+
+  /** Compute the 1D weights and the offsets of the support once, with the
+   * mirror boundary conditions of the BSplineInterpolateImageFunction.
+   */
+  const MovingImageType *     image       = this->m_MovingImageVector[ 0 ];
+  const MovingImageRegionType region      = image->GetBufferedRegion();
+  const unsigned int          splineOrder = this->m_FusedSplineOrder;
+  const unsigned int          supportSize = splineOrder + 1;
+
+  double        weights[ MovingImageDimension ][ 4 ];
+  double        derivativeWeights[ MovingImageDimension ][ 4 ];
+  SizeValueType offsets[ MovingImageDimension ][ 4 ];
+  SizeValueType stride = numberOfChannels;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const double x      = cindex[ d ] - region.GetIndex()[ d ];
+    const long   length = static_cast< long >( region.GetSize()[ d ] );
+    const long   first  = ( splineOrder & 1 )
+      ? static_cast< long >( std::floor( x ) ) - static_cast< long >( splineOrder / 2 )
+      : static_cast< long >( std::floor( x + 0.5 ) ) - static_cast< long >( splineOrder / 2 );
+
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      const long   index = first + static_cast< long >( k );
+      const double u     = x - index;
+      weights[ d ][ k ]           = MultiInputEvaluateBSplineKernel( splineOrder, u );
+      derivativeWeights[ d ][ k ] = splineOrder == 0 ? 0.0
+        : MultiInputEvaluateBSplineKernel( splineOrder - 1, u + 0.5 )
+        - MultiInputEvaluateBSplineKernel( splineOrder - 1, u - 0.5 );
+
+      long mirrored = index;
+      if( length == 1 )
+      {
+        mirrored = 0;
+      }
+      else
+      {
+        const long length2 = 2 * length - 2;
+        mirrored = mirrored < 0
+          ? -mirrored - length2 * ( ( -mirrored ) / length2 )
+          : mirrored - length2 * ( mirrored / length2 );
+        if( mirrored >= length )
+        {
+          mirrored = length2 - mirrored;
+        }
+      }
+      offsets[ d ][ k ] = static_cast< SizeValueType >( mirrored ) * stride;
+    }
+    stride *= static_cast< SizeValueType >( length );
+  }
+
+  /** Gather all channels in a single pass over the support. */
+  for( unsigned int c = 0; c < numberOfChannels; ++c )
+  {
+    values[ c ] = NumericTraits< RealType >::Zero;
+    if( gradients ) { gradients[ c ].Fill( 0.0 ); }
+  }
+
+  unsigned int k[ MovingImageDimension ];
+  std::fill( k, k + MovingImageDimension, 0u );
+  const double * coefficients = &( this->m_FusedCoefficients[ 0 ] );
+  bool           done         = false;
+  while( !done )
+  {
+    SizeValueType offset = 0;
+    double        weight = 1.0;
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      offset += offsets[ d ][ k[ d ] ];
+      weight *= weights[ d ][ k[ d ] ];
+    }
+    const double * coefficient = coefficients + offset;
+    for( unsigned int c = 0; c < numberOfChannels; ++c )
+    {
+      values[ c ] += weight * coefficient[ c ];
+    }
+
+    if( gradients )
+    {
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        double derivativeWeight = derivativeWeights[ d ][ k[ d ] ];
+        for( unsigned int e = 0; e < MovingImageDimension; ++e )
+        {
+          if( e != d ) { derivativeWeight *= weights[ e ][ k[ e ] ]; }
+        }
+        for( unsigned int c = 0; c < numberOfChannels; ++c )
+        {
+          gradients[ c ][ d ] += derivativeWeight * coefficient[ c ];
+        }
+      }
+    }
+
+    /** Next point of the support. */
+    done = true;
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      if( ++k[ d ] < supportSize )
+      {
+        done = false;
+        break;
+      }
+      k[ d ] = 0;
+    }
+  }
+
+  /** Convert the gradients to physical space, like the interpolators. */
+  if( gradients )
+  {
+    const bool useImageDirection = this->m_BSplineInterpolatorVector[ 0 ]->GetUseImageDirection();
+    for( unsigned int c = 0; c < numberOfChannels; ++c )
+    {
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        gradients[ c ][ d ] /= image->GetSpacing()[ d ];
+      }
+      if( useImageDirection )
+      {
+        MovingImageDerivativeType orientedGradient;
+        image->TransformLocalVectorToPhysicalVector( gradients[ c ], orientedGradient );
+        gradients[ c ] = orientedGradient;
+      }
+    }
+  }
+
+  return true;
+
+}   // end EvaluateMovingImageValuesAndDerivatives()
+
+
 /**
  * ************************ IsInsideMovingMask *************************
  */
@@ -204,6 +204,8 @@ public:
 
   /** Whether you want to use a finite difference implementation of the metric's derivative.
    * This option should be set before calling Initialize(); Default: false.
+   * When multi-threaded, every thread but the first keeps its own copy of the
+   * incremental pdfs, each of size #parameters * #fixed bins * #moving bins.
    */
   itkSetMacro( UseFiniteDifferenceDerivative, bool );
   itkGetConstMacro( UseFiniteDifferenceDerivative, bool );
@@ -215,6 +217,57 @@ public:
   itkSetMacro( FiniteDifferencePerturbation, double );
   itkGetConstMacro( FiniteDifferencePerturbation, double );
 
+  /** Option to compute the moving image gradient and the sparse image Jacobian
+   * already during the multi-threaded joint histogram computation, and to store
+   * them per sample in a per-thread buffer. Subclasses that make a second pass
+   * over the samples to compute the derivative, can then read this buffer instead
+   * of transforming and interpolating every sample again. The buffer costs
+   * #samples * #nonzero Jacobian indices doubles, so this option is meant for
+   * use with a random sampler. Only used when UseExplicitPDFDerivatives == false.
+   * Default: false.
+   */
+  itkSetMacro( UseFusedPDFAndDerivativePass, bool );
+  itkGetConstMacro( UseFusedPDFAndDerivativePass, bool );
+  itkBooleanMacro( UseFusedPDFAndDerivativePass );
+
+  /** Option to store, for every sample, the start bin and the weights of the
+   * fixed Parzen window. The fixed image values of the samples only change when
+   * the image sampler produces new samples, so with a grid or full sampler, or
+   * without NewSamplesEveryIteration, the fixed Parzen window is then computed
+   * once per resolution, instead of in every iteration. The buffer costs
+   * #samples * ( FixedKernelBSplineOrder + 1 ) doubles. Default: true.
+   */
+  itkSetMacro( UseFixedParzenWindowCache, bool );
+  itkGetConstMacro( UseFixedParzenWindowCache, bool );
+  itkBooleanMacro( UseFixedParzenWindowCache );
+
+  /** Option to store the explicit PDF derivatives sparsely: for every pair of
+   * histogram bins, only the blocks of PDFDerivativeBlockSize consecutive
+   * parameters that are touched by a sample are stored. Every thread builds its
+   * own sparse derivatives, so that the explicit PDF derivatives are computed
+   * multi-threadedly as well. This keeps UseExplicitPDFDerivatives usable for
+   * transforms with many parameters, that are each affected by a small part of
+   * the samples, such as B-spline transforms with a fine grid. Only used when
+   * UseExplicitPDFDerivatives, multi-threading is on, and the subclass
+   * supports it. Default: false.
+   */
+  itkSetMacro( UseSparseJointPDFDerivatives, bool );
+  itkGetConstMacro( UseSparseJointPDFDerivatives, bool );
+  itkBooleanMacro( UseSparseJointPDFDerivatives );
+
+  /** Release the per-thread histograms too. */
+  virtual void ReleaseMemory( void );
+
+  /** Add the joint pdfs and their derivatives to the memory usage. */
+  virtual SizeValueType GetMemoryUsage( void ) const;
+
+  /** Add the joint pdfs and, with UseExplicitPDFDerivatives, the dense joint
+   * pdf derivatives, which take #fixed bins * #moving bins * #parameters floats.
+   */
+  virtual SizeValueType GetProjectedMemoryUsage(
+    const NumberOfParametersType numberOfParameters,
+    const SizeValueType numberOfSamples ) const;
+
 protected:
 
   /** The constructor. */
@@ -240,6 +293,7 @@ protected:
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::CentralDifferenceGradientFilterType CentralDifferenceGradientFilterType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::NumberOfParametersType              NumberOfParametersType;
 
   /** Typedefs for the PDFs and PDF derivatives. */
   typedef double                                       PDFValueType;
@@ -297,6 +351,15 @@ protected:
   KernelFunctionPointer m_MovingKernel;
   KernelFunctionPointer m_DerivativeMovingKernel;
 
+  /** The B-spline orders of the three kernels, set by InitializeKernels().
+   * They allow EvaluateParzenValues() to evaluate the kernels inline, instead
+   * of through the virtual Evaluate(). A negative order stands for a kernel of
+   * another type, which is evaluated through Evaluate().
+   */
+  int m_FixedKernelOrder;
+  int m_MovingKernelOrder;
+  int m_DerivativeMovingKernelOrder;
+
   /** Threading related parameters. */
   mutable std::vector< JointPDFPointer > m_ThreaderJointPDFs;
 
@@ -309,10 +372,45 @@ protected:
   };
   ParzenWindowHistogramMultiThreaderParameterType m_ParzenWindowHistogramThreaderParameters;
 
+  /** The number of consecutive parameters in one block of the sparse joint pdf derivatives. */
+  itkStaticConstMacro( PDFDerivativeBlockSize, unsigned int, 32 );
+
+  /** Sparse joint pdf derivatives, see UseSparseJointPDFDerivatives. For
+   * every pair of bins ( fixed bin * #moving bins + moving bin ) and every
+   * block of parameters, m_BlockIndices holds one plus the index of the block
+   * in m_Blocks, or zero when the block was not touched.
+   */
+  struct SparseJointPDFDerivativesType
+  {
+    std::vector< unsigned int >           m_BlockIndices;
+    std::vector< PDFDerivativeValueType > m_Blocks;
+  };
+
   struct ParzenWindowHistogramGetValueAndDerivativePerThreadStruct
   {
     SizeValueType   st_NumberOfPixelsCounted;
     JointPDFPointer st_JointPDF;
+
+    /** Per sample buffers, filled when m_CacheSampleDerivativeTerms == true.
+     * The image Jacobian and its non-zero indices are stored contiguously,
+     * with a fixed stride of the number of non-zero Jacobian indices.
+     */
+    std::vector< RealType >            st_CachedFixedImageValues;
+    std::vector< RealType >            st_CachedMovingImageValues;
+    std::vector< DerivativeValueType > st_CachedImageJacobians;
+    NonZeroJacobianIndicesType         st_CachedNonZeroJacobianIndices;
+
+    /** The incremental pdfs and perturbed alphas of the finite difference
+     * derivative. Thread 0 uses the member variables instead.
+     */
+    JointPDFDerivativesPointer st_IncrementalJointPDFRight;
+    JointPDFDerivativesPointer st_IncrementalJointPDFLeft;
+    DerivativeType             st_PerturbedAlphaRight;
+    DerivativeType             st_PerturbedAlphaLeft;
+    double                     st_SumOfMovingMaskValues;
+
+    /** The sparse joint pdf derivatives of this thread. */
+    SparseJointPDFDerivativesType st_SparseJointPDFDerivatives;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ParzenWindowHistogramGetValueAndDerivativePerThreadStruct,
     PaddedParzenWindowHistogramGetValueAndDerivativePerThreadStruct );
@@ -324,6 +422,50 @@ protected:
   /** Initialize threading related parameters. */
   virtual void InitializeThreadingParameters( void ) const;
 
+  /** Initialize the per-thread joint histogram of one thread. */
+  virtual void InitializePerThreadVariables( ThreadIdType threadId ) const;
+
+  /** Create the per-thread incremental pdfs of the finite difference derivative,
+   * when they do not exist yet or have a different size.
+   */
+  void InitializeIncrementalPDFsPerThread( void ) const;
+
+  /** When true, ThreadedComputePDFs() also fills the per-thread sample buffers.
+   * Set by subclasses, for the duration of a ComputePDFs() call, when they
+   * support m_UseFusedPDFAndDerivativePass.
+   */
+  mutable bool m_CacheSampleDerivativeTerms;
+
+  /** The fixed Parzen windows of the samples, see UseFixedParzenWindowCache.
+   * For sample i, m_FixedParzenWindowIndices[ i ] is the lowest affected fixed
+   * bin, and the weights are stored contiguously from
+   * m_FixedParzenWindowValues[ i * fixed Parzen window size ] on.
+   */
+  mutable std::vector< OffsetValueType >   m_FixedParzenWindowIndices;
+  mutable std::vector< PDFValueType >      m_FixedParzenWindowValues;
+  mutable const ImageSampleContainerType * m_FixedParzenWindowSamples;
+  mutable ModifiedTimeType                 m_FixedParzenWindowMTime;
+  mutable bool                             m_FixedParzenWindowCacheIsValid;
+
+  /** Fill the fixed Parzen window cache, if enabled and out of date.
+   * Should be called after the image sampler has been updated.
+   */
+  void UpdateFixedParzenWindowCache( void ) const;
+
+  /** Get the fixed Parzen window of a sample. From the cache when it is valid,
+   * otherwise it is computed from the (limited) fixed image value into the
+   * buffer, which should have the size of the fixed Parzen window.
+   */
+  const PDFValueType * GetFixedParzenWindow(
+    const unsigned long sampleIndex, const RealType & fixedImageValue,
+    OffsetValueType & fixedParzenWindowIndex,
+    ParzenValueContainerType & buffer ) const;
+
+  /** Compute the fixed Parzen window of a fixed image value. */
+  void ComputeFixedParzenWindow( const RealType & fixedImageValue,
+    OffsetValueType & fixedParzenWindowIndex,
+    PDFValueType * fixedParzenValues ) const;
+
   /** Multi-threaded versions of the ComputePDF function. */
   inline void ThreadedComputePDFs( ThreadIdType threadId );
 
@@ -336,6 +478,37 @@ protected:
   /** Helper function to launch the threads. */
   void LaunchComputePDFsThreaderCallback( void ) const;
 
+  /** Compute the contribution of the samples pos_begin up to pos_end to the
+   * joint pdf, the incremental pdfs and the perturbed alphas. Used by
+   * ComputePDFsAndIncrementalPDFs(), single-threaded for all samples, or by
+   * every thread for its own part of the samples and its own histograms.
+   */
+  void ComputePDFsAndIncrementalPDFsOfSamples(
+    const unsigned long pos_begin, const unsigned long pos_end,
+    JointPDFType * jointPDF,
+    JointPDFDerivativesType * incrementalJointPDFRight,
+    JointPDFDerivativesType * incrementalJointPDFLeft,
+    DerivativeType & perturbedAlphaRight,
+    DerivativeType & perturbedAlphaLeft,
+    double & sumOfMovingMaskValues,
+    SizeValueType & numberOfPixelsCounted ) const;
+
+  /** Multi-threaded version of ComputePDFsAndIncrementalPDFs(). */
+  inline void ThreadedComputePDFsAndIncrementalPDFs( ThreadIdType threadId );
+
+  /** Add the histograms of the other threads to those of thread 0. The
+   * incremental pdfs, which are large, are merged multi-threadedly.
+   */
+  void AfterThreadedComputePDFsAndIncrementalPDFs( double & sumOfMovingMaskValues ) const;
+
+  /** Merge a part of the incremental pdfs of all threads. */
+  inline void ThreadedMergeIncrementalPDFs( ThreadIdType threadId );
+
+  /** Helper functions to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputePDFsAndIncrementalPDFsThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE MergeIncrementalPDFsThreaderCallback( void * arg );
+
   /** Compute the Parzen values given an image value and a starting histogram index
    * Compute the values at (parzenWindowIndex - parzenWindowTerm + k) for
    * k = 0 ... kernelsize-1
@@ -347,6 +520,15 @@ protected:
     const KernelFunctionType * kernel,
     ParzenValueContainerType & parzenValues ) const;
 
+  /** Evaluate a BSplineKernelFunction2 or a BSplineDerivativeKernelFunction2
+   * of the given order at the entire support, without a virtual call.
+   */
+  static void EvaluateBSplineKernel( const int order,
+    const KernelFunctionType * kernel, const double u, PDFValueType * values );
+
+  static void EvaluateBSplineDerivativeKernel( const int order,
+    const KernelFunctionType * kernel, const double u, PDFValueType * values );
+
   /** Update the joint PDF with a pixel pair; on demand also updates the
    * pdf derivatives (if the Jacobian pointers are nonzero).
    */
@@ -357,6 +539,18 @@ protected:
     const NonZeroJacobianIndicesType * nzji,
     JointPDFType * jointPDF ) const;
 
+  /** Same as above, but for a fixed Parzen window that is already known.
+   * The pdf derivatives go to sparseJointPDFDerivatives, if given.
+   */
+  void UpdateJointPDFAndDerivatives(
+    const OffsetValueType fixedParzenWindowIndex,
+    const PDFValueType * fixedParzenValues,
+    const RealType & movingImageValue,
+    const DerivativeType * imageJacobian,
+    const NonZeroJacobianIndicesType * nzji,
+    JointPDFType * jointPDF,
+    SparseJointPDFDerivativesType * sparseJointPDFDerivatives = 0 ) const;
+
   /** Update the joint PDF and the incremental pdfs.
    * The input is a pixel pair (fixed, moving, moving mask) and
    * a set of moving image/mask values when using mu+delta*e_k, for
@@ -375,6 +569,22 @@ protected:
     const DerivativeType & movingMaskValuesLeft,
     const NonZeroJacobianIndicesType & nzji ) const;
 
+  /** Same as above, but updates the given histograms and perturbed alphas
+   * instead of the member variables, which makes it thread-safe.
+   */
+  void UpdateJointPDFAndIncrementalPDFs(
+    RealType fixedImageValue, RealType movingImageValue, RealType movingMaskValue,
+    const DerivativeType & movingImageValuesRight,
+    const DerivativeType & movingImageValuesLeft,
+    const DerivativeType & movingMaskValuesRight,
+    const DerivativeType & movingMaskValuesLeft,
+    const NonZeroJacobianIndicesType & nzji,
+    JointPDFType * jointPDF,
+    JointPDFDerivativesType * incrementalJointPDFRight,
+    JointPDFDerivativesType * incrementalJointPDFLeft,
+    DerivativeType & perturbedAlphaRight,
+    DerivativeType & perturbedAlphaLeft ) const;
+
   /** Update the pdf derivatives
    * adds -image_jac[mu]*factor to the bin
    * with index [ mu, pdfIndex[0], pdfIndex[1] ] for all mu.
@@ -385,6 +595,38 @@ protected:
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji ) const;
 
+  /** Same as above, for sparse joint pdf derivatives. New blocks are added
+   * when a parameter of an untouched block is updated.
+   */
+  void UpdateSparseJointPDFDerivatives(
+    SparseJointPDFDerivativesType & sparseJointPDFDerivatives,
+    const JointPDFIndexType & pdfIndex, double factor,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji ) const;
+
+  /** Set by subclasses that can compute their derivative from the sparse
+   * joint pdf derivatives, see AccumulateSparseJointPDFDerivatives().
+   */
+  bool m_SparseJointPDFDerivativesSupported;
+
+  /** Whether ComputePDFsAndPDFDerivatives() computes sparse joint pdf
+   * derivatives, instead of m_JointPDFDerivatives.
+   */
+  bool GetSparseJointPDFDerivativesAreUsed( void ) const;
+
+  /** Compute derivative -= sum_{i,k} weights(i,k) dh(i,k)/dmu, for the sparse
+   * joint pdf derivatives of all threads. The weights are ordered like the
+   * joint pdf buffer, with the moving bins running fastest.
+   */
+  void AccumulateSparseJointPDFDerivatives(
+    const std::vector< double > & weights, DerivativeType & derivative ) const;
+
+  /** Multi-threaded computation of the joint pdf and sparse pdf derivatives. */
+  inline void ThreadedComputePDFsAndSparsePDFDerivatives( ThreadIdType threadId );
+
+  /** Helper function to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputePDFsAndSparsePDFDerivativesThreaderCallback( void * arg );
+
   /** Multiply the pdf entries by the given normalization factor. */
   virtual void NormalizeJointPDF(
     JointPDFType * pdf, const double & factor ) const;
@@ -497,6 +739,9 @@ private:
   bool          m_UseExplicitPDFDerivatives;
   bool          m_UseFiniteDifferenceDerivative;
   double        m_FiniteDifferencePerturbation;
+  bool          m_UseFusedPDFAndDerivativePass;
+  bool          m_UseFixedParzenWindowCache;
+  bool          m_UseSparseJointPDFDerivatives;
 
 };
 
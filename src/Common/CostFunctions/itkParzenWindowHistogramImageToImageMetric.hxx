@@ -25,6 +25,7 @@
 #include "itkImageLinearIteratorWithIndex.h"
 #include "itkImageScanlineIterator.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -54,6 +55,9 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   this->m_FixedKernel                   = 0;
   this->m_MovingKernel                  = 0;
   this->m_DerivativeMovingKernel        = 0;
+  this->m_FixedKernelOrder              = -1;
+  this->m_MovingKernelOrder             = -1;
+  this->m_DerivativeMovingKernelOrder   = -1;
   this->m_FixedKernelBSplineOrder       = 0;
   this->m_MovingKernelBSplineOrder      = 3;
   this->m_FixedParzenTermToIndexOffset  = 0.5;
@@ -67,7 +71,16 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   this->SetUseFixedImageLimiter( true );
   this->SetUseMovingImageLimiter( true );
 
-  this->m_UseExplicitPDFDerivatives = true;
+  this->m_UseExplicitPDFDerivatives    = true;
+  this->m_UseFusedPDFAndDerivativePass = false;
+  this->m_CacheSampleDerivativeTerms   = false;
+
+  this->m_UseFixedParzenWindowCache     = true;
+  this->m_UseSparseJointPDFDerivatives  = false;
+  this->m_SparseJointPDFDerivativesSupported = false;
+  this->m_FixedParzenWindowSamples      = 0;
+  this->m_FixedParzenWindowMTime        = 0;
+  this->m_FixedParzenWindowCacheIsValid = false;
 
   /** Initialize the m_ParzenWindowHistogramThreaderParameters */
   this->m_ParzenWindowHistogramThreaderParameters.m_Metric = this;
@@ -129,6 +142,90 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 } // end PrintSelf()
 
 
+/**
+ * ********************* ReleaseMemory ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ReleaseMemory( void )
+{
+  Superclass::ReleaseMemory();
+
+  delete[] this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables;
+  this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables     = NULL;
+  this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize = 0;
+
+} // end ReleaseMemory()
+
+
+/**
+ * ********************* GetMemoryUsage ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::GetMemoryUsage( void ) const
+{
+  SizeValueType usage = Superclass::GetMemoryUsage()
+    + this->GetImageMemoryUsage( this->m_JointPDF.GetPointer() )
+    + this->GetImageMemoryUsage( this->m_JointPDFDerivatives.GetPointer() )
+    + this->GetImageMemoryUsage( this->m_IncrementalJointPDFRight.GetPointer() )
+    + this->GetImageMemoryUsage( this->m_IncrementalJointPDFLeft.GetPointer() )
+    + this->m_FixedParzenWindowIndices.capacity() * sizeof( OffsetValueType )
+    + this->m_FixedParzenWindowValues.capacity() * sizeof( PDFValueType );
+
+  for( std::size_t i = 0; i < this->m_ThreaderJointPDFs.size(); ++i )
+  {
+    usage += this->GetImageMemoryUsage( this->m_ThreaderJointPDFs[ i ].GetPointer() );
+  }
+
+  for( ThreadIdType i = 0; i < this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize; ++i )
+  {
+    const ParzenWindowHistogramGetValueAndDerivativePerThreadStruct & variables
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ];
+    usage += this->GetImageMemoryUsage( variables.st_JointPDF.GetPointer() )
+      + ( variables.st_CachedFixedImageValues.capacity()
+      + variables.st_CachedMovingImageValues.capacity() ) * sizeof( RealType )
+      + variables.st_CachedImageJacobians.capacity() * sizeof( DerivativeValueType )
+      + variables.st_CachedNonZeroJacobianIndices.capacity()
+      * sizeof( typename NonZeroJacobianIndicesType::value_type )
+      + variables.st_SparseJointPDFDerivatives.m_BlockIndices.capacity() * sizeof( unsigned int )
+      + variables.st_SparseJointPDFDerivatives.m_Blocks.capacity() * sizeof( PDFDerivativeValueType );
+  }
+  return usage;
+
+} // end GetMemoryUsage()
+
+
+/**
+ * ********************* GetProjectedMemoryUsage ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::GetProjectedMemoryUsage( const NumberOfParametersType numberOfParameters,
+  const SizeValueType numberOfSamples ) const
+{
+  const SizeValueType numberOfBins
+    = this->m_NumberOfFixedHistogramBins * this->m_NumberOfMovingHistogramBins;
+  const SizeValueType numberOfJointPDFs
+    = this->m_UseMultiThread ? this->m_NumberOfThreads + 1 : 1;
+
+  SizeValueType usage = Superclass::GetProjectedMemoryUsage( numberOfParameters, numberOfSamples )
+    + numberOfJointPDFs * numberOfBins * sizeof( PDFValueType );
+  if( this->m_UseExplicitPDFDerivatives && !this->m_UseSparseJointPDFDerivatives )
+  {
+    usage += numberOfBins * numberOfParameters * sizeof( PDFDerivativeValueType );
+  }
+  return usage;
+
+} // end GetProjectedMemoryUsage()
+
+
 /**
  * ********************* Initialize *****************************
  */
@@ -147,6 +244,14 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   /** Set up the Parzen windows. */
   this->InitializeKernels();
 
+  /** The bin sizes or the fixed kernel may have changed, so the cached
+   * fixed Parzen windows are no longer valid.
+   */
+  this->m_FixedParzenWindowSamples      = 0;
+  this->m_FixedParzenWindowCacheIsValid = false;
+  this->m_FixedParzenWindowIndices.clear();
+  this->m_FixedParzenWindowValues.clear();
+
   /** If the user plans to use a finite difference derivative,
    * allocate some memory for the perturbed alpha variables.
    */
@@ -329,7 +434,14 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     } // end if this->GetUseFiniteDifferenceDerivative()
     else
     {
-      if( this->m_UseExplicitPDFDerivatives )
+      if( this->GetSparseJointPDFDerivativesAreUsed() )
+      {
+        /** The sparse derivatives are stored per thread. */
+        this->m_IncrementalJointPDFRight = 0;
+        this->m_IncrementalJointPDFLeft  = 0;
+        this->m_JointPDFDerivatives      = 0;
+      }
+      else if( this->m_UseExplicitPDFDerivatives )
       {
         this->m_IncrementalJointPDFRight = 0;
         this->m_IncrementalJointPDFLeft  = 0;
@@ -415,6 +527,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
                          << this->m_MovingKernelBSplineOrder );
   } // end switch MovingKernelBSplineOrder
 
+  /** Remember the orders of the kernels that were created above. */
+  this->m_FixedKernelOrder            = this->m_FixedKernelBSplineOrder;
+  this->m_MovingKernelOrder           = this->m_MovingKernelBSplineOrder;
+  this->m_DerivativeMovingKernelOrder = vnl_math_max( 1, this->m_MovingKernelOrder );
+
   /** The region of support of the Parzen window determines which bins
    * of the joint PDF are effected by the pair of image values.
    * For example, if we are using a cubic spline for the moving image Parzen
@@ -450,9 +567,6 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::InitializeThreadingParameters( void ) const
 {
-  /** Call superclass implementation. */
-  Superclass::InitializeThreadingParameters();
-
   /** Resize and initialize the threading related parameters.
    * The SetSize() functions do not resize the data when this is not
    * needed, which saves valuable re-allocation time.
@@ -460,16 +574,6 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    * which has performance benefits for larger vector sizes.
    */
 
-  /** Construct regions for the joint histograms. */
-  JointPDFRegionType jointPDFRegion;
-  JointPDFIndexType  jointPDFIndex;
-  JointPDFSizeType   jointPDFSize;
-  jointPDFIndex.Fill( 0 );
-  jointPDFSize[ 0 ] = this->m_NumberOfMovingHistogramBins;
-  jointPDFSize[ 1 ] = this->m_NumberOfFixedHistogramBins;
-  jointPDFRegion.SetIndex( jointPDFIndex );
-  jointPDFRegion.SetSize( jointPDFSize );
-
   /** Only resize the array of structs when needed. */
   if( this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize != this->m_NumberOfThreads )
   {
@@ -480,22 +584,92 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize = this->m_NumberOfThreads;
   }
 
-  /** Some initialization. */
+  /** Create the joint pdfs here, the object factory is not used from the threads. */
   for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
   {
-    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
-
-    // Initialize the joint pdf
     JointPDFPointer & jointPDF = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_JointPDF;
     if( jointPDF.IsNull() ) { jointPDF = JointPDFType::New(); }
-    if( jointPDF->GetLargestPossibleRegion() != jointPDFRegion )
+  }
+
+  /** Call superclass implementation, which calls InitializePerThreadVariables()
+   * for every thread, so the array of structs should exist already. */
+  Superclass::InitializeThreadingParameters();
+
+} // end InitializeThreadingParameters()
+
+
+/**
+ * ********************* InitializePerThreadVariables ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::InitializePerThreadVariables( ThreadIdType threadId ) const
+{
+  /** Call superclass implementation. */
+  Superclass::InitializePerThreadVariables( threadId );
+
+  /** Construct regions for the joint histograms. */
+  JointPDFRegionType jointPDFRegion;
+  JointPDFIndexType  jointPDFIndex;
+  JointPDFSizeType   jointPDFSize;
+  jointPDFIndex.Fill( 0 );
+  jointPDFSize[ 0 ] = this->m_NumberOfMovingHistogramBins;
+  jointPDFSize[ 1 ] = this->m_NumberOfFixedHistogramBins;
+  jointPDFRegion.SetIndex( jointPDFIndex );
+  jointPDFRegion.SetSize( jointPDFSize );
+
+  this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+
+  // Initialize the joint pdf
+  JointPDFPointer & jointPDF = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_JointPDF;
+  if( jointPDF->GetLargestPossibleRegion() != jointPDFRegion )
+  {
+    jointPDF->SetRegions( jointPDFRegion );
+    jointPDF->Allocate();
+  }
+
+} // end InitializePerThreadVariables()
+
+
+/**
+ * ********************* InitializeIncrementalPDFsPerThread ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeIncrementalPDFsPerThread( void ) const
+{
+  /** The incremental pdfs are created by InitializeHistograms(), after the
+   * other threading parameters, and thread 0 uses the member variables, see
+   * ThreadedComputePDFsAndIncrementalPDFs(). The object factory is not used
+   * from the threads, so the other copies are created here.
+   */
+  const JointPDFDerivativesRegionType & incrementalPDFRegion
+    = this->m_IncrementalJointPDFRight->GetLargestPossibleRegion();
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ];
+    if( perThread.st_IncrementalJointPDFRight.IsNull() )
     {
-      jointPDF->SetRegions( jointPDFRegion );
-      jointPDF->Allocate();
+      perThread.st_IncrementalJointPDFRight = JointPDFDerivativesType::New();
+      perThread.st_IncrementalJointPDFLeft  = JointPDFDerivativesType::New();
     }
+    if( perThread.st_IncrementalJointPDFRight->GetLargestPossibleRegion() != incrementalPDFRegion )
+    {
+      perThread.st_IncrementalJointPDFRight->SetRegions( incrementalPDFRegion );
+      perThread.st_IncrementalJointPDFRight->Allocate();
+      perThread.st_IncrementalJointPDFLeft->SetRegions( incrementalPDFRegion );
+      perThread.st_IncrementalJointPDFLeft->Allocate();
+    }
+    perThread.st_PerturbedAlphaRight.SetSize( this->GetNumberOfParameters() );
+    perThread.st_PerturbedAlphaLeft.SetSize( this->GetNumberOfParameters() );
   }
 
-} // end InitializeThreadingParameters()
+} // end InitializeIncrementalPDFsPerThread()
 
 
 /**
@@ -548,10 +722,189 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   double parzenWindowTerm, OffsetValueType parzenWindowIndex,
   const KernelFunctionType * kernel, ParzenValueContainerType & parzenValues ) const
 {
-  kernel->Evaluate( static_cast<double>( parzenWindowIndex ) - parzenWindowTerm, parzenValues.data_block() );
+  const double   u      = static_cast< double >( parzenWindowIndex ) - parzenWindowTerm;
+  PDFValueType * values = parzenValues.data_block();
+
+  /** Avoid the virtual call for the kernels created by InitializeKernels(). */
+  if( kernel == this->m_MovingKernel.GetPointer() )
+  {
+    EvaluateBSplineKernel( this->m_MovingKernelOrder, kernel, u, values );
+  }
+  else if( kernel == this->m_DerivativeMovingKernel.GetPointer() )
+  {
+    EvaluateBSplineDerivativeKernel( this->m_DerivativeMovingKernelOrder, kernel, u, values );
+  }
+  else if( kernel == this->m_FixedKernel.GetPointer() )
+  {
+    EvaluateBSplineKernel( this->m_FixedKernelOrder, kernel, u, values );
+  }
+  else
+  {
+    kernel->Evaluate( u, values );
+  }
+
 } // end EvaluateParzenValues()
 
 
+/**
+ * ********************** EvaluateBSplineKernel ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateBSplineKernel( const int order,
+  const KernelFunctionType * kernel, const double u, PDFValueType * values )
+{
+  /** The qualified calls are not virtual, so that they can be inlined. */
+  switch( order )
+  {
+    case 0:
+      static_cast< const BSplineKernelFunction2< 0 > * >( kernel )
+      ->BSplineKernelFunction2< 0 >::Evaluate( u, values ); break;
+    case 1:
+      static_cast< const BSplineKernelFunction2< 1 > * >( kernel )
+      ->BSplineKernelFunction2< 1 >::Evaluate( u, values ); break;
+    case 2:
+      static_cast< const BSplineKernelFunction2< 2 > * >( kernel )
+      ->BSplineKernelFunction2< 2 >::Evaluate( u, values ); break;
+    case 3:
+      static_cast< const BSplineKernelFunction2< 3 > * >( kernel )
+      ->BSplineKernelFunction2< 3 >::Evaluate( u, values ); break;
+    default:
+      kernel->Evaluate( u, values );
+  }
+
+} // end EvaluateBSplineKernel()
+
+
+/**
+ * ********************** EvaluateBSplineDerivativeKernel ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateBSplineDerivativeKernel( const int order,
+  const KernelFunctionType * kernel, const double u, PDFValueType * values )
+{
+  switch( order )
+  {
+    case 1:
+      static_cast< const BSplineDerivativeKernelFunction2< 1 > * >( kernel )
+      ->BSplineDerivativeKernelFunction2< 1 >::Evaluate( u, values ); break;
+    case 2:
+      static_cast< const BSplineDerivativeKernelFunction2< 2 > * >( kernel )
+      ->BSplineDerivativeKernelFunction2< 2 >::Evaluate( u, values ); break;
+    case 3:
+      static_cast< const BSplineDerivativeKernelFunction2< 3 > * >( kernel )
+      ->BSplineDerivativeKernelFunction2< 3 >::Evaluate( u, values ); break;
+    default:
+      kernel->Evaluate( u, values );
+  }
+
+} // end EvaluateBSplineDerivativeKernel()
+
+
+/**
+ * ********************** ComputeFixedParzenWindow ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeFixedParzenWindow( const RealType & fixedImageValue,
+  OffsetValueType & fixedParzenWindowIndex,
+  PDFValueType * fixedParzenValues ) const
+{
+  /** Determine Parzen window arguments (see eq. 6 of Mattes paper [2]). */
+  const double fixedImageParzenWindowTerm
+    = fixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+
+  /** The lowest bin number affected by this pixel. */
+  fixedParzenWindowIndex = static_cast< OffsetValueType >( vcl_floor(
+    fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+
+  /** The Parzen values. */
+  EvaluateBSplineKernel( this->m_FixedKernelOrder, this->m_FixedKernel,
+    static_cast< double >( fixedParzenWindowIndex ) - fixedImageParzenWindowTerm,
+    fixedParzenValues );
+
+} // end ComputeFixedParzenWindow()
+
+
+/**
+ * ********************** UpdateFixedParzenWindowCache ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateFixedParzenWindowCache( void ) const
+{
+  if( !this->m_UseFixedParzenWindowCache )
+  {
+    this->m_FixedParzenWindowCacheIsValid = false;
+    return;
+  }
+
+  /** Check if the cache is still up-to-date. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned long              numberOfSamples = sampleContainer->Size();
+  if( this->m_FixedParzenWindowSamples == sampleContainer
+    && this->m_FixedParzenWindowMTime == sampleContainer->GetUpdateMTime()
+    && this->m_FixedParzenWindowIndices.size() == numberOfSamples )
+  {
+    this->m_FixedParzenWindowCacheIsValid = true;
+    return;
+  }
+
+  /** Compute the fixed Parzen window of every sample. */
+  const unsigned long windowSize = this->m_JointPDFWindow.GetSize()[ 1 ];
+  this->m_FixedParzenWindowIndices.resize( numberOfSamples );
+  this->m_FixedParzenWindowValues.resize( numberOfSamples * windowSize );
+  typename ImageSampleContainerType::ConstIterator fiter = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend  = sampleContainer->End();
+  for( unsigned long i = 0; fiter != fend; ++fiter, ++i )
+  {
+    const RealType fixedImageValue = this->GetFixedImageLimiter()->Evaluate(
+      static_cast< RealType >( ( *fiter ).Value().m_ImageValue ) );
+    this->ComputeFixedParzenWindow( fixedImageValue,
+      this->m_FixedParzenWindowIndices[ i ],
+      &this->m_FixedParzenWindowValues[ i * windowSize ] );
+  }
+
+  this->m_FixedParzenWindowSamples      = sampleContainer;
+  this->m_FixedParzenWindowMTime        = sampleContainer->GetUpdateMTime();
+  this->m_FixedParzenWindowCacheIsValid = true;
+
+} // end UpdateFixedParzenWindowCache()
+
+
+/**
+ * ********************** GetFixedParzenWindow ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+const typename ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >::PDFValueType *
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::GetFixedParzenWindow(
+  const unsigned long sampleIndex, const RealType & fixedImageValue,
+  OffsetValueType & fixedParzenWindowIndex,
+  ParzenValueContainerType & buffer ) const
+{
+  if( this->m_FixedParzenWindowCacheIsValid )
+  {
+    fixedParzenWindowIndex = this->m_FixedParzenWindowIndices[ sampleIndex ];
+    return &this->m_FixedParzenWindowValues[ sampleIndex * buffer.GetSize() ];
+  }
+
+  this->ComputeFixedParzenWindow( fixedImageValue, fixedParzenWindowIndex, buffer.data_block() );
+  return buffer.data_block();
+
+} // end GetFixedParzenWindow()
+
+
 /**
  * ********************** UpdateJointPDFAndDerivatives ***************
  */
@@ -565,29 +918,50 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   const DerivativeType * imageJacobian,
   const NonZeroJacobianIndicesType * nzji,
   JointPDFType * jointPDF ) const
+{
+  /** Compute the fixed Parzen window, and call the function that does the work. */
+  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+  OffsetValueType          fixedImageParzenWindowIndex;
+  this->ComputeFixedParzenWindow( fixedImageValue,
+    fixedImageParzenWindowIndex, fixedParzenValues.data_block() );
+
+  this->UpdateJointPDFAndDerivatives(
+    fixedImageParzenWindowIndex, fixedParzenValues.data_block(),
+    movingImageValue, imageJacobian, nzji, jointPDF );
+
+} // end UpdateJointPDFAndDerivatives()
+
+
+/**
+ * ********************** UpdateJointPDFAndDerivatives ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateJointPDFAndDerivatives(
+  const OffsetValueType fixedImageParzenWindowIndex,
+  const PDFValueType * fixedParzenValues,
+  const RealType & movingImageValue,
+  const DerivativeType * imageJacobian,
+  const NonZeroJacobianIndicesType * nzji,
+  JointPDFType * jointPDF,
+  SparseJointPDFDerivativesType * sparseJointPDFDerivatives ) const
 {
   typedef ImageScanlineIterator< JointPDFType > PDFIteratorType;
 
   /** Determine Parzen window arguments (see eq. 6 of Mattes paper [2]). */
-  const double fixedImageParzenWindowTerm
-    = fixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
   const double movingImageParzenWindowTerm
     = movingImageValue / this->m_MovingImageBinSize - this->m_MovingImageNormalizedMin;
 
-  /** The lowest bin numbers affected by this pixel: */
-  const OffsetValueType fixedImageParzenWindowIndex
-    = static_cast< OffsetValueType >( vcl_floor(
-    fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+  /** The lowest bin number affected by this pixel: */
   const OffsetValueType movingImageParzenWindowIndex
     = static_cast< OffsetValueType >( vcl_floor(
     movingImageParzenWindowTerm + this->m_MovingParzenTermToIndexOffset ) );
 
-  /** The Parzen values. */
-  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+  /** The moving Parzen values. */
+  const unsigned int       fixedWindowSize = this->m_JointPDFWindow.GetSize()[ 1 ];
   ParzenValueContainerType movingParzenValues( this->m_JointPDFWindow.GetSize()[ 0 ] );
-  this->EvaluateParzenValues(
-    fixedImageParzenWindowTerm, fixedImageParzenWindowIndex,
-    this->m_FixedKernel, fixedParzenValues );
   this->EvaluateParzenValues(
     movingImageParzenWindowTerm, movingImageParzenWindowIndex,
     this->m_MovingKernel, movingParzenValues );
@@ -607,7 +981,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   if( !imageJacobian )
   {
     /** Loop over the Parzen window region and increment the values. */
-    for( unsigned int f = 0; f < fixedParzenValues.GetSize(); ++f )
+    for( unsigned int f = 0; f < fixedWindowSize; ++f )
     {
       const double fv = fixedParzenValues[ f ];
       for( unsigned int m = 0; m < movingParzenValues.GetSize(); ++m )
@@ -632,16 +1006,25 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     /** Loop over the Parzen window region and increment the values
      * Also update the pdf derivatives.
      */
-    for( unsigned int f = 0; f < fixedParzenValues.GetSize(); ++f )
+    for( unsigned int f = 0; f < fixedWindowSize; ++f )
     {
       const double fv    = fixedParzenValues[ f ];
       const double fv_et = fv / et;
       for( unsigned int m = 0; m < movingParzenValues.GetSize(); ++m )
       {
         it.Value() += static_cast< PDFValueType >( fv * movingParzenValues[ m ] );
-        this->UpdateJointPDFDerivatives(
-          it.GetIndex(), fv_et * derivativeMovingParzenValues[ m ],
-          *imageJacobian, *nzji );
+        if( sparseJointPDFDerivatives )
+        {
+          this->UpdateSparseJointPDFDerivatives( *sparseJointPDFDerivatives,
+            it.GetIndex(), fv_et * derivativeMovingParzenValues[ m ],
+            *imageJacobian, *nzji );
+        }
+        else
+        {
+          this->UpdateJointPDFDerivatives(
+            it.GetIndex(), fv_et * derivativeMovingParzenValues[ m ],
+            *imageJacobian, *nzji );
+        }
         ++it;
       }
       it.NextLine();
@@ -694,50 +1077,143 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * *********************** NormalizeJointPDF ***********************
+ * *************** UpdateSparseJointPDFDerivatives ***************************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
-::NormalizeJointPDF( JointPDFType * pdf, const double & factor ) const
+::UpdateSparseJointPDFDerivatives(
+  SparseJointPDFDerivativesType & sparseJointPDFDerivatives,
+  const JointPDFIndexType & pdfIndex, double factor,
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesType & nzji ) const
 {
-  typedef ImageScanlineIterator< JointPDFType > JointPDFIteratorType;
-  JointPDFIteratorType it( pdf, pdf->GetBufferedRegion() );
-  const PDFValueType   castfac = static_cast< PDFValueType >( factor );
-  while( !it.IsAtEnd() )
+  const unsigned int  blockSize      = Self::PDFDerivativeBlockSize;
+  const unsigned int  numberOfBlocks = ( this->GetNumberOfParameters() + blockSize - 1 ) / blockSize;
+  const SizeValueType binPair        = pdfIndex[ 1 ] * this->m_NumberOfMovingHistogramBins + pdfIndex[ 0 ];
+  unsigned int *      blockIndices   = &sparseJointPDFDerivatives.m_BlockIndices[ binPair * numberOfBlocks ];
+
+  /** Loop over the non-zero Jacobians, which are sorted for most transforms,
+   * so that consecutive parameters usually fall in the same block.
+   */
+  std::vector< PDFDerivativeValueType > & blocks = sparseJointPDFDerivatives.m_Blocks;
+  for( unsigned int i = 0; i < imageJacobian.GetSize(); ++i )
   {
-    while( !it.IsAtEndOfLine() )
+    const unsigned int mu    = nzji[ i ];
+    const unsigned int block = mu / blockSize;
+    if( blockIndices[ block ] == 0 )
     {
-      it.Value() *= castfac;
-      ++it;
+      blocks.resize( blocks.size() + blockSize, NumericTraits< PDFDerivativeValueType >::ZeroValue() );
+      blockIndices[ block ] = static_cast< unsigned int >( blocks.size() / blockSize );
     }
-    it.NextLine();
+    blocks[ ( blockIndices[ block ] - 1 ) * blockSize + mu % blockSize ]
+      -= static_cast< PDFDerivativeValueType >( imageJacobian[ i ] * factor );
   }
 
-} // end NormalizeJointPDF()
+} // end UpdateSparseJointPDFDerivatives()
 
 
 /**
- * *********************** NormalizeJointPDFDerivatives ***********************
+ * *************** GetSparseJointPDFDerivativesAreUsed ***************************
  */
 
 template< class TFixedImage, class TMovingImage >
-void
+bool
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
-::NormalizeJointPDFDerivatives( JointPDFDerivativesType * pdf, const double & factor ) const
+::GetSparseJointPDFDerivativesAreUsed( void ) const
 {
-  typedef ImageScanlineIterator< JointPDFDerivativesType > JointPDFDerivativesIteratorType;
-  JointPDFDerivativesIteratorType it( pdf, pdf->GetBufferedRegion() );
-  const PDFValueType              castfac = static_cast< PDFValueType >( factor );
-  while( !it.IsAtEnd() )
-  {
-    while( !it.IsAtEndOfLine() )
-    {
-      it.Value() *= castfac;
-      ++it;
+  return this->m_UseSparseJointPDFDerivatives && this->m_SparseJointPDFDerivativesSupported
+         && this->m_UseExplicitPDFDerivatives && this->m_UseMultiThread
+         && this->GetUseDerivative() && !this->GetUseFiniteDifferenceDerivative();
+
+} // end GetSparseJointPDFDerivativesAreUsed()
+
+
+/**
+ * *************** AccumulateSparseJointPDFDerivatives ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulateSparseJointPDFDerivatives(
+  const std::vector< double > & weights, DerivativeType & derivative ) const
+{
+  const unsigned int  blockSize          = Self::PDFDerivativeBlockSize;
+  const unsigned int  numberOfParameters = this->GetNumberOfParameters();
+  const unsigned int  numberOfBlocks     = ( numberOfParameters + blockSize - 1 ) / blockSize;
+  const SizeValueType numberOfBinPairs   = weights.size();
+
+  for( ThreadIdType t = 0; t < this->m_NumberOfThreads; ++t )
+  {
+    const SparseJointPDFDerivativesType & sparseJointPDFDerivatives
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ t ].st_SparseJointPDFDerivatives;
+    const unsigned int *           blockIndices = &sparseJointPDFDerivatives.m_BlockIndices[ 0 ];
+    const PDFDerivativeValueType * blocks       = sparseJointPDFDerivatives.m_Blocks.empty()
+      ? 0 : &sparseJointPDFDerivatives.m_Blocks[ 0 ];
+    if( !blocks ) { continue; }
+
+    for( SizeValueType binPair = 0; binPair < numberOfBinPairs; ++binPair, blockIndices += numberOfBlocks )
+    {
+      const double weight = weights[ binPair ];
+      if( weight == 0.0 ) { continue; }
+
+      for( unsigned int block = 0; block < numberOfBlocks; ++block )
+      {
+        if( blockIndices[ block ] == 0 ) { continue; }
+
+        const PDFDerivativeValueType * blockPtr = blocks + ( blockIndices[ block ] - 1 ) * blockSize;
+        const unsigned int             first    = block * blockSize;
+        const unsigned int             last     = std::min( numberOfParameters, first + blockSize );
+        for( unsigned int mu = first; mu < last; ++mu )
+        {
+          derivative[ mu ] -= blockPtr[ mu - first ] * weight;
+        }
+      }
     }
-    it.NextLine();
+  }
+
+} // end AccumulateSparseJointPDFDerivatives()
+
+
+/**
+ * *********************** NormalizeJointPDF ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::NormalizeJointPDF( JointPDFType * pdf, const double & factor ) const
+{
+  /** Loop over the contiguous buffer, which the compiler can vectorize. */
+  PDFValueType *      pdfPtr         = pdf->GetBufferPointer();
+  const SizeValueType numberOfValues = pdf->GetBufferedRegion().GetNumberOfPixels();
+  const PDFValueType  castfac        = static_cast< PDFValueType >( factor );
+  for( SizeValueType i = 0; i < numberOfValues; ++i )
+  {
+    pdfPtr[ i ] *= castfac;
+  }
+
+} // end NormalizeJointPDF()
+
+
+/**
+ * *********************** NormalizeJointPDFDerivatives ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::NormalizeJointPDFDerivatives( JointPDFDerivativesType * pdf, const double & factor ) const
+{
+  /** Loop over the contiguous buffer, which the compiler can vectorize. */
+  PDFDerivativeValueType *     pdfPtr         = pdf->GetBufferPointer();
+  const SizeValueType          numberOfValues = pdf->GetBufferedRegion().GetNumberOfPixels();
+  const PDFDerivativeValueType castfac        = static_cast< PDFDerivativeValueType >( factor );
+  for( SizeValueType i = 0; i < numberOfValues; ++i )
+  {
+    pdfPtr[ i ] *= castfac;
   }
 
 } // end NormalizeJointPDFDerivatives()
@@ -751,26 +1227,41 @@ template< class TFixedImage, class TMovingImage >
 void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::ComputeMarginalPDF(
-  const JointPDFType * itkNotUsed( jointPDF ),
+  const JointPDFType * jointPDF,
   MarginalPDFType & marginalPDF, const unsigned int & direction ) const
 {
-  typedef ImageLinearIteratorWithIndex< JointPDFType > JointPDFLinearIterator;
-  // \todo: bug? shouldn't this be over the function argument jointPDF ?
-  JointPDFLinearIterator linearIter( this->m_JointPDF, this->m_JointPDF->GetBufferedRegion() );
-  linearIter.SetDirection( direction );
-  linearIter.GoToBegin();
-  unsigned int marginalIndex = 0;
-  while( !linearIter.IsAtEnd() )
+  /** The joint pdf is stored with the moving bins (index 0) running fastest. */
+  const PDFValueType * pdfPtr            = jointPDF->GetBufferPointer();
+  const unsigned int   numberOfMovingBins = jointPDF->GetBufferedRegion().GetSize()[ 0 ];
+  const unsigned int   numberOfFixedBins  = jointPDF->GetBufferedRegion().GetSize()[ 1 ];
+
+  if( direction == 0 )
+  {
+    /** Sum over the moving bins, which are contiguous. */
+    for( unsigned int f = 0; f < numberOfFixedBins; ++f )
+    {
+      PDFValueType sum = 0.0;
+      for( unsigned int m = 0; m < numberOfMovingBins; ++m )
+      {
+        sum += pdfPtr[ m ];
+      }
+      marginalPDF[ f ] = sum;
+      pdfPtr          += numberOfMovingBins;
+    }
+  }
+  else
   {
-    PDFValueType sum = 0.0;
-    while( !linearIter.IsAtEndOfLine() )
+    /** Sum over the fixed bins, adding one contiguous row at a time. */
+    PDFValueType * marginalPtr = marginalPDF.data_block();
+    std::fill( marginalPtr, marginalPtr + numberOfMovingBins, NumericTraits< PDFValueType >::ZeroValue() );
+    for( unsigned int f = 0; f < numberOfFixedBins; ++f )
     {
-      sum += linearIter.Get();
-      ++linearIter;
+      for( unsigned int m = 0; m < numberOfMovingBins; ++m )
+      {
+        marginalPtr[ m ] += pdfPtr[ m ];
+      }
+      pdfPtr += numberOfMovingBins;
     }
-    marginalPDF[ marginalIndex ] = sum;
-    linearIter.NextLine();
-    ++marginalIndex;
   }
 
 } // end ComputeMarginalPDFs()
@@ -841,10 +1332,38 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   const DerivativeType & movingMaskValuesRight,
   const DerivativeType & movingMaskValuesLeft,
   const NonZeroJacobianIndicesType & nzji ) const
+{
+  this->UpdateJointPDFAndIncrementalPDFs( fixedImageValue, movingImageValue, movingMaskValue,
+    movingImageValuesRight, movingImageValuesLeft, movingMaskValuesRight, movingMaskValuesLeft, nzji,
+    this->m_JointPDF, this->m_IncrementalJointPDFRight, this->m_IncrementalJointPDFLeft,
+    this->m_PerturbedAlphaRight, this->m_PerturbedAlphaLeft );
+
+} // end UpdateJointPDFAndIncrementalPDFs()
+
+
+/**
+ * ******************* UpdateJointPDFAndIncrementalPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateJointPDFAndIncrementalPDFs(
+  RealType fixedImageValue, RealType movingImageValue, RealType movingMaskValue,
+  const DerivativeType & movingImageValuesRight,
+  const DerivativeType & movingImageValuesLeft,
+  const DerivativeType & movingMaskValuesRight,
+  const DerivativeType & movingMaskValuesLeft,
+  const NonZeroJacobianIndicesType & nzji,
+  JointPDFType * jointPDF,
+  JointPDFDerivativesType * incrementalJointPDFRight,
+  JointPDFDerivativesType * incrementalJointPDFLeft,
+  DerivativeType & perturbedAlphaRight,
+  DerivativeType & perturbedAlphaLeft ) const
 {
   /** Pointers to the first pixels in the incremental joint pdfs. */
-  PDFDerivativeValueType * incRightBasePtr = this->m_IncrementalJointPDFRight->GetBufferPointer();
-  PDFDerivativeValueType * incLeftBasePtr  = this->m_IncrementalJointPDFLeft->GetBufferPointer();
+  PDFDerivativeValueType * incRightBasePtr = incrementalJointPDFRight->GetBufferPointer();
+  PDFDerivativeValueType * incLeftBasePtr  = incrementalJointPDFLeft->GetBufferPointer();
 
   /** The Parzen value containers. */
   ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
@@ -892,11 +1411,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       {
         const PDFValueType fv_mask_mv
                                                 = static_cast< PDFValueType >( fv_mask * movingParzenValues[ m ] );
-        this->m_JointPDF->GetPixel( pdfIndex ) += fv_mask_mv;
+        jointPDF->GetPixel( pdfIndex ) += fv_mask_mv;
 
         unsigned long offset = static_cast< unsigned long >(
-          pdfIndex[ 0 ] * this->m_IncrementalJointPDFRight->GetOffsetTable()[ 1 ]
-          + pdfIndex[ 1 ] * this->m_IncrementalJointPDFRight->GetOffsetTable()[ 2 ] );
+          pdfIndex[ 0 ] * incrementalJointPDFRight->GetOffsetTable()[ 1 ]
+          + pdfIndex[ 1 ] * incrementalJointPDFRight->GetOffsetTable()[ 2 ] );
 
         /** Get the pointer to the element with index [0, pdfIndex[0], pdfIndex[1]]. */
         PDFDerivativeValueType * incRightPtr = incRightBasePtr + offset;
@@ -963,7 +1482,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         for( unsigned int m = 0; m < movingParzenValues.GetSize(); ++m )
         {
           const PDFValueType fv_mask_mv = static_cast< PDFValueType >( fv_mask * movingParzenValues[ m ] );
-          this->m_IncrementalJointPDFRight->GetPixel( rindex ) += fv_mask_mv;
+          incrementalJointPDFRight->GetPixel( rindex ) += fv_mask_mv;
           ++( rindex[ 1 ] );
         } // end for m
 
@@ -998,7 +1517,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         for( unsigned int m = 0; m < movingParzenValues.GetSize(); ++m )
         {
           const PDFValueType fv_mask_mv = static_cast< PDFValueType >( fv_mask * movingParzenValues[ m ] );
-          this->m_IncrementalJointPDFLeft->GetPixel( lindex ) += fv_mask_mv;
+          incrementalJointPDFLeft->GetPixel( lindex ) += fv_mask_mv;
           ++( lindex[ 1 ] );
         } // end for m
 
@@ -1009,8 +1528,8 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     }   // end if maskl
 
     /** Update the perturbed alphas. */
-    this->m_PerturbedAlphaRight[ mu ] += ( maskr - movingMaskValue );
-    this->m_PerturbedAlphaLeft[ mu ]  += ( maskl - movingMaskValue );
+    perturbedAlphaRight[ mu ] += ( maskr - movingMaskValue );
+    perturbedAlphaLeft[ mu ]  += ( maskl - movingMaskValue );
   } // end for i
 
 } // end UpdateJointPDFAndIncrementalPDFs()
@@ -1045,6 +1564,10 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
+  /** Compute the fixed Parzen windows of new samples. */
+  this->UpdateFixedParzenWindowCache();
+  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
@@ -1062,7 +1585,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -1091,8 +1614,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
 
       /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, 0, 0, this->m_JointPDF.GetPointer() );
+      OffsetValueType      fixedParzenWindowIndex;
+      const PDFValueType * fixedParzenWindow = this->GetFixedParzenWindow(
+        fiter.Index(), fixedImageValue, fixedParzenWindowIndex, fixedParzenValues );
+      this->UpdateJointPDFAndDerivatives( fixedParzenWindowIndex, fixedParzenWindow,
+        movingImageValue, 0, 0, this->m_JointPDF.GetPointer() );
     }
 
   } // end iterating over fixed image spatial sample container for loop
@@ -1136,6 +1662,9 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
+  /** Compute the fixed Parzen windows of new samples. */
+  this->UpdateFixedParzenWindowCache();
+
   /** Launch multi-threading JointPDF computation. */
   this->LaunchComputePDFsThreaderCallback();
 
@@ -1183,7 +1712,32 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   fend                                                   += (int)pos_end;
 
   /** Create variables to store intermediate results. circumvent false sharing */
-  unsigned long numberOfPixelsCounted = 0;
+  unsigned long            numberOfPixelsCounted = 0;
+  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+
+  /** Prepare the per sample buffers, if requested. The capacity is kept
+   * between iterations, so that no re-allocation takes place.
+   */
+  const bool                   cacheDerivativeTerms = this->m_CacheSampleDerivativeTerms;
+  NonZeroJacobianIndicesType & nzji
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NonZeroJacobianIndices;
+  DerivativeType & imageJacobian
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_ImageJacobian;
+  const NumberOfParametersType nnzji = nzji.size();
+  if( cacheDerivativeTerms )
+  {
+    AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & cache
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+    const unsigned long numberOfSamples = pos_end - pos_begin;
+    cache.st_CachedFixedImageValues.clear();
+    cache.st_CachedMovingImageValues.clear();
+    cache.st_CachedImageJacobians.clear();
+    cache.st_CachedNonZeroJacobianIndices.clear();
+    cache.st_CachedFixedImageValues.reserve( numberOfSamples );
+    cache.st_CachedMovingImageValues.reserve( numberOfSamples );
+    cache.st_CachedImageJacobians.reserve( numberOfSamples * nnzji );
+    cache.st_CachedNonZeroJacobianIndices.reserve( numberOfSamples * nnzji );
+  }
 
   /** Loop over sample container and compute contribution of each sample to pdfs. */
   for( fiter = fbegin; fiter != fend; ++fiter )
@@ -1191,10 +1745,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     /** Read fixed coordinates and initialize some variables. */
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
     RealType                    movingImageValue;
+    MovingImageDerivativeType   movingImageDerivative;
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -1208,7 +1763,8 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     if( sampleOk )
     {
       sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, 0 );
+        mappedPoint, movingImageValue,
+        cacheDerivativeTerms ? &movingImageDerivative : 0 );
     }
 
     if( sampleOk )
@@ -1219,13 +1775,39 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Make sure the values fall within the histogram range. */
-      fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
-      movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+      fixedImageValue = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+      if( cacheDerivativeTerms )
+      {
+        movingImageValue = this->GetMovingImageLimiter()
+          ->Evaluate( movingImageValue, movingImageDerivative );
+      }
+      else
+      {
+        movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+      }
 
       /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, 0, 0,
-        jointPDF.GetPointer() );
+      OffsetValueType      fixedParzenWindowIndex;
+      const PDFValueType * fixedParzenWindow = this->GetFixedParzenWindow(
+        fiter.Index(), fixedImageValue, fixedParzenWindowIndex, fixedParzenValues );
+      this->UpdateJointPDFAndDerivatives( fixedParzenWindowIndex, fixedParzenWindow,
+        movingImageValue, 0, 0, jointPDF.GetPointer() );
+
+      /** Store what the derivative pass needs from this sample. */
+      if( cacheDerivativeTerms )
+      {
+        this->EvaluateTransformJacobianWithImageGradientProduct(
+          fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
+
+        AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & cache
+          = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+        cache.st_CachedFixedImageValues.push_back( fixedImageValue );
+        cache.st_CachedMovingImageValues.push_back( movingImageValue );
+        cache.st_CachedImageJacobians.insert( cache.st_CachedImageJacobians.end(),
+          imageJacobian.begin(), imageJacobian.end() );
+        cache.st_CachedNonZeroJacobianIndices.insert( cache.st_CachedNonZeroJacobianIndices.end(),
+          nzji.begin(), nzji.end() );
+      }
     }
   } // end iterating over fixed image spatial sample container for loop
 
@@ -1331,14 +1913,11 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputePDFsThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputePDFsThreaderCallback,
+  /** Launch. */
+  this->ExecuteThreaderCallback( this->ComputePDFsThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_ParzenWindowHistogramThreaderParameters ) ) );
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
-
 } // end LaunchComputePDFsThreaderCallback()
 
 
@@ -1351,6 +1930,20 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::ComputePDFsAndPDFDerivatives( const ParametersType & parameters ) const
 {
+  /** Compute sparse pdf derivatives multi-threadedly, if requested. */
+  if( this->GetSparseJointPDFDerivativesAreUsed() )
+  {
+    this->BeforeThreadedGetValueAndDerivative( parameters );
+    this->UpdateFixedParzenWindowCache();
+    this->ExecuteThreaderCallback( this->ComputePDFsAndSparsePDFDerivativesThreaderCallback,
+      const_cast< void * >( static_cast< const void * >(
+        &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+
+    /** Accumulate the joint histograms and compute alpha. */
+    this->AfterThreadedComputePDFs();
+    return;
+  }
+
   /** Initialize some variables. */
   this->m_JointPDF->FillBuffer( 0.0 );
   this->m_JointPDFDerivatives->FillBuffer( 0.0 );
@@ -1377,6 +1970,10 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
+  /** Compute the fixed Parzen windows of new samples. */
+  this->UpdateFixedParzenWindowCache();
+  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
@@ -1395,7 +1992,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -1425,15 +2022,18 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         movingImageValue, movingImageDerivative );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner product (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
         jacobian, movingImageDerivative, imageJacobian );
 
       /** Update the joint pdf and the joint pdf derivatives. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, &imageJacobian, &nzji, this->m_JointPDF.GetPointer() );
+      OffsetValueType      fixedParzenWindowIndex;
+      const PDFValueType * fixedParzenWindow = this->GetFixedParzenWindow(
+        fiter.Index(), fixedImageValue, fixedParzenWindowIndex, fixedParzenValues );
+      this->UpdateJointPDFAndDerivatives( fixedParzenWindowIndex, fixedParzenWindow,
+        movingImageValue, &imageJacobian, &nzji, this->m_JointPDF.GetPointer() );
 
     } //end if-block check sampleOk
   }   // end iterating over fixed image spatial sample container for loop
@@ -1453,25 +2053,158 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ************************ ComputePDFsAndIncrementalPDFs *******************
+ * ******************* ThreadedComputePDFsAndSparsePDFDerivatives *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
-::ComputePDFsAndIncrementalPDFs( const ParametersType & parameters ) const
+::ThreadedComputePDFsAndSparsePDFDerivatives( ThreadIdType threadId )
 {
-  /** Initialize some variables. */
-  this->m_JointPDF->FillBuffer( 0.0 );
-  this->m_IncrementalJointPDFRight->FillBuffer( 0.0 );
-  this->m_IncrementalJointPDFLeft->FillBuffer( 0.0 );
-  this->m_Alpha = 0.0;
-  this->m_PerturbedAlphaRight.Fill( 0.0 );
-  this->m_PerturbedAlphaLeft.Fill( 0.0 );
+  /** Get handles to the histograms of this thread and initialize them here,
+   * so that this is done multi-threadedly. The block table keeps its capacity,
+   * and the blocks are only added when touched.
+   */
+  AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+  JointPDFType * jointPDF = perThread.st_JointPDF.GetPointer();
+  jointPDF->FillBuffer( NumericTraits< PDFValueType >::ZeroValue() );
 
-  this->m_NumberOfPixelsCounted = 0;
-  double       sumOfMovingMaskValues = 0.0;
-  const double delta                 = this->GetFiniteDifferencePerturbation();
+  const unsigned int blockSize      = Self::PDFDerivativeBlockSize;
+  const unsigned int numberOfBlocks = ( this->GetNumberOfParameters() + blockSize - 1 ) / blockSize;
+  SparseJointPDFDerivativesType & sparseJointPDFDerivatives = perThread.st_SparseJointPDFDerivatives;
+  sparseJointPDFDerivatives.m_BlockIndices.assign( static_cast< SizeValueType >( numberOfBlocks )
+    * this->m_NumberOfFixedHistogramBins * this->m_NumberOfMovingHistogramBins, 0 );
+  sparseJointPDFDerivatives.m_Blocks.clear();
+
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create iterator over the sample container. */
+  typename ImageSampleContainerType::ConstIterator fiter;
+  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+  fbegin                                                 += (int)pos_begin;
+  fend                                                   += (int)pos_end;
+
+  /** Get handles to the per-thread buffers for dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType & nzji
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NonZeroJacobianIndices;
+  DerivativeType & imageJacobian
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_ImageJacobian;
+  ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
+  unsigned long            numberOfPixelsCounted = 0;
+
+  /** Loop over sample container and compute contribution of each sample to pdfs. */
+  for( fiter = fbegin; fiter != fend; ++fiter )
+  {
+    /** Read fixed coordinates and initialize some variables. */
+    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    RealType                    movingImageValue;
+    MovingImagePointType        mappedPoint;
+    MovingImageDerivativeType   movingImageDerivative;
+
+    /** Transform point and check if it is inside the B-spline support region. */
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
+
+    /** Check if point is inside mask. */
+    if( sampleOk )
+    {
+      sampleOk = this->IsInsideMovingMask( mappedPoint );
+    }
+
+    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
+     * the point is inside the moving image buffer.
+     */
+    if( sampleOk )
+    {
+      sampleOk = this->EvaluateMovingImageValueAndDerivative(
+        mappedPoint, movingImageValue, &movingImageDerivative );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      /** Get the fixed image value. */
+      RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+
+      /** Make sure the values fall within the histogram range. */
+      fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+      movingImageValue = this->GetMovingImageLimiter()->Evaluate(
+        movingImageValue, movingImageDerivative );
+
+      /** Compute the inner product (dM/dx)^T (dT/dmu). */
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
+
+      /** Update the joint pdf and the sparse joint pdf derivatives. */
+      OffsetValueType      fixedParzenWindowIndex;
+      const PDFValueType * fixedParzenWindow = this->GetFixedParzenWindow(
+        fiter.Index(), fixedImageValue, fixedParzenWindowIndex, fixedParzenValues );
+      this->UpdateJointPDFAndDerivatives( fixedParzenWindowIndex, fixedParzenWindow,
+        movingImageValue, &imageJacobian, &nzji, jointPDF, &sparseJointPDFDerivatives );
+
+    } //end if-block check sampleOk
+  }   // end iterating over fixed image spatial sample container for loop
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  perThread.st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end ThreadedComputePDFsAndSparsePDFDerivatives()
+
+
+/**
+ * **************** ComputePDFsAndSparsePDFDerivativesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndSparsePDFDerivativesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputePDFsAndSparsePDFDerivatives( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputePDFsAndSparsePDFDerivativesThreaderCallback()
+
+
+/**
+ * ************************ ComputePDFsAndIncrementalPDFsOfSamples *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndIncrementalPDFsOfSamples(
+  const unsigned long pos_begin, const unsigned long pos_end,
+  JointPDFType * jointPDF,
+  JointPDFDerivativesType * incrementalJointPDFRight,
+  JointPDFDerivativesType * incrementalJointPDFLeft,
+  DerivativeType & perturbedAlphaRight,
+  DerivativeType & perturbedAlphaLeft,
+  double & sumOfMovingMaskValues,
+  SizeValueType & numberOfPixelsCounted ) const
+{
+  const double delta = this->GetFiniteDifferencePerturbation();
 
   /** sparse jacobian+indices. */
   NonZeroJacobianIndicesType nzji( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
@@ -1483,28 +2216,15 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType movingMaskValuesRight( nzji.size() );
   DerivativeType movingMaskValuesLeft( nzji.size() );
 
-  /** Call non-thread-safe stuff, such as:
-   *   this->SetTransformParameters( parameters );
-   *   this->GetImageSampler()->Update();
-   * Because of these calls GetValueAndDerivative itself is not thread-safe,
-   * so cannot be called multiple times simultaneously.
-   * This is however needed in the CombinationImageToImageMetric.
-   * In that case, you need to:
-   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
-   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
-   *   calling GetValueAndDerivative
-   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
-   * - Now you can call GetValueAndDerivative multi-threaded.
-   */
-  this->BeforeThreadedGetValueAndDerivative( parameters );
-
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator fiter;
   typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+  fbegin                                                 += (int)pos_begin;
+  fend                                                   += (int)pos_end;
 
   /** Loop over sample container and compute contribution of each sample to pdfs. */
   for( fiter = fbegin; fiter != fend; ++fiter )
@@ -1516,7 +2236,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
      * if not, skip this sample.
      */
     MovingImagePointType mappedPoint;
-    bool                 sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool                 sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     if( sampleOk )
     {
@@ -1559,14 +2279,14 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       if( !sampleOk ) { continue; }
 
       /** Count how many samples were used. */
-      sumOfMovingMaskValues         += movingMaskValue;
-      this->m_NumberOfPixelsCounted += static_cast< unsigned int >( sampleOk );
+      sumOfMovingMaskValues += movingMaskValue;
+      numberOfPixelsCounted += static_cast< unsigned int >( sampleOk );
 
       /** Get the TransformJacobian dT/dmu. We assume the transform is a linear
        * function of its parameters, so that we can evaluate T(x;\mu+delta_ek)
        * as T(x) + delta * dT/dmu_k.
        */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       MovingImagePointType mappedPointRight;
       MovingImagePointType mappedPointLeft;
@@ -1636,11 +2356,69 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       this->UpdateJointPDFAndIncrementalPDFs(
         fixedImageValue, movingImageValue, movingMaskValue,
         movingImageValuesRight, movingImageValuesLeft,
-        movingMaskValuesRight, movingMaskValuesLeft, nzji );
+        movingMaskValuesRight, movingMaskValuesLeft, nzji,
+        jointPDF, incrementalJointPDFRight, incrementalJointPDFLeft,
+        perturbedAlphaRight, perturbedAlphaLeft );
 
     } //end if-block check sampleOk
   }   // end iterating over fixed image spatial sample container for loop
 
+} // end ComputePDFsAndIncrementalPDFsOfSamples()
+
+
+/**
+ * ************************ ComputePDFsAndIncrementalPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndIncrementalPDFs( const ParametersType & parameters ) const
+{
+  /** Initialize some variables. */
+  this->m_JointPDF->FillBuffer( 0.0 );
+  this->m_IncrementalJointPDFRight->FillBuffer( 0.0 );
+  this->m_IncrementalJointPDFLeft->FillBuffer( 0.0 );
+  this->m_Alpha = 0.0;
+  this->m_PerturbedAlphaRight.Fill( 0.0 );
+  this->m_PerturbedAlphaLeft.Fill( 0.0 );
+
+  this->m_NumberOfPixelsCounted = 0;
+  double sumOfMovingMaskValues = 0.0;
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValueAndDerivative itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
+   *   calling GetValueAndDerivative
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValueAndDerivative multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Compute the contributions of all samples, single- or multi-threaded. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  if( !this->m_UseMultiThread )
+  {
+    this->ComputePDFsAndIncrementalPDFsOfSamples( 0, sampleContainer->Size(),
+      this->m_JointPDF, this->m_IncrementalJointPDFRight, this->m_IncrementalJointPDFLeft,
+      this->m_PerturbedAlphaRight, this->m_PerturbedAlphaLeft,
+      sumOfMovingMaskValues, this->m_NumberOfPixelsCounted );
+  }
+  else
+  {
+    this->InitializeIncrementalPDFsPerThread();
+    this->ExecuteThreaderCallback( this->ComputePDFsAndIncrementalPDFsThreaderCallback,
+      const_cast< void * >( static_cast< const void * >(
+        &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+    this->AfterThreadedComputePDFsAndIncrementalPDFs( sumOfMovingMaskValues );
+  }
+
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples(
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
@@ -1676,6 +2454,192 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 } // end ComputePDFsAndIncrementalPDFs()
 
 
+/**
+ * ******************* ThreadedComputePDFsAndIncrementalPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputePDFsAndIncrementalPDFs( ThreadIdType threadId )
+{
+  /** Get handles to the histograms of this thread. Thread 0 directly uses the
+   * member variables, which were initialized already, and saves one copy of the
+   * large incremental pdfs. The other threads initialize their own here, so that
+   * this is done multi-threadedly.
+   */
+  AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+  JointPDFType *            jointPDF                 = perThread.st_JointPDF.GetPointer();
+  JointPDFDerivativesType * incrementalJointPDFRight = this->m_IncrementalJointPDFRight.GetPointer();
+  JointPDFDerivativesType * incrementalJointPDFLeft  = this->m_IncrementalJointPDFLeft.GetPointer();
+  DerivativeType *          perturbedAlphaRight      = &this->m_PerturbedAlphaRight;
+  DerivativeType *          perturbedAlphaLeft       = &this->m_PerturbedAlphaLeft;
+  jointPDF->FillBuffer( NumericTraits< PDFValueType >::ZeroValue() );
+  if( threadId > 0 )
+  {
+    incrementalJointPDFRight = perThread.st_IncrementalJointPDFRight.GetPointer();
+    incrementalJointPDFLeft  = perThread.st_IncrementalJointPDFLeft.GetPointer();
+    perturbedAlphaRight      = &perThread.st_PerturbedAlphaRight;
+    perturbedAlphaLeft       = &perThread.st_PerturbedAlphaLeft;
+    incrementalJointPDFRight->FillBuffer( NumericTraits< PDFDerivativeValueType >::ZeroValue() );
+    incrementalJointPDFLeft->FillBuffer( NumericTraits< PDFDerivativeValueType >::ZeroValue() );
+    perturbedAlphaRight->Fill( 0.0 );
+    perturbedAlphaLeft->Fill( 0.0 );
+  }
+
+  /** Get the samples for this thread. */
+  const unsigned long sampleContainerSize = this->GetImageSampler()->GetOutput()->Size();
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Compute the contributions of these samples. */
+  double        sumOfMovingMaskValues = 0.0;
+  SizeValueType numberOfPixelsCounted = 0;
+  this->ComputePDFsAndIncrementalPDFsOfSamples( pos_begin, pos_end,
+    jointPDF, incrementalJointPDFRight, incrementalJointPDFLeft,
+    *perturbedAlphaRight, *perturbedAlphaLeft,
+    sumOfMovingMaskValues, numberOfPixelsCounted );
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  perThread.st_SumOfMovingMaskValues = sumOfMovingMaskValues;
+  perThread.st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end ThreadedComputePDFsAndIncrementalPDFs()
+
+
+/**
+ * ******************* AfterThreadedComputePDFsAndIncrementalPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedComputePDFsAndIncrementalPDFs( double & sumOfMovingMaskValues ) const
+{
+  /** Accumulate the counts, the joint histogram and the perturbed alphas. */
+  const SizeValueType numberOfValues = this->m_JointPDF->GetBufferedRegion().GetNumberOfPixels();
+  PDFValueType *      jointPDFPtr    = this->m_JointPDF->GetBufferPointer();
+  std::copy( this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ 0 ].st_JointPDF->GetBufferPointer(),
+    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ 0 ].st_JointPDF->GetBufferPointer() + numberOfValues,
+    jointPDFPtr );
+  sumOfMovingMaskValues         = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ 0 ].st_SumOfMovingMaskValues;
+  this->m_NumberOfPixelsCounted = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted = 0;
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ];
+    sumOfMovingMaskValues         += perThread.st_SumOfMovingMaskValues;
+    this->m_NumberOfPixelsCounted += perThread.st_NumberOfPixelsCounted;
+    perThread.st_NumberOfPixelsCounted = 0;
+
+    const PDFValueType * threadPtr = perThread.st_JointPDF->GetBufferPointer();
+    for( SizeValueType j = 0; j < numberOfValues; ++j )
+    {
+      jointPDFPtr[ j ] += threadPtr[ j ];
+    }
+    this->m_PerturbedAlphaRight += perThread.st_PerturbedAlphaRight;
+    this->m_PerturbedAlphaLeft  += perThread.st_PerturbedAlphaLeft;
+  }
+
+  /** Add the incremental pdfs of the other threads to those of thread 0. */
+  if( this->m_NumberOfThreads > 1 )
+  {
+    this->ExecuteThreaderCallback( this->MergeIncrementalPDFsThreaderCallback,
+      const_cast< void * >( static_cast< const void * >(
+        &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  }
+
+} // end AfterThreadedComputePDFsAndIncrementalPDFs()
+
+
+/**
+ * ******************* ThreadedMergeIncrementalPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedMergeIncrementalPDFs( ThreadIdType threadId )
+{
+  /** Every thread merges an equal part of the buffers. */
+  const SizeValueType numberOfValues
+    = this->m_IncrementalJointPDFRight->GetBufferedRegion().GetNumberOfPixels();
+  const SizeValueType valuesPerThread
+    = static_cast< SizeValueType >( vcl_ceil( static_cast< double >( numberOfValues )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+  const SizeValueType pos_begin = std::min( numberOfValues, valuesPerThread * threadId );
+  const SizeValueType pos_end   = std::min( numberOfValues, valuesPerThread * ( threadId + 1 ) );
+
+  PDFDerivativeValueType * rightPtr = this->m_IncrementalJointPDFRight->GetBufferPointer();
+  PDFDerivativeValueType * leftPtr  = this->m_IncrementalJointPDFLeft->GetBufferPointer();
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    const AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ];
+    const PDFDerivativeValueType * threadRightPtr = perThread.st_IncrementalJointPDFRight->GetBufferPointer();
+    const PDFDerivativeValueType * threadLeftPtr  = perThread.st_IncrementalJointPDFLeft->GetBufferPointer();
+    for( SizeValueType j = pos_begin; j < pos_end; ++j )
+    {
+      rightPtr[ j ] += threadRightPtr[ j ];
+      leftPtr[ j ]  += threadLeftPtr[ j ];
+    }
+  }
+
+} // end ThreadedMergeIncrementalPDFs()
+
+
+/**
+ * **************** ComputePDFsAndIncrementalPDFsThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndIncrementalPDFsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputePDFsAndIncrementalPDFs( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputePDFsAndIncrementalPDFsThreaderCallback()
+
+
+/**
+ * **************** MergeIncrementalPDFsThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::MergeIncrementalPDFsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedMergeIncrementalPDFs( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end MergeIncrementalPDFsThreaderCallback()
+
+
 } // end namespace itk
 
 #endif // end #ifndef _itkParzenWindowHistogramImageToImageMetric_HXX__
@@ -35,6 +35,7 @@ ScaledSingleValuedCostFunction
   this->m_UnscaledCostFunction = 0;
   this->m_UseScales            = false;
   this->m_NegateCostFunction   = false;
+  this->m_LastValue            = NumericTraits< MeasureType >::Zero;
 
 } // end Constructor
 
@@ -58,16 +59,17 @@ ScaledSingleValuedCostFunction
 
   MeasureType returnvalue = NumericTraits< MeasureType >::Zero;
 
+  this->m_ValueTimer.Start();
   if( this->m_UseScales )
   {
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
-    returnvalue = this->m_UnscaledCostFunction->GetValue( scaledParameters );
+    returnvalue = this->m_UnscaledCostFunction->GetValue( this->GetUnscaledParameters( parameters ) );
   }
   else
   {
     returnvalue = this->m_UnscaledCostFunction->GetValue( parameters );
   }
+  this->m_ValueTimer.Stop();
+  this->m_LastValue = returnvalue;
 
   if( this->GetNegateCostFunction() )
   {
@@ -96,27 +98,18 @@ ScaledSingleValuedCostFunction
     itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
   }
 
+  this->m_DerivativeTimer.Start();
   if( this->m_UseScales )
   {
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
-    this->m_UnscaledCostFunction->GetDerivative( scaledParameters, derivative );
-
-    const ScalesType & scales = this->GetScales();
-    for( unsigned int i = 0; i < numberOfParameters; ++i )
-    {
-      derivative[ i ] /= scales[ i ];
-    }
+    this->m_UnscaledCostFunction->GetDerivative( this->GetUnscaledParameters( parameters ), derivative );
   }
   else
   {
     m_UnscaledCostFunction->GetDerivative( parameters, derivative );
   }
+  this->m_DerivativeTimer.Stop();
 
-  if( this->GetNegateCostFunction() )
-  {
-    derivative = -derivative;
-  }
+  this->ScaleAndNegateDerivative( derivative );
 
 } // end GetDerivative()
 
@@ -141,33 +134,100 @@ ScaledSingleValuedCostFunction
     itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
   }
 
+  this->m_ValueAndDerivativeTimer.Start();
   if( this->m_UseScales )
   {
 
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
-    this->m_UnscaledCostFunction->GetValueAndDerivative( scaledParameters, value, derivative );
-
-    const ScalesType & scales = this->GetScales();
-    for( unsigned int i = 0; i < numberOfParameters; ++i )
-    {
-      derivative[ i ] /= scales[ i ];
-    }
+    this->m_UnscaledCostFunction->GetValueAndDerivative( this->GetUnscaledParameters( parameters ), value, derivative );
   }
   else
   {
     this->m_UnscaledCostFunction->GetValueAndDerivative( parameters, value, derivative );
   }
+  this->m_ValueAndDerivativeTimer.Stop();
+  this->m_LastValue = value;
 
   if( this->GetNegateCostFunction() )
   {
-    value      = -value;
-    derivative = -derivative;
+    value = -value;
   }
+  this->ScaleAndNegateDerivative( derivative );
 
 } // end GetValueAndDerivative()
 
 
+/**
+ * **************** GetUnscaledParameters ************************
+ */
+
+const ScaledSingleValuedCostFunction::ParametersType &
+ScaledSingleValuedCostFunction
+::GetUnscaledParameters( const ParametersType & parameters ) const
+{
+  /** x = y/s, copied and divided in one pass into a buffer that is
+   * allocated only once. The transform may keep a reference to these
+   * parameters, see AdvancedBSplineDeformableTransformBase::SetParameters(),
+   * which stays valid until the next call.
+   */
+  const unsigned int numberOfParameters = parameters.GetSize();
+  const ScalesType & scales             = this->GetScales();
+  if( scales.GetSize() != numberOfParameters )
+  {
+    itkExceptionMacro( << "Number of scales is not correct." );
+  }
+
+  this->m_UnscaledParameters.SetSize( numberOfParameters );
+  double *       unscaled = this->m_UnscaledParameters.data_block();
+  const double * scaled   = parameters.data_block();
+  const double * s        = scales.data_block();
+  for( unsigned int i = 0; i < numberOfParameters; ++i )
+  {
+    unscaled[ i ] = scaled[ i ] / s[ i ];
+  }
+
+  return this->m_UnscaledParameters;
+
+} // end GetUnscaledParameters()
+
+
+/**
+ * **************** ScaleAndNegateDerivative ************************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ScaleAndNegateDerivative( DerivativeType & derivative ) const
+{
+  /** dF/dy(y)= 1/s * df/dx(y/s), and the sign flip for maximization,
+   * in one pass over the derivative, without temporaries. */
+  const bool negate = this->GetNegateCostFunction();
+  if( !this->m_UseScales && !negate )
+  {
+    return;
+  }
+
+  const unsigned int numberOfParameters = derivative.GetSize();
+  double *           deriv              = derivative.data_block();
+  if( this->m_UseScales )
+  {
+    const double * scales = this->GetScales().data_block();
+    const double   sign   = negate ? -1.0 : 1.0;
+    for( unsigned int i = 0; i < numberOfParameters; ++i )
+    {
+      deriv[ i ] = sign * ( deriv[ i ] / scales[ i ] );
+    }
+  }
+  else
+  {
+    for( unsigned int i = 0; i < numberOfParameters; ++i )
+    {
+      deriv[ i ] = -deriv[ i ];
+    }
+  }
+
+} // end ScaleAndNegateDerivative()
+
+
 /**
  * **************** GetNumberOfParameters ************************
  */
@@ -21,6 +21,7 @@
 
 #include "itkSingleValuedCostFunction.h"
 #include "itkIntTypes.h" //temp, needed for IdentifierType
+#include "itkTimeProbe.h"
 
 namespace itk
 {
@@ -33,6 +34,11 @@ namespace itk
  * By default it does not apply any scaling. Use the method SetUseScales(true)
  * to enable the use of scales.
  *
+ * When scales are used, the unscaled parameters are computed into a buffer
+ * owned by this object, so that no vector is allocated per evaluation.
+ * Consequently, one instance should not be evaluated from several threads
+ * at the same time.
+ *
  * \ingroup Numerics
  */
 
@@ -126,6 +132,20 @@ public:
   /** Convert the parameters from unscaled to scaled: y = x*s. */
   virtual void ConvertUnscaledToScaledParameters( ParametersType & parameters ) const;
 
+  /** Timers of the calls to the GetValue, GetDerivative and
+   * GetValueAndDerivative methods of the unscaled cost function. Their
+   * totals and numbers of stops accumulate over the lifetime of this object.
+   * They are used for performance telemetry, see elx::PerformanceTrace.
+   */
+  const TimeProbe & GetValueTimer( void ) const { return this->m_ValueTimer; }
+  const TimeProbe & GetDerivativeTimer( void ) const { return this->m_DerivativeTimer; }
+  const TimeProbe & GetValueAndDerivativeTimer( void ) const { return this->m_ValueAndDerivativeTimer; }
+
+  /** The value of the unscaled cost function in the last call of GetValue()
+   * or GetValueAndDerivative(), for progress reports, see
+   * RegistrationMonitor. */
+  itkGetConstMacro( LastValue, MeasureType );
+
 protected:
 
   /** The constructor. */
@@ -136,6 +156,14 @@ protected:
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
 
+  /** Divide the derivative by the scales, if used, and negate it, if
+   * desired, in a single pass and in place. */
+  void ScaleAndNegateDerivative( DerivativeType & derivative ) const;
+
+  /** Return x = y/s, computed into m_UnscaledParameters. Only to be used
+   * when scales are used. */
+  const ParametersType & GetUnscaledParameters( const ParametersType & parameters ) const;
+
 private:
 
   /** The private constructor. */
@@ -150,6 +178,15 @@ private:
   bool                            m_UseScales;
   bool                            m_NegateCostFunction;
 
+  mutable TimeProbe m_ValueTimer;
+  mutable TimeProbe m_DerivativeTimer;
+  mutable TimeProbe m_ValueAndDerivativeTimer;
+
+  mutable MeasureType m_LastValue;
+
+  /** Buffer for the unscaled parameters, reused in every evaluation. */
+  mutable ParametersType m_UnscaledParameters;
+
 };
 
 } //end namespace itk
@@ -40,6 +40,10 @@
 #include "itkExceptionObject.h"
 #include "itkSpatialObject.h"
 #include "itkPointSet.h"
+#include "itkMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -54,6 +58,11 @@ namespace itk
  * This class computes a value that measures the similarity between the fixed point-set
  * and the transformed moving point-set.
  *
+ * Subclasses can multi-thread their GetValueAndDerivative() over the points
+ * of the fixed point set. Every thread then adds to its own copy of the
+ * derivative, which are merged afterwards by AccumulateDerivativesThreaderCallback().
+ * The threads are taken from the global PersistentThreadPool.
+ *
  * \ingroup RegistrationMetrics
  *
  */
@@ -96,11 +105,12 @@ public:
   typedef AdvancedTransform< CoordinateRepresentationType,
     itkGetStaticConstMacro( FixedPointSetDimension ),
     itkGetStaticConstMacro( MovingPointSetDimension ) > TransformType;
-  typedef typename TransformType::Pointer         TransformPointer;
-  typedef typename TransformType::InputPointType  InputPointType;
-  typedef typename TransformType::OutputPointType OutputPointType;
-  typedef typename TransformType::ParametersType  TransformParametersType;
-  typedef typename TransformType::JacobianType    TransformJacobianType;
+  typedef typename TransformType::Pointer             TransformPointer;
+  typedef typename TransformType::InputPointType      InputPointType;
+  typedef typename TransformType::OutputPointType     OutputPointType;
+  typedef typename TransformType::ParametersType      TransformParametersType;
+  typedef typename TransformType::ParametersValueType TransformParametersValueType;
+  typedef typename TransformType::JacobianType        TransformJacobianType;
 
   typedef SpatialObject<
     itkGetStaticConstMacro( FixedPointSetDimension ) > FixedImageMaskType;
@@ -120,6 +130,12 @@ public:
   /** Typedefs for support of sparse Jacobians and compact support of transformations. */
   typedef typename TransformType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
 
+  /** Typedefs for multi-threading. */
+  typedef itk::MultiThreader                 ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct     ThreadInfoType;
+  typedef ThreaderType::ThreadFunctionType   ThreadFunctionType;
+  typedef PersistentThreadPool               ThreadPoolType;
+
   /** Connect the fixed pointset.  */
   itkSetConstObjectMacro( FixedPointSet, FixedPointSetType );
 
@@ -171,10 +187,28 @@ public:
   itkGetConstReferenceMacro( UseMetricSingleThreaded, bool );
   itkBooleanMacro( UseMetricSingleThreaded );
 
+  /** Whether GetValueAndDerivative() can be called concurrently with that of
+   * other metrics that share the transform, see AdvancedImageToImageMetric.
+   */
+  itkGetConstMacro( SupportsConcurrentEvaluation, bool );
+
+  /** Select the use of multi-threading. Only has an effect for the metrics
+   * that implement ThreadedGetValueAndDerivative(). Default: true.
+   */
+  itkSetMacro( UseMultiThread, bool );
+  itkGetConstReferenceMacro( UseMultiThread, bool );
+  itkBooleanMacro( UseMultiThread );
+
+  /** Set/Get the maximum number of threads.
+   * Default: the global default number of threads of the MultiThreader.
+   */
+  itkSetClampMacro( NumberOfThreads, ThreadIdType, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
+
 protected:
 
   SingleValuedPointSetToPointSetMetric();
-  virtual ~SingleValuedPointSetToPointSetMetric() {}
+  virtual ~SingleValuedPointSetToPointSetMetric();
 
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
@@ -189,7 +223,98 @@ protected:
   mutable unsigned int m_NumberOfPointsCounted;
 
   /** Variables for multi-threading. */
-  bool m_UseMetricSingleThreaded;
+  bool         m_UseMetricSingleThreaded;
+  bool         m_SupportsConcurrentEvaluation;
+  bool         m_UseMultiThread;
+  ThreadIdType m_NumberOfThreads;
+
+  /** A thread is only started for every MinimumNumberOfPointsPerThread
+   * points, since for small point sets, such as a few landmarks, starting
+   * the threads costs more than it gains.
+   */
+  itkStaticConstMacro( MinimumNumberOfPointsPerThread, unsigned int, 64 );
+
+  /** Get the number of threads to use for a number of points. */
+  ThreadIdType GetNumberOfThreadsForPoints( const SizeValueType numberOfPoints ) const;
+
+  /** Give every thread an equal part of the range [ 0, size [, such as
+   * the points or the parameters. */
+  void SplitRangeForThread( const SizeValueType size,
+    const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+    SizeValueType & begin, SizeValueType & end ) const;
+
+  /** Helper struct that multi-threads the computation of the metric derivative. */
+  struct MultiThreaderParameterType
+  {
+    // To give the threads access to all members.
+    SingleValuedPointSetToPointSetMetric * st_Metric;
+    // Used for accumulating derivatives
+    DerivativeValueType * st_DerivativePointer;
+    DerivativeValueType   st_NormalizationFactor;
+  };
+  mutable MultiThreaderParameterType m_ThreaderMetricParameters;
+
+  /** The per-thread value, derivative and touched derivative blocks, see
+   * AdvancedImageToImageMetric. The Jacobians and nonzero Jacobian indices
+   * are scratch buffers for TransformType::GetJacobians().
+   */
+  struct GetValueAndDerivativePerThreadStruct
+  {
+    SizeValueType                               st_NumberOfPointsCounted;
+    MeasureType                                 st_Value;
+    DerivativeType                              st_Derivative;
+    std::vector< unsigned char >                st_TouchedDerivativeBlocks;
+    std::vector< TransformParametersValueType > st_Jacobians;
+    std::vector< unsigned long >                st_NonZeroJacobianIndices;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, GetValueAndDerivativePerThreadStruct,
+    PaddedGetValueAndDerivativePerThreadStruct );
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT, PaddedGetValueAndDerivativePerThreadStruct,
+    AlignedGetValueAndDerivativePerThreadStruct );
+  mutable AlignedGetValueAndDerivativePerThreadStruct * m_GetValueAndDerivativePerThreadVariables;
+  mutable ThreadIdType                                  m_GetValueAndDerivativePerThreadVariablesSize;
+
+  /** Initialize the per-thread variables for numberOfThreads threads.
+   * The per-thread derivatives are only reset when their size changes;
+   * otherwise AccumulateDerivativesThreaderCallback() has reset them.
+   */
+  virtual void InitializeThreadingParameters( const ThreadIdType numberOfThreads ) const;
+
+  /** Execute a threader callback on numberOfThreads threads of the global thread pool. */
+  void ExecuteThreaderCallback( ThreadFunctionType callback, void * userData,
+    const ThreadIdType numberOfThreads ) const;
+
+  /** Let every thread merge a part of the per-thread derivatives into
+   * m_ThreaderMetricParameters.st_DerivativePointer, divide it by the
+   * normalization factor and reset the per-thread derivatives.
+   */
+  static ITK_THREAD_RETURN_TYPE AccumulateDerivativesThreaderCallback( void * arg );
+
+  /** Sparse accumulation of the per-thread derivatives, as in the
+   * AdvancedImageToImageMetric: the derivative blocks of 2^DerivativeBlockSizeLog2
+   * parameters that a thread did not touch are skipped in the accumulation.
+   * Used when the transform has fewer nonzero Jacobian indices than parameters.
+   */
+  itkStaticConstMacro( DerivativeBlockSizeLog2, unsigned int, 7 );
+  mutable bool m_UseSparseDerivativeAccumulation;
+
+  /** Mark the derivative blocks containing the nonzero Jacobian indices
+   * nzji[ 0 ], ..., nzji[ n - 1 ] as touched by this thread. */
+  void MarkTouchedDerivativeBlocks( const ThreadIdType threadId,
+    const unsigned long * nzji, const SizeValueType n ) const
+  {
+    if( !this->m_UseSparseDerivativeAccumulation )
+    {
+      return;
+    }
+    unsigned char * touched
+      = &( this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks[ 0 ] );
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      touched[ nzji[ i ] >> DerivativeBlockSizeLog2 ] = 1;
+    }
+  }
+
 
 private:
 
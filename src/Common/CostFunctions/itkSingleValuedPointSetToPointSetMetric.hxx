@@ -35,6 +35,7 @@
 #define __itkSingleValuedPointSetToPointSetMetric_hxx
 
 #include "itkSingleValuedPointSetToPointSetMetric.h"
+#include "vnl/vnl_math.h"
 
 namespace itk
 {
@@ -55,11 +56,34 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
 
   this->m_NumberOfPointsCounted = 0;
 
-  this->m_UseMetricSingleThreaded = true;
+  this->m_UseMetricSingleThreaded      = true;
+  this->m_SupportsConcurrentEvaluation = false;
+  this->m_UseMultiThread               = true;
+  this->m_NumberOfThreads              = ThreaderType::GetGlobalDefaultNumberOfThreads();
+
+  this->m_ThreaderMetricParameters.st_Metric              = this;
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = 0;
+  this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
+
+  this->m_GetValueAndDerivativePerThreadVariables     = 0;
+  this->m_GetValueAndDerivativePerThreadVariablesSize = 0;
+  this->m_UseSparseDerivativeAccumulation             = false;
 
 } // end Constructor
 
 
+/**
+ * ******************* Destructor ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::~SingleValuedPointSetToPointSetMetric()
+{
+  delete[] this->m_GetValueAndDerivativePerThreadVariables;
+} // end Destructor
+
+
 /**
  * ******************* SetTransformParameters ***********************
  */
@@ -135,6 +159,203 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
 } // end BeforeThreadedGetValueAndDerivative()
 
 
+/**
+ * *********************** GetNumberOfThreadsForPoints ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ThreadIdType
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::GetNumberOfThreadsForPoints( const SizeValueType numberOfPoints ) const
+{
+  if( !this->m_UseMultiThread )
+  {
+    return 1;
+  }
+
+  const SizeValueType maximumNumberOfThreads = numberOfPoints / MinimumNumberOfPointsPerThread;
+  if( maximumNumberOfThreads < 1 )
+  {
+    return 1;
+  }
+  return static_cast< ThreadIdType >( vnl_math_min(
+    maximumNumberOfThreads, static_cast< SizeValueType >( this->m_NumberOfThreads ) ) );
+
+} // end GetNumberOfThreadsForPoints()
+
+
+/**
+ * *********************** SplitRangeForThread ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::SplitRangeForThread( const SizeValueType size,
+  const ThreadIdType threadId, const ThreadIdType numberOfThreads,
+  SizeValueType & begin, SizeValueType & end ) const
+{
+  const SizeValueType chunkSize = ( size + numberOfThreads - 1 ) / numberOfThreads;
+  begin = vnl_math_min( size, threadId * chunkSize );
+  end   = vnl_math_min( size, begin + chunkSize );
+
+} // end SplitRangeForThread()
+
+
+/**
+ * *********************** InitializeThreadingParameters ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::InitializeThreadingParameters( const ThreadIdType numberOfThreads ) const
+{
+  /** Only resize the array of structs when needed. */
+  if( this->m_GetValueAndDerivativePerThreadVariablesSize < numberOfThreads )
+  {
+    delete[] this->m_GetValueAndDerivativePerThreadVariables;
+    this->m_GetValueAndDerivativePerThreadVariables     = new AlignedGetValueAndDerivativePerThreadStruct[ numberOfThreads ];
+    this->m_GetValueAndDerivativePerThreadVariablesSize = numberOfThreads;
+  }
+
+  /** Only track the touched derivative blocks when the derivative of a
+   * single point is sparse.
+   */
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  this->m_UseSparseDerivativeAccumulation
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices() < numberOfParameters;
+  const SizeValueType numberOfBlocks = this->m_UseSparseDerivativeAccumulation
+    ? ( ( numberOfParameters - 1 ) >> DerivativeBlockSizeLog2 ) + 1 : 0;
+
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    GetValueAndDerivativePerThreadStruct & perThread = this->m_GetValueAndDerivativePerThreadVariables[ i ];
+    perThread.st_NumberOfPointsCounted = NumericTraits< SizeValueType >::Zero;
+    perThread.st_Value                 = NumericTraits< MeasureType >::Zero;
+    if( perThread.st_Derivative.GetSize() != numberOfParameters )
+    {
+      perThread.st_Derivative.SetSize( numberOfParameters );
+      perThread.st_Derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    }
+    if( perThread.st_TouchedDerivativeBlocks.size() != numberOfBlocks )
+    {
+      perThread.st_TouchedDerivativeBlocks.assign( numberOfBlocks, 0 );
+    }
+  }
+
+} // end InitializeThreadingParameters()
+
+
+/**
+ * *********************** ExecuteThreaderCallback ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::ExecuteThreaderCallback( ThreadFunctionType callback, void * userData,
+  const ThreadIdType numberOfThreads ) const
+{
+  /** When the pool is in use, for example by a metric that evaluates this
+   * one concurrently, the callback is run serially in this thread.
+   */
+  ThreadPoolType::GetGlobalThreadPool()->SingleMethodExecute( callback, userData, numberOfThreads );
+
+} // end ExecuteThreaderCallback()
+
+
+/**
+ * *********************** AccumulateDerivativesThreaderCallback ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::AccumulateDerivativesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = temp->st_Metric;
+
+  /** The parameters are split between the threads at block boundaries, so
+   * that every block, and every touched flag, is owned by a single thread.
+   */
+  const bool         sparse    = metric->m_UseSparseDerivativeAccumulation;
+  const unsigned int blockSize = sparse ? ( 1u << DerivativeBlockSizeLog2 ) : 1024;
+  const unsigned int numPar    = metric->GetNumberOfParameters();
+  const unsigned int numBlocks = ( numPar + blockSize - 1 ) / blockSize;
+  const unsigned int subSize   = blockSize * ( ( numBlocks + nrOfThreads - 1 ) / nrOfThreads );
+  const unsigned int jmin      = vnl_math_min( numPar, threadID * subSize );
+  const unsigned int jmax      = vnl_math_min( numPar, ( threadID + 1 ) * subSize );
+
+  /** Accumulate the sub-derivatives one thread at a time per block, skipping
+   * the untouched blocks, and reset them for the next iteration.
+   */
+  const DerivativeValueType zero          = NumericTraits< DerivativeValueType >::Zero;
+  const DerivativeValueType normalization = 1.0 / temp->st_NormalizationFactor;
+  DerivativeValueType *     derivative    = temp->st_DerivativePointer;
+  for( unsigned int jb = jmin; jb < jmax; jb += blockSize )
+  {
+    const unsigned int je = ( jb + blockSize < jmax ) ? jb + blockSize : jmax;
+    for( unsigned int j = jb; j < je; ++j )
+    {
+      derivative[ j ] = zero;
+    }
+
+    bool touched = false;
+    for( ThreadIdType i = 0; i < nrOfThreads; ++i )
+    {
+      if( sparse )
+      {
+        unsigned char & flag
+          = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_TouchedDerivativeBlocks[ jb / blockSize ];
+        if( !flag )
+        {
+#ifndef NDEBUG
+          /** A thread that wrote to this block without marking it, i.e.
+           * without calling MarkTouchedDerivativeBlocks(), would silently
+           * lose its contributions here. */
+          const DerivativeValueType * untouched
+            = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.data_block();
+          for( unsigned int j = jb; j < je; ++j )
+          {
+            itkAssertInDebugAndIgnoreInReleaseMacro( untouched[ j ] == zero );
+          }
+#endif
+          continue;
+        }
+        flag = 0;
+      }
+      touched = true;
+
+      DerivativeValueType * subDerivative
+        = metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.data_block();
+      for( unsigned int j = jb; j < je; ++j )
+      {
+        derivative[ j ]   += subDerivative[ j ];
+        subDerivative[ j ] = zero;
+      }
+    }
+
+    if( touched )
+    {
+      for( unsigned int j = jb; j < je; ++j )
+      {
+        derivative[ j ] *= normalization;
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end AccumulateDerivativesThreaderCallback()
+
+
 /**
  * ******************* PrintSelf ***********************
  */
@@ -151,6 +372,8 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
   os << "Fixed mask: " << this->m_FixedImageMask.GetPointer() << std::endl;
   os << "Moving mask: " << this->m_MovingImageMask.GetPointer() << std::endl;
   os << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << "UseMultiThread: " << this->m_UseMultiThread << std::endl;
+  os << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
 
 } // end PrintSelf()
 
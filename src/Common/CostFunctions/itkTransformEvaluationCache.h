@@ -0,0 +1,241 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTransformEvaluationCache_h
+#define __itkTransformEvaluationCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+#include <vector>
+#include <cstring>
+
+namespace itk
+{
+
+/** \class TransformEvaluationCache
+ *
+ * \brief The transformed points and sparse Jacobians of a set of samples.
+ *
+ * When several metrics use the same samples and the same transform, as in
+ * the CombinationImageToImageMetric with a shared image sampler, they all
+ * transform the same points and evaluate the same Jacobians. This class
+ * stores the mapped points and, optionally, the Jacobians and nonzero
+ * Jacobian indices of the samples, so that they are computed only once per
+ * iteration. After Evaluate() has been called for all samples, the cache is
+ * read-only and can be used by several threads and metrics at once.
+ *
+ * The Jacobians are stored in the layout of AdvancedTransform::GetJacobians().
+ *
+ * \ingroup RegistrationMetrics
+ */
+
+template< class TTransform >
+class TransformEvaluationCache : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef TransformEvaluationCache   Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TransformEvaluationCache, Object );
+
+  /** Typedef's. */
+  typedef TTransform                                         TransformType;
+  typedef typename TransformType::ScalarType                 ScalarType;
+  typedef typename TransformType::InputPointType             InputPointType;
+  typedef typename TransformType::OutputPointType            OutputPointType;
+  typedef typename TransformType::JacobianType               JacobianType;
+  typedef typename TransformType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename TransformType::MovingImageGradientType    MovingImageGradientType;
+  typedef typename TransformType::DerivativeType             DerivativeType;
+  typedef std::vector< InputPointType >                      InputPointArrayType;
+
+  itkStaticConstMacro( OutputSpaceDimension, unsigned int, TransformType::OutputSpaceDimension );
+
+  /** Allocate the cache for numberOfSamples samples. The Jacobians are only
+   * stored when withJacobians is true. The input points should be filled
+   * in by the caller, see GetInputPoints().
+   */
+  void Resize( const SizeValueType numberOfSamples,
+    const SizeValueType numberOfNonZeroJacobianIndices, const bool withJacobians )
+  {
+    this->m_NumberOfNonZeroJacobianIndices = numberOfNonZeroJacobianIndices;
+    this->m_HasJacobians                   = withJacobians;
+    this->m_InputPoints.resize( numberOfSamples );
+    this->m_MappedPoints.resize( numberOfSamples );
+    const SizeValueType n = withJacobians ? numberOfSamples : 0;
+    this->m_NonZeroJacobianIndices.resize( n * numberOfNonZeroJacobianIndices );
+    this->m_Jacobians.resize( n * OutputSpaceDimension * numberOfNonZeroJacobianIndices );
+  }
+
+
+  /** The memory needed to store numberOfSamples samples, in bytes. */
+  static SizeValueType GetMemoryUsage( const SizeValueType numberOfSamples,
+    const SizeValueType numberOfNonZeroJacobianIndices, const bool withJacobians )
+  {
+    SizeValueType perSample = 2 * sizeof( InputPointType );
+    if( withJacobians )
+    {
+      perSample += numberOfNonZeroJacobianIndices
+        * ( sizeof( unsigned long ) + OutputSpaceDimension * sizeof( ScalarType ) );
+    }
+    return numberOfSamples * perSample;
+  }
+
+
+  /** Get the number of samples. */
+  SizeValueType Size( void ) const
+  {
+    return this->m_MappedPoints.size();
+  }
+
+
+  /** Whether the Jacobians are available. */
+  bool GetHasJacobians( void ) const
+  {
+    return this->m_HasJacobians;
+  }
+
+
+  /** Access to the points to be transformed. */
+  InputPointArrayType & GetInputPoints( void )
+  {
+    return this->m_InputPoints;
+  }
+
+
+  /** Transform the samples [begin, end[ and compute their Jacobians.
+   * Different ranges can be evaluated by different threads.
+   */
+  void Evaluate( const TransformType * transform,
+    const SizeValueType begin, const SizeValueType end )
+  {
+    if( end <= begin )
+    {
+      return;
+    }
+    transform->TransformPoints( &( this->m_InputPoints[ begin ] ), end - begin,
+      &( this->m_MappedPoints[ begin ] ) );
+    if( this->m_HasJacobians )
+    {
+      const SizeValueType nnzji = this->m_NumberOfNonZeroJacobianIndices;
+      transform->GetJacobians( &( this->m_InputPoints[ begin ] ), end - begin,
+        &( this->m_Jacobians[ begin * OutputSpaceDimension * nnzji ] ),
+        &( this->m_NonZeroJacobianIndices[ begin * nnzji ] ) );
+    }
+  }
+
+
+  /** Get the mapped point of sample i. */
+  const OutputPointType & GetMappedPoint( const SizeValueType i ) const
+  {
+    return this->m_MappedPoints[ i ];
+  }
+
+
+  /** Copy the Jacobian of sample i, which should have the right size. */
+  void GetJacobian( const SizeValueType i, JacobianType & jacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+  {
+    const SizeValueType nnzji = this->m_NumberOfNonZeroJacobianIndices;
+    std::memcpy( jacobian.data_block(),
+      &( this->m_Jacobians[ i * OutputSpaceDimension * nnzji ] ),
+      OutputSpaceDimension * nnzji * sizeof( ScalarType ) );
+    this->GetNonZeroJacobianIndices( i, nonZeroJacobianIndices );
+  }
+
+
+  /** Compute the inner product of the Jacobian of sample i and the moving
+   * image gradient, see AdvancedTransform::EvaluateJacobianWithImageGradientProduct().
+   * The imageJacobian should have the right size.
+   */
+  void EvaluateJacobianWithImageGradientProduct( const SizeValueType i,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+  {
+    const SizeValueType nnzji = this->m_NumberOfNonZeroJacobianIndices;
+    const ScalarType *  jac   = &( this->m_Jacobians[ i * OutputSpaceDimension * nnzji ] );
+    for( SizeValueType mu = 0; mu < nnzji; ++mu )
+    {
+      imageJacobian[ mu ] = jac[ mu ] * movingImageGradient[ 0 ];
+    }
+    for( unsigned int d = 1; d < OutputSpaceDimension; ++d )
+    {
+      jac += nnzji;
+      for( SizeValueType mu = 0; mu < nnzji; ++mu )
+      {
+        imageJacobian[ mu ] += jac[ mu ] * movingImageGradient[ d ];
+      }
+    }
+    this->GetNonZeroJacobianIndices( i, nonZeroJacobianIndices );
+  }
+
+
+protected:
+
+  TransformEvaluationCache() :
+    m_NumberOfNonZeroJacobianIndices( 0 ),
+    m_HasJacobians( false )
+  {}
+
+  virtual ~TransformEvaluationCache() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const
+  {
+    Superclass::PrintSelf( os, indent );
+    os << indent << "Size: " << this->Size() << std::endl;
+    os << indent << "HasJacobians: " << this->m_HasJacobians << std::endl;
+  }
+
+
+  /** Copy the nonzero Jacobian indices of sample i. */
+  void GetNonZeroJacobianIndices( const SizeValueType i,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+  {
+    const SizeValueType   nnzji = this->m_NumberOfNonZeroJacobianIndices;
+    const unsigned long * nzji  = &( this->m_NonZeroJacobianIndices[ i * nnzji ] );
+    nonZeroJacobianIndices.assign( nzji, nzji + nnzji );
+  }
+
+
+private:
+
+  TransformEvaluationCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );           // purposely not implemented
+
+  SizeValueType                  m_NumberOfNonZeroJacobianIndices;
+  bool                           m_HasJacobians;
+  InputPointArrayType            m_InputPoints;
+  std::vector< OutputPointType > m_MappedPoints;
+  std::vector< unsigned long >   m_NonZeroJacobianIndices;
+  std::vector< ScalarType >      m_Jacobians;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTransformEvaluationCache_h
@@ -30,6 +30,11 @@ namespace itk
  * If a mask is given: only those voxels within the mask AND the
  * InputImageRegion.
  *
+ * The region is always split in slabs that are sampled multi-threaded.
+ * Since the samples of the slabs are merged in order, the output does not
+ * depend on the number of threads. Along a line the physical point is
+ * updated incrementally, instead of being computed for every voxel.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -20,7 +20,7 @@
 
 #include "itkImageFullSampler.h"
 
-#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageLinearConstIteratorWithIndex.h"
 
 namespace itk
 {
@@ -34,98 +34,18 @@ void
 ImageFullSampler< TInputImage >
 ::GenerateData( void )
 {
-  /** If desired we exercise a multi-threaded version. */
-  if( this->m_UseMultiThread )
-  {
-    /** Calls ThreadedGenerateData(). */
-    return Superclass::GenerateData();
-  }
-
-  /** Get handles to the input image, output sample container, and the mask. */
-  InputImageConstPointer inputImage = this->GetInput();
-  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
-  typename MaskType::ConstPointer mask                       = this->GetMask();
-
   /** Clear the container. */
-  sampleContainer->Initialize();
-
-  /** Set up a region iterator within the user specified image region. */
-  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
-  InputImageIterator iter( inputImage, this->GetCroppedInputImageRegion() );
-
-  /** Fill the sample container. */
-  if( mask.IsNull() )
-  {
-    /** Try to reserve memory. If no mask is used this can raise std
-     * exceptions when the input image is large.
-     */
-    try
-    {
-      sampleContainer->Reserve( this->GetCroppedInputImageRegion()
-        .GetNumberOfPixels() );
-    }
-    catch( std::exception & excp )
-    {
-      std::string message = "std: ";
-      message += excp.what();
-      message += "\nERROR: failed to allocate memory for the sample container.";
-      const char * message2 = message.c_str();
-      itkExceptionMacro( << message2 );
-    }
-    catch( ... )
-    {
-      itkExceptionMacro( << "ERROR: failed to allocate memory for the sample container." );
-    }
-
-    /** Simply loop over the image and store all samples in the container. */
-    ImageSampleType tempSample;
-    unsigned long   ind = 0;
-    for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter, ++ind )
-    {
-      /** Get sampled index */
-      InputImageIndexType index = iter.GetIndex();
-
-      /** Translate index to point */
-      inputImage->TransformIndexToPhysicalPoint( index,
-        tempSample.m_ImageCoordinates );
-
-      /** Get sampled image value */
-      tempSample.m_ImageValue = iter.Get();
+  this->GetOutput()->Initialize();
 
-      /** Store in container */
-      sampleContainer->SetElement( ind, tempSample );
-
-    } // end for
-  }   // end if no mask
-  else
+  /** Make sure the mask is up-to-date before the threads use it. */
+  typename MaskType::ConstPointer mask = this->GetMask();
+  if( mask.IsNotNull() && mask->GetSource() )
   {
-    if( mask->GetSource() )
-    {
-      mask->GetSource()->Update();
-    }
-
-    /** Loop over the image and check if the points falls within the mask. */
-    ImageSampleType tempSample;
-    for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter )
-    {
-      /** Get sampled index. */
-      InputImageIndexType index = iter.GetIndex();
-
-      /** Translate index to point. */
-      inputImage->TransformIndexToPhysicalPoint( index,
-        tempSample.m_ImageCoordinates );
-
-      if( mask->IsInside( tempSample.m_ImageCoordinates ) )
-      {
-        /** Get sampled image value. */
-        tempSample.m_ImageValue = iter.Get();
-
-        /** Store in container. */
-        sampleContainer->push_back( tempSample );
+    mask->GetSource()->Update();
+  }
 
-      } // end if
-    }   // end for
-  }     // end else (if mask exists)
+  /** Calls ThreadedGenerateData(), and merges the results in order. */
+  Superclass::GenerateData();
 
 } // end GenerateData()
 
@@ -146,18 +66,21 @@ ImageFullSampler< TInputImage >
   ImageSampleContainerPointer & sampleContainerThisThread // & ???
     = this->m_ThreaderSampleContainer[ threadId ];
 
-  /** Set up a region iterator within the user specified image region. */
-  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
-  //InputImageIterator iter( inputImage, this->GetCroppedInputImageRegion() );
-  InputImageIterator iter( inputImage, inputRegionForThread );
+  /** The split is done on the requested region. Only sample the part
+   * that lies within the user specified image region.
+   */
+  InputImageRegionType region = inputRegionForThread;
+  if( !region.Crop( this->GetCroppedInputImageRegion() ) )
+  {
+    return;
+  }
 
-  /** Fill the sample container. */
-  const unsigned long chunkSize = inputRegionForThread.GetNumberOfPixels();
+  /** Try to reserve memory. If no mask is used this can raise std
+   * exceptions when the input image is large.
+   */
+  const unsigned long chunkSize = region.GetNumberOfPixels();
   if( mask.IsNull() )
   {
-    /** Try to reserve memory. If no mask is used this can raise std
-     * exceptions when the input image is large.
-     */
     try
     {
       sampleContainerThisThread->Reserve( chunkSize );
@@ -174,56 +97,52 @@ ImageFullSampler< TInputImage >
     {
       itkExceptionMacro( << "ERROR: failed to allocate memory for the sample container." );
     }
+  }
 
-    /** Simply loop over the image and store all samples in the container. */
-    ImageSampleType tempSample;
-    unsigned long   ind = 0;
-    for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter, ++ind )
-    {
-      /** Get sampled index */
-      InputImageIndexType index = iter.GetIndex();
-
-      /** Translate index to point */
-      inputImage->TransformIndexToPhysicalPoint( index,
-        tempSample.m_ImageCoordinates );
-
-      /** Get sampled image value */
-      tempSample.m_ImageValue = iter.Get();
+  /** The physical step between two neighbouring voxels along a line. */
+  InputImageIndexType index = region.GetIndex();
+  InputImagePointType point;
+  InputImagePointType nextPoint;
+  inputImage->TransformIndexToPhysicalPoint( index, point );
+  ++index[ 0 ];
+  inputImage->TransformIndexToPhysicalPoint( index, nextPoint );
+  const typename InputImagePointType::VectorType step = nextPoint - point;
 
-      /** Store in container. */
-      sampleContainerThisThread->SetElement( ind, tempSample );
+  /** Set up a line iterator within the region of this thread. */
+  typedef ImageLinearConstIteratorWithIndex< InputImageType > InputImageIterator;
+  InputImageIterator iter( inputImage, region );
+  iter.SetDirection( 0 );
 
-    } // end for
-  }   // end if no mask
-  else
+  /** Fill the sample container. */
+  ImageSampleType tempSample;
+  unsigned long   ind = 0;
+  for( iter.GoToBegin(); !iter.IsAtEnd(); iter.NextLine() )
   {
-    if( mask->GetSource() )
-    {
-      mask->GetSource()->Update();
-    }
+    /** Translate the first index of the line to a point. */
+    inputImage->TransformIndexToPhysicalPoint( iter.GetIndex(),
+      tempSample.m_ImageCoordinates );
 
-    /** Loop over the image and check if the points falls within the mask. */
-    ImageSampleType tempSample;
-    for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter )
+    while( !iter.IsAtEndOfLine() )
     {
-      /** Get sampled index. */
-      InputImageIndexType index = iter.GetIndex();
-
-      /** Translate index to point. */
-      inputImage->TransformIndexToPhysicalPoint( index,
-        tempSample.m_ImageCoordinates );
-
-      if( mask->IsInside( tempSample.m_ImageCoordinates ) )
+      if( mask.IsNull() )
       {
-        /** Get sampled image value. */
+        /** Get sampled image value, and store in container. */
+        tempSample.m_ImageValue = iter.Get();
+        sampleContainerThisThread->SetElement( ind, tempSample );
+        ++ind;
+      }
+      else if( mask->IsInside( tempSample.m_ImageCoordinates ) )
+      {
+        /** Get sampled image value, and store in container. */
         tempSample.m_ImageValue = iter.Get();
-
-        /**  Store in container. */
         sampleContainerThisThread->push_back( tempSample );
+      }
 
-      } // end if
-    }   // end for
-  }     // end else (if mask exists)
+      /** Jump to the next point on the line. */
+      tempSample.m_ImageCoordinates += step;
+      ++iter;
+    }
+  }
 
 } // end ThreadedGenerateData()
 
@@ -31,6 +31,10 @@ namespace itk
  * The grid can be specified by an integer downsampling factor for
  * each dimension.
  *
+ * The grid is split in slabs that are sampled multi-threaded, and merged
+ * in order, so the output does not depend on the number of threads. Along
+ * a grid line the physical point is updated incrementally.
+ *
  * \parameter SampleGridSpacing: This parameter controls the spacing
  *    of the uniform grid in all dimensions. This should be given in
  *    index coordinates. \n
@@ -145,12 +149,23 @@ protected:
   /** Function that does the work. */
   virtual void GenerateData( void );
 
+  /** Multi-threaded function that does the work. */
+  virtual void ThreadedGenerateData(
+    const InputImageRegionType & inputRegionForThread,
+    ThreadIdType threadId );
+
   /** An array of integer spacing factors */
   SampleGridSpacingType m_SampleGridSpacing;
 
   /** The number of samples entered in the SetNumberOfSamples method */
   unsigned long m_RequestedNumberOfSamples;
 
+  /** The first grid position and the number of grid positions, for each
+   * dimension. Computed in GenerateData().
+   */
+  SampleGridIndexType m_SampleGridIndex;
+  SampleGridSizeType  m_SampleGridSize;
+
 private:
 
   /** The private constructor. */
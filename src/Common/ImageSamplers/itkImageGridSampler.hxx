@@ -20,7 +20,7 @@
 
 #include "itkImageGridSampler.h"
 
-#include "itkImageRegionConstIteratorWithIndex.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -35,6 +35,8 @@ ImageGridSampler< TInputImage >
 {
   this->m_SampleGridSpacing.Fill( 1 );
   this->m_RequestedNumberOfSamples = 0;
+  this->m_SampleGridIndex.Fill( 0 );
+  this->m_SampleGridSize.Fill( 0 );
   this->m_SampleGridSpacing.Fill( static_cast< SampleGridSpacingValueType >( 0.0 ) );
 } // end Constructor
 
@@ -66,156 +68,146 @@ void
 ImageGridSampler< TInputImage >
 ::GenerateData( void )
 {
-  /** Get handles to the input image, output sample container, and the mask. */
-  InputImageConstPointer inputImage = this->GetInput();
-  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
-  typename MaskType::ConstPointer mask                       = this->GetMask();
-
   /** Clear the container. */
-  sampleContainer->Initialize();
-
-  /** Set up a region iterator within the user specified image region. */
-  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
-  InputImageIterator iter( inputImage, this->GetCroppedInputImageRegion() );
+  this->GetOutput()->Initialize();
 
   /** Take into account the possibility of a smaller bounding box around the mask */
   this->SetNumberOfSamples( this->m_RequestedNumberOfSamples );
 
   /** Determine the grid. */
-  SampleGridIndexType index;
-  SampleGridSizeType  sampleGridSize;
-  SampleGridIndexType sampleGridIndex
-    = this->GetCroppedInputImageRegion().GetIndex();
+  this->m_SampleGridIndex = this->GetCroppedInputImageRegion().GetIndex();
   const InputImageSizeType & inputImageSize
     = this->GetCroppedInputImageRegion().GetSize();
-  unsigned long numberOfSamplesOnGrid = 1;
   for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
   {
     /** The number of sample point along one dimension. */
-    sampleGridSize[ dim ] = 1
+    this->m_SampleGridSize[ dim ] = 1
       + ( ( inputImageSize[ dim ] - 1 ) / this->GetSampleGridSpacing()[ dim ] );
 
     /** The position of the first sample along this dimension is
      * chosen to center the grid nicely on the input image region.
      */
-    sampleGridIndex[ dim ] += ( inputImageSize[ dim ]
-      - ( ( sampleGridSize[ dim ] - 1 ) * this->GetSampleGridSpacing()[ dim ] + 1 ) ) / 2;
+    this->m_SampleGridIndex[ dim ] += ( inputImageSize[ dim ]
+      - ( ( this->m_SampleGridSize[ dim ] - 1 ) * this->GetSampleGridSpacing()[ dim ] + 1 ) ) / 2;
+  }
 
-    /** Update the number of samples on the grid. */
-    numberOfSamplesOnGrid *= sampleGridSize[ dim ];
+  /** Make sure the mask is up-to-date before the threads use it. */
+  typename MaskType::ConstPointer mask = this->GetMask();
+  if( mask.IsNotNull() && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
   }
 
-  /** Prepare for looping over the grid. */
-  unsigned int dim_z = 1;
-  unsigned int dim_t = 1;
-  if( InputImageDimension > 2 )
+  /** Calls ThreadedGenerateData(), and merges the results in order. */
+  Superclass::GenerateData();
+
+} // end GenerateData()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageGridSampler< TInputImage >
+::ThreadedGenerateData( const InputImageRegionType & inputRegionForThread,
+  ThreadIdType threadId )
+{
+  /** Get handles to the input image, mask and the output. */
+  InputImageConstPointer inputImage = this->GetInput();
+  typename MaskType::ConstPointer mask = this->GetMask();
+  ImageSampleContainerPointer & sampleContainerThisThread
+    = this->m_ThreaderSampleContainer[ threadId ];
+
+  /** The split is done on the requested region. Only sample the part
+   * that lies within the user specified image region.
+   */
+  InputImageRegionType region = inputRegionForThread;
+  if( !region.Crop( this->GetCroppedInputImageRegion() ) )
   {
-    dim_z = sampleGridSize[ 2 ];
-    if( InputImageDimension > 3 )
+    return;
+  }
+
+  /** Determine the grid positions that lie within the region of this thread. */
+  SampleGridIndexType firstIndex;
+  SampleGridSizeType  gridSize;
+  unsigned long       numberOfSamples = 1;
+  for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+  {
+    const SampleGridSpacingValueType spacing = this->m_SampleGridSpacing[ dim ];
+    const SampleGridSpacingValueType begin
+      = region.GetIndex()[ dim ] - this->m_SampleGridIndex[ dim ];
+    const SampleGridSpacingValueType end
+      = begin + static_cast< SampleGridSpacingValueType >( region.GetSize()[ dim ] );
+    const SampleGridSpacingValueType firstPosition
+      = begin <= 0 ? 0 : ( begin + spacing - 1 ) / spacing;
+    const SampleGridSpacingValueType endPosition = end <= 0 ? 0
+      : std::min( static_cast< SampleGridSpacingValueType >( this->m_SampleGridSize[ dim ] ),
+      ( end - 1 ) / spacing + 1 );
+    if( endPosition <= firstPosition )
     {
-      dim_t = sampleGridSize[ 3 ];
+      return;
     }
+    firstIndex[ dim ] = this->m_SampleGridIndex[ dim ] + firstPosition * spacing;
+    gridSize[ dim ]   = endPosition - firstPosition;
+    numberOfSamples  *= gridSize[ dim ];
   }
-  index = sampleGridIndex;
-
   if( mask.IsNull() )
   {
-    /** Ugly loop over the grid. */
-    for( unsigned int t = 0; t < dim_t; t++ )
+    sampleContainerThisThread->reserve( numberOfSamples );
+  }
+
+  /** The physical step between two neighbouring grid positions along a line. */
+  SampleGridIndexType index = firstIndex;
+  InputImagePointType point;
+  InputImagePointType nextPoint;
+  inputImage->TransformIndexToPhysicalPoint( index, point );
+  index[ 0 ] += this->m_SampleGridSpacing[ 0 ];
+  inputImage->TransformIndexToPhysicalPoint( index, nextPoint );
+  const typename InputImagePointType::VectorType step = nextPoint - point;
+
+  /** Loop over the grid lines; checks also if a sample falls within the mask. */
+  const unsigned long numberOfLines = numberOfSamples / gridSize[ 0 ];
+  ImageSampleType     tempsample;
+  index = firstIndex;
+  for( unsigned long line = 0; line < numberOfLines; ++line )
+  {
+    // Translate the first index of the line to a point.
+    inputImage->TransformIndexToPhysicalPoint(
+      index, tempsample.m_ImageCoordinates );
+
+    for( unsigned long x = 0; x < gridSize[ 0 ]; ++x )
     {
-      for( unsigned int z = 0; z < dim_z; z++ )
+      if( mask.IsNull() || mask->IsInside( tempsample.m_ImageCoordinates ) )
       {
-        for( unsigned int y = 0; y < sampleGridSize[ 1 ]; y++ )
-        {
-          for( unsigned int x = 0; x < sampleGridSize[ 0 ]; x++ )
-          {
-            ImageSampleType tempsample;
-
-            // Get sampled fixed image value.
-            tempsample.m_ImageValue = inputImage->GetPixel( index );
-
-            // Translate index to point.
-            inputImage->TransformIndexToPhysicalPoint(
-              index, tempsample.m_ImageCoordinates );
-
-            // Jump to next position on grid.
-            index[ 0 ] += this->m_SampleGridSpacing[ 0 ];
-
-            // Store sample in container.
-            sampleContainer->push_back( tempsample );
-
-          } // end x
-          index[ 0 ]  = sampleGridIndex[ 0 ];
-          index[ 1 ] += this->m_SampleGridSpacing[ 1 ];
-
-        } // end y
-        if( InputImageDimension > 2 )
-        {
-          index[ 1 ]  = sampleGridIndex[ 1 ];
-          index[ 2 ] += this->m_SampleGridSpacing[ 2 ];
-        }
-      } // end z
-      if( InputImageDimension > 3 )
-      {
-        index[ 2 ]  = sampleGridIndex[ 2 ];
-        index[ 3 ] += this->m_SampleGridSpacing[ 3 ];
+        // Get sampled fixed image value.
+        tempsample.m_ImageValue = inputImage->GetPixel( index );
+
+        // Store sample in container.
+        sampleContainerThisThread->push_back( tempsample );
       }
-    } // end t
 
-  } // end if no mask
-  else
-  {
-    if( mask->GetSource() )
-    {
-      mask->GetSource()->Update();
+      // Jump to next position on grid.
+      index[ 0 ]                    += this->m_SampleGridSpacing[ 0 ];
+      tempsample.m_ImageCoordinates += step;
     }
-    /* Ugly loop over the grid; checks also if a sample falls within the mask. */
-    for( unsigned int t = 0; t < dim_t; t++ )
+
+    // Jump to the next grid line.
+    index[ 0 ] = firstIndex[ 0 ];
+    for( unsigned int dim = 1; dim < InputImageDimension; dim++ )
     {
-      for( unsigned int z = 0; z < dim_z; z++ )
+      index[ dim ] += this->m_SampleGridSpacing[ dim ];
+      if( index[ dim ] < static_cast< typename SampleGridIndexType::IndexValueType >(
+        firstIndex[ dim ] + gridSize[ dim ] * this->m_SampleGridSpacing[ dim ] ) )
       {
-        for( unsigned int y = 0; y < sampleGridSize[ 1 ]; y++ )
-        {
-          for( unsigned int x = 0; x < sampleGridSize[ 0 ]; x++ )
-          {
-            ImageSampleType tempsample;
-
-            // Translate index to point.
-            inputImage->TransformIndexToPhysicalPoint(
-              index, tempsample.m_ImageCoordinates );
-
-            if( mask->IsInside( tempsample.m_ImageCoordinates ) )
-            {
-              // Get sampled fixed image value.
-              tempsample.m_ImageValue = inputImage->GetPixel( index );
-
-              // Store sample in container.
-              sampleContainer->push_back( tempsample );
-
-            } // end if in mask
-              // Jump to next position on grid
-            index[ 0 ] += this->m_SampleGridSpacing[ 0 ];
-
-          } // end x
-          index[ 0 ]  = sampleGridIndex[ 0 ];
-          index[ 1 ] += this->m_SampleGridSpacing[ 1 ];
-
-        } // end y
-        if( InputImageDimension > 2 )
-        {
-          index[ 1 ]  = sampleGridIndex[ 1 ];
-          index[ 2 ] += this->m_SampleGridSpacing[ 2 ];
-        }
-      } // end z
-      if( InputImageDimension > 3 )
-      {
-        index[ 2 ]  = sampleGridIndex[ 2 ];
-        index[ 3 ] += this->m_SampleGridSpacing[ 3 ];
+        break;
       }
-    } // end t
-  }   // else (if mask exists)
+      index[ dim ] = firstIndex[ dim ];
+    }
+  }
 
-} // end GenerateData()
+} // end ThreadedGenerateData()
 
 
 /**
@@ -0,0 +1,178 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageImportanceSampler_h
+#define __ImageImportanceSampler_h
+
+#include "itkImageRandomSamplerBase.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include <vector>
+
+namespace itk
+{
+/** \class ImageImportanceSampler
+ *
+ * \brief Samples voxels of an image with a probability that increases with
+ * the gradient magnitude of the image.
+ *
+ * In homogeneous regions of the fixed image the samples contribute almost
+ * nothing to the metric derivative. This sampler therefore draws voxel \f$i\f$
+ * with probability
+ * \f[ q_i \propto (1-\alpha) \bar{g} + \alpha g_i, \f]
+ * where \f$g_i\f$ is the gradient magnitude at the voxel (central differences,
+ * in physical units), \f$\bar{g}\f$ its mean over the voxels inside the mask,
+ * and \f$1-\alpha\f$ the UniformFraction. The uniform part keeps the
+ * probability of every voxel away from zero, which bounds the weights.
+ *
+ * The probability map and an alias table (Vose) are built once for every
+ * input image, mask and region, so in a registration once per resolution.
+ * Drawing a sample then takes constant time.
+ *
+ * To keep the metric an unbiased estimate of the uniformly sampled metric,
+ * every sample gets the weight \f$w_i = 1 / ( n q_i )\f$, with \f$n\f$ the
+ * number of voxels inside the mask, see GetSampleWeights(). The weights are
+ * normalized to mean one over the drawn sample set, so that metrics may
+ * keep dividing by the number of samples. Only metrics that apply the
+ * weights can be used with this sampler.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TInputImage >
+class ImageImportanceSampler :
+  public ImageRandomSamplerBase< TInputImage >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageImportanceSampler                Self;
+  typedef ImageRandomSamplerBase< TInputImage > Superclass;
+  typedef SmartPointer< Self >                  Pointer;
+  typedef SmartPointer< const Self >            ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageImportanceSampler, ImageRandomSamplerBase );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::DataObjectPointer            DataObjectPointer;
+  typedef typename Superclass::OutputVectorContainerType    OutputVectorContainerType;
+  typedef typename Superclass::OutputVectorContainerPointer OutputVectorContainerPointer;
+  typedef typename Superclass::InputImageType               InputImageType;
+  typedef typename Superclass::InputImagePointer            InputImagePointer;
+  typedef typename Superclass::InputImageConstPointer       InputImageConstPointer;
+  typedef typename Superclass::InputImageRegionType         InputImageRegionType;
+  typedef typename Superclass::InputImagePixelType          InputImagePixelType;
+  typedef typename Superclass::ImageSampleType              ImageSampleType;
+  typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
+  typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::SampleWeightContainerType    SampleWeightContainerType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int,
+    Superclass::InputImageDimension );
+
+  /** Other typdefs. */
+  typedef typename InputImageType::IndexType InputImageIndexType;
+  typedef typename InputImageType::PointType InputImagePointType;
+
+  /** The random number generator used to draw the samples. */
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+  typedef typename RandomGeneratorType::Pointer                  RandomGeneratorPointer;
+
+  /** Set/Get the fraction \f$1-\alpha\f$ of the probability that is spread
+   * uniformly over the voxels, in [0, 1]. With 1 this sampler draws like the
+   * ImageRandomSampler. Default: 0.1.
+   */
+  itkSetClampMacro( UniformFraction, double, 0.0, 1.0 );
+  itkGetConstMacro( UniformFraction, double );
+
+  /** This sampler does not support sample prefetching. */
+  virtual bool SamplePrefetchingSupported( void ) const
+  {
+    return false;
+  }
+
+
+protected:
+
+  /** The voxels inside the mask, as offsets in the cropped region. */
+  typedef unsigned int                    VoxelOffsetType;
+  typedef std::vector< VoxelOffsetType >  VoxelOffsetContainerType;
+  typedef typename MaskType::ConstPointer MaskConstPointer;
+
+  /** The constructor. */
+  ImageImportanceSampler();
+  /** The destructor. */
+  virtual ~ImageImportanceSampler() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Function that does the work. */
+  virtual void GenerateData( void );
+
+  /** Build the probability map and the alias table, if out of date. */
+  virtual void UpdateAliasTable( void );
+
+  /** The gradient magnitude of the input image at an index, by central
+   * differences, which become one-sided at the border of the buffered region.
+   */
+  double ComputeGradientMagnitude( const InputImageIndexType & index ) const;
+
+  /** Convert an offset in the cropped region to an index. */
+  void ComputeIndex( const VoxelOffsetType offset, InputImageIndexType & index ) const;
+
+  RandomGeneratorPointer m_RandomGenerator;
+  double                 m_UniformFraction;
+
+  /** The alias table: the voxels, n times their probability, and for every
+   * column the threshold below which the column's own voxel is taken and
+   * the voxel that is taken otherwise.
+   */
+  VoxelOffsetContainerType m_VoxelOffsets;
+  std::vector< float >     m_ScaledProbabilities;
+  std::vector< float >     m_AliasThresholds;
+  VoxelOffsetContainerType m_AliasIndices;
+
+  /** What the alias table was built for. */
+  const InputImageType * m_AliasTableInput;
+  ModifiedTimeType       m_AliasTableInputMTime;
+  const MaskType *       m_AliasTableMask;
+  ModifiedTimeType       m_AliasTableMaskMTime;
+  InputImageRegionType   m_AliasTableRegion;
+  double                 m_AliasTableUniformFraction;
+
+private:
+
+  /** The private constructor. */
+  ImageImportanceSampler( const Self & );  // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );          // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageImportanceSampler.hxx"
+#endif
+
+#endif // end #ifndef __ImageImportanceSampler_h
@@ -0,0 +1,346 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageImportanceSampler_hxx
+#define __ImageImportanceSampler_hxx
+
+#include "itkImageImportanceSampler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage >
+ImageImportanceSampler< TInputImage >
+::ImageImportanceSampler()
+{
+  /** Setup random generator. */
+  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+  this->m_UniformFraction = 0.1;
+
+  this->m_AliasTableInput           = 0;
+  this->m_AliasTableInputMTime      = 0;
+  this->m_AliasTableMask            = 0;
+  this->m_AliasTableMaskMTime       = 0;
+  this->m_AliasTableUniformFraction = 0.0;
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageImportanceSampler< TInputImage >
+::GenerateData( void )
+{
+  /** Get a handle to the output sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetOutput();
+
+  /** Clear the container and the weights. */
+  sampleContainer->Initialize();
+  this->m_SampleWeights.clear();
+
+  /** Make sure the alias table is up-to-date. */
+  this->UpdateAliasTable();
+  const unsigned long numberOfVoxels = this->m_VoxelOffsets.size();
+  if( numberOfVoxels == 0 )
+  {
+    itkExceptionMacro( << "ERROR: the mask does not contain any voxel of the input image region." );
+  }
+
+  /** Draw the samples from the alias table: a uniform column, and then
+   * either the column's own voxel or its alias. Drawing is cheap compared
+   * to evaluating the metric, so it is not multi-threaded.
+   */
+  const unsigned long    numberOfSamples = this->GetNumberOfSamples();
+  const InputImageType * inputImage      = this->m_AliasTableInput;
+  sampleContainer->Reserve( numberOfSamples );
+  this->m_SampleWeights.resize( numberOfSamples );
+  double              sumOfWeights = 0.0;
+  InputImageIndexType index;
+  for( unsigned long i = 0; i < numberOfSamples; ++i )
+  {
+    const double  u      = this->m_RandomGenerator->GetVariateWithOpenUpperRange() * numberOfVoxels;
+    unsigned long column = std::min( static_cast< unsigned long >( u ), numberOfVoxels - 1 );
+    if( u - column >= this->m_AliasThresholds[ column ] )
+    {
+      column = this->m_AliasIndices[ column ];
+    }
+
+    ImageSampleType & sample = sampleContainer->ElementAt( i );
+    this->ComputeIndex( this->m_VoxelOffsets[ column ], index );
+    inputImage->TransformIndexToPhysicalPoint( index, sample.m_ImageCoordinates );
+    sample.m_ImageValue = inputImage->GetPixel( index );
+
+    /** The weight 1 / ( n q ) corrects for the sampling probability q. */
+    this->m_SampleWeights[ i ] = 1.0 / this->m_ScaledProbabilities[ column ];
+    sumOfWeights              += this->m_SampleWeights[ i ];
+  }
+
+  /** Normalize the weights to mean one. */
+  if( sumOfWeights > 0.0 )
+  {
+    const double normalization = numberOfSamples / sumOfWeights;
+    for( unsigned long i = 0; i < numberOfSamples; ++i )
+    {
+      this->m_SampleWeights[ i ] *= normalization;
+    }
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ******************* UpdateAliasTable *******************
+ */
+
+template< class TInputImage >
+void
+ImageImportanceSampler< TInputImage >
+::UpdateAliasTable( void )
+{
+  InputImageConstPointer inputImage = this->GetInput();
+  MaskConstPointer       mask       = this->GetMask();
+  if( mask.IsNotNull() && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Check if the table is still up-to-date. */
+  const InputImageRegionType & region = this->GetCroppedInputImageRegion();
+  if( this->m_AliasTableInput == inputImage.GetPointer()
+    && this->m_AliasTableInputMTime == inputImage->GetMTime()
+    && this->m_AliasTableMask == mask.GetPointer()
+    && ( mask.IsNull() || this->m_AliasTableMaskMTime == mask->GetMTime() )
+    && this->m_AliasTableRegion == region
+    && this->m_AliasTableUniformFraction == this->m_UniformFraction )
+  {
+    return;
+  }
+
+  /** The offsets are stored in 32 bits. */
+  if( region.GetNumberOfPixels() > NumericTraits< VoxelOffsetType >::max() )
+  {
+    itkExceptionMacro( << "ERROR: the input image region is too large for this sampler. "
+                       << "Consider using the ImageRandomSampler instead." );
+  }
+
+  this->m_AliasTableInput = 0;
+  this->m_AliasTableRegion = region;
+  this->m_VoxelOffsets.clear();
+  this->m_ScaledProbabilities.clear();
+  this->m_AliasThresholds.clear();
+  this->m_AliasIndices.clear();
+
+  try
+  {
+    /** Collect the voxels inside the mask and their gradient magnitudes. */
+    std::vector< double > gradientMagnitudes;
+    InputImageIndexType   index;
+    InputImagePointType   point;
+    const unsigned long   numberOfPixels = region.GetNumberOfPixels();
+    for( unsigned long offset = 0; offset < numberOfPixels; ++offset )
+    {
+      this->ComputeIndex( static_cast< VoxelOffsetType >( offset ), index );
+      if( mask.IsNotNull() )
+      {
+        inputImage->TransformIndexToPhysicalPoint( index, point );
+        if( !mask->IsInside( point ) )
+        {
+          continue;
+        }
+      }
+      this->m_VoxelOffsets.push_back( static_cast< VoxelOffsetType >( offset ) );
+      gradientMagnitudes.push_back( this->ComputeGradientMagnitude( index ) );
+    }
+
+    const std::size_t numberOfVoxels = this->m_VoxelOffsets.size();
+    if( numberOfVoxels > 0 )
+    {
+      /** Compute n times the probabilities, which have mean one. For an image
+       * without any gradient all voxels are equally likely.
+       */
+      double meanGradientMagnitude = 0.0;
+      for( std::size_t i = 0; i < numberOfVoxels; ++i )
+      {
+        meanGradientMagnitude += gradientMagnitudes[ i ];
+      }
+      meanGradientMagnitude /= numberOfVoxels;
+
+      const double alpha = meanGradientMagnitude > 0.0 ? 1.0 - this->m_UniformFraction : 0.0;
+      std::vector< double > scaled( numberOfVoxels, 1.0 );
+      if( alpha > 0.0 )
+      {
+        for( std::size_t i = 0; i < numberOfVoxels; ++i )
+        {
+          scaled[ i ] = ( 1.0 - alpha ) + alpha * gradientMagnitudes[ i ] / meanGradientMagnitude;
+        }
+      }
+      gradientMagnitudes.clear();
+      this->m_ScaledProbabilities.assign( scaled.begin(), scaled.end() );
+
+      /** Build the alias table with the method of Vose: pair every column
+       * with a probability below one with a column above one.
+       */
+      this->m_AliasThresholds.assign( numberOfVoxels, 1.0f );
+      this->m_AliasIndices.resize( numberOfVoxels );
+      VoxelOffsetContainerType smallColumns;
+      VoxelOffsetContainerType largeColumns;
+      for( std::size_t i = 0; i < numberOfVoxels; ++i )
+      {
+        this->m_AliasIndices[ i ] = static_cast< VoxelOffsetType >( i );
+        if( scaled[ i ] < 1.0 )
+        {
+          smallColumns.push_back( static_cast< VoxelOffsetType >( i ) );
+        }
+        else
+        {
+          largeColumns.push_back( static_cast< VoxelOffsetType >( i ) );
+        }
+      }
+      while( !smallColumns.empty() && !largeColumns.empty() )
+      {
+        const VoxelOffsetType s = smallColumns.back();
+        const VoxelOffsetType l = largeColumns.back();
+        smallColumns.pop_back();
+        this->m_AliasThresholds[ s ] = static_cast< float >( scaled[ s ] );
+        this->m_AliasIndices[ s ]    = l;
+        scaled[ l ]                 += scaled[ s ] - 1.0;
+        if( scaled[ l ] < 1.0 )
+        {
+          largeColumns.pop_back();
+          smallColumns.push_back( l );
+        }
+      }
+
+      /** The remaining columns, above one or below one by round-off only,
+       * keep their own voxel.
+       */
+    }
+  }
+  catch( std::bad_alloc & )
+  {
+    this->m_VoxelOffsets.clear();
+    this->m_ScaledProbabilities.clear();
+    this->m_AliasThresholds.clear();
+    this->m_AliasIndices.clear();
+    itkExceptionMacro( << "ERROR: failed to allocate memory for the importance sampling alias table." );
+  }
+
+  /** Remember what the table was built for. */
+  this->m_AliasTableInput           = inputImage.GetPointer();
+  this->m_AliasTableInputMTime      = inputImage->GetMTime();
+  this->m_AliasTableMask            = mask.GetPointer();
+  this->m_AliasTableMaskMTime       = mask.IsNotNull() ? mask->GetMTime() : 0;
+  this->m_AliasTableUniformFraction = this->m_UniformFraction;
+
+} // end UpdateAliasTable()
+
+
+/**
+ * ******************* ComputeGradientMagnitude *******************
+ */
+
+template< class TInputImage >
+double
+ImageImportanceSampler< TInputImage >
+::ComputeGradientMagnitude( const InputImageIndexType & index ) const
+{
+  InputImageConstPointer       inputImage = this->GetInput();
+  const InputImageRegionType & buffered   = inputImage->GetBufferedRegion();
+
+  double sumOfSquares = 0.0;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    InputImageIndexType lower = index;
+    InputImageIndexType upper = index;
+    if( lower[ d ] > buffered.GetIndex()[ d ] )
+    {
+      --lower[ d ];
+    }
+    if( upper[ d ] < buffered.GetIndex()[ d ]
+      + static_cast< typename InputImageIndexType::IndexValueType >( buffered.GetSize()[ d ] ) - 1 )
+    {
+      ++upper[ d ];
+    }
+    if( upper[ d ] == lower[ d ] )
+    {
+      continue;
+    }
+
+    const double derivative
+      = ( static_cast< double >( inputImage->GetPixel( upper ) )
+      - static_cast< double >( inputImage->GetPixel( lower ) ) )
+      / ( ( upper[ d ] - lower[ d ] ) * inputImage->GetSpacing()[ d ] );
+    sumOfSquares += derivative * derivative;
+  }
+
+  return std::sqrt( sumOfSquares );
+
+} // end ComputeGradientMagnitude()
+
+
+/**
+ * ******************* ComputeIndex *******************
+ */
+
+template< class TInputImage >
+void
+ImageImportanceSampler< TInputImage >
+::ComputeIndex( const VoxelOffsetType offset, InputImageIndexType & index ) const
+{
+  const InputImageRegionType & region = this->m_AliasTableRegion;
+  index = region.GetIndex();
+  unsigned long rest = offset;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    index[ d ] += rest % region.GetSize()[ d ];
+    rest       /= region.GetSize()[ d ];
+  }
+
+} // end ComputeIndex()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage >
+void
+ImageImportanceSampler< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UniformFraction: " << this->m_UniformFraction << std::endl;
+  os << indent << "NumberOfVoxelsInsideMask: " << this->m_VoxelOffsets.size() << std::endl;
+  os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __ImageImportanceSampler_hxx
@@ -33,6 +33,13 @@ namespace itk
  * This image sampler generates not only samples that correspond with
  * pixel locations, but selects points in physical space.
  *
+ * When UseLowDiscrepancySampling is true, the coordinates are not drawn
+ * independently, but taken from a Halton sequence, which covers the sample
+ * region much more evenly. To keep the samples of different sample sets
+ * independent, every sample set shifts the sequence by a random vector,
+ * modulo the region size (a Cranley-Patterson rotation). With a mask,
+ * rejected points simply advance the sequence.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -73,6 +80,7 @@ public:
   typedef typename Superclass::InputImagePointType          InputImagePointType;
   typedef typename Superclass::InputImagePointValueType     InputImagePointValueType;
   typedef typename Superclass::ImageSampleValueType         ImageSampleValueType;
+  typedef typename Superclass::CounterBasedRandomGeneratorType CounterBasedRandomGeneratorType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -105,14 +113,24 @@ public:
   itkGetConstMacro( UseRandomSampleRegion, bool );
   itkSetMacro( UseRandomSampleRegion, bool );
 
+  /** Set/Get whether to take the coordinates from a randomly shifted Halton
+   * sequence, instead of independent uniform draws. Default: false. */
+  itkSetMacro( UseLowDiscrepancySampling, bool );
+  itkGetConstMacro( UseLowDiscrepancySampling, bool );
+  itkBooleanMacro( UseLowDiscrepancySampling );
+
 protected:
 
   typedef typename InterpolatorType::ContinuousIndexType InputImageContinuousIndexType;
 
   /** The constructor. */
   ImageRandomCoordinateSampler();
-  /** The destructor. */
-  virtual ~ImageRandomCoordinateSampler() {}
+  /** The destructor. Stops the sample prefetching, which calls GenerateData(). */
+  virtual ~ImageRandomCoordinateSampler()
+  {
+    this->DiscardPrefetchedSamples();
+  }
+
 
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
@@ -133,6 +151,33 @@ protected:
     const InputImageContinuousIndexType & largestContIndex,
     InputImageContinuousIndexType &       randomContIndex );
 
+  /** Generate a point randomly in a bounding box, using the counter-based
+   * generator when UseCounterBasedRandomGenerator is true, and
+   * GenerateRandomCoordinate() otherwise. */
+  void GenerateSampleCoordinate(
+    const InputImageContinuousIndexType & smallestContIndex,
+    const InputImageContinuousIndexType & largestContIndex,
+    CounterBasedRandomGeneratorType &     generator,
+    InputImageContinuousIndexType &       randomContIndex );
+
+  /** Draw the random shift of the Halton sequence for a new sample set. */
+  void InitializeLowDiscrepancyShift( void );
+
+  /** Compute point sequenceIndex of the shifted Halton sequence, in a
+   * bounding box. Thread-safe. */
+  void GenerateLowDiscrepancyCoordinate( const unsigned long sequenceIndex,
+    const InputImageContinuousIndexType & smallestContIndex,
+    const InputImageContinuousIndexType & largestContIndex,
+    InputImageContinuousIndexType &       sampleContIndex ) const;
+
+  /** The radical inverse of index in the given base, in [0,1). */
+  static double RadicalInverse( unsigned int base, unsigned long index );
+
+  /** Compute the corners of the sampling region in continuous index space. */
+  void ComputeSampleRegion(
+    InputImageContinuousIndexType & smallestContIndex,
+    InputImageContinuousIndexType & largestContIndex );
+
   InterpolatorPointer    m_Interpolator;
   RandomGeneratorPointer m_RandomGenerator;
   InputImageSpacingType  m_SampleRegionSize;
@@ -156,6 +201,14 @@ private:
   void operator=( const Self & );                 // purposely not implemented
 
   bool m_UseRandomSampleRegion;
+  bool m_UseLowDiscrepancySampling;
+
+  /** The random shift of the Halton sequence of the current sample set. */
+  FixedArray< double, itkGetStaticConstMacro( InputImageDimension ) > m_LowDiscrepancyShift;
+
+  /** The sampling region, stored for the threads. */
+  InputImageContinuousIndexType m_SmallestContIndex;
+  InputImageContinuousIndexType m_LargestContIndex;
 
 };
 
@@ -41,8 +41,10 @@ ImageRandomCoordinateSampler< TInputImage >
   /** Setup random generator. */
   this->m_RandomGenerator = RandomGeneratorType::GetInstance();
 
-  this->m_UseRandomSampleRegion = false;
+  this->m_UseRandomSampleRegion     = false;
+  this->m_UseLowDiscrepancySampling = false;
   this->m_SampleRegionSize.Fill( 1.0 );
+  this->m_LowDiscrepancyShift.Fill( 0.0 );
 
 } // end Constructor
 
@@ -56,6 +58,18 @@ void
 ImageRandomCoordinateSampler< TInputImage >
 ::GenerateData( void )
 {
+  /** Use the samples that were drawn in the background, if possible. */
+  if( this->UsePrefetchedSamples() )
+  {
+    return;
+  }
+
+  /** Every call draws a new sample set from the counter-based generator. */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->NextSampleSet();
+  }
+
   /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
   typename MaskType::ConstPointer mask = this->GetMask();
   if( mask.IsNull() && this->m_UseMultiThread )
@@ -66,25 +80,25 @@ ImageRandomCoordinateSampler< TInputImage >
 
   /** Get handles to the input image, output sample container, and interpolator. */
   InputImageConstPointer inputImage = this->GetInput();
-  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetSampleContainerToFill();
   typename InterpolatorType::Pointer interpolator            = this->GetInterpolator();
 
-  /** Set up the interpolator. */
-  interpolator->SetInputImage( inputImage ); // only once?
+  /** Set up the interpolator. Not in the background thread, since it may
+   * update the input pipeline; the foreground generation already did it.
+   */
+  if( !this->GetGeneratingPrefetchedSamples() )
+  {
+    interpolator->SetInputImage( inputImage ); // only once?
+  }
 
   /** Convert inputImageRegion to bounding box in physical space. */
-  InputImageSizeType unitSize;
-  unitSize.Fill( 1 );
-  InputImageIndexType smallestIndex
-    = this->GetCroppedInputImageRegion().GetIndex();
-  InputImageIndexType largestIndex
-    = smallestIndex + this->GetCroppedInputImageRegion().GetSize() - unitSize;
-  InputImageContinuousIndexType smallestImageContIndex( smallestIndex );
-  InputImageContinuousIndexType largestImageContIndex( largestIndex );
   InputImageContinuousIndexType smallestContIndex;
   InputImageContinuousIndexType largestContIndex;
-  this->GenerateSampleRegion( smallestImageContIndex, largestImageContIndex,
-    smallestContIndex, largestContIndex );
+  this->ComputeSampleRegion( smallestContIndex, largestContIndex );
+  if( this->m_UseLowDiscrepancySampling )
+  {
+    this->InitializeLowDiscrepancyShift();
+  }
 
   /** Reserve memory for the output. */
   sampleContainer->Reserve( this->GetNumberOfSamples() );
@@ -93,7 +107,8 @@ ImageRandomCoordinateSampler< TInputImage >
   typename ImageSampleContainerType::Iterator iter;
   typename ImageSampleContainerType::ConstIterator end = sampleContainer->End();
 
-  InputImageContinuousIndexType sampleContIndex;
+  InputImageContinuousIndexType   sampleContIndex;
+  CounterBasedRandomGeneratorType generator;
   /** Fill the sample container. */
   if( mask.IsNull() )
   {
@@ -105,7 +120,20 @@ ImageRandomCoordinateSampler< TInputImage >
       ImageSampleValueType & sampleValue = ( *iter ).Value().m_ImageValue;
 
       /** Walk over the image until we find a valid point. */
-      this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, sampleContIndex );
+      if( this->m_UseLowDiscrepancySampling )
+      {
+        this->GenerateLowDiscrepancyCoordinate( iter.Index(),
+          smallestContIndex, largestContIndex, sampleContIndex );
+      }
+      else
+      {
+        if( this->m_UseCounterBasedRandomGenerator )
+        {
+          this->GetSampleRandomGenerator( iter.Index(), generator );
+        }
+        this->GenerateSampleCoordinate( smallestContIndex, largestContIndex,
+          generator, sampleContIndex );
+      }
 
       /** Convert to point */
       inputImage->TransformContinuousIndexToPhysicalPoint( sampleContIndex, samplePoint );
@@ -135,6 +163,12 @@ ImageRandomCoordinateSampler< TInputImage >
       InputImagePointType &  samplePoint = ( *iter ).Value().m_ImageCoordinates;
       ImageSampleValueType & sampleValue = ( *iter ).Value().m_ImageValue;
 
+      /** A sample continues its own stream until a valid point is found. */
+      if( this->m_UseCounterBasedRandomGenerator )
+      {
+        this->GetSampleRandomGenerator( iter.Index(), generator );
+      }
+
       /** Walk over the image until we find a valid point */
       do
       {
@@ -151,8 +185,18 @@ ImageRandomCoordinateSampler< TInputImage >
                              << "reasonable time. Probably the mask is too small" );
         }
 
-        /** Generate a point in the input image region. */
-        this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, sampleContIndex );
+        /** Generate a point in the input image region. A rejected point
+         * of the Halton sequence just advances the sequence. */
+        if( this->m_UseLowDiscrepancySampling )
+        {
+          this->GenerateLowDiscrepancyCoordinate( numberOfSamplesTried - 1,
+            smallestContIndex, largestContIndex, sampleContIndex );
+        }
+        else
+        {
+          this->GenerateSampleCoordinate( smallestContIndex, largestContIndex,
+            generator, sampleContIndex );
+        }
         inputImage->TransformContinuousIndexToPhysicalPoint( sampleContIndex, samplePoint );
 
       }
@@ -179,32 +223,36 @@ ImageRandomCoordinateSampler< TInputImage >
 ::BeforeThreadedGenerateData( void )
 {
   /** Set up the interpolator. */
-  typename InterpolatorType::Pointer interpolator = this->GetInterpolator();
-  interpolator->SetInputImage( this->GetInput() ); // only once per resolution?
+  if( !this->GetGeneratingPrefetchedSamples() )
+  {
+    typename InterpolatorType::Pointer interpolator = this->GetInterpolator();
+    interpolator->SetInputImage( this->GetInput() ); // only once per resolution?
+  }
 
   /** Clear the random number list. */
   this->m_RandomNumberList.resize( 0 );
-  this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
 
   /** Convert inputImageRegion to bounding box in physical space. */
-  InputImageSizeType  unitSize; unitSize.Fill( 1 );
-  InputImageIndexType smallestIndex
-    = this->GetCroppedInputImageRegion().GetIndex();
-  InputImageIndexType largestIndex
-    = smallestIndex + this->GetCroppedInputImageRegion().GetSize() - unitSize;
-  InputImageContinuousIndexType smallestImageCIndex( smallestIndex );
-  InputImageContinuousIndexType largestImageCIndex( largestIndex );
-  InputImageContinuousIndexType smallestCIndex, largestCIndex, randomCIndex;
-  this->GenerateSampleRegion( smallestImageCIndex, largestImageCIndex,
-    smallestCIndex, largestCIndex );
-
-  /** Fill the list with random numbers. */
-  for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
+  this->ComputeSampleRegion( this->m_SmallestContIndex, this->m_LargestContIndex );
+  if( this->m_UseLowDiscrepancySampling )
   {
-    this->GenerateRandomCoordinate( smallestCIndex, largestCIndex, randomCIndex );
-    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    this->InitializeLowDiscrepancyShift();
+  }
+
+  /** Fill the list with random numbers. The counter-based generator and
+   * the Halton sequence draw the samples inside the threads instead. */
+  if( !this->m_UseCounterBasedRandomGenerator && !this->m_UseLowDiscrepancySampling )
+  {
+    this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
+    InputImageContinuousIndexType randomCIndex;
+    for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
     {
-      this->m_RandomNumberList.push_back( randomCIndex[ j ] );
+      this->GenerateRandomCoordinate( this->m_SmallestContIndex,
+        this->m_LargestContIndex, randomCIndex );
+      for( unsigned int j = 0; j < InputImageDimension; ++j )
+      {
+        this->m_RandomNumberList.push_back( randomCIndex[ j ] );
+      }
     }
   }
 
@@ -257,14 +305,33 @@ ImageRandomCoordinateSampler< TInputImage >
   typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
 
   /** Fill the local sample container. */
-  InputImageContinuousIndexType sampleCIndex;
-  unsigned long                 sampleId = sampleStart;
-  for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter )
+  InputImageContinuousIndexType   sampleCIndex;
+  CounterBasedRandomGeneratorType generator;
+  unsigned long                   sampleId = sampleStart;
+  unsigned long                   streamId = threadId
+    * ( this->GetNumberOfSamples() / this->GetNumberOfThreads() );
+  for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter, ++streamId )
   {
-    /** Create a random point out of InputImageDimension random numbers. */
-    for( unsigned int j = 0; j < InputImageDimension; ++j, sampleId++ )
+    if( this->m_UseLowDiscrepancySampling )
     {
-      sampleCIndex[ j ] = this->m_RandomNumberList[ sampleId ];
+      /** Take the point of the Halton sequence of this sample. */
+      this->GenerateLowDiscrepancyCoordinate( streamId,
+        this->m_SmallestContIndex, this->m_LargestContIndex, sampleCIndex );
+    }
+    else if( this->m_UseCounterBasedRandomGenerator )
+    {
+      /** Draw from the stream of this sample, independent of the thread. */
+      this->GetSampleRandomGenerator( streamId, generator );
+      this->GenerateSampleCoordinate( this->m_SmallestContIndex,
+        this->m_LargestContIndex, generator, sampleCIndex );
+    }
+    else
+    {
+      /** Create a random point out of InputImageDimension random numbers. */
+      for( unsigned int j = 0; j < InputImageDimension; ++j, sampleId++ )
+      {
+        sampleCIndex[ j ] = this->m_RandomNumberList[ sampleId ];
+      }
     }
 
     /** Make a reference to the current sample in the container. */
@@ -304,6 +371,144 @@ ImageRandomCoordinateSampler< TInputImage >
 } // end GenerateRandomCoordinate()
 
 
+/**
+ * ******************* GenerateSampleCoordinate *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::GenerateSampleCoordinate(
+  const InputImageContinuousIndexType & smallestContIndex,
+  const InputImageContinuousIndexType & largestContIndex,
+  CounterBasedRandomGeneratorType &     generator,
+  InputImageContinuousIndexType &       randomContIndex )
+{
+  if( !this->m_UseCounterBasedRandomGenerator )
+  {
+    this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, randomContIndex );
+    return;
+  }
+
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    randomContIndex[ i ] = static_cast< InputImagePointValueType >(
+      generator.GetUniformVariate( smallestContIndex[ i ], largestContIndex[ i ] ) );
+  }
+} // end GenerateSampleCoordinate()
+
+
+/**
+ * ******************* InitializeLowDiscrepancyShift *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::InitializeLowDiscrepancyShift( void )
+{
+  /** The counter-based generator reserves the one but last stream for the shift. */
+  CounterBasedRandomGeneratorType generator;
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->GetSampleRandomGenerator( NumericTraits< unsigned long >::max() - 1, generator );
+  }
+
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    if( this->m_UseCounterBasedRandomGenerator )
+    {
+      this->m_LowDiscrepancyShift[ i ] = generator.GetUniformVariate( 0.0, 1.0 );
+    }
+    else
+    {
+      this->m_LowDiscrepancyShift[ i ] = this->m_RandomGenerator->GetUniformVariate( 0.0, 1.0 );
+    }
+  }
+
+} // end InitializeLowDiscrepancyShift()
+
+
+/**
+ * ******************* GenerateLowDiscrepancyCoordinate *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::GenerateLowDiscrepancyCoordinate( const unsigned long sequenceIndex,
+  const InputImageContinuousIndexType & smallestContIndex,
+  const InputImageContinuousIndexType & largestContIndex,
+  InputImageContinuousIndexType &       sampleContIndex ) const
+{
+  /** One prime base per dimension. */
+  static const unsigned int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19 };
+
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    /** Skip the first point of the sequence, which is the origin. */
+    double u = RadicalInverse( primes[ i % 8 ], sequenceIndex + 1 )
+      + this->m_LowDiscrepancyShift[ i ];
+    if( u >= 1.0 )
+    {
+      u -= 1.0;
+    }
+    sampleContIndex[ i ] = static_cast< InputImagePointValueType >(
+      smallestContIndex[ i ] + u * ( largestContIndex[ i ] - smallestContIndex[ i ] ) );
+  }
+
+} // end GenerateLowDiscrepancyCoordinate()
+
+
+/**
+ * ******************* RadicalInverse *******************
+ */
+
+template< class TInputImage >
+double
+ImageRandomCoordinateSampler< TInputImage >
+::RadicalInverse( unsigned int base, unsigned long index )
+{
+  const double invBase = 1.0 / static_cast< double >( base );
+  double       factor  = invBase;
+  double       result  = 0.0;
+  while( index > 0 )
+  {
+    result += factor * static_cast< double >( index % base );
+    index  /= base;
+    factor *= invBase;
+  }
+  return result;
+
+} // end RadicalInverse()
+
+
+/**
+ * ******************* ComputeSampleRegion *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::ComputeSampleRegion(
+  InputImageContinuousIndexType & smallestContIndex,
+  InputImageContinuousIndexType & largestContIndex )
+{
+  /** Convert inputImageRegion to bounding box in physical space. */
+  InputImageSizeType unitSize;
+  unitSize.Fill( 1 );
+  InputImageIndexType smallestIndex
+    = this->GetCroppedInputImageRegion().GetIndex();
+  InputImageIndexType largestIndex
+    = smallestIndex + this->GetCroppedInputImageRegion().GetSize() - unitSize;
+  InputImageContinuousIndexType smallestImageContIndex( smallestIndex );
+  InputImageContinuousIndexType largestImageContIndex( largestIndex );
+  this->GenerateSampleRegion( smallestImageContIndex, largestImageContIndex,
+    smallestContIndex, largestContIndex );
+
+} // end ComputeSampleRegion()
+
+
 /**
  * ******************* GenerateSampleRegion *******************
  */
@@ -341,7 +546,14 @@ ImageRandomCoordinateSampler< TInputImage >
     maxSmallestContIndex[ i ] = vnl_math_max( maxSmallestContIndex[ i ], smallestImageContIndex[ i ] );
   }
 
-  this->GenerateRandomCoordinate( smallestImageContIndex, maxSmallestContIndex, smallestContIndex );
+  /** The counter-based generator reserves the last stream for the region. */
+  CounterBasedRandomGeneratorType generator;
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->GetSampleRandomGenerator( NumericTraits< unsigned long >::max(), generator );
+  }
+  this->GenerateSampleCoordinate( smallestImageContIndex, maxSmallestContIndex,
+    generator, smallestContIndex );
   largestContIndex  = smallestContIndex;
   largestContIndex += sampleRegionSize;
 
@@ -361,6 +573,7 @@ ImageRandomCoordinateSampler< TInputImage >
 
   os << indent << "Interpolator: " << this->m_Interpolator.GetPointer() << std::endl;
   os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
+  os << indent << "UseLowDiscrepancySampling: " << this->m_UseLowDiscrepancySampling << std::endl;
 
 } // end PrintSelf()
 
@@ -32,6 +32,10 @@ namespace itk
  * mask. If the mask is very sparse, this may take some time. In this case,
  * consider using the ImageRandomSamplerSparseMask.
  *
+ * With UseCounterBasedRandomGenerator, sample i is taken from random stream
+ * i of the current sample set, also when a mask is given, in which case the
+ * stream is continued until a position inside the mask is found.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -68,6 +72,7 @@ public:
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
   typedef typename Superclass::MaskType                     MaskType;
   typedef typename Superclass::InputImageSizeType           InputImageSizeType;
+  typedef typename Superclass::CounterBasedRandomGeneratorType CounterBasedRandomGeneratorType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -81,8 +86,12 @@ protected:
 
   /** The constructor. */
   ImageRandomSampler() {}
-  /** The destructor. */
-  virtual ~ImageRandomSampler() {}
+  /** The destructor. Stops the sample prefetching, which calls GenerateData(). */
+  virtual ~ImageRandomSampler()
+  {
+    this->DiscardPrefetchedSamples();
+  }
+
 
   /** Functions that do the work. */
   virtual void GenerateData( void );
@@ -91,6 +100,15 @@ protected:
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId );
 
+  /** Draw a random voxel of the cropped input image region. */
+  void GenerateRandomIndex( CounterBasedRandomGeneratorType & generator,
+    InputImageIndexType & index ) const;
+
+  /** Translate a position in [0, NumberOfPixels[ of the cropped input
+   * image region to an index, as in ImageRandomConstIteratorWithIndex.
+   */
+  void PositionToIndex( unsigned long randomPosition, InputImageIndexType & index ) const;
+
 private:
 
   /** The private constructor. */
@@ -22,6 +22,7 @@
 
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkImageRandomConstIteratorWithIndex.h"
+#include "vnl/vnl_math.h"
 
 namespace itk
 {
@@ -35,6 +36,18 @@ void
 ImageRandomSampler< TInputImage >
 ::GenerateData( void )
 {
+  /** Use the samples that were drawn in the background, if possible. */
+  if( this->UsePrefetchedSamples() )
+  {
+    return;
+  }
+
+  /** Every call draws a new sample set from the counter-based generator. */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->NextSampleSet();
+  }
+
   /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
   typename MaskType::ConstPointer mask = this->GetMask();
   if( mask.IsNull() && this->m_UseMultiThread )
@@ -45,20 +58,63 @@ ImageRandomSampler< TInputImage >
 
   /** Get handles to the input image, output sample container. */
   InputImageConstPointer inputImage = this->GetInput();
-  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetSampleContainerToFill();
 
   /** Reserve memory for the output. */
   sampleContainer->Reserve( this->GetNumberOfSamples() );
 
+  /** Setup an iterator over the output, which is of ImageSampleContainerType. */
+  typename ImageSampleContainerType::Iterator iter;
+  typename ImageSampleContainerType::ConstIterator end = sampleContainer->End();
+
+  /** Use one random stream per sample, see ThreadedGenerateData(). */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    if( mask.IsNotNull() && mask->GetSource() )
+    {
+      mask->GetSource()->Update();
+    }
+
+    /** Make sure we are not eternally trying to find samples: */
+    const unsigned long maximumNumberOfTrials = 10 * this->GetNumberOfSamples();
+    unsigned long       numberOfTrials        = 0;
+
+    CounterBasedRandomGeneratorType generator;
+    InputImageIndexType             index;
+    InputImagePointType             inputPoint;
+    for( iter = sampleContainer->Begin(); iter != end; ++iter )
+    {
+      this->GetSampleRandomGenerator( iter.Index(), generator );
+      do
+      {
+        if( numberOfTrials++ == maximumNumberOfTrials )
+        {
+          /** Squeeze the sample container to the size that is still valid. */
+          typename ImageSampleContainerType::iterator stlnow = sampleContainer->begin();
+          typename ImageSampleContainerType::iterator stlend = sampleContainer->end();
+          stlnow                                            += iter.Index();
+          sampleContainer->erase( stlnow, stlend );
+          itkExceptionMacro( << "Could not find enough image samples within "
+                             << "reasonable time. Probably the mask is too small" );
+        }
+        this->GenerateRandomIndex( generator, index );
+        inputImage->TransformIndexToPhysicalPoint( index, inputPoint );
+      }
+      while( mask.IsNotNull() && !mask->IsInside( inputPoint ) );
+
+      /** Put the coordinates and the value in the sample. */
+      ( *iter ).Value().m_ImageCoordinates = inputPoint;
+      ( *iter ).Value().m_ImageValue
+        = static_cast< ImageSampleValueType >( inputImage->GetPixel( index ) );
+    }
+    return;
+  }
+
   /** Setup a random iterator over the input image. */
   typedef ImageRandomConstIteratorWithIndex< InputImageType > RandomIteratorType;
   RandomIteratorType randIter( inputImage, this->GetCroppedInputImageRegion() );
   randIter.GoToBegin();
 
-  /** Setup an iterator over the output, which is of ImageSampleContainerType. */
-  typename ImageSampleContainerType::Iterator iter;
-  typename ImageSampleContainerType::ConstIterator end = sampleContainer->End();
-
   if( mask.IsNull() )
   {
     /** number of samples + 1, because of the initial ++randIter. */
@@ -171,23 +227,21 @@ ImageRandomSampler< TInputImage >
   typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
 
   /** Fill the local sample container. */
-  unsigned long       sampleId    = sampleStart;
-  InputImageSizeType  regionSize  = this->GetCroppedInputImageRegion().GetSize();
-  InputImageIndexType regionIndex = this->GetCroppedInputImageRegion().GetIndex();
+  unsigned long                   sampleId = sampleStart;
+  CounterBasedRandomGeneratorType generator;
+  InputImageIndexType             positionIndex;
   for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter, sampleId++ )
   {
-    unsigned long randomPosition = static_cast< unsigned long >( this->m_RandomNumberList[ sampleId ] );
-
-    /** Translate randomPosition to an index, copied from ImageRandomConstIteratorWithIndex. */
-    unsigned long       residual;
-    InputImageIndexType positionIndex;
-    for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+    if( this->m_UseCounterBasedRandomGenerator )
     {
-      const unsigned long sizeInThisDimension = regionSize[ dim ];
-      residual             = randomPosition % sizeInThisDimension;
-      positionIndex[ dim ] = residual + regionIndex[ dim ];
-      randomPosition      -= residual;
-      randomPosition      /= sizeInThisDimension;
+      /** Draw from the stream of this sample, independent of the thread. */
+      this->GetSampleRandomGenerator( sampleId, generator );
+      this->GenerateRandomIndex( generator, positionIndex );
+    }
+    else
+    {
+      this->PositionToIndex( static_cast< unsigned long >(
+        this->m_RandomNumberList[ sampleId ] ), positionIndex );
     }
 
     /** Transform index to the physical coordinates and put it in the sample. */
@@ -202,6 +256,50 @@ ImageRandomSampler< TInputImage >
 } // end ThreadedGenerateData()
 
 
+/**
+ * ******************* GenerateRandomIndex *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSampler< TInputImage >
+::GenerateRandomIndex( CounterBasedRandomGeneratorType & generator,
+  InputImageIndexType & index ) const
+{
+  const unsigned long numPixels = this->GetCroppedInputImageRegion().GetNumberOfPixels();
+  unsigned long       randomPosition
+    = static_cast< unsigned long >( generator.GetVariate() * numPixels );
+  randomPosition = vnl_math_min( randomPosition, numPixels - 1 );
+  this->PositionToIndex( randomPosition, index );
+
+} // end GenerateRandomIndex()
+
+
+/**
+ * ******************* PositionToIndex *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSampler< TInputImage >
+::PositionToIndex( unsigned long randomPosition, InputImageIndexType & index ) const
+{
+  /** Translate randomPosition to an index, copied from ImageRandomConstIteratorWithIndex. */
+  const InputImageSizeType  regionSize  = this->GetCroppedInputImageRegion().GetSize();
+  const InputImageIndexType regionIndex = this->GetCroppedInputImageRegion().GetIndex();
+  unsigned long             residual;
+  for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+  {
+    const unsigned long sizeInThisDimension = regionSize[ dim ];
+    residual        = randomPosition % sizeInThisDimension;
+    index[ dim ]    = residual + regionIndex[ dim ];
+    randomPosition -= residual;
+    randomPosition /= sizeInThisDimension;
+  }
+
+} // end PositionToIndex()
+
+
 } // end namespace itk
 
 #endif // end #ifndef __ImageRandomSampler_hxx
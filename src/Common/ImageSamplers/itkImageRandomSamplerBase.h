@@ -19,6 +19,7 @@
 #define __ImageRandomSamplerBase_h
 
 #include "itkImageSamplerBase.h"
+#include "itkPhiloxRandomNumberGenerator.h"
 
 namespace itk
 {
@@ -29,6 +30,15 @@ namespace itk
  *
  * It adds the Set/GetNumberOfSamples function.
  *
+ * By default the samples are drawn from the global Mersenne Twister, in a
+ * serial loop before the (optional) multi-threaded part. When
+ * UseCounterBasedRandomGenerator is true, each sample instead gets its own
+ * stream of a PhiloxRandomNumberGenerator, identified by the sample number
+ * and the number of the sample set. The samples can then be drawn inside
+ * the threads, and are the same for every number of threads, for a given
+ * Seed. This option is supported by the ImageRandomSampler and the
+ * ImageRandomCoordinateSampler; the other subclasses ignore it.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -71,6 +81,31 @@ public:
   /** Set the number of samples. */
   itkSetClampMacro( NumberOfSamples, unsigned long, 1, NumericTraits< unsigned long >::max() );
 
+  /** The counter-based random number generator. */
+  typedef PhiloxRandomNumberGenerator              CounterBasedRandomGeneratorType;
+  typedef CounterBasedRandomGeneratorType::SeedType SeedType;
+
+  /** Select the counter-based random number generator. Default: false. */
+  itkSetMacro( UseCounterBasedRandomGenerator, bool );
+  itkGetConstMacro( UseCounterBasedRandomGenerator, bool );
+  itkBooleanMacro( UseCounterBasedRandomGenerator );
+
+  /** Set/Get the seed of the counter-based random number generator.
+   * Setting the seed restarts the sequence of sample sets. Default: 121212.
+   */
+  virtual void SetSeed( const SeedType seed );
+  itkGetConstMacro( Seed, SeedType );
+
+  /** Sample prefetching is supported when the counter-based random number
+   * generator is used, since the samples then do not depend on the moment
+   * they are drawn.
+   */
+  virtual bool SamplePrefetchingSupported( void ) const
+  {
+    return this->m_UseCounterBasedRandomGenerator;
+  }
+
+
 protected:
 
   /** The constructor. */
@@ -82,12 +117,31 @@ protected:
   /** Multi-threaded function that does the work. */
   virtual void BeforeThreadedGenerateData( void );
 
+  /** Start a new sample set of the counter-based random number generator.
+   * Should be called once at the start of GenerateData().
+   */
+  void NextSampleSet( void );
+
+  /** Get a counter-based generator, positioned at the start of the random
+   * stream of sample sampleId of the current sample set. Thread-safe.
+   */
+  void GetSampleRandomGenerator( const unsigned long sampleId,
+    CounterBasedRandomGeneratorType & generator ) const;
+
+  /** Prefetched samples that are thrown away return their sample set. */
+  virtual void AfterDiscardingPrefetchedSamples( void );
+
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
 
   /** Member variable used when threading. */
   std::vector< double > m_RandomNumberList;
 
+  /** Variables for the counter-based random number generator. */
+  bool          m_UseCounterBasedRandomGenerator;
+  SeedType      m_Seed;
+  unsigned long m_SampleSetNumber;
+
 private:
 
   /** The private constructor. */
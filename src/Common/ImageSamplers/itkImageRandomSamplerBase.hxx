@@ -36,6 +36,10 @@ ImageRandomSamplerBase< TInputImage >
 {
   this->m_NumberOfSamples = 1000;
 
+  this->m_UseCounterBasedRandomGenerator = false;
+  this->m_Seed                           = 121212;
+  this->m_SampleSetNumber                = 0;
+
 } // end Constructor
 
 
@@ -48,6 +52,14 @@ void
 ImageRandomSamplerBase< TInputImage >
 ::BeforeThreadedGenerateData( void )
 {
+  /** The counter-based generator draws the samples inside the threads. */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->m_RandomNumberList.resize( 0 );
+    Superclass::BeforeThreadedGenerateData();
+    return;
+  }
+
   /** Create a random number generator. Also used in the ImageRandomConstIteratorWithIndex. */
   typedef typename Statistics::MersenneTwisterRandomVariateGenerator::Pointer GeneratorPointer;
   GeneratorPointer localGenerator = Statistics::MersenneTwisterRandomVariateGenerator::GetInstance();
@@ -74,6 +86,76 @@ ImageRandomSamplerBase< TInputImage >
 } // end BeforeThreadedGenerateData()
 
 
+/**
+ * ******************* SetSeed *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::SetSeed( const SeedType seed )
+{
+  if( this->m_Seed != seed )
+  {
+    this->m_Seed = seed;
+    this->Modified();
+  }
+  this->m_SampleSetNumber = 0;
+
+} // end SetSeed()
+
+
+/**
+ * ******************* NextSampleSet *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::NextSampleSet( void )
+{
+  ++this->m_SampleSetNumber;
+
+} // end NextSampleSet()
+
+
+/**
+ * ******************* AfterDiscardingPrefetchedSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::AfterDiscardingPrefetchedSamples( void )
+{
+  /** The prefetch called NextSampleSet(), so that without prefetching the
+   * same sample sets are drawn.
+   */
+  if( this->m_SampleSetNumber > 0 )
+  {
+    --this->m_SampleSetNumber;
+  }
+
+} // end AfterDiscardingPrefetchedSamples()
+
+
+/**
+ * ******************* GetSampleRandomGenerator *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::GetSampleRandomGenerator( const unsigned long sampleId,
+  CounterBasedRandomGeneratorType & generator ) const
+{
+  typedef CounterBasedRandomGeneratorType::WordType WordType;
+  generator.SetSeed( this->m_Seed );
+  generator.SetStream( sampleId, static_cast< WordType >( this->m_SampleSetNumber ) );
+
+} // end GetSampleRandomGenerator()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -86,6 +168,9 @@ ImageRandomSamplerBase< TInputImage >
   Superclass::PrintSelf( os, indent );
 
   os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "UseCounterBasedRandomGenerator: "
+     << this->m_UseCounterBasedRandomGenerator << std::endl;
+  os << indent << "Seed: " << this->m_Seed << std::endl;
 
 } // end PrintSelf()
 
@@ -20,7 +20,7 @@
 
 #include "itkImageRandomSamplerBase.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
-#include "itkImageFullSampler.h"
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +31,13 @@ namespace itk
  * This version takes into account that the mask may be very small.
  * Also, it may be more efficient when very many different sample sets
  * of the same input image are required, because it does some precomputation.
+ *
+ * The precomputation is a compact list of the (32 bit) linear offsets, within
+ * the cropped input image region, of all voxels inside the mask. It is built
+ * multi-threaded, and only again when the input image, the mask or the region
+ * change, so in a registration once per resolution. Drawing a sample then
+ * takes constant time: a random entry of the list is converted to an index,
+ * a physical point and an image value.
  * \ingroup ImageSamplers
  */
 
@@ -78,10 +85,19 @@ public:
   typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
   typedef typename RandomGeneratorType::Pointer                  RandomGeneratorPointer;
 
+  /** This sampler does not support sample prefetching. */
+  virtual bool SamplePrefetchingSupported( void ) const
+  {
+    return false;
+  }
+
+
 protected:
 
-  typedef itk::ImageFullSampler< InputImageType >   InternalFullSamplerType;
-  typedef typename InternalFullSamplerType::Pointer InternalFullSamplerPointer;
+  /** The list of in-mask voxels, as offsets in the cropped region. */
+  typedef unsigned int                   MaskOffsetType;
+  typedef std::vector< MaskOffsetType >  MaskOffsetContainerType;
+  typedef typename MaskType::ConstPointer MaskConstPointer;
 
   /** The constructor. */
   ImageRandomSamplerSparseMask();
@@ -101,8 +117,29 @@ protected:
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId );
 
-  RandomGeneratorPointer     m_RandomGenerator;
-  InternalFullSamplerPointer m_InternalFullSampler;
+  /** Build the list of in-mask voxels, if it is out of date. */
+  virtual void UpdateMaskOffsets( void );
+
+  /** Build the part of the list of thread threadId. */
+  virtual void ThreadedComputeMaskOffsets( ThreadIdType threadId,
+    ThreadIdType numberOfThreads );
+
+  /** Static callback for the thread pool. */
+  static ITK_THREAD_RETURN_TYPE ComputeMaskOffsetsThreaderCallback( void * arg );
+
+  /** Convert an entry of the list to a sample. */
+  void ComputeSample( const MaskOffsetType offset, ImageSampleType & sample ) const;
+
+  RandomGeneratorPointer m_RandomGenerator;
+
+  /** The list of in-mask voxels, and what it was built for. */
+  MaskOffsetContainerType                m_MaskOffsets;
+  std::vector< MaskOffsetContainerType > m_ThreaderMaskOffsets;
+  const InputImageType *                 m_MaskOffsetsInput;
+  ModifiedTimeType                       m_MaskOffsetsInputMTime;
+  const MaskType *                       m_MaskOffsetsMask;
+  ModifiedTimeType                       m_MaskOffsetsMaskMTime;
+  InputImageRegionType                   m_MaskOffsetsRegion;
 
 private:
 
@@ -19,6 +19,8 @@
 #define __ImageRandomSamplerSparseMask_hxx
 
 #include "itkImageRandomSamplerSparseMask.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -34,7 +36,10 @@ ImageRandomSamplerSparseMask< TInputImage >
   /** Setup random generator. */
   this->m_RandomGenerator = RandomGeneratorType::GetInstance();
 
-  this->m_InternalFullSampler = InternalFullSamplerType::New();
+  this->m_MaskOffsetsInput      = 0;
+  this->m_MaskOffsetsInputMTime = 0;
+  this->m_MaskOffsetsMask       = 0;
+  this->m_MaskOffsetsMaskMTime  = 0;
 
 } // end Constructor
 
@@ -49,7 +54,7 @@ ImageRandomSamplerSparseMask< TInputImage >
 ::GenerateData( void )
 {
   /** Get a handle to the mask. */
-  typename MaskType::ConstPointer mask = this->GetMask();
+  MaskConstPointer mask = this->GetMask();
 
   /** Sanity check. */
   if( mask.IsNull() )
@@ -57,42 +62,17 @@ ImageRandomSamplerSparseMask< TInputImage >
     itkExceptionMacro( << "ERROR: do not call this function when no mask is supplied." );
   }
 
-  /** Get handles to the input image and output sample container. */
-  InputImageConstPointer      inputImage      = this->GetInput();
+  /** Get a handle to the output sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetOutput();
 
   /** Clear the container. */
   sampleContainer->Initialize();
 
-  /** Make sure the internal full sampler is up-to-date. */
-  this->m_InternalFullSampler->SetInput( inputImage );
-  this->m_InternalFullSampler->SetMask( mask );
-  this->m_InternalFullSampler->SetInputImageRegion( this->GetCroppedInputImageRegion() );
-
-  /** Use try/catch, since the full sampler may crash, due to insufficient memory. */
-  try
+  /** Make sure the list of in-mask voxels is up-to-date. */
+  this->UpdateMaskOffsets();
+  if( this->m_MaskOffsets.empty() )
   {
-    this->m_InternalFullSampler->Update();
-  }
-  catch( ExceptionObject & err )
-  {
-    std::string message = "ERROR: This ImageSampler internally uses the "
-      "ImageFullSampler. Updating of this internal sampler raised the "
-      "exception:\n";
-    message += err.GetDescription();
-
-    std::string            fullSamplerMessage = err.GetDescription();
-    std::string::size_type loc                = fullSamplerMessage.find(
-      "ERROR: failed to allocate memory for the sample container", 0 );
-    if( loc != std::string::npos && this->GetMask() == 0 )
-    {
-      message += "\nYou are using the ImageRandomSamplerSparseMask sampler, "
-        "but you did not set a mask. The internal ImageFullSampler therefore "
-        "requires a lot of memory. Consider using the ImageRandomSampler "
-        "instead.";
-    }
-    const char * message2 = message.c_str();
-    itkExceptionMacro( << message2 );
+    itkExceptionMacro( << "ERROR: the mask does not contain any voxel of the input image region." );
   }
 
   /** If desired we exercise a multi-threaded version. */
@@ -102,17 +82,16 @@ ImageRandomSamplerSparseMask< TInputImage >
     return Superclass::GenerateData();
   }
 
-  /** Get a handle to the full sampler output. */
-  typename ImageSampleContainerType::Pointer allValidSamples
-    = this->m_InternalFullSampler->GetOutput();
-  unsigned long numberOfValidSamples = allValidSamples->Size();
+  const unsigned long numberOfValidSamples = this->m_MaskOffsets.size();
 
-  /** Take random samples from the allValidSamples-container. */
+  /** Take random samples from the list of in-mask voxels. */
+  sampleContainer->Reserve( this->GetNumberOfSamples() );
   for( unsigned int i = 0; i < this->GetNumberOfSamples(); ++i )
   {
     unsigned long randomIndex
       = this->m_RandomGenerator->GetIntegerVariate( numberOfValidSamples - 1 );
-    sampleContainer->push_back( allValidSamples->ElementAt( randomIndex ) );
+    this->ComputeSample( this->m_MaskOffsets[ randomIndex ],
+      sampleContainer->ElementAt( i ) );
   }
 
 } // end GenerateData()
@@ -131,9 +110,8 @@ ImageRandomSamplerSparseMask< TInputImage >
   this->m_RandomNumberList.resize( 0 );
   this->m_RandomNumberList.reserve( this->m_NumberOfSamples );
 
-  /** Get a handle to the full sampler output size. */
-  const unsigned long numberOfValidSamples
-    = this->m_InternalFullSampler->GetOutput()->Size();
+  /** Get the number of in-mask voxels. */
+  const unsigned long numberOfValidSamples = this->m_MaskOffsets.size();
 
   /** Fill the list with random numbers. */
   for( unsigned int i = 0; i < this->GetNumberOfSamples(); ++i )
@@ -163,10 +141,6 @@ void
 ImageRandomSamplerSparseMask< TInputImage >
 ::ThreadedGenerateData( const InputImageRegionType &, ThreadIdType threadId )
 {
-  /** Get a handle to the full sampler output. */
-  typename ImageSampleContainerType::Pointer allValidSamples
-    = this->m_InternalFullSampler->GetOutput();
-
   /** Figure out which samples to process. */
   unsigned long chunkSize   = this->GetNumberOfSamples() / this->GetNumberOfThreads();
   unsigned long sampleStart = threadId * chunkSize;
@@ -185,17 +159,198 @@ ImageRandomSamplerSparseMask< TInputImage >
   typename ImageSampleContainerType::Iterator iter;
   typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
 
-  /** Take random samples from the allValidSamples-container. */
+  /** Take random samples from the list of in-mask voxels. */
   unsigned long sampleId = sampleStart;
   for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter, sampleId++ )
   {
     unsigned long randomIndex = static_cast< unsigned long >( this->m_RandomNumberList[ sampleId ] );
-    ( *iter ).Value() = allValidSamples->ElementAt( randomIndex );
+    this->ComputeSample( this->m_MaskOffsets[ randomIndex ], ( *iter ).Value() );
   }
 
 } // end ThreadedGenerateData()
 
 
+/**
+ * ******************* UpdateMaskOffsets *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerSparseMask< TInputImage >
+::UpdateMaskOffsets( void )
+{
+  InputImageConstPointer inputImage = this->GetInput();
+  MaskConstPointer       mask       = this->GetMask();
+  if( mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Check if the list is still up-to-date. */
+  const InputImageRegionType & region = this->GetCroppedInputImageRegion();
+  if( this->m_MaskOffsetsInput == inputImage.GetPointer()
+    && this->m_MaskOffsetsInputMTime == inputImage->GetMTime()
+    && this->m_MaskOffsetsMask == mask.GetPointer()
+    && this->m_MaskOffsetsMaskMTime == mask->GetMTime()
+    && this->m_MaskOffsetsRegion == region )
+  {
+    return;
+  }
+
+  /** The offsets are stored in 32 bits. */
+  if( region.GetNumberOfPixels() > NumericTraits< MaskOffsetType >::max() )
+  {
+    itkExceptionMacro( << "ERROR: the input image region is too large for this sampler. "
+                       << "Consider using the ImageRandomSampler instead." );
+  }
+
+  /** Let each thread collect the in-mask voxels of a contiguous part of the
+   * region, and concatenate the parts in order. The list is therefore the
+   * same for any number of threads.
+   */
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+  this->m_MaskOffsets.clear();
+  this->m_MaskOffsetsInput = 0;
+  try
+  {
+    this->m_ThreaderMaskOffsets.assign( numberOfThreads, MaskOffsetContainerType() );
+
+    PersistentThreadPool::GetGlobalThreadPool()->SingleMethodExecute(
+      this->ComputeMaskOffsetsThreaderCallback, this, numberOfThreads );
+
+    std::size_t numberOfValidSamples = 0;
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      numberOfValidSamples += this->m_ThreaderMaskOffsets[ i ].size();
+    }
+    this->m_MaskOffsets.reserve( numberOfValidSamples );
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      this->m_MaskOffsets.insert( this->m_MaskOffsets.end(),
+        this->m_ThreaderMaskOffsets[ i ].begin(), this->m_ThreaderMaskOffsets[ i ].end() );
+    }
+    this->m_ThreaderMaskOffsets.clear();
+  }
+  catch( std::bad_alloc & )
+  {
+    this->m_MaskOffsets.clear();
+    this->m_ThreaderMaskOffsets.clear();
+    itkExceptionMacro( << "ERROR: failed to allocate memory for the list of voxels inside the mask." );
+  }
+
+  /** Remember what the list was built for. */
+  this->m_MaskOffsetsInput      = inputImage.GetPointer();
+  this->m_MaskOffsetsInputMTime = inputImage->GetMTime();
+  this->m_MaskOffsetsMask       = mask.GetPointer();
+  this->m_MaskOffsetsMaskMTime  = mask->GetMTime();
+  this->m_MaskOffsetsRegion     = region;
+
+} // end UpdateMaskOffsets()
+
+
+/**
+ * ******************* ComputeMaskOffsetsThreaderCallback *******************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageRandomSamplerSparseMask< TInputImage >
+::ComputeMaskOffsetsThreaderCallback( void * arg )
+{
+  typedef PersistentThreadPool::ThreadInfoType ThreadInfoType;
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  Self *           self       = static_cast< Self * >( infoStruct->UserData );
+
+  self->ThreadedComputeMaskOffsets( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeMaskOffsetsThreaderCallback()
+
+
+/**
+ * ******************* ThreadedComputeMaskOffsets *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerSparseMask< TInputImage >
+::ThreadedComputeMaskOffsets( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  InputImageConstPointer       inputImage = this->GetInput();
+  const MaskType *             mask       = this->GetMask();
+  const InputImageRegionType & region     = this->GetCroppedInputImageRegion();
+
+  /** Figure out which part of the region to process. */
+  const unsigned long numberOfPixels = region.GetNumberOfPixels();
+  const unsigned long chunkSize      = ( numberOfPixels + numberOfThreads - 1 ) / numberOfThreads;
+  const unsigned long begin          = std::min( numberOfPixels, threadId * chunkSize );
+  const unsigned long end            = std::min( numberOfPixels, begin + chunkSize );
+  if( begin == end )
+  {
+    return;
+  }
+
+  /** Convert the first offset to an index; step through the rest. */
+  InputImageIndexType index = region.GetIndex();
+  unsigned long       rest  = begin;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    index[ d ] += rest % region.GetSize()[ d ];
+    rest       /= region.GetSize()[ d ];
+  }
+
+  MaskOffsetContainerType & offsets = this->m_ThreaderMaskOffsets[ threadId ];
+  InputImagePointType       point;
+  for( unsigned long offset = begin; offset < end; ++offset )
+  {
+    inputImage->TransformIndexToPhysicalPoint( index, point );
+    if( mask->IsInside( point ) )
+    {
+      offsets.push_back( static_cast< MaskOffsetType >( offset ) );
+    }
+
+    /** Next index. */
+    for( unsigned int d = 0; d < InputImageDimension; ++d )
+    {
+      ++index[ d ];
+      if( index[ d ] < region.GetIndex()[ d ]
+        + static_cast< typename InputImageIndexType::IndexValueType >( region.GetSize()[ d ] ) )
+      {
+        break;
+      }
+      index[ d ] = region.GetIndex()[ d ];
+    }
+  }
+
+} // end ThreadedComputeMaskOffsets()
+
+
+/**
+ * ******************* ComputeSample *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerSparseMask< TInputImage >
+::ComputeSample( const MaskOffsetType offset, ImageSampleType & sample ) const
+{
+  const InputImageRegionType & region = this->m_MaskOffsetsRegion;
+  InputImageIndexType          index  = region.GetIndex();
+  unsigned long                rest   = offset;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    index[ d ] += rest % region.GetSize()[ d ];
+    rest       /= region.GetSize()[ d ];
+  }
+
+  const InputImageType * inputImage = this->m_MaskOffsetsInput;
+  inputImage->TransformIndexToPhysicalPoint( index, sample.m_ImageCoordinates );
+  sample.m_ImageValue = inputImage->GetPixel( index );
+
+} // end ComputeSample()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -207,7 +362,7 @@ ImageRandomSamplerSparseMask< TInputImage >
 {
   Superclass::PrintSelf( os, indent );
 
-  os << indent << "InternalFullSampler: " << this->m_InternalFullSampler.GetPointer() << std::endl;
+  os << indent << "NumberOfVoxelsInsideMask: " << this->m_MaskOffsets.size() << std::endl;
   os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
 
 } // end PrintSelf()
@@ -0,0 +1,205 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageSampleArrays_h
+#define __itkImageSampleArrays_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkContinuousIndex.h"
+#include "itkImageSample.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageSampleArrays
+ *
+ * \brief A structure-of-arrays version of a container of ImageSample's.
+ *
+ * The ImageSampleContainer stores every sample as a point and a value.
+ * This class stores the coordinates of every dimension, the sample values,
+ * and optionally the continuous indices of the samples into the sampled
+ * image, in separate contiguous arrays. Loops over the samples that only
+ * need part of this information then stream through memory without
+ * loading unused data, and loops over one coordinate can be vectorized.
+ *
+ * The arrays are filled by ImageSamplerBase::GetSampleArrays().
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TImage >
+class ImageSampleArrays : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageSampleArrays          Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageSampleArrays, Object );
+
+  /** Typedef's. */
+  typedef TImage                                  ImageType;
+  typedef ImageSample< ImageType >                ImageSampleType;
+  typedef typename ImageSampleType::PointType     PointType;
+  typedef typename PointType::ValueType           CoordRepType;
+  typedef typename ImageSampleType::RealType      RealType;
+  typedef ContinuousIndex< CoordRepType,
+    ImageType::ImageDimension >                   ContinuousIndexType;
+  typedef std::vector< CoordRepType >             CoordinateArrayType;
+  typedef std::vector< RealType >                 ValueArrayType;
+
+  itkStaticConstMacro( ImageDimension, unsigned int, ImageType::ImageDimension );
+
+  /** Resize all arrays. The continuous index arrays are only allocated
+   * when withContinuousIndices is true. */
+  void Resize( const SizeValueType numberOfSamples, const bool withContinuousIndices )
+  {
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      this->m_Coordinates[ d ].resize( numberOfSamples );
+      this->m_ContinuousIndices[ d ].resize( withContinuousIndices ? numberOfSamples : 0 );
+    }
+    this->m_Values.resize( numberOfSamples );
+    this->m_HasContinuousIndices = withContinuousIndices;
+  }
+
+
+  /** Get the number of samples. */
+  SizeValueType Size( void ) const
+  {
+    return this->m_Values.size();
+  }
+
+
+  /** Whether the continuous indices are available. */
+  bool GetHasContinuousIndices( void ) const
+  {
+    return this->m_HasContinuousIndices;
+  }
+
+
+  /** Direct access to the arrays. */
+  CoordinateArrayType & GetCoordinates( const unsigned int dim )
+  {
+    return this->m_Coordinates[ dim ];
+  }
+
+
+  const CoordinateArrayType & GetCoordinates( const unsigned int dim ) const
+  {
+    return this->m_Coordinates[ dim ];
+  }
+
+
+  CoordinateArrayType & GetContinuousIndices( const unsigned int dim )
+  {
+    return this->m_ContinuousIndices[ dim ];
+  }
+
+
+  const CoordinateArrayType & GetContinuousIndices( const unsigned int dim ) const
+  {
+    return this->m_ContinuousIndices[ dim ];
+  }
+
+
+  ValueArrayType & GetValues( void )
+  {
+    return this->m_Values;
+  }
+
+
+  const ValueArrayType & GetValues( void ) const
+  {
+    return this->m_Values;
+  }
+
+
+  /** Gather the coordinates of sample i into a point. */
+  void GetPoint( const SizeValueType i, PointType & point ) const
+  {
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      point[ d ] = this->m_Coordinates[ d ][ i ];
+    }
+  }
+
+
+  /** Gather the coordinates of the samples [begin, begin + n[ into an
+   * array of points, e.g. for AdvancedTransform::TransformPoints(). */
+  void GetPoints( const SizeValueType begin, const SizeValueType n, PointType * points ) const
+  {
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      const CoordRepType * coordinates = &( this->m_Coordinates[ d ][ begin ] );
+      for( SizeValueType i = 0; i < n; ++i )
+      {
+        points[ i ][ d ] = coordinates[ i ];
+      }
+    }
+  }
+
+
+  /** Gather the continuous index of sample i. */
+  void GetContinuousIndex( const SizeValueType i, ContinuousIndexType & cindex ) const
+  {
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      cindex[ d ] = this->m_ContinuousIndices[ d ][ i ];
+    }
+  }
+
+
+protected:
+
+  ImageSampleArrays() : m_HasContinuousIndices( false ) {}
+  virtual ~ImageSampleArrays() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const
+  {
+    Superclass::PrintSelf( os, indent );
+    os << indent << "Size: " << this->Size() << std::endl;
+    os << indent << "HasContinuousIndices: " << this->m_HasContinuousIndices << std::endl;
+  }
+
+
+private:
+
+  ImageSampleArrays( const Self & ); // purposely not implemented
+  void operator=( const Self & );    // purposely not implemented
+
+  CoordinateArrayType m_Coordinates[ ImageDimension ];
+  CoordinateArrayType m_ContinuousIndices[ ImageDimension ];
+  ValueArrayType      m_Values;
+  bool                m_HasContinuousIndices;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageSampleArrays_h
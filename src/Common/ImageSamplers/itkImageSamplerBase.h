@@ -20,8 +20,11 @@
 
 #include "itkImageToVectorContainerFilter.h"
 #include "itkImageSample.h"
+#include "itkImageSampleArrays.h"
 #include "itkVectorDataContainer.h"
 #include "itkSpatialObject.h"
+#include "itkMultiThreader.h"
+#include <vector>
 
 namespace itk
 {
@@ -87,6 +90,11 @@ public:
   typedef typename MaskType::ConstPointer                       MaskConstPointer;
   typedef std::vector< MaskConstPointer >                       MaskVectorType;
   typedef std::vector< InputImageRegionType >                   InputImageRegionVectorType;
+  typedef ImageSampleArrays< InputImageType >                   ImageSampleArraysType;
+  typedef typename ImageSampleArraysType::Pointer               ImageSampleArraysPointer;
+
+  /** The importance weights of the samples, see GetSampleWeights(). */
+  typedef std::vector< double > SampleWeightContainerType;
 
   /** ******************** Masks ******************** */
 
@@ -161,6 +169,14 @@ public:
   }
 
 
+  /** Set/Get a region to which the samples are restricted, in addition to
+   * the input image region and the bounding box of the mask, such as the
+   * part of the fixed image that overlaps the moving image. An empty region,
+   * the default, means no restriction.
+   */
+  itkSetMacro( OverlapRegion, InputImageRegionType );
+  itkGetConstReferenceMacro( OverlapRegion, InputImageRegionType );
+
   /** Get a handle to the cropped InputImageregion. */
   itkGetConstReferenceMacro( CroppedInputImageRegion, InputImageRegionType );
 
@@ -170,13 +186,90 @@ public:
   /** \todo: Temporary, should think about interface. */
   itkSetMacro( UseMultiThread, bool );
 
+  /** ******************** Structure of arrays ******************** */
+
+  /** Get the output samples as a structure of arrays. The arrays are
+   * (re)filled from the output sample container only when the output has
+   * been modified since the last call. This function is not thread-safe;
+   * call it after Update(), before starting the threads that use it.
+   */
+  virtual const ImageSampleArraysType * GetSampleArrays( void );
+
+  /** Whether GetSampleArrays() also stores the continuous index of every
+   * sample into the input image. Default: false.
+   */
+  itkSetMacro( ComputeContinuousIndices, bool );
+  itkGetConstMacro( ComputeContinuousIndices, bool );
+  itkBooleanMacro( ComputeContinuousIndices );
+
+  /** ******************** Sample weights ******************** */
+
+  /** Get the importance weights of the output samples, one per sample, in
+   * the order of the output container. Samplers that do not draw the samples
+   * uniformly, like the ImageImportanceSampler, set these to correct for the
+   * sampling probability. An empty container means that all samples have
+   * weight one, which is the case for all other samplers.
+   */
+  const SampleWeightContainerType & GetSampleWeights( void ) const
+  {
+    return this->m_SampleWeights;
+  }
+
+
+  /** ******************** Sample prefetching ******************** */
+
+  /** Double-buffered sampling. After every sample set that was generated on
+   * request of SelectNewSamplesOnUpdate(), the next sample set is drawn in a
+   * background thread, while the current set is in use. The next call to
+   * SelectNewSamplesOnUpdate() and Update() swaps the prefetched set into the
+   * output, instead of generating it. Only samplers for which
+   * SamplePrefetchingSupported() returns true use this. Default: false.
+   */
+  itkSetMacro( UseSamplePrefetching, bool );
+  itkGetConstMacro( UseSamplePrefetching, bool );
+  itkBooleanMacro( UseSamplePrefetching );
+
+  /** Whether the sampler supports sample prefetching. This requires that
+   * the samples do not depend on the moment they are drawn, see for example
+   * ImageRandomSamplerBase::UseCounterBasedRandomGenerator.
+   */
+  virtual bool SamplePrefetchingSupported( void ) const
+  {
+    return false;
+  }
+
+
+  /** Wait for a running prefetch and throw its samples away. Must be called
+   * before the input image or the masks are changed or regenerated, for
+   * example at the end of a resolution.
+   */
+  void DiscardPrefetchedSamples( void );
+
+  /** Release the samples, the prefetched samples and the per-thread sample
+   * containers. The next Update() generates the samples again. Used between
+   * resolutions in the LowMemoryMode of elastix.
+   */
+  virtual void ReleaseMemory( void );
+
+  /** Get the memory held by the sampler in bytes: the samples, the
+   * prefetched samples, the per-thread sample containers and the sample
+   * arrays.
+   */
+  virtual SizeValueType GetMemoryUsage( void ) const;
+
+  /** Overridden to discard the prefetched samples, which were drawn with
+   * the old settings. Note that GenerateData() may therefore not modify
+   * the sampler itself.
+   */
+  virtual void Modified( void ) const;
+
 protected:
 
   /** The constructor. */
   ImageSamplerBase();
 
   /** The destructor. */
-  virtual ~ImageSamplerBase() {}
+  virtual ~ImageSamplerBase();
 
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
@@ -201,11 +294,52 @@ protected:
   /** Multi-threaded function that does the work. */
   virtual void BeforeThreadedGenerateData( void );
 
+  /** Merge the samples of all threads into the sample container to fill.
+   * The offset of each thread follows from a prefix sum of the sample
+   * counts, so the threads copy their samples in parallel, in thread order.
+   */
   virtual void AfterThreadedGenerateData( void );
 
+  /** Static callback for merging the samples of the threads. */
+  static ITK_THREAD_RETURN_TYPE MergeThreaderSamplesCallback( void * arg );
+
+  /** Fill the structure of arrays from the output sample container.
+   * Subclasses that generate their samples in a suitable order may
+   * override this to fill the arrays directly.
+   */
+  virtual void FillSampleArrays( ImageSampleArraysType * sampleArrays );
+
+  /** Swap the prefetched samples into the output, if new samples were
+   * requested and the prefetched samples are still valid. Subclasses that
+   * support prefetching call this at the start of GenerateData(), and
+   * return immediately when it returns true.
+   */
+  bool UsePrefetchedSamples( void );
+
+  /** The sample container that GenerateData() should fill: the prefetch
+   * buffer when running in the background thread, the output otherwise.
+   */
+  ImageSampleContainerType * GetSampleContainerToFill( void );
+
+  /** Whether GenerateData() runs in the background thread. */
+  itkGetConstMacro( GeneratingPrefetchedSamples, bool );
+
+  /** Called when prefetched samples are thrown away, so that subclasses can
+   * undo the state changes of the prefetch, like advancing a random stream.
+   */
+  virtual void AfterDiscardingPrefetchedSamples( void ) {}
+
+  /** Overridden to start the next prefetch after the output was generated. */
+  virtual void UpdateOutputData( DataObject * output );
+
   /***/
   unsigned long                              m_NumberOfSamples;
   std::vector< ImageSampleContainerPointer > m_ThreaderSampleContainer;
+  std::vector< unsigned long >               m_ThreaderSampleOffsets;
+  ImageSampleContainerType *                 m_ThreaderMergeContainer;
+
+  /** The importance weights of the output samples, see GetSampleWeights(). */
+  SampleWeightContainerType m_SampleWeights;
 
   //tmp?
   bool m_UseMultiThread;
@@ -226,8 +360,34 @@ private:
   unsigned int               m_NumberOfInputImageRegions;
 
   InputImageRegionType m_CroppedInputImageRegion;
+  InputImageRegionType m_OverlapRegion;
   InputImageRegionType m_DummyInputImageRegion;
 
+  /** Structure of arrays version of the output. */
+  ImageSampleArraysPointer m_SampleArrays;
+  ModifiedTimeType         m_SampleArraysMTime;
+  bool                     m_ComputeContinuousIndices;
+
+  /** Sample prefetching. */
+  void StartSamplePrefetch( void );
+
+  void WaitForSamplePrefetch( void );
+
+  ModifiedTimeType GetSampleInputsMTime( void );
+
+  static ITK_THREAD_RETURN_TYPE SamplePrefetchThreaderCallback( void * arg );
+
+  bool                        m_UseSamplePrefetching;
+  bool                        m_NewSamplesRequested;
+  bool                        m_HasPrefetchedSamples;
+  bool                        m_PrefetchSucceeded;
+  bool                        m_SamplePrefetchRunning;
+  bool                        m_GeneratingPrefetchedSamples;
+  ImageSampleContainerPointer m_PrefetchedSampleContainer;
+  ModifiedTimeType            m_PrefetchInputsMTime;
+  MultiThreader::Pointer      m_SamplePrefetchThreader;
+  ThreadIdType                m_SamplePrefetchThreadId;
+
 };
 
 } // end namespace itk
@@ -19,6 +19,8 @@
 #define __ImageSamplerBase_hxx
 
 #include "itkImageSamplerBase.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -38,10 +40,42 @@ ImageSamplerBase< TInputImage >
 
   //tmp?
   this->m_UseMultiThread = false;
+  this->m_ThreaderMergeContainer = 0;
+
+  this->m_SampleArrays             = 0;
+  this->m_SampleArraysMTime        = 0;
+  this->m_ComputeContinuousIndices = false;
+
+  this->m_UseSamplePrefetching        = false;
+  this->m_NewSamplesRequested         = false;
+  this->m_HasPrefetchedSamples        = false;
+  this->m_PrefetchSucceeded           = false;
+  this->m_SamplePrefetchRunning       = false;
+  this->m_GeneratingPrefetchedSamples = false;
+  this->m_PrefetchedSampleContainer   = 0;
+  this->m_PrefetchInputsMTime         = 0;
+  this->m_SamplePrefetchThreader      = 0;
+  this->m_SamplePrefetchThreadId      = 0;
 
 } // end Constructor()
 
 
+/**
+ * ******************* Destructor *******************
+ */
+
+template< class TInputImage >
+ImageSamplerBase< TInputImage >
+::~ImageSamplerBase()
+{
+  /** Subclasses that support prefetching should already have stopped the
+   * background thread in their destructor, since it calls their GenerateData().
+   */
+  this->WaitForSamplePrefetch();
+
+} // end Destructor()
+
+
 /**
  * ******************* SetMask *******************
  */
@@ -248,6 +282,15 @@ ImageSamplerBase< TInputImage >
   * Return true to indicate that indeed new samples will be selected.
   * Inheriting subclasses may just return false and do nothing.
   */
+  if( this->m_UseSamplePrefetching && this->SamplePrefetchingSupported() )
+  {
+    /** Keep the prefetched samples: bypass our own Modified(). */
+    this->WaitForSamplePrefetch();
+    this->m_NewSamplesRequested = true;
+    Superclass::Modified();
+    return true;
+  }
+
   this->Modified();
   return true;
 
@@ -403,6 +446,16 @@ ImageSamplerBase< TInputImage >
     }
   }
 
+  /** Restrict the region further to the overlap region, if one is set. */
+  if( this->m_OverlapRegion.GetNumberOfPixels() > 0 )
+  {
+    if( !this->m_CroppedInputImageRegion.Crop( this->m_OverlapRegion ) )
+    {
+      itkExceptionMacro( << "ERROR: the overlap region lies "
+                         << "entirely out of the InputImageRegion!" );
+    }
+  }
+
 } // end CropInputImageRegion()
 
 
@@ -435,27 +488,423 @@ void
 ImageSamplerBase< TInputImage >
 ::AfterThreadedGenerateData( void )
 {
-  /** Get the combined number of samples. */
-  this->m_NumberOfSamples = 0;
-  for( std::size_t i = 0; i < this->GetNumberOfThreads(); i++ )
+  /** Get the combined number of samples, and the offset of each thread. */
+  const ThreadIdType numberOfThreads = this->m_ThreaderSampleContainer.size();
+  this->m_ThreaderSampleOffsets.resize( numberOfThreads + 1 );
+  this->m_ThreaderSampleOffsets[ 0 ] = 0;
+  for( ThreadIdType i = 0; i < numberOfThreads; i++ )
   {
-    this->m_NumberOfSamples += this->m_ThreaderSampleContainer[ i ]->Size();
+    this->m_ThreaderSampleOffsets[ i + 1 ] = this->m_ThreaderSampleOffsets[ i ]
+      + this->m_ThreaderSampleContainer[ i ]->Size();
   }
+  this->m_NumberOfSamples = this->m_ThreaderSampleOffsets[ numberOfThreads ];
 
   /** Get handle to the output sample container. */
-  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetSampleContainerToFill();
   sampleContainer->clear();
-  sampleContainer->reserve( this->m_NumberOfSamples );
+  sampleContainer->resize( this->m_NumberOfSamples );
 
   /** Combine the results of all threads. */
-  for( std::size_t i = 0; i < this->GetNumberOfThreads(); i++ )
+  this->m_ThreaderMergeContainer = sampleContainer.GetPointer();
+  PersistentThreadPool::GetGlobalThreadPool()->SingleMethodExecute(
+    this->MergeThreaderSamplesCallback, this, numberOfThreads );
+  this->m_ThreaderMergeContainer = 0;
+
+} // end AfterThreadedGenerateData()
+
+
+/**
+ * ******************* MergeThreaderSamplesCallback *******************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageSamplerBase< TInputImage >
+::MergeThreaderSamplesCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  Self *             self     = static_cast< Self * >( infoStruct->UserData );
+  const ThreadIdType threadId = infoStruct->ThreadID;
+
+  const ImageSampleContainerType * threaderSamples
+    = self->m_ThreaderSampleContainer[ threadId ].GetPointer();
+  std::copy( threaderSamples->begin(), threaderSamples->end(),
+    self->m_ThreaderMergeContainer->begin()
+    + self->m_ThreaderSampleOffsets[ threadId ] );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end MergeThreaderSamplesCallback()
+
+
+/**
+ * ******************* Modified *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::Modified( void ) const
+{
+  if( this->m_HasPrefetchedSamples || this->m_SamplePrefetchRunning )
   {
-    sampleContainer->insert( sampleContainer->end(),
-      this->m_ThreaderSampleContainer[ i ]->begin(),
-      this->m_ThreaderSampleContainer[ i ]->end() );
+    const_cast< Self * >( this )->DiscardPrefetchedSamples();
   }
+  Superclass::Modified();
 
-} // end AfterThreadedGenerateData()
+} // end Modified()
+
+
+/**
+ * ******************* DiscardPrefetchedSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::DiscardPrefetchedSamples( void )
+{
+  this->WaitForSamplePrefetch();
+  if( this->m_HasPrefetchedSamples )
+  {
+    this->m_HasPrefetchedSamples = false;
+    this->AfterDiscardingPrefetchedSamples();
+  }
+
+} // end DiscardPrefetchedSamples()
+
+
+/**
+ * ******************* ReleaseMemory *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::ReleaseMemory( void )
+{
+  this->DiscardPrefetchedSamples();
+  this->m_PrefetchedSampleContainer = 0;
+  this->m_ThreaderSampleContainer.clear();
+  this->m_SampleArrays      = 0;
+  this->m_SampleArraysMTime = 0;
+  SampleWeightContainerType().swap( this->m_SampleWeights );
+
+  /** ReleaseData() only clears the output, the swap frees its memory. */
+  ImageSampleContainerType * output = this->GetOutput();
+  output->ReleaseData();
+  typename ImageSampleContainerType::STLContainerType().swap( output->CastToSTLContainer() );
+
+} // end ReleaseMemory()
+
+
+/**
+ * ******************* GetMemoryUsage *******************
+ */
+
+template< class TInputImage >
+SizeValueType
+ImageSamplerBase< TInputImage >
+::GetMemoryUsage( void ) const
+{
+  const ImageSampleContainerType * output
+    = dynamic_cast< const ImageSampleContainerType * >( this->ProcessObject::GetOutput( 0 ) );
+  SizeValueType numberOfSamples = output ? output->capacity() : 0;
+  if( this->m_PrefetchedSampleContainer.IsNotNull() )
+  {
+    numberOfSamples += this->m_PrefetchedSampleContainer->capacity();
+  }
+  for( std::size_t i = 0; i < this->m_ThreaderSampleContainer.size(); ++i )
+  {
+    if( this->m_ThreaderSampleContainer[ i ].IsNotNull() )
+    {
+      numberOfSamples += this->m_ThreaderSampleContainer[ i ]->capacity();
+    }
+  }
+
+  SizeValueType usage = numberOfSamples * sizeof( ImageSampleType )
+    + this->m_SampleWeights.capacity() * sizeof( double );
+  if( this->m_SampleArrays.IsNotNull() )
+  {
+    const SizeValueType numberOfCoordinates
+      = this->m_SampleArrays->GetHasContinuousIndices() ? 2 * InputImageDimension : InputImageDimension;
+    usage += this->m_SampleArrays->Size()
+      * ( numberOfCoordinates * sizeof( typename ImageSampleArraysType::CoordRepType )
+      + sizeof( typename ImageSampleArraysType::RealType ) );
+  }
+  return usage;
+
+} // end GetMemoryUsage()
+
+
+/**
+ * ******************* UsePrefetchedSamples *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSamplerBase< TInputImage >
+::UsePrefetchedSamples( void )
+{
+  /** In the background thread the samples are generated as usual. */
+  if( this->m_GeneratingPrefetchedSamples )
+  {
+    return false;
+  }
+
+  /** The prefetched samples can only be used for a new sample set, when
+   * they were drawn from the same input image and masks.
+   */
+  this->WaitForSamplePrefetch();
+  if( !this->m_HasPrefetchedSamples )
+  {
+    return false;
+  }
+  if( !this->m_UseSamplePrefetching || !this->m_NewSamplesRequested
+    || !this->m_PrefetchSucceeded
+    || this->GetSampleInputsMTime() != this->m_PrefetchInputsMTime )
+  {
+    this->DiscardPrefetchedSamples();
+    return false;
+  }
+
+  /** Swap the buffers. */
+  this->GetOutput()->swap( *this->m_PrefetchedSampleContainer );
+  this->m_NumberOfSamples      = this->GetOutput()->Size();
+  this->m_HasPrefetchedSamples = false;
+  return true;
+
+} // end UsePrefetchedSamples()
+
+
+/**
+ * ******************* GetSampleContainerToFill *******************
+ */
+
+template< class TInputImage >
+typename ImageSamplerBase< TInputImage >::ImageSampleContainerType *
+ImageSamplerBase< TInputImage >
+::GetSampleContainerToFill( void )
+{
+  if( this->m_GeneratingPrefetchedSamples )
+  {
+    return this->m_PrefetchedSampleContainer.GetPointer();
+  }
+  return this->GetOutput();
+
+} // end GetSampleContainerToFill()
+
+
+/**
+ * ******************* UpdateOutputData *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::UpdateOutputData( DataObject * output )
+{
+  /** The background thread may not run while the output is generated. */
+  this->WaitForSamplePrefetch();
+
+  const bool newSamplesRequested = this->m_NewSamplesRequested;
+  Superclass::UpdateOutputData( output );
+  this->m_NewSamplesRequested = false;
+
+  /** Draw the next sample set while the current one is in use. */
+  if( newSamplesRequested && this->m_UseSamplePrefetching
+    && this->SamplePrefetchingSupported() )
+  {
+    this->StartSamplePrefetch();
+  }
+
+} // end UpdateOutputData()
+
+
+/**
+ * ******************* StartSamplePrefetch *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::StartSamplePrefetch( void )
+{
+  this->DiscardPrefetchedSamples();
+
+  if( this->m_PrefetchedSampleContainer.IsNull() )
+  {
+    this->m_PrefetchedSampleContainer = ImageSampleContainerType::New();
+  }
+  if( this->m_SamplePrefetchThreader.IsNull() )
+  {
+    this->m_SamplePrefetchThreader = MultiThreader::New();
+  }
+  this->m_PrefetchedSampleContainer->Initialize();
+  this->m_PrefetchInputsMTime = this->GetSampleInputsMTime();
+
+  /** The flags are set before the thread starts, and reset after it was joined. */
+  this->m_PrefetchSucceeded           = false;
+  this->m_HasPrefetchedSamples        = true;
+  this->m_GeneratingPrefetchedSamples = true;
+  this->m_SamplePrefetchRunning       = true;
+  this->m_SamplePrefetchThreadId      = this->m_SamplePrefetchThreader->SpawnThread(
+    this->SamplePrefetchThreaderCallback, this );
+
+} // end StartSamplePrefetch()
+
+
+/**
+ * ******************* WaitForSamplePrefetch *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::WaitForSamplePrefetch( void )
+{
+  if( this->m_SamplePrefetchRunning )
+  {
+    this->m_SamplePrefetchThreader->TerminateThread( this->m_SamplePrefetchThreadId );
+    this->m_SamplePrefetchRunning       = false;
+    this->m_GeneratingPrefetchedSamples = false;
+  }
+
+} // end WaitForSamplePrefetch()
+
+
+/**
+ * ******************* GetSampleInputsMTime *******************
+ */
+
+template< class TInputImage >
+ModifiedTimeType
+ImageSamplerBase< TInputImage >
+::GetSampleInputsMTime( void )
+{
+  ModifiedTimeType mtime = 0;
+  if( this->GetInput() )
+  {
+    mtime = this->GetInput()->GetMTime();
+  }
+  for( std::size_t i = 0; i < this->m_MaskVector.size(); ++i )
+  {
+    if( this->m_MaskVector[ i ].IsNotNull() && this->m_MaskVector[ i ]->GetMTime() > mtime )
+    {
+      mtime = this->m_MaskVector[ i ]->GetMTime();
+    }
+  }
+  return mtime;
+
+} // end GetSampleInputsMTime()
+
+
+/**
+ * ******************* SamplePrefetchThreaderCallback *******************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageSamplerBase< TInputImage >
+::SamplePrefetchThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  Self * self = static_cast< Self * >( infoStruct->UserData );
+
+  /** Errors are not reported here: the samples are then generated again in
+   * the main thread, which reports them in the usual way.
+   */
+  try
+  {
+    self->GenerateData();
+    self->m_PrefetchSucceeded = true;
+  }
+  catch( ... )
+  {
+    self->m_PrefetchSucceeded = false;
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end SamplePrefetchThreaderCallback()
+
+
+/**
+ * ******************* GetSampleArrays *******************
+ */
+
+template< class TInputImage >
+const typename ImageSamplerBase< TInputImage >::ImageSampleArraysType *
+ImageSamplerBase< TInputImage >
+::GetSampleArrays( void )
+{
+  if( this->m_SampleArrays.IsNull() )
+  {
+    this->m_SampleArrays = ImageSampleArraysType::New();
+  }
+
+  /** Only convert when the samples or the settings have changed. */
+  const ModifiedTimeType outputMTime = this->GetOutput()->GetMTime();
+  if( outputMTime != this->m_SampleArraysMTime
+    || this->m_SampleArrays->GetHasContinuousIndices() != this->m_ComputeContinuousIndices )
+  {
+    this->FillSampleArrays( this->m_SampleArrays );
+    this->m_SampleArraysMTime = outputMTime;
+  }
+
+  return this->m_SampleArrays.GetPointer();
+
+} // end GetSampleArrays()
+
+
+/**
+ * ******************* FillSampleArrays *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::FillSampleArrays( ImageSampleArraysType * sampleArrays )
+{
+  const ImageSampleContainerType * sampleContainer = this->GetOutput();
+  const unsigned long              numberOfSamples = sampleContainer->Size();
+  sampleArrays->Resize( numberOfSamples, this->m_ComputeContinuousIndices );
+
+  /** Copy the values and the coordinates. */
+  typename ImageSampleArraysType::ValueArrayType & values = sampleArrays->GetValues();
+  for( unsigned long i = 0; i < numberOfSamples; ++i )
+  {
+    values[ i ] = sampleContainer->ElementAt( i ).m_ImageValue;
+  }
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    typename ImageSampleArraysType::CoordinateArrayType & coordinates
+      = sampleArrays->GetCoordinates( d );
+    for( unsigned long i = 0; i < numberOfSamples; ++i )
+    {
+      coordinates[ i ] = sampleContainer->ElementAt( i ).m_ImageCoordinates[ d ];
+    }
+  }
+
+  /** Compute the continuous indices into the input image. */
+  if( this->m_ComputeContinuousIndices )
+  {
+    const InputImageType *                              inputImage = this->GetInput();
+    typename ImageSampleArraysType::ContinuousIndexType cindex;
+    for( unsigned long i = 0; i < numberOfSamples; ++i )
+    {
+      inputImage->TransformPhysicalPointToContinuousIndex(
+        sampleContainer->ElementAt( i ).m_ImageCoordinates, cindex );
+      for( unsigned int d = 0; d < InputImageDimension; ++d )
+      {
+        sampleArrays->GetContinuousIndices( d )[ i ] = cindex[ d ];
+      }
+    }
+  }
+
+} // end FillSampleArrays()
 
 
 /**
@@ -485,6 +934,8 @@ ImageSamplerBase< TInputImage >
     os << indent.GetNextIndent() << this->m_InputImageRegionVector[ i ] << std::endl;
   }
   os << indent << "CroppedInputImageRegion" << this->m_CroppedInputImageRegion << std::endl;
+  os << indent << "OverlapRegion" << this->m_OverlapRegion << std::endl;
+  os << indent << "ComputeContinuousIndices: " << this->m_ComputeContinuousIndices << std::endl;
 
 } // end PrintSelf()
 
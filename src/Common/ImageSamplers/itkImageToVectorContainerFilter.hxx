@@ -21,6 +21,7 @@
 #include "itkImageToVectorContainerFilter.h"
 
 #include "itkMath.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -227,11 +228,9 @@ ImageToVectorContainerFilter< TInputImage, TOutputVectorContainer >
   ThreadStruct str;
   str.Filter = this;
 
-  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
-  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
-
-  // multithread the execution
-  this->GetMultiThreader()->SingleMethodExecute();
+  // multithread the execution, on the persistent thread pool
+  PersistentThreadPool::GetGlobalThreadPool()->SingleMethodExecute(
+    this->ThreaderCallback, &str, this->GetNumberOfThreads() );
 
   // Call a method that can be overridden by a subclass to perform
   // some calculations after all the threads have completed
@@ -104,6 +104,13 @@ public:
   itkGetConstMacro( UseRandomSampleRegion, bool );
   itkSetMacro( UseRandomSampleRegion, bool );
 
+  /** This sampler does not support sample prefetching. */
+  virtual bool SamplePrefetchingSupported( void ) const
+  {
+    return false;
+  }
+
+
 protected:
 
   typedef typename InterpolatorType::ContinuousIndexType InputImageContinuousIndexType;
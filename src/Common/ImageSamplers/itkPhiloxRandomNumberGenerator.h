@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPhiloxRandomNumberGenerator_h
+#define __itkPhiloxRandomNumberGenerator_h
+
+#include "itkIntTypes.h"
+
+namespace itk
+{
+
+/** \class PhiloxRandomNumberGenerator
+ *
+ * \brief A counter-based random number generator.
+ *
+ * This class implements the Philox4x32-10 generator of Salmon et al.,
+ * "Parallel random numbers: as easy as 1, 2, 3", SC 2011. In contrast to the
+ * Mersenne Twister, its output is a pure function of a 64-bit key (the seed)
+ * and a 128-bit counter. A stream, identified by a 64-bit stream id and a
+ * 32-bit substream id, can therefore be started at any moment in any thread,
+ * without generating the numbers of the preceding streams. The image
+ * samplers use one stream per sample, so that the samples are independent
+ * of the number of threads.
+ *
+ * The class is intentionally lightweight, no itk::Object, so that every
+ * thread can create its own generator on the stack.
+ *
+ * \ingroup ImageSamplers
+ */
+
+class PhiloxRandomNumberGenerator
+{
+public:
+
+  /** Typedefs. */
+  typedef uint32_t WordType;
+  typedef uint64_t SeedType;
+  typedef uint64_t StreamIdType;
+
+  /** Constructor. The default seed equals that of the Mersenne Twister. */
+  explicit PhiloxRandomNumberGenerator( const SeedType seed = 121212 )
+  {
+    this->SetSeed( seed );
+    this->SetStream( 0, 0 );
+  }
+
+
+  /** Set the seed, i.e. the key of the generator. */
+  void SetSeed( const SeedType seed )
+  {
+    this->m_Key[ 0 ] = static_cast< WordType >( seed );
+    this->m_Key[ 1 ] = static_cast< WordType >( seed >> 32 );
+  }
+
+
+  /** Go to the start of stream (streamId, substreamId). */
+  void SetStream( const StreamIdType streamId, const WordType substreamId )
+  {
+    this->m_Counter[ 0 ] = static_cast< WordType >( streamId );
+    this->m_Counter[ 1 ] = static_cast< WordType >( streamId >> 32 );
+    this->m_Counter[ 2 ] = 0;
+    this->m_Counter[ 3 ] = substreamId;
+    this->m_ResultIndex  = 4;
+  }
+
+
+  /** Get the next 32 random bits of the current stream. */
+  WordType GetIntegerVariate( void )
+  {
+    if( this->m_ResultIndex == 4 )
+    {
+      Philox4x32( this->m_Counter, this->m_Key, this->m_Result );
+      ++this->m_Counter[ 2 ];
+      this->m_ResultIndex = 0;
+    }
+    return this->m_Result[ this->m_ResultIndex++ ];
+  }
+
+
+  /** Get a uniform variate in [0, 1), with 53 random bits. */
+  double GetVariate( void )
+  {
+    const WordType a = this->GetIntegerVariate() >> 5;
+    const WordType b = this->GetIntegerVariate() >> 6;
+    return ( a * 67108864.0 + b ) * ( 1.0 / 9007199254740992.0 );
+  }
+
+
+  /** Get a uniform variate in [a, b). */
+  double GetUniformVariate( const double a, const double b )
+  {
+    return a + ( b - a ) * this->GetVariate();
+  }
+
+
+  /** The Philox4x32-10 bijection: result = f_key( counter ). */
+  static void Philox4x32( const WordType counter[ 4 ], const WordType key[ 2 ],
+    WordType result[ 4 ] )
+  {
+    WordType c0 = counter[ 0 ];
+    WordType c1 = counter[ 1 ];
+    WordType c2 = counter[ 2 ];
+    WordType c3 = counter[ 3 ];
+    WordType k0 = key[ 0 ];
+    WordType k1 = key[ 1 ];
+    for( unsigned int round = 0; round < 10; ++round )
+    {
+      const uint64_t p0 = static_cast< uint64_t >( 0xD2511F53u ) * c0;
+      const uint64_t p1 = static_cast< uint64_t >( 0xCD9E8D57u ) * c2;
+      c0 = static_cast< WordType >( p1 >> 32 ) ^ c1 ^ k0;
+      c1 = static_cast< WordType >( p1 );
+      c2 = static_cast< WordType >( p0 >> 32 ) ^ c3 ^ k1;
+      c3 = static_cast< WordType >( p0 );
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    result[ 0 ] = c0;
+    result[ 1 ] = c1;
+    result[ 2 ] = c2;
+    result[ 3 ] = c3;
+  }
+
+
+private:
+
+  WordType     m_Key[ 2 ];
+  WordType     m_Counter[ 4 ];
+  WordType     m_Result[ 4 ];
+  unsigned int m_ResultIndex;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPhiloxRandomNumberGenerator_h
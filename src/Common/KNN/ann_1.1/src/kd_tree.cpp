@@ -42,12 +42,13 @@
 //  contains no points.  For messy coding reasons it is convenient
 //  to have it reference a trivial point index.
 //
-//  KD_TRIVIAL is allocated when the first kd-tree is created.  It
-//  must *never* deallocated (since it may be shared by more than
-//  one tree).
+//  KD_TRIVIAL is a static object, so that trees can be created by
+//  different threads at the same time.  It must *never* deallocated
+//  (since it may be shared by more than one tree).
 //----------------------------------------------------------------------
 static int        IDX_TRIVIAL[] = {0};  // trivial point index
-ANNkd_leaf        *KD_TRIVIAL = NULL;   // trivial leaf node
+static ANNkd_leaf KD_TRIVIAL_LEAF(0, IDX_TRIVIAL); // trivial leaf node
+ANNkd_leaf        *KD_TRIVIAL = &KD_TRIVIAL_LEAF;
 
 //----------------------------------------------------------------------
 //  Printing the kd-tree 
@@ -215,15 +216,11 @@ ANNkd_tree::~ANNkd_tree()       // tree destructor
 }
 
 //----------------------------------------------------------------------
-//  This is called with all use of ANN is finished.  It eliminates the
-//  minor memory leak caused by the allocation of KD_TRIVIAL.
+//  This is called with all use of ANN is finished.  KD_TRIVIAL is no
+//  longer allocated, so there is nothing left to clean up.
 //----------------------------------------------------------------------
 void annClose()       // close use of ANN
 {
-  if (KD_TRIVIAL != NULL) {
-    delete KD_TRIVIAL;
-    KD_TRIVIAL = NULL;
-  }
 }
 
 //----------------------------------------------------------------------
@@ -234,11 +231,6 @@ void annClose()       // close use of ANN
 //    assumed to be of the proper size (n).  Otherwise, one is
 //    allocated and initialized to the identity.  Warning: In
 //    either case the destructor will deallocate this array.
-//
-//    As a kludge, we need to allocate KD_TRIVIAL if one has not
-//    already been allocated.  (This is because I'm too dumb to
-//    figure out how to cause a pointer to be allocated at load
-//    time.)
 //----------------------------------------------------------------------
 
 void ANNkd_tree::SkeletonTree(      // construct skeleton tree
@@ -266,8 +258,6 @@ void ANNkd_tree::SkeletonTree(      // construct skeleton tree
   }
 
   bnd_box_lo = bnd_box_hi = NULL;   // bounding box is nonexistent
-  if (KD_TRIVIAL == NULL)       // no trivial leaf node yet?
-    KD_TRIVIAL = new ANNkd_leaf(0, IDX_TRIVIAL);  // allocate it
 }
 
 ANNkd_tree::ANNkd_tree(         // basic constructor
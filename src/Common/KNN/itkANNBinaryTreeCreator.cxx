@@ -24,7 +24,8 @@
 namespace itk
 {
 
-unsigned int ANNBinaryTreeCreator::m_NumberOfANNBinaryTrees = 0;
+unsigned int        ANNBinaryTreeCreator::m_NumberOfANNBinaryTrees = 0;
+SimpleFastMutexLock ANNBinaryTreeCreator::m_ReferenceCountMutex;
 
 /**
  * ************************ CreateANNkDTree *************************
@@ -106,7 +107,9 @@ ANNBinaryTreeCreator::DeleteANNBruteForceTree( ANNBruteForceTreeType * & tree )
 void
 ANNBinaryTreeCreator::IncreaseReferenceCount( void )
 {
+  m_ReferenceCountMutex.Lock();
   m_NumberOfANNBinaryTrees++;
+  m_ReferenceCountMutex.Unlock();
 }   // end IncreaseReferenceCount
 
 
@@ -117,11 +120,13 @@ ANNBinaryTreeCreator::IncreaseReferenceCount( void )
 void
 ANNBinaryTreeCreator::DecreaseReferenceCount( void )
 {
+  m_ReferenceCountMutex.Lock();
   m_NumberOfANNBinaryTrees--;
   if( m_NumberOfANNBinaryTrees == 0 )
   {
     annClose();
   }
+  m_ReferenceCountMutex.Unlock();
 }   // end DecreaseReferenceCount
 
 
@@ -0,0 +1,125 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTiledBruteForceTree_h
+#define __itkTiledBruteForceTree_h
+
+#include "itkBinaryTreeBase.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * \class TiledBruteForceTree
+ *
+ * \brief A "tree" for exact brute force kNN searching.
+ *
+ * This class does not build a tree at all. It copies the samples of the
+ * ListSampleCArray to a dimension-major layout, i.e. all first coordinates,
+ * then all second coordinates, etc., padded to a multiple of the tile size.
+ * The TiledBruteForceTreeSearch then computes the distances of a query point
+ * to a whole tile of points in tight loops that the compiler can vectorize.
+ * For the small sample sets and high dimensional feature spaces of the
+ * KNNGraphAlphaMutualInformation this is often faster than the search of a
+ * kd-tree, which degrades to a brute force search with a lot of overhead.
+ *
+ * \ingroup ANNwrap
+ */
+
+template< class TListSample >
+class TiledBruteForceTree : public BinaryTreeBase< TListSample >
+{
+public:
+
+  /** Standard itk. */
+  typedef TiledBruteForceTree           Self;
+  typedef BinaryTreeBase< TListSample > Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** New method for creating an object using a factory. */
+  itkNewMacro( Self );
+
+  /** ITK type info. */
+  itkTypeMacro( TiledBruteForceTree, BinaryTreeBase );
+
+  /** Typedef's from Superclass. */
+  typedef typename Superclass::SampleType                 SampleType;
+  typedef typename Superclass::MeasurementVectorType      MeasurementVectorType;
+  typedef typename Superclass::MeasurementVectorSizeType  MeasurementVectorSizeType;
+  typedef typename Superclass::TotalAbsoluteFrequencyType TotalAbsoluteFrequencyType;
+
+  /** Typedef's. */
+  typedef std::vector< double > CoordinateContainerType;
+
+  /** The number of points in a tile. */
+  itkStaticConstMacro( TileSize, unsigned int, 64 );
+
+  /** Generate the tree, i.e. copy the samples to the tiled layout. */
+  virtual void GenerateTree( void );
+
+  /** Get the coordinates: coordinate d of point i is stored at
+   * d * GetPaddedNumberOfPoints() + i. */
+  const double * GetCoordinates( void ) const
+  {
+    return this->m_Coordinates.empty() ? 0 : &( this->m_Coordinates[ 0 ] );
+  }
+
+
+  /** Get the number of points. */
+  unsigned long GetNumberOfPoints( void ) const
+  {
+    return this->m_NumberOfPoints;
+  }
+
+
+  /** Get the number of points rounded up to a multiple of the tile size. */
+  unsigned long GetPaddedNumberOfPoints( void ) const
+  {
+    return this->m_PaddedNumberOfPoints;
+  }
+
+
+protected:
+
+  TiledBruteForceTree();
+  virtual ~TiledBruteForceTree() {}
+
+  /** PrintSelf. */
+  virtual void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  TiledBruteForceTree( const Self & ); // purposely not implemented
+  void operator=( const Self & );      // purposely not implemented
+
+  /** Member variables. */
+  CoordinateContainerType m_Coordinates;
+  unsigned long           m_NumberOfPoints;
+  unsigned long           m_PaddedNumberOfPoints;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTiledBruteForceTree.hxx"
+#endif
+
+#endif // end #ifndef __itkTiledBruteForceTree_h
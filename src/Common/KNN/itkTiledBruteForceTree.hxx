@@ -0,0 +1,93 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTiledBruteForceTree_hxx
+#define __itkTiledBruteForceTree_hxx
+
+#include "itkTiledBruteForceTree.h"
+
+namespace itk
+{
+
+/**
+ * ************************ Constructor *************************
+ */
+
+template< class TListSample >
+TiledBruteForceTree< TListSample >
+::TiledBruteForceTree()
+{
+  this->m_NumberOfPoints       = 0;
+  this->m_PaddedNumberOfPoints = 0;
+}   // end Constructor
+
+
+/**
+ * ************************ GenerateTree *************************
+ */
+
+template< class TListSample >
+void
+TiledBruteForceTree< TListSample >
+::GenerateTree( void )
+{
+  const unsigned long dim = this->GetDataDimension();
+  const unsigned long nop = this->GetActualNumberOfDataPoints();
+  const unsigned long tileSize = Self::TileSize;
+
+  this->m_NumberOfPoints       = nop;
+  this->m_PaddedNumberOfPoints = ( ( nop + tileSize - 1 ) / tileSize ) * tileSize;
+
+  /** The padding is never compared to a query point, its value is irrelevant. */
+  const unsigned long paddedNop = this->m_PaddedNumberOfPoints;
+  this->m_Coordinates.assign( dim * paddedNop, 0.0 );
+
+  /** Copy the samples, transposing them to the dimension-major layout. */
+  typename SampleType::InternalDataContainerType data
+    = this->GetSample()->GetInternalContainer();
+  for( unsigned long i = 0; i < nop; ++i )
+  {
+    for( unsigned long d = 0; d < dim; ++d )
+    {
+      this->m_Coordinates[ d * paddedNop + i ]
+        = static_cast< double >( data[ i ][ d ] );
+    }
+  }
+
+}   // end GenerateTree
+
+
+/**
+ * ************************ PrintSelf *************************
+ */
+
+template< class TListSample >
+void
+TiledBruteForceTree< TListSample >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfPoints: " << this->m_NumberOfPoints << std::endl;
+  os << indent << "PaddedNumberOfPoints: " << this->m_PaddedNumberOfPoints << std::endl;
+
+}   // end PrintSelf
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTiledBruteForceTree_hxx
@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTiledBruteForceTreeSearch_h
+#define __itkTiledBruteForceTreeSearch_h
+
+#include "itkBinaryTreeSearchBase.h"
+#include "itkTiledBruteForceTree.h"
+
+namespace itk
+{
+
+/**
+ * \class TiledBruteForceTreeSearch
+ *
+ * \brief Exact kNN search in a TiledBruteForceTree.
+ *
+ * The squared distances of the query point to a tile of points are computed
+ * first, one dimension at a time, so that the inner loops run over
+ * consecutive memory and are vectorized by the compiler. Only then the
+ * points of the tile that are closer than the current k-th neighbour are
+ * inserted in the sorted list of neighbours. The search is exact, and, as
+ * with ANN, points at distance zero, such as the query point itself, are only
+ * found when elastix is built with ELASTIX_KNN_ALLOW_SELF_MATCH.
+ *
+ * The searcher does not modify itself during the search, so that several
+ * threads can call Search() at the same time.
+ *
+ * \ingroup ANNwrap
+ */
+
+template< class TListSample >
+class TiledBruteForceTreeSearch :
+  public BinaryTreeSearchBase< TListSample >
+{
+public:
+
+  /** Standard itk. */
+  typedef TiledBruteForceTreeSearch Self;
+  typedef BinaryTreeSearchBase<
+    TListSample >                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** New method for creating an object using a factory. */
+  itkNewMacro( Self );
+
+  /** ITK type info. */
+  itkTypeMacro( TiledBruteForceTreeSearch, BinaryTreeSearchBase );
+
+  /** Typedefs from Superclass. */
+  typedef typename Superclass::ListSampleType        ListSampleType;
+  typedef typename Superclass::BinaryTreeType        BinaryTreeType;
+  typedef typename Superclass::BinaryTreePointer     BinaryTreePointer;
+  typedef typename Superclass::MeasurementVectorType MeasurementVectorType;
+  typedef typename Superclass::IndexArrayType        IndexArrayType;
+  typedef typename Superclass::DistanceArrayType     DistanceArrayType;
+
+  /** The tiled tree. */
+  typedef TiledBruteForceTree< ListSampleType > TiledBruteForceTreeType;
+
+  /** Set the binary tree, which should be a TiledBruteForceTree. */
+  virtual void SetBinaryTree( BinaryTreeType * tree );
+
+  /** Search the nearest neighbours of a query point qp. The dists are
+   * squared distances. When the tree contains less than k points, the
+   * remaining indices are -1 and the distances the maximum double.
+   */
+  virtual void Search( const MeasurementVectorType & qp, IndexArrayType & ind,
+    DistanceArrayType & dists );
+
+protected:
+
+  TiledBruteForceTreeSearch();
+  virtual ~TiledBruteForceTreeSearch();
+
+  /** Member variables. */
+  typename TiledBruteForceTreeType::Pointer m_BinaryTreeAsTiledType;
+
+private:
+
+  TiledBruteForceTreeSearch( const Self & ); // purposely not implemented
+  void operator=( const Self & );            // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTiledBruteForceTreeSearch.hxx"
+#endif
+
+#endif // end #ifndef __itkTiledBruteForceTreeSearch_h
@@ -0,0 +1,166 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTiledBruteForceTreeSearch_hxx
+#define __itkTiledBruteForceTreeSearch_hxx
+
+#include "itkTiledBruteForceTreeSearch.h"
+#include "itkNumericTraits.h"
+#include "vnl/vnl_math.h"
+#include "ANN/ANN.h"
+
+namespace itk
+{
+
+/**
+ * ************************ Constructor *************************
+ */
+
+template< class TListSample >
+TiledBruteForceTreeSearch< TListSample >
+::TiledBruteForceTreeSearch()
+{
+  this->m_BinaryTreeAsTiledType = 0;
+}   // end Constructor
+
+
+/**
+ * ************************ Destructor *************************
+ */
+
+template< class TListSample >
+TiledBruteForceTreeSearch< TListSample >
+::~TiledBruteForceTreeSearch()
+{}  // end Destructor
+
+/**
+ * ************************ SetBinaryTree *************************
+ */
+
+template< class TListSample >
+void
+TiledBruteForceTreeSearch< TListSample >
+::SetBinaryTree( BinaryTreeType * tree )
+{
+  this->Superclass::SetBinaryTree( tree );
+  if( tree )
+  {
+    TiledBruteForceTreeType * testPtr = dynamic_cast< TiledBruteForceTreeType * >( tree );
+    if( testPtr )
+    {
+      if( testPtr != this->m_BinaryTreeAsTiledType )
+      {
+        this->m_BinaryTreeAsTiledType = testPtr;
+        this->Modified();
+      }
+    }
+    else
+    {
+      itkExceptionMacro( << "ERROR: The tree is not of type TiledBruteForceTree." );
+    }
+  }
+  else
+  {
+    if( this->m_BinaryTreeAsTiledType.IsNotNull() )
+    {
+      this->m_BinaryTreeAsTiledType = 0;
+      this->Modified();
+    }
+  }
+
+}   // end SetBinaryTree
+
+
+/**
+ * ************************ Search *************************
+ */
+
+template< class TListSample >
+void
+TiledBruteForceTreeSearch< TListSample >
+::Search( const MeasurementVectorType & qp, IndexArrayType & ind,
+  DistanceArrayType & dists )
+{
+  const unsigned int  tileSize  = TiledBruteForceTreeType::TileSize;
+  const unsigned int  k         = this->m_KNearestNeighbors;
+  const unsigned int  dim       = this->m_DataDimension;
+  const unsigned long nop       = this->m_BinaryTreeAsTiledType->GetNumberOfPoints();
+  const unsigned long paddedNop = this->m_BinaryTreeAsTiledType->GetPaddedNumberOfPoints();
+  const double *      coords    = this->m_BinaryTreeAsTiledType->GetCoordinates();
+
+  /** Initialize the sorted list of neighbours. */
+  ind.SetSize( k );
+  dists.SetSize( k );
+  ind.Fill( -1 );
+  dists.Fill( NumericTraits< double >::max() );
+  if( k == 0 )
+  {
+    return;
+  }
+
+  /** Loop over the tiles. */
+  double tileDistances[ tileSize ];
+  for( unsigned long tileBegin = 0; tileBegin < paddedNop; tileBegin += tileSize )
+  {
+    /** Compute the squared distances to all points of the tile. */
+    const double * x  = coords + tileBegin;
+    const double   q0 = static_cast< double >( qp[ 0 ] );
+    for( unsigned int j = 0; j < tileSize; ++j )
+    {
+      const double diff = x[ j ] - q0;
+      tileDistances[ j ] = diff * diff;
+    }
+    for( unsigned int d = 1; d < dim; ++d )
+    {
+      x = coords + d * paddedNop + tileBegin;
+      const double q = static_cast< double >( qp[ d ] );
+      for( unsigned int j = 0; j < tileSize; ++j )
+      {
+        const double diff = x[ j ] - q;
+        tileDistances[ j ] += diff * diff;
+      }
+    }
+
+    /** Insert the closer points of the tile in the list, skipping the padding.
+     * As in ANN, points at distance zero are only accepted with
+     * ANN_ALLOW_SELF_MATCH, see ELASTIX_KNN_ALLOW_SELF_MATCH. */
+    const unsigned long numberOfPointsInTile
+      = vnl_math_min( static_cast< unsigned long >( tileSize ), nop - tileBegin );
+    for( unsigned int j = 0; j < numberOfPointsInTile; ++j )
+    {
+      const double dist = tileDistances[ j ];
+      if( dist < dists[ k - 1 ] && ( ANN_ALLOW_SELF_MATCH || dist != 0.0 ) )
+      {
+        unsigned int pos = k - 1;
+        while( pos > 0 && dists[ pos - 1 ] > dist )
+        {
+          dists[ pos ] = dists[ pos - 1 ];
+          ind[ pos ]   = ind[ pos - 1 ];
+          --pos;
+        }
+        dists[ pos ] = dist;
+        ind[ pos ]   = static_cast< int >( tileBegin + j );
+      }
+    }
+  }
+
+}   // end Search
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTiledBruteForceTreeSearch_hxx
@@ -44,6 +44,7 @@
 #include "gdcmException.h"
 #include "gdcmFileMetaInformation.h"
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -854,346 +855,192 @@ MevisDicomTiffImageIO::Read( void * buffer )
       return;
     }
 
-    // buffer pointer is scanline based (one dimensional array)
-    // tile is positioned on x,y,z; we read each tile, and fill
-    // the corresponding positions in the onedimensional array
-    unsigned char * vol = reinterpret_cast< unsigned char * >( buffer );
+    // the buffer holds the IO region in scanline order, which may be
+    // part of the image only (streaming). Slice z of the tiff file is
+    // image slice z in 3D, and z + t * sizez in 4D.
+    const ImageIORegion & region = this->GetIORegion();
+    const unsigned int    dim    = this->GetNumberOfDimensions();
 
-    const unsigned int tilesize       = TIFFTileSize( m_TIFFImage );
-    const unsigned int tilerowbytes   = TIFFTileRowSize( m_TIFFImage );
-    const unsigned int bytespersample = m_BitsPerSample / 8;
-
-    unsigned char * tilebuf = static_cast< unsigned char * >( _TIFFmalloc( tilesize ) );
-
-    //
-    // special cases, if the tilexy is larger than or equal to the image
-    // size itself, treat as three separate cases, both are larger/equal,
-    // or only direction
-    //
-    bool tileoversized( false );
-
-    if( m_TileLength >= m_Length || m_TileWidth >= m_Width )
+    ReadTilesParameterType parameters;
+    parameters.st_Self   = this;
+    parameters.st_Buffer = reinterpret_cast< unsigned char * >( buffer );
+    for( unsigned int i = 0; i < 2; ++i )
     {
-      tileoversized = true;
-
-      // case one both x,y is larger
-      if( m_TileLength >= m_Length && m_TileWidth >= m_Width )
+      parameters.st_RegionIndex[ i ] = region.GetIndex( i );
+      parameters.st_RegionSize[ i ]  = region.GetSize( i );
+    }
+    const unsigned int z0 = dim > 2 ? region.GetIndex( 2 ) : 0;
+    const unsigned int nz = dim > 2 ? region.GetSize( 2 ) : 1;
+    const unsigned int t0 = dim > 3 ? region.GetIndex( 3 ) : 0;
+    const unsigned int nt = dim > 3 ? region.GetSize( 3 ) : 1;
+    const unsigned int sz = dim > 3 ? m_Dimensions[ 2 ] : 0;
+
+    // collect the tiles that intersect the region, slice by slice
+    const unsigned int xbegin = parameters.st_RegionIndex[ 0 ] - parameters.st_RegionIndex[ 0 ] % m_TileWidth;
+    const unsigned int ybegin = parameters.st_RegionIndex[ 1 ] - parameters.st_RegionIndex[ 1 ] % m_TileLength;
+    const unsigned int xend   = parameters.st_RegionIndex[ 0 ] + parameters.st_RegionSize[ 0 ];
+    const unsigned int yend   = parameters.st_RegionIndex[ 1 ] + parameters.st_RegionSize[ 1 ];
+    for( unsigned int t = 0; t < nt; ++t )
+    {
+      for( unsigned int z = 0; z < nz; ++z )
       {
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
+        TileType tile;
+        tile.z0    = ( z0 + z ) + ( t0 + t ) * sz;
+        tile.slice = t * nz + z;
+        for( tile.y0 = ybegin; tile.y0 < yend; tile.y0 += m_TileLength )
         {
-          if( TIFFReadTile( m_TIFFImage, tilebuf, 0, 0, z0, 0 ) < 0 )
-          {
-            _TIFFfree( tilebuf );
-            itkExceptionMacro( << "mevisIO:read(): error reading tile (topleft)" );
-            return;
-          }
-          else
+          for( tile.x0 = xbegin; tile.x0 < xend; tile.x0 += m_TileWidth )
           {
-            // do row based copy of tile into volume
-            const unsigned     lenx       = m_Width;
-            const unsigned     leny       = m_Length;
-            const unsigned int tilexbytes = lenx * bytespersample;
-
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width;
-            pv += p * bytespersample;
-
-            unsigned char * pb = tilebuf;
-            for( unsigned int r = 0; r < leny; ++r )
-            {
-              memcpy( pv, pb, tilexbytes );
-              pv += tilexbytes;
-              pb += tilerowbytes;
-            }
+            parameters.st_Tiles.push_back( tile );
           }
         }
-      } // end case one
-
-      // case two, larger x, smaller y
-      if( m_TileWidth >= m_Width && m_TileLength < m_Length )
-      {
-
-        const unsigned     lenx       = m_Width;
-        const unsigned int tilexbytes = lenx * bytespersample;
-
-        const bool my = ( m_Length % m_TileLength == 0 ) ? true : false;
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-        {
-          for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-          {
-            if( TIFFReadTile( m_TIFFImage, tilebuf, 0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (top image)" );
-              return;
-            }
-            else
-            {
-
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += tilexbytes;
-                pb += tilerowbytes;
-              }
-            }
-          }
+      }
+    }
 
-          if( !my )
-          {
-            const unsigned     leny = m_Length % m_TileLength;
-            const unsigned int y0   = m_Length - leny;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, 0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (strip bottom)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += tilexbytes;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
+    // decoding compressed tiles is expensive, so then the tiles are
+    // distributed over the threads; libtiff handles cannot be shared,
+    // so every thread except the first opens the file itself.
+    unsigned int numberOfThreads = 1;
+    if( m_Compression != 1 )
+    {
+      numberOfThreads = std::min< std::size_t >(
+        MultiThreader::GetGlobalDefaultNumberOfThreads(), parameters.st_Tiles.size() );
+      numberOfThreads = std::max( numberOfThreads, 1u );
+    }
 
-      } // end case two
+    parameters.st_ThreadFailed.assign( numberOfThreads, 0 );
+    if( numberOfThreads == 1 )
+    {
+      parameters.st_ThreadFailed[ 0 ]
+        = !this->ReadTiles( m_TIFFImage, parameters, 0, parameters.st_Tiles.size() );
+    }
+    else
+    {
+      MultiThreader::Pointer threader = MultiThreader::New();
+      threader->SetNumberOfThreads( numberOfThreads );
+      threader->SetSingleMethod( ReadTilesThreaderCallback, &parameters );
+      threader->SingleMethodExecute();
+    }
 
-      // case three, smaller x, larger y
-      if( m_TileWidth < m_Width && m_TileLength >= m_Length )
+    for( unsigned int i = 0; i < parameters.st_ThreadFailed.size(); ++i )
+    {
+      if( parameters.st_ThreadFailed[ i ] )
       {
+        itkExceptionMacro( << "mevisIO:read(): error reading tile" );
+      }
+    }
+  }
+  else
+  {
+    // if not tiled then img is stripped
+    itkExceptionMacro( << "mevisIO:read(): non-tiled dcm/tiff reading not (yet) implemented" );
+    return;
+  }
+  return;
+}
 
-        const unsigned leny = m_Length;
-        const bool     mx   = ( m_Width % m_TileWidth == 0 ) ? true : false;
 
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-        {
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            // read tile
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, 0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (top image)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + x0;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-          // fill strip right
-          if( !mx )
-          {
-            const unsigned     lenx       = m_Width % m_TileWidth;
-            const unsigned int x0         = m_Width - lenx;
-            const unsigned int tilexbytes = lenx * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, 0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (strip right)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + x0;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
+// read a range of tiles
+bool
+MevisDicomTiffImageIO::ReadTiles( TIFF * tiff,
+  const ReadTilesParameterType & parameters,
+  const std::size_t begin, const std::size_t end )
+{
+  const unsigned int tilesize       = TIFFTileSize( tiff );
+  const unsigned int tilerowbytes   = TIFFTileRowSize( tiff );
+  const unsigned int bytespersample = m_BitsPerSample / 8;
 
-      } // end case three
+  const unsigned int rx0 = parameters.st_RegionIndex[ 0 ];
+  const unsigned int ry0 = parameters.st_RegionIndex[ 1 ];
+  const unsigned int rx1 = rx0 + parameters.st_RegionSize[ 0 ];
+  const unsigned int ry1 = ry0 + parameters.st_RegionSize[ 1 ];
+  const std::size_t  regionrowbytes = parameters.st_RegionSize[ 0 ] * bytespersample;
 
-    } // end oversized tile
+  unsigned char * tilebuf = static_cast< unsigned char * >( _TIFFmalloc( tilesize ) );
+  if( tilebuf == NULL )
+  {
+    return false;
+  }
 
-    //
-    // normal case, tile is smaller than image
-    //
-    if( !tileoversized )
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    const TileType & tile = parameters.st_Tiles[ i ];
+    if( TIFFReadTile( tiff, tilebuf, tile.x0, tile.y0, tile.z0, 0 ) < 0 )
     {
-      // is volume direction a multiple of tiledirection?
-      const bool mx = ( m_Width % m_TileWidth == 0 ) ? true : false;
-      const bool my = ( m_Length % m_TileLength == 0 ) ? true : false;
+      _TIFFfree( tilebuf );
+      return false;
+    }
 
-      // fill everything inside ie from topleft
-      for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-      {
-        for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-        {
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            // x0,y0,z0 is position of tile in volume, top left corner
-            // pointer to volume (at 0,0,0)
-            unsigned char * pv = vol;
-
-            // set pointer of volume to y0,x0,z0 position
-            const unsigned int p = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            // read tile
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (topleft image)" );
-              return;
-            }
-            else
-            {
-              // do row based copy of tile into volume
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                // move pointers
-                // x remain same, y is one complete vol line
-                // (ie width of image)
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
+    // the part of the tile inside the region; tiles at the right and
+    // bottom border of the image may extend beyond it
+    const unsigned int xs = std::max( tile.x0, rx0 );
+    const unsigned int xe = std::min( tile.x0 + m_TileWidth, rx1 );
+    const unsigned int ys = std::max( tile.y0, ry0 );
+    const unsigned int ye = std::min( tile.y0 + m_TileLength, ry1 );
+    const std::size_t  tilexbytes = ( xe - xs ) * bytespersample;
+
+    // do row based copy of tile into volume
+    const unsigned char * pb = tilebuf
+      + ( ys - tile.y0 ) * tilerowbytes + ( xs - tile.x0 ) * bytespersample;
+    unsigned char * pv = parameters.st_Buffer
+      + ( static_cast< std::size_t >( tile.slice ) * parameters.st_RegionSize[ 1 ] + ( ys - ry0 ) )
+      * regionrowbytes + ( xs - rx0 ) * bytespersample;
+    for( unsigned int r = ys; r < ye; ++r )
+    {
+      memcpy( pv, pb, tilexbytes );
+      pv += regionrowbytes;
+      pb += tilerowbytes;
+    }
+  }
 
-          }
-        }
-        // fill boundaries
-        if( !mx )
-        {
-          // x is fixed
-          const unsigned     lenx       = m_Width % m_TileWidth;
-          const unsigned int x0         = m_Width - lenx;
-          const unsigned int tilexbytes = lenx * bytespersample;
+  _TIFFfree( tilebuf );
+  return true;
+}
 
-          for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-          {
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (ydirection)" );
-              return;
-            }
-            else
-            {
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-        if( !my )
-        {
-          // y is fixed
-          const unsigned     leny = m_Length % m_TileLength;
-          const unsigned int y0   = m_Length - leny;
 
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (x-direction)" );
-              return;
-            }
-            else
-            {
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-        // fill corner bottom
-        if( !mx && !my )
-        {
-          // x0,y0 is fixed
-          const unsigned     lenx       = m_Width % m_TileWidth;
-          const unsigned int x0         = m_Width - lenx;
-          const unsigned int tilexbytes = lenx * bytespersample;
-          const unsigned     leny       = m_Length % m_TileLength;
-          const unsigned int y0         = m_Length - leny;
-
-          unsigned char *    pv = vol;
-          const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-          pv += p * bytespersample;
+// threader callback for reading tiles
+ITK_THREAD_RETURN_TYPE
+MevisDicomTiffImageIO::ReadTilesThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  ReadTilesParameterType * parameters
+    = static_cast< ReadTilesParameterType * >( infoStruct->UserData );
+  const unsigned int threadId        = infoStruct->ThreadID;
+  const unsigned int numberOfThreads = infoStruct->NumberOfThreads;
+  MevisDicomTiffImageIO * self = parameters->st_Self;
 
-          if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-          {
-            _TIFFfree( tilebuf );
-            itkExceptionMacro( << "mevisIO:read(): error reading tile (corner bottom)" );
-            return;
-          }
-          else
-          {
-            unsigned char * pb = tilebuf;
-            for( unsigned int r = 0; r < leny; ++r )
-            {
-              memcpy( pv, pb, tilexbytes );
-              pv += m_Width * bytespersample;
-              pb += tilerowbytes;
-            }
-          }
-        }
-      }
+  // a contiguous range of tiles per thread, for sequential file access
+  const std::size_t numberOfTiles = parameters->st_Tiles.size();
+  const std::size_t begin         = numberOfTiles * threadId / numberOfThreads;
+  const std::size_t end           = numberOfTiles * ( threadId + 1 ) / numberOfThreads;
+  if( begin == end )
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  TIFF * tiff = self->m_TIFFImage;
+  if( threadId > 0 )
+  {
+    tiff = TIFFOpen( self->m_TiffFileName.c_str(), "rc" );
+    if( tiff == NULL )
+    {
+      parameters->st_ThreadFailed[ threadId ] = 1;
+      return ITK_THREAD_RETURN_VALUE;
     }
+  }
 
-    _TIFFfree( tilebuf );
+  if( !self->ReadTiles( tiff, *parameters, begin, end ) )
+  {
+    parameters->st_ThreadFailed[ threadId ] = 1;
   }
-  else
+
+  if( threadId > 0 )
   {
-    // if not tiled then img is stripped
-    itkExceptionMacro( << "mevisIO:read(): non-tiled dcm/tiff reading not (yet) implemented" );
-    return;
+    TIFFClose( tiff );
   }
-  return;
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 
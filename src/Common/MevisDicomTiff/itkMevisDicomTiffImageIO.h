@@ -23,12 +23,14 @@
 #endif
 
 #include "itkImageIOBase.h"
+#include "itkMultiThreader.h"
 #include "itk_tiff.h"
 #include "gdcmTag.h"
 #include "gdcmAttribute.h"
 
 #include <fstream>
 #include <string>
+#include <vector>
 
 namespace itk
 {
@@ -132,9 +134,13 @@ public:
 
   virtual void Write( const void * buffer );
 
+  /** Reading is streamed: only the tiles that intersect the requested
+   * region are read and decoded. Compressed tiles are decoded in parallel,
+   * every thread reading through its own handle of the tiff file.
+   */
   virtual bool CanStreamRead()
   {
-    return false;
+    return true;
   }
 
 
@@ -158,6 +164,35 @@ private:
   bool FindElement( const gdcm::DataSet ds, const gdcm::Tag tag, gdcm::DataElement & de,
     const bool breadthfirstsearch );
 
+  /** A tile of the tiff file, at tile position x0, y0 in tiff slice z0, which
+   * is read into slice "slice" of the IO region.
+   */
+  struct TileType
+  {
+    unsigned int x0;
+    unsigned int y0;
+    unsigned int z0;
+    unsigned int slice;
+  };
+
+  /** The tiles intersecting the IO region, and the IO region as x, y range. */
+  struct ReadTilesParameterType
+  {
+    MevisDicomTiffImageIO * st_Self;
+    std::vector< TileType > st_Tiles;
+    unsigned char *         st_Buffer;
+    unsigned int            st_RegionIndex[ 2 ];
+    unsigned int            st_RegionSize[ 2 ];
+    std::vector< int >      st_ThreadFailed;
+  };
+
+  /** Read and copy the tiles [begin, end) into the buffer; false on failure. */
+  bool ReadTiles( TIFF * tiff, const ReadTilesParameterType & parameters,
+    const std::size_t begin, const std::size_t end );
+
+  /** Threader callback, reading a contiguous range of the tiles. */
+  static ITK_THREAD_RETURN_TYPE ReadTilesThreaderCallback( void * arg );
+
   // the following may include the pathname
   std::string m_DcmFileName;
   std::string m_TiffFileName;
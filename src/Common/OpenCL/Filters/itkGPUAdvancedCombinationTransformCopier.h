@@ -51,6 +51,13 @@ namespace itk
  * that provides the input to the GPUAdvancedCombinationTransformCopier object. This is needed
  * because the GPUAdvancedCombinationTransformCopier is not a pipeline filter.
  *
+ * All matrix-offset transforms, whatever their parameterisation (such as the
+ * AffineLogTransform), are copied through their matrix and offset to a GPU
+ * affine transform. All AdvancedBSplineDeformableTransform's, including the
+ * RecursiveBSplineTransform, are copied to a GPU B-spline transform. Transforms
+ * without a GPU version, and combinations by addition, cannot be copied:
+ * Update() then throws, and GetUnsupportedReason() tells why.
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -135,6 +142,9 @@ public:
   /** Update method. */
   void Update( void );
 
+  /** Get the reason why the last Update() failed, or an empty string. */
+  itkGetStringMacro( UnsupportedReason );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   // Begin concept checking
   itkConceptMacro( OutputTransformPrecisionTypeIsFloatingPointCheck,
@@ -158,6 +168,12 @@ protected:
     const CPUCurrentTransformConstPointer & fromTransform,
     GPUAdvancedTransformPointer & toTransform );
 
+  /** Copy the matrix and offset of a matrix-offset transform, as the
+   * parameters of an affine transform with a zero center. */
+  void CastCopyMatrixOffsetParameters(
+    const CPUCurrentTransformConstPointer & fromTransform,
+    GPUAdvancedTransformPointer & toTransform );
+
   /** Method to copy the parameters. */
   void CastCopyParameters(
     const CPUParametersType & from,
@@ -252,6 +268,7 @@ private:
   GPUComboTransformPointer      m_Output;
   ModifiedTimeType              m_InternalTransformTime;
   bool                          m_ExplicitMode;
+  std::string                   m_UnsupportedReason;
 };
 
 } // end namespace itk
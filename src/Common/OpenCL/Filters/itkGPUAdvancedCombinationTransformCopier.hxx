@@ -41,6 +41,8 @@
 // GPU factory include
 #include "itkGPUImageFactory.h"
 
+#include <sstream>
+
 namespace itk
 {
 //------------------------------------------------------------------------------
@@ -71,8 +73,31 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
   const ModifiedTimeType t = this->m_InputTransform->GetMTime();
   if( t <= this->m_InternalTransformTime ) return; // No need to update
 
-  // Cache the timestamp
-  this->m_InternalTransformTime = t;
+  // Check the structure of the combination. Initial transforms that are not
+  // an AdvancedCombinationTransform are not counted by GetNumberOfTransforms(),
+  // and the GPU kernels compose the transforms, they can not add them.
+  this->m_UnsupportedReason = "";
+  const SizeValueType numberOfTransforms = this->m_InputTransform->GetNumberOfTransforms();
+  if( numberOfTransforms == 0 )
+  {
+    this->m_UnsupportedReason = "the combination has no current transform,"
+      " or an initial transform that is not an AdvancedCombinationTransform";
+  }
+  for( const CPUComboTransformType * combo = this->m_InputTransform.GetPointer(); combo != NULL;
+    combo = dynamic_cast< const CPUComboTransformType * >( combo->GetInitialTransform() ) )
+  {
+    if( combo->GetInitialTransform() != NULL && !combo->GetUseComposition() )
+    {
+      this->m_UnsupportedReason = "the transforms are combined by addition,"
+        " while the GPU only supports composition";
+    }
+  }
+  if( !this->m_UnsupportedReason.empty() )
+  {
+    this->m_Output = NULL;
+    itkExceptionMacro( << "ERROR: GPUAdvancedCombinationTransformCopier was unable to copy transform: "
+                       << this->m_UnsupportedReason );
+  }
 
   // Allocate the output GPU combo transform
   GPUComboTransformPointer comboTransformGPU = GPUComboTransformType::New();
@@ -83,7 +108,6 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
   GPUComboTransformPointer        currentTransformGPU = comboTransformGPU;
 
   // Loop over all sub-transforms
-  const SizeValueType numberOfTransforms = this->m_InputTransform->GetNumberOfTransforms();
   for( SizeValueType i = 0; i < numberOfTransforms; ++i )
   {
     // Get the current CPU transform of type itk::Transform
@@ -96,8 +120,13 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
     const bool copySucceeded = this->CopyToCurrentTransform( currentTransformCPU, currentTransformGPU );
     if( !copySucceeded )
     {
-      itkExceptionMacro( << "ERROR: GPUAdvancedCombinationTransformCopier was unable to copy transform from: "
-                         << this->m_InputTransform );
+      std::ostringstream reason;
+      reason << "transform " << i << " of " << numberOfTransforms
+             << " (" << itkCurrentTransform->GetNameOfClass() << ") has no GPU version";
+      this->m_UnsupportedReason = reason.str();
+      this->m_Output            = NULL;
+      itkExceptionMacro( << "ERROR: GPUAdvancedCombinationTransformCopier was unable to copy transform: "
+                         << this->m_UnsupportedReason );
     }
 
     // skip next step when last transform
@@ -108,6 +137,9 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
     currentTransformGPU->SetInitialTransform( initialNext );
     currentTransformGPU = initialNext;
   }
+
+  // Cache the timestamp, only after a successful copy
+  this->m_InternalTransformTime = t;
 }
 
 
@@ -164,7 +196,9 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
       return similarityCopyResult;
     }
 
-    // Try Advanced Affine
+    // Try Advanced Affine. This also covers the other matrix-offset
+    // transforms, such as the AffineLogTransform, by copying their matrix
+    // and offset instead of their parameters.
     typedef AdvancedMatrixOffsetTransformBase< CPUScalarType, SpaceDimension, SpaceDimension >
       AdvancedAffineTransformType;
     const typename AdvancedAffineTransformType::ConstPointer affine
@@ -187,7 +221,7 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
           GPUAdvancedAffineTransformType;
         affineTransform = GPUAdvancedAffineTransformType::New();
       }
-      this->CastCopyTransformParameters( fromTransform, affineTransform );
+      this->CastCopyMatrixOffsetParameters( fromTransform, affineTransform );
       toTransform->SetCurrentTransform( affineTransform );
       return true;
     }
@@ -220,7 +254,9 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
       return true;
     }
 
-    // For BSpline we have to check all possible spline orders
+    // For BSpline we have to check all possible spline orders. The
+    // RecursiveBSplineTransform derives from the AdvancedBSplineDeformableTransform,
+    // it computes the same B-spline, so it is copied the same way.
     const bool bsplineCopyResult = this->CopyBSplineTransform( fromTransform, toTransform );
     if( bsplineCopyResult )
     {
@@ -256,6 +292,43 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
 }
 
 
+//------------------------------------------------------------------------------
+template< typename TTypeList, typename NDimensions, typename TAdvancedCombinationTransform, typename TOutputTransformPrecisionType >
+void
+GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinationTransform, TOutputTransformPrecisionType >
+::CastCopyMatrixOffsetParameters(
+  const CPUCurrentTransformConstPointer & fromTransform,
+  GPUAdvancedTransformPointer & toTransform )
+{
+  typedef AdvancedMatrixOffsetTransformBase< CPUScalarType, SpaceDimension, SpaceDimension >
+    AdvancedAffineTransformType;
+  const AdvancedAffineTransformType * affine
+    = dynamic_cast< const AdvancedAffineTransformType * >( fromTransform.GetPointer() );
+
+  // Zero center, so that the translation is the offset
+  GPUFixedParametersType fixedParametersTo( SpaceDimension );
+  fixedParametersTo.Fill( 0 );
+
+  // The matrix in row-major order, followed by the offset
+  GPUParametersType parametersTo( SpaceDimension * ( SpaceDimension + 1 ) );
+  unsigned int      par = 0;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      parametersTo[ par++ ] = static_cast< GPUScalarType >( affine->GetMatrix()[ i ][ j ] );
+    }
+  }
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    parametersTo[ par++ ] = static_cast< GPUScalarType >( affine->GetOffset()[ i ] );
+  }
+
+  toTransform->SetFixedParameters( fixedParametersTo );
+  toTransform->SetParameters( parametersTo );
+}
+
+
 //------------------------------------------------------------------------------
 template< typename TTypeList, typename NDimensions, typename TAdvancedCombinationTransform, typename TOutputTransformPrecisionType >
 void
@@ -619,6 +692,7 @@ GPUAdvancedCombinationTransformCopier< TTypeList, NDimensions, TAdvancedCombinat
   os << indent << "Output Transform: " << this->m_Output << std::endl;
   os << indent << "Internal Transform Time: " << this->m_InternalTransformTime << std::endl;
   os << indent << "Explicit Mode: " << this->m_ExplicitMode << std::endl;
+  os << indent << "Unsupported Reason: " << this->m_UnsupportedReason << std::endl;
 }
 
 
@@ -106,6 +106,9 @@ GPUBSplineTransform< TScalarType, NDimensions, VSplineOrder, TParentTransform >
     GPUCoefficientsImagePointer gpuCoefficientImage
       = dynamic_cast< GPUCoefficientsImageType * >( this->m_CoefficientImages[ i ].GetPointer() );
 
+    /** AllocateGPU() keeps the existing device buffer when the size did not
+     * change, so the coefficients of a new iteration are written in place.
+     */
     if( gpuCoefficientImage )
     {
       gpuCoefficientImage->GetGPUDataManager()->SetGPUBufferLock( false );
@@ -117,8 +120,11 @@ GPUBSplineTransform< TScalarType, NDimensions, VSplineOrder, TParentTransform >
 
     this->m_GPUBSplineTransformCoefficientImages[ i ] = gpuCoefficientImage;
 
-    GPUDataManagerPointer gpuCoefficientsBase = GPUDataManager::New();
-    this->m_GPUBSplineTransformCoefficientImagesBase[ i ] = gpuCoefficientsBase;
+    if( this->m_GPUBSplineTransformCoefficientImagesBase[ i ].IsNull() )
+    {
+      GPUDataManagerPointer gpuCoefficientsBase = GPUDataManager::New();
+      this->m_GPUBSplineTransformCoefficientImagesBase[ i ] = gpuCoefficientsBase;
+    }
   }
 } // end CopyCoefficientImagesToGPU()
 
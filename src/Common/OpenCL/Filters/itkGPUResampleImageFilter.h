@@ -120,6 +120,43 @@ public:
   itkSetMacro( RequestedNumberOfSplits, unsigned int );
   itkGetConstMacro( RequestedNumberOfSplits, unsigned int );
 
+  /** Set/Get whether consecutive chunks are pipelined on two command queues.
+   * Each queue has its own deformation field buffer. Chunk k + 1 can then
+   * compute its deformation field while chunk k is still interpolating, on
+   * devices that execute kernels concurrently. This costs one extra
+   * deformation field buffer of the maximum chunk size. Default true. */
+  itkSetMacro( UsePipelinedChunks, bool );
+  itkGetConstMacro( UsePipelinedChunks, bool );
+  itkBooleanMacro( UsePipelinedChunks );
+
+  /** Typedefs for the transform outputs. */
+  typedef Vector< float, OutputImageDimension >                   DeformationVectorType;
+  typedef Image< DeformationVectorType, OutputImageDimension >    DeformationFieldImageType;
+  typedef Image< float, OutputImageDimension >                    DeterminantImageType;
+
+  /** Set/Get whether the deformation field of the transform on the output
+   * grid is computed as well, from the transformed points of the kernels.
+   * It is available from GetDeformationFieldOutput() after the update.
+   * Default false. */
+  itkSetMacro( ComputeDeformationField, bool );
+  itkGetConstMacro( ComputeDeformationField, bool );
+  itkBooleanMacro( ComputeDeformationField );
+
+  /** Set/Get whether the determinant of the spatial Jacobian of the transform
+   * on the output grid is computed as well, with central differences of the
+   * deformation field. It is available from
+   * GetDeterminantOfSpatialJacobianOutput() after the update. Default false. */
+  itkSetMacro( ComputeDeterminantOfSpatialJacobian, bool );
+  itkGetConstMacro( ComputeDeterminantOfSpatialJacobian, bool );
+  itkBooleanMacro( ComputeDeterminantOfSpatialJacobian );
+
+  /** Get the transform outputs of the last update.
+   * These are not pipeline outputs, and are NULL when not computed. */
+  DeformationFieldImageType * GetDeformationFieldOutput( void )
+  { return this->m_DeformationFieldOutput.GetPointer(); }
+  DeterminantImageType * GetDeterminantOfSpatialJacobianOutput( void )
+  { return this->m_DeterminantOfSpatialJacobianOutput.GetPointer(); }
+
 protected:
 
   GPUResampleImageFilter();
@@ -155,6 +192,13 @@ protected:
     const typename GPUInputImage::Pointer & input,
     const typename GPUOutputImage::Pointer & output );
 
+  /** Set the deformation field buffer to the pre, loop and post kernels. */
+  void SetDeformationFieldBufferForAllKernels( const GPUDataManagerPointer & buffer );
+
+  /** Compute the determinant of the spatial Jacobian from the displacement
+   * buffer, and download the requested transform outputs. */
+  void GenerateTransformOutputs( const typename GPUOutputImage::Pointer & output );
+
   /** Set the B-spline transform coefficient images to the GPU. */
   void SetBSplineTransformCoefficientsToGPU(
     const std::size_t transformIndex );
@@ -188,7 +232,16 @@ private:
   GPUDataManagerPointer m_OutputGPUImageBase;
   GPUDataManagerPointer m_FilterParameters;
   GPUDataManagerPointer m_DeformationFieldBuffer;
+  GPUDataManagerPointer m_PipelinedDeformationFieldBuffer;
+  GPUDataManagerPointer m_DisplacementFieldBuffer;
+  GPUDataManagerPointer m_DeterminantOfSpatialJacobianBuffer;
   unsigned int          m_RequestedNumberOfSplits;
+  bool                  m_UsePipelinedChunks;
+  bool                  m_ComputeDeformationField;
+  bool                  m_ComputeDeterminantOfSpatialJacobian;
+
+  typename DeformationFieldImageType::Pointer m_DeformationFieldOutput;
+  typename DeterminantImageType::Pointer      m_DeterminantOfSpatialJacobianOutput;
 
   typedef std::pair< int, bool >                            TransformHandle;
   typedef std::map< GPUTransformTypeEnum, TransformHandle > TransformsHandle;
@@ -226,6 +279,8 @@ private:
   std::size_t      m_FilterPreGPUKernelHandle;
   TransformsHandle m_FilterLoopGPUKernelHandle;
   std::size_t      m_FilterPostGPUKernelHandle;
+  std::size_t      m_FilterDisplacementGPUKernelHandle;
+  std::size_t      m_FilterDeterminantGPUKernelHandle;
 
   // GPU kernel managers
   GPUKernelManagerPointer m_PreKernelManager;
@@ -65,7 +65,10 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   this->m_FilterParameters->SetBufferSize( sizeof( FilterParameters ) );
   this->m_FilterParameters->Allocate();
 
-  this->m_DeformationFieldBuffer = GPUDataManager::New();
+  this->m_DeformationFieldBuffer             = GPUDataManager::New();
+  this->m_PipelinedDeformationFieldBuffer    = GPUDataManager::New();
+  this->m_DisplacementFieldBuffer            = GPUDataManager::New();
+  this->m_DeterminantOfSpatialJacobianBuffer = GPUDataManager::New();
 
   this->m_InterpolatorSourceLoadedIndex = 0;
   this->m_TransformSourceLoadedIndex    = 0;
@@ -80,7 +83,10 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   this->m_InterpolatorBase = NULL;
   this->m_TransformBase    = NULL;
 
-  this->m_RequestedNumberOfSplits = 5;
+  this->m_RequestedNumberOfSplits             = 5;
+  this->m_UsePipelinedChunks                  = true;
+  this->m_ComputeDeformationField             = false;
+  this->m_ComputeDeterminantOfSpatialJacobian = false;
 
   std::ostringstream defines;
   if( TInputImage::ImageDimension > 3 || TInputImage::ImageDimension < 1 )
@@ -137,6 +143,12 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   }
   this->m_FilterPreGPUKernelHandle
     = this->m_PreKernelManager->CreateKernel( program, "ResampleImageFilterPre" );
+
+  // The kernels for the transform outputs are part of the pre program
+  this->m_FilterDisplacementGPUKernelHandle
+    = this->m_PreKernelManager->CreateKernel( program, "ResampleImageFilterDisplacement" );
+  this->m_FilterDeterminantGPUKernelHandle
+    = this->m_PreKernelManager->CreateKernel( program, "ResampleImageFilterDeterminantOfSpatialJacobian" );
 } // end Constructor
 
 
@@ -501,6 +513,35 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   this->m_DeformationFieldBuffer->SetBufferSize( mem_size_DF );
   this->m_DeformationFieldBuffer->Allocate();
 
+  // Consecutive chunks only share the deformation field buffer: the input
+  // is read-only and each chunk writes its own part of the output. With a
+  // second buffer and a second in-order command queue, consecutive chunks
+  // therefore have no dependencies, and the device may overlap them.
+  const bool pipelined = this->m_UsePipelinedChunks && numberOfChunks > 1;
+  if( pipelined )
+  {
+    this->m_PipelinedDeformationFieldBuffer->Initialize();
+    this->m_PipelinedDeformationFieldBuffer->SetBufferFlag( CL_MEM_READ_WRITE );
+    this->m_PipelinedDeformationFieldBuffer->SetBufferSize( mem_size_DF );
+    this->m_PipelinedDeformationFieldBuffer->Allocate();
+  }
+
+  // The displacement of every chunk is collected in a buffer of the full
+  // output size, the determinant of the spatial Jacobian needs neighbours
+  // across the chunk borders.
+  const bool computeTransformOutputs
+    = this->m_ComputeDeformationField || this->m_ComputeDeterminantOfSpatialJacobian;
+  this->m_DeformationFieldOutput             = NULL;
+  this->m_DeterminantOfSpatialJacobianOutput = NULL;
+  if( computeTransformOutputs )
+  {
+    this->m_DisplacementFieldBuffer->Initialize();
+    this->m_DisplacementFieldBuffer->SetBufferFlag( CL_MEM_READ_WRITE );
+    this->m_DisplacementFieldBuffer->SetBufferSize( outputLargestRegion.GetNumberOfPixels()
+      * OutputImageDimension * sizeof( cl_float ) );
+    this->m_DisplacementFieldBuffer->Allocate();
+  }
+
   // Set arguments for pre kernel
   this->SetArgumentsForPreKernelManager( outPtr );
 
@@ -528,159 +569,209 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   std::size_t offset3D[ 3 ], offset2D[ 2 ], offset1D;
 
   // Some temporaries
-  OpenCLEventList eventList;
+  OpenCLEventList finishedEvents;
   unsigned int    piece;
   OpenCLSize      global_work_size;
   OpenCLSize      global_work_offset;
 
-  /** Loop over the chunks. */
-  for( piece = 0; piece < numberOfChunks && !this->GetAbortGenerateData(); ++piece )
+  // The command queues and deformation field buffers of the pipeline stages.
+  // The kernel managers launch on the active queue of the context.
+  OpenCLContext *          context       = this->m_PreKernelManager->GetContext();
+  const OpenCLCommandQueue originalQueue = context->GetCommandQueue();
+  OpenCLCommandQueue       queues[ 2 ];
+  GPUDataManagerPointer    deformationFieldBuffers[ 2 ];
+  OpenCLEvent              lastStageEvents[ 2 ];
+  queues[ 0 ]                  = originalQueue;
+  queues[ 1 ]                  = pipelined ? context->CreateCommandQueue( 0 ) : originalQueue;
+  deformationFieldBuffers[ 0 ] = this->m_DeformationFieldBuffer;
+  deformationFieldBuffers[ 1 ] = pipelined
+    ? this->m_PipelinedDeformationFieldBuffer : this->m_DeformationFieldBuffer;
+
+  try
   {
-    // Get the current chunk region.
-    OutputImageRegionType currentChunkRegion = outputLargestRegion;
-    splitter->GetSplit( piece, numberOfChunks, currentChunkRegion );
-
-    // define and set deformation field size, global_work_size and global_work_offset
-    // The deformation field size is the second argument in the
-    // pre/loop/post kernel, i.e. index is 1.
-    const cl_uint dfSizeKernelIndex = 1;
-    switch( static_cast< unsigned int >( OutputImageDimension ) )
+    /** Loop over the chunks. */
+    for( piece = 0; piece < numberOfChunks && !this->GetAbortGenerateData(); ++piece )
     {
-      case 1:
+      // Get the current chunk region.
+      OutputImageRegionType currentChunkRegion = outputLargestRegion;
+      splitter->GetSplit( piece, numberOfChunks, currentChunkRegion );
+
+      // Select the pipeline stage of this chunk. A chunk only depends on the
+      // previous chunk of the same stage, which reused its buffer.
+      const unsigned int stage = piece % 2;
+      if( pipelined )
       {
-        dfsize1D = currentChunkRegion.GetSize( 0 );
-        global1D = local1D * (unsigned int)ceil( (float)dfsize1D / (float)local1D );
-        offset1D = currentChunkRegion.GetIndex( 0 );
-
-        // set dfsize argument
-        this->m_PreKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
-
-        this->m_LoopKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
-
-        this->m_PostKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
-
-        global_work_size   = OpenCLSize( global1D );
-        global_work_offset = OpenCLSize( offset1D );
+        context->SetCommandQueue( queues[ stage ] );
+        this->SetDeformationFieldBufferForAllKernels( deformationFieldBuffers[ stage ] );
       }
-      break;
-      case 2:
+      OpenCLEventList eventList;
+
+      // define and set deformation field size, global_work_size and global_work_offset
+      // The deformation field size is the second argument in the
+      // pre/loop/post kernel, i.e. index is 1.
+      const cl_uint dfSizeKernelIndex = 1;
+      switch( static_cast< unsigned int >( OutputImageDimension ) )
       {
-        for( unsigned int i = 0; i < 2; i++ )
+        case 1:
         {
-          dfsize2D.s[ i ] = currentChunkRegion.GetSize( i );
-          global2D[ i ]   = local2D[ i ] * (unsigned int)ceil( (float)dfsize2D.s[ i ] / (float)local2D[ i ] );
-          offset2D[ i ]   = currentChunkRegion.GetIndex( i );
-        }
+          dfsize1D = currentChunkRegion.GetSize( 0 );
+          global1D = local1D * (unsigned int)ceil( (float)dfsize1D / (float)local1D );
+          offset1D = currentChunkRegion.GetIndex( 0 );
 
-        // set dfsize argument
-        this->m_PreKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
+          // set dfsize argument
+          this->m_PreKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
 
-        this->m_LoopKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
+          this->m_LoopKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
 
-        this->m_PostKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
+          this->m_PostKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint ), (void *)&dfsize1D );
 
-        global_work_size   = OpenCLSize( global2D[ 0 ], global2D[ 1 ] );
-        global_work_offset = OpenCLSize( offset2D[ 0 ], offset2D[ 1 ] );
-      }
-      break;
-      case 3:
-      {
-        for( unsigned int i = 0; i < 3; i++ )
-        {
-          dfsize3D.s[ i ] = currentChunkRegion.GetSize( i );
-          global3D[ i ]   = local3D[ i ] * (unsigned int)ceil( (float)dfsize3D.s[ i ] / (float)local3D[ i ] );
-          offset3D[ i ]   = currentChunkRegion.GetIndex( i );
+          global_work_size   = OpenCLSize( global1D );
+          global_work_offset = OpenCLSize( offset1D );
         }
-        dfsize3D.s[ 3 ] = 0;
+        break;
+        case 2:
+        {
+          for( unsigned int i = 0; i < 2; i++ )
+          {
+            dfsize2D.s[ i ] = currentChunkRegion.GetSize( i );
+            global2D[ i ]   = local2D[ i ] * (unsigned int)ceil( (float)dfsize2D.s[ i ] / (float)local2D[ i ] );
+            offset2D[ i ]   = currentChunkRegion.GetIndex( i );
+          }
 
-        // set dfsize argument
-        this->m_PreKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+          // set dfsize argument
+          this->m_PreKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
 
-        this->m_LoopKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+          this->m_LoopKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
 
-        this->m_PostKernelManager->SetKernelArgForAllKernels(
-          dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+          this->m_PostKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint2 ), (void *)&dfsize2D );
 
-        global_work_size   = OpenCLSize( global3D[ 0 ], global3D[ 1 ], global3D[ 2 ] );
-        global_work_offset = OpenCLSize( offset3D[ 0 ], offset3D[ 1 ], offset3D[ 2 ] );
-      }
-      break;
-      default:
+          global_work_size   = OpenCLSize( global2D[ 0 ], global2D[ 1 ] );
+          global_work_offset = OpenCLSize( offset2D[ 0 ], offset2D[ 1 ] );
+        }
         break;
-    }
+        case 3:
+        {
+          for( unsigned int i = 0; i < 3; i++ )
+          {
+            dfsize3D.s[ i ] = currentChunkRegion.GetSize( i );
+            global3D[ i ]   = local3D[ i ] * (unsigned int)ceil( (float)dfsize3D.s[ i ] / (float)local3D[ i ] );
+            offset3D[ i ]   = currentChunkRegion.GetIndex( i );
+          }
+          dfsize3D.s[ 3 ] = 0;
+
+          // set dfsize argument
+          this->m_PreKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+
+          this->m_LoopKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+
+          this->m_PostKernelManager->SetKernelArgForAllKernels(
+            dfSizeKernelIndex, sizeof( cl_uint3 ), (void *)&dfsize3D );
+
+          global_work_size   = OpenCLSize( global3D[ 0 ], global3D[ 1 ], global3D[ 2 ] );
+          global_work_offset = OpenCLSize( offset3D[ 0 ], offset3D[ 1 ], offset3D[ 2 ] );
+        }
+        break;
+        default:
+          break;
+      }
 
-    // Set global work size and offset for all kernels
-    this->m_PreKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
-    this->m_PreKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
+      // Set global work size and offset for all kernels
+      this->m_PreKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
+      this->m_PreKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
 
-    this->m_LoopKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
-    this->m_LoopKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
+      this->m_LoopKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
+      this->m_LoopKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
 
-    this->m_PostKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
-    this->m_PostKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
+      this->m_PostKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
+      this->m_PostKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
 
-    // Launch pre kernel
-#if 0 // this should work in theory but doesn't
-    OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle, eventList );
-    eventList.Append( preEvent );
-#else
-    if( eventList.GetSize() == 0 )
-    {
-      OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle );
-      eventList.Append( preEvent );
-    }
-    else
-    {
-      OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle, eventList );
-      eventList.Append( preEvent );
-    }
-#endif
-
-    // Launch all the loop kernels
-    if( this->m_TransformIsCombo )
-    {
-      typedef GPUCompositeTransformBase< InterpolatorPrecisionType,
-        InputImageDimension > CompositeTransformType;
-      const CompositeTransformType * compositeTransform
-        = dynamic_cast< const CompositeTransformType * >( this->m_TransformBase );
+      // Launch pre kernel, after the previous chunk of this stage. Launching
+      // with an empty event list does not work.
+      if( lastStageEvents[ stage ].IsNull() )
+      {
+        OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle );
+        eventList.Append( preEvent );
+      }
+      else
+      {
+        OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel(
+          this->m_FilterPreGPUKernelHandle, OpenCLEventList( lastStageEvents[ stage ] ) );
+        eventList.Append( preEvent );
+      }
 
-      for( int i = compositeTransform->GetNumberOfTransforms() - 1; i >= 0; i-- )
+      // Launch all the loop kernels
+      if( this->m_TransformIsCombo )
       {
-        /** Set the transform parameters to the loop kernel. */
-        this->SetTransformParametersForLoopKernelManager( i );
+        typedef GPUCompositeTransformBase< InterpolatorPrecisionType,
+          InputImageDimension > CompositeTransformType;
+        const CompositeTransformType * compositeTransform
+          = dynamic_cast< const CompositeTransformType * >( this->m_TransformBase );
 
+        for( int i = compositeTransform->GetNumberOfTransforms() - 1; i >= 0; i-- )
+        {
+          /** Set the transform parameters to the loop kernel. */
+          this->SetTransformParametersForLoopKernelManager( i );
+
+          /** Get the kernel id for this transform and launch it. */
+          std::size_t kernelId = 1e10;
+          this->GetKernelIdFromTransformId( i, kernelId );
+          OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
+          eventList.Append( loopEvent );
+
+        } // end loop over the list of transforms
+      }   // end if is combo
+      else
+      {
         /** Get the kernel id for this transform and launch it. */
         std::size_t kernelId = 1e10;
-        this->GetKernelIdFromTransformId( i, kernelId );
+        this->GetKernelIdFromTransformId( 0, kernelId ); // 0 is dummy for non-combo transform
         OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
         eventList.Append( loopEvent );
+      }
 
-      } // end loop over the list of transforms
-    }   // end if is combo
-    else
-    {
-      /** Get the kernel id for this transform and launch it. */
-      std::size_t kernelId = 1e10;
-      this->GetKernelIdFromTransformId( 0, kernelId ); // 0 is dummy for non-combo transform
-      OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
-      eventList.Append( loopEvent );
+      // Store the displacement of this chunk
+      if( computeTransformOutputs )
+      {
+        OpenCLEvent displacementEvent = this->m_PreKernelManager->LaunchKernel(
+          this->m_FilterDisplacementGPUKernelHandle, eventList );
+        eventList.Append( displacementEvent );
+      }
+
+      // Launch the post kernel
+      OpenCLEvent postEvent = this->m_PostKernelManager->LaunchKernel(
+        this->m_FilterPostGPUKernelHandle, eventList );
+      lastStageEvents[ stage ] = postEvent;
+      finishedEvents.Append( postEvent );
     }
 
-    // Launch the post kernel
-    OpenCLEvent postEvent = this->m_PostKernelManager->LaunchKernel(
-      this->m_FilterPostGPUKernelHandle, eventList );
-    eventList.Append( postEvent );
+    finishedEvents.WaitForFinished();
+  }
+  catch( ExceptionObject & )
+  {
+    context->SetCommandQueue( originalQueue );
+    throw;
   }
 
-  eventList.WaitForFinished();
+  // Restore the queue, the output is read back on it.
+  context->SetCommandQueue( originalQueue );
+  if( pipelined )
+  {
+    this->SetDeformationFieldBufferForAllKernels( this->m_DeformationFieldBuffer );
+  }
+
+  // Compute and download the transform outputs
+  if( computeTransformOutputs && !this->GetAbortGenerateData() )
+  {
+    this->GenerateTransformOutputs( outPtr );
+  }
 
   itkDebugMacro( << "GPUResampleImageFilter::GPUGenerateData() finished" );
 } // end GPUGenerateData()
@@ -720,6 +811,26 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   OpenCLKernelToImageBridge< OutputImageType >::SetSize(
     preKernel, argidx++, outputImage->GetLargestPossibleRegion().GetSize() );
 
+  // The displacement kernel takes the arguments of the pre kernel,
+  // followed by the displacement buffer.
+  if( this->m_ComputeDeformationField || this->m_ComputeDeterminantOfSpatialJacobian )
+  {
+    argidx = 0;
+    OpenCLKernel & displacementKernel
+      = this->m_PreKernelManager->GetKernel( this->m_FilterDisplacementGPUKernelHandle );
+    this->m_PreKernelManager->SetKernelArgWithImage( this->m_FilterDisplacementGPUKernelHandle,
+      argidx++, this->m_DeformationFieldBuffer );
+    argidx++; // skip deformation field size for now
+    OpenCLKernelToImageBridge< OutputImageType >::SetDirection(
+      displacementKernel, argidx++, outputImage->GetIndexToPhysicalPoint() );
+    OpenCLKernelToImageBridge< OutputImageType >::SetOrigin(
+      displacementKernel, argidx++, outputImage->GetOrigin() );
+    OpenCLKernelToImageBridge< OutputImageType >::SetSize(
+      displacementKernel, argidx++, outputImage->GetLargestPossibleRegion().GetSize() );
+    this->m_PreKernelManager->SetKernelArgWithImage( this->m_FilterDisplacementGPUKernelHandle,
+      argidx++, this->m_DisplacementFieldBuffer );
+  }
+
   itkDebugMacro( << "GPUResampleImageFilter::SetArgumentsForPreKernelManager() finished" );
 } // end SetArgumentsForPreKernelManager()
 
@@ -817,6 +928,134 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
 } // end SetTransformArgumentsForLoopKernelManager()
 
 
+/**
+ * ***************** SetDeformationFieldBufferForAllKernels ***********************
+ */
+
+template< typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType >
+void
+GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::SetDeformationFieldBufferForAllKernels( const GPUDataManagerPointer & buffer )
+{
+  // The deformation field is the first argument of all kernels.
+  const cl_uint deformationFieldKernelIndex = 0;
+
+  this->m_PreKernelManager->SetKernelArgWithImage(
+    this->m_FilterPreGPUKernelHandle, deformationFieldKernelIndex, buffer );
+  if( this->m_ComputeDeformationField || this->m_ComputeDeterminantOfSpatialJacobian )
+  {
+    this->m_PreKernelManager->SetKernelArgWithImage(
+      this->m_FilterDisplacementGPUKernelHandle, deformationFieldKernelIndex, buffer );
+  }
+
+  typename TransformsHandle::const_iterator it = this->m_FilterLoopGPUKernelHandle.begin();
+  for(; it != this->m_FilterLoopGPUKernelHandle.end(); ++it )
+  {
+    if( !it->second.second ) { continue; }
+    this->m_LoopKernelManager->SetKernelArgWithImage(
+      it->second.first, deformationFieldKernelIndex, buffer );
+  }
+
+  this->m_PostKernelManager->SetKernelArgWithImage(
+    this->m_FilterPostGPUKernelHandle, deformationFieldKernelIndex, buffer );
+} // end SetDeformationFieldBufferForAllKernels()
+
+
+/**
+ * ***************** GenerateTransformOutputs ***********************
+ */
+
+template< typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType >
+void
+GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::GenerateTransformOutputs( const typename GPUOutputImage::Pointer & output )
+{
+  itkDebugMacro( << "GPUResampleImageFilter::GenerateTransformOutputs() called" );
+
+  const OutputImageRegionType region = output->GetLargestPossibleRegion();
+
+  if( this->m_ComputeDeterminantOfSpatialJacobian )
+  {
+    this->m_DeterminantOfSpatialJacobianBuffer->Initialize();
+    this->m_DeterminantOfSpatialJacobianBuffer->SetBufferFlag( CL_MEM_WRITE_ONLY );
+    this->m_DeterminantOfSpatialJacobianBuffer->SetBufferSize(
+      region.GetNumberOfPixels() * sizeof( cl_float ) );
+    this->m_DeterminantOfSpatialJacobianBuffer->Allocate();
+
+    // Set the arguments, the kernel runs once over the full output
+    cl_uint           argidx            = 0;
+    const std::size_t kernelId          = this->m_FilterDeterminantGPUKernelHandle;
+    OpenCLKernel &    determinantKernel = this->m_PreKernelManager->GetKernel( kernelId );
+    this->m_PreKernelManager->SetKernelArgWithImage( kernelId, argidx++,
+      this->m_DisplacementFieldBuffer );
+    OpenCLKernelToImageBridge< OutputImageType >::SetSize(
+      determinantKernel, argidx++, region.GetSize() );
+    OpenCLKernelToImageBridge< OutputImageType >::SetDirection(
+      determinantKernel, argidx++, output->GetIndexToPhysicalPoint() );
+    this->m_PreKernelManager->SetKernelArgWithImage( kernelId, argidx++,
+      this->m_DeterminantOfSpatialJacobianBuffer );
+
+    const OpenCLSize localWorkSize
+      = OpenCLSize::GetLocalWorkSize( this->m_PreKernelManager->GetContext()->GetDefaultDevice() );
+    std::size_t globalSize[ 3 ] = { 1, 1, 1 };
+    for( unsigned int i = 0; i < OutputImageDimension; ++i )
+    {
+      globalSize[ i ] = localWorkSize[ i ]
+        * (unsigned int)ceil( (float)region.GetSize( i ) / (float)localWorkSize[ i ] );
+    }
+
+    OpenCLSize globalWorkSize, globalWorkOffset;
+    switch( static_cast< unsigned int >( OutputImageDimension ) )
+    {
+      case 1:
+        globalWorkSize   = OpenCLSize( globalSize[ 0 ] );
+        globalWorkOffset = OpenCLSize( 0 ); break;
+      case 2:
+        globalWorkSize   = OpenCLSize( globalSize[ 0 ], globalSize[ 1 ] );
+        globalWorkOffset = OpenCLSize( 0, 0 ); break;
+      case 3:
+        globalWorkSize   = OpenCLSize( globalSize[ 0 ], globalSize[ 1 ], globalSize[ 2 ] );
+        globalWorkOffset = OpenCLSize( 0, 0, 0 ); break;
+      default:
+        break;
+    }
+
+    OpenCLEvent determinantEvent = this->m_PreKernelManager->LaunchKernel(
+      kernelId, globalWorkSize, localWorkSize, globalWorkOffset );
+    determinantEvent.WaitForFinished();
+
+    // Download into a plain image on the output grid
+    this->m_DeterminantOfSpatialJacobianOutput = DeterminantImageType::New();
+    this->m_DeterminantOfSpatialJacobianOutput->CopyInformation( output );
+    this->m_DeterminantOfSpatialJacobianOutput->SetRegions( region );
+    this->m_DeterminantOfSpatialJacobianOutput->Allocate();
+
+    this->m_DeterminantOfSpatialJacobianBuffer->SetCPUBufferPointer(
+      this->m_DeterminantOfSpatialJacobianOutput->GetBufferPointer() );
+    this->m_DeterminantOfSpatialJacobianBuffer->SetCPUDirtyFlag( true );
+    this->m_DeterminantOfSpatialJacobianBuffer->UpdateCPUBuffer();
+    this->m_DeterminantOfSpatialJacobianBuffer->SetCPUBufferPointer( NULL );
+  }
+
+  if( this->m_ComputeDeformationField )
+  {
+    // The vectors of the image have the layout of the displacement buffer
+    this->m_DeformationFieldOutput = DeformationFieldImageType::New();
+    this->m_DeformationFieldOutput->CopyInformation( output );
+    this->m_DeformationFieldOutput->SetRegions( region );
+    this->m_DeformationFieldOutput->Allocate();
+
+    this->m_DisplacementFieldBuffer->SetCPUBufferPointer(
+      this->m_DeformationFieldOutput->GetBufferPointer() );
+    this->m_DisplacementFieldBuffer->SetCPUDirtyFlag( true );
+    this->m_DisplacementFieldBuffer->UpdateCPUBuffer();
+    this->m_DisplacementFieldBuffer->SetCPUBufferPointer( NULL );
+  }
+
+  itkDebugMacro( << "GPUResampleImageFilter::GenerateTransformOutputs() finished" );
+} // end GenerateTransformOutputs()
+
+
 /**
  * ***************** SetBSplineTransformCoefficientsToGPU ***********************
  */
@@ -1180,6 +1419,12 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
 {
   CPUSuperclass::PrintSelf( os, indent );
   GPUSuperclass::PrintSelf( os, indent );
+
+  os << indent << "RequestedNumberOfSplits: " << this->m_RequestedNumberOfSplits << std::endl;
+  os << indent << "UsePipelinedChunks: " << this->m_UsePipelinedChunks << std::endl;
+  os << indent << "ComputeDeformationField: " << this->m_ComputeDeformationField << std::endl;
+  os << indent << "ComputeDeterminantOfSpatialJacobian: "
+     << this->m_ComputeDeterminantOfSpatialJacobian << std::endl;
 } // end PrintSelf()
 
 
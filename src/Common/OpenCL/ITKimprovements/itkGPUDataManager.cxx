@@ -34,8 +34,17 @@
 *=========================================================================*/
 #include "itkGPUDataManager.h"
 
+#ifdef OPENCL_PROFILING
+#include "itkOpenCLProfilingReport.h"
+#endif
+
 namespace itk
 {
+// counters over all data managers
+static SizeValueType       GPUDataManagerGlobalNumberOfCopies = 0;
+static SizeValueType       GPUDataManagerGlobalNumberOfImplicitSynchronizations = 0;
+static SimpleFastMutexLock GPUDataManagerGlobalCountersMutex;
+
 // constructor
 GPUDataManager::GPUDataManager()
 {
@@ -46,6 +55,14 @@ GPUDataManager::GPUDataManager()
   m_CPUBufferLock = false;
   m_GPUBufferLock = false;
 
+  m_NumberOfCPUToGPUCopies           = 0;
+  m_NumberOfGPUToCPUCopies           = 0;
+  m_NumberOfImplicitSynchronizations = 0;
+  m_NumberOfAllocations              = 0;
+  m_NumberOfZeroCopySynchronizations = 0;
+
+  m_UseZeroCopy = true;
+
   this->Initialize();
 }
 
@@ -93,15 +110,62 @@ GPUDataManager::Allocate()
 
   if( m_BufferSize > 0 )
   {
+    const bool zeroCopy = this->CanUseZeroCopy();
+
+    /** Reuse the existing buffer, so that repeated uploads of the same
+     * data, e.g. the coefficients at every iteration, are written in place.
+     * A zero-copy buffer can only be reused for the same host memory. */
+    if( m_GPUBuffer != NULL
+      && m_AllocatedBufferSize == m_BufferSize
+      && m_AllocatedMemFlags == m_MemFlags
+      && m_AllocatedZeroCopy == zeroCopy
+      && ( !zeroCopy || m_AllocatedHostPointer == m_CPUBuffer ) )
+    {
+      m_IsGPUBufferDirty = true;
+      return;
+    }
+
+    /** Release the old buffer, which would leak otherwise. */
+    if( m_GPUBuffer != NULL )
+    {
+      errid = clReleaseMemObject( m_GPUBuffer );
+      m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+      m_GPUBuffer = NULL;
+    }
+
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clCreateBuffer, "
               << this <<  "::Allocate Create GPU buffer of size "
               << m_BufferSize << " Bytes" << std::endl;
 #endif
-    m_GPUBuffer = clCreateBuffer( m_Context->GetContextId(),
-      m_MemFlags, m_BufferSize, NULL, &errid );
-    m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
-    m_IsGPUBufferDirty = true;
+    m_AllocatedZeroCopy    = false;
+    m_AllocatedHostPointer = NULL;
+    if( zeroCopy )
+    {
+      /** Wrap the host memory, fall back to a device buffer if the
+       * implementation refuses it. */
+      m_GPUBuffer = clCreateBuffer( m_Context->GetContextId(),
+        m_MemFlags | CL_MEM_USE_HOST_PTR, m_BufferSize, m_CPUBuffer, &errid );
+      if( errid == CL_SUCCESS && m_GPUBuffer != NULL )
+      {
+        m_AllocatedZeroCopy    = true;
+        m_AllocatedHostPointer = m_CPUBuffer;
+      }
+      else
+      {
+        m_GPUBuffer = NULL;
+      }
+    }
+    if( !m_AllocatedZeroCopy )
+    {
+      m_GPUBuffer = clCreateBuffer( m_Context->GetContextId(),
+        m_MemFlags, m_BufferSize, NULL, &errid );
+      m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+    }
+    m_IsGPUBufferDirty    = true;
+    m_AllocatedBufferSize = m_BufferSize;
+    m_AllocatedMemFlags   = m_MemFlags;
+    ++m_NumberOfAllocations;
   }
 }
 
@@ -134,7 +198,14 @@ GPUDataManager::SetGPUDirtyFlag( bool isDirty )
 void
 GPUDataManager::SetGPUBufferDirty()
 {
+  const SizeValueType copies = m_NumberOfGPUToCPUCopies;
   this->UpdateCPUBuffer();
+  if( m_NumberOfGPUToCPUCopies != copies )
+  {
+    ++m_NumberOfImplicitSynchronizations;
+    MutexHolderType holder( GPUDataManagerGlobalCountersMutex );
+    ++GPUDataManagerGlobalNumberOfImplicitSynchronizations;
+  }
   m_IsGPUBufferDirty = true;
 }
 
@@ -143,7 +214,14 @@ GPUDataManager::SetGPUBufferDirty()
 void
 GPUDataManager::SetCPUBufferDirty()
 {
+  const SizeValueType copies = m_NumberOfCPUToGPUCopies;
   this->UpdateGPUBuffer();
+  if( m_NumberOfCPUToGPUCopies != copies )
+  {
+    ++m_NumberOfImplicitSynchronizations;
+    MutexHolderType holder( GPUDataManagerGlobalCountersMutex );
+    ++GPUDataManagerGlobalNumberOfImplicitSynchronizations;
+  }
   m_IsCPUBufferDirty = true;
 }
 
@@ -159,7 +237,13 @@ GPUDataManager::UpdateCPUBuffer()
 
   MutexHolderType holder( m_Mutex );
 
-  if( m_IsCPUBufferDirty && m_GPUBuffer != NULL && m_CPUBuffer != NULL )
+  if( m_IsCPUBufferDirty && m_GPUBuffer != NULL && m_CPUBuffer != NULL
+    && m_AllocatedZeroCopy )
+  {
+    this->SynchronizeZeroCopyBuffer( CL_MAP_READ );
+    m_IsCPUBufferDirty = false;
+  }
+  else if( m_IsCPUBufferDirty && m_GPUBuffer != NULL && m_CPUBuffer != NULL )
   {
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clEnqueueReadBuffer, " << this
@@ -179,9 +263,16 @@ GPUDataManager::UpdateCPUBuffer()
 #endif
 
     m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
-    //m_ContextManager->OpenCLProfile(clEvent, "clEnqueueReadBuffer GPU->CPU");
+#ifdef OPENCL_PROFILING
+    // The OpenCLEvent takes over ownership of clEvent.
+    OpenCLProfilingReport::GetInstance()->AddTransferEvent(
+      "device-to-host", m_BufferSize, OpenCLEvent( clEvent ) );
+#endif
 
     m_IsCPUBufferDirty = false;
+    ++m_NumberOfGPUToCPUCopies;
+    MutexHolderType globalHolder( GPUDataManagerGlobalCountersMutex );
+    ++GPUDataManagerGlobalNumberOfCopies;
   }
 }
 
@@ -197,7 +288,13 @@ GPUDataManager::UpdateGPUBuffer()
 
   MutexHolderType holder( m_Mutex );
 
-  if( m_IsGPUBufferDirty && m_CPUBuffer != NULL && m_GPUBuffer != NULL )
+  if( m_IsGPUBufferDirty && m_CPUBuffer != NULL && m_GPUBuffer != NULL
+    && m_AllocatedZeroCopy )
+  {
+    this->SynchronizeZeroCopyBuffer( CL_MAP_WRITE );
+    m_IsGPUBufferDirty = false;
+  }
+  else if( m_IsGPUBufferDirty && m_CPUBuffer != NULL && m_GPUBuffer != NULL )
   {
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clEnqueueWriteBuffer, " << this << "::UpdateGPUBuffer CPU->GPU data copy "
@@ -216,13 +313,72 @@ GPUDataManager::UpdateGPUBuffer()
       NULL );
 #endif
     m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
-    //m_ContextManager->OpenCLProfile(clEvent, "clEnqueueWriteBuffer CPU->GPU");
+#ifdef OPENCL_PROFILING
+    // The OpenCLEvent takes over ownership of clEvent.
+    OpenCLProfilingReport::GetInstance()->AddTransferEvent(
+      "host-to-device", m_BufferSize, OpenCLEvent( clEvent ) );
+#endif
 
     m_IsGPUBufferDirty = false;
+    ++m_NumberOfCPUToGPUCopies;
+    MutexHolderType globalHolder( GPUDataManagerGlobalCountersMutex );
+    ++GPUDataManagerGlobalNumberOfCopies;
   }
 }
 
 
+//------------------------------------------------------------------------------
+bool
+GPUDataManager::CanUseZeroCopy( void ) const
+{
+  if( !m_UseZeroCopy || m_CPUBuffer == NULL || !m_Context->IsCreated() )
+  {
+    return false;
+  }
+
+  const OpenCLDevice device = m_Context->GetDefaultDevice();
+  if( !device.HasUnifiedMemory() )
+  {
+    return false;
+  }
+
+  /** Implementations copy anyway, or refuse, unaligned host memory. */
+  const std::size_t alignment = device.GetDefaultAlignment();
+  if( alignment > 0 && reinterpret_cast< std::size_t >( m_CPUBuffer ) % alignment != 0 )
+  {
+    return false;
+  }
+
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+void
+GPUDataManager::SynchronizeZeroCopyBuffer( const cl_map_flags flags )
+{
+#if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
+  std::cout << "clEnqueueMapBuffer, " << this
+            << "::SynchronizeZeroCopyBuffer " << m_GPUBuffer << std::endl;
+#endif
+
+  cl_int                 errid;
+  const cl_command_queue queue  = m_Context->GetCommandQueue().GetQueueId();
+  void *                 mapped = clEnqueueMapBuffer( queue, m_GPUBuffer, CL_TRUE, flags,
+    0, m_BufferSize, 0, NULL, NULL, &errid );
+  m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+
+  cl_event unmapEvent = NULL;
+  errid = clEnqueueUnmapMemObject( queue, m_GPUBuffer, mapped, 0, NULL, &unmapEvent );
+  m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+  errid = clWaitForEvents( 1, &unmapEvent );
+  clReleaseEvent( unmapEvent );
+  m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+
+  ++m_NumberOfZeroCopySynchronizations;
+}
+
+
 //------------------------------------------------------------------------------
 cl_mem *
 GPUDataManager::GetGPUBufferPointer()
@@ -288,6 +444,11 @@ GPUDataManager::Graft( const GPUDataManager * data )
     m_GPUBuffer = data->m_GPUBuffer;
     m_CPUBuffer = data->m_CPUBuffer;
 
+    m_AllocatedBufferSize  = data->m_AllocatedBufferSize;
+    m_AllocatedMemFlags    = data->m_AllocatedMemFlags;
+    m_AllocatedZeroCopy    = data->m_AllocatedZeroCopy;
+    m_AllocatedHostPointer = data->m_AllocatedHostPointer;
+
     m_IsCPUBufferDirty = data->m_IsCPUBufferDirty;
     m_IsGPUBufferDirty = data->m_IsGPUBufferDirty;
   }
@@ -314,6 +475,11 @@ GPUDataManager::Initialize()
   m_IsGPUBufferDirty = false;
   m_IsCPUBufferDirty = false;
 
+  m_AllocatedBufferSize  = 0;
+  m_AllocatedMemFlags    = CL_MEM_READ_WRITE;
+  m_AllocatedZeroCopy    = false;
+  m_AllocatedHostPointer = NULL;
+
   m_CPUBufferLock = false;
   m_GPUBufferLock = false;
 }
@@ -331,6 +497,42 @@ GPUDataManager::PrintSelf( std::ostream & os, Indent indent ) const
   os << indent << "m_CPUBuffer: " << m_CPUBuffer << std::endl;
   os << indent << "m_CPUBufferLock: " << m_CPUBufferLock << std::endl;
   os << indent << "m_GPUBufferLock: " << m_GPUBufferLock << std::endl;
+  os << indent << "m_NumberOfCPUToGPUCopies: " << m_NumberOfCPUToGPUCopies << std::endl;
+  os << indent << "m_NumberOfGPUToCPUCopies: " << m_NumberOfGPUToCPUCopies << std::endl;
+  os << indent << "m_NumberOfImplicitSynchronizations: " << m_NumberOfImplicitSynchronizations << std::endl;
+  os << indent << "m_NumberOfAllocations: " << m_NumberOfAllocations << std::endl;
+  os << indent << "m_UseZeroCopy: " << m_UseZeroCopy << std::endl;
+  os << indent << "m_AllocatedZeroCopy: " << m_AllocatedZeroCopy << std::endl;
+  os << indent << "m_NumberOfZeroCopySynchronizations: "
+     << m_NumberOfZeroCopySynchronizations << std::endl;
+}
+
+
+//------------------------------------------------------------------------------
+SizeValueType
+GPUDataManager::GetGlobalNumberOfCopies()
+{
+  MutexHolderType holder( GPUDataManagerGlobalCountersMutex );
+  return GPUDataManagerGlobalNumberOfCopies;
+}
+
+
+//------------------------------------------------------------------------------
+SizeValueType
+GPUDataManager::GetGlobalNumberOfImplicitSynchronizations()
+{
+  MutexHolderType holder( GPUDataManagerGlobalCountersMutex );
+  return GPUDataManagerGlobalNumberOfImplicitSynchronizations;
+}
+
+
+//------------------------------------------------------------------------------
+void
+GPUDataManager::ResetGlobalCounters()
+{
+  MutexHolderType holder( GPUDataManagerGlobalCountersMutex );
+  GPUDataManagerGlobalNumberOfCopies                   = 0;
+  GPUDataManagerGlobalNumberOfImplicitSynchronizations = 0;
 }
 
 
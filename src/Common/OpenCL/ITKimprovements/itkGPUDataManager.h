@@ -151,12 +151,55 @@ public:
   void SetGPUBufferLock( const bool v ) { this->m_GPUBufferLock = v; }
   itkGetConstReferenceMacro( GPUBufferLock, bool );
 
+  /** Number of actual data copies between host and device. */
+  itkGetConstMacro( NumberOfCPUToGPUCopies, SizeValueType );
+  itkGetConstMacro( NumberOfGPUToCPUCopies, SizeValueType );
+
+  /** Number of copies that were triggered implicitly by
+   * SetCPUBufferDirty() or SetGPUBufferDirty(), i.e. by requesting the
+   * buffer pointer on the other side. A device-resident buffer that is
+   * shared across iterations should keep this number close to zero. */
+  itkGetConstMacro( NumberOfImplicitSynchronizations, SizeValueType );
+
+  /** Wrap the CPU buffer in the GPU buffer (CL_MEM_USE_HOST_PTR) instead of
+   * allocating device memory, when the device shares its memory with the
+   * host, e.g. an integrated GPU. The buffers are then synchronized by
+   * mapping and unmapping, without copying. Only used when the CPU buffer is
+   * aligned to the device base address alignment. Default true. */
+  itkSetMacro( UseZeroCopy, bool );
+  itkGetConstMacro( UseZeroCopy, bool );
+  itkBooleanMacro( UseZeroCopy );
+
+  /** Returns true if the current GPU buffer wraps the CPU buffer. */
+  bool IsZeroCopyBuffer() const { return this->m_AllocatedZeroCopy; }
+
+  /** Number of map/unmap synchronizations of a zero-copy buffer. */
+  itkGetConstMacro( NumberOfZeroCopySynchronizations, SizeValueType );
+
+  /** Number of times a GPU buffer was (re)created. Allocate() reuses the
+   * existing buffer when size and flags did not change. */
+  itkGetConstMacro( NumberOfAllocations, SizeValueType );
+
+  /** Counters summed over all GPUDataManager instances. */
+  static SizeValueType GetGlobalNumberOfCopies();
+
+  static SizeValueType GetGlobalNumberOfImplicitSynchronizations();
+
+  static void ResetGlobalCounters();
+
 protected:
 
   GPUDataManager();
   virtual ~GPUDataManager();
   virtual void PrintSelf( std::ostream & os, Indent indent ) const;
 
+  /** Returns true if a zero-copy buffer can be created for the CPU buffer. */
+  bool CanUseZeroCopy( void ) const;
+
+  /** Map and unmap a zero-copy buffer, which makes the host and device
+   * views of the shared memory consistent. */
+  void SynchronizeZeroCopyBuffer( const cl_map_flags flags );
+
 protected:
 
   unsigned int m_BufferSize; // # of bytes
@@ -181,6 +224,22 @@ protected:
   /** Mutex lock to prevent r/w hazard for multithreaded code */
   SimpleFastMutexLock m_Mutex;
 
+  /** size and flags of the currently allocated GPU buffer */
+  unsigned int m_AllocatedBufferSize;
+  cl_mem_flags m_AllocatedMemFlags;
+
+  /** zero-copy buffers, the host pointer is the one the buffer wraps */
+  bool   m_UseZeroCopy;
+  bool   m_AllocatedZeroCopy;
+  void * m_AllocatedHostPointer;
+
+  /** synchronization counters */
+  SizeValueType m_NumberOfCPUToGPUCopies;
+  SizeValueType m_NumberOfGPUToCPUCopies;
+  SizeValueType m_NumberOfImplicitSynchronizations;
+  SizeValueType m_NumberOfAllocations;
+  SizeValueType m_NumberOfZeroCopySynchronizations;
+
 private:
 
   //ITK_DISALLOW_COPY_AND_ASSIGN( GPUDataManager );
@@ -73,7 +73,19 @@ GPUImageDataManager< ImageType >::UpdateCPUBuffer()
     * correctly managed. Therefore, we check the time stamp of
     * CPU and GPU data as well
     */
-    if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != NULL && m_CPUBuffer != NULL )
+    if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != NULL && m_CPUBuffer != NULL
+      && this->m_AllocatedZeroCopy )
+    {
+      /** The image pixels are the buffer, only make them consistent. */
+      this->SynchronizeZeroCopyBuffer( CL_MAP_READ );
+
+      m_Image->Modified();
+      this->SetTimeStamp( m_Image->GetTimeStamp() );
+
+      m_IsCPUBufferDirty = false;
+      m_IsGPUBufferDirty = false;
+    }
+    else if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != NULL && m_CPUBuffer != NULL )
     {
       cl_int errid;
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
@@ -128,7 +140,17 @@ GPUImageDataManager< ImageType >::UpdateGPUBuffer()
     * correctly managed. Therefore, we check the time stamp of
     * CPU and GPU data as well
     */
-    if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != NULL && m_GPUBuffer != NULL )
+    if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != NULL && m_GPUBuffer != NULL
+      && this->m_AllocatedZeroCopy )
+    {
+      this->SynchronizeZeroCopyBuffer( CL_MAP_WRITE );
+
+      this->SetTimeStamp( cpu_time_stamp );
+
+      m_IsCPUBufferDirty = false;
+      m_IsGPUBufferDirty = false;
+    }
+    else if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != NULL && m_GPUBuffer != NULL )
     {
       cl_int errid;
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
@@ -38,6 +38,10 @@
 #include "itkGPUImageToImageFilter.h"
 #include "itkGPUImage.h"
 
+#ifdef OPENCL_PROFILING
+#include "itkOpenCLProfilingReport.h"
+#endif
+
 namespace itk
 {
 template< typename TInputImage, typename TOutputImage, typename TParentImageFilter >
@@ -93,6 +97,15 @@ GPUImageToImageFilter< TInputImage, TOutputImage, TParentImageFilter >
     // separate threads
     this->BeforeThreadedGenerateData();
 
+#ifdef OPENCL_PROFILING
+    // Tag the kernels and transfers of this filter in the profiling report,
+    // nested in the stage of the component that runs it, if any.
+    OpenCLProfilingReport::Pointer report = OpenCLProfilingReport::GetInstance();
+    const std::string previousStage = report->GetStage();
+    report->SetStage( previousStage.empty() ? std::string( this->GetNameOfClass() )
+      : previousStage + "/" + this->GetNameOfClass() );
+#endif
+
     this->GPUGenerateData();
 
     // Update CPU buffer for all outputs
@@ -106,6 +119,10 @@ GPUImageToImageFilter< TInputImage, TOutputImage, TParentImageFilter >
       }
     }
 
+#ifdef OPENCL_PROFILING
+    report->SetStage( previousStage );
+#endif
+
     // Call a method that can be overridden by a subclass to perform
     // some calculations after all the threads have completed
     this->AfterThreadedGenerateData();
@@ -17,10 +17,14 @@
  *=========================================================================*/
 #include "itkOpenCLContext.h"
 #include "itkOpenCLKernels.h"
+#include "itkOpenCLProgramBinaryCache.h"
 #include "itkOpenCLProfilingTimeProbe.h"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iterator>
+#include <vector>
 
 #include "itksys/MD5.h"
 #include "itkOpenCLMacro.h"
@@ -82,7 +86,9 @@ public:
   OpenCLContextPimpl() :
     id( 0 ),
     is_created( false ),
-    last_error( CL_SUCCESS )
+    last_error( CL_SUCCESS ),
+    active_device( 0 ),
+    number_of_device_selections( 0 )
   {}
 
   ~OpenCLContextPimpl()
@@ -90,6 +96,7 @@ public:
     // Release the command queues for the context.
     command_queue         = OpenCLCommandQueue();
     default_command_queue = OpenCLCommandQueue();
+    device_command_queues.clear();
 
     // Release the context.
     if( is_created )
@@ -107,6 +114,11 @@ public:
   OpenCLCommandQueue default_command_queue;
   OpenCLDevice       default_device;
   cl_int             last_error;
+
+  // Multi-device support, see SetActiveDevice()
+  std::vector< OpenCLCommandQueue > device_command_queues;
+  std::size_t                       active_device;
+  std::size_t                       number_of_device_selections;
 };
 
 //------------------------------------------------------------------------------
@@ -581,6 +593,9 @@ OpenCLContext::Release()
   {
     d->command_queue         = OpenCLCommandQueue();
     d->default_command_queue = OpenCLCommandQueue();
+    d->device_command_queues.clear();
+    d->active_device               = 0;
+    d->number_of_device_selections = 0;
     clReleaseContext( d->id );
     d->id             = 0;
     d->default_device = OpenCLDevice();
@@ -667,6 +682,75 @@ OpenCLContext::GetDefaultDevice() const
 }
 
 
+//------------------------------------------------------------------------------
+std::size_t
+OpenCLContext::GetNumberOfDevices() const
+{
+  return this->GetDevices().size();
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLContext::SetActiveDevice( const std::size_t index )
+{
+  ITK_OPENCL_D( OpenCLContext );
+  const std::list< OpenCLDevice > devices = this->GetDevices();
+  if( index >= devices.size() )
+  {
+    return false;
+  }
+
+  std::list< OpenCLDevice >::const_iterator device = devices.begin();
+  std::advance( device, index );
+
+  // Each device gets its own in-order queue, created on first use.
+  if( d->device_command_queues.size() != devices.size() )
+  {
+    d->device_command_queues.resize( devices.size() );
+  }
+  if( d->device_command_queues[ index ].IsNull() )
+  {
+#ifdef OPENCL_PROFILING
+    d->device_command_queues[ index ] = this->CreateCommandQueue( CL_QUEUE_PROFILING_ENABLE, *device );
+#else
+    d->device_command_queues[ index ] = this->CreateCommandQueue( 0, *device );
+#endif
+  }
+
+  d->default_device = *device;
+  d->command_queue  = d->device_command_queues[ index ];
+  d->active_device  = index;
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+std::size_t
+OpenCLContext::GetActiveDeviceIndex() const
+{
+  ITK_OPENCL_D( const OpenCLContext );
+  return d->active_device;
+}
+
+
+//------------------------------------------------------------------------------
+std::size_t
+OpenCLContext::SetNextActiveDevice()
+{
+  ITK_OPENCL_D( OpenCLContext );
+  const std::size_t numberOfDevices = this->GetNumberOfDevices();
+  if( numberOfDevices == 0 )
+  {
+    return 0;
+  }
+
+  const std::size_t index = d->number_of_device_selections++ % numberOfDevices;
+  this->SetActiveDevice( index );
+  return index;
+}
+
+
 //------------------------------------------------------------------------------
 cl_int
 OpenCLContext::GetLastError() const
@@ -1379,11 +1463,52 @@ OpenCLContext::BuildProgramFromSourceCode( const std::list< OpenCLDevice > & dev
   const std::string & postfixSourceCode,
   const std::string & extraBuildOptions )
 {
+  // Try the program binary cache first. CreateProgramFromBinaryCode() only
+  // supports the default device, so the cache is used for that case only.
+  std::string cacheKey;
+  if( OpenCLProgramBinaryCache::IsEnabled() && devices.size() == 1
+    && devices.front().GetDeviceId() == this->GetDefaultDevice().GetDeviceId() )
+  {
+    std::ostringstream source;
+    if( !prefixSourceCode.empty() )
+    {
+      source << prefixSourceCode << std::endl;
+    }
+    source << sourceCode;
+    if( !postfixSourceCode.empty() )
+    {
+      source << std::endl << postfixSourceCode;
+    }
+
+    cacheKey = OpenCLProgramBinaryCache::GetKey( devices.front(), source.str(),
+      OpenCLProgram::GetBuildOptions( extraBuildOptions ) );
+
+    OpenCLProgram cachedProgram = OpenCLProgramBinaryCache::Load( this, cacheKey );
+    if( !cachedProgram.IsNull() )
+    {
+      try
+      {
+        if( cachedProgram.Build( devices, extraBuildOptions ) )
+        {
+          return cachedProgram;
+        }
+      }
+      catch( ExceptionObject & )
+      {
+        // Fall back to building from source
+      }
+    }
+  }
+
   OpenCLProgram program = this->CreateProgramFromSourceCode( sourceCode,
     prefixSourceCode, postfixSourceCode );
 
   if( program.IsNull() || program.Build( devices, extraBuildOptions ) )
   {
+    if( !program.IsNull() && !cacheKey.empty() )
+    {
+      OpenCLProgramBinaryCache::Store( program, cacheKey );
+    }
     return program;
   }
   return OpenCLProgram();
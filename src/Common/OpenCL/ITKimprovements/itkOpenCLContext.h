@@ -197,6 +197,27 @@ public:
    * \sa GetDevices() */
   OpenCLDevice GetDefaultDevice() const;
 
+  /** Returns the number of devices in use by this context. */
+  std::size_t GetNumberOfDevices() const;
+
+  /** Makes device \a index of GetDevices() the active device of a
+   * multi-device context. It becomes the default device, and the active
+   * command queue becomes an in-order queue on that device, so that all
+   * subsequent kernels and transfers of the OpenCL filters run on it.
+   * Buffers and programs belong to the context and remain valid.
+   * Returns false if \a index is out of range.
+   * \sa GetActiveDeviceIndex(), SetNextActiveDevice() */
+  bool SetActiveDevice( const std::size_t index );
+
+  /** Returns the index of the active device, 0 unless SetActiveDevice()
+   * or SetNextActiveDevice() was called. */
+  std::size_t GetActiveDeviceIndex() const;
+
+  /** Activates the devices one after another, starting with the first
+   * one, so that consecutive jobs in one process are spread over all
+   * devices. Returns the index of the activated device. */
+  std::size_t SetNextActiveDevice();
+
   /** Returns the last OpenCL error that occurred while executing an
    * operation on this context or any of the objects created by
    * the context. Returns \c{CL_SUCCESS} if the last operation succeeded.
@@ -0,0 +1,194 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkOpenCLDeviceMemoryArena.h"
+
+namespace itk
+{
+// static instance
+OpenCLDeviceMemoryArena::Pointer OpenCLDeviceMemoryArena::m_Instance = 0;
+
+//------------------------------------------------------------------------------
+OpenCLDeviceMemoryArena::OpenCLDeviceMemoryArena()
+{
+  this->m_NumberOfUploads       = 0;
+  this->m_NumberOfReuses        = 0;
+  this->m_NumberOfInPlaceWrites = 0;
+}
+
+
+//------------------------------------------------------------------------------
+OpenCLDeviceMemoryArena::Pointer
+OpenCLDeviceMemoryArena::GetInstance()
+{
+  if( !OpenCLDeviceMemoryArena::m_Instance )
+  {
+    OpenCLDeviceMemoryArena::m_Instance = OpenCLDeviceMemoryArena::New();
+  }
+  return OpenCLDeviceMemoryArena::m_Instance;
+}
+
+
+//------------------------------------------------------------------------------
+GPUDataManager *
+OpenCLDeviceMemoryArena::GetBuffer( const void * key,
+  const ModifiedTimeType timeStamp, const void * data,
+  const std::size_t size, const cl_mem_flags flags )
+{
+  if( this->IsUpToDate( key, timeStamp, size ) )
+  {
+    ++this->m_NumberOfReuses;
+    return this->m_Buffers[ key ].m_DataManager.GetPointer();
+  }
+
+  if( data == NULL )
+  {
+    itkExceptionMacro( << "No data to upload for a buffer that is not up to date." );
+  }
+
+  BufferEntry & entry = this->m_Buffers[ key ];
+  entry.m_TimeStamp = timeStamp;
+  this->Write( entry, data, size, flags );
+  ++this->m_NumberOfUploads;
+
+  return entry.m_DataManager.GetPointer();
+} // end GetBuffer()
+
+
+//------------------------------------------------------------------------------
+GPUDataManager *
+OpenCLDeviceMemoryArena::UpdateBuffer( const void * key,
+  const void * data, const std::size_t size, const cl_mem_flags flags )
+{
+  BufferEntry & entry = this->m_Buffers[ key ];
+  const bool    inPlace = entry.m_DataManager.IsNotNull() && entry.m_Size == size;
+  entry.m_TimeStamp = 0;
+  this->Write( entry, data, size, flags );
+
+  if( inPlace )
+  {
+    ++this->m_NumberOfInPlaceWrites;
+  }
+  else
+  {
+    ++this->m_NumberOfUploads;
+  }
+
+  return entry.m_DataManager.GetPointer();
+} // end UpdateBuffer()
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLDeviceMemoryArena::Write( BufferEntry & entry, const void * data,
+  const std::size_t size, const cl_mem_flags flags )
+{
+  if( entry.m_DataManager.IsNull() )
+  {
+    entry.m_DataManager = GPUDataManager::New();
+
+    /** The host data is detached after the upload, so it cannot be shared. */
+    entry.m_DataManager->SetUseZeroCopy( false );
+  }
+
+  /** Allocate() keeps the existing buffer when size and flags are unchanged,
+   * so that the copy below overwrites the device memory in place. */
+  GPUDataManager * manager = entry.m_DataManager.GetPointer();
+  manager->SetBufferFlag( flags );
+  manager->SetBufferSize( static_cast< unsigned int >( size ) );
+  manager->Allocate();
+  manager->SetCPUBufferPointer( const_cast< void * >( data ) );
+  manager->SetGPUDirtyFlag( true );
+  manager->UpdateGPUBuffer();
+
+  /** Detach the host data: the device copy is now the only one. */
+  manager->SetCPUBufferPointer( NULL );
+  manager->SetCPUDirtyFlag( false );
+
+  entry.m_Size = size;
+} // end Write()
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLDeviceMemoryArena::HasBuffer( const void * key ) const
+{
+  return this->m_Buffers.find( key ) != this->m_Buffers.end();
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLDeviceMemoryArena::IsUpToDate( const void * key,
+  const ModifiedTimeType timeStamp, const std::size_t size ) const
+{
+  BufferMapType::const_iterator it = this->m_Buffers.find( key );
+  return it != this->m_Buffers.end()
+         && it->second.m_TimeStamp == timeStamp
+         && it->second.m_Size == size;
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLDeviceMemoryArena::Release( const void * key )
+{
+  this->m_Buffers.erase( key );
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLDeviceMemoryArena::Clear()
+{
+  this->m_Buffers.clear();
+}
+
+
+//------------------------------------------------------------------------------
+std::size_t
+OpenCLDeviceMemoryArena::GetResidentBytes() const
+{
+  std::size_t bytes = 0;
+  for( BufferMapType::const_iterator it = this->m_Buffers.begin();
+    it != this->m_Buffers.end(); ++it )
+  {
+    bytes += it->second.m_Size;
+  }
+  return bytes;
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLDeviceMemoryArena::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfBuffers: " << this->GetNumberOfBuffers() << std::endl;
+  os << indent << "ResidentBytes: " << this->GetResidentBytes() << std::endl;
+  os << indent << "NumberOfUploads: " << this->m_NumberOfUploads << std::endl;
+  os << indent << "NumberOfReuses: " << this->m_NumberOfReuses << std::endl;
+  os << indent << "NumberOfInPlaceWrites: " << this->m_NumberOfInPlaceWrites << std::endl;
+  os << indent << "NumberOfImplicitSynchronizations: "
+     << GPUDataManager::GetGlobalNumberOfImplicitSynchronizations() << std::endl;
+  os << indent << "NumberOfHostDeviceCopies: "
+     << GPUDataManager::GetGlobalNumberOfCopies() << std::endl;
+}
+
+
+} // end namespace itk
@@ -0,0 +1,156 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkOpenCLDeviceMemoryArena_h
+#define __itkOpenCLDeviceMemoryArena_h
+
+#include "itkGPUDataManager.h"
+#include "itkImageRegionConstIterator.h"
+
+#include <map>
+#include <vector>
+
+namespace itk
+{
+/** \class OpenCLDeviceMemoryArena
+ * \brief Registration-scoped storage of device-resident buffers.
+ *
+ * GPU components that are (re)initialized at every resolution or even every
+ * iteration would otherwise create a new GPUDataManager and upload the same
+ * image data each time. The arena keeps one buffer per key, typically the
+ * address of the CPU data owner, and only uploads again if the modified time
+ * of that owner changed. Buffers that change every iteration, such as
+ * transform coefficients, are overwritten in place with UpdateBuffer().
+ *
+ * Buffers handed out by the arena are device-resident: their CPU pointer is
+ * detached after the upload, so that the ITK pipeline never triggers an
+ * implicit GPU->CPU copy. The number of uploads, reuses and in-place writes
+ * is counted and reported by Print().
+ *
+ * \ingroup OpenCL
+ */
+class ITKOpenCL_EXPORT OpenCLDeviceMemoryArena : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef OpenCLDeviceMemoryArena    Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLDeviceMemoryArena, Object );
+
+  /** Get the arena that is shared by all GPU components. */
+  static Pointer GetInstance();
+
+  /** Get the device buffer of \a key. The \a data is uploaded only when the
+   * buffer does not exist yet, or when \a size or \a timeStamp differ from
+   * the previous request. */
+  GPUDataManager * GetBuffer( const void * key, const ModifiedTimeType timeStamp,
+    const void * data, const std::size_t size,
+    const cl_mem_flags flags = CL_MEM_READ_ONLY );
+
+  /** Get the device buffer holding the buffered region of \a image as float.
+   * The conversion and upload only take place when the image was modified
+   * since the previous request, so within a resolution this is free. */
+  template< class TImage >
+  GPUDataManager * GetImageBuffer( const TImage * image )
+  {
+    const ModifiedTimeType timeStamp = image->GetMTime();
+    const std::size_t      size      = sizeof( float )
+      * image->GetBufferedRegion().GetNumberOfPixels();
+    if( this->IsUpToDate( image, timeStamp, size ) )
+    {
+      return this->GetBuffer( image, timeStamp, NULL, size );
+    }
+
+    std::vector< float > buffer( image->GetBufferedRegion().GetNumberOfPixels() );
+    ImageRegionConstIterator< TImage > it( image, image->GetBufferedRegion() );
+    for( std::size_t i = 0; !it.IsAtEnd(); ++it, ++i )
+    {
+      buffer[ i ] = static_cast< float >( it.Get() );
+    }
+    return this->GetBuffer( image, timeStamp, &buffer[ 0 ], size );
+  }
+
+  /** Overwrite the existing device buffer of \a key in place. The buffer
+   * is (re)allocated only when its size changes. */
+  GPUDataManager * UpdateBuffer( const void * key,
+    const void * data, const std::size_t size,
+    const cl_mem_flags flags = CL_MEM_READ_ONLY );
+
+  /** Check whether a buffer for \a key exists. */
+  bool HasBuffer( const void * key ) const;
+
+  /** Check whether the buffer for \a key exists with the given time stamp
+   * and size, i.e. whether GetBuffer() would reuse it. */
+  bool IsUpToDate( const void * key, const ModifiedTimeType timeStamp,
+    const std::size_t size ) const;
+
+  /** Release the buffer of \a key, e.g. at the start of a new resolution. */
+  void Release( const void * key );
+
+  /** Release all buffers, e.g. at the end of a registration. */
+  void Clear();
+
+  /** Statistics. */
+  itkGetConstMacro( NumberOfUploads, SizeValueType );
+  itkGetConstMacro( NumberOfReuses, SizeValueType );
+  itkGetConstMacro( NumberOfInPlaceWrites, SizeValueType );
+  std::size_t GetNumberOfBuffers() const { return this->m_Buffers.size(); }
+  std::size_t GetResidentBytes() const;
+
+protected:
+
+  OpenCLDeviceMemoryArena();
+  virtual ~OpenCLDeviceMemoryArena() {}
+  virtual void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  OpenCLDeviceMemoryArena( const Self & ); // purposely not implemented
+  void operator=( const Self & );          // purposely not implemented
+
+  struct BufferEntry
+  {
+    GPUDataManager::Pointer m_DataManager;
+    ModifiedTimeType        m_TimeStamp;
+    std::size_t             m_Size;
+  };
+
+  typedef std::map< const void *, BufferEntry > BufferMapType;
+
+  /** Copy \a data into the buffer of \a entry and detach the CPU pointer. */
+  void Write( BufferEntry & entry, const void * data,
+    const std::size_t size, const cl_mem_flags flags );
+
+  BufferMapType m_Buffers;
+  SizeValueType m_NumberOfUploads;
+  SizeValueType m_NumberOfReuses;
+  SizeValueType m_NumberOfInPlaceWrites;
+
+  static Pointer m_Instance;
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkOpenCLDeviceMemoryArena_h
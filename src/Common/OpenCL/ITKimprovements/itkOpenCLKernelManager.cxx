@@ -36,6 +36,10 @@
 #include "itkOpenCLContext.h"
 #include "itkOpenCLMacro.h"
 
+#ifdef OPENCL_PROFILING
+#include "itkOpenCLProfilingReport.h"
+#endif
+
 namespace itk
 {
 OpenCLKernelManager::OpenCLKernelManager()
@@ -286,7 +290,7 @@ OpenCLKernelManager::LaunchKernel( const std::size_t kernelId )
     return OpenCLEvent();
   }
 
-  return kernel.LaunchKernel();
+  return this->RecordLaunch( kernel, kernel.LaunchKernel() );
 }
 
 
@@ -319,7 +323,7 @@ OpenCLKernelManager::LaunchKernel( const std::size_t kernelId,
   kernel.SetLocalWorkSize( local_work_size );
   kernel.SetGlobalWorkOffset( global_work_offset );
 
-  return kernel.LaunchKernel();
+  return this->RecordLaunch( kernel, kernel.LaunchKernel() );
 }
 
 
@@ -346,7 +350,7 @@ OpenCLKernelManager::LaunchKernel( const std::size_t kernelId,
     return OpenCLEvent();
   }
 
-  return kernel.LaunchKernel( event_list );
+  return this->RecordLaunch( kernel, kernel.LaunchKernel( event_list ) );
 }
 
 
@@ -380,7 +384,18 @@ OpenCLKernelManager::LaunchKernel( const std::size_t kernelId,
   kernel.SetLocalWorkSize( local_work_size );
   kernel.SetGlobalWorkOffset( global_work_offset );
 
-  return kernel.LaunchKernel( event_list );
+  return this->RecordLaunch( kernel, kernel.LaunchKernel( event_list ) );
+}
+
+
+//------------------------------------------------------------------------------
+OpenCLEvent
+OpenCLKernelManager::RecordLaunch( const OpenCLKernel & kernel, const OpenCLEvent & event )
+{
+#ifdef OPENCL_PROFILING
+  OpenCLProfilingReport::GetInstance()->AddKernelEvent( kernel.GetName(), event );
+#endif
+  return event;
 }
 
 
@@ -142,6 +142,10 @@ protected:
 
   void ResetArguments( const std::size_t kernelIdx );
 
+  /** Record the launch of \a kernel in the OpenCLProfilingReport when
+   * compiled with OPENCL_PROFILING, and return \a event. */
+  OpenCLEvent RecordLaunch( const OpenCLKernel & kernel, const OpenCLEvent & event );
+
 private:
 
   OpenCLKernelManager( const Self & );   // purposely not implemented
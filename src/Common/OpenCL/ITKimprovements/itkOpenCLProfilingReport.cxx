@@ -0,0 +1,359 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkOpenCLProfilingReport.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace itk
+{
+// static instance
+OpenCLProfilingReport::Pointer OpenCLProfilingReport::m_Instance = 0;
+
+namespace
+{
+// Escape the characters that may not appear unescaped in a JSON string.
+std::string
+OpenCLProfilingReportEscape( const std::string & s )
+{
+  std::string escaped;
+  for( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+  {
+    if( *it == '"' || *it == '\\' )
+    {
+      escaped += '\\';
+    }
+    escaped += *it;
+  }
+  return escaped;
+}
+
+
+// Nanoseconds to milliseconds.
+double
+OpenCLProfilingReportToMilliseconds( const cl_ulong ns )
+{
+  return static_cast< double >( ns ) * 1.0e-6;
+}
+
+
+// Bytes per nanosecond equals gigabytes per second.
+double
+OpenCLProfilingReportBandwidth( const std::size_t bytes, const cl_ulong ns )
+{
+  return ns > 0 ? static_cast< double >( bytes ) / static_cast< double >( ns ) : 0.0;
+}
+
+
+} // end namespace
+
+//------------------------------------------------------------------------------
+OpenCLProfilingReport::OpenCLProfilingReport()
+{}
+
+//------------------------------------------------------------------------------
+OpenCLProfilingReport::Pointer
+OpenCLProfilingReport::GetInstance()
+{
+  if( !OpenCLProfilingReport::m_Instance )
+  {
+    OpenCLProfilingReport::m_Instance = OpenCLProfilingReport::New();
+  }
+  return OpenCLProfilingReport::m_Instance;
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLProfilingReport::IsEnabled()
+{
+#ifdef OPENCL_PROFILING
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::AddKernelEvent( const std::string & kernelName,
+  const OpenCLEvent & event )
+{
+  if( event.IsNull() )
+  {
+    return;
+  }
+
+  Record record;
+  record.m_Stage      = this->m_Stage;
+  record.m_Name       = kernelName;
+  record.m_IsTransfer = false;
+  record.m_Bytes      = 0;
+  record.m_Event      = event;
+  this->m_Records.push_back( record );
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::AddTransferEvent( const std::string & name,
+  const std::size_t bytes, const OpenCLEvent & event )
+{
+  if( event.IsNull() )
+  {
+    return;
+  }
+
+  Record record;
+  record.m_Stage      = this->m_Stage;
+  record.m_Name       = name;
+  record.m_IsTransfer = true;
+  record.m_Bytes      = bytes;
+  record.m_Event      = event;
+  this->m_Records.push_back( record );
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::Clear()
+{
+  this->m_Records.clear();
+  this->m_Stage.clear();
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::ComputeTimings( std::vector< Timing > & timings ) const
+{
+  timings.resize( this->m_Records.size() );
+
+  cl_ulong origin = 0;
+  for( std::size_t i = 0; i < this->m_Records.size(); ++i )
+  {
+    OpenCLEvent event = this->m_Records[ i ].m_Event;
+    event.WaitForFinished();
+
+    timings[ i ].m_Queued = event.GetQueueTime();
+    timings[ i ].m_Submit = event.GetSubmitTime();
+    timings[ i ].m_Start  = event.GetRunTime();
+    timings[ i ].m_End    = event.GetFinishTime();
+
+    if( timings[ i ].m_Queued > 0 && ( origin == 0 || timings[ i ].m_Queued < origin ) )
+    {
+      origin = timings[ i ].m_Queued;
+    }
+  }
+
+  // Make the times relative to the first record, events without profiling
+  // information keep zero times.
+  for( std::size_t i = 0; i < timings.size(); ++i )
+  {
+    if( timings[ i ].m_Queued >= origin && timings[ i ].m_End >= timings[ i ].m_Start
+      && timings[ i ].m_Queued > 0 )
+    {
+      timings[ i ].m_Queued -= origin;
+      timings[ i ].m_Submit -= origin;
+      timings[ i ].m_Start  -= origin;
+      timings[ i ].m_End    -= origin;
+    }
+    else
+    {
+      timings[ i ].m_Queued = timings[ i ].m_Submit = 0;
+      timings[ i ].m_Start  = timings[ i ].m_End = 0;
+    }
+  }
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::ComputeSummaries( const std::vector< Timing > & timings,
+  std::vector< StageSummary > & summaries ) const
+{
+  summaries.clear();
+  for( std::size_t i = 0; i < this->m_Records.size(); ++i )
+  {
+    const Record & record = this->m_Records[ i ];
+
+    std::size_t s = 0;
+    while( s < summaries.size() && summaries[ s ].m_Stage != record.m_Stage )
+    {
+      ++s;
+    }
+    if( s == summaries.size() )
+    {
+      StageSummary summary;
+      summary.m_Stage             = record.m_Stage;
+      summary.m_NumberOfKernels   = 0;
+      summary.m_NumberOfTransfers = 0;
+      summary.m_KernelTime        = 0.0;
+      summary.m_TransferTime      = 0.0;
+      summary.m_Bytes             = 0;
+      summaries.push_back( summary );
+    }
+
+    const double duration = OpenCLProfilingReportToMilliseconds(
+      timings[ i ].m_End - timings[ i ].m_Start );
+    if( record.m_IsTransfer )
+    {
+      ++summaries[ s ].m_NumberOfTransfers;
+      summaries[ s ].m_TransferTime += duration;
+      summaries[ s ].m_Bytes        += record.m_Bytes;
+    }
+    else
+    {
+      ++summaries[ s ].m_NumberOfKernels;
+      summaries[ s ].m_KernelTime += duration;
+    }
+  }
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::WriteReport( std::ostream & os ) const
+{
+  std::vector< Timing > timings;
+  this->ComputeTimings( timings );
+  std::vector< StageSummary > summaries;
+  this->ComputeSummaries( timings, summaries );
+
+  os << "OpenCL profiling report (times in ms, bandwidth in GB/s):" << std::endl;
+  if( !IsEnabled() )
+  {
+    os << "  OpenCL profiling is not enabled, compile with OPENCL_PROFILING." << std::endl;
+    return;
+  }
+
+  const std::ios_base::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision( 3 );
+
+  for( std::size_t s = 0; s < summaries.size(); ++s )
+  {
+    const StageSummary & summary = summaries[ s ];
+    os << "  " << ( summary.m_Stage.empty() ? "unknown" : summary.m_Stage ) << ": "
+       << summary.m_NumberOfKernels << " kernels " << summary.m_KernelTime
+       << ", " << summary.m_NumberOfTransfers << " transfers " << summary.m_TransferTime
+       << " (" << summary.m_Bytes << " bytes";
+    if( summary.m_TransferTime > 0.0 )
+    {
+      os << ", " << static_cast< double >( summary.m_Bytes ) * 1.0e-6 / summary.m_TransferTime;
+    }
+    os << ")" << std::endl;
+  }
+
+  for( std::size_t i = 0; i < this->m_Records.size(); ++i )
+  {
+    const Record & record = this->m_Records[ i ];
+    const Timing & timing = timings[ i ];
+    os << "    " << record.m_Stage << " " << record.m_Name
+       << " queued " << OpenCLProfilingReportToMilliseconds( timing.m_Queued )
+       << " submit " << OpenCLProfilingReportToMilliseconds( timing.m_Submit )
+       << " start " << OpenCLProfilingReportToMilliseconds( timing.m_Start )
+       << " end " << OpenCLProfilingReportToMilliseconds( timing.m_End );
+    if( record.m_IsTransfer )
+    {
+      os << " bytes " << record.m_Bytes << " bandwidth "
+         << OpenCLProfilingReportBandwidth( record.m_Bytes, timing.m_End - timing.m_Start );
+    }
+    os << std::endl;
+  }
+
+  os.flags( flags );
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::WriteJSON( std::ostream & os ) const
+{
+  std::vector< Timing > timings;
+  this->ComputeTimings( timings );
+  std::vector< StageSummary > summaries;
+  this->ComputeSummaries( timings, summaries );
+
+  os << "{\n  \"profilingEnabled\": " << ( IsEnabled() ? "true" : "false" ) << ",\n";
+
+  os << "  \"stages\": [";
+  for( std::size_t s = 0; s < summaries.size(); ++s )
+  {
+    const StageSummary & summary = summaries[ s ];
+    const double         bandwidth = summary.m_TransferTime > 0.0
+      ? static_cast< double >( summary.m_Bytes ) * 1.0e-6 / summary.m_TransferTime : 0.0;
+    os << ( s == 0 ? "\n" : ",\n" )
+       << "    { \"stage\": \"" << OpenCLProfilingReportEscape( summary.m_Stage ) << "\""
+       << ", \"kernels\": " << summary.m_NumberOfKernels
+       << ", \"kernelTimeMs\": " << summary.m_KernelTime
+       << ", \"transfers\": " << summary.m_NumberOfTransfers
+       << ", \"transferTimeMs\": " << summary.m_TransferTime
+       << ", \"bytes\": " << summary.m_Bytes
+       << ", \"bandwidthGBs\": " << bandwidth << " }";
+  }
+  os << "\n  ],\n";
+
+  os << "  \"records\": [";
+  for( std::size_t i = 0; i < this->m_Records.size(); ++i )
+  {
+    const Record & record = this->m_Records[ i ];
+    const Timing & timing = timings[ i ];
+    os << ( i == 0 ? "\n" : ",\n" )
+       << "    { \"stage\": \"" << OpenCLProfilingReportEscape( record.m_Stage ) << "\""
+       << ", \"name\": \"" << OpenCLProfilingReportEscape( record.m_Name ) << "\""
+       << ", \"type\": \"" << ( record.m_IsTransfer ? "transfer" : "kernel" ) << "\""
+       << ", \"queuedNs\": " << timing.m_Queued
+       << ", \"submitNs\": " << timing.m_Submit
+       << ", \"startNs\": " << timing.m_Start
+       << ", \"endNs\": " << timing.m_End
+       << ", \"bytes\": " << record.m_Bytes
+       << ", \"bandwidthGBs\": "
+       << OpenCLProfilingReportBandwidth( record.m_Bytes, timing.m_End - timing.m_Start )
+       << " }";
+  }
+  os << "\n  ]\n}\n";
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLProfilingReport::WriteJSONFile( const std::string & filename ) const
+{
+  std::ofstream file( filename.c_str(), std::ios::out );
+  if( !file.is_open() )
+  {
+    return false;
+  }
+  this->WriteJSON( file );
+  return !file.fail();
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLProfilingReport::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+  os << indent << "Enabled: " << ( IsEnabled() ? "On" : "Off" ) << std::endl;
+  os << indent << "Stage: " << this->m_Stage << std::endl;
+  os << indent << "NumberOfRecords: " << this->m_Records.size() << std::endl;
+}
+
+
+} // end namespace itk
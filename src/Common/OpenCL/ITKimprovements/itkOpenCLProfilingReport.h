@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkOpenCLProfilingReport_h
+#define __itkOpenCLProfilingReport_h
+
+#include "itkOpenCLExport.h"
+#include "itkOpenCLEvent.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+/** \class OpenCLProfilingReport
+ * \brief Collects the profiling information of OpenCL kernels and transfers.
+ *
+ * When compiled with OPENCL_PROFILING the command queues are created with
+ * CL_QUEUE_PROFILING_ENABLE. The OpenCLKernelManager then records every
+ * kernel launch and the GPUDataManager every host/device transfer here,
+ * tagged with the current stage, which the GPUImageToImageFilter sets to the
+ * name of the filter that is executing. The events are only queried when a
+ * report is written, so recording does not synchronize the queues.
+ *
+ * The report lists the queued, submit, start and end times of every record
+ * relative to the first record, the transferred bytes and the achieved
+ * bandwidth. It can be written as a table or as a JSON document.
+ *
+ * \ingroup OpenCL
+ */
+class ITKOpenCL_EXPORT OpenCLProfilingReport : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef OpenCLProfilingReport      Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLProfilingReport, Object );
+
+  /** Get the report that is shared by all GPU components. */
+  static Pointer GetInstance();
+
+  /** Returns true if elastix was compiled with OPENCL_PROFILING, i.e. if the
+   * events carry profiling information. */
+  static bool IsEnabled();
+
+  /** Set/Get the stage that new records are tagged with. */
+  void SetStage( const std::string & stage ) { this->m_Stage = stage; }
+  const std::string & GetStage() const { return this->m_Stage; }
+
+  /** Record a kernel launch. */
+  void AddKernelEvent( const std::string & kernelName, const OpenCLEvent & event );
+
+  /** Record a transfer of \a bytes, \a name is e.g. "host-to-device". */
+  void AddTransferEvent( const std::string & name, const std::size_t bytes,
+    const OpenCLEvent & event );
+
+  /** Get the number of records. */
+  std::size_t GetNumberOfRecords() const { return this->m_Records.size(); }
+
+  /** Remove all records, e.g. at the start of a registration. */
+  void Clear();
+
+  /** Write the records and a per-stage summary as a table. */
+  void WriteReport( std::ostream & os ) const;
+
+  /** Write the records and a per-stage summary as JSON to \a os. */
+  void WriteJSON( std::ostream & os ) const;
+
+  /** Write the JSON document to \a filename. Returns false on failure. */
+  bool WriteJSONFile( const std::string & filename ) const;
+
+protected:
+
+  OpenCLProfilingReport();
+  virtual ~OpenCLProfilingReport() {}
+  virtual void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  OpenCLProfilingReport( const Self & ); // purposely not implemented
+  void operator=( const Self & );        // purposely not implemented
+
+  struct Record
+  {
+    std::string m_Stage;
+    std::string m_Name;
+    bool        m_IsTransfer;
+    std::size_t m_Bytes;
+    OpenCLEvent m_Event;
+  };
+
+  struct Timing
+  {
+    cl_ulong m_Queued;
+    cl_ulong m_Submit;
+    cl_ulong m_Start;
+    cl_ulong m_End;
+  };
+
+  struct StageSummary
+  {
+    std::string m_Stage;
+    std::size_t m_NumberOfKernels;
+    std::size_t m_NumberOfTransfers;
+    double      m_KernelTime;   // milliseconds
+    double      m_TransferTime; // milliseconds
+    std::size_t m_Bytes;
+  };
+
+  /** Wait for the events and get their times relative to the first one. */
+  void ComputeTimings( std::vector< Timing > & timings ) const;
+
+  /** Sum up the records per stage, in order of first appearance. */
+  void ComputeSummaries( const std::vector< Timing > & timings,
+    std::vector< StageSummary > & summaries ) const;
+
+  std::vector< Record > m_Records;
+  std::string           m_Stage;
+
+  static Pointer m_Instance;
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkOpenCLProfilingReport_h
@@ -16,11 +16,13 @@
  *
  *=========================================================================*/
 #include "itkOpenCLProfilingTimeProbe.h"
+#include "itkTraceEventRecorder.h"
 
 namespace itk
 {
 OpenCLProfilingTimeProbe::OpenCLProfilingTimeProbe( const std::string & message ) :
-  m_ProfilingMessage( message )
+  m_ProfilingMessage( message ),
+  m_TraceStart( TraceEventRecorder::GetTimeStamp() )
 {
   this->m_Timer.Start();
 }
@@ -30,6 +32,11 @@ OpenCLProfilingTimeProbe::OpenCLProfilingTimeProbe( const std::string & message
 OpenCLProfilingTimeProbe::~OpenCLProfilingTimeProbe()
 {
   this->m_Timer.Stop();
+  if( TraceEventRecorder::IsEnabled() )
+  {
+    TraceEventRecorder::AddCompleteEvent( this->m_ProfilingMessage, "opencl",
+      this->m_TraceStart, TraceEventRecorder::GetTimeStamp() - this->m_TraceStart );
+  }
   std::cout << this->m_ProfilingMessage << " took "
             << this->m_Timer.GetMean() << " seconds." << std::endl;
 }
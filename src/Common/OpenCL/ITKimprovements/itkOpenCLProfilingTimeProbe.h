@@ -28,6 +28,9 @@ namespace itk
 /** \class OpenCLProfilingTimeProbe
  * \brief Computes the time passed between two points in code.
  *
+ * The time is printed, and recorded as an event of the
+ * TraceEventRecorder when that is enabled.
+ *
  * \ingroup OpenCL
  * \sa TimeProbe
  */
@@ -45,6 +48,7 @@ private:
 
   TimeProbe   m_Timer;
   std::string m_ProfilingMessage;
+  double      m_TraceStart;
 };
 
 } // end namespace itk
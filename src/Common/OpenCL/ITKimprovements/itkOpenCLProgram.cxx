@@ -253,12 +253,8 @@ OpenCLProgram::Build( const std::list< OpenCLDevice > & devices,
     }
   }
 
-  // Get OpenCL math and optimization options
-  std::string oclOptions;
-  OpenCLProgramSupport::GetOpenCLMathAndOptimizationOptions( oclOptions );
-
-  // Append extra OpenCL options if provided
-  oclOptions = !extraBuildOptions.empty() ? oclOptions + " " + extraBuildOptions : oclOptions;
+  // Get OpenCL math and optimization options, and the extra options
+  std::string oclOptions = OpenCLProgram::GetBuildOptions( extraBuildOptions );
 
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
   if( GetFileName().size() > 0 )
@@ -394,6 +390,60 @@ std::list< OpenCLDevice > OpenCLProgram::GetDevices() const
 }
 
 
+//------------------------------------------------------------------------------
+std::vector< std::vector< unsigned char > >
+OpenCLProgram::GetBinaries() const
+{
+  std::vector< std::vector< unsigned char > > binaries;
+  cl_uint                                     numDevices = 0;
+
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_NUM_DEVICES,
+    sizeof( numDevices ), &numDevices, 0 ) != CL_SUCCESS || numDevices == 0 )
+  {
+    return binaries;
+  }
+
+  std::vector< std::size_t > sizes( numDevices, 0 );
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_BINARY_SIZES,
+    numDevices * sizeof( std::size_t ), &sizes[ 0 ], 0 ) != CL_SUCCESS )
+  {
+    return binaries;
+  }
+
+  // clGetProgramInfo() copies each binary into memory provided by the caller
+  binaries.resize( numDevices );
+  std::vector< unsigned char * > pointers( numDevices, static_cast< unsigned char * >( 0 ) );
+  for( cl_uint i = 0; i < numDevices; ++i )
+  {
+    if( sizes[ i ] > 0 )
+    {
+      binaries[ i ].resize( sizes[ i ] );
+      pointers[ i ] = &binaries[ i ][ 0 ];
+    }
+  }
+
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_BINARIES,
+    numDevices * sizeof( unsigned char * ), &pointers[ 0 ], 0 ) != CL_SUCCESS )
+  {
+    binaries.clear();
+  }
+  return binaries;
+}
+
+
+//------------------------------------------------------------------------------
+std::string
+OpenCLProgram::GetBuildOptions( const std::string & extraBuildOptions )
+{
+  // Get OpenCL math and optimization options
+  std::string oclOptions;
+  OpenCLProgramSupport::GetOpenCLMathAndOptimizationOptions( oclOptions );
+
+  // Append extra OpenCL options if provided
+  return !extraBuildOptions.empty() ? oclOptions + " " + extraBuildOptions : oclOptions;
+}
+
+
 //------------------------------------------------------------------------------
 OpenCLKernel
 OpenCLProgram::CreateKernel( const std::string & name ) const
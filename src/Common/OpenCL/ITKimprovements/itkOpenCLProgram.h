@@ -22,6 +22,7 @@
 #include "itkOpenCLKernel.h"
 
 #include <string>
+#include <vector>
 
 namespace itk
 {
@@ -101,6 +102,17 @@ public:
    * \sa GetBinaries() */
   std::list< OpenCLDevice > GetDevices() const;
 
+  /** Returns the binaries of this program, one for each device returned
+   * by GetDevices(), in the same order. A binary is empty if the program
+   * was not built for that device.
+   * \sa GetDevices(), OpenCLContext::CreateProgramFromBinaryCode() */
+  std::vector< std::vector< unsigned char > > GetBinaries() const;
+
+  /** Returns the compiler options that Build() passes to clBuildProgram:
+   * the options provided during CMake configuration, followed by
+   * \a extraBuildOptions. */
+  static std::string GetBuildOptions( const std::string & extraBuildOptions = std::string() );
+
   /** Creates a kernel for the entry point associated with \a name
    * in this program.
    * \sa Build() */
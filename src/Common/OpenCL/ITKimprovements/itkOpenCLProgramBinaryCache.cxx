@@ -0,0 +1,243 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkOpenCLProgramBinaryCache.h"
+#include "itkOpenCLContext.h"
+#include "itkOpenCLKernels.h"
+#include "itkOpenCLMacro.h"
+#include "itkProcessId.h"
+
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+// The header identifies the file format; the key guards against renamed files.
+const char * const OpenCLProgramBinaryCacheHeader = "elastix OpenCL program binary 1";
+
+struct OpenCLProgramBinaryCacheState
+{
+  OpenCLProgramBinaryCacheState() :
+    m_DirectoryIsSet( false ), m_NumberOfHits( 0 ), m_NumberOfMisses( 0 )
+  {}
+
+  std::string   m_Directory;
+  bool          m_DirectoryIsSet;
+  unsigned long m_NumberOfHits;
+  unsigned long m_NumberOfMisses;
+};
+
+OpenCLProgramBinaryCacheState &
+GetOpenCLProgramBinaryCacheState()
+{
+  static OpenCLProgramBinaryCacheState state;
+  return state;
+}
+
+
+} // end namespace
+
+namespace itk
+{
+//------------------------------------------------------------------------------
+void
+OpenCLProgramBinaryCache::SetDirectory( const std::string & directory )
+{
+  OpenCLProgramBinaryCacheState & state = GetOpenCLProgramBinaryCacheState();
+  state.m_Directory      = directory;
+  state.m_DirectoryIsSet = true;
+}
+
+
+//------------------------------------------------------------------------------
+std::string
+OpenCLProgramBinaryCache::GetDirectory()
+{
+  OpenCLProgramBinaryCacheState & state = GetOpenCLProgramBinaryCacheState();
+  if( !state.m_DirectoryIsSet )
+  {
+    // The environment overrides the directory chosen during CMake configuration
+    const char * environment = itksys::SystemTools::GetEnv( "ELASTIX_OPENCL_PROGRAM_CACHE_DIR" );
+    state.m_Directory      = environment != NULL ? environment : OpenCLProgramCacheDirectory;
+    state.m_DirectoryIsSet = true;
+  }
+  return state.m_Directory;
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLProgramBinaryCache::IsEnabled()
+{
+  return !OpenCLProgramBinaryCache::GetDirectory().empty();
+}
+
+
+//------------------------------------------------------------------------------
+std::string
+OpenCLProgramBinaryCache::GetKey( const OpenCLDevice & device,
+  const std::string & source, const std::string & buildOptions )
+{
+  std::ostringstream description;
+  description << device.GetName() << '\n'
+              << device.GetVendor() << '\n'
+              << device.GetVersion() << '\n'
+              << device.GetDriverVersion() << '\n'
+              << buildOptions << '\n';
+  const std::string text = description.str();
+
+  itksysMD5 * md5 = itksysMD5_New();
+  itksysMD5_Initialize( md5 );
+  itksysMD5_Append( md5, (unsigned char *)text.c_str(), text.size() );
+  itksysMD5_Append( md5, (unsigned char *)source.c_str(), source.size() );
+  const std::size_t DigestSize = 32u;
+  char              Digest[ DigestSize ];
+  itksysMD5_FinalizeHex( md5, Digest );
+  itksysMD5_Delete( md5 );
+
+  return std::string( Digest, DigestSize );
+}
+
+
+//------------------------------------------------------------------------------
+OpenCLProgram
+OpenCLProgramBinaryCache::Load( OpenCLContext * context, const std::string & key )
+{
+  OpenCLProgramBinaryCacheState & state = GetOpenCLProgramBinaryCacheState();
+
+  std::ifstream file( GetFileName( key ).c_str(), std::ios::in | std::ios::binary );
+  if( !file.is_open() )
+  {
+    ++state.m_NumberOfMisses;
+    return OpenCLProgram();
+  }
+
+  std::string header, storedKey;
+  std::size_t size = 0;
+  std::getline( file, header );
+  std::getline( file, storedKey );
+  file >> size;
+  file.ignore( 1 );
+  if( !file || header != OpenCLProgramBinaryCacheHeader || storedKey != key || size == 0 )
+  {
+    ++state.m_NumberOfMisses;
+    return OpenCLProgram();
+  }
+
+  std::vector< unsigned char > binary( size );
+  file.read( reinterpret_cast< char * >( &binary[ 0 ] ), size );
+  if( static_cast< std::size_t >( file.gcount() ) != size )
+  {
+    ++state.m_NumberOfMisses;
+    return OpenCLProgram();
+  }
+
+  // A binary of another driver is rejected by clCreateProgramWithBinary
+  OpenCLProgram program;
+  try
+  {
+    program = context->CreateProgramFromBinaryCode( &binary[ 0 ], size );
+  }
+  catch( ExceptionObject & )
+  {
+    program = OpenCLProgram();
+  }
+
+  if( program.IsNull() )
+  {
+    ++state.m_NumberOfMisses;
+  }
+  else
+  {
+    ++state.m_NumberOfHits;
+  }
+  return program;
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLProgramBinaryCache::Store( const OpenCLProgram & program, const std::string & key )
+{
+  const std::vector< std::vector< unsigned char > > binaries = program.GetBinaries();
+  if( binaries.size() != 1 || binaries[ 0 ].empty() )
+  {
+    return false;
+  }
+
+  const std::string directory = OpenCLProgramBinaryCache::GetDirectory();
+  if( !itksys::SystemTools::MakeDirectory( directory.c_str() ) )
+  {
+    itkOpenCLWarningMacroGeneric( << "Cannot create OpenCL program cache directory: " << directory );
+    return false;
+  }
+
+  // Write to a temporary file first, so that concurrent processes never
+  // read a partially written binary. The temporary file is unique for every
+  // writer, also for concurrent registrations in the same process.
+  const std::string fileName = GetFileName( key );
+  const std::string tempName = itk::GetUniqueTemporaryFileName( fileName );
+  std::ofstream     file( tempName.c_str(), std::ios::out | std::ios::binary );
+  if( !file.is_open() )
+  {
+    itkOpenCLWarningMacroGeneric( << "Cannot write OpenCL program cache file: " << tempName );
+    return false;
+  }
+
+  const std::vector< unsigned char > & binary = binaries[ 0 ];
+  file << OpenCLProgramBinaryCacheHeader << '\n' << key << '\n' << binary.size() << '\n';
+  file.write( reinterpret_cast< const char * >( &binary[ 0 ] ), binary.size() );
+  file.close();
+
+  if( !file || std::rename( tempName.c_str(), fileName.c_str() ) != 0 )
+  {
+    std::remove( tempName.c_str() );
+    return false;
+  }
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+unsigned long
+OpenCLProgramBinaryCache::GetNumberOfHits()
+{
+  return GetOpenCLProgramBinaryCacheState().m_NumberOfHits;
+}
+
+
+//------------------------------------------------------------------------------
+unsigned long
+OpenCLProgramBinaryCache::GetNumberOfMisses()
+{
+  return GetOpenCLProgramBinaryCacheState().m_NumberOfMisses;
+}
+
+
+//------------------------------------------------------------------------------
+std::string
+OpenCLProgramBinaryCache::GetFileName( const std::string & key )
+{
+  return OpenCLProgramBinaryCache::GetDirectory() + "/ocl-" + key + ".bin";
+}
+
+
+} // end namespace itk
@@ -0,0 +1,94 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkOpenCLProgramBinaryCache_h
+#define __itkOpenCLProgramBinaryCache_h
+
+#include "itkOpenCLProgram.h"
+
+#include <string>
+
+namespace itk
+{
+/**
+ * \class OpenCLProgramBinaryCache
+ * \brief On-disk cache of built OpenCL program binaries.
+ *
+ * Building the OpenCL programs for all transform and interpolator
+ * combinations takes seconds, which dominates short transformix runs.
+ * This cache stores the binary of a built program, obtained with
+ * clGetProgramInfo(CL_PROGRAM_BINARIES), in a file whose name is the MD5
+ * hash of the device name, vendor, OpenCL version, driver version, the
+ * build options and the complete source code. A later run on the same
+ * device and driver loads the binary instead of compiling the source.
+ *
+ * The cache is disabled when the directory is empty. The directory is
+ * taken from SetDirectory(), or else from the environment variable
+ * ELASTIX_OPENCL_PROGRAM_CACHE_DIR, or else from the CMake variable
+ * OPENCL_PROGRAM_CACHE_DIR.
+ *
+ * \sa OpenCLContext::BuildProgramFromSourceCode()
+ * \ingroup OpenCL
+ */
+
+// Forward declaration
+class OpenCLContext;
+
+class ITKOpenCL_EXPORT OpenCLProgramBinaryCache
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef OpenCLProgramBinaryCache Self;
+
+  /** Set/Get the cache directory. An empty directory disables the cache. */
+  static void SetDirectory( const std::string & directory );
+
+  static std::string GetDirectory();
+
+  /** Returns true if a cache directory is set. */
+  static bool IsEnabled();
+
+  /** Returns the key of the program built from \a source with
+   * \a buildOptions for \a device. */
+  static std::string GetKey( const OpenCLDevice & device,
+    const std::string & source, const std::string & buildOptions );
+
+  /** Creates the program stored under \a key for the default device of
+   * \a context. Returns a null program on a cache miss. The program still
+   * needs to be built, which for a binary is fast. */
+  static OpenCLProgram Load( OpenCLContext * context, const std::string & key );
+
+  /** Stores the binary of the built \a program under \a key.
+   * Returns false if the binary could not be written. */
+  static bool Store( const OpenCLProgram & program, const std::string & key );
+
+  /** Number of cache hits and misses in this process. */
+  static unsigned long GetNumberOfHits();
+
+  static unsigned long GetNumberOfMisses();
+
+private:
+
+  /** Returns the file name of \a key in the cache directory. */
+  static std::string GetFileName( const std::string & key );
+
+};
+
+} // end namespace itk
+
+#endif /* __itkOpenCLProgramBinaryCache_h */
@@ -966,3 +966,227 @@ __kernel void ResampleImageFilterPost_BSplineInterpolator(
   }
 }
 #endif
+
+//------------------------------------------------------------------------------
+// The kernels below compute the outputs of transformix on the GPU, from the
+// transformed points of the pre and loop kernels. They are compiled with the
+// pre kernel. The displacement kernel is launched for every chunk, after the
+// loop kernels, and writes the displacement of the chunk to the full size
+// displacement buffer: DIM floats per output pixel. The determinant kernel is
+// launched once on the full displacement buffer, after all chunks.
+//
+// The spatial Jacobian of x -> x + u(x) is computed with central differences
+// of the displacement along the grid, one-sided at the border of the image:
+// dT/dx = ( du/di + D S ) ( D S )^-1, with D S the index to physical point
+// matrix. For transforms that are linear between grid points this is exact,
+// for B-spline transforms it is a second order approximation.
+
+//------------------------------------------------------------------------------
+#if defined( DIM_1 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDisplacement(
+  /* Transformation field buffer */
+  __global const float *transformation_field,
+  /* Transformation field size */
+  uint transformation_field_size,
+  /* Output image information */
+  const float index_to_physical_point,
+  const float origin,
+  const uint size,
+  /* Displacement buffer, of the full output size */
+  __global float *displacement )
+{
+  uint global_id = get_global_id_1d();
+  uint index = get_current_image_index_1d( global_id );
+
+  if( is_valid_1d( index, transformation_field_size ) && is_valid_1d( global_id, size ) )
+  {
+    float point = transform_index_to_physical_point_1d_(
+      global_id, index_to_physical_point, origin );
+    displacement[ global_id ] = transformation_field[ index ] - point;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined( DIM_1 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDeterminantOfSpatialJacobian(
+  /* Displacement buffer, of the full output size */
+  __global const float *displacement,
+  /* Output image size */
+  const uint size,
+  /* Output image information */
+  const float index_to_physical_point,
+  /* Determinant buffer, of the full output size */
+  __global float *determinant )
+{
+  uint global_id = get_global_id_1d();
+
+  if( is_valid_1d( global_id, size ) )
+  {
+    const uint before = global_id > 0 ? global_id - 1 : global_id;
+    const uint after = global_id + 1 < size ? global_id + 1 : global_id;
+    float du = 0.0f;
+    if( after > before )
+    {
+      du = ( displacement[ after ] - displacement[ before ] ) / (float)( after - before );
+    }
+    determinant[ global_id ] = ( du + index_to_physical_point ) / index_to_physical_point;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined( DIM_2 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDisplacement(
+  /* Transformation field buffer */
+  __global const float2 *transformation_field,
+  /* Transformation field size */
+  uint2 transformation_field_size,
+  /* Output image information */
+  const float4 index_to_physical_point,
+  const float2 origin,
+  const uint2 size,
+  /* Displacement buffer, of the full output size */
+  __global float *displacement )
+{
+  uint2 global_id = get_global_id_2d();
+  uint2 index = get_current_image_index_2d( global_id );
+
+  if( is_valid_2d( index, transformation_field_size ) && is_valid_2d( global_id, size ) )
+  {
+    float2 point = transform_index_to_physical_point_2d_(
+      global_id, index_to_physical_point, origin );
+    const uint tidx = mad24( transformation_field_size.x, index.y, index.x );
+    const uint gidx = mad24( size.x, global_id.y, global_id.x );
+    const float2 u = transformation_field[ tidx ] - point;
+    displacement[ 2 * gidx ] = u.x;
+    displacement[ 2 * gidx + 1 ] = u.y;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined( DIM_2 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDeterminantOfSpatialJacobian(
+  /* Displacement buffer, of the full output size */
+  __global const float *displacement,
+  /* Output image size */
+  const uint2 size,
+  /* Output image information */
+  const float4 index_to_physical_point,
+  /* Determinant buffer, of the full output size */
+  __global float *determinant )
+{
+  uint2 global_id = get_global_id_2d();
+
+  if( is_valid_2d( global_id, size ) )
+  {
+    // Columns of du/di + D S, one per grid direction.
+    float2 column[ 2 ];
+    column[ 0 ] = index_to_physical_point.s02;
+    column[ 1 ] = index_to_physical_point.s13;
+
+    const uint position[ 2 ] = { global_id.x, global_id.y };
+    const uint limit[ 2 ] = { size.x, size.y };
+    const uint stride[ 2 ] = { 1, size.x };
+    const uint gidx = mad24( size.x, global_id.y, global_id.x );
+    for( uint c = 0; c < 2; c++ )
+    {
+      const uint before = position[ c ] > 0 ? gidx - stride[ c ] : gidx;
+      const uint after = position[ c ] + 1 < limit[ c ] ? gidx + stride[ c ] : gidx;
+      if( after > before )
+      {
+        const float h = (float)( ( after - before ) / stride[ c ] );
+        column[ c ].x += ( displacement[ 2 * after ] - displacement[ 2 * before ] ) / h;
+        column[ c ].y += ( displacement[ 2 * after + 1 ] - displacement[ 2 * before + 1 ] ) / h;
+      }
+    }
+
+    const float detJ = column[ 0 ].x * column[ 1 ].y - column[ 1 ].x * column[ 0 ].y;
+    const float detDS = index_to_physical_point.s0 * index_to_physical_point.s3
+      - index_to_physical_point.s1 * index_to_physical_point.s2;
+    determinant[ gidx ] = detJ / detDS;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined( DIM_3 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDisplacement(
+  /* Transformation field buffer */
+  __global const float3 *transformation_field,
+  /* Transformation field size */
+  uint3 transformation_field_size,
+  /* Output image information */
+  const float16 index_to_physical_point, // OpenCL does not have float9
+  const float3 origin,
+  const uint3 size,
+  /* Displacement buffer, of the full output size */
+  __global float *displacement )
+{
+  uint3 global_id = get_global_id_3d();
+  uint3 index = get_current_image_index_3d( global_id );
+
+  if( is_valid_3d( index, transformation_field_size ) && is_valid_3d( global_id, size ) )
+  {
+    float3 point = transform_index_to_physical_point_3d_(
+      global_id, index_to_physical_point, origin );
+    const uint tidx = mad24( transformation_field_size.x,
+      mad24( index.z, transformation_field_size.y, index.y ), index.x );
+    const uint gidx = mad24( size.x, mad24( global_id.z, size.y, global_id.y ), global_id.x );
+    const float3 u = transformation_field[ tidx ] - point;
+    displacement[ 3 * gidx ] = u.x;
+    displacement[ 3 * gidx + 1 ] = u.y;
+    displacement[ 3 * gidx + 2 ] = u.z;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined( DIM_3 ) && defined( RESAMPLE_PRE )
+__kernel void ResampleImageFilterDeterminantOfSpatialJacobian(
+  /* Displacement buffer, of the full output size */
+  __global const float *displacement,
+  /* Output image size */
+  const uint3 size,
+  /* Output image information */
+  const float16 index_to_physical_point, // OpenCL does not have float9
+  /* Determinant buffer, of the full output size */
+  __global float *determinant )
+{
+  uint3 global_id = get_global_id_3d();
+
+  if( is_valid_3d( global_id, size ) )
+  {
+    // Columns of du/di + D S, one per grid direction.
+    float3 column[ 3 ];
+    column[ 0 ] = index_to_physical_point.s036;
+    column[ 1 ] = index_to_physical_point.s147;
+    column[ 2 ] = index_to_physical_point.s258;
+
+    const uint position[ 3 ] = { global_id.x, global_id.y, global_id.z };
+    const uint limit[ 3 ] = { size.x, size.y, size.z };
+    const uint stride[ 3 ] = { 1, size.x, size.x * size.y };
+    const uint gidx = mad24( size.x, mad24( global_id.z, size.y, global_id.y ), global_id.x );
+    for( uint c = 0; c < 3; c++ )
+    {
+      const uint before = position[ c ] > 0 ? gidx - stride[ c ] : gidx;
+      const uint after = position[ c ] + 1 < limit[ c ] ? gidx + stride[ c ] : gidx;
+      if( after > before )
+      {
+        const float h = (float)( ( after - before ) / stride[ c ] );
+        column[ c ].x += ( displacement[ 3 * after ] - displacement[ 3 * before ] ) / h;
+        column[ c ].y += ( displacement[ 3 * after + 1 ] - displacement[ 3 * before + 1 ] ) / h;
+        column[ c ].z += ( displacement[ 3 * after + 2 ] - displacement[ 3 * before + 2 ] ) / h;
+      }
+    }
+
+    const float3 ds0 = index_to_physical_point.s036;
+    const float3 ds1 = index_to_physical_point.s147;
+    const float3 ds2 = index_to_physical_point.s258;
+    const float detJ = dot( column[ 0 ], cross( column[ 1 ], column[ 2 ] ) );
+    const float detDS = dot( ds0, cross( ds1, ds2 ) );
+    determinant[ gidx ] = detJ / detDS;
+  }
+}
+#endif
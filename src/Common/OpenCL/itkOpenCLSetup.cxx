@@ -19,6 +19,7 @@
 
 #include "itkOpenCLLogger.h"
 #include "itkOpenCLContext.h"
+#include "itkOpenCLProfilingReport.h"
 #include <sstream>
 
 namespace itk
@@ -47,6 +48,23 @@ CreateOpenCLContext( std::string & errorMessage,
 #endif
   }
 
+  return CreateOpenCLContext( errorMessage, openCLDeviceType,
+    std::vector< int >( 1, openCLDeviceID ) );
+} // end CreateOpenCLContext()
+
+
+//------------------------------------------------------------------------------
+bool
+CreateOpenCLContext( std::string & errorMessage,
+  const std::string openCLDeviceType,
+  const std::vector< int > & openCLDeviceIDs )
+{
+  /** Get a handle to an existing OpenCL context. */
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+
+  /** If it already existed, then do nothing. */
+  if( context->IsCreated() ) { return true; }
+
   /** Convert device type string to enum. */
   const std::string             indent( "  " );
   itk::OpenCLDevice::DeviceType deviceType = itk::OpenCLDevice::Default;
@@ -81,60 +99,65 @@ CreateOpenCLContext( std::string & errorMessage,
     }
   }
 
-  /** Check if user provided the correct OpenCL device ID. */
-  if( ( openCLDeviceID < 0 ) || ( openCLDeviceID > static_cast< int >( devicesByType.size() ) - 1 ) )
+  /** Check if user provided the correct OpenCL device IDs. */
+  for( std::size_t i = 0; i < openCLDeviceIDs.size(); ++i )
   {
-    const std::string s = ( devicesByType.size() > 1 ) ? "s" : "";
-    std::stringstream errorMessageStream;
-    errorMessageStream << "ERROR: You have selected the OpenCL device ID: " << openCLDeviceID
-                       << ", with (OpenCLDeviceID \"" << openCLDeviceID << "\") option." << std::endl
-                       << indent << "There are only " << devicesByType.size() << " "
-                       << openCLDeviceType << " OpenCL-enabled device" << s << " present on this system:" << std::endl;
-
-    unsigned int deviceID = 0;
-    for( std::list< itk::OpenCLDevice >::const_iterator device = devicesByType.begin(); device != devicesByType.end(); ++device )
+    const int openCLDeviceID = openCLDeviceIDs[ i ];
+    if( ( openCLDeviceID < 0 ) || ( openCLDeviceID > static_cast< int >( devicesByType.size() ) - 1 ) )
     {
-      errorMessageStream << indent << "OpenCL device ID: " << deviceID << std::endl;
-      errorMessageStream << indent << indent << "Name: " << ( *device ).GetName() << std::endl;
-      errorMessageStream << indent << indent << "Vendor: " << ( *device ).GetVendor() << std::endl;
-      errorMessageStream << indent << indent << "Has double support: " << ( ( *device ).HasDouble() ? "Yes" : "No" ) << std::endl;
-      errorMessageStream << indent << indent << "Device type: ";
-      switch( ( *device ).GetDeviceType() )
+      const std::string s = ( devicesByType.size() > 1 ) ? "s" : "";
+      std::stringstream errorMessageStream;
+      errorMessageStream << "ERROR: You have selected the OpenCL device ID: " << openCLDeviceID
+                         << ", with (OpenCLDeviceID \"" << openCLDeviceID << "\") option." << std::endl
+                         << indent << "There are only " << devicesByType.size() << " "
+                         << openCLDeviceType << " OpenCL-enabled device" << s << " present on this system:" << std::endl;
+
+      unsigned int deviceID = 0;
+      for( std::list< itk::OpenCLDevice >::const_iterator device = devicesByType.begin(); device != devicesByType.end(); ++device )
       {
-        case OpenCLDevice::Default:
-          errorMessageStream << "Default"; break;
-        case OpenCLDevice::CPU:
-          errorMessageStream << "CPU"; break;
-        case OpenCLDevice::GPU:
-          errorMessageStream << "GPU"; break;
-        case OpenCLDevice::Accelerator:
-          errorMessageStream << "Accelerator"; break;
-        case OpenCLDevice::All:
-          errorMessageStream << "All"; break;
-        default:
-          errorMessageStream << "Unknown"; break;
+        errorMessageStream << indent << "OpenCL device ID: " << deviceID << std::endl;
+        errorMessageStream << indent << indent << "Name: " << ( *device ).GetName() << std::endl;
+        errorMessageStream << indent << indent << "Vendor: " << ( *device ).GetVendor() << std::endl;
+        errorMessageStream << indent << indent << "Has double support: " << ( ( *device ).HasDouble() ? "Yes" : "No" ) << std::endl;
+        errorMessageStream << indent << indent << "Device type: ";
+        switch( ( *device ).GetDeviceType() )
+        {
+          case OpenCLDevice::Default:
+            errorMessageStream << "Default"; break;
+          case OpenCLDevice::CPU:
+            errorMessageStream << "CPU"; break;
+          case OpenCLDevice::GPU:
+            errorMessageStream << "GPU"; break;
+          case OpenCLDevice::Accelerator:
+            errorMessageStream << "Accelerator"; break;
+          case OpenCLDevice::All:
+            errorMessageStream << "All"; break;
+          default:
+            errorMessageStream << "Unknown"; break;
+        }
+        errorMessageStream << std::endl << indent << "elastix option: "
+                           << "(OpenCLDeviceID \"" << deviceID << "\")" << std::endl;
+        ++deviceID;
       }
-      errorMessageStream << std::endl << indent << "elastix option: "
-                         << "(OpenCLDeviceID \"" << deviceID << "\")" << std::endl;
-      ++deviceID;
-    }
 
-    errorMessageStream << std::endl << indent << "Please provide the correct "
-                       << openCLDeviceType << " OpenCL device ID using the (OpenCLDeviceID \"\") option." << std::endl;
-    errorMessage = errorMessageStream.str();
+      errorMessageStream << std::endl << indent << "Please provide the correct "
+                         << openCLDeviceType << " OpenCL device ID using the (OpenCLDeviceID \"\") option." << std::endl;
+      errorMessage = errorMessageStream.str();
 
-    return false;
+      return false;
+    }
   }
 
-  /** Select the OpenCL device ID. The operator[] does not exist for std::list.
-   * We have to loop over devicesByType and select it. */
+  /** Select the OpenCL device IDs. The operator[] does not exist for std::list.
+   * We have to loop over devicesByType and select them. */
   std::list< itk::OpenCLDevice > selected;
-  int                            deviceID = 0;
-  for( std::list< OpenCLDevice >::const_iterator device = devicesByType.begin();
-    device != devicesByType.end(); ++device )
+  for( std::size_t i = 0; i < openCLDeviceIDs.size(); ++i )
   {
+    int deviceID = 0;
+    for( std::list< OpenCLDevice >::const_iterator device = devicesByType.begin();
+      device != devicesByType.end(); ++device )
     {
-      if( deviceID == openCLDeviceID )
+      if( deviceID == openCLDeviceIDs[ i ] )
       {
         selected.push_back( *device );
         break;
@@ -143,8 +166,24 @@ CreateOpenCLContext( std::string & errorMessage,
     }
   }
 
-  /** Create OpenCL context that matches selected device. */
-  if( selected.size() == 1 )
+  /** All devices of one context must belong to the same platform. */
+  for( std::list< OpenCLDevice >::const_iterator device = selected.begin();
+    device != selected.end(); ++device )
+  {
+    if( ( *device ).GetPlatform() != selected.front().GetPlatform() )
+    {
+      std::stringstream errorMessageStream;
+      errorMessageStream << "ERROR: The OpenCL devices selected with the (OpenCLDeviceID) option "
+                         << "do not belong to the same OpenCL platform." << std::endl
+                         << indent << "Please select devices of one platform, e.g. from one vendor." << std::endl;
+      errorMessage = errorMessageStream.str();
+
+      return false;
+    }
+  }
+
+  /** Create OpenCL context that matches selected devices. */
+  if( !selected.empty() )
   {
     context->Create( selected );
   }
@@ -196,6 +235,37 @@ CreateOpenCLContext( std::string & errorMessage,
 } // end CreateOpenCLContext()
 
 
+//------------------------------------------------------------------------------
+bool
+SelectOpenCLDevice( std::string & errorMessage, const int openCLDeviceIndex )
+{
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  if( !context->IsCreated() || context->GetNumberOfDevices() < 2 )
+  {
+    return true;
+  }
+
+  if( openCLDeviceIndex < 0 )
+  {
+    context->SetNextActiveDevice();
+    return true;
+  }
+
+  if( !context->SetActiveDevice( static_cast< std::size_t >( openCLDeviceIndex ) ) )
+  {
+    std::stringstream errorMessageStream;
+    errorMessageStream << "ERROR: You have selected the OpenCL device index: " << openCLDeviceIndex
+                       << ", with (OpenCLDeviceIndex \"" << openCLDeviceIndex << "\") option." << std::endl
+                       << "  The OpenCL context only has " << context->GetNumberOfDevices()
+                       << " devices." << std::endl;
+    errorMessage = errorMessageStream.str();
+
+    return false;
+  }
+  return true;
+} // end SelectOpenCLDevice()
+
+
 //------------------------------------------------------------------------------
 void
 CreateOpenCLLogger( const std::string & prefixFileName, const std::string & outputDirectory )
@@ -207,4 +277,39 @@ CreateOpenCLLogger( const std::string & prefixFileName, const std::string & outp
 } // end CreateOpenCLLogger()
 
 
+//------------------------------------------------------------------------------
+bool
+WriteOpenCLProfilingReport( std::ostream & os,
+  const std::string & prefixFileName, const std::string & outputDirectory )
+{
+  itk::OpenCLProfilingReport::Pointer report = itk::OpenCLProfilingReport::GetInstance();
+  if( !itk::OpenCLProfilingReport::IsEnabled() || report->GetNumberOfRecords() == 0 )
+  {
+    return false;
+  }
+
+  /** Construct the file name the same way as for the OpenCL logger. */
+  std::string fileName = outputDirectory;
+  if( !fileName.empty() && fileName[ fileName.size() - 1 ] != '/' )
+  {
+    fileName.append( "/" );
+  }
+  fileName.append( prefixFileName + "_opencl_profiling.json" );
+
+  report->WriteReport( os );
+  if( report->WriteJSONFile( fileName ) )
+  {
+    os << "  The OpenCL profiling report was written to '" << fileName << "'." << std::endl;
+  }
+  else
+  {
+    os << "  Unable to write the OpenCL profiling report to '" << fileName << "'." << std::endl;
+  }
+
+  /** Start the next run with an empty report. */
+  report->Clear();
+  return true;
+} // end WriteOpenCLProfilingReport()
+
+
 } // end namespace itk
@@ -18,7 +18,9 @@
 #ifndef __itkOpenCLSetup_h
 #define __itkOpenCLSetup_h
 
+#include <ostream>
 #include <string>
+#include <vector>
 
 /** This file contains helper functionality to enable
  * OpenCL support within elastix and transformix.
@@ -29,9 +31,26 @@ namespace itk
 bool CreateOpenCLContext( std::string & errorMessage,
   const std::string openCLDeviceType, const int openCLDeviceID );
 
+/** Method that is used to create a multi-device OpenCL context within
+ * elastix and transformix, from devices that share one platform. */
+bool CreateOpenCLContext( std::string & errorMessage,
+  const std::string openCLDeviceType, const std::vector< int > & openCLDeviceIDs );
+
+/** Method that is used to select the device of a multi-device OpenCL context
+ * for one elastix or transformix run. A negative \a openCLDeviceIndex selects
+ * the devices round-robin, so consecutive runs in one process alternate. */
+bool SelectOpenCLDevice( std::string & errorMessage, const int openCLDeviceIndex );
+
 /** Method that is used to create OpenCL logger within elastix and transformix. */
 void CreateOpenCLLogger( const std::string & prefixFileName, const std::string & outputDirectory );
 
+/** Method that is used to write the OpenCL profiling report of a run within
+ * elastix and transformix, as a table to \a os and as JSON to the file
+ * <prefixFileName>_opencl_profiling.json in \a outputDirectory. Only does
+ * something when compiled with OPENCL_PROFILING. Returns true if written. */
+bool WriteOpenCLProfilingReport( std::ostream & os,
+  const std::string & prefixFileName, const std::string & outputDirectory );
+
 } // end namespace itk
 
 #endif
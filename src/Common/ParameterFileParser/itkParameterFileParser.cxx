@@ -22,7 +22,8 @@
 #include "itkParameterFileParser.h"
 
 #include <itksys/SystemTools.hxx>
-#include <itksys/RegularExpression.hxx>
+
+#include <algorithm>
 
 namespace itk
 {
@@ -185,25 +186,27 @@ ParameterFileParser
    * 2) Remove everything after comment sign //
    * 3) Remove leading spaces
    * 4) Remove trailing spaces
+   * This is done in a single pass over the line, without regular
+   * expressions, since lines can contain millions of values.
    */
-  lineOut = lineIn;
-  itksys::SystemTools::ReplaceString( lineOut, "\t", " " );
-
-  itksys::RegularExpression commentPart( "//" );
-  if( commentPart.find( lineOut ) )
+  std::string::size_type end = lineIn.find( "//" );
+  if( end == std::string::npos )
   {
-    lineOut = lineOut.substr( 0, commentPart.start() );
+    end = lineIn.size();
   }
 
-  itksys::RegularExpression leadingSpaces( "^[ ]*(.*)" );
-  leadingSpaces.find( lineOut );
-  lineOut = leadingSpaces.match( 1 );
-
-  itksys::RegularExpression trailingSpaces( "[ \t]+$" );
-  if( trailingSpaces.find( lineOut ) )
+  std::string::size_type begin = 0;
+  while( begin < end && ( lineIn[ begin ] == ' ' || lineIn[ begin ] == '\t' ) )
   {
-    lineOut = lineOut.substr( 0, trailingSpaces.start() );
+    ++begin;
   }
+  while( end > begin && ( lineIn[ end - 1 ] == ' ' || lineIn[ end - 1 ] == '\t' ) )
+  {
+    --end;
+  }
+
+  lineOut.assign( lineIn, begin, end - begin );
+  std::replace( lineOut.begin(), lineOut.end(), '\t', ' ' );
 
   /**
    * Checks:
@@ -215,18 +218,8 @@ ParameterFileParser
    * Otherwise return true.
    */
 
-  /** 1. Check for non-empty lines. */
-  itksys::RegularExpression reNonEmptyLine( "[^ ]+" );
-  bool                      match1 = reNonEmptyLine.find( lineOut );
-  if( !match1 )
-  {
-    return false;
-  }
-
-  /** 2. Check for comments. */
-  itksys::RegularExpression reComment( "^//" );
-  bool                      match2 = reComment.find( lineOut );
-  if( match2 )
+  /** 1. Check for non-empty lines. 2. Comments have been removed already. */
+  if( lineOut.empty() )
   {
     return false;
   }
@@ -240,12 +233,15 @@ ParameterFileParser
   }
 
   /** Remove brackets. */
-  lineOut = lineOut.substr( 1, lineOut.size() - 2 );
+  lineOut.erase( lineOut.size() - 1 );
+  lineOut.erase( 0, 1 );
 
-  /** 4. Check: the line should contain at least two words. */
-  itksys::RegularExpression reTwoWords( "([ ]+)([^ ]+)" );
-  bool                      match4 = reTwoWords.find( lineOut );
-  if( !match4 )
+  /** 4. Check: the line should contain at least two words,
+   * i.e. a space followed by a non-space.
+   */
+  const std::string::size_type firstSpace = lineOut.find( ' ' );
+  if( firstSpace == std::string::npos
+    || lineOut.find_first_not_of( ' ', firstSpace ) == std::string::npos )
   {
     std::string hint = "Line does not contain a parameter name and value.";
     this->ThrowException( lineIn, hint );
@@ -286,22 +282,24 @@ ParameterFileParser
   /** 2) Get the parameter name. */
   std::string parameterName = splittedLine[ 0 ];
   itksys::SystemTools::ReplaceString( parameterName, " ", "" );
-  splittedLine.erase( splittedLine.begin() );
 
-  /** 3) Get the parameter values. */
+  /** 3) Get the parameter values. The strings are moved, not copied. */
   std::vector< std::string > parameterValues;
-  for( unsigned int i = 0; i < splittedLine.size(); ++i )
+  parameterValues.reserve( splittedLine.size() - 1 );
+  for( std::size_t i = 1; i < splittedLine.size(); ++i )
   {
-    if( splittedLine[ i ] != "" )
+    if( !splittedLine[ i ].empty() )
     {
-      parameterValues.push_back( splittedLine[ i ] );
+      parameterValues.push_back( std::string() );
+      parameterValues.back().swap( splittedLine[ i ] );
     }
   }
 
-  /** 4) Perform some checks on the parameter name. */
-  itksys::RegularExpression reInvalidCharacters1( "[.,:;!@#$%^&-+|<>?]" );
-  bool                      match = reInvalidCharacters1.find( parameterName );
-  if( match )
+  /** 4) Perform some checks on the parameter name. These are the characters
+   * of the former regular expression "[.,:;!@#$%^&-+|<>?]", in which "&-+"
+   * is the range "&'()*+".
+   */
+  if( parameterName.find_first_of( ".,:;!@#$%^&'()*+|<>?" ) != std::string::npos )
   {
     std::string hint = "The parameter \""
       + parameterName
@@ -310,11 +308,10 @@ ParameterFileParser
   }
 
   /** 5) Perform checks on the parameter values. */
-  itksys::RegularExpression reInvalidCharacters2( "[,;!@#$%&|<>?]" );
   for( unsigned int i = 0; i < parameterValues.size(); ++i )
   {
     /** For all entries some characters are not allowed. */
-    if( reInvalidCharacters2.find( parameterValues[ i ] ) )
+    if( parameterValues[ i ].find_first_of( ",;!@#$%&|<>?" ) != std::string::npos )
     {
       std::string hint = "The parameter value \""
         + parameterValues[ i ]
@@ -333,7 +330,7 @@ ParameterFileParser
   }
   else
   {
-    this->m_ParameterMap.insert( make_pair( parameterName, parameterValues ) );
+    this->m_ParameterMap[ parameterName ].swap( parameterValues );
   }
 
 } // end GetParameterFromLine()
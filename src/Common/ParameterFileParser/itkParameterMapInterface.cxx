@@ -18,6 +18,8 @@
 
 #include "itkParameterMapInterface.h"
 
+#include <cstdlib>
+
 namespace itk
 {
 
@@ -146,6 +148,39 @@ ParameterMapInterface
 } // end StringCast()
 
 
+/**
+ * **************** StringCast ***************
+ */
+
+bool
+ParameterMapInterface
+::StringCast( const std::string & parameterValue, double & casted ) const
+{
+  /** Like the string stream version, a cast succeeds when a number could
+   * be read from the start of the string.
+   */
+  const char * begin = parameterValue.c_str();
+  char *       end   = 0;
+  casted = std::strtod( begin, &end );
+  return end != begin;
+} // end StringCast()
+
+
+/**
+ * **************** StringCast ***************
+ */
+
+bool
+ParameterMapInterface
+::StringCast( const std::string & parameterValue, float & casted ) const
+{
+  double castedAsDouble = 0.0;
+  const bool success    = this->StringCast( parameterValue, castedAsDouble );
+  casted = static_cast< float >( castedAsDouble );
+  return success;
+} // end StringCast()
+
+
 /**
  * **************** ReadParameter ***************
  */
@@ -429,6 +429,14 @@ private:
    */
   bool StringCast( const std::string & parameterValue, std::string & casted ) const;
 
+  /** Provide specializations for floating point values, based on strtod,
+   * since string streams are slow for large vectors of values, like the
+   * TransformParameters of a B-spline transform.
+   */
+  bool StringCast( const std::string & parameterValue, double & casted ) const;
+
+  bool StringCast( const std::string & parameterValue, float & casted ) const;
+
 };
 
 } // end of namespace itk
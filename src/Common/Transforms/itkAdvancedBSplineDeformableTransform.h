@@ -174,6 +174,8 @@ public:
 
   typedef typename Superclass
     ::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename Superclass
+    ::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
   typedef typename Superclass::SpatialJacobianType SpatialJacobianType;
   typedef typename Superclass
     ::JacobianOfSpatialJacobianType JacobianOfSpatialJacobianType;
@@ -257,6 +259,17 @@ public:
     JacobianType & j,
     NonZeroJacobianIndicesType & nzji ) const;
 
+  /** Batch versions of TransformPoint() and GetJacobian(), see AdvancedTransform.
+   * The stack buffers for the weights are set up only once for all points.
+   */
+  virtual void TransformPoints( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints, OutputPointType * outputPoints ) const;
+
+  virtual void GetJacobians( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    ParametersValueType * jacobians,
+    unsigned long * nonZeroJacobianIndices ) const;
+
   /** Compute the inner product of the Jacobian with the moving image gradient.
    * The Jacobian is (partially) constructed inside this function, but not returned.
    */
@@ -266,6 +279,42 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** The nonzero Jacobian indices of a B-spline are a box in the grid. */
+  virtual bool GetHasNonZeroJacobianIndicesDescriptor( void ) const
+  { return true; }
+
+  /** Same as the above, with a compact description of the nonzero Jacobian indices. */
+  virtual void EvaluateCompactJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesDescriptorType & descriptor ) const;
+
+  /** Cache the support region start index and the 1D B-spline weights of a
+   * fixed array of points, see AdvancedTransform. The cache is released
+   * when the grid changes.
+   */
+  virtual bool PrecomputeJacobianStructure(
+    const InputPointType * points,
+    const SizeValueType numberOfPoints,
+    const SizeValueType maximumMemory );
+
+  virtual void ReleaseJacobianStructure( void );
+
+  virtual SizeValueType GetNumberOfPrecomputedJacobianStructures( void ) const
+  { return this->m_CachedInsideValidRegion.size(); }
+
+  virtual SizeValueType GetJacobianStructureMemoryUsage( void ) const;
+
+  virtual ModifiedTimeType GetJacobianStructureMTime( void ) const;
+
+  virtual void EvaluateCachedJacobianWithImageGradientProduct(
+    const SizeValueType pointIndex,
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -326,6 +375,21 @@ protected:
     NonZeroJacobianIndicesType & nonZeroJacobianIndices,
     const RegionType & supportRegion ) const;
 
+  /** Compute the offsets in the coefficient images of the control points of
+   * a support region, in the order of the weights. The grid has a border of
+   * SplineOrder control points around the image, so the support region of a
+   * point inside the valid region never leaves the grid, and the offsets
+   * follow from the offset table of the grid, without bounds checks.
+   */
+  virtual void ComputeSupportOffsets( const IndexType & supportIndex,
+    OffsetValueType * offsets ) const;
+
+  /** Copy the coefficients of a support region to a buffer of size
+   * SpaceDimension * NumberOfWeights, ordered by dimension and then by weight.
+   */
+  void CopySupportRegionCoefficients( const IndexType & supportIndex,
+    typename WeightsType::ValueType * coefficients ) const;
+
   typedef typename Superclass::JacobianImageType JacobianImageType;
   typedef typename Superclass::JacobianPixelType JacobianPixelType;
 
@@ -337,6 +401,18 @@ protected:
   std::vector< DerivativeWeightsFunctionPointer >                  m_DerivativeWeightsFunctions;
   std::vector< std::vector< SODerivativeWeightsFunctionPointer > > m_SODerivativeWeightsFunctions;
 
+  /** The Jacobian structure cache, filled by PrecomputeJacobianStructure().
+   * For point p, m_CachedSupportIndices[ p * SpaceDimension + d ] stores the
+   * start index of its support region and m_CachedWeights1D[ p * SpaceDimension
+   * * ( SplineOrder + 1 ) + ... ] its 1D weights, as computed by
+   * BSplineInterpolationWeightFunctionBase::Evaluate1DWeights().
+   */
+  typedef typename IndexType::IndexValueType IndexValueType;
+  std::vector< IndexValueType > m_CachedSupportIndices;
+  std::vector< double >         m_CachedWeights1D;
+  std::vector< unsigned char >  m_CachedInsideValidRegion;
+  TimeStamp                     m_JacobianStructureTimeStamp;
+
 private:
 
   AdvancedBSplineDeformableTransform( const Self & ); // purposely not implemented
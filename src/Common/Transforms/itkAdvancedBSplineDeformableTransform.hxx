@@ -131,8 +131,6 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
     }
   }
 
-  this->m_LastJacobianIndex = this->m_ValidRegion.GetIndex();
-
   // needed, there seems to be double functionality compared to base constructor
   this->UpdatePointIndexConversions();
 
@@ -197,6 +195,9 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 
     this->UpdateGridOffsetTable();
 
+    // The cached Jacobian structure is no longer valid
+    this->ReleaseJacobianStructure();
+
     //
     // If we are using the default parameters, update their size and set to identity.
     //
@@ -261,49 +262,50 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
   this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
 
-  // For each dimension, correlate coefficient with weights
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
-
   outputPoint.Fill( NumericTraits< ScalarType >::ZeroValue() );
 
-  /** Create iterators over the coefficient images. */
-  typedef ImageScanlineConstIterator< ImageType > IteratorType;
-  IteratorType      iterator[ SpaceDimension ];
-  unsigned long     counter = 0;
-  const PixelType * basePointer
-    = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
+  /** Get the offsets of the control points of the support region. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  OffsetValueType     offsets[ numberOfWeights ];
+  this->ComputeSupportOffsets( supportIndex, offsets );
 
-  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  /** With interleaved coefficients, the coefficients of all dimensions of
+   * a control point are read from one array.
+   */
+  if( !this->m_InterleavedCoefficients.empty() )
   {
-    iterator[ j ] = IteratorType( this->m_CoefficientImages[ j ], supportRegion );
+    const unsigned int stride      = Superclass::InterleavedCoefficientsStride;
+    const PixelType *  interleaved = &( this->m_InterleavedCoefficients[ 0 ] );
+    for( unsigned long k = 0; k < numberOfWeights; ++k )
+    {
+      const PixelType * coefficient = interleaved + offsets[ k ] * stride;
+      indices[ k ] = offsets[ k ];
+      for( unsigned int j = 0; j < SpaceDimension; j++ )
+      {
+        outputPoint[ j ] += static_cast< ScalarType >( weights[ k ] * coefficient[ j ] );
+      }
+    }
   }
-
-  /** Loop over the support region. */
-  while( !iterator[ 0 ].IsAtEnd() )
+  else
   {
-    while( !iterator[ 0 ].IsAtEndOfLine() )
+    const PixelType * coefficients[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; j++ )
+    {
+      coefficients[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer();
+    }
+    for( unsigned long k = 0; k < numberOfWeights; ++k )
     {
       // populate the indices array
-      indices[ counter ] = &( iterator[ 0 ].Value() ) - basePointer;
+      indices[ k ] = offsets[ k ];
 
       // multiply weight with coefficient to compute displacement
       for( unsigned int j = 0; j < SpaceDimension; j++ )
       {
         outputPoint[ j ] += static_cast< ScalarType >(
-          weights[ counter ] * iterator[ j ].Value() );
-        ++iterator[ j ];
+          weights[ k ] * coefficients[ j ][ offsets[ k ] ] );
       }
-      ++counter;
-    } // end of scanline
-
-    for( unsigned int j = 0; j < SpaceDimension; j++ )
-    {
-      iterator[ j ].NextLine();
     }
-
-  } // end while
+  }
 
   // The output point is the start point + displacement.
   for( unsigned int j = 0; j < SpaceDimension; j++ )
@@ -443,6 +445,106 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end GetJacobian()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  /** Allocate memory on the stack, once for all points. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  typename ParameterIndexArrayType::ValueType indicesArray[ numberOfWeights ];
+  WeightsType             weights( weightsArray, numberOfWeights, false );
+  ParameterIndexArrayType indices( indicesArray, numberOfWeights, false );
+  bool                    inside;
+
+  /** Call the implementation that takes the buffers for each point. */
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    this->TransformPoint( inputPoints[ p ], outputPoints[ p ],
+      weights, indices, inside );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* GetJacobians ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::GetJacobians(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  ParametersValueType * jacobians,
+  unsigned long * nonZeroJacobianIndices ) const
+{
+  /** Sanity check. */
+  if( this->m_InputParametersPointer == NULL )
+  {
+    itkExceptionMacro( << "Cannot compute Jacobian: parameters not set" );
+  }
+
+  /** Sizes and buffers that are shared by all points. */
+  const unsigned long          numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  const NumberOfParametersType nnzji           = this->GetNumberOfNonZeroJacobianIndices();
+  const SizeValueType          jacobianSize    = SpaceDimension * nnzji;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  WeightsType                weights( weightsArray, numberOfWeights, false );
+  NonZeroJacobianIndicesType nzji( nnzji );
+  ContinuousIndexType        cindex;
+  IndexType                  supportIndex;
+  RegionType                 supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    ParametersValueType * jacobianPointer = jacobians + p * jacobianSize;
+    unsigned long *       nzjiPointer     = nonZeroJacobianIndices + p * nnzji;
+    std::fill( jacobianPointer, jacobianPointer + jacobianSize, 0.0 );
+
+    /** NOTE: if the support region does not lie totally within the grid
+     * we assume zero displacement and zero Jacobian.
+     */
+    this->TransformPointToContinuousGridIndex( inputPoints[ p ], cindex );
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      for( NumberOfParametersType i = 0; i < nnzji; ++i )
+      {
+        nzjiPointer[ i ] = i;
+      }
+      continue;
+    }
+
+    /** Compute the weights. */
+    this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
+    this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+
+    /** Put at the right positions. */
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      unsigned long offset = d * SpaceDimension * numberOfWeights + d * numberOfWeights;
+      std::copy( weightsArray, weightsArray + numberOfWeights, jacobianPointer + offset );
+    }
+
+    /** Compute the nonzero Jacobian indices. */
+    supportRegion.SetIndex( supportIndex );
+    this->ComputeNonZeroJacobianIndices( nzji, supportRegion );
+    std::copy( nzji.begin(), nzji.end(), nzjiPointer );
+  }
+
+} // end GetJacobians()
+
+
 /**
  * ********************* EvaluateJacobianAndImageGradientProduct ****************************
  */
@@ -517,6 +619,258 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* EvaluateCompactJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::EvaluateCompactJacobianWithImageGradientProduct(
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesDescriptorType & descriptor ) const
+{
+  /** Convert the physical point to a continuous index. */
+  ContinuousIndexType cindex;
+  this->TransformPointToContinuousGridIndex( ipp, cindex );
+
+  /** Get sizes. */
+  const NumberOfParametersType nnzji             = this->GetNumberOfNonZeroJacobianIndices();
+  const NumberOfParametersType nnzjiPerDimension = nnzji / SpaceDimension;
+
+  /** Outside the valid region the Jacobian is zero. Describe the indices
+   * 0 to nnzji - 1, like EvaluateJacobianWithImageGradientProduct() does.
+   */
+  if( !this->InsideValidRegion( cindex ) )
+  {
+    descriptor.m_Start                  = 0;
+    descriptor.m_ParametersPerDimension = nnzjiPerDimension;
+    unsigned long stride = 1;
+    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    {
+      descriptor.m_SupportSize[ i ] = this->m_SupportSize[ i ];
+      descriptor.m_Strides[ i ]     = stride;
+      stride                       *= this->m_SupportSize[ i ];
+    }
+    imageJacobian.Fill( 0.0 );
+    return;
+  }
+
+  /** Compute the B-spline weights on the stack. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  WeightsType weights( weightsArray, numberOfWeights, false );
+
+  IndexType supportIndex;
+  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
+  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+
+  /** Compute the inner product. */
+  NumberOfParametersType counter = 0;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    const MovingImageGradientValueType mig = movingImageGradient[ d ];
+    for( NumberOfParametersType i = 0; i < nnzjiPerDimension; ++i )
+    {
+      imageJacobian[ counter ] = weightsArray[ i ] * mig;
+      ++counter;
+    }
+  }
+
+  /** Describe the support region in the grid, as ComputeNonZeroJacobianIndices() does. */
+  descriptor.m_Start                  = 0;
+  descriptor.m_ParametersPerDimension = this->GetNumberOfParametersPerDimension();
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    descriptor.m_Start           += supportIndex[ i ] * this->m_GridOffsetTable[ i ];
+    descriptor.m_SupportSize[ i ] = this->m_SupportSize[ i ];
+    descriptor.m_Strides[ i ]     = this->m_GridOffsetTable[ i ];
+  }
+
+} // end EvaluateCompactJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* PrecomputeJacobianStructure ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+bool
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::PrecomputeJacobianStructure(
+  const InputPointType * points,
+  const SizeValueType numberOfPoints,
+  const SizeValueType maximumMemory )
+{
+  this->ReleaseJacobianStructure();
+
+  /** Check the memory budget. */
+  const SizeValueType numberOfWeights1D = SpaceDimension * ( SplineOrder + 1 );
+  const SizeValueType bytesPerPoint     = SpaceDimension * sizeof( IndexValueType )
+    + numberOfWeights1D * sizeof( double ) + sizeof( unsigned char );
+  if( numberOfPoints == 0 || numberOfPoints * bytesPerPoint > maximumMemory )
+  {
+    return false;
+  }
+
+  this->m_CachedSupportIndices.resize( numberOfPoints * SpaceDimension, 0 );
+  this->m_CachedWeights1D.resize( numberOfPoints * numberOfWeights1D, 0.0 );
+  this->m_CachedInsideValidRegion.resize( numberOfPoints, 0 );
+
+  /** Compute the support index and 1D weights of all points. */
+  ContinuousIndexType cindex;
+  IndexType           supportIndex;
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    this->TransformPointToContinuousGridIndex( points[ p ], cindex );
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      continue;
+    }
+
+    this->m_CachedInsideValidRegion[ p ] = 1;
+    this->m_WeightsFunction->Evaluate1DWeights( cindex, supportIndex,
+      &( this->m_CachedWeights1D[ p * numberOfWeights1D ] ) );
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      this->m_CachedSupportIndices[ p * SpaceDimension + d ] = supportIndex[ d ];
+    }
+  }
+
+  this->m_JacobianStructureTimeStamp.Modified();
+  return true;
+
+} // end PrecomputeJacobianStructure()
+
+
+/**
+ * ********************* ReleaseJacobianStructure ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ReleaseJacobianStructure( void )
+{
+  /** Swap with empty vectors to really free the memory. */
+  std::vector< IndexValueType >().swap( this->m_CachedSupportIndices );
+  std::vector< double >().swap( this->m_CachedWeights1D );
+  std::vector< unsigned char >().swap( this->m_CachedInsideValidRegion );
+
+} // end ReleaseJacobianStructure()
+
+
+/**
+ * ********************* GetJacobianStructureMemoryUsage ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+SizeValueType
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::GetJacobianStructureMemoryUsage( void ) const
+{
+  return this->m_CachedSupportIndices.capacity() * sizeof( IndexValueType )
+         + this->m_CachedWeights1D.capacity() * sizeof( double )
+         + this->m_CachedInsideValidRegion.capacity() * sizeof( unsigned char );
+
+} // end GetJacobianStructureMemoryUsage()
+
+
+/**
+ * ********************* GetJacobianStructureMTime ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+ModifiedTimeType
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::GetJacobianStructureMTime( void ) const
+{
+  if( this->m_CachedInsideValidRegion.empty() )
+  {
+    return 0;
+  }
+  return this->m_JacobianStructureTimeStamp.GetMTime();
+
+} // end GetJacobianStructureMTime()
+
+
+/**
+ * ********************* EvaluateCachedJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::EvaluateCachedJacobianWithImageGradientProduct(
+  const SizeValueType pointIndex,
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** Fall back to the normal computation for points outside the cache. */
+  if( pointIndex >= this->m_CachedInsideValidRegion.size() )
+  {
+    this->EvaluateJacobianWithImageGradientProduct(
+      ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+    return;
+  }
+
+  /** Get sizes. */
+  const NumberOfParametersType nnzji             = this->GetNumberOfNonZeroJacobianIndices();
+  const NumberOfParametersType nnzjiPerDimension = nnzji / SpaceDimension;
+
+  /** NOTE: if the support region does not lie totally within the grid
+   * we assume zero displacement and zero Jacobian.
+   */
+  if( !this->m_CachedInsideValidRegion[ pointIndex ] )
+  {
+    nonZeroJacobianIndices.resize( nnzji );
+    for( NumberOfParametersType i = 0; i < nnzji; ++i )
+    {
+      nonZeroJacobianIndices[ i ] = i;
+    }
+    imageJacobian.Fill( 0.0 );
+    return;
+  }
+
+  /** Compute the B-spline weights from the cached 1D weights. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  this->m_WeightsFunction->EvaluateFromOneDWeights(
+    &( this->m_CachedWeights1D[ pointIndex * SpaceDimension * ( SplineOrder + 1 ) ] ),
+    weightsArray );
+
+  /** Compute the inner product. */
+  NumberOfParametersType counter = 0;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    const MovingImageGradientValueType mig = movingImageGradient[ d ];
+    for( NumberOfParametersType i = 0; i < nnzjiPerDimension; ++i )
+    {
+      imageJacobian[ counter ] = weightsArray[ i ] * mig;
+      ++counter;
+    }
+  }
+
+  /** Setup support region needed for the nonZeroJacobianIndices. */
+  IndexType supportIndex;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    supportIndex[ d ] = this->m_CachedSupportIndices[ pointIndex * SpaceDimension + d ];
+  }
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+  supportRegion.SetIndex( supportIndex );
+
+  /** Compute the nonzero Jacobian indices. */
+  this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+
+} // end EvaluateCachedJacobianWithImageGradientProduct()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -555,28 +909,9 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   IndexType supportIndex;
   this->m_DerivativeWeightsFunctions[ 0 ]->ComputeStartIndex(
     cindex, supportIndex );
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
 
   /** Copy values from coefficient image to linear coeffs array. */
-  typedef ImageScanlineConstIterator< ImageType > IteratorType;
-  typename WeightsType::iterator itCoeffsLinear = coeffs.begin();
-  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-  {
-    IteratorType itCoef( this->m_CoefficientImages[ dim ], supportRegion );
-
-    while( !itCoef.IsAtEnd() )
-    {
-      while( !itCoef.IsAtEndOfLine() )
-      {
-        ( *itCoeffsLinear ) = itCoef.Value();
-        ++itCoeffsLinear;
-        ++itCoef;
-      }
-      itCoef.NextLine();
-    }
-  }
+  this->CopySupportRegionCoefficients( supportIndex, coeffArray );
 
   /** Compute the spatial Jacobian sj:
    *    dT_{dim} / dx_i = delta_{dim,i} + \sum coefs_{dim} * weights * PointToGridIndex.
@@ -666,29 +1001,9 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   IndexType supportIndex;
   this->m_SODerivativeWeightsFunctions[ 0 ][ 0 ]->ComputeStartIndex(
     cindex, supportIndex );
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
 
   /** Copy values from coefficient image to linear coeffs array. */
-  typedef ImageScanlineConstIterator< ImageType > IteratorType;
-  typename WeightsType::iterator itCoeffsLinear = coeffs.begin();
-  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-  {
-    IteratorType itCoef( this->m_CoefficientImages[ dim ], supportRegion );
-
-    //for( unsigned int mu = 0; mu < numberOfWeights; ++mu )
-    while( !itCoef.IsAtEnd() )
-    {
-      while( !itCoef.IsAtEndOfLine() )
-      {
-        ( *itCoeffsLinear ) = itCoef.Value();
-        ++itCoeffsLinear;
-        ++itCoef;
-      }
-      itCoef.NextLine();
-    }
-  }
+  this->CopySupportRegionCoefficients( supportIndex, coeffArray );
 
   /** For all derivative directions, compute the spatial Hessian.
    * The derivatives are d^2T / dx_i dx_j.
@@ -818,25 +1133,32 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   } // end for i
 
   /** Compute the Jacobian of the spatial Jacobian jsj:
-   *    d/dmu dT_{dim} / dx_i = weights.
+   *    d/dmu dT_{dim} / dx_i = weights,
+   * and take into account grid spacing and direction cosines. Only row dim
+   * of the matrix of a parameter of dimension dim is non-zero, and it is the
+   * same row for all dimensions, so that row is multiplied once per weight,
+   * instead of multiplying all matrices.
    */
-  SpatialJacobianType * basepointer = &jsj[ 0 ];
+  const double * dc = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
   for( unsigned int mu = 0; mu < numberOfWeights; ++mu )
   {
-    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    double row[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
     {
-      double tmp = *( weightVector + i * numberOfWeights + mu );
-      for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+      row[ j ] = 0.0;
+      for( unsigned int i = 0; i < SpaceDimension; ++i )
       {
-        ( *( basepointer + dim * numberOfWeights + mu ) )( dim, i ) = tmp;
+        row[ j ] += weightVector[ i * numberOfWeights + mu ] * dc[ i * SpaceDimension + j ];
+      }
+    }
+    for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+    {
+      SpatialJacobianType & matrix = jsj[ dim * numberOfWeights + mu ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        matrix( dim, j ) = row[ j ];
       }
     }
-  }
-
-  /** Take into account grid spacing and direction cosines */
-  for( unsigned int i = 0; i < jsj.size(); ++i )
-  {
-    jsj[ i ] = jsj[ i ] * this->m_PointToIndexMatrix2;
   }
 
   /** Compute the nonzero Jacobian indices. */
@@ -909,24 +1231,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   WeightsType      coeffs( coeffArray, numberOfWeights * SpaceDimension, false );
 
   /** Copy values from coefficient image to linear coeffs array. */
-  // takes considerable amount of time : 27% of this function. // with old region iterator, check with new
-  typedef ImageScanlineConstIterator< ImageType > IteratorType;
-  typename WeightsType::iterator itCoeffsLinear = coeffs.begin();
-  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-  {
-    IteratorType itCoef( this->m_CoefficientImages[ dim ], supportRegion );
-
-    while( !itCoef.IsAtEnd() )
-    {
-      while( !itCoef.IsAtEndOfLine() )
-      {
-        ( *itCoeffsLinear ) = itCoef.Value();
-        ++itCoeffsLinear;
-        ++itCoef;
-      }
-      itCoef.NextLine();
-    }
-  }
+  this->CopySupportRegionCoefficients( supportIndex, coeffArray );
 
   /** On the stack instead of heap is faster. */
   const unsigned int d = SpaceDimension * ( SpaceDimension + 1 ) / 2;
@@ -984,25 +1289,32 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   }
 
   /** Compute the Jacobian of the spatial Jacobian jsj:
-   *    d/dmu dT_{dim} / dx_i = weights.
+   *    d/dmu dT_{dim} / dx_i = weights,
+   * and take into account grid spacing and direction cosines. Only row dim
+   * of the matrix of a parameter of dimension dim is non-zero, and it is the
+   * same row for all dimensions, so that row is multiplied once per weight,
+   * instead of multiplying all matrices.
    */
-  SpatialJacobianType * basepointer = &jsj[ 0 ];
+  const double * dc = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
   for( unsigned int mu = 0; mu < numberOfWeights; ++mu )
   {
-    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    double row[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
     {
-      const double tmp = *( weightVector + i * numberOfWeights + mu );
-      for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+      row[ j ] = 0.0;
+      for( unsigned int i = 0; i < SpaceDimension; ++i )
       {
-        ( *( basepointer + dim * numberOfWeights + mu ) )( dim, i ) = tmp;
+        row[ j ] += weightVector[ i * numberOfWeights + mu ] * dc[ i * SpaceDimension + j ];
+      }
+    }
+    for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+    {
+      SpatialJacobianType & matrix = jsj[ dim * numberOfWeights + mu ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        matrix( dim, j ) = row[ j ];
       }
     }
-  }
-
-  /** Take into account grid spacing and direction cosines */
-  for( unsigned int i = 0; i < jsj.size(); ++i )
-  {
-    jsj[ i ] = jsj[ i ] * this->m_PointToIndexMatrix2;
   }
 
   /** Compute the nonzero Jacobian indices. */
@@ -1077,9 +1389,9 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
    * Make use of the fact that the Hessian is symmetrical, so do not compute
    * both i,j and j,i for i != j.
    */
-  const unsigned int           d = SpaceDimension * ( SpaceDimension + 1 ) / 2;
-  FixedArray< WeightsType, d > weightVector;
-  unsigned int                 count = 0;
+  const unsigned int d = SpaceDimension * ( SpaceDimension + 1 ) / 2;
+  double             weightVector[ d * numberOfWeights ];
+  unsigned int       count = 0;
   for( unsigned int i = 0; i < SpaceDimension; ++i )
   {
     for( unsigned int j = 0; j <= i; ++j )
@@ -1087,23 +1399,24 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
       /** Compute the derivative weights. */
       this->m_SODerivativeWeightsFunctions[ i ][ j ]->Evaluate( cindex, supportIndex, weights );
 
-      /** Remember the weights. */
-      weightVector[ count ] = weights;
+      /** Remember the weights, on the stack. */
+      std::copy( weights.data_block(), weights.data_block() + numberOfWeights,
+        weightVector + count * numberOfWeights );
       ++count;
 
     } // end for j
   }   // end for i
 
   /** Compute d/dmu d^2T_{dim} / dx_i dx_j = weights. */
+  SpatialJacobianType matrix;
   for( unsigned int mu = 0; mu < numberOfWeights; ++mu )
   {
-    SpatialJacobianType matrix;
-    unsigned int        count = 0;
+    unsigned int count = 0;
     for( unsigned int i = 0; i < SpaceDimension; ++i )
     {
       for( unsigned int j = 0; j <= i; ++j )
       {
-        double tmp = weightVector[ count ][ mu ];
+        const double tmp = weightVector[ count * numberOfWeights + mu ];
         matrix[ i ][ j ] = tmp;
         if( i != j ) { matrix[ j ][ i ] = tmp; }
         ++count;
@@ -1111,8 +1424,21 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
     }
 
     /** Take into account grid spacing and direction matrix. */
-    matrix = this->m_PointToIndexMatrixTransposed2
-      * ( matrix * this->m_PointToIndexMatrix2 );
+    if( !this->m_PointToIndexMatrixIsDiagonal )
+    {
+      matrix = this->m_PointToIndexMatrixTransposed2
+        * ( matrix * this->m_PointToIndexMatrix2 );
+    }
+    else
+    {
+      for( unsigned int i = 0; i < SpaceDimension; ++i )
+      {
+        for( unsigned int j = 0; j < SpaceDimension; ++j )
+        {
+          matrix[ i ][ j ] *= this->m_PointToIndexMatrixDiagonalProducts[ i + SpaceDimension * j ];
+        }
+      }
+    }
 
     /** Copy the matrix to the right locations. */
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
@@ -1199,24 +1525,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   WeightsType      coeffs( coeffArray, numberOfWeights * SpaceDimension, false );
 
   /** Copy values from coefficient image to linear coeffs array. */
-  // takes considerable amount of time : 27% of this function. // with old region iterator, check with new
-  typedef ImageScanlineConstIterator< ImageType > IteratorType;
-  typename WeightsType::iterator itCoeffsLinear = coeffs.begin();
-  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-  {
-    IteratorType itCoef( this->m_CoefficientImages[ dim ], supportRegion );
-
-    while( !itCoef.IsAtEnd() )
-    {
-      while( !itCoef.IsAtEndOfLine() )
-      {
-        ( *itCoeffsLinear ) = itCoef.Value();
-        ++itCoeffsLinear;
-        ++itCoef;
-      }
-      itCoef.NextLine();
-    }
-  }
+  this->CopySupportRegionCoefficients( supportIndex, coeffArray );
 
   /** On the stack instead of heap is faster. */
   const unsigned int d = SpaceDimension * ( SpaceDimension + 1 ) / 2;
@@ -1455,6 +1764,88 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end ComputeNonZeroJacobianIndices()
 
 
+/**
+ * ********************* ComputeSupportOffsets ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeSupportOffsets(
+  const IndexType & supportIndex,
+  OffsetValueType * offsets ) const
+{
+  /** The offset of the first control point of the support region. */
+  OffsetValueType offset = 0;
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    offset += supportIndex[ j ] * this->m_GridOffsetTable[ j ];
+  }
+
+  /** The jumps of the offset at the end of a row, plane, etc. of the
+   * support region.
+   */
+  OffsetValueType jump[ SpaceDimension ];
+  jump[ 0 ] = this->m_GridOffsetTable[ 0 ];
+  for( unsigned int j = 1; j < SpaceDimension; ++j )
+  {
+    jump[ j ] = this->m_GridOffsetTable[ j ]
+      - static_cast< OffsetValueType >( this->m_SupportSize[ j - 1 ] )
+      * this->m_GridOffsetTable[ j - 1 ];
+  }
+
+  /** Loop over the support region. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  SizeValueType       position[ SpaceDimension ];
+  std::fill( position, position + SpaceDimension, 0 );
+  for( unsigned long k = 0; k < numberOfWeights; ++k )
+  {
+    offsets[ k ] = offset;
+
+    /** Go to the next control point of the support region. */
+    offset += jump[ 0 ];
+    for( unsigned int j = 0; j < SpaceDimension - 1; ++j )
+    {
+      if( ++position[ j ] < this->m_SupportSize[ j ] )
+      {
+        break;
+      }
+      position[ j ] = 0;
+      offset       += jump[ j + 1 ];
+    }
+  }
+
+} // end ComputeSupportOffsets()
+
+
+/**
+ * ********************* CopySupportRegionCoefficients ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::CopySupportRegionCoefficients(
+  const IndexType & supportIndex,
+  typename WeightsType::ValueType * coefficients ) const
+{
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  OffsetValueType     offsets[ numberOfWeights ];
+  this->ComputeSupportOffsets( supportIndex, offsets );
+
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    const PixelType * basePointer = this->m_CoefficientImages[ dim ]->GetBufferPointer();
+    for( unsigned long k = 0; k < numberOfWeights; ++k )
+    {
+      *coefficients = basePointer[ offsets[ k ] ];
+      ++coefficients;
+    }
+  }
+
+} // end CopySupportRegionCoefficients()
+
+
 /**
  * ********************* PrintSelf ****************************
  */
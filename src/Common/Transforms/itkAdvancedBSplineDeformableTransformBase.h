@@ -22,6 +22,8 @@
 #include "itkImage.h"
 #include "itkImageRegion.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -79,6 +81,8 @@ public:
 
   typedef typename Superclass
     ::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename Superclass
+    ::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
   typedef typename Superclass::SpatialJacobianType SpatialJacobianType;
   typedef typename Superclass
     ::JacobianOfSpatialJacobianType JacobianOfSpatialJacobianType;
@@ -183,6 +187,31 @@ public:
    */
   virtual void SetCoefficientImages( ImagePointer images[] );
 
+  /** The number of values per control point in the interleaved coefficients:
+   * SpaceDimension, padded to 4 for SpaceDimension 3, so that the
+   * coefficients of a control point are aligned to a SIMD register. */
+  itkStaticConstMacro( InterleavedCoefficientsStride, unsigned int,
+    NDimensions == 3 ? 4 : NDimensions );
+
+  /** Select an interleaved copy of the coefficients, with the coefficients
+   * of all dimensions of a control point next to each other. A point then
+   * reads its support region from one array instead of SpaceDimension arrays,
+   * which touches a SpaceDimension-th of the cache lines. The coefficient of
+   * dimension d at grid offset i is stored at
+   * i * InterleavedCoefficientsStride + d; it is parameter
+   * d * GetNumberOfParametersPerDimension() + i.
+   *
+   * The copy is made by SetParameters(), SetParametersByValue(),
+   * SetCoefficientImages() and SetIdentity(). Parameters that are changed in
+   * place after these calls are therefore not seen by TransformPoint(). The
+   * copy is used by the TransformPoint() and TransformPoints() functions of
+   * the AdvancedBSplineDeformableTransform and the RecursiveBSplineTransform.
+   * Default: false.
+   */
+  virtual void SetUseInterleavedCoefficients( bool _arg );
+  itkGetConstMacro( UseInterleavedCoefficients, bool );
+  itkBooleanMacro( UseInterleavedCoefficients );
+
   /** Typedefs for specifying the extend to the grid. */
   typedef ImageRegion< itkGetStaticConstMacro( SpaceDimension ) > RegionType;
 
@@ -267,6 +296,9 @@ public:
    */
   virtual bool IsLinear( void ) const { return false; }
 
+  /** The displacement is a weighted sum of the coefficients. */
+  virtual bool GetIsLinearInParameters( void ) const { return true; }
+
   /** Indicates the category transform.
    *  e.g. an affine transform, or a local one, e.g. a deformation field.
    */
@@ -351,11 +383,6 @@ protected:
 
   typename JacobianImageType::Pointer m_JacobianImage[ NDimensions ];
 
-  /** Keep track of last support region used in computing the Jacobian
-  * for fast resetting of Jacobian to zero.
-  */
-  mutable IndexType m_LastJacobianIndex;
-
   /** Array holding images wrapped from the flat parameters. */
   ImagePointer m_WrappedImage[ NDimensions ];
 
@@ -364,6 +391,14 @@ protected:
 
   void UpdateGridOffsetTable( void );
 
+  /** Copy the coefficient images to m_InterleavedCoefficients, if
+   * UseInterleavedCoefficients is on; free it otherwise. */
+  void UpdateInterleavedCoefficients( void );
+
+  /** The interleaved coefficients, see SetUseInterleavedCoefficients(). */
+  bool                     m_UseInterleavedCoefficients;
+  std::vector< PixelType > m_InterleavedCoefficients;
+
 private:
 
   AdvancedBSplineDeformableTransformBase( const Self & ); // purposely not implemented
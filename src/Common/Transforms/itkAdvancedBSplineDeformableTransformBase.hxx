@@ -48,6 +48,8 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
   // Make sure the parameters pointer is not NULL after construction.
   this->m_InputParametersPointer = &( this->m_InternalParametersBuffer );
 
+  this->m_UseInterleavedCoefficients = false;
+
   // Initialize coeffient images
   for( unsigned int j = 0; j < SpaceDimension; j++ )
   {
@@ -94,8 +96,6 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
   }
 
   this->UpdatePointIndexConversions();
-
-  this->m_LastJacobianIndex = this->m_ValidRegion.GetIndex();
 }
 
 
@@ -211,6 +211,9 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
       this->m_WrappedImage[ j ]->SetSpacing( this->m_GridSpacing.GetDataPointer() );
     }
 
+    // The cached Jacobian structure is no longer valid
+    this->ReleaseJacobianStructure();
+
     this->UpdatePointIndexConversions();
 
     this->Modified();
@@ -234,6 +237,9 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
       this->m_WrappedImage[ j ]->SetDirection( this->m_GridDirection );
     }
 
+    // The cached Jacobian structure is no longer valid
+    this->ReleaseJacobianStructure();
+
     this->UpdatePointIndexConversions();
 
     this->Modified();
@@ -258,6 +264,9 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
       this->m_WrappedImage[ j ]->SetOrigin( this->m_GridOrigin.GetDataPointer() );
     }
 
+    // The cached Jacobian structure is no longer valid
+    this->ReleaseJacobianStructure();
+
     this->Modified();
   }
 
@@ -275,6 +284,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     ParametersType * parameters
       = const_cast< ParametersType * >( this->m_InputParametersPointer );
     parameters->Fill( 0.0 );
+    this->UpdateInterleavedCoefficients();
     this->Modified();
   }
   else
@@ -310,6 +320,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
 
   // Wrap flat array as images of coefficients
   this->WrapAsImages();
+  this->UpdateInterleavedCoefficients();
 
   // Modified is always called since we just have a pointer to the
   // parameters and cannot know if the parameters have changed.
@@ -453,6 +464,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
 
   // wrap flat array as images of coefficients
   this->WrapAsImages();
+  this->UpdateInterleavedCoefficients();
 
   // Modified is always called since we just have a pointer to the
   // parameters and cannot know if the parameters have changed.
@@ -537,8 +549,53 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     this->m_InternalParametersBuffer = ParametersType( 0 );
     this->m_InputParametersPointer   = NULL;
 
+    this->UpdateInterleavedCoefficients();
+  }
+
+}
+
+
+// Select the interleaved coefficients
+template< class TScalarType, unsigned int NDimensions >
+void
+AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
+::SetUseInterleavedCoefficients( bool _arg )
+{
+  if( this->m_UseInterleavedCoefficients != _arg )
+  {
+    this->m_UseInterleavedCoefficients = _arg;
+    this->UpdateInterleavedCoefficients();
+    this->Modified();
+  }
+}
+
+
+// Copy the coefficients to the interleaved layout
+template< class TScalarType, unsigned int NDimensions >
+void
+AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
+::UpdateInterleavedCoefficients( void )
+{
+  if( !this->m_UseInterleavedCoefficients || !this->m_CoefficientImages[ 0 ] )
+  {
+    std::vector< PixelType >().swap( this->m_InterleavedCoefficients );
+    return;
   }
 
+  /** The padding values stay zero. */
+  const unsigned int  stride         = InterleavedCoefficientsStride;
+  const SizeValueType numberOfPixels
+    = this->m_CoefficientImages[ 0 ]->GetBufferedRegion().GetNumberOfPixels();
+  this->m_InterleavedCoefficients.assign( numberOfPixels * stride, 0.0 );
+  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  {
+    const PixelType * coefficients = this->m_CoefficientImages[ j ]->GetBufferPointer();
+    PixelType *       interleaved  = &( this->m_InterleavedCoefficients[ j ] );
+    for( SizeValueType i = 0; i < numberOfPixels; ++i, interleaved += stride )
+    {
+      *interleaved = coefficients[ i ];
+    }
+  }
 }
 
 
@@ -568,6 +625,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
   }
   os << " ]" << std::endl;
 
+  os << indent << "UseInterleavedCoefficients: " << this->m_UseInterleavedCoefficients << std::endl;
   os << indent << "WrappedImage: [ " << this->m_WrappedImage[ 0 ].GetPointer();
   for( unsigned int j = 1; j < SpaceDimension; j++ )
   {
@@ -578,7 +636,6 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
   os << indent << "InputParametersPointer: "
      << this->m_InputParametersPointer << std::endl;
   os << indent << "ValidRegion: " << this->m_ValidRegion << std::endl;
-  os << indent << "LastJacobianIndex: " << this->m_LastJacobianIndex << std::endl;
 }
 
 
@@ -589,16 +646,14 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
 ::InsideValidRegion(
   const ContinuousIndexType & index ) const
 {
+  /** Check if index can be evaluated given the current grid. The tests of
+   * all dimensions are combined without branches, as one bounding box test.
+   */
   bool inside = true;
-
-  /** Check if index can be evaluated given the current grid. */
   for( unsigned int j = 0; j < SpaceDimension; j++ )
   {
-    if( index[ j ] < this->m_ValidRegionBegin[ j ] || index[ j ] >= this->m_ValidRegionEnd[ j ] )
-    {
-      inside = false;
-      break;
-    }
+    inside &= ( index[ j ] >= this->m_ValidRegionBegin[ j ] )
+      & ( index[ j ] < this->m_ValidRegionEnd[ j ] );
   }
 
   return inside;
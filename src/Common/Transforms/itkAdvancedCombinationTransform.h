@@ -91,6 +91,7 @@ public:
   typedef typename Superclass::InputPointType                InputPointType;
   typedef typename Superclass::OutputPointType               OutputPointType;
   typedef typename Superclass::NonZeroJacobianIndicesType    NonZeroJacobianIndicesType;
+  typedef typename Superclass::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
   typedef typename Superclass::SpatialJacobianType           SpatialJacobianType;
   typedef typename Superclass::JacobianOfSpatialJacobianType JacobianOfSpatialJacobianType;
   typedef typename Superclass::SpatialHessianType            SpatialHessianType;
@@ -159,6 +160,13 @@ public:
 
   itkGetConstMacro( UseAddition, bool );
 
+  /** Map a point with the initial transform, using the cached affine map
+   * when available. Public, so that a metric that evaluates the current
+   * transform itself can compose it with the initial transform.
+   */
+  inline InputPointType TransformPointWithInitialTransform(
+    const InputPointType & point ) const;
+
   /**  Method to transform a point. */
   virtual OutputPointType TransformPoint( const InputPointType  & point ) const;
 
@@ -246,6 +254,41 @@ public:
     JacobianType & j,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Batch versions of TransformPoint() and GetJacobian(). Without an initial
+   * transform these are forwarded to the batch functions of the current
+   * transform, otherwise the points are processed one by one.
+   */
+  virtual void TransformPoints( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints, OutputPointType * outputPoints ) const;
+
+  virtual void GetJacobians( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    ParametersValueType * jacobians,
+    unsigned long * nonZeroJacobianIndices ) const;
+
+  /** The Jacobian structure cache of the current transform is only used
+   * when there is no initial transform, since otherwise the current transform
+   * does not act on the given points. See AdvancedTransform.
+   */
+  virtual bool PrecomputeJacobianStructure( const InputPointType * points,
+    const SizeValueType numberOfPoints,
+    const SizeValueType maximumMemory );
+
+  virtual void ReleaseJacobianStructure( void );
+
+  virtual SizeValueType GetNumberOfPrecomputedJacobianStructures( void ) const;
+
+  virtual SizeValueType GetJacobianStructureMemoryUsage( void ) const;
+
+  virtual ModifiedTimeType GetJacobianStructureMTime( void ) const;
+
+  virtual void EvaluateCachedJacobianWithImageGradientProduct(
+    const SizeValueType pointIndex,
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
   /** Compute the inner product of the Jacobian with the moving image gradient. */
   virtual void EvaluateJacobianWithImageGradientProduct(
     const InputPointType & ipp,
@@ -253,6 +296,19 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** The compact nonzero Jacobian indices are those of the current transform. */
+  virtual bool GetHasNonZeroJacobianIndicesDescriptor( void ) const;
+
+  /** The initial transform has no parameters, so composition and addition
+   * are linear in the parameters when the current transform is. */
+  virtual bool GetIsLinearInParameters( void ) const;
+
+  virtual void EvaluateCompactJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesDescriptorType & descriptor ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -349,6 +405,26 @@ protected:
   /** Throw an exception. */
   virtual void NoCurrentTransformSet( void ) const throw ( ExceptionObject );
 
+  /** Cache the affine map of the initial transform when it is linear and
+   * composition is used. A chain of linear transforms, for example nested
+   * combination transforms, is thereby flattened into a single matrix and
+   * offset. The cache is updated when the transforms, the combination method
+   * or the parameters are set.
+   */
+  virtual void UpdateInitialTransformCache( void );
+
+  /** Get the spatial Jacobian of the initial transform, using the cached
+   * affine map when available.
+   */
+  inline void GetSpatialJacobianOfInitialTransform(
+    const InputPointType & ipp,
+    SpatialJacobianType & sj0 ) const;
+
+  /** The cached affine map of a linear initial transform. */
+  bool                m_InitialTransformIsAffine;
+  SpatialJacobianType m_InitialTransformMatrix;
+  OutputVectorType    m_InitialTransformOffset;
+
   /**  A pointer to one of the following functions:
    * - TransformPointUseAddition,
    * - TransformPointUseComposition,
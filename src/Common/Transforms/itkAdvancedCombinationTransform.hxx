@@ -19,6 +19,7 @@
 #define __itkAdvancedCombinationTransform_hxx
 
 #include "itkAdvancedCombinationTransform.h"
+#include <vector>
 
 namespace itk
 {
@@ -39,6 +40,11 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   this->m_UseAddition    = false;
   this->m_UseComposition = true;
 
+  /** No cached initial transform. */
+  this->m_InitialTransformIsAffine = false;
+  this->m_InitialTransformMatrix.SetIdentity();
+  this->m_InitialTransformOffset.Fill( 0.0 );
+
   /** Set everything to have no current transform. */
   this->m_SelectedTransformPointFunction
     = &Self::TransformPointNoCurrentTransform;
@@ -326,6 +332,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   {
     this->Modified();
     this->m_CurrentTransform->SetParameters( param );
+    this->UpdateInitialTransformCache();
   }
   else
   {
@@ -350,6 +357,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   {
     this->Modified();
     this->m_CurrentTransform->SetFixedParameters( param );
+    this->UpdateInitialTransformCache();
   }
   else
   {
@@ -374,6 +382,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   {
     this->Modified();
     this->m_CurrentTransform->SetParametersByValue( param );
+    this->UpdateInitialTransformCache();
   }
   else
   {
@@ -722,9 +731,95 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
       = &Self::GetJacobianOfSpatialHessianUseComposition;
   }
 
+  /** Flatten a linear initial transform. */
+  this->UpdateInitialTransformCache();
+
 } // end UpdateCombinationMethod()
 
 
+/**
+ * ****************** UpdateInitialTransformCache ********************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::UpdateInitialTransformCache( void )
+{
+  this->m_InitialTransformIsAffine = false;
+  if( this->m_SelectedTransformPointFunction != &Self::TransformPointUseComposition
+    || !this->m_InitialTransform->IsLinear() )
+  {
+    return;
+  }
+
+  /** A linear transform is fully described by its spatial Jacobian
+   * and the image of the origin.
+   */
+  InputPointType origin;
+  origin.Fill( 0.0 );
+  const OutputPointType transformedOrigin = this->m_InitialTransform->TransformPoint( origin );
+  this->m_InitialTransform->GetSpatialJacobian( origin, this->m_InitialTransformMatrix );
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    this->m_InitialTransformOffset[ i ] = transformedOrigin[ i ];
+  }
+  this->m_InitialTransformIsAffine = true;
+
+} // end UpdateInitialTransformCache()
+
+
+/**
+ * ************* TransformPointWithInitialTransform **********************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+typename AdvancedCombinationTransform< TScalarType, NDimensions >::InputPointType
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::TransformPointWithInitialTransform( const InputPointType & point ) const
+{
+  if( !this->m_InitialTransformIsAffine )
+  {
+    return this->m_InitialTransform->TransformPoint( point );
+  }
+
+  InputPointType out;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    out[ i ] = this->m_InitialTransformOffset[ i ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      out[ i ] += this->m_InitialTransformMatrix( i, j ) * point[ j ];
+    }
+  }
+  return out;
+
+} // end TransformPointWithInitialTransform()
+
+
+/**
+ * ************* GetSpatialJacobianOfInitialTransform **********************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetSpatialJacobianOfInitialTransform(
+  const InputPointType & ipp,
+  SpatialJacobianType & sj0 ) const
+{
+  if( this->m_InitialTransformIsAffine )
+  {
+    sj0 = this->m_InitialTransformMatrix;
+  }
+  else
+  {
+    this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  }
+
+} // end GetSpatialJacobianOfInitialTransform()
+
+
 /**
  * ************* NoCurrentTransformSet **********************
  */
@@ -798,7 +893,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 ::TransformPointUseComposition( const InputPointType & point ) const
 {
   return this->m_CurrentTransform->TransformPoint(
-    this->m_InitialTransform->TransformPoint( point ) );
+    this->TransformPointWithInitialTransform( point ) );
 
 } // end TransformPointUseComposition()
 
@@ -865,7 +960,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
   this->m_CurrentTransform->GetJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
+    this->TransformPointWithInitialTransform( ipp ),
     j, nonZeroJacobianIndices );
 
 } // end GetJacobianUseComposition()
@@ -939,7 +1034,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
   this->m_CurrentTransform->EvaluateJacobianWithImageGradientProduct(
-    this->m_InitialTransform->TransformPoint( ipp ),
+    this->TransformPointWithInitialTransform( ipp ),
     movingImageGradient, imageJacobian, nonZeroJacobianIndices );
 
 } // end EvaluateJacobianWithImageGradientProductUseComposition()
@@ -1015,9 +1110,9 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   SpatialJacobianType & sj ) const
 {
   SpatialJacobianType sj0, sj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ), sj1 );
+    this->TransformPointWithInitialTransform( ipp ), sj1 );
 
   sj = sj1 * sj0;
 
@@ -1098,14 +1193,12 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   /** Transform the input point. */
   // \todo this has already been computed and it is expensive.
   InputPointType transformedPoint
-    = this->m_InitialTransform->TransformPoint( ipp );
+    = this->TransformPointWithInitialTransform( ipp );
 
   /** Compute the (Jacobian of the) spatial Jacobian / Hessian of the
-   * internal transforms.
+   * internal transforms. An affine initial transform has no spatial Hessian.
    */
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
-  this->m_CurrentTransform->GetSpatialJacobian( transformedPoint, sj1 );
-  this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetSpatialHessian( transformedPoint, sh1 );
 
   typename SpatialJacobianType::InternalMatrixType sj0tvnl = sj0.GetTranspose();
@@ -1115,10 +1208,18 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
   {
     sh[ dim ] = sj0t * ( sh1[ dim ] * sj0 );
+  }
 
-    for( unsigned int p = 0; p < SpaceDimension; ++p )
+  if( !this->m_InitialTransformIsAffine )
+  {
+    this->m_CurrentTransform->GetSpatialJacobian( transformedPoint, sj1 );
+    this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
+    for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
-      sh[ dim ] += ( sh0[ p ] * sj1( dim, p ) );
+      for( unsigned int p = 0; p < SpaceDimension; ++p )
+      {
+        sh[ dim ] += ( sh0[ p ] * sj1( dim, p ) );
+      }
     }
   }
 
@@ -1207,17 +1308,19 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   JacobianOfSpatialJacobianType & jsj,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
-  SpatialJacobianType           sj0;
-  JacobianOfSpatialJacobianType jsj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  /** The Jacobian of the current transform is multiplied in place,
+   * which avoids allocating a temporary jsj for every point.
+   */
+  SpatialJacobianType sj0;
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
-    jsj1, nonZeroJacobianIndices );
+    this->TransformPointWithInitialTransform( ipp ),
+    jsj, nonZeroJacobianIndices );
 
   jsj.resize( nonZeroJacobianIndices.size() );
   for( unsigned int mu = 0; mu < nonZeroJacobianIndices.size(); ++mu )
   {
-    jsj[ mu ] = jsj1[ mu ] * sj0;
+    jsj[ mu ] = jsj[ mu ] * sj0;
   }
 
 } // end GetJacobianOfSpatialJacobianUseComposition()
@@ -1236,18 +1339,17 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   JacobianOfSpatialJacobianType & jsj,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
-  SpatialJacobianType           sj0, sj1;
-  JacobianOfSpatialJacobianType jsj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  SpatialJacobianType sj0, sj1;
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
-    sj1, jsj1, nonZeroJacobianIndices );
+    this->TransformPointWithInitialTransform( ipp ),
+    sj1, jsj, nonZeroJacobianIndices );
 
   sj = sj1 * sj0;
   jsj.resize( nonZeroJacobianIndices.size() );
   for( unsigned int mu = 0; mu < nonZeroJacobianIndices.size(); ++mu )
   {
-    jsj[ mu ] = jsj1[ mu ] * sj0;
+    jsj[ mu ] = jsj[ mu ] * sj0;
   }
 
 } // end GetJacobianOfSpatialJacobianUseComposition()
@@ -1380,24 +1482,19 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   SpatialJacobianType           sj0;
   SpatialHessianType            sh0;
   JacobianOfSpatialJacobianType jsj1;
-  JacobianOfSpatialHessianType  jsh1;
 
   /** Transform the input point. */
   // \todo: this has already been computed and it is expensive.
   InputPointType transformedPoint
-    = this->m_InitialTransform->TransformPoint( ipp );
+    = this->TransformPointWithInitialTransform( ipp );
 
   /** Compute the (Jacobian of the) spatial Jacobian / Hessian of the
-   * internal transforms. */
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
-  this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
-
-  /** Assume/demand that GetJacobianOfSpatialJacobian returns
-   * the same nonZeroJacobianIndices as the GetJacobianOfSpatialHessian. */
-  this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    transformedPoint, jsj1, nonZeroJacobianIndices );
+   * internal transforms. The Jacobian of the spatial Hessian of the current
+   * transform is written to jsh directly and multiplied in place.
+   */
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialHessian(
-    transformedPoint, jsh1, nonZeroJacobianIndices );
+    transformedPoint, jsh, nonZeroJacobianIndices );
 
   typename SpatialJacobianType::InternalMatrixType sj0tvnl = sj0.GetTranspose();
   SpatialJacobianType sj0t( sj0tvnl );
@@ -1409,12 +1506,20 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   {
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
-      jsh[ mu ][ dim ] = sj0t * ( jsh1[ mu ][ dim ] * sj0 );
+      jsh[ mu ][ dim ] = sj0t * ( jsh[ mu ][ dim ] * sj0 );
     }
   }
 
-  if( this->m_InitialTransform->GetHasNonZeroSpatialHessian() )
+  /** Only a nonlinear initial transform needs the Jacobian of the spatial
+   * Jacobian. Assume/demand that GetJacobianOfSpatialJacobian returns
+   * the same nonZeroJacobianIndices as the GetJacobianOfSpatialHessian.
+   */
+  if( !this->m_InitialTransformIsAffine
+    && this->m_InitialTransform->GetHasNonZeroSpatialHessian() )
   {
+    this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
+    this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
+      transformedPoint, jsj1, nonZeroJacobianIndices );
     for( unsigned int mu = 0; mu < nonZeroJacobianIndices.size(); ++mu )
     {
       for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
@@ -1447,26 +1552,19 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   SpatialJacobianType           sj0, sj1;
   SpatialHessianType            sh0, sh1;
   JacobianOfSpatialJacobianType jsj1;
-  JacobianOfSpatialHessianType  jsh1;
 
   /** Transform the input point. */
   // \todo this has already been computed and it is expensive.
   InputPointType transformedPoint
-    = this->m_InitialTransform->TransformPoint( ipp );
+    = this->TransformPointWithInitialTransform( ipp );
 
   /** Compute the (Jacobian of the) spatial Jacobian / Hessian of the
-   * internal transforms.
-   */
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
-  this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
-
-  /** Assume/demand that GetJacobianOfSpatialJacobian returns the same
-   * nonZeroJacobianIndices as the GetJacobianOfSpatialHessian.
+   * internal transforms. The Jacobian of the spatial Hessian of the current
+   * transform is written to jsh directly and multiplied in place.
    */
-  this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    transformedPoint, sj1, jsj1, nonZeroJacobianIndices );
+  this->GetSpatialJacobianOfInitialTransform( ipp, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialHessian(
-    transformedPoint, sh1, jsh1, nonZeroJacobianIndices );
+    transformedPoint, sh1, jsh, nonZeroJacobianIndices );
 
   typename SpatialJacobianType::InternalMatrixType sj0tvnl = sj0.GetTranspose();
   SpatialJacobianType sj0t( sj0tvnl );
@@ -1477,12 +1575,26 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   {
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
-      jsh[ mu ][ dim ] = sj0t * ( jsh1[ mu ][ dim ] * sj0 );
+      jsh[ mu ][ dim ] = sj0t * ( jsh[ mu ][ dim ] * sj0 );
     }
   }
 
-  if( this->m_InitialTransform->GetHasNonZeroSpatialHessian() )
+  /** Combine them in one overall spatial Hessian. */
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    sh[ dim ] = sj0t * ( sh1[ dim ] * sj0 );
+  }
+
+  /** Only a nonlinear initial transform needs the (Jacobian of the) spatial
+   * Jacobian. Assume/demand that GetJacobianOfSpatialJacobian returns the
+   * same nonZeroJacobianIndices as the GetJacobianOfSpatialHessian.
+   */
+  if( !this->m_InitialTransformIsAffine
+    && this->m_InitialTransform->GetHasNonZeroSpatialHessian() )
   {
+    this->m_InitialTransform->GetSpatialHessian( ipp, sh0 );
+    this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
+      transformedPoint, sj1, jsj1, nonZeroJacobianIndices );
     for( unsigned int mu = 0; mu < nonZeroJacobianIndices.size(); ++mu )
     {
       for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
@@ -1493,16 +1605,6 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
         }
       }
     }
-  }
-
-  /** Combine them in one overall spatial Hessian. */
-  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-  {
-    sh[ dim ] = sj0t * ( sh1[ dim ] * sj0 );
-  }
-
-  if( this->m_InitialTransform->GetHasNonZeroSpatialHessian() )
-  {
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
       for( unsigned int p = 0; p < SpaceDimension; ++p )
@@ -1632,6 +1734,202 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ****************** TransformPoints ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  if( this->m_SelectedTransformPointFunction == &Self::TransformPointNoInitialTransform )
+  {
+    this->m_CurrentTransform->TransformPoints( inputPoints, numberOfPoints, outputPoints );
+  }
+  else if( this->m_InitialTransformIsAffine && numberOfPoints > 0 )
+  {
+    /** Map the points with the cached affine map, and pass the whole batch on. */
+    std::vector< InputPointType > initialPoints( numberOfPoints );
+    for( SizeValueType p = 0; p < numberOfPoints; ++p )
+    {
+      initialPoints[ p ] = this->TransformPointWithInitialTransform( inputPoints[ p ] );
+    }
+    this->m_CurrentTransform->TransformPoints( &( initialPoints[ 0 ] ), numberOfPoints, outputPoints );
+  }
+  else
+  {
+    Superclass::TransformPoints( inputPoints, numberOfPoints, outputPoints );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ****************** GetJacobians ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetJacobians(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  ParametersValueType * jacobians,
+  unsigned long * nonZeroJacobianIndices ) const
+{
+  if( this->m_SelectedGetSparseJacobianFunction == &Self::GetJacobianNoInitialTransform )
+  {
+    this->m_CurrentTransform->GetJacobians( inputPoints, numberOfPoints,
+      jacobians, nonZeroJacobianIndices );
+  }
+  else if( this->m_InitialTransformIsAffine && numberOfPoints > 0 )
+  {
+    std::vector< InputPointType > initialPoints( numberOfPoints );
+    for( SizeValueType p = 0; p < numberOfPoints; ++p )
+    {
+      initialPoints[ p ] = this->TransformPointWithInitialTransform( inputPoints[ p ] );
+    }
+    this->m_CurrentTransform->GetJacobians( &( initialPoints[ 0 ] ), numberOfPoints,
+      jacobians, nonZeroJacobianIndices );
+  }
+  else
+  {
+    Superclass::GetJacobians( inputPoints, numberOfPoints,
+      jacobians, nonZeroJacobianIndices );
+  }
+
+} // end GetJacobians()
+
+
+/**
+ * ****************** PrecomputeJacobianStructure ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+bool
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::PrecomputeJacobianStructure(
+  const InputPointType * points,
+  const SizeValueType numberOfPoints,
+  const SizeValueType maximumMemory )
+{
+  if( this->m_SelectedEvaluateJacobianWithImageGradientProductFunction
+    == &Self::EvaluateJacobianWithImageGradientProductNoInitialTransform )
+  {
+    return this->m_CurrentTransform->PrecomputeJacobianStructure(
+      points, numberOfPoints, maximumMemory );
+  }
+  return false;
+
+} // end PrecomputeJacobianStructure()
+
+
+/**
+ * ****************** ReleaseJacobianStructure ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::ReleaseJacobianStructure( void )
+{
+  if( this->m_CurrentTransform.IsNotNull() )
+  {
+    this->m_CurrentTransform->ReleaseJacobianStructure();
+  }
+
+} // end ReleaseJacobianStructure()
+
+
+/**
+ * ****************** GetNumberOfPrecomputedJacobianStructures ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+SizeValueType
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetNumberOfPrecomputedJacobianStructures( void ) const
+{
+  if( this->m_SelectedEvaluateJacobianWithImageGradientProductFunction
+    == &Self::EvaluateJacobianWithImageGradientProductNoInitialTransform )
+  {
+    return this->m_CurrentTransform->GetNumberOfPrecomputedJacobianStructures();
+  }
+  return 0;
+
+} // end GetNumberOfPrecomputedJacobianStructures()
+
+
+/**
+ * ****************** GetJacobianStructureMemoryUsage ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+SizeValueType
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetJacobianStructureMemoryUsage( void ) const
+{
+  if( this->m_CurrentTransform.IsNotNull() )
+  {
+    return this->m_CurrentTransform->GetJacobianStructureMemoryUsage();
+  }
+  return 0;
+
+} // end GetJacobianStructureMemoryUsage()
+
+
+/**
+ * ****************** GetJacobianStructureMTime ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+ModifiedTimeType
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetJacobianStructureMTime( void ) const
+{
+  if( this->m_SelectedEvaluateJacobianWithImageGradientProductFunction
+    == &Self::EvaluateJacobianWithImageGradientProductNoInitialTransform )
+  {
+    return this->m_CurrentTransform->GetJacobianStructureMTime();
+  }
+  return 0;
+
+} // end GetJacobianStructureMTime()
+
+
+/**
+ * ****************** EvaluateCachedJacobianWithImageGradientProduct ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::EvaluateCachedJacobianWithImageGradientProduct(
+  const SizeValueType pointIndex,
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  if( this->m_SelectedEvaluateJacobianWithImageGradientProductFunction
+    == &Self::EvaluateJacobianWithImageGradientProductNoInitialTransform )
+  {
+    this->m_CurrentTransform->EvaluateCachedJacobianWithImageGradientProduct(
+      pointIndex, ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  }
+  else
+  {
+    this->EvaluateJacobianWithImageGradientProduct(
+      ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  }
+
+} // end EvaluateCachedJacobianWithImageGradientProduct()
+
+
 /**
  * ****************** EvaluateJacobianWithImageGradientProduct ****************************
  */
@@ -1652,6 +1950,73 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ****************** GetHasNonZeroJacobianIndicesDescriptor ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+bool
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetHasNonZeroJacobianIndicesDescriptor( void ) const
+{
+  return this->m_CurrentTransform.IsNotNull()
+         && this->m_CurrentTransform->GetHasNonZeroJacobianIndicesDescriptor();
+
+} // end GetHasNonZeroJacobianIndicesDescriptor()
+
+
+/**
+ * ****************** GetIsLinearInParameters ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+bool
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetIsLinearInParameters( void ) const
+{
+  return this->m_CurrentTransform.IsNotNull()
+         && this->m_CurrentTransform->GetIsLinearInParameters();
+
+} // end GetIsLinearInParameters()
+
+
+/**
+ * ****************** EvaluateCompactJacobianWithImageGradientProduct ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::EvaluateCompactJacobianWithImageGradientProduct(
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesDescriptorType & descriptor ) const
+{
+  if( this->m_CurrentTransform.IsNull() )
+  {
+    this->NoCurrentTransformSet();
+  }
+
+  /** As in EvaluateJacobianWithImageGradientProductUseComposition(), the
+   * current transform acts on the point mapped by the initial transform.
+   */
+  if( this->m_SelectedEvaluateJacobianWithImageGradientProductFunction
+    == &Self::EvaluateJacobianWithImageGradientProductUseComposition )
+  {
+    this->m_CurrentTransform->EvaluateCompactJacobianWithImageGradientProduct(
+      this->TransformPointWithInitialTransform( ipp ),
+      movingImageGradient, imageJacobian, descriptor );
+  }
+  else
+  {
+    this->m_CurrentTransform->EvaluateCompactJacobianWithImageGradientProduct(
+      ipp, movingImageGradient, imageJacobian, descriptor );
+  }
+
+} // end EvaluateCompactJacobianWithImageGradientProduct()
+
+
 /**
  * ****************** GetSpatialJacobian ****************************
  */
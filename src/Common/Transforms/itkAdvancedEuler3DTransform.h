@@ -113,6 +113,9 @@ public:
   typedef typename Superclass
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType InternalMatrixType;
+  typedef typename Superclass::DerivativeType     DerivativeType;
+  typedef typename Superclass
+    ::MovingImageGradientType MovingImageGradientType;
 
   /** Set/Get the transformation from a container of parameters
    * This is typically used by optimizers.  There are 6 parameters. The first
@@ -135,6 +138,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, directly from the precomputed m_JacobianOfSpatialJacobian.
+   */
+  virtual void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
   /** Set/Get the order of the computation. Default ZXY */
   itkSetMacro( ComputeZYX, bool );
   itkGetConstMacro( ComputeZYX, bool );
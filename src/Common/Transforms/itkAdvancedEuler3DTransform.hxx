@@ -302,6 +302,42 @@ AdvancedEuler3DTransform< TScalarType >::GetJacobian( const InputPointType & p,
 }
 
 
+// Compute the Jacobian times the moving image gradient
+template< class TScalarType >
+void
+AdvancedEuler3DTransform< TScalarType >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** The rotation part: g^T dR/dmu * (p-c), without forming the Jacobian. */
+  const InputVectorType                 pp  = p - this->GetCenter();
+  const JacobianOfSpatialJacobianType & jsj = this->m_JacobianOfSpatialJacobian;
+  for( unsigned int par = 0; par < 3; ++par )
+  {
+    const InputVectorType column = jsj[ par ] * pp;
+    double                sum    = 0.0;
+    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    {
+      sum += movingImageGradient[ i ] * column[ i ];
+    }
+    imageJacobian[ par ] = sum;
+  }
+
+  /** The translation part. */
+  const unsigned int blockOffset = 3;
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    imageJacobian[ blockOffset + dim ] = movingImageGradient[ dim ];
+  }
+
+  // Copy the constant nonZeroJacobianIndices
+  nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+}
+
+
 // Precompute Jacobian of Spatial Jacobian
 template< class TScalarType >
 void
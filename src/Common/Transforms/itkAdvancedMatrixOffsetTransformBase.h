@@ -343,6 +343,10 @@ public:
    */
   OutputPointType     TransformPoint( const InputPointType & point ) const;
 
+  /** Transform a contiguous array of points, without a virtual call per point. */
+  virtual void TransformPoints( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints, OutputPointType * outputPoints ) const;
+
   OutputVectorType    TransformVector( const InputVectorType & vector ) const;
 
   OutputVnlVectorType TransformVector( const InputVnlVectorType & vector ) const;
@@ -546,10 +550,6 @@ private:
   TimeStamp         m_MatrixMTime;
   mutable TimeStamp m_InverseMatrixMTime;
 
-  /** Used by the GetJacobian() function which returns the
-   * Jacobian as an output variable. */
-  mutable NonZeroJacobianIndicesType m_NonZeroJacobianIndicesTemp;
-
 };
 
 }  // namespace itk
@@ -264,6 +264,48 @@ AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensi
 }
 
 
+// Transform an array of points
+template< class TScalarType, unsigned int NInputDimensions,
+unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  /** Copy the matrix and offset to the stack, so that the compiler knows they
+   * do not alias with the output, and write out the matrix-vector product.
+   */
+  ScalarType matrix[ NOutputDimensions ][ NInputDimensions ];
+  ScalarType offset[ NOutputDimensions ];
+  for( unsigned int i = 0; i < NOutputDimensions; ++i )
+  {
+    for( unsigned int j = 0; j < NInputDimensions; ++j )
+    {
+      matrix[ i ][ j ] = this->m_Matrix[ i ][ j ];
+    }
+    offset[ i ] = this->m_Offset[ i ];
+  }
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    const InputPointType & ip = inputPoints[ p ];
+    OutputPointType &      op = outputPoints[ p ];
+    for( unsigned int i = 0; i < NOutputDimensions; ++i )
+    {
+      ScalarType sum = offset[ i ];
+      for( unsigned int j = 0; j < NInputDimensions; ++j )
+      {
+        sum += matrix[ i ][ j ] * ip[ j ];
+      }
+      op[ i ] = sum;
+    }
+  }
+
+} // end TransformPoints()
+
+
 // Transform a vector
 template< class TScalarType, unsigned int NInputDimensions,
 unsigned int NOutputDimensions >
@@ -262,7 +262,10 @@ void
 AdvancedSimilarity3DTransform< TScalarType >
 ::ComputeMatrix()
 {
-  this->Superclass::ComputeMatrix();
+  /** Skip the derivatives of the superclass; they are recomputed below
+   * for the scaled matrix.
+   */
+  this->AdvancedVersorTransform< TScalarType >::ComputeMatrix();
   MatrixType newMatrix = this->GetMatrix();
   newMatrix *= m_Scale;
   this->SetVarMatrix( newMatrix );
@@ -337,7 +340,7 @@ AdvancedSimilarity3DTransform< TScalarType >
   jsj[ 1 ]( 2, 0 ) = vyy - vww; jsj[ 1 ]( 2, 1 ) = vzw - vxy; jsj[ 1 ]( 2, 2 ) = -2.0 * vyw;
   jsj[ 1 ]        *= ( this->m_Scale * 2.0 / vw );
 
-  jsj[ 2 ]( 0, 0 ) = -2.0 * vzw; jsj[ 2 ]( 0, 1 ) = vzz - vw;  jsj[ 2 ]( 0, 2 ) = vxw - vyz;
+  jsj[ 2 ]( 0, 0 ) = -2.0 * vzw; jsj[ 2 ]( 0, 1 ) = vzz - vww; jsj[ 2 ]( 0, 2 ) = vxw - vyz;
   jsj[ 2 ]( 1, 0 ) = vww - vzz; jsj[ 2 ]( 1, 1 ) = -2.0 * vzw; jsj[ 2 ]( 1, 2 ) = vyw + vxz;
   jsj[ 2 ]( 2, 0 ) = vxw + vyz; jsj[ 2 ]( 2, 1 ) = vyw - vxz; jsj[ 2 ]( 2, 2 ) = 0.0;
   jsj[ 2 ]        *= ( this->m_Scale * 2.0 / vw );
@@ -136,7 +136,10 @@ public:
 
   /** Types for the (Spatial)Jacobian/Hessian.
    * Using an itk::FixedArray instead of an std::vector gives a performance
-   * gain for the SpatialHessianType.
+   * gain for the SpatialHessianType. The transforms resize the Jacobians of
+   * the spatial Jacobian and Hessian to GetNumberOfNonZeroJacobianIndices()
+   * and write them in place, so a caller that keeps them from point to point,
+   * as the penalty terms do, only allocates at the first point.
    */
   typedef std::vector< unsigned long > NonZeroJacobianIndicesType;
   typedef Matrix< ScalarType,
@@ -205,6 +208,120 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Transform a contiguous array of points, such as the coordinates of a
+   * sample container. The default implementation calls TransformPoint() for
+   * each point. Subclasses may override this to avoid the virtual call and
+   * the repeated setup per point.
+   */
+  virtual void TransformPoints(
+    const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    OutputPointType * outputPoints ) const;
+
+  /** Compute the sparse Jacobians of a contiguous array of points.
+   * With nnzji = GetNumberOfNonZeroJacobianIndices(), the Jacobian of point p
+   * is stored row-major as an OutputSpaceDimension x nnzji matrix starting at
+   * jacobians + p * OutputSpaceDimension * nnzji, and its nonzero Jacobian
+   * indices start at nonZeroJacobianIndices + p * nnzji. Both arrays should be
+   * allocated by the caller. The default implementation calls GetJacobian()
+   * for each point.
+   */
+  virtual void GetJacobians(
+    const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    ParametersValueType * jacobians,
+    unsigned long * nonZeroJacobianIndices ) const;
+
+  /** Precompute the part of the Jacobian that does not depend on the
+   * transform parameters, for a fixed array of points, such as the samples of
+   * a full or grid sampler. Afterwards the Jacobian at point i of that array
+   * can be evaluated with EvaluateCachedJacobianWithImageGradientProduct().
+   * No cache is created when it would take more than maximumMemory bytes.
+   * Returns whether the cache was created. The default implementation does
+   * not support caching and returns false.
+   */
+  virtual bool PrecomputeJacobianStructure(
+    const InputPointType * points,
+    const SizeValueType numberOfPoints,
+    const SizeValueType maximumMemory );
+
+  /** Release the cache created by PrecomputeJacobianStructure(). */
+  virtual void ReleaseJacobianStructure( void ) {}
+
+  /** Get the number of points in the cache; zero when there is no valid cache. */
+  virtual SizeValueType GetNumberOfPrecomputedJacobianStructures( void ) const
+  { return 0; }
+
+  /** Get the memory used by the cache, in bytes. */
+  virtual SizeValueType GetJacobianStructureMemoryUsage( void ) const
+  { return 0; }
+
+  /** Get the time at which the current cache was created; zero when there
+   * is no valid cache. Users of the cache can store this time to check that
+   * the cache still contains their points.
+   */
+  virtual ModifiedTimeType GetJacobianStructureMTime( void ) const
+  { return 0; }
+
+  /** Same as EvaluateJacobianWithImageGradientProduct(), for the point with
+   * index pointIndex in the array given to PrecomputeJacobianStructure().
+   * The point ipp itself should be passed as well. The default implementation
+   * ignores the index and calls EvaluateJacobianWithImageGradientProduct().
+   */
+  virtual void EvaluateCachedJacobianWithImageGradientProduct(
+    const SizeValueType pointIndex,
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
+  /** Compact description of the nonzero Jacobian indices of a transform whose
+   * parameters lie on a grid, such as the B-spline transforms. The local
+   * parameter ( d, k_0, ..., k_{N-1} ), with 0 <= k_i < m_SupportSize[ i ] and
+   * the k_0 running fastest, then the k_1, and so on, and d the slowest,
+   * has the global index
+   *   m_Start + d * m_ParametersPerDimension + sum_i k_i * m_Strides[ i ],
+   * which is the order of the NonZeroJacobianIndicesType.
+   */
+  struct NonZeroJacobianIndicesDescriptorType
+  {
+    unsigned long m_Start;
+    unsigned long m_ParametersPerDimension;
+    unsigned long m_SupportSize[ NInputDimensions ];
+    unsigned long m_Strides[ NInputDimensions ];
+  };
+
+  /** Whether EvaluateCompactJacobianWithImageGradientProduct() is implemented.
+   * Default: false.
+   */
+  virtual bool GetHasNonZeroJacobianIndicesDescriptor( void ) const
+  { return false; }
+
+  /** Whether the transformed points are linear in the parameters, i.e.
+   * T( x; p + a*d ) = T( x; p ) + a * ( T( x; p + d ) - T( x; p ) )
+   * for all x, p, d and a. Not to be confused with IsLinear(), which is about
+   * the input points. Default: false.
+   */
+  virtual bool GetIsLinearInParameters( void ) const
+  { return false; }
+
+  /** Same as EvaluateJacobianWithImageGradientProduct(), but the nonzero
+   * Jacobian indices are returned as a NonZeroJacobianIndicesDescriptorType,
+   * which takes a few bytes instead of GetNumberOfNonZeroJacobianIndices()
+   * indices. Only for transforms with GetHasNonZeroJacobianIndicesDescriptor();
+   * the default implementation throws an exception.
+   */
+  virtual void EvaluateCompactJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesDescriptorType & descriptor ) const;
+
+  /** Expand a descriptor to the full list of nonzero Jacobian indices. */
+  static void ExpandNonZeroJacobianIndices(
+    const NonZeroJacobianIndicesDescriptorType & descriptor,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices );
+
   /** Compute the spatial Jacobian of the transformation.
    *
    * The spatial Jacobian is expressed as a vector of partial derivatives of the
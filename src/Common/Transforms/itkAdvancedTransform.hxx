@@ -35,6 +35,7 @@
 #define _itkAdvancedTransform_hxx
 
 #include "itkAdvancedTransform.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -107,6 +108,163 @@ AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    outputPoints[ p ] = this->TransformPoint( inputPoints[ p ] );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* GetJacobians ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::GetJacobians(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  ParametersValueType * jacobians,
+  unsigned long * nonZeroJacobianIndices ) const
+{
+  const NumberOfParametersType nnzji        = this->GetNumberOfNonZeroJacobianIndices();
+  const SizeValueType          jacobianSize = OutputSpaceDimension * nnzji;
+
+  /** Reuse the Jacobian and the indices for all points. */
+  JacobianType               jacobian( OutputSpaceDimension, nnzji );
+  NonZeroJacobianIndicesType nzji( nnzji );
+  jacobian.Fill( 0.0 );
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    this->GetJacobian( inputPoints[ p ], jacobian, nzji );
+
+    if( nzji.size() != nnzji )
+    {
+      itkExceptionMacro( << "GetJacobians() requires a fixed number of "
+                         << "nonzero Jacobian indices per point." );
+    }
+
+    std::copy( jacobian.data_block(), jacobian.data_block() + jacobianSize,
+      jacobians + p * jacobianSize );
+    std::copy( nzji.begin(), nzji.end(), nonZeroJacobianIndices + p * nnzji );
+  }
+
+} // end GetJacobians()
+
+
+/**
+ * ********************* PrecomputeJacobianStructure ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+bool
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::PrecomputeJacobianStructure(
+  const InputPointType * itkNotUsed( points ),
+  const SizeValueType itkNotUsed( numberOfPoints ),
+  const SizeValueType itkNotUsed( maximumMemory ) )
+{
+  return false;
+
+} // end PrecomputeJacobianStructure()
+
+
+/**
+ * ********************* EvaluateCachedJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateCachedJacobianWithImageGradientProduct(
+  const SizeValueType itkNotUsed( pointIndex ),
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  this->EvaluateJacobianWithImageGradientProduct(
+    ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+
+} // end EvaluateCachedJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* EvaluateCompactJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateCompactJacobianWithImageGradientProduct(
+  const InputPointType & itkNotUsed( ipp ),
+  const MovingImageGradientType & itkNotUsed( movingImageGradient ),
+  DerivativeType & itkNotUsed( imageJacobian ),
+  NonZeroJacobianIndicesDescriptorType & itkNotUsed( descriptor ) ) const
+{
+  itkExceptionMacro( << "ERROR: this transform does not describe its nonzero Jacobian "
+                     << "indices compactly." );
+
+} // end EvaluateCompactJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* ExpandNonZeroJacobianIndices ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::ExpandNonZeroJacobianIndices(
+  const NonZeroJacobianIndicesDescriptorType & descriptor,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices )
+{
+  /** The number of local parameters per output dimension. */
+  unsigned long numberOfWeights = 1;
+  for( unsigned int i = 0; i < NInputDimensions; ++i )
+  {
+    numberOfWeights *= descriptor.m_SupportSize[ i ];
+  }
+  nonZeroJacobianIndices.resize( numberOfWeights * NOutputDimensions );
+
+  /** Walk through the support region like an odometer. */
+  unsigned long localParNum = 0;
+  for( unsigned int d = 0; d < NOutputDimensions; ++d )
+  {
+    unsigned long k[ NInputDimensions ];
+    std::fill( k, k + NInputDimensions, 0 );
+    unsigned long globalParNum = descriptor.m_Start + d * descriptor.m_ParametersPerDimension;
+    for( unsigned long w = 0; w < numberOfWeights; ++w )
+    {
+      nonZeroJacobianIndices[ localParNum++ ] = globalParNum;
+      for( unsigned int i = 0; i < NInputDimensions; ++i )
+      {
+        globalParNum += descriptor.m_Strides[ i ];
+        if( ++k[ i ] < descriptor.m_SupportSize[ i ] ) { break; }
+        globalParNum -= k[ i ] * descriptor.m_Strides[ i ];
+        k[ i ]        = 0;
+      }
+    }
+  }
+
+} // end ExpandNonZeroJacobianIndices()
+
+
 /**
  * ********************* GetNumberOfNonZeroJacobianIndices ****************************
  */
@@ -0,0 +1,140 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedTransformDispatch_h
+#define __itkAdvancedTransformDispatch_h
+
+#include "TypeList.h"
+#include <typeinfo>
+
+namespace itk
+{
+
+/** \class AdvancedTransformDispatch
+ * \brief Evaluates the transforms of a type list without virtual calls.
+ *
+ * The metrics evaluate the transform of every sample through an
+ * AdvancedTransform pointer. When the type of the transform is known, the
+ * functions of that type can be called with their qualified name, which
+ * the compiler can inline. Find() returns the position in the type list of
+ * the exact type of a transform, and the other functions take that
+ * position and call the function of the type at that position. The types
+ * must derive from TTransform, and the position is found once, for
+ * example at the start of each resolution.
+ *
+ * Only exact types are found, since a subclass may override what is
+ * inlined. At position -1, or a position that is not in the list, the
+ * virtual functions are called.
+ *
+ * \ingroup Transforms
+ */
+
+template< class TTypeList >
+struct AdvancedTransformDispatch;
+
+template< class THead, class TTail >
+struct AdvancedTransformDispatch< typelist::TypeList< THead, TTail > >
+{
+  typedef AdvancedTransformDispatch< TTail > TailType;
+
+  /** The position of the exact type of the transform in the list, or -1. */
+  template< class TTransform >
+  static int Find( const TTransform * transform, const int position = 0 )
+  {
+    if( transform != 0 && typeid( *transform ) == typeid( THead ) )
+    {
+      return position;
+    }
+    return TailType::Find( transform, position + 1 );
+  }
+
+
+  /** Map a point with the transform of the type at the position. */
+  template< class TTransform >
+  static inline typename TTransform::OutputPointType TransformPoint(
+    const int position, const TTransform * transform,
+    const typename TTransform::InputPointType & point )
+  {
+    if( position == 0 )
+    {
+      return static_cast< const THead * >( transform )->THead::TransformPoint( point );
+    }
+    return TailType::TransformPoint( position - 1, transform, point );
+  }
+
+
+  /** Compute the product of the moving image gradient and the transform
+   * Jacobian with the transform of the type at the position. */
+  template< class TTransform >
+  static inline void EvaluateJacobianWithImageGradientProduct(
+    const int position, const TTransform * transform,
+    const typename TTransform::InputPointType & point,
+    const typename TTransform::MovingImageGradientType & movingImageGradient,
+    typename TTransform::DerivativeType & imageJacobian,
+    typename TTransform::NonZeroJacobianIndicesType & nonZeroJacobianIndices )
+  {
+    if( position == 0 )
+    {
+      static_cast< const THead * >( transform )->THead::EvaluateJacobianWithImageGradientProduct(
+        point, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+      return;
+    }
+    TailType::EvaluateJacobianWithImageGradientProduct( position - 1, transform,
+      point, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  }
+
+
+};
+
+/** The end of the list: the virtual functions. */
+template< >
+struct AdvancedTransformDispatch< typelist::NullType >
+{
+  template< class TTransform >
+  static int Find( const TTransform *, const int )
+  {
+    return -1;
+  }
+
+
+  template< class TTransform >
+  static inline typename TTransform::OutputPointType TransformPoint(
+    const int, const TTransform * transform,
+    const typename TTransform::InputPointType & point )
+  {
+    return transform->TransformPoint( point );
+  }
+
+
+  template< class TTransform >
+  static inline void EvaluateJacobianWithImageGradientProduct(
+    const int, const TTransform * transform,
+    const typename TTransform::InputPointType & point,
+    const typename TTransform::MovingImageGradientType & movingImageGradient,
+    typename TTransform::DerivativeType & imageJacobian,
+    typename TTransform::NonZeroJacobianIndicesType & nonZeroJacobianIndices )
+  {
+    transform->EvaluateJacobianWithImageGradientProduct(
+      point, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  }
+
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkAdvancedTransformDispatch_h
@@ -230,6 +230,9 @@ public:
    */
   virtual bool IsLinear() const { return true; }
 
+  /** The translation is the parameter vector. */
+  virtual bool GetIsLinearInParameters( void ) const { return true; }
+
   /** Indicates the category transform.
    *  e.g. an affine transform, or a local one, e.g. a deformation field.
    */
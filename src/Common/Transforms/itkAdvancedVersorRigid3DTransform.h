@@ -120,6 +120,9 @@ public:
   typedef typename Superclass
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType InternalMatrixType;
+  typedef typename Superclass::DerivativeType     DerivativeType;
+  typedef typename Superclass
+    ::MovingImageGradientType MovingImageGradientType;
 
   /** Set the transformation from a container of parameters
    * This is typically used by optimizers.
@@ -135,6 +138,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, directly from the precomputed m_JacobianOfSpatialJacobian.
+   */
+  virtual void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
 protected:
 
   AdvancedVersorRigid3DTransform( unsigned int outputSpaceDim,
@@ -146,6 +158,17 @@ protected:
 
   void PrintSelf( std::ostream & os, Indent indent ) const;
 
+  /** Compute the rotation matrix and the derivatives of it. */
+  void ComputeMatrix( void );
+
+  /** Compute the versor from the matrix and the derivatives of the matrix. */
+  void ComputeMatrixParameters( void );
+
+  /** Update the m_JacobianOfSpatialJacobian, which is constant over the
+   * input space, so that GetJacobian() only multiplies it with p - c.
+   */
+  virtual void PrecomputeJacobianOfSpatialJacobian( void );
+
   /** This method must be made protected here because it is not a safe way of
    * initializing the Versor */
   virtual void SetRotationMatrix( const MatrixType & matrix )
@@ -44,21 +44,27 @@ template< class TScalarType >
 AdvancedVersorRigid3DTransform< TScalarType >
 ::AdvancedVersorRigid3DTransform() :
   Superclass( ParametersDimension )
-{}
+{
+  this->PrecomputeJacobianOfSpatialJacobian();
+}
 
 // Constructor with arguments
 template< class TScalarType >
 AdvancedVersorRigid3DTransform< TScalarType >::AdvancedVersorRigid3DTransform( unsigned int outputSpaceDim,
   unsigned int paramDim ) :
   Superclass( paramDim )
-{}
+{
+  this->PrecomputeJacobianOfSpatialJacobian();
+}
 
 // Constructor with arguments
 template< class TScalarType >
 AdvancedVersorRigid3DTransform< TScalarType >::AdvancedVersorRigid3DTransform( const MatrixType & matrix,
   const OutputVectorType & offset ) :
   Superclass( matrix, offset )
-{}
+{
+  this->PrecomputeJacobianOfSpatialJacobian();
+}
 
 // Set Parameters
 template< class TScalarType >
@@ -142,31 +148,123 @@ const typename AdvancedVersorRigid3DTransform< TScalarType >::ParametersType
   return this->m_Parameters;
 }
 
-// Set parameters
+// Get Jacobian
 template< class TScalarType >
 void
 AdvancedVersorRigid3DTransform< TScalarType >::GetJacobian( const InputPointType & p,
   JacobianType & j,
   NonZeroJacobianIndicesType & nzji ) const
 {
-  typedef typename VersorType::ValueType ValueType;
-
   // Initialize the Jacobian. Resizing is only performed when needed.
   // Filling with zeros is needed because the lower loops only visit
   // the nonzero positions.
   j.SetSize( OutputSpaceDimension, ParametersDimension );
   j.Fill( 0.0 );
 
+  /** Compute dR/dmu * (p-c) */
+  const InputVectorType                 pp  = p - this->GetCenter();
+  const JacobianOfSpatialJacobianType & jsj = this->m_JacobianOfSpatialJacobian;
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    const InputVectorType column = jsj[ dim ] * pp;
+    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    {
+      j( i, dim ) = column[ i ];
+    }
+  }
+
+  // compute Jacobian with respect to the translation parameters
+  j[ 0 ][ 3 ] = 1.0;
+  j[ 1 ][ 4 ] = 1.0;
+  j[ 2 ][ 5 ] = 1.0;
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
+// Compute the Jacobian times the moving image gradient
+template< class TScalarType >
+void
+AdvancedVersorRigid3DTransform< TScalarType >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** All parameters but the translation contribute g^T dM/dmu * (p-c),
+   * which also covers the scale of the AdvancedSimilarity3DTransform.
+   */
+  const InputVectorType                 pp  = p - this->GetCenter();
+  const JacobianOfSpatialJacobianType & jsj = this->m_JacobianOfSpatialJacobian;
+  const unsigned int                    numberOfParameters = jsj.size();
+  for( unsigned int par = 0; par < numberOfParameters; ++par )
+  {
+    if( par >= 3 && par < 6 )
+    {
+      imageJacobian[ par ] = movingImageGradient[ par - 3 ];
+      continue;
+    }
+    const InputVectorType column = jsj[ par ] * pp;
+    double                sum    = 0.0;
+    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    {
+      sum += movingImageGradient[ i ] * column[ i ];
+    }
+    imageJacobian[ par ] = sum;
+  }
+
+  // Copy the constant nonZeroJacobianIndices
+  nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+}
+
+
+// Compute the matrix and its derivatives
+template< class TScalarType >
+void
+AdvancedVersorRigid3DTransform< TScalarType >
+::ComputeMatrix( void )
+{
+  this->Superclass::ComputeMatrix();
+  this->PrecomputeJacobianOfSpatialJacobian();
+}
+
+
+// Compute the versor and the derivatives of the matrix
+template< class TScalarType >
+void
+AdvancedVersorRigid3DTransform< TScalarType >
+::ComputeMatrixParameters( void )
+{
+  this->Superclass::ComputeMatrixParameters();
+  this->PrecomputeJacobianOfSpatialJacobian();
+}
+
+
+// Precompute Jacobian of Spatial Jacobian
+template< class TScalarType >
+void
+AdvancedVersorRigid3DTransform< TScalarType >
+::PrecomputeJacobianOfSpatialJacobian( void )
+{
+  /** The Jacobian of spatial Jacobian is constant over inputspace, so is precomputed.
+   * Subclasses with more parameters have sized it already.
+   */
+  JacobianOfSpatialJacobianType & jsj = this->m_JacobianOfSpatialJacobian;
+  if( jsj.size() < ParametersDimension )
+  {
+    jsj.resize( ParametersDimension );
+  }
+
+  typedef typename VersorType::ValueType ValueType;
+
   // compute derivatives with respect to rotation
   const ValueType vx = this->GetVersor().GetX();
   const ValueType vy = this->GetVersor().GetY();
   const ValueType vz = this->GetVersor().GetZ();
   const ValueType vw = this->GetVersor().GetW();
 
-  const double px = p[ 0 ] - this->GetCenter()[ 0 ];
-  const double py = p[ 1 ] - this->GetCenter()[ 1 ];
-  const double pz = p[ 2 ] - this->GetCenter()[ 2 ];
-
   const double vxx = vx * vx;
   const double vyy = vy * vy;
   const double vzz = vz * vz;
@@ -181,34 +279,26 @@ AdvancedVersorRigid3DTransform< TScalarType >::GetJacobian( const InputPointType
 
   const double vzw = vz * vw;
 
-  // compute Jacobian with respect to quaternion parameters
-  j[ 0 ][ 0 ] = 2.0 * ( ( vyw + vxz ) * py + ( vzw - vxy ) * pz )
-    / vw;
-  j[ 1 ][ 0 ] = 2.0 * ( ( vyw - vxz ) * px   - 2 * vxw   * py + ( vxx - vww ) * pz )
-    / vw;
-  j[ 2 ][ 0 ] = 2.0 * ( ( vzw + vxy ) * px + ( vww - vxx ) * py   - 2 * vxw   * pz )
-    / vw;
-
-  j[ 0 ][ 1 ] = 2.0 * ( -2 * vyw  * px + ( vxw + vyz ) * py + ( vww - vyy ) * pz )
-    / vw;
-  j[ 1 ][ 1 ] = 2.0 * ( ( vxw - vyz ) * px                + ( vzw + vxy ) * pz )
-    / vw;
-  j[ 2 ][ 1 ] = 2.0 * ( ( vyy - vww ) * px + ( vzw - vxy ) * py   - 2 * vyw   * pz )
-    / vw;
-
-  j[ 0 ][ 2 ] = 2.0 * ( -2 * vzw  * px + ( vzz - vww ) * py + ( vxw - vyz ) * pz )
-    / vw;
-  j[ 1 ][ 2 ] = 2.0 * ( ( vww - vzz ) * px   - 2 * vzw   * py + ( vyw + vxz ) * pz )
-    / vw;
-  j[ 2 ][ 2 ] = 2.0 * ( ( vxw + vyz ) * px + ( vyw - vxz ) * py )
-    / vw;
+  jsj[ 0 ]( 0, 0 ) = 0.0;     jsj[ 0 ]( 0, 1 ) = vyw + vxz; jsj[ 0 ]( 0, 2 ) = vzw - vxy;
+  jsj[ 0 ]( 1, 0 ) = vyw - vxz; jsj[ 0 ]( 1, 1 ) = -2.0 * vxw; jsj[ 0 ]( 1, 2 ) = vxx - vww;
+  jsj[ 0 ]( 2, 0 ) = vzw + vxy; jsj[ 0 ]( 2, 1 ) = vww - vxx; jsj[ 0 ]( 2, 2 ) = -2.0 * vxw;
+  jsj[ 0 ]        *= ( 2.0 / vw );
 
-  j[ 0 ][ 3 ] = 1.0;
-  j[ 1 ][ 4 ] = 1.0;
-  j[ 2 ][ 5 ] = 1.0;
+  jsj[ 1 ]( 0, 0 ) = -2.0 * vyw; jsj[ 1 ]( 0, 1 ) = vxw + vyz; jsj[ 1 ]( 0, 2 ) = vww - vyy;
+  jsj[ 1 ]( 1, 0 ) = vxw - vyz; jsj[ 1 ]( 1, 1 ) = 0.0;     jsj[ 1 ]( 1, 2 ) = vzw + vxy;
+  jsj[ 1 ]( 2, 0 ) = vyy - vww; jsj[ 1 ]( 2, 1 ) = vzw - vxy; jsj[ 1 ]( 2, 2 ) = -2.0 * vyw;
+  jsj[ 1 ]        *= ( 2.0 / vw );
 
-  // Copy the constant nonZeroJacobianIndices
-  nzji = this->m_NonZeroJacobianIndices;
+  jsj[ 2 ]( 0, 0 ) = -2.0 * vzw; jsj[ 2 ]( 0, 1 ) = vzz - vww; jsj[ 2 ]( 0, 2 ) = vxw - vyz;
+  jsj[ 2 ]( 1, 0 ) = vww - vzz; jsj[ 2 ]( 1, 1 ) = -2.0 * vzw; jsj[ 2 ]( 1, 2 ) = vyw + vxz;
+  jsj[ 2 ]( 2, 0 ) = vxw + vyz; jsj[ 2 ]( 2, 1 ) = vyw - vxz; jsj[ 2 ]( 2, 2 ) = 0.0;
+  jsj[ 2 ]        *= ( 2.0 / vw );
+
+  /** Translation parameters: */
+  for( unsigned int par = 3; par < ParametersDimension; ++par )
+  {
+    jsj[ par ].Fill( 0.0 );
+  }
 }
 
 
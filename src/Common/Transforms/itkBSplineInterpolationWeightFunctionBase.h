@@ -119,10 +119,31 @@ public:
   virtual void Evaluate( const ContinuousIndexType & cindex,
     const IndexType & startIndex, WeightsType & weights ) const;
 
+  /** Evaluate the weights for a batch of continuous indices at once.
+   * On return, startIndices[ p ] contains the start index of the support region
+   * of point p, and weights[ p * NumberOfWeights + k ] its k-th weight.
+   * The output arrays should be allocated by the caller.
+   */
+  virtual void EvaluateBatch( const ContinuousIndexType * cindices,
+    const SizeValueType numberOfPoints,
+    IndexType * startIndices, double * weights ) const;
+
   /** Compute the start index of the support region. */
   void ComputeStartIndex( const ContinuousIndexType & index,
     IndexType & startIndex ) const;
 
+  /** Evaluate only the 1D weights at the specified position.
+   * On return, startIndex contains the start index of the support region and
+   * weights1D[ d * ( SplineOrder + 1 ) + k ] the k-th 1D weight of dimension d.
+   * Together they take much less memory than the full set of weights, which
+   * can be recovered with EvaluateFromOneDWeights().
+   */
+  void Evaluate1DWeights( const ContinuousIndexType & cindex,
+    IndexType & startIndex, double * weights1D ) const;
+
+  /** Compute the NumberOfWeights weights from the 1D weights. */
+  void EvaluateFromOneDWeights( const double * weights1D, double * weights ) const;
+
   /** Get support region size. */
   itkGetConstReferenceMacro( SupportSize, SizeType );
 
@@ -160,6 +181,12 @@ protected:
     const IndexType & startIndex,
     OneDWeightsType & weights1D ) const = 0;
 
+  /** Compute the tensor product of the 1D weights.
+   * The weights are ordered with the first dimension running fastest.
+   */
+  void ComputeTensorProduct( const OneDWeightsType & weights1D,
+    double * weights ) const;
+
   /** Print the member variables. */
   virtual void PrintSelf( std::ostream & os, Indent indent ) const;
 
@@ -22,6 +22,7 @@
 #include "itkImage.h"
 #include "itkMatrix.h"
 #include "itkImageRegionConstIteratorWithIndex.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -198,18 +199,127 @@ BSplineInterpolationWeightFunctionBase< TCoordRep, VSpaceDimension, VSplineOrder
   this->Compute1DWeights( cindex, startIndex, weights1D );
 
   /** Compute the vector of weights. */
-  for( unsigned int k = 0; k < this->m_NumberOfWeights; k++ )
+  this->ComputeTensorProduct( weights1D, weights.data_block() );
+
+} // end Evaluate()
+
+
+/**
+ * ******************* EvaluateBatch *******************
+ */
+
+template< class TCoordRep, unsigned int VSpaceDimension, unsigned int VSplineOrder >
+void
+BSplineInterpolationWeightFunctionBase< TCoordRep, VSpaceDimension, VSplineOrder >
+::EvaluateBatch(
+  const ContinuousIndexType * cindices,
+  const SizeValueType numberOfPoints,
+  IndexType * startIndices,
+  double * weights ) const
+{
+  /** The 1D weights are kept on the stack, and the weights of consecutive
+   * points are written contiguously, which keeps all data in cache.
+   */
+  OneDWeightsType weights1D;
+  double *        weightsPtr = weights;
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    this->ComputeStartIndex( cindices[ p ], startIndices[ p ] );
+    this->Compute1DWeights( cindices[ p ], startIndices[ p ], weights1D );
+    this->ComputeTensorProduct( weights1D, weightsPtr );
+    weightsPtr += NumberOfWeights;
+  }
+
+} // end EvaluateBatch()
+
+
+/**
+ * ******************* Evaluate1DWeights *******************
+ */
+
+template< class TCoordRep, unsigned int VSpaceDimension, unsigned int VSplineOrder >
+void
+BSplineInterpolationWeightFunctionBase< TCoordRep, VSpaceDimension, VSplineOrder >
+::Evaluate1DWeights(
+  const ContinuousIndexType & cindex,
+  IndexType & startIndex,
+  double * weights1D ) const
+{
+  OneDWeightsType oneDWeights;
+  this->ComputeStartIndex( cindex, startIndex );
+  this->Compute1DWeights( cindex, startIndex, oneDWeights );
+
+  const double * oneDWeightsPtr = oneDWeights.GetVnlMatrix().data_block();
+  std::copy( oneDWeightsPtr, oneDWeightsPtr + SpaceDimension * ( SplineOrder + 1 ), weights1D );
+
+} // end Evaluate1DWeights()
+
+
+/**
+ * ******************* EvaluateFromOneDWeights *******************
+ */
+
+template< class TCoordRep, unsigned int VSpaceDimension, unsigned int VSplineOrder >
+void
+BSplineInterpolationWeightFunctionBase< TCoordRep, VSpaceDimension, VSplineOrder >
+::EvaluateFromOneDWeights(
+  const double * weights1D,
+  double * weights ) const
+{
+  OneDWeightsType oneDWeights;
+  std::copy( weights1D, weights1D + SpaceDimension * ( SplineOrder + 1 ),
+    oneDWeights.GetVnlMatrix().data_block() );
+  this->ComputeTensorProduct( oneDWeights, weights );
+
+} // end EvaluateFromOneDWeights()
+
+
+/**
+ * ******************* ComputeTensorProduct *******************
+ */
+
+template< class TCoordRep, unsigned int VSpaceDimension, unsigned int VSplineOrder >
+void
+BSplineInterpolationWeightFunctionBase< TCoordRep, VSpaceDimension, VSplineOrder >
+::ComputeTensorProduct(
+  const OneDWeightsType & weights1D,
+  double * weights ) const
+{
+  /** Instead of computing each weight as the product of SpaceDimension 1D
+   * weights, looked up via m_OffsetToIndexTable, the product is built up one
+   * dimension at a time, starting with the last dimension. This requires only
+   * one multiplication per weight, and the inner loop has a length known at
+   * compile time and contiguous output, so the compiler can fully unroll
+   * and vectorize it. The expansion is done in place: block i only overwrites
+   * entries with an index >= i, and weights[ i ] is read before the write.
+   */
+  const unsigned int supportSize = SplineOrder + 1;
+
+  /** Initialize with the 1D weights of the last dimension. */
+  const double * lastWeights1D = weights1D[ SpaceDimension - 1 ];
+  for( unsigned int k = 0; k < supportSize; ++k )
+  {
+    weights[ k ] = lastWeights1D[ k ];
+  }
+
+  /** Expand with the remaining dimensions. */
+  unsigned long numberOfComputedWeights = supportSize;
+  for( int j = static_cast< int >( SpaceDimension ) - 2; j >= 0; --j )
   {
-    double                tmp1 = 1.0;
-    const unsigned long * tmp2 = this->m_OffsetToIndexTable[ k ];
-    for( unsigned int j = 0; j < SpaceDimension; j++ )
+    const double * currentWeights1D = weights1D[ j ];
+    for( long i = static_cast< long >( numberOfComputedWeights ) - 1; i >= 0; --i )
     {
-      tmp1 *= weights1D[ j ][ tmp2[ j ] ];
+      const double w   = weights[ i ];
+      double *     out = weights + i * supportSize;
+      for( unsigned int k = 0; k < supportSize; ++k )
+      {
+        out[ k ] = w * currentWeights1D[ k ];
+      }
     }
-    weights[ k ] = tmp1;
+    numberOfComputedWeights *= supportSize;
   }
 
-} // end Evaluate()
+} // end ComputeTensorProduct()
 
 
 } // end namespace itk
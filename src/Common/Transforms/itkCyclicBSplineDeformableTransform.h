@@ -30,11 +30,63 @@
 namespace itk
 {
 
+/** \class CyclicBSplineSupportOffsets
+ *
+ * \brief Helper that lists the coefficient offsets of a B-spline support
+ * region, in the order of the weights, with the first dimension running
+ * fastest. The loops over the dimensions are unrolled by recursion.
+ *
+ * The offsets of every dimension are given in a table, so that the
+ * wrapping of the cyclic dimension is done once per dimension instead of
+ * once per support point.
+ */
+template< unsigned int VDimension, unsigned int VSupportSize >
+class CyclicBSplineSupportOffsets
+{
+public:
+
+  typedef OffsetValueType OffsetTableType[ VSupportSize ];
+
+  static inline void Compute( const OffsetTableType * dimensionOffsets,
+    const OffsetValueType base, OffsetValueType * & offsets )
+  {
+    for( unsigned int k = 0; k < VSupportSize; ++k )
+    {
+      CyclicBSplineSupportOffsets< VDimension - 1, VSupportSize >
+      ::Compute( dimensionOffsets, base + dimensionOffsets[ VDimension - 1 ][ k ], offsets );
+    }
+  }
+
+
+};
+
+template< unsigned int VSupportSize >
+class CyclicBSplineSupportOffsets< 0, VSupportSize >
+{
+public:
+
+  typedef OffsetValueType OffsetTableType[ VSupportSize ];
+
+  static inline void Compute( const OffsetTableType *,
+    const OffsetValueType base, OffsetValueType * & offsets )
+  {
+    *offsets = base;
+    ++offsets;
+  }
+
+
+};
+
 /** \class CyclicBSplineDeformableTransform
  *
  * \brief Deformable transform using a B-spline representation in which the
  *   B-spline grid is formulated in a cyclic way.
  *
+ * The offsets of the coefficients in the support region are computed
+ * directly, wrapping the index in the last dimension around, see
+ * ComputeSupportOffsets(). This avoids splitting the support region and
+ * iterating over the two parts at every evaluation.
+ *
  * \ingroup Transforms
  */
 template<
@@ -140,6 +192,12 @@ public:
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const;
 
+  /** The support region wraps around in the last dimension, so it is not
+   * a box in the grid.
+   */
+  virtual bool GetHasNonZeroJacobianIndicesDescriptor( void ) const
+  { return false; }
+
 protected:
 
   CyclicBSplineDeformableTransform();
@@ -152,6 +210,16 @@ protected:
   /** Check if a continuous index is inside the valid region. */
   bool InsideValidRegion( const ContinuousIndexType & index ) const;
 
+  /** The number of coefficients in the support region. */
+  itkStaticConstMacro( NumberOfWeights, unsigned long, WeightsFunctionType::NumberOfWeights );
+
+  /** Compute, for every point of the support region starting at supportIndex,
+   * the offset of its coefficient in the coefficient images, in the order
+   * of the weights. The index in the last dimension wraps around the grid.
+   */
+  virtual void ComputeSupportOffsets( const IndexType & supportIndex,
+    OffsetValueType * offsets ) const;
+
   /** Split an image region into two regions based on the last dimension. */
   virtual void SplitRegion(
     const RegionType & imageRegion,
@@ -145,6 +145,51 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 }
 
 
+/**
+ * ********************* ComputeSupportOffsets ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeSupportOffsets(
+  const IndexType & supportIndex,
+  OffsetValueType * offsets ) const
+{
+  const unsigned int       supportSize = VSplineOrder + 1;
+  const RegionType &       gridRegion  = this->m_CoefficientImages[ 0 ]->GetBufferedRegion();
+  const OffsetValueType *  offsetTable = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+
+  /** The offsets per dimension. The support region lies inside the grid,
+   * except in the last dimension, where the index is taken modulo the
+   * grid size.
+   */
+  OffsetValueType dimensionOffsets[ SpaceDimension ][ supportSize ];
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    const OffsetValueType gridSize = static_cast< OffsetValueType >( gridRegion.GetSize( d ) );
+    OffsetValueType       index    = supportIndex[ d ] - gridRegion.GetIndex( d );
+    if( d == SpaceDimension - 1 )
+    {
+      index = ( ( index % gridSize ) + gridSize ) % gridSize;
+    }
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      dimensionOffsets[ d ][ k ] = index * offsetTable[ d ];
+      ++index;
+      if( d == SpaceDimension - 1 && index == gridSize )
+      {
+        index = 0;
+      }
+    }
+  }
+
+  CyclicBSplineSupportOffsets< SpaceDimension, VSplineOrder + 1 >
+  ::Compute( dimensionOffsets, 0, offsets );
+
+} // end ComputeSupportOffsets()
+
+
 /** Transform a point. */
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 void
@@ -189,58 +234,42 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
   this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
 
-  /** For each dimension, correlate coefficient with weights. */
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
-
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
-
-  /** Zero output point elements. */
-  outputPoint.Fill( NumericTraits< ScalarType >::ZeroValue() );
+  /** The coefficient offsets of the support region, wrapped around in
+   * the last dimension.
+   */
+  OffsetValueType offsets[ NumberOfWeights ];
+  this->ComputeSupportOffsets( supportIndex, offsets );
 
-  unsigned long counter = 0;
-  for( unsigned int r = 0; r < 2; ++r )
+  /** For each dimension, correlate coefficient with weights. */
+  const PixelType * coefficients[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
   {
-    /** Create iterators over the coefficient images
-     * (for both supportRegion1 and supportRegion2.
-     */
-    typedef ImageRegionConstIterator< ImageType > IteratorType;
-    IteratorType iterator[ SpaceDimension ];
+    coefficients[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer();
+  }
 
-    const PixelType * basePointer
-      = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
+  ScalarType displacement[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  {
+    displacement[ j ] = NumericTraits< ScalarType >::ZeroValue();
+  }
+  for( unsigned long counter = 0; counter < NumberOfWeights; ++counter )
+  {
+    /** Populate the indices array. */
+    const OffsetValueType offset = offsets[ counter ];
+    indices[ counter ] = offset;
 
+    /** Multiply weigth with coefficient to compute displacement. */
+    const ScalarType weight = weights[ counter ];
     for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
     {
-      iterator[ j ] = IteratorType( this->m_CoefficientImages[ j ], supportRegions[ r ] );
+      displacement[ j ] += static_cast< ScalarType >( weight * coefficients[ j ][ offset ] );
     }
-
-    /** Loop over this support region. */
-    while( !iterator[ 0 ].IsAtEnd() )
-    {
-      /** Populate the indices array. */
-      indices[ counter ] = &( iterator[ 0 ].Value() ) - basePointer;
-
-      /** Multiply weigth with coefficient to compute displacement. */
-      for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
-      {
-        outputPoint[ j ] += static_cast< ScalarType >(
-          weights[ counter ] * iterator[ j ].Value() );
-        ++iterator[ j ];
-      }
-      ++counter;
-
-    } // end while
   }
 
   /** The output point is the start point + displacement. */
   for( unsigned int j = 0; j < SpaceDimension; j++ )
   {
-    outputPoint[ j ] += transformedPoint[ j ];
+    outputPoint[ j ] = transformedPoint[ j ] + displacement[ j ];
   }
 }
 
@@ -251,10 +280,6 @@ void
 CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 ::GetJacobian( const InputPointType & point, WeightsType & weights, ParameterIndexArrayType & indexes ) const
 {
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  const PixelType * basePointer = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
-
   /** Tranform from world coordinates to grid coordinates. */
   ContinuousIndexType cindex;
   this->TransformPointToContinuousGridIndex( point, cindex );
@@ -274,27 +299,12 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
   this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
 
-  supportRegion.SetIndex( supportIndex );
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
-
-  /** For each dimension, copy the weight to the support region. */
-  unsigned long counter = 0;
-  typedef ImageRegionIterator< JacobianImageType > IteratorType;
-  for( unsigned int r = 0; r < 2; ++r )
+  /** The coefficient offsets of the support region. */
+  OffsetValueType offsets[ NumberOfWeights ];
+  this->ComputeSupportOffsets( supportIndex, offsets );
+  for( unsigned long counter = 0; counter < NumberOfWeights; ++counter )
   {
-    IteratorType iterator = IteratorType( this->m_CoefficientImages[ 0 ], supportRegions[ r ] );
-
-    while( !iterator.IsAtEnd() )
-    {
-      indexes[ counter ] = &( iterator.Value() ) - basePointer;
-
-      /** Go to next coefficient in the support region. */
-      ++counter;
-      ++iterator;
-    }
+    indexes[ counter ] = offsets[ counter ];
   }
 }
 
@@ -340,14 +350,10 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   IndexType supportIndex;
   this->m_DerivativeWeightsFunctions[ 0 ]->ComputeStartIndex(
     cindex, supportIndex );
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
 
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
+  /** The coefficient offsets of the support region. */
+  OffsetValueType offsets[ NumberOfWeights ];
+  this->ComputeSupportOffsets( supportIndex, offsets );
 
   sj.Fill( 0.0 );
 
@@ -365,25 +371,12 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
       /** Compute the sum for this dimension. */
-      double sum = 0.0;
-
-      typename WeightsType::const_iterator itWeights = weights.begin();
-
-      for( unsigned int r = 0; r < 2; ++r )
+      const PixelType * coefficients = this->m_CoefficientImages[ dim ]->GetBufferPointer();
+      double            sum          = 0.0;
+      for( unsigned long mu = 0; mu < NumberOfWeights; ++mu )
       {
-        /** Create an iterator over the correct part of the coefficient
-                       * image. Create an iterator over the weights vector.
-                       */
-        ImageRegionConstIterator< ImageType > itCoef(
-        this->m_CoefficientImages[ dim ], supportRegions[ r ] );
-
-        while( !itCoef.IsAtEnd() )
-        {
-          sum += itCoef.Value() * ( *itWeights );
-          ++itWeights;
-          ++itCoef;
-        }
-      } // end for r
+        sum += coefficients[ offsets[ mu ] ] * weights[ mu ];
+      }
 
       /** Update the spatial Jacobian sj. */
       sj( dim, i ) += sum;
@@ -415,44 +408,30 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 {
   nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
 
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
+  /** The coefficient offsets of the support region. */
+  OffsetValueType offsets[ NumberOfWeights ];
+  this->ComputeSupportOffsets( supportRegion.GetIndex(), offsets );
 
   /** Initialize some helper variables. */
   const SizeValueType numberOfWeights = WeightsFunctionType::NumberOfWeights;
   const SizeValueType parametersPerDim
     = this->GetNumberOfParametersPerDimension();
-  unsigned long mu = 0;
 
-  for( unsigned int r = 0; r < 2; ++r )
+  /** For all control points in the support region, set which of the
+   * indices in the parameter array are non-zero.
+   */
+  for( unsigned long mu = 0; mu < numberOfWeights; ++mu )
   {
-    /** Create iterator over the coefficient image (for current supportRegion). */
-    ImageRegionConstIteratorWithIndex< ImageType >
-    iterator( this->m_CoefficientImages[ 0 ], supportRegions[ r ] );
+    /** Translate the offset into a parameter number for the x-direction. */
+    const IdentifierType parameterNumber = offsets[ mu ];
 
-    /** For all control points in the support region, set which of the
-            * indices in the parameter array are non-zero.
-            */
-    const PixelType * basePointer = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
-    while( !iterator.IsAtEnd() )
+    /** Update the nonZeroJacobianIndices for all directions. */
+    for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
-      /** Translate the index into a parameter number for the x-direction. */
-      const IdentifierType parameterNumber = &( iterator.Value() ) - basePointer;
-
-      /** Update the nonZeroJacobianIndices for all directions. */
-      for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-      {
-        nonZeroJacobianIndices[ mu + dim * numberOfWeights ]
-          = parameterNumber + dim * parametersPerDim;
-      }
-
-      /** Increase the iterators. */
-      ++iterator;
-      ++mu;
-    } // end while
-  }   // end for (supportregions)
+      nonZeroJacobianIndices[ mu + dim * numberOfWeights ]
+        = parameterNumber + dim * parametersPerDim;
+    }
+  }
 
 } // end ComputeNonZeroJacobianIndices()
 
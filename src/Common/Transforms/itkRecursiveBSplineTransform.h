@@ -139,6 +139,15 @@ public:
     JacobianType & j,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Batch versions of TransformPoint() and GetJacobian(), see AdvancedTransform. */
+  virtual void TransformPoints( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints, OutputPointType * outputPoints ) const;
+
+  virtual void GetJacobians( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    ParametersValueType * jacobians,
+    unsigned long * nonZeroJacobianIndices ) const;
+
   /** Compute the inner product of the Jacobian with the moving image gradient.
    * The Jacobian is (partially) constructed inside this function, but not returned.
    */
@@ -148,6 +157,16 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Same as EvaluateJacobianWithImageGradientProduct(), using the 1D weights
+   * and support index cached by PrecomputeJacobianStructure().
+   */
+  virtual void EvaluateCachedJacobianWithImageGradientProduct(
+    const SizeValueType pointIndex,
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -203,6 +222,42 @@ protected:
     NonZeroJacobianIndicesType & nonZeroJacobianIndices,
     const RegionType & supportRegion ) const;
 
+  /** Compute the 1D weights, and their derivatives up to derivativeOrder,
+   * at a point. Returns false if the point is outside the valid region. The
+   * derivative arrays are only used when the order asks for them.
+   */
+  bool EvaluateWeights1D( const InputPointType & ipp,
+    const unsigned int derivativeOrder,
+    double * weightsArray1D,
+    double * derivativeWeightsArray1D,
+    double * hessianWeightsArray1D,
+    IndexType & supportIndex ) const;
+
+  /** Compute the spatial Jacobian and Hessian from precomputed 1D weights. */
+  void ComputeSpatialJacobian( const IndexType & supportIndex,
+    const double * weightsArray1D,
+    const double * derivativeWeightsArray1D,
+    SpatialJacobianType & sj ) const;
+
+  void ComputeSpatialHessian( const IndexType & supportIndex,
+    const double * weightsArray1D,
+    const double * derivativeWeightsArray1D,
+    const double * hessianWeightsArray1D,
+    SpatialHessianType & sh ) const;
+
+  /** Compute the Jacobian of the spatial Jacobian and of the spatial Hessian.
+   * When sj or sh is not NULL, it is computed from the same weights.
+   */
+  void ComputeJacobianOfSpatialJacobian( const InputPointType & ipp,
+    SpatialJacobianType * sj,
+    JacobianOfSpatialJacobianType & jsj,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
+  void ComputeJacobianOfSpatialHessian( const InputPointType & ipp,
+    SpatialHessianType * sh,
+    JacobianOfSpatialHessianType & jsh,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
 private:
 
   RecursiveBSplineTransform( const Self & ); // purposely not implemented
@@ -21,6 +21,7 @@
 #include "itkRecursiveBSplineTransform.h"
 
 #include "itkRecursiveBSplineTransformImplementation.h"
+#include <algorithm>
 
 
 namespace itk
@@ -94,16 +95,31 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
   }
 
-  ScalarType * mu[ SpaceDimension ];
-  for( unsigned int j = 0; j < SpaceDimension; ++j )
-  {
-    mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
-  }
-
   /** Call the recursive TransformPoint function. */
   ScalarType displacement[ SpaceDimension ];
-  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
-    ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+  if( !this->m_InterleavedCoefficients.empty() )
+  {
+    const unsigned int stride = Superclass::InterleavedCoefficientsStride;
+    OffsetValueType    interleavedOffsetTable[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      interleavedOffsetTable[ j ] = bsplineOffsetTable[ j ] * stride;
+    }
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::TransformPointInterleaved( displacement,
+      &( this->m_InterleavedCoefficients[ totalOffsetToSupportIndex * stride ] ),
+      interleavedOffsetTable, weightsArray1D );
+  }
+  else
+  {
+    ScalarType * mu[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+    }
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+  }
 
   // The output point is the start point + displacement.
   for( unsigned int j = 0; j < SpaceDimension; ++j )
@@ -181,6 +197,158 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 } // end GetJacobian()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  /** Check if the coefficient image has been set. */
+  if( !this->m_CoefficientImages[ 0 ] )
+  {
+    itkWarningMacro( << "B-spline coefficients have not been set" );
+    std::copy( inputPoints, inputPoints + numberOfPoints, outputPoints );
+    return;
+  }
+
+  /** The weights, the offset table and the coefficient buffers are set up
+   * only once, so that the loop over the points only evaluates the 1D weights
+   * and the recursive interpolation.
+   */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType             weights1D( weightsArray1D, numberOfWeights, false );
+  const OffsetValueType * bsplineOffsetTable = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+  ScalarType *            bufferPointers[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    bufferPointers[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer();
+  }
+  ContinuousIndexType cindex;
+  IndexType           supportIndex;
+  ScalarType *        mu[ SpaceDimension ];
+  ScalarType          displacement[ SpaceDimension ];
+
+  /** The interleaved coefficients, if they are used. */
+  const unsigned int stride      = Superclass::InterleavedCoefficientsStride;
+  const ScalarType * interleaved = this->m_InterleavedCoefficients.empty()
+    ? 0 : &( this->m_InterleavedCoefficients[ 0 ] );
+  OffsetValueType interleavedOffsetTable[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    interleavedOffsetTable[ j ] = bsplineOffsetTable[ j ] * stride;
+  }
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    /** NOTE: if the support region does not lie totally within the grid
+     * we assume zero displacement and return the input point.
+     */
+    const InputPointType & point = inputPoints[ p ];
+    this->TransformPointToContinuousGridIndex( point, cindex );
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      outputPoints[ p ] = point;
+      continue;
+    }
+
+    /** Compute the 1D weights and the coefficients of the support region. */
+    this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+    OffsetValueType totalOffsetToSupportIndex = 0;
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
+    }
+
+    /** Call the recursive TransformPoint function. */
+    if( interleaved )
+    {
+      RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+        ::TransformPointInterleaved( displacement, interleaved + totalOffsetToSupportIndex * stride,
+        interleavedOffsetTable, weightsArray1D );
+    }
+    else
+    {
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        mu[ j ] = bufferPointers[ j ] + totalOffsetToSupportIndex;
+      }
+      RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+        ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+    }
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      outputPoints[ p ][ j ] = displacement[ j ] + point[ j ];
+    }
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* GetJacobians ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::GetJacobians(
+  const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  ParametersValueType * jacobians,
+  unsigned long * nonZeroJacobianIndices ) const
+{
+  /** Sizes and buffers that are shared by all points. */
+  const unsigned int           numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  const NumberOfParametersType nnzji           = this->GetNumberOfNonZeroJacobianIndices();
+  const SizeValueType          jacobianSize    = SpaceDimension * nnzji;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType                weights1D( weightsArray1D, numberOfWeights, false );
+  NonZeroJacobianIndicesType nzji( nnzji );
+  ContinuousIndexType        cindex;
+  IndexType                  supportIndex;
+  RegionType                 supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    ParametersValueType * jacobianPointer = jacobians + p * jacobianSize;
+    unsigned long *       nzjiPointer     = nonZeroJacobianIndices + p * nnzji;
+    std::fill( jacobianPointer, jacobianPointer + jacobianSize, 0.0 );
+
+    /** NOTE: if the support region does not lie totally within the grid
+     * we assume zero displacement and zero Jacobian.
+     */
+    this->TransformPointToContinuousGridIndex( inputPoints[ p ], cindex );
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      for( NumberOfParametersType i = 0; i < nnzji; ++i )
+      {
+        nzjiPointer[ i ] = i;
+      }
+      continue;
+    }
+
+    /** Compute the 1D weights and write the Jacobian directly in the output. */
+    this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::GetJacobian( jacobianPointer, weightsArray1D, 1.0 );
+
+    /** Compute the nonzero Jacobian indices. */
+    supportRegion.SetIndex( supportIndex );
+    this->ComputeNonZeroJacobianIndices( nzji, supportRegion );
+    std::copy( nzji.begin(), nzji.end(), nzjiPointer );
+  }
+
+} // end GetJacobians()
+
+
 /**
  * ********************* EvaluateJacobianAndImageGradientProduct ****************************
  */
@@ -251,15 +419,85 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 
 
 /**
- * ********************* GetSpatialJacobian ****************************
+ * ********************* EvaluateCachedJacobianWithImageGradientProduct ****************************
  */
 
 template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
 void
 RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
-::GetSpatialJacobian(
+::EvaluateCachedJacobianWithImageGradientProduct(
+  const SizeValueType pointIndex,
   const InputPointType & ipp,
-  SpatialJacobianType & sj ) const
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** Fall back to the normal computation for points outside the cache. */
+  if( pointIndex >= this->m_CachedInsideValidRegion.size() )
+  {
+    this->EvaluateJacobianWithImageGradientProduct(
+      ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+    return;
+  }
+
+  /** NOTE: if the support region does not lie totally within the grid
+   * we assume zero displacement and zero Jacobian.
+   */
+  const NumberOfParametersType nnzji = this->GetNumberOfNonZeroJacobianIndices();
+  if( !this->m_CachedInsideValidRegion[ pointIndex ] )
+  {
+    nonZeroJacobianIndices.resize( nnzji );
+    for( NumberOfParametersType i = 0; i < nnzji; ++i )
+    {
+      nonZeroJacobianIndices[ i ] = i;
+    }
+    return;
+  }
+
+  /** The cached 1D weights have the layout of the recursive weights function. */
+  const double * weightsArray1D
+    = &( this->m_CachedWeights1D[ pointIndex * SpaceDimension * ( SplineOrder + 1 ) ] );
+
+  /** Recursively compute the inner product of the Jacobian and the moving image gradient. */
+  double migArray[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    migArray[ j ] = movingImageGradient[ j ];
+  }
+  ParametersValueType * imageJacobianPointer = imageJacobian.data_block();
+  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+    ::EvaluateJacobianWithImageGradientProduct( imageJacobianPointer, migArray, weightsArray1D, 1.0 );
+
+  /** Setup support region needed for the nonZeroJacobianIndices. */
+  IndexType supportIndex;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    supportIndex[ d ] = this->m_CachedSupportIndices[ pointIndex * SpaceDimension + d ];
+  }
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+  supportRegion.SetIndex( supportIndex );
+
+  /** Compute the nonzero Jacobian indices. */
+  this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+
+} // end EvaluateCachedJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* EvaluateWeights1D ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+bool
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::EvaluateWeights1D(
+  const InputPointType & ipp,
+  const unsigned int derivativeOrder,
+  double * weightsArray1D,
+  double * derivativeWeightsArray1D,
+  double * hessianWeightsArray1D,
+  IndexType & supportIndex ) const
 {
   /** Convert the physical point to a continuous index, which
    * is needed for the 'Evaluate()' functions below.
@@ -267,32 +505,80 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   ContinuousIndexType cindex;
   this->TransformPointToContinuousGridIndex( ipp, cindex );
 
-  // NOTE: if the support region does not lie totally within the grid
-  // we assume zero displacement and identity spatial Jacobian
+  /** NOTE: if the support region does not lie totally within the grid
+   * we assume zero displacement.
+   */
   if( !this->InsideValidRegion( cindex ) )
   {
-    sj.SetIdentity();
-    return;
+    return false;
   }
 
-  /** Create storage for the B-spline interpolation weights. */
-  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
-  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
-  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
-  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
-
-  double * weightsPointer           = &( weights1D[ 0 ] );
-  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
-
   /** Compute the interpolation weights.
    * In contrast to the normal B-spline weights function, the recursive version
    * returns the individual weights instead of the multiplied ones.
    */
-  IndexType supportIndex;
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  WeightsType        weights1D( weightsArray1D, numberOfWeights, false );
   this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
+  if( derivativeOrder > 0 )
+  {
+    WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
+    this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
+  }
+  if( derivativeOrder > 1 )
+  {
+    WeightsType hessianWeights1D( hessianWeightsArray1D, numberOfWeights, false );
+    this->m_RecursiveBSplineWeightFunction->EvaluateSecondOrderDerivative( cindex, hessianWeights1D, supportIndex );
+  }
+
+  return true;
+
+} // end EvaluateWeights1D()
+
+
+/**
+ * ********************* GetSpatialJacobian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::GetSpatialJacobian(
+  const InputPointType & ipp,
+  SpatialJacobianType & sj ) const
+{
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  double             weightsArray1D[ numberOfWeights ];
+  double             derivativeWeightsArray1D[ numberOfWeights ];
+  IndexType          supportIndex;
 
+  // NOTE: if the support region does not lie totally within the grid
+  // we assume zero displacement and identity spatial Jacobian
+  if( !this->EvaluateWeights1D( ipp, 1, weightsArray1D, derivativeWeightsArray1D, 0, supportIndex ) )
+  {
+    sj.SetIdentity();
+    return;
+  }
+
+  this->ComputeSpatialJacobian( supportIndex, weightsArray1D, derivativeWeightsArray1D, sj );
+
+} // end GetSpatialJacobian()
+
+
+/**
+ * ********************* ComputeSpatialJacobian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::ComputeSpatialJacobian(
+  const IndexType & supportIndex,
+  const double * weightsArray1D,
+  const double * derivativeWeightsArray1D,
+  SpatialJacobianType & sj ) const
+{
   /** Compute the offset to the start index. */
   const OffsetValueType * bsplineOffsetTable        = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
   OffsetValueType         totalOffsetToSupportIndex = 0;
@@ -311,7 +597,7 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   /** Recursively compute the spatial Jacobian. */
   double spatialJacobian[ SpaceDimension * ( SpaceDimension + 1 ) ]; //double
   RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
-    ::GetSpatialJacobian( spatialJacobian, mu, bsplineOffsetTable, weightsPointer, derivativeWeightsPointer );
+    ::GetSpatialJacobian( spatialJacobian, mu, bsplineOffsetTable, weightsArray1D, derivativeWeightsArray1D );
 
   /** Copy the correct elements to the spatial Jacobian.
    * The first SpaceDimension elements are actually the displacement, i.e. the recursive
@@ -334,7 +620,7 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     sj( j, j ) += 1.0;
   }
 
-} // end GetSpatialJacobian()
+} // end ComputeSpatialJacobian()
 
 
 /**
@@ -348,15 +634,17 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   const InputPointType & ipp,
   SpatialHessianType & sh ) const
 {
-  /** Convert the physical point to a continuous index, which
-   * is needed for the evaluate functions below.
-   */
-  ContinuousIndexType cindex;
-  this->TransformPointToContinuousGridIndex( ipp, cindex );
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  double             weightsArray1D[ numberOfWeights ];
+  double             derivativeWeightsArray1D[ numberOfWeights ];
+  double             hessianWeightsArray1D[ numberOfWeights ];
+  IndexType          supportIndex;
 
   // NOTE: if the support region does not lie totally within the grid
   // we assume zero displacement and zero spatial Hessian
-  if( !this->InsideValidRegion( cindex ) )
+  if( !this->EvaluateWeights1D( ipp, 2, weightsArray1D, derivativeWeightsArray1D,
+    hessianWeightsArray1D, supportIndex ) )
   {
     for( unsigned int i = 0; i < sh.Size(); ++i )
     {
@@ -365,28 +653,26 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     return;
   }
 
-  /** Create storage for the B-spline interpolation weights. */
-  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
-  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
-  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
-  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType hessianWeightsArray1D[ numberOfWeights ];
-  WeightsType hessianWeights1D( hessianWeightsArray1D, numberOfWeights, false );
+  this->ComputeSpatialHessian( supportIndex, weightsArray1D, derivativeWeightsArray1D,
+    hessianWeightsArray1D, sh );
 
-  double * weightsPointer           = &( weights1D[ 0 ] );
-  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
-  double * hessianWeightsPointer    = &( hessianWeights1D[ 0 ] );
+} // end GetSpatialHessian()
 
-  /** Compute the interpolation weights.
-   * In contrast to the normal B-spline weights function, the recursive version
-   * returns the individual weights instead of the multiplied ones.
-   */
-  IndexType supportIndex;
-  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateSecondOrderDerivative( cindex, hessianWeights1D, supportIndex );
 
+/**
+ * ********************* ComputeSpatialHessian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::ComputeSpatialHessian(
+  const IndexType & supportIndex,
+  const double * weightsArray1D,
+  const double * derivativeWeightsArray1D,
+  const double * hessianWeightsArray1D,
+  SpatialHessianType & sh ) const
+{
   /** Compute the offset to the start index. */
   const OffsetValueType * bsplineOffsetTable        = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
   OffsetValueType         totalOffsetToSupportIndex = 0;
@@ -406,7 +692,7 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   double spatialHessian[ SpaceDimension * ( SpaceDimension + 1 ) * ( SpaceDimension + 2 ) / 2 ];
   RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
     ::GetSpatialHessian( spatialHessian, mu, bsplineOffsetTable,
-    weightsPointer, derivativeWeightsPointer, hessianWeightsPointer );
+    weightsArray1D, derivativeWeightsArray1D, hessianWeightsArray1D );
 
   /** Copy the correct elements to the spatial Hessian.
    * The first SpaceDimension elements are actually the displacement, i.e. the recursive
@@ -442,7 +728,24 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
       * ( sh[ dim ] * this->m_PointToIndexMatrix2 );
   }
 
-} // end GetSpatialHessian()
+} // end ComputeSpatialHessian()
+
+
+/**
+ * ********************* GetJacobianOfSpatialJacobian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::GetJacobianOfSpatialJacobian(
+  const InputPointType & ipp,
+  JacobianOfSpatialJacobianType & jsj,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  SpatialJacobianType * noSpatialJacobian = 0;
+  this->ComputeJacobianOfSpatialJacobian( ipp, noSpatialJacobian, jsj, nonZeroJacobianIndices );
+} // end GetJacobianOfSpatialJacobian()
 
 
 /**
@@ -454,6 +757,25 @@ void
 RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 ::GetJacobianOfSpatialJacobian(
   const InputPointType & ipp,
+  SpatialJacobianType & sj,
+  JacobianOfSpatialJacobianType & jsj,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** Share the weights between the spatial Jacobian and its Jacobian. */
+  this->ComputeJacobianOfSpatialJacobian( ipp, &sj, jsj, nonZeroJacobianIndices );
+} // end GetJacobianOfSpatialJacobian()
+
+
+/**
+ * ********************* ComputeJacobianOfSpatialJacobian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::ComputeJacobianOfSpatialJacobian(
+  const InputPointType & ipp,
+  SpatialJacobianType * sj,
   JacobianOfSpatialJacobianType & jsj,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
@@ -466,15 +788,15 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 
   jsj.resize( this->GetNumberOfNonZeroJacobianIndices() );
 
-  /** Convert the physical point to a continuous index, which
-   * is needed for the 'Evaluate()' functions below.
-   */
-  ContinuousIndexType cindex;
-  this->TransformPointToContinuousGridIndex( ipp, cindex );
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  double             weightsArray1D[ numberOfWeights ];
+  double             derivativeWeightsArray1D[ numberOfWeights ];
+  IndexType          supportIndex;
 
   // NOTE: if the support region does not lie totally within the grid
-  // we assume zero displacement and zero jsj.
-  if( !this->InsideValidRegion( cindex ) )
+  // we assume zero displacement, identity sj and zero jsj.
+  if( !this->EvaluateWeights1D( ipp, 1, weightsArray1D, derivativeWeightsArray1D, 0, supportIndex ) )
   {
     for( unsigned int i = 0; i < jsj.size(); ++i )
     {
@@ -485,27 +807,13 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     {
       nonZeroJacobianIndices[ i ] = i;
     }
+    if( sj != 0 )
+    {
+      sj->SetIdentity();
+    }
     return;
   }
 
-  /** Create storage for the B-spline interpolation weights. */
-  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
-  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
-  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
-  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
-
-  double * weightsPointer           = &( weights1D[ 0 ] );
-  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
-
-  /** Compute the interpolation weights.
-   * In contrast to the normal B-spline weights function, the recursive version
-   * returns the individual weights instead of the multiplied ones.
-   */
-  IndexType supportIndex;
-  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
-
   /** Allocate memory for jsj. If you want also the Jacobian,
    * numberOfIndices more elements are needed.
    */
@@ -515,7 +823,13 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   const double * dc      = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
   double *       jsjPtr2 = jsj[ 0 ].GetVnlMatrix().data_block();
   RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
-    ::GetJacobianOfSpatialJacobian( jsjPtr2, weightsPointer, derivativeWeightsPointer, dc, dummy );
+    ::GetJacobianOfSpatialJacobian( jsjPtr2, weightsArray1D, derivativeWeightsArray1D, dc, dummy );
+
+  /** The spatial Jacobian from the same weights. */
+  if( sj != 0 )
+  {
+    this->ComputeSpatialJacobian( supportIndex, weightsArray1D, derivativeWeightsArray1D, *sj );
+  }
 
   /** Setup support region needed for the nonZeroJacobianIndices. */
   RegionType supportRegion;
@@ -525,25 +839,24 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   /** Compute the nonzero Jacobian indices. */
   this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
 
-} // end GetJacobianOfSpatialJacobian()
+} // end ComputeJacobianOfSpatialJacobian()
 
 
 /**
- * ********************* GetJacobianOfSpatialJacobian ****************************
+ * ********************* GetJacobianOfSpatialHessian ****************************
  */
 
 template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
 void
 RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
-::GetJacobianOfSpatialJacobian(
+::GetJacobianOfSpatialHessian(
   const InputPointType & ipp,
-  SpatialJacobianType & sj,
-  JacobianOfSpatialJacobianType & jsj,
+  JacobianOfSpatialHessianType & jsh,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
-  this->GetJacobianOfSpatialJacobian( ipp, jsj, nonZeroJacobianIndices );
-  this->GetSpatialJacobian( ipp, sj );
-} // end GetJacobianOfSpatialJacobian()
+  SpatialHessianType * noSpatialHessian = 0;
+  this->ComputeJacobianOfSpatialHessian( ipp, noSpatialHessian, jsh, nonZeroJacobianIndices );
+} // end GetJacobianOfSpatialHessian()
 
 
 /**
@@ -555,6 +868,25 @@ void
 RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 ::GetJacobianOfSpatialHessian(
   const InputPointType & ipp,
+  SpatialHessianType & sh,
+  JacobianOfSpatialHessianType & jsh,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** Share the weights between the spatial Hessian and its Jacobian. */
+  this->ComputeJacobianOfSpatialHessian( ipp, &sh, jsh, nonZeroJacobianIndices );
+} // end GetJacobianOfSpatialHessian()
+
+
+/**
+ * ********************* ComputeJacobianOfSpatialHessian ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::ComputeJacobianOfSpatialHessian(
+  const InputPointType & ipp,
+  SpatialHessianType * sh,
   JacobianOfSpatialHessianType & jsh,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
@@ -567,15 +899,17 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 
   jsh.resize( this->GetNumberOfNonZeroJacobianIndices() );
 
-  /** Convert the physical point to a continuous index, which
-   * is needed for the 'Evaluate()' functions below.
-   */
-  ContinuousIndexType cindex;
-  this->TransformPointToContinuousGridIndex( ipp, cindex );
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  double             weightsArray1D[ numberOfWeights ];
+  double             derivativeWeightsArray1D[ numberOfWeights ];
+  double             hessianWeightsArray1D[ numberOfWeights ];
+  IndexType          supportIndex;
 
   // NOTE: if the support region does not lie totally within the grid
-  // we assume zero displacement and identity sj and zero jsj.
-  if( !this->InsideValidRegion( cindex ) )
+  // we assume zero displacement, zero sh and zero jsh.
+  if( !this->EvaluateWeights1D( ipp, 2, weightsArray1D, derivativeWeightsArray1D,
+    hessianWeightsArray1D, supportIndex ) )
   {
     for( unsigned int i = 0; i < jsh.size(); ++i )
     {
@@ -589,31 +923,16 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     {
       nonZeroJacobianIndices[ i ] = i;
     }
+    if( sh != 0 )
+    {
+      for( unsigned int i = 0; i < sh->Size(); ++i )
+      {
+        ( *sh )[ i ].Fill( 0.0 );
+      }
+    }
     return;
   }
 
-  /** Create storage for the B-spline interpolation weights. */
-  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
-  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
-  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
-  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
-  typename WeightsType::ValueType hessianWeightsArray1D[ numberOfWeights ];
-  WeightsType hessianWeights1D( hessianWeightsArray1D, numberOfWeights, false );
-
-  double * weightsPointer           = &( weights1D[ 0 ] );
-  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
-  double * hessianWeightsPointer    = &( hessianWeights1D[ 0 ] );
-
-  /** Compute the interpolation weights.
-   * In contrast to the normal B-spline weights function, the recursive version
-   * returns the individual weights instead of the multiplied ones.
-   */
-  IndexType supportIndex;
-  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
-  this->m_RecursiveBSplineWeightFunction->EvaluateSecondOrderDerivative( cindex, hessianWeights1D, supportIndex );
-
   /** Recursively expand all weights (destroys dummy and jshPtr points to last element afterwards).
    * This version also performs pre- and post-multiplication with the matrices dc^T and dc, respectively.
    * Other differences are that the complete matrix is returned, not just the upper triangle.
@@ -623,7 +942,15 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   const double * dc         = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
   double         dummy[ 1 ] = { 1.0 };
   RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
-    ::GetJacobianOfSpatialHessian( jshPtr, weightsPointer, derivativeWeightsPointer, hessianWeightsPointer, dc, dummy );
+    ::GetJacobianOfSpatialHessian( jshPtr, weightsArray1D, derivativeWeightsArray1D,
+    hessianWeightsArray1D, dc, dummy );
+
+  /** The spatial Hessian from the same weights. */
+  if( sh != 0 )
+  {
+    this->ComputeSpatialHessian( supportIndex, weightsArray1D, derivativeWeightsArray1D,
+      hessianWeightsArray1D, *sh );
+  }
 
   /** Setup support region needed for the nonZeroJacobianIndices. */
   RegionType supportRegion;
@@ -633,25 +960,7 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   /** Compute the nonzero Jacobian indices. */
   this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
 
-} // end GetJacobianOfSpatialHessian()
-
-
-/**
- * ********************* GetJacobianOfSpatialHessian ****************************
- */
-
-template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
-void
-RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
-::GetJacobianOfSpatialHessian(
-  const InputPointType & ipp,
-  SpatialHessianType & sh,
-  JacobianOfSpatialHessianType & jsh,
-  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
-{
-  this->GetJacobianOfSpatialHessian( ipp, jsh, nonZeroJacobianIndices );
-  this->GetSpatialHessian( ipp, sh );
-} // end GetJacobianOfSpatialHessian()
+} // end ComputeJacobianOfSpatialHessian()
 
 
 /**
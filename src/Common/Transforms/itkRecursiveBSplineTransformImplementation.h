@@ -100,6 +100,42 @@ public:
   } // end TransformPoint()
 
 
+  /** TransformPoint recursive implementation, for interleaved coefficients:
+   * mu points to the coefficients of all dimensions of the first control
+   * point of the support region, and the offset table is that of the grid,
+   * multiplied by the number of values per control point.
+   */
+  static inline void TransformPointInterleaved(
+    OutputPointType opp, const ScalarType * mu,
+    const OffsetValueType * interleavedOffsetTable,
+    const double * weights1D )
+  {
+    /** Create a temporary opp and initialize the original. */
+    ScalarType tmp_opp[ OutputDimension ];
+    for( unsigned int j = 0; j < OutputDimension; ++j )
+    {
+      opp[ j ] = 0.0;
+    }
+
+    const OffsetValueType bot = interleavedOffsetTable[ SpaceDimension - 1 ];
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      /** Recurse. */
+      RecursiveBSplineTransformImplementation< OutputDimension, SpaceDimension - 1, SplineOrder, TScalar >
+        ::TransformPointInterleaved( tmp_opp, mu, interleavedOffsetTable, weights1D );
+
+      /** Accumulate the weights. */
+      for( unsigned int j = 0; j < OutputDimension; ++j )
+      {
+        opp[ j ] += tmp_opp[ j ] * weights1D[ k + HelperConstVariable ];
+      }
+
+      // move to the next control point
+      mu += bot;
+    }
+  } // end TransformPointInterleaved()
+
+
   /** GetJacobian recursive implementation. */
   static inline void GetJacobian(
     ScalarType * & jacobians, const double * weights1D, double value )
@@ -403,6 +439,19 @@ public:
   } // end TransformPoint()
 
 
+  /** TransformPointInterleaved recursive implementation. */
+  static inline void TransformPointInterleaved(
+    OutputPointType opp, const ScalarType * mu,
+    const OffsetValueType * itkNotUsed( interleavedOffsetTable ),
+    const double * itkNotUsed( weights1D ) )
+  {
+    for( unsigned int j = 0; j < OutputDimension; ++j )
+    {
+      opp[ j ] = mu[ j ];
+    }
+  } // end TransformPointInterleaved()
+
+
   /** GetJacobian recursive implementation. */
   static inline void GetJacobian(
     ScalarType * & jacobians, const double * weights1D, double value )
@@ -20,6 +20,10 @@
 
 #include "itkAdvancedTransform.h"
 #include "itkIndex.h"
+#include "vnl/vnl_math.h"
+
+#include <vector>
+#include <algorithm>
 
 namespace itk
 {
@@ -133,6 +137,28 @@ public:
   }
 
 
+  /** Transform a contiguous array of points. The points are grouped per
+   * sub-transform, and each group is transformed by a single call to the
+   * TransformPoints() of its sub-transform, so that the data of one
+   * sub-transform stays in cache. Samplers that traverse the image in
+   * raster order, such as the grid and full samplers, already produce the
+   * samples per slice; each thread then evaluates a contiguous range of
+   * sub-transforms.
+   */
+  virtual void TransformPoints(
+    const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    OutputPointType * outputPoints ) const;
+
+  /** Compute the sparse Jacobians of a contiguous array of points, grouped
+   * per sub-transform, see TransformPoints().
+   */
+  virtual void GetJacobians(
+    const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints,
+    ParametersValueType * jacobians,
+    unsigned long * nonZeroJacobianIndices ) const;
+
   /** This returns a sparse version of the Jacobian of the transformation.
    * In this class however, the Jacobian is not sparse.
    * However, it is a useful function, since the Jacobian is passed
@@ -288,6 +314,22 @@ protected:
   StackTransform();
   virtual ~StackTransform() {}
 
+  /** Get the index of the sub-transform of a point. */
+  unsigned int GetSubTransformIndex( const InputPointType & ipp ) const
+  {
+    return vnl_math_min( this->m_NumberOfSubTransforms - 1, static_cast< unsigned int >(
+        vnl_math_max( 0,
+        vnl_math_rnd( ( ipp[ ReducedInputSpaceDimension ] - m_StackOrigin ) / m_StackSpacing ) ) ) );
+  }
+
+
+  /** Sort the points by sub-transform. On return, the points of
+   * sub-transform t are order[ begin[ t ] ], ..., order[ begin[ t + 1 ] - 1 ],
+   * in their original order. */
+  void GroupPointsBySubTransform( const InputPointType * inputPoints,
+    const SizeValueType numberOfPoints, std::vector< SizeValueType > & begin,
+    std::vector< SizeValueType > & order ) const;
+
 private:
 
   StackTransform( const Self & );  // purposely not implemented
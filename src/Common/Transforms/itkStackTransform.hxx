@@ -114,10 +114,7 @@ StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
 
   /** Transform point using right subtransform. */
   SubTransformOutputPointType oppr;
-  const unsigned int          subt
-    = vnl_math_min( this->m_NumberOfSubTransforms - 1, static_cast< unsigned int >(
-      vnl_math_max( 0,
-      vnl_math_rnd( ( ipp[ ReducedInputSpaceDimension ] - m_StackOrigin ) / m_StackSpacing ) ) ) );
+  const unsigned int          subt = this->GetSubTransformIndex( ipp );
   oppr = this->m_SubTransformContainer[ subt ]->TransformPoint( ippr );
 
   /** Increase dimension of input point. */
@@ -153,10 +150,7 @@ StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
   }
 
   /** Get Jacobian from right subtransform. */
-  const unsigned int subt
-    = vnl_math_min( this->m_NumberOfSubTransforms - 1, static_cast< unsigned int >(
-      vnl_math_max( 0,
-      vnl_math_rnd( ( ipp[ ReducedInputSpaceDimension ] - m_StackOrigin ) / m_StackSpacing ) ) ) );
+  const unsigned int subt = this->GetSubTransformIndex( ipp );
   SubTransformJacobianType subjac;
   this->m_SubTransformContainer[ subt ]->GetJacobian( ippr, subjac, nzji );
 
@@ -180,6 +174,165 @@ StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* GroupPointsBySubTransform ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::GroupPointsBySubTransform( const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints, std::vector< SizeValueType > & begin,
+  std::vector< SizeValueType > & order ) const
+{
+  /** A counting sort on the sub-transform index. */
+  std::vector< unsigned int > subt( numberOfPoints );
+  begin.assign( this->m_NumberOfSubTransforms + 1, 0 );
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    subt[ p ] = this->GetSubTransformIndex( inputPoints[ p ] );
+    ++begin[ subt[ p ] + 1 ];
+  }
+  for( unsigned int t = 0; t < this->m_NumberOfSubTransforms; ++t )
+  {
+    begin[ t + 1 ] += begin[ t ];
+  }
+
+  std::vector< SizeValueType > next( begin.begin(), begin.end() - 1 );
+  order.resize( numberOfPoints );
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    order[ next[ subt[ p ] ]++ ] = p;
+  }
+
+} // end GroupPointsBySubTransform()
+
+
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPoints( const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  OutputPointType * outputPoints ) const
+{
+  if( numberOfPoints == 0 )
+  {
+    return;
+  }
+
+  std::vector< SizeValueType > begin, order;
+  this->GroupPointsBySubTransform( inputPoints, numberOfPoints, begin, order );
+
+  /** Reduce the dimension of the points, in sub-transform order. */
+  std::vector< SubTransformInputPointType >  ippr( numberOfPoints );
+  std::vector< SubTransformOutputPointType > oppr( numberOfPoints );
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    const InputPointType & ipp = inputPoints[ order[ i ] ];
+    for( unsigned int d = 0; d < ReducedInputSpaceDimension; ++d )
+    {
+      ippr[ i ][ d ] = ipp[ d ];
+    }
+  }
+
+  /** Transform each group with its sub-transform. */
+  for( unsigned int t = 0; t < this->m_NumberOfSubTransforms; ++t )
+  {
+    if( begin[ t + 1 ] > begin[ t ] )
+    {
+      this->m_SubTransformContainer[ t ]->TransformPoints( &ippr[ begin[ t ] ],
+        begin[ t + 1 ] - begin[ t ], &oppr[ begin[ t ] ] );
+    }
+  }
+
+  /** Increase the dimension of the points, in the original order. */
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    const SizeValueType p = order[ i ];
+    for( unsigned int d = 0; d < ReducedOutputSpaceDimension; ++d )
+    {
+      outputPoints[ p ][ d ] = oppr[ i ][ d ];
+    }
+    outputPoints[ p ][ ReducedOutputSpaceDimension ] = inputPoints[ p ][ ReducedInputSpaceDimension ];
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* GetJacobians ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::GetJacobians( const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints,
+  ParametersValueType * jacobians,
+  unsigned long * nonZeroJacobianIndices ) const
+{
+  if( numberOfPoints == 0 )
+  {
+    return;
+  }
+
+  std::vector< SizeValueType > begin, order;
+  this->GroupPointsBySubTransform( inputPoints, numberOfPoints, begin, order );
+
+  /** Reduce the dimension of the points, in sub-transform order. */
+  std::vector< SubTransformInputPointType > ippr( numberOfPoints );
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    const InputPointType & ipp = inputPoints[ order[ i ] ];
+    for( unsigned int d = 0; d < ReducedInputSpaceDimension; ++d )
+    {
+      ippr[ i ][ d ] = ipp[ d ];
+    }
+  }
+
+  /** Compute the Jacobians of each group with its sub-transform. */
+  const SizeValueType                nnzji   = this->GetNumberOfNonZeroJacobianIndices();
+  const SizeValueType                subSize = ReducedOutputSpaceDimension * nnzji;
+  std::vector< ParametersValueType > subjac( numberOfPoints * subSize );
+  std::vector< unsigned long >       subnzji( numberOfPoints * nnzji );
+  for( unsigned int t = 0; t < this->m_NumberOfSubTransforms; ++t )
+  {
+    if( begin[ t + 1 ] > begin[ t ] )
+    {
+      this->m_SubTransformContainer[ t ]->GetJacobians( &ippr[ begin[ t ] ],
+        begin[ t + 1 ] - begin[ t ], &subjac[ begin[ t ] * subSize ],
+        &subnzji[ begin[ t ] * nnzji ] );
+    }
+  }
+
+  /** Fill the output Jacobians, in the original order. The last row is zero,
+   * and the indices are shifted to the parameters of the sub-transform. */
+  const unsigned long numberOfSubParameters
+    = this->m_SubTransformContainer[ 0 ]->GetNumberOfParameters();
+  for( unsigned int t = 0; t < this->m_NumberOfSubTransforms; ++t )
+  {
+    const unsigned long shift = t * numberOfSubParameters;
+    for( SizeValueType i = begin[ t ]; i < begin[ t + 1 ]; ++i )
+    {
+      const SizeValueType p = order[ i ];
+      std::copy( &subjac[ i * subSize ], &subjac[ i * subSize ] + subSize,
+        jacobians + p * OutputSpaceDimension * nnzji );
+      std::fill( jacobians + p * OutputSpaceDimension * nnzji + subSize,
+        jacobians + ( p + 1 ) * OutputSpaceDimension * nnzji, 0.0 );
+      for( SizeValueType mu = 0; mu < nnzji; ++mu )
+      {
+        nonZeroJacobianIndices[ p * nnzji + mu ] = subnzji[ i * nnzji + mu ] + shift;
+      }
+    }
+  }
+
+} // end GetJacobians()
+
+
 /**
  * ********************* GetNumberOfNonZeroJacobianIndices ****************************
  */
@@ -0,0 +1,232 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTransformToDeformationFieldAndSpatialJacobianSource_h
+#define __itkTransformToDeformationFieldAndSpatialJacobianSource_h
+
+#include "itkAdvancedTransform.h"
+#include "itkImageSource.h"
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkMatrix.h"
+
+namespace itk
+{
+
+/** \class TransformToDeformationFieldAndSpatialJacobianSource
+ * \brief Generate the deformation field, the determinant of the spatial
+ * Jacobian and the spatial Jacobian matrix of a transform in one pass.
+ *
+ * This class combines the TransformToDisplacementFieldFilter, the
+ * TransformToDeterminantOfSpatialJacobianSource and the
+ * TransformToSpatialJacobianSource. The grid is traversed only once, and
+ * in each voxel the spatial Jacobian is computed once for both the
+ * determinant and the matrix output. Each of the outputs is optional and
+ * only allocated when it is switched on:
+ * \li output 0: the deformation field, T(x) - x, see ComputeDeformationField;
+ * \li output 1: det( dT/dx ), see ComputeDeterminantOfSpatialJacobian;
+ * \li output 2: dT/dx, see ComputeSpatialJacobian.
+ *
+ * When several outputs are written one after the other, they are all
+ * computed in the first update, as long as the filter is not modified
+ * in between.
+ *
+ * Output information (spacing, size and direction) for the output
+ * images should be set. This information has the normal defaults of
+ * unit spacing, zero origin and identity direction.
+ *
+ * This filter is implemented as a multithreaded filter.  It provides a
+ * ThreadedGenerateData() method for its implementation.
+ *
+ * \ingroup GeometricTransforms
+ */
+template< unsigned int VDimension,
+class TTransformPrecisionType = double,
+class TOutputComponentType = float >
+class TransformToDeformationFieldAndSpatialJacobianSource :
+  public ImageSource< Image< Vector< TOutputComponentType, VDimension >, VDimension > >
+{
+public:
+
+  /** Typedefs for the output images. */
+  typedef TOutputComponentType                                    OutputComponentType;
+  typedef Vector< OutputComponentType, VDimension >               DeformationVectorType;
+  typedef Image< DeformationVectorType, VDimension >              DeformationFieldImageType;
+  typedef Image< OutputComponentType, VDimension >                DeterminantImageType;
+  typedef Matrix< OutputComponentType, VDimension, VDimension >   SpatialJacobianPixelType;
+  typedef Image< SpatialJacobianPixelType, VDimension >           SpatialJacobianImageType;
+
+  /** Standard class typedefs. */
+  typedef TransformToDeformationFieldAndSpatialJacobianSource Self;
+  typedef ImageSource< DeformationFieldImageType >            Superclass;
+  typedef SmartPointer< Self >                                Pointer;
+  typedef SmartPointer< const Self >                          ConstPointer;
+
+  typedef DeformationFieldImageType                  OutputImageType;
+  typedef typename OutputImageType::Pointer          OutputImagePointer;
+  typedef typename OutputImageType::RegionType       OutputImageRegionType;
+  typedef typename Superclass::DataObjectPointer     DataObjectPointer;
+  typedef typename Superclass::DataObjectPointerArraySizeType
+    DataObjectPointerArraySizeType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TransformToDeformationFieldAndSpatialJacobianSource, ImageSource );
+
+  /** Number of dimensions. */
+  itkStaticConstMacro( ImageDimension, unsigned int, VDimension );
+
+  /** Typedefs for transform. */
+  typedef AdvancedTransform< TTransformPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) >     TransformType;
+  typedef typename TransformType::ConstPointer        TransformPointerType;
+  typedef typename TransformType::SpatialJacobianType SpatialJacobianType;
+  typedef typename TransformType::OutputPointType     TransformOutputPointType;
+
+  /** Typedefs for output image. */
+  typedef typename OutputImageType::RegionType    RegionType;
+  typedef typename RegionType::SizeType           SizeType;
+  typedef typename OutputImageType::IndexType     IndexType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     OriginType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  /** Typedefs for base image. */
+  typedef ImageBase< itkGetStaticConstMacro( ImageDimension ) > ImageBaseType;
+
+  /** Set the coordinate transformation, see TransformToSpatialJacobianSource. */
+  itkSetConstObjectMacro( Transform, TransformType );
+
+  /** Get a pointer to the coordinate transform. */
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Set/Get which outputs are computed. Default: all false. */
+  itkSetMacro( ComputeDeformationField, bool );
+  itkGetConstMacro( ComputeDeformationField, bool );
+  itkBooleanMacro( ComputeDeformationField );
+  itkSetMacro( ComputeDeterminantOfSpatialJacobian, bool );
+  itkGetConstMacro( ComputeDeterminantOfSpatialJacobian, bool );
+  itkBooleanMacro( ComputeDeterminantOfSpatialJacobian );
+  itkSetMacro( ComputeSpatialJacobian, bool );
+  itkGetConstMacro( ComputeSpatialJacobian, bool );
+  itkBooleanMacro( ComputeSpatialJacobian );
+
+  /** Get the outputs. */
+  DeformationFieldImageType * GetDeformationFieldOutput( void );
+  DeterminantImageType * GetDeterminantOfSpatialJacobianOutput( void );
+  SpatialJacobianImageType * GetSpatialJacobianOutput( void );
+
+  /** Set the size of the output image. */
+  virtual void SetOutputSize( const SizeType & size );
+
+  /** Get the size of the output image. */
+  virtual const SizeType & GetOutputSize();
+
+  /** Set the start index of the output largest possible region.
+  * The default is an index of all zeros. */
+  virtual void SetOutputIndex( const IndexType & index );
+
+  /** Get the start index of the output largest possible region. */
+  virtual const IndexType & GetOutputIndex();
+
+  /** Set the region of the output image. */
+  itkSetMacro( OutputRegion, OutputImageRegionType );
+
+  /** Get the region of the output image. */
+  itkGetConstReferenceMacro( OutputRegion, OutputImageRegionType );
+
+  /** Set the output image spacing. */
+  itkSetMacro( OutputSpacing, SpacingType );
+
+  /** Get the output image spacing. */
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+
+  /** Set the output image origin. */
+  itkSetMacro( OutputOrigin, OriginType );
+
+  /** Get the output image origin. */
+  itkGetConstReferenceMacro( OutputOrigin, OriginType );
+
+  /** Set the output direction cosine matrix. */
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+  /** Helper method to set the output parameters based on this image */
+  void SetOutputParametersFromImage( const ImageBaseType * image );
+
+  /** Set the output information of all outputs. */
+  virtual void GenerateOutputInformation( void );
+
+  /** Checking if transform is set. For a linear transformation the
+   * spatial Jacobian is computed only once. */
+  virtual void BeforeThreadedGenerateData( void );
+
+  /** Compute the Modified Time based on changes to the components. */
+  unsigned long GetMTime( void ) const;
+
+  /** Create the outputs, which have different types. */
+  using Superclass::MakeOutput;
+  virtual DataObjectPointer MakeOutput( DataObjectPointerArraySizeType idx );
+
+protected:
+
+  TransformToDeformationFieldAndSpatialJacobianSource();
+  ~TransformToDeformationFieldAndSpatialJacobianSource() {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Only allocate the outputs that are switched on. */
+  virtual void AllocateOutputs( void );
+
+  /** Compute the outputs for a region. */
+  void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId );
+
+private:
+
+  TransformToDeformationFieldAndSpatialJacobianSource( const Self & ); // purposely not implemented
+  void operator=( const Self & );                                      // purposely not implemented
+
+  /** Member variables. */
+  RegionType           m_OutputRegion;         // region of the output image
+  TransformPointerType m_Transform;            // Coordinate transform to use
+  SpacingType          m_OutputSpacing;        // output image spacing
+  OriginType           m_OutputOrigin;         // output image origin
+  DirectionType        m_OutputDirection;      // output image direction cosines
+
+  bool m_ComputeDeformationField;
+  bool m_ComputeDeterminantOfSpatialJacobian;
+  bool m_ComputeSpatialJacobian;
+
+  /** The spatial Jacobian of a linear transform. */
+  bool                m_TransformIsLinear;
+  SpatialJacobianType m_LinearSpatialJacobian;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTransformToDeformationFieldAndSpatialJacobianSource.hxx"
+#endif
+
+#endif // end #ifndef __itkTransformToDeformationFieldAndSpatialJacobianSource_h
@@ -0,0 +1,469 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTransformToDeformationFieldAndSpatialJacobianSource_hxx
+#define __itkTransformToDeformationFieldAndSpatialJacobianSource_hxx
+
+#include "itkTransformToDeformationFieldAndSpatialJacobianSource.h"
+
+#include "itkAdvancedIdentityTransform.h"
+#include "itkProgressReporter.h"
+#include "itkImageRegionIterator.h"
+#include "vnl/vnl_det.h"
+#include "vnl/vnl_copy.h"
+
+namespace itk
+{
+
+/**
+ * Constructor
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::TransformToDeformationFieldAndSpatialJacobianSource()
+{
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+  SizeType size;
+  size.Fill( 0 );
+  this->m_OutputRegion.SetSize( size );
+
+  IndexType index;
+  index.Fill( 0 );
+  this->m_OutputRegion.SetIndex( index );
+
+  this->m_Transform = AdvancedIdentityTransform< TTransformPrecisionType, ImageDimension >::New();
+
+  this->m_ComputeDeformationField             = false;
+  this->m_ComputeDeterminantOfSpatialJacobian = false;
+  this->m_ComputeSpatialJacobian              = false;
+  this->m_TransformIsLinear                   = false;
+  this->m_LinearSpatialJacobian.SetIdentity();
+
+  /** Create the determinant and spatial Jacobian outputs. */
+  this->SetNumberOfRequiredOutputs( 3 );
+  this->SetNthOutput( 1, this->MakeOutput( 1 ) );
+  this->SetNthOutput( 2, this->MakeOutput( 2 ) );
+
+} // end Constructor
+
+
+/**
+ * ******************* MakeOutput *******************
+ */
+
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::DataObjectPointer
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::MakeOutput( DataObjectPointerArraySizeType idx )
+{
+  if( idx == 1 )
+  {
+    return DeterminantImageType::New().GetPointer();
+  }
+  else if( idx == 2 )
+  {
+    return SpatialJacobianImageType::New().GetPointer();
+  }
+  return Superclass::MakeOutput( idx );
+
+} // end MakeOutput()
+
+
+/**
+ * ******************* Get*Output *******************
+ */
+
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::DeformationFieldImageType
+* TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetDeformationFieldOutput( void )
+{
+  return this->GetOutput( 0 );
+}
+
+
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::DeterminantImageType
+* TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetDeterminantOfSpatialJacobianOutput( void )
+{
+  return dynamic_cast< DeterminantImageType * >( this->ProcessObject::GetOutput( 1 ) );
+}
+
+
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SpatialJacobianImageType
+* TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetSpatialJacobianOutput( void )
+{
+  return dynamic_cast< SpatialJacobianImageType * >( this->ProcessObject::GetOutput( 2 ) );
+}
+
+
+/**
+ * Print out a description of self
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "OutputRegion: " << this->m_OutputRegion << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << indent << "ComputeDeformationField: "
+     << this->m_ComputeDeformationField << std::endl;
+  os << indent << "ComputeDeterminantOfSpatialJacobian: "
+     << this->m_ComputeDeterminantOfSpatialJacobian << std::endl;
+  os << indent << "ComputeSpatialJacobian: "
+     << this->m_ComputeSpatialJacobian << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * Set the output image size.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputSize( const SizeType & size )
+{
+  if( this->m_OutputRegion.GetSize() != size )
+  {
+    this->m_OutputRegion.SetSize( size );
+    this->Modified();
+  }
+}
+
+
+/**
+ * Get the output image size.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+const typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SizeType
+& TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetOutputSize()
+{
+  return this->m_OutputRegion.GetSize();
+}
+
+
+/**
+ * Set the output image index.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputIndex( const IndexType & index )
+{
+  if( this->m_OutputRegion.GetIndex() != index )
+  {
+    this->m_OutputRegion.SetIndex( index );
+    this->Modified();
+  }
+}
+
+
+/**
+ * Get the output image index.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+const typename TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::IndexType
+& TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetOutputIndex()
+{
+  return this->m_OutputRegion.GetIndex();
+}
+
+
+/** Helper method to set the output parameters based on this image */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputParametersFromImage( const ImageBaseType * image )
+{
+  if( !image )
+  {
+    itkExceptionMacro( << "Cannot use a null image reference" );
+  }
+
+  this->SetOutputOrigin( image->GetOrigin() );
+  this->SetOutputSpacing( image->GetSpacing() );
+  this->SetOutputDirection( image->GetDirection() );
+  this->SetOutputRegion( image->GetLargestPossibleRegion() );
+
+} // end SetOutputParametersFromImage()
+
+
+/**
+ * Set up state of filter before multi-threading.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::BeforeThreadedGenerateData( void )
+{
+  if( !this->m_Transform )
+  {
+    itkExceptionMacro( << "Transform not set" );
+  }
+
+  /** For a linear transformation the spatial derivative is a constant,
+   * i.e. it is independent of the spatial position. */
+  this->m_TransformIsLinear = this->m_Transform->IsLinear();
+  if( this->m_TransformIsLinear )
+  {
+    IndexType index; index.Fill( 1 );
+    PointType point;
+    this->GetOutput()->TransformIndexToPhysicalPoint( index, point );
+    this->m_Transform->GetSpatialJacobian( point, this->m_LinearSpatialJacobian );
+  }
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ThreadedGenerateData
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  typedef ImageRegionIterator< DeformationFieldImageType > DeformationIteratorType;
+  typedef ImageRegionIterator< DeterminantImageType >      DeterminantIteratorType;
+  typedef ImageRegionIterator< SpatialJacobianImageType >  SpatialJacobianIteratorType;
+  typedef typename IndexType::IndexValueType               IndexValueType;
+
+  const bool computeDef = this->m_ComputeDeformationField;
+  const bool computeDet = this->m_ComputeDeterminantOfSpatialJacobian;
+  const bool computeMat = this->m_ComputeSpatialJacobian;
+  const bool computeSJ  = ( computeDet || computeMat ) && !this->m_TransformIsLinear;
+
+  /** Create iterators for the outputs that are switched on. They all walk
+   * the region in the same order. */
+  DeformationFieldImageType * defOutput = this->GetDeformationFieldOutput();
+  DeformationIteratorType     itDef;
+  DeterminantIteratorType     itDet;
+  SpatialJacobianIteratorType itMat;
+  if( computeDef )
+  {
+    itDef = DeformationIteratorType( defOutput, outputRegionForThread );
+  }
+  if( computeDet )
+  {
+    itDet = DeterminantIteratorType(
+      this->GetDeterminantOfSpatialJacobianOutput(), outputRegionForThread );
+  }
+  if( computeMat )
+  {
+    itMat = SpatialJacobianIteratorType(
+      this->GetSpatialJacobianOutput(), outputRegionForThread );
+  }
+
+  // Support for progress methods/callbacks
+  const SizeValueType nrOfPixels = outputRegionForThread.GetNumberOfPixels();
+  ProgressReporter    progress( this, threadId, nrOfPixels );
+
+  const IndexType start = outputRegionForThread.GetIndex();
+  const SizeType  size  = outputRegionForThread.GetSize();
+  IndexType       index = start;
+
+  PointType                point;
+  TransformOutputPointType transformedPoint;
+  DeformationVectorType    deformation;
+  SpatialJacobianType      sj = this->m_LinearSpatialJacobian;
+  SpatialJacobianPixelType sjOut;
+  const unsigned int       nrElements = sj.GetVnlMatrix().size();
+  OutputComponentType      detjac
+    = static_cast< OutputComponentType >( vnl_det( sj.GetVnlMatrix() ) );
+  vnl_copy( sj.GetVnlMatrix().begin(), sjOut.GetVnlMatrix().begin(), nrElements );
+
+  // Walk the output region
+  for( SizeValueType i = 0; i < nrOfPixels; ++i )
+  {
+    // Determine the coordinates of the current voxel
+    defOutput->TransformIndexToPhysicalPoint( index, point );
+
+    if( computeDef )
+    {
+      transformedPoint = this->m_Transform->TransformPoint( point );
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        deformation[ d ] = static_cast< OutputComponentType >(
+          transformedPoint[ d ] - point[ d ] );
+      }
+      itDef.Set( deformation );
+      ++itDef;
+    }
+
+    if( computeSJ )
+    {
+      this->m_Transform->GetSpatialJacobian( point, sj );
+      if( computeDet )
+      {
+        detjac = static_cast< OutputComponentType >( vnl_det( sj.GetVnlMatrix() ) );
+      }
+      if( computeMat )
+      {
+        vnl_copy( sj.GetVnlMatrix().begin(), sjOut.GetVnlMatrix().begin(), nrElements );
+      }
+    }
+    if( computeDet )
+    {
+      itDet.Set( detjac );
+      ++itDet;
+    }
+    if( computeMat )
+    {
+      itMat.Set( sjOut );
+      ++itMat;
+    }
+
+    // Go to the next index, dimension 0 running fastest
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      ++index[ d ];
+      if( index[ d ] < start[ d ] + static_cast< IndexValueType >( size[ d ] ) )
+      {
+        break;
+      }
+      index[ d ] = start[ d ];
+    }
+
+    progress.CompletedPixel();
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * Only allocate the outputs that are switched on.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::AllocateOutputs( void )
+{
+  RegionType emptyRegion;
+  if( this->m_ComputeDeformationField )
+  {
+    DeformationFieldImageType * output = this->GetDeformationFieldOutput();
+    output->SetBufferedRegion( output->GetRequestedRegion() );
+    output->Allocate();
+  }
+  else
+  {
+    this->GetDeformationFieldOutput()->SetBufferedRegion( emptyRegion );
+  }
+
+  if( this->m_ComputeDeterminantOfSpatialJacobian )
+  {
+    DeterminantImageType * output = this->GetDeterminantOfSpatialJacobianOutput();
+    output->SetBufferedRegion( output->GetRequestedRegion() );
+    output->Allocate();
+  }
+  else
+  {
+    this->GetDeterminantOfSpatialJacobianOutput()->SetBufferedRegion( emptyRegion );
+  }
+
+  if( this->m_ComputeSpatialJacobian )
+  {
+    SpatialJacobianImageType * output = this->GetSpatialJacobianOutput();
+    output->SetBufferedRegion( output->GetRequestedRegion() );
+    output->Allocate();
+  }
+  else
+  {
+    this->GetSpatialJacobianOutput()->SetBufferedRegion( emptyRegion );
+  }
+
+} // end AllocateOutputs()
+
+
+/**
+ * Inform pipeline of required output region
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GenerateOutputInformation( void )
+{
+  // call the superclass' implementation of this method
+  Superclass::GenerateOutputInformation();
+
+  // set the information of all outputs
+  for( unsigned int i = 0; i < 3; ++i )
+  {
+    ImageBaseType * outputPtr = dynamic_cast< ImageBaseType * >(
+      this->ProcessObject::GetOutput( i ) );
+    if( !outputPtr )
+    {
+      continue;
+    }
+
+    outputPtr->SetLargestPossibleRegion( this->m_OutputRegion );
+    outputPtr->SetSpacing( this->m_OutputSpacing );
+    outputPtr->SetOrigin( this->m_OutputOrigin );
+    outputPtr->SetDirection( this->m_OutputDirection );
+  }
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * Verify if any of the components has been modified.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+unsigned long
+TransformToDeformationFieldAndSpatialJacobianSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetMTime( void ) const
+{
+  unsigned long latestTime = Object::GetMTime();
+
+  if( this->m_Transform )
+  {
+    if( latestTime < this->m_Transform->GetMTime() )
+    {
+      latestTime = this->m_Transform->GetMTime();
+    }
+  }
+
+  return latestTime;
+} // end GetMTime()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTransformToDeformationFieldAndSpatialJacobianSource_hxx
@@ -0,0 +1,238 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTransformToInverseDeformationFieldSource_h
+#define __itkTransformToInverseDeformationFieldSource_h
+
+#include "itkAdvancedTransform.h"
+#include "itkImageSource.h"
+#include "itkImage.h"
+#include "itkVector.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class TransformToInverseDeformationFieldSource
+ * \brief Generate the deformation field of the inverse of a transform.
+ *
+ * For every voxel x of the output grid the point y is searched for which
+ * T(y) = x, and the deformation y - x is stored. The output can therefore
+ * be used directly as the field of a DeformationFieldInterpolatingTransform,
+ * or be written to disk and used by the elastix DeformationFieldTransform.
+ *
+ * The search in each voxel starts from the negated forward deformation,
+ * y_0 = x - ( T(x) - x ), which is the exact inverse up to first order for
+ * small deformations. It then iterates either the fixed point scheme
+ * y <- y - ( T(y) - x ), or, when UseNewtonIteration is set, the Newton
+ * scheme y <- y - J(y)^{-1} ( T(y) - x ), with J the spatial Jacobian of the
+ * transform. Newton converges in a few iterations for any smooth transform,
+ * such as the B-spline transforms and the interpolated deformation field;
+ * a linear transform is inverted in one step. When the spatial Jacobian is
+ * not invertible in some point, that iteration falls back to a fixed point
+ * step. The iteration stops when the residual |T(y) - x| is smaller than
+ * the Tolerance, or after MaximumNumberOfIterations iterations.
+ *
+ * After the update, the largest remaining residual and the number of voxels
+ * that did not converge can be inspected, see GetMaximumResidual() and
+ * GetNumberOfNonConvergedPixels(). A large residual points at a transform
+ * that is not invertible, for example due to folding.
+ *
+ * Output information (spacing, size and direction) for the output
+ * image should be set. This information has the normal defaults of
+ * unit spacing, zero origin and identity direction.
+ *
+ * This filter is implemented as a multithreaded filter.  It provides a
+ * ThreadedGenerateData() method for its implementation.
+ *
+ * \ingroup GeometricTransforms
+ */
+template< unsigned int VDimension,
+class TTransformPrecisionType = double,
+class TOutputComponentType = float >
+class TransformToInverseDeformationFieldSource :
+  public ImageSource< Image< Vector< TOutputComponentType, VDimension >, VDimension > >
+{
+public:
+
+  /** Typedefs for the output image. */
+  typedef TOutputComponentType                       OutputComponentType;
+  typedef Vector< OutputComponentType, VDimension >  DeformationVectorType;
+  typedef Image< DeformationVectorType, VDimension > DeformationFieldImageType;
+
+  /** Standard class typedefs. */
+  typedef TransformToInverseDeformationFieldSource Self;
+  typedef ImageSource< DeformationFieldImageType > Superclass;
+  typedef SmartPointer< Self >                     Pointer;
+  typedef SmartPointer< const Self >               ConstPointer;
+
+  typedef DeformationFieldImageType            OutputImageType;
+  typedef typename OutputImageType::Pointer    OutputImagePointer;
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TransformToInverseDeformationFieldSource, ImageSource );
+
+  /** Number of dimensions. */
+  itkStaticConstMacro( ImageDimension, unsigned int, VDimension );
+
+  /** Typedefs for transform. */
+  typedef AdvancedTransform< TTransformPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) >     TransformType;
+  typedef typename TransformType::ConstPointer        TransformPointerType;
+  typedef typename TransformType::SpatialJacobianType SpatialJacobianType;
+  typedef typename TransformType::InputPointType      TransformInputPointType;
+  typedef typename TransformType::OutputPointType     TransformOutputPointType;
+
+  /** Typedefs for output image. */
+  typedef typename OutputImageType::RegionType    RegionType;
+  typedef typename RegionType::SizeType           SizeType;
+  typedef typename OutputImageType::IndexType     IndexType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     OriginType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  /** Typedefs for base image. */
+  typedef ImageBase< itkGetStaticConstMacro( ImageDimension ) > ImageBaseType;
+
+  /** Set the transform to invert. */
+  itkSetConstObjectMacro( Transform, TransformType );
+
+  /** Get a pointer to the transform to invert. */
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Set/Get the maximum number of iterations per voxel. Default: 20. */
+  itkSetMacro( MaximumNumberOfIterations, unsigned int );
+  itkGetConstMacro( MaximumNumberOfIterations, unsigned int );
+
+  /** Set/Get the tolerance on the residual |T(y) - x|, in physical units.
+   * Default: 1e-3. */
+  itkSetMacro( Tolerance, double );
+  itkGetConstMacro( Tolerance, double );
+
+  /** Set/Get whether Newton iterations are used instead of fixed point
+   * iterations. Default: true. */
+  itkSetMacro( UseNewtonIteration, bool );
+  itkGetConstMacro( UseNewtonIteration, bool );
+  itkBooleanMacro( UseNewtonIteration );
+
+  /** Get the largest residual |T(y) - x| over all voxels, after the update. */
+  itkGetConstMacro( MaximumResidual, double );
+
+  /** Get the number of voxels in which the tolerance was not reached. */
+  itkGetConstMacro( NumberOfNonConvergedPixels, SizeValueType );
+
+  /** Set the size of the output image. */
+  virtual void SetOutputSize( const SizeType & size );
+
+  /** Get the size of the output image. */
+  virtual const SizeType & GetOutputSize();
+
+  /** Set the start index of the output largest possible region.
+  * The default is an index of all zeros. */
+  virtual void SetOutputIndex( const IndexType & index );
+
+  /** Get the start index of the output largest possible region. */
+  virtual const IndexType & GetOutputIndex();
+
+  /** Set the region of the output image. */
+  itkSetMacro( OutputRegion, OutputImageRegionType );
+
+  /** Get the region of the output image. */
+  itkGetConstReferenceMacro( OutputRegion, OutputImageRegionType );
+
+  /** Set the output image spacing. */
+  itkSetMacro( OutputSpacing, SpacingType );
+
+  /** Get the output image spacing. */
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+
+  /** Set the output image origin. */
+  itkSetMacro( OutputOrigin, OriginType );
+
+  /** Get the output image origin. */
+  itkGetConstReferenceMacro( OutputOrigin, OriginType );
+
+  /** Set the output direction cosine matrix. */
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+  /** Helper method to set the output parameters based on this image */
+  void SetOutputParametersFromImage( const ImageBaseType * image );
+
+  /** Set the output information. */
+  virtual void GenerateOutputInformation( void );
+
+  /** Checking if transform is set, and initialize the convergence
+   * statistics of the threads. */
+  virtual void BeforeThreadedGenerateData( void );
+
+  /** Combine the convergence statistics of the threads. */
+  virtual void AfterThreadedGenerateData( void );
+
+  /** Compute the Modified Time based on changes to the components. */
+  unsigned long GetMTime( void ) const;
+
+protected:
+
+  TransformToInverseDeformationFieldSource();
+  ~TransformToInverseDeformationFieldSource() {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Invert the transform in the voxels of a region. */
+  void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId );
+
+private:
+
+  TransformToInverseDeformationFieldSource( const Self & ); // purposely not implemented
+  void operator=( const Self & );                           // purposely not implemented
+
+  /** Member variables. */
+  RegionType           m_OutputRegion;         // region of the output image
+  TransformPointerType m_Transform;            // Coordinate transform to invert
+  SpacingType          m_OutputSpacing;        // output image spacing
+  OriginType           m_OutputOrigin;         // output image origin
+  DirectionType        m_OutputDirection;      // output image direction cosines
+
+  unsigned int m_MaximumNumberOfIterations;
+  double       m_Tolerance;
+  bool         m_UseNewtonIteration;
+
+  /** Convergence statistics, in total and per thread. */
+  double                       m_MaximumResidual;
+  SizeValueType                m_NumberOfNonConvergedPixels;
+  std::vector< double >        m_ThreaderMaximumResidual;
+  std::vector< SizeValueType > m_ThreaderNumberOfNonConvergedPixels;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTransformToInverseDeformationFieldSource.hxx"
+#endif
+
+#endif // end #ifndef __itkTransformToInverseDeformationFieldSource_h
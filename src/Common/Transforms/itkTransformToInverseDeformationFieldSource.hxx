@@ -0,0 +1,390 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTransformToInverseDeformationFieldSource_hxx
+#define __itkTransformToInverseDeformationFieldSource_hxx
+
+#include "itkTransformToInverseDeformationFieldSource.h"
+
+#include "itkAdvancedIdentityTransform.h"
+#include "itkProgressReporter.h"
+#include "itkImageRegionIterator.h"
+#include "vnl/vnl_det.h"
+#include "vnl/vnl_inverse.h"
+#include "vnl/vnl_math.h"
+#include "vcl_cmath.h"
+
+namespace itk
+{
+
+/**
+ * Constructor
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::TransformToInverseDeformationFieldSource()
+{
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+  SizeType size;
+  size.Fill( 0 );
+  this->m_OutputRegion.SetSize( size );
+
+  IndexType index;
+  index.Fill( 0 );
+  this->m_OutputRegion.SetIndex( index );
+
+  this->m_Transform = AdvancedIdentityTransform< TTransformPrecisionType, ImageDimension >::New();
+
+  this->m_MaximumNumberOfIterations  = 20;
+  this->m_Tolerance                  = 1e-3;
+  this->m_UseNewtonIteration         = true;
+  this->m_MaximumResidual            = 0.0;
+  this->m_NumberOfNonConvergedPixels = 0;
+
+} // end Constructor
+
+
+/**
+ * Print out a description of self
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "OutputRegion: " << this->m_OutputRegion << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << indent << "MaximumNumberOfIterations: "
+     << this->m_MaximumNumberOfIterations << std::endl;
+  os << indent << "Tolerance: " << this->m_Tolerance << std::endl;
+  os << indent << "UseNewtonIteration: " << this->m_UseNewtonIteration << std::endl;
+  os << indent << "MaximumResidual: " << this->m_MaximumResidual << std::endl;
+  os << indent << "NumberOfNonConvergedPixels: "
+     << this->m_NumberOfNonConvergedPixels << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * Set the output image size.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputSize( const SizeType & size )
+{
+  if( this->m_OutputRegion.GetSize() != size )
+  {
+    this->m_OutputRegion.SetSize( size );
+    this->Modified();
+  }
+}
+
+
+/**
+ * Get the output image size.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+const typename TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SizeType
+& TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetOutputSize()
+{
+  return this->m_OutputRegion.GetSize();
+}
+
+
+/**
+ * Set the output image index.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputIndex( const IndexType & index )
+{
+  if( this->m_OutputRegion.GetIndex() != index )
+  {
+    this->m_OutputRegion.SetIndex( index );
+    this->Modified();
+  }
+}
+
+
+/**
+ * Get the output image index.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+const typename TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::IndexType
+& TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetOutputIndex()
+{
+  return this->m_OutputRegion.GetIndex();
+}
+
+
+/** Helper method to set the output parameters based on this image */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::SetOutputParametersFromImage( const ImageBaseType * image )
+{
+  if( !image )
+  {
+    itkExceptionMacro( << "Cannot use a null image reference" );
+  }
+
+  this->SetOutputOrigin( image->GetOrigin() );
+  this->SetOutputSpacing( image->GetSpacing() );
+  this->SetOutputDirection( image->GetDirection() );
+  this->SetOutputRegion( image->GetLargestPossibleRegion() );
+
+} // end SetOutputParametersFromImage()
+
+
+/**
+ * Set up state of filter before multi-threading.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::BeforeThreadedGenerateData( void )
+{
+  if( !this->m_Transform )
+  {
+    itkExceptionMacro( << "Transform not set" );
+  }
+
+  /** Each thread keeps its own convergence statistics. */
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+  this->m_ThreaderMaximumResidual.assign( numberOfThreads, 0.0 );
+  this->m_ThreaderNumberOfNonConvergedPixels.assign( numberOfThreads, 0 );
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ThreadedGenerateData
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  typedef ImageRegionIterator< DeformationFieldImageType > DeformationIteratorType;
+  typedef typename IndexType::IndexValueType               IndexValueType;
+
+  DeformationFieldImageType * output = this->GetOutput();
+  DeformationIteratorType     itDef( output, outputRegionForThread );
+
+  // Support for progress methods/callbacks
+  const SizeValueType nrOfPixels = outputRegionForThread.GetNumberOfPixels();
+  ProgressReporter    progress( this, threadId, nrOfPixels );
+
+  const IndexType start = outputRegionForThread.GetIndex();
+  const SizeType  size  = outputRegionForThread.GetSize();
+  IndexType       index = start;
+
+  const double       tolerance2    = this->m_Tolerance * this->m_Tolerance;
+  const unsigned int maxIterations = this->m_MaximumNumberOfIterations;
+  const bool         useNewton     = this->m_UseNewtonIteration;
+
+  PointType                point;
+  TransformInputPointType  y;
+  TransformOutputPointType Ty;
+  SpatialJacobianType      sj;
+  DeformationVectorType    deformation;
+  double                   residual[ ImageDimension ];
+  double                   maxResidual2       = 0.0;
+  SizeValueType            numberNotConverged = 0;
+
+  // Walk the output region
+  for( SizeValueType i = 0; i < nrOfPixels; ++i )
+  {
+    // Determine the coordinates of the current voxel
+    output->TransformIndexToPhysicalPoint( index, point );
+
+    /** Start from the negated forward deformation: y = x - ( T(x) - x ). */
+    Ty = this->m_Transform->TransformPoint( point );
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      y[ d ] = 2.0 * point[ d ] - Ty[ d ];
+    }
+
+    /** Iterate until the residual T(y) - x is small enough. */
+    double residual2 = 0.0;
+    for( unsigned int iter = 0; iter <= maxIterations; ++iter )
+    {
+      Ty        = this->m_Transform->TransformPoint( y );
+      residual2 = 0.0;
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        residual[ d ] = Ty[ d ] - point[ d ];
+        residual2    += residual[ d ] * residual[ d ];
+      }
+      if( residual2 <= tolerance2 || iter == maxIterations )
+      {
+        break;
+      }
+
+      /** Newton step y -= J^{-1} r, or a fixed point step y -= r when
+       * the spatial Jacobian is (nearly) singular. */
+      bool newtonStepTaken = false;
+      if( useNewton )
+      {
+        this->m_Transform->GetSpatialJacobian( y, sj );
+        const double det = vnl_det( sj.GetVnlMatrix() );
+        if( vnl_math_abs( det ) > 1e-12 )
+        {
+          const typename SpatialJacobianType::InternalMatrixType sjInverse
+            = vnl_inverse( sj.GetVnlMatrix() );
+          for( unsigned int d = 0; d < ImageDimension; ++d )
+          {
+            double step = 0.0;
+            for( unsigned int e = 0; e < ImageDimension; ++e )
+            {
+              step += sjInverse( d, e ) * residual[ e ];
+            }
+            y[ d ] -= step;
+          }
+          newtonStepTaken = true;
+        }
+      }
+      if( !newtonStepTaken )
+      {
+        for( unsigned int d = 0; d < ImageDimension; ++d )
+        {
+          y[ d ] -= residual[ d ];
+        }
+      }
+    }
+
+    if( residual2 > tolerance2 )
+    {
+      ++numberNotConverged;
+    }
+    maxResidual2 = vnl_math_max( maxResidual2, residual2 );
+
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      deformation[ d ] = static_cast< OutputComponentType >( y[ d ] - point[ d ] );
+    }
+    itDef.Set( deformation );
+    ++itDef;
+
+    // Go to the next index, dimension 0 running fastest
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      ++index[ d ];
+      if( index[ d ] < start[ d ] + static_cast< IndexValueType >( size[ d ] ) )
+      {
+        break;
+      }
+      index[ d ] = start[ d ];
+    }
+
+    progress.CompletedPixel();
+  }
+
+  this->m_ThreaderMaximumResidual[ threadId ]            = vcl_sqrt( maxResidual2 );
+  this->m_ThreaderNumberOfNonConvergedPixels[ threadId ] = numberNotConverged;
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * Combine the convergence statistics of the threads.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::AfterThreadedGenerateData( void )
+{
+  this->m_MaximumResidual            = 0.0;
+  this->m_NumberOfNonConvergedPixels = 0;
+  for( unsigned int i = 0; i < this->m_ThreaderMaximumResidual.size(); ++i )
+  {
+    this->m_MaximumResidual = vnl_math_max(
+      this->m_MaximumResidual, this->m_ThreaderMaximumResidual[ i ] );
+    this->m_NumberOfNonConvergedPixels
+      += this->m_ThreaderNumberOfNonConvergedPixels[ i ];
+  }
+
+} // end AfterThreadedGenerateData()
+
+
+/**
+ * Inform pipeline of required output region
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+void
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GenerateOutputInformation( void )
+{
+  // call the superclass' implementation of this method
+  Superclass::GenerateOutputInformation();
+
+  // get pointer to the output
+  OutputImagePointer outputPtr = this->GetOutput();
+  if( !outputPtr )
+  {
+    return;
+  }
+
+  outputPtr->SetLargestPossibleRegion( this->m_OutputRegion );
+  outputPtr->SetSpacing( this->m_OutputSpacing );
+  outputPtr->SetOrigin( this->m_OutputOrigin );
+  outputPtr->SetDirection( this->m_OutputDirection );
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * Verify if any of the components has been modified.
+ */
+template< unsigned int VDimension, class TTransformPrecisionType, class TOutputComponentType >
+unsigned long
+TransformToInverseDeformationFieldSource< VDimension, TTransformPrecisionType, TOutputComponentType >
+::GetMTime( void ) const
+{
+  unsigned long latestTime = Object::GetMTime();
+
+  if( this->m_Transform )
+  {
+    if( latestTime < this->m_Transform->GetMTime() )
+    {
+      latestTime = this->m_Transform->GetMTime();
+    }
+  }
+
+  return latestTime;
+} // end GetMTime()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTransformToInverseDeformationFieldSource_hxx
@@ -20,6 +20,9 @@
 
 #include "itkObject.h"
 #include "itkArray.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -33,6 +36,18 @@ namespace itk
  * on a denser grid. Therefore, the user needs to supply the old B-spline grid
  * (region, spacing, origin, direction), and the required B-spline grid.
  *
+ * When the required grid halves the grid spacing and its control points
+ * coincide with the current control points or lie halfway between them,
+ * the new coefficients are computed directly with the refinement mask of
+ * the B-spline, if UseDyadicRefinement is on. This is the common case for
+ * a grid schedule of powers of two. The refinement is exact, is applied one
+ * dimension at a time, and is multi-threaded over the grid lines. Beyond
+ * the current grid the coefficients are mirrored, like the
+ * BSplineInterpolateImageFunction does. Dyadic refinement is only possible
+ * for odd B-spline orders. In all other cases the deformation is sampled on
+ * the required grid and the coefficients are computed by a B-spline
+ * decomposition.
+ *
  */
 
 template< class TArray, class TImage >
@@ -94,6 +109,14 @@ public:
   /** Set the B-spline order. */
   itkSetMacro( BSplineOrder, unsigned int );
 
+  /** Set/Get whether the direct dyadic refinement is used when possible.
+   * It reproduces the current deformation exactly, whereas the default path
+   * interpolates it at the new control points, so that the results differ
+   * slightly near the grid border. Default: false. */
+  itkSetMacro( UseDyadicRefinement, bool );
+  itkGetConstMacro( UseDyadicRefinement, bool );
+  itkBooleanMacro( UseDyadicRefinement );
+
   /** Compute the output parameter array. */
   virtual void UpsampleParameters( const ArrayType & param_in,
     ArrayType & param_out );
@@ -112,6 +135,34 @@ protected:
   /** Function that checks if upsampling is required. */
   virtual bool DoUpsampling( void );
 
+  /** Function that checks if the required grid is a dyadic refinement of
+   * the current grid. If so, offsets contains for each dimension the
+   * position of the first required control point, in half current grid
+   * spacings relative to the first current control point.
+   */
+  virtual bool IsDyadicRefinement( std::vector< long > & offsets ) const;
+
+  /** Refine one coefficient image, of size current grid region, to the
+   * required grid region. */
+  virtual void DyadicRefinement( const ValueType * coeffs_in,
+    ValueType * coeffs_out, const std::vector< long > & offsets ) const;
+
+  /** The threader callback of DyadicRefinement(). */
+  static ITK_THREAD_RETURN_TYPE DyadicRefinementThreaderCallback( void * arg );
+
+  /** The struct with the settings of a single refinement pass. */
+  struct DyadicRefinementPassType
+  {
+    const ValueType *             m_Input;
+    ValueType *                   m_Output;
+    const std::vector< double > * m_Mask;
+    unsigned long                 m_NumberOfLines;
+    unsigned long                 m_Stride;
+    unsigned long                 m_InputLength;
+    unsigned long                 m_OutputLength;
+    long                          m_Offset;
+  };
+
 private:
 
   UpsampleBSplineParametersFilter( const Self & ); // purposely not implemented
@@ -127,6 +178,7 @@ private:
   DirectionType m_RequiredGridDirection;
   RegionType    m_RequiredGridRegion;
   unsigned int  m_BSplineOrder;
+  bool          m_UseDyadicRefinement;
 
 };
 
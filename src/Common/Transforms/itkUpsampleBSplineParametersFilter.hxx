@@ -23,6 +23,9 @@
 #include "itkBSplineResampleImageFunction.h"
 #include "itkBSplineDecompositionImageFilter.h"
 #include "itkResampleImageFilter.h"
+#include "itkTraceEventRecorder.h"
+#include "vnl/vnl_math.h"
+#include "vcl_cmath.h"
 
 namespace itk
 {
@@ -35,7 +38,8 @@ template< class TArray, class TImage >
 UpsampleBSplineParametersFilter< TArray, TImage >
 ::UpsampleBSplineParametersFilter()
 {
-  this->m_BSplineOrder = 3;
+  this->m_BSplineOrder        = 3;
+  this->m_UseDyadicRefinement = false;
 
   // Initialize grid settings.
   this->m_CurrentGridOrigin.Fill( 0.0 );
@@ -64,6 +68,26 @@ UpsampleBSplineParametersFilter< TArray, TImage >
     return;
   }
 
+  /** Get the number of parameters. */
+  const unsigned int currentNumberOfPixels
+    = this->m_CurrentGridRegion.GetNumberOfPixels();
+  const unsigned int requiredNumberOfPixels
+    = this->m_RequiredGridRegion.GetNumberOfPixels();
+
+  /** Refine the coefficients directly, if the grids allow it. */
+  std::vector< long > offsets;
+  if( this->m_UseDyadicRefinement && this->IsDyadicRefinement( offsets ) )
+  {
+    parameters_out.SetSize( requiredNumberOfPixels * Dimension );
+    for( unsigned int j = 0; j < Dimension; j++ )
+    {
+      this->DyadicRefinement(
+        parameters_in.data_block() + j * currentNumberOfPixels,
+        parameters_out.data_block() + j * requiredNumberOfPixels, offsets );
+    }
+    return;
+  }
+
   /** Typedefs. */
   typedef itk::ResampleImageFilter<
     ImageType, ImageType >                        UpsampleFilterType;
@@ -72,12 +96,6 @@ UpsampleBSplineParametersFilter< TArray, TImage >
   typedef itk::BSplineDecompositionImageFilter<
     ImageType, ImageType >                        DecompositionFilterType;
 
-  /** Get the number of parameters. */
-  const unsigned int currentNumberOfPixels
-    = this->m_CurrentGridRegion.GetNumberOfPixels();
-  const unsigned int requiredNumberOfPixels
-    = this->m_RequiredGridRegion.GetNumberOfPixels();
-
   /** Create the new vector of output parameters, with the correct size. */
   parameters_out.SetSize( requiredNumberOfPixels * Dimension );
 
@@ -135,6 +153,7 @@ UpsampleBSplineParametersFilter< TArray, TImage >
     /** Do the upsampling. */
     try
     {
+      TraceEventScope traceScope( "UpsampleBSplineParameters", "bspline" );
       decompositionFilter->UpdateLargestPossibleRegion();
       // \todo: the decomposition filter could be multi-threaded
       // by deriving it from the RecursiveSeparableImageFilter,
@@ -183,6 +202,211 @@ UpsampleBSplineParametersFilter< TArray, TImage >
 } // end DoUpsampling()
 
 
+/**
+ * ******************* IsDyadicRefinement *******************
+ */
+
+template< class TArray, class TImage >
+bool
+UpsampleBSplineParametersFilter< TArray, TImage >
+::IsDyadicRefinement( std::vector< long > & offsets ) const
+{
+  /** The refinement mask only maps control points to control points
+   * for odd orders. */
+  if( this->m_BSplineOrder % 2 == 0 )
+  {
+    return false;
+  }
+
+  /** The direction should be the same and the spacing halved. */
+  const double tolerance = 1e-6;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      if( vnl_math_abs( this->m_CurrentGridDirection[ i ][ j ]
+        - this->m_RequiredGridDirection[ i ][ j ] ) > tolerance )
+      {
+        return false;
+      }
+    }
+    if( vnl_math_abs( this->m_CurrentGridSpacing[ i ]
+      - 2.0 * this->m_RequiredGridSpacing[ i ] ) > tolerance * this->m_CurrentGridSpacing[ i ] )
+    {
+      return false;
+    }
+  }
+
+  /** The shift of the origin, in half current grid spacings, should be
+   * an integer. */
+  const vnl_matrix_fixed< double, Dimension, Dimension > inverseDirection
+    = this->m_CurrentGridDirection.GetInverse();
+  offsets.resize( Dimension );
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    double shift = 0.0;
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      shift += inverseDirection[ i ][ j ]
+        * ( this->m_RequiredGridOrigin[ j ] - this->m_CurrentGridOrigin[ j ] );
+    }
+    const double halfSteps = 2.0 * shift / this->m_CurrentGridSpacing[ i ];
+    const long   roundedHalfSteps = static_cast< long >( vnl_math_rnd( halfSteps ) );
+    if( vnl_math_abs( halfSteps - roundedHalfSteps ) > tolerance )
+    {
+      return false;
+    }
+    offsets[ i ] = roundedHalfSteps
+      + static_cast< long >( this->m_RequiredGridRegion.GetIndex()[ i ] )
+      - 2 * static_cast< long >( this->m_CurrentGridRegion.GetIndex()[ i ] );
+  }
+
+  return true;
+
+} // end IsDyadicRefinement()
+
+
+/**
+ * ******************* DyadicRefinement *******************
+ */
+
+template< class TArray, class TImage >
+void
+UpsampleBSplineParametersFilter< TArray, TImage >
+::DyadicRefinement( const ValueType * coeffs_in,
+  ValueType * coeffs_out, const std::vector< long > & offsets ) const
+{
+  /** The refinement mask of a B-spline of order n:
+   * a_i = binomial( n + 1, i ) / 2^n, for i = 0, ..., n + 1.
+   */
+  const unsigned int    n = this->m_BSplineOrder;
+  std::vector< double > mask( n + 2 );
+  mask[ 0 ] = 1.0 / static_cast< double >( 1UL << n );
+  for( unsigned int i = 1; i < n + 2; ++i )
+  {
+    mask[ i ] = mask[ i - 1 ] * static_cast< double >( n + 2 - i ) / static_cast< double >( i );
+  }
+
+  /** Refine one dimension at a time. Dimension d of the buffer has the
+   * required size for d smaller than the current dimension, and the current
+   * size otherwise. */
+  std::vector< unsigned long > size( Dimension );
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    size[ d ] = this->m_CurrentGridRegion.GetSize()[ d ];
+  }
+  std::vector< ValueType > buffer[ 2 ];
+  const ValueType *        input = coeffs_in;
+  MultiThreader::Pointer   threader = MultiThreader::New();
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    const unsigned long outputLength = this->m_RequiredGridRegion.GetSize()[ d ];
+    unsigned long       stride = 1;
+    unsigned long       numberOfLines = 1;
+    for( unsigned int i = 0; i < Dimension; ++i )
+    {
+      if( i < d ) { stride *= size[ i ]; }
+      if( i != d ) { numberOfLines *= size[ i ]; }
+    }
+
+    /** The last pass writes to the output directly. */
+    ValueType * output = coeffs_out;
+    if( d < Dimension - 1 )
+    {
+      buffer[ d % 2 ].resize( numberOfLines * outputLength );
+      output = &( buffer[ d % 2 ][ 0 ] );
+    }
+
+    DyadicRefinementPassType pass;
+    pass.m_Input         = input;
+    pass.m_Output        = output;
+    pass.m_Mask          = &mask;
+    pass.m_NumberOfLines = numberOfLines;
+    pass.m_Stride        = stride;
+    pass.m_InputLength   = size[ d ];
+    pass.m_OutputLength  = outputLength;
+    pass.m_Offset        = offsets[ d ];
+
+    threader->SetNumberOfThreads( static_cast< ThreadIdType >( vnl_math_max< unsigned long >( 1,
+      vnl_math_min< unsigned long >( threader->GetGlobalDefaultNumberOfThreads(), numberOfLines ) ) ) );
+    threader->SetSingleMethod( DyadicRefinementThreaderCallback, &pass );
+    threader->SingleMethodExecute();
+
+    input     = output;
+    size[ d ] = outputLength;
+  }
+
+} // end DyadicRefinement()
+
+
+/**
+ * ******************* DyadicRefinementThreaderCallback *******************
+ */
+
+template< class TArray, class TImage >
+ITK_THREAD_RETURN_TYPE
+UpsampleBSplineParametersFilter< TArray, TImage >
+::DyadicRefinementThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  const ThreadIdType threadId        = infoStruct->ThreadID;
+  const ThreadIdType numberOfThreads = infoStruct->NumberOfThreads;
+  const DyadicRefinementPassType * pass
+    = static_cast< const DyadicRefinementPassType * >( infoStruct->UserData );
+
+  /** Determine the lines of this thread. */
+  const unsigned long linesPerThread = static_cast< unsigned long >( vcl_ceil(
+    static_cast< double >( pass->m_NumberOfLines ) / static_cast< double >( numberOfThreads ) ) );
+  const unsigned long beginLine = vnl_math_min( threadId * linesPerThread, pass->m_NumberOfLines );
+  const unsigned long endLine   = vnl_math_min( beginLine + linesPerThread, pass->m_NumberOfLines );
+
+  const std::vector< double > & mask   = *( pass->m_Mask );
+  const long                    radius = static_cast< long >( mask.size() - 1 ) / 2;
+  const long                    N      = static_cast< long >( pass->m_InputLength );
+  const long                    period = 2 * N - 2;
+  const unsigned long           stride = pass->m_Stride;
+
+  for( unsigned long line = beginLine; line < endLine; ++line )
+  {
+    const unsigned long inner = line % stride;
+    const unsigned long outer = line / stride;
+    const ValueType *   in    = pass->m_Input + outer * stride * pass->m_InputLength + inner;
+    ValueType *         out   = pass->m_Output + outer * stride * pass->m_OutputLength + inner;
+
+    for( unsigned long j = 0; j < pass->m_OutputLength; ++j )
+    {
+      /** The required control point lies at m half steps from the first
+       * current control point, and gets contributions from the current
+       * control points k with |m - 2k| <= radius. */
+      const long m     = pass->m_Offset + static_cast< long >( j );
+      long       kBegin = m - radius;
+      kBegin = ( kBegin >= 0 ) ? ( kBegin + 1 ) / 2 : -( ( -kBegin ) / 2 );
+      double value = 0.0;
+      for( long k = kBegin; 2 * k <= m + radius; ++k )
+      {
+        /** Mirror boundary conditions, as in the BSplineInterpolateImageFunction. */
+        long kk = k;
+        if( N == 1 )
+        {
+          kk = 0;
+        }
+        else
+        {
+          kk = ( ( kk % period ) + period ) % period;
+          if( kk >= N ) { kk = period - kk; }
+        }
+        value += mask[ m - 2 * k + radius ] * in[ kk * stride ];
+      }
+      out[ j * stride ] = static_cast< ValueType >( value );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end DyadicRefinementThreaderCallback()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -205,6 +429,7 @@ UpsampleBSplineParametersFilter< TArray, TImage >
   os << indent << "RequiredGridRegion: "  << this->m_RequiredGridRegion << std::endl;
 
   os << indent << "BSplineOrder: " << this->m_BSplineOrder << std::endl;
+  os << indent << "UseDyadicRefinement: " << this->m_UseDyadicRefinement << std::endl;
 
 } // end PrintSelf()
 
@@ -114,11 +114,24 @@ public:
     OutputType & value,
     CovariantVectorType & deriv ) const
   {
+    BufferInfoType info;
+    this->GetBufferInfo( info );
     return this->EvaluateValueAndDerivativeOptimized(
-      Dispatch< ImageDimension >(), x, value, deriv );
+      Dispatch< ImageDimension >(), info, x, value, deriv );
   }
 
 
+  /** Method to compute both the value and the derivative at a batch of
+   * continuous indices. The image buffer, offset table and spacing are
+   * looked up only once for the whole batch.
+   */
+  void EvaluateValueAndDerivativeAtContinuousIndices(
+    const SizeValueType numberOfIndices,
+    const ContinuousIndexType * x,
+    OutputType * values,
+    CovariantVectorType * derivs ) const;
+
+
 protected:
 
   AdvancedLinearInterpolateImageFunction();
@@ -134,9 +147,32 @@ private:
   template< unsigned int >
   struct Dispatch : public DispatchBase {};
 
+  /** Helper struct with the image information that is needed for every
+   * evaluation. The corner values are read directly from the buffer.
+   */
+  struct BufferInfoType
+  {
+    const InputImageType * m_Image;
+    const InputPixelType * m_Buffer;
+    OffsetValueType        m_Stride[ ImageDimension ];
+    double                 m_InverseSpacing[ ImageDimension ];
+  };
+
+  /** Fill the buffer information. */
+  void GetBufferInfo( BufferInfoType & info ) const;
+
+  /** Mirror x into the image domain and compute the corner pointer and the
+   * linear interpolation weights. Returns the pointer to the first corner.
+   */
+  inline const InputPixelType * ComputeCornerAndWeights(
+    const BufferInfoType & info,
+    const ContinuousIndexType & x,
+    double * dist, double * dinv, double * derivSign ) const;
+
   /** Method to compute both the value and the derivative. 2D specialization. */
   inline void EvaluateValueAndDerivativeOptimized(
     const Dispatch< 2 > &,
+    const BufferInfoType & info,
     const ContinuousIndexType & x,
     OutputType & value,
     CovariantVectorType & deriv ) const;
@@ -144,6 +180,7 @@ private:
   /** Method to compute both the value and the derivative. 3D specialization. */
   inline void EvaluateValueAndDerivativeOptimized(
     const Dispatch< 3 > &,
+    const BufferInfoType & info,
     const ContinuousIndexType & x,
     OutputType & value,
     CovariantVectorType & deriv ) const;
@@ -151,6 +188,7 @@ private:
   /** Method to compute both the value and the derivative. Generic. */
   inline void EvaluateValueAndDerivativeOptimized(
     const DispatchBase &,
+    const BufferInfoType &,
     const ContinuousIndexType & x,
     OutputType & value,
     CovariantVectorType & deriv ) const
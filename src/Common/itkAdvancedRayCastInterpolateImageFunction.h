@@ -144,6 +144,11 @@ public:
   virtual OutputType EvaluateAtContinuousIndex(
     const ContinuousIndexType & index ) const;
 
+  /** Set the input image, and compute the bounding planes of the volume,
+   * which are then shared by all rays. Not thread-safe.
+   */
+  virtual void SetInputImage( const InputImageType * ptr );
+
   /** Connect the Transform. */
   itkSetObjectMacro( Transform, TransformType );
   /** Get a pointer to the Transform.  */
@@ -208,6 +213,12 @@ protected:
   /// Pointer to the interpolator
   InterpolatorPointer m_Interpolator;
 
+  /// The bounding planes and corners of the input volume, see SetInputImage()
+  double                 m_BoundingPlane[ 6 ][ 4 ];
+  double                 m_BoundingCorner[ 8 ][ 3 ];
+  const InputImageType * m_VolumeGeometryImage;
+  ModifiedTimeType       m_VolumeGeometryMTime;
+
 private:
 
   AdvancedRayCastInterpolateImageFunction( const Self & ); // purposely not implemented
@@ -37,6 +37,7 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
 
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 // Put the helper class in an anonymous namespace so that it is not
 // exposed to the user
@@ -167,6 +168,17 @@ public:
   /// Initialise the object
   void Initialise( void );
 
+  /** Initialise the object from the volume geometry of an earlier
+   * Initialise() for the same image, which saves the computation of the
+   * bounding planes for every ray.
+   */
+  void InitialiseFromVolumeGeometry(
+    const double boundingPlane[ 6 ][ 4 ], const double boundingCorner[ 8 ][ 3 ] );
+
+  /// Get the volume geometry computed by Initialise()
+  void GetVolumeGeometry(
+    double boundingPlane[ 6 ][ 4 ], double boundingCorner[ 8 ][ 3 ] ) const;
+
 protected:
 
   /// Calculate the endpoint coordinats of the ray in voxels.
@@ -349,6 +361,38 @@ RayCastHelper< TInputImage, TCoordRep >
 }
 
 
+/* -----------------------------------------------------------------------
+   InitialiseFromVolumeGeometry() - Initialise from a cached geometry
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+RayCastHelper< TInputImage, TCoordRep >
+::InitialiseFromVolumeGeometry(
+  const double boundingPlane[ 6 ][ 4 ], const double boundingCorner[ 8 ][ 3 ] )
+{
+  this->RecordVolumeDimensions();
+
+  std::copy( &boundingPlane[ 0 ][ 0 ], &boundingPlane[ 0 ][ 0 ] + 6 * 4, &m_BoundingPlane[ 0 ][ 0 ] );
+  std::copy( &boundingCorner[ 0 ][ 0 ], &boundingCorner[ 0 ][ 0 ] + 8 * 3, &m_BoundingCorner[ 0 ][ 0 ] );
+}
+
+
+/* -----------------------------------------------------------------------
+   GetVolumeGeometry() - Get the planes and corners of the volume
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+RayCastHelper< TInputImage, TCoordRep >
+::GetVolumeGeometry(
+  double boundingPlane[ 6 ][ 4 ], double boundingCorner[ 8 ][ 3 ] ) const
+{
+  std::copy( &m_BoundingPlane[ 0 ][ 0 ], &m_BoundingPlane[ 0 ][ 0 ] + 6 * 4, &boundingPlane[ 0 ][ 0 ] );
+  std::copy( &m_BoundingCorner[ 0 ][ 0 ], &m_BoundingCorner[ 0 ][ 0 ] + 8 * 3, &boundingCorner[ 0 ][ 0 ] );
+}
+
+
 /* -----------------------------------------------------------------------
    RecordVolumeDimensions() - Record volume dimensions and resolution
    ----------------------------------------------------------------------- */
@@ -1414,20 +1458,97 @@ RayCastHelper< TInputImage, TCoordRep >
   {
     return false;
   }
-  /* Step along the ray as quickly as possible
-     integrating the interpolated intensities. */
+
+  /* The two in-plane axes of the bilinear interpolation. The traversal
+     direction is fixed along the ray, so this is decided once per ray
+     instead of once per plane as in GetCurrentIntensity(). */
+
+  unsigned int ay, az;
+  switch( m_TraversalDirection )
+  {
+    case TRANSVERSE_IN_X:
+      ay = 1; az = 2;
+      break;
+    case TRANSVERSE_IN_Y:
+      ay = 0; az = 2;
+      break;
+    case TRANSVERSE_IN_Z:
+      ay = 0; az = 1;
+      break;
+    default:
+    {
+      itk::ExceptionObject err( __FILE__, __LINE__ );
+      err.SetLocation( ITK_LOCATION );
+      err.SetDescription( "The ray traversal direction is unset "
+        "- IntegrateAboveThreshold()." );
+      throw err;
+    }
+  }
+
+  /* Step along the ray as quickly as possible integrating the interpolated
+     intensities. The loop is GetCurrentIntensity() followed by
+     IncrementVoxelPointers(), on local copies of the ray state. */
+
+  const PixelType * voxel0 = m_RayIntersectionVoxels[ 0 ];
+  const PixelType * voxel1 = m_RayIntersectionVoxels[ 1 ];
+  const PixelType * voxel2 = m_RayIntersectionVoxels[ 2 ];
+  const PixelType * voxel3 = m_RayIntersectionVoxels[ 3 ];
+  double            position[ 3 ];
+  position[ 0 ] = m_Position3Dvox[ 0 ];
+  position[ 1 ] = m_Position3Dvox[ 1 ];
+  position[ 2 ] = m_Position3Dvox[ 2 ];
+  int        voxelStep[ 3 ] = { 0, 0, 0 };
+  const int  strideY        = m_NumberOfVoxelsInX;
+  const int  strideZ        = m_NumberOfVoxelsInX * m_NumberOfVoxelsInY;
 
   for( m_NumVoxelPlanesTraversed = 0;
     m_NumVoxelPlanesTraversed < m_TotalRayVoxelPlanes;
     m_NumVoxelPlanesTraversed++ )
   {
-    intensity = this->GetCurrentIntensity();
-
+    const double a = (double)( *voxel0 );
+    const double b = (double)( *voxel1 - a );
+    const double c = (double)( *voxel2 - a );
+    const double d = (double)( *voxel3 - a - b - c );
+    const double y = position[ ay ] - vcl_floor( position[ ay ] );
+    const double z = position[ az ] - vcl_floor( position[ az ] );
+
+    intensity = a + b * y + c * z + d * y * z;
     if( intensity > threshold )
     {
       integral += intensity - threshold;
     }
-    this->IncrementVoxelPointers();
+
+    const double xBefore = position[ 0 ];
+    const double yBefore = position[ 1 ];
+    const double zBefore = position[ 2 ];
+    position[ 0 ] += m_VoxelIncrement[ 0 ];
+    position[ 1 ] += m_VoxelIncrement[ 1 ];
+    position[ 2 ] += m_VoxelIncrement[ 2 ];
+
+    const int dx = ( (int)position[ 0 ] ) - ( (int)xBefore );
+    const int dy = ( (int)position[ 1 ] ) - ( (int)yBefore );
+    const int dz = ( (int)position[ 2 ] ) - ( (int)zBefore );
+    voxelStep[ 0 ] += dx;
+    voxelStep[ 1 ] += dy;
+    voxelStep[ 2 ] += dz;
+
+    const int offset = dx + dy * strideY + dz * strideZ;
+    voxel0 += offset;
+    voxel1 += offset;
+    voxel2 += offset;
+    voxel3 += offset;
+  }
+
+  /* Store the state at the end of the ray. */
+
+  m_RayIntersectionVoxels[ 0 ] = voxel0;
+  m_RayIntersectionVoxels[ 1 ] = voxel1;
+  m_RayIntersectionVoxels[ 2 ] = voxel2;
+  m_RayIntersectionVoxels[ 3 ] = voxel3;
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    m_Position3Dvox[ i ]              = position[ i ];
+    m_RayIntersectionVoxelIndex[ i ] += voxelStep[ i ];
   }
 
   /* The ray passes through the volume one plane of voxels at a time,
@@ -1524,6 +1645,37 @@ AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
   m_FocalPoint[ 0 ] = 0.;
   m_FocalPoint[ 1 ] = 0.;
   m_FocalPoint[ 2 ] = 0.;
+
+  m_VolumeGeometryImage = 0;
+  m_VolumeGeometryMTime = 0;
+}
+
+
+/* -----------------------------------------------------------------------
+   SetInputImage
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
+::SetInputImage( const InputImageType * ptr )
+{
+  this->Superclass::SetInputImage( ptr );
+
+  /* Compute the bounding planes of the volume once, instead of for every
+     ray. The resample filter sets the input image before its threads start. */
+  m_VolumeGeometryImage = 0;
+  if( ptr != 0 )
+  {
+    RayCastHelper< TInputImage, TCoordRep > ray;
+    ray.SetImage( ptr );
+    ray.ZeroState();
+    ray.Initialise();
+    ray.GetVolumeGeometry( m_BoundingPlane, m_BoundingCorner );
+
+    m_VolumeGeometryImage = ptr;
+    m_VolumeGeometryMTime = ptr->GetMTime();
+  }
 }
 
 
@@ -1566,7 +1718,15 @@ AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
   RayCastHelper< TInputImage, TCoordRep > ray;
   ray.SetImage( this->m_Image );
   ray.ZeroState();
-  ray.Initialise();
+  if( this->m_VolumeGeometryImage == this->m_Image.GetPointer()
+    && this->m_VolumeGeometryMTime == this->m_Image->GetMTime() )
+  {
+    ray.InitialiseFromVolumeGeometry( this->m_BoundingPlane, this->m_BoundingCorner );
+  }
+  else
+  {
+    ray.Initialise();
+  }
 
   ray.SetRay( point, direction );
   ray.IntegrateAboveThreshold( integral, m_Threshold );
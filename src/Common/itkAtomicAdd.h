@@ -0,0 +1,86 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAtomicAdd_h
+#define __itkAtomicAdd_h
+
+#include "itkIntTypes.h"
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#pragma intrinsic( _InterlockedCompareExchange64 )
+#endif
+
+#include <cstring>
+
+/** ELASTIX_HAVE_ATOMIC_ADD is defined to 1 when AtomicAdd() is lock-free on
+ * this compiler, and to 0 otherwise. Code that depends on atomic adds for
+ * performance should check it and use another strategy when it is 0.
+ */
+#if defined( _MSC_VER ) || defined( __GNUC__ )
+#define ELASTIX_HAVE_ATOMIC_ADD 1
+#else
+#define ELASTIX_HAVE_ATOMIC_ADD 0
+#endif
+
+namespace itk
+{
+
+/** Atomically add value to *address, i.e. *address += value, such that
+ * concurrent adds to the same address from different threads are not lost.
+ *
+ * There are no atomic floating point instructions, so the add is done in
+ * a compare-and-swap loop on the 64-bit representation of the double. The
+ * order in which concurrent adds are applied is undefined, so the result
+ * is only reproducible up to floating point round-off.
+ *
+ * When ELASTIX_HAVE_ATOMIC_ADD is 0 this function is a plain, non-atomic add.
+ */
+inline void
+AtomicAdd( double * address, const double value )
+{
+#if ELASTIX_HAVE_ATOMIC_ADD
+  volatile int64_t * target = reinterpret_cast< volatile int64_t * >( address );
+  int64_t            expected = *target;
+  for( ;; )
+  {
+    double current;
+    std::memcpy( &current, &expected, sizeof( double ) );
+    const double sum = current + value;
+    int64_t      desired;
+    std::memcpy( &desired, &sum, sizeof( double ) );
+#if defined( _MSC_VER )
+    const int64_t previous = _InterlockedCompareExchange64(
+      reinterpret_cast< volatile __int64 * >( target ), desired, expected );
+#else
+    const int64_t previous = __sync_val_compare_and_swap( target, expected, desired );
+#endif
+    if( previous == expected )
+    {
+      return;
+    }
+    expected = previous;
+  }
+#else
+  *address += value;
+#endif
+}
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkAtomicAdd_h
@@ -0,0 +1,62 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef __itkBSplineCoefficientImageProvider_h
+#define __itkBSplineCoefficientImageProvider_h
+
+namespace itk
+{
+
+/**
+ * \class BSplineCoefficientImageProvider
+ * \brief Interface of interpolators that give access to the B-spline
+ * coefficients they computed for their input image.
+ *
+ * itk::BSplineInterpolateImageFunction keeps its coefficients protected.
+ * Interpolators that derive from it can also derive from this class, so
+ * that users like AdvancedImageToImageMetric reuse the coefficients instead
+ * of running the B-spline decomposition of the same image again.
+ *
+ * \ingroup Interpolators
+ */
+
+template< class TCoefficientImage >
+class BSplineCoefficientImageProvider
+{
+public:
+
+  typedef TCoefficientImage CoefficientImageType;
+
+  /** The coefficients of the current input image, or 0 when there are none. */
+  virtual const CoefficientImageType * GetBSplineCoefficientImage( void ) const = 0;
+
+protected:
+
+  BSplineCoefficientImageProvider() {}
+  virtual ~BSplineCoefficientImageProvider() {}
+
+private:
+
+  BSplineCoefficientImageProvider( const BSplineCoefficientImageProvider & ); // purposely not implemented
+  void operator=( const BSplineCoefficientImageProvider & );                  // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBSplineCoefficientImageProvider_h
@@ -0,0 +1,300 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBackgroundWriter.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <fstream>
+
+namespace itk
+{
+
+/** Variables for the process-wide writer. */
+static BackgroundWriter::Pointer GlobalBackgroundWriter;
+static SimpleFastMutexLock       GlobalBackgroundWriterMutex;
+
+/**
+ * ****************** TextFileTask::Execute *********************************
+ */
+
+void
+BackgroundWriter::TextFileTask
+::Execute( void )
+{
+  std::ofstream file( this->m_FileName.c_str() );
+  if( !file.is_open() )
+  {
+    itkGenericExceptionMacro( << "ERROR: File \"" << this->m_FileName << "\" could not be opened!" );
+  }
+  file << this->m_Text;
+  if( !file )
+  {
+    itkGenericExceptionMacro( << "ERROR: File \"" << this->m_FileName << "\" could not be written!" );
+  }
+
+} // end TextFileTask::Execute()
+
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+BackgroundWriter
+::BackgroundWriter()
+{
+  this->m_MaximumNumberOfWorkers      = 1;
+  this->m_MaximumNumberOfPendingTasks = 2;
+  this->m_Spawner                     = MultiThreader::New();
+  this->m_TaskAvailable               = ConditionVariable::New();
+  this->m_TaskFinished                = ConditionVariable::New();
+  this->m_NumberOfRunningTasks        = 0;
+  this->m_Terminate                   = false;
+
+  this->StartWorkers();
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+BackgroundWriter
+::~BackgroundWriter()
+{
+  this->WaitForAllTasks();
+  this->StopWorkers();
+
+} // end Destructor
+
+
+/**
+ * ****************** GetGlobalBackgroundWriter *********************************
+ */
+
+BackgroundWriter *
+BackgroundWriter
+::GetGlobalBackgroundWriter( void )
+{
+  GlobalBackgroundWriterMutex.Lock();
+  if( GlobalBackgroundWriter.IsNull() )
+  {
+    GlobalBackgroundWriter = Self::New();
+  }
+  GlobalBackgroundWriterMutex.Unlock();
+
+  return GlobalBackgroundWriter.GetPointer();
+
+} // end GetGlobalBackgroundWriter()
+
+
+/**
+ * ****************** SetMaximumNumberOfWorkers *********************************
+ */
+
+void
+BackgroundWriter
+::SetMaximumNumberOfWorkers( ThreadIdType numberOfWorkers )
+{
+  if( numberOfWorkers < 1 ) { numberOfWorkers = 1; }
+  if( this->m_MaximumNumberOfWorkers == numberOfWorkers ) { return; }
+
+  this->WaitForAllTasks();
+  this->StopWorkers();
+  this->m_MaximumNumberOfWorkers = numberOfWorkers;
+  this->StartWorkers();
+  this->Modified();
+
+} // end SetMaximumNumberOfWorkers()
+
+
+/**
+ * ****************** StartWorkers *********************************
+ */
+
+void
+BackgroundWriter
+::StartWorkers( void )
+{
+  this->m_Terminate = false;
+  this->m_SpawnedThreadIds.clear();
+  for( ThreadIdType i = 0; i < this->m_MaximumNumberOfWorkers; ++i )
+  {
+    this->m_SpawnedThreadIds.push_back( this->m_Spawner->SpawnThread(
+      Self::WorkerThreadCallback, this ) );
+  }
+
+} // end StartWorkers()
+
+
+/**
+ * ****************** StopWorkers *********************************
+ */
+
+void
+BackgroundWriter
+::StopWorkers( void )
+{
+  this->m_Mutex.Lock();
+  this->m_Terminate = true;
+  this->m_TaskAvailable->Broadcast();
+  this->m_Mutex.Unlock();
+
+  /** TerminateThread() joins the thread. */
+  for( std::size_t i = 0; i < this->m_SpawnedThreadIds.size(); ++i )
+  {
+    this->m_Spawner->TerminateThread( this->m_SpawnedThreadIds[ i ] );
+  }
+  this->m_SpawnedThreadIds.clear();
+
+} // end StopWorkers()
+
+
+/**
+ * ****************** Submit *********************************
+ */
+
+void
+BackgroundWriter
+::Submit( Task * task )
+{
+  this->m_Mutex.Lock();
+  while( this->m_Tasks.size() >= this->m_MaximumNumberOfPendingTasks )
+  {
+    this->m_TaskFinished->Wait( &this->m_Mutex );
+  }
+  this->m_Tasks.push_back( task );
+  this->m_TaskAvailable->Signal();
+  this->m_Mutex.Unlock();
+
+} // end Submit()
+
+
+/**
+ * ****************** WaitForAllTasks *********************************
+ */
+
+std::vector< std::string >
+BackgroundWriter
+::WaitForAllTasks( void )
+{
+  this->m_Mutex.Lock();
+  while( !this->m_Tasks.empty() || this->m_NumberOfRunningTasks > 0 )
+  {
+    this->m_TaskFinished->Wait( &this->m_Mutex );
+  }
+  std::vector< std::string > errorMessages;
+  errorMessages.swap( this->m_ErrorMessages );
+  this->m_Mutex.Unlock();
+
+  return errorMessages;
+
+} // end WaitForAllTasks()
+
+
+/**
+ * ****************** WorkerThreadCallback *********************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+BackgroundWriter
+::WorkerThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  static_cast< Self * >( infoStruct->UserData )->WorkerLoop();
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WorkerThreadCallback()
+
+
+/**
+ * ****************** WorkerLoop *********************************
+ */
+
+void
+BackgroundWriter
+::WorkerLoop( void )
+{
+  this->m_Mutex.Lock();
+  while( true )
+  {
+    /** Sleep until there is a task, or until we should stop. The queue is
+     * emptied before stopping. */
+    while( !this->m_Terminate && this->m_Tasks.empty() )
+    {
+      this->m_TaskAvailable->Wait( &this->m_Mutex );
+    }
+    if( this->m_Tasks.empty() ) { break; }
+
+    Task * task = this->m_Tasks.front();
+    this->m_Tasks.pop_front();
+    ++this->m_NumberOfRunningTasks;
+    this->m_Mutex.Unlock();
+
+    std::string errorMessage;
+    try
+    {
+      task->Execute();
+    }
+    catch( ExceptionObject & excp )
+    {
+      errorMessage = excp.GetDescription();
+    }
+    catch( std::exception & excp )
+    {
+      errorMessage = excp.what();
+    }
+    catch( ... )
+    {
+      errorMessage = "Unknown exception in a background write.";
+    }
+    delete task;
+
+    this->m_Mutex.Lock();
+    --this->m_NumberOfRunningTasks;
+    if( !errorMessage.empty() )
+    {
+      this->m_ErrorMessages.push_back( errorMessage );
+    }
+    this->m_TaskFinished->Broadcast();
+  }
+  this->m_Mutex.Unlock();
+
+} // end WorkerLoop()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+BackgroundWriter
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumNumberOfWorkers: " << this->m_MaximumNumberOfWorkers << std::endl;
+  os << indent << "MaximumNumberOfPendingTasks: " << this->m_MaximumNumberOfPendingTasks << std::endl;
+  os << indent << "NumberOfPendingTasks: " << this->m_Tasks.size() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
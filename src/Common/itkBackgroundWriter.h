@@ -0,0 +1,159 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBackgroundWriter_h
+#define __itkBackgroundWriter_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BackgroundWriter
+ *
+ * \brief Writes files in background threads, with bounded concurrency.
+ *
+ * Intermediate results, such as the result image after every iteration or
+ * the transform parameter file of every resolution, need not be written
+ * before the registration continues. The caller captures what is to be
+ * written in a Task, for example a disconnected copy of an image, and
+ * submits it. At most MaximumNumberOfWorkers tasks run at the same time,
+ * and Submit() blocks while MaximumNumberOfPendingTasks tasks are queued,
+ * so that the memory held by the snapshots stays bounded.
+ *
+ * Tasks must not use the xout logging, which is not thread-safe. The
+ * messages of the exceptions thrown by the tasks are collected, and
+ * returned by WaitForAllTasks().
+ *
+ * A process-wide writer is available through GetGlobalBackgroundWriter().
+ *
+ * \ingroup ITKCommon
+ */
+
+class BackgroundWriter : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef BackgroundWriter           Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BackgroundWriter, Object );
+
+  /** A unit of work; deleted by the writer after Execute(). */
+  class Task
+  {
+public:
+
+    virtual ~Task() {}
+    virtual void Execute( void ) = 0;
+
+  };
+
+  /** A task that writes a string to a text file. */
+  class TextFileTask : public Task
+  {
+public:
+
+    TextFileTask( const std::string & fileName, const std::string & text ) :
+      m_FileName( fileName ), m_Text( text ) {}
+    virtual void Execute( void );
+
+private:
+
+    std::string m_FileName;
+    std::string m_Text;
+
+  };
+
+  /** Get the process-wide writer, which is created on first use. */
+  static Self * GetGlobalBackgroundWriter( void );
+
+  /** Set/Get the number of worker threads. Changing it waits for all
+   * tasks. Default: 1. */
+  virtual void SetMaximumNumberOfWorkers( ThreadIdType numberOfWorkers );
+  itkGetConstMacro( MaximumNumberOfWorkers, ThreadIdType );
+
+  /** Set/Get the maximum number of queued tasks. Default: 2. */
+  itkSetClampMacro( MaximumNumberOfPendingTasks, SizeValueType,
+    1, NumericTraits< SizeValueType >::max() );
+  itkGetConstMacro( MaximumNumberOfPendingTasks, SizeValueType );
+
+  /** Queue a task; the writer takes ownership. Blocks while the queue is
+   * full. */
+  void Submit( Task * task );
+
+  /** Block until all submitted tasks are finished. Returns the messages of
+   * the tasks that failed since the previous call. */
+  std::vector< std::string > WaitForAllTasks( void );
+
+protected:
+
+  BackgroundWriter();
+  virtual ~BackgroundWriter();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Start and stop the worker threads. */
+  void StartWorkers( void );
+  void StopWorkers( void );
+
+  /** The function executed by the workers. */
+  static ITK_THREAD_RETURN_TYPE WorkerThreadCallback( void * arg );
+
+  /** The main loop of a worker thread. */
+  void WorkerLoop( void );
+
+private:
+
+  BackgroundWriter( const Self & ); // purposely not implemented
+  void operator=( const Self & );   // purposely not implemented
+
+  ThreadIdType                m_MaximumNumberOfWorkers;
+  SizeValueType               m_MaximumNumberOfPendingTasks;
+  MultiThreader::Pointer      m_Spawner;
+  std::vector< ThreadIdType > m_SpawnedThreadIds;
+
+  /** The queue, and the synchronization of the workers. */
+  SimpleMutexLock            m_Mutex;
+  ConditionVariable::Pointer m_TaskAvailable;
+  ConditionVariable::Pointer m_TaskFinished;
+  std::deque< Task * >       m_Tasks;
+  SizeValueType              m_NumberOfRunningTasks;
+  bool                       m_Terminate;
+  std::vector< std::string > m_ErrorMessages;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBackgroundWriter_h
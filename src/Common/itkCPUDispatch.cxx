@@ -0,0 +1,326 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCPUDispatch_cxx
+#define __itkCPUDispatch_cxx
+
+#include "itkCPUDispatch.h"
+
+#if defined( ELASTIX_USE_CPU_DISPATCH ) && defined( _MSC_VER )
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+/** The generic variant of the kernels, compiled with the default flags. */
+#define elxCPUDispatchVariant Generic
+#include "itkCPUDispatchKernels.hxx"
+#undef elxCPUDispatchVariant
+
+namespace itk
+{
+
+namespace CPUDispatchKernels
+{
+
+#ifdef ELASTIX_USE_CPU_DISPATCH
+/** The variants in itkCPUDispatch<Variant>.cxx. */
+#define elxDeclareCPUDispatchVariant( variant ) \
+  namespace variant \
+  { \
+  void SubtractScaled( double * y, const double * x, const double a, const SizeValueType n ); \
+  double Dot( const double * x, const double * y, const SizeValueType n ); \
+  double Dot( const float * x, const double * y, const SizeValueType n ); \
+  double AddScaledAndDot( double * r, const double * x, const double a, \
+    const double * z, const SizeValueType n ); \
+  double AddScaledAndDot( double * r, const float * x, const double a, \
+    const float * z, const SizeValueType n ); \
+  double MultiplyAndDot( double * r, const double * h, const double * z, \
+    const SizeValueType n ); \
+  double MultiplyAndDot( double * r, const double * h, const float * z, \
+    const SizeValueType n ); \
+  }
+
+elxDeclareCPUDispatchVariant( SSE42 )
+elxDeclareCPUDispatchVariant( AVX2 )
+elxDeclareCPUDispatchVariant( AVX512 )
+
+#undef elxDeclareCPUDispatchVariant
+#endif
+
+/** The selected variant, as a table of function pointers. */
+struct KernelTable
+{
+  void ( *SubtractScaled )( double *, const double *, const double, const SizeValueType );
+  double ( *Dot )( const double *, const double *, const SizeValueType );
+  double ( *DotFloat )( const float *, const double *, const SizeValueType );
+  double ( *AddScaledAndDot )( double *, const double *, const double,
+    const double *, const SizeValueType );
+  double ( *AddScaledAndDotFloat )( double *, const float *, const double,
+    const float *, const SizeValueType );
+  double ( *MultiplyAndDot )( double *, const double *, const double *,
+    const SizeValueType );
+  double ( *MultiplyAndDotFloat )( double *, const double *, const float *,
+    const SizeValueType );
+  CPUDispatch::InstructionSetType InstructionSet;
+};
+
+/** Fill the table with the kernels of one variant. The casts select the
+ * overloads. */
+#define elxSetCPUDispatchKernels( table, variant, instructionSet ) \
+  table.SubtractScaled       = variant::SubtractScaled; \
+  table.Dot                  = static_cast< double ( * )( const double *, const double *, \
+    const SizeValueType ) >( variant::Dot ); \
+  table.DotFloat             = static_cast< double ( * )( const float *, const double *, \
+    const SizeValueType ) >( variant::Dot ); \
+  table.AddScaledAndDot      = static_cast< double ( * )( double *, const double *, \
+    const double, const double *, const SizeValueType ) >( variant::AddScaledAndDot ); \
+  table.AddScaledAndDotFloat = static_cast< double ( * )( double *, const float *, \
+    const double, const float *, const SizeValueType ) >( variant::AddScaledAndDot ); \
+  table.MultiplyAndDot       = static_cast< double ( * )( double *, const double *, \
+    const double *, const SizeValueType ) >( variant::MultiplyAndDot ); \
+  table.MultiplyAndDotFloat  = static_cast< double ( * )( double *, const double *, \
+    const float *, const SizeValueType ) >( variant::MultiplyAndDot ); \
+  table.InstructionSet       = instructionSet;
+
+static KernelTable
+SelectKernels( void )
+{
+  KernelTable table;
+  elxSetCPUDispatchKernels( table, Generic, CPUDispatch::Generic );
+
+#ifdef ELASTIX_USE_CPU_DISPATCH
+  switch( CPUDispatch::GetSupportedInstructionSet() )
+  {
+    case CPUDispatch::AVX512:
+      elxSetCPUDispatchKernels( table, AVX512, CPUDispatch::AVX512 );
+      break;
+    case CPUDispatch::AVX2:
+      elxSetCPUDispatchKernels( table, AVX2, CPUDispatch::AVX2 );
+      break;
+    case CPUDispatch::SSE42:
+      elxSetCPUDispatchKernels( table, SSE42, CPUDispatch::SSE42 );
+      break;
+    default:
+      break;
+  }
+#endif
+
+  return table;
+
+} // end SelectKernels()
+
+#undef elxSetCPUDispatchKernels
+
+
+/** The table is filled during static initialization, before main(), so
+ * before any thread can call a kernel.
+ */
+static const KernelTable Kernels = SelectKernels();
+
+} // end namespace CPUDispatchKernels
+
+
+/**
+ * ****************** GetSupportedInstructionSet *********************************
+ */
+
+CPUDispatch::InstructionSetType
+CPUDispatch
+::GetSupportedInstructionSet( void )
+{
+#if defined( ELASTIX_USE_CPU_DISPATCH ) && defined( _MSC_VER )
+  int info[ 4 ];
+  __cpuid( info, 0 );
+  const int maximumLeaf = info[ 0 ];
+  if( maximumLeaf < 1 )
+  {
+    return Generic;
+  }
+
+  __cpuid( info, 1 );
+  const bool sse42   = ( info[ 2 ] & ( 1 << 20 ) ) != 0;
+  const bool fma     = ( info[ 2 ] & ( 1 << 12 ) ) != 0;
+  const bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+  if( !sse42 )
+  {
+    return Generic;
+  }
+  if( !osxsave || maximumLeaf < 7 )
+  {
+    return SSE42;
+  }
+
+  /** The operating system must save the AVX (and AVX-512) registers. */
+  const unsigned __int64 xcr0 = _xgetbv( 0 );
+  __cpuidex( info, 7, 0 );
+  const bool avx2    = ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+  const bool avx512f = ( info[ 1 ] & ( 1 << 16 ) ) != 0;
+  if( avx512f && ( xcr0 & 0xe6 ) == 0xe6 )
+  {
+    return AVX512;
+  }
+  if( avx2 && fma && ( xcr0 & 0x6 ) == 0x6 )
+  {
+    return AVX2;
+  }
+  return SSE42;
+#elif defined( ELASTIX_USE_CPU_DISPATCH ) && defined( __GNUC__ )
+  /** This also checks that the operating system supports the registers. */
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) )
+  {
+    return AVX512;
+  }
+  if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+  {
+    return AVX2;
+  }
+  if( __builtin_cpu_supports( "sse4.2" ) )
+  {
+    return SSE42;
+  }
+  return Generic;
+#else
+  return Generic;
+#endif
+
+} // end GetSupportedInstructionSet()
+
+
+/**
+ * ****************** GetInstructionSet *********************************
+ */
+
+CPUDispatch::InstructionSetType
+CPUDispatch
+::GetInstructionSet( void )
+{
+  return CPUDispatchKernels::Kernels.InstructionSet;
+
+} // end GetInstructionSet()
+
+
+/**
+ * ****************** GetInstructionSetName *********************************
+ */
+
+const char *
+CPUDispatch
+::GetInstructionSetName( const InstructionSetType instructionSet )
+{
+  switch( instructionSet )
+  {
+    case SSE42:
+      return "SSE4.2";
+    case AVX2:
+      return "AVX2";
+    case AVX512:
+      return "AVX-512";
+    default:
+      return "generic";
+  }
+
+} // end GetInstructionSetName()
+
+
+/**
+ * ****************** SubtractScaled *********************************
+ */
+
+void
+CPUDispatch
+::SubtractScaled( double * y, const double * x, const double a,
+  const SizeValueType n )
+{
+  CPUDispatchKernels::Kernels.SubtractScaled( y, x, a, n );
+
+} // end SubtractScaled()
+
+
+/**
+ * ****************** Dot *********************************
+ */
+
+double
+CPUDispatch
+::Dot( const double * x, const double * y, const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.Dot( x, y, n );
+
+} // end Dot()
+
+
+double
+CPUDispatch
+::Dot( const float * x, const double * y, const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.DotFloat( x, y, n );
+
+} // end Dot()
+
+
+/**
+ * ****************** AddScaledAndDot *********************************
+ */
+
+double
+CPUDispatch
+::AddScaledAndDot( double * r, const double * x, const double a,
+  const double * z, const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.AddScaledAndDot( r, x, a, z, n );
+
+} // end AddScaledAndDot()
+
+
+double
+CPUDispatch
+::AddScaledAndDot( double * r, const float * x, const double a,
+  const float * z, const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.AddScaledAndDotFloat( r, x, a, z, n );
+
+} // end AddScaledAndDot()
+
+
+/**
+ * ****************** MultiplyAndDot *********************************
+ */
+
+double
+CPUDispatch
+::MultiplyAndDot( double * r, const double * h, const double * z,
+  const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.MultiplyAndDot( r, h, z, n );
+
+} // end MultiplyAndDot()
+
+
+double
+CPUDispatch
+::MultiplyAndDot( double * r, const double * h, const float * z,
+  const SizeValueType n )
+{
+  return CPUDispatchKernels::Kernels.MultiplyAndDotFloat( r, h, z, n );
+
+} // end MultiplyAndDot()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkCPUDispatch_cxx
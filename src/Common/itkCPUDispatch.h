@@ -0,0 +1,101 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCPUDispatch_h
+#define __itkCPUDispatch_h
+
+#include "itkIntTypes.h"
+
+namespace itk
+{
+
+/** \class CPUDispatch
+ *
+ * \brief Selects, at run time, the variant of the hot kernels that fits the CPU.
+ *
+ * With the CMake option ELASTIX_USE_CPU_DISPATCH the kernels declared here
+ * are compiled several times, for SSE4.2, AVX2 and AVX-512, next to a
+ * generic variant. The best variant that the CPU and the operating system
+ * support is selected on first use, so one binary runs on a mixed fleet
+ * of x86 machines. Without the option, or on other processors, only the
+ * generic variant is built.
+ *
+ * The variants are compiled without floating point contraction, so they
+ * give bitwise the same results.
+ *
+ * \ingroup ITKCommon
+ */
+
+class CPUDispatch
+{
+public:
+
+  /** The instruction sets, from least to most capable. */
+  typedef enum {
+    Generic = 0,
+    SSE42   = 1,
+    AVX2    = 2,
+    AVX512  = 3
+  } InstructionSetType;
+
+  /** The most capable instruction set that the CPU supports. */
+  static InstructionSetType GetSupportedInstructionSet( void );
+
+  /** The instruction set of the kernels in use: the supported one,
+   * limited to the variants that were compiled.
+   */
+  static InstructionSetType GetInstructionSet( void );
+
+  /** A readable name, for the log file. */
+  static const char * GetInstructionSetName( const InstructionSetType instructionSet );
+
+  /** The kernels. */
+
+  /** y[ i ] -= a * x[ i ], as in the gradient descent step. */
+  static void SubtractScaled( double * y, const double * x, const double a,
+    const SizeValueType n );
+
+  /** The sum of x[ i ] * y[ i ]. */
+  static double Dot( const double * x, const double * y, const SizeValueType n );
+
+  /** The sum of x[ i ] * y[ i ], with x in single precision. */
+  static double Dot( const float * x, const double * y, const SizeValueType n );
+
+  /** r[ i ] += a * x[ i ], and return the sum of z[ i ] * r[ i ] with the
+   * updated r, in one pass. This fuses the steps of the L-BFGS two-loop
+   * recursion. When z is NULL only the update is done, and 0 is returned.
+   */
+  static double AddScaledAndDot( double * r, const double * x, const double a,
+    const double * z, const SizeValueType n );
+
+  static double AddScaledAndDot( double * r, const float * x, const double a,
+    const float * z, const SizeValueType n );
+
+  /** r[ i ] *= h[ i ], and return the sum of z[ i ] * r[ i ] with the
+   * updated r, in one pass. When z is NULL only the update is done.
+   */
+  static double MultiplyAndDot( double * r, const double * h, const double * z,
+    const SizeValueType n );
+
+  static double MultiplyAndDot( double * r, const double * h, const float * z,
+    const SizeValueType n );
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkCPUDispatch_h
@@ -0,0 +1,202 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+/** The kernels of the CPUDispatch, as plain loops that the compiler
+ * vectorizes for the instruction set of the translation unit.
+ *
+ * This file is included once per variant, after defining
+ * elxCPUDispatchVariant to the name of the variant's namespace.
+ * It therefore has no include guard.
+ */
+
+#include "itkIntTypes.h"
+
+namespace itk
+{
+namespace CPUDispatchKernels
+{
+namespace elxCPUDispatchVariant
+{
+
+void
+SubtractScaled( double * y, const double * x, const double a, const SizeValueType n )
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    y[ i ] -= a * x[ i ];
+  }
+}
+
+
+double
+Dot( const double * x, const double * y, const SizeValueType n )
+{
+  /** Four partial sums, so that the loop vectorizes without reassociating
+   * floating point additions; the result is the same for every variant.
+   */
+  double       sum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  SizeValueType i       = 0;
+  for( ; i + 4 <= n; i += 4 )
+  {
+    sum[ 0 ] += x[ i ] * y[ i ];
+    sum[ 1 ] += x[ i + 1 ] * y[ i + 1 ];
+    sum[ 2 ] += x[ i + 2 ] * y[ i + 2 ];
+    sum[ 3 ] += x[ i + 3 ] * y[ i + 3 ];
+  }
+  for( ; i < n; ++i )
+  {
+    sum[ 0 ] += x[ i ] * y[ i ];
+  }
+  return ( sum[ 0 ] + sum[ 1 ] ) + ( sum[ 2 ] + sum[ 3 ] );
+}
+
+
+/** The L-BFGS kernels, for a history in double or in single precision. */
+template< class THistoryValue >
+static double
+DotTemplate( const THistoryValue * x, const double * y, const SizeValueType n )
+{
+  double       sum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  SizeValueType i       = 0;
+  for( ; i + 4 <= n; i += 4 )
+  {
+    sum[ 0 ] += x[ i ] * y[ i ];
+    sum[ 1 ] += x[ i + 1 ] * y[ i + 1 ];
+    sum[ 2 ] += x[ i + 2 ] * y[ i + 2 ];
+    sum[ 3 ] += x[ i + 3 ] * y[ i + 3 ];
+  }
+  for( ; i < n; ++i )
+  {
+    sum[ 0 ] += x[ i ] * y[ i ];
+  }
+  return ( sum[ 0 ] + sum[ 1 ] ) + ( sum[ 2 ] + sum[ 3 ] );
+}
+
+
+template< class THistoryValue >
+static double
+AddScaledAndDotTemplate( double * r, const THistoryValue * x, const double a,
+  const THistoryValue * z, const SizeValueType n )
+{
+  if( z == 0 )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      r[ i ] += a * x[ i ];
+    }
+    return 0.0;
+  }
+
+  double       sum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  SizeValueType i       = 0;
+  for( ; i + 4 <= n; i += 4 )
+  {
+    r[ i ]     += a * x[ i ];
+    r[ i + 1 ] += a * x[ i + 1 ];
+    r[ i + 2 ] += a * x[ i + 2 ];
+    r[ i + 3 ] += a * x[ i + 3 ];
+    sum[ 0 ]   += z[ i ] * r[ i ];
+    sum[ 1 ]   += z[ i + 1 ] * r[ i + 1 ];
+    sum[ 2 ]   += z[ i + 2 ] * r[ i + 2 ];
+    sum[ 3 ]   += z[ i + 3 ] * r[ i + 3 ];
+  }
+  for( ; i < n; ++i )
+  {
+    r[ i ]   += a * x[ i ];
+    sum[ 0 ] += z[ i ] * r[ i ];
+  }
+  return ( sum[ 0 ] + sum[ 1 ] ) + ( sum[ 2 ] + sum[ 3 ] );
+}
+
+
+template< class THistoryValue >
+static double
+MultiplyAndDotTemplate( double * r, const double * h, const THistoryValue * z,
+  const SizeValueType n )
+{
+  if( z == 0 )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      r[ i ] *= h[ i ];
+    }
+    return 0.0;
+  }
+
+  double       sum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  SizeValueType i       = 0;
+  for( ; i + 4 <= n; i += 4 )
+  {
+    r[ i ]     *= h[ i ];
+    r[ i + 1 ] *= h[ i + 1 ];
+    r[ i + 2 ] *= h[ i + 2 ];
+    r[ i + 3 ] *= h[ i + 3 ];
+    sum[ 0 ]   += z[ i ] * r[ i ];
+    sum[ 1 ]   += z[ i + 1 ] * r[ i + 1 ];
+    sum[ 2 ]   += z[ i + 2 ] * r[ i + 2 ];
+    sum[ 3 ]   += z[ i + 3 ] * r[ i + 3 ];
+  }
+  for( ; i < n; ++i )
+  {
+    r[ i ]   *= h[ i ];
+    sum[ 0 ] += z[ i ] * r[ i ];
+  }
+  return ( sum[ 0 ] + sum[ 1 ] ) + ( sum[ 2 ] + sum[ 3 ] );
+}
+
+
+double
+Dot( const float * x, const double * y, const SizeValueType n )
+{
+  return DotTemplate( x, y, n );
+}
+
+
+double
+AddScaledAndDot( double * r, const double * x, const double a,
+  const double * z, const SizeValueType n )
+{
+  return AddScaledAndDotTemplate( r, x, a, z, n );
+}
+
+
+double
+AddScaledAndDot( double * r, const float * x, const double a,
+  const float * z, const SizeValueType n )
+{
+  return AddScaledAndDotTemplate( r, x, a, z, n );
+}
+
+
+double
+MultiplyAndDot( double * r, const double * h, const double * z, const SizeValueType n )
+{
+  return MultiplyAndDotTemplate( r, h, z, n );
+}
+
+
+double
+MultiplyAndDot( double * r, const double * h, const float * z, const SizeValueType n )
+{
+  return MultiplyAndDotTemplate( r, h, z, n );
+}
+
+
+} // end namespace elxCPUDispatchVariant
+} // end namespace CPUDispatchKernels
+} // end namespace itk
@@ -0,0 +1,25 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+/** The SSE42 variant of the CPUDispatch kernels. CMake compiles this file
+ * with the flags for SSE42, see ELASTIX_USE_CPU_DISPATCH.
+ */
+
+#define elxCPUDispatchVariant SSE42
+#include "itkCPUDispatchKernels.hxx"
+#undef elxCPUDispatchVariant
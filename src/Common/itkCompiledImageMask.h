@@ -0,0 +1,134 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCompiledImageMask_h
+#define __itkCompiledImageMask_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageMaskSpatialObject2.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class CompiledImageMask
+ *
+ * \brief A flat copy of an ImageMaskSpatialObject2, for fast point queries.
+ *
+ * ImageMaskSpatialObject2::IsInside() tests the bounding box, sets up the
+ * world-to-index transform, transforms the point, and reads the pixel through
+ * the image, on every call. This class does that work once in Compile():
+ * it stores the world bounds of the mask, the world-to-index transform as a
+ * matrix and offset, and the voxels of the axis-aligned bounding box region of
+ * the mask as a packed bit array. IsInside() then gives the same answers as
+ * the spatial object, with a few multiply-adds and a bit lookup.
+ *
+ * Compile() must be called again when the mask changes; IsUpToDate() tells
+ * whether that is needed. A compiled mask may be queried from several threads.
+ *
+ * \ingroup ImageMasks
+ */
+
+template< unsigned int TDimension >
+class CompiledImageMask : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef CompiledImageMask          Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( CompiledImageMask, Object );
+
+  /** Typedefs. */
+  typedef ImageMaskSpatialObject2< TDimension > MaskSpatialObjectType;
+  typedef typename MaskSpatialObjectType::PointType  PointType;
+  typedef typename MaskSpatialObjectType::IndexType  IndexType;
+  typedef typename MaskSpatialObjectType::RegionType RegionType;
+
+  /** Copy the given mask into the lookup structure. */
+  void Compile( const MaskSpatialObjectType * mask );
+
+  /** Whether the structure was compiled from the given mask, and the mask
+   * has not been modified since.
+   */
+  bool IsUpToDate( const MaskSpatialObjectType * mask ) const;
+
+  /** Returns true if the point is inside the mask, like
+   * ImageMaskSpatialObject2::IsInside().
+   */
+  inline bool IsInside( const PointType & point ) const;
+
+  /** Batch query: inside[ i ] = IsInside( points[ i ] ), for i < n. */
+  void IsInside( const PointType * points, const SizeValueType n, bool * inside ) const;
+
+  /** Get the region of the mask image that is stored: the axis-aligned
+   * bounding box region of the nonzero voxels.
+   */
+  itkGetConstReferenceMacro( Region, RegionType );
+
+protected:
+
+  CompiledImageMask();
+  virtual ~CompiledImageMask() {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  CompiledImageMask( const Self & ); // purposely not implemented
+  void operator=( const Self & );    // purposely not implemented
+
+  /** The mask it was compiled from, not reference counted, and its MTime. */
+  const MaskSpatialObjectType * m_Mask;
+  ModifiedTimeType              m_MaskMTime;
+
+  /** False when no voxel is inside, so that IsInside() is always false. */
+  bool m_Valid;
+
+  /** The world bounds, and the world-to-index transform. */
+  double m_BoundsMinimum[ TDimension ];
+  double m_BoundsMaximum[ TDimension ];
+  double m_Matrix[ TDimension ][ TDimension ];
+  double m_Offset[ TDimension ];
+
+  /** The stored region, as start index, size, and strides of the bit array. */
+  RegionType    m_Region;
+  OffsetValueType m_RegionStart[ TDimension ];
+  SizeValueType   m_RegionSize[ TDimension ];
+  SizeValueType   m_RegionStride[ TDimension ];
+
+  /** The voxels of the region, eight per byte. */
+  std::vector< unsigned char > m_Bits;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkCompiledImageMask.hxx"
+#endif
+
+#endif // end #ifndef __itkCompiledImageMask_h
@@ -0,0 +1,238 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCompiledImageMask_hxx
+#define __itkCompiledImageMask_hxx
+
+#include "itkCompiledImageMask.h"
+#include "itkImageRegionConstIterator.h"
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< unsigned int TDimension >
+CompiledImageMask< TDimension >
+::CompiledImageMask()
+{
+  this->m_Mask      = 0;
+  this->m_MaskMTime = 0;
+  this->m_Valid     = false;
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    this->m_BoundsMinimum[ i ] = 0.0;
+    this->m_BoundsMaximum[ i ] = 0.0;
+    this->m_Offset[ i ]        = 0.0;
+    this->m_RegionStart[ i ]   = 0;
+    this->m_RegionSize[ i ]    = 0;
+    this->m_RegionStride[ i ]  = 0;
+    for( unsigned int j = 0; j < TDimension; ++j )
+    {
+      this->m_Matrix[ i ][ j ] = 0.0;
+    }
+  }
+
+} // end Constructor
+
+
+/**
+ * ******************* Compile *******************
+ */
+
+template< unsigned int TDimension >
+void
+CompiledImageMask< TDimension >
+::Compile( const MaskSpatialObjectType * mask )
+{
+  typedef typename MaskSpatialObjectType::ImageType ImageType;
+  typedef ImageRegionConstIterator< ImageType >     IteratorType;
+
+  this->m_Mask      = mask;
+  this->m_MaskMTime = mask ? mask->GetMTime() : 0;
+  this->m_Valid     = false;
+  this->m_Bits.clear();
+  this->Modified();
+
+  if( mask == 0 || mask->GetImage() == 0 )
+  {
+    return;
+  }
+
+  /** Store the world-to-index transform, which is used by IsInside() of the mask. */
+  if( !mask->SetInternalInverseTransformToWorldToIndexTransform() )
+  {
+    return;
+  }
+  const typename MaskSpatialObjectType::TransformType * worldToIndex
+    = mask->GetInternalInverseTransform();
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    this->m_Offset[ i ] = worldToIndex->GetOffset()[ i ];
+    for( unsigned int j = 0; j < TDimension; ++j )
+    {
+      this->m_Matrix[ i ][ j ] = worldToIndex->GetMatrix()( i, j );
+    }
+  }
+
+  /** Store the world bounds, which are tested first by IsInside() of the mask. */
+  const PointType boundsMinimum = mask->GetBounds()->GetMinimum();
+  const PointType boundsMaximum = mask->GetBounds()->GetMaximum();
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    this->m_BoundsMinimum[ i ] = boundsMinimum[ i ];
+    this->m_BoundsMaximum[ i ] = boundsMaximum[ i ];
+  }
+
+  /** Outside the bounding box region all voxels are zero, so only
+   * that region needs to be stored.
+   */
+  const ImageType * image  = mask->GetImage();
+  RegionType        region = mask->GetAxisAlignedBoundingBoxRegion();
+  if( !region.Crop( image->GetBufferedRegion() ) )
+  {
+    return;
+  }
+  this->m_Region = region;
+
+  SizeValueType stride = 1;
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    this->m_RegionStart[ i ]  = region.GetIndex()[ i ];
+    this->m_RegionSize[ i ]   = region.GetSize()[ i ];
+    this->m_RegionStride[ i ] = stride;
+    stride                   *= region.GetSize()[ i ];
+  }
+
+  /** Pack the voxels, in the order of the strides. */
+  this->m_Bits.assign( ( region.GetNumberOfPixels() + 7 ) / 8, 0 );
+  IteratorType  it( image, region );
+  SizeValueType bit = 0;
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++bit )
+  {
+    if( it.Get() != NumericTraits< typename ImageType::PixelType >::ZeroValue() )
+    {
+      this->m_Bits[ bit >> 3 ] |= static_cast< unsigned char >( 1 << ( bit & 7 ) );
+    }
+  }
+
+  this->m_Valid = true;
+
+} // end Compile()
+
+
+/**
+ * ******************* IsUpToDate *******************
+ */
+
+template< unsigned int TDimension >
+bool
+CompiledImageMask< TDimension >
+::IsUpToDate( const MaskSpatialObjectType * mask ) const
+{
+  return mask != 0 && mask == this->m_Mask
+         && mask->GetMTime() == this->m_MaskMTime;
+
+} // end IsUpToDate()
+
+
+/**
+ * ******************* IsInside *******************
+ */
+
+template< unsigned int TDimension >
+bool
+CompiledImageMask< TDimension >
+::IsInside( const PointType & point ) const
+{
+  if( !this->m_Valid )
+  {
+    return false;
+  }
+
+  /** Test the world bounds. */
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    if( point[ i ] < this->m_BoundsMinimum[ i ] || point[ i ] > this->m_BoundsMaximum[ i ] )
+    {
+      return false;
+    }
+  }
+
+  /** Map to the nearest index, and test it against the stored region. */
+  SizeValueType bit = 0;
+  for( unsigned int i = 0; i < TDimension; ++i )
+  {
+    double cindex = this->m_Offset[ i ];
+    for( unsigned int j = 0; j < TDimension; ++j )
+    {
+      cindex += this->m_Matrix[ i ][ j ] * point[ j ];
+    }
+    const OffsetValueType index = static_cast< OffsetValueType >(
+      Math::Round< double >( cindex ) ) - this->m_RegionStart[ i ];
+    if( index < 0 || static_cast< SizeValueType >( index ) >= this->m_RegionSize[ i ] )
+    {
+      return false;
+    }
+    bit += static_cast< SizeValueType >( index ) * this->m_RegionStride[ i ];
+  }
+
+  return ( this->m_Bits[ bit >> 3 ] >> ( bit & 7 ) ) & 1;
+
+} // end IsInside()
+
+
+/**
+ * ******************* IsInside *******************
+ */
+
+template< unsigned int TDimension >
+void
+CompiledImageMask< TDimension >
+::IsInside( const PointType * points, const SizeValueType n, bool * inside ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    inside[ i ] = this->IsInside( points[ i ] );
+  }
+
+} // end IsInside()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< unsigned int TDimension >
+void
+CompiledImageMask< TDimension >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Valid: " << ( this->m_Valid ? "true" : "false" ) << std::endl;
+  os << indent << "Region: " << this->m_Region << std::endl;
+  os << indent << "NumberOfBytes: " << this->m_Bits.size() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkCompiledImageMask_hxx
@@ -0,0 +1,128 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkComputeActiveParameters_h
+#define __itkComputeActiveParameters_h
+
+#include "itkObject.h"
+#include "itkImage.h"
+#include "itkSpatialObject.h"
+
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+/**\class ComputeActiveParameters
+ * \brief Computes the parameters of a transform that can have a nonzero derivative
+ * within the fixed image mask.
+ *
+ * With a transform with a compact support, such as the B-spline, only the
+ * coefficients whose support contains a point inside the fixed image mask can
+ * have a nonzero derivative of a metric that samples inside the mask. The
+ * others can be left out of the vector operations of the optimizer, see
+ * GradientDescentOptimizer2::SetActiveParameterRanges().
+ *
+ * The support regions are evaluated at the voxels of the mask, dilated by one
+ * voxel, so that also the continuous sample positions of the random coordinate
+ * sampler, up to half a voxel away from a voxel inside the mask, are covered.
+ * Transforms without GetHasNonZeroJacobianIndicesDescriptor(), and a missing
+ * mask, give an empty result, which means that all parameters are active.
+ */
+
+template< class TFixedImage, class TTransform >
+class ComputeActiveParameters :
+  public Object
+{
+public:
+
+  /** Standard ITK.*/
+  typedef ComputeActiveParameters    Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ComputeActiveParameters, Object );
+
+  /** typedef  */
+  typedef TFixedImage                         FixedImageType;
+  typedef TTransform                          TransformType;
+  typedef typename TransformType::Pointer     TransformPointer;
+  typedef typename FixedImageType::RegionType FixedImageRegionType;
+
+  itkStaticConstMacro( FixedImageDimension, unsigned int,
+    TFixedImage::ImageDimension );
+  typedef SpatialObject< itkGetStaticConstMacro( FixedImageDimension ) > FixedImageMaskType;
+  typedef typename FixedImageMaskType::ConstPointer                      FixedImageMaskConstPointer;
+
+  /** The active parameters, as sorted, disjoint ranges [ begin, end [. */
+  typedef std::pair< unsigned long, unsigned long > ActiveParameterRangeType;
+  typedef std::vector< ActiveParameterRangeType >   ActiveParameterRangesType;
+
+  /** Set the fixed image. */
+  itkSetConstObjectMacro( FixedImage, FixedImageType );
+
+  /** Set the transform. */
+  itkSetObjectMacro( Transform, TransformType );
+
+  /** Set the fixed image mask. */
+  itkSetConstObjectMacro( FixedImageMask, FixedImageMaskType );
+
+  /** Set the region of the fixed image that the metric uses. */
+  itkSetMacro( FixedImageRegion, FixedImageRegionType );
+
+  /** Compute the ranges of active parameters, and return the number
+   * of active parameters.
+   */
+  virtual unsigned long Compute( ActiveParameterRangesType & ranges );
+
+protected:
+
+  ComputeActiveParameters();
+  virtual ~ComputeActiveParameters() {}
+
+  typedef typename FixedImageType::IndexType              FixedImageIndexType;
+  typedef typename FixedImageType::PointType              FixedImagePointType;
+  typedef typename TransformType::DerivativeType          DerivativeType;
+  typedef typename TransformType::NumberOfParametersType  NumberOfParametersType;
+  typedef typename TransformType::MovingImageGradientType MovingImageGradientType;
+  typedef typename TransformType::NonZeroJacobianIndicesDescriptorType
+    NonZeroJacobianIndicesDescriptorType;
+
+  typename FixedImageType::ConstPointer m_FixedImage;
+  FixedImageRegionType       m_FixedImageRegion;
+  FixedImageMaskConstPointer m_FixedImageMask;
+  TransformPointer           m_Transform;
+
+private:
+
+  ComputeActiveParameters( const Self & ); // purposely not implemented
+  void operator=( const Self & );          // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkComputeActiveParameters.hxx"
+#endif
+
+#endif // end #ifndef __itkComputeActiveParameters_h
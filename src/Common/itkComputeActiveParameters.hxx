@@ -0,0 +1,189 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkComputeActiveParameters_hxx
+#define __itkComputeActiveParameters_hxx
+
+#include "itkComputeActiveParameters.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+namespace itk
+{
+/**
+ * ************************* Constructor ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ComputeActiveParameters< TFixedImage, TTransform >
+::ComputeActiveParameters()
+{
+  this->m_FixedImage     = NULL;
+  this->m_FixedImageMask = NULL;
+  this->m_Transform      = NULL;
+
+} // end Constructor
+
+
+/**
+ * ************************* Compute ************************
+ */
+
+template< class TFixedImage, class TTransform >
+unsigned long
+ComputeActiveParameters< TFixedImage, TTransform >
+::Compute( ActiveParameterRangesType & ranges )
+{
+  ranges.clear();
+  if( this->m_FixedImage.IsNull() || this->m_Transform.IsNull() )
+  {
+    itkExceptionMacro( << "ERROR: the fixed image and the transform should be set." );
+  }
+
+  const unsigned long numberOfParameters = this->m_Transform->GetNumberOfParameters();
+  const unsigned int  dim                = FixedImageDimension;
+  if( this->m_FixedImageMask.IsNull()
+    || !this->m_Transform->GetHasNonZeroJacobianIndicesDescriptor()
+    || numberOfParameters % dim != 0 )
+  {
+    return numberOfParameters;
+  }
+  const unsigned long parametersPerDimension = numberOfParameters / dim;
+
+  /** Flag the voxels inside the mask. */
+  const FixedImageRegionType & region         = this->m_FixedImageRegion;
+  const unsigned long          numberOfPixels = region.GetNumberOfPixels();
+  std::vector< unsigned char > inside( numberOfPixels, 0 );
+  FixedImagePointType          point;
+  typedef ImageRegionConstIteratorWithIndex< FixedImageType > IteratorType;
+  IteratorType it( this->m_FixedImage, region );
+  for( unsigned long i = 0; !it.IsAtEnd(); ++it, ++i )
+  {
+    this->m_FixedImage->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    inside[ i ] = this->m_FixedImageMask->IsInside( point ) ? 1 : 0;
+  }
+
+  /** Dilate by one voxel, one dimension at a time, into the 3^dim neighbourhood. */
+  unsigned long stride = 1;
+  for( unsigned int d = 0; d < dim; ++d )
+  {
+    const unsigned long size = region.GetSize()[ d ];
+    std::vector< unsigned char > dilated( inside );
+    for( unsigned long i = 0; i < numberOfPixels; ++i )
+    {
+      if( !inside[ i ] )
+      {
+        continue;
+      }
+      const unsigned long position = ( i / stride ) % size;
+      if( position > 0 ) { dilated[ i - stride ] = 1; }
+      if( position + 1 < size ) { dilated[ i + stride ] = 1; }
+    }
+    inside.swap( dilated );
+    stride *= size;
+  }
+
+  /** Flag the control points in the supports of the flagged voxels. For
+   * neighbouring voxels in the same grid cell the support is the same, so
+   * it is flagged only once.
+   */
+  std::vector< unsigned char > active( parametersPerDimension, 0 );
+  DerivativeType               imageJacobian( this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
+  MovingImageGradientType      zeroGradient;
+  zeroGradient.Fill( 0.0 );
+  NonZeroJacobianIndicesDescriptorType descriptor;
+  unsigned long                        previousStart = NumericTraits< unsigned long >::max();
+  it.GoToBegin();
+  for( unsigned long i = 0; !it.IsAtEnd(); ++it, ++i )
+  {
+    if( !inside[ i ] )
+    {
+      continue;
+    }
+    this->m_FixedImage->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    this->m_Transform->EvaluateCompactJacobianWithImageGradientProduct(
+      point, zeroGradient, imageJacobian, descriptor );
+
+    /** Outside the valid region of the transform the Jacobian is zero. */
+    if( descriptor.m_ParametersPerDimension != parametersPerDimension
+      || descriptor.m_Start == previousStart )
+    {
+      continue;
+    }
+    previousStart = descriptor.m_Start;
+
+    unsigned long numberOfSupportPoints = 1;
+    for( unsigned int d = 0; d < dim; ++d )
+    {
+      numberOfSupportPoints *= descriptor.m_SupportSize[ d ];
+    }
+    for( unsigned long k = 0; k < numberOfSupportPoints; ++k )
+    {
+      unsigned long index = descriptor.m_Start;
+      unsigned long rest  = k;
+      for( unsigned int d = 0; d < dim; ++d )
+      {
+        index += ( rest % descriptor.m_SupportSize[ d ] ) * descriptor.m_Strides[ d ];
+        rest  /= descriptor.m_SupportSize[ d ];
+      }
+      active[ index ] = 1;
+    }
+  }
+
+  /** Convert the flags to ranges, the same for every dimension. */
+  unsigned long numberOfActiveParameters = 0;
+  for( unsigned int d = 0; d < dim; ++d )
+  {
+    const unsigned long offset = d * parametersPerDimension;
+    for( unsigned long j = 0; j < parametersPerDimension; )
+    {
+      if( !active[ j ] )
+      {
+        ++j;
+        continue;
+      }
+      const unsigned long begin = j;
+      while( j < parametersPerDimension && active[ j ] )
+      {
+        ++j;
+      }
+      if( !ranges.empty() && ranges.back().second == offset + begin )
+      {
+        ranges.back().second = offset + j;
+      }
+      else
+      {
+        ranges.push_back( ActiveParameterRangeType( offset + begin, offset + j ) );
+      }
+      numberOfActiveParameters += j - begin;
+    }
+  }
+
+  /** No active parameters at all is not a useful subset. */
+  if( numberOfActiveParameters == 0 || numberOfActiveParameters == numberOfParameters )
+  {
+    ranges.clear();
+    return numberOfParameters;
+  }
+
+  return numberOfActiveParameters;
+
+} // end Compute()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkComputeActiveParameters_hxx
@@ -22,6 +22,10 @@
 #include "itkImageRandomSamplerBase.h"
 #include "itkImageRandomCoordinateSampler.h"
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
+#include "itkMultiThreader.h"
+
+#include "vnl/vnl_diag_matrix.h"
+#include "vnl/vnl_sparse_matrix.h"
 
 namespace itk
 {
@@ -31,6 +35,13 @@ namespace itk
  * More specifically this class computes the Jacobian terms related to the automatic
  * parameter estimation for the adaptive stochastic gradient descent optimizer.
  * Details can be found in the paper.
+ *
+ * The computation is multi-threaded by default. Every thread accumulates the
+ * covariance matrix of its own part of the samples, after which the threads
+ * merge the partial matrices, each for its own part of the rows. Since the
+ * dense band matrix then exists once per thread, the band rows can optionally
+ * be stored only for the parameters touched by the samples of the thread,
+ * see SetUseSparseBandCovariance().
  */
 
 template< class TFixedImage, class TTransform >
@@ -107,10 +118,43 @@ public:
   virtual void Compute( double & TrC, double & TrCC,
     double & maxJJ, double & maxJCJ );
 
+  /** The single-threaded version of Compute(). */
+  virtual void ComputeSingleThreaded( double & TrC, double & TrCC,
+    double & maxJJ, double & maxJCJ );
+
+  /** Set the number of threads. */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads )
+  {
+    this->m_Threader->SetNumberOfThreads( numberOfThreads );
+  }
+
+
+  /** Select the multi-threaded implementation. Default: true. */
+  itkSetMacro( UseMultiThread, bool );
+
+  /** In the multi-threaded implementation, store the band of the covariance
+   * matrix only for the rows that are touched by the samples of a thread,
+   * instead of as a dense matrix per thread. This reduces the memory use for
+   * large transforms, at the cost of an indirection. Default: false.
+   */
+  itkSetMacro( UseSparseBandCovariance, bool );
+  itkGetConstMacro( UseSparseBandCovariance, bool );
+
 protected:
 
   ComputeJacobianTerms();
-  virtual ~ComputeJacobianTerms() {}
+  virtual ~ComputeJacobianTerms();
+
+  /** Typedefs for multi-threading. */
+  typedef itk::MultiThreader             ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct ThreadInfoType;
+
+  /** Typedefs for the covariance matrix. */
+  typedef double                                   CovarianceValueType;
+  typedef itk::Array2D< CovarianceValueType >      CovarianceMatrixType;
+  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
+  typedef SparseCovarianceMatrixType::row          SparseRowType;
+  typedef vnl_diag_matrix< CovarianceValueType >   DiagCovarianceMatrixType;
 
   typename FixedImageType::ConstPointer m_FixedImage;
   FixedImageRegionType       m_FixedImageRegion;
@@ -151,6 +195,86 @@ protected:
   virtual void SampleFixedImageForJacobianTerms(
     ImageSampleContainerPointer & sampleContainer );
 
+  /** Guess the band structure of the covariance matrix from a few samples.
+   * bandcovMap maps a parameter number difference q-p to a column of the
+   * band matrix, or to the number of bands if it is not in the band;
+   * bandcovMap2 maps the columns back to q-p.
+   */
+  virtual void DetermineBandStructure(
+    const ImageSampleContainerType * sampleContainer,
+    std::vector< unsigned int > & bandcovMap,
+    std::vector< unsigned int > & bandcovMap2 ) const;
+
+  /** Launch the threads, for one of the phases of Compute(). */
+  void LaunchComputeThreaderCallback( const unsigned int phase ) const;
+
+  /** Compute threader callback function. */
+  static ITK_THREAD_RETURN_TYPE ComputeThreaderCallback( void * arg );
+
+  /** Phase 1: accumulate the covariance matrix of the samples of a thread. */
+  void ThreadedComputeCovariance( ThreadIdType threadId );
+
+  /** Phase 2: merge the rows of the per-thread covariance matrices. */
+  void ThreadedReduceCovariance( ThreadIdType threadId );
+
+  /** Phase 3: compute maxJJ and maxJCJ for the samples of a thread. */
+  void ThreadedComputeMaxima( ThreadIdType threadId );
+
+  /** Initialize some multi-threading related parameters. */
+  virtual void InitializeThreadingParameters( void );
+
+  /** Helper structs that multi-threads the computation using ITK threads. */
+  struct MultiThreaderParameterType
+  {
+    // To give the threads access to all member variables and functions.
+    Self *       st_Self;
+    unsigned int st_Phase;
+  };
+  mutable MultiThreaderParameterType m_ThreaderParameters;
+
+  struct ComputePerThreadStruct
+  {
+    // Used for accumulating the covariance matrix
+    SparseCovarianceMatrixType         st_Cov;
+    CovarianceMatrixType               st_BandCov;
+    std::vector< unsigned int >        st_BandCovRowIndex;
+    std::vector< CovarianceValueType > st_SparseBandCov;
+    double                             st_TrC;
+    double                             st_TrCC;
+    double                             st_MaxJJ;
+    double                             st_MaxJCJ;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ComputePerThreadStruct,
+    PaddedComputePerThreadStruct );
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT, PaddedComputePerThreadStruct,
+    AlignedComputePerThreadStruct );
+  mutable AlignedComputePerThreadStruct * m_ComputePerThreadVariables;
+  mutable ThreadIdType                    m_ComputePerThreadVariablesSize;
+
+  /** Get row p of the band matrix of a thread. In the sparse representation
+   * the row is created when allocate is true, and NULL is returned otherwise.
+   * The pointer is invalidated by the creation of another row.
+   */
+  CovarianceValueType * GetBandCovarianceRow(
+    ComputePerThreadStruct & threadVariables, const unsigned int p, const bool allocate );
+
+  /** Add 1/n J^T J of a run of samples with the same nonzero Jacobian
+   * indices to the covariance matrix of a thread.
+   */
+  void AccumulateCovariance( ComputePerThreadStruct & threadVariables,
+    const NonZeroJacobianIndicesType & jacind,
+    const CovarianceMatrixType & jactjac, const double n );
+
+  /** Variables shared by the threads. */
+  ThreaderType::Pointer       m_Threader;
+  bool                        m_UseMultiThread;
+  bool                        m_UseSparseBandCovariance;
+  ImageSampleContainerPointer m_SampleContainer;
+  std::vector< unsigned int > m_BandCovMap;
+  std::vector< unsigned int > m_BandCovMap2;
+  SparseCovarianceMatrixType  m_Cov;
+  DiagCovarianceMatrixType    m_DiagCov;
+
 private:
 
   ComputeJacobianTerms( const Self & ); // purposely not implemented
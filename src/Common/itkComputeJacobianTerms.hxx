@@ -22,8 +22,8 @@
 
 #include "vnl/vnl_math.h"
 #include "vnl/vnl_fastops.h"
-#include "vnl/vnl_diag_matrix.h"
-#include "vnl/vnl_sparse_matrix.h"
+
+#include <algorithm>
 
 namespace itk
 {
@@ -31,31 +31,647 @@ namespace itk
  * ************************* Constructor ************************
  */
 
-template< class TFixedImage, class TTransform >
-ComputeJacobianTerms< TFixedImage, TTransform >
-::ComputeJacobianTerms()
-{
-  this->m_FixedImage     = NULL;
-  this->m_FixedImageMask = NULL;
-  this->m_Transform      = NULL;
-  this->m_FixedImageMask = NULL;
-  this->m_UseScales      = false;
+template< class TFixedImage, class TTransform >
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeJacobianTerms()
+{
+  this->m_FixedImage     = NULL;
+  this->m_FixedImageMask = NULL;
+  this->m_Transform      = NULL;
+  this->m_FixedImageMask = NULL;
+  this->m_UseScales      = false;
+
+  this->m_MaxBandCovSize               = 0;
+  this->m_NumberOfBandStructureSamples = 0;
+  this->m_NumberOfJacobianMeasurements = 0;
+
+  /** Threading related variables. */
+  this->m_UseMultiThread          = true;
+  this->m_UseSparseBandCovariance = false;
+  this->m_Threader                = ThreaderType::New();
+  this->m_Threader->SetUseThreadPool( false );
+
+  /** Initialize the m_ThreaderParameters. */
+  this->m_ThreaderParameters.st_Self  = this;
+  this->m_ThreaderParameters.st_Phase = 0;
+
+  // Multi-threading structs
+  this->m_ComputePerThreadVariables     = NULL;
+  this->m_ComputePerThreadVariablesSize = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************* Destructor *******************
+ */
+
+template< class TFixedImage, class TTransform >
+ComputeJacobianTerms< TFixedImage, TTransform >
+::~ComputeJacobianTerms()
+{
+  delete[] this->m_ComputePerThreadVariables;
+} // end Destructor
+
+
+/**
+ * ****************** InitializeThreadingParameters ****************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::InitializeThreadingParameters( void )
+{
+  /** Resize and initialize the threading related parameters.
+   * Every thread gets its own sparse covariance matrix and band matrix.
+   * In the sparse band representation only the row index is allocated here;
+   * the band rows are created when a thread touches them.
+   */
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
+  const unsigned int P               = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+  const unsigned int bandcovsize = this->m_BandCovMap2.size();
+
+  /** Only resize the array of structs when needed. */
+  if( this->m_ComputePerThreadVariablesSize != numberOfThreads )
+  {
+    delete[] this->m_ComputePerThreadVariables;
+    this->m_ComputePerThreadVariables     = new AlignedComputePerThreadStruct[ numberOfThreads ];
+    this->m_ComputePerThreadVariablesSize = numberOfThreads;
+  }
+
+  /** Some initialization. */
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    ComputePerThreadStruct & threadVariables = this->m_ComputePerThreadVariables[ i ];
+    threadVariables.st_Cov = SparseCovarianceMatrixType( P, P );
+    if( this->m_UseSparseBandCovariance )
+    {
+      threadVariables.st_BandCovRowIndex.assign( P, NumericTraits< unsigned int >::max() );
+    }
+    else
+    {
+      threadVariables.st_BandCov.SetSize( P, bandcovsize );
+      threadVariables.st_BandCov.Fill( NumericTraits< CovarianceValueType >::Zero );
+    }
+    threadVariables.st_TrC    = NumericTraits< double >::Zero;
+    threadVariables.st_TrCC   = NumericTraits< double >::Zero;
+    threadVariables.st_MaxJJ  = NumericTraits< double >::Zero;
+    threadVariables.st_MaxJCJ = NumericTraits< double >::Zero;
+  }
+
+} // end InitializeThreadingParameters()
+
+
+/**
+ * ************************* Compute ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::Compute( double & TrC, double & TrCC, double & maxJJ, double & maxJCJ )
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->ComputeSingleThreaded( TrC, TrCC, maxJJ, maxJCJ );
+  }
+
+  /** This function computes the same four terms as ComputeSingleThreaded(),
+   * in three multi-threaded phases:
+   * 1: every thread accumulates C over its own part of the samples,
+   * 2: every thread merges and scales its own part of the rows of C,
+   *    and computes its part of TrC and TrCC,
+   * 3: every thread computes maxJJ and maxJCJ over its part of the samples.
+   */
+
+  /** Initialize. */
+  TrC = TrCC = maxJJ = maxJCJ = 0.0;
+
+  /** Get samples. */
+  ImageSampleContainerPointer sampleContainer = 0;
+  this->SampleFixedImageForJacobianTerms( sampleContainer );
+  this->m_SampleContainer = sampleContainer;
+
+  /** Get the number of parameters. */
+  const unsigned int P = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+
+  /** Try to guess the band structure of the covariance matrix. */
+  this->DetermineBandStructure( sampleContainer,
+    this->m_BandCovMap, this->m_BandCovMap2 );
+
+  /** Phase 1: accumulate the per-thread covariance matrices. */
+  this->InitializeThreadingParameters();
+  this->LaunchComputeThreaderCallback( 1 );
+
+  /** Phase 2: merge them into the upper triangular part of C. */
+  this->m_Cov     = SparseCovarianceMatrixType( P, P );
+  this->m_DiagCov = DiagCovarianceMatrixType( P, 0.0 );
+  this->LaunchComputeThreaderCallback( 2 );
+
+  /** Gather TrC and TrCC, and free the per-thread matrices. */
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    ComputePerThreadStruct & threadVariables = this->m_ComputePerThreadVariables[ i ];
+    TrC  += threadVariables.st_TrC;
+    TrCC += threadVariables.st_TrCC;
+
+    threadVariables.st_Cov = SparseCovarianceMatrixType();
+    threadVariables.st_BandCov.set_size( 0, 0 );
+    std::vector< unsigned int >().swap( threadVariables.st_BandCovRowIndex );
+    std::vector< CovarianceValueType >().swap( threadVariables.st_SparseBandCov );
+  }
+
+  /** Symmetry: multiply by 2 and subtract sumsqr(diagcov). */
+  TrCC *= 2.0;
+  TrCC -= this->m_DiagCov.diagonal().squared_magnitude();
+
+  /** Phase 3: compute maxJJ and maxJCJ. */
+  this->LaunchComputeThreaderCallback( 3 );
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    maxJJ  = vnl_math_max( maxJJ, this->m_ComputePerThreadVariables[ i ].st_MaxJJ );
+    maxJCJ = vnl_math_max( maxJCJ, this->m_ComputePerThreadVariables[ i ].st_MaxJCJ );
+  }
+
+  /** Release the memory. */
+  this->m_SampleContainer = 0;
+  this->m_Cov             = SparseCovarianceMatrixType();
+  this->m_DiagCov         = DiagCovarianceMatrixType();
+
+} // end Compute()
+
+
+/**
+ * *********************** LaunchComputeThreaderCallback***************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::LaunchComputeThreaderCallback( const unsigned int phase ) const
+{
+  /** Setup threader. */
+  this->m_ThreaderParameters.st_Phase = phase;
+  this->m_Threader->SetSingleMethod( this->ComputeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderParameters ) ) );
+
+  /** Launch. */
+  this->m_Threader->SingleMethodExecute();
+
+} // end LaunchComputeThreaderCallback()
+
+
+/**
+ * ************ ComputeThreaderCallback ****************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeThreaderCallback( void * arg )
+{
+  /** Get the current thread id and user data. */
+  ThreadInfoType *             infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType                 threadID   = infoStruct->ThreadID;
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+
+  /** Call the real implementation. */
+  if( temp->st_Phase == 1 )
+  {
+    temp->st_Self->ThreadedComputeCovariance( threadID );
+  }
+  else if( temp->st_Phase == 2 )
+  {
+    temp->st_Self->ThreadedReduceCovariance( threadID );
+  }
+  else
+  {
+    temp->st_Self->ThreadedComputeMaxima( threadID );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeThreaderCallback()
+
+
+/**
+ * ************************* GetBandCovarianceRow ************************
+ */
+
+template< class TFixedImage, class TTransform >
+typename ComputeJacobianTerms< TFixedImage, TTransform >::CovarianceValueType *
+ComputeJacobianTerms< TFixedImage, TTransform >
+::GetBandCovarianceRow( ComputePerThreadStruct & threadVariables,
+  const unsigned int p, const bool allocate )
+{
+  if( !this->m_UseSparseBandCovariance )
+  {
+    return threadVariables.st_BandCov[ p ];
+  }
+
+  /** Sparse representation: rows are stored consecutively in the order
+   * in which they are created.
+   */
+  const unsigned int bandcovsize = this->m_BandCovMap2.size();
+  unsigned int &     rowIndex    = threadVariables.st_BandCovRowIndex[ p ];
+  if( rowIndex == NumericTraits< unsigned int >::max() )
+  {
+    if( !allocate ) { return NULL; }
+    rowIndex = threadVariables.st_SparseBandCov.size() / bandcovsize;
+    threadVariables.st_SparseBandCov.resize(
+      threadVariables.st_SparseBandCov.size() + bandcovsize, 0.0 );
+  }
+  return &( threadVariables.st_SparseBandCov[ rowIndex * bandcovsize ] );
+
+} // end GetBandCovarianceRow()
+
+
+/**
+ * ************************* AccumulateCovariance ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::AccumulateCovariance( ComputePerThreadStruct & threadVariables,
+  const NonZeroJacobianIndicesType & jacind,
+  const CovarianceMatrixType & jactjac, const double n )
+{
+  const unsigned int sizejacind  = jacind.size();
+  const unsigned int bandcovsize = this->m_BandCovMap2.size();
+
+  for( unsigned int pi = 0; pi < sizejacind; ++pi )
+  {
+    const unsigned int    p       = jacind[ pi ];
+    CovarianceValueType * bandrow = bandcovsize > 0
+      ? this->GetBandCovarianceRow( threadVariables, p, true ) : NULL;
+    for( unsigned int qi = 0; qi < sizejacind; ++qi )
+    {
+      const unsigned int q = jacind[ qi ];
+      if( q >= p )
+      {
+        const double tempval = jactjac( pi, qi ) / n;
+        if( vcl_abs( tempval ) > 1e-14 )
+        {
+          const unsigned int bandindex = this->m_BandCovMap[ q - p ];
+          if( bandindex < bandcovsize )
+          {
+            bandrow[ bandindex ] += tempval;
+          }
+          else
+          {
+            threadVariables.st_Cov( p, q ) += tempval;
+          }
+        }
+      }
+    } // qi
+  }   // pi
+
+} // end AccumulateCovariance()
+
+
+/**
+ * ************************* ThreadedComputeCovariance ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeCovariance( ThreadIdType threadId )
+{
+  /** Get sample container size, number of threads, and output space dimension. */
+  const SizeValueType sampleContainerSize = this->m_SampleContainer->Size();
+  const ThreadIdType  numberOfThreads     = this->m_Threader->GetNumberOfThreads();
+  const unsigned int  outdim              = this->m_Transform->GetOutputSpaceDimension();
+  const double        n                   = static_cast< double >( sampleContainerSize );
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( numberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Variables for nonzerojacobian indices and the Jacobian. */
+  const NumberOfParametersType sizejacind
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+  NonZeroJacobianIndicesType prevjacind( sizejacind );
+
+  /** For temporary storage of J'J. */
+  CovarianceMatrixType jactjac( sizejacind, sizejacind );
+  jactjac.Fill( 0.0 );
+
+  /** Loop over the samples of this thread; consecutive samples with the
+   * same nonzero Jacobian indices are summed in jactjac first.
+   */
+  ComputePerThreadStruct & threadVariables = this->m_ComputePerThreadVariables[ threadId ];
+  bool                     first           = true;
+  for( unsigned long i = pos_begin; i < pos_end; ++i )
+  {
+    /** Read fixed coordinates and get Jacobian J_j. */
+    const FixedImagePointType & point
+      = this->m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
+
+    /** Skip invalid Jacobians, if any. */
+    if( sizejacind > 1 )
+    {
+      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
+    }
+
+    if( !first && jacind == prevjacind )
+    {
+      /** Update sum of J_j^T J_j. */
+      vnl_fastops::inc_X_by_AtA( jactjac, jacj );
+    }
+    else
+    {
+      /** Update covariance matrix. */
+      if( !first )
+      {
+        this->AccumulateCovariance( threadVariables, prevjacind, jactjac, n );
+      }
+
+      /** Initialize jactjac by J_j^T J_j. */
+      vnl_fastops::AtA( jactjac, jacj );
+
+      /** Remember nonzerojacobian indices. */
+      prevjacind = jacind;
+      first      = false;
+    }
+  } // end loop over samples
+
+  /** Update covariance matrix once again to include last jactjac updates. */
+  if( !first )
+  {
+    this->AccumulateCovariance( threadVariables, prevjacind, jactjac, n );
+  }
+
+} // end ThreadedComputeCovariance()
+
+
+/**
+ * ************************* ThreadedReduceCovariance ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedReduceCovariance( ThreadIdType threadId )
+{
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
+  const unsigned int P               = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+  const unsigned int bandcovsize = this->m_BandCovMap2.size();
+  const ScalesType & scales      = this->m_Scales;
+
+  /** Get the rows for this thread. */
+  const unsigned int nrOfRowsPerThreads = static_cast< unsigned int >(
+    vcl_ceil( static_cast< double >( P ) / static_cast< double >( numberOfThreads ) ) );
+  unsigned int p_begin = nrOfRowsPerThreads * threadId;
+  unsigned int p_end   = nrOfRowsPerThreads * ( threadId + 1 );
+  p_begin = ( p_begin > P ) ? P : p_begin;
+  p_end   = ( p_end > P ) ? P : p_end;
+
+  typedef std::pair< unsigned int, CovarianceValueType > EntryType;
+  std::vector< EntryType >           entries;
+  std::vector< int >                 cols;
+  std::vector< CovarianceValueType > vals;
+  std::vector< CovarianceValueType > bandsum( bandcovsize );
+
+  double TrC  = 0.0;
+  double TrCC = 0.0;
+  for( unsigned int p = p_begin; p < p_end; ++p )
+  {
+    /** Sum the band rows and collect the sparse rows of all threads. */
+    entries.clear();
+    std::fill( bandsum.begin(), bandsum.end(), 0.0 );
+    for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+    {
+      ComputePerThreadStruct & threadVariables = this->m_ComputePerThreadVariables[ t ];
+      if( bandcovsize > 0 )
+      {
+        const CovarianceValueType * bandrow
+          = this->GetBandCovarianceRow( threadVariables, p, false );
+        if( bandrow != NULL )
+        {
+          for( unsigned int b = 0; b < bandcovsize; ++b )
+          {
+            bandsum[ b ] += bandrow[ b ];
+          }
+        }
+      }
+
+      const SparseRowType & covrowp = threadVariables.st_Cov.get_row( p );
+      for( typename SparseRowType::const_iterator it = covrowp.begin(); it != covrowp.end(); ++it )
+      {
+        entries.push_back( EntryType( ( *it ).first, ( *it ).second ) );
+      }
+    }
+    for( unsigned int b = 0; b < bandcovsize; ++b )
+    {
+      if( vcl_abs( bandsum[ b ] ) > 1e-14 )
+      {
+        entries.push_back( EntryType( p + this->m_BandCovMap2[ b ], bandsum[ b ] ) );
+      }
+    }
+    if( entries.empty() ) { continue; }
+
+    /** Merge the entries per column and apply the scales. */
+    std::sort( entries.begin(), entries.end() );
+    cols.clear(); vals.clear();
+    for( unsigned int e = 0; e < entries.size(); ++e )
+    {
+      const unsigned int q = entries[ e ].first;
+      if( !cols.empty() && static_cast< unsigned int >( cols.back() ) == q )
+      {
+        vals.back() += entries[ e ].second;
+      }
+      else
+      {
+        cols.push_back( static_cast< int >( q ) );
+        vals.push_back( entries[ e ].second );
+      }
+    }
+    for( unsigned int e = 0; e < cols.size(); ++e )
+    {
+      if( this->m_UseScales )
+      {
+        vals[ e ] /= scales[ p ] * scales[ cols[ e ] ];
+      }
+      TrCC += vnl_math_sqr( vals[ e ] );
+      if( static_cast< unsigned int >( cols[ e ] ) == p )
+      {
+        TrC                   += vals[ e ];
+        this->m_DiagCov[ p ]   = vals[ e ];
+      }
+    }
+
+    /** Threads write disjoint rows, so this is safe. */
+    this->m_Cov.set_row( p, cols, vals );
+  }
+
+  this->m_ComputePerThreadVariables[ threadId ].st_TrC  = TrC;
+  this->m_ComputePerThreadVariables[ threadId ].st_TrCC = TrCC;
+
+} // end ThreadedReduceCovariance()
+
+
+/**
+ * ************************* ThreadedComputeMaxima ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeMaxima( ThreadIdType threadId )
+{
+  typedef itk::Array< SizeValueType > NonZeroJacobianIndicesExpandedType;
+
+  /** Get sample container size, number of threads, and output space dimension. */
+  const SizeValueType sampleContainerSize = this->m_SampleContainer->Size();
+  const ThreadIdType  numberOfThreads     = this->m_Threader->GetNumberOfThreads();
+  const unsigned int  outdim              = this->m_Transform->GetOutputSpaceDimension();
+  const unsigned int  P                   = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+  const ScalesType &  scales = this->m_Scales;
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( numberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Variables for nonzerojacobian indices and the Jacobian. */
+  const NumberOfParametersType sizejacind
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+
+  /** Temporaries, see ComputeSingleThreaded(). */
+  const double                       sqrt2 = vcl_sqrt( static_cast< double >( 2.0 ) );
+  JacobianType                       jacjjacj( outdim, outdim );
+  JacobianType                       jacjcov( outdim, sizejacind );
+  DiagCovarianceMatrixType           diagcovsparse( sizejacind );
+  JacobianType                       jacjdiagcov( outdim, sizejacind );
+  JacobianType                       jacjdiagcovjacj( outdim, outdim );
+  JacobianType                       jacjcovjacj( outdim, outdim );
+  NonZeroJacobianIndicesExpandedType jacindExpanded( P );
+  jacindExpanded.Fill( sizejacind );
+
+  double maxJJ  = 0.0;
+  double maxJCJ = 0.0;
+  for( unsigned long i = pos_begin; i < pos_end; ++i )
+  {
+    /** Read fixed coordinates and get Jacobian. */
+    const FixedImagePointType & point
+      = this->m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
+
+    /** Apply scales, if necessary. */
+    if( this->m_UseScales )
+    {
+      for( unsigned int pi = 0; pi < sizejacind; ++pi )
+      {
+        jacj.scale_column( pi, 1.0 / scales[ jacind[ pi ] ] );
+      }
+    }
+
+    /** Compute JJ_j = ||J_j||_F^2 + 2\sqrt{2} || J_j J_j^T ||_F. */
+    double JJ_j = vnl_math_sqr( jacj.frobenius_norm() );
+    vnl_fastops::ABt( jacjjacj, jacj, jacj );
+    JJ_j += 2.0 * sqrt2 * jacjjacj.frobenius_norm();
+    maxJJ = vnl_math_max( maxJJ, JJ_j );
+
+    /** Store the nonzero Jacobian indices in a different format
+     * and create the sparse diagcov.
+     */
+    for( unsigned int pi = 0; pi < sizejacind; ++pi )
+    {
+      const unsigned int p = jacind[ pi ];
+      jacindExpanded[ p ] = pi;
+      diagcovsparse[ pi ] = this->m_DiagCov[ p ];
+    }
 
-  this->m_MaxBandCovSize               = 0;
-  this->m_NumberOfBandStructureSamples = 0;
-  this->m_NumberOfJacobianMeasurements = 0;
+    /** jacjC = J_j cov^T, with cov the upper triangular part of C. */
+    jacjcov.Fill( 0.0 );
+    for( unsigned int pi = 0; pi < sizejacind; ++pi )
+    {
+      const unsigned int p = jacind[ pi ];
+      if( !this->m_Cov.empty_row( p ) )
+      {
+        const SparseRowType & covrowp = this->m_Cov.get_row( p );
+        typename SparseRowType::const_iterator covrowpit;
+        for( covrowpit = covrowp.begin(); covrowpit != covrowp.end(); ++covrowpit )
+        {
+          const unsigned int qi = jacindExpanded[ ( *covrowpit ).first ];
+          if( qi < sizejacind )
+          {
+            const CovarianceValueType covElement = ( *covrowpit ).second;
+            for( unsigned int dx = 0; dx < outdim; ++dx )
+            {
+              jacjcov[ dx ][ pi ] += jacj[ dx ][ qi ] * covElement;
+            }
+          }
+        }
+      }
+    }
 
-} // end Constructor
+    /** Reset jacindExpanded for the next sample. */
+    for( unsigned int pi = 0; pi < sizejacind; ++pi )
+    {
+      jacindExpanded[ jacind[ pi ] ] = sizejacind;
+    }
+
+    /** J C J' = J (cov + cov' - diag(cov')) J'. */
+    vnl_fastops::ABt( jacjcovjacj, jacjcov, jacj );
+    jacjdiagcov = jacj * diagcovsparse;
+    vnl_fastops::ABt( jacjdiagcovjacj, jacjdiagcov, jacj );
+    jacjcovjacj += jacjcovjacj.transpose();
+    jacjcovjacj -= jacjdiagcovjacj;
+
+    /** Compute JCJ_j = Tr( J_j C J_j^T ) + 2 \sqrt{2} || J_j C J_j^T ||_F. */
+    double JCJ_j = 0.0;
+    for( unsigned int d = 0; d < outdim; ++d )
+    {
+      JCJ_j += jacjcovjacj[ d ][ d ];
+    }
+    JCJ_j += 2.0 * sqrt2 * jacjcovjacj.frobenius_norm();
+    maxJCJ = vnl_math_max( maxJCJ, JCJ_j );
+
+  } // end loop over samples
+
+  this->m_ComputePerThreadVariables[ threadId ].st_MaxJJ  = maxJJ;
+  this->m_ComputePerThreadVariables[ threadId ].st_MaxJCJ = maxJCJ;
+
+} // end ThreadedComputeMaxima()
 
 
 /**
- * ************************* Compute ************************
+ * ************************* ComputeSingleThreaded ************************
  */
 
 template< class TFixedImage, class TTransform >
 void
 ComputeJacobianTerms< TFixedImage, TTransform >
-::Compute( double & TrC, double & TrCC, double & maxJJ, double & maxJCJ )
+::ComputeSingleThreaded( double & TrC, double & TrCC, double & maxJJ, double & maxJCJ )
 {
   /** This function computes four terms needed for the automatic parameter
    * estimation. The equation number refers to the IJCV paper.
@@ -73,12 +689,7 @@ ComputeJacobianTerms< TFixedImage, TTransform >
    * Term 4: maxJCJ, see (54)
    */
 
-  typedef double                                   CovarianceValueType;
-  typedef itk::Array2D< CovarianceValueType >      CovarianceMatrixType;
-  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
-  typedef SparseCovarianceMatrixType::row          SparseRowType;
-  typedef itk::Array< SizeValueType >              NonZeroJacobianIndicesExpandedType;
-  typedef vnl_diag_matrix< CovarianceValueType >   DiagCovarianceMatrixType;
+  typedef itk::Array< SizeValueType > NonZeroJacobianIndicesExpandedType;
 
   /** Initialize. */
   TrC = TrCC = maxJJ = maxJCJ = 0.0;
@@ -126,95 +737,11 @@ ComputeJacobianTerms< TFixedImage, TTransform >
   CovarianceMatrixType jactjac( sizejacind, sizejacind );
   jactjac.Fill( 0.0 );
 
-  typedef std::vector< unsigned int >             DifHistType;
-  typedef std::pair< unsigned int, unsigned int > FreqPairType;
-  typedef std::vector< FreqPairType >             DifHist2Type;
-  DifHist2Type difHist2;
-
-  /** DifHist is a histogram of absolute parameterNrDifferences that
-   * occur in the nonzerojacobianindex vectors.
-   * DifHist2 is another way of storing the histogram, as a vector
-   * of pairs. pair.first = Frequency, pair.second = parameterNrDifference.
-   * This is useful for sorting.
-   */
-  DifHistType difHist( P, 0 );
-
-  /** Try to guess the band structure of the covariance matrix.
-   * A 'band' is a series of elements cov(p,q) with constant q-p.
-   * In the loop below, on a few positions in the image the Jacobian
-   * is computed. The nonzerojacobianindices are inspected to figure out
-   * which values of q-p occur often. This is done by making a histogram.
-   * The histogram is then sorted and the most occurring bands
-   * are determined. The covariance elements in these bands will not
-   * be stored in the sparse matrix structure 'cov', but in the band
-   * matrix 'bandcov', which is much faster.
-   * Only after the bandcov and cov have been filled (by looping over
-   * all Jacobian measurements in the sample container, the bandcov
-   * matrix is injected in the cov matrix, for easy further calculations,
-   * and the bandcov matrix is deleted.
-   */
-  unsigned int onezero = 0;
-  for( unsigned int s = 0; s < this->m_NumberOfBandStructureSamples; ++s )
-  {
-    /** Semi-randomly get some samples from the sample container. */
-    const unsigned int samplenr = ( s + 1 ) * nrofsamples
-      / ( this->m_NumberOfBandStructureSamples + 2 + onezero );
-    onezero = 1 - onezero; // introduces semi-randomness
-
-    /** Read fixed coordinates and get Jacobian J_j. */
-    const FixedImagePointType & point
-      = sampleContainer->GetElement( samplenr ).m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind );
-
-    /** Skip invalid Jacobians in the beginning, if any. */
-    if( sizejacind > 1 )
-    {
-      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
-    }
-
-    /** Fill the histogram of parameter nr differences. */
-    for( unsigned int i = 0; i < sizejacind; ++i )
-    {
-      const int jacindi = static_cast< int >( jacind[ i ] );
-      for( unsigned int j = i; j < sizejacind; ++j )
-      {
-        const int jacindj = static_cast< int >( jacind[ j ] );
-        difHist[ static_cast< unsigned int >( vcl_abs( jacindj - jacindi ) ) ]++;
-      }
-    }
-  }
-
-  /** Copy the nonzero elements of the difHist to a vector pairs. */
-  for( unsigned int p = 0; p < P; ++p )
-  {
-    const unsigned int freq = difHist[ p ];
-    if( freq != 0 )
-    {
-      difHist2.push_back( FreqPairType( freq, p ) );
-    }
-  }
-  difHist.resize( 0 );
-
-  /** Compute the number of bands. */
-  const unsigned int bandcovsize = vnl_math_min( this->m_MaxBandCovSize,
-    static_cast< unsigned int >( difHist2.size() ) );
-
-  /** Maps parameterNrDifference (q-p) to colnr in bandcov. */
-  std::vector< unsigned int > bandcovMap( P, bandcovsize );
-  /** Maps colnr in bandcov to parameterNrDifference (q-p). */
-  std::vector< unsigned int > bandcovMap2( bandcovsize, P );
-
-  /** Sort the difHist2 based on the frequencies. */
-  std::sort( difHist2.begin(), difHist2.end() );
-
-  /** Determine the bands that are expected to be most dominant. */
-  DifHist2Type::iterator difHist2It = difHist2.end();
-  for( unsigned int b = 0; b < bandcovsize; ++b )
-  {
-    --difHist2It;
-    bandcovMap[ difHist2It->second ] = b;
-    bandcovMap2[ b ]                 = difHist2It->second;
-  }
+  /** Try to guess the band structure of the covariance matrix. */
+  std::vector< unsigned int > bandcovMap;
+  std::vector< unsigned int > bandcovMap2;
+  this->DetermineBandStructure( sampleContainer, bandcovMap, bandcovMap2 );
+  const unsigned int bandcovsize = bandcovMap2.size();
 
   /** Initialize band matrix. */
   bandcov = CovarianceMatrixType( P, bandcovsize );
@@ -514,6 +1041,123 @@ ComputeJacobianTerms< TFixedImage, TTransform >
 } // end Compute()
 
 
+/**
+ * ************************* DetermineBandStructure ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::DetermineBandStructure(
+  const ImageSampleContainerType * sampleContainer,
+  std::vector< unsigned int > & bandcovMap,
+  std::vector< unsigned int > & bandcovMap2 ) const
+{
+  const SizeValueType nrofsamples = sampleContainer->Size();
+  const unsigned int  P           = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+  const unsigned int outdim = this->m_Transform->GetOutputSpaceDimension();
+
+  /** Variables for nonzerojacobian indices and the Jacobian. */
+  const NumberOfParametersType sizejacind
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+
+  typedef std::vector< unsigned int >             DifHistType;
+  typedef std::pair< unsigned int, unsigned int > FreqPairType;
+  typedef std::vector< FreqPairType >             DifHist2Type;
+  DifHist2Type difHist2;
+
+  /** DifHist is a histogram of absolute parameterNrDifferences that
+   * occur in the nonzerojacobianindex vectors.
+   * DifHist2 is another way of storing the histogram, as a vector
+   * of pairs. pair.first = Frequency, pair.second = parameterNrDifference.
+   * This is useful for sorting.
+   */
+  DifHistType difHist( P, 0 );
+
+  /** Try to guess the band structure of the covariance matrix.
+   * A 'band' is a series of elements cov(p,q) with constant q-p.
+   * In the loop below, on a few positions in the image the Jacobian
+   * is computed. The nonzerojacobianindices are inspected to figure out
+   * which values of q-p occur often. This is done by making a histogram.
+   * The histogram is then sorted and the most occurring bands
+   * are determined. The covariance elements in these bands will not
+   * be stored in the sparse matrix structure 'cov', but in the band
+   * matrix 'bandcov', which is much faster.
+   * Only after the bandcov and cov have been filled (by looping over
+   * all Jacobian measurements in the sample container, the bandcov
+   * matrix is injected in the cov matrix, for easy further calculations,
+   * and the bandcov matrix is deleted.
+   */
+  unsigned int onezero = 0;
+  for( unsigned int s = 0; s < this->m_NumberOfBandStructureSamples; ++s )
+  {
+    /** Semi-randomly get some samples from the sample container. */
+    const unsigned int samplenr = ( s + 1 ) * nrofsamples
+      / ( this->m_NumberOfBandStructureSamples + 2 + onezero );
+    onezero = 1 - onezero; // introduces semi-randomness
+
+    /** Read fixed coordinates and get Jacobian J_j. */
+    const FixedImagePointType & point
+      = sampleContainer->ElementAt( samplenr ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
+
+    /** Skip invalid Jacobians in the beginning, if any. */
+    if( sizejacind > 1 )
+    {
+      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
+    }
+
+    /** Fill the histogram of parameter nr differences. */
+    for( unsigned int i = 0; i < sizejacind; ++i )
+    {
+      const int jacindi = static_cast< int >( jacind[ i ] );
+      for( unsigned int j = i; j < sizejacind; ++j )
+      {
+        const int jacindj = static_cast< int >( jacind[ j ] );
+        difHist[ static_cast< unsigned int >( vcl_abs( jacindj - jacindi ) ) ]++;
+      }
+    }
+  }
+
+  /** Copy the nonzero elements of the difHist to a vector pairs. */
+  for( unsigned int p = 0; p < P; ++p )
+  {
+    const unsigned int freq = difHist[ p ];
+    if( freq != 0 )
+    {
+      difHist2.push_back( FreqPairType( freq, p ) );
+    }
+  }
+  difHist.resize( 0 );
+
+  /** Compute the number of bands. */
+  const unsigned int bandcovsize = vnl_math_min( this->m_MaxBandCovSize,
+    static_cast< unsigned int >( difHist2.size() ) );
+
+  /** Maps parameterNrDifference (q-p) to colnr in bandcov. */
+  bandcovMap.assign( P, bandcovsize );
+  /** Maps colnr in bandcov to parameterNrDifference (q-p). */
+  bandcovMap2.assign( bandcovsize, P );
+
+  /** Sort the difHist2 based on the frequencies. */
+  std::sort( difHist2.begin(), difHist2.end() );
+
+  /** Determine the bands that are expected to be most dominant. */
+  DifHist2Type::iterator difHist2It = difHist2.end();
+  for( unsigned int b = 0; b < bandcovsize; ++b )
+  {
+    --difHist2It;
+    bandcovMap[ difHist2It->second ] = b;
+    bandcovMap2[ b ]                 = difHist2It->second;
+  }
+
+} // end DetermineBandStructure()
+
+
 /**
  * ************************* SampleFixedImageForJacobianTerms ************************
  */
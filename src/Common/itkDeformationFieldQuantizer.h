@@ -0,0 +1,87 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDeformationFieldQuantizer_h
+#define __itkDeformationFieldQuantizer_h
+
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkMetaDataDictionary.h"
+
+namespace itk
+{
+
+/** \class DeformationFieldQuantizer
+ *
+ * \brief Stores a vector field as 16 bit integers, with a scale and offset.
+ *
+ * Quantize() maps the components v of the field linearly to the integers
+ * q in [-32767, 32767], with v = offset + scale * q, so that the range of
+ * all components is used. The scale and the offset are stored as strings in
+ * the MetaDataDictionary of the quantized field, with the keys given by
+ * GetScaleKey() and GetOffsetKey(), which the MetaImage and NRRD writers
+ * write to the header. The maximum error is half the scale.
+ *
+ * Dequantize() undoes this for a field that was read as floating point,
+ * given the dictionary of the file.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< class TVectorImage >
+class DeformationFieldQuantizer
+{
+public:
+
+  /** Typedefs. */
+  typedef TVectorImage                              VectorImageType;
+  typedef typename VectorImageType::PixelType       VectorType;
+  typedef typename VectorType::ValueType            ComponentType;
+  itkStaticConstMacro( ImageDimension, unsigned int, VectorImageType::ImageDimension );
+  itkStaticConstMacro( VectorDimension, unsigned int, VectorType::Dimension );
+  typedef Vector< short,
+    itkGetStaticConstMacro( VectorDimension ) >     QuantizedVectorType;
+  typedef Image< QuantizedVectorType,
+    itkGetStaticConstMacro( ImageDimension ) >      QuantizedImageType;
+  typedef typename QuantizedImageType::Pointer      QuantizedImagePointer;
+
+  /** The keys of the scale and offset in the dictionary. */
+  static const char * GetScaleKey( void ) { return "DeformationFieldQuantizationScale"; }
+  static const char * GetOffsetKey( void ) { return "DeformationFieldQuantizationOffset"; }
+
+  /** Return the quantized copy of a field. */
+  static QuantizedImagePointer Quantize( const VectorImageType * field );
+
+  /** Rescale a field that was read from a quantized file, in place. Returns
+   * false, without changing the field, if the dictionary has no scale. */
+  static bool Dequantize( VectorImageType * field, const MetaDataDictionary & dictionary );
+
+private:
+
+  DeformationFieldQuantizer();                                // purposely not implemented
+  DeformationFieldQuantizer( const DeformationFieldQuantizer & ); // purposely not implemented
+  void operator=( const DeformationFieldQuantizer & );          // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDeformationFieldQuantizer.hxx"
+#endif
+
+#endif // end #ifndef __itkDeformationFieldQuantizer_h
@@ -0,0 +1,135 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDeformationFieldQuantizer_hxx
+#define __itkDeformationFieldQuantizer_hxx
+
+#include "itkDeformationFieldQuantizer.h"
+#include "itkMetaDataObject.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "vnl/vnl_math.h"
+
+#include <sstream>
+
+namespace itk
+{
+
+/**
+ * ******************* Quantize *******************
+ */
+
+template< class TVectorImage >
+typename DeformationFieldQuantizer< TVectorImage >::QuantizedImagePointer
+DeformationFieldQuantizer< TVectorImage >
+::Quantize( const VectorImageType * field )
+{
+  const typename VectorImageType::RegionType region = field->GetBufferedRegion();
+
+  /** Determine the range of all components. */
+  double minimum = 0.0;
+  double maximum = 0.0;
+  bool   first   = true;
+  ImageRegionConstIterator< VectorImageType > it( field, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const VectorType & v = it.Value();
+    for( unsigned int d = 0; d < VectorDimension; ++d )
+    {
+      const double c = static_cast< double >( v[ d ] );
+      minimum = first ? c : vnl_math_min( minimum, c );
+      maximum = first ? c : vnl_math_max( maximum, c );
+      first   = false;
+    }
+  }
+  const double offset = 0.5 * ( minimum + maximum );
+  const double scale  = maximum > minimum ? ( maximum - minimum ) / 65534.0 : 1.0;
+
+  /** Quantize. */
+  QuantizedImagePointer quantized = QuantizedImageType::New();
+  quantized->CopyInformation( field );
+  quantized->SetRegions( region );
+  quantized->Allocate();
+  ImageRegionIterator< QuantizedImageType > qit( quantized, region );
+  QuantizedVectorType                       q;
+  for( it.GoToBegin(), qit.GoToBegin(); !it.IsAtEnd(); ++it, ++qit )
+  {
+    const VectorType & v = it.Value();
+    for( unsigned int d = 0; d < VectorDimension; ++d )
+    {
+      const double r = ( static_cast< double >( v[ d ] ) - offset ) / scale;
+      q[ d ] = static_cast< short >( vnl_math_rnd( vnl_math_max( -32767.0, vnl_math_min( 32767.0, r ) ) ) );
+    }
+    qit.Set( q );
+  }
+
+  /** Store the scale and the offset, with full precision. */
+  std::ostringstream scaleString;
+  std::ostringstream offsetString;
+  scaleString.precision( 17 );
+  offsetString.precision( 17 );
+  scaleString << scale;
+  offsetString << offset;
+  MetaDataDictionary & dictionary = quantized->GetMetaDataDictionary();
+  EncapsulateMetaData< std::string >( dictionary, GetScaleKey(), scaleString.str() );
+  EncapsulateMetaData< std::string >( dictionary, GetOffsetKey(), offsetString.str() );
+
+  return quantized;
+
+} // end Quantize()
+
+
+/**
+ * ******************* Dequantize *******************
+ */
+
+template< class TVectorImage >
+bool
+DeformationFieldQuantizer< TVectorImage >
+::Dequantize( VectorImageType * field, const MetaDataDictionary & dictionary )
+{
+  std::string scaleString;
+  if( !ExposeMetaData< std::string >( dictionary, GetScaleKey(), scaleString ) )
+  {
+    return false;
+  }
+  std::string offsetString = "0";
+  ExposeMetaData< std::string >( dictionary, GetOffsetKey(), offsetString );
+
+  double scale  = 1.0;
+  double offset = 0.0;
+  std::istringstream( scaleString ) >> scale;
+  std::istringstream( offsetString ) >> offset;
+
+  ImageRegionIterator< VectorImageType > it( field, field->GetBufferedRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    VectorType & v = it.Value();
+    for( unsigned int d = 0; d < VectorDimension; ++d )
+    {
+      v[ d ] = static_cast< ComponentType >( offset + scale * static_cast< double >( v[ d ] ) );
+    }
+  }
+  field->Modified();
+  return true;
+
+} // end Dequantize()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkDeformationFieldQuantizer_hxx
@@ -0,0 +1,152 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDistributedEvaluation.h"
+
+#ifdef ELASTIX_USE_MPI
+#include <mpi.h>
+#endif
+
+namespace itk
+{
+
+unsigned int DistributedEvaluation::s_Rank              = 0;
+unsigned int DistributedEvaluation::s_NumberOfProcesses = 1;
+
+/**
+ * **************** Initialize *****************************
+ */
+
+void
+DistributedEvaluation
+::Initialize( int * argc, char *** argv )
+{
+#ifdef ELASTIX_USE_MPI
+  int initialized = 0;
+  MPI_Initialized( &initialized );
+  if( !initialized )
+  {
+    MPI_Init( argc, argv );
+  }
+
+  int rank = 0;
+  int size = 1;
+  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_size( MPI_COMM_WORLD, &size );
+  s_Rank              = static_cast< unsigned int >( rank );
+  s_NumberOfProcesses = static_cast< unsigned int >( size );
+#else
+  (void)argc;
+  (void)argv;
+#endif
+
+} // end Initialize()
+
+
+/**
+ * **************** Finalize *****************************
+ */
+
+void
+DistributedEvaluation
+::Finalize( void )
+{
+#ifdef ELASTIX_USE_MPI
+  int finalized = 0;
+  MPI_Finalized( &finalized );
+  if( !finalized )
+  {
+    MPI_Finalize();
+  }
+#endif
+  s_Rank              = 0;
+  s_NumberOfProcesses = 1;
+
+} // end Finalize()
+
+
+/**
+ * **************** GetPartition *****************************
+ */
+
+void
+DistributedEvaluation
+::GetPartition( const SizeValueType n, SizeValueType & begin, SizeValueType & end )
+{
+  /** Contiguous parts, of which the first n % size have one sample more. */
+  const SizeValueType size      = s_NumberOfProcesses;
+  const SizeValueType rank      = s_Rank;
+  const SizeValueType quotient  = n / size;
+  const SizeValueType remainder = n % size;
+  begin = rank * quotient + ( rank < remainder ? rank : remainder );
+  end   = begin + quotient + ( rank < remainder ? 1 : 0 );
+
+} // end GetPartition()
+
+
+/**
+ * **************** AllReduceSum *****************************
+ */
+
+void
+DistributedEvaluation
+::AllReduceSum( double * values, const SizeValueType n )
+{
+#ifdef ELASTIX_USE_MPI
+  if( s_NumberOfProcesses > 1 && n > 0 )
+  {
+    /** MPI counts are ints, so reduce long vectors in chunks. */
+    const SizeValueType chunkSize = 1 << 28;
+    for( SizeValueType offset = 0; offset < n; offset += chunkSize )
+    {
+      const SizeValueType count = ( n - offset < chunkSize ) ? n - offset : chunkSize;
+      MPI_Allreduce( MPI_IN_PLACE, values + offset, static_cast< int >( count ),
+        MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    }
+  }
+#else
+  (void)values;
+  (void)n;
+#endif
+
+} // end AllReduceSum()
+
+
+/**
+ * **************** AllReduceSum *****************************
+ */
+
+void
+DistributedEvaluation
+::AllReduceSum( SizeValueType & value )
+{
+#ifdef ELASTIX_USE_MPI
+  if( s_NumberOfProcesses > 1 )
+  {
+    unsigned long long sum = value;
+    MPI_Allreduce( MPI_IN_PLACE, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+    value = static_cast< SizeValueType >( sum );
+  }
+#else
+  (void)value;
+#endif
+
+} // end AllReduceSum()
+
+
+} // end namespace itk
@@ -0,0 +1,90 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDistributedEvaluation_h
+#define __itkDistributedEvaluation_h
+
+#include "itkIntTypes.h"
+
+namespace itk
+{
+
+/** \class DistributedEvaluation
+ *
+ * \brief The processes that evaluate one registration together, with MPI.
+ *
+ * When elastix is built with ELASTIX_USE_MPI and started with mpirun, every
+ * process runs the same registration, with the same images, parameters and
+ * random seeds, and therefore draws the same samples. Metrics that support
+ * it evaluate only the part of the samples returned by GetPartition(), and
+ * sum their partial values and derivatives with AllReduceSum(), so that
+ * every process continues with the same value and derivative.
+ *
+ * Without ELASTIX_USE_MPI there is a single process, and all functions are
+ * trivial.
+ *
+ * \ingroup ITKCommon
+ */
+
+class DistributedEvaluation
+{
+public:
+
+  /** Initialize MPI; called once, at the start of main(). */
+  static void Initialize( int * argc, char *** argv );
+
+  /** Finalize MPI; called once, at the end of main(). */
+  static void Finalize( void );
+
+  /** The rank of this process, and the number of processes. */
+  static unsigned int GetRank( void ) { return s_Rank; }
+  static unsigned int GetNumberOfProcesses( void ) { return s_NumberOfProcesses; }
+
+  /** The range [begin, end) of the n samples that this process evaluates. */
+  static void GetPartition( const SizeValueType n, SizeValueType & begin, SizeValueType & end );
+
+  /** Replace the values of this process by their sum over all processes. */
+  static void AllReduceSum( double * values, const SizeValueType n );
+
+  static void AllReduceSum( SizeValueType & value );
+
+  /** Calls Initialize() on construction and Finalize() on destruction, so
+   * that every return from main() finalizes MPI. */
+  class Session
+  {
+public:
+
+    Session( int * argc, char *** argv ) { DistributedEvaluation::Initialize( argc, argv ); }
+    ~Session() { DistributedEvaluation::Finalize(); }
+
+private:
+
+    Session( const Session & );      // purposely not implemented
+    void operator=( const Session & ); // purposely not implemented
+
+  };
+
+private:
+
+  static unsigned int s_Rank;
+  static unsigned int s_NumberOfProcesses;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkDistributedEvaluation_h
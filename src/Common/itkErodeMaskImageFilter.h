@@ -20,6 +20,7 @@
 
 #include "itkImageToImageFilter.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
+#include <vector>
 
 namespace itk
 {
@@ -48,6 +49,13 @@ namespace itk
  *   the derivative of the metric.\n
  *   --> <tt>radius = static_cast<unsigned long>( 2 * schedule + 1 );</tt>
  *
+ * Since the parabolic erosion of a mask by a radius r1 followed by an
+ * erosion by r2 equals an erosion by r1 + r2, the eroded masks of all
+ * resolution levels can be computed in one go, each level starting from the
+ * level with the next smaller radius. When CacheErodedMasks is on, the filter
+ * does so on its first update and keeps the results, so that changing only
+ * the ResolutionLevel just hands out the cached mask. The cache is rebuilt
+ * when the input mask, the schedule or IsMovingMask change.
  *
  * \sa ParabolicErodeImageFilter
  *
@@ -117,6 +125,16 @@ public:
   itkSetMacro( ResolutionLevel, unsigned int );
   itkGetConstMacro( ResolutionLevel, unsigned int );
 
+  /** Set/Get whether the eroded masks of all resolution levels are computed
+   * incrementally on the first update and cached. Default: false.
+   */
+  itkSetMacro( CacheErodedMasks, bool );
+  itkGetConstMacro( CacheErodedMasks, bool );
+  itkBooleanMacro( CacheErodedMasks );
+
+  /** Release the cached eroded masks. */
+  virtual void ReleaseErodedMasks( void );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro( SameDimensionCheck,
@@ -138,6 +156,25 @@ protected:
    */
   virtual void GenerateData( void );
 
+  /** Typedef for the per dimension erosion radius, in voxels. */
+  typedef FixedArray< unsigned long,
+    itkGetStaticConstMacro( ImageDimension ) >            RadiusType;
+
+  /** Compute the erosion radius of a resolution level. */
+  virtual void ComputeRadius( unsigned int level, RadiusType & radius ) const;
+
+  /** Erode an image with the given radius, using the parabolic erosion filter.
+   * A radius of zero leaves that dimension untouched.
+   */
+  virtual OutputImagePointer ErodeImage( const InputImageType * image,
+    const RadiusType & radius ) const;
+
+  /** Incrementally compute the eroded masks of all resolution levels. */
+  virtual void ComputeErodedMasks( void );
+
+  /** Check whether the cached masks belong to the current settings. */
+  virtual bool ErodedMasksAreUpToDate( void ) const;
+
 private:
 
   ErodeMaskImageFilter( const Self & );    // purposely not implemented
@@ -146,6 +183,14 @@ private:
   bool         m_IsMovingMask;
   unsigned int m_ResolutionLevel;
   ScheduleType m_Schedule;
+  bool         m_CacheErodedMasks;
+
+  /** The cache, and the settings it was computed for. */
+  std::vector< OutputImagePointer > m_ErodedMasks;
+  ScheduleType                      m_ErodedMasksSchedule;
+  bool                              m_ErodedMasksIsMovingMask;
+  const InputImageType *            m_ErodedMasksInput;
+  unsigned long                     m_ErodedMasksInputMTime;
 
 };
 
@@ -35,6 +35,10 @@ ErodeMaskImageFilter< TImage >
 {
   this->m_IsMovingMask    = false;
   this->m_ResolutionLevel = 0;
+  this->m_CacheErodedMasks = false;
+  this->m_ErodedMasksIsMovingMask = false;
+  this->m_ErodedMasksInput        = 0;
+  this->m_ErodedMasksInputMTime   = 0;
 
   ScheduleType defaultSchedule( 1, InputImageDimension );
   defaultSchedule.Fill( NumericTraits< unsigned int >::OneValue() );
@@ -52,33 +56,87 @@ void
 ErodeMaskImageFilter< TImage >
 ::GenerateData( void )
 {
-  /** Typedefs. */
-  //typedef itk::ThresholdImageFilter<InputImageType> ThresholdFilterType;
-  typedef itk::ParabolicErodeImageFilter<
-    InputImageType, OutputImageType >               ErodeFilterType;
-  typedef typename ErodeFilterType::RadiusType     RadiusType;
-  typedef typename ErodeFilterType::ScalarRealType ScalarRealType;
+  /** Erode just the requested level if the cache is not wanted. */
+  if( !this->m_CacheErodedMasks )
+  {
+    RadiusType radius;
+    this->ComputeRadius( this->GetResolutionLevel(), radius );
+    OutputImagePointer eroded = this->ErodeImage( this->GetInput(), radius );
+    this->GraftOutput( eroded );
+    return;
+  }
+
+  /** Otherwise compute all levels at once, and hand out the requested one. */
+  if( !this->ErodedMasksAreUpToDate() )
+  {
+    this->ComputeErodedMasks();
+  }
+
+  if( this->GetResolutionLevel() >= this->m_ErodedMasks.size() )
+  {
+    itkExceptionMacro( << "ERROR: ResolutionLevel " << this->GetResolutionLevel()
+                       << " is not covered by the schedule." );
+  }
+
+  /** Graft the cached mask back onto the filter's output.
+   * this copies back the region ivars and meta-data.
+   */
+  this->GraftOutput( this->m_ErodedMasks[ this->GetResolutionLevel() ] );
+
+} // end GenerateData()
 
-  /** Get the correct radius. */
-  RadiusType     radiusarray;
-  ScalarRealType radius   = 0.0;
-  ScalarRealType schedule = 0.0;
+
+/**
+ * ************* ComputeRadius *******************
+ */
+
+template< class TImage >
+void
+ErodeMaskImageFilter< TImage >
+::ComputeRadius( unsigned int level, RadiusType & radius ) const
+{
   for( unsigned int i = 0; i < InputImageDimension; ++i )
   {
-    schedule = static_cast< ScalarRealType >(
-      this->GetSchedule()[ this->GetResolutionLevel() ][ i ] );
+    const unsigned long schedule = this->GetSchedule()[ level ][ i ];
     if( !this->GetIsMovingMask() )
     {
-      radius = schedule + 1.0;
+      radius[ i ] = schedule + 1;
     }
     else
     {
-      radius = 2.0 * schedule + 1.0;
+      radius[ i ] = 2 * schedule + 1;
     }
-    // Very specific computation for the parabolic erosion filter:
-    radius = radius * radius / 2.0 + 1.0;
+  }
+
+} // end ComputeRadius()
+
+
+/**
+ * ************* ErodeImage *******************
+ */
+
+template< class TImage >
+typename ErodeMaskImageFilter< TImage >::OutputImagePointer
+ErodeMaskImageFilter< TImage >
+::ErodeImage( const InputImageType * image, const RadiusType & radius ) const
+{
+  /** Typedefs. */
+  //typedef itk::ThresholdImageFilter<InputImageType> ThresholdFilterType;
+  typedef itk::ParabolicErodeImageFilter<
+    InputImageType, OutputImageType >               ErodeFilterType;
+  typedef typename ErodeFilterType::RadiusType     ScaleType;
+  typedef typename ErodeFilterType::ScalarRealType ScalarRealType;
 
-    radiusarray.SetElement( i, radius );
+  /** Very specific computation for the parabolic erosion filter.
+   * With a scale of r * r / 2 + 1, a voxel survives when no
+   * zero voxel is within r voxels along the dimension. A scale of zero
+   * leaves the dimension untouched.
+   */
+  ScaleType scale;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    const ScalarRealType r = static_cast< ScalarRealType >( radius[ i ] );
+    scale.SetElement( i, radius[ i ] > 0 ? r * r / 2.0 + 1.0 : 0.0 );
   }
 
   /** Threshold the data first. Every voxel with intensity >= 1 is used.
@@ -91,17 +149,145 @@ ErodeMaskImageFilter< TImage >
   /** Create and run the erosion filter. */
   typename ErodeFilterType::Pointer erosion = ErodeFilterType::New();
   erosion->SetUseImageSpacing( false );
-  erosion->SetScale( radiusarray );
+  erosion->SetScale( scale );
+  erosion->SetNumberOfThreads( this->GetNumberOfThreads() );
   //erosion->SetInput( threshold->GetOutput() );
-  erosion->SetInput( this->GetInput() );
+  erosion->SetInput( image );
   erosion->Update();
 
-  /** Graft the output of the mini-pipeline back onto the filter's output.
-   * this copies back the region ivars and meta-data.
+  OutputImagePointer eroded = erosion->GetOutput();
+  eroded->DisconnectPipeline();
+  return eroded;
+
+} // end ErodeImage()
+
+
+/**
+ * ************* ComputeErodedMasks *******************
+ */
+
+template< class TImage >
+void
+ErodeMaskImageFilter< TImage >
+::ComputeErodedMasks( void )
+{
+  this->ReleaseErodedMasks();
+
+  const unsigned int numberOfLevels = this->GetSchedule().rows();
+  std::vector< RadiusType >    radii( numberOfLevels );
+  std::vector< unsigned long > sums( numberOfLevels, 0 );
+  for( unsigned int level = 0; level < numberOfLevels; ++level )
+  {
+    this->ComputeRadius( level, radii[ level ] );
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      sums[ level ] += radii[ level ][ i ];
+    }
+  }
+
+  /** Visit the levels from the smallest to the largest radius. Each level
+   * starts from the largest already eroded level that it contains
+   * dimension-wise, and only erodes the difference.
    */
-  this->GraftOutput( erosion->GetOutput() );
+  std::vector< bool > done( numberOfLevels, false );
+  this->m_ErodedMasks.resize( numberOfLevels );
+  for( unsigned int n = 0; n < numberOfLevels; ++n )
+  {
+    /** Find the smallest level not done yet. */
+    unsigned int level = numberOfLevels;
+    for( unsigned int l = 0; l < numberOfLevels; ++l )
+    {
+      if( !done[ l ] && ( level == numberOfLevels || sums[ l ] < sums[ level ] ) )
+      {
+        level = l;
+      }
+    }
 
-} // end GenerateData()
+    /** Find the best starting point. */
+    const InputImageType * base = this->GetInput();
+    RadiusType             baseRadius;
+    baseRadius.Fill( 0 );
+    unsigned long baseSum = 0;
+    for( unsigned int l = 0; l < numberOfLevels; ++l )
+    {
+      if( !done[ l ] || sums[ l ] <= baseSum )
+      {
+        continue;
+      }
+      bool contained = true;
+      for( unsigned int i = 0; i < InputImageDimension; ++i )
+      {
+        contained &= radii[ l ][ i ] <= radii[ level ][ i ];
+      }
+      if( contained )
+      {
+        base       = this->m_ErodedMasks[ l ];
+        baseRadius = radii[ l ];
+        baseSum    = sums[ l ];
+      }
+    }
+
+    /** Erode the difference, or share the mask if there is none. */
+    if( baseSum == sums[ level ] )
+    {
+      this->m_ErodedMasks[ level ] = const_cast< OutputImageType * >( base );
+    }
+    else
+    {
+      RadiusType difference;
+      for( unsigned int i = 0; i < InputImageDimension; ++i )
+      {
+        difference[ i ] = radii[ level ][ i ] - baseRadius[ i ];
+      }
+      this->m_ErodedMasks[ level ] = this->ErodeImage( base, difference );
+    }
+    done[ level ] = true;
+
+  } // end for levels
+
+  /** Remember the settings the cache belongs to. */
+  this->m_ErodedMasksSchedule     = this->GetSchedule();
+  this->m_ErodedMasksIsMovingMask = this->GetIsMovingMask();
+  this->m_ErodedMasksInput        = this->GetInput();
+  this->m_ErodedMasksInputMTime   = this->GetInput()->GetMTime();
+
+} // end ComputeErodedMasks()
+
+
+/**
+ * ************* ErodedMasksAreUpToDate *******************
+ */
+
+template< class TImage >
+bool
+ErodeMaskImageFilter< TImage >
+::ErodedMasksAreUpToDate( void ) const
+{
+  return !this->m_ErodedMasks.empty()
+         && this->m_ErodedMasksInput == this->GetInput()
+         && this->m_ErodedMasksInputMTime == this->GetInput()->GetMTime()
+         && this->m_ErodedMasksIsMovingMask == this->GetIsMovingMask()
+         && this->m_ErodedMasksSchedule.rows() == this->GetSchedule().rows()
+         && this->m_ErodedMasksSchedule.cols() == this->GetSchedule().cols()
+         && this->m_ErodedMasksSchedule == this->GetSchedule();
+
+} // end ErodedMasksAreUpToDate()
+
+
+/**
+ * ************* ReleaseErodedMasks *******************
+ */
+
+template< class TImage >
+void
+ErodeMaskImageFilter< TImage >
+::ReleaseErodedMasks( void )
+{
+  this->m_ErodedMasks.clear();
+  this->m_ErodedMasksInput      = 0;
+  this->m_ErodedMasksInputMTime = 0;
+
+} // end ReleaseErodedMasks()
 
 
 } // end namespace itk
@@ -20,6 +20,7 @@
 
 #include "itkMultiResolutionPyramidImageFilter.h"
 #include "itkSmoothingRecursiveGaussianImageFilter.h"
+#include "itkMultiThreader.h"
 
 namespace itk
 {
@@ -96,7 +97,20 @@ namespace itk
  *
  * The GenericMultiResolutionPyramidImageFilter provides direct control to
  * compute only single level of the pyramid via SetCurrentLevel() and
- * SetComputeOnlyForCurrentLevel() methods.
+ * SetComputeOnlyForCurrentLevel() methods. In that mode only the output of
+ * the current level is allocated; the outputs of the other levels are
+ * released when the current level changes. ReleaseOutputOfCurrentLevel()
+ * releases the current level as well, for example when the resolution that
+ * used it is finished. The full resolution smoothed image, which is an
+ * intermediate result when both smoothing and rescaling are performed, is
+ * released directly after rescaling. Together this keeps the peak memory
+ * close to the size of the input plus one smoothed copy.
+ *
+ * With SetComputeNextLevelInBackground() the output of the next level is
+ * computed by a background thread as soon as the current level is done,
+ * so that it is ready when the current level changes. In a registration
+ * the finer level is then computed while the coarser level is optimized.
+ * This costs the memory of one more level.
  *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
@@ -220,6 +234,21 @@ public:
   itkGetConstMacro( ComputeOnlyForCurrentLevel, bool );
   itkBooleanMacro( ComputeOnlyForCurrentLevel );
 
+  /** Release the output of the current level. Only has effect when
+   * ComputeOnlyForCurrentLevel is true. The output is recomputed when it
+   * is requested again.
+   */
+  virtual void ReleaseOutputOfCurrentLevel( void );
+
+  /** Set/Get whether the output of the next level is computed by a
+   * background thread, after the output of the current level has been
+   * computed. Only has effect when ComputeOnlyForCurrentLevel is true.
+   * Default: false.
+   */
+  itkSetMacro( ComputeNextLevelInBackground, bool );
+  itkGetConstMacro( ComputeNextLevelInBackground, bool );
+  itkBooleanMacro( ComputeNextLevelInBackground );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro( SameDimensionCheck,
@@ -232,7 +261,7 @@ public:
 protected:
 
   GenericMultiResolutionPyramidImageFilter();
-  ~GenericMultiResolutionPyramidImageFilter() {}
+  ~GenericMultiResolutionPyramidImageFilter();
 
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
@@ -259,14 +288,48 @@ protected:
   /** Generate the output data. */
   virtual void GenerateData( void );
 
+  /** Compute the outputs of all levels, or of the current level. */
+  void GenerateLevels( void );
+
   /** Release the output data when the current level is used. */
   void ReleaseOutputs( void );
 
+  /** Graft the input into the output of a level that is neither smoothed
+   * nor rescaled, and of which the output type equals the input type.
+   * Returns whether the input was grafted.
+   */
+  bool GraftInputIntoLevel( const unsigned int level );
+
+  /** Start computing the output of a level in a background thread, with a
+   * copy of this filter.
+   */
+  void StartComputingLevelInBackground( const unsigned int level );
+
+  /** Wait until the background thread, if any, is finished. */
+  void WaitForBackgroundLevel( void );
+
+  /** Wait for and graft the output of the background thread, if it
+   * computed the current level. Returns whether the output was grafted.
+   */
+  bool GraftBackgroundLevel( void );
+
+  /** The function executed by the background thread. */
+  static ITK_THREAD_RETURN_TYPE BackgroundThreaderCallback( void * arg );
+
   SmoothingScheduleType m_SmoothingSchedule;
   unsigned int          m_CurrentLevel;
   bool                  m_ComputeOnlyForCurrentLevel;
   bool                  m_SmoothingScheduleDefined;
 
+  /** The computation of the next level in the background. */
+  bool                   m_ComputeNextLevelInBackground;
+  Pointer                m_BackgroundFilter;
+  unsigned int           m_BackgroundLevel;
+  bool                   m_BackgroundLevelIsValid;
+  MultiThreader::Pointer m_BackgroundThreader;
+  ThreadIdType           m_BackgroundThreadId;
+  bool                   m_BackgroundThreadIsRunning;
+
 private:
 
   /** Typedef for smoother. Smooth always happens first, then only from
@@ -23,6 +23,8 @@
 #include "itkResampleImageFilter.h"
 #include "itkShrinkImageFilter.h"
 #include "itkImageAlgorithm.h"
+#include "itkTraceEventRecorder.h"
+#include "itkHardwareCounters.h"
 
 namespace // anonymous namespace
 {
@@ -65,9 +67,27 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
   temp.Fill( NumericTraits< ScalarRealType >::ZeroValue() );
   this->m_SmoothingSchedule        = temp;
   this->m_SmoothingScheduleDefined = false;
+
+  this->m_ComputeNextLevelInBackground = false;
+  this->m_BackgroundLevel              = 0;
+  this->m_BackgroundLevelIsValid       = false;
+  this->m_BackgroundThreadId           = 0;
+  this->m_BackgroundThreadIsRunning    = false;
 } // end Constructor
 
 
+/**
+ * ******************* Destructor ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::~GenericMultiResolutionPyramidImageFilter()
+{
+  this->WaitForBackgroundLevel();
+} // end Destructor
+
+
 /**
  * ******************* SetNumberOfLevels ***********************
  */
@@ -110,6 +130,14 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
     }
     this->ReleaseOutputs();
 
+    /** A level computed in the background for another level is of no use. */
+    if( this->m_BackgroundFilter.IsNotNull()
+      && this->m_BackgroundLevel != this->m_CurrentLevel )
+    {
+      this->WaitForBackgroundLevel();
+      this->m_BackgroundFilter = 0;
+    }
+
     /** Only set the modified flag for this filter if the output is computed per level. */
     if( this->m_ComputeOnlyForCurrentLevel )
     {
@@ -265,6 +293,36 @@ template< class TInputImage, class TOutputImage, class TPrecisionType >
 void
 GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
 ::GenerateData( void )
+{
+  TraceEventScope traceScope( "GenericPyramid::GenerateData", "pyramid" );
+  HardwareCounterScope counterScope( "GenericPyramid::GenerateData" );
+
+  /** Take the output of the current level from the background thread, if
+   * it computed that level, and compute it otherwise.
+   */
+  if( !this->GraftBackgroundLevel() )
+  {
+    this->GenerateLevels();
+  }
+
+  /** Start on the next level, which is needed after the current one. */
+  if( this->m_ComputeOnlyForCurrentLevel && this->m_ComputeNextLevelInBackground
+    && this->m_CurrentLevel + 1 < this->m_NumberOfLevels )
+  {
+    this->StartComputingLevelInBackground( this->m_CurrentLevel + 1 );
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ******************* GenerateLevels ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GenerateLevels( void )
 {
   // Depending on user setting of the SetUseMultiResolutionRescaleSchedule() and
   // SetUseMultiResolutionSmoothingSchedule()
@@ -343,6 +401,15 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 
     if( this->ComputeForCurrentLevel( level ) )
     {
+      // A level without smoothing and rescaling shares the pixels of the
+      // input, instead of a copy of the full resolution image. This matters
+      // for large, memory mapped inputs, whose pages are then only loaded
+      // where the registration reads them.
+      if( this->GraftInputIntoLevel( level ) )
+      {
+        continue;
+      }
+
       // Allocate memory for each output
       OutputImagePointer outputPtr = this->GetOutput( level );
       outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
@@ -381,7 +448,165 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 
     }
   } // end for ilevel
-}   // end GenerateData()
+}   // end GenerateLevels()
+
+
+/**
+ * ******************* GraftInputIntoLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+bool
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GraftInputIntoLevel( const unsigned int level )
+{
+  /** Only for a level that would be a plain copy of an input of the same type. */
+  const OutputImageType * input = dynamic_cast< const OutputImageType * >( this->GetInput() );
+  SigmaArrayType          sigmaArray;
+  RescaleFactorArrayType  shrinkFactors;
+  this->GetSigma( level, sigmaArray );
+  this->GetShrinkFactors( level, shrinkFactors );
+  if( input == 0 || !this->AreSigmasAllZeros( sigmaArray )
+    || !this->AreRescaleFactorsAllOnes( shrinkFactors ) )
+  {
+    return false;
+  }
+
+  /** The output of such a level has the geometry of the input, so the
+   * graft only shares the pixel container; the registration never writes it.
+   */
+  this->GraftNthOutput( level, const_cast< OutputImageType * >( input ) );
+  return true;
+
+} // end GraftInputIntoLevel()
+
+
+/**
+ * ******************* StartComputingLevelInBackground ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::StartComputingLevelInBackground( const unsigned int level )
+{
+  this->WaitForBackgroundLevel();
+
+  /** The copy reads the input through a graft without a source, so that
+   * the background thread does not update the upstream pipeline.
+   */
+  InputImagePointer input = InputImageType::New();
+  input->Graft( this->GetInput() );
+
+  /** Copy the settings; the schedules are not clamped again. */
+  Pointer filter = Self::New();
+  filter->SetNumberOfLevels( this->m_NumberOfLevels );
+  filter->Superclass::SetSchedule( this->m_Schedule );
+  filter->m_SmoothingSchedule        = this->m_SmoothingSchedule;
+  filter->m_SmoothingScheduleDefined = this->m_SmoothingScheduleDefined;
+  filter->SetUseShrinkImageFilter( this->GetUseShrinkImageFilter() );
+  filter->SetNumberOfThreads( this->GetNumberOfThreads() );
+  filter->SetComputeOnlyForCurrentLevel( true );
+  filter->SetCurrentLevel( level );
+  filter->SetInput( input );
+
+  this->m_BackgroundFilter       = filter;
+  this->m_BackgroundLevel        = level;
+  this->m_BackgroundLevelIsValid = false;
+  if( this->m_BackgroundThreader.IsNull() )
+  {
+    this->m_BackgroundThreader = MultiThreader::New();
+  }
+  this->m_BackgroundThreadId = this->m_BackgroundThreader->SpawnThread(
+    Self::BackgroundThreaderCallback, this );
+  this->m_BackgroundThreadIsRunning = true;
+
+} // end StartComputingLevelInBackground()
+
+
+/**
+ * ******************* WaitForBackgroundLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::WaitForBackgroundLevel( void )
+{
+  if( this->m_BackgroundThreadIsRunning )
+  {
+    /** TerminateThread() joins the thread. */
+    this->m_BackgroundThreader->TerminateThread( this->m_BackgroundThreadId );
+    this->m_BackgroundThreadIsRunning = false;
+  }
+} // end WaitForBackgroundLevel()
+
+
+/**
+ * ******************* GraftBackgroundLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+bool
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GraftBackgroundLevel( void )
+{
+  if( !this->m_ComputeOnlyForCurrentLevel || this->m_BackgroundFilter.IsNull()
+    || this->m_BackgroundLevel != this->m_CurrentLevel )
+  {
+    return false;
+  }
+
+  this->WaitForBackgroundLevel();
+  Pointer filter = this->m_BackgroundFilter;
+  this->m_BackgroundFilter = 0;
+
+  /** Only use the result if it is exactly what is requested now. On a
+   * failure the level is computed again, which reports the error.
+   */
+  OutputImageType * computed  = filter->GetOutput( this->m_CurrentLevel );
+  OutputImageType * outputPtr = this->GetOutput( this->m_CurrentLevel );
+  if( !this->m_BackgroundLevelIsValid
+    || computed->GetLargestPossibleRegion() != outputPtr->GetLargestPossibleRegion()
+    || computed->GetBufferedRegion() != outputPtr->GetRequestedRegion()
+    || computed->GetSpacing() != outputPtr->GetSpacing()
+    || computed->GetOrigin() != outputPtr->GetOrigin() )
+  {
+    return false;
+  }
+
+  this->GraftNthOutput( this->m_CurrentLevel, computed );
+  return true;
+
+} // end GraftBackgroundLevel()
+
+
+/**
+ * ******************* BackgroundThreaderCallback ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+ITK_THREAD_RETURN_TYPE
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::BackgroundThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  Self * self = static_cast< Self * >( infoStruct->UserData );
+
+  try
+  {
+    self->m_BackgroundFilter->GetOutput( self->m_BackgroundLevel )->UpdateLargestPossibleRegion();
+    self->m_BackgroundLevelIsValid = true;
+  }
+  catch( ... )
+  {
+    self->m_BackgroundLevelIsValid = false;
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end BackgroundThreaderCallback()
 
 
 /**
@@ -439,8 +664,11 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 
   // Rescaling is done with input and output type being equal: return 1
   // Input and output are equal only if the smoother was used previously.
+  // The full resolution smoothed image is only needed as input of the
+  // rescaler, so let the rescaler release it as soon as it is done.
   if( sameType )
   {
+    smoother->ReleaseDataFlagOn();
     rescaleSameTypes->SetInput( smoother->GetOutput() );
     return 1;
   }
@@ -698,6 +926,25 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 } // end ReleaseOutputs()
 
 
+/**
+ * ******************* ReleaseOutputOfCurrentLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::ReleaseOutputOfCurrentLevel( void )
+{
+  if( this->m_ComputeOnlyForCurrentLevel
+    && this->m_CurrentLevel < this->m_NumberOfLevels )
+  {
+    // ReleaseData() also informs the pipeline that the data has to be
+    // regenerated when it is requested again.
+    this->GetOutput( this->m_CurrentLevel )->ReleaseData();
+  }
+} // end ReleaseOutputOfCurrentLevel()
+
+
 /**
  * ******************* ComputeForCurrentLevel ***********************
  */
@@ -914,6 +1161,8 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
      << this->m_CurrentLevel << std::endl;
   os << indent << "ComputeOnlyForCurrentLevel: "
      << ( this->m_ComputeOnlyForCurrentLevel ? "true" : "false" ) << std::endl;
+  os << indent << "ComputeNextLevelInBackground: "
+     << ( this->m_ComputeNextLevelInBackground ? "true" : "false" ) << std::endl;
   os << indent << "SmoothingScheduleDefined: "
      << ( this->m_SmoothingScheduleDefined ? "true" : "false" ) << std::endl;
   os << indent << "Smoothing Schedule: ";
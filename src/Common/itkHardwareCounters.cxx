@@ -0,0 +1,288 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkHardwareCounters.h"
+
+#include "itkRealTimeClock.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+
+#if defined( __linux__ )
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cstring>
+#define ELX_HAVE_PERF_EVENT
+#endif
+
+namespace itk
+{
+
+/** Variables of the process-wide counters. */
+bool HardwareCounters::s_Enabled = false;
+
+static HardwareCounters::TableType GlobalHardwareCounterTable;
+static RealTimeClock::Pointer      GlobalHardwareCounterClock;
+static SimpleFastMutexLock         GlobalHardwareCounterMutex;
+
+#ifdef ELX_HAVE_PERF_EVENT
+
+/** The counters of a thread: a group of perf events, led by the cycles.
+ * They are opened on the first read in a thread, and closed when the
+ * thread ends. */
+struct PerfEventGroup
+{
+  int m_FileDescriptors[ 3 ];
+};
+
+static pthread_key_t  PerfEventGroupKey;
+static pthread_once_t PerfEventGroupKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * ****************** ClosePerfEventGroup *********************************
+ */
+
+static void
+ClosePerfEventGroup( void * arg )
+{
+  PerfEventGroup * group = static_cast< PerfEventGroup * >( arg );
+  for( int i = 2; i >= 0; --i )
+  {
+    if( group->m_FileDescriptors[ i ] >= 0 )
+    {
+      close( group->m_FileDescriptors[ i ] );
+    }
+  }
+  delete group;
+
+} // end ClosePerfEventGroup()
+
+
+/**
+ * ****************** CreatePerfEventGroupKey *********************************
+ */
+
+static void
+CreatePerfEventGroupKey( void )
+{
+  pthread_key_create( &PerfEventGroupKey, ClosePerfEventGroup );
+
+} // end CreatePerfEventGroupKey()
+
+
+/**
+ * ****************** OpenPerfEvent *********************************
+ */
+
+static int
+OpenPerfEvent( const unsigned long long config, const int groupFileDescriptor )
+{
+  struct perf_event_attr attributes;
+  std::memset( &attributes, 0, sizeof( attributes ) );
+  attributes.type           = PERF_TYPE_HARDWARE;
+  attributes.size           = sizeof( attributes );
+  attributes.config         = config;
+  attributes.read_format    = PERF_FORMAT_GROUP;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv     = 1;
+
+  /** The calling thread, on any CPU. */
+  return static_cast< int >( syscall( __NR_perf_event_open, &attributes, 0, -1,
+    groupFileDescriptor, 0 ) );
+
+} // end OpenPerfEvent()
+
+
+/**
+ * ****************** GetPerfEventGroup *********************************
+ */
+
+static PerfEventGroup *
+GetPerfEventGroup( void )
+{
+  pthread_once( &PerfEventGroupKeyOnce, CreatePerfEventGroupKey );
+  PerfEventGroup * group = static_cast< PerfEventGroup * >(
+    pthread_getspecific( PerfEventGroupKey ) );
+  if( group == 0 )
+  {
+    group = new PerfEventGroup;
+    group->m_FileDescriptors[ 0 ] = OpenPerfEvent( PERF_COUNT_HW_CPU_CYCLES, -1 );
+    group->m_FileDescriptors[ 1 ] = -1;
+    group->m_FileDescriptors[ 2 ] = -1;
+    if( group->m_FileDescriptors[ 0 ] >= 0 )
+    {
+      group->m_FileDescriptors[ 1 ] = OpenPerfEvent( PERF_COUNT_HW_INSTRUCTIONS,
+        group->m_FileDescriptors[ 0 ] );
+    }
+    if( group->m_FileDescriptors[ 1 ] >= 0 )
+    {
+      /** Opened after the instructions only, so that the order of the read
+       * values is fixed. */
+      group->m_FileDescriptors[ 2 ] = OpenPerfEvent( PERF_COUNT_HW_CACHE_MISSES,
+        group->m_FileDescriptors[ 0 ] );
+    }
+    pthread_setspecific( PerfEventGroupKey, group );
+  }
+  return group;
+
+} // end GetPerfEventGroup()
+
+
+#endif // ELX_HAVE_PERF_EVENT
+
+/**
+ * ****************** CountsType::operator+= *********************************
+ */
+
+void
+HardwareCounters::CountsType::operator+=( const CountsType & other )
+{
+  this->m_Cycles         += other.m_Cycles;
+  this->m_Instructions   += other.m_Instructions;
+  this->m_CacheMisses    += other.m_CacheMisses;
+  this->m_Time           += other.m_Time;
+  this->m_NumberOfScopes += other.m_NumberOfScopes;
+
+} // end CountsType::operator+=()
+
+
+/**
+ * ****************** Enable *********************************
+ */
+
+bool
+HardwareCounters::Enable( void )
+{
+  {
+    MutexLockHolder< SimpleFastMutexLock > lock( GlobalHardwareCounterMutex );
+    if( GlobalHardwareCounterClock.IsNull() )
+    {
+      GlobalHardwareCounterClock = RealTimeClock::New();
+    }
+  }
+
+  /** Try the counters of this thread. */
+  CountsType counts;
+  s_Enabled = HardwareCounters::Read( counts );
+  return s_Enabled;
+
+} // end Enable()
+
+
+/**
+ * ****************** Disable *********************************
+ */
+
+void
+HardwareCounters::Disable( void )
+{
+  s_Enabled = false;
+
+} // end Disable()
+
+
+/**
+ * ****************** Read *********************************
+ */
+
+bool
+HardwareCounters::Read( CountsType & counts )
+{
+#ifdef ELX_HAVE_PERF_EVENT
+  PerfEventGroup * group = GetPerfEventGroup();
+  if( group->m_FileDescriptors[ 0 ] < 0 )
+  {
+    return false;
+  }
+
+  /** The group is read at once: the number of events, then their values,
+   * in the order in which they were opened. */
+  unsigned long long values[ 4 ] = { 0, 0, 0, 0 };
+  const ssize_t      size        = read( group->m_FileDescriptors[ 0 ], values, sizeof( values ) );
+  if( size < static_cast< ssize_t >( 2 * sizeof( unsigned long long ) ) )
+  {
+    return false;
+  }
+
+  counts.m_Cycles       = static_cast< double >( values[ 1 ] );
+  counts.m_Instructions = values[ 0 ] > 1 ? static_cast< double >( values[ 2 ] ) : 0.0;
+  counts.m_CacheMisses  = values[ 0 ] > 2 ? static_cast< double >( values[ 3 ] ) : 0.0;
+  counts.m_Time         = GlobalHardwareCounterClock->GetTimeInSeconds();
+  return true;
+#else
+  (void)counts;
+  return false;
+#endif
+
+} // end Read()
+
+
+/**
+ * ****************** Add *********************************
+ */
+
+void
+HardwareCounters::Add( const char * phase, const unsigned int thread,
+  const CountsType & counts )
+{
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalHardwareCounterMutex );
+  GlobalHardwareCounterTable[ PhaseThreadType( phase, thread ) ] += counts;
+
+} // end Add()
+
+
+/**
+ * ****************** AddSince *********************************
+ */
+
+void
+HardwareCounters::AddSince( const char * phase, const unsigned int thread,
+  const CountsType & start )
+{
+  CountsType counts;
+  if( !HardwareCounters::Read( counts ) )
+  {
+    return;
+  }
+  counts.m_Cycles        -= start.m_Cycles;
+  counts.m_Instructions  -= start.m_Instructions;
+  counts.m_CacheMisses   -= start.m_CacheMisses;
+  counts.m_Time          -= start.m_Time;
+  counts.m_NumberOfScopes = 1.0;
+  HardwareCounters::Add( phase, thread, counts );
+
+} // end AddSince()
+
+
+/**
+ * ****************** GetAndClear *********************************
+ */
+
+HardwareCounters::TableType
+HardwareCounters::GetAndClear( void )
+{
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalHardwareCounterMutex );
+  TableType table;
+  table.swap( GlobalHardwareCounterTable );
+  return table;
+
+} // end GetAndClear()
+
+
+} // end namespace itk
@@ -0,0 +1,162 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkHardwareCounters_h
+#define __itkHardwareCounters_h
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace itk
+{
+
+/** \class HardwareCounters
+ *
+ * \brief Collects hardware performance counters per phase and per thread.
+ *
+ * Code regions that are marked with a HardwareCounterScope count, while
+ * the counters are enabled, the CPU cycles, the instructions and the
+ * last level cache misses of the thread that runs them, and their wall
+ * time. The counts are summed per phase, the name of the scope, and per
+ * thread: 0 for the main thread and threadID + 1 for the workers of a
+ * multi-threaded callback, as in the TraceEventRecorder.
+ *
+ * The ratio of instructions to cycles, and the estimated memory bandwidth,
+ * the cache misses times the size of a cache line per second, tell whether a
+ * phase is compute-bound or memory-bound. The bandwidth is a lower bound:
+ * prefetches and write-backs are not counted.
+ *
+ * The counters use perf_event on Linux, and are not available elsewhere.
+ * They may also be blocked by /proc/sys/kernel/perf_event_paranoid, or
+ * inside a container; Enable() then returns false. Only user space is
+ * counted. When disabled, a HardwareCounterScope costs a single test of a
+ * static flag.
+ *
+ * \ingroup ITKCommon
+ */
+
+class HardwareCounters
+{
+public:
+
+  /** The counts of a phase. */
+  struct CountsType
+  {
+    double m_Cycles;
+    double m_Instructions;
+    double m_CacheMisses;
+    double m_Time;
+    double m_NumberOfScopes;
+
+    CountsType() :
+      m_Cycles( 0.0 ), m_Instructions( 0.0 ), m_CacheMisses( 0.0 ),
+      m_Time( 0.0 ), m_NumberOfScopes( 0.0 ) {}
+
+    void operator+=( const CountsType & other );
+
+  };
+
+  /** The counts per phase and thread. */
+  typedef std::pair< std::string, unsigned int > PhaseThreadType;
+  typedef std::map< PhaseThreadType, CountsType > TableType;
+
+  /** Start counting. Returns false if the counters are not available. */
+  static bool Enable( void );
+
+  /** Stop counting. The counts are kept. */
+  static void Disable( void );
+
+  static bool IsEnabled( void ) { return s_Enabled; }
+
+  /** Read the counters of the calling thread, and the wall time in seconds.
+   * Returns false if they cannot be read. */
+  static bool Read( CountsType & counts );
+
+  /** Add the counts of a scope. */
+  static void Add( const char * phase, const unsigned int thread, const CountsType & counts );
+
+  /** Add the counts since start, a Read() in the calling thread. For phases
+   * that do not fit in a scope, such as those delimited by events. */
+  static void AddSince( const char * phase, const unsigned int thread, const CountsType & start );
+
+  /** Get the counts since the previous call, and start again from zero. */
+  static TableType GetAndClear( void );
+
+  /** The assumed size of a cache line, in bytes, for the bandwidth. */
+  static double GetCacheLineSize( void ) { return 64.0; }
+
+private:
+
+  static bool s_Enabled;
+
+};
+
+/** \class HardwareCounterScope
+ *
+ * \brief Counts the lifetime of this object as a phase of the HardwareCounters.
+ *
+ * \code
+ * {
+ *   HardwareCounterScope scope( "ThreadedGetValueAndDerivative", threadID + 1 );
+ *   // ... the region to be counted
+ * }
+ * \endcode
+ *
+ * The phase must be a string literal, or otherwise outlive the scope.
+ *
+ * \ingroup ITKCommon
+ */
+
+class HardwareCounterScope
+{
+public:
+
+  HardwareCounterScope( const char * phase, const unsigned int thread = 0 ) :
+    m_Phase( phase ), m_Thread( thread ), m_Started( false )
+  {
+    if( HardwareCounters::IsEnabled() )
+    {
+      this->m_Started = HardwareCounters::Read( this->m_Start );
+    }
+  }
+
+
+  ~HardwareCounterScope()
+  {
+    if( this->m_Started )
+    {
+      HardwareCounters::AddSince( this->m_Phase, this->m_Thread, this->m_Start );
+    }
+  }
+
+
+private:
+
+  HardwareCounterScope( const HardwareCounterScope & ); // purposely not implemented
+  void operator=( const HardwareCounterScope & );       // purposely not implemented
+
+  const char *                 m_Phase;
+  unsigned int                 m_Thread;
+  bool                         m_Started;
+  HardwareCounters::CountsType m_Start;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkHardwareCounters_h
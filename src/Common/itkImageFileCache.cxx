@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageFileCache_cxx
+#define __itkImageFileCache_cxx
+
+#include "itkImageFileCache.h"
+#include "itkByteSwapper.h"
+#include "itkIntTypes.h"
+#include "itkProcessId.h"
+#include <itksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <sstream>
+
+namespace itk
+{
+
+/**
+ * ****************** CreateKey *********************************
+ */
+
+std::string
+ImageFileCacheBase
+::CreateKey( const std::string & fileName, const std::string & pixelTypeName,
+  const unsigned int pixelSize, const unsigned int dimension )
+{
+  if( !itksys::SystemTools::FileExists( fileName.c_str(), true ) )
+  {
+    return "";
+  }
+
+  std::ostringstream key;
+  key << itksys::SystemTools::CollapseFullPath( fileName.c_str() )
+      << "|" << itksys::SystemTools::ModifiedTime( fileName.c_str() )
+      << "|" << itksys::SystemTools::FileLength( fileName.c_str() )
+      << "|" << pixelTypeName << "|" << pixelSize << "|" << dimension
+      << "|" << ( ByteSwapper< int >::SystemIsBigEndian() ? "BE" : "LE" );
+  return key.str();
+
+} // end CreateKey()
+
+
+/**
+ * ****************** GetCacheFileName *********************************
+ */
+
+std::string
+ImageFileCacheBase
+::GetCacheFileName( const std::string & cacheDirectory, const std::string & key )
+{
+  /** The 64 bit FNV-1a hash of the key. */
+  uint64_t hash = 14695981039346656037ULL;
+  for( std::string::size_type i = 0; i < key.size(); ++i )
+  {
+    hash ^= static_cast< unsigned char >( key[ i ] );
+    hash *= 1099511628211ULL;
+  }
+
+  char name[ 32 ];
+  std::sprintf( name, "%08x%08x.elxcache",
+    static_cast< unsigned int >( hash >> 32 ), static_cast< unsigned int >( hash & 0xffffffffu ) );
+
+  std::string directory = cacheDirectory;
+  if( !directory.empty() && directory[ directory.size() - 1 ] != '/'
+    && directory[ directory.size() - 1 ] != '\\' )
+  {
+    directory += "/";
+  }
+  return directory + name;
+
+} // end GetCacheFileName()
+
+
+/**
+ * ****************** GetTemporaryFileName *********************************
+ */
+
+std::string
+ImageFileCacheBase
+::GetTemporaryFileName( const std::string & cacheFileName )
+{
+  return GetUniqueTemporaryFileName( cacheFileName );
+
+} // end GetTemporaryFileName()
+
+
+/**
+ * ****************** Contains *********************************
+ */
+
+bool
+ImageFileCacheBase
+::Contains( const std::string & cacheDirectory, const std::string & key )
+{
+  return itksys::SystemTools::FileExists(
+    GetCacheFileName( cacheDirectory, key ).c_str(), true );
+
+} // end Contains()
+
+
+/**
+ * ****************** GetBSplineCoefficientsDescription *********************************
+ */
+
+std::string
+ImageFileCacheBase
+::GetBSplineCoefficientsDescription( const unsigned int splineOrder )
+{
+  std::ostringstream description;
+  description << "BSplineDecompositionImageFilter|" << splineOrder;
+  return description.str();
+
+} // end GetBSplineCoefficientsDescription()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageFileCache_cxx
@@ -0,0 +1,220 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageFileCache_h
+#define __itkImageFileCache_h
+
+#include "itkImportImageContainer.h"
+#include "itkMemoryMappedFile.h"
+
+#include <string>
+
+namespace itk
+{
+
+/** \class MappedImportImageContainer
+ *
+ * \brief A pixel container that refers to the data of a memory mapped file.
+ *
+ * The container keeps the mapping alive for as long as the container exists,
+ * so that images sharing the container, for example the output of a
+ * ChangeInformationImageFilter, stay valid.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< typename TElementIdentifier, typename TElement >
+class MappedImportImageContainer :
+  public ImportImageContainer< TElementIdentifier, TElement >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef MappedImportImageContainer                           Self;
+  typedef ImportImageContainer< TElementIdentifier, TElement > Superclass;
+  typedef SmartPointer< Self >                                 Pointer;
+  typedef SmartPointer< const Self >                           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MappedImportImageContainer, ImportImageContainer );
+
+  /** Refer to the data of the mapped file, at the given byte offset. */
+  void SetMappedFile( MemoryMappedFile * mappedFile,
+    const SizeValueType offset, const TElementIdentifier size )
+  {
+    this->m_MappedFile = mappedFile;
+    TElement * data = reinterpret_cast< TElement * >(
+      static_cast< char * >( mappedFile->GetData() ) + offset );
+    this->SetImportPointer( data, size, false );
+  }
+
+
+protected:
+
+  MappedImportImageContainer() {}
+  virtual ~MappedImportImageContainer() {}
+
+private:
+
+  MappedImportImageContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & );             // purposely not implemented
+
+  MemoryMappedFile::Pointer m_MappedFile;
+
+};
+
+/** \class ImageFileCacheBase
+ *
+ * \brief The part of the ImageFileCache that does not depend on the image type.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ImageFileCacheBase
+{
+public:
+
+  /** The key of an image file: its full path, modification time and size,
+   * and the pixel type and dimension of the image that is read from it.
+   * Returns an empty string if the file does not exist.
+   */
+  static std::string CreateKey( const std::string & fileName,
+    const std::string & pixelTypeName, const unsigned int pixelSize,
+    const unsigned int dimension );
+
+  /** The name of the cache file for a key. */
+  static std::string GetCacheFileName( const std::string & cacheDirectory,
+    const std::string & key );
+
+  /** A temporary file name next to the cache file, unique for every writer,
+   * also for concurrent writers in this process, see GetUniqueTemporaryFileName(). */
+  static std::string GetTemporaryFileName( const std::string & cacheFileName );
+
+  /** Whether the cache directory has a cache file for a key. The file is
+   * not checked; Load() may still reject it.
+   */
+  static bool Contains( const std::string & cacheDirectory, const std::string & key );
+
+  /** The description of the B-spline coefficients of an image, for
+   * CreateContentKey(), such that the interpolators and the metrics that
+   * compute the same coefficients find the same cache file.
+   */
+  static std::string GetBSplineCoefficientsDescription( const unsigned int splineOrder );
+
+  /** The first bytes of a cache file. */
+  static const char * GetMagic( void ) { return "ELXIMGC1"; }
+
+  /** The pixel data starts at a multiple of this number of bytes. */
+  itkStaticConstMacro( DataAlignment, unsigned int, 64 );
+
+};
+
+/** \class ImageFileCache
+ *
+ * \brief Caches decoded images in memory mapped files, shared by processes.
+ *
+ * Reading and decompressing a large image, for example an atlas in a
+ * compressed .mha or .nii.gz file, may take longer than the registration.
+ * When many elastix or transformix processes on one machine read the same
+ * file, the decoded image can be written to a cache file once, with Store(),
+ * and mapped by all later processes, with Load(). The operating system then
+ * shares the pages of the cache file between the processes.
+ *
+ * A cache file is found by a hash of the path, the modification time and the
+ * size of the image file, and the pixel type and dimension of the image.
+ * Changing the image file therefore makes its cache file obsolete; obsolete
+ * cache files are not removed. The cache files are written in the byte order
+ * of the machine, and are meant for a local cache directory.
+ *
+ * Images that are derived from an image, such as the levels of an image
+ * pyramid or B-spline coefficients, can be cached by the content of that
+ * image instead of by a file, see CreateContentKey(), LoadWithKey() and
+ * StoreWithKey(). This lets runs on the same image skip the preprocessing.
+ *
+ * The mapping is copy-on-write, so modifying a loaded image does not change
+ * the cache file. Only images whose pixels can be copied bytewise, such as
+ * scalar images, are supported.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< class TImage >
+class ImageFileCache : public ImageFileCacheBase
+{
+public:
+
+  /** Typedefs. */
+  typedef TImage                             ImageType;
+  typedef typename ImageType::Pointer        ImagePointer;
+  typedef typename ImageType::PixelType      PixelType;
+  typedef typename ImageType::RegionType     RegionType;
+  typedef typename ImageType::PixelContainer PixelContainerType;
+  typedef MappedImportImageContainer<
+    typename PixelContainerType::ElementIdentifier, PixelType > MappedPixelContainerType;
+
+  itkStaticConstMacro( ImageDimension, unsigned int, ImageType::ImageDimension );
+
+  /** Load the image of a file from the cache directory. Returns a null
+   * pointer if the image is not cached, or if the cache file is invalid.
+   */
+  static ImagePointer Load( const std::string & cacheDirectory,
+    const std::string & fileName );
+
+  /** Store the image of a file in the cache directory. The cache file is
+   * written to a temporary file first, and then renamed, so that other
+   * processes never see a partial file. Returns false on failure.
+   */
+  static bool Store( const std::string & cacheDirectory,
+    const std::string & fileName, const ImageType * image );
+
+  /** The key of an image of this type that is computed from an input image,
+   * for example a pyramid level or the B-spline coefficients of the input.
+   * The key consists of the MD5 hash of the pixels of the input, its
+   * geometry and pixel type, the pixel type of this image type, and the
+   * description of the computation, which should contain all its settings.
+   * Hashing the input takes one pass over its pixels.
+   */
+  template< class TInputImage >
+  static std::string CreateContentKey( const TInputImage * input,
+    const std::string & description );
+
+  /** Load or store an image by its key, see CreateContentKey(). Otherwise
+   * the same as Load() and Store().
+   */
+  static ImagePointer LoadWithKey( const std::string & cacheDirectory,
+    const std::string & key );
+
+  static bool StoreWithKey( const std::string & cacheDirectory,
+    const std::string & key, const ImageType * image );
+
+protected:
+
+  /** The key of an image file, for this image type. */
+  static std::string CreateKey( const std::string & fileName );
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageFileCache.hxx"
+#endif
+
+#endif // end #ifndef __itkImageFileCache_h
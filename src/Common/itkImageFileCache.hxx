@@ -0,0 +1,343 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageFileCache_hxx
+#define __itkImageFileCache_hxx
+
+#include "itkImageFileCache.h"
+#include "itkByteSwapper.h"
+#include "itkIntTypes.h"
+#include "itksys/MD5.h"
+#include <itksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+
+namespace itk
+{
+
+/**
+ * ****************** CreateKey *********************************
+ */
+
+template< class TImage >
+std::string
+ImageFileCache< TImage >
+::CreateKey( const std::string & fileName )
+{
+  return ImageFileCacheBase::CreateKey( fileName, typeid( PixelType ).name(),
+    sizeof( PixelType ), ImageDimension );
+
+} // end CreateKey()
+
+
+/**
+ * ****************** Load *********************************
+ */
+
+template< class TImage >
+typename ImageFileCache< TImage >::ImagePointer
+ImageFileCache< TImage >
+::Load( const std::string & cacheDirectory, const std::string & fileName )
+{
+  return LoadWithKey( cacheDirectory, CreateKey( fileName ) );
+
+} // end Load()
+
+
+/**
+ * ****************** Store *********************************
+ */
+
+template< class TImage >
+bool
+ImageFileCache< TImage >
+::Store( const std::string & cacheDirectory, const std::string & fileName,
+  const ImageType * image )
+{
+  return StoreWithKey( cacheDirectory, CreateKey( fileName ), image );
+
+} // end Store()
+
+
+/**
+ * ****************** CreateContentKey *********************************
+ */
+
+template< class TImage >
+template< class TInputImage >
+std::string
+ImageFileCache< TImage >
+::CreateContentKey( const TInputImage * input, const std::string & description )
+{
+  typedef typename TInputImage::PixelType InputPixelType;
+  const unsigned int InputDimension = TInputImage::ImageDimension;
+
+  const typename TInputImage::RegionType & region = input->GetBufferedRegion();
+  if( input->GetBufferPointer() == 0 || region.GetNumberOfPixels() == 0 )
+  {
+    return "";
+  }
+
+  /** The MD5 hash of the pixels, appended in chunks that fit an int. */
+  itksysMD5 * md5 = itksysMD5_New();
+  itksysMD5_Initialize( md5 );
+  const unsigned char * data = reinterpret_cast< const unsigned char * >( input->GetBufferPointer() );
+  SizeValueType         remaining = region.GetNumberOfPixels() * sizeof( InputPixelType );
+  const SizeValueType   chunkSize = 1 << 30;
+  while( remaining > 0 )
+  {
+    const SizeValueType length = remaining < chunkSize ? remaining : chunkSize;
+    itksysMD5_Append( md5, data, static_cast< int >( length ) );
+    data      += length;
+    remaining -= length;
+  }
+  char digest[ 33 ];
+  itksysMD5_FinalizeHex( md5, digest );
+  digest[ 32 ] = '\0';
+  itksysMD5_Delete( md5 );
+
+  /** The geometry, with all digits, and the pixel types. */
+  std::ostringstream key;
+  key.precision( 17 );
+  key << "content|" << digest << "|" << region.GetIndex() << region.GetSize()
+      << "|" << input->GetSpacing() << "|" << input->GetOrigin()
+      << "|" << input->GetDirection()
+      << "|" << typeid( InputPixelType ).name() << "|" << sizeof( InputPixelType )
+      << "|" << InputDimension << "|" << typeid( PixelType ).name()
+      << "|" << sizeof( PixelType ) << "|" << ImageDimension
+      << "|" << ( ByteSwapper< int >::SystemIsBigEndian() ? "BE" : "LE" )
+      << "|" << description;
+  return key.str();
+
+} // end CreateContentKey()
+
+
+/**
+ * ****************** LoadWithKey *********************************
+ */
+
+template< class TImage >
+typename ImageFileCache< TImage >::ImagePointer
+ImageFileCache< TImage >
+::LoadWithKey( const std::string & cacheDirectory, const std::string & key )
+{
+  if( key.empty() )
+  {
+    return 0;
+  }
+
+  /** A missing or unreadable cache file is not an error. */
+  MemoryMappedFile::Pointer mappedFile = MemoryMappedFile::New();
+  try
+  {
+    mappedFile->Map( GetCacheFileName( cacheDirectory, key ) );
+  }
+  catch( ExceptionObject & )
+  {
+    return 0;
+  }
+
+  /** Parse and check the header. */
+  const char *        data   = static_cast< const char * >( mappedFile->GetData() );
+  const SizeValueType size   = mappedFile->GetSize();
+  SizeValueType       offset = 8;
+  uint32_t            keyLength      = 0;
+  uint32_t            dimension      = 0;
+  uint64_t            numberOfPixels = 0;
+  const SizeValueType fixedHeaderSize = 24 + ImageDimension * ( 8 + 8 + 8 + 8 )
+    + ImageDimension * ImageDimension * 8;
+  if( size < fixedHeaderSize || std::memcmp( data, GetMagic(), 8 ) != 0 )
+  {
+    return 0;
+  }
+  std::memcpy( &keyLength, data + offset, 4 ); offset += 4;
+  std::memcpy( &dimension, data + offset, 4 ); offset += 4;
+  std::memcpy( &numberOfPixels, data + offset, 8 ); offset += 8;
+  if( dimension != ImageDimension )
+  {
+    return 0;
+  }
+
+  typename RegionType::IndexType index;
+  typename RegionType::SizeType  regionSize;
+  typename ImageType::SpacingType   spacing;
+  typename ImageType::PointType     origin;
+  typename ImageType::DirectionType direction;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    int64_t  indexValue = 0;
+    uint64_t sizeValue  = 0;
+    double   spacingValue = 0.0;
+    double   originValue  = 0.0;
+    std::memcpy( &indexValue, data + offset, 8 );
+    std::memcpy( &sizeValue, data + offset + 8 * ImageDimension, 8 );
+    std::memcpy( &spacingValue, data + offset + 16 * ImageDimension, 8 );
+    std::memcpy( &originValue, data + offset + 24 * ImageDimension, 8 );
+    index[ i ]      = static_cast< typename RegionType::IndexType::IndexValueType >( indexValue );
+    regionSize[ i ] = static_cast< typename RegionType::SizeType::SizeValueType >( sizeValue );
+    spacing[ i ]    = spacingValue;
+    origin[ i ]     = originValue;
+    offset += 8;
+  }
+  offset += 24 * ImageDimension;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    for( unsigned int j = 0; j < ImageDimension; ++j )
+    {
+      double value = 0.0;
+      std::memcpy( &value, data + offset, 8 ); offset += 8;
+      direction[ i ][ j ] = value;
+    }
+  }
+
+  /** The full key guards against collisions of the hash in the file name. */
+  if( offset + keyLength > size
+    || key.compare( 0, std::string::npos, data + offset, keyLength ) != 0 )
+  {
+    return 0;
+  }
+  offset += keyLength;
+  offset  = ( offset + DataAlignment - 1 ) / DataAlignment * DataAlignment;
+
+  const RegionType region( index, regionSize );
+  if( numberOfPixels != region.GetNumberOfPixels()
+    || offset > size || ( size - offset ) / sizeof( PixelType ) < numberOfPixels )
+  {
+    return 0;
+  }
+
+  /** Create the image on the mapped data. */
+  typename MappedPixelContainerType::Pointer container = MappedPixelContainerType::New();
+  container->SetMappedFile( mappedFile, offset, numberOfPixels );
+
+  ImagePointer image = ImageType::New();
+  image->SetRegions( region );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->SetDirection( direction );
+  image->SetPixelContainer( container );
+
+  return image;
+
+} // end LoadWithKey()
+
+
+/**
+ * ****************** StoreWithKey *********************************
+ */
+
+template< class TImage >
+bool
+ImageFileCache< TImage >
+::StoreWithKey( const std::string & cacheDirectory, const std::string & key,
+  const ImageType * image )
+{
+  if( key.empty() || image == 0 )
+  {
+    return false;
+  }
+
+  const RegionType & region = image->GetBufferedRegion();
+  if( region != image->GetLargestPossibleRegion() )
+  {
+    return false;
+  }
+
+  /** Assemble the header. */
+  const uint32_t keyLength      = static_cast< uint32_t >( key.size() );
+  const uint32_t dimension      = ImageDimension;
+  const uint64_t numberOfPixels = region.GetNumberOfPixels();
+  std::string    header( GetMagic(), 8 );
+  header.append( reinterpret_cast< const char * >( &keyLength ), 4 );
+  header.append( reinterpret_cast< const char * >( &dimension ), 4 );
+  header.append( reinterpret_cast< const char * >( &numberOfPixels ), 8 );
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    const int64_t value = region.GetIndex()[ i ];
+    header.append( reinterpret_cast< const char * >( &value ), 8 );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    const uint64_t value = region.GetSize()[ i ];
+    header.append( reinterpret_cast< const char * >( &value ), 8 );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    const double value = image->GetSpacing()[ i ];
+    header.append( reinterpret_cast< const char * >( &value ), 8 );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    const double value = image->GetOrigin()[ i ];
+    header.append( reinterpret_cast< const char * >( &value ), 8 );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    for( unsigned int j = 0; j < ImageDimension; ++j )
+    {
+      const double value = image->GetDirection()[ i ][ j ];
+      header.append( reinterpret_cast< const char * >( &value ), 8 );
+    }
+  }
+  header += key;
+  header.resize( ( header.size() + DataAlignment - 1 ) / DataAlignment * DataAlignment, '\0' );
+
+  /** Write to a temporary file, and rename it when it is complete. */
+  if( !itksys::SystemTools::MakeDirectory( cacheDirectory.c_str() ) )
+  {
+    return false;
+  }
+  const std::string cacheFileName     = GetCacheFileName( cacheDirectory, key );
+  const std::string temporaryFileName = GetTemporaryFileName( cacheFileName );
+  {
+    std::ofstream file( temporaryFileName.c_str(), std::ios::out | std::ios::binary );
+    if( !file.is_open() )
+    {
+      return false;
+    }
+    file.write( header.data(), header.size() );
+    file.write( reinterpret_cast< const char * >( image->GetBufferPointer() ),
+      numberOfPixels * sizeof( PixelType ) );
+    if( !file )
+    {
+      file.close();
+      std::remove( temporaryFileName.c_str() );
+      return false;
+    }
+  }
+
+  /** Another process may have stored the same image in the meantime;
+   * then its cache file is kept.
+   */
+  if( std::rename( temporaryFileName.c_str(), cacheFileName.c_str() ) != 0 )
+  {
+    std::remove( temporaryFileName.c_str() );
+    return false;
+  }
+
+  return true;
+
+} // end StoreWithKey()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageFileCache_hxx
@@ -35,6 +35,11 @@ namespace itk
  * if necessary. This is useful in some cases, to avoid the use of
  * a itk::CastImageFilter (to save memory for example).
  *
+ * Compressed MetaImages (.mha and .mhd) that are written in one piece are
+ * compressed with the threads of this filter, see itk::ParallelDeflate, and
+ * written by this filter instead of the MetaImageIO. The result is an
+ * ordinary compressed MetaImage.
+ *
  */
 template< class TInputImage >
 class ITKIOImageBase_HIDDEN ImageFileCastWriter : public ImageFileWriter< TInputImage >
@@ -70,6 +75,17 @@ public:
   /** Determine the default outputcomponentType */
   std::string GetDefaultOutputComponentType( void ) const;
 
+  /** Set/Get whether compressed MetaImages are compressed with several
+   * threads. Default: true. */
+  itkSetMacro( UseParallelCompression, bool );
+  itkGetConstMacro( UseParallelCompression, bool );
+  itkBooleanMacro( UseParallelCompression );
+
+  /** Set/Get the zlib compression level, from 0 to 9, or -1 for the zlib
+   * default, used for the parallel compression. Default: -1. */
+  itkSetClampMacro( CompressionLevel, int, -1, 9 );
+  itkGetConstMacro( CompressionLevel, int );
+
 protected:
 
   ImageFileCastWriter();
@@ -110,6 +126,13 @@ protected:
   }
 
 
+  /** Write the buffer of the input, or of its cast copy, with the
+   * parallel compression if possible, and with the ImageIO otherwise. */
+  void WriteBuffer( const InputImageType * input, const void * buffer );
+
+  /** Write a compressed MetaImage header and data, compressed in parallel. */
+  void WriteCompressedMetaImage( const InputImageType * input, const void * buffer );
+
   ProcessObject::Pointer m_Caster;
 
 private:
@@ -118,6 +141,8 @@ private:
   void operator=( const Self & );      // purposely not implemented
 
   std::string m_OutputComponentType;
+  bool        m_UseParallelCompression;
+  int         m_CompressionLevel;
 };
 
 } // end namespace itk
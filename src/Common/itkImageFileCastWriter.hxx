@@ -27,6 +27,13 @@
 #include "itkVectorImage.h"
 #include "itkDefaultConvertPixelTraits.h"
 #include "itkMetaImageIO.h"
+#include "itkImageAlgorithm.h"
+#include "itkByteSwapper.h"
+#include "itkParallelDeflate.h"
+#include "itksys/SystemTools.hxx"
+
+#include <fstream>
+#include <iomanip>
 
 namespace itk
 {
@@ -36,8 +43,10 @@ template< class TInputImage >
 ImageFileCastWriter< TInputImage >
 ::ImageFileCastWriter()
 {
-  this->m_Caster              = 0;
-  this->m_OutputComponentType = this->GetDefaultOutputComponentType();
+  this->m_Caster                 = 0;
+  this->m_OutputComponentType    = this->GetDefaultOutputComponentType();
+  this->m_UseParallelCompression = true;
+  this->m_CompressionLevel       = -1;
 }
 
 
@@ -80,6 +89,22 @@ ImageFileCastWriter< TInputImage >
 
   itkDebugMacro( << "Writing file: " << this->GetFileName() );
 
+  /** When streaming, only the requested region of the input is written.
+   * If the input buffers more than that, copy the requested part, so that
+   * the buffer pointer corresponds to the IO region.
+   */
+  typename InputImageType::Pointer cacheImage;
+  const InputImageRegionType requestedRegion = input->GetRequestedRegion();
+  if( input->GetBufferedRegion() != requestedRegion )
+  {
+    cacheImage = InputImageType::New();
+    cacheImage->CopyInformation( input );
+    cacheImage->SetBufferedRegion( requestedRegion );
+    cacheImage->Allocate();
+    ImageAlgorithm::Copy( input, cacheImage.GetPointer(), requestedRegion, requestedRegion );
+    input = cacheImage;
+  }
+
   // Make sure that the image is the right type and no more than
   // four components.
   typedef typename InputImageType::PixelType ScalarType;
@@ -171,7 +196,7 @@ ImageFileCastWriter< TInputImage >
     }
 
     /** Do the writing */
-    this->GetImageIO()->Write( convertedDataBuffer );
+    this->WriteBuffer( input, convertedDataBuffer );
     /** Release the caster's memory */
     this->m_Caster = 0;
 
@@ -180,7 +205,145 @@ ImageFileCastWriter< TInputImage >
   {
     /** No casting needed or possible, just write */
     const void * dataPtr = (const void *)input->GetBufferPointer();
-    this->GetImageIO()->Write( dataPtr );
+    this->WriteBuffer( input, dataPtr );
+  }
+
+}
+
+
+//---------------------------------------------------------
+template< class TInputImage >
+void
+ImageFileCastWriter< TInputImage >
+::WriteBuffer( const InputImageType * input, const void * buffer )
+{
+  /** The parallel compression writes MetaImages in one piece. */
+  const std::string extension = itksys::SystemTools::LowerCase(
+    itksys::SystemTools::GetFilenameLastExtension( this->GetFileName() ) );
+  const bool isMetaImage = extension == ".mha" || extension == ".mhd";
+  if( this->GetUseCompression() && this->m_UseParallelCompression
+    && this->GetNumberOfThreads() > 1 && isMetaImage
+    && input->GetBufferedRegion() == input->GetLargestPossibleRegion() )
+  {
+    this->WriteCompressedMetaImage( input, buffer );
+  }
+  else
+  {
+    this->GetImageIO()->Write( buffer );
+  }
+
+}
+
+
+//---------------------------------------------------------
+template< class TInputImage >
+void
+ImageFileCastWriter< TInputImage >
+::WriteCompressedMetaImage( const InputImageType * input, const void * buffer )
+{
+  ImageIOBase * imageIO = this->GetImageIO();
+
+  /** The MetaIO name of the component type. */
+  std::string elementType;
+  switch( imageIO->GetComponentType() )
+  {
+    case ImageIOBase::CHAR: elementType   = "MET_CHAR"; break;
+    case ImageIOBase::UCHAR: elementType  = "MET_UCHAR"; break;
+    case ImageIOBase::SHORT: elementType  = "MET_SHORT"; break;
+    case ImageIOBase::USHORT: elementType = "MET_USHORT"; break;
+    case ImageIOBase::INT: elementType    = "MET_INT"; break;
+    case ImageIOBase::UINT: elementType   = "MET_UINT"; break;
+    case ImageIOBase::LONG:
+      elementType = sizeof( long ) == 4 ? "MET_INT" : "MET_LONG_LONG"; break;
+    case ImageIOBase::ULONG:
+      elementType = sizeof( unsigned long ) == 4 ? "MET_UINT" : "MET_ULONG_LONG"; break;
+    case ImageIOBase::FLOAT: elementType  = "MET_FLOAT"; break;
+    case ImageIOBase::DOUBLE: elementType = "MET_DOUBLE"; break;
+    default:
+      /** Leave other types to the ImageIO. */
+      imageIO->Write( buffer );
+      return;
+  }
+
+  /** Compress the data. */
+  const InputImageRegionType region             = input->GetLargestPossibleRegion();
+  const unsigned int         numberOfComponents = imageIO->GetNumberOfComponents();
+  const SizeValueType        numberOfBytes
+    = region.GetNumberOfPixels() * numberOfComponents * imageIO->GetComponentSize();
+  std::string compressed;
+  ParallelDeflate::Compress( buffer, numberOfBytes, this->m_CompressionLevel,
+    this->GetNumberOfThreads(), compressed );
+
+  /** The data file: in the header for .mha, next to it for .mhd. */
+  const std::string fileName = this->GetFileName();
+  const bool        local    = itksys::SystemTools::LowerCase(
+    itksys::SystemTools::GetFilenameLastExtension( fileName ) ) == ".mha";
+  const std::string dataFileName
+    = itksys::SystemTools::GetFilenameWithoutLastExtension( fileName ) + ".zraw";
+
+  /** Write the header. The origin is the position of the first voxel. */
+  typename InputImageType::PointType origin;
+  input->TransformIndexToPhysicalPoint( region.GetIndex(), origin );
+  std::ofstream header( fileName.c_str(), std::ios::out | std::ios::binary );
+  if( !header.is_open() )
+  {
+    itkExceptionMacro( << "ERROR: File \"" << fileName << "\" could not be opened!" );
+  }
+  header << std::setprecision( 16 );
+  header << "ObjectType = Image\n";
+  header << "NDims = " << InputImageDimension << "\n";
+  header << "BinaryData = True\n";
+  header << "BinaryDataByteOrderMSB = "
+         << ( ByteSwapper< char >::SystemIsBigEndian() ? "True" : "False" ) << "\n";
+  header << "CompressedData = True\n";
+  header << "CompressedDataSize = " << compressed.size() << "\n";
+  header << "TransformMatrix =";
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    {
+      header << " " << input->GetDirection()[ j ][ i ];
+    }
+  }
+  header << "\nOffset =";
+  for( unsigned int i = 0; i < InputImageDimension; ++i ) { header << " " << origin[ i ]; }
+  header << "\nCenterOfRotation =";
+  for( unsigned int i = 0; i < InputImageDimension; ++i ) { header << " 0"; }
+  header << "\nElementSpacing =";
+  for( unsigned int i = 0; i < InputImageDimension; ++i ) { header << " " << input->GetSpacing()[ i ]; }
+  header << "\nDimSize =";
+  for( unsigned int i = 0; i < InputImageDimension; ++i ) { header << " " << region.GetSize()[ i ]; }
+  header << "\n";
+  if( numberOfComponents > 1 )
+  {
+    header << "ElementNumberOfChannels = " << numberOfComponents << "\n";
+  }
+  header << "ElementType = " << elementType << "\n";
+  header << "ElementDataFile = " << ( local ? std::string( "LOCAL" ) : dataFileName ) << "\n";
+
+  /** Write the data. */
+  if( local )
+  {
+    header.write( compressed.data(), compressed.size() );
+  }
+  else
+  {
+    const std::string path = itksys::SystemTools::GetFilenamePath( fileName );
+    const std::string fullDataFileName = path.empty() ? dataFileName : path + "/" + dataFileName;
+    std::ofstream     data( fullDataFileName.c_str(), std::ios::out | std::ios::binary );
+    if( !data.is_open() )
+    {
+      itkExceptionMacro( << "ERROR: File \"" << fullDataFileName << "\" could not be opened!" );
+    }
+    data.write( compressed.data(), compressed.size() );
+    if( !data )
+    {
+      itkExceptionMacro( << "ERROR: File \"" << fullDataFileName << "\" could not be written!" );
+    }
+  }
+  if( !header )
+  {
+    itkExceptionMacro( << "ERROR: File \"" << fileName << "\" could not be written!" );
   }
 
 }
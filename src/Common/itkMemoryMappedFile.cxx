@@ -0,0 +1,200 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedFile_cxx
+#define __itkMemoryMappedFile_cxx
+
+#include "itkMemoryMappedFile.h"
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+MemoryMappedFile
+::MemoryMappedFile()
+{
+  this->m_Data          = 0;
+  this->m_Size          = 0;
+  this->m_FileHandle    = 0;
+  this->m_MappingHandle = 0;
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+MemoryMappedFile
+::~MemoryMappedFile()
+{
+  this->Unmap();
+
+} // end Destructor
+
+
+/**
+ * ****************** Map *********************************
+ */
+
+void
+MemoryMappedFile
+::Map( const std::string & fileName )
+{
+  this->Unmap();
+
+#if defined( _WIN32 )
+  HANDLE file = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  if( file == INVALID_HANDLE_VALUE )
+  {
+    itkExceptionMacro( << "Could not open file \"" << fileName << "\"." );
+  }
+
+  LARGE_INTEGER fileSize;
+  if( !GetFileSizeEx( file, &fileSize ) )
+  {
+    CloseHandle( file );
+    itkExceptionMacro( << "Could not get the size of file \"" << fileName << "\"." );
+  }
+  const SizeValueType size = static_cast< SizeValueType >( fileSize.QuadPart );
+
+  if( size > 0 )
+  {
+    /** PAGE_WRITECOPY and FILE_MAP_COPY give a copy-on-write view. */
+    HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+    void * data    = mapping ? MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 ) : NULL;
+    if( data == NULL )
+    {
+      if( mapping )
+      {
+        CloseHandle( mapping );
+      }
+      CloseHandle( file );
+      itkExceptionMacro( << "Could not map file \"" << fileName << "\"." );
+    }
+    this->m_MappingHandle = mapping;
+    this->m_Data          = data;
+  }
+  this->m_FileHandle = file;
+#else
+  const int file = open( fileName.c_str(), O_RDONLY );
+  if( file < 0 )
+  {
+    itkExceptionMacro( << "Could not open file \"" << fileName << "\"." );
+  }
+
+  struct stat fileStatus;
+  if( fstat( file, &fileStatus ) != 0 )
+  {
+    close( file );
+    itkExceptionMacro( << "Could not get the size of file \"" << fileName << "\"." );
+  }
+  const SizeValueType size = static_cast< SizeValueType >( fileStatus.st_size );
+
+  if( size > 0 )
+  {
+    /** MAP_PRIVATE gives a copy-on-write mapping. */
+    void * data = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0 );
+    if( data == MAP_FAILED )
+    {
+      close( file );
+      itkExceptionMacro( << "Could not map file \"" << fileName << "\"." );
+    }
+    this->m_Data = data;
+  }
+
+  /** The mapping stays valid after closing the file. */
+  close( file );
+#endif
+
+  this->m_Size     = size;
+  this->m_FileName = fileName;
+  this->Modified();
+
+} // end Map()
+
+
+/**
+ * ****************** Unmap *********************************
+ */
+
+void
+MemoryMappedFile
+::Unmap( void )
+{
+#if defined( _WIN32 )
+  if( this->m_Data )
+  {
+    UnmapViewOfFile( this->m_Data );
+  }
+  if( this->m_MappingHandle )
+  {
+    CloseHandle( static_cast< HANDLE >( this->m_MappingHandle ) );
+  }
+  if( this->m_FileHandle )
+  {
+    CloseHandle( static_cast< HANDLE >( this->m_FileHandle ) );
+  }
+#else
+  if( this->m_Data )
+  {
+    munmap( this->m_Data, this->m_Size );
+  }
+#endif
+
+  this->m_Data          = 0;
+  this->m_Size          = 0;
+  this->m_FileHandle    = 0;
+  this->m_MappingHandle = 0;
+  this->m_FileName      = "";
+
+} // end Unmap()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+MemoryMappedFile
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "FileName: " << this->m_FileName << std::endl;
+  os << indent << "Data: " << this->m_Data << std::endl;
+  os << indent << "Size: " << this->m_Size << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryMappedFile_cxx
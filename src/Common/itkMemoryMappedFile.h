@@ -0,0 +1,103 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedFile_h
+#define __itkMemoryMappedFile_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+#include <string>
+
+namespace itk
+{
+
+/** \class MemoryMappedFile
+ *
+ * \brief Maps a file into memory.
+ *
+ * The operating system loads the pages of the file when they are first
+ * accessed, so mapping a large file is cheap compared to reading it. The
+ * mapping is copy-on-write: the data may be modified, but changes are never
+ * written back to the file, and only the modified pages are copied.
+ *
+ * The data stays valid until Unmap() is called, Map() is called again, or
+ * the object is destroyed. Mapping is supported on POSIX systems and on
+ * Windows.
+ *
+ * \ingroup ITKCommon
+ */
+
+class MemoryMappedFile : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef MemoryMappedFile           Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MemoryMappedFile, Object );
+
+  /** Map the file. A previous mapping is released first.
+   * Throws an exception when the file cannot be mapped.
+   */
+  void Map( const std::string & fileName );
+
+  /** Release the mapping. */
+  void Unmap( void );
+
+  /** Get the mapped data, or 0 if no file is mapped or the file is empty. */
+  void * GetData( void ) const { return this->m_Data; }
+
+  /** Get the size of the mapped data in bytes. */
+  itkGetConstMacro( Size, SizeValueType );
+
+  /** Get the name of the mapped file. */
+  itkGetStringMacro( FileName );
+
+protected:
+
+  MemoryMappedFile();
+  virtual ~MemoryMappedFile();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  MemoryMappedFile( const Self & ); // purposely not implemented
+  void operator=( const Self & );   // purposely not implemented
+
+  void *        m_Data;
+  SizeValueType m_Size;
+  std::string   m_FileName;
+
+  /** The file and mapping handles, Windows only. */
+  void * m_FileHandle;
+  void * m_MappingHandle;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryMappedFile_h
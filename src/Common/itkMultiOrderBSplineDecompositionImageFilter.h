@@ -42,7 +42,7 @@
 #include "itkImageLinearIteratorWithIndex.h"
 #include "vnl/vnl_matrix.h"
 
-#include "itkImageToImageFilter.h"
+#include "itkInPlaceImageFilter.h"
 
 namespace itk
 {
@@ -71,27 +71,34 @@ namespace itk
  *               Uses mirror boundary conditions.
  *               Can only process LargestPossibleRegion
  *
+ * The 1D recursions are multi-threaded over the image lines. Along the
+ * non-contiguous dimensions, blocks of neighbouring lines are copied to an
+ * interleaved scratch buffer and filtered together, so that every cache line
+ * that is read is fully used. The copy of the input to the output is fused
+ * with the filtering along the first dimension. When the input and output
+ * image types are the same, the filter can run in place, see
+ * InPlaceImageFilter::SetInPlace(), which avoids a second image buffer.
+ *
  * \sa itkBSplineInterpolateImageFunction
  *
  *  ***TODO: Is this an ImageFilter?  or does it belong to another group?
  * \ingroup ImageFilters
- * \ingroup SingleThreaded
  * \ingroup CannotBeStreamed
  */
 template< class TInputImage, class TOutputImage >
 class ITK_EXPORT MultiOrderBSplineDecompositionImageFilter :
-  public         ImageToImageFilter< TInputImage, TOutputImage >
+  public InPlaceImageFilter< TInputImage, TOutputImage >
 {
 public:
 
   /** Standard class typedefs. */
   typedef MultiOrderBSplineDecompositionImageFilter       Self;
-  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef InPlaceImageFilter< TInputImage, TOutputImage > Superclass;
   typedef SmartPointer< Self >                            Pointer;
   typedef SmartPointer< const Self >                      ConstPointer;
 
   /** Run-time type information (and related methods). */
-  itkTypeMacro( MultiOrderBSplineDecompositionImageFilter, ImageToImageFilter );
+  itkTypeMacro( MultiOrderBSplineDecompositionImageFilter, InPlaceImageFilter );
 
   /** New macro for creation of through a Smart Pointer */
   itkNewMacro( Self );
@@ -112,6 +119,9 @@ public:
   /** Iterator typedef support */
   typedef ImageLinearIteratorWithIndex< TOutputImage > OutputLinearIterator;
 
+  /** Threading typedefs. */
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+
   /** Get/Sets the Spline Order, supports 0th - 5th order splines. The default
    *  is a 3rd order spline. */
   void SetSplineOrder( unsigned int order );
@@ -153,14 +163,29 @@ protected:
   void EnlargeOutputRequestedRegion( DataObject * output );
 
   /** These are needed by the smoothing spline routine. */
-  std::vector< CoeffType > m_Scratch;             // temp storage for processing of Coefficients
   typename TInputImage::SizeType m_DataLength;    // Image size
 
   unsigned int m_SplineOrder[ ImageDimension ];            // User specified spline order per dimension (3rd or cubic is the default)
   double       m_SplinePoles[ 3 ];                         // Poles calculated for a given spline order
   int          m_NumberOfPoles;                            // number of poles
   double       m_Tolerance;                                // Tolerance used for determining initial causal coefficient
-  unsigned int m_IteratorDirection;                        // Direction for iterator incrementing
+
+  /** The number of neighbouring lines that are filtered together along the
+   * non-contiguous dimensions. */
+  itkStaticConstMacro( LineBlockSize, unsigned int, 16 );
+
+  /** Struct to pass information to the threads. */
+  struct MultiThreaderParameterType
+  {
+    Self *       st_Self;
+    unsigned int st_Direction;
+  };
+
+  /** Threader callback and threaded worker for one dimension. */
+  static ITK_THREAD_RETURN_TYPE DataToCoefficientsThreaderCallback( void * arg );
+
+  void ThreadedDataToCoefficients( unsigned int direction,
+    ThreadIdType threadId, ThreadIdType numberOfThreads );
 
 private:
 
@@ -170,27 +195,23 @@ private:
   /** Determines the poles for dimension given the Spline Order. */
   virtual void SetPoles( unsigned int dimension );
 
-  /** Converts a vector of data to a vector of Spline coefficients. */
-  virtual bool DataToCoefficients1D();
+  /** Converts numberOfLines interleaved vectors of data of the given length
+   * to vectors of Spline coefficients. Element k of line b is stored
+   * at scratch[ k * numberOfLines + b ]. */
+  virtual bool DataToCoefficients1D( CoeffType * scratch,
+    unsigned long length, unsigned int numberOfLines ) const;
 
   /** Converts an N-dimension image of data to an equivalent sized image
    *    of spline coefficients. */
   void DataToCoefficientsND();
 
   /** Determines the first coefficient for the causal filtering of the data. */
-  virtual void SetInitialCausalCoefficient( double z );
+  virtual void SetInitialCausalCoefficient( double z, CoeffType * scratch,
+    unsigned long length, unsigned int numberOfLines ) const;
 
   /** Determines the first coefficient for the anti-causal filtering of the data. */
-  virtual void SetInitialAntiCausalCoefficient( double z );
-
-  /** Used to initialize the Coefficients image before calculation. */
-  void CopyImageToImage();
-
-  /** Copies a vector of data from the Coefficients image to the m_Scratch vector. */
-  void CopyCoefficientsToScratch( OutputLinearIterator & );
-
-  /** Copies a vector of data from m_Scratch to the Coefficients image. */
-  void CopyScratchToCoefficients( OutputLinearIterator & );
+  virtual void SetInitialAntiCausalCoefficient( double z, CoeffType * scratch,
+    unsigned long length, unsigned int numberOfLines ) const;
 
 };
 
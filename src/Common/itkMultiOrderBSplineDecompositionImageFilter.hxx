@@ -40,8 +40,9 @@
 #include "itkMultiOrderBSplineDecompositionImageFilter.h"
 #include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkImageRegionIterator.h"
-#include "itkProgressReporter.h"
 #include "itkVector.h"
+#include "itkTraceEventRecorder.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -54,8 +55,8 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 ::MultiOrderBSplineDecompositionImageFilter()
 {
   int splineOrder = 3;
-  m_Tolerance         = 1e-10; // Need some guidance on this one...what is reasonable?
-  m_IteratorDirection = 0;
+  m_Tolerance = 1e-10; // Need some guidance on this one...what is reasonable?
+  this->InPlaceOff();
   this->SetSplineOrder( splineOrder );
 }
 
@@ -87,7 +88,8 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 template< class TInputImage, class TOutputImage >
 bool
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::DataToCoefficients1D()
+::DataToCoefficients1D( CoeffType * scratch,
+  unsigned long length, unsigned int numberOfLines ) const
 {
 
   // See Unser, 1993, Part II, Equation 2.5,
@@ -95,7 +97,7 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 
   double c0 = 1.0;
 
-  if( m_DataLength[ m_IteratorDirection ] == 1 ) //Required by mirror boundaries
+  if( length == 1 ) //Required by mirror boundaries
   {
     return false;
   }
@@ -108,28 +110,42 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
   }
 
   // apply the gain
-  for( unsigned int n = 0; n < m_DataLength[ m_IteratorDirection ]; n++ )
+  const unsigned long numberOfElements = length * numberOfLines;
+  for( unsigned long i = 0; i < numberOfElements; i++ )
   {
-    m_Scratch[ n ] *= c0;
+    scratch[ i ] *= c0;
   }
 
-  // loop over all poles
+  // loop over all poles, the inner loops over the interleaved lines
+  // are independent and contiguous in memory
   for( int k = 0; k < m_NumberOfPoles; k++ )
   {
+    const double z = m_SplinePoles[ k ];
+
     // causal initialization
-    this->SetInitialCausalCoefficient( m_SplinePoles[ k ] );
+    this->SetInitialCausalCoefficient( z, scratch, length, numberOfLines );
     // causal recursion
-    for( unsigned int n = 1; n < m_DataLength[ m_IteratorDirection ]; n++ )
+    for( unsigned long n = 1; n < length; n++ )
     {
-      m_Scratch[ n ] += m_SplinePoles[ k ] * m_Scratch[ n - 1 ];
+      CoeffType *       current  = scratch + n * numberOfLines;
+      const CoeffType * previous = current - numberOfLines;
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        current[ b ] += z * previous[ b ];
+      }
     }
 
     // anticausal initialization
-    this->SetInitialAntiCausalCoefficient( m_SplinePoles[ k ] );
+    this->SetInitialAntiCausalCoefficient( z, scratch, length, numberOfLines );
     // anticausal recursion
-    for( int n = m_DataLength[ m_IteratorDirection ] - 2; 0 <= n; n-- )
+    for( long n = static_cast< long >( length ) - 2; 0 <= n; n-- )
     {
-      m_Scratch[ n ] = m_SplinePoles[ k ] * ( m_Scratch[ n + 1 ] - m_Scratch[ n ] );
+      CoeffType *       current = scratch + n * numberOfLines;
+      const CoeffType * next    = current + numberOfLines;
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        current[ b ] = z * ( next[ b ] - current[ b ] );
+      }
     }
   }
   return true;
@@ -225,46 +241,64 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 template< class TInputImage, class TOutputImage >
 void
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::SetInitialCausalCoefficient( double z )
+::SetInitialCausalCoefficient( double z, CoeffType * scratch,
+  unsigned long length, unsigned int numberOfLines ) const
 {
   /* begining InitialCausalCoefficient */
   /* See Unser, 1999, Box 2 for explaination */
-  CoeffType     sum;
   double        zn, z2n, iz;
   unsigned long horizon;
 
   /* this initialization corresponds to mirror boundaries */
-  horizon = m_DataLength[ m_IteratorDirection ];
+  horizon = length;
   zn      = z;
   if( m_Tolerance > 0.0 )
   {
     horizon = (long)vcl_ceil( vcl_log( m_Tolerance ) / vcl_log( vcl_fabs( z ) ) );
   }
-  if( horizon < m_DataLength[ m_IteratorDirection ] )
+
+  /* The sums are accumulated in scratch[ 0 .. numberOfLines [,
+   * the other elements are not modified. */
+  if( horizon < length )
   {
     /* accelerated loop */
-    sum = m_Scratch[ 0 ];   // verify this
-    for( unsigned int n = 1; n < horizon; n++ )
+    for( unsigned long n = 1; n < horizon; n++ )
     {
-      sum += zn * m_Scratch[ n ];
-      zn  *= z;
+      const CoeffType * data = scratch + n * numberOfLines;
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        scratch[ b ] += zn * data[ b ];
+      }
+      zn *= z;
     }
-    m_Scratch[ 0 ] = sum;
   }
   else
   {
     /* full loop */
-    iz   = 1.0 / z;
-    z2n  = vcl_pow( z, (double)( m_DataLength[ m_IteratorDirection ] - 1L ) );
-    sum  = m_Scratch[ 0 ] + z2n * m_Scratch[ m_DataLength[ m_IteratorDirection ] - 1L ];
+    iz  = 1.0 / z;
+    z2n = vcl_pow( z, (double)( length - 1L ) );
+    const CoeffType * last = scratch + ( length - 1 ) * numberOfLines;
+    for( unsigned int b = 0; b < numberOfLines; ++b )
+    {
+      scratch[ b ] += z2n * last[ b ];
+    }
     z2n *= z2n * iz;
-    for( unsigned int n = 1; n <= ( m_DataLength[ m_IteratorDirection ] - 2 ); n++ )
+    for( unsigned long n = 1; n <= ( length - 2 ); n++ )
     {
-      sum += ( zn + z2n ) * m_Scratch[ n ];
+      const CoeffType * data = scratch + n * numberOfLines;
+      const double      w    = zn + z2n;
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        scratch[ b ] += w * data[ b ];
+      }
       zn  *= z;
       z2n *= iz;
     }
-    m_Scratch[ 0 ] = sum / ( 1.0 - zn * zn );
+    const double norm = 1.0 / ( 1.0 - zn * zn );
+    for( unsigned int b = 0; b < numberOfLines; ++b )
+    {
+      scratch[ b ] *= norm;
+    }
   }
 }
 
@@ -272,14 +306,19 @@ MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 template< class TInputImage, class TOutputImage >
 void
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::SetInitialAntiCausalCoefficient( double z )
+::SetInitialAntiCausalCoefficient( double z, CoeffType * scratch,
+  unsigned long length, unsigned int numberOfLines ) const
 {
   // this initialization corresponds to mirror boundaries
   /* See Unser, 1999, Box 2 for explaination */
   //  Also see erratum at http://bigwww.epfl.ch/publications/unser9902.html
-  m_Scratch[ m_DataLength[ m_IteratorDirection ] - 1 ]
-    = ( z / ( z * z - 1.0 ) )
-    * ( z * m_Scratch[ m_DataLength[ m_IteratorDirection ] - 2 ] + m_Scratch[ m_DataLength[ m_IteratorDirection ] - 1 ] );
+  CoeffType *       last          = scratch + ( length - 1 ) * numberOfLines;
+  const CoeffType * secondLast    = last - numberOfLines;
+  const double      normalization = z / ( z * z - 1.0 );
+  for( unsigned int b = 0; b < numberOfLines; ++b )
+  {
+    last[ b ] = normalization * ( z * secondLast[ b ] + last[ b ] );
+  }
 }
 
 
@@ -288,108 +327,133 @@ void
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 ::DataToCoefficientsND()
 {
-  OutputImagePointer output = this->GetOutput();
-
-  Size< ImageDimension > size = output->GetBufferedRegion().GetSize();
-
-  unsigned int count = output->GetBufferedRegion().GetNumberOfPixels() / size[ 0 ] * ImageDimension;
+  MultiThreaderParameterType parameters;
+  parameters.st_Self = this;
 
-  ProgressReporter progress( this, 0, count, 10 );
-
-  // Initialize coeffient array
-  this->CopyImageToImage();   // Coefficients are initialized to the input data
+  MultiThreader * threader = this->GetMultiThreader();
+  threader->SetNumberOfThreads( this->GetNumberOfThreads() );
+  threader->SetSingleMethod( DataToCoefficientsThreaderCallback, &parameters );
 
+  // Loop through each dimension. The copy of the input data to the
+  // coefficients is done while filtering along the first dimension.
   for( unsigned int n = 0; n < ImageDimension; n++ )
   {
-    m_IteratorDirection = n;
-    // Loop through each dimension
-
     // Compute poles for this dimension
     this->SetPoles( n );
 
-    // Initialize iterators
-    OutputLinearIterator CIterator( output, output->GetBufferedRegion() );
-    CIterator.SetDirection( m_IteratorDirection );
-    // For each data vector
-    while( !CIterator.IsAtEnd() )
-    {
-      // Copy coefficients to scratch
-      this->CopyCoefficientsToScratch( CIterator );
-
-      // Perform 1D BSpline calculations
-      this->DataToCoefficients1D();
-
-      // Copy scratch back to coefficients.
-      // Brings us back to the end of the line we were working on.
-      CIterator.GoToBeginOfLine();
-      this->CopyScratchToCoefficients( CIterator ); // m_Scratch = m_Image;
-      CIterator.NextLine();
-      progress.CompletedPixel();
-    }
+    parameters.st_Direction = n;
+    threader->SingleMethodExecute();
+
+    this->UpdateProgress( static_cast< float >( n + 1 ) / ImageDimension );
   }
 }
 
 
 /**
- * Copy the input image into the output image
+ * Threader callback
  */
 template< class TInputImage, class TOutputImage >
-void
+ITK_THREAD_RETURN_TYPE
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::CopyImageToImage()
+::DataToCoefficientsThreaderCallback( void * arg )
 {
-  typedef ImageRegionConstIteratorWithIndex< TInputImage > InputIterator;
-  typedef ImageRegionIterator< TOutputImage >              OutputIterator;
-  typedef typename TOutputImage::PixelType                 OutputPixelType;
+  ThreadInfoType *             infoStruct = static_cast< ThreadInfoType * >( arg );
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
 
-  InputIterator  inIt( this->GetInput(), this->GetInput()->GetBufferedRegion() );
-  OutputIterator outIt( this->GetOutput(), this->GetOutput()->GetBufferedRegion() );
+  temp->st_Self->ThreadedDataToCoefficients( temp->st_Direction,
+    infoStruct->ThreadID, infoStruct->NumberOfThreads );
 
-  inIt.GoToBegin();
-  outIt.GoToBegin();
-  while( !outIt.IsAtEnd() )
-  {
-    outIt.Set( static_cast< OutputPixelType >( inIt.Get() ) );
-    ++inIt;
-    ++outIt;
-  }
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 
 /**
- * Copy the scratch to one line of the output image
+ * Filter the lines along one dimension, for one thread
  */
 template< class TInputImage, class TOutputImage >
 void
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::CopyScratchToCoefficients( OutputLinearIterator & Iter )
+::ThreadedDataToCoefficients( unsigned int direction,
+  ThreadIdType threadId, ThreadIdType numberOfThreads )
 {
+  typedef typename TInputImage::PixelType  InputPixelType;
   typedef typename TOutputImage::PixelType OutputPixelType;
-  unsigned long j = 0;
-  while( !Iter.IsAtEndOfLine() )
+
+  const InputPixelType * inputBuffer  = this->GetInput()->GetBufferPointer();
+  OutputPixelType *      outputBuffer = this->GetOutput()->GetBufferPointer();
+
+  /** The lines along the given direction start at
+   * outer * stride * length + inner, with inner in [0, stride[. Lines with
+   * neighbouring inner are neighbours in memory, so they are processed in
+   * blocks. For the first dimension stride = 1 and every block is one
+   * contiguous line.
+   */
+  const unsigned long length = m_DataLength[ direction ];
+  unsigned long       stride = 1;
+  for( unsigned int d = 0; d < direction; ++d )
   {
-    Iter.Set( static_cast< OutputPixelType >( m_Scratch[ j ] ) );
-    ++Iter;
-    ++j;
+    stride *= m_DataLength[ d ];
   }
+  const unsigned long numberOfPixels
+    = this->GetOutput()->GetBufferedRegion().GetNumberOfPixels();
+  const unsigned long numberOfOuter     = numberOfPixels / ( stride * length );
+  const unsigned long maxBlockSize      = std::min( stride, static_cast< unsigned long >( Self::LineBlockSize ) );
+  const unsigned long numberOfBlocks    = ( stride + maxBlockSize - 1 ) / maxBlockSize;
+  const unsigned long numberOfWorkItems = numberOfOuter * numberOfBlocks;
+
+  /** Static split of the work over the threads. */
+  const unsigned long itemsPerThread = static_cast< unsigned long >(
+    vcl_ceil( static_cast< double >( numberOfWorkItems ) / static_cast< double >( numberOfThreads ) ) );
+  unsigned long pos_begin = itemsPerThread * threadId;
+  unsigned long pos_end   = itemsPerThread * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfWorkItems ) ? numberOfWorkItems : pos_begin;
+  pos_end   = ( pos_end > numberOfWorkItems ) ? numberOfWorkItems : pos_end;
+
+  std::vector< CoeffType > scratch( length * maxBlockSize );
+
+  for( unsigned long item = pos_begin; item < pos_end; ++item )
+  {
+    const unsigned long outer         = item / numberOfBlocks;
+    const unsigned long firstInner    = ( item % numberOfBlocks ) * maxBlockSize;
+    const unsigned int  numberOfLines = static_cast< unsigned int >(
+      std::min( maxBlockSize, stride - firstInner ) );
+    const unsigned long offset = outer * stride * length + firstInner;
+
+    /** Gather the block of lines in the interleaved scratch buffer. */
+    for( unsigned long k = 0; k < length; ++k )
+    {
+      CoeffType *         s   = &scratch[ k * numberOfLines ];
+      const unsigned long pos = offset + k * stride;
+      if( direction == 0 )
+      {
+        for( unsigned int b = 0; b < numberOfLines; ++b )
+        {
+          s[ b ] = static_cast< CoeffType >( inputBuffer[ pos + b ] );
+        }
+      }
+      else
+      {
+        for( unsigned int b = 0; b < numberOfLines; ++b )
+        {
+          s[ b ] = static_cast< CoeffType >( outputBuffer[ pos + b ] );
+        }
+      }
+    }
 
-}
-
+    // Perform 1D BSpline calculations
+    this->DataToCoefficients1D( &scratch[ 0 ], length, numberOfLines );
 
-/**
- * Copy one line of the output image to the scratch
- */
-template< class TInputImage, class TOutputImage >
-void
-MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
-::CopyCoefficientsToScratch( OutputLinearIterator & Iter )
-{
-  unsigned long j = 0;
-  while( !Iter.IsAtEndOfLine() )
-  {
-    m_Scratch[ j ] = static_cast< CoeffType >( Iter.Get() );
-    ++Iter;
-    ++j;
+    /** Scatter the block back to the coefficients. */
+    for( unsigned long k = 0; k < length; ++k )
+    {
+      const CoeffType * s   = &scratch[ k * numberOfLines ];
+      OutputPixelType * out = outputBuffer + offset + k * stride;
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        out[ b ] = static_cast< OutputPixelType >( s[ b ] );
+      }
+    }
   }
 }
 
@@ -442,32 +506,17 @@ void
 MultiOrderBSplineDecompositionImageFilter< TInputImage, TOutputImage >
 ::GenerateData()
 {
+  TraceEventScope traceScope( "MultiOrderBSplineDecomposition::GenerateData", "bspline" );
 
-  // Allocate scratch memory
   InputImageConstPointer inputPtr = this->GetInput();
   m_DataLength = inputPtr->GetBufferedRegion().GetSize();
 
-  unsigned long maxLength = 0;
-  for( unsigned int n = 0; n < ImageDimension; n++ )
-  {
-    if( m_DataLength[ n ] > maxLength )
-    {
-      maxLength = m_DataLength[ n ];
-    }
-  }
-  m_Scratch.resize( maxLength );
-
-  // Allocate memory for output image
-  OutputImagePointer outputPtr = this->GetOutput();
-  outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
-  outputPtr->Allocate();
+  // Allocate memory for output image, or graft the input when running in place
+  this->AllocateOutputs();
 
   // Calculate actual output
   this->DataToCoefficientsND();
 
-  // Clean up
-  m_Scratch.clear();
-
 }
 
 
@@ -115,6 +115,9 @@ namespace itk
  * type.
  *
  * This filter uses multithreaded filters to perform the smoothing.
+ * The input is cast to the output pixel type only once for all levels,
+ * and the intermediate smoothing steps run in place, so that per level
+ * only one pass per dimension and one extra image buffer are needed.
  *
  * This filter supports streaming.
  *
@@ -41,6 +41,9 @@
 #include "itkCastImageFilter.h"
 #include "itkRecursiveGaussianImageFilter.h"
 #include "itkExceptionObject.h"
+#include "itkImageAlgorithm.h"
+#include "itkTraceEventRecorder.h"
+#include "itkHardwareCounters.h"
 
 #include "vnl/vnl_math.h"
 
@@ -95,6 +98,9 @@ void
 MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
 ::GenerateData()
 {
+  TraceEventScope traceScope( "GaussianSmoothingPyramid::GenerateData", "pyramid" );
+  HardwareCounterScope counterScope( "GaussianSmoothingPyramid::GenerateData" );
+
   // Get the input and output pointers
   InputImageConstPointer inputPtr = this->GetInput();
 
@@ -149,13 +155,9 @@ MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
     outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
     outputPtr->Allocate();
 
-    // Force caster to regenerate data
-    // This is necessary because the caster may have to regenerate
-    // data for each output. (because this filter has n outputs, but
-    // for generating each output the caster filter is used.
-    caster->Modified();
-
     // compute shrink factors and variances
+    int firstUsedDim = -1;
+    int lastUsedDim  = -1;
     for( idim = 0; idim < ImageDimension; idim++ )
     {
       factors[ idim ] = this->m_Schedule[ ilevel ][ idim ];
@@ -187,6 +189,8 @@ MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
       {
         // Use the filter for this dimension
         smootherPointerArray[ idim ] = smootherArray[ idim ];
+        if( firstUsedDim < 0 ) { firstUsedDim = idim; }
+        lastUsedDim = idim;
       }
 
       /** Set the input of the smoother filters to the previous pointers
@@ -198,6 +202,29 @@ MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
       }
     }
 
+    /** The input is cast only once, for all levels, so its output may not
+     * be overwritten: the first smoother may not run in place. The last
+     * smoother writes directly into the output of this level. The smoothers
+     * in between can reuse the buffer of their input, which would be
+     * released anyway.
+     */
+    for( idim = 0; idim < ImageDimension; idim++ )
+    {
+      const int dim = static_cast< int >( idim );
+      smootherArray[ idim ]->SetInPlace( dim != firstUsedDim && dim != lastUsedDim );
+    }
+
+    if( lastUsedDim < 0 )
+    {
+      /** No smoothing at all for this level: copy the cast input. Grafting
+       * the output on the caster would overwrite the cast image.
+       */
+      caster->Update();
+      ImageAlgorithm::Copy( caster->GetOutput(), outputPtr.GetPointer(),
+        caster->GetOutput()->GetBufferedRegion(), outputPtr->GetBufferedRegion() );
+      continue;
+    }
+
     smootherPointerArray[ ImageDimension - 1 ]->GraftOutput( outputPtr );
     smootherPointerArray[ ImageDimension - 1 ]->Update();
 
@@ -149,11 +149,19 @@ public:
     FixedImageType, FixedImageType >                  FixedImagePyramidType;
   typedef typename FixedImagePyramidType::Pointer FixedImagePyramidPointer;
 
+  /** Type of a list of precomputed fixed image pyramid outputs. */
+  typedef typename FixedImageType::Pointer       FixedImagePointer;
+  typedef std::vector< FixedImagePointer >       FixedImagePyramidOutputsType;
+
   /** Type of the moving image multiresolution pyramid. */
   typedef MultiResolutionPyramidImageFilter<
     MovingImageType, MovingImageType >                MovingImagePyramidType;
   typedef typename MovingImagePyramidType::Pointer MovingImagePyramidPointer;
 
+  /** Type of a list of precomputed moving image pyramid outputs. */
+  typedef typename MovingImageType::Pointer      MovingImagePointer;
+  typedef std::vector< MovingImagePointer >      MovingImagePyramidOutputsType;
+
   /** Type of the Transformation parameters This is the same type used to
    *  represent the search space of the optimization algorithm.
    */
@@ -204,6 +212,62 @@ public:
   itkSetObjectMacro( MovingImagePyramid, MovingImagePyramidType );
   itkGetObjectMacro( MovingImagePyramid, MovingImagePyramidType );
 
+  /** Set/Get whether the output of the fixed image pyramid is used as the
+   * moving image as well. This is only allowed when the fixed and moving
+   * image are the same object, as in group-wise registration, and the
+   * moving image pyramid would compute exactly the same images. The moving
+   * image pyramid is then not updated, which halves the memory and time
+   * needed for the pyramids. Default: false.
+   */
+  itkSetMacro( ShareImagePyramids, bool );
+  itkGetConstMacro( ShareImagePyramids, bool );
+  itkBooleanMacro( ShareImagePyramids );
+
+  /** Set/Get precomputed outputs of the fixed image pyramid, one image per
+   * level, e.g. from an earlier registration of the same fixed image with
+   * the same pyramid settings. When the number of images equals the number
+   * of levels, the fixed image pyramid is not updated and these images are
+   * used instead. The caller is responsible that they are what the pyramid
+   * would compute. Default: empty.
+   */
+  virtual void SetFixedImagePyramidOutputs( const FixedImagePyramidOutputsType & outputs )
+  {
+    this->m_FixedImagePyramidOutputs = outputs;
+    this->Modified();
+  }
+
+
+  const FixedImagePyramidOutputsType & GetFixedImagePyramidOutputs( void ) const
+  {
+    return this->m_FixedImagePyramidOutputs;
+  }
+
+
+  /** Returns the fixed image of a level, either from the fixed image
+   * pyramid or from the precomputed outputs. */
+  virtual FixedImageType * GetFixedImageAtLevel( const unsigned long level ) const;
+
+  /** Set/Get precomputed outputs of the moving image pyramid, the
+   * counterpart of SetFixedImagePyramidOutputs(). Not used when the image
+   * pyramids are shared. Default: empty.
+   */
+  virtual void SetMovingImagePyramidOutputs( const MovingImagePyramidOutputsType & outputs )
+  {
+    this->m_MovingImagePyramidOutputs = outputs;
+    this->Modified();
+  }
+
+
+  const MovingImagePyramidOutputsType & GetMovingImagePyramidOutputs( void ) const
+  {
+    return this->m_MovingImagePyramidOutputs;
+  }
+
+
+  /** Returns the moving image of a level, either from the moving image
+   * pyramid or from the precomputed outputs. */
+  virtual MovingImageType * GetMovingImageAtLevel( const unsigned long level ) const;
+
   /** Set/Get the number of multi-resolution levels. */
   itkSetClampMacro( NumberOfLevels, unsigned long, 1,
     NumericTraits< unsigned long >::max() );
@@ -228,6 +292,42 @@ public:
    */
   itkGetConstReferenceMacro( LastTransformParameters, ParametersType );
 
+  /** Set/Get additional candidates for the initial transformation parameters,
+   * for a multi-start in the first resolution level: the parameter vectors of
+   * the candidates one after another. The InitialTransformParameters are the
+   * first candidate. An empty array, the default, disables the multi-start.
+   */
+  itkSetMacro( MultiStartInitialTransformParameters, ParametersType );
+  itkGetConstReferenceMacro( MultiStartInitialTransformParameters, ParametersType );
+
+  /** Set/Get the number of multi-start candidates that survive the pruning on
+   * their initial metric value, and are optimized in the first resolution level.
+   * Default: 1.
+   */
+  itkSetClampMacro( MultiStartNumberOfSurvivors, unsigned long, 1,
+    NumericTraits< unsigned long >::max() );
+  itkGetConstMacro( MultiStartNumberOfSurvivors, unsigned long );
+
+  /** Get the index of the multi-start candidate that was continued to the
+   * next resolution levels: 0 for the InitialTransformParameters.
+   */
+  itkGetConstMacro( MultiStartWinner, unsigned long );
+
+  /** Set/Get the number of resolution levels that were completed in an earlier
+   * run, to resume a registration. These levels are skipped: the IterationEvent
+   * is still invoked, so the components can set up the level, but the optimizer
+   * is not run. After the last skipped level the transform gets the
+   * ResumeTransformParameters. Default: 0, no levels are skipped.
+   */
+  itkSetMacro( ResumeLevel, unsigned long );
+  itkGetConstMacro( ResumeLevel, unsigned long );
+
+  /** Set/Get the transform parameters at the end of the last completed
+   * level, see ResumeLevel.
+   */
+  itkSetMacro( ResumeTransformParameters, ParametersType );
+  itkGetConstReferenceMacro( ResumeTransformParameters, ParametersType );
+
   /** Returns the transform resulting from the registration process. */
   const TransformOutputType * GetOutput( void ) const;
 
@@ -266,6 +366,22 @@ protected:
   /** Compute the size of the fixed region for each level of the pyramid. */
   virtual void PreparePyramids( void );
 
+  /** Run the optimizer in the current level and store the result in
+   * m_LastTransformParameters. In the first level, with multi-start candidates,
+   * all candidates are ranked on their metric value, the best
+   * MultiStartNumberOfSurvivors are optimized one after another, and the
+   * optimized candidate with the lowest metric value is the result.
+   */
+  virtual void OptimizeCurrentLevel( void );
+
+  /** Returns true if the current level is skipped, because it was completed
+   * before a resume, see ResumeLevel. In that case lastParameters are set to
+   * the parameters at the end of the level, and passed to the next level.
+   * The lastParameters are taken by reference, because some children classes
+   * keep their own copy of the last transform parameters.
+   */
+  virtual bool SkipResumedLevel( ParametersType & lastParameters );
+
   /** Set the current level to be processed. */
   itkSetMacro( CurrentLevel, unsigned long );
 
@@ -300,6 +416,17 @@ private:
 
   unsigned long m_NumberOfLevels;
   unsigned long m_CurrentLevel;
+  bool          m_ShareImagePyramids;
+
+  ParametersType m_MultiStartInitialTransformParameters;
+  unsigned long  m_MultiStartNumberOfSurvivors;
+  unsigned long  m_MultiStartWinner;
+
+  unsigned long  m_ResumeLevel;
+  ParametersType m_ResumeTransformParameters;
+
+  FixedImagePyramidOutputsType  m_FixedImagePyramidOutputs;
+  MovingImagePyramidOutputsType m_MovingImagePyramidOutputs;
 
 };
 
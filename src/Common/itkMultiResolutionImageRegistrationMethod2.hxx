@@ -44,6 +44,10 @@
 #include "itkContinuousIndex.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace itk
 {
 
@@ -68,8 +72,9 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   this->m_FixedImagePyramid  = FixedImagePyramidType::New();
   this->m_MovingImagePyramid = MovingImagePyramidType::New();
 
-  this->m_NumberOfLevels = 1;
-  this->m_CurrentLevel   = 0;
+  this->m_NumberOfLevels     = 1;
+  this->m_CurrentLevel       = 0;
+  this->m_ShareImagePyramids = false;
 
   this->m_Stop = false;
 
@@ -81,6 +86,13 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   this->m_InitialTransformParametersOfNextLevel.Fill( 0.0f );
   this->m_LastTransformParameters.Fill( 0.0f );
 
+  this->m_MultiStartInitialTransformParameters = ParametersType( 0 );
+  this->m_MultiStartNumberOfSurvivors          = 1;
+  this->m_MultiStartWinner                     = 0;
+
+  this->m_ResumeLevel               = 0;
+  this->m_ResumeTransformParameters = ParametersType( 0 );
+
   TransformOutputPointer transformDecorator
     = static_cast< TransformOutputType * >(
     this->MakeOutput( 0 ).GetPointer() );
@@ -121,8 +133,21 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   }
 
   // Setup the metric
-  this->m_Metric->SetMovingImage( this->m_MovingImagePyramid->GetOutput( this->m_CurrentLevel ) );
-  this->m_Metric->SetFixedImage( this->m_FixedImagePyramid->GetOutput( this->m_CurrentLevel ) );
+  if( this->m_ShareImagePyramids )
+  {
+    const MovingImageType * movingImage = dynamic_cast< const MovingImageType * >(
+      this->GetFixedImageAtLevel( this->m_CurrentLevel ) );
+    if( !movingImage )
+    {
+      itkExceptionMacro( << "ShareImagePyramids requires the same fixed and moving image type" );
+    }
+    this->m_Metric->SetMovingImage( movingImage );
+  }
+  else
+  {
+    this->m_Metric->SetMovingImage( this->GetMovingImageAtLevel( this->m_CurrentLevel ) );
+  }
+  this->m_Metric->SetFixedImage( this->GetFixedImageAtLevel( this->m_CurrentLevel ) );
   this->m_Metric->SetTransform( this->m_Transform );
   this->m_Metric->SetInterpolator( this->m_Interpolator );
   this->m_Metric->SetFixedImageRegion( this->m_FixedImageRegionPyramid[ this->m_CurrentLevel ] );
@@ -199,15 +224,34 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
     itkExceptionMacro( << "Moving image pyramid is not present" );
   }
 
-  // Setup the fixed image pyramid
+  // Setup the fixed image pyramid. It is not updated when its outputs
+  // are precomputed.
   this->m_FixedImagePyramid->SetNumberOfLevels( this->m_NumberOfLevels );
   this->m_FixedImagePyramid->SetInput( this->m_FixedImage );
-  this->m_FixedImagePyramid->UpdateLargestPossibleRegion();
+  if( this->m_FixedImagePyramidOutputs.size() != this->m_NumberOfLevels )
+  {
+    this->m_FixedImagePyramidOutputs.clear();
+    this->m_FixedImagePyramid->UpdateLargestPossibleRegion();
+  }
 
-  // Setup the moving image pyramid
+  // Setup the moving image pyramid. When the pyramids are shared it is
+  // not updated; the fixed pyramid output is used instead. Neither is it
+  // updated when its outputs are precomputed.
   this->m_MovingImagePyramid->SetNumberOfLevels( this->m_NumberOfLevels );
   this->m_MovingImagePyramid->SetInput( this->m_MovingImage );
-  this->m_MovingImagePyramid->UpdateLargestPossibleRegion();
+  if( this->m_ShareImagePyramids )
+  {
+    if( static_cast< const DataObject * >( this->m_FixedImage.GetPointer() )
+      != static_cast< const DataObject * >( this->m_MovingImage.GetPointer() ) )
+    {
+      itkExceptionMacro( << "ShareImagePyramids requires the fixed and moving image to be the same" );
+    }
+  }
+  else if( this->m_MovingImagePyramidOutputs.size() != this->m_NumberOfLevels )
+  {
+    this->m_MovingImagePyramidOutputs.clear();
+    this->m_MovingImagePyramid->UpdateLargestPossibleRegion();
+  }
 
   typedef typename FixedImageRegionType::SizeType      SizeType;
   typedef typename FixedImageRegionType::IndexType     IndexType;
@@ -251,7 +295,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
     IndexType        start;
     CIndexType       startcindex;
     CIndexType       endcindex;
-    FixedImageType * fixedImageAtLevel = this->m_FixedImagePyramid->GetOutput( level );
+    FixedImageType * fixedImageAtLevel = this->GetFixedImageAtLevel( level );
     /** map the original fixed image region to the image resulting from the
      * FixedImagePyramid at level l.
      * To be on the safe side, the start point is ceiled, and the end point is
@@ -273,6 +317,40 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 } // end PreparePyramids()
 
 
+/*
+ * Get the fixed image of a level
+ */
+template< typename TFixedImage, typename TMovingImage >
+typename MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >::FixedImageType
+* MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::GetFixedImageAtLevel( const unsigned long level ) const
+{
+  if( level < this->m_FixedImagePyramidOutputs.size() )
+  {
+    return this->m_FixedImagePyramidOutputs[ level ].GetPointer();
+  }
+  return this->m_FixedImagePyramid->GetOutput( level );
+
+} // end GetFixedImageAtLevel()
+
+
+/*
+ * Get the moving image of a level
+ */
+template< typename TFixedImage, typename TMovingImage >
+typename MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >::MovingImageType
+* MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::GetMovingImageAtLevel( const unsigned long level ) const
+{
+  if( level < this->m_MovingImagePyramidOutputs.size() )
+  {
+    return this->m_MovingImagePyramidOutputs[ level ].GetPointer();
+  }
+  return this->m_MovingImagePyramid->GetOutput( level );
+
+} // end GetMovingImageAtLevel()
+
+
 /*
  * Starts the Registration Process
  */
@@ -318,6 +396,12 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
         break;
       }
 
+      // Skip the levels that were completed before a resume
+      if( this->SkipResumedLevel( this->m_LastTransformParameters ) )
+      {
+        continue;
+      }
+
       try
       {
         // initialize the interconnects between components
@@ -335,7 +419,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
       try
       {
         // do the optimization
-        this->m_Optimizer->StartOptimization();
+        this->OptimizeCurrentLevel();
       }
       catch( ExceptionObject & err )
       {
@@ -348,7 +432,6 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
       }
 
       // get the results
-      this->m_LastTransformParameters = this->m_Optimizer->GetCurrentPosition();
       this->m_Transform->SetParameters( this->m_LastTransformParameters );
 
       // setup the initial parameters for next level
@@ -363,6 +446,138 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 } // end StartRegistration()
 
 
+/*
+ * Optimize the current level, with a multi-start in the first level
+ */
+template< typename TFixedImage, typename TMovingImage >
+void
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::OptimizeCurrentLevel( void )
+{
+  if( this->m_CurrentLevel == 0 )
+  {
+    this->m_MultiStartWinner = 0;
+  }
+  if( this->m_CurrentLevel != 0
+    || this->m_MultiStartInitialTransformParameters.Size() == 0 )
+  {
+    this->m_Optimizer->StartOptimization();
+    this->m_LastTransformParameters = this->m_Optimizer->GetCurrentPosition();
+    return;
+  }
+
+  /** Collect the candidates. The first is the initial position set by Initialize(). */
+  const unsigned int P = this->m_Transform->GetNumberOfParameters();
+  if( this->m_MultiStartInitialTransformParameters.Size() % P != 0 )
+  {
+    itkExceptionMacro( << "The number of multi-start initial transform parameters ("
+                       << this->m_MultiStartInitialTransformParameters.Size()
+                       << ") is not a multiple of the number of transform parameters ("
+                       << P << ")" );
+  }
+  const unsigned int          K = 1 + this->m_MultiStartInitialTransformParameters.Size() / P;
+  std::vector< ParametersType > candidates( K, this->m_Optimizer->GetInitialPosition() );
+  for( unsigned int k = 1; k < K; ++k )
+  {
+    for( unsigned int i = 0; i < P; ++i )
+    {
+      candidates[ k ][ i ] = this->m_MultiStartInitialTransformParameters[ ( k - 1 ) * P + i ];
+    }
+  }
+
+  /** Early pruning: rank the candidates on their initial metric value.
+   * A candidate on which the metric fails, for example because too few
+   * samples map inside the moving image, ranks last.
+   */
+  const double worst = NumericTraits< double >::max();
+  std::vector< std::pair< double, unsigned int > > ranking( K );
+  for( unsigned int k = 0; k < K; ++k )
+  {
+    ranking[ k ] = std::make_pair( worst, k );
+    try
+    {
+      ranking[ k ].first = this->m_Metric->GetValue( candidates[ k ] );
+    }
+    catch( ExceptionObject & )
+    {
+    }
+  }
+  std::stable_sort( ranking.begin(), ranking.end() );
+
+  /** Optimize the survivors one after another; each uses all threads of the metric.
+   * Keep the one with the lowest final metric value.
+   */
+  const unsigned int survivors = vnl_math_min(
+    static_cast< unsigned int >( this->m_MultiStartNumberOfSurvivors ), K );
+  double bestValue = worst;
+  for( unsigned int s = 0; s < survivors && !this->m_Stop; ++s )
+  {
+    const unsigned int k = ranking[ s ].second;
+    this->m_Optimizer->SetInitialPosition( candidates[ k ] );
+    this->m_Optimizer->StartOptimization();
+
+    const ParametersType & result = this->m_Optimizer->GetCurrentPosition();
+    double                 value  = worst;
+    try
+    {
+      value = this->m_Metric->GetValue( result );
+    }
+    catch( ExceptionObject & )
+    {
+    }
+
+    if( s == 0 || value < bestValue )
+    {
+      bestValue                       = value;
+      this->m_LastTransformParameters = result;
+      this->m_MultiStartWinner        = k;
+    }
+  }
+
+} // end OptimizeCurrentLevel()
+
+
+/*
+ * Skip a level that was completed before a resume
+ */
+template< typename TFixedImage, typename TMovingImage >
+bool
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::SkipResumedLevel( ParametersType & lastParameters )
+{
+  if( this->m_CurrentLevel >= this->m_ResumeLevel )
+  {
+    return false;
+  }
+
+  /** The components have set up this level in the IterationEvent, for example
+   * a B-spline transform has upsampled its grid. The last skipped level ends
+   * with the parameters of the resume, the others with their initial parameters.
+   */
+  if( this->m_CurrentLevel + 1 == this->m_ResumeLevel )
+  {
+    lastParameters = this->m_ResumeTransformParameters;
+  }
+  else
+  {
+    lastParameters = this->m_InitialTransformParametersOfNextLevel;
+  }
+
+  if( lastParameters.Size() != this->m_Transform->GetNumberOfParameters() )
+  {
+    itkExceptionMacro( << "Size mismatch between the resumed parameters ("
+                       << lastParameters.Size() << ") and the transform ("
+                       << this->m_Transform->GetNumberOfParameters()
+                       << ") in level " << this->m_CurrentLevel );
+  }
+
+  this->m_Transform->SetParameters( lastParameters );
+  this->m_InitialTransformParametersOfNextLevel = lastParameters;
+  return true;
+
+} // end SkipResumedLevel()
+
+
 /*
  * PrintSelf
  */
@@ -382,6 +597,12 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
      << this->m_FixedImagePyramid.GetPointer() << std::endl;
   os << indent << "MovingImagePyramid: "
      << this->m_MovingImagePyramid.GetPointer() << std::endl;
+  os << indent << "ShareImagePyramids: "
+     << ( this->m_ShareImagePyramids ? "true" : "false" ) << std::endl;
+  os << indent << "NumberOfPrecomputedFixedImagePyramidOutputs: "
+     << this->m_FixedImagePyramidOutputs.size() << std::endl;
+  os << indent << "NumberOfPrecomputedMovingImagePyramidOutputs: "
+     << this->m_MovingImagePyramidOutputs.size() << std::endl;
 
   os << indent << "NumberOfLevels: " << this->m_NumberOfLevels << std::endl;
   os << indent << "CurrentLevel: " << this->m_CurrentLevel << std::endl;
@@ -392,6 +613,14 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
      << this->m_InitialTransformParametersOfNextLevel << std::endl;
   os << indent << "LastTransformParameters: "
      << this->m_LastTransformParameters << std::endl;
+  os << indent << "MultiStartInitialTransformParameters: "
+     << this->m_MultiStartInitialTransformParameters << std::endl;
+  os << indent << "MultiStartNumberOfSurvivors: "
+     << this->m_MultiStartNumberOfSurvivors << std::endl;
+  os << indent << "MultiStartWinner: "
+     << this->m_MultiStartWinner << std::endl;
+  os << indent << "ResumeLevel: "
+     << this->m_ResumeLevel << std::endl;
   os << indent << "FixedImageRegion: "
      << this->m_FixedImageRegion << std::endl;
 
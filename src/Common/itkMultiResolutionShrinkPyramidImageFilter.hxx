@@ -21,6 +21,8 @@
 #include "itkMultiResolutionShrinkPyramidImageFilter.h"
 
 #include "itkShrinkImageFilter.h"
+#include "itkTraceEventRecorder.h"
+#include "itkHardwareCounters.h"
 #include "vnl/vnl_math.h"
 
 namespace itk
@@ -34,6 +36,9 @@ void
 MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
 ::GenerateData( void )
 {
+  TraceEventScope traceScope( "ShrinkPyramid::GenerateData", "pyramid" );
+  HardwareCounterScope counterScope( "ShrinkPyramid::GenerateData" );
+
   /** Create the shrinking filter. */
   typedef ShrinkImageFilter< TInputImage, TOutputImage > ShrinkerType;
   typename ShrinkerType::Pointer shrinker = ShrinkerType::New();
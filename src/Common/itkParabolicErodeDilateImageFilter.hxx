@@ -31,6 +31,7 @@
 #include "itkImageLinearConstIterator.h"
 #endif
 #include "itkParabolicMorphUtils.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -175,19 +176,21 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
   typename TOutputImage::Pointer     outputImage( this->GetOutput() );
 
   //const unsigned int imageDimension = inputImage->GetImageDimension();
+  // Allocate once; the threads only write their own lines.
   outputImage->SetBufferedRegion( outputImage->GetRequestedRegion() );
   outputImage->Allocate();
   // Set up the multithreaded processing
   typename ImageSource< TOutputImage >::ThreadStruct str;
   str.Filter = this;
-  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
-  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
 
-  // multithread the execution
+  // multithread the execution, one line-parallel pass per dimension.
+  // The persistent pool avoids spawning and joining threads for every pass.
+  PersistentThreadPool * threadPool = PersistentThreadPool::GetGlobalThreadPool();
   for( unsigned int d = 0; d < ImageDimension; d++ )
   {
     m_CurrentDimension = d;
-    this->GetMultiThreader()->SingleMethodExecute();
+    threadPool->SingleMethodExecute( this->ThreaderCallback, &str,
+      this->GetNumberOfThreads() );
   }
 
 }
@@ -215,7 +218,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
   }
   float progressPerDimension = 1.0 / ImageDimension;
 
-  ProgressReporter * progress = new ProgressReporter( this,
+  ProgressReporter progress( this,
     threadId,
     NumberOfRows[ m_CurrentDimension ],
     30,
@@ -233,8 +236,6 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
   typename TInputImage::ConstPointer inputImage( this->GetInput() );
   typename TOutputImage::Pointer     outputImage( this->GetOutput() );
 
-  outputImage->SetBufferedRegion( outputImage->GetRequestedRegion() );
-  outputImage->Allocate();
   RegionType region = outputRegionForThread;
 
   InputConstIteratorType  inputIterator(  inputImage,  region );
@@ -263,7 +264,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
       doOneDimension< InputConstIteratorType, OutputIteratorType,
       RealType, OutputPixelType, doDilate >( inputIterator, outputIterator,
-        *progress, LineLength, 0,
+        progress, LineLength, 0,
         this->m_MagnitudeSign,
         this->m_UseImageSpacing,
         this->m_Extreme,
@@ -298,7 +299,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
       doOneDimension< OutputConstIteratorType, OutputIteratorType,
       RealType, OutputPixelType, doDilate >( inputIteratorStage2, outputIterator,
-        *progress, LineLength, m_CurrentDimension,
+        progress, LineLength, m_CurrentDimension,
         this->m_MagnitudeSign,
         this->m_UseImageSpacing,
         this->m_Extreme,
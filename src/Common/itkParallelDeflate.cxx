@@ -0,0 +1,159 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkParallelDeflate.h"
+#include "itkMacro.h"
+#include "itk_zlib.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+/** The blocks, shared by the threads. */
+struct ParallelDeflateBlocks
+{
+  const unsigned char *      m_Data;
+  SizeValueType              m_Size;
+  int                        m_Level;
+  std::vector< std::string > m_Output;
+  std::vector< uLong >       m_Checksums;
+  std::vector< bool >        m_Failed;
+  ThreadIdType               m_NumberOfThreads;
+};
+
+/**
+ * ****************** CompressThreaderCallback *********************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+ParallelDeflate
+::CompressThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  ParallelDeflateBlocks * blocks = static_cast< ParallelDeflateBlocks * >( infoStruct->UserData );
+  const ThreadIdType      threadId        = infoStruct->ThreadID;
+  const SizeValueType     numberOfBlocks  = blocks->m_Output.size();
+  const SizeValueType     blockSize       = GetBlockSize();
+
+  /** Every thread compresses every m_NumberOfThreads'th block. */
+  for( SizeValueType b = threadId; b < numberOfBlocks; b += blocks->m_NumberOfThreads )
+  {
+    const SizeValueType begin = b * blockSize;
+    const SizeValueType size  = std::min( blockSize, blocks->m_Size - begin );
+    const bool          last  = ( b == numberOfBlocks - 1 );
+
+    /** A raw deflate stream, without zlib header and checksum. */
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree  = Z_NULL;
+    stream.opaque = Z_NULL;
+    if( deflateInit2( &stream, blocks->m_Level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+    {
+      blocks->m_Failed[ b ] = true;
+      continue;
+    }
+
+    /** Non-final blocks end with a sync flush, at a byte boundary. */
+    std::string & output = blocks->m_Output[ b ];
+    output.resize( deflateBound( &stream, static_cast< uLong >( size ) ) + 16 );
+    stream.next_in   = const_cast< Bytef * >( blocks->m_Data + begin );
+    stream.avail_in  = static_cast< uInt >( size );
+    stream.next_out  = reinterpret_cast< Bytef * >( &output[ 0 ] );
+    stream.avail_out = static_cast< uInt >( output.size() );
+    const int result = deflate( &stream, last ? Z_FINISH : Z_SYNC_FLUSH );
+    if( ( last && result != Z_STREAM_END ) || ( !last && result != Z_OK ) || stream.avail_in != 0 )
+    {
+      blocks->m_Failed[ b ] = true;
+    }
+    output.resize( output.size() - stream.avail_out );
+    deflateEnd( &stream );
+
+    blocks->m_Checksums[ b ] = adler32( adler32( 0L, Z_NULL, 0 ),
+      blocks->m_Data + begin, static_cast< uInt >( size ) );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end CompressThreaderCallback()
+
+
+/**
+ * ****************** Compress *********************************
+ */
+
+void
+ParallelDeflate
+::Compress( const void * data, const SizeValueType size,
+  const int level, const ThreadIdType numberOfThreads, std::string & output )
+{
+  /** Split the buffer in blocks. */
+  const SizeValueType   blockSize      = GetBlockSize();
+  const SizeValueType   numberOfBlocks = size == 0 ? 1 : ( size + blockSize - 1 ) / blockSize;
+  ParallelDeflateBlocks blocks;
+  blocks.m_Data            = static_cast< const unsigned char * >( data );
+  blocks.m_Size            = size;
+  blocks.m_Level           = level;
+  blocks.m_Output.resize( numberOfBlocks );
+  blocks.m_Checksums.resize( numberOfBlocks, 1 );
+  blocks.m_Failed.resize( numberOfBlocks, false );
+  blocks.m_NumberOfThreads = static_cast< ThreadIdType >(
+    std::max< SizeValueType >( 1, std::min< SizeValueType >( numberOfThreads, numberOfBlocks ) ) );
+
+  /** Compress the blocks. */
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( blocks.m_NumberOfThreads );
+  threader->SetSingleMethod( ParallelDeflate::CompressThreaderCallback, &blocks );
+  threader->SingleMethodExecute();
+
+  /** Concatenate the zlib header, the blocks and the checksum. */
+  SizeValueType totalSize = 6;
+  uLong         checksum  = adler32( 0L, Z_NULL, 0 );
+  for( SizeValueType b = 0; b < numberOfBlocks; ++b )
+  {
+    if( blocks.m_Failed[ b ] )
+    {
+      itkGenericExceptionMacro( << "ERROR: deflating block " << b << " failed." );
+    }
+    const SizeValueType blockBegin = b * blockSize;
+    const SizeValueType blockEnd   = std::min( blockBegin + blockSize, size );
+    checksum   = adler32_combine( checksum, blocks.m_Checksums[ b ],
+      static_cast< z_off_t >( blockEnd - blockBegin ) );
+    totalSize += blocks.m_Output[ b ].size();
+  }
+
+  output.clear();
+  output.reserve( totalSize );
+  output.push_back( static_cast< char >( 0x78 ) );
+  output.push_back( static_cast< char >( 0x9c ) );
+  for( SizeValueType b = 0; b < numberOfBlocks; ++b )
+  {
+    output.append( blocks.m_Output[ b ] );
+    std::string().swap( blocks.m_Output[ b ] );
+  }
+  for( int shift = 24; shift >= 0; shift -= 8 )
+  {
+    output.push_back( static_cast< char >( ( checksum >> shift ) & 0xff ) );
+  }
+
+} // end Compress()
+
+
+} // end namespace itk
@@ -0,0 +1,69 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelDeflate_h
+#define __itkParallelDeflate_h
+
+#include "itkIntTypes.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+
+namespace itk
+{
+
+/** \class ParallelDeflate
+ *
+ * \brief Compresses a buffer to a zlib stream with several threads.
+ *
+ * The buffer is split in blocks, which are deflated independently, each
+ * block ending at a byte boundary, as done by pigz. The blocks are
+ * concatenated between one zlib header and the Adler-32 checksum of the
+ * whole buffer, so the result is a single ordinary zlib stream, which any
+ * zlib reader, such as the MetaImageIO, can inflate. Blocks do not refer to
+ * data of previous blocks, which costs a little compression ratio.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ParallelDeflate
+{
+public:
+
+  /** Compress size bytes of data into output, with the zlib compression
+   * level (-1 for the default, 0 to 9) and the given number of threads.
+   * Throws an ExceptionObject on failure. */
+  static void Compress( const void * data, const SizeValueType size,
+    const int level, const ThreadIdType numberOfThreads, std::string & output );
+
+  /** The size of the blocks that are compressed independently. */
+  static SizeValueType GetBlockSize( void ) { return 1 << 22; }
+
+private:
+
+  ParallelDeflate();                        // purposely not implemented
+  ParallelDeflate( const ParallelDeflate & ); // purposely not implemented
+  void operator=( const ParallelDeflate & );  // purposely not implemented
+
+  /** The function executed by the threads. */
+  static ITK_THREAD_RETURN_TYPE CompressThreaderCallback( void * arg );
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelDeflate_h
@@ -0,0 +1,611 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkPersistentThreadPool.h"
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#elif defined( _WIN32 )
+#include <windows.h>
+#endif
+
+/** Thread-local storage of a pointer, without depending on C++11. */
+#if defined( _MSC_VER )
+#define itkPersistentThreadPoolThreadLocal __declspec( thread )
+#else
+#define itkPersistentThreadPoolThreadLocal __thread
+#endif
+
+namespace itk
+{
+
+/** Variables for the process-wide thread pool. */
+static PersistentThreadPool::Pointer GlobalPersistentThreadPool;
+static SimpleFastMutexLock           GlobalPersistentThreadPoolMutex;
+
+/** The pool of which the calling thread executes a callback, if any. */
+static itkPersistentThreadPoolThreadLocal PersistentThreadPool * CurrentThreadPool = 0;
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+PersistentThreadPool
+::PersistentThreadPool()
+{
+  this->m_NumberOfThreads       = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->m_UseThreadAffinity     = false;
+  this->m_Spawner               = MultiThreader::New();
+  this->m_WorkAvailable         = ConditionVariable::New();
+  this->m_WorkFinished          = ConditionVariable::New();
+  this->m_PoolAvailable         = ConditionVariable::New();
+  this->m_Generation            = 0;
+  this->m_NumberOfActiveThreads = 0;
+  this->m_NumberOfBusyWorkers   = 0;
+  this->m_Busy                  = false;
+  this->m_Terminate             = false;
+  this->m_Callback              = 0;
+  this->m_ExceptionOccurred     = false;
+  this->m_ParentThreadPool      = 0;
+
+  this->StartWorkers();
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+PersistentThreadPool
+::~PersistentThreadPool()
+{
+  this->StopWorkers();
+
+} // end Destructor
+
+
+/**
+ * ****************** GetGlobalThreadPool *********************************
+ */
+
+PersistentThreadPool *
+PersistentThreadPool
+::GetGlobalThreadPool( void )
+{
+  GlobalPersistentThreadPoolMutex.Lock();
+  if( GlobalPersistentThreadPool.IsNull() )
+  {
+    GlobalPersistentThreadPool = Self::New();
+  }
+  GlobalPersistentThreadPoolMutex.Unlock();
+
+  return GlobalPersistentThreadPool.GetPointer();
+
+} // end GetGlobalThreadPool()
+
+
+/**
+ * ****************** SetNumberOfThreads *********************************
+ */
+
+void
+PersistentThreadPool
+::SetNumberOfThreads( ThreadIdType numberOfThreads )
+{
+  /** Clamp to the range supported by the MultiThreader. */
+  if( numberOfThreads < 1 ) { numberOfThreads = 1; }
+  if( numberOfThreads > ITK_MAX_THREADS ) { numberOfThreads = ITK_MAX_THREADS; }
+
+  /** Claiming the pool from one of its own callbacks would wait forever. */
+  if( this->IsCalledFromCallback() )
+  {
+    itkExceptionMacro( << "The number of threads cannot be changed from a callback of the pool." );
+  }
+
+  this->ClaimPool();
+  if( this->m_NumberOfThreads != numberOfThreads )
+  {
+    this->RestartWorkers( numberOfThreads, this->m_UseThreadAffinity );
+    this->Modified();
+  }
+  this->ReleasePool();
+
+} // end SetNumberOfThreads()
+
+
+/**
+ * ****************** SetUseThreadAffinity *********************************
+ */
+
+void
+PersistentThreadPool
+::SetUseThreadAffinity( bool useThreadAffinity )
+{
+  if( this->IsCalledFromCallback() )
+  {
+    itkExceptionMacro( << "The thread affinity cannot be changed from a callback of the pool." );
+  }
+
+  /** The workers pin themselves when they start. Unpinning is done by
+   * restarting them as well, since new threads inherit the affinity of
+   * the calling thread, which is never pinned.
+   */
+  this->ClaimPool();
+  if( this->m_UseThreadAffinity != useThreadAffinity )
+  {
+    this->RestartWorkers( this->m_NumberOfThreads, useThreadAffinity );
+    this->Modified();
+  }
+  this->ReleasePool();
+
+} // end SetUseThreadAffinity()
+
+
+/**
+ * ****************** SetCurrentThreadAffinity *********************************
+ */
+
+bool
+PersistentThreadPool
+::SetCurrentThreadAffinity( ThreadIdType processor )
+{
+#if defined( __linux__ )
+  const long numberOfProcessors = sysconf( _SC_NPROCESSORS_ONLN );
+  if( numberOfProcessors < 1 ) { return false; }
+  cpu_set_t cpuSet;
+  CPU_ZERO( &cpuSet );
+  CPU_SET( processor % numberOfProcessors, &cpuSet );
+  return pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &cpuSet ) == 0;
+#elif defined( _WIN32 )
+  SYSTEM_INFO systemInfo;
+  GetSystemInfo( &systemInfo );
+  DWORD numberOfProcessors = systemInfo.dwNumberOfProcessors;
+  if( numberOfProcessors > 8 * sizeof( DWORD_PTR ) ) { numberOfProcessors = 8 * sizeof( DWORD_PTR ); }
+  if( numberOfProcessors < 1 ) { return false; }
+  const DWORD_PTR mask = static_cast< DWORD_PTR >( 1 ) << ( processor % numberOfProcessors );
+  return SetThreadAffinityMask( GetCurrentThread(), mask ) != 0;
+#else
+  (void)processor;
+  return false;
+#endif
+
+} // end SetCurrentThreadAffinity()
+
+
+/**
+ * ****************** StartWorkers *********************************
+ */
+
+void
+PersistentThreadPool
+::StartWorkers( void )
+{
+  this->m_Terminate  = false;
+  this->m_Generation = 0;
+
+  /** Allocate the per-thread structs before spawning, since the workers
+   * keep pointers to them.
+   */
+  this->m_WorkerInfo.resize( this->m_NumberOfThreads );
+  this->m_ThreadInfo.resize( this->m_NumberOfThreads );
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_WorkerInfo[ i ].m_Pool     = this;
+    this->m_WorkerInfo[ i ].m_ThreadId = i;
+  }
+
+  /** Thread 0 is the calling thread, so we spawn one thread less. */
+  this->m_SpawnedThreadIds.clear();
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_SpawnedThreadIds.push_back( this->m_Spawner->SpawnThread(
+      Self::WorkerThreadCallback, &this->m_WorkerInfo[ i ] ) );
+  }
+
+} // end StartWorkers()
+
+
+/**
+ * ****************** StopWorkers *********************************
+ */
+
+void
+PersistentThreadPool
+::StopWorkers( void )
+{
+  this->m_Mutex.Lock();
+  this->m_Terminate = true;
+  this->m_WorkAvailable->Broadcast();
+  this->m_Mutex.Unlock();
+
+  /** TerminateThread() joins the thread. */
+  for( std::size_t i = 0; i < this->m_SpawnedThreadIds.size(); ++i )
+  {
+    this->m_Spawner->TerminateThread( this->m_SpawnedThreadIds[ i ] );
+  }
+  this->m_SpawnedThreadIds.clear();
+
+} // end StopWorkers()
+
+
+/**
+ * ****************** ClaimPool *********************************
+ */
+
+void
+PersistentThreadPool
+::ClaimPool( void )
+{
+  this->m_Mutex.Lock();
+  while( this->m_Busy )
+  {
+    this->m_PoolAvailable->Wait( &this->m_Mutex );
+  }
+  this->m_Busy = true;
+  this->m_Mutex.Unlock();
+
+} // end ClaimPool()
+
+
+/**
+ * ****************** ReleasePool *********************************
+ */
+
+void
+PersistentThreadPool
+::ReleasePool( void )
+{
+  this->m_Mutex.Lock();
+  this->m_Busy = false;
+  this->m_PoolAvailable->Signal();
+  this->m_Mutex.Unlock();
+
+} // end ReleasePool()
+
+
+/**
+ * ****************** RestartWorkers *********************************
+ */
+
+void
+PersistentThreadPool
+::RestartWorkers( ThreadIdType numberOfThreads, bool useThreadAffinity )
+{
+  this->StopWorkers();
+  this->m_NumberOfThreads   = numberOfThreads;
+  this->m_UseThreadAffinity = useThreadAffinity;
+  this->StartWorkers();
+
+} // end RestartWorkers()
+
+
+/**
+ * ****************** IsCalledFromCallback *********************************
+ */
+
+bool
+PersistentThreadPool
+::IsCalledFromCallback( void ) const
+{
+  for( const Self * pool = CurrentThreadPool; pool != 0; pool = pool->m_ParentThreadPool )
+  {
+    if( pool == this ) { return true; }
+  }
+  return false;
+
+} // end IsCalledFromCallback()
+
+
+/**
+ * ****************** WorkerThreadCallback *********************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+PersistentThreadPool
+::WorkerThreadCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  WorkerInfoType * workerInfo = static_cast< WorkerInfoType * >( infoStruct->UserData );
+
+  workerInfo->m_Pool->WorkerLoop( workerInfo->m_ThreadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WorkerThreadCallback()
+
+
+/**
+ * ****************** WorkerLoop *********************************
+ */
+
+void
+PersistentThreadPool
+::WorkerLoop( ThreadIdType threadId )
+{
+  /** The generation counter is reset in StartWorkers() before the workers
+   * are spawned, so a worker that starts late still picks up the first job.
+   */
+  unsigned long seenGeneration = 0;
+
+  /** Pin this worker, if requested. Failure is not fatal. */
+  if( this->m_UseThreadAffinity )
+  {
+    Self::SetCurrentThreadAffinity( threadId );
+  }
+
+  this->m_Mutex.Lock();
+  while( true )
+  {
+    /** Sleep until there is new work, or until we should stop. */
+    while( !this->m_Terminate && this->m_Generation == seenGeneration )
+    {
+      this->m_WorkAvailable->Wait( &this->m_Mutex );
+    }
+    if( this->m_Terminate ) { break; }
+    seenGeneration = this->m_Generation;
+
+    /** Threads not needed for this job go back to sleep. */
+    if( threadId < this->m_NumberOfActiveThreads )
+    {
+      this->m_Mutex.Unlock();
+      this->RunCallback( threadId );
+      this->m_Mutex.Lock();
+
+      --this->m_NumberOfBusyWorkers;
+      if( this->m_NumberOfBusyWorkers == 0 )
+      {
+        this->m_WorkFinished->Signal();
+      }
+    }
+  }
+  this->m_Mutex.Unlock();
+
+} // end WorkerLoop()
+
+
+/**
+ * ****************** RunCallback *********************************
+ */
+
+void
+PersistentThreadPool
+::RunCallback( ThreadIdType threadId )
+{
+  /** Mark this thread, so that nested calls are recognized. */
+  Self * previousThreadPool = CurrentThreadPool;
+  CurrentThreadPool = this;
+
+  try
+  {
+    this->m_Callback( &this->m_ThreadInfo[ threadId ] );
+  }
+  catch( ExceptionObject & excp )
+  {
+    this->m_ExceptionMutex.Lock();
+    if( !this->m_ExceptionOccurred )
+    {
+      this->m_ExceptionOccurred = true;
+      this->m_Exception         = excp;
+    }
+    this->m_ExceptionMutex.Unlock();
+  }
+  catch( std::exception & excp )
+  {
+    this->m_ExceptionMutex.Lock();
+    if( !this->m_ExceptionOccurred )
+    {
+      this->m_ExceptionOccurred = true;
+      this->m_Exception         = ExceptionObject( __FILE__, __LINE__, excp.what() );
+    }
+    this->m_ExceptionMutex.Unlock();
+  }
+  catch( ... )
+  {
+    this->m_ExceptionMutex.Lock();
+    if( !this->m_ExceptionOccurred )
+    {
+      this->m_ExceptionOccurred = true;
+      this->m_Exception         = ExceptionObject( __FILE__, __LINE__,
+        "Unknown exception thrown in PersistentThreadPool worker." );
+    }
+    this->m_ExceptionMutex.Unlock();
+  }
+
+  CurrentThreadPool = previousThreadPool;
+
+} // end RunCallback()
+
+
+/**
+ * ****************** GetNestedThreadPool *********************************
+ */
+
+PersistentThreadPool *
+PersistentThreadPool
+::GetNestedThreadPool( void )
+{
+  this->m_Mutex.Lock();
+  if( this->m_NestedThreadPool.IsNull() )
+  {
+    this->m_NestedThreadPool = Self::New();
+    this->m_NestedThreadPool->m_ParentThreadPool = this;
+    this->m_NestedThreadPool->SetNumberOfThreads( this->m_NumberOfThreads );
+  }
+  Self * nestedThreadPool = this->m_NestedThreadPool.GetPointer();
+  this->m_Mutex.Unlock();
+
+  return nestedThreadPool;
+
+} // end GetNestedThreadPool()
+
+
+/**
+ * ****************** SingleMethodExecute *********************************
+ */
+
+void
+PersistentThreadPool
+::SingleMethodExecute( ThreadFunctionType callback,
+  void * userData, ThreadIdType numberOfThreads )
+{
+  /** A callback of this pool, or of one of its nested pools, would wait
+   * for itself. Such nested calls are executed on the nested pool of the
+   * innermost pool of the calling thread.
+   */
+  if( this->IsCalledFromCallback() )
+  {
+    CurrentThreadPool->GetNestedThreadPool()->SingleMethodExecute(
+      callback, userData, numberOfThreads );
+    return;
+  }
+
+  /** Claim the pool; if it is in use by another thread, wait for it. */
+  this->ClaimPool();
+
+  /** Enlarge the pool if needed, clamped as in SetNumberOfThreads(). */
+  if( numberOfThreads == 0 ) { numberOfThreads = this->m_NumberOfThreads; }
+  if( numberOfThreads > ITK_MAX_THREADS ) { numberOfThreads = ITK_MAX_THREADS; }
+  if( numberOfThreads > this->m_NumberOfThreads )
+  {
+    this->RestartWorkers( numberOfThreads, this->m_UseThreadAffinity );
+  }
+
+  /** Setup the job. */
+  this->m_Callback          = callback;
+  this->m_ExceptionOccurred = false;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_ThreadInfo[ i ].ThreadID        = i;
+    this->m_ThreadInfo[ i ].NumberOfThreads = numberOfThreads;
+    this->m_ThreadInfo[ i ].UserData        = userData;
+  }
+
+  /** Wake up the workers. */
+  if( numberOfThreads > 1 )
+  {
+    this->m_Mutex.Lock();
+    this->m_NumberOfActiveThreads = numberOfThreads;
+    this->m_NumberOfBusyWorkers   = numberOfThreads - 1;
+    ++this->m_Generation;
+    this->m_WorkAvailable->Broadcast();
+    this->m_Mutex.Unlock();
+  }
+
+  /** The calling thread does the work of thread 0. */
+  this->RunCallback( 0 );
+
+  /** Wait for the workers to finish, and release the pool. The exception
+   * is copied first, since a waiting caller may start the next job.
+   */
+  this->m_Mutex.Lock();
+  while( this->m_NumberOfBusyWorkers > 0 )
+  {
+    this->m_WorkFinished->Wait( &this->m_Mutex );
+  }
+  const bool      exceptionOccurred = this->m_ExceptionOccurred;
+  ExceptionObject exception         = this->m_Exception;
+  this->m_NumberOfActiveThreads = 0;
+  this->m_Busy                  = false;
+  this->m_PoolAvailable->Signal();
+  this->m_Mutex.Unlock();
+
+  if( exceptionOccurred )
+  {
+    throw exception;
+  }
+
+} // end SingleMethodExecute()
+
+
+/**
+ * ****************** WorkChunks *********************************
+ */
+
+PersistentThreadPool::WorkChunks
+::WorkChunks()
+{
+  this->m_ChunkSize      = 1;
+  this->m_RangeSize      = 0;
+  this->m_NextChunkBegin = 0;
+
+} // end WorkChunks()
+
+
+/**
+ * ****************** WorkChunks::Initialize *********************************
+ */
+
+void
+PersistentThreadPool::WorkChunks
+::Initialize( SizeValueType size, SizeValueType chunkSize )
+{
+  this->m_Mutex.Lock();
+  this->m_RangeSize      = size;
+  this->m_ChunkSize      = chunkSize > 0 ? chunkSize : 1;
+  this->m_NextChunkBegin = 0;
+  this->m_Mutex.Unlock();
+
+} // end WorkChunks::Initialize()
+
+
+/**
+ * ****************** WorkChunks::GetNext *********************************
+ */
+
+bool
+PersistentThreadPool::WorkChunks
+::GetNext( SizeValueType & begin, SizeValueType & end )
+{
+  this->m_Mutex.Lock();
+  const bool available = this->m_NextChunkBegin < this->m_RangeSize;
+  if( available )
+  {
+    begin = this->m_NextChunkBegin;
+    end   = begin + this->m_ChunkSize;
+    if( end > this->m_RangeSize ) { end = this->m_RangeSize; }
+    this->m_NextChunkBegin = end;
+  }
+  this->m_Mutex.Unlock();
+
+  return available;
+
+} // end WorkChunks::GetNext()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+PersistentThreadPool
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "UseThreadAffinity: " << this->m_UseThreadAffinity << std::endl;
+  os << indent << "NumberOfSpawnedThreads: " << this->m_SpawnedThreadIds.size() << std::endl;
+  os << indent << "Busy: " << this->m_Busy << std::endl;
+  os << indent << "NestedThreadPool: " << this->m_NestedThreadPool.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
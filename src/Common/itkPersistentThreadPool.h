@@ -0,0 +1,232 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPersistentThreadPool_h
+#define __itkPersistentThreadPool_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class PersistentThreadPool
+ *
+ * \brief A pool of worker threads that stay alive between calls.
+ *
+ * The itk::MultiThreader creates and joins its threads in every call to
+ * SingleMethodExecute(). For metrics that are evaluated thousands of times
+ * per resolution, as in stochastic gradient descent, the thread creation
+ * overhead becomes a measurable part of each iteration. This class keeps
+ * its workers alive and lets them sleep on a condition variable until new
+ * work arrives.
+ *
+ * The interface mimics the MultiThreader: a callback of type
+ * MultiThreader::ThreadFunctionType is called once for every thread, with
+ * a pointer to a MultiThreader::ThreadInfoStruct containing the ThreadID,
+ * NumberOfThreads and UserData. Existing threader callbacks can therefore
+ * be used unchanged. The calling thread acts as thread 0.
+ *
+ * In addition, a simple dynamic scheduler is provided by WorkChunks. The
+ * caller owns one per job and passes it to the callback, in its user data.
+ * The threads then repeatedly request the next chunk of a range, so that
+ * fast threads take over the work of slow ones. Note that with dynamic
+ * scheduling the order in which per-thread results are accumulated depends
+ * on the timing, so results are only reproducible up to floating point
+ * round-off.
+ *
+ * A process-wide pool is available through GetGlobalThreadPool(). Calls to
+ * SingleMethodExecute() from other threads are queued: they wait until the
+ * current job is finished. Calls that are nested inside a callback of the
+ * pool would wait for themselves; they are executed on a second pool,
+ * which is created on first use, and may nest again in the same way.
+ *
+ * Optionally, the workers can be pinned to a processor, worker i to
+ * logical processor i, so that the operating system does not migrate them
+ * away from the memory they touched first. The calling thread, thread 0,
+ * is never pinned. Pinning is supported on Linux and Windows, and a no-op
+ * on other platforms.
+ *
+ * \ingroup ITKCommon
+ */
+
+class PersistentThreadPool : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef PersistentThreadPool       Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( PersistentThreadPool, Object );
+
+  /** Typedefs borrowed from the MultiThreader. */
+  typedef MultiThreader::ThreadFunctionType ThreadFunctionType;
+  typedef MultiThreader::ThreadInfoStruct   ThreadInfoType;
+
+  /** Get the process-wide pool, which is created on first use. */
+  static Self * GetGlobalThreadPool( void );
+
+  /** Set/Get the number of threads, including the calling thread.
+   * Changing the number of threads restarts the workers. As with
+   * SingleMethodExecute(), the setters wait until the current job of
+   * another thread is finished. They may not be called from a callback of
+   * the pool itself. */
+  virtual void SetNumberOfThreads( ThreadIdType numberOfThreads );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
+
+  /** Set/Get whether the workers are pinned to a processor. Changing
+   * this setting restarts the workers, see SetNumberOfThreads(). Default: false. */
+  virtual void SetUseThreadAffinity( bool useThreadAffinity );
+  itkGetConstMacro( UseThreadAffinity, bool );
+  itkBooleanMacro( UseThreadAffinity );
+
+  /** Execute the callback on numberOfThreads threads and block until all
+   * threads are finished. When numberOfThreads is larger than the current
+   * pool size, the pool is enlarged. A value of zero means all threads
+   * of the pool. Exceptions thrown in a callback are rethrown here.
+   */
+  virtual void SingleMethodExecute( ThreadFunctionType callback,
+    void * userData, ThreadIdType numberOfThreads = 0 );
+
+  /** \class WorkChunks
+   * \brief Dynamic scheduling: hands out the range [0, size[ in chunks of
+   * chunkSize to the threads of one job.
+   */
+  class WorkChunks
+  {
+public:
+
+    WorkChunks();
+
+    /** Split [0, size[ in chunks of chunkSize. Call before the job. */
+    void Initialize( SizeValueType size, SizeValueType chunkSize );
+
+    /** Get the next chunk [begin, end[. Returns false when the whole
+     * range has been handed out. Thread-safe. */
+    bool GetNext( SizeValueType & begin, SizeValueType & end );
+
+private:
+
+    WorkChunks( const WorkChunks & );    // purposely not implemented
+    void operator=( const WorkChunks & ); // purposely not implemented
+
+    SimpleFastMutexLock m_Mutex;
+    SizeValueType       m_ChunkSize;
+    SizeValueType       m_RangeSize;
+    SizeValueType       m_NextChunkBegin;
+  };
+
+protected:
+
+  PersistentThreadPool();
+  virtual ~PersistentThreadPool();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Start and stop the worker threads. */
+  void StartWorkers( void );
+  void StopWorkers( void );
+
+  /** Claim the pool for the calling thread, waiting until the job of
+   * another thread is finished, and release it again. The job and the
+   * workers may only be changed while the pool is claimed. */
+  void ClaimPool( void );
+  void ReleasePool( void );
+
+  /** Restart the workers with new settings. The pool should be claimed. */
+  void RestartWorkers( ThreadIdType numberOfThreads, bool useThreadAffinity );
+
+  /** Whether the calling thread executes a callback of this pool, or of
+   * one of its nested pools. */
+  bool IsCalledFromCallback( void ) const;
+
+  /** The function executed by the workers. */
+  static ITK_THREAD_RETURN_TYPE WorkerThreadCallback( void * arg );
+
+  /** The main loop of a worker thread. */
+  void WorkerLoop( ThreadIdType threadId );
+
+  /** Run the callback for one thread, catching exceptions. */
+  void RunCallback( ThreadIdType threadId );
+
+  /** Get the pool for calls nested inside a callback of this pool. */
+  Self * GetNestedThreadPool( void );
+
+  /** Pin the current thread to a logical processor, modulo the number of
+   * processors. Returns false if this is not supported or failed. */
+  static bool SetCurrentThreadAffinity( ThreadIdType processor );
+
+private:
+
+  PersistentThreadPool( const Self & ); // purposely not implemented
+  void operator=( const Self & );       // purposely not implemented
+
+  /** Struct given to the spawned threads. */
+  struct WorkerInfoType
+  {
+    PersistentThreadPool * m_Pool;
+    ThreadIdType           m_ThreadId;
+  };
+
+  ThreadIdType                  m_NumberOfThreads;
+  bool                          m_UseThreadAffinity;
+  MultiThreader::Pointer        m_Spawner;
+  std::vector< ThreadIdType >   m_SpawnedThreadIds;
+  std::vector< WorkerInfoType > m_WorkerInfo;
+  std::vector< ThreadInfoType > m_ThreadInfo;
+
+  /** Synchronization of the workers. */
+  SimpleMutexLock            m_Mutex;
+  ConditionVariable::Pointer m_WorkAvailable;
+  ConditionVariable::Pointer m_WorkFinished;
+  ConditionVariable::Pointer m_PoolAvailable;
+  unsigned long              m_Generation;
+  ThreadIdType               m_NumberOfActiveThreads;
+  ThreadIdType               m_NumberOfBusyWorkers;
+  bool                       m_Busy;
+  bool                       m_Terminate;
+
+  /** The current job. */
+  ThreadFunctionType  m_Callback;
+  bool                m_ExceptionOccurred;
+  ExceptionObject     m_Exception;
+  SimpleFastMutexLock m_ExceptionMutex;
+
+  /** The pool for nested calls, see GetNestedThreadPool(), and the pool
+   * of which this is the nested pool, if any. */
+  Pointer m_NestedThreadPool;
+  Self *  m_ParentThreadPool;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPersistentThreadPool_h
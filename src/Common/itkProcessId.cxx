@@ -0,0 +1,51 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkProcessId.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <sstream>
+
+namespace itk
+{
+
+/** The number of temporary file names handed out in this process. The
+ * mutex is a namespace scope static, so it is constructed before main().
+ */
+static SimpleFastMutexLock s_TemporaryFileNameMutex;
+static unsigned long       s_TemporaryFileNameCounter = 0;
+
+/**
+ * ****************** GetUniqueTemporaryFileName *********************************
+ */
+
+std::string
+GetUniqueTemporaryFileName( const std::string & fileName )
+{
+  s_TemporaryFileNameMutex.Lock();
+  const unsigned long count = s_TemporaryFileNameCounter++;
+  s_TemporaryFileNameMutex.Unlock();
+
+  std::ostringstream name;
+  name << fileName << "." << GetProcessIdentifier() << "." << count << ".tmp";
+  return name.str();
+
+} // end GetUniqueTemporaryFileName()
+
+
+} // end namespace itk
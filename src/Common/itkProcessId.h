@@ -0,0 +1,57 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkProcessId_h
+#define __itkProcessId_h
+
+#if defined( _WIN32 )
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <string>
+
+namespace itk
+{
+
+/** The id of the calling process. It makes the names of temporary files
+ * unique among processes that share a directory, such as the caches, and
+ * identifies the process in the status file.
+ */
+inline unsigned long
+GetProcessIdentifier( void )
+{
+#if defined( _WIN32 )
+  return static_cast< unsigned long >( _getpid() );
+#else
+  return static_cast< unsigned long >( getpid() );
+#endif
+}
+
+
+/** A name for a temporary file, next to fileName, that is unique among all
+ * writers: "<fileName>.<pid>.<n>.tmp", with n counting the calls in this
+ * process. Writers of concurrent processes, and concurrent writers in the
+ * same process, such as the registrations of -slices and -sweep, thus never
+ * write the same temporary file before renaming it to fileName.
+ */
+std::string GetUniqueTemporaryFileName( const std::string & fileName );
+
+} // end namespace itk
+
+#endif // end #ifndef __itkProcessId_h
@@ -0,0 +1,333 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRecursiveBSplineInterpolateImageFunctionImplementation_h
+#define __itkRecursiveBSplineInterpolateImageFunctionImplementation_h
+
+#include "itkIntTypes.h"
+#include "itkMacro.h"
+
+namespace itk
+{
+
+/** \class RecursiveBSplineInterpolationWeights
+ *
+ * \brief The 1D weights and derivative weights of the B-spline interpolation
+ * of an image, for spline orders 1 to 5.
+ *
+ * The argument u is the continuous index minus the first index of the support
+ * region, i.e. floor( cindex - ( SplineOrder - 1 ) / 2 ). The formulas are
+ * those of itk::BSplineInterpolateImageFunction, so that the results agree
+ * with that interpolator; in particular the derivative weights of the first
+ * order spline do not depend on u. The derivative weights of order n are the
+ * differences of the weights of order n - 1, evaluated at u - 0.5.
+ *
+ * \ingroup ImageFunctions
+ */
+
+template< unsigned int SplineOrder >
+class RecursiveBSplineInterpolationWeights
+{};
+
+template< >
+class RecursiveBSplineInterpolationWeights< 1 >
+{
+public:
+
+  static inline void Evaluate( const double u, double * weights )
+  {
+    weights[ 0 ] = 1.0 - u;
+    weights[ 1 ] = u;
+  }
+
+
+  static inline void EvaluateDerivative( const double itkNotUsed( u ), double * weights )
+  {
+    weights[ 0 ] = -1.0;
+    weights[ 1 ] = 1.0;
+  }
+
+
+};
+
+template< >
+class RecursiveBSplineInterpolationWeights< 2 >
+{
+public:
+
+  static inline void Evaluate( const double u, double * weights )
+  {
+    const double w = u - 1.0;
+    weights[ 1 ] = 0.75 - w * w;
+    weights[ 2 ] = 0.5 * ( w - weights[ 1 ] + 1.0 );
+    weights[ 0 ] = 1.0 - weights[ 1 ] - weights[ 2 ];
+  }
+
+
+  static inline void EvaluateDerivative( const double u, double * weights )
+  {
+    const double w  = u - 0.5;
+    const double w1 = 1.0 - w;
+    weights[ 0 ] = 0.0 - w1;
+    weights[ 1 ] = w1 - w;
+    weights[ 2 ] = w;
+  }
+
+
+};
+
+template< >
+class RecursiveBSplineInterpolationWeights< 3 >
+{
+public:
+
+  static inline void Evaluate( const double u, double * weights )
+  {
+    const double w = u - 1.0;
+    weights[ 3 ] = ( 1.0 / 6.0 ) * w * w * w;
+    weights[ 0 ] = ( 1.0 / 6.0 ) + 0.5 * w * ( w - 1.0 ) - weights[ 3 ];
+    weights[ 2 ] = w + weights[ 0 ] - 2.0 * weights[ 3 ];
+    weights[ 1 ] = 1.0 - weights[ 0 ] - weights[ 2 ] - weights[ 3 ];
+  }
+
+
+  static inline void EvaluateDerivative( const double u, double * weights )
+  {
+    const double w  = u - 1.5;
+    const double w2 = 0.75 - w * w;
+    const double w3 = 0.5 * ( w - w2 + 1.0 );
+    const double w1 = 1.0 - w2 - w3;
+    weights[ 0 ] = 0.0 - w1;
+    weights[ 1 ] = w1 - w2;
+    weights[ 2 ] = w2 - w3;
+    weights[ 3 ] = w3;
+  }
+
+
+};
+
+template< >
+class RecursiveBSplineInterpolationWeights< 4 >
+{
+public:
+
+  static inline void Evaluate( const double u, double * weights )
+  {
+    const double w  = u - 2.0;
+    const double w2 = w * w;
+    const double t  = ( 1.0 / 6.0 ) * w2;
+    weights[ 0 ] = 0.5 - w;
+    weights[ 0 ] *= weights[ 0 ];
+    weights[ 0 ] *= ( 1.0 / 24.0 ) * weights[ 0 ];
+    const double t0 = w * ( t - 11.0 / 24.0 );
+    const double t1 = 19.0 / 96.0 + w2 * ( 0.25 - t );
+    weights[ 1 ] = t1 + t0;
+    weights[ 3 ] = t1 - t0;
+    weights[ 4 ] = weights[ 0 ] + t0 + 0.5 * w;
+    weights[ 2 ] = 1.0 - weights[ 0 ] - weights[ 1 ] - weights[ 3 ] - weights[ 4 ];
+  }
+
+
+  static inline void EvaluateDerivative( const double u, double * weights )
+  {
+    double w[ 4 ];
+    RecursiveBSplineInterpolationWeights< 3 >::Evaluate( u - 0.5, w );
+    weights[ 0 ] = 0.0 - w[ 0 ];
+    weights[ 1 ] = w[ 0 ] - w[ 1 ];
+    weights[ 2 ] = w[ 1 ] - w[ 2 ];
+    weights[ 3 ] = w[ 2 ] - w[ 3 ];
+    weights[ 4 ] = w[ 3 ];
+  }
+
+
+};
+
+template< >
+class RecursiveBSplineInterpolationWeights< 5 >
+{
+public:
+
+  static inline void Evaluate( const double u, double * weights )
+  {
+    double       w  = u - 2.0;
+    double       w2 = w * w;
+    weights[ 5 ] = ( 1.0 / 120.0 ) * w * w2 * w2;
+    w2          -= w;
+    const double w4 = w2 * w2;
+    w           -= 0.5;
+    const double t  = w2 * ( w2 - 3.0 );
+    weights[ 0 ] = ( 1.0 / 24.0 ) * ( 1.0 / 5.0 + w2 + w4 ) - weights[ 5 ];
+    double t0 = ( 1.0 / 24.0 ) * ( w2 * ( w2 - 5.0 ) + 46.0 / 5.0 );
+    double t1 = ( -1.0 / 12.0 ) * w * ( t + 4.0 );
+    weights[ 2 ] = t0 + t1;
+    weights[ 3 ] = t0 - t1;
+    t0           = ( 1.0 / 16.0 ) * ( 9.0 / 5.0 - t );
+    t1           = ( 1.0 / 24.0 ) * w * ( w4 - w2 - 5.0 );
+    weights[ 1 ] = t0 + t1;
+    weights[ 4 ] = t0 - t1;
+  }
+
+
+  static inline void EvaluateDerivative( const double u, double * weights )
+  {
+    double w[ 5 ];
+    RecursiveBSplineInterpolationWeights< 4 >::Evaluate( u - 0.5, w );
+    weights[ 0 ] = 0.0 - w[ 0 ];
+    weights[ 1 ] = w[ 0 ] - w[ 1 ];
+    weights[ 2 ] = w[ 1 ] - w[ 2 ];
+    weights[ 3 ] = w[ 2 ] - w[ 3 ];
+    weights[ 4 ] = w[ 3 ] - w[ 4 ];
+    weights[ 5 ] = w[ 4 ];
+  }
+
+
+};
+
+/** \class RecursiveBSplineInterpolateImageFunctionImplementation
+ *
+ * \brief This helper class contains the recursive implementation of the
+ * B-spline interpolation of an image.
+ *
+ * It is the interpolator counterpart of RecursiveBSplineTransformImplementation:
+ * the loops over the dimensions and the support of the spline are unrolled at
+ * compile time. The coefficients are read from a buffer that is padded with
+ * the mirrored coefficients, such that the whole support region of every
+ * point inside the image lies inside the buffer, and no boundary condition
+ * has to be applied per coefficient. The pointer points to the first
+ * coefficient of the support region, and the offset table is that of the
+ * padded buffer. The 1D weights are stored per dimension, SplineOrder + 1
+ * for each dimension, see RecursiveBSplineInterpolationWeights.
+ *
+ * \ingroup ImageFunctions
+ */
+
+template< unsigned int SpaceDimension, unsigned int SplineOrder, class TCoefficient >
+class RecursiveBSplineInterpolateImageFunctionImplementation
+{
+public:
+
+  typedef TCoefficient CoefficientType;
+
+  /** Helper constant variable. */
+  itkStaticConstMacro( HelperConstVariable, unsigned int,
+    ( SpaceDimension - 1 ) * ( SplineOrder + 1 ) );
+
+  /** Evaluate recursive implementation. */
+  static inline double Evaluate(
+    const CoefficientType * coefficients,
+    const OffsetValueType * offsetTable,
+    const double * weights1D )
+  {
+    const OffsetValueType bot   = offsetTable[ SpaceDimension - 1 ];
+    double                value = 0.0;
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      /** Recurse. */
+      value += RecursiveBSplineInterpolateImageFunctionImplementation< SpaceDimension - 1, SplineOrder, TCoefficient >
+        ::Evaluate( coefficients, offsetTable, weights1D ) * weights1D[ k + HelperConstVariable ];
+
+      // move to the next coefficient
+      coefficients += bot;
+    }
+    return value;
+  } // end Evaluate()
+
+
+  /** EvaluateValueAndDerivative recursive implementation.
+   * The output has SpaceDimension + 1 elements: first the derivatives
+   * with respect to the continuous index, then the value.
+   */
+  static inline void EvaluateValueAndDerivative(
+    double * derivativeAndValue,
+    const CoefficientType * coefficients,
+    const OffsetValueType * offsetTable,
+    const double * weights1D,
+    const double * derivativeWeights1D )
+  {
+    /** Create a temporary output and initialize the original. */
+    double tmp[ SpaceDimension ];
+    for( unsigned int n = 0; n <= SpaceDimension; ++n )
+    {
+      derivativeAndValue[ n ] = 0.0;
+    }
+
+    const OffsetValueType bot = offsetTable[ SpaceDimension - 1 ];
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      /** Recurse. */
+      RecursiveBSplineInterpolateImageFunctionImplementation< SpaceDimension - 1, SplineOrder, TCoefficient >
+        ::EvaluateValueAndDerivative( tmp, coefficients, offsetTable, weights1D, derivativeWeights1D );
+
+      /** Accumulate: the lower dimensions with the weights, and the value of
+       * the lower dimensions with both the weights and the derivative weights.
+       */
+      const double w  = weights1D[ k + HelperConstVariable ];
+      const double dw = derivativeWeights1D[ k + HelperConstVariable ];
+      for( unsigned int n = 0; n < SpaceDimension - 1; ++n )
+      {
+        derivativeAndValue[ n ] += tmp[ n ] * w;
+      }
+      derivativeAndValue[ SpaceDimension - 1 ] += tmp[ SpaceDimension - 1 ] * dw;
+      derivativeAndValue[ SpaceDimension ]     += tmp[ SpaceDimension - 1 ] * w;
+
+      // move to the next coefficient
+      coefficients += bot;
+    }
+  } // end EvaluateValueAndDerivative()
+
+
+};
+
+/** \class RecursiveBSplineInterpolateImageFunctionImplementation
+ *
+ * \brief Template specialization to stop the recursion.
+ */
+
+template< unsigned int SplineOrder, class TCoefficient >
+class RecursiveBSplineInterpolateImageFunctionImplementation< 0, SplineOrder, TCoefficient >
+{
+public:
+
+  typedef TCoefficient CoefficientType;
+
+  /** Evaluate recursive implementation. */
+  static inline double Evaluate(
+    const CoefficientType * coefficients,
+    const OffsetValueType * itkNotUsed( offsetTable ),
+    const double * itkNotUsed( weights1D ) )
+  {
+    return static_cast< double >( *coefficients );
+  } // end Evaluate()
+
+
+  /** EvaluateValueAndDerivative recursive implementation. */
+  static inline void EvaluateValueAndDerivative(
+    double * derivativeAndValue,
+    const CoefficientType * coefficients,
+    const OffsetValueType * itkNotUsed( offsetTable ),
+    const double * itkNotUsed( weights1D ),
+    const double * itkNotUsed( derivativeWeights1D ) )
+  {
+    derivativeAndValue[ 0 ] = static_cast< double >( *coefficients );
+  } // end EvaluateValueAndDerivative()
+
+
+};
+
+} // end namespace itk
+
+#endif /* __itkRecursiveBSplineInterpolateImageFunctionImplementation_h */
@@ -45,6 +45,7 @@
 #include "vnl/vnl_matrix.h"
 
 #include "itkMultiOrderBSplineDecompositionImageFilter.h"
+#include "itkRecursiveBSplineInterpolationWeightFunction.h"
 #include "itkConceptChecking.h"
 #include "itkCovariantVector.h"
 
@@ -80,6 +81,13 @@ namespace itk
  *               Spline is determined in all dimensions, cannot selectively
  *                  pick dimension for calculating spline.
  *
+ * The weights and the coefficient offsets of the support region are computed
+ * once per evaluation, for the first ImageDimension - 1 dimensions, and then
+ * applied to the slab of the coefficient image that belongs to the last index.
+ * EvaluateValueAndDerivativeAtContinuousIndex() shares them between the value
+ * and the derivative, and EvaluateValuesAndDerivativesOverLastDimension()
+ * between several positions in the last dimension.
+ *
  * \sa MultiOrderBSplineDecompositionImageFilter
  *
  * \ingroup ImageFunctions
@@ -165,6 +173,26 @@ public:
   CovariantVectorType EvaluateDerivativeAtContinuousIndex(
     const ContinuousIndexType & x ) const;
 
+  /** Evaluate the value and the derivative at a ContinuousIndex position,
+   * computing the weights only once. */
+  void EvaluateValueAndDerivativeAtContinuousIndex(
+    const ContinuousIndexType & x,
+    OutputType & value,
+    CovariantVectorType & derivative ) const;
+
+  /** Evaluate the values, and the derivatives if not NULL, at the first
+   * ImageDimension - 1 coordinates of x, for several indices in the last
+   * dimension. The last coordinate of x is not used. The weights are computed
+   * once for all indices, which are assumed to lie inside the image buffer.
+   * This is useful for the metrics over the last dimension, when the points
+   * of all time points map to the same spatial position. */
+  void EvaluateValuesAndDerivativesOverLastDimension(
+    const ContinuousIndexType & x,
+    const int * lastDimPositions,
+    const unsigned int numberOfLastDimPositions,
+    OutputType * values,
+    CovariantVectorType * derivatives ) const;
+
   /** Get/Sets the Spline Order, supports 0th - 5th order splines. The default
    *  is a 3rd order spline. */
   void SetSplineOrder( unsigned int SplineOrder );
@@ -208,6 +236,31 @@ private:
   ReducedDimensionBSplineInterpolateImageFunction( const Self & ); //purposely not implemented
   void operator=( const Self & );                                  //purposely not implemented
 
+  /** The maximum number of points in the support region, for spline order 5. */
+  itkStaticConstMacro( MaxNumberOfInterpolationPoints, unsigned int,
+    ( GetConstNumberOfIndicesHack< 5, ImageDimension - 1 >::Value ) );
+
+  /** The weights, the derivative weights and the coefficient offsets, relative
+   * to the start of a slab, of the points in the support region. */
+  struct SpatialSupportType
+  {
+    double          m_Weights[ MaxNumberOfInterpolationPoints ];
+    double          m_DerivativeWeights[ ImageDimension ][ MaxNumberOfInterpolationPoints ];
+    OffsetValueType m_Offsets[ MaxNumberOfInterpolationPoints ];
+  };
+
+  /** Compute the support region of x in the first ImageDimension - 1 dimensions. */
+  void ComputeSpatialSupport( const ContinuousIndexType & x,
+    const bool computeDerivativeWeights,
+    SpatialSupportType & support ) const;
+
+  /** Get the offset of the slab of the coefficient image at an index in the
+   * last dimension. */
+  OffsetValueType GetSlabOffset( const long lastDimIndex ) const;
+
+  /** Divide the derivative by the spacing, and orient it if requested. */
+  void ConvertToPhysicalDerivative( CovariantVectorType & derivative ) const;
+
   /** Determines the weights for interpolation of the value x */
   void SetInterpolationWeights( const ContinuousIndexType & x,
     const vnl_matrix< long > & EvaluateIndex,
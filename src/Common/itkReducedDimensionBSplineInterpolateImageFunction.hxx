@@ -149,61 +149,125 @@ ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoeffic
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
 ::EvaluateAtContinuousIndex( const ContinuousIndexType & x ) const
 {
-  /** Allocate memory on the stack: */
-  const unsigned int maxSplineOrder = 5;
-  const unsigned int maxMatrixSize  = ( ImageDimension - 1 ) * ( maxSplineOrder + 1 );
-  long               evaluateIndexData[ maxMatrixSize ];
-  double             weightsData[ maxMatrixSize ];
-
-  vnl_matrix_ref< long > EvaluateIndex( ImageDimension - 1, ( m_SplineOrder + 1 ), evaluateIndexData );
-
-  // compute the interpolation indexes
-  this->DetermineRegionOfSupport( EvaluateIndex, x, m_SplineOrder );
+  // compute the weights and offsets of the interpolation indexes
+  SpatialSupportType support;
+  this->ComputeSpatialSupport( x, false, support );
+
+  // perform interpolation in the slab of the last index
+  const CoefficientDataType * slab = m_Coefficients->GetBufferPointer()
+    + this->GetSlabOffset( vnl_math_rnd( x[ ImageDimension - 1 ] ) );
+  double interpolated = 0.0;
+  for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
+  {
+    interpolated += support.m_Weights[ p ] * slab[ support.m_Offsets[ p ] ];
+  }
+  return ( interpolated );
 
-  // Determine weights
-  vnl_matrix_ref< double > weights( ImageDimension - 1, ( m_SplineOrder + 1 ), weightsData );
+}
 
-  SetInterpolationWeights( x, EvaluateIndex, weights, m_SplineOrder );
 
-  // Modify EvaluateIndex at the boundaries using mirror boundary conditions
-  this->ApplyMirrorBoundaryConditions( EvaluateIndex, m_SplineOrder );
+template< class TImageType, class TCoordRep, class TCoefficientType >
+typename
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::CovariantVectorType
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::EvaluateDerivativeAtContinuousIndex( const ContinuousIndexType & x ) const
+{
+  OutputType          value;
+  CovariantVectorType derivativeValue;
+  this->EvaluateValueAndDerivativeAtContinuousIndex( x, value, derivativeValue );
+  return derivativeValue;
+}
 
-  // perform interpolation
-  double    interpolated = 0.0;
-  IndexType coefficientIndex;
-  coefficientIndex[ ImageDimension - 1 ] = vnl_math_rnd( x[ ImageDimension - 1 ] );
 
-  // Step through eachpoint in the N-dimensional interpolation cube.
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::EvaluateValueAndDerivativeAtContinuousIndex( const ContinuousIndexType & x,
+  OutputType & value, CovariantVectorType & derivativeValue ) const
+{
+  // compute the weights, derivative weights and offsets of the interpolation indexes
+  SpatialSupportType support;
+  this->ComputeSpatialSupport( x, true, support );
+
+  // calculate value and derivative in the slab of the last index
+  const CoefficientDataType * slab = m_Coefficients->GetBufferPointer()
+    + this->GetSlabOffset( vnl_math_rnd( x[ ImageDimension - 1 ] ) );
+  double interpolated = 0.0;
+  for( unsigned int n = 0; n < ImageDimension; n++ )
+  {
+    derivativeValue[ n ] = 0.0;
+  }
   for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
   {
-    // translate each step into the N-dimensional index.
-    //      IndexType pointIndex = PointToIndex( p );
-
-    double w = 1.0;
+    const double coefficient = slab[ support.m_Offsets[ p ] ];
+    interpolated += support.m_Weights[ p ] * coefficient;
     for( unsigned int n = 0; n < ImageDimension - 1; n++ )
     {
-      w                    *= weights[ n ][ m_PointsToIndex[ p ][ n ] ];
-      coefficientIndex[ n ] = EvaluateIndex[ n ][ m_PointsToIndex[ p ][ n ] ]; // Build up ND index for coefficients.
+      derivativeValue[ n ] += coefficient * support.m_DerivativeWeights[ n ][ p ];
     }
-    // Convert our step p to the appropriate point in ND space in the
-    // m_Coefficients cube.
-    interpolated += w * m_Coefficients->GetPixel( coefficientIndex );
   }
-  return ( interpolated );
-
+  value = interpolated;
+  this->ConvertToPhysicalDerivative( derivativeValue );
 }
 
 
 template< class TImageType, class TCoordRep, class TCoefficientType >
-typename
+void
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
-::CovariantVectorType
+::EvaluateValuesAndDerivativesOverLastDimension( const ContinuousIndexType & x,
+  const int * lastDimPositions, const unsigned int numberOfLastDimPositions,
+  OutputType * values, CovariantVectorType * derivatives ) const
+{
+  // compute the weights and offsets once for all slabs
+  SpatialSupportType support;
+  this->ComputeSpatialSupport( x, derivatives != NULL, support );
+
+  // sweep over the slabs
+  const CoefficientDataType * coefficients = m_Coefficients->GetBufferPointer();
+  for( unsigned int t = 0; t < numberOfLastDimPositions; t++ )
+  {
+    const CoefficientDataType * slab = coefficients + this->GetSlabOffset( lastDimPositions[ t ] );
+    double                      interpolated = 0.0;
+    if( derivatives == NULL )
+    {
+      for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
+      {
+        interpolated += support.m_Weights[ p ] * slab[ support.m_Offsets[ p ] ];
+      }
+    }
+    else
+    {
+      CovariantVectorType & derivativeValue = derivatives[ t ];
+      for( unsigned int n = 0; n < ImageDimension; n++ )
+      {
+        derivativeValue[ n ] = 0.0;
+      }
+      for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
+      {
+        const double coefficient = slab[ support.m_Offsets[ p ] ];
+        interpolated += support.m_Weights[ p ] * coefficient;
+        for( unsigned int n = 0; n < ImageDimension - 1; n++ )
+        {
+          derivativeValue[ n ] += coefficient * support.m_DerivativeWeights[ n ][ p ];
+        }
+      }
+      this->ConvertToPhysicalDerivative( derivativeValue );
+    }
+    values[ t ] = interpolated;
+  }
+}
+
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
-::EvaluateDerivativeAtContinuousIndex( const ContinuousIndexType & x ) const
+::ComputeSpatialSupport( const ContinuousIndexType & x,
+  const bool computeDerivativeWeights, SpatialSupportType & support ) const
 {
   /** Allocate memory on the stack: */
   const unsigned int maxSplineOrder = 5;
-  const unsigned int maxMatrixSize  = ( ImageDimension - 1 ) * ( maxSplineOrder + 1 );
+  const unsigned int maxMatrixSize  = ImageDimension * ( maxSplineOrder + 1 );
   long               evaluateIndexData[ maxMatrixSize ];
   double             weightsData[ maxMatrixSize ];
   double             weightsDerivativeData[ maxMatrixSize ];
@@ -211,62 +275,99 @@ ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoeffic
   vnl_matrix_ref< long > EvaluateIndex( ImageDimension - 1, ( m_SplineOrder + 1 ), evaluateIndexData );
 
   // compute the interpolation indexes
-  // TODO: Do we need to revisit region of support for the derivatives?
   this->DetermineRegionOfSupport( EvaluateIndex, x, m_SplineOrder );
 
   // Determine weights
   vnl_matrix_ref< double > weights( ImageDimension - 1, ( m_SplineOrder + 1 ), weightsData );
-
   SetInterpolationWeights( x, EvaluateIndex, weights, m_SplineOrder );
 
   vnl_matrix_ref< double > weightsDerivative( ImageDimension - 1, ( m_SplineOrder + 1 ), weightsDerivativeData );
-  SetDerivativeWeights( x, EvaluateIndex, weightsDerivative, ( m_SplineOrder ) );
+  if( computeDerivativeWeights )
+  {
+    SetDerivativeWeights( x, EvaluateIndex, weightsDerivative, m_SplineOrder );
+  }
 
   // Modify EvaluateIndex at the boundaries using mirror boundary conditions
   this->ApplyMirrorBoundaryConditions( EvaluateIndex, m_SplineOrder );
 
-  const InputImageType * inputImage = this->GetInputImage();
-  const typename InputImageType::SpacingType & spacing = inputImage->GetSpacing();
-
-  // Calculate derivative
-  CovariantVectorType derivativeValue;
-  derivativeValue[ ImageDimension - 1 ] = static_cast< OutputType >( 0.0 );
-  double    tempValue;
-  IndexType coefficientIndex;
-  coefficientIndex[ ImageDimension - 1 ] = vnl_math_rnd( x[ ImageDimension - 1 ] );
+  // Convert the indexes to offsets in a slab of the coefficient image
+  const OffsetValueType * offsetTable = m_Coefficients->GetOffsetTable();
+  const IndexType &       startIndex  = m_Coefficients->GetBufferedRegion().GetIndex();
   for( unsigned int n = 0; n < ImageDimension - 1; n++ )
   {
-    derivativeValue[ n ] = 0.0;
-    for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
+    for( unsigned int k = 0; k <= m_SplineOrder; k++ )
     {
-      tempValue = 1.0;
-      for( unsigned int n1 = 0; n1 < ImageDimension - 1; n1++ )
-      {
-        coefficientIndex[ n1 ] = EvaluateIndex[ n1 ][ m_PointsToIndex[ p ][ n1 ] ];
+      EvaluateIndex[ n ][ k ] = ( EvaluateIndex[ n ][ k ] - startIndex[ n ] ) * offsetTable[ n ];
+    }
+  }
 
-        if( n1 == n )
-        {
-          //w *= weights[ n ][ m_PointsToIndex[ p ][ n ] ];
-          tempValue *= weightsDerivative[ n1 ][ m_PointsToIndex[ p ][ n1 ] ];
-        }
-        else
+  // Step through each point in the (N-1)-dimensional interpolation cube.
+  for( unsigned int p = 0; p < m_MaxNumberInterpolationPoints; p++ )
+  {
+    double          w      = 1.0;
+    OffsetValueType offset = 0;
+    for( unsigned int n = 0; n < ImageDimension - 1; n++ )
+    {
+      w      *= weights[ n ][ m_PointsToIndex[ p ][ n ] ];
+      offset += EvaluateIndex[ n ][ m_PointsToIndex[ p ][ n ] ];
+    }
+    support.m_Weights[ p ] = w;
+    support.m_Offsets[ p ] = offset;
+
+    if( computeDerivativeWeights )
+    {
+      for( unsigned int n = 0; n < ImageDimension - 1; n++ )
+      {
+        double tempValue = 1.0;
+        for( unsigned int n1 = 0; n1 < ImageDimension - 1; n1++ )
         {
-          tempValue *= weights[ n1 ][ m_PointsToIndex[ p ][ n1 ] ];
+          if( n1 == n )
+          {
+            tempValue *= weightsDerivative[ n1 ][ m_PointsToIndex[ p ][ n1 ] ];
+          }
+          else
+          {
+            tempValue *= weights[ n1 ][ m_PointsToIndex[ p ][ n1 ] ];
+          }
         }
+        support.m_DerivativeWeights[ n ][ p ] = tempValue;
       }
-      derivativeValue[ n ] += m_Coefficients->GetPixel( coefficientIndex ) * tempValue;
     }
-    derivativeValue[ n ] /= spacing[ n ];  // take spacing into account
   }
+}
 
-  if( this->m_UseImageDirection )
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+OffsetValueType
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::GetSlabOffset( const long lastDimIndex ) const
+{
+  const unsigned int lastDim = ImageDimension - 1;
+  return ( lastDimIndex - m_Coefficients->GetBufferedRegion().GetIndex()[ lastDim ] )
+         * m_Coefficients->GetOffsetTable()[ lastDim ];
+}
+
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::ConvertToPhysicalDerivative( CovariantVectorType & derivativeValue ) const
+{
+  const InputImageType * inputImage = this->GetInputImage();
+  const typename InputImageType::SpacingType & spacing = inputImage->GetSpacing();
+
+  // take spacing into account
+  derivativeValue[ ImageDimension - 1 ] = static_cast< OutputType >( 0.0 );
+  for( unsigned int n = 0; n < ImageDimension - 1; n++ )
   {
-    CovariantVectorType orientedDerivative;
-    inputImage->TransformLocalVectorToPhysicalVector( derivativeValue, orientedDerivative );
-    return orientedDerivative;
+    derivativeValue[ n ] /= spacing[ n ];
   }
 
-  return derivativeValue;
+  if( this->m_UseImageDirection )
+  {
+    const CovariantVectorType derivative = derivativeValue;
+    inputImage->TransformLocalVectorToPhysicalVector( derivative, derivativeValue );
+  }
 }
 
 
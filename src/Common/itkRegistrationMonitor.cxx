@@ -0,0 +1,195 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkRegistrationMonitor.h"
+#include "itkEventObject.h"
+
+namespace itk
+{
+
+// static instance
+RegistrationMonitor * volatile RegistrationMonitor::s_ActiveMonitor = 0;
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+RegistrationMonitor
+::RegistrationMonitor()
+{
+  this->m_FinishedCondition = ConditionVariable::New();
+  this->m_CancelRequested   = false;
+  this->m_Finished          = false;
+  this->m_ReturnValue       = 0;
+
+  this->m_Progress.m_ElastixLevel          = 0;
+  this->m_Progress.m_NumberOfElastixLevels = 0;
+  this->m_Progress.m_Resolution            = 0;
+  this->m_Progress.m_NumberOfResolutions   = 0;
+  this->m_Progress.m_Iteration             = 0;
+  this->m_Progress.m_MetricValue           = 0.0;
+
+} // end Constructor
+
+
+/**
+ * ****************** SetProgress *********************************
+ */
+
+void
+RegistrationMonitor
+::SetProgress( const ProgressType & progress )
+{
+  this->m_Mutex.Lock();
+  if( progress.m_ElastixLevel != this->m_Progress.m_ElastixLevel
+    || progress.m_Resolution != this->m_Progress.m_Resolution )
+  {
+    this->m_MetricValues.clear();
+  }
+  this->m_Progress = progress;
+  this->m_MetricValues.push_back( progress.m_MetricValue );
+  this->m_Mutex.Unlock();
+
+  /** Call the observers without holding the lock, so they can ask for the
+   * progress. */
+  this->InvokeEvent( ProgressEvent() );
+
+} // end SetProgress()
+
+
+/**
+ * ****************** GetProgress *********************************
+ */
+
+RegistrationMonitor::ProgressType
+RegistrationMonitor
+::GetProgress( void ) const
+{
+  this->m_Mutex.Lock();
+  const ProgressType progress = this->m_Progress;
+  this->m_Mutex.Unlock();
+  return progress;
+
+} // end GetProgress()
+
+
+/**
+ * ****************** GetMetricValues *********************************
+ */
+
+std::vector< double >
+RegistrationMonitor
+::GetMetricValues( void ) const
+{
+  this->m_Mutex.Lock();
+  const std::vector< double > metricValues = this->m_MetricValues;
+  this->m_Mutex.Unlock();
+  return metricValues;
+
+} // end GetMetricValues()
+
+
+/**
+ * ****************** RequestCancel *********************************
+ */
+
+void
+RegistrationMonitor
+::RequestCancel( void )
+{
+  this->m_Mutex.Lock();
+  this->m_CancelRequested = true;
+  this->m_Mutex.Unlock();
+
+} // end RequestCancel()
+
+
+/**
+ * ****************** SetFinished *********************************
+ */
+
+void
+RegistrationMonitor
+::SetFinished( const int returnValue )
+{
+  this->m_Mutex.Lock();
+  this->m_Finished    = true;
+  this->m_ReturnValue = returnValue;
+  this->m_FinishedCondition->Broadcast();
+  this->m_Mutex.Unlock();
+
+} // end SetFinished()
+
+
+/**
+ * ****************** IsFinished *********************************
+ */
+
+bool
+RegistrationMonitor
+::IsFinished( void ) const
+{
+  this->m_Mutex.Lock();
+  const bool finished = this->m_Finished;
+  this->m_Mutex.Unlock();
+  return finished;
+
+} // end IsFinished()
+
+
+/**
+ * ****************** WaitForFinished *********************************
+ */
+
+int
+RegistrationMonitor
+::WaitForFinished( void )
+{
+  this->m_Mutex.Lock();
+  while( !this->m_Finished )
+  {
+    this->m_FinishedCondition->Wait( &this->m_Mutex );
+  }
+  const int returnValue = this->m_ReturnValue;
+  this->m_Mutex.Unlock();
+  return returnValue;
+
+} // end WaitForFinished()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+RegistrationMonitor
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  const ProgressType progress = this->GetProgress();
+  os << indent << "ElastixLevel: " << progress.m_ElastixLevel << std::endl;
+  os << indent << "Resolution: " << progress.m_Resolution << std::endl;
+  os << indent << "Iteration: " << progress.m_Iteration << std::endl;
+  os << indent << "MetricValue: " << progress.m_MetricValue << std::endl;
+  os << indent << "CancelRequested: " << ( this->m_CancelRequested ? "true" : "false" ) << std::endl;
+  os << indent << "Finished: " << ( this->IsFinished() ? "true" : "false" ) << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRegistrationMonitor_h
+#define __itkRegistrationMonitor_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class RegistrationMonitor
+ *
+ * \brief The progress of a registration that runs in another thread, and a
+ * request to cancel it.
+ *
+ * The elastix library returns a monitor from ELASTIX::RegisterImagesAsync().
+ * During the run this monitor is the active monitor of the process, see
+ * SetActiveMonitor(). In every iteration, elastix reports the parameter
+ * file, the resolution, the iteration and the metric value to it, and the
+ * monitor invokes a ProgressEvent. The observers of that event are called
+ * from the registration thread, after the monitor is unlocked.
+ *
+ * A cancel request is cooperative: elastix polls it after every iteration,
+ * and the metrics poll it before every threaded evaluation, see the
+ * AdvancedImageToImageMetric. Both then throw a ProcessAborted exception,
+ * so the threads of a cancelled registration are free within one iteration.
+ *
+ * All methods may be called from any thread.
+ *
+ * \ingroup ITKCommon
+ */
+
+class RegistrationMonitor : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef RegistrationMonitor        Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( RegistrationMonitor, Object );
+
+  /** The progress of the registration. */
+  struct ProgressType
+  {
+    unsigned int  m_ElastixLevel;
+    unsigned int  m_NumberOfElastixLevels;
+    unsigned int  m_Resolution;
+    unsigned int  m_NumberOfResolutions;
+    SizeValueType m_Iteration;
+    double        m_MetricValue;
+  };
+
+  /** Report the progress; invokes a ProgressEvent. The metric values of a
+   * resolution are collected, and cleared at the start of the next one. */
+  void SetProgress( const ProgressType & progress );
+
+  /** Get the last reported progress. */
+  ProgressType GetProgress( void ) const;
+
+  /** Get the metric values of the iterations of the current resolution. */
+  std::vector< double > GetMetricValues( void ) const;
+
+  /** Request the registration to stop. */
+  void RequestCancel( void );
+
+  /** Returns true if a cancel was requested. */
+  bool GetCancelRequested( void ) const { return this->m_CancelRequested; }
+
+  /** Mark the registration as finished, with the return value of the run,
+   * and wake up the threads in WaitForFinished(). */
+  void SetFinished( const int returnValue );
+
+  /** Returns true if the registration is finished. */
+  bool IsFinished( void ) const;
+
+  /** Block until the registration is finished, and return its return value. */
+  int WaitForFinished( void );
+
+  /** Set/Get the monitor of the registration that is running in this
+   * process; 0 if there is none. */
+  static void SetActiveMonitor( Self * monitor ) { s_ActiveMonitor = monitor; }
+  static Self * GetActiveMonitor( void ) { return s_ActiveMonitor; }
+
+  /** Returns true if the active monitor requests to cancel. This is cheap,
+   * so it can be polled often. */
+  static bool IsActiveCancelRequested( void )
+  {
+    Self * monitor = s_ActiveMonitor;
+    return monitor != 0 && monitor->m_CancelRequested;
+  }
+
+
+  /** Makes a monitor the active monitor during its lifetime. */
+  class ActiveMonitorScope
+  {
+public:
+
+    ActiveMonitorScope( Self * monitor ) { RegistrationMonitor::SetActiveMonitor( monitor ); }
+    ~ActiveMonitorScope() { RegistrationMonitor::SetActiveMonitor( 0 ); }
+
+  };
+
+protected:
+
+  RegistrationMonitor();
+  virtual ~RegistrationMonitor() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  RegistrationMonitor( const Self & ); // purposely not implemented
+  void operator=( const Self & );      // purposely not implemented
+
+  static Self * volatile s_ActiveMonitor;
+
+  mutable SimpleMutexLock    m_Mutex;
+  ConditionVariable::Pointer m_FinishedCondition;
+  ProgressType               m_Progress;
+  std::vector< double >      m_MetricValues;
+  volatile bool              m_CancelRequested;
+  bool                       m_Finished;
+  int                        m_ReturnValue;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkRegistrationMonitor_h
@@ -0,0 +1,212 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkTraceEventRecorder.h"
+
+#include "itkRealTimeClock.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+
+#include <fstream>
+#include <set>
+#include <vector>
+
+namespace itk
+{
+
+/** A recorded event. */
+struct TraceEvent
+{
+  std::string  m_Name;
+  const char * m_Category;
+  double       m_Start;
+  double       m_Duration;
+  unsigned int m_Thread;
+};
+
+/** Variables of the process-wide recorder. */
+bool TraceEventRecorder::s_Enabled = false;
+
+static std::vector< TraceEvent > GlobalTraceEvents;
+static RealTimeClock::Pointer    GlobalTraceClock;
+static double                    GlobalTraceOrigin = 0.0;
+static SimpleFastMutexLock       GlobalTraceMutex;
+
+/**
+ * ****************** Enable *********************************
+ */
+
+void
+TraceEventRecorder::Enable( void )
+{
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalTraceMutex );
+  if( GlobalTraceClock.IsNull() )
+  {
+    GlobalTraceClock  = RealTimeClock::New();
+    GlobalTraceOrigin = GlobalTraceClock->GetTimeInSeconds();
+  }
+  s_Enabled = true;
+
+} // end Enable()
+
+
+/**
+ * ****************** Disable *********************************
+ */
+
+void
+TraceEventRecorder::Disable( void )
+{
+  s_Enabled = false;
+
+} // end Disable()
+
+
+/**
+ * ****************** GetTimeStamp *********************************
+ */
+
+double
+TraceEventRecorder::GetTimeStamp( void )
+{
+  if( GlobalTraceClock.IsNull() )
+  {
+    return 0.0;
+  }
+  return ( GlobalTraceClock->GetTimeInSeconds() - GlobalTraceOrigin ) * 1.0e6;
+
+} // end GetTimeStamp()
+
+
+/**
+ * ****************** AddCompleteEvent *********************************
+ */
+
+void
+TraceEventRecorder::AddCompleteEvent( const std::string & name, const char * category,
+  const double start, const double duration, const unsigned int thread )
+{
+  TraceEvent event;
+  event.m_Name     = name;
+  event.m_Category = category;
+  event.m_Start    = start;
+  event.m_Duration = duration;
+  event.m_Thread   = thread;
+
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalTraceMutex );
+  GlobalTraceEvents.push_back( event );
+
+} // end AddCompleteEvent()
+
+
+/**
+ * ****************** Clear *********************************
+ */
+
+void
+TraceEventRecorder::Clear( void )
+{
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalTraceMutex );
+  GlobalTraceEvents.clear();
+
+} // end Clear()
+
+
+/**
+ * ****************** WriteJSONString *********************************
+ */
+
+static void
+WriteJSONString( std::ostream & os, const char * s )
+{
+  os << '"';
+  for( ; *s != '\0'; ++s )
+  {
+    if( *s == '"' || *s == '\\' )
+    {
+      os << '\\';
+    }
+    os << *s;
+  }
+  os << '"';
+
+} // end WriteJSONString()
+
+
+/**
+ * ****************** WriteToFile *********************************
+ */
+
+bool
+TraceEventRecorder::WriteToFile( const std::string & fileName )
+{
+  std::ofstream file( fileName.c_str() );
+  if( !file.is_open() )
+  {
+    return false;
+  }
+
+  MutexLockHolder< SimpleFastMutexLock > lock( GlobalTraceMutex );
+
+  file << std::fixed;
+  file.precision( 3 );
+  file << "{\"traceEvents\":[\n";
+
+  /** Name the threads that occur. */
+  std::set< unsigned int > threads;
+  for( std::size_t i = 0; i < GlobalTraceEvents.size(); ++i )
+  {
+    threads.insert( GlobalTraceEvents[ i ].m_Thread );
+  }
+  bool first = true;
+  for( std::set< unsigned int >::const_iterator it = threads.begin(); it != threads.end(); ++it )
+  {
+    file << ( first ? "" : ",\n" )
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << *it
+         << ",\"args\":{\"name\":\"";
+    if( *it == 0 )
+    {
+      file << "main";
+    }
+    else
+    {
+      file << "worker " << *it - 1;
+    }
+    file << "\"}}";
+    first = false;
+  }
+
+  for( std::size_t i = 0; i < GlobalTraceEvents.size(); ++i )
+  {
+    const TraceEvent & event = GlobalTraceEvents[ i ];
+    file << ( first ? "" : ",\n" ) << "{\"name\":";
+    WriteJSONString( file, event.m_Name.c_str() );
+    file << ",\"cat\":";
+    WriteJSONString( file, event.m_Category );
+    file << ",\"ph\":\"X\",\"ts\":" << event.m_Start
+         << ",\"dur\":" << event.m_Duration
+         << ",\"pid\":1,\"tid\":" << event.m_Thread << "}";
+    first = false;
+  }
+
+  file << "\n]}\n";
+  return !file.fail();
+
+} // end WriteToFile()
+
+
+} // end namespace itk
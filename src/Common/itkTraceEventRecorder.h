@@ -0,0 +1,146 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTraceEventRecorder_h
+#define __itkTraceEventRecorder_h
+
+#include <string>
+
+namespace itk
+{
+
+/** \class TraceEventRecorder
+ *
+ * \brief Records a timeline of events, to be viewed as a Chrome trace.
+ *
+ * When enabled, code regions that are marked with a TraceEventScope are
+ * recorded as "complete" events, with their start time, duration and
+ * thread. WriteToFile() writes them in the Chrome trace event JSON format,
+ * which can be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * The thread of an event is a logical one: 0 for the main thread, and
+ * threadID + 1 for the workers of a multi-threaded callback. This shows
+ * the load balance between the threads of a single launch.
+ *
+ * Recording is off by default, in which case a TraceEventScope costs a
+ * single test of a static flag. The recorder is process-wide and can be
+ * used from multiple threads. elastix and transformix enable it with the
+ * -trace command line argument.
+ *
+ * \ingroup ITKCommon
+ */
+
+class TraceEventRecorder
+{
+public:
+
+  /** Start recording. The time stamps are relative to the first call. */
+  static void Enable( void );
+
+  /** Stop recording. The recorded events are kept. */
+  static void Disable( void );
+
+  static bool IsEnabled( void ) { return s_Enabled; }
+
+  /** The current time stamp, in microseconds. */
+  static double GetTimeStamp( void );
+
+  /** Record an event that started at the given time stamp and that took
+   * duration microseconds. */
+  static void AddCompleteEvent( const std::string & name, const char * category,
+    const double start, const double duration, const unsigned int thread = 0 );
+
+  /** Write the recorded events as Chrome trace JSON. Returns false when the
+   * file cannot be written. */
+  static bool WriteToFile( const std::string & fileName );
+
+  /** Remove all recorded events. */
+  static void Clear( void );
+
+private:
+
+  static bool s_Enabled;
+
+};
+
+/** \class TraceEventScope
+ *
+ * \brief Records the lifetime of this object as an event of the TraceEventRecorder.
+ *
+ * \code
+ * {
+ *   TraceEventScope scope( "GenerateData", "pyramid" );
+ *   // ... the region to be recorded
+ * }
+ * \endcode
+ *
+ * The category must be a string literal, or otherwise outlive the scope.
+ *
+ * \ingroup ITKCommon
+ */
+
+class TraceEventScope
+{
+public:
+
+  TraceEventScope( const char * name, const char * category, const unsigned int thread = 0 ) :
+    m_Category( category ), m_Thread( thread ), m_Start( -1.0 )
+  {
+    if( TraceEventRecorder::IsEnabled() )
+    {
+      this->m_Name  = name;
+      this->m_Start = TraceEventRecorder::GetTimeStamp();
+    }
+  }
+
+
+  TraceEventScope( const std::string & name, const char * category, const unsigned int thread = 0 ) :
+    m_Category( category ), m_Thread( thread ), m_Start( -1.0 )
+  {
+    if( TraceEventRecorder::IsEnabled() )
+    {
+      this->m_Name  = name;
+      this->m_Start = TraceEventRecorder::GetTimeStamp();
+    }
+  }
+
+
+  ~TraceEventScope()
+  {
+    if( this->m_Start >= 0.0 )
+    {
+      TraceEventRecorder::AddCompleteEvent( this->m_Name, this->m_Category, this->m_Start,
+        TraceEventRecorder::GetTimeStamp() - this->m_Start, this->m_Thread );
+    }
+  }
+
+
+private:
+
+  TraceEventScope( const TraceEventScope & ); // purposely not implemented
+  void operator=( const TraceEventScope & );  // purposely not implemented
+
+  std::string  m_Name;
+  const char * m_Category;
+  unsigned int m_Thread;
+  double       m_Start;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTraceEventRecorder_h
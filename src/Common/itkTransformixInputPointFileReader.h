@@ -20,6 +20,7 @@
 #define __itkTransformixInputPointFileReader_h
 
 #include "itkMeshFileReaderBase.h"
+#include "itkMemoryMappedFile.h"
 
 #include <fstream>
 
@@ -40,6 +41,17 @@ namespace itk
  *
  * The second word in the text file represents the number of points that
  * should be read.
+ *
+ * The file is memory mapped and parsed in a single pass, so that files with
+ * millions of points load quickly.
+ *
+ * Alternatively, the points may be given in a binary file, which is
+ * recognized by its first eight bytes "ELXPOINT". These are followed by a
+ * header of little endian integers: the dimension (uint32), whether the
+ * points are indices (uint32, 0 or 1) and the number of points (uint64).
+ * The header is followed by the coordinates as little endian float32,
+ * point after point. The same format is used by transformix to write
+ * outputpoints.bin, see the WriteOutputPointsAsBinary parameter.
  **/
 
 template< class TOutputMesh >
@@ -82,6 +94,14 @@ public:
    */
   itkGetConstMacro( NumberOfPoints, unsigned long );
 
+  /** Get whether the file is in the binary point format. */
+  itkGetConstMacro( IsBinary, bool );
+
+  /** The first bytes of a binary point file, and the size of its header. */
+  static const char * GetBinaryFileMagic( void ) { return "ELXPOINT"; }
+  itkStaticConstMacro( BinaryFileMagicSize, unsigned int, 8 );
+  itkStaticConstMacro( BinaryFileHeaderSize, unsigned int, 24 );
+
   /** Prepare the allocation of the output mesh during the first back
    * propagation of the pipeline. Updates the PointsAreIndices and NumberOfPoints.
    */
@@ -95,10 +115,22 @@ protected:
   /** Fill the point container of the output. */
   virtual void GenerateData( void );
 
+  /** Read the next whitespace separated word of the text file, starting at
+   * m_Position, and advance m_Position past it. Returns false at the end of
+   * the file. The word is truncated to the size of the buffer.
+   */
+  bool ReadWord( char * buffer, const unsigned int bufferSize );
+
+  /** Throw an exception with the file name appended. */
+  void ThrowReadError( const std::string & message ) const;
+
   unsigned long m_NumberOfPoints;
   bool          m_PointsAreIndices;
+  bool          m_IsBinary;
 
-  std::ifstream m_Reader;
+  /** The mapped file, and the position of the data that is not read yet. */
+  MemoryMappedFile::Pointer m_MappedFile;
+  SizeValueType             m_Position;
 
 private:
 
@@ -20,6 +20,12 @@
 #define __itkTransformixInputPointFileReader_hxx
 
 #include "itkTransformixInputPointFileReader.h"
+#include "itkByteSwapper.h"
+#include "itkIntTypes.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 namespace itk
 {
@@ -34,6 +40,8 @@ TransformixInputPointFileReader< TOutputMesh >
 {
   this->m_NumberOfPoints   = 0;
   this->m_PointsAreIndices = false;
+  this->m_IsBinary         = false;
+  this->m_Position         = 0;
 } // end constructor
 
 
@@ -44,12 +52,7 @@ TransformixInputPointFileReader< TOutputMesh >
 template< class TOutputMesh >
 TransformixInputPointFileReader< TOutputMesh >
 ::~TransformixInputPointFileReader()
-{
-  if( this->m_Reader.is_open() )
-  {
-    this->m_Reader.close();
-  }
-} // end constructor
+{} // end destructor
 
 
 /**
@@ -63,39 +66,86 @@ TransformixInputPointFileReader< TOutputMesh >
 {
   this->Superclass::GenerateOutputInformation();
 
-  /** The superclass tests already if it's a valid file; so just open it and
-  * assume it goes alright */
-  if( this->m_Reader.is_open() )
+  /** The superclass tests already if it's a valid file; so just map it. */
+  this->m_MappedFile = MemoryMappedFile::New();
+  this->m_MappedFile->Map( this->m_FileName );
+  this->m_Position = 0;
+
+  const char *        data = static_cast< const char * >( this->m_MappedFile->GetData() );
+  const SizeValueType size = this->m_MappedFile->GetSize();
+
+  /** Check for the binary format. */
+  this->m_IsBinary = size >= BinaryFileMagicSize
+    && std::memcmp( data, GetBinaryFileMagic(), BinaryFileMagicSize ) == 0;
+  if( this->m_IsBinary )
   {
-    this->m_Reader.close();
+    if( size < BinaryFileHeaderSize )
+    {
+      this->ThrowReadError( "The header of the binary point file is incomplete." );
+    }
+
+    /** The header fields are little endian. */
+    itk::uint32_t dimension        = 0;
+    itk::uint32_t pointsAreIndices = 0;
+    itk::uint64_t numberOfPoints   = 0;
+    std::memcpy( &dimension, data + 8, 4 );
+    std::memcpy( &pointsAreIndices, data + 12, 4 );
+    std::memcpy( &numberOfPoints, data + 16, 8 );
+    ByteSwapper< itk::uint32_t >::SwapFromSystemToLittleEndian( &dimension );
+    ByteSwapper< itk::uint32_t >::SwapFromSystemToLittleEndian( &pointsAreIndices );
+    ByteSwapper< itk::uint64_t >::SwapFromSystemToLittleEndian( &numberOfPoints );
+
+    if( dimension != OutputMeshType::PointDimension )
+    {
+      std::ostringstream msg;
+      msg << "The binary point file has dimension " << dimension
+          << ", but points of dimension " << OutputMeshType::PointDimension
+          << " are expected.";
+      this->ThrowReadError( msg.str() );
+    }
+
+    this->m_PointsAreIndices = ( pointsAreIndices != 0 );
+    this->m_NumberOfPoints   = static_cast< unsigned long >( numberOfPoints );
+    this->m_Position         = BinaryFileHeaderSize;
+    return;
   }
-  this->m_Reader.open( this->m_FileName.c_str() );
 
   /** Read the first entry */
-  std::string indexOrPoint;
-  this->m_Reader >> indexOrPoint;
+  char indexOrPoint[ 64 ];
+  if( !this->ReadWord( indexOrPoint, sizeof( indexOrPoint ) ) )
+  {
+    indexOrPoint[ 0 ] = '\0';
+  }
 
   /** Set the IsIndex bool and the number of points.*/
-  if( indexOrPoint == "point" )
+  char numberOfPoints[ 64 ];
+  if( std::strcmp( indexOrPoint, "point" ) == 0 )
   {
     /** Input points are specified in world coordinates. */
     this->m_PointsAreIndices = false;
-    this->m_Reader >> this->m_NumberOfPoints;
+    if( !this->ReadWord( numberOfPoints, sizeof( numberOfPoints ) ) )
+    {
+      numberOfPoints[ 0 ] = '\0';
+    }
   }
-  else if( indexOrPoint == "index" )
+  else if( std::strcmp( indexOrPoint, "index" ) == 0 )
   {
     /** Input points are specified as image indices. */
     this->m_PointsAreIndices = true;
-    this->m_Reader >> this->m_NumberOfPoints;
+    if( !this->ReadWord( numberOfPoints, sizeof( numberOfPoints ) ) )
+    {
+      numberOfPoints[ 0 ] = '\0';
+    }
   }
   else
   {
     /** Input points are assumed to be specified as image indices. */
     this->m_PointsAreIndices = true;
-    this->m_NumberOfPoints   = atoi( indexOrPoint.c_str() );
+    std::strcpy( numberOfPoints, indexOrPoint );
   }
+  this->m_NumberOfPoints = std::strtoul( numberOfPoints, 0, 10 );
 
-  /** Leave the file open for the generate data method */
+  /** Keep the file mapped for the generate data method */
 
 } // end GenerateOutputInformation()
 
@@ -117,50 +167,69 @@ TransformixInputPointFileReader< TOutputMesh >
   OutputMeshPointer      output = this->GetOutput();
   PointsContainerPointer points = PointsContainerType::New();
 
+  if( this->m_MappedFile.IsNull() )
+  {
+    this->ThrowReadError( "The file has unexpectedly been closed." );
+  }
+
   /** Read the file */
-  if( this->m_Reader.is_open() )
+  const unsigned long numberOfPoints = this->m_NumberOfPoints;
+  if( this->m_IsBinary )
   {
-    for( unsigned int i = 0; i < this->m_NumberOfPoints; ++i )
+    /** Check the size before allocating, so that a corrupt header
+     * does not lead to a huge allocation.
+     */
+    const SizeValueType available = this->m_MappedFile->GetSize() - this->m_Position;
+    if( numberOfPoints > available / ( dimension * sizeof( float ) ) )
     {
-      // read point from textfile
-      PointType point;
+      this->ThrowReadError( "The file is not large enough." );
+    }
+
+    points->Reserve( numberOfPoints );
+    const char * data = static_cast< const char * >( this->m_MappedFile->GetData() )
+      + this->m_Position;
+    float coordinates[ dimension ];
+    for( unsigned long i = 0; i < numberOfPoints; ++i )
+    {
+      /** The data of the mapped file need not be aligned. */
+      std::memcpy( coordinates, data, sizeof( coordinates ) );
+      data += sizeof( coordinates );
+      ByteSwapper< float >::SwapRangeFromSystemToLittleEndian( coordinates, dimension );
+
+      PointType & point = points->ElementAt( i );
       for( unsigned int j = 0; j < dimension; j++ )
       {
-        if( !this->m_Reader.eof() )
-        {
-          this->m_Reader >> point[ j ];
-        }
-        else
-        {
-          std::ostringstream msg;
-          msg << "The file is not large enough. "
-              << std::endl << "Filename: " << this->m_FileName
-              << std::endl;
-          MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
-          throw e;
-          return;
-        }
+        point[ j ] = coordinates[ j ];
       }
-      points->push_back( point );
     }
   }
   else
   {
-    std::ostringstream msg;
-    msg << "The file has unexpectedly been closed. "
-        << std::endl << "Filename: " << this->m_FileName
-        << std::endl;
-    MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
-    throw e;
-    return;
+    points->Reserve( numberOfPoints );
+    char word[ 64 ];
+    for( unsigned long i = 0; i < numberOfPoints; ++i )
+    {
+      // read point from textfile
+      PointType & point = points->ElementAt( i );
+      for( unsigned int j = 0; j < dimension; j++ )
+      {
+        if( !this->ReadWord( word, sizeof( word ) ) )
+        {
+          points->Initialize();
+          this->ThrowReadError( "The file is not large enough." );
+        }
+        point[ j ] = std::strtod( word, 0 );
+      }
+    }
   }
 
   /** set in output */
   output->Initialize();
   output->SetPoints( points );
 
-  /** Close the reader */
-  this->m_Reader.close();
+  /** Release the file */
+  this->m_MappedFile = 0;
+  this->m_Position   = 0;
 
   /** This indicates that the current BufferedRegion is equal to the
    * requested region. This action prevents useless re-executions of
@@ -171,6 +240,67 @@ TransformixInputPointFileReader< TOutputMesh >
 } // end GenerateData()
 
 
+/**
+ * *************** ReadWord ***********
+ */
+
+template< class TOutputMesh >
+bool
+TransformixInputPointFileReader< TOutputMesh >
+::ReadWord( char * buffer, const unsigned int bufferSize )
+{
+  /** The mapped file is not null terminated, so the word is copied to the
+   * buffer before it is converted.
+   */
+  const char *        data = static_cast< const char * >( this->m_MappedFile->GetData() );
+  const SizeValueType size = this->m_MappedFile->GetSize();
+  SizeValueType       pos  = this->m_Position;
+
+  while( pos < size && std::isspace( static_cast< unsigned char >( data[ pos ] ) ) )
+  {
+    ++pos;
+  }
+  if( pos == size )
+  {
+    this->m_Position = pos;
+    return false;
+  }
+
+  unsigned int length = 0;
+  while( pos < size && !std::isspace( static_cast< unsigned char >( data[ pos ] ) ) )
+  {
+    if( length + 1 < bufferSize )
+    {
+      buffer[ length++ ] = data[ pos ];
+    }
+    ++pos;
+  }
+  buffer[ length ] = '\0';
+  this->m_Position = pos;
+  return true;
+
+} // end ReadWord()
+
+
+/**
+ * *************** ThrowReadError ***********
+ */
+
+template< class TOutputMesh >
+void
+TransformixInputPointFileReader< TOutputMesh >
+::ThrowReadError( const std::string & message ) const
+{
+  std::ostringstream msg;
+  msg << message
+      << std::endl << "Filename: " << this->m_FileName
+      << std::endl;
+  MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
+  throw e;
+
+} // end ThrowReadError()
+
+
 } // end namespace itk
 
 #endif
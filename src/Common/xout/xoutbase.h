@@ -117,6 +117,15 @@ public:
 
   virtual void WriteBufferedData( void );
 
+  /** In quiet mode all input is ignored: operator<< and WriteBufferedData()
+   * do nothing, and operator[] returns this object itself, without searching
+   * the target cells. This makes channels without outputs, like the
+   * iteration table of a run that neither logs nor prints, practically free.
+   * False by default.
+   */
+  void SetQuiet( bool _arg ) { this->m_Quiet = _arg; }
+  bool GetQuiet( void ) const { return this->m_Quiet; }
+
   /**
    * Methods to Add and Remove target cells. They return 0 when successful.
    */
@@ -165,12 +174,19 @@ protected:
    * False by default. */
   bool m_Call;
 
+  /** Whether all input is ignored, see SetQuiet(). */
+  bool m_Quiet;
+
   /** Called each time << is used, but only when m_Call == true; */
   virtual void Callback( void ){}
 
   template< class T >
   Self & SendToTargets( const T & _arg )
   {
+    if( m_Quiet )
+    {
+      return *this;
+    }
     Send< T >::ToTargets( const_cast< T & >( _arg ), m_CTargetCells, m_XTargetCells );
     /** Call the callback method. */
     if( m_Call )
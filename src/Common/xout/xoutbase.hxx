@@ -31,7 +31,8 @@ using namespace std;
 template< class charT, class traits >
 xoutbase< charT, traits >::xoutbase()
 {
-  this->m_Call = false;
+  this->m_Call  = false;
+  this->m_Quiet = false;
 
 }   // end Constructor
 
@@ -73,6 +74,11 @@ template< class charT, class traits >
 void
 xoutbase< charT, traits >::WriteBufferedData( void )
 {
+  if( this->m_Quiet )
+  {
+    return;
+  }
+
   /** Update the target c-streams. */
   for( CStreamMapIteratorType cit = this->m_CTargetCells.begin();
     cit != this->m_CTargetCells.end(); ++cit )
@@ -307,6 +313,11 @@ template< class charT, class traits >
 xoutbase< charT, traits > &
 xoutbase< charT, traits >::SelectXCell( const char * name )
 {
+  if( this->m_Quiet )
+  {
+    return *this;
+  }
+
   if( this->m_XTargetCells.count( name ) )
   {
     return *( this->m_XTargetCells[ name ] );
@@ -0,0 +1,122 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __xoutbuffer_h
+#define __xoutbuffer_h
+
+#include <streambuf>
+#include <vector>
+#include <ctime>
+
+namespace xoutlibrary
+{
+using namespace std;
+
+/**
+ * \class xoutbuffer
+ * \brief A stream buffer that batches the flushes of another stream buffer.
+ *
+ * The xout classes flush their outputs after every cell and every row of
+ * the iteration table. For a log file on a network file system every flush
+ * is a round trip. The xoutbuffer collects the output in its own buffer and
+ * passes it on to the target stream buffer, but it only flushes the target
+ * when at least FlushSize characters were written since the previous flush,
+ * or when at least FlushInterval seconds have passed. Use it through an
+ * std::ostream:
+ *
+ * \code
+ * std::ofstream logFile( "elastix.log" );
+ * xl::xoutbuffer< char > logBuffer( logFile.rdbuf() );
+ * std::ostream log( &logBuffer );
+ * xout.AddOutput( "log", &log );
+ * \endcode
+ *
+ * The remaining data is flushed by Flush() and by the destructor, so the
+ * target must outlive the xoutbuffer.
+ *
+ * \ingroup xout
+ */
+
+template< class charT, class traits = char_traits< charT > >
+class xoutbuffer : public basic_streambuf< charT, traits >
+{
+public:
+
+  /** Typedef's. */
+  typedef xoutbuffer                       Self;
+  typedef basic_streambuf< charT, traits > Superclass;
+  typedef Superclass                       streambuf_type;
+  typedef charT                            char_type;
+  typedef traits                           traits_type;
+  typedef typename traits::int_type        int_type;
+
+  /** Constructor. The target may also be set later with SetTarget(). */
+  xoutbuffer( streambuf_type * target = 0, size_t bufferSize = 65536 );
+
+  /** Destructor, flushes the remaining data. */
+  virtual ~xoutbuffer();
+
+  /** Set/Get the stream buffer to which the data is passed on. */
+  void SetTarget( streambuf_type * target );
+
+  streambuf_type * GetTarget( void ) const { return this->m_Target; }
+
+  /** Set/Get the number of characters after which the target is flushed.
+   * Default: 65536. */
+  void SetFlushSize( size_t size ) { this->m_FlushSize = size; }
+  size_t GetFlushSize( void ) const { return this->m_FlushSize; }
+
+  /** Set/Get the number of seconds after which the target is flushed.
+   * Default: 1. Set it to 0 to flush the target at every flush of the
+   * stream, like an unbuffered stream. */
+  void SetFlushInterval( double seconds ) { this->m_FlushInterval = seconds; }
+  double GetFlushInterval( void ) const { return this->m_FlushInterval; }
+
+  /** Pass all data on to the target and flush it. Returns 0 when successful. */
+  int Flush( void );
+
+protected:
+
+  /** Called when the buffer is full. */
+  virtual int_type overflow( int_type c );
+
+  /** Called by the flush of the stream. Passes the data on to the target,
+   * but only flushes the target according to FlushSize and FlushInterval. */
+  virtual int sync( void );
+
+  /** Pass the data in the buffer on to the target. Returns false on error. */
+  bool WriteToTarget( void );
+
+  streambuf_type *    m_Target;
+  vector< char_type > m_Buffer;
+  size_t              m_FlushSize;
+  double              m_FlushInterval;
+  size_t              m_UnflushedSize;
+  time_t              m_LastFlushTime;
+
+private:
+
+  xoutbuffer( const Self & );        // purposely not implemented
+  void operator=( const Self & );    // purposely not implemented
+
+};
+
+} // end namespace xoutlibrary
+
+#include "xoutbuffer.hxx"
+
+#endif // end #ifndef __xoutbuffer_h
@@ -0,0 +1,169 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __xoutbuffer_hxx
+#define __xoutbuffer_hxx
+
+#include "xoutbuffer.h"
+
+namespace xoutlibrary
+{
+using namespace std;
+
+/**
+ * ************************ Constructor *************************
+ */
+
+template< class charT, class traits >
+xoutbuffer< charT, traits >::xoutbuffer( streambuf_type * target, size_t bufferSize ) :
+  m_Target( target ),
+  m_Buffer( bufferSize > 0 ? bufferSize : 1 ),
+  m_FlushSize( 65536 ),
+  m_FlushInterval( 1.0 ),
+  m_UnflushedSize( 0 ),
+  m_LastFlushTime( time( 0 ) )
+{
+  this->setp( &( this->m_Buffer[ 0 ] ), &( this->m_Buffer[ 0 ] ) + this->m_Buffer.size() );
+
+}   // end Constructor
+
+
+/**
+ * ********************* Destructor *****************************
+ */
+
+template< class charT, class traits >
+xoutbuffer< charT, traits >::~xoutbuffer()
+{
+  this->Flush();
+
+}   // end Destructor
+
+
+/**
+ * ************************ SetTarget ***************************
+ */
+
+template< class charT, class traits >
+void
+xoutbuffer< charT, traits >::SetTarget( streambuf_type * target )
+{
+  /** Data that was meant for the previous target goes there. */
+  this->Flush();
+  this->m_Target = target;
+
+}   // end SetTarget
+
+
+/**
+ * ************************ WriteToTarget ***********************
+ */
+
+template< class charT, class traits >
+bool
+xoutbuffer< charT, traits >::WriteToTarget( void )
+{
+  const streamsize n = this->pptr() - this->pbase();
+  if( n == 0 )
+  {
+    return true;
+  }
+
+  /** Without a target the data is discarded, like for a closed file. */
+  bool ok = true;
+  if( this->m_Target )
+  {
+    ok = ( this->m_Target->sputn( this->pbase(), n ) == n );
+  }
+
+  this->m_UnflushedSize += static_cast< size_t >( n );
+  this->pbump( static_cast< int >( -n ) );
+  return ok;
+
+}   // end WriteToTarget
+
+
+/**
+ * ************************ Flush *******************************
+ */
+
+template< class charT, class traits >
+int
+xoutbuffer< charT, traits >::Flush( void )
+{
+  int returndummy = this->WriteToTarget() ? 0 : 1;
+  if( this->m_Target && this->m_Target->pubsync() != 0 )
+  {
+    returndummy = 1;
+  }
+
+  this->m_UnflushedSize = 0;
+  this->m_LastFlushTime = time( 0 );
+  return returndummy;
+
+}   // end Flush
+
+
+/**
+ * ************************ overflow ****************************
+ */
+
+template< class charT, class traits >
+typename xoutbuffer< charT, traits >::int_type
+xoutbuffer< charT, traits >::overflow( int_type c )
+{
+  if( !this->WriteToTarget() )
+  {
+    return traits_type::eof();
+  }
+
+  if( !traits_type::eq_int_type( c, traits_type::eof() ) )
+  {
+    *( this->pptr() ) = traits_type::to_char_type( c );
+    this->pbump( 1 );
+  }
+  return traits_type::not_eof( c );
+
+}   // end overflow
+
+
+/**
+ * ************************ sync ********************************
+ */
+
+template< class charT, class traits >
+int
+xoutbuffer< charT, traits >::sync( void )
+{
+  if( !this->WriteToTarget() )
+  {
+    return -1;
+  }
+
+  if( this->m_UnflushedSize >= this->m_FlushSize
+    || difftime( time( 0 ), this->m_LastFlushTime ) >= this->m_FlushInterval )
+  {
+    return this->Flush() == 0 ? 0 : -1;
+  }
+  return 0;
+
+}   // end sync
+
+
+} // end namespace xoutlibrary
+
+#endif // end #ifndef __xoutbuffer_hxx
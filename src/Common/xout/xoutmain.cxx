@@ -20,21 +20,59 @@
 
 #include "xoutmain.h"
 
+/** Thread-local storage of a pointer, without depending on C++11. */
+#if defined( _MSC_VER )
+#define xout_thread_local __declspec( thread )
+#else
+#define xout_thread_local __thread
+#endif
+
 namespace xoutlibrary
 {
-static xoutbase_type * local_xout = 0;
+
+/** The xout of the calling thread, see set_xout(). Threads that did not
+ * set one, like the worker threads of a run, use the default xout, see
+ * set_default_xout(). Until a default is set, that is an xout without
+ * outputs, which discards everything. It is never destroyed, so that it
+ * can be used during static destruction.
+ */
+static xout_thread_local xoutbase_type * local_thread_xout = 0;
+static xoutbase_type &                   local_null_xout    = *new xoutbase_type;
+static xoutbase_type *                   local_default_xout = &local_null_xout;
 
 xoutbase_type &
 get_xout( void )
 {
-  return *local_xout;
+  xoutbase_type * threadXout = local_thread_xout;
+  return threadXout != 0 ? *threadXout : *local_default_xout;
 }
 
 
 void
 set_xout( xoutbase_type * arg )
 {
-  local_xout = arg;
+  local_thread_xout = arg;
+}
+
+
+void
+set_default_xout( xoutbase_type * arg )
+{
+  local_default_xout = arg != 0 ? arg : &local_null_xout;
+}
+
+
+void
+unset_xout( xoutbase_type * arg )
+{
+  if( local_thread_xout == arg )
+  {
+    local_thread_xout = 0;
+  }
+  if( local_default_xout == arg )
+  {
+    local_default_xout = &local_null_xout;
+  }
 }
 
 
@@ -23,6 +23,7 @@
 #include "xoutsimple.h"
 #include "xoutrow.h"
 #include "xoutcell.h"
+#include "xoutbuffer.h"
 
 /** Define a namespace alias. */
 namespace xl = xoutlibrary;
@@ -36,11 +37,30 @@ typedef xoutbase< char >   xoutbase_type;
 typedef xoutsimple< char > xoutsimple_type;
 typedef xoutrow< char >    xoutrow_type;
 typedef xoutcell< char >   xoutcell_type;
+typedef xoutbuffer< char > xoutbuffer_type;
 
+/** Returns the xout of the calling thread. A thread that did not set its
+ * own xout, like a worker thread of a filter, gets the default xout, see
+ * set_default_xout(). The lookup uses thread-local storage and no lock.
+ */
 xoutbase_type & get_xout( void );
 
+/** Set the xout of the calling thread. This allows concurrent runs in
+ * different threads of one process to log to their own outputs.
+ */
 void set_xout( xoutbase_type * arg );
 
+/** Set the xout of all threads that did not set their own, typically the
+ * xout of the program. With 0, or when no default was set, these threads
+ * get an xout without outputs, which discards everything.
+ */
+void set_default_xout( xoutbase_type * arg );
+
+/** Remove arg as the xout of the calling thread, and as the default xout.
+ * Call this before arg is destroyed, from the thread that set it.
+ */
+void unset_xout( xoutbase_type * arg );
+
 } // end namespace xoutlibrary
 
 #endif // end #ifndef __xoutmain_h
@@ -66,6 +66,11 @@ void
 xoutrow< charT, traits >
 ::WriteBufferedData( void )
 {
+  if( this->m_Quiet )
+  {
+    return;
+  }
+
   /** Write the cell-data to the outputs, separated by tabs. */
   XStreamMapIteratorType xit   = this->m_XTargetCells.begin();
   XStreamMapIteratorType tmpIt = xit;
@@ -314,6 +319,11 @@ void
 xoutrow< charT, traits >
 ::WriteHeaders( void )
 {
+  if( this->m_Quiet )
+  {
+    return;
+  }
+
   /** Copy '*this'. */
   Self headerwriter;
   headerwriter.SetTargetCells( this->m_XTargetCells );
@@ -344,6 +354,11 @@ xoutbase< charT, traits > &
 xoutrow< charT, traits >
 ::SelectXCell( const char * name )
 {
+  if( this->m_Quiet )
+  {
+    return *this;
+  }
+
   std::string cellname( name );
 
   /** Check if the name is "WriteHeaders". Then the method
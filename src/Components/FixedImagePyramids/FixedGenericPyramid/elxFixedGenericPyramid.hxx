@@ -153,6 +153,14 @@ FixedGenericPyramid< TElastix >
     "ComputePyramidImagesPerResolution", 0, false );
   this->SetComputeOnlyForCurrentLevel( computeThisResolution );
 
+  /** When computing per resolution, optionally compute the images of the
+   * next resolution in the background, while the current one is running.
+   */
+  bool computeInBackground = false;
+  this->m_Configuration->ReadParameter( computeInBackground,
+    "ComputePyramidImagesInBackground", 0, false );
+  this->SetComputeNextLevelInBackground( computeInBackground );
+
 } // end SetFixedSchedule()
 
 
@@ -177,6 +185,24 @@ FixedGenericPyramid< TElastix >
 } // end BeforeEachResolution()
 
 
+/**
+ * ******************* AfterEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+FixedGenericPyramid< TElastix >
+::AfterEachResolution( void )
+{
+  /** The pyramid components are called after the metrics, so the images
+   * of this level are no longer needed. When the pyramid is computed per
+   * resolution, release them to reduce the memory footprint.
+   */
+  this->ReleaseOutputOfCurrentLevel();
+
+} // end AfterEachResolution()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxFixedGenericPyramid_hxx
@@ -0,0 +1,103 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLFixedShrinkingPyramid_h
+#define __elxOpenCLFixedShrinkingPyramid_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxFixedShrinkingPyramid.h"
+#include "elxOpenCLImagePyramidBase.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLFixedShrinkingPyramid
+ * \brief The FixedShrinkingPyramid, computed with OpenCL.
+ *
+ * The shrinking of all levels runs on the GPU.
+ * Without OpenCL, for 2D images, or when the GPU fails, the FixedShrinkingPyramid is
+ * computed on the CPU.
+ *
+ * The parameters used in this class are:
+ * \parameter FixedImagePyramid: Select this pyramid as follows:\n
+ *    <tt>(FixedImagePyramid "OpenCLFixedShrinkingImagePyramid")</tt>
+ * \parameter OpenCLFixedShrinkingImagePyramidUseOpenCL: Enable the OpenCL pyramid as follows:\n
+ *    <tt>(OpenCLFixedShrinkingImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa FixedShrinkingPyramid, OpenCLImagePyramidBase
+ * \ingroup ImagePyramids
+ */
+
+template< class TElastix >
+class OpenCLFixedShrinkingPyramid :
+  public OpenCLImagePyramidBase<
+  FixedShrinkingPyramid< TElastix >,
+  itk::MultiResolutionShrinkPyramidImageFilter<
+  itk::GPUImage< typename FixedShrinkingPyramid< TElastix >::InputImageType::PixelType,
+  FixedShrinkingPyramid< TElastix >::ImageDimension >,
+  itk::GPUImage< typename FixedShrinkingPyramid< TElastix >::OutputImageType::PixelType,
+  FixedShrinkingPyramid< TElastix >::ImageDimension > > >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLFixedShrinkingPyramid Self;
+  typedef OpenCLImagePyramidBase<
+    FixedShrinkingPyramid< TElastix >,
+    itk::MultiResolutionShrinkPyramidImageFilter<
+    itk::GPUImage< typename FixedShrinkingPyramid< TElastix >::InputImageType::PixelType,
+    FixedShrinkingPyramid< TElastix >::ImageDimension >,
+    itk::GPUImage< typename FixedShrinkingPyramid< TElastix >::OutputImageType::PixelType,
+    FixedShrinkingPyramid< TElastix >::ImageDimension > > > Superclass;
+  typedef typename Superclass::Superclass1 Superclass1;
+  typedef typename Superclass::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >        Pointer;
+  typedef itk::SmartPointer< const Self >  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLFixedShrinkingPyramid, OpenCLImagePyramidBase );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific pyramid. \n
+   * example: <tt>(FixedImagePyramid "OpenCLFixedShrinkingImagePyramid")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLFixedShrinkingImagePyramid" );
+
+protected:
+
+  /** The constructor. */
+  OpenCLFixedShrinkingPyramid() {}
+  /** The destructor. */
+  virtual ~OpenCLFixedShrinkingPyramid() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLFixedShrinkingPyramid( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLFixedShrinkingPyramid_h
@@ -0,0 +1,103 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLFixedSmoothingPyramid_h
+#define __elxOpenCLFixedSmoothingPyramid_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxFixedSmoothingPyramid.h"
+#include "elxOpenCLImagePyramidBase.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLFixedSmoothingPyramid
+ * \brief The FixedSmoothingPyramid, computed with OpenCL.
+ *
+ * The Gaussian smoothing of all levels runs on the GPU.
+ * Without OpenCL, for 2D images, or when the GPU fails, the FixedSmoothingPyramid is
+ * computed on the CPU.
+ *
+ * The parameters used in this class are:
+ * \parameter FixedImagePyramid: Select this pyramid as follows:\n
+ *    <tt>(FixedImagePyramid "OpenCLFixedSmoothingImagePyramid")</tt>
+ * \parameter OpenCLFixedSmoothingImagePyramidUseOpenCL: Enable the OpenCL pyramid as follows:\n
+ *    <tt>(OpenCLFixedSmoothingImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa FixedSmoothingPyramid, OpenCLImagePyramidBase
+ * \ingroup ImagePyramids
+ */
+
+template< class TElastix >
+class OpenCLFixedSmoothingPyramid :
+  public OpenCLImagePyramidBase<
+  FixedSmoothingPyramid< TElastix >,
+  itk::MultiResolutionGaussianSmoothingPyramidImageFilter<
+  itk::GPUImage< typename FixedSmoothingPyramid< TElastix >::InputImageType::PixelType,
+  FixedSmoothingPyramid< TElastix >::ImageDimension >,
+  itk::GPUImage< typename FixedSmoothingPyramid< TElastix >::OutputImageType::PixelType,
+  FixedSmoothingPyramid< TElastix >::ImageDimension > > >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLFixedSmoothingPyramid Self;
+  typedef OpenCLImagePyramidBase<
+    FixedSmoothingPyramid< TElastix >,
+    itk::MultiResolutionGaussianSmoothingPyramidImageFilter<
+    itk::GPUImage< typename FixedSmoothingPyramid< TElastix >::InputImageType::PixelType,
+    FixedSmoothingPyramid< TElastix >::ImageDimension >,
+    itk::GPUImage< typename FixedSmoothingPyramid< TElastix >::OutputImageType::PixelType,
+    FixedSmoothingPyramid< TElastix >::ImageDimension > > > Superclass;
+  typedef typename Superclass::Superclass1 Superclass1;
+  typedef typename Superclass::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >        Pointer;
+  typedef itk::SmartPointer< const Self >  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLFixedSmoothingPyramid, OpenCLImagePyramidBase );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific pyramid. \n
+   * example: <tt>(FixedImagePyramid "OpenCLFixedSmoothingImagePyramid")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLFixedSmoothingImagePyramid" );
+
+protected:
+
+  /** The constructor. */
+  OpenCLFixedSmoothingPyramid() {}
+  /** The destructor. */
+  virtual ~OpenCLFixedSmoothingPyramid() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLFixedSmoothingPyramid( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLFixedSmoothingPyramid_h
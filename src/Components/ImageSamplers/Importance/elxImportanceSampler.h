@@ -0,0 +1,148 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxImportanceSampler_h
+#define __elxImportanceSampler_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "itkImageImportanceSampler.h"
+
+namespace elastix
+{
+
+/**
+ * \class ImportanceSampler
+ * \brief An image sampler based on the itk::ImageImportanceSampler.
+ *
+ * This image sampler randomly samples 'NumberOfSamples' voxels in
+ * the InputImageRegion, inside the mask if one is given, with a probability
+ * that increases with the gradient magnitude of the fixed image. Voxels in
+ * homogeneous regions, which contribute little to the metric derivative,
+ * are thus selected less often, so that fewer samples may be needed. The
+ * metric corrects for the sampling probability with a weight per sample.
+ * Only metrics that support these weights, like the AdvancedMeanSquares
+ * metric, can be used with this sampler.
+ *
+ * The probability map is computed once per resolution.
+ *
+ * This sampler is suitable to used in combination with the
+ * NewSamplesEveryIteration parameter (defined in the elx::OptimizerBase).
+ *
+ * The parameters used in this class are:
+ * \parameter ImageSampler: Select this image sampler as follows:\n
+ *    <tt>(ImageSampler "Importance")</tt>
+ * \parameter NumberOfSpatialSamples: The number of image voxels used for computing the
+ *    metric value and its derivative in each iteration. Must be given for each resolution.\n
+ *    example: <tt>(NumberOfSpatialSamples 2048 2048 4000)</tt> \n
+ *    The default is 5000.
+ * \parameter UniformFraction: The fraction of the sampling probability that is spread
+ *    uniformly over the voxels, in [0, 1]. Larger values give more samples in homogeneous
+ *    regions and less variable weights; with 1 all voxels are equally likely.
+ *    Can be given for each resolution.\n
+ *    example: <tt>(UniformFraction 0.1 0.2)</tt> \n
+ *    The default is 0.1.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TElastix >
+class ImportanceSampler :
+  public
+  itk::ImageImportanceSampler<
+  typename elx::ImageSamplerBase< TElastix >::InputImageType >,
+  public
+  elx::ImageSamplerBase< TElastix >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImportanceSampler Self;
+  typedef itk::ImageImportanceSampler<
+    typename elx::ImageSamplerBase< TElastix >::InputImageType >
+    Superclass1;
+  typedef elx::ImageSamplerBase< TElastix > Superclass2;
+  typedef itk::SmartPointer< Self >         Pointer;
+  typedef itk::SmartPointer< const Self >   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImportanceSampler, itk::ImageImportanceSampler );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific interpolator. \n
+   * example: <tt>(ImageSampler "Importance")</tt>\n
+   */
+  elxClassNameMacro( "Importance" );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass1::DataObjectPointer            DataObjectPointer;
+  typedef typename Superclass1::OutputVectorContainerType    OutputVectorContainerType;
+  typedef typename Superclass1::OutputVectorContainerPointer OutputVectorContainerPointer;
+  typedef typename Superclass1::InputImageType               InputImageType;
+  typedef typename Superclass1::InputImagePointer            InputImagePointer;
+  typedef typename Superclass1::InputImageConstPointer       InputImageConstPointer;
+  typedef typename Superclass1::InputImageRegionType         InputImageRegionType;
+  typedef typename Superclass1::InputImagePixelType          InputImagePixelType;
+  typedef typename Superclass1::ImageSampleType              ImageSampleType;
+  typedef typename Superclass1::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass1::MaskType                     MaskType;
+  typedef typename Superclass1::InputImageIndexType          InputImageIndexType;
+  typedef typename Superclass1::InputImagePointType          InputImagePointType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int, Superclass1::InputImageDimension );
+
+  /** Typedefs inherited from Elastix. */
+  typedef typename Superclass2::ElastixType          ElastixType;
+  typedef typename Superclass2::ElastixPointer       ElastixPointer;
+  typedef typename Superclass2::ConfigurationType    ConfigurationType;
+  typedef typename Superclass2::ConfigurationPointer ConfigurationPointer;
+  typedef typename Superclass2::RegistrationType     RegistrationType;
+  typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
+  typedef typename Superclass2::ITKBaseType          ITKBaseType;
+
+  /** Execute stuff before each resolution:
+   * \li Set the number of samples.
+   * \li Set the uniform fraction.
+   */
+  virtual void BeforeEachResolution( void );
+
+protected:
+
+  /** The constructor. */
+  ImportanceSampler() {}
+  /** The destructor. */
+  virtual ~ImportanceSampler() {}
+
+private:
+
+  /** The private constructor. */
+  ImportanceSampler( const Self & );  // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );       // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxImportanceSampler.hxx"
+#endif
+
+#endif // end #ifndef __elxImportanceSampler_h
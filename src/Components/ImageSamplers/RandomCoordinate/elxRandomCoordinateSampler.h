@@ -70,6 +70,13 @@ namespace elastix
  *    With this option you can specify the order of interpolation.\n
  *    example: <tt>(FixedImageBSplineInterpolationOrder 0 0 1)</tt>\n
  *    Default value: 1. The parameter can be specified for each resolution.
+ * \parameter UseLowDiscrepancySampling: Take the coordinates from a Halton sequence,
+ *    which is randomly shifted for every new sample set, instead of drawing them
+ *    independently. The samples then cover the image more evenly, so that often fewer
+ *    samples give the same accuracy of the gradient. Can be combined with a mask and
+ *    with NewSamplesEveryIteration.\n
+ *    example: <tt>(UseLowDiscrepancySampling "true")</tt>\n
+ *    Default: false. The parameter can be specified for each resolution.
  *
  * \ingroup ImageSamplers
  */
@@ -68,6 +68,12 @@ RandomCoordinateSampler< TElastix >
     "UseRandomSampleRegion", this->GetComponentLabel(), level, 0 );
   this->SetUseRandomSampleRegion( useRandomSampleRegion );
 
+  /** Set the UseLowDiscrepancySampling bool. */
+  bool useLowDiscrepancySampling = false;
+  this->GetConfiguration()->ReadParameter( useLowDiscrepancySampling,
+    "UseLowDiscrepancySampling", this->GetComponentLabel(), level, 0 );
+  this->SetUseLowDiscrepancySampling( useLowDiscrepancySampling );
+
   /** Set the SampleRegionSize. */
   if( useRandomSampleRegion )
   {
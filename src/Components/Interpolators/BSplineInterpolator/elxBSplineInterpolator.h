@@ -20,6 +20,12 @@
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
 #include "itkBSplineInterpolateImageFunction.h"
+#include "itkBSplineCoefficientImageProvider.h"
+
+#ifdef ELASTIX_USE_OPENCL
+#include "itkGPUImage.h"
+#include "itkGPUBSplineDecompositionImageFilter.h"
+#endif
 
 namespace elastix
 {
@@ -43,6 +49,24 @@ namespace elastix
  *    The default order is 1. The parameter can be specified for each resolution.\n
  *    If only given for one resolution, that value is used for the other resolutions as well.
  *
+ * \parameter BSplineInterpolatorUseOpenCL: when elastix is compiled with OpenCL
+ *    and an OpenCL context is available, compute the B-spline coefficients of
+ *    the moving image on the GPU. The coefficients are downloaded afterwards,
+ *    so the interpolation itself still runs on the CPU. The GPU computes the
+ *    coefficients in single precision, so the results differ slightly from
+ *    those of the CPU. \n
+ *    example: <tt>(BSplineInterpolatorUseOpenCL "true")</tt> \n
+ *    The default is "false". Only used for 1D, 2D and 3D images and orders 2 and higher.
+ *    If the GPU decomposition fails, the CPU decomposition is used.
+ *
+ * With the command line argument -artifactcache, the coefficients of orders 2
+ * and higher are stored in that directory, and later runs on the same image
+ * map them instead of computing them.
+ *
+ * For orders 2 to 5 the metric can precompute the moving image gradient,
+ * see the CacheMovingImageGradient parameter of the metrics.
+ * For orders 1 to 5 the metrics evaluate the interpolation themselves, from
+ * padded coefficients, see the UseRecursiveBSplineInterpolation parameter.
  * \ingroup Interpolators
  */
 
@@ -54,7 +78,10 @@ class BSplineInterpolator :
   typename InterpolatorBase< TElastix >::CoordRepType,
   double >,        //CoefficientType
   public
-  InterpolatorBase< TElastix >
+  InterpolatorBase< TElastix >,
+  public
+  itk::BSplineCoefficientImageProvider< itk::Image< double,
+  InterpolatorBase< TElastix >::InputImageType::ImageDimension > >
 {
 public:
 
@@ -110,13 +137,64 @@ public:
    */
   virtual void BeforeEachResolution( void );
 
+  /** The B-spline coefficients take one CoefficientDataType per pixel. */
+  virtual itk::SizeValueType GetMemoryUsage( const itk::SizeValueType numberOfPixels ) const
+  {
+    return numberOfPixels * sizeof( CoefficientDataType );
+  }
+
+#ifdef ELASTIX_USE_OPENCL
+  /** Execute stuff before the actual registration:
+   * \li Read whether the coefficients should be computed with OpenCL.
+   */
+  virtual void BeforeRegistration( void );
+
+#endif
+
+  /** Get the B-spline coefficients of the current input image, so that the
+   * metrics use them for their padded copy instead of computing them again.
+   */
+  virtual const CoefficientImageType * GetBSplineCoefficientImage( void ) const
+  {
+    return this->m_Coefficients.GetPointer();
+  }
+
+  /** Set the input image and compute the B-spline coefficients.
+   * Overridden to take the coefficients from the artifact cache, see the
+   * command line argument -artifactcache, or to compute them with OpenCL,
+   * when possible. Falls back to the CPU implementation of the superclass
+   * otherwise, and then stores the coefficients in the artifact cache.
+   */
+  virtual void SetInputImage( const InputImageType * inputData );
+
 protected:
 
   /** The constructor. */
-  BSplineInterpolator() {}
+  BSplineInterpolator();
   /** The destructor. */
   virtual ~BSplineInterpolator() {}
 
+#ifdef ELASTIX_USE_OPENCL
+  /** GPU typedefs. */
+  typedef typename InputImageType::PixelType InputImagePixelType;
+  typedef itk::GPUImage< InputImagePixelType,
+    itkGetStaticConstMacro( ImageDimension ) >           GPUInputImageType;
+  typedef itk::GPUImage< CoefficientDataType,
+    itkGetStaticConstMacro( ImageDimension ) >           GPUCoefficientImageType;
+  typedef itk::GPUBSplineDecompositionImageFilter<
+    GPUInputImageType, GPUCoefficientImageType >         GPUCoefficientFilterType;
+  typedef typename GPUCoefficientFilterType::Pointer GPUCoefficientFilterPointer;
+
+  /** Compute the coefficients of the input image with OpenCL.
+   * Returns false if that was not possible, in which case the
+   * coefficients are left untouched.
+   */
+  bool GenerateCoefficientsUsingOpenCL( const InputImageType * inputData );
+
+  GPUCoefficientFilterPointer m_GPUCoefficientFilter;
+  bool                        m_UseOpenCL;
+#endif
+
 private:
 
   /** The private constructor. */
@@ -20,10 +20,31 @@
 #define __elxBSplineInterpolator_hxx
 
 #include "elxBSplineInterpolator.h"
+#include "itkTraceEventRecorder.h"
+#include "itkImageFileCache.h"
+
+#ifdef ELASTIX_USE_OPENCL
+#include "itkOpenCLContext.h"
+#include "itkOpenCLLogger.h"
+#endif
 
 namespace elastix
 {
 
+/**
+ * ***************** Constructor ***********************
+ */
+
+template< class TElastix >
+BSplineInterpolator< TElastix >
+::BSplineInterpolator()
+{
+#ifdef ELASTIX_USE_OPENCL
+  this->m_UseOpenCL = false;
+#endif
+} // end Constructor()
+
+
 /**
  * ***************** BeforeEachResolution ***********************
  */
@@ -57,6 +78,190 @@ BSplineInterpolator< TElastix >
 
 } // end BeforeEachResolution()
 
+#ifdef ELASTIX_USE_OPENCL
+
+/**
+ * ***************** BeforeRegistration ***********************
+ */
+
+template< class TElastix >
+void
+BSplineInterpolator< TElastix >
+::BeforeRegistration( void )
+{
+  this->m_UseOpenCL = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseOpenCL,
+    "BSplineInterpolatorUseOpenCL", this->GetComponentLabel(), 0, 0 );
+
+} // end BeforeRegistration()
+
+
+#endif
+
+/**
+ * ***************** SetInputImage ***********************
+ */
+
+template< class TElastix >
+void
+BSplineInterpolator< TElastix >
+::SetInputImage( const InputImageType * inputData )
+{
+  typedef itk::ImageFileCache< CoefficientImageType > CoefficientFileCacheType;
+
+  /** Records the computation of the coefficients. */
+  itk::TraceEventScope traceScope( "BSplineInterpolator::SetInputImage", "bspline" );
+
+  /** Take the coefficients from the artifact cache, if possible. For order
+   * 0 and 1 the coefficients are a plain copy of the image.
+   */
+  std::string cacheDirectory;
+  std::string cacheKey;
+  if( this->GetConfiguration() )
+  {
+    cacheDirectory = this->GetConfiguration()->GetCommandLineArgument( "-artifactcache" );
+  }
+  if( inputData && !cacheDirectory.empty() && this->GetSplineOrder() > 1 )
+  {
+    cacheKey = CoefficientFileCacheType::CreateContentKey( inputData,
+      CoefficientFileCacheType::GetBSplineCoefficientsDescription( this->GetSplineOrder() ) );
+    typename CoefficientImageType::Pointer coefficients
+      = CoefficientFileCacheType::LoadWithKey( cacheDirectory, cacheKey );
+    if( coefficients.IsNotNull() )
+    {
+      /** Do what Superclass1::SetInputImage() does, except for the
+       * computation of the coefficients.
+       */
+      Superclass1::Superclass::SetInputImage( inputData );
+      this->m_Coefficients = coefficients;
+      this->m_DataLength   = inputData->GetBufferedRegion().GetSize();
+      return;
+    }
+  }
+
+#ifdef ELASTIX_USE_OPENCL
+  /** The coefficients of the GPU are not stored in the artifact cache, so
+   * that it holds the coefficients of the CPU only.
+   */
+  if( inputData && this->GenerateCoefficientsUsingOpenCL( inputData ) )
+  {
+    /** Do what Superclass1::SetInputImage() does, except for the
+     * computation of the coefficients, which has been done on the GPU.
+     */
+    Superclass1::Superclass::SetInputImage( inputData );
+    this->m_DataLength = inputData->GetBufferedRegion().GetSize();
+    return;
+  }
+#endif
+
+  Superclass1::SetInputImage( inputData );
+
+  /** A failure only costs a later run the time to compute them. */
+  if( !cacheKey.empty() && !CoefficientFileCacheType::Contains( cacheDirectory, cacheKey ) )
+  {
+    CoefficientFileCacheType::StoreWithKey( cacheDirectory, cacheKey,
+      this->m_Coefficients.GetPointer() );
+  }
+
+} // end SetInputImage()
+
+
+#ifdef ELASTIX_USE_OPENCL
+
+
+/**
+ * ***************** GenerateCoefficientsUsingOpenCL ***********************
+ */
+
+template< class TElastix >
+bool
+BSplineInterpolator< TElastix >
+::GenerateCoefficientsUsingOpenCL( const InputImageType * inputData )
+{
+  /** The GPU decomposition supports 1D, 2D and 3D images only. For order
+   * 0 and 1 the coefficients are a plain copy of the image, so the GPU
+   * does not help.
+   */
+  if( !this->m_UseOpenCL || ImageDimension > 3 || this->GetSplineOrder() < 2 )
+  {
+    return false;
+  }
+
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  if( !context->IsCreated() )
+  {
+    return false;
+  }
+
+  bool computedUsingOpenCL = true;
+  try
+  {
+    /** Create the filter only once; its constructor builds the kernel. */
+    if( this->m_GPUCoefficientFilter.IsNull() )
+    {
+      this->m_GPUCoefficientFilter = GPUCoefficientFilterType::New();
+    }
+
+    /** Upload the input image. */
+    typename GPUInputImageType::Pointer gpuInputImage = GPUInputImageType::New();
+    gpuInputImage->GraftITKImage( inputData );
+    gpuInputImage->AllocateGPU();
+    gpuInputImage->GetGPUDataManager()->SetCPUBufferLock( true );
+    gpuInputImage->GetGPUDataManager()->SetGPUDirtyFlag( true );
+    gpuInputImage->GetGPUDataManager()->UpdateGPUBuffer();
+
+    this->m_GPUCoefficientFilter->SetSplineOrder( this->GetSplineOrder() );
+    this->m_GPUCoefficientFilter->SetInput( gpuInputImage );
+    this->m_GPUCoefficientFilter->Update();
+
+    /** Download the coefficients once, and hand them to the CPU
+     * interpolator as a plain image, so that the evaluation does not
+     * go through the GPU data manager for every pixel access.
+     */
+    typename GPUCoefficientImageType::Pointer gpuCoefficients
+      = this->m_GPUCoefficientFilter->GetOutput();
+    gpuCoefficients->UpdateCPUBuffer();
+
+    typename CoefficientImageType::Pointer coefficients = CoefficientImageType::New();
+    coefficients->Graft( gpuCoefficients );
+    this->m_Coefficients = coefficients;
+
+    /** Disconnect, so that the next resolution does not reuse the output. */
+    this->m_GPUCoefficientFilter->SetInput( NULL );
+    gpuCoefficients->DisconnectPipeline();
+  }
+  catch( itk::OpenCLCompileError & e )
+  {
+    itk::OpenCLLogger::Pointer logger = itk::OpenCLLogger::GetInstance();
+    logger->Write( itk::LoggerBase::CRITICAL, e.GetDescription() );
+
+    elx::xout[ "error" ] << "ERROR: OpenCL program has not been compiled"
+                         << " during the B-spline decomposition." << std::endl
+                         << "  Please check the '" << logger->GetLogFileName()
+                         << "' in output directory." << std::endl;
+    computedUsingOpenCL = false;
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    elx::xout[ "error" ] << "ERROR: Exception during the GPU B-spline decomposition: "
+                         << e << std::endl;
+    computedUsingOpenCL = false;
+  }
+
+  if( !computedUsingOpenCL )
+  {
+    elx::xout[ "warning" ] << "WARNING: The B-spline decomposition with OpenCL failed.\n"
+                           << "  The BSplineInterpolator is switching back to CPU mode." << std::endl;
+    this->m_GPUCoefficientFilter = NULL;
+    this->m_UseOpenCL = false;
+  }
+
+  return computedUsingOpenCL;
+
+} // end GenerateCoefficientsUsingOpenCL()
+
+#endif // end #ifdef ELASTIX_USE_OPENCL
+
 
 } // end namespace elastix
 
@@ -20,6 +20,7 @@
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
 #include "itkBSplineInterpolateImageFunction.h"
+#include "itkBSplineCoefficientImageProvider.h"
 
 namespace elastix
 {
@@ -43,6 +44,15 @@ namespace elastix
  *    The default order is 1. The parameter can be specified for each resolution.\n
  *    If only given for one resolution, that value is used for the other resolutions as well.
  *
+ * For orders 2 to 5 the metric can precompute the moving image gradient,
+ * see the CacheMovingImageGradient parameter of the metrics.
+ * For orders 1 to 5 the metrics evaluate the interpolation themselves, from
+ * padded coefficients, see the UseRecursiveBSplineInterpolation parameter.
+ *
+ * With the command line argument -artifactcache, the coefficients of orders 2
+ * and higher are stored in that directory, and later runs on the same image
+ * map them instead of computing them.
+ *
  * \ingroup Interpolators
  */
 
@@ -54,7 +64,10 @@ class BSplineInterpolatorFloat :
   typename InterpolatorBase< TElastix >::CoordRepType,
   float >,        //CoefficientType
   public
-  InterpolatorBase< TElastix >
+  InterpolatorBase< TElastix >,
+  public
+  itk::BSplineCoefficientImageProvider< itk::Image< float,
+  InterpolatorBase< TElastix >::InputImageType::ImageDimension > >
 {
 public:
 
@@ -110,6 +123,26 @@ public:
    */
   virtual void BeforeEachResolution( void );
 
+  /** The B-spline coefficients take one CoefficientDataType per pixel. */
+  virtual itk::SizeValueType GetMemoryUsage( const itk::SizeValueType numberOfPixels ) const
+  {
+    return numberOfPixels * sizeof( CoefficientDataType );
+  }
+
+  /** Get the B-spline coefficients of the current input image, so that the
+   * metrics use them for their padded copy instead of computing them again.
+   */
+  virtual const CoefficientImageType * GetBSplineCoefficientImage( void ) const
+  {
+    return this->m_Coefficients.GetPointer();
+  }
+
+  /** Set the input image and compute the B-spline coefficients.
+   * Overridden to take the coefficients from the artifact cache, see the
+   * command line argument -artifactcache, and to store them there.
+   */
+  virtual void SetInputImage( const InputImageType * inputData );
+
 protected:
 
   /** The constructor. */
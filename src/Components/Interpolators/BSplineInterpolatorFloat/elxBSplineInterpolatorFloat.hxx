@@ -20,6 +20,7 @@
 #define __elxBSplineInterpolatorFloat_hxx
 
 #include "elxBSplineInterpolatorFloat.h"
+#include "itkImageFileCache.h"
 
 namespace elastix
 {
@@ -57,6 +58,56 @@ BSplineInterpolatorFloat< TElastix >
 } // end BeforeEachResolution()
 
 
+/**
+ * ***************** SetInputImage ***********************
+ */
+
+template< class TElastix >
+void
+BSplineInterpolatorFloat< TElastix >
+::SetInputImage( const InputImageType * inputData )
+{
+  typedef itk::ImageFileCache< CoefficientImageType > CoefficientFileCacheType;
+
+  /** Take the coefficients from the artifact cache, if possible. For order
+   * 0 and 1 the coefficients are a plain copy of the image.
+   */
+  std::string cacheDirectory;
+  std::string cacheKey;
+  if( this->GetConfiguration() )
+  {
+    cacheDirectory = this->GetConfiguration()->GetCommandLineArgument( "-artifactcache" );
+  }
+  if( inputData && !cacheDirectory.empty() && this->GetSplineOrder() > 1 )
+  {
+    cacheKey = CoefficientFileCacheType::CreateContentKey( inputData,
+      CoefficientFileCacheType::GetBSplineCoefficientsDescription( this->GetSplineOrder() ) );
+    typename CoefficientImageType::Pointer coefficients
+      = CoefficientFileCacheType::LoadWithKey( cacheDirectory, cacheKey );
+    if( coefficients.IsNotNull() )
+    {
+      /** Do what Superclass1::SetInputImage() does, except for the
+       * computation of the coefficients.
+       */
+      Superclass1::Superclass::SetInputImage( inputData );
+      this->m_Coefficients = coefficients;
+      this->m_DataLength   = inputData->GetBufferedRegion().GetSize();
+      return;
+    }
+  }
+
+  Superclass1::SetInputImage( inputData );
+
+  /** A failure only costs a later run the time to compute them. */
+  if( !cacheKey.empty() && !CoefficientFileCacheType::Contains( cacheDirectory, cacheKey ) )
+  {
+    CoefficientFileCacheType::StoreWithKey( cacheDirectory, cacheKey,
+      this->m_Coefficients.GetPointer() );
+  }
+
+} // end SetInputImage()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxBSplineInterpolatorFloat_hxx
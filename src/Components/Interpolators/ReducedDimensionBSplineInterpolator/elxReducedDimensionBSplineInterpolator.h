@@ -108,6 +108,12 @@ public:
    */
   virtual void BeforeEachResolution( void );
 
+  /** The B-spline coefficients take one CoefficientDataType per pixel. */
+  virtual itk::SizeValueType GetMemoryUsage( const itk::SizeValueType numberOfPixels ) const
+  {
+    return numberOfPixels * sizeof( CoefficientDataType );
+  }
+
 protected:
 
   /** The constructor. */
@@ -47,6 +47,14 @@ namespace itk
  * (perfect foreground alignment).  When dealing with optimizers that can
  * only minimize a metric, use the ComplementOn() method.
  *
+ * For the derivative, every thread accumulates the image Jacobians of the
+ * samples in the fixed foreground and of those in the fixed background,
+ * interleaved in a single vector, so that every sample is added only once.
+ * When the transform has a compact support, only the touched blocks of
+ * these vectors are merged afterwards, like the sparse accumulation of
+ * AdvancedImageToImageMetric. And when the samples did not change since the
+ * previous iteration, as with full sampling, the fixed foreground is read
+ * from a bitset over the samples instead of being compared again.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
@@ -136,6 +144,11 @@ public:
   virtual void GetDerivative( const TransformParametersType & parameters,
     DerivativeType & derivative ) const;
 
+  /** Contains calls from GetValueAndDerivative that are thread-unsafe,
+   * such as updating the fixed foreground bitset. */
+  virtual void BeforeThreadedGetValueAndDerivative(
+    const TransformParametersType & parameters ) const;
+
   /** Get value and derivatives for multiple valued optimizers. */
   virtual void GetValueAndDerivativeSingleThreaded(
     const TransformParametersType & parameters,
@@ -193,19 +206,48 @@ protected:
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
 
+  /** Whether a fixed or moving image value is foreground. */
+  bool IsForeground( const RealType & value ) const
+  {
+    if( this->m_UseForegroundValue )
+    {
+      return vnl_math_abs( value - this->m_ForegroundValue ) < this->m_Epsilon;
+    }
+    return value > this->m_Epsilon;
+  }
+
+
+  /** Whether fixed sample i is foreground, from the bitset when it is
+   * up-to-date, and otherwise from its value. */
+  bool IsFixedForegroundSample( const unsigned long i, const RealType & fixedImageValue ) const
+  {
+    if( this->m_UseFixedForegroundBits )
+    {
+      return this->m_FixedForegroundBits[ i ];
+    }
+    return this->IsForeground( fixedImageValue );
+  }
+
+
+  /** Update the bitset of the fixed foreground samples. Like the Jacobian
+   * structure cache, it is only built when the samples did not change
+   * since the previous iteration. */
+  void UpdateFixedForegroundBits( void ) const;
+
   /** Compute a pixel's contribution to the measure and derivatives;
-   * Called by GetValueAndDerivative().
+   * Called by GetValueAndDerivative(). The sums are interleaved: the
+   * element 2 mu sums the image Jacobians of the fixed foreground samples,
+   * the element 2 mu + 1 those of the other samples.
    */
   void UpdateValueAndDerivativeTerms(
-    const RealType & fixedImageValue,
+    const bool fixedForeground,
     const RealType & movingImageValue,
     std::size_t & fixedForegroundArea,
     std::size_t & movingForegroundArea,
     std::size_t & intersection,
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
-    DerivativeType & sum1,
-    DerivativeType & sum2 ) const;
+    DerivativeType & sums ) const;
 
   /** Initialize some multi-threading related parameters.
    * Overrides function in AdvancedImageToImageMetric, because
@@ -233,6 +275,14 @@ private:
   RealType m_Epsilon;
   bool     m_Complement;
 
+  /** The fixed foreground bitset, see UpdateFixedForegroundBits(). */
+  mutable std::vector< bool > m_FixedForegroundBits;
+  mutable bool                m_UseFixedForegroundBits;
+  mutable ModifiedTimeType    m_FixedForegroundSamplesMTime;
+  mutable bool                m_FixedForegroundUseForegroundValue;
+  mutable RealType            m_FixedForegroundValue;
+  mutable RealType            m_FixedForegroundEpsilon;
+
   /** Threading related parameters. */
 
   /** Helper structs that multi-threads the computation of
@@ -249,11 +299,11 @@ private:
 
   struct KappaGetValueAndDerivativePerThreadStruct
   {
-    SizeValueType  st_NumberOfPixelsCounted;
-    SizeValueType  st_AreaSum;
-    SizeValueType  st_AreaIntersection;
-    DerivativeType st_DerivativeSum1;
-    DerivativeType st_DerivativeSum2;
+    SizeValueType                st_NumberOfPixelsCounted;
+    SizeValueType                st_AreaSum;
+    SizeValueType                st_AreaIntersection;
+    DerivativeType               st_DerivativeSums;
+    std::vector< unsigned char > st_TouchedDerivativeBlocks;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, KappaGetValueAndDerivativePerThreadStruct,
     PaddedKappaGetValueAndDerivativePerThreadStruct );
@@ -41,10 +41,22 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   this->m_Epsilon            = 1e-3;
   this->m_Complement         = true;
 
+  this->m_UseFixedForegroundBits            = false;
+  this->m_FixedForegroundSamplesMTime       = 0;
+  this->m_FixedForegroundUseForegroundValue = true;
+  this->m_FixedForegroundValue              = 0.0;
+  this->m_FixedForegroundEpsilon            = 0.0;
+
   // Multi-threading structs
   this->m_KappaGetValueAndDerivativePerThreadVariables     = NULL;
   this->m_KappaGetValueAndDerivativePerThreadVariablesSize = 0;
 
+  /** GetValueAndDerivative() only modifies members of this metric, and can
+   * read the transformed samples from a shared cache. */
+  this->m_SupportsConcurrentEvaluation           = true;
+  this->m_SupportsSharedTransformEvaluationCache = true;
+  this->m_SupportsSparseDerivativeAccumulation   = true;
+
 } // end Constructor
 
 
@@ -84,6 +96,15 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     this->m_KappaGetValueAndDerivativePerThreadVariablesSize = this->m_NumberOfThreads;
   }
 
+  /** Only merge the touched blocks of the derivative sums, when the
+   * transform has a compact support. */
+  const NumberOfParametersType numberOfParameters = this->GetNumberOfParameters();
+  this->m_UseSparseDerivativeAccumulation = this->m_SupportsSparseDerivativeAccumulation
+    && this->m_AdvancedTransform.IsNotNull()
+    && this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() < numberOfParameters;
+  const SizeValueType numberOfBlocks = this->m_UseSparseDerivativeAccumulation
+    ? ( ( numberOfParameters - 1 ) >> Superclass::DerivativeBlockSizeLog2 ) + 1 : 0;
+
   /** Some initialization. */
   const SizeValueType       zero1 = NumericTraits< SizeValueType >::Zero;
   const DerivativeValueType zero2 = NumericTraits< DerivativeValueType >::Zero;
@@ -92,10 +113,9 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = zero1;
     this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaSum               = zero1;
     this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaIntersection      = zero1;
-    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum1.SetSize( this->GetNumberOfParameters() );
-    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum2.SetSize( this->GetNumberOfParameters() );
-    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum1.Fill( zero2 );
-    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum2.Fill( zero2 );
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSums.SetSize( 2 * numberOfParameters );
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSums.Fill( zero2 );
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_TouchedDerivativeBlocks.assign( numberOfBlocks, 0 );
   }
 
 } // end InitializeThreadingParameters()
@@ -122,6 +142,77 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 } // end PrintSelf()
 
 
+/**
+ * ******************* BeforeThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
+::BeforeThreadedGetValueAndDerivative( const TransformParametersType & parameters ) const
+{
+  this->Superclass::BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** With UseMetricSingleThreaded off the preparations were already done. */
+  if( this->m_UseMetricSingleThreaded )
+  {
+    this->UpdateFixedForegroundBits();
+  }
+
+} // end BeforeThreadedGetValueAndDerivative()
+
+
+/**
+ * ******************* UpdateFixedForegroundBits *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateFixedForegroundBits( void ) const
+{
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const ModifiedTimeType      samplesMTime    = sampleContainer->GetMTime();
+  const unsigned long         numberOfSamples = sampleContainer->Size();
+
+  /** Check if the bitset is still valid for these samples and settings. */
+  const bool sameSettings
+    = this->m_FixedForegroundUseForegroundValue == this->m_UseForegroundValue
+    && this->m_FixedForegroundValue == this->m_ForegroundValue
+    && this->m_FixedForegroundEpsilon == this->m_Epsilon;
+  if( samplesMTime == this->m_FixedForegroundSamplesMTime && sameSettings
+    && this->m_FixedForegroundBits.size() == numberOfSamples )
+  {
+    this->m_UseFixedForegroundBits = true;
+    return;
+  }
+
+  /** Only build the bitset for samples that did not change since the
+   * previous iteration, so that no time is wasted for random samplers.
+   */
+  this->m_UseFixedForegroundBits = false;
+  this->m_FixedForegroundBits.clear();
+  if( samplesMTime != this->m_FixedForegroundSamplesMTime )
+  {
+    this->m_FixedForegroundSamplesMTime = samplesMTime;
+    return;
+  }
+
+  this->m_FixedForegroundUseForegroundValue = this->m_UseForegroundValue;
+  this->m_FixedForegroundValue              = this->m_ForegroundValue;
+  this->m_FixedForegroundEpsilon            = this->m_Epsilon;
+  this->m_FixedForegroundBits.resize( numberOfSamples );
+  typename ImageSampleContainerType::ConstIterator fiter = sampleContainer->Begin();
+  for( unsigned long i = 0; i < numberOfSamples; ++i, ++fiter )
+  {
+    this->m_FixedForegroundBits[ i ] = this->IsForeground(
+      static_cast< RealType >( ( *fiter ).Value().m_ImageValue ) );
+  }
+  this->m_UseFixedForegroundBits = true;
+
+} // end UpdateFixedForegroundBits()
+
+
 /**
  * ******************* GetValue *******************
  */
@@ -313,10 +404,8 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   std::size_t          movingForegroundArea = 0;
   std::size_t          intersection         = 0;
 
-  DerivativeType vecSum1( this->GetNumberOfParameters() );
-  DerivativeType vecSum2( this->GetNumberOfParameters() );
-  vecSum1.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  vecSum2.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  DerivativeType sums( 2 * this->GetNumberOfParameters() );
+  sums.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator fiter;
@@ -330,7 +419,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside moving mask. */
     if( sampleOk )
@@ -358,7 +447,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
         = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner products (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -366,10 +455,10 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 
       /** Compute this pixel's contribution to the measure and derivatives. */
       this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
+        this->IsFixedForegroundSample( fiter.Index(), fixedImageValue ),
+        movingImageValue,
         fixedForegroundArea, movingForegroundArea, intersection,
-        imageJacobian, nzji,
-        vecSum1, vecSum2 );
+        imageJacobian, nzji, sums );
 
     } // end if sampleOk
 
@@ -397,9 +486,14 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   const MeasureType tmp1               = areaSumFloat / areaSumFloatSquare;
   const MeasureType tmp2               = 2.0 * intersectionFloat / areaSumFloatSquare;
 
+  /** The derivative is tmp1 * 2 * sumFg - tmp2 * ( sumFg + sumBg ). */
   if( areaSum > 0 )
   {
-    derivative = tmp1 * vecSum1 - tmp2 * vecSum2;
+    const MeasureType coefficientFg = 2.0 * tmp1 - tmp2;
+    for( unsigned int mu = 0; mu < this->GetNumberOfParameters(); ++mu )
+    {
+      derivative[ mu ] = coefficientFg * sums[ 2 * mu ] - tmp2 * sums[ 2 * mu + 1 ];
+    }
   }
   else
   {
@@ -460,18 +554,21 @@ void
 AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  /** Get handles to the pre-allocated scratch buffers for dM(x)/dmu and the
+   * sparse Jacobian indices, sized in InitializePerThreadVariables(). */
+  typename Superclass::AlignedGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  NonZeroJacobianIndicesType & nzji          = perThread.st_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = perThread.st_ImageJacobian;
 
   /** Get handles to the pre-allocated derivatives for the current thread.
    * The initialization is performed at the beginning of each resolution in
    * InitializeThreadingParameters(), and at the end of each iteration in
    * AfterThreadedGetValueAndDerivative() and the accumulate functions.
    */
-  DerivativeType & vecSum1 = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeSum1;
-  DerivativeType & vecSum2 = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeSum2;
+  DerivativeType & sums = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeSums;
+  std::vector< unsigned char > & touched
+    = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks;
 
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
@@ -509,7 +606,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside moving mask. */
     if( sampleOk )
@@ -545,16 +642,25 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
       /** Compute this pixel's contribution to the measure and derivatives. */
       this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
+        this->IsFixedForegroundSample( fiter.Index(), fixedImageValue ),
+        movingImageValue,
         fixedForegroundArea, movingForegroundArea, intersection,
-        imageJacobian, nzji,
-        vecSum1, vecSum2 );
+        imageJacobian, nzji, sums );
+
+      /** Mark the touched blocks for the sparse accumulation. */
+      if( this->m_UseSparseDerivativeAccumulation )
+      {
+        for( unsigned int i = 0; i < nzji.size(); ++i )
+        {
+          touched[ nzji[ i ] >> Superclass::DerivativeBlockSizeLog2 ] = 1;
+        }
+      }
 
     } // end if sampleOk
 
@@ -609,42 +715,52 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaIntersection = zero;
   }
 
-  if( areaSum == 0 ) { return; }
+  /** Compute the final metric value, and some intermediate values to
+   * calculate the derivative. Without any foreground the derivative is zero,
+   * but the sums are still reset for the next iteration.
+   */
+  MeasureType tmp1 = zero;
+  MeasureType tmp2 = zero;
+  value = zero;
+  if( areaSum > 0 )
+  {
+    value = 1.0 - 2.0 * intersection / areaSum;
 
-  /** Compute the final metric value. */
-  value = 1.0 - 2.0 * intersection / areaSum;
+    MeasureType direction = -1.0;
+    if( !this->m_Complement ) { direction = 1.0; }
+    const MeasureType areaSumSquare = direction * areaSum * areaSum;
+    tmp1 = direction / areaSum;
+    tmp2 = 2.0 * intersection / areaSumSquare;
+  }
   if( !this->m_Complement ) { value = 1.0 - value; }
 
-  /** Some intermediate values to calculate the derivative. */
-  MeasureType direction = -1.0;
-  if( !this->m_Complement ) { direction = 1.0; }
-  const MeasureType areaSumSquare = direction * areaSum * areaSum;
-  const MeasureType tmp1          = direction / areaSum;
-  const MeasureType tmp2          = 2.0 * intersection / areaSumSquare;
+  /** The derivative is tmp1 * 2 * sumFg - tmp2 * ( sumFg + sumBg ). */
+  const MeasureType coefficientFg = 2.0 * tmp1 - tmp2;
+  const MeasureType coefficientBg = tmp2;
 
   /** Accumulate intermediate values and calculate derivative. */
   if( !this->m_UseMultiThread ) // single-threaded
   {
-    DerivativeType vecSum1 = this->m_KappaGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeSum1;
-    DerivativeType vecSum2 = this->m_KappaGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeSum2;
+    DerivativeType sums = this->m_KappaGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeSums;
     for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
     {
-      vecSum1 += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum1;
-      vecSum2 += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum2;
+      sums += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSums;
+    }
+    for( unsigned int mu = 0; mu < this->GetNumberOfParameters(); ++mu )
+    {
+      derivative[ mu ] = coefficientFg * sums[ 2 * mu ] - coefficientBg * sums[ 2 * mu + 1 ];
     }
-    derivative = tmp1 * vecSum1 - tmp2 * vecSum2;
   }
   else // multi-threaded
   {
     MultiThreaderAccumulateDerivativeType * temp = new MultiThreaderAccumulateDerivativeType;
 
     temp->st_Metric            = const_cast< Self * >( this );
-    temp->st_Coefficient1      = tmp1;
-    temp->st_Coefficient2      = tmp2;
+    temp->st_Coefficient1      = coefficientFg;
+    temp->st_Coefficient2      = coefficientBg;
     temp->st_DerivativePointer = derivative.begin();
 
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+    this->ExecuteThreaderCallback( AccumulateDerivativesThreaderCallback, temp );
 
     delete temp;
   }
@@ -668,29 +784,71 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   MultiThreaderAccumulateDerivativeType * temp
     = static_cast< MultiThreaderAccumulateDerivativeType * >( infoStruct->UserData );
 
-  const unsigned int numPar  = temp->st_Metric->GetNumberOfParameters();
-  const unsigned int subSize = static_cast< unsigned int >(
-    vcl_ceil( static_cast< double >( numPar ) / static_cast< double >( nrOfThreads ) ) );
+  /** The parameters are split between the threads at block boundaries,
+   * like in the AccumulateDerivativesThreaderCallback() of the superclass.
+   * With the sparse accumulation the blocks that a thread did not touch
+   * contain only zeros and are skipped.
+   */
+  Self *             metric    = temp->st_Metric;
+  const bool         sparse    = metric->m_UseSparseDerivativeAccumulation;
+  const unsigned int blockSize = sparse ? ( 1u << Superclass::DerivativeBlockSizeLog2 ) : 512; // 2 sums each
+  const unsigned int numPar    = metric->GetNumberOfParameters();
+  const unsigned int numBlocks = ( numPar + blockSize - 1 ) / blockSize;
+  const unsigned int subSize   = blockSize * static_cast< unsigned int >(
+    vcl_ceil( static_cast< double >( numBlocks ) / static_cast< double >( nrOfThreads ) ) );
   unsigned int jmin = threadId * subSize;
   unsigned int jmax = ( threadId + 1 ) * subSize;
+  jmin = ( jmin > numPar ) ? numPar : jmin;
   jmax = ( jmax > numPar ) ? numPar : jmax;
 
-  const DerivativeValueType zero = NumericTraits< DerivativeValueType >::Zero;
-  DerivativeValueType       sum1, sum2;
-  for( unsigned int j = jmin; j < jmax; j++ )
+  const DerivativeValueType zero          = NumericTraits< DerivativeValueType >::Zero;
+  const DerivativeValueType coefficientFg = temp->st_Coefficient1;
+  const DerivativeValueType coefficientBg = temp->st_Coefficient2;
+  DerivativeValueType *     derivative    = temp->st_DerivativePointer;
+  for( unsigned int jb = jmin; jb < jmax; jb += blockSize )
   {
-    sum1 = sum2 = zero;
+    const unsigned int je = ( jb + blockSize < jmax ) ? jb + blockSize : jmax;
+    for( unsigned int j = jb; j < je; ++j )
+    {
+      derivative[ j ] = zero;
+    }
+
+    /** Add the interleaved sums of one thread at a time. */
     for( ThreadIdType i = 0; i < nrOfThreads; ++i )
     {
-      sum1 += temp->st_Metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum1[ j ];
-      sum2 += temp->st_Metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum2[ j ];
+      if( sparse )
+      {
+        unsigned char & flag
+          = metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_TouchedDerivativeBlocks[ jb / blockSize ];
+        if( !flag )
+        {
+#ifndef NDEBUG
+          /** A thread that wrote to this block without marking it, i.e.
+           * without calling MarkTouchedDerivativeBlocks(), would silently
+           * lose its contributions here. */
+          const DerivativeValueType * untouched
+            = metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSums.data_block();
+          for( unsigned int j = 2 * jb; j < 2 * je; ++j )
+          {
+            itkAssertInDebugAndIgnoreInReleaseMacro( untouched[ j ] == zero );
+          }
+#endif
+          continue;
+        }
+        flag = 0;
+      }
+
+      DerivativeValueType * sums
+        = metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSums.data_block();
+      for( unsigned int j = jb; j < je; ++j )
+      {
+        derivative[ j ] += coefficientFg * sums[ 2 * j ] - coefficientBg * sums[ 2 * j + 1 ];
 
-      /** Reset these variables for the next iteration. */
-      temp->st_Metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum1[ j ] = zero;
-      temp->st_Metric->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeSum2[ j ] = zero;
+        /** Reset these variables for the next iteration. */
+        sums[ 2 * j ]     = zero;
+        sums[ 2 * j + 1 ] = zero;
+      }
     }
-    temp->st_DerivativePointer[ j ]
-      = temp->st_Coefficient1 * sum1 - temp->st_Coefficient2 * sum2;
   }
 
   return ITK_THREAD_RETURN_VALUE;
@@ -706,52 +864,33 @@ template< class TFixedImage, class TMovingImage >
 void
 AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::UpdateValueAndDerivativeTerms(
-  const RealType & fixedImageValue,
+  const bool fixedForeground,
   const RealType & movingImageValue,
   std::size_t & fixedForegroundArea,
   std::size_t & movingForegroundArea,
   std::size_t & intersection,
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
-  DerivativeType & sum1,
-  DerivativeType & sum2 ) const
+  DerivativeType & sums ) const
 {
   /** Update the intermediate values. */
-  bool usableFixedSample = false;
-  if( this->m_UseForegroundValue )
-  {
-    const RealType diffFixed  = vnl_math_abs( fixedImageValue - this->m_ForegroundValue );
-    const RealType diffMoving = vnl_math_abs( movingImageValue - this->m_ForegroundValue );
-    if( diffFixed < this->m_Epsilon ) { fixedForegroundArea++; usableFixedSample = true; }
-    if( diffMoving < this->m_Epsilon ) { movingForegroundArea++; }
-    if( diffFixed < this->m_Epsilon
-      && diffMoving < this->m_Epsilon ) { intersection++; }
-  }
-  else
-  {
-    if( fixedImageValue  > this->m_Epsilon ) { fixedForegroundArea++; usableFixedSample = true; }
-    if( movingImageValue > this->m_Epsilon ) { movingForegroundArea++; }
-    if( fixedImageValue  > this->m_Epsilon
-      && movingImageValue > this->m_Epsilon ) { intersection++; }
-  }
+  const bool movingForeground = this->IsForeground( movingImageValue );
+  if( fixedForeground ) { fixedForegroundArea++; }
+  if( movingForeground ) { movingForegroundArea++; }
+  if( fixedForeground && movingForeground ) { intersection++; }
 
-  /** Calculate the contributions to the derivatives with respect to each parameter. */
+  /** Calculate the contributions to the derivatives with respect to each
+   * parameter, in the foreground or the background elements of the sums.
+   */
+  DerivativeValueType * sumsPointer = sums.data_block() + ( fixedForeground ? 0 : 1 );
   if( nzji.size() == this->GetNumberOfParameters() )
   {
     /** Loop over all Jacobians. */
     typename DerivativeType::const_iterator imjacit = imageJacobian.begin();
-    typename DerivativeType::iterator sum1it        = sum1.begin();
-    typename DerivativeType::iterator sum2it        = sum2.begin();
     for( unsigned int mu = 0; mu < this->GetNumberOfParameters(); ++mu )
     {
-      if( usableFixedSample )
-      {
-        ( *sum1it ) += 2.0 * ( *imjacit );
-      }
-      ( *sum2it ) += ( *imjacit );
-
-      /** Increase iterators. */
-      ++imjacit; ++sum1it; ++sum2it;
+      sumsPointer[ 2 * mu ] += ( *imjacit );
+      ++imjacit;
     }
   }
   else
@@ -759,13 +898,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     /** Only pick the nonzero Jacobians. */
     for( unsigned int i = 0; i < nzji.size(); ++i )
     {
-      const unsigned int        index = nzji[ i ];
-      const DerivativeValueType imjac = imageJacobian[ i ];
-      if( usableFixedSample )
-      {
-        sum1[ index ] += 2.0 * imjac;
-      }
-      sum2[ index ] += imjac;
+      sumsPointer[ 2 * nzji[ i ] ] += imageJacobian[ i ];
     }
   }
 
@@ -91,6 +91,31 @@ namespace elastix
  *    B-spline grids.
  *    example: <tt>(UseFastAndLowMemoryVersion "false")</tt> \n
  *    The default is "true".
+ * \parameter UseFusedPDFAndDerivativePass: Only used by the fast and low memory
+ *    version. When "true", the image Jacobian of each sample is computed while
+ *    building the joint histogram and buffered, so that the derivative does not
+ *    need a second transformation and interpolation of all samples. This costs
+ *    number of samples * number of affected parameters doubles of memory, so it
+ *    is meant for random samplers. Not used with UseJacobianPreconditioning.
+ *    Can be given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(UseFusedPDFAndDerivativePass "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseFixedParzenWindowCache: When "true", the fixed image Parzen window
+ *    of every sample is computed once for every new set of samples, and reused in
+ *    the following iterations. This saves time with a grid or full sampler, or with
+ *    (NewSamplesEveryIteration "false"), and costs number of samples *
+ *    ( FixedKernelBSplineOrder + 1 ) doubles of memory.
+ *    Can be given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(UseFixedParzenWindowCache "false")</tt> \n
+ *    The default is "true".
+ * \parameter UseSparseJointPDFDerivatives: When "true", the joint histogram derivatives
+ *    are stored per thread in blocks of 32 parameters, and only the blocks that a
+ *    bin actually receives are allocated. With a B-spline transform of many parameters
+ *    this takes a fraction of the memory of the dense derivatives, and the histogram
+ *    derivatives are computed multi-threaded. Only used with (UseExplicitPDFDerivatives "true")
+ *    and (UseMultiThreadingForMetrics "true"). \n
+ *    example: <tt>(UseSparseJointPDFDerivatives "true")</tt> \n
+ *    The default is "false".
  *
  * \sa ParzenWindowMutualInformationImageToImageMetric
  * \ingroup Metrics
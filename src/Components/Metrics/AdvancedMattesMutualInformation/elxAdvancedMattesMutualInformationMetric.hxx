@@ -125,6 +125,24 @@ AdvancedMattesMutualInformationMetric< TElastix >
     "UseFastAndLowMemoryVersion", this->GetComponentLabel(), level, 0 );
   this->SetUseExplicitPDFDerivatives( !useFastAndLowMemoryVersion );
 
+  /** Set whether the PDF and derivative computation share one pass over the samples. */
+  bool useFusedPDFAndDerivativePass = false;
+  this->GetConfiguration()->ReadParameter( useFusedPDFAndDerivativePass,
+    "UseFusedPDFAndDerivativePass", this->GetComponentLabel(), level, 0 );
+  this->SetUseFusedPDFAndDerivativePass( useFusedPDFAndDerivativePass );
+
+  /** Set whether the fixed Parzen windows of the samples are cached. */
+  bool useFixedParzenWindowCache = true;
+  this->GetConfiguration()->ReadParameter( useFixedParzenWindowCache,
+    "UseFixedParzenWindowCache", this->GetComponentLabel(), level, 0 );
+  this->SetUseFixedParzenWindowCache( useFixedParzenWindowCache );
+
+  /** Set whether to store the pdf derivatives sparsely. */
+  bool useSparseJointPDFDerivatives = false;
+  this->GetConfiguration()->ReadParameter( useSparseJointPDFDerivatives,
+    "UseSparseJointPDFDerivatives", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparseJointPDFDerivatives( useSparseJointPDFDerivatives );
+
   /** Set whether to use Nick Tustison's preconditioning technique. */
   bool useJacobianPreconditioning = false;
   this->GetConfiguration()->ReadParameter( useJacobianPreconditioning,
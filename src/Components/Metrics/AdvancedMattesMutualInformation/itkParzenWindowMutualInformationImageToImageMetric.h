@@ -256,6 +256,18 @@ protected:
   /** Helper function to launch the threads. */
   void LaunchComputeDerivativeLowMemoryThreaderCallback( void ) const;
 
+  /** Helper array for storing the values of the JointPDF ratios. */
+  typedef double                PRatioType;
+  typedef Array2D< PRatioType > PRatioArrayType;
+  mutable PRatioArrayType m_PRatioArray;
+
+  /** Helper function to compute m_PRatioArray in case of low memory consumption.
+   * m_PRatioArray( i, k ) should contain -d value / d h( i, k ), where h is the
+   * unnormalized joint histogram. Subclasses can override this function to
+   * reuse the low memory derivative for another histogram based measure.
+   */
+  virtual void ComputeValueAndPRatioArray( double & MI ) const;
+
 private:
 
   /** The private constructor. */
@@ -263,11 +275,6 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                                  // purposely not implemented
 
-  /** Helper array for storing the values of the JointPDF ratios. */
-  typedef double                PRatioType;
-  typedef Array2D< PRatioType > PRatioArrayType;
-  mutable PRatioArrayType m_PRatioArray;
-
   /** Setting */
   bool m_UseJacobianPreconditioning;
 
@@ -284,9 +291,6 @@ private:
     const NonZeroJacobianIndicesType & nzji,
     DerivativeType & derivative ) const;
 
-  /** Helper function to compute m_PRatioArray in case of low memory consumption. */
-  void ComputeValueAndPRatioArray( double & MI ) const;
-
 };
 
 } // end namespace itk
@@ -26,6 +26,7 @@
 #include "itkMatrix.h"
 #include "vnl/vnl_inverse.h"
 #include "vnl/vnl_det.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -43,6 +44,17 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 {
   this->m_UseJacobianPreconditioning = false;
 
+  /** ThreadedComputeDerivativeLowMemory() marks the derivative blocks that it touches. */
+  this->m_SupportsSparseDerivativeAccumulation = true;
+
+  /** GetValueAndDerivative() only modifies members of this metric, and can
+   * read the transformed samples from a shared cache. */
+  this->m_SupportsConcurrentEvaluation           = true;
+  this->m_SupportsSharedTransformEvaluationCache = true;
+
+  /** GetValueAndAnalyticDerivative() can use the sparse pdf derivatives. */
+  this->m_SparseJointPDFDerivativesSupported = true;
+
   /** Initialize the m_ParzenWindowHistogramThreaderParameters. */
   this->m_ParzenWindowMutualInformationThreaderParameters.m_Metric = this;
 
@@ -92,46 +104,43 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   this->ComputeMarginalPDF( this->m_JointPDF, this->m_FixedImageMarginalPDF, 0 );
   this->ComputeMarginalPDF( this->m_JointPDF, this->m_MovingImageMarginalPDF, 1 );
 
-  /** Compute the metric by double summation over histogram. */
-
-  /** Setup iterators */
-  typedef ImageLinearConstIteratorWithIndex< JointPDFType > JointPDFIteratorType;
-  typedef typename MarginalPDFType::const_iterator          MarginalPDFIteratorType;
-
-  JointPDFIteratorType jointPDFit(
-    this->m_JointPDF, this->m_JointPDF->GetLargestPossibleRegion() );
-  jointPDFit.SetDirection( 0 );
-  jointPDFit.GoToBegin();
-  MarginalPDFIteratorType       fixedPDFit   = this->m_FixedImageMarginalPDF.begin();
-  const MarginalPDFIteratorType fixedPDFend  = this->m_FixedImageMarginalPDF.end();
-  MarginalPDFIteratorType       movingPDFit  = this->m_MovingImageMarginalPDF.begin();
-  const MarginalPDFIteratorType movingPDFend = this->m_MovingImageMarginalPDF.end();
+  /** Compute the metric by double summation over histogram. The logarithms
+   * of the marginal pdfs are computed once, so that every bin only needs the
+   * logarithm of the joint pdf: log( p / ( pf pm ) ) = log p - log pf - log pm.
+   */
+  const unsigned int numberOfFixedBins  = this->m_FixedImageMarginalPDF.GetSize();
+  const unsigned int numberOfMovingBins = this->m_MovingImageMarginalPDF.GetSize();
+  MarginalPDFType    logMovingPDF( numberOfMovingBins );
+  for( unsigned int m = 0; m < numberOfMovingBins; ++m )
+  {
+    const double movingImagePDFValue = this->m_MovingImageMarginalPDF[ m ];
+    logMovingPDF[ m ] = movingImagePDFValue > 0.0 ? vcl_log( movingImagePDFValue ) : 0.0;
+  }
 
-  /** Loop over histogram. */
-  double MI = 0.0;
-  while( fixedPDFit != fixedPDFend )
+  /** Loop over histogram, whose moving bins are contiguous. */
+  const PDFValueType * jointPDFPtr = this->m_JointPDF->GetBufferPointer();
+  double               MI          = 0.0;
+  for( unsigned int f = 0; f < numberOfFixedBins; ++f, jointPDFPtr += numberOfMovingBins )
   {
-    const double fixedImagePDFValue = *fixedPDFit;
-    movingPDFit = this->m_MovingImageMarginalPDF.begin();
-    while( movingPDFit != movingPDFend )
+    const double fixedImagePDFValue = this->m_FixedImageMarginalPDF[ f ];
+    if( !( fixedImagePDFValue > 0.0 ) )
     {
-      const double movingImagePDFValue = *movingPDFit;
-      const double fixPDFmovPDF        = fixedImagePDFValue * movingImagePDFValue;
-      const double jointPDFValue       = jointPDFit.Get();
+      continue;
+    }
+    const double logFixedImagePDFValue = vcl_log( fixedImagePDFValue );
+
+    for( unsigned int m = 0; m < numberOfMovingBins; ++m )
+    {
+      const double fixPDFmovPDF  = fixedImagePDFValue * this->m_MovingImageMarginalPDF[ m ];
+      const double jointPDFValue = jointPDFPtr[ m ];
 
       /** Check for non-zero bin contribution. */
       if( jointPDFValue > 1e-16 && fixPDFmovPDF > 1e-16 )
       {
-        MI += jointPDFValue * vcl_log( jointPDFValue / fixPDFmovPDF );
+        MI += jointPDFValue * ( vcl_log( jointPDFValue ) - logFixedImagePDFValue - logMovingPDF[ m ] );
       }
-      ++movingPDFit;
-      ++jointPDFit;
-    }  // end while-loop over moving index
-
-    ++fixedPDFit;
-    jointPDFit.NextLine();
-
-  } // end while-loop over fixed index
+    } // end loop over moving index
+  }   // end loop over fixed index
 
   return static_cast< MeasureType >( -1.0 * MI );
 
@@ -173,6 +182,37 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   this->ComputeMarginalPDF( this->m_JointPDF, this->m_FixedImageMarginalPDF, 0 );
   this->ComputeMarginalPDF( this->m_JointPDF, this->m_MovingImageMarginalPDF, 1 );
 
+  /** With sparse pdf derivatives, compute the weight of every bin first,
+   * and let the superclass apply them to the blocks of all threads.
+   */
+  if( this->GetSparseJointPDFDerivativesAreUsed() )
+  {
+    const unsigned int    nrOfFixedBins  = this->m_FixedImageMarginalPDF.size();
+    const unsigned int    nrOfMovingBins = this->m_MovingImageMarginalPDF.size();
+    const PDFValueType *  jointPDFPtr    = this->m_JointPDF->GetBufferPointer();
+    std::vector< double > weights( nrOfFixedBins * nrOfMovingBins, 0.0 );
+    double                MI             = 0.0;
+    for( unsigned int f = 0; f < nrOfFixedBins; ++f )
+    {
+      const double fixedImagePDFValue = this->m_FixedImageMarginalPDF[ f ];
+      for( unsigned int m = 0; m < nrOfMovingBins; ++m )
+      {
+        const double fixPDFmovPDF  = fixedImagePDFValue * this->m_MovingImageMarginalPDF[ m ];
+        const double jointPDFValue = jointPDFPtr[ f * nrOfMovingBins + m ];
+        if( jointPDFValue > 1e-16 && fixPDFmovPDF > 1e-16 )
+        {
+          const double pRatio = vcl_log( jointPDFValue / fixPDFmovPDF );
+          MI += jointPDFValue * pRatio;
+          weights[ f * nrOfMovingBins + m ] = this->m_Alpha * pRatio;
+        }
+      }
+    }
+
+    this->AccumulateSparseJointPDFDerivatives( weights, derivative );
+    value = static_cast< MeasureType >( -1.0 * MI );
+    return;
+  }
+
   /** Compute the metric and derivatives by double summation over histogram. */
 
   /** Setup iterators .*/
@@ -256,7 +296,13 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   /** Construct the JointPDF and Alpha.
    * This function contains a loop over the samples.
    * It executes multi-threadedly when m_UseMultiThread == true.
+   * In the fused mode the image Jacobian of each sample is stored as well,
+   * so that the derivative loop below does not need to revisit the images.
+   * Jacobian preconditioning needs the full transform Jacobian, so it is
+   * not supported by the fused mode.
    */
+  this->m_CacheSampleDerivativeTerms = this->GetUseFusedPDFAndDerivativePass()
+    && this->m_UseMultiThread && !this->GetUseJacobianPreconditioning();
   this->ComputePDFs( parameters );
 
   /** Normalize the joint histogram by alpha. */
@@ -282,6 +328,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * It executes multi-threadedly when m_UseMultiThread == true.
    */
   this->ComputeDerivativeLowMemory( derivative );
+  this->m_CacheSampleDerivativeTerms = false;
 
 } // end GetValueAndAnalyticDerivativeLowMemory()
 
@@ -329,7 +376,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if the point is inside the moving mask. */
     if( sampleOk )
@@ -358,7 +405,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
         ->Evaluate( movingImageValue, movingImageDerivative );
 
       /** Get the transform Jacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner product (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -443,10 +490,13 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedComputeDerivativeLowMemory( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  /** Get handles to the pre-allocated scratch buffers for dM(x)/dmu and the
+   * sparse Jacobian indices, sized in InitializePerThreadVariables(). */
+  typename Superclass::AlignedGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  const NumberOfParametersType nnzji         = perThread.st_NonZeroJacobianIndices.size();
+  NonZeroJacobianIndicesType & nzji          = perThread.st_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = perThread.st_ImageJacobian;
 
   /** Get a handle to the pre-allocated derivative for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -464,6 +514,30 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     preconditioningDivisor.Fill( 0.0 );
   }
 
+  /** In the fused mode, ThreadedComputePDFs() already visited the same samples
+   * for this thread and stored the image values and image Jacobians.
+   */
+  if( this->m_CacheSampleDerivativeTerms )
+  {
+    const typename Superclass::AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct & cache
+      = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+    const std::size_t numberOfCachedSamples = cache.st_CachedFixedImageValues.size();
+    for( std::size_t i = 0; i < numberOfCachedSamples; ++i )
+    {
+      const std::size_t offset = i * nnzji;
+      std::copy( cache.st_CachedImageJacobians.begin() + offset,
+        cache.st_CachedImageJacobians.begin() + offset + nnzji, imageJacobian.begin() );
+      std::copy( cache.st_CachedNonZeroJacobianIndices.begin() + offset,
+        cache.st_CachedNonZeroJacobianIndices.begin() + offset + nnzji, nzji.begin() );
+
+      this->UpdateDerivativeLowMemory(
+        cache.st_CachedFixedImageValues[ i ], cache.st_CachedMovingImageValues[ i ],
+        imageJacobian, nzji, derivative );
+      this->MarkTouchedDerivativeBlocks( threadId, nzji );
+    }
+    return;
+  }
+
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
   const unsigned long         sampleContainerSize = sampleContainer->Size();
@@ -495,7 +569,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if the point is inside the moving mask. */
     if( sampleOk )
@@ -531,15 +605,15 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
       /** If desired, apply the technique introduced by Tustison. */
-      TransformJacobianType jacobian;
       if( this->GetUseJacobianPreconditioning() )
       {
-        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+        TransformJacobianType & jacobian = perThread.st_TransformJacobian;
+        this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
         this->ComputeJacobianPreconditioner( jacobian, nzji,
           jacobianPreconditioner, preconditioningDivisor );
@@ -560,6 +634,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
       this->UpdateDerivativeLowMemory(
         fixedImageValue, movingImageValue, imageJacobian, nzji,
         derivative );
+      this->MarkTouchedDerivativeBlocks( threadId, nzji );
 
     } // end sampleOk
   }   // end loop over sample container
@@ -628,9 +703,8 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 
 } // end AfterThreadedComputeDerivativeLowMemory()
@@ -667,14 +741,11 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputeDerivativeLowMemoryThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputeDerivativeLowMemoryThreaderCallback,
+  /** Launch. */
+  this->ExecuteThreaderCallback( this->ComputeDerivativeLowMemoryThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_ParzenWindowMutualInformationThreaderParameters ) ) );
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
-
 } // end LaunchComputeDerivativeLowMemoryThreaderCallback()
 
 
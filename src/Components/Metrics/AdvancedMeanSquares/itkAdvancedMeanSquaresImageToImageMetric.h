@@ -23,6 +23,7 @@
 #include "itkSmoothingRecursiveGaussianImageFilter.h"   // needed for SelfHessian
 #include "itkImageGridSampler.h"                        // needed for SelfHessian
 #include "itkNearestNeighborInterpolateImageFunction.h" // needed for SelfHessian
+#include "itkMersenneTwisterRandomVariateGenerator.h"   // needed for SelfHessian
 
 namespace itk
 {
@@ -122,6 +123,8 @@ public:
   typedef typename Superclass::HessianType      HessianType;
   typedef typename Superclass::ThreaderType     ThreaderType;
   typedef typename Superclass::ThreadInfoType   ThreadInfoType;
+  typedef typename
+    Superclass::SelfHessianBlocksType SelfHessianBlocksType;
 
   /** The fixed image dimension. */
   itkStaticConstMacro( FixedImageDimension, unsigned int,
@@ -147,9 +150,16 @@ public:
   virtual void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & value, DerivativeType & derivative ) const;
 
-  /** Experimental feature: compute SelfHessian */
+  /** Experimental feature: compute SelfHessian, using multiple threads.
+   * Every thread fills its own sparse matrix, so for transforms with a
+   * large support GetSelfHessianBlocks() needs much less memory. */
   virtual void GetSelfHessian( const TransformParametersType & parameters, HessianType & H ) const;
 
+  /** Experimental feature: compute the diagonal blocks of the SelfHessian,
+   * using multiple threads. */
+  virtual void GetSelfHessianBlocks( const TransformParametersType & parameters,
+    const unsigned int blockSize, SelfHessianBlocksType & blocks ) const;
+
   /** Default: 1.0 mm */
   itkSetMacro( SelfHessianSmoothingSigma, double );
   itkGetConstMacro( SelfHessianSmoothingSigma, double );
@@ -205,6 +215,8 @@ protected:
   typedef typename Superclass::CentralDifferenceGradientFilterType CentralDifferenceGradientFilterType;
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
+  typedef typename Superclass::ImageSampleArraysType               ImageSampleArraysType;
 
   /** Protected typedefs for SelfHessian */
   typedef SmoothingRecursiveGaussianImageFilter<
@@ -214,6 +226,8 @@ protected:
   typedef NearestNeighborInterpolateImageFunction<
     FixedImageType, CoordinateRepresentationType >                 DummyFixedImageInterpolatorType;
   typedef ImageGridSampler< FixedImageType >                       SelfHessianSamplerType;
+  typedef Statistics::MersenneTwisterRandomVariateGenerator        RandomGeneratorType;
+  typedef typename RandomGeneratorType::Pointer                    RandomGeneratorPointer;
 
   double m_NormalizationFactor;
 
@@ -225,7 +239,19 @@ protected:
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
     MeasureType & measure,
-    DerivativeType & deriv ) const;
+    DerivativeType & deriv,
+    const RealType weight = 1.0 ) const;
+
+  /** Compute a pixel's contribution to the measure and atomically add its
+   * contribution to the shared derivative; called by the threaded functions
+   * when m_UseAtomicDerivativeAccumulation is true. */
+  void UpdateValueAndAtomicDerivativeTerms(
+    const RealType fixedImageValue,
+    const RealType movingImageValue,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji,
+    MeasureType & measure,
+    const RealType weight = 1.0 ) const;
 
   /** Compute a pixel's contribution to the SelfHessian;
    * Called by GetSelfHessian(). */
@@ -234,6 +260,42 @@ protected:
     const NonZeroJacobianIndicesType & nzji,
     HessianType & H ) const;
 
+  /** Compute a pixel's contribution to the diagonal blocks of the
+   * SelfHessian; called by GetSelfHessianBlocks(). */
+  void UpdateSelfHessianBlockTerms(
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji,
+    const unsigned int blockSize,
+    SelfHessianBlocksType & blocks ) const;
+
+  /** The input and the per-thread results of the threaded SelfHessian
+   * computation. With a block size of zero the threads fill sparse
+   * matrices, otherwise diagonal blocks. */
+  struct SelfHessianThreaderParameterType
+  {
+    const Self *                          m_Metric;
+    const ImageSampleContainerType *      m_Samples;
+    const FixedImageInterpolatorType *    m_FixedImageInterpolator;
+    unsigned int                          m_BlockSize;
+    std::vector< HessianType >            m_Hessians;
+    std::vector< SelfHessianBlocksType >  m_Blocks;
+    std::vector< SizeValueType >          m_NumberOfPixelsCounted;
+    std::vector< RandomGeneratorPointer > m_RandomGenerators;
+  };
+
+  /** Set up the smoothed fixed image and the samples, and let all threads
+   * accumulate their part of the SelfHessian. Returns the total number
+   * of samples that were counted. */
+  SizeValueType ComputeSelfHessianTerms( const TransformParametersType & parameters,
+    SelfHessianThreaderParameterType & threaderParameters ) const;
+
+  /** SelfHessian threader callback function. */
+  static ITK_THREAD_RETURN_TYPE ComputeSelfHessianThreaderCallback( void * arg );
+
+  /** Accumulate the SelfHessian over the samples of one thread. */
+  void ThreadedComputeSelfHessian( ThreadIdType threadId, ThreadIdType numberOfThreads,
+    SelfHessianThreaderParameterType & threaderParameters ) const;
+
   /** Get value for each thread. */
   inline void ThreadedGetValue( ThreadIdType threadID );
 
@@ -243,6 +305,11 @@ protected:
   /** Get value and derivatives for each thread. */
   inline void ThreadedGetValueAndDerivative( ThreadIdType threadID );
 
+  /** Get value and derivatives for each thread, reading the samples from
+   * the structure-of-arrays container and transforming them in batches.
+   */
+  inline void ThreadedGetValueAndDerivativeFromSampleArrays( ThreadIdType threadID );
+
   /** Gather the values and derivatives from all threads. */
   inline void AfterThreadedGetValueAndDerivative(
     MeasureType & value, DerivativeType & derivative ) const;
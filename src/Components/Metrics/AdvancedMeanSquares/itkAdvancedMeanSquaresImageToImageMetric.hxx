@@ -22,6 +22,8 @@
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 
+#include <algorithm>
+
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
 #endif
@@ -51,6 +53,27 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
   this->m_SelfHessianNoiseRange = 1.0;
 
+  /** The threaded functions mark the derivative blocks that they touch,
+   * or scatter atomically into the shared derivative. */
+  this->m_SupportsSparseDerivativeAccumulation = true;
+  this->m_SupportsAtomicDerivativeAccumulation = true;
+
+  /** GetValueAndDerivative() only modifies members of this metric, and can
+   * read the transformed samples from a shared cache. */
+  this->m_SupportsConcurrentEvaluation           = true;
+  this->m_SupportsSharedTransformEvaluationCache = true;
+
+  /** The threaded functions evaluate the samples of this process, and the
+   * value and derivative are sums over the samples. */
+  this->m_SupportsDistributedEvaluation = true;
+
+  /** The contributions of the samples are weighted with GetSampleWeight(). */
+  this->m_SupportsSampleWeights = true;
+
+  /** The Jacobian is evaluated per sample index, so that it can be taken
+   * from the transform Jacobian structure cache. */
+  this->m_SupportsTransformJacobianStructureCache = true;
+
 } // end Constructor
 
 
@@ -191,7 +214,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
       /** The difference squared. */
       const RealType diff = movingImageValue - fixedImageValue;
-      measure += diff * diff;
+      measure += this->GetSampleWeight( fiter.Index() ) * diff * diff;
 
     } // end if sampleOk
 
@@ -270,15 +293,18 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
   const unsigned long         sampleContainerSize = sampleContainer->Size();
 
-  /** Get the samples for this thread. */
+  /** Split the samples of this process over the threads. */
+  unsigned long process_begin = 0;
+  unsigned long process_end   = 0;
+  this->GetProcessSampleRange( sampleContainerSize, process_begin, process_end );
   const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( process_end - process_begin )
     / static_cast< double >( this->m_NumberOfThreads ) ) );
 
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+  unsigned long pos_begin = process_begin + nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = process_begin + nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > process_end ) ? process_end : pos_begin;
+  pos_end   = ( pos_end > process_end ) ? process_end : pos_end;
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator threader_fiter;
@@ -328,7 +354,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
       /** The difference squared. */
       const RealType diff = movingImageValue - fixedImageValue;
-      measure += diff * diff;
+      measure += this->GetSampleWeight( threader_fiter.Index() ) * diff * diff;
 
     } // end if sampleOk
 
@@ -360,7 +386,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
   }
 
-  /** Check if enough samples were valid. */
+  /** Sum the number of pixels over the processes, and check if enough
+   * samples were valid. */
+  this->SumOverProcesses( this->m_NumberOfPixelsCounted );
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
   this->CheckNumberOfSamples(
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
@@ -380,6 +408,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   }
   value *= normal_sum;
 
+  /** Sum the partial values over the processes. */
+  this->SumOverProcesses( value, 0 );
+
 } // end AfterThreadedGetValue()
 
 
@@ -463,7 +494,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -497,8 +528,8 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian and the moving image gradient. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative,
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        fiter.Index(), fixedPoint, movingImageDerivative,
         imageJacobian, nzji );
 #endif
 
@@ -506,7 +537,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
       this->UpdateValueAndDerivativeTerms(
         fixedImageValue, movingImageValue,
         imageJacobian, nzji,
-        measure, derivative );
+        measure, derivative, this->GetSampleWeight( fiter.Index() ) );
 
     } // end if sampleOk
 
@@ -565,6 +596,14 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
+  /** In the atomic mode the threads add directly to the derivative. */
+  if( this->m_UseAtomicDerivativeAccumulation )
+  {
+    derivative.SetSize( this->GetNumberOfParameters() );
+    derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    this->m_ThreaderMetricParameters.st_DerivativePointer = derivative.begin();
+  }
+
   /** Launch multi-threading metric */
   this->LaunchGetValueAndDerivativeThreaderCallback();
 
@@ -583,10 +622,26 @@ void
 AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nnzji );
+  /** Use the structure-of-arrays version of the samples, if available,
+   * unless the mapped points are shared with other metrics.
+   */
+  if( this->m_SampleArrays != 0 && this->m_SharedTransformEvaluationCache == 0 )
+  {
+    this->ThreadedGetValueAndDerivativeFromSampleArrays( threadId );
+    return;
+  }
+
+  /** Get handles to the pre-allocated scratch buffers for dM(x)/dmu and the
+   * sparse Jacobian indices, sized in InitializePerThreadVariables(). */
+  typename Superclass::AlignedGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  NonZeroJacobianIndicesType & nzji          = perThread.st_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = perThread.st_ImageJacobian;
+
+  /** Use the compact nonzero Jacobian indices, if the transform has them. */
+  const bool useDescriptor = this->m_UseNonZeroJacobianIndicesDescriptor
+    && this->m_SharedTransformEvaluationCache == 0 && !this->m_UseAtomicDerivativeAccumulation;
+  NonZeroJacobianIndicesDescriptorType descriptor;
 
   /** Get a handle to the pre-allocated derivative for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -599,15 +654,18 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
   const unsigned long         sampleContainerSize = sampleContainer->Size();
 
-  /** Get the samples for this thread. */
+  /** Split the samples of this process over the threads. */
+  unsigned long process_begin = 0;
+  unsigned long process_end   = 0;
+  this->GetProcessSampleRange( sampleContainerSize, process_begin, process_end );
   const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( process_end - process_begin )
     / static_cast< double >( this->m_NumberOfThreads ) ) );
 
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+  unsigned long pos_begin = process_begin + nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = process_begin + nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > process_end ) ? process_end : pos_begin;
+  pos_end   = ( pos_end > process_end ) ? process_end : pos_end;
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator threader_fiter;
@@ -631,7 +689,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( threader_fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -656,6 +714,22 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
       const RealType & fixedImageValue
         = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
 
+      /** With a compact description of the nonzero Jacobian indices, the
+       * derivative is accumulated without an index list.
+       */
+      if( useDescriptor )
+      {
+        this->m_AdvancedTransform->EvaluateCompactJacobianWithImageGradientProduct(
+          fixedPoint, movingImageDerivative, imageJacobian, descriptor );
+
+        const RealType weight = this->GetSampleWeight( threader_fiter.Index() );
+        const RealType diff   = movingImageValue - fixedImageValue;
+        measure += weight * diff * diff;
+        this->AddDerivativeTerms( weight * diff * 2.0, imageJacobian, descriptor, derivative );
+        this->MarkTouchedDerivativeBlocks( threadId, descriptor );
+        continue;
+      }
+
 #if 0
       /** Get the TransformJacobian dT/dmu. */
       this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
@@ -665,15 +739,26 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        threader_fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
       /** Compute this pixel's contribution to the measure and derivatives. */
-      this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
-        imageJacobian, nzji,
-        measure, derivative );
+      if( this->m_UseAtomicDerivativeAccumulation )
+      {
+        this->UpdateValueAndAtomicDerivativeTerms(
+          fixedImageValue, movingImageValue,
+          imageJacobian, nzji, measure,
+          this->GetSampleWeight( threader_fiter.Index() ) );
+      }
+      else
+      {
+        this->UpdateValueAndDerivativeTerms(
+          fixedImageValue, movingImageValue,
+          imageJacobian, nzji,
+          measure, derivative, this->GetSampleWeight( threader_fiter.Index() ) );
+        this->MarkTouchedDerivativeBlocks( threadId, nzji );
+      }
 
     } // end if sampleOk
 
@@ -686,6 +771,137 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 } // end ThreadedGetValueAndDerivative()
 
 
+/**
+ * ******************* ThreadedGetValueAndDerivativeFromSampleArrays *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValueAndDerivativeFromSampleArrays( ThreadIdType threadId )
+{
+  /** Get handles to the pre-allocated scratch buffers for dM(x)/dmu and the
+   * sparse Jacobian indices, sized in InitializePerThreadVariables(). */
+  typename Superclass::AlignedGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  NonZeroJacobianIndicesType & nzji          = perThread.st_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = perThread.st_ImageJacobian;
+
+  /** Use the compact nonzero Jacobian indices, if the transform has them. */
+  const bool useDescriptor = this->m_UseNonZeroJacobianIndicesDescriptor
+    && !this->m_UseAtomicDerivativeAccumulation;
+  NonZeroJacobianIndicesDescriptorType descriptor;
+
+  /** Get a handle to the pre-allocated derivative for the current thread. */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get the samples for this thread. */
+  const ImageSampleArraysType * sampleArrays        = this->m_SampleArrays;
+  const unsigned long           sampleContainerSize = sampleArrays->Size();
+
+  /** Split the samples of this process over the threads. */
+  unsigned long process_begin = 0;
+  unsigned long process_end   = 0;
+  this->GetProcessSampleRange( sampleContainerSize, process_begin, process_end );
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( process_end - process_begin )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = process_begin + nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = process_begin + nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > process_end ) ? process_end : pos_begin;
+  pos_end   = ( pos_end > process_end ) ? process_end : pos_end;
+
+  /** Small batches of points, that fit in the L1 cache. */
+  const unsigned long  batchSize = 64;
+  FixedImagePointType  fixedPoints[ batchSize ];
+  MovingImagePointType mappedPoints[ batchSize ];
+  const RealType *     fixedImageValues = &( sampleArrays->GetValues()[ 0 ] );
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Loop over the batches of samples. */
+  for( unsigned long batch_begin = pos_begin; batch_begin < pos_end; batch_begin += batchSize )
+  {
+    const unsigned long n = vnl_math_min( batchSize, pos_end - batch_begin );
+
+    /** Gather the fixed points and transform them with one call. */
+    sampleArrays->GetPoints( batch_begin, n, fixedPoints );
+    this->TransformPoints( batch_begin, n, fixedPoints, mappedPoints );
+
+    for( unsigned long i = 0; i < n; ++i )
+    {
+      const FixedImagePointType &  fixedPoint  = fixedPoints[ i ];
+      const MovingImagePointType & mappedPoint = mappedPoints[ i ];
+      RealType                     movingImageValue;
+      MovingImageDerivativeType    movingImageDerivative;
+
+      /** Check if point is inside mask. */
+      bool sampleOk = this->IsInsideMovingMask( mappedPoint );
+
+      /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
+       * the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, &movingImageDerivative );
+      }
+
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
+
+        /** With a compact description of the nonzero Jacobian indices, the
+         * derivative is accumulated without an index list.
+         */
+        if( useDescriptor )
+        {
+          this->m_AdvancedTransform->EvaluateCompactJacobianWithImageGradientProduct(
+            fixedPoint, movingImageDerivative, imageJacobian, descriptor );
+
+          const RealType weight = this->GetSampleWeight( batch_begin + i );
+          const RealType diff   = movingImageValue - fixedImageValues[ batch_begin + i ];
+          measure += weight * diff * diff;
+          this->AddDerivativeTerms( weight * diff * 2.0, imageJacobian, descriptor, derivative );
+          this->MarkTouchedDerivativeBlocks( threadId, descriptor );
+          continue;
+        }
+
+        /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+        this->EvaluateTransformJacobianWithImageGradientProduct(
+          batch_begin + i, fixedPoint, movingImageDerivative, imageJacobian, nzji );
+
+        /** Compute this pixel's contribution to the measure and derivatives. */
+        if( this->m_UseAtomicDerivativeAccumulation )
+        {
+          this->UpdateValueAndAtomicDerivativeTerms(
+            fixedImageValues[ batch_begin + i ], movingImageValue,
+            imageJacobian, nzji, measure,
+            this->GetSampleWeight( batch_begin + i ) );
+        }
+        else
+        {
+          this->UpdateValueAndDerivativeTerms(
+            fixedImageValues[ batch_begin + i ], movingImageValue,
+            imageJacobian, nzji,
+            measure, derivative, this->GetSampleWeight( batch_begin + i ) );
+          this->MarkTouchedDerivativeBlocks( threadId, nzji );
+        }
+
+      } // end if sampleOk
+    }   // end loop over the batch
+  }     // end loop over the batches
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValueAndDerivativeFromSampleArrays()
+
+
 /**
  * ******************* AfterThreadedGetValueAndDerivative *******************
  */
@@ -706,7 +922,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
   }
 
-  /** Check if enough samples were valid. */
+  /** Sum the number of pixels over the processes, and check if enough
+   * samples were valid. */
+  this->SumOverProcesses( this->m_NumberOfPixelsCounted );
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
   this->CheckNumberOfSamples(
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
@@ -727,8 +945,13 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   value *= normal_sum;
 
   /** Accumulate derivatives. */
+  // the threads already added to the derivative, only normalize
+  if( this->m_UseAtomicDerivativeAccumulation )
+  {
+    derivative *= normal_sum;
+  }
   // compute single-threadedly
-  if( !this->m_UseMultiThread && false ) // force multi-threaded
+  else if( !this->m_UseMultiThread && false ) // force multi-threaded
   {
     derivative = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_Derivative * normal_sum;
     for( ThreadIdType i = 1; i < this->m_NumberOfThreads; i++ )
@@ -742,9 +965,8 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0 / normal_sum;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -765,6 +987,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   }
 #endif
 
+  /** Sum the partial values and derivatives over the processes. */
+  this->SumOverProcesses( value, &derivative );
+
 } // end AfterThreadedGetValueAndDerivative()
 
 
@@ -781,15 +1006,16 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
   MeasureType & measure,
-  DerivativeType & deriv ) const
+  DerivativeType & deriv,
+  const RealType weight ) const
 {
-  /** The difference squared. */
+  /** The difference squared, times the importance weight of the sample. */
   const RealType diff     = movingImageValue - fixedImageValue;
   const RealType diffdiff = diff * diff;
-  measure += diffdiff;
+  measure += weight * diffdiff;
 
   /** Calculate the contributions to the derivatives with respect to each parameter. */
-  const RealType diff_2 = diff * 2.0;
+  const RealType diff_2 = weight * diff * 2.0;
   if( nzji.size() == this->GetNumberOfParameters() )
   {
     /** Loop over all Jacobians. */
@@ -814,6 +1040,31 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 } // end UpdateValueAndDerivativeTerms()
 
 
+/**
+ * *************** UpdateValueAndAtomicDerivativeTerms ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateValueAndAtomicDerivativeTerms(
+  const RealType fixedImageValue,
+  const RealType movingImageValue,
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesType & nzji,
+  MeasureType & measure,
+  const RealType weight ) const
+{
+  /** The difference squared, times the importance weight of the sample. */
+  const RealType diff = movingImageValue - fixedImageValue;
+  measure += weight * diff * diff;
+
+  /** Scatter the contributions to the derivatives into the shared derivative. */
+  this->AtomicScatterDerivativeTerms( weight * diff * 2.0, imageJacobian, nzji );
+
+} // end UpdateValueAndAtomicDerivativeTerms()
+
+
 /**
  * ******************* GetSelfHessian *******************
  */
@@ -824,27 +1075,122 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::GetSelfHessian( const TransformParametersType & parameters, HessianType & H ) const
 {
   itkDebugMacro( "GetSelfHessian()" );
-  typedef Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
 
-  /** Initialize some variables. */
-  this->m_NumberOfPixelsCounted = 0;
-  RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
-  randomGenerator->Initialize();
+  /** Let every thread fill its own sparse matrix. */
+  SelfHessianThreaderParameterType threaderParameters;
+  threaderParameters.m_BlockSize = 0;
+  this->m_NumberOfPixelsCounted  = this->ComputeSelfHessianTerms( parameters, threaderParameters );
 
-  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
-  NonZeroJacobianIndicesType nzji(
-  this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-  DerivativeType        imageJacobian( nzji.size() );
-  TransformJacobianType jacobian;
+  /** Prepare Hessian */
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  H.set_size( numberOfParameters, numberOfParameters );
+  //H.Fill(0.0); // done by set_size if sparse matrix
+
+  /** Add the matrices of the threads. */
+  for( unsigned int t = 0; t < threaderParameters.m_Hessians.size(); ++t )
+  {
+    if( threaderParameters.m_NumberOfPixelsCounted[ t ] == 0 )
+    {
+      continue;
+    }
+    HessianType sum;
+    H.add( threaderParameters.m_Hessians[ t ], sum );
+    H = sum;
+    threaderParameters.m_Hessians[ t ].set_size( 0, 0 );
+  }
+
+  /** Compute the measure value and derivative. */
+  if( this->m_NumberOfPixelsCounted > 0 )
+  {
+    const double normal_sum = 2.0 * this->m_NormalizationFactor
+      / static_cast< double >( this->m_NumberOfPixelsCounted );
+    for( unsigned int i = 0; i < numberOfParameters; ++i )
+    {
+      H.scale_row( i, normal_sum );
+    }
+  }
+  else
+  {
+    //H.fill_diagonal(1.0);
+    for( unsigned int i = 0; i < numberOfParameters; ++i )
+    {
+      H( i, i ) = 1.0;
+    }
+  }
+
+} // end GetSelfHessian()
+
+
+/**
+ * ******************* GetSelfHessianBlocks *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetSelfHessianBlocks( const TransformParametersType & parameters,
+  const unsigned int blockSize, SelfHessianBlocksType & blocks ) const
+{
+  itkDebugMacro( "GetSelfHessianBlocks()" );
 
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  if( blockSize == 0 || numberOfParameters % blockSize != 0 )
+  {
+    itkExceptionMacro( << "ERROR: the self Hessian block size " << blockSize
+                       << " does not divide the number of parameters " << numberOfParameters );
+  }
+
+  /** Let every thread fill its own blocks. */
+  SelfHessianThreaderParameterType threaderParameters;
+  threaderParameters.m_BlockSize = blockSize;
+  this->m_NumberOfPixelsCounted  = this->ComputeSelfHessianTerms( parameters, threaderParameters );
+
+  /** Add the blocks of the threads. */
+  const SizeValueType numberOfValues = static_cast< SizeValueType >( numberOfParameters ) * blockSize;
+  blocks.SetSize( numberOfValues );
+  blocks.Fill( 0.0 );
+  for( unsigned int t = 0; t < threaderParameters.m_Blocks.size(); ++t )
+  {
+    if( threaderParameters.m_NumberOfPixelsCounted[ t ] == 0 )
+    {
+      continue;
+    }
+    const HessianValueType * threadBlocks = threaderParameters.m_Blocks[ t ].data_block();
+    HessianValueType *       sum          = blocks.data_block();
+    for( SizeValueType i = 0; i < numberOfValues; ++i )
+    {
+      sum[ i ] += threadBlocks[ i ];
+    }
+  }
+
+  /** Normalize, or return identity blocks if no sample was valid. */
+  if( this->m_NumberOfPixelsCounted > 0 )
+  {
+    const double normal_sum = 2.0 * this->m_NormalizationFactor
+      / static_cast< double >( this->m_NumberOfPixelsCounted );
+    blocks *= normal_sum;
+  }
+  else
+  {
+    this->Superclass::GetSelfHessianBlocks( parameters, blockSize, blocks );
+  }
+
+} // end GetSelfHessianBlocks()
+
+
+/**
+ * ******************* ComputeSelfHessianTerms *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeSelfHessianTerms( const TransformParametersType & parameters,
+  SelfHessianThreaderParameterType & threaderParameters ) const
+{
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  /** Prepare Hessian */
-  H.set_size( this->GetNumberOfParameters(),
-    this->GetNumberOfParameters() );
-  //H.Fill(0.0); // done by set_size if sparse matrix
-
   /** Smooth fixed image */
   typename SmootherType::Pointer smoother = SmootherType::New();
   smoother->SetInput( this->GetFixedImage() );
@@ -867,28 +1213,141 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
    * Actually we could do without a sampler, but it's easy like this.
    */
   typename SelfHessianSamplerType::Pointer sampler = SelfHessianSamplerType::New();
-  //typename DummyFixedImageInterpolatorType::Pointer dummyInterpolator =
-  //  DummyFixedImageInterpolatorType::New();
   sampler->SetInputImageRegion( this->GetImageSampler()->GetInputImageRegion() );
   sampler->SetMask( this->GetImageSampler()->GetMask() );
   sampler->SetInput( smoother->GetInput() );
   sampler->SetNumberOfSamples( this->m_NumberOfSamplesForSelfHessian );
-  //sampler->SetInterpolator( dummyInterpolator );
 
   /** Update the imageSampler and get a handle to the sample container. */
   sampler->Update();
   ImageSampleContainerPointer sampleContainer = sampler->GetOutput();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
+  /** Every thread draws its noise from its own generator, seeded from the
+   * global one, so that the threads do not share a generator.
+   */
+  const ThreadIdType numberOfThreads
+    = this->m_UseMultiThread ? this->m_NumberOfThreads : 1;
+  RandomGeneratorPointer globalGenerator = RandomGeneratorType::GetInstance();
+  threaderParameters.m_Metric                 = this;
+  threaderParameters.m_Samples                = sampleContainer.GetPointer();
+  threaderParameters.m_FixedImageInterpolator = fixedInterpolator.GetPointer();
+  threaderParameters.m_NumberOfPixelsCounted.assign( numberOfThreads, 0 );
+  threaderParameters.m_RandomGenerators.resize( numberOfThreads );
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    threaderParameters.m_RandomGenerators[ t ] = RandomGeneratorType::New();
+    threaderParameters.m_RandomGenerators[ t ]->Initialize( globalGenerator->GetIntegerVariate() );
+  }
+  if( threaderParameters.m_BlockSize == 0 )
+  {
+    threaderParameters.m_Hessians.resize( numberOfThreads );
+  }
+  else
+  {
+    threaderParameters.m_Blocks.resize( numberOfThreads );
+  }
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  /** Launch. */
+  if( this->m_UseMultiThread )
+  {
+    this->ExecuteThreaderCallback( this->ComputeSelfHessianThreaderCallback,
+      static_cast< void * >( &threaderParameters ) );
+  }
+  else
+  {
+    this->ThreadedComputeSelfHessian( 0, 1, threaderParameters );
+  }
+
+  /** Check if enough samples were valid. */
+  SizeValueType numberOfPixelsCounted = 0;
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    numberOfPixelsCounted += threaderParameters.m_NumberOfPixelsCounted[ t ];
+  }
+  this->CheckNumberOfSamples( sampleContainer->Size(), numberOfPixelsCounted );
+
+  return numberOfPixelsCounted;
+
+} // end ComputeSelfHessianTerms()
+
+
+/**
+ * ******************* ComputeSelfHessianThreaderCallback *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeSelfHessianThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  SelfHessianThreaderParameterType * temp
+    = static_cast< SelfHessianThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputeSelfHessian( threadID, nrOfThreads, *temp );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeSelfHessianThreaderCallback()
+
+
+/**
+ * ******************* ThreadedComputeSelfHessian *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputeSelfHessian( ThreadIdType threadId, ThreadIdType numberOfThreads,
+  SelfHessianThreaderParameterType & threaderParameters ) const
+{
+  /** The pool may run more threads than there are result slots. */
+  if( threadId >= threaderParameters.m_NumberOfPixelsCounted.size() )
+  {
+    return;
+  }
+
+  /** Get a handle to the output of this thread. */
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  const unsigned int blockSize          = threaderParameters.m_BlockSize;
+  if( blockSize == 0 )
+  {
+    threaderParameters.m_Hessians[ threadId ].set_size( numberOfParameters, numberOfParameters );
+  }
+  else
+  {
+    threaderParameters.m_Blocks[ threadId ].SetSize( numberOfParameters * blockSize );
+    threaderParameters.m_Blocks[ threadId ].Fill( 0.0 );
+  }
+  RandomGeneratorType * randomGenerator = threaderParameters.m_RandomGenerators[ threadId ];
+
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji(
+  this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType        imageJacobian( nzji.size() );
+  TransformJacobianType jacobian;
+
+  /** Get the samples for this thread. */
+  const ImageSampleContainerType * sampleContainer = threaderParameters.m_Samples;
+  const unsigned long              sampleContainerSize = sampleContainer->Size();
+  const unsigned long              nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( numberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Loop over the fixed image samples of this thread. */
+  SizeValueType numberOfPixelsCounted = 0;
+  for( unsigned long i = pos_begin; i < pos_end; ++i )
   {
     /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( i ).m_ImageCoordinates;
     MovingImagePointType        mappedPoint;
     MovingImageDerivativeType   movingImageDerivative;
 
@@ -913,14 +1372,15 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
     if( sampleOk )
     {
-      this->m_NumberOfPixelsCounted++;
+      ++numberOfPixelsCounted;
 
       /** Use the derivative of the fixed image for the self Hessian!
        * \todo: we can do this more efficient without the interpolation,
        * without the sampler, and with a precomputed gradient image,
        * but is this the bottleneck?
        */
-      movingImageDerivative = fixedInterpolator->EvaluateDerivative( fixedPoint );
+      movingImageDerivative
+        = threaderParameters.m_FixedImageInterpolator->EvaluateDerivative( fixedPoint );
       for( unsigned int d = 0; d < FixedImageDimension; ++d )
       {
         movingImageDerivative[ d ] += randomGenerator->GetVariateWithClosedRange(
@@ -935,36 +1395,88 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 
       /** Compute this pixel's contribution to the SelfHessian. */
-      this->UpdateSelfHessianTerms( imageJacobian, nzji, H );
+      if( blockSize == 0 )
+      {
+        this->UpdateSelfHessianTerms( imageJacobian, nzji,
+          threaderParameters.m_Hessians[ threadId ] );
+      }
+      else
+      {
+        this->UpdateSelfHessianBlockTerms( imageJacobian, nzji, blockSize,
+          threaderParameters.m_Blocks[ threadId ] );
+      }
 
     } // end if sampleOk
 
   } // end for loop over the image sample container
 
-  /** Check if enough samples were valid. */
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+  threaderParameters.m_NumberOfPixelsCounted[ threadId ] = numberOfPixelsCounted;
 
-  /** Compute the measure value and derivative. */
-  if( this->m_NumberOfPixelsCounted > 0 )
+} // end ThreadedComputeSelfHessian()
+
+
+/**
+ * *************** UpdateSelfHessianBlockTerms ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateSelfHessianBlockTerms(
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesType & nzji,
+  const unsigned int blockSize,
+  SelfHessianBlocksType & blocks ) const
+{
+  const unsigned int imjacsize   = imageJacobian.GetSize();
+  HessianValueType * blockValues = blocks.data_block();
+
+  /** The diagonal: no grouping needed. */
+  if( blockSize == 1 )
   {
-    const double normal_sum = 2.0 * this->m_NormalizationFactor
-      / static_cast< double >( this->m_NumberOfPixelsCounted );
-    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+    for( unsigned int i = 0; i < imjacsize; ++i )
     {
-      H.scale_row( i, normal_sum );
+      blockValues[ nzji[ i ] ] += imageJacobian[ i ] * imageJacobian[ i ];
     }
+    return;
   }
-  else
+
+  /** Group the nonzero Jacobians by block, so that only the pairs inside
+   * a block are visited, instead of all imjacsize^2 pairs.
+   */
+  const unsigned int numberOfBlocks = this->GetNumberOfParameters() / blockSize;
+  std::vector< std::pair< unsigned int, unsigned int > > order( imjacsize );
+  for( unsigned int i = 0; i < imjacsize; ++i )
   {
-    //H.fill_diagonal(1.0);
-    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+    order[ i ] = std::make_pair( static_cast< unsigned int >( nzji[ i ] % numberOfBlocks ), i );
+  }
+  std::sort( order.begin(), order.end() );
+
+  for( unsigned int first = 0; first < imjacsize; )
+  {
+    unsigned int last = first + 1;
+    while( last < imjacsize && order[ last ].first == order[ first ].first )
     {
-      H( i, i ) = 1.0;
+      ++last;
+    }
+
+    HessianValueType * block = blockValues
+      + static_cast< SizeValueType >( order[ first ].first ) * blockSize * blockSize;
+    for( unsigned int a = first; a < last; ++a )
+    {
+      const unsigned int i    = order[ a ].second;
+      const unsigned int row  = nzji[ i ] / numberOfBlocks;
+      const double       imji = imageJacobian[ i ];
+      for( unsigned int b = first; b < last; ++b )
+      {
+        const unsigned int j = order[ b ].second;
+        block[ row * blockSize + nzji[ j ] / numberOfBlocks ] += imji * imageJacobian[ j ];
+      }
     }
+    first = last;
   }
 
-} // end GetSelfHessian()
+} // end UpdateSelfHessianBlockTerms()
 
 
 /**
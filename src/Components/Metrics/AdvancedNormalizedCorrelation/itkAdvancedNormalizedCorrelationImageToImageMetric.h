@@ -19,6 +19,7 @@
 #define __itkAdvancedNormalizedCorrelationImageToImageMetric_h
 
 #include "itkAdvancedImageToImageMetric.h"
+#include "itkCompensatedSummation.h"
 
 namespace itk
 {
@@ -81,6 +82,11 @@ namespace itk
  *
  * where Af and Am are the average of f and m, respectively.
  *
+ * The sums sff, smm, sfm, sf and sm are accumulated with compensated (Kahan)
+ * summation, which limits the round-off that the subtraction of the mean
+ * amplifies. The three derivative terms of every parameter are stored
+ * interleaved in a single per-thread buffer, so that they are updated and
+ * reduced in a single pass.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
@@ -211,16 +217,16 @@ protected:
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
 
   /** Compute a pixel's contribution to the derivative terms;
-   * Called by GetValueAndDerivative().
+   * Called by GetValueAndDerivative(). The terms of parameter mu are
+   * interleaved: derivativeF at 3 mu, derivativeM at 3 mu + 1 and the
+   * differential at 3 mu + 2.
    */
   void UpdateDerivativeTerms(
     const RealType & fixedImageValue,
     const RealType & movingImageValue,
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
-    DerivativeType & derivativeF,
-    DerivativeType & derivativeM,
-    DerivativeType & differential ) const;
+    DerivativeType & derivativeTerms ) const;
 
   /** Initialize some multi-threading related parameters.
    * Overrides function in AdvancedImageToImageMetric, because
@@ -246,6 +252,7 @@ private:
   mutable bool m_SubtractMean;
 
   typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
+  typedef CompensatedSummation< AccumulateType >                CompensatedSummationType;
 
   /** Helper structs that multi-threads the computation of
    * the metric derivative using ITK threads.
@@ -269,9 +276,7 @@ private:
     AccumulateType st_Sfm;
     AccumulateType st_Sf;
     AccumulateType st_Sm;
-    DerivativeType st_DerivativeF;
-    DerivativeType st_DerivativeM;
-    DerivativeType st_Differential;
+    DerivativeType st_DerivativeTerms;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, CorrelationGetValueAndDerivativePerThreadStruct,
     PaddedCorrelationGetValueAndDerivativePerThreadStruct );
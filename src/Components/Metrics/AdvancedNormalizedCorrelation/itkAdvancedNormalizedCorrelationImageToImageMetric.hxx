@@ -20,10 +20,6 @@
 
 #include "itkAdvancedNormalizedCorrelationImageToImageMetric.h"
 
-#ifdef ELASTIX_USE_OPENMP
-#include <omp.h>
-#endif
-
 namespace itk
 {
 
@@ -45,6 +41,11 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_CorrelationGetValueAndDerivativePerThreadVariables     = NULL;
   this->m_CorrelationGetValueAndDerivativePerThreadVariablesSize = 0;
 
+  /** GetValueAndDerivative() only modifies members of this metric, and can
+   * read the transformed samples from a shared cache. */
+  this->m_SupportsConcurrentEvaluation           = true;
+  this->m_SupportsSharedTransformEvaluationCache = true;
+
 } // end Constructor
 
 
@@ -97,12 +98,8 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm                   = zero1;
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf                    = zero1;
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm                    = zero1;
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.Fill( zero2 );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.Fill( zero2 );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.Fill( zero2 );
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeTerms.SetSize( 3 * this->GetNumberOfParameters() );
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeTerms.Fill( zero2 );
   }
 
 } // end InitializeThreadingParameters()
@@ -135,28 +132,21 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   const RealType & movingImageValue,
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
-  DerivativeType & derivativeF,
-  DerivativeType & derivativeM,
-  DerivativeType & differential ) const
+  DerivativeType & derivativeTerms ) const
 {
   /** Calculate the contributions to the derivatives with respect to each parameter. */
+  DerivativeValueType * terms = derivativeTerms.data_block();
   if( nzji.size() == this->GetNumberOfParameters() )
   {
     /** Loop over all Jacobians. */
-    typename DerivativeType::const_iterator imjacit  = imageJacobian.begin();
-    typename DerivativeType::iterator derivativeFit  = derivativeF.begin();
-    typename DerivativeType::iterator derivativeMit  = derivativeM.begin();
-    typename DerivativeType::iterator differentialit = differential.begin();
-
+    typename DerivativeType::const_iterator imjacit = imageJacobian.begin();
     for( unsigned int mu = 0; mu < this->GetNumberOfParameters(); ++mu )
     {
-      ( *derivativeFit )  += fixedImageValue * ( *imjacit );
-      ( *derivativeMit )  += movingImageValue * ( *imjacit );
-      ( *differentialit ) += ( *imjacit );
+      terms[ 0 ] += fixedImageValue * ( *imjacit );
+      terms[ 1 ] += movingImageValue * ( *imjacit );
+      terms[ 2 ] += ( *imjacit );
       ++imjacit;
-      ++derivativeFit;
-      ++derivativeMit;
-      ++differentialit;
+      terms += 3;
     }
   }
   else
@@ -164,11 +154,11 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     /** Only pick the nonzero Jacobians. */
     for( unsigned int i = 0; i < imageJacobian.GetSize(); ++i )
     {
-      const unsigned int index           = nzji[ i ];
-      const RealType     differentialtmp = imageJacobian[ i ];
-      derivativeF[ index ]  += fixedImageValue  * differentialtmp;
-      derivativeM[ index ]  += movingImageValue * differentialtmp;
-      differential[ index ] += differentialtmp;
+      DerivativeValueType * termsOfIndex    = terms + 3 * nzji[ i ];
+      const RealType        differentialtmp = imageJacobian[ i ];
+      termsOfIndex[ 0 ] += fixedImageValue  * differentialtmp;
+      termsOfIndex[ 1 ] += movingImageValue * differentialtmp;
+      termsOfIndex[ 2 ] += differentialtmp;
     }
   }
 
@@ -214,11 +204,11 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
 
   /** Create variables to store intermediate results. */
-  AccumulateType sff = NumericTraits< AccumulateType >::Zero;
-  AccumulateType smm = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sfm = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sf  = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sm  = NumericTraits< AccumulateType >::Zero;
+  CompensatedSummationType sff;
+  CompensatedSummationType smm;
+  CompensatedSummationType sfm;
+  CompensatedSummationType sf;
+  CompensatedSummationType sm;
 
   /** Loop over the fixed image samples to calculate the mean squares. */
   for( fiter = fbegin; fiter != fend; ++fiter )
@@ -274,18 +264,18 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   const RealType N = static_cast< RealType >( this->m_NumberOfPixelsCounted );
   if( this->m_SubtractMean && this->m_NumberOfPixelsCounted > 0 )
   {
-    sff -= ( sf * sf / N );
-    smm -= ( sm * sm / N );
-    sfm -= ( sf * sm / N );
+    sff -= ( sf.GetSum() * sf.GetSum() / N );
+    smm -= ( sm.GetSum() * sm.GetSum() / N );
+    sfm -= ( sf.GetSum() * sm.GetSum() / N );
   }
 
   /** The denominator of the NC. */
-  const RealType denom = -1.0 * vcl_sqrt( sff * smm );
+  const RealType denom = -1.0 * vcl_sqrt( sff.GetSum() * smm.GetSum() );
 
   /** Calculate the measure value. */
   if( this->m_NumberOfPixelsCounted > 0 && denom < -1e-14 )
   {
-    measure = sfm / denom;
+    measure = sfm.GetSum() / denom;
   }
   else
   {
@@ -337,12 +327,8 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_NumberOfPixelsCounted = 0;
   derivative                    = DerivativeType( this->GetNumberOfParameters() );
   derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  DerivativeType derivativeF = DerivativeType( this->GetNumberOfParameters() );
-  derivativeF.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  DerivativeType derivativeM = DerivativeType( this->GetNumberOfParameters() );
-  derivativeM.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  DerivativeType differential = DerivativeType( this->GetNumberOfParameters() );
-  differential.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  DerivativeType derivativeTerms = DerivativeType( 3 * this->GetNumberOfParameters() );
+  derivativeTerms.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
 
   /** Array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
   NonZeroJacobianIndicesType nzji( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
@@ -350,11 +336,11 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   TransformJacobianType      jacobian;
 
   /** Initialize some variables for intermediate results. */
-  AccumulateType sff = NumericTraits< AccumulateType >::Zero;
-  AccumulateType smm = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sfm = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sf  = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sm  = NumericTraits< AccumulateType >::Zero;
+  CompensatedSummationType sff;
+  CompensatedSummationType smm;
+  CompensatedSummationType sfm;
+  CompensatedSummationType sf;
+  CompensatedSummationType sm;
 
   /** Call non-thread-safe stuff, such as:
    *   this->SetTransformParameters( parameters );
@@ -389,7 +375,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -414,7 +400,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
       const RealType & fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the innerproducts (dM/dx)^T (dT/dmu) and (dMask/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -429,8 +415,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 
       /** Compute this pixel's contribution to the derivative terms. */
       this->UpdateDerivativeTerms(
-        fixedImageValue, movingImageValue, imageJacobian, nzji,
-        derivativeF, derivativeM, differential );
+        fixedImageValue, movingImageValue, imageJacobian, nzji, derivativeTerms );
 
     } // end if sampleOk
 
@@ -444,30 +429,31 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
    * derivativeF and derivativeM.
    */
   const RealType N = static_cast< RealType >( this->m_NumberOfPixelsCounted );
+  AccumulateType sf_N = NumericTraits< AccumulateType >::Zero;
+  AccumulateType sm_N = NumericTraits< AccumulateType >::Zero;
   if( this->m_SubtractMean && this->m_NumberOfPixelsCounted > 0 )
   {
-    sff -= ( sf * sf / N );
-    smm -= ( sm * sm / N );
-    sfm -= ( sf * sm / N );
-
-    for( unsigned int i = 0; i < this->GetNumberOfParameters(); i++ )
-    {
-      derivativeF[ i ] -= sf * differential[ i ] / N;
-      derivativeM[ i ] -= sm * differential[ i ] / N;
-    }
+    sff -= ( sf.GetSum() * sf.GetSum() / N );
+    smm -= ( sm.GetSum() * sm.GetSum() / N );
+    sfm -= ( sf.GetSum() * sm.GetSum() / N );
+    sf_N = sf.GetSum() / N;
+    sm_N = sm.GetSum() / N;
   }
 
   /** The denominator of the value and the derivative. */
-  const RealType denom = -1.0 * vcl_sqrt( sff * smm );
+  const RealType denom = -1.0 * vcl_sqrt( sff.GetSum() * smm.GetSum() );
 
   /** Calculate the value and the derivative. */
   if( this->m_NumberOfPixelsCounted > 0 && denom < -1e-14 )
   {
-    value = sfm / denom;
+    value = sfm.GetSum() / denom;
+    const AccumulateType sfm_smm = sfm.GetSum() / smm.GetSum();
     for( unsigned int i = 0; i < this->GetNumberOfParameters(); i++ )
     {
-      derivative[ i ] = ( derivativeF[ i ] - ( sfm / smm ) * derivativeM[ i ] )
-        / denom;
+      const DerivativeValueType differential = derivativeTerms[ 3 * i + 2 ];
+      const DerivativeValueType derivativeF  = derivativeTerms[ 3 * i ] - sf_N * differential;
+      const DerivativeValueType derivativeM  = derivativeTerms[ 3 * i + 1 ] - sm_N * differential;
+      derivative[ i ] = ( derivativeF - sfm_smm * derivativeM ) / denom;
     }
   }
   else
@@ -530,19 +516,19 @@ void
 AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  /** Get handles to the pre-allocated scratch buffers for dM(x)/dmu and the
+   * sparse Jacobian indices, sized in InitializePerThreadVariables(). */
+  typename Superclass::AlignedGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  NonZeroJacobianIndicesType & nzji          = perThread.st_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = perThread.st_ImageJacobian;
 
   /** Get handles to the pre-allocated derivatives for the current thread.
    * The initialization is performed at the beginning of each resolution in
    * InitializeThreadingParameters(), and at the end of each iteration in
    * AfterThreadedGetValueAndDerivative() and the accumulate functions.
    */
-  DerivativeType & derivativeF  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeF;
-  DerivativeType & derivativeM  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeM;
-  DerivativeType & differential = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Differential;
+  DerivativeType & derivativeTerms = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeTerms;
 
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
@@ -567,12 +553,12 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   threader_fend   += (int)pos_end;
 
   /** Create variables to store intermediate results. */
-  AccumulateType sff                   = NumericTraits< AccumulateType >::Zero;
-  AccumulateType smm                   = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sfm                   = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sf                    = NumericTraits< AccumulateType >::Zero;
-  AccumulateType sm                    = NumericTraits< AccumulateType >::Zero;
-  unsigned long  numberOfPixelsCounted = 0;
+  CompensatedSummationType sff;
+  CompensatedSummationType smm;
+  CompensatedSummationType sfm;
+  CompensatedSummationType sf;
+  CompensatedSummationType sm;
+  unsigned long            numberOfPixelsCounted = 0;
 
   /** Loop over the fixed image to calculate the mean squares. */
   for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
@@ -584,7 +570,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformPoint( threader_fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -618,8 +604,8 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+      this->EvaluateTransformJacobianWithImageGradientProduct(
+        threader_fiter.Index(), fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
       /** Update some sums needed to calculate the value of NC. */
@@ -631,8 +617,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 
       /** Compute this voxel's contribution to the derivative terms. */
       this->UpdateDerivativeTerms(
-        fixedImageValue, movingImageValue, imageJacobian, nzji,
-        derivativeF, derivativeM, differential );
+        fixedImageValue, movingImageValue, imageJacobian, nzji, derivativeTerms );
 
     } // end if sampleOk
 
@@ -640,11 +625,11 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
-  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sff                   = sff;
-  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Smm                   = smm;
-  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sfm                   = sfm;
-  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sf                    = sf;
-  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sm                    = sm;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sff                   = sff.GetSum();
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Smm                   = smm.GetSum();
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sfm                   = sfm.GetSum();
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sf                    = sf.GetSum();
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sm                    = sm.GetSum();
 
 } // end ThreadedGetValueAndDerivative()
 
@@ -677,19 +662,15 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
 
   /** Accumulate values. */
-  const AccumulateType zero = NumericTraits< AccumulateType >::Zero;
-  AccumulateType       sff  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sff;
-  AccumulateType       smm  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Smm;
-  AccumulateType       sfm  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sfm;
-  AccumulateType       sf   = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sf;
-  AccumulateType       sm   = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sm;
-  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  const AccumulateType     zero = NumericTraits< AccumulateType >::Zero;
+  CompensatedSummationType sffSum, smmSum, sfmSum, sfSum, smSum;
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
   {
-    sff += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sff;
-    smm += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Smm;
-    sfm += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm;
-    sf  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf;
-    sm  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm;
+    sffSum += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sff;
+    smmSum += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Smm;
+    sfmSum += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm;
+    sfSum  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf;
+    smSum  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm;
 
     /** Reset these variables for the next iteration. */
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sff = zero;
@@ -698,15 +679,20 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf  = zero;
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm  = zero;
   }
+  const AccumulateType sf = sfSum.GetSum();
+  const AccumulateType sm = smSum.GetSum();
 
   /** If SubtractMean, then subtract things from sff, smm and sfm. */
   const RealType N = static_cast< RealType >( this->m_NumberOfPixelsCounted );
   if( this->m_SubtractMean )
   {
-    sff -= ( sf * sf / N );
-    smm -= ( sm * sm / N );
-    sfm -= ( sf * sm / N );
+    sffSum -= ( sf * sf / N );
+    smmSum -= ( sm * sm / N );
+    sfmSum -= ( sf * sm / N );
   }
+  const AccumulateType sff = sffSum.GetSum();
+  const AccumulateType smm = smmSum.GetSum();
+  const AccumulateType sfm = sfmSum.GetSum();
 
   /** The denominator of the value and the derivative. */
   const RealType denom = -1.0 * vcl_sqrt( sff * smm );
@@ -716,99 +702,32 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   {
     value = NumericTraits< MeasureType >::Zero;
     derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-    return;
-  }
-
-  /** Calculate the metric value. */
-  value = sfm / denom;
-
-  /** Calculate the metric derivative. */
-  // single-threaded
-  if( !this->m_UseMultiThread && false ) // force multi-threaded
-  {
-    DerivativeType & derivativeF  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeF;
-    DerivativeType & derivativeM  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeM;
-    DerivativeType & differential = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Differential;
-
-    for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
-    {
-      derivativeF  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF;
-      derivativeM  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM;
-      differential += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential;
-    }
 
-    /** If SubtractMean, then subtract things from  derivativeF and derivativeM. */
-    if( this->m_SubtractMean )
-    {
-      double diff, derF, derM;
-      for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
-      {
-        diff            = differential[ i ];
-        derF            = derivativeF[ i ] - ( sf / N ) * diff;
-        derM            = derivativeM[ i ] - ( sm / N ) * diff;
-        derivative[ i ] = ( derF - ( sfm / smm ) * derM ) / denom;
-      }
-    }
-    else
+    /** Reset the derivative terms for the next iteration. */
+    for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
     {
-      for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
-      {
-        derivative[ i ] = ( derivativeF[ i ] - ( sfm / smm ) * derivativeM[ i ] ) / denom;
-      }
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeTerms.Fill(
+        NumericTraits< DerivativeValueType >::ZeroValue() );
     }
+    return;
   }
-  else if( true ) // force !this->m_UseOpenMP ) // multi-threaded using ITK threads
-  {
-    MultiThreaderAccumulateDerivativeType * temp = new MultiThreaderAccumulateDerivativeType;
 
-    temp->st_Metric              = const_cast< Self * >( this );
-    temp->st_sf_N                = sf / N;
-    temp->st_sm_N                = sm / N;
-    temp->st_sfm_smm             = sfm / smm;
-    temp->st_InvertedDenominator = 1.0 / denom;
-    temp->st_DerivativePointer   = derivative.begin();
-
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+  /** Calculate the metric value. */
+  value = sfm / denom;
 
-    delete temp;
-  }
-#ifdef ELASTIX_USE_OPENMP
-  // compute multi-threadedly with openmp
-  else
-  {
-    const int            spaceDimension = static_cast< int >( this->GetNumberOfParameters() );
-    const AccumulateType sf_N           = sf / N;
-    const AccumulateType sm_N           = sm / N;
-    const AccumulateType sfm_smm        = sfm / smm;
+  /** Calculate the metric derivative, multi-threaded using ITK threads. */
+  MultiThreaderAccumulateDerivativeType * temp = new MultiThreaderAccumulateDerivativeType;
 
-    #pragma omp parallel for
-    for( int j = 0; j < spaceDimension; ++j )
-    {
-      DerivativeValueType derivativeF
-        = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeF[ j ];
-      DerivativeValueType derivativeM
-        = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_DerivativeM[ j ];
-      DerivativeValueType differential
-        = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Differential[ j ];
-
-      for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
-      {
-        derivativeF  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF[ j ];
-        derivativeM  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM[ j ];
-        differential += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential[ j ];
-      }
+  temp->st_Metric              = const_cast< Self * >( this );
+  temp->st_sf_N                = sf / N;
+  temp->st_sm_N                = sm / N;
+  temp->st_sfm_smm             = sfm / smm;
+  temp->st_InvertedDenominator = 1.0 / denom;
+  temp->st_DerivativePointer   = derivative.begin();
 
-      if( this->m_SubtractMean )
-      {
-        derivativeF -= sf_N * differential;
-        derivativeM -= sm_N * differential;
-      }
+  this->ExecuteThreaderCallback( AccumulateDerivativesThreaderCallback, temp );
 
-      derivative[ j ] = ( derivativeF - sfm_smm * derivativeM ) / denom;
-    }
-  } // end OpenMP
-#endif
+  delete temp;
 
 } // end AfterThreadedGetValueAndDerivative()
 
@@ -840,23 +759,28 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     vcl_ceil( static_cast< double >( numPar ) / static_cast< double >( nrOfThreads ) ) );
   unsigned int jmin = threadId * subSize;
   unsigned int jmax = ( threadId + 1 ) * subSize;
+  jmin = ( jmin > numPar ) ? numPar : jmin;
   jmax = ( jmax > numPar ) ? numPar : jmax;
 
+  /** Reduce the interleaved derivative terms of all threads in a single
+   * pass, in which they are also reset for the next iteration.
+   */
   const DerivativeValueType zero = NumericTraits< DerivativeValueType >::Zero;
-  DerivativeValueType       derivativeF, derivativeM, differential;
   for( unsigned int j = jmin; j < jmax; ++j )
   {
-    derivativeF = derivativeM = differential = zero;
+    DerivativeValueType derivativeF  = zero;
+    DerivativeValueType derivativeM  = zero;
+    DerivativeValueType differential = zero;
     for( ThreadIdType i = 0; i < nrOfThreads; ++i )
     {
-      derivativeF  += temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF[ j ];
-      derivativeM  += temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM[ j ];
-      differential += temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential[ j ];
-
-      /** Reset these variables for the next iteration. */
-      temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF[ j ]  = zero;
-      temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM[ j ]  = zero;
-      temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential[ j ] = zero;
+      DerivativeValueType * terms
+        = temp->st_Metric->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeTerms.data_block() + 3 * j;
+      derivativeF  += terms[ 0 ];
+      derivativeM  += terms[ 1 ];
+      differential += terms[ 2 ];
+      terms[ 0 ]    = zero;
+      terms[ 1 ]    = zero;
+      terms[ 2 ]    = zero;
     }
 
     if( subtractMean )
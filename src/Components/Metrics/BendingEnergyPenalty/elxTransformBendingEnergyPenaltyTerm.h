@@ -39,6 +39,11 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter Metric: Select this metric as follows:\n
  *    <tt>(Metric "TransformBendingEnergyPenalty")</tt>
+ * \parameter UseAnalyticBendingEnergy: Compute the bending energy exactly from
+ *    the coefficients of a cubic B-spline transform, instead of from the samples.
+ *    The energy is integrated over the fixed image region. Can be given for each
+ *    resolution. Default is "false".\n
+ *    example: <tt>(UseAnalyticBendingEnergy "true")</tt>
  *
  * \ingroup Metrics
  *
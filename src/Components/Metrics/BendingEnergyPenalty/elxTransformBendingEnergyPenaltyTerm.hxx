@@ -62,6 +62,12 @@ TransformBendingEnergyPenalty< TElastix >
     "NumberOfSamplesForSelfHessian", this->GetComponentLabel(), level, 0 );
   this->SetNumberOfSamplesForSelfHessian( numberOfSamplesForSelfHessian );
 
+  /** Compute the bending energy analytically, from the B-spline coefficients. */
+  bool useAnalyticBendingEnergy = false;
+  this->GetConfiguration()->ReadParameter( useAnalyticBendingEnergy,
+    "UseAnalyticBendingEnergy", this->GetComponentLabel(), level, 0 );
+  this->SetUseAnalyticBendingEnergy( useAnalyticBendingEnergy );
+
 } // end BeforeEachResolution()
 
 
@@ -21,6 +21,8 @@
 #include "itkTransformPenaltyTerm.h"
 #include "itkImageGridSampler.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -128,6 +130,9 @@ public:
   /** Define the dimension. */
   itkStaticConstMacro( FixedImageDimension, unsigned int, FixedImageType::ImageDimension );
 
+  /** Initialize the penalty term. */
+  virtual void Initialize( void ) throw ( ExceptionObject );
+
   /** Get the penalty term value. */
   virtual MeasureType GetValue( const ParametersType & parameters ) const;
 
@@ -160,6 +165,15 @@ public:
   itkSetMacro( NumberOfSamplesForSelfHessian, unsigned int );
   itkGetConstMacro( NumberOfSamplesForSelfHessian, unsigned int );
 
+  /** Compute the bending energy of a cubic B-spline transform exactly from
+   * its coefficients, instead of averaging it over the samples. The energy is
+   * integrated over the fixed image region, intersected with the valid region
+   * of the B-spline grid. Default: false.
+   */
+  itkSetMacro( UseAnalyticBendingEnergy, bool );
+  itkGetConstMacro( UseAnalyticBendingEnergy, bool );
+  itkBooleanMacro( UseAnalyticBendingEnergy );
+
 protected:
 
   /** Typedefs for indices and points. */
@@ -187,7 +201,52 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                    // purposely not implemented
 
+  /** Precompute the kernels of the analytic bending energy. */
+  void InitializeAnalyticBendingEnergy( void );
+
+  /** Compute the analytic bending energy, and its derivative if derivative is not NULL. */
+  void ComputeAnalyticBendingEnergy( const ParametersType & parameters,
+    MeasureType & value, DerivativeType * derivative ) const;
+
+  /** The jobs of a pass: apply the kernel of an order along an axis. */
+  struct AnalyticBendingEnergyJobType
+  {
+    const double * st_Input;
+    double *       st_Output;
+    unsigned int   st_Order;
+  };
+
+  /** Apply the kernels of the jobs along an axis, for the grid lines of a thread. */
+  void ThreadedApplyAnalyticKernels( ThreadIdType threadId, ThreadIdType numberOfThreads,
+    const std::vector< AnalyticBendingEnergyJobType > & jobs, unsigned int axis ) const;
+
+  /** Multi-threaded callback for ThreadedApplyAnalyticKernels(). */
+  static ITK_THREAD_RETURN_TYPE ApplyAnalyticKernelsThreaderCallback( void * arg );
+
+  struct BendingEnergyMultiThreaderParameterType
+  {
+    const Self *                                        m_Metric;
+    const std::vector< AnalyticBendingEnergyJobType > * m_Jobs;
+    unsigned int                                        m_Axis;
+  };
+
+  /** Evaluate the cubic B-spline kernel or its first or second derivative. */
+  static double EvaluateCubicBSplineKernel( unsigned int order, double u );
+
   unsigned int m_NumberOfSamplesForSelfHessian;
+  bool         m_UseAnalyticBendingEnergy;
+
+  /** The analytic bending energy is a sum of quadratic forms in the B-spline
+   * coefficients, which are separable over the grid axes. The factor of an
+   * axis is a banded matrix, the integral of the products of the derivatives
+   * of order 0, 1 or 2 of the B-spline basis functions of the coefficients.
+   * m_AnalyticKernels[ axis ][ order ] stores it with 7 bands per coefficient.
+   */
+  typedef std::vector< double > AnalyticKernelType;
+  std::vector< std::vector< AnalyticKernelType > > m_AnalyticKernels;
+  std::vector< SizeValueType >                     m_AnalyticGridSize;
+  std::vector< double >                            m_AnalyticGridSpacing;
+  bool                                             m_AnalyticDomainIsEmpty;
 
 };
 
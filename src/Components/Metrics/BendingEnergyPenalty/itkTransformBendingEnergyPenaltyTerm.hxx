@@ -42,9 +42,424 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 
   this->m_NumberOfSamplesForSelfHessian = 100000;
 
+  /** ThreadedGetValueAndDerivative() marks the derivative blocks that it touches. */
+  this->m_SupportsSparseDerivativeAccumulation = true;
+
+  /** GetValueAndDerivative() only modifies members of this metric. */
+  this->m_SupportsConcurrentEvaluation = true;
+
+  /** The analytic bending energy is off by default. */
+  this->m_UseAnalyticBendingEnergy = false;
+  this->m_AnalyticDomainIsEmpty    = true;
+
 } // end Constructor
 
 
+/**
+ * ******************* Initialize *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::Initialize( void ) throw ( ExceptionObject )
+{
+  /** Call the initialize of the superclass. */
+  this->Superclass::Initialize();
+
+  /** Precompute the kernels of the analytic bending energy. */
+  if( this->m_UseAnalyticBendingEnergy )
+  {
+    this->InitializeAnalyticBendingEnergy();
+  }
+
+} // end Initialize()
+
+
+/**
+ * ******************* InitializeAnalyticBendingEnergy *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::InitializeAnalyticBendingEnergy( void )
+{
+  /** The analytic bending energy is only implemented for cubic B-splines,
+   * which includes the RecursiveBSplineTransform.
+   */
+  BSplineOrder3TransformPointer bspline = 0;
+  if( !this->CheckForBSplineTransform2( bspline ) || bspline.IsNull() )
+  {
+    itkExceptionMacro( << "ERROR: the analytic bending energy requires a cubic B-spline transform." );
+  }
+
+  typedef typename BSplineOrder3TransformType::RegionType    GridRegionType;
+  typedef typename BSplineOrder3TransformType::SpacingType   GridSpacingType;
+  typedef typename BSplineOrder3TransformType::OriginType    GridOriginType;
+  typedef typename BSplineOrder3TransformType::DirectionType GridDirectionType;
+
+  const GridRegionType    gridRegion    = bspline->GetGridRegion();
+  const GridSpacingType   gridSpacing   = bspline->GetGridSpacing();
+  const GridOriginType    gridOrigin    = bspline->GetGridOrigin();
+  const GridDirectionType gridDirection = bspline->GetGridDirection();
+  const typename GridDirectionType::InternalMatrixType directionInverse = gridDirection.GetInverse();
+
+  /** Compute the bounding box of the fixed image region in grid coordinates,
+   * from the corner voxels, and intersect it with the valid grid region.
+   * This box is exact when the grid is aligned with the fixed image.
+   */
+  const FixedImageRegionType & fixedImageRegion = this->GetFixedImageRegion();
+  std::vector< double >        domainBegin( FixedImageDimension, NumericTraits< double >::max() );
+  std::vector< double >        domainEnd( FixedImageDimension, NumericTraits< double >::NonpositiveMin() );
+  for( unsigned int corner = 0; corner < ( 1u << FixedImageDimension ); ++corner )
+  {
+    FixedImageIndexType index = fixedImageRegion.GetIndex();
+    for( unsigned int m = 0; m < FixedImageDimension; ++m )
+    {
+      if( corner & ( 1u << m ) )
+      {
+        index[ m ] += fixedImageRegion.GetSize()[ m ] - 1;
+      }
+    }
+    FixedImagePointType point;
+    this->GetFixedImage()->TransformIndexToPhysicalPoint( index, point );
+
+    for( unsigned int j = 0; j < FixedImageDimension; ++j )
+    {
+      double u = 0.0;
+      for( unsigned int i = 0; i < FixedImageDimension; ++i )
+      {
+        u += directionInverse( j, i ) * ( point[ i ] - gridOrigin[ i ] );
+      }
+      u /= gridSpacing[ j ];
+      domainBegin[ j ] = vnl_math_min( domainBegin[ j ], u );
+      domainEnd[ j ]   = vnl_math_max( domainEnd[ j ], u );
+    }
+  }
+
+  /** The 4-point Gauss-Legendre rule, which is exact for the products of
+   * two cubic polynomials on each knot interval.
+   */
+  const double gaussNodes[ 4 ]   = { -0.8611363115940526, -0.3399810435848563, 0.3399810435848563, 0.8611363115940526 };
+  const double gaussWeights[ 4 ] = { 0.3478548451374538, 0.6521451548625461, 0.6521451548625461, 0.3478548451374538 };
+
+  /** Compute the banded kernels of all axes and derivative orders. The
+   * kernels are normalized by the length of the domain, so that the energy
+   * is the mean over the domain, like the sampled version. For a domain of
+   * zero length the basis functions are evaluated at that point.
+   */
+  this->m_AnalyticKernels.resize( FixedImageDimension );
+  this->m_AnalyticGridSize.resize( FixedImageDimension );
+  this->m_AnalyticGridSpacing.resize( FixedImageDimension );
+  this->m_AnalyticDomainIsEmpty = false;
+  for( unsigned int m = 0; m < FixedImageDimension; ++m )
+  {
+    const long   n         = static_cast< long >( gridRegion.GetSize()[ m ] );
+    const double gridIndex = static_cast< double >( gridRegion.GetIndex()[ m ] );
+    const double begin     = vnl_math_max( domainBegin[ m ], gridIndex + 1.0 );
+    const double end       = vnl_math_min( domainEnd[ m ], gridIndex + static_cast< double >( n - 2 ) );
+    const double length    = end - begin;
+    this->m_AnalyticGridSize[ m ]    = n;
+    this->m_AnalyticGridSpacing[ m ] = gridSpacing[ m ];
+    this->m_AnalyticKernels[ m ].assign( 3, AnalyticKernelType( n * 7, 0.0 ) );
+    if( length < 0.0 )
+    {
+      this->m_AnalyticDomainIsEmpty = true;
+      continue;
+    }
+
+    for( unsigned int order = 0; order < 3; ++order )
+    {
+      AnalyticKernelType & analyticKernel = this->m_AnalyticKernels[ m ][ order ];
+      for( long k = 0; k < n; ++k )
+      {
+        for( long delta = -3; delta <= 3; ++delta )
+        {
+          const long l = k + delta;
+          if( l < 0 || l >= n )
+          {
+            continue;
+          }
+          const double ck = gridIndex + k;
+          const double cl = gridIndex + l;
+
+          /** Integrate the product over the common support within the domain. */
+          double integral = 0.0;
+          if( length > 0.0 )
+          {
+            const double lower = vnl_math_max( begin, vnl_math_max( ck, cl ) - 2.0 );
+            const double upper = vnl_math_min( end, vnl_math_min( ck, cl ) + 2.0 );
+            for( double q = vcl_floor( lower ); q < upper; q += 1.0 )
+            {
+              const double t0        = vnl_math_max( lower, q );
+              const double t1        = vnl_math_min( upper, q + 1.0 );
+              const double halfWidth = 0.5 * ( t1 - t0 );
+              const double center    = 0.5 * ( t1 + t0 );
+              for( unsigned int g = 0; g < 4 && t1 > t0; ++g )
+              {
+                const double t = center + halfWidth * gaussNodes[ g ];
+                integral += gaussWeights[ g ] * halfWidth
+                  * EvaluateCubicBSplineKernel( order, t - ck )
+                  * EvaluateCubicBSplineKernel( order, t - cl );
+              }
+            }
+            integral /= length;
+          }
+          else
+          {
+            integral = EvaluateCubicBSplineKernel( order, begin - ck )
+              * EvaluateCubicBSplineKernel( order, begin - cl );
+          }
+          analyticKernel[ k * 7 + delta + 3 ] = integral;
+        }
+      }
+    }
+  }
+
+} // end InitializeAnalyticBendingEnergy()
+
+
+/**
+ * ******************* ComputeAnalyticBendingEnergy *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::ComputeAnalyticBendingEnergy( const ParametersType & parameters,
+  MeasureType & value, DerivativeType * derivative ) const
+{
+  /** Initialize some variables. */
+  value = NumericTraits< MeasureType >::Zero;
+  if( derivative != NULL )
+  {
+    *derivative = DerivativeType( this->GetNumberOfParameters() );
+    derivative->Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  }
+  if( this->m_AnalyticDomainIsEmpty )
+  {
+    return;
+  }
+
+  SizeValueType numberOfCoefficients = 1;
+  for( unsigned int m = 0; m < FixedImageDimension; ++m )
+  {
+    numberOfCoefficients *= this->m_AnalyticGridSize[ m ];
+  }
+
+  /** The bending energy of every displacement component is the sum over
+   * the pairs ( i, j ) of c^T ( K_ij ) c, where K_ij is the tensor product
+   * of the kernels of derivative order 0, 1 or 2 of the axes, and the order
+   * of an axis is the number of times it occurs in ( i, j ). The kernels
+   * are applied axis by axis, sharing the partial products of the pairs.
+   */
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    const double * coefficients = parameters.data_block() + d * numberOfCoefficients;
+
+    std::vector< std::vector< double > > current( 1 ), next;
+    std::vector< unsigned int >          currentOrder( 1, 0 ), currentOnes( 1, 0 ), nextOrder, nextOnes;
+    std::vector< double >                currentWeight( 1, 1.0 ), nextWeight;
+    current[ 0 ].assign( coefficients, coefficients + numberOfCoefficients );
+
+    for( unsigned int m = 0; m < FixedImageDimension; ++m )
+    {
+      /** The orders of the partial products after this axis. The total
+       * order should be 2 after the last axis.
+       */
+      const double squaredSpacing = this->m_AnalyticGridSpacing[ m ] * this->m_AnalyticGridSpacing[ m ];
+      nextOrder.clear(); nextOnes.clear(); nextWeight.clear();
+      std::vector< unsigned int > inputOfNext, orderOfNext;
+      for( unsigned int t = 0; t < current.size(); ++t )
+      {
+        const unsigned int lowest = ( m == FixedImageDimension - 1 ) ? 2 - currentOrder[ t ] : 0;
+        for( unsigned int order = lowest; order <= 2 - currentOrder[ t ]; ++order )
+        {
+          inputOfNext.push_back( t );
+          orderOfNext.push_back( order );
+          nextOrder.push_back( currentOrder[ t ] + order );
+          nextOnes.push_back( currentOnes[ t ] + ( order == 1 ? 1 : 0 ) );
+          double weight = currentWeight[ t ];
+          for( unsigned int o = 0; o < order; ++o )
+          {
+            weight /= squaredSpacing;
+          }
+          nextWeight.push_back( weight );
+        }
+      }
+
+      /** Apply the kernels along this axis. */
+      next.assign( inputOfNext.size(), std::vector< double >( numberOfCoefficients ) );
+      std::vector< AnalyticBendingEnergyJobType > jobs( inputOfNext.size() );
+      for( unsigned int j = 0; j < inputOfNext.size(); ++j )
+      {
+        jobs[ j ].st_Input  = &( current[ inputOfNext[ j ] ][ 0 ] );
+        jobs[ j ].st_Output = &( next[ j ][ 0 ] );
+        jobs[ j ].st_Order  = orderOfNext[ j ];
+      }
+      if( this->m_UseMultiThread )
+      {
+        /** The jobs are passed to the threads, so that concurrent evaluations
+         * of this metric do not share them. */
+        BendingEnergyMultiThreaderParameterType threaderParameters;
+        threaderParameters.m_Metric = this;
+        threaderParameters.m_Jobs   = &jobs;
+        threaderParameters.m_Axis   = m;
+        this->ExecuteThreaderCallback( this->ApplyAnalyticKernelsThreaderCallback, &threaderParameters );
+      }
+      else
+      {
+        this->ThreadedApplyAnalyticKernels( 0, 1, jobs, m );
+      }
+
+      current.swap( next );
+      currentOrder.swap( nextOrder );
+      currentOnes.swap( nextOnes );
+      currentWeight.swap( nextWeight );
+    }
+
+    /** Sum the pairs: the mixed derivatives occur twice in the Hessian. */
+    for( unsigned int t = 0; t < current.size(); ++t )
+    {
+      currentWeight[ t ] *= ( currentOnes[ t ] == 2 ) ? 2.0 : 1.0;
+    }
+    for( SizeValueType k = 0; k < numberOfCoefficients; ++k )
+    {
+      double y = 0.0;
+      for( unsigned int t = 0; t < current.size(); ++t )
+      {
+        y += currentWeight[ t ] * current[ t ][ k ];
+      }
+      value += coefficients[ k ] * y;
+      if( derivative != NULL )
+      {
+        ( *derivative )[ d * numberOfCoefficients + k ] = 2.0 * y;
+      }
+    }
+  }
+
+} // end ComputeAnalyticBendingEnergy()
+
+
+/**
+ * ******************* ThreadedApplyAnalyticKernels *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedApplyAnalyticKernels( ThreadIdType threadId, ThreadIdType numberOfThreads,
+  const std::vector< AnalyticBendingEnergyJobType > & jobs, unsigned int axis ) const
+{
+  /** The lines along the axis, and their stride. */
+  const long    n      = static_cast< long >( this->m_AnalyticGridSize[ axis ] );
+  SizeValueType stride = 1, numberOfLines = 1;
+  for( unsigned int m = 0; m < FixedImageDimension; ++m )
+  {
+    if( m < axis ) { stride *= this->m_AnalyticGridSize[ m ]; }
+    if( m != axis ) { numberOfLines *= this->m_AnalyticGridSize[ m ]; }
+  }
+
+  /** Get the lines of this thread. */
+  const SizeValueType numberOfLinesPerThread = static_cast< SizeValueType >(
+    vcl_ceil( static_cast< double >( numberOfLines ) / static_cast< double >( numberOfThreads ) ) );
+  const SizeValueType begin = vnl_math_min( threadId * numberOfLinesPerThread, numberOfLines );
+  const SizeValueType end   = vnl_math_min( ( threadId + 1 ) * numberOfLinesPerThread, numberOfLines );
+
+  for( unsigned int j = 0; j < jobs.size(); ++j )
+  {
+    const double * input  = jobs[ j ].st_Input;
+    double *       output = jobs[ j ].st_Output;
+    const double * kernel = &( this->m_AnalyticKernels[ axis ][ jobs[ j ].st_Order ][ 0 ] );
+    for( SizeValueType line = begin; line < end; ++line )
+    {
+      const SizeValueType base = ( line % stride ) + ( line / stride ) * stride * n;
+      for( long k = 0; k < n; ++k )
+      {
+        const double * band     = kernel + k * 7 + 3;
+        const long     deltaMin = vnl_math_max( -3L, -k );
+        const long     deltaMax = vnl_math_min( 3L, n - 1 - k );
+        double         sum      = 0.0;
+        for( long delta = deltaMin; delta <= deltaMax; ++delta )
+        {
+          sum += band[ delta ] * input[ base + ( k + delta ) * stride ];
+        }
+        output[ base + k * stride ] = sum;
+      }
+    }
+  }
+
+} // end ThreadedApplyAnalyticKernels()
+
+
+/**
+ * **************** ApplyAnalyticKernelsThreaderCallback *******
+ */
+
+template< class TFixedImage, class TScalarType >
+ITK_THREAD_RETURN_TYPE
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::ApplyAnalyticKernelsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId        = infoStruct->ThreadID;
+  ThreadIdType     numberOfThreads = infoStruct->NumberOfThreads;
+
+  BendingEnergyMultiThreaderParameterType * temp
+    = static_cast< BendingEnergyMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedApplyAnalyticKernels( threadId, numberOfThreads,
+    *( temp->m_Jobs ), temp->m_Axis );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ApplyAnalyticKernelsThreaderCallback()
+
+
+/**
+ * **************** EvaluateCubicBSplineKernel *******
+ */
+
+template< class TFixedImage, class TScalarType >
+double
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::EvaluateCubicBSplineKernel( unsigned int order, double u )
+{
+  const double absU = vnl_math_abs( u );
+  if( absU >= 2.0 )
+  {
+    return 0.0;
+  }
+
+  if( order == 0 )
+  {
+    if( absU < 1.0 )
+    {
+      return ( 4.0 - 6.0 * absU * absU + 3.0 * absU * absU * absU ) / 6.0;
+    }
+    return ( 2.0 - absU ) * ( 2.0 - absU ) * ( 2.0 - absU ) / 6.0;
+  }
+  else if( order == 1 )
+  {
+    if( absU < 1.0 )
+    {
+      return -2.0 * u + 1.5 * u * absU;
+    }
+    return ( u < 0.0 ? 0.5 : -0.5 ) * ( 2.0 - absU ) * ( 2.0 - absU );
+  }
+  else
+  {
+    if( absU < 1.0 )
+    {
+      return 3.0 * absU - 2.0;
+    }
+    return 2.0 - absU;
+  }
+
+} // end EvaluateCubicBSplineKernel()
+
+
 /**
  * ****************** GetValue *******************************
  */
@@ -54,6 +469,14 @@ typename TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >::MeasureT
 TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 ::GetValue( const ParametersType & parameters ) const
 {
+  /** The analytic bending energy does not use the samples. */
+  if( this->m_UseAnalyticBendingEnergy )
+  {
+    MeasureType value = NumericTraits< MeasureType >::Zero;
+    this->ComputeAnalyticBendingEnergy( parameters, value, NULL );
+    return value;
+  }
+
   /** Initialize some variables. */
   this->m_NumberOfPixelsCounted = 0;
   RealType           measure = NumericTraits< RealType >::Zero;
@@ -368,6 +791,12 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
   const ParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
+  /** The analytic bending energy does not use the samples. */
+  if( this->m_UseAnalyticBendingEnergy )
+  {
+    return this->ComputeAnalyticBendingEnergy( parameters, value, &derivative );
+  }
+
   /** Option for now to still use the single threaded code. */
   if( !this->m_UseMultiThread )
   {
@@ -408,10 +837,13 @@ void
 TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Create and initialize some variables. */
+  /** Create and initialize some variables. The nonzero Jacobian indices
+   * use the pre-allocated scratch buffer of this thread.
+   */
   SpatialHessianType           spatialHessian;
   JacobianOfSpatialHessianType jacobianOfSpatialHessian;
-  NonZeroJacobianIndicesType   nonZeroJacobianIndices;
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NonZeroJacobianIndices;
   const NumberOfParametersType numberOfNonZeroJacobianIndices
     = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
   jacobianOfSpatialHessian.resize( numberOfNonZeroJacobianIndices );
@@ -572,6 +1004,9 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
           }
         }
       } // end if B-spline
+
+      this->MarkTouchedDerivativeBlocks( threadId, nonZeroJacobianIndices );
+
     }   // end if sampleOk
   }     // end for loop over the image sample container
 
@@ -638,9 +1073,8 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
     this->m_ThreaderMetricParameters.st_NormalizationFactor
       = static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -31,6 +31,9 @@ namespace itk
  *  and a fixed point-set.
  *  Correspondence is needed.
  *
+ * The points are divided over the threads, which transform them, and
+ * compute their Jacobians, in chunks of PointChunkSize points with the
+ * batched TransformPoints() and GetJacobians() of the transform.
  *
  * \ingroup RegistrationMetrics
  */
@@ -79,6 +82,9 @@ public:
 
   typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
 
+  typedef typename Superclass::ThreadInfoType              ThreadInfoType;
+  typedef typename Superclass::TransformParametersValueType TransformParametersValueType;
+
   /**  Get the value for single valued optimizers. */
   MeasureType GetValue( const TransformParametersType & parameters ) const;
 
@@ -95,6 +101,30 @@ protected:
   CorrespondingPointsEuclideanDistancePointMetric();
   virtual ~CorrespondingPointsEuclideanDistancePointMetric() {}
 
+  /** Typedefs for multi-threading. */
+  typedef typename Superclass::MultiThreaderParameterType           MultiThreaderParameterType;
+  typedef typename Superclass::GetValueAndDerivativePerThreadStruct GetValueAndDerivativePerThreadStruct;
+
+  /** The number of points that is passed at once to the transform. */
+  itkStaticConstMacro( PointChunkSize, unsigned int, 32 );
+
+  /** Add the distances, and when m_ComputeDerivative is true their
+   * derivatives, of the part of the points of this thread to the
+   * per-thread variables.
+   */
+  void ThreadedGetValueAndDerivative( const ThreadIdType threadId,
+    const ThreadIdType numberOfThreads ) const;
+
+  /** Multi-threaded version of ThreadedGetValueAndDerivative(). */
+  static ITK_THREAD_RETURN_TYPE GetValueAndDerivativeThreaderCallback( void * arg );
+
+  /** Launch the threads and gather the value and the number of points counted. */
+  void LaunchGetValueAndDerivativeThreaderCallback( const ThreadIdType numberOfThreads,
+    MeasureType & measure ) const;
+
+  /** Whether the threads compute the derivative, or only the value. */
+  mutable bool m_ComputeDerivative;
+
 private:
 
   CorrespondingPointsEuclideanDistancePointMetric( const Self & ); // purposely not implemented
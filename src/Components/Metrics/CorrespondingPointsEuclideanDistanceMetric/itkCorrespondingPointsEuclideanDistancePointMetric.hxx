@@ -19,6 +19,7 @@
 #define __itkCorrespondingPointsEuclideanDistancePointMetric_hxx
 
 #include "itkCorrespondingPointsEuclideanDistancePointMetric.h"
+#include "vnl/vnl_math.h"
 
 namespace itk
 {
@@ -30,7 +31,12 @@ namespace itk
 template< class TFixedPointSet, class TMovingPointSet >
 CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
 ::CorrespondingPointsEuclideanDistancePointMetric()
-{} // end Constructor
+{
+  /** GetValueAndDerivative() only modifies members of this metric. */
+  this->m_SupportsConcurrentEvaluation = true;
+  this->m_ComputeDerivative            = false;
+
+} // end Constructor
 
 /**
  * ******************* GetValue *******************
@@ -54,57 +60,26 @@ CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet
     itkExceptionMacro( << "Moving point set has not been assigned" );
   }
 
-  /** Initialize some variables. */
-  this->m_NumberOfPointsCounted = 0;
-  MeasureType     measure = NumericTraits< MeasureType >::Zero;
-  InputPointType  movingPoint;
-  OutputPointType fixedPoint, mappedPoint;
+  if( movingPointSet->GetNumberOfPoints() < fixedPointSet->GetNumberOfPoints() )
+  {
+    itkExceptionMacro( << "The moving point set has fewer points than the fixed point set" );
+  }
 
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  /** Create iterators. */
-  PointIterator pointItFixed  = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointItMoving = movingPointSet->GetPoints()->Begin();
-  PointIterator pointEnd      = fixedPointSet->GetPoints()->End();
+  /** Let the threads compute the value of their part of the points. */
+  const ThreadIdType numberOfThreads
+    = this->GetNumberOfThreadsForPoints( fixedPointSet->GetNumberOfPoints() );
+  this->m_ComputeDerivative = false;
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  this->LaunchGetValueAndDerivativeThreaderCallback( numberOfThreads, measure );
 
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
+  if( this->m_NumberOfPointsCounted > 0 )
   {
-    /** Get the current corresponding points. */
-    fixedPoint  = pointItFixed.Value();
-    movingPoint = pointItMoving.Value();
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    //bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-    mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
-
-    /** Check if point is inside mask. */
-    bool sampleOk = true;
-    if( sampleOk )
-    {
-      //sampleOk = this->IsInsideMovingMask( mappedPoint );
-      if( this->m_MovingImageMask.IsNotNull() )
-      {
-        sampleOk = this->m_MovingImageMask->IsInside( mappedPoint );
-      }
-    }
-
-    if( sampleOk )
-    {
-      this->m_NumberOfPointsCounted++;
-
-      VnlVectorType diffPoint = ( movingPoint - mappedPoint ).GetVnlVector();
-      measure += diffPoint.magnitude();
-
-    } // end if sampleOk
-
-    ++pointItFixed;
-    ++pointItMoving;
-
-  } // end loop over all corresponding points
-
-  return measure / this->m_NumberOfPointsCounted;
+    measure /= this->m_NumberOfPointsCounted;
+  }
+  return measure;
 
 } // end GetValue()
 
@@ -153,17 +128,10 @@ CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet
     itkExceptionMacro( << "Moving point set has not been assigned" );
   }
 
-  /** Initialize some variables */
-  this->m_NumberOfPointsCounted = 0;
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
-  derivative = DerivativeType( this->GetNumberOfParameters() );
-  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  NonZeroJacobianIndicesType nzji(
-  this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-  TransformJacobianType jacobian;
-
-  InputPointType  movingPoint;
-  OutputPointType fixedPoint, mappedPoint;
+  if( movingPointSet->GetNumberOfPoints() < fixedPointSet->GetNumberOfPoints() )
+  {
+    itkExceptionMacro( << "The moving point set has fewer points than the fixed point set" );
+  }
 
   /** Call non-thread-safe stuff, such as:
    *   this->SetTransformParameters( parameters );
@@ -180,86 +148,201 @@ CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
-  /** Create iterators. */
-  PointIterator pointItFixed  = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointItMoving = movingPointSet->GetPoints()->Begin();
-  PointIterator pointEnd      = fixedPointSet->GetPoints()->End();
+  /** Let the threads compute the value and derivative of their part of the points. */
+  const ThreadIdType numberOfThreads
+    = this->GetNumberOfThreadsForPoints( fixedPointSet->GetNumberOfPoints() );
+  this->m_ComputeDerivative = true;
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  this->LaunchGetValueAndDerivativeThreaderCallback( numberOfThreads, measure );
 
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
+  /** Check if enough samples were valid. */
+//   this->CheckNumberOfSamples(
+//     fixedPointSet->GetNumberOfPoints(), this->m_NumberOfPointsCounted );
+
+  /** Merge the per-thread derivatives and divide by the number of points. */
+  derivative = DerivativeType( this->GetNumberOfParameters() );
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor
+    = this->m_NumberOfPointsCounted > 0 ? this->m_NumberOfPointsCounted : 1;
+  this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    &this->m_ThreaderMetricParameters, numberOfThreads );
+
+  /** Copy the measure to value. */
+  value = measure;
+  if( this->m_NumberOfPointsCounted > 0 )
   {
-    /** Get the current corresponding points. */
-    fixedPoint  = pointItFixed.Value();
-    movingPoint = pointItMoving.Value();
+    value = measure / this->m_NumberOfPointsCounted;
+  }
+
+} // end GetValueAndDerivative()
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    //bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-    mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
 
-    /** Check if point is inside mask. */
-    bool sampleOk = true;
-    if( sampleOk )
+/**
+ * ******************* LaunchGetValueAndDerivativeThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
+::LaunchGetValueAndDerivativeThreaderCallback( const ThreadIdType numberOfThreads,
+  MeasureType & measure ) const
+{
+  this->InitializeThreadingParameters( numberOfThreads );
+  this->ExecuteThreaderCallback( Self::GetValueAndDerivativeThreaderCallback,
+    &this->m_ThreaderMetricParameters, numberOfThreads );
+
+  /** Gather the values and the number of points counted, in thread order. */
+  this->m_NumberOfPointsCounted = 0;
+  measure                       = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPointsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPointsCounted;
+    measure                       += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+  }
+
+} // end LaunchGetValueAndDerivativeThreaderCallback()
+
+
+/**
+ * ******************* GetValueAndDerivativeThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
+::GetValueAndDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = static_cast< const Self * >( temp->st_Metric );
+
+  metric->ThreadedGetValueAndDerivative( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end GetValueAndDerivativeThreaderCallback()
+
+
+/**
+ * ******************* ThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
+::ThreadedGetValueAndDerivative( const ThreadIdType threadId,
+  const ThreadIdType numberOfThreads ) const
+{
+  typedef typename FixedPointSetType::PointsContainer  FixedPointsContainerType;
+  typedef typename MovingPointSetType::PointsContainer MovingPointsContainerType;
+  const FixedPointsContainerType *  fixedPoints  = this->m_FixedPointSet->GetPoints();
+  const MovingPointsContainerType * movingPoints = this->m_MovingPointSet->GetPoints();
+
+  /** Get the part of the points of this thread. */
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  this->SplitRangeForThread( this->m_FixedPointSet->GetNumberOfPoints(),
+    threadId, numberOfThreads, begin, end );
+
+  GetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+
+  /** The scratch buffers for the Jacobians of a chunk of points. */
+  const bool          computeDerivative = this->m_ComputeDerivative;
+  const unsigned long nnzji             = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const unsigned long jacobianSize      = Self::MovingPointSetDimension * nnzji;
+  if( computeDerivative )
+  {
+    perThread.st_Jacobians.resize( PointChunkSize * jacobianSize );
+    perThread.st_NonZeroJacobianIndices.resize( PointChunkSize * nnzji );
+  }
+  DerivativeValueType * derivative = perThread.st_Derivative.data_block();
+
+  InputPointType  fixedChunk[ PointChunkSize ];
+  OutputPointType mappedChunk[ PointChunkSize ];
+  SizeValueType   validChunkIndices[ PointChunkSize ];
+  MeasureType     measure = NumericTraits< MeasureType >::Zero;
+  SizeValueType   numberOfPointsCounted = 0;
+
+  /** Loop over the corresponding points, a chunk at a time. */
+  for( SizeValueType chunkBegin = begin; chunkBegin < end; chunkBegin += PointChunkSize )
+  {
+    const SizeValueType chunkSize = vnl_math_min(
+      end - chunkBegin, static_cast< SizeValueType >( PointChunkSize ) );
+    for( SizeValueType i = 0; i < chunkSize; ++i )
     {
-      //sampleOk = this->IsInsideMovingMask( mappedPoint );
-      if( this->m_MovingImageMask.IsNotNull() )
+      fixedChunk[ i ] = fixedPoints->ElementAt( chunkBegin + i );
+    }
+    this->m_Transform->TransformPoints( fixedChunk, chunkSize, mappedChunk );
+
+    /** Check if the points are inside the moving mask, and keep only those,
+     * so that the Jacobians are only computed of the valid points.
+     */
+    SizeValueType numberOfValidPoints = 0;
+    for( SizeValueType i = 0; i < chunkSize; ++i )
+    {
+      if( this->m_MovingImageMask.IsNull() || this->m_MovingImageMask->IsInside( mappedChunk[ i ] ) )
       {
-        sampleOk = this->m_MovingImageMask->IsInside( mappedPoint );
+        fixedChunk[ numberOfValidPoints ]        = fixedChunk[ i ];
+        validChunkIndices[ numberOfValidPoints ] = i;
+        ++numberOfValidPoints;
       }
     }
 
-    if( sampleOk )
+    /** Get the TransformJacobians dT/dmu of the valid points. */
+    if( computeDerivative && numberOfValidPoints > 0 )
     {
-      this->m_NumberOfPointsCounted++;
+      this->m_Transform->GetJacobians( fixedChunk, numberOfValidPoints,
+        &( perThread.st_Jacobians[ 0 ] ), &( perThread.st_NonZeroJacobianIndices[ 0 ] ) );
+    }
 
-      /** Get the TransformJacobian dT/dmu. */
-      //this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-      this->m_Transform->GetJacobian( fixedPoint, jacobian, nzji );
+    for( SizeValueType p = 0; p < numberOfValidPoints; ++p )
+    {
+      const SizeValueType                                i           = validChunkIndices[ p ];
+      const typename MovingPointsContainerType::Element & movingPoint = movingPoints->ElementAt( chunkBegin + i );
 
-      VnlVectorType diffPoint = ( movingPoint - mappedPoint ).GetVnlVector();
-      MeasureType   distance  = diffPoint.magnitude();
+      double diffPoint[ Self::MovingPointSetDimension ];
+      double squaredDistance = 0.0;
+      for( unsigned int d = 0; d < Self::MovingPointSetDimension; ++d )
+      {
+        diffPoint[ d ]   = movingPoint[ d ] - mappedChunk[ i ][ d ];
+        squaredDistance += diffPoint[ d ] * diffPoint[ d ];
+      }
+      const MeasureType distance = vcl_sqrt( squaredDistance );
       measure += distance;
+      ++numberOfPointsCounted;
 
       /** Calculate the contributions to the derivatives with respect to each parameter. */
-      if( distance > vcl_numeric_limits< MeasureType >::epsilon() )
+      if( computeDerivative && distance > vcl_numeric_limits< MeasureType >::epsilon() )
       {
-        VnlVectorType diff_2 = diffPoint / distance;
-        if( nzji.size() == this->GetNumberOfParameters() )
+        for( unsigned int d = 0; d < Self::MovingPointSetDimension; ++d )
         {
-          /** Loop over all Jacobians. */
-          derivative -= diff_2 * jacobian;
+          diffPoint[ d ] /= distance;
         }
-        else
+
+        /** Only pick the nonzero Jacobians, which is all of them for a dense Jacobian. */
+        const TransformParametersValueType * jacobian = &( perThread.st_Jacobians[ p * jacobianSize ] );
+        const unsigned long *                nzji     = &( perThread.st_NonZeroJacobianIndices[ p * nnzji ] );
+        for( unsigned long k = 0; k < nnzji; ++k )
         {
-          /** Only pick the nonzero Jacobians. */
-          for( unsigned int i = 0; i < nzji.size(); ++i )
+          double sum = 0.0;
+          for( unsigned int d = 0; d < Self::MovingPointSetDimension; ++d )
           {
-            const unsigned int index  = nzji[ i ];
-            VnlVectorType      column = jacobian.get_column( i );
-            derivative[ index ] -= dot_product( diff_2, column );
+            sum += diffPoint[ d ] * jacobian[ d * nnzji + k ];
           }
+          derivative[ nzji[ k ] ] -= sum;
         }
+        this->MarkTouchedDerivativeBlocks( threadId, nzji, nnzji );
       } // end if distance != 0
-
-    } // end if sampleOk
-
-    ++pointItFixed;
-    ++pointItMoving;
-
+    }
   } // end loop over all corresponding points
 
-  /** Check if enough samples were valid. */
-//   this->CheckNumberOfSamples(
-//     fixedPointSet->GetNumberOfPoints(), this->m_NumberOfPointsCounted );
-
-  /** Copy the measure to value. */
-  value = measure;
-  if( this->m_NumberOfPointsCounted > 0 )
-  {
-    derivative /= this->m_NumberOfPointsCounted;
-    value       = measure / this->m_NumberOfPointsCounted;
-  }
+  perThread.st_Value                 = measure;
+  perThread.st_NumberOfPointsCounted = numberOfPointsCounted;
 
-} // end GetValueAndDerivative()
+} // end ThreadedGetValueAndDerivative()
 
 
 } // end namespace itk
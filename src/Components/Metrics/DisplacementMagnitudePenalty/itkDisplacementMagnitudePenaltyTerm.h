@@ -103,6 +103,9 @@ public:
    */
   virtual MeasureType GetValue( const ParametersType & parameters ) const;
 
+  /** Get the penalty term value, without threads. */
+  virtual MeasureType GetValueSingleThreaded( const ParametersType & parameters ) const;
+
   /** Get the penalty term derivative.
    * Simply calls GetValueAndDerivative and returns the derivative. */
   virtual void GetDerivative( const ParametersType & parameters,
@@ -117,6 +120,25 @@ public:
     MeasureType & value,
     DerivativeType & derivative ) const;
 
+  /** Get the penalty term value and derivative, without threads. */
+  virtual void GetValueAndDerivativeSingleThreaded(
+    const ParametersType & parameters,
+    MeasureType & value,
+    DerivativeType & derivative ) const;
+
+  /** Get value for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID );
+
+  /** Gather the values from all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const;
+
+  /** Get value and derivatives for each thread. */
+  inline void ThreadedGetValueAndDerivative( ThreadIdType threadID );
+
+  /** Gather the values and derivatives from all threads. */
+  inline void AfterThreadedGetValueAndDerivative(
+    MeasureType & value, DerivativeType & derivative ) const;
+
 protected:
 
   /** Typedefs for indices and points. */
@@ -127,6 +149,7 @@ protected:
   typedef typename Superclass::MovingImagePointType           MovingImagePointType;
   typedef typename Superclass::MovingImageContinuousIndexType MovingImageContinuousIndexType;
   typedef typename Superclass::NonZeroJacobianIndicesType     NonZeroJacobianIndicesType;
+  typedef typename Superclass::NumberOfParametersType         NumberOfParametersType;
 
   /** The constructor. */
   DisplacementMagnitudePenaltyTerm();
@@ -37,6 +37,12 @@ DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
   /** Turn on the sampler functionality */
   this->SetUseImageSampler( true );
 
+  /** ThreadedGetValueAndDerivative() marks the derivative blocks that it touches. */
+  this->m_SupportsSparseDerivativeAccumulation = true;
+
+  /** GetValueAndDerivative() only modifies members of this metric. */
+  this->m_SupportsConcurrentEvaluation = true;
+
 } // end constructor
 
 
@@ -58,13 +64,13 @@ DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
 */
 
 /**
- * ****************** GetValue *******************************
+ * ****************** GetValueSingleThreaded *******************************
  */
 
 template< class TFixedImage, class TScalarType >
 typename DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >::MeasureType
 DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
-::GetValue( const ParametersType & parameters ) const
+::GetValueSingleThreaded( const ParametersType & parameters ) const
 {
   /** Initialize some variables. */
   this->m_NumberOfPixelsCounted = 0;
@@ -124,9 +130,156 @@ DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
   /** Return the value. */
   return static_cast< MeasureType >( measure );
 
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ****************** GetValue *******************************
+ */
+
+template< class TFixedImage, class TScalarType >
+typename DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >::MeasureType
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::GetValue( const ParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * See GetValueAndDerivative() for the use in the CombinationImageToImageMetric.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the metric values from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
 } // end GetValue()
 
 
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create iterator over the sample container. */
+  typename ImageSampleContainerType::ConstIterator fiter;
+  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+  fbegin                                                 += (int)pos_begin;
+  fend                                                   += (int)pos_end;
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Loop over the fixed image samples to calculate the penalty term. */
+  for( fiter = fbegin; fiter != fend; ++fiter )
+  {
+    /** Read fixed coordinates and initialize some variables. */
+    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    MovingImagePointType        mappedPoint;
+
+    /** Transform point and check if it is inside the B-spline support region. */
+    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+
+    /** Check if point is inside mask. */
+    if( sampleOk )
+    {
+      sampleOk = this->IsInsideMovingMask( mappedPoint );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      /** Compute the contribution of this point: ||T(x)-x||^2
+      * \todo FixedImageDimension should be MovingImageDimension  */
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        measure += vnl_math_sqr( mappedPoint[ d ] - fixedPoint[ d ] );
+      }
+
+    } // end if sampleOk
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = 0;
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Accumulate values, in thread order. */
+  value = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    value += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
+  }
+
+  /** Update measure value. Avoid division by zero. */
+  value /= vnl_math_max( NumericTraits< RealType >::One,
+    static_cast< RealType >( this->m_NumberOfPixelsCounted ) );
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -146,13 +299,13 @@ DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
 
 
 /**
- * ****************** GetValueAndDerivative *******************************
+ * ****************** GetValueAndDerivativeSingleThreaded *******************************
  */
 
 template< class TFixedImage, class TScalarType >
 void
 DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
-::GetValueAndDerivative(
+::GetValueAndDerivativeSingleThreaded(
   const ParametersType & parameters,
   MeasureType & value,
   DerivativeType & derivative ) const
@@ -253,9 +406,189 @@ DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
   /** The return value. */
   value = static_cast< MeasureType >( measure );
 
+} // end GetValueAndDerivativeSingleThreaded()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::GetValueAndDerivative(
+  const ParametersType & parameters,
+  MeasureType & value,
+  DerivativeType & derivative ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueAndDerivativeSingleThreaded(
+      parameters, value, derivative );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValueAndDerivative itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
+   *   calling GetValueAndDerivative
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValueAndDerivative multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueAndDerivativeThreaderCallback();
+
+  /** Gather the metric values and derivatives from all threads. */
+  this->AfterThreadedGetValueAndDerivative( value, derivative );
+
 } // end GetValueAndDerivative()
 
 
+/**
+ * ******************* ThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::ThreadedGetValueAndDerivative( ThreadIdType threadId )
+{
+  typedef typename MovingImagePointType::VectorType VectorType;
+
+  /** The Jacobian and the nonzero Jacobian indices use the pre-allocated
+   * scratch buffers of this thread.
+   */
+  TransformJacobianType & jacobian
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TransformJacobian;
+  NonZeroJacobianIndicesType & nzji
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NonZeroJacobianIndices;
+  const NumberOfParametersType nrNonZeroJacobianIndices
+    = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
+  nzji.resize( nrNonZeroJacobianIndices );
+
+  /** Get a handle to the pre-allocated derivative for the current thread.
+   * The initialization is performed at the beginning of each resolution in
+   * InitializeThreadingParameters(), and at the end of each iteration in
+   * AfterThreadedGetValueAndDerivative() and the accumulate functions.
+   */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create iterator over the sample container. */
+  typename ImageSampleContainerType::ConstIterator fiter;
+  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+  fbegin                                                 += (int)pos_begin;
+  fend                                                   += (int)pos_end;
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Loop over the fixed image to calculate the penalty term and its derivative. */
+  for( fiter = fbegin; fiter != fend; ++fiter )
+  {
+    /** Read fixed coordinates and initialize some variables. */
+    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    MovingImagePointType        mappedPoint;
+
+    /** Transform point and check if it is inside the B-spline support region. */
+    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+
+    /** Check if point is inside mask. */
+    if( sampleOk )
+    {
+      sampleOk = this->IsInsideMovingMask( mappedPoint );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      /** Get the TransformJacobian dT/dmu. */
+      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+
+      /** Compute displacement */
+      const VectorType vec = mappedPoint - fixedPoint;
+
+      /** Compute the contribution to the metric value of this point. */
+      measure += vec.GetSquaredNorm();
+
+      /** Compute the contribution to the derivative; (T(x)-x)' dT/dmu
+       * \todo FixedImageDimension should be MovingImageDimension  */
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        const double vecd = vec[ d ];
+        for( unsigned int i = 0; i < nrNonZeroJacobianIndices; ++i )
+        {
+          derivative[ nzji[ i ] ] += vecd * jacobian( d, i );
+        }
+      }
+
+      this->MarkTouchedDerivativeBlocks( threadId, nzji );
+
+    } // end if sampleOk
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValueAndDerivative()
+
+
+/**
+ * ******************* AfterThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+DisplacementMagnitudePenaltyTerm< TFixedImage, TScalarType >
+::AfterThreadedGetValueAndDerivative(
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** The value and the number of pixels. */
+  this->AfterThreadedGetValue( value );
+
+  /** Accumulate the derivatives. The factor 2 in the derivative
+   * originates from the square in ||T(x)-x||^2.
+   */
+  const RealType normalizationConstant = vnl_math_max(
+    NumericTraits< RealType >::One,
+    static_cast< RealType >( this->m_NumberOfPixelsCounted ) );
+  derivative.SetSize( this->GetNumberOfParameters() );
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor
+    = static_cast< DerivativeValueType >( normalizationConstant / 2.0 );
+
+  this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+
+} // end AfterThreadedGetValueAndDerivative()
+
+
 } // end namespace itk
 
 #endif // #ifndef __itkDisplacementMagnitudePenaltyTerm_hxx
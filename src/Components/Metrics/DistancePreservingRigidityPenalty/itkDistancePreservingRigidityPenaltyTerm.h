@@ -33,6 +33,8 @@
 #include "itkImageRegionIterator.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
 
+#include <vector>
+
 namespace itk
 {
 /**
@@ -213,6 +215,39 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                        // purposely not implemented
 
+  /** Typedefs for multi-threading. */
+  typedef typename Superclass::ThreadInfoType ThreadInfoType;
+
+  /** Precompute the neighbour pairs, their reference distances and the
+   * B-spline weights of the penalty grid points. Called by Initialize().
+   */
+  void InitializeNeighbourPairs( void );
+
+  /** Transform the penalty grid points of a thread. */
+  void ThreadedTransformPoints( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Compute the value, and if derivative is not NULL also the derivative,
+   * over the neighbour pairs of a thread.
+   */
+  MeasureType ThreadedComputePairs( ThreadIdType threadId, ThreadIdType numberOfThreads,
+    DerivativeValueType * derivative ) const;
+
+  /** Compute the value and optionally the derivative over all pairs. */
+  void ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const;
+
+  /** Multi-threaded callbacks. */
+  static ITK_THREAD_RETURN_TYPE TransformPointsThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputePairsThreaderCallback( void * arg );
+
+  struct DistancePreservingRigidityPenaltyTermMultiThreaderParameterType
+  {
+    Self * m_Metric;
+    bool   m_ComputeDerivative;
+  };
+
+  mutable DistancePreservingRigidityPenaltyTermMultiThreaderParameterType m_DistancePreservingThreaderParameters;
+
   /** Member variables. */
   BSplineTransformPointer m_BSplineTransform;
 
@@ -225,6 +260,24 @@ private:
 
   unsigned int m_NumberOfRigidGrids;
 
+  /** The neighbour pairs in compressed sparse row format. Row r belongs to
+   * the rigid penalty grid point m_RowPointIndices[ r ] and contains the
+   * pairs m_RowOffsets[ r ] to m_RowOffsets[ r + 1 ]. Of every pair the
+   * neighbour point and the squared reference distance are stored.
+   */
+  typedef typename PenaltyGridImageType::PointType PenaltyGridPointType;
+  std::vector< PenaltyGridPointType > m_PenaltyGridPoints;
+  std::vector< unsigned long >        m_RowOffsets;
+  std::vector< unsigned long >        m_RowPointIndices;
+  std::vector< MeasureType >          m_RowWeights;
+  std::vector< unsigned long >        m_PairPointIndices;
+  std::vector< MeasureType >          m_PairReferenceDistances;
+
+  /** The 4^3 B-spline weights and parameter indices of every point. */
+  std::vector< MeasureType >             m_PointWeights;
+  std::vector< unsigned long >           m_PointParameterIndices;
+  mutable std::vector< OutputPointType > m_MappedPenaltyGridPoints;
+
 };
 
 // end class DistancePreservingRigidityPenaltyTerm
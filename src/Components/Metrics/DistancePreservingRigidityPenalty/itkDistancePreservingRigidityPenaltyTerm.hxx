@@ -49,6 +49,11 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
   /** We don't use an image sampler for this advanced metric. */
   this->SetUseImageSampler( false );
 
+  /** Initialize the threader parameters. */
+  this->m_DistancePreservingThreaderParameters.m_Metric            = this;
+  this->m_DistancePreservingThreaderParameters.m_ComputeDerivative = true;
+  this->m_SupportsSparseDerivativeAccumulation                     = true;
+
 } // end Constructor
 
 
@@ -153,120 +158,198 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
     }
     ++ki;
   }
+
+  /** Precompute the neighbour pairs of the rigid penalty grid points. */
+  this->InitializeNeighbourPairs();
+
 } // end Initialize()
 
 
 /**
- * *********************** GetValue *****************************
+ * *********************** InitializeNeighbourPairs *****************************
  */
 
 template< class TFixedImage, class TScalarType >
-typename DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >::MeasureType
+void
 DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
-::GetValue( const ParametersType & parameters ) const
+::InitializeNeighbourPairs( void )
 {
-  /** Set output values to zero. */
-  this->m_RigidityPenaltyTermValue = NumericTraits< MeasureType >::Zero;
-
-  //this->SetTransformParameters( parameters );
-  this->m_BSplineTransform->SetParameters( parameters );
+  this->m_PenaltyGridPoints.clear();
+  this->m_RowOffsets.assign( 1, 0 );
+  this->m_RowPointIndices.clear();
+  this->m_RowWeights.clear();
+  this->m_PairPointIndices.clear();
+  this->m_PairReferenceDistances.clear();
+  this->m_PointWeights.clear();
+  this->m_PointParameterIndices.clear();
+
+  /** The penalty is only implemented for 3D. */
+  if( MovingImageDimension != 3 || this->m_NumberOfRigidGrids == 0 )
+  {
+    return;
+  }
 
-  /** distance-preserving penalty computation */
-  MeasureType penaltyTerm       = 0.0;
-  MeasureType penaltyTermBuffer = 0.0;
+  /** Look up the label of every penalty grid point once. */
+  const PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
+  const SizeValueType              numberOfGridPoints     = penaltyGridImageRegion.GetNumberOfPixels();
 
-  MeasureType dx = 0.0;
-  MeasureType dX = 0.0;
+  typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
+  typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
+  segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
 
   typedef itk::ImageRegionConstIteratorWithIndex< PenaltyGridImageType > PenaltyGridIteratorType;
-  PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
-
   PenaltyGridIteratorType pgi( this->m_PenaltyGridImage, penaltyGridImageRegion );
 
-  typename PenaltyGridImageType::IndexType penaltyGridIndex, neighborPenaltyGridIndex;
-  typename PenaltyGridImageType::PointType penaltyGridPoint, neighborPenaltyGridPoint, xn, xf;
-
-  typename TransformType::OutputVectorType dd_dx, dd_dy, dd_dz;
+  std::vector< unsigned int >         labels( numberOfGridPoints );
+  std::vector< PenaltyGridPointType > gridPoints( numberOfGridPoints );
+  SizeValueType                       offset = 0;
+  for( pgi.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++offset )
+  {
+    this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( pgi.GetIndex(), gridPoints[ offset ] );
+    labels[ offset ] = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( gridPoints[ offset ] ) );
+  }
 
+  /** Create the rows. Neighbours outside the penalty grid are skipped. */
   typedef itk::ConstNeighborhoodIterator< PenaltyGridImageType > NeighborhoodIteratorType;
   typename NeighborhoodIteratorType::RadiusType radius;
   radius.Fill( 1 );
   NeighborhoodIteratorType ni( radius, this->m_PenaltyGridImage, penaltyGridImageRegion );
-  unsigned int             numberOfNeighborhood = ni.Size();
-
-  unsigned int numberOfRigidGridsNeighbor;
-
-  // interpolation of segmented image
-  typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
-  typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
+  const unsigned int       numberOfNeighborhood = ni.Size();
 
-  segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
-
-  unsigned int pixelValue, pixelValueNeighbor;
-
-  /** Penalty term computation */
-  if( MovingImageDimension == 3 )
+  std::vector< long >          pointIndexOfGridPoint( numberOfGridPoints, -1 );
+  std::vector< unsigned long > neighbours;
+  neighbours.reserve( numberOfNeighborhood );
+  offset = 0;
+  for( pgi.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++offset )
   {
-    for( pgi.GoToBegin(), ni.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++ni )
+    const unsigned int pixelValue = labels[ offset ];
+    if( pixelValue == 0 || pixelValue >= 6 )
     {
-      penaltyGridIndex = pgi.GetIndex();
+      continue;
+    }
 
-      this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( penaltyGridIndex, penaltyGridPoint );
+    /** Find the neighbours with the same label, including the point itself. */
+    ni.SetLocation( pgi.GetIndex() );
+    neighbours.clear();
+    unsigned int numberOfRigidGridsNeighbor = 0;
+    for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
+    {
+      const typename PenaltyGridImageType::IndexType neighborIndex = ni.GetIndex( kk );
+      if( !penaltyGridImageRegion.IsInside( neighborIndex ) )
+      {
+        continue;
+      }
+      const SizeValueType neighborOffset = this->m_PenaltyGridImage->ComputeOffset( neighborIndex );
+      if( labels[ neighborOffset ] == pixelValue )
+      {
+        ++numberOfRigidGridsNeighbor;
 
-      ni.SetLocation( penaltyGridIndex );
+        /** The pair of the point with itself does not contribute. */
+        if( neighborOffset != offset )
+        {
+          neighbours.push_back( neighborOffset );
+        }
+      }
+    }
+    if( numberOfRigidGridsNeighbor <= 1 )
+    {
+      continue;
+    }
 
-      pixelValue = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
+    /** Add the row and its pairs. */
+    for( unsigned int kk = 0; kk <= neighbours.size(); ++kk )
+    {
+      const SizeValueType gridOffset = kk < neighbours.size() ? neighbours[ kk ] : offset;
+      if( pointIndexOfGridPoint[ gridOffset ] < 0 )
+      {
+        pointIndexOfGridPoint[ gridOffset ] = static_cast< long >( this->m_PenaltyGridPoints.size() );
+        this->m_PenaltyGridPoints.push_back( gridPoints[ gridOffset ] );
+      }
+    }
 
-      if( pixelValue > 0 && pixelValue < 6 )
+    const PenaltyGridPointType & penaltyGridPoint = gridPoints[ offset ];
+    this->m_RowPointIndices.push_back( pointIndexOfGridPoint[ offset ] );
+    this->m_RowWeights.push_back( 1.0 / numberOfRigidGridsNeighbor / this->m_NumberOfRigidGrids );
+    for( unsigned int kk = 0; kk < neighbours.size(); ++kk )
+    {
+      const PenaltyGridPointType & neighborPenaltyGridPoint = gridPoints[ neighbours[ kk ] ];
+      MeasureType                  dX                       = 0.0;
+      for( unsigned int d = 0; d < 3; ++d )
       {
-        numberOfRigidGridsNeighbor = 0;
+        dX += ( neighborPenaltyGridPoint[ d ] - penaltyGridPoint[ d ] )
+          * ( neighborPenaltyGridPoint[ d ] - penaltyGridPoint[ d ] );
+      }
+      this->m_PairPointIndices.push_back( pointIndexOfGridPoint[ neighbours[ kk ] ] );
+      this->m_PairReferenceDistances.push_back( dX );
+    }
+    this->m_RowOffsets.push_back( this->m_PairPointIndices.size() );
+  }
 
-        for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-        {
-          neighborPenaltyGridIndex = ni.GetIndex( kk );
+  /** Precompute the B-spline weights and the parameter indices of the points. */
+  typedef itk::BSplineKernelFunction< 3 > BSplineKernelFunctionType;
+  BSplineKernelFunctionType::Pointer bSplineKernel = BSplineKernelFunctionType::New();
 
-          this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
+  typedef itk::BSplineInterpolationWeightFunction< double, ImageDimension, 3 > WeightsFunctionType;
+  typedef typename WeightsFunctionType::ContinuousIndexType                    ContinuousIndexType;
+  typedef double                                                               ContinuousIndexValueType;
 
-          pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+  typename BSplineKnotImageType::SizeType bSplineKnotImageSize = this->m_BSplineKnotImage->GetBufferedRegion().GetSize();
 
-          if( pixelValue == pixelValueNeighbor )
-          {
-            numberOfRigidGridsNeighbor++;
-          }
-        }
+  const SizeValueType numberOfPoints = this->m_PenaltyGridPoints.size();
+  this->m_PointWeights.resize( numberOfPoints * 64 );
+  this->m_PointParameterIndices.resize( numberOfPoints * 64 );
+  this->m_MappedPenaltyGridPoints.resize( numberOfPoints );
+  ContinuousIndexType tindex, ntindex_start;
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( this->m_PenaltyGridPoints[ i ], tindex );
+    for( unsigned dd = 0; dd < ImageDimension; dd++ )
+    {
+      ntindex_start[ dd ] = static_cast< ContinuousIndexValueType >( floor( tindex[ dd ] ) ) - 1.0;
+    }
 
-        if( numberOfRigidGridsNeighbor > 1 )
+    unsigned int mu = 0;
+    for( unsigned int kk = 0; kk < 4; ++kk )
+    {
+      const ContinuousIndexValueType p = ntindex_start[ 2 ] + kk;
+      for( unsigned int jj = 0; jj < 4; ++jj )
+      {
+        const ContinuousIndexValueType n = ntindex_start[ 1 ] + jj;
+        for( unsigned int ii = 0; ii < 4; ++ii, ++mu )
         {
-          for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-          {
-            neighborPenaltyGridIndex = ni.GetIndex( kk );
-
-            this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
+          const ContinuousIndexValueType m = ntindex_start[ 0 ] + ii;
+          this->m_PointWeights[ i * 64 + mu ] = ( bSplineKernel->Evaluate( tindex[ 0 ] - m ) )
+            * ( bSplineKernel->Evaluate( tindex[ 1 ] - n ) )
+            * ( bSplineKernel->Evaluate( tindex[ 2 ] - p ) );
+          this->m_PointParameterIndices[ i * 64 + mu ]
+            = static_cast< unsigned int >( m ) + bSplineKnotImageSize[ 0 ] * static_cast< unsigned int >( n )
+            + bSplineKnotImageSize[ 0 ] * bSplineKnotImageSize[ 1 ] * static_cast< unsigned int >( p );
+        }
+      }
+    }
+  }
 
-            pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+} // end InitializeNeighbourPairs()
 
-            if( pixelValue == pixelValueNeighbor )
-            {
-              xn = this->m_Transform->TransformPoint( neighborPenaltyGridPoint );
-              xf = this->m_Transform->TransformPoint( penaltyGridPoint );
 
-              dX = ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] ) * ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] )
-                + ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] ) * ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] )
-                + ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] ) * ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] );
+/**
+ * *********************** GetValue *****************************
+ */
 
-              dx = ( xn[ 0 ] - xf[ 0 ] ) * ( xn[ 0 ] - xf[ 0 ] )
-                + ( xn[ 1 ] - xf[ 1 ] ) * ( xn[ 1 ] - xf[ 1 ] )
-                + ( xn[ 2 ] - xf[ 2 ] ) * ( xn[ 2 ] - xf[ 2 ] );
+template< class TFixedImage, class TScalarType >
+typename DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >::MeasureType
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::GetValue( const ParametersType & parameters ) const
+{
+  /** Set output values to zero. */
+  this->m_RigidityPenaltyTermValue = NumericTraits< MeasureType >::Zero;
 
-              penaltyTermBuffer = ( dx - dX ) * ( dx - dX );
+  //this->SetTransformParameters( parameters );
+  this->m_BSplineTransform->SetParameters( parameters );
 
-              penaltyTerm += penaltyTermBuffer / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-            }
-          } // end for
-        }   // end if
-      }     // end if
-    }       // end for
-  }         // end if ( dimension = 3 )
+  /** Distance-preserving penalty computation over the neighbour pairs. */
+  MeasureType penaltyTerm = NumericTraits< MeasureType >::Zero;
+  this->ComputeValueAndDerivative( penaltyTerm, NULL );
 
   /** Return the rigidity penalty term value. */
   return penaltyTerm;
@@ -309,188 +392,228 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
 
   this->m_BSplineTransform->SetParameters( parameters );
 
-  /** Distance-preserving penalty */
-  MeasureType penaltyTermBuffer   = 0.0;
-  MeasureType derivativeTermTemp1 = 0.0, derivativeTermTemp2 = 0.0, derivativeTermTemp3 = 0.0;
+  /** Distance-preserving penalty over the neighbour pairs. */
+  this->ComputeValueAndDerivative( value, &derivative );
 
-  unsigned int par1, par2;
-
-  MeasureType dX = 0.0;
-  MeasureType dx = 0.0;
+} // end GetValueAndDerivative()
 
-  typename PenaltyGridImageType::IndexType penaltyGridIndex, neighborPenaltyGridIndex;
-  typename PenaltyGridImageType::PointType penaltyGridPoint, neighborPenaltyGridPoint, xn, xf;
 
-  typedef itk::BSplineKernelFunction< 3 > BSplineKernelFunctionType;
-  BSplineKernelFunctionType::Pointer bSplineKernel = BSplineKernelFunctionType::New();
+/**
+ * *********************** ComputeValueAndDerivative ****************
+ */
 
-  typedef itk::BSplineInterpolationWeightFunction< double, ImageDimension, 3 > WeightsFunctionType;
-  typedef typename WeightsFunctionType::ContinuousIndexType                    ContinuousIndexType;
-  typedef double                                                               ContinuousIndexValueType;
+template< class TFixedImage, class TScalarType >
+void
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const
+{
+  value = NumericTraits< MeasureType >::Zero;
 
-  ContinuousIndexType      tindex, neighbor_tindex, neighbor_tindex_start;
-  ContinuousIndexValueType tx, ty, tz;
+  /** Single-threadedly transform the points and loop over the pairs. */
+  if( !this->m_UseMultiThread )
+  {
+    this->ThreadedTransformPoints( 0, 1 );
+    value = this->ThreadedComputePairs( 0, 1,
+      derivative != NULL ? derivative->data_block() : NULL );
+    return;
+  }
 
-  ContinuousIndexValueType m, n, p, neighbor_m, neighbor_n, neighbor_p;
+  /** Transform the points, and then loop over the pairs. Both are split
+   * over the threads, with a barrier in between.
+   */
+  this->m_DistancePreservingThreaderParameters.m_ComputeDerivative = ( derivative != NULL );
+  void * userData = const_cast< void * >( static_cast< const void * >(
+    &this->m_DistancePreservingThreaderParameters ) );
+  this->ExecuteThreaderCallback( this->TransformPointsThreaderCallback, userData );
+  this->ExecuteThreaderCallback( this->ComputePairsThreaderCallback, userData );
+
+  /** Accumulate the values. */
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    value += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
 
-  typedef itk::ImageRegionConstIteratorWithIndex< PenaltyGridImageType > PenaltyGridIteratorType;
-  PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
-  PenaltyGridIteratorType    pgi( this->m_PenaltyGridImage, penaltyGridImageRegion );
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
+  }
 
-  // neighborhood iterator
-  typedef itk::ConstNeighborhoodIterator< PenaltyGridImageType > NeighborhoodIteratorType;
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType ni( radius, this->m_PenaltyGridImage, penaltyGridImageRegion );
-  unsigned int             numberOfNeighborhood = ni.Size();
+  /** Accumulate the derivatives multi-threadedly, which also resets them. */
+  if( derivative != NULL )
+  {
+    this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative->begin();
+    this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
 
-  ContinuousIndexType      tindex_neighbor, ntindex_start, ntindex_neighbor_start;
-  ContinuousIndexValueType tx_neighbor, ty_neighbor, tz_neighbor;
+    this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  }
 
-  typename BSplineKnotImageType::SizeType bSplineKnotImageSize = this->m_BSplineKnotImage->GetBufferedRegion().GetSize();
+} // end ComputeValueAndDerivative()
 
-  MeasureType du_dC, du_dC_neighbor;
 
-  unsigned int numberOfRigidGridsNeighbor;
+/**
+ * *********************** ThreadedTransformPoints ****************
+ */
 
-  const unsigned int parametersDimension            = this->GetNumberOfParameters();
-  unsigned int       numberOfParametersPerDimension = parametersDimension / ImageDimension;
+template< class TFixedImage, class TScalarType >
+void
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedTransformPoints( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Get the points of this thread. */
+  const SizeValueType numberOfPoints          = this->m_PenaltyGridPoints.size();
+  const SizeValueType numberOfPointsPerThread = static_cast< SizeValueType >(
+    vcl_ceil( static_cast< double >( numberOfPoints ) / static_cast< double >( numberOfThreads ) ) );
+  const SizeValueType begin = vnl_math_min( threadId * numberOfPointsPerThread, numberOfPoints );
+  const SizeValueType end   = vnl_math_min( ( threadId + 1 ) * numberOfPointsPerThread, numberOfPoints );
+
+  for( SizeValueType i = begin; i < end; ++i )
+  {
+    this->m_MappedPenaltyGridPoints[ i ] = this->m_Transform->TransformPoint( this->m_PenaltyGridPoints[ i ] );
+  }
 
-  // interpolation of segmented image
-  typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
-  typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
+} // end ThreadedTransformPoints()
 
-  segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
 
-  unsigned int pixelValue, pixelValueNeighbor;
+/**
+ * *********************** ThreadedComputePairs ****************
+ */
 
-  if( MovingImageDimension == 3 )
+template< class TFixedImage, class TScalarType >
+typename DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >::MeasureType
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedComputePairs( ThreadIdType threadId, ThreadIdType numberOfThreads,
+  DerivativeValueType * derivative ) const
+{
+  /** Get the rows of this thread. */
+  const SizeValueType numberOfRows          = this->m_RowPointIndices.size();
+  const SizeValueType numberOfRowsPerThread = static_cast< SizeValueType >(
+    vcl_ceil( static_cast< double >( numberOfRows ) / static_cast< double >( numberOfThreads ) ) );
+  const SizeValueType begin = vnl_math_min( threadId * numberOfRowsPerThread, numberOfRows );
+  const SizeValueType end   = vnl_math_min( ( threadId + 1 ) * numberOfRowsPerThread, numberOfRows );
+
+  const unsigned int numberOfParametersPerDimension = this->GetNumberOfParameters() / ImageDimension;
+  const bool         markTouchedBlocks              = derivative != NULL && this->m_UseMultiThread
+    && this->m_UseSparseDerivativeAccumulation;
+
+  MeasureType penaltyTerm = NumericTraits< MeasureType >::Zero;
+  for( SizeValueType r = begin; r < end; ++r )
   {
-    for( pgi.GoToBegin(), ni.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++ni )
-    {
-      penaltyGridIndex = pgi.GetIndex();
+    const unsigned long     pointIndex = this->m_RowPointIndices[ r ];
+    const OutputPointType & xf         = this->m_MappedPenaltyGridPoints[ pointIndex ];
+    const MeasureType       rowWeight  = this->m_RowWeights[ r ];
 
-      this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( penaltyGridIndex, penaltyGridPoint );
-
-      pixelValue = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
+    for( unsigned long pair = this->m_RowOffsets[ r ]; pair < this->m_RowOffsets[ r + 1 ]; ++pair )
+    {
+      const unsigned long     neighborIndex = this->m_PairPointIndices[ pair ];
+      const OutputPointType & xn            = this->m_MappedPenaltyGridPoints[ neighborIndex ];
+      const MeasureType       dX            = this->m_PairReferenceDistances[ pair ];
 
-      ni.SetLocation( penaltyGridIndex );
+      const MeasureType dx = ( xn[ 0 ] - xf[ 0 ] ) * ( xn[ 0 ] - xf[ 0 ] )
+        + ( xn[ 1 ] - xf[ 1 ] ) * ( xn[ 1 ] - xf[ 1 ] )
+        + ( xn[ 2 ] - xf[ 2 ] ) * ( xn[ 2 ] - xf[ 2 ] );
 
-      /** Penalty term calculation */
-      if( pixelValue > 0 && pixelValue < 6 )
+      penaltyTerm += ( dx - dX ) * ( dx - dX ) * rowWeight;
+      if( derivative == NULL )
       {
-        numberOfRigidGridsNeighbor = 0;
+        continue;
+      }
 
-        for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-        {
-          neighborPenaltyGridIndex = ni.GetIndex( kk );
+      const MeasureType derivativeTermTemp1 = 4 * ( dx - dX ) * ( xn[ 0 ] - xf[ 0 ] ) * rowWeight;
+      const MeasureType derivativeTermTemp2 = 4 * ( dx - dX ) * ( xn[ 1 ] - xf[ 1 ] ) * rowWeight;
+      const MeasureType derivativeTermTemp3 = 4 * ( dx - dX ) * ( xn[ 2 ] - xf[ 2 ] ) * rowWeight;
 
-          this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
+      /** Neighbourhood of (i',j',k') and of (i,j,k), respectively. */
+      const MeasureType *   du_dC_neighbor = &( this->m_PointWeights[ neighborIndex * 64 ] );
+      const unsigned long * par1           = &( this->m_PointParameterIndices[ neighborIndex * 64 ] );
+      const MeasureType *   du_dC          = &( this->m_PointWeights[ pointIndex * 64 ] );
+      const unsigned long * par2           = &( this->m_PointParameterIndices[ pointIndex * 64 ] );
+      for( unsigned int mu = 0; mu < 64; ++mu )
+      {
+        derivative[ par1[ mu ] ]                                      += derivativeTermTemp1 * du_dC_neighbor[ mu ];
+        derivative[ par1[ mu ] + numberOfParametersPerDimension ]     += derivativeTermTemp2 * du_dC_neighbor[ mu ];
+        derivative[ par1[ mu ] + 2 * numberOfParametersPerDimension ] += derivativeTermTemp3 * du_dC_neighbor[ mu ];
 
-          pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+        derivative[ par2[ mu ] ]                                      -= derivativeTermTemp1 * du_dC[ mu ];
+        derivative[ par2[ mu ] + numberOfParametersPerDimension ]     -= derivativeTermTemp2 * du_dC[ mu ];
+        derivative[ par2[ mu ] + 2 * numberOfParametersPerDimension ] -= derivativeTermTemp3 * du_dC[ mu ];
+      }
+    }
 
-          if( pixelValue == pixelValueNeighbor )
+    /** Mark the derivative blocks of the point and its neighbours as touched. */
+    if( markTouchedBlocks && this->m_RowOffsets[ r ] < this->m_RowOffsets[ r + 1 ] )
+    {
+      unsigned char * touched
+        = &( this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedDerivativeBlocks[ 0 ] );
+      for( unsigned long pair = this->m_RowOffsets[ r ]; pair <= this->m_RowOffsets[ r + 1 ]; ++pair )
+      {
+        const unsigned long   index = pair < this->m_RowOffsets[ r + 1 ] ? this->m_PairPointIndices[ pair ] : pointIndex;
+        const unsigned long * par   = &( this->m_PointParameterIndices[ index * 64 ] );
+        for( unsigned int mu = 0; mu < 64; ++mu )
+        {
+          for( unsigned int d = 0; d < ImageDimension; ++d )
           {
-            numberOfRigidGridsNeighbor++;
+            touched[ ( par[ mu ] + d * numberOfParametersPerDimension ) >> Superclass::DerivativeBlockSizeLog2 ] = 1;
           }
         }
+      }
+    }
+  }
 
-        if( numberOfRigidGridsNeighbor > 1 )
-        {
-          for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-          {
-            neighborPenaltyGridIndex = ni.GetIndex( kk );
-
-            this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
-
-            pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
-
-            if( pixelValue == pixelValueNeighbor )
-            {
-              xn = this->m_Transform->TransformPoint( neighborPenaltyGridPoint );
-              xf = this->m_Transform->TransformPoint( penaltyGridPoint );
-
-              dX = ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] ) * ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] )
-                + ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] ) * ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] )
-                + ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] ) * ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] );
-
-              dx = ( xn[ 0 ] - xf[ 0 ] ) * ( xn[ 0 ] - xf[ 0 ] )
-                + ( xn[ 1 ] - xf[ 1 ] ) * ( xn[ 1 ] - xf[ 1 ] )
-                + ( xn[ 2 ] - xf[ 2 ] ) * ( xn[ 2 ] - xf[ 2 ] );
-
-              penaltyTermBuffer = ( dx - dX ) * ( dx - dX );
-
-              value += penaltyTermBuffer / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
+  return penaltyTerm;
 
-              // find neighboring B-Spline control points
-              this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( penaltyGridPoint, tindex );
-              this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( neighborPenaltyGridPoint, tindex_neighbor );
+} // end ThreadedComputePairs()
 
-              tx = tindex[ 0 ];
-              ty = tindex[ 1 ];
-              tz = tindex[ 2 ];
 
-              tx_neighbor = tindex_neighbor[ 0 ];
-              ty_neighbor = tindex_neighbor[ 1 ];
-              tz_neighbor = tindex_neighbor[ 2 ];
+/**
+ * **************** TransformPointsThreaderCallback *******
+ */
 
-              for( unsigned dd = 0; dd < ImageDimension; dd++ )
-              {
-                ntindex_start[ dd ]          = static_cast< ContinuousIndexValueType >( floor( tindex[ dd ] ) ) - 1.0;
-                ntindex_neighbor_start[ dd ] = static_cast< ContinuousIndexValueType >( floor( tindex_neighbor[ dd ] ) ) - 1.0;
-              }
+template< class TFixedImage, class TScalarType >
+ITK_THREAD_RETURN_TYPE
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::TransformPointsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId        = infoStruct->ThreadID;
+  ThreadIdType     numberOfThreads = infoStruct->NumberOfThreads;
 
-              derivativeTermTemp1 = 4 * ( dx - dX ) * ( xn[ 0 ] - xf[ 0 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-              derivativeTermTemp2 = 4 * ( dx - dX ) * ( xn[ 1 ] - xf[ 1 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-              derivativeTermTemp3 = 4 * ( dx - dX ) * ( xn[ 2 ] - xf[ 2 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
+  DistancePreservingRigidityPenaltyTermMultiThreaderParameterType * temp
+    = static_cast< DistancePreservingRigidityPenaltyTermMultiThreaderParameterType * >( infoStruct->UserData );
 
-              for( unsigned int kk = 0; kk < 4; ++kk )
-              {
-                p          = ntindex_start[ 2 ] + kk;
-                neighbor_p = ntindex_neighbor_start[ 2 ] + kk;
+  temp->m_Metric->ThreadedTransformPoints( threadId, numberOfThreads );
 
-                for( unsigned int jj = 0; jj < 4; ++jj )
-                {
-                  n          = ntindex_start[ 1 ] + jj;
-                  neighbor_n = ntindex_neighbor_start[ 1 ] + jj;
+  return ITK_THREAD_RETURN_VALUE;
 
-                  for( unsigned int ii = 0; ii < 4; ++ii )
-                  {
-                    m          = ntindex_start[ 0 ] + ii;
-                    neighbor_m = ntindex_neighbor_start[ 0 ] + ii;
+} // end TransformPointsThreaderCallback()
 
-                    // neighborhood of (i',j',k')
-                    du_dC_neighbor = ( bSplineKernel->Evaluate( tx_neighbor - neighbor_m ) ) * ( bSplineKernel->Evaluate( ty_neighbor - neighbor_n ) )
-                      * ( bSplineKernel->Evaluate( tz_neighbor - neighbor_p ) );
 
-                    par1 = static_cast< unsigned int >( neighbor_m ) + bSplineKnotImageSize[ 0 ] * static_cast< unsigned int >( neighbor_n )
-                      + bSplineKnotImageSize[ 0 ] * bSplineKnotImageSize[ 1 ] * static_cast< unsigned int >( neighbor_p );
+/**
+ * **************** ComputePairsThreaderCallback *******
+ */
 
-                    derivative[ par1 ]                                      += derivativeTermTemp1 * du_dC_neighbor;
-                    derivative[ par1 + numberOfParametersPerDimension ]     += derivativeTermTemp2 * du_dC_neighbor;
-                    derivative[ par1 + 2 * numberOfParametersPerDimension ] += derivativeTermTemp3 * du_dC_neighbor;
+template< class TFixedImage, class TScalarType >
+ITK_THREAD_RETURN_TYPE
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ComputePairsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId        = infoStruct->ThreadID;
+  ThreadIdType     numberOfThreads = infoStruct->NumberOfThreads;
 
-                    // neighborhood of (i,j,k)
-                    du_dC = ( bSplineKernel->Evaluate( tx - m ) ) * ( bSplineKernel->Evaluate( ty - n ) )
-                      * ( bSplineKernel->Evaluate( tz - p ) );
+  DistancePreservingRigidityPenaltyTermMultiThreaderParameterType * temp
+    = static_cast< DistancePreservingRigidityPenaltyTermMultiThreaderParameterType * >( infoStruct->UserData );
 
-                    par2 = static_cast< unsigned int >( m ) + bSplineKnotImageSize[ 0 ] * static_cast< unsigned int >( n )
-                      + bSplineKnotImageSize[ 0 ] * bSplineKnotImageSize[ 1 ] * static_cast< unsigned int >( p );
+  /** Every thread writes its own copy of the derivative. */
+  DerivativeValueType * derivative = NULL;
+  if( temp->m_ComputeDerivative )
+  {
+    derivative = temp->m_Metric->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative.data_block();
+  }
+  temp->m_Metric->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value
+    = temp->m_Metric->ThreadedComputePairs( threadId, numberOfThreads, derivative );
 
-                    derivative[ par2 ]                                      -= derivativeTermTemp1 * du_dC;
-                    derivative[ par2 + numberOfParametersPerDimension ]     -= derivativeTermTemp2 * du_dC;
-                    derivative[ par2 + 2 * numberOfParametersPerDimension ] -= derivativeTermTemp3 * du_dC;
-                  }
-                }
-              }
-            }
-          } // end for
-        }   // end if
-      }
-    } // end for
-  }   // end if ( dimension = 3 )
+  return ITK_THREAD_RETURN_VALUE;
 
-} // end GetValueAndDerivative()
+} // end ComputePairsThreaderCallback()
 
 
 /**
@@ -44,6 +44,7 @@
 #include "itkOptimizer.h"
 #include "itkAdvancedCombinationTransform.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include <vector>
 
 namespace itk
 {
@@ -111,6 +112,9 @@ public:
   typedef typename Superclass::MovingImageType         MovingImageType;
   typedef typename Superclass::FixedImageConstPointer  FixedImageConstPointer;
   typedef typename Superclass::MovingImageConstPointer MovingImageConstPointer;
+  typedef typename Superclass::FixedImageRegionType    FixedImageRegionType;
+  typedef typename Superclass::FixedImageMaskType      FixedImageMaskType;
+  typedef typename Superclass::ThreadInfoType          ThreadInfoType;
   typedef typename TFixedImage::PixelType              FixedImagePixelType;
   typedef typename TMovingImage::PixelType             MovedImagePixelType;
   typedef typename MovingImageType::RegionType         MovingImageRegionType;
@@ -182,10 +186,22 @@ protected:
   /** Compute the variance and range of the moving image gradients. */
   void ComputeVariance( void ) const;
 
-  /** Compute the similarity measure using a specified subtraction factor. */
+  /** Compute the similarity measure using a specified subtraction factor,
+   * from the current moved image gradients.
+   */
   MeasureType ComputeMeasure( const TransformParametersType & parameters,
     const double * subtractionFactor ) const;
 
+  /** The loops of ComputeMovedGradientRange() and ComputeMeasure() run
+   * multi-threaded; every thread processes a slab of the fixed image region
+   * and stores its results in its own entries of m_ThreaderResults, which
+   * are then combined in order.
+   */
+  void ThreadedComputeGradientTerms( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Static callback for the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputeGradientTermsThreaderCallback( void * arg );
+
   typedef NeighborhoodOperatorImageFilter<
     FixedGradientImageType, FixedGradientImageType > FixedSobelFilter;
 
@@ -239,6 +255,14 @@ private:
   double                      m_Rescalingfactor;
   CombinationTransformPointer m_CombinationTransform;
 
+  /** Variables for ThreadedComputeGradientTerms(): per thread the minimum
+   * and maximum moved gradient, or the measure, for every dimension.
+   */
+  itkStaticConstMacro( NumberOfThreaderResults, unsigned int, 2 * FixedImageDimension );
+  mutable std::vector< MeasureType > m_ThreaderResults;
+  mutable bool                       m_ThreaderComputeMeasure;
+  mutable const double *             m_ThreaderSubtractionFactor;
+
 };
 
 } // end namespace itk
@@ -78,6 +78,9 @@ GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
 
   this->m_DerivativeDelta = 0.001;
   this->m_Rescalingfactor = 1.0;
+
+  this->m_ThreaderComputeMeasure    = false;
+  this->m_ThreaderSubtractionFactor = 0;
 }
 
 
@@ -184,40 +187,141 @@ void
 GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
 ::ComputeMovedGradientRange( void ) const
 {
-  unsigned int           iDimension;
-  MovedGradientPixelType gradient;
+  /** Let the threads compute the range of their slabs. */
+  const ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  this->m_ThreaderComputeMeasure = false;
+  this->m_ThreaderResults.resize( numberOfThreads * NumberOfThreaderResults );
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    for( unsigned int iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
+    {
+      this->m_ThreaderResults[ i * NumberOfThreaderResults + 2 * iDimension ]
+        = NumericTraits< MeasureType >::max();
+      this->m_ThreaderResults[ i * NumberOfThreaderResults + 2 * iDimension + 1 ]
+        = NumericTraits< MeasureType >::NonpositiveMin();
+    }
+  }
 
-  for( iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
+  this->ExecuteThreaderCallback( this->ComputeGradientTermsThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( this ) ) );
+
+  /** Combine the ranges of the threads. */
+  for( unsigned int iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
   {
-    typedef itk::ImageRegionConstIteratorWithIndex<
-      MovedGradientImageType > IteratorType;
+    MeasureType minimum = NumericTraits< MeasureType >::max();
+    MeasureType maximum = NumericTraits< MeasureType >::NonpositiveMin();
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      minimum = vnl_math_min( minimum, this->m_ThreaderResults[ i * NumberOfThreaderResults + 2 * iDimension ] );
+      maximum = vnl_math_max( maximum, this->m_ThreaderResults[ i * NumberOfThreaderResults + 2 * iDimension + 1 ] );
+    }
+    this->m_MinMovedGradient[ iDimension ] = static_cast< MovedGradientPixelType >( minimum );
+    this->m_MaxMovedGradient[ iDimension ] = static_cast< MovedGradientPixelType >( maximum );
+  }
 
-    IteratorType iterate( m_MovedSobelFilters[ iDimension ]->GetOutput(),
-    this->GetFixedImageRegion() );
+} // end ComputeMovedGradientRange()
 
-    gradient = iterate.Get();
 
-    m_MinMovedGradient[ iDimension ] = gradient;
-    m_MaxMovedGradient[ iDimension ] = gradient;
+/**
+ * ******************** ComputeGradientTermsThreaderCallback ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeGradientTermsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const Self *     self       = static_cast< const Self * >( infoStruct->UserData );
 
-    while( !iterate.IsAtEnd() )
+  self->ThreadedComputeGradientTerms( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeGradientTermsThreaderCallback()
+
+
+/**
+ * ******************** ThreadedComputeGradientTerms ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputeGradientTerms( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Get the slab of the fixed image region of this thread. */
+  FixedImageRegionType region;
+  if( !this->SplitFixedImageRegionForThread( this->GetFixedImageRegion(), threadId, numberOfThreads, region ) )
+  {
+    return;
+  }
+
+  typedef ImageRegionConstIteratorWithIndex< FixedGradientImageType > FixedIteratorType;
+  typedef ImageRegionConstIteratorWithIndex< MovedGradientImageType > MovedIteratorType;
+
+  const FixedImageMaskType * fixedMask = this->m_FixedImageMask.GetPointer();
+  MeasureType *              results   = &( this->m_ThreaderResults[ threadId * NumberOfThreaderResults ] );
+  typename FixedImageType::PointType point;
+
+  for( unsigned int iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
+  {
+    MovedIteratorType movedIterator( this->m_MovedSobelFilters[ iDimension ]->GetOutput(), region );
+
+    /** The range of the moved image gradients, over the whole region. */
+    if( !this->m_ThreaderComputeMeasure )
     {
-      gradient = iterate.Get();
+      MeasureType minimum = results[ 2 * iDimension ];
+      MeasureType maximum = results[ 2 * iDimension + 1 ];
+      while( !movedIterator.IsAtEnd() )
+      {
+        const MeasureType gradient = movedIterator.Get();
+        minimum = vnl_math_min( minimum, gradient );
+        maximum = vnl_math_max( maximum, gradient );
+        ++movedIterator;
+      }
+      results[ 2 * iDimension ]     = minimum;
+      results[ 2 * iDimension + 1 ] = maximum;
+      continue;
+    }
+
+    if( this->m_Variance[ iDimension ] == NumericTraits< MovedGradientPixelType >::ZeroValue() )
+    {
+      continue;
+    }
+
+    /** Iterate over the fixed and moving gradient images
+     *  calculating the similarity measure
+     */
+    FixedIteratorType fixedIterator( this->m_FixedSobelFilters[ iDimension ]->GetOutput(), region );
+    const double      subtractionFactor = this->m_ThreaderSubtractionFactor[ iDimension ];
+    MeasureType       measure           = NumericTraits< MeasureType >::Zero;
 
-      if( gradient > m_MaxMovedGradient[ iDimension ] )
+    while( !fixedIterator.IsAtEnd() )
+    {
+      /** if fixedMask is given */
+      bool sampleOK = true;
+      if( fixedMask != 0 )
       {
-        m_MaxMovedGradient[ iDimension ] = gradient;
+        this->m_FixedImage->TransformIndexToPhysicalPoint( fixedIterator.GetIndex(), point );
+        sampleOK = fixedMask->IsInside( point );
       }
 
-      if( gradient < m_MinMovedGradient[ iDimension ] )
+      if( sampleOK )
       {
-        m_MinMovedGradient[ iDimension ] = gradient;
+        const MovedGradientPixelType diff = fixedIterator.Get() - subtractionFactor * movedIterator.Get();
+        measure += this->m_Variance[ iDimension ] / ( this->m_Variance[ iDimension ] + diff * diff );
       }
 
-      ++iterate;
-    }
-  }
-}
+      ++fixedIterator;
+      ++movedIterator;
+    } // end while fixedIterator
+
+    results[ iDimension ] = measure;
+
+  } // end for iDimension
+
+} // end ThreadedComputeGradientTerms()
 
 
 /**
@@ -350,105 +454,30 @@ GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
 template< class TFixedImage, class TMovingImage >
 typename GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
 GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
-::ComputeMeasure( const TransformParametersType & parameters,
+::ComputeMeasure( const TransformParametersType & itkNotUsed( parameters ),
   const double * subtractionFactor ) const
 {
-  /** Call non-thread-safe stuff, such as:
-   *   this->SetTransformParameters( parameters );
-   *   this->GetImageSampler()->Update();
-   * Because of these calls GetValueAndDerivative itself is not thread-safe,
-   * so cannot be called multiple times simultaneously.
-   * This is however needed in the CombinationImageToImageMetric.
-   * In that case, you need to:
-   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
-   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
-   *   calling GetValueAndDerivative
-   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
-   * - Now you can call GetValueAndDerivative multi-threaded.
+  /** The moved image and its gradients are already up-to-date, see GetValue().
+   * Let the threads add up the measure of their slabs.
    */
-  this->BeforeThreadedGetValueAndDerivative( parameters );
-  //this->SetTransformParameters( parameters );
-
-  unsigned int iDimension;
-  this->m_TransformMovingImageFilter->Modified();
-  this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  const ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  this->m_ThreaderComputeMeasure    = true;
+  this->m_ThreaderSubtractionFactor = subtractionFactor;
+  this->m_ThreaderResults.assign( numberOfThreads * NumberOfThreaderResults,
+    NumericTraits< MeasureType >::Zero );
 
-  typename FixedImageType::IndexType currentIndex;
-  typename FixedImageType::PointType point;
+  this->ExecuteThreaderCallback( this->ComputeGradientTermsThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( this ) ) );
 
-  for( iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
+  /** Add the measures of the threads in a fixed order. */
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  for( unsigned int iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
   {
-
-    if( this->m_Variance[ iDimension ] == NumericTraits< MovedGradientPixelType >::ZeroValue() )
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
     {
-      continue;
+      measure += this->m_ThreaderResults[ i * NumberOfThreaderResults + iDimension ];
     }
-
-    /** Iterate over the fixed and moving gradient images
-     *  calculating the similarity measure
-     */
-
-    MovedGradientPixelType movedGradient;
-    FixedGradientPixelType fixedGradient;
-    MovedGradientPixelType diff;
-
-    typedef  itk::ImageRegionConstIteratorWithIndex< FixedGradientImageType >
-      FixedIteratorType;
-
-    FixedIteratorType fixedIterator( this->m_FixedSobelFilters[ iDimension ]->GetOutput(),
-    this->GetFixedImageRegion() );
-
-    typedef  itk::ImageRegionConstIteratorWithIndex< MovedGradientImageType >
-      MovedIteratorType;
-
-    MovedIteratorType movedIterator( this->m_MovedSobelFilters[ iDimension ]->GetOutput(),
-    this->GetFixedImageRegion() );
-
-    this->m_FixedSobelFilters[ iDimension ]->UpdateLargestPossibleRegion();
-    this->m_MovedSobelFilters[ iDimension ]->UpdateLargestPossibleRegion();
-
-    bool sampleOK = false;
-
-    if( this->m_FixedImageMask.IsNull() )
-    {
-      sampleOK = true;
-    }
-
-    while( !fixedIterator.IsAtEnd() )
-    {
-      /** Get current index */
-      currentIndex = fixedIterator.GetIndex();
-      this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
-
-      /** if fixedMask is given */
-      if( !this->m_FixedImageMask.IsNull() )
-      {
-
-        if( this->m_FixedImageMask->IsInside( point ) )   // sample is good
-        {
-          sampleOK = true;
-        }
-        else  // sample no good
-        {
-          sampleOK = false;
-        }
-      }
-
-      if( sampleOK )
-      {
-        movedGradient = movedIterator.Get();
-        fixedGradient = fixedIterator.Get();
-        diff          = fixedGradient - subtractionFactor[ iDimension ] * movedGradient;
-        measure      += this->m_Variance[ iDimension ] / ( this->m_Variance[ iDimension ] + diff * diff );
-
-      } // end if sampleOK
-
-      ++fixedIterator;
-      ++movedIterator;
-    } // end while fixedIterator
-
-  } // end for iDimension
+  }
 
   return measure /= -this->m_Rescalingfactor; //negative for minimization
 
@@ -464,9 +493,26 @@ typename GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >::Meas
 GradientDifferenceImageToImageMetric< TFixedImage, TMovingImage >
 ::GetValue( const TransformParametersType & parameters ) const
 {
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValueAndDerivative itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
+   *   calling GetValueAndDerivative
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValueAndDerivative multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Project the moving image once. The resample filter itself is
+   * multi-threaded over the fixed image.
+   */
   unsigned int iFilter;
   unsigned int iDimension;
-  this->SetTransformParameters( parameters );
   this->m_TransformMovingImageFilter->Modified();
   this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
 
@@ -37,7 +37,10 @@ namespace elastix
  *    Choose a value between 0.0 and 1.0. The default is 0.5.
  * \parameter TreeType: The type of the kNN binary tree. \n
  *    <tt>(TreeType "BDTree" "BruteForceTree")</tt> \n
- *    Choose one of { KDTree, BDTree, BruteForceTree }. \n
+ *    Choose one of { KDTree, BDTree, BruteForceTree, TiledBruteForceTree }. \n
+ *    The TiledBruteForceTree is an exact brute force search that does not use ANN,
+ *    and which is often faster than the other trees for high dimensional features.
+ *    It ignores the TreeSearchType, ErrorBound and SquaredSearchRadius. \n
  *    The default is "KDTree" for all resolutions.
  * \parameter BucketSize: The maximum number of samples in one bucket. \n
  *    This parameter influences the calculation time only, and is not appropiate for the BruteForceTree. \n
@@ -70,6 +73,11 @@ namespace elastix
  * \parameter AvoidDivisionBy: a small number to avoid division by zero in the implentation. \n
  *    <tt>(AvoidDivisionBy 0.000000001)</tt> \n
  *    The default is 1e-5.
+ * \parameter UseFusedMovingImageEvaluation: evaluate all moving (feature) images with
+ *    one set of B-spline weights per sample. This is only done when all moving images
+ *    share their geometry and interpolator spline order; the result is the same. \n
+ *    <tt>(UseFusedMovingImageEvaluation "false")</tt> \n
+ *    The default is "true".
  *
  * \warning Note that we assume the FixedFeatureImageType to have the same
  * pixeltype as the FixedImageType
@@ -65,6 +65,11 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
   this->m_Configuration->ReadParameter( smallNumber, "AvoidDivisionBy", 0, true );
   this->SetAvoidDivisionBy( smallNumber );
 
+  /** Evaluate all moving feature images in one pass, if possible. */
+  bool useFused = true;
+  this->m_Configuration->ReadParameter( useFused, "UseFusedMovingImageEvaluation", 0, true );
+  this->SetUseFusedMovingImageEvaluation( useFused );
+
 } // end BeforeRegistration()
 
 
@@ -95,7 +100,7 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
   {
     silentShrink = true;
   }
-  else if( treeType == "BruteForceTree" )
+  else if( treeType == "BruteForceTree" || treeType == "TiledBruteForceTree" )
   {
     silentBS     = true;
     silentSplit  = true;
@@ -179,6 +184,10 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
   {
     this->SetANNBruteForceTree();
   }
+  else if( treeType == "TiledBruteForceTree" )
+  {
+    this->SetTiledBruteForceTree();
+  }
   else
   {
     itkExceptionMacro( << "ERROR: there is no tree type \""
@@ -198,6 +207,14 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
     silentSR = false;
   }
 
+  /** The tiled brute force tree has its own exact searcher. */
+  const bool tiled    = treeType == "TiledBruteForceTree";
+  bool       silentEB = tiled;
+  if( tiled )
+  {
+    silentSR = true;
+  }
+
   /** Get the k nearest neighbours. */
   unsigned int kNearestNeighbours = 20;
   this->m_Configuration->ReadParameter( kNearestNeighbours,
@@ -207,7 +224,7 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
 
   /** Get the error bound. */
   double errorBound = 0.0;
-  this->m_Configuration->ReadParameter( errorBound, "ErrorBound", 0 );
+  this->m_Configuration->ReadParameter( errorBound, "ErrorBound", 0, silentEB );
   this->m_Configuration->ReadParameter( errorBound, "ErrorBound", level, true );
 
   /** Get the squared search radius. */
@@ -218,7 +235,11 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
     "SquaredSearchRadius", level, true );
 
   /** Set the tree searcher. */
-  if( treeSearchType == "Standard" )
+  if( tiled )
+  {
+    this->SetTiledBruteForceTreeSearch( kNearestNeighbours );
+  }
+  else if( treeSearchType == "Standard" )
   {
     this->SetANNStandardTreeSearch( kNearestNeighbours, errorBound );
   }
@@ -31,11 +31,13 @@
 #include "itkANNkDTree.h"
 #include "itkANNbdTree.h"
 #include "itkANNBruteForceTree.h"
+#include "itkTiledBruteForceTree.h"
 
 /** Supported tree searchers. */
 #include "itkANNStandardTreeSearch.h"
 #include "itkANNFixedRadiusTreeSearch.h"
 #include "itkANNPriorityTreeSearch.h"
+#include "itkTiledBruteForceTreeSearch.h"
 
 /** Include for the spatial derivatives. */
 #include "itkArray2D.h"
@@ -134,6 +136,7 @@ public:
   typedef typename
     Superclass::MovingImageLimiterOutputType MovingImageLimiterOutputType;
   typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename Superclass::NumberOfParametersType     NumberOfParametersType;
 
   /** Typedef's for storing multiple inputs. */
   typedef typename Superclass::FixedImageVectorType             FixedImageVectorType;
@@ -156,18 +159,20 @@ public:
   typedef typename ListSampleType::Pointer ListSamplePointer;
 
   /** Typedefs for trees. */
-  typedef BinaryTreeBase< ListSampleType >    BinaryKNNTreeType;
-  typedef typename BinaryKNNTreeType::Pointer BinaryKNNTreePointer;
-  typedef ANNkDTree< ListSampleType >         ANNkDTreeType;
-  typedef ANNbdTree< ListSampleType >         ANNbdTreeType;
-  typedef ANNBruteForceTree< ListSampleType > ANNBruteForceTreeType;
+  typedef BinaryTreeBase< ListSampleType >      BinaryKNNTreeType;
+  typedef typename BinaryKNNTreeType::Pointer   BinaryKNNTreePointer;
+  typedef ANNkDTree< ListSampleType >           ANNkDTreeType;
+  typedef ANNbdTree< ListSampleType >           ANNbdTreeType;
+  typedef ANNBruteForceTree< ListSampleType >   ANNBruteForceTreeType;
+  typedef TiledBruteForceTree< ListSampleType > TiledBruteForceTreeType;
 
   /** Typedefs for tree searchers. */
-  typedef BinaryTreeSearchBase< ListSampleType >     BinaryKNNTreeSearchType;
-  typedef typename BinaryKNNTreeSearchType::Pointer  BinaryKNNTreeSearchPointer;
-  typedef ANNStandardTreeSearch< ListSampleType >    ANNStandardTreeSearchType;
-  typedef ANNFixedRadiusTreeSearch< ListSampleType > ANNFixedRadiusTreeSearchType;
-  typedef ANNPriorityTreeSearch< ListSampleType >    ANNPriorityTreeSearchType;
+  typedef BinaryTreeSearchBase< ListSampleType >      BinaryKNNTreeSearchType;
+  typedef typename BinaryKNNTreeSearchType::Pointer   BinaryKNNTreeSearchPointer;
+  typedef ANNStandardTreeSearch< ListSampleType >     ANNStandardTreeSearchType;
+  typedef ANNFixedRadiusTreeSearch< ListSampleType >  ANNFixedRadiusTreeSearchType;
+  typedef ANNPriorityTreeSearch< ListSampleType >     ANNPriorityTreeSearchType;
+  typedef TiledBruteForceTreeSearch< ListSampleType > TiledBruteForceTreeSearchType;
 
   typedef typename BinaryKNNTreeSearchType::IndexArrayType    IndexArrayType;
   typedef typename BinaryKNNTreeSearchType::DistanceArrayType DistanceArrayType;
@@ -177,7 +182,7 @@ public:
 
   /**
    * *** Set trees: ***
-   * Currently kd, bd, and brute force trees are supported.
+   * Currently kd, bd, brute force, and tiled brute force trees are supported.
    */
 
   /** Set ANNkDTree. */
@@ -200,9 +205,14 @@ public:
   /** Set ANNBruteForceTree. */
   void SetANNBruteForceTree( void );
 
+  /** Set TiledBruteForceTree. This tree can only be searched with the
+   * TiledBruteForceTreeSearch. */
+  void SetTiledBruteForceTree( void );
+
   /**
    * *** Set tree searchers: ***
-   * Currently standard, fixed radius, and priority tree searchers are supported.
+   * Currently standard, fixed radius, priority, and tiled brute force
+   * tree searchers are supported.
    */
 
   /** Set ANNStandardTreeSearch. */
@@ -217,6 +227,9 @@ public:
   void SetANNPriorityTreeSearch( unsigned int kNearestNeighbors,
     double errorBound );
 
+  /** Set TiledBruteForceTreeSearch, the exact search in a TiledBruteForceTree. */
+  void SetTiledBruteForceTreeSearch( unsigned int kNearestNeighbors );
+
   /**
    * *** Standard metric stuff: ***
    */
@@ -247,6 +260,16 @@ public:
   /** Avoid division by a small number. */
   itkGetConstReferenceMacro( AvoidDivisionBy, double );
 
+  /** Add the list samples and the trees of the fixed, moving and joint
+   * features, and the Jacobians and spatial derivatives that are stored for
+   * every sample when the derivative is computed. The trees are estimated
+   * as one index per sample. The Jacobians are only counted once the metric
+   * has a transform.
+   */
+  virtual SizeValueType GetProjectedMemoryUsage(
+    const NumberOfParametersType numberOfParameters,
+    const SizeValueType numberOfSamples ) const;
+
 protected:
 
   /** Constructor. */
@@ -335,6 +358,51 @@ private:
     DerivativeType & dGamma_M,
     DerivativeType & dGamma_J ) const;
 
+  /** Threading related typedefs and parameters. */
+  typedef typename Superclass::ThreadInfoType ThreadInfoType;
+  struct KNNGraphAlphaMutualInformationMultiThreaderParameterType
+  {
+    const Self *                                  m_Metric;
+    const ListSampleType *                        m_ListSampleFixed;
+    const ListSampleType *                        m_ListSampleMoving;
+    const ListSampleType *                        m_ListSampleJoint;
+    const TransformJacobianContainerType *        m_JacobianContainer;
+    const TransformJacobianIndicesContainerType * m_JacobianIndicesContainer;
+    const SpatialDerivativeContainerType *        m_SpatialDerivativesContainer;
+    bool                                          m_ComputeDerivative;
+  };
+
+  /** Generate the three kNN trees from the list samples, each in a
+   * separate thread, and connect them to the searchers.
+   */
+  void GenerateTrees(
+    const ListSamplePointer & listSampleFixed,
+    const ListSamplePointer & listSampleMoving,
+    const ListSamplePointer & listSampleJoint ) const;
+
+  /** Helper function to launch the threads that generate the trees. */
+  static ITK_THREAD_RETURN_TYPE GenerateTreesThreaderCallback( void * arg );
+
+  /** Search the neighbours of the query points [begin, end[ and add their
+   * contributions to sumG and, if requested, to contribution. The ANN
+   * searches keep their state in thread-local variables, so this function
+   * can be called by several threads at once.
+   */
+  void ComputeValueAndDerivativeOfQueryPoints(
+    const KNNGraphAlphaMutualInformationMultiThreaderParameterType & parameters,
+    const unsigned long begin, const unsigned long end,
+    MeasureType & sumG, DerivativeType & contribution ) const;
+
+  /** Compute sumG and contribution over all query points, multi-threaded
+   * when m_UseMultiThread is true.
+   */
+  void ComputeValueAndDerivativeOfAllQueryPoints(
+    const KNNGraphAlphaMutualInformationMultiThreaderParameterType & parameters,
+    MeasureType & sumG, DerivativeType & contribution ) const;
+
+  /** Helper function to launch the threads that search the neighbours. */
+  static ITK_THREAD_RETURN_TYPE ComputeValueAndDerivativeThreaderCallback( void * arg );
+
 };
 
 } // end namespace itk
@@ -161,6 +161,22 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 } // end SetANNBruteForceTree()
 
 
+/**
+ * ************************ SetTiledBruteForceTree *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::SetTiledBruteForceTree( void )
+{
+  this->m_BinaryKNNTreeFixed  = TiledBruteForceTreeType::New();
+  this->m_BinaryKNNTreeMoving = TiledBruteForceTreeType::New();
+  this->m_BinaryKNNTreeJoint  = TiledBruteForceTreeType::New();
+
+} // end SetTiledBruteForceTree()
+
+
 /**
  * ************************ SetANNStandardTreeSearch *************************
  */
@@ -265,6 +281,33 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 } // end SetANNPriorityTreeSearch()
 
 
+/**
+ * ************************ SetTiledBruteForceTreeSearch *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::SetTiledBruteForceTreeSearch( unsigned int kNearestNeighbors )
+{
+  typename TiledBruteForceTreeSearchType::Pointer tmpPtrF
+    = TiledBruteForceTreeSearchType::New();
+  typename TiledBruteForceTreeSearchType::Pointer tmpPtrM
+    = TiledBruteForceTreeSearchType::New();
+  typename TiledBruteForceTreeSearchType::Pointer tmpPtrJ
+    = TiledBruteForceTreeSearchType::New();
+
+  tmpPtrF->SetKNearestNeighbors( kNearestNeighbors );
+  tmpPtrM->SetKNearestNeighbors( kNearestNeighbors );
+  tmpPtrJ->SetKNearestNeighbors( kNearestNeighbors );
+
+  this->m_BinaryKNNTreeSearcherFixed  = tmpPtrF;
+  this->m_BinaryKNNTreeSearcherMoving = tmpPtrM;
+  this->m_BinaryKNNTreeSearcherJoint  = tmpPtrJ;
+
+} // end SetTiledBruteForceTreeSearch()
+
+
 /**
  * ********************* Initialize *****************************
  */
@@ -336,25 +379,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
-
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
-
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  this->GenerateTrees( listSampleFixed, listSampleMoving, listSampleJoint );
 
   /**
    * *************** Estimate the \alpha MI ******************
@@ -389,77 +414,20 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * where d1 and d2 are the possibly different dimensions of the two feature sets.
    */
 
-  /** Temporary variables. */
-  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J;
-  IndexArrayType        indices_F, indices_M, indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
-
-  MeasureType    H, G;
-  AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
-
-  /** Get the size of the feature vectors. */
-  unsigned int fixedSize  = this->GetNumberOfFixedImages();
-  unsigned int movingSize = this->GetNumberOfMovingImages();
-  unsigned int jointSize  = fixedSize + movingSize;
-
-  /** Get the number of neighbours and \gamma. */
-  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
-  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
-
-  /** Loop over all query points, i.e. all samples. */
-  for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
-  {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
-    listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the K nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
-
-    /** Add the distances between the points to get the total graph length.
-     * The outcommented implementation calculates: sum J/sqrt(F*M)
-     *
-    for ( unsigned int j = 0; j < K; j++ )
-    {
-    enumerator = vcl_sqrt( distsJ[ j ] );
-    denominator = vcl_sqrt( vcl_sqrt( distsF[ j ] ) * vcl_sqrt( distsM[ j ] ) );
-    if ( denominator > 1e-14 )
-    {
-    contribution += vcl_pow( enumerator / denominator, twoGamma );
-    }
-    }*/
-
-    /** Add the distances of all neighbours of the query point,
-    * for the three graphs:
-    * sum M / sqrt( sum F * sum M)
-    */
-
-    /** Variables to compute the measure. */
-    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
-
-    /** Loop over the neighbours. */
-    for( unsigned int p = 0; p < k; p++ )
-    {
-      Gamma_F += vcl_sqrt( distances_F[ p ] );
-      Gamma_M += vcl_sqrt( distances_M[ p ] );
-      Gamma_J += vcl_sqrt( distances_J[ p ] );
-    } // end loop over the k neighbours
-
-    /** Calculate the contribution of this query point. */
-    H = vcl_sqrt( Gamma_F * Gamma_M );
-    if( H > this->m_AvoidDivisionBy )
-    {
-      /** Compute some sums. */
-      G     = Gamma_J / H;
-      sumG += vcl_pow( G, twoGamma );
-    }
-  } // end looping over all query points
+  /** Search the neighbours of all query points and sum their contributions. */
+  KNNGraphAlphaMutualInformationMultiThreaderParameterType temp;
+  temp.m_Metric                      = this;
+  temp.m_ListSampleFixed             = listSampleFixed.GetPointer();
+  temp.m_ListSampleMoving            = listSampleMoving.GetPointer();
+  temp.m_ListSampleJoint             = listSampleJoint.GetPointer();
+  temp.m_JacobianContainer           = &dummyJacobianContainer;
+  temp.m_JacobianIndicesContainer    = &dummyJacobianIndicesContainer;
+  temp.m_SpatialDerivativesContainer = &dummySpatialDerivativesContainer;
+  temp.m_ComputeDerivative           = false;
+
+  MeasureType    sumG = NumericTraits< MeasureType >::Zero;
+  DerivativeType dummyContribution;
+  this->ComputeValueAndDerivativeOfAllQueryPoints( temp, sumG, dummyContribution );
 
   /**
    * *************** Finally, calculate the metric value \alpha MI ******************
@@ -561,25 +529,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
-
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
-
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  this->GenerateTrees( listSampleFixed, listSampleMoving, listSampleJoint );
 
   /**
    * *************** Estimate the \alpha MI and its derivatives ******************
@@ -614,107 +564,24 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * where d1 and d2 are the possibly different dimensions of the two feature sets.
    */
 
-  /** Temporary variables. */
-  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J, z_M_ip, z_J_ip, diff_M, diff_J;
-  IndexArrayType        indices_F,   indices_M,   indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
-  MeasureType           distance_F,  distance_M,  distance_J;
-
-  MeasureType    H, G, Gpow;
-  AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
-
+  /** Search the neighbours of all query points and sum their contributions. */
+  KNNGraphAlphaMutualInformationMultiThreaderParameterType temp;
+  temp.m_Metric                      = this;
+  temp.m_ListSampleFixed             = listSampleFixed.GetPointer();
+  temp.m_ListSampleMoving            = listSampleMoving.GetPointer();
+  temp.m_ListSampleJoint             = listSampleJoint.GetPointer();
+  temp.m_JacobianContainer           = &jacobianContainer;
+  temp.m_JacobianIndicesContainer    = &jacobianIndicesContainer;
+  temp.m_SpatialDerivativesContainer = &spatialDerivativesContainer;
+  temp.m_ComputeDerivative           = true;
+
+  MeasureType    sumG = NumericTraits< MeasureType >::Zero;
   DerivativeType contribution( this->GetNumberOfParameters() );
   contribution.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  DerivativeType dGamma_M( this->GetNumberOfParameters() );
-  DerivativeType dGamma_J( this->GetNumberOfParameters() );
+  this->ComputeValueAndDerivativeOfAllQueryPoints( temp, sumG, contribution );
 
   /** Get the size of the feature vectors. */
-  unsigned int fixedSize  = this->GetNumberOfFixedImages();
-  unsigned int movingSize = this->GetNumberOfMovingImages();
-  unsigned int jointSize  = fixedSize + movingSize;
-
-  /** Get the number of neighbours and \gamma. */
-  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
-  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
-
-  /** Loop over all query points, i.e. all samples. */
-  for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
-  {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
-    listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the k nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
-
-    /** Variables to compute the measure and its derivative. */
-    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
-
-    SpatialDerivativeType D1sparse, D2sparse_M, D2sparse_J;
-    D1sparse = spatialDerivativesContainer[ i ] * jacobianContainer[ i ];
-
-    dGamma_M.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-    dGamma_J.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-
-    /** Loop over the neighbours. */
-    for( unsigned int p = 0; p < k; p++ )
-    {
-      /** Get the neighbour point z_ip^M. */
-      listSampleMoving->GetMeasurementVector( indices_M[ p ], z_M_ip );
-      listSampleMoving->GetMeasurementVector( indices_J[ p ], z_J_ip );
-
-      /** Get the distances. */
-      distance_F = vcl_sqrt( distances_F[ p ] );
-      distance_M = vcl_sqrt( distances_M[ p ] );
-      distance_J = vcl_sqrt( distances_J[ p ] );
-
-      /** Compute Gamma's. */
-      Gamma_F += distance_F;
-      Gamma_M += distance_M;
-      Gamma_J += distance_J;
-
-      /** Get the difference of z_ip^M with z_i^M. */
-      diff_M = z_M - z_M_ip;
-      diff_J = z_M - z_J_ip;
-
-      /** Compute derivatives. */
-      D2sparse_M = spatialDerivativesContainer[ indices_M[ p ] ]
-        * jacobianContainer[ indices_M[ p ] ];
-      D2sparse_J = spatialDerivativesContainer[ indices_J[ p ] ]
-        * jacobianContainer[ indices_J[ p ] ];
-
-      /** Update the dGamma's. */
-      this->UpdateDerivativeOfGammas(
-        D1sparse, D2sparse_M, D2sparse_J,
-        jacobianIndicesContainer[ i ],
-        jacobianIndicesContainer[ indices_M[ p ] ],
-        jacobianIndicesContainer[ indices_J[ p ] ],
-        diff_M, diff_J,
-        distance_M, distance_J,
-        dGamma_M, dGamma_J );
-
-    } // end loop over the k neighbours
-
-    /** Compute contributions. */
-    H = vcl_sqrt( Gamma_F * Gamma_M );
-    if( H > this->m_AvoidDivisionBy )
-    {
-      /** Compute some sums. */
-      G     = Gamma_J / H;
-      sumG += vcl_pow( G, twoGamma );
-
-      /** Compute the contribution to the derivative. */
-      Gpow          = vcl_pow( G, twoGamma - 1.0 );
-      contribution += ( Gpow / H ) * ( dGamma_J - ( 0.5 * Gamma_J / Gamma_M ) * dGamma_M );
-    }
-
-  } // end looping over all query points
+  const unsigned int jointSize = this->GetNumberOfFixedImages() + this->GetNumberOfMovingImages();
 
   /**
    * *************** Finally, calculate the metric value and derivative ******************
@@ -730,13 +597,44 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     measure = vcl_log( sumG / number ) / ( this->m_Alpha - 1.0 );
 
     /** Compute the derivative (-2.0 * d = -jointSize). */
-    derivative = ( static_cast< AccumulateType >( jointSize ) / sumG ) * contribution;
+    derivative = ( static_cast< MeasureType >( jointSize ) / sumG ) * contribution;
   }
   value = -measure;
 
 } // end GetValueAndDerivative()
 
 
+/**
+ * ************************ GetProjectedMemoryUsage *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetProjectedMemoryUsage( const NumberOfParametersType numberOfParameters,
+  const SizeValueType numberOfSamples ) const
+{
+  const SizeValueType numberOfFixedFeatures  = this->GetNumberOfFixedImages();
+  const SizeValueType numberOfMovingFeatures = this->GetNumberOfMovingImages();
+
+  /** The fixed, moving and joint list samples and their trees. */
+  SizeValueType usage = Superclass::GetProjectedMemoryUsage( numberOfParameters, numberOfSamples )
+    + numberOfSamples * 2 * ( numberOfFixedFeatures + numberOfMovingFeatures ) * sizeof( double )
+    + numberOfSamples * 3 * sizeof( int );
+
+  /** The Jacobians, their indices and the spatial derivatives per sample. */
+  if( this->m_AdvancedTransform.IsNotNull() )
+  {
+    const SizeValueType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
+    usage += numberOfSamples * ( nnzji * ( MovingImageDimension * sizeof( double )
+      + sizeof( typename NonZeroJacobianIndicesType::value_type ) )
+      + numberOfMovingFeatures * MovingImageDimension * sizeof( double ) );
+  }
+  return usage;
+
+} // end GetProjectedMemoryUsage()
+
+
 /**
  * ************************ ComputeListSampleValuesAndDerivativePlusJacobian *************************
  */
@@ -797,9 +695,19 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
   TransformJacobianType jacobian;
 
+  /** The fixed feature values at the samples, computed once per sampler update. */
+  this->UpdateFixedFeatureValues();
+  const double * fixedFeatureValues = this->m_FixedFeatureValues.empty()
+    ? 0 : &( this->m_FixedFeatureValues[ 0 ] );
+
+  /** Storage for evaluating all moving images in one pass. */
+  const bool                               fused = this->m_MovingImagesAreFused;
+  std::vector< RealType >                  movingValues( movingSize );
+  std::vector< MovingImageDerivativeType > movingGradients( movingSize );
+
   /** Loop over the fixed image samples to calculate the list samples. */
   unsigned int ii = 0;
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  for( fiter = fbegin; fiter != fend; ++fiter, fixedFeatureValues += fixedSize )
   {
     /** Read fixed coordinates and initialize some variables. */
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
@@ -818,7 +726,14 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
      * moving images buffers.
      */
     MovingImageDerivativeType movingImageDerivative;
-    if( sampleOk )
+    if( sampleOk && fused )
+    {
+      sampleOk = this->EvaluateMovingImageValuesAndDerivatives( mappedPoint,
+        &movingValues[ 0 ], doDerivative ? &movingGradients[ 0 ] : 0 );
+      movingImageValue      = movingValues[ 0 ];
+      movingImageDerivative = movingGradients[ 0 ];
+    }
+    else if( sampleOk )
     {
       if( doDerivative )
       {
@@ -838,8 +753,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     if( sampleOk )
     {
       /** Get the fixed image value. */
-      const RealType & fixedImageValue = static_cast< RealType >(
-        ( *fiter ).Value().m_ImageValue );
+      const RealType fixedImageValue = fixedFeatureValues[ 0 ];
 
       /** Add the samples to the ListSampleCarrays. */
       listSampleFixed->SetMeasurement(  this->m_NumberOfPixelsCounted, 0,
@@ -854,8 +768,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
       /** Get and set the values of the fixed feature images. */
       for( unsigned int j = 1; j < this->GetNumberOfFixedImages(); j++ )
       {
-        fixedFeatureValue = this->m_FixedImageInterpolatorVector[ j ]
-          ->Evaluate( fixedPoint );
+        fixedFeatureValue = fixedFeatureValues[ j ];
         listSampleFixed->SetMeasurement(
           this->m_NumberOfPixelsCounted, j, fixedFeatureValue );
         listSampleJoint->SetMeasurement(
@@ -865,8 +778,8 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
       /** Get and set the values of the moving feature images. */
       for( unsigned int j = 1; j < this->GetNumberOfMovingImages(); j++ )
       {
-        movingFeatureValue = this->m_InterpolatorVector[ j ]
-          ->Evaluate( mappedPoint );
+        movingFeatureValue = fused ? movingValues[ j ]
+          : this->m_InterpolatorVector[ j ]->Evaluate( mappedPoint );
         listSampleMoving->SetMeasurement(
           this->m_NumberOfPixelsCounted,
           j,
@@ -895,12 +808,22 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
         spatialDerivatives.set_row( 0, movingImageDerivative.GetDataPointer() );
 
         /** Get the spatial derivatives of the moving feature images. */
-        SpatialDerivativeType movingFeatureImageDerivatives(
-        this->GetNumberOfMovingImages() - 1,
-        this->FixedImageDimension );
-        this->EvaluateMovingFeatureImageDerivatives(
-          mappedPoint, movingFeatureImageDerivatives );
-        spatialDerivatives.update( movingFeatureImageDerivatives, 1, 0 );
+        if( fused )
+        {
+          for( unsigned int j = 1; j < movingSize; ++j )
+          {
+            spatialDerivatives.set_row( j, movingGradients[ j ].GetDataPointer() );
+          }
+        }
+        else
+        {
+          SpatialDerivativeType movingFeatureImageDerivatives(
+          this->GetNumberOfMovingImages() - 1,
+          this->FixedImageDimension );
+          this->EvaluateMovingFeatureImageDerivatives(
+            mappedPoint, movingFeatureImageDerivatives );
+          spatialDerivatives.update( movingFeatureImageDerivatives, 1, 0 );
+        }
 
         /** Put the spatial derivatives of this sample into the container. */
         spatialDerivativesContainer.push_back( spatialDerivatives );
@@ -1076,6 +999,297 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 } // end UpdateDerivativeOfGammas()
 
 
+/**
+ * ************************ GenerateTrees *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GenerateTrees(
+  const ListSamplePointer & listSampleFixed,
+  const ListSamplePointer & listSampleMoving,
+  const ListSamplePointer & listSampleJoint ) const
+{
+  /** Connect the list samples to the trees. */
+  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
+  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
+  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
+
+  /** Generate the three trees, concurrently. */
+  BinaryKNNTreeType * trees[ 3 ] = {
+    this->m_BinaryKNNTreeFixed.GetPointer(),
+    this->m_BinaryKNNTreeMoving.GetPointer(),
+    this->m_BinaryKNNTreeJoint.GetPointer() };
+  if( this->m_UseMultiThread )
+  {
+    this->ExecuteThreaderCallback( GenerateTreesThreaderCallback, trees );
+  }
+  else
+  {
+    for( unsigned int t = 0; t < 3; ++t )
+    {
+      trees[ t ]->GenerateTree();
+    }
+  }
+
+  /** Initialize tree searchers. */
+  this->m_BinaryKNNTreeSearcherFixed
+  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
+  this->m_BinaryKNNTreeSearcherMoving
+  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
+  this->m_BinaryKNNTreeSearcherJoint
+  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+
+} // end GenerateTrees()
+
+
+/**
+ * ************************ GenerateTreesThreaderCallback *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GenerateTreesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  BinaryKNNTreeType ** trees = static_cast< BinaryKNNTreeType ** >( infoStruct->UserData );
+
+  /** Each thread generates at most one tree, unless there are fewer than three threads. */
+  for( unsigned int t = threadId; t < 3; t += nrOfThreads )
+  {
+    trees[ t ]->GenerateTree();
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end GenerateTreesThreaderCallback()
+
+
+/**
+ * ************************ ComputeValueAndDerivativeOfQueryPoints *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeValueAndDerivativeOfQueryPoints(
+  const KNNGraphAlphaMutualInformationMultiThreaderParameterType & parameters,
+  const unsigned long begin, const unsigned long end,
+  MeasureType & sumG, DerivativeType & contribution ) const
+{
+  /** Temporary variables. */
+  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
+  MeasurementVectorType z_F, z_M, z_J, z_M_ip, z_J_ip, diff_M, diff_J;
+  IndexArrayType        indices_F,   indices_M,   indices_J;
+  DistanceArrayType     distances_F, distances_M, distances_J;
+  MeasureType           distance_F,  distance_M,  distance_J;
+
+  MeasureType    H, G, Gpow;
+  AccumulateType localSumG = NumericTraits< AccumulateType >::Zero;
+
+  const ListSampleType *                        listSampleFixed             = parameters.m_ListSampleFixed;
+  const ListSampleType *                        listSampleMoving            = parameters.m_ListSampleMoving;
+  const ListSampleType *                        listSampleJoint             = parameters.m_ListSampleJoint;
+  const TransformJacobianContainerType &        jacobianContainer           = *parameters.m_JacobianContainer;
+  const TransformJacobianIndicesContainerType & jacobianIndicesContainer    = *parameters.m_JacobianIndicesContainer;
+  const SpatialDerivativeContainerType &        spatialDerivativesContainer = *parameters.m_SpatialDerivativesContainer;
+  const bool                                    computeDerivative           = parameters.m_ComputeDerivative;
+
+  DerivativeType dGamma_M, dGamma_J;
+  if( computeDerivative )
+  {
+    dGamma_M.SetSize( this->GetNumberOfParameters() );
+    dGamma_J.SetSize( this->GetNumberOfParameters() );
+  }
+
+  /** Get the size of the feature vectors. */
+  unsigned int fixedSize  = this->GetNumberOfFixedImages();
+  unsigned int movingSize = this->GetNumberOfMovingImages();
+  unsigned int jointSize  = fixedSize + movingSize;
+
+  /** Get the number of neighbours and \gamma. */
+  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
+  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
+
+  /** Loop over the query points, i.e. the samples. */
+  for( unsigned long i = begin; i < end; i++ )
+  {
+    /** Get the i-th query point. */
+    listSampleFixed->GetMeasurementVector(  i, z_F );
+    listSampleMoving->GetMeasurementVector( i, z_M );
+    listSampleJoint->GetMeasurementVector(  i, z_J );
+
+    /** Search for the k nearest neighbours of the current query point. */
+    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
+    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
+    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
+
+    /** Variables to compute the measure and its derivative. */
+    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
+    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
+    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
+
+    SpatialDerivativeType D1sparse, D2sparse_M, D2sparse_J;
+    if( computeDerivative )
+    {
+      D1sparse = spatialDerivativesContainer[ i ] * jacobianContainer[ i ];
+      dGamma_M.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+      dGamma_J.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    }
+
+    /** Loop over the neighbours. */
+    for( unsigned int p = 0; p < k; p++ )
+    {
+      /** Get the distances. */
+      distance_F = vcl_sqrt( distances_F[ p ] );
+      distance_M = vcl_sqrt( distances_M[ p ] );
+      distance_J = vcl_sqrt( distances_J[ p ] );
+
+      /** Compute Gamma's. */
+      Gamma_F += distance_F;
+      Gamma_M += distance_M;
+      Gamma_J += distance_J;
+
+      if( !computeDerivative )
+      {
+        continue;
+      }
+
+      /** Get the neighbour point z_ip^M. */
+      listSampleMoving->GetMeasurementVector( indices_M[ p ], z_M_ip );
+      listSampleMoving->GetMeasurementVector( indices_J[ p ], z_J_ip );
+
+      /** Get the difference of z_ip^M with z_i^M. */
+      diff_M = z_M - z_M_ip;
+      diff_J = z_M - z_J_ip;
+
+      /** Compute derivatives. */
+      D2sparse_M = spatialDerivativesContainer[ indices_M[ p ] ]
+        * jacobianContainer[ indices_M[ p ] ];
+      D2sparse_J = spatialDerivativesContainer[ indices_J[ p ] ]
+        * jacobianContainer[ indices_J[ p ] ];
+
+      /** Update the dGamma's. */
+      this->UpdateDerivativeOfGammas(
+        D1sparse, D2sparse_M, D2sparse_J,
+        jacobianIndicesContainer[ i ],
+        jacobianIndicesContainer[ indices_M[ p ] ],
+        jacobianIndicesContainer[ indices_J[ p ] ],
+        diff_M, diff_J,
+        distance_M, distance_J,
+        dGamma_M, dGamma_J );
+
+    } // end loop over the k neighbours
+
+    /** Compute contributions. */
+    H = vcl_sqrt( Gamma_F * Gamma_M );
+    if( H > this->m_AvoidDivisionBy )
+    {
+      /** Compute some sums. */
+      G          = Gamma_J / H;
+      localSumG += vcl_pow( G, twoGamma );
+
+      /** Compute the contribution to the derivative. */
+      if( computeDerivative )
+      {
+        Gpow          = vcl_pow( G, twoGamma - 1.0 );
+        contribution += ( Gpow / H ) * ( dGamma_J - ( 0.5 * Gamma_J / Gamma_M ) * dGamma_M );
+      }
+    }
+
+  } // end looping over the query points
+
+  sumG += localSumG;
+
+} // end ComputeValueAndDerivativeOfQueryPoints()
+
+
+/**
+ * ************************ ComputeValueAndDerivativeOfAllQueryPoints *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeValueAndDerivativeOfAllQueryPoints(
+  const KNNGraphAlphaMutualInformationMultiThreaderParameterType & parameters,
+  MeasureType & sumG, DerivativeType & contribution ) const
+{
+  /** Single-threaded. */
+  if( !this->m_UseMultiThread )
+  {
+    this->ComputeValueAndDerivativeOfQueryPoints( parameters,
+      0, this->m_NumberOfPixelsCounted, sumG, contribution );
+    return;
+  }
+
+  /** Launch multi-threading: every thread searches the neighbours of a
+   * contiguous part of the query points.
+   */
+  this->ExecuteThreaderCallback( ComputeValueAndDerivativeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &parameters ) ) );
+
+  /** Accumulate the results of the threads, in a fixed order. */
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    sumG += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+    if( parameters.m_ComputeDerivative )
+    {
+      contribution += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative;
+    }
+  }
+
+} // end ComputeValueAndDerivativeOfAllQueryPoints()
+
+
+/**
+ * ************************ ComputeValueAndDerivativeThreaderCallback *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeValueAndDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  const KNNGraphAlphaMutualInformationMultiThreaderParameterType * temp
+    = static_cast< const KNNGraphAlphaMutualInformationMultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = temp->m_Metric;
+
+  /** Get the query points of this thread. */
+  const unsigned long numberOfQueryPoints = metric->m_NumberOfPixelsCounted;
+  const unsigned long subSize             = static_cast< unsigned long >(
+    vcl_ceil( static_cast< double >( numberOfQueryPoints ) / static_cast< double >( nrOfThreads ) ) );
+  unsigned long pos_begin = subSize * threadId;
+  unsigned long pos_end   = subSize * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfQueryPoints ) ? numberOfQueryPoints : pos_begin;
+  pos_end   = ( pos_end > numberOfQueryPoints ) ? numberOfQueryPoints : pos_end;
+
+  /** The per-thread results are reset by the thread itself. */
+  MeasureType &    sumG         = metric->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value;
+  DerivativeType & contribution = metric->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+  sumG = NumericTraits< MeasureType >::Zero;
+  if( temp->m_ComputeDerivative )
+  {
+    contribution.SetSize( metric->GetNumberOfParameters() );
+    contribution.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  }
+
+  metric->ComputeValueAndDerivativeOfQueryPoints( *temp, pos_begin, pos_end, sumG, contribution );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeValueAndDerivativeThreaderCallback()
+
+
 /**
  * ************************ PrintSelf *************************
  */
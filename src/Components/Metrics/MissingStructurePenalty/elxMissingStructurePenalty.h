@@ -193,6 +193,9 @@ private:
   void operator=( const Self & );           // purposely not implemented
 
   unsigned int m_NumberOfMeshes;
+
+  /** The WriteResultMeshAfterEachIteration parameter, read every iteration. */
+  CachedParameter< bool > m_WriteResultMeshAfterEachIteration;
 };
 
 } // end namespace elastix
@@ -30,7 +30,8 @@ namespace elastix
 
 template< class TElastix >
 MissingStructurePenalty< TElastix >
-::MissingStructurePenalty()
+::MissingStructurePenalty() :
+  m_WriteResultMeshAfterEachIteration( "WriteResultMeshAfterEachIteration", false )
 {
   this->m_NumberOfMeshes = 0;
 }
@@ -188,9 +189,8 @@ MissingStructurePenalty< TElastix >
   const unsigned int iter = this->m_Elastix->GetIterationCounter();
 
   /** Decide whether or not to write the result image this iteration. */
-  bool writeResultMeshThisIteration = false;
-  this->m_Configuration->ReadParameter( writeResultMeshThisIteration,
-    "WriteResultMeshAfterEachIteration", "", level, 0, false );
+  const bool writeResultMeshThisIteration
+    = this->m_WriteResultMeshAfterEachIteration.Get( this->m_Configuration, level );
 
   /** Writing result mesh. */
   if( writeResultMeshThisIteration )
@@ -26,12 +26,31 @@
 #include "itkVectorContainer.h"
 #include "vnl_adjugate_fixed.h"
 
+#include <vector>
+
 namespace itk
 {
 
 /** \class MissingVolumeMeshPenalty
  * \brief Computes the (pseudo) volume of the transformed surface mesh of a structure.\n
  *
+ * The value and derivative are computed with the threads of the global
+ * PersistentThreadPool, in three passes: the vertices of all meshes are
+ * mapped, the volumes of the triangles and their derivatives with respect
+ * to their corners are computed, and the derivatives of the corners of each
+ * vertex are gathered and multiplied by the Jacobian of that vertex. The
+ * derivatives with respect to the parameters are added to the per-thread
+ * derivatives of the SingleValuedPointSetToPointSetMetric, which are merged
+ * afterwards. Every pass writes to separate memory, so no locking is needed,
+ * and the derivatives of the vertices do not depend on the number of threads.
+ *
+ * The points and triangles of the meshes are copied to flat arrays in
+ * Initialize(). For B-spline transforms, the Jacobian does not depend on
+ * the parameters, so the Jacobians and nonzero Jacobian indices of the
+ * vertices, i.e. their B-spline support, are computed in the first
+ * GetValueAndDerivative() after Initialize(), and reused afterwards,
+ * if they fit in MaximumVertexJacobianCacheSize bytes.
+ *
  * \author F.F. Berendsen, Image Sciences Institute, UMC Utrecht, The Netherlands
  * \note If you use the MissingStructurePenalty anywhere we would appreciate if you cite the following article:\n
  * F.F. Berendsen, A.N.T.J. Kotte, A.A.C. de Leeuw, I.M. Jrgenliemk-Schulz,\n
@@ -68,6 +87,8 @@ public:
   typedef typename Superclass::TransformParametersType TransformParametersType;
   typedef typename Superclass::TransformJacobianType   TransformJacobianType;
 
+  typedef typename Superclass::TransformParametersValueType TransformParametersValueType;
+
   typedef typename Superclass::MeasureType         MeasureType;
   typedef typename Superclass::DerivativeType      DerivativeType;
   typedef typename Superclass::DerivativeValueType DerivativeValueType;
@@ -157,11 +178,87 @@ public:
   void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const;
 
+  /** Set/Get the memory budget of the cache of the vertex Jacobians, in bytes.
+   * Default: 512 MB. */
+  itkSetMacro( MaximumVertexJacobianCacheSize, SizeValueType );
+  itkGetConstMacro( MaximumVertexJacobianCacheSize, SizeValueType );
+
+  /** Get the memory used by the cache of the vertex Jacobians, in bytes. */
+  SizeValueType GetVertexJacobianCacheMemoryUsage( void ) const;
+
 protected:
 
   MissingVolumeMeshPenalty();
   virtual ~MissingVolumeMeshPenalty();
 
+  /** Typedefs for multi-threading. */
+  typedef typename Superclass::ThreadInfoType                       ThreadInfoType;
+  typedef typename Superclass::MultiThreaderParameterType           MultiThreaderParameterType;
+  typedef typename Superclass::GetValueAndDerivativePerThreadStruct GetValueAndDerivativePerThreadStruct;
+
+  /** The number of vertices that is passed at once to the transform,
+   * when the vertex Jacobians are not cached. */
+  itkStaticConstMacro( PointChunkSize, unsigned int, 32 );
+
+  /** The flat copy of a mesh, made in Initialize(). The corners of cell c
+   * are m_CellPointIds[ c * FixedPointSetDimension + i ], and the corners
+   * of vertex v are m_VertexCorners[ m_VertexCornerOffsets[ v ] ], ...,
+   * m_VertexCorners[ m_VertexCornerOffsets[ v + 1 ] - 1 ]. The derivative
+   * of the volume of a cell with respect to each of its corners is stored
+   * in m_CornerDerivatives. The vertices and cells of all meshes are numbered
+   * consecutively, starting at m_VertexOffset and m_CellOffset.
+   */
+  struct MeshCacheType
+  {
+    std::vector< InputPointType >  m_FixedPoints;
+    std::vector< OutputPointType > m_MappedPoints;
+    MeshPointsContainerType *      m_MappedPointsContainer;
+    std::vector< SizeValueType >   m_CellPointIds;
+    std::vector< SizeValueType >   m_VertexCornerOffsets;
+    std::vector< SizeValueType >   m_VertexCorners;
+    std::vector< double >          m_CornerDerivatives;
+    OutputPointType                m_Centroid;
+    SizeValueType                  m_VertexOffset;
+    SizeValueType                  m_CellOffset;
+  };
+
+  /** Copy the meshes to m_MeshCaches, and invalidate the vertex Jacobians. */
+  void InitializeMeshCaches( void );
+
+  /** Run the passes on numberOfThreads threads, and gather the value. */
+  void LaunchGetValueAndDerivativeThreaderCallbacks(
+    const ThreadIdType numberOfThreads, MeasureType & measure ) const;
+
+  /** Map the vertices of this thread, and possibly compute their Jacobians
+   * for the cache. */
+  void ThreadedTransformPoints( const ThreadIdType threadId,
+    const ThreadIdType numberOfThreads ) const;
+
+  /** Add the absolute volumes of the cells of this thread to the per-thread
+   * value, and when m_ComputeDerivative is true store their corner derivatives. */
+  void ThreadedComputeVolumes( const ThreadIdType threadId,
+    const ThreadIdType numberOfThreads ) const;
+
+  /** Add the derivatives of the vertices of this thread to the per-thread
+   * derivative. */
+  void ThreadedComputeDerivative( const ThreadIdType threadId,
+    const ThreadIdType numberOfThreads ) const;
+
+  /** Multi-threaded versions of the functions above. */
+  static ITK_THREAD_RETURN_TYPE TransformPointsThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeVolumesThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeDerivativeThreaderCallback( void * arg );
+
+  /** Compute the signed volume of a cell with respect to the centroid, and
+   * when cornerDerivatives is not null, the derivative of its absolute value
+   * with respect to each corner.
+   */
+  double ComputeSignedVolume( const OutputPointType * mappedPoints,
+    const OutputPointType & centroid, const SizeValueType * pointIds,
+    double * cornerDerivatives ) const;
+
   /** PrintSelf. */
   //void PrintSelf(std::ostream& os, Indent indent) const;
 
@@ -171,6 +268,20 @@ protected:
   mutable FixedMeshContainerConstPointer m_FixedMeshContainer;
   mutable MappedMeshContainerPointer     m_MappedMeshContainer;
 
+  mutable std::vector< MeshCacheType > m_MeshCaches;
+  SizeValueType                        m_NumberOfVertices;
+  SizeValueType                        m_NumberOfCells;
+
+  /** Whether the threads compute the derivative, or only the value. */
+  mutable bool m_ComputeDerivative;
+
+  /** The cached Jacobians of all vertices, in the layout of GetJacobians(). */
+  SizeValueType                                       m_MaximumVertexJacobianCacheSize;
+  mutable std::vector< TransformParametersValueType > m_VertexJacobians;
+  mutable std::vector< unsigned long >                m_VertexNonZeroJacobianIndices;
+  mutable bool                                        m_VertexJacobianCacheIsValid;
+  mutable bool                                        m_BuildVertexJacobianCache;
+
 private:
 
   void SubVector( const VectorType & fullVector, SubVectorType & subVector, const unsigned int leaveOutIndex ) const;
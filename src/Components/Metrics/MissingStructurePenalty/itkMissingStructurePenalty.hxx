@@ -20,6 +20,8 @@
 
 #include "itkMissingStructurePenalty.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -32,6 +34,17 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
 ::MissingVolumeMeshPenalty()
 {
   this->m_MappedMeshContainer = MappedMeshContainerType::New();
+
+  /** GetValueAndDerivative() only modifies members of this metric. */
+  this->m_SupportsConcurrentEvaluation = true;
+  this->m_ComputeDerivative            = false;
+
+  this->m_NumberOfVertices               = 0;
+  this->m_NumberOfCells                  = 0;
+  this->m_MaximumVertexJacobianCacheSize = 512 * 1024 * 1024;
+  this->m_VertexJacobianCacheIsValid     = false;
+  this->m_BuildVertexJacobianCache       = false;
+
 } // end Constructor
 
 
@@ -67,6 +80,11 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
     itkExceptionMacro( << "FixedMeshContainer is not present" );
   }
 
+  if( FixedPointSetDimension < 2 || FixedPointSetDimension > 4 )
+  {
+    itkExceptionMacro( << "Only meshes of dimension 2, 3 and 4 are supported" );
+  }
+
   const FixedMeshContainerElementIdentifier numberOfMeshes = this->m_FixedMeshContainer->Size();
   this->m_MappedMeshContainer->Reserve( numberOfMeshes );
 
@@ -92,9 +110,109 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
     this->m_MappedMeshContainer->SetElement( meshId, mappedMesh );
 
   }
+
+  /** Copy the points and the cells of the meshes to flat arrays. */
+  this->InitializeMeshCaches();
+
 } // end Initialize()
 
 
+/**
+ * *********************** InitializeMeshCaches *****************************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet  >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::InitializeMeshCaches( void )
+{
+  const FixedMeshContainerElementIdentifier numberOfMeshes = this->m_FixedMeshContainer->Size();
+  this->m_MeshCaches.clear();
+  this->m_MeshCaches.resize( numberOfMeshes );
+  this->m_NumberOfVertices = 0;
+  this->m_NumberOfCells    = 0;
+
+  for( FixedMeshContainerElementIdentifier meshId = 0; meshId < numberOfMeshes; ++meshId )
+  {
+    MeshCacheType &                       cache          = this->m_MeshCaches[ meshId ];
+    const FixedMeshConstPointer           fixedMesh      = this->m_FixedMeshContainer->ElementAt( meshId );
+    const MeshPointsContainerConstPointer fixedPoints    = fixedMesh->GetPoints();
+    const SizeValueType                   numberOfPoints = fixedPoints->Size();
+
+    /** The points. */
+    cache.m_VertexOffset = this->m_NumberOfVertices;
+    cache.m_FixedPoints.resize( numberOfPoints );
+    cache.m_MappedPoints.resize( numberOfPoints );
+    cache.m_MappedPointsContainer = this->m_MappedMeshContainer->ElementAt( meshId )->GetPoints();
+    MeshPointsContainerConstIteratorType fixedPointIt = fixedPoints->Begin();
+    for( SizeValueType i = 0; i < numberOfPoints; ++i, ++fixedPointIt )
+    {
+      cache.m_FixedPoints[ i ] = fixedPointIt->Value();
+    }
+
+    /** The corners of the cells. Only the first FixedPointSetDimension
+     * points of a cell are used. */
+    cache.m_CellOffset = this->m_NumberOfCells;
+    cache.m_CellPointIds.clear();
+    if( fixedMesh->GetCells() )
+    {
+      cache.m_CellPointIds.reserve( fixedMesh->GetNumberOfCells() * FixedPointSetDimension );
+      typename FixedMeshType::CellsContainerConstIterator cellIt  = fixedMesh->GetCells()->Begin();
+      typename FixedMeshType::CellsContainerConstIterator cellEnd = fixedMesh->GetCells()->End();
+      for(; cellIt != cellEnd; ++cellIt )
+      {
+        const CellInterfaceType * cell = cellIt->Value();
+        if( cell->GetNumberOfPoints() < FixedPointSetDimension )
+        {
+          itkExceptionMacro( << "Mesh " << meshId << " has a cell with fewer than "
+                             << FixedPointSetDimension << " points" );
+        }
+
+        typename CellInterfaceType::PointIdConstIterator pointIdIt = cell->PointIdsBegin();
+        for( unsigned int i = 0; i < FixedPointSetDimension; ++i, ++pointIdIt )
+        {
+          if( static_cast< SizeValueType >( *pointIdIt ) >= numberOfPoints )
+          {
+            itkExceptionMacro( << "Mesh " << meshId << " has a cell with point id "
+                               << *pointIdIt << ", but only " << numberOfPoints << " points" );
+          }
+          cache.m_CellPointIds.push_back( *pointIdIt );
+        }
+      }
+    }
+    const SizeValueType numberOfCorners = cache.m_CellPointIds.size();
+    cache.m_CornerDerivatives.assign( numberOfCorners * FixedPointSetDimension, 0.0 );
+
+    /** The corners of each vertex, in compressed row storage. */
+    cache.m_VertexCornerOffsets.assign( numberOfPoints + 1, 0 );
+    for( SizeValueType k = 0; k < numberOfCorners; ++k )
+    {
+      ++cache.m_VertexCornerOffsets[ cache.m_CellPointIds[ k ] + 1 ];
+    }
+    for( SizeValueType i = 0; i < numberOfPoints; ++i )
+    {
+      cache.m_VertexCornerOffsets[ i + 1 ] += cache.m_VertexCornerOffsets[ i ];
+    }
+    std::vector< SizeValueType > position(
+      cache.m_VertexCornerOffsets.begin(), cache.m_VertexCornerOffsets.end() - 1 );
+    cache.m_VertexCorners.resize( numberOfCorners );
+    for( SizeValueType k = 0; k < numberOfCorners; ++k )
+    {
+      cache.m_VertexCorners[ position[ cache.m_CellPointIds[ k ] ]++ ] = k;
+    }
+
+    this->m_NumberOfVertices += numberOfPoints;
+    this->m_NumberOfCells    += numberOfCorners / FixedPointSetDimension;
+  }
+
+  /** The Jacobians of the vertices are computed again, for the current transform. */
+  this->m_VertexJacobians.clear();
+  this->m_VertexNonZeroJacobianIndices.clear();
+  this->m_VertexJacobianCacheIsValid = false;
+
+} // end InitializeMeshCaches()
+
+
 /**
  * ******************* GetValue *******************
  */
@@ -110,18 +228,19 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
   {
     itkExceptionMacro( << "FixedMeshContainer mesh has not been assigned" );
   }
-
-  /** Initialize some variables */
-  MeasureType value = NumericTraits< MeasureType >::Zero;
-
-  //OutputPointType fixedPoint;
-  /** Get the current corresponding points. */
+  if( this->m_MeshCaches.size() != fixedMeshContainer->Size() )
+  {
+    itkExceptionMacro( << "The metric has not been initialized" );
+  }
 
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  DerivativeType dummyDerivative;
-  this->GetValueAndDerivative( parameters, value, dummyDerivative );
+  /** Let the threads compute the volumes, without the derivatives. */
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreadsForPoints( this->m_NumberOfVertices );
+  this->m_ComputeDerivative = false;
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->LaunchGetValueAndDerivativeThreaderCallbacks( numberOfThreads, value );
 
   return value;
 
@@ -165,179 +284,459 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
   {
     itkExceptionMacro( << "FixedMeshContainer mesh has not been assigned" );
   }
+  if( this->m_MeshCaches.size() != fixedMeshContainer->Size() )
+  {
+    itkExceptionMacro( << "The metric has not been initialized" );
+  }
 
-  /** Initialize some variables */
-  value = NumericTraits< MeasureType >::Zero;
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   * See the CorrespondingPointsEuclideanDistancePointMetric for the use
+   * in the CombinationImageToImageMetric.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
 
-  /** Make sure the transform parameters are up to date. */
-  this->SetTransformParameters( parameters );
+  /** Let the threads compute the volumes and their derivatives. */
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreadsForPoints( this->m_NumberOfVertices );
+  this->m_ComputeDerivative = true;
+  value                     = NumericTraits< MeasureType >::Zero;
+  this->LaunchGetValueAndDerivativeThreaderCallbacks( numberOfThreads, value );
 
+  /** Merge the per-thread derivatives. */
   derivative = DerivativeType( this->GetNumberOfParameters() );
-  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
+  this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    &this->m_ThreaderMetricParameters, numberOfThreads );
 
-  NonZeroJacobianIndicesType nzji( this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-  TransformJacobianType      jacobian;
+} // end GetValueAndDerivative()
 
-  const FixedMeshContainerElementIdentifier numberOfMeshes = this->m_FixedMeshContainer->Size();
 
-  typedef typename FixedMeshType::PointType FixedMeshPointType;
+/**
+ * ******************* LaunchGetValueAndDerivativeThreaderCallbacks *******************
+ */
 
-  FixedMeshPointType zeroPoint = typename FixedMeshPointType::Point();
-  zeroPoint.Fill( 0.0 );
+template< class TFixedPointSet, class TMovingPointSet >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::LaunchGetValueAndDerivativeThreaderCallbacks( const ThreadIdType numberOfThreads,
+  MeasureType & measure ) const
+{
+  this->InitializeThreadingParameters( numberOfThreads );
+
+  /** The Jacobian of a B-spline transform does not depend on its parameters,
+   * so the Jacobians of the vertices are computed once, with the mapping of
+   * the vertices, if they fit in the memory budget.
+   */
+  this->m_BuildVertexJacobianCache = false;
+  if( this->m_ComputeDerivative && !this->m_VertexJacobianCacheIsValid
+    && this->m_Transform->GetHasNonZeroJacobianIndicesDescriptor() )
+  {
+    const unsigned long nnzji     = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+    const SizeValueType cacheSize = this->m_NumberOfVertices * nnzji
+      * ( MovingPointSetDimension * sizeof( TransformParametersValueType ) + sizeof( unsigned long ) );
+    if( cacheSize <= this->m_MaximumVertexJacobianCacheSize )
+    {
+      this->m_VertexJacobians.resize( this->m_NumberOfVertices * MovingPointSetDimension * nnzji );
+      this->m_VertexNonZeroJacobianIndices.resize( this->m_NumberOfVertices * nnzji );
+      this->m_BuildVertexJacobianCache = true;
+    }
+  }
 
-  typename MeshPointsContainerType::Pointer pointCentroids = FixedMeshType::PointsContainer::New();
-  pointCentroids->resize( numberOfMeshes, typename FixedMeshPointType::Point( zeroPoint ) );
+  /** Map the vertices. */
+  this->ExecuteThreaderCallback( Self::TransformPointsThreaderCallback,
+    &this->m_ThreaderMetricParameters, numberOfThreads );
+  if( this->m_BuildVertexJacobianCache )
+  {
+    this->m_VertexJacobianCacheIsValid = true;
+    this->m_BuildVertexJacobianCache   = false;
+  }
 
-  for( FixedMeshContainerElementIdentifier meshId = 0; meshId < numberOfMeshes; ++meshId ) // loop over all meshes in container
+  /** The centroids of the mapped meshes. */
+  for( SizeValueType meshId = 0; meshId < this->m_MeshCaches.size(); ++meshId )
   {
-    const FixedMeshConstPointer           fixedMesh      = fixedMeshContainer->ElementAt( meshId );
-    const MeshPointsContainerConstPointer fixedPoints    = fixedMesh->GetPoints();
-    const unsigned int                    numberOfPoints = fixedPoints->Size();
+    MeshCacheType &     cache          = this->m_MeshCaches[ meshId ];
+    const SizeValueType numberOfPoints = cache.m_MappedPoints.size();
+    cache.m_Centroid.Fill( 0.0 );
+    for( SizeValueType i = 0; i < numberOfPoints; ++i )
+    {
+      cache.m_Centroid.GetVnlVector() += cache.m_MappedPoints[ i ].GetVnlVector();
+    }
+    if( numberOfPoints > 0 )
+    {
+      cache.m_Centroid.GetVnlVector() /= numberOfPoints;
+    }
+  }
+
+  /** Compute the volumes, and gather them in thread order. */
+  this->ExecuteThreaderCallback( Self::ComputeVolumesThreaderCallback,
+    &this->m_ThreaderMetricParameters, numberOfThreads );
+  measure = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    measure += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+  }
+
+  /** Gather the corner derivatives at the vertices. */
+  if( this->m_ComputeDerivative )
+  {
+    this->ExecuteThreaderCallback( Self::ComputeDerivativeThreaderCallback,
+      &this->m_ThreaderMetricParameters, numberOfThreads );
+  }
+
+} // end LaunchGetValueAndDerivativeThreaderCallbacks()
+
+
+/**
+ * ******************* TransformPointsThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::TransformPointsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = static_cast< const Self * >( temp->st_Metric );
+
+  metric->ThreadedTransformPoints( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TransformPointsThreaderCallback()
+
+
+/**
+ * ******************* ComputeVolumesThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ComputeVolumesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = static_cast< const Self * >( temp->st_Metric );
 
-    const FixedMeshPointer           mappedMesh   = this->m_MappedMeshContainer->ElementAt( meshId );
-    const MeshPointsContainerPointer mappedPoints = mappedMesh->GetPoints();
+  metric->ThreadedComputeVolumes( infoStruct->ThreadID, infoStruct->NumberOfThreads );
 
-    typename FixedMeshType::PointType &              pointCentroid = pointCentroids->ElementAt( meshId );
-    typedef typename FixedMeshType::PointsContainer FixedMeshPointsContainerType;
-    typename FixedMeshType::PointsContainer::Pointer derivPoints = FixedMeshPointsContainerType::New();
+  return ITK_THREAD_RETURN_VALUE;
 
-    derivPoints->resize( numberOfPoints, typename FixedMeshPointType::Point( zeroPoint ) );
+} // end ComputeVolumesThreaderCallback()
 
-    MeshPointsContainerConstIteratorType fixedPointIt  = fixedPoints->Begin();
-    MeshPointsContainerIteratorType      mappedPointIt = mappedPoints->Begin();
-    MeshPointsContainerConstIteratorType fixedPointEnd = fixedPoints->End();
 
-    for(; fixedPointIt != fixedPointEnd; ++fixedPointIt, ++mappedPointIt )
+/**
+ * ******************* ComputeDerivativeThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ComputeDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = static_cast< const Self * >( temp->st_Metric );
+
+  metric->ThreadedComputeDerivative( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeDerivativeThreaderCallback()
+
+
+/**
+ * ******************* ThreadedTransformPoints *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ThreadedTransformPoints( const ThreadIdType threadId,
+  const ThreadIdType numberOfThreads ) const
+{
+  /** Get the part of the vertices of this thread. */
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  this->SplitRangeForThread( this->m_NumberOfVertices, threadId, numberOfThreads, begin, end );
+
+  const unsigned long nnzji        = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const unsigned long jacobianSize = MovingPointSetDimension * nnzji;
+
+  for( SizeValueType meshId = 0; meshId < this->m_MeshCaches.size(); ++meshId )
+  {
+    MeshCacheType &     cache     = this->m_MeshCaches[ meshId ];
+    const SizeValueType meshBegin = vnl_math_max( begin, cache.m_VertexOffset );
+    const SizeValueType meshEnd   = vnl_math_min( end,
+      cache.m_VertexOffset + static_cast< SizeValueType >( cache.m_FixedPoints.size() ) );
+    if( meshBegin >= meshEnd )
     {
-      const OutputPointType mappedPoint = this->m_Transform->TransformPoint( fixedPointIt->Value() );
-      mappedPointIt.Value()         = mappedPoint;
-      pointCentroid.GetVnlVector() += mappedPoint.GetVnlVector();
+      continue;
     }
-    pointCentroid.GetVnlVector() /= numberOfPoints;
-
-    typename FixedMeshType::CellsContainerConstIterator cellBegin = fixedMesh->GetCells()->Begin();
-    typename FixedMeshType::CellsContainerConstIterator cellEnd   = fixedMesh->GetCells()->End();
+    const SizeValueType first          = meshBegin - cache.m_VertexOffset;
+    const SizeValueType numberOfPoints = meshEnd - meshBegin;
 
-    typename CellInterfaceType::PointIdIterator beginpointer;
-    float sumSignedVolume = 0.0;
-    float sumAbsVolume    = 0.0;
+    this->m_Transform->TransformPoints( &( cache.m_FixedPoints[ first ] ),
+      numberOfPoints, &( cache.m_MappedPoints[ first ] ) );
 
-    const float eps = 0.00001;
+    /** Also store them in the mapped mesh, for writing the result mesh. */
+    for( SizeValueType i = first; i < first + numberOfPoints; ++i )
+    {
+      cache.m_MappedPointsContainer->ElementAt( i ) = cache.m_MappedPoints[ i ];
+    }
 
-    for(; cellBegin != cellEnd; ++cellBegin )
+    if( this->m_BuildVertexJacobianCache )
     {
-      beginpointer = cellBegin->Value()->PointIdsBegin();
-      float signedVolume;  // = vnl_determinant(fullMatrix.GetVnlMatrix());
+      this->m_Transform->GetJacobians( &( cache.m_FixedPoints[ first ] ), numberOfPoints,
+        &( this->m_VertexJacobians[ meshBegin * jacobianSize ] ),
+        &( this->m_VertexNonZeroJacobianIndices[ meshBegin * nnzji ] ) );
+    }
+  }
 
-      //const VectorType::const_pointer p1,p2,p3,p4;
-      switch( static_cast< unsigned int >( FixedPointSetDimension ) )
-      {
-        case 2:
-        {
-          const FixedMeshPointIdentifier p1Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p1   = mappedPoints->GetElement( p1Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p2Id = *beginpointer;
-          ++beginpointer;
-          const VectorType p2 = mappedPoints->GetElement( p2Id ) - pointCentroid;
+} // end ThreadedTransformPoints()
 
-          signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer() );
 
-          const int sign = ( signedVolume > eps ) - ( signedVolume < -eps );
-          if( sign != 0 )
-          {
-            derivPoints->at( p1Id )[ 0 ] += sign * p2[ 1 ];
-            derivPoints->at( p1Id )[ 1 ] -= sign * p2[ 0 ];
-            derivPoints->at( p2Id )[ 0 ] -= sign * p1[ 1 ];
-            derivPoints->at( p2Id )[ 1 ] += sign * p1[ 0 ];
-          }
+/**
+ * ******************* ThreadedComputeVolumes *******************
+ */
 
-        }
-        break;
-        case 3:
-        {
-          const FixedMeshPointIdentifier p1Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p1   = mappedPoints->GetElement( p1Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p2Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p2   = mappedPoints->GetElement( p2Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p3Id = *beginpointer;
-          ++beginpointer;
-          const VectorType p3 = mappedPoints->GetElement( p3Id ) - pointCentroid;
+template< class TFixedPointSet, class TMovingPointSet >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ThreadedComputeVolumes( const ThreadIdType threadId,
+  const ThreadIdType numberOfThreads ) const
+{
+  /** Get the part of the cells of this thread. */
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  this->SplitRangeForThread( this->m_NumberOfCells, threadId, numberOfThreads, begin, end );
+
+  const unsigned int dimension         = FixedPointSetDimension;
+  const bool         computeDerivative = this->m_ComputeDerivative;
+  MeasureType        measure           = NumericTraits< MeasureType >::Zero;
 
-          signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer(), p3.GetDataPointer() );
+  for( SizeValueType meshId = 0; meshId < this->m_MeshCaches.size(); ++meshId )
+  {
+    MeshCacheType &     cache     = this->m_MeshCaches[ meshId ];
+    const SizeValueType meshBegin = vnl_math_max( begin, cache.m_CellOffset );
+    const SizeValueType meshEnd   = vnl_math_min( end, cache.m_CellOffset
+      + static_cast< SizeValueType >( cache.m_CellPointIds.size() / dimension ) );
 
-          const int sign = ( ( signedVolume > eps ) - ( signedVolume < -eps ) );
+    for( SizeValueType cell = meshBegin; cell < meshEnd; ++cell )
+    {
+      const SizeValueType localCell = cell - cache.m_CellOffset;
+      double *            cornerDerivatives = computeDerivative
+        ? &( cache.m_CornerDerivatives[ localCell * dimension * dimension ] ) : 0;
 
-          if( sign != 0 )
-          {
-            derivPoints->at( p1Id )[ 0 ] += sign * ( p2[ 1 ] * p3[ 2 ] - p2[ 2 ] * p3[ 1 ] );
-            derivPoints->at( p1Id )[ 1 ] += sign * ( p2[ 2 ] * p3[ 0 ] - p2[ 0 ] * p3[ 2 ] );
-            derivPoints->at( p1Id )[ 2 ] += sign * ( p2[ 0 ] * p3[ 1 ] - p2[ 1 ] * p3[ 0 ] );
+      const double signedVolume = this->ComputeSignedVolume( &( cache.m_MappedPoints[ 0 ] ),
+        cache.m_Centroid, &( cache.m_CellPointIds[ localCell * dimension ] ), cornerDerivatives );
+      measure += vcl_abs( signedVolume );
+    }
+  }
+
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value = measure;
+
+} // end ThreadedComputeVolumes()
+
+
+/**
+ * ******************* ThreadedComputeDerivative *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ThreadedComputeDerivative( const ThreadIdType threadId,
+  const ThreadIdType numberOfThreads ) const
+{
+  /** Get the part of the vertices of this thread. */
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  this->SplitRangeForThread( this->m_NumberOfVertices, threadId, numberOfThreads, begin, end );
+
+  GetValueAndDerivativePerThreadStruct & perThread
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  DerivativeValueType * derivative = perThread.st_Derivative.data_block();
+
+  /** Without the cache, the Jacobians are computed a chunk of vertices at a time. */
+  const unsigned int  dimension    = FixedPointSetDimension;
+  const unsigned long nnzji        = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const unsigned long jacobianSize = MovingPointSetDimension * nnzji;
+  const bool          useCache     = this->m_VertexJacobianCacheIsValid;
+  if( !useCache )
+  {
+    perThread.st_Jacobians.resize( PointChunkSize * jacobianSize );
+    perThread.st_NonZeroJacobianIndices.resize( PointChunkSize * nnzji );
+  }
 
-            derivPoints->at( p2Id )[ 0 ] += sign * ( p1[ 2 ] * p3[ 1 ] - p1[ 1 ] * p3[ 2 ] );
-            derivPoints->at( p2Id )[ 1 ] += sign * ( p1[ 0 ] * p3[ 2 ] - p1[ 2 ] * p3[ 0 ] );
-            derivPoints->at( p2Id )[ 2 ] += sign * ( p1[ 1 ] * p3[ 0 ] - p1[ 0 ] * p3[ 1 ] );
+  for( SizeValueType meshId = 0; meshId < this->m_MeshCaches.size(); ++meshId )
+  {
+    const MeshCacheType & cache     = this->m_MeshCaches[ meshId ];
+    const SizeValueType   meshBegin = vnl_math_max( begin, cache.m_VertexOffset );
+    const SizeValueType   meshEnd   = vnl_math_min( end,
+      cache.m_VertexOffset + static_cast< SizeValueType >( cache.m_FixedPoints.size() ) );
 
-            derivPoints->at( p3Id )[ 0 ] += sign * ( p1[ 1 ] * p2[ 2 ] - p1[ 2 ] * p2[ 1 ] );
-            derivPoints->at( p3Id )[ 1 ] += sign * ( p1[ 2 ] * p2[ 0 ] - p1[ 0 ] * p2[ 2 ] );
-            derivPoints->at( p3Id )[ 2 ] += sign * ( p1[ 0 ] * p2[ 1 ] - p1[ 1 ] * p2[ 0 ] );
+    for( SizeValueType chunkBegin = meshBegin; chunkBegin < meshEnd; chunkBegin += PointChunkSize )
+    {
+      const SizeValueType chunkSize = vnl_math_min(
+        meshEnd - chunkBegin, static_cast< SizeValueType >( PointChunkSize ) );
+      const SizeValueType first = chunkBegin - cache.m_VertexOffset;
+      if( !useCache )
+      {
+        this->m_Transform->GetJacobians( &( cache.m_FixedPoints[ first ] ), chunkSize,
+          &( perThread.st_Jacobians[ 0 ] ), &( perThread.st_NonZeroJacobianIndices[ 0 ] ) );
+      }
 
+      for( SizeValueType p = 0; p < chunkSize; ++p )
+      {
+        /** Sum the derivatives with respect to the corners at this vertex. */
+        const SizeValueType vertex = first + p;
+        double              pointDerivative[ FixedPointSetDimension ];
+        bool                isZero = true;
+        for( unsigned int d = 0; d < dimension; ++d )
+        {
+          pointDerivative[ d ] = 0.0;
+        }
+        for( SizeValueType k = cache.m_VertexCornerOffsets[ vertex ];
+          k < cache.m_VertexCornerOffsets[ vertex + 1 ]; ++k )
+        {
+          const double * corner = &( cache.m_CornerDerivatives[ cache.m_VertexCorners[ k ] * dimension ] );
+          for( unsigned int d = 0; d < dimension; ++d )
+          {
+            pointDerivative[ d ] += corner[ d ];
+            isZero               &= corner[ d ] == 0.0;
           }
         }
+        if( isZero )
+        {
+          continue;
+        }
 
-        break;
-        case 4:
+        /** Multiply by the TransformJacobian dT/dmu. */
+        const TransformParametersValueType * jacobian = useCache
+          ? &( this->m_VertexJacobians[ ( chunkBegin + p ) * jacobianSize ] )
+          : &( perThread.st_Jacobians[ p * jacobianSize ] );
+        const unsigned long * nzji = useCache
+          ? &( this->m_VertexNonZeroJacobianIndices[ ( chunkBegin + p ) * nnzji ] )
+          : &( perThread.st_NonZeroJacobianIndices[ p * nnzji ] );
+        for( unsigned long k = 0; k < nnzji; ++k )
         {
-          const VectorConstPointer p1 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p2 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p3 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p4 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          signedVolume = vnl_determinant( p1, p2, p3, p4 );
+          double sum = 0.0;
+          for( unsigned int d = 0; d < dimension; ++d )
+          {
+            sum += pointDerivative[ d ] * jacobian[ d * nnzji + k ];
+          }
+          derivative[ nzji[ k ] ] += sum;
         }
-        break;
-        default:
-          std::cout << "no dimensions higher than 4"  << std::endl;
+        this->MarkTouchedDerivativeBlocks( threadId, nzji, nnzji );
       }
-
-      sumSignedVolume +=  signedVolume;
-      sumAbsVolume    += vcl_abs( signedVolume );
     }
+  }
+
+} // end ThreadedComputeDerivative()
 
-    /** Create iterators. */
-    fixedPointIt = fixedPoints->Begin();
-    unsigned int pointIndex;
-    /** Loop over points. */
-    for( pointIndex = 0; fixedPointIt != fixedPointEnd; ++fixedPointIt, ++pointIndex )
+
+/**
+ * ******************* ComputeSignedVolume *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+double
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ComputeSignedVolume( const OutputPointType * mappedPoints,
+  const OutputPointType & centroid, const SizeValueType * pointIds,
+  double * cornerDerivatives ) const
+{
+  const double eps          = 0.00001;
+  double       signedVolume = 0.0;
+
+  switch( static_cast< unsigned int >( FixedPointSetDimension ) )
+  {
+    case 2:
     {
-      /** Get the TransformJacobian dT/dmu. */
-      this->m_Transform->GetJacobian( fixedPointIt.Value(), jacobian, nzji );
-      if( nzji.size() == this->GetNumberOfParameters() )
+      const VectorType p1 = mappedPoints[ pointIds[ 0 ] ] - centroid;
+      const VectorType p2 = mappedPoints[ pointIds[ 1 ] ] - centroid;
+
+      signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer() );
+
+      if( cornerDerivatives )
       {
-        /** Loop over all Jacobians. */
-        derivative += derivPoints->at( pointIndex ).GetVnlVector() * jacobian; //* sumAbsVolumeEps;
+        const int sign = ( signedVolume > eps ) - ( signedVolume < -eps );
+        cornerDerivatives[ 0 ] =  sign * p2[ 1 ];
+        cornerDerivatives[ 1 ] = -sign * p2[ 0 ];
+        cornerDerivatives[ 2 ] = -sign * p1[ 1 ];
+        cornerDerivatives[ 3 ] =  sign * p1[ 0 ];
       }
-      else
+    }
+    break;
+    case 3:
+    {
+      const VectorType p1 = mappedPoints[ pointIds[ 0 ] ] - centroid;
+      const VectorType p2 = mappedPoints[ pointIds[ 1 ] ] - centroid;
+      const VectorType p3 = mappedPoints[ pointIds[ 2 ] ] - centroid;
+
+      signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer(), p3.GetDataPointer() );
+
+      if( cornerDerivatives )
       {
-        /** Only pick the nonzero Jacobians. */
-        for( unsigned int i = 0; i < nzji.size(); ++i )
-        {
-          const unsigned int index  = nzji[ i ];
-          VnlVectorType      column = jacobian.get_column( i );
-          derivative[ index ] += dot_product( derivPoints->at( pointIndex ).GetVnlVector(), column ); // *sumAbsVolumeEps;
-        }
+        const int sign = ( signedVolume > eps ) - ( signedVolume < -eps );
+        cornerDerivatives[ 0 ] = sign * ( p2[ 1 ] * p3[ 2 ] - p2[ 2 ] * p3[ 1 ] );
+        cornerDerivatives[ 1 ] = sign * ( p2[ 2 ] * p3[ 0 ] - p2[ 0 ] * p3[ 2 ] );
+        cornerDerivatives[ 2 ] = sign * ( p2[ 0 ] * p3[ 1 ] - p2[ 1 ] * p3[ 0 ] );
+
+        cornerDerivatives[ 3 ] = sign * ( p1[ 2 ] * p3[ 1 ] - p1[ 1 ] * p3[ 2 ] );
+        cornerDerivatives[ 4 ] = sign * ( p1[ 0 ] * p3[ 2 ] - p1[ 2 ] * p3[ 0 ] );
+        cornerDerivatives[ 5 ] = sign * ( p1[ 1 ] * p3[ 0 ] - p1[ 0 ] * p3[ 1 ] );
+
+        cornerDerivatives[ 6 ] = sign * ( p1[ 1 ] * p2[ 2 ] - p1[ 2 ] * p2[ 1 ] );
+        cornerDerivatives[ 7 ] = sign * ( p1[ 2 ] * p2[ 0 ] - p1[ 0 ] * p2[ 2 ] );
+        cornerDerivatives[ 8 ] = sign * ( p1[ 0 ] * p2[ 1 ] - p1[ 1 ] * p2[ 0 ] );
+      }
+    }
+    break;
+    case 4:
+    {
+      /** The derivative is not implemented for 4D meshes. */
+      signedVolume = vnl_determinant(
+        mappedPoints[ pointIds[ 0 ] ].GetDataPointer(), mappedPoints[ pointIds[ 1 ] ].GetDataPointer(),
+        mappedPoints[ pointIds[ 2 ] ].GetDataPointer(), mappedPoints[ pointIds[ 3 ] ].GetDataPointer() );
+
+      if( cornerDerivatives )
+      {
+        std::fill( cornerDerivatives, cornerDerivatives + 16, 0.0 );
       }
+    }
+    break;
+    default:
+      break;
+  }
 
-    }   // end loop over all corresponding points
+  return signedVolume;
 
-    /** Check if enough samples were valid. */
+} // end ComputeSignedVolume()
 
-    /** Copy the measure to value. */
-    value += sumAbsVolume;
 
-  } // end loop over all meshes in container
-} // end GetValueAndDerivative()
+/**
+ * ******************* GetVertexJacobianCacheMemoryUsage *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+SizeValueType
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::GetVertexJacobianCacheMemoryUsage( void ) const
+{
+  return this->m_VertexJacobians.capacity() * sizeof( TransformParametersValueType )
+         + this->m_VertexNonZeroJacobianIndices.capacity() * sizeof( unsigned long );
+
+} // end GetVertexJacobianCacheMemoryUsage()
 
 
 /**
@@ -27,6 +27,7 @@
 #include "itkOptimizer.h"
 #include "itkAdvancedCombinationTransform.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include <vector>
 
 namespace itk
 {
@@ -83,6 +84,8 @@ public:
   typedef typename Superclass::FixedImageConstPointer  FixedImageConstPointer;
   typedef typename Superclass::MovingImageConstPointer MovingImageConstPointer;
   typedef typename Superclass::MovingImagePointer      MovingImagePointer;
+  typedef typename Superclass::FixedImageMaskType      FixedImageMaskType;
+  typedef typename Superclass::ThreadInfoType          ThreadInfoType;
   typedef typename TFixedImage::PixelType              FixedImagePixelType;
   typedef typename TMovingImage::PixelType             MovedImagePixelType;
   typedef typename itk::Optimizer                      OptimizerType;
@@ -166,9 +169,21 @@ protected:
 
   void ComputeMeanFixedGradient( void ) const;
 
-  /** Compute the similarity measure  */
+  /** Compute the similarity measure from the current moved image gradients. */
   MeasureType ComputeMeasure( const TransformParametersType & parameters ) const;
 
+  /** The loops of ComputeMeanMovedGradient() and ComputeMeasure() run
+   * multi-threaded; every thread adds up its slab of the fixed image region
+   * into its own entries of m_ThreaderSums, which are then added in order.
+   */
+  void ThreadedAccumulateGradients( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Launch ThreadedAccumulateGradients() and add the sums of the threads. */
+  void AccumulateGradients( const bool computeMeasure, MeasureType * sums ) const;
+
+  /** Static callback for the threads. */
+  static ITK_THREAD_RETURN_TYPE AccumulateGradientsThreaderCallback( void * arg );
+
   typedef NeighborhoodOperatorImageFilter<
     FixedGradientImageType, FixedGradientImageType >        FixedSobelFilter;
   typedef NeighborhoodOperatorImageFilter<
@@ -189,6 +204,11 @@ private:
   /** The mean of the fixed image gradients. */
   mutable FixedGradientPixelType m_MeanFixedGradient[ FixedImageDimension ];
 
+  /** Variables for ThreadedAccumulateGradients(). */
+  itkStaticConstMacro( NumberOfThreaderSums, unsigned int, 4 );
+  mutable std::vector< MeasureType > m_ThreaderSums;
+  mutable bool                       m_ThreaderComputeMeasure;
+
   /** The filter for transforming the moving images. */
   TransformMovingImageFilterPointer m_TransformMovingImageFilter;
 
@@ -43,6 +43,7 @@ NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_CombinationTransform       = CombinationTransformType::New();
   this->m_TransformMovingImageFilter = TransformMovingImageFilterType::New();
   this->m_DerivativeDelta            = 0.001;
+  this->m_ThreaderComputeMeasure     = false;
 
   for( unsigned int iDimension = 0; iDimension < MovedImageDimension; iDimension++ )
   {
@@ -223,181 +224,167 @@ void
 NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::ComputeMeanMovedGradient( void ) const
 {
-  typename MovedGradientImageType::IndexType currentIndex;
-  typename MovedGradientImageType::PointType point;
+  /** Add up the moved image gradients inside the fixed mask. */
+  MeasureType sums[ NumberOfThreaderSums ];
+  this->AccumulateGradients( false, sums );
 
-  for( int iDimension = 0; iDimension < MovedImageDimension; iDimension++ )
-  {
-    this->m_MovedSobelFilters[ iDimension ]->UpdateLargestPossibleRegion();
-  }
+  const MeasureType nPixels = sums[ 2 ];
+  this->m_MeanMovedGradient[ 0 ] = sums[ 0 ] / nPixels;
+  this->m_MeanMovedGradient[ 1 ] = sums[ 1 ] / nPixels;
 
-  typedef  itk::ImageRegionConstIteratorWithIndex< MovedGradientImageType >
-    MovedIteratorType;
-
-  MovedIteratorType movedIteratorx( this->m_MovedSobelFilters[ 0 ]->GetOutput(),
-  this->GetFixedImageRegion() );
-  MovedIteratorType movedIteratory( this->m_MovedSobelFilters[ 1 ]->GetOutput(),
-  this->GetFixedImageRegion() );
+} // end ComputeMeanMovedGradient()
 
-  movedIteratorx.GoToBegin();
-  movedIteratory.GoToBegin();
 
-  bool sampleOK = false;
+/**
+ * ***************** ComputeMeasure *****************
+ */
 
-  if( this->m_FixedImageMask.IsNull() )
-  {
-    sampleOK = true;
-  }
+template< class TFixedImage, class TMovingImage >
+typename NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMeasure( const TransformParametersType & itkNotUsed( parameters ) ) const
+{
+  /** The moved image and its gradients are already up-to-date, see GetValue().
+   * Add up the correlations of the normalized gradients inside the fixed mask.
+   */
+  MeasureType sums[ NumberOfThreaderSums ];
+  this->AccumulateGradients( true, sums );
 
-  MovedGradientPixelType movedGradient[ MovedImageDimension ];
+  const MeasureType NGcrosscorrelation      = sums[ 0 ];
+  const MeasureType NGautocorrelationmoving = sums[ 1 ];
+  const MeasureType NGautocorrelationfixed  = sums[ 2 ];
+  this->m_NumberOfPixelsCounted = static_cast< unsigned long >( sums[ 3 ] );
 
-  for( int i = 0; i < MovedImageDimension; i++ )
-  {
-    movedGradient[ i ] = 0.0;
-  }
+  const MeasureType measure = -1.0 * ( NGcrosscorrelation
+    / ( vcl_sqrt( NGautocorrelationfixed ) * vcl_sqrt( NGautocorrelationmoving ) ) );
+  return measure;
 
-  unsigned long nPixels = 0;
+} // end ComputeMeasure()
 
-  while( !movedIteratorx.IsAtEnd() )
-  {
-    /** Get current index */
-    currentIndex = movedIteratorx.GetIndex();
-    this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
 
-    /** if fixedMask is given */
-    if( !this->m_FixedImageMask.IsNull() )
-    {
-      if( this->m_FixedImageMask->IsInside( point ) )
-      {
-        sampleOK = true;
-      }
-      else
-      {
-        sampleOK = false;
-      }
-    }
+/**
+ * ***************** AccumulateGradients *****************
+ */
 
-    if( sampleOK )
-    {
-      movedGradient[ 0 ] += movedIteratorx.Get();
-      movedGradient[ 1 ] += movedIteratory.Get();
-      nPixels++;
-    } // end if sampleOK
+template< class TFixedImage, class TMovingImage >
+void
+NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulateGradients( const bool computeMeasure, MeasureType * sums ) const
+{
+  const ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  this->m_ThreaderComputeMeasure = computeMeasure;
+  this->m_ThreaderSums.assign( numberOfThreads * NumberOfThreaderSums,
+    NumericTraits< MeasureType >::Zero );
 
-    ++movedIteratorx;
-    ++movedIteratory;
-  } // end while
+  this->ExecuteThreaderCallback( this->AccumulateGradientsThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( this ) ) );
 
-  this->m_MeanMovedGradient[ 0 ] = movedGradient[ 0 ] / nPixels;
-  this->m_MeanMovedGradient[ 1 ] = movedGradient[ 1 ] / nPixels;
+  /** Add the sums of the threads in a fixed order. */
+  for( unsigned int k = 0; k < NumberOfThreaderSums; ++k )
+  {
+    sums[ k ] = NumericTraits< MeasureType >::Zero;
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      sums[ k ] += this->m_ThreaderSums[ i * NumberOfThreaderSums + k ];
+    }
+  }
 
-} // end ComputeMeanMovedGradient()
+} // end AccumulateGradients()
 
 
 /**
- * ***************** ComputeMeasure *****************
+ * ***************** AccumulateGradientsThreaderCallback *****************
  */
 
 template< class TFixedImage, class TMovingImage >
-typename NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+ITK_THREAD_RETURN_TYPE
 NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
-::ComputeMeasure( const TransformParametersType & parameters ) const
+::AccumulateGradientsThreaderCallback( void * arg )
 {
-  this->SetTransformParameters( parameters );
-  this->m_TransformMovingImageFilter->Modified();
-  this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const Self *     self       = static_cast< const Self * >( infoStruct->UserData );
 
-  typename FixedImageType::IndexType currentIndex;
-  typename FixedImageType::PointType point;
+  self->ThreadedAccumulateGradients( infoStruct->ThreadID, infoStruct->NumberOfThreads );
 
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  return ITK_THREAD_RETURN_VALUE;
 
-  MovedGradientPixelType NmovedGradient[ FixedImageDimension ];
-  FixedGradientPixelType NfixedGradient[ FixedImageDimension ];
+} // end AccumulateGradientsThreaderCallback()
 
-  MeasureType NGcrosscorrelation      = NumericTraits< MeasureType >::Zero;
-  MeasureType NGautocorrelationfixed  = NumericTraits< MeasureType >::Zero;
-  MeasureType NGautocorrelationmoving = NumericTraits< MeasureType >::Zero;
 
-  /** Make sure all is updated */
-  for( int iDimension = 0; iDimension < FixedImageDimension; iDimension++ )
+/**
+ * ***************** ThreadedAccumulateGradients *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedAccumulateGradients( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Get the slab of the fixed image region of this thread. */
+  FixedImageRegionType region;
+  if( !this->SplitFixedImageRegionForThread( this->GetFixedImageRegion(), threadId, numberOfThreads, region ) )
   {
-    this->m_FixedSobelFilters[ iDimension ]->UpdateLargestPossibleRegion();
-    this->m_MovedSobelFilters[ iDimension ]->UpdateLargestPossibleRegion();
+    return;
   }
 
-  typedef  itk::ImageRegionConstIteratorWithIndex< FixedGradientImageType >
-    FixedIteratorType;
-
-  FixedIteratorType fixedIteratorx( this->m_FixedSobelFilters[ 0 ]->GetOutput(),
-  this->GetFixedImageRegion() );
-  FixedIteratorType fixedIteratory( this->m_FixedSobelFilters[ 1 ]->GetOutput(),
-  this->GetFixedImageRegion() );
-
-  fixedIteratorx.GoToBegin();
-  fixedIteratory.GoToBegin();
-
-  typedef  itk::ImageRegionConstIteratorWithIndex< MovedGradientImageType >
-    MovedIteratorType;
-
-  MovedIteratorType movedIteratorx( this->m_MovedSobelFilters[ 0 ]->GetOutput(),
-  this->GetFixedImageRegion() );
-  MovedIteratorType movedIteratory( this->m_MovedSobelFilters[ 1 ]->GetOutput(),
-  this->GetFixedImageRegion() );
-
-  movedIteratorx.GoToBegin();
-  movedIteratory.GoToBegin();
+  typedef ImageRegionConstIteratorWithIndex< FixedGradientImageType > FixedIteratorType;
+  typedef ImageRegionConstIteratorWithIndex< MovedGradientImageType > MovedIteratorType;
 
-  this->m_NumberOfPixelsCounted = 0;
-  bool sampleOK = false;
+  FixedIteratorType fixedIteratorx( this->m_FixedSobelFilters[ 0 ]->GetOutput(), region );
+  FixedIteratorType fixedIteratory( this->m_FixedSobelFilters[ 1 ]->GetOutput(), region );
+  MovedIteratorType movedIteratorx( this->m_MovedSobelFilters[ 0 ]->GetOutput(), region );
+  MovedIteratorType movedIteratory( this->m_MovedSobelFilters[ 1 ]->GetOutput(), region );
 
-  if( this->m_FixedImageMask.IsNull() )
+  const bool                computeMeasure = this->m_ThreaderComputeMeasure;
+  const FixedImageMaskType * fixedMask     = this->m_FixedImageMask.GetPointer();
+  MeasureType               sums[ NumberOfThreaderSums ];
+  for( unsigned int k = 0; k < NumberOfThreaderSums; ++k )
   {
-    sampleOK = true;
+    sums[ k ] = NumericTraits< MeasureType >::Zero;
   }
 
+  typename FixedImageType::PointType point;
   while( !fixedIteratorx.IsAtEnd() )
   {
-    currentIndex = fixedIteratorx.GetIndex();
-    this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
-
     /** if fixedMask is given */
-    if( !this->m_FixedImageMask.IsNull() )
+    bool sampleOK = true;
+    if( fixedMask != 0 )
     {
-      if( this->m_FixedImageMask->IsInside( point ) )
-      {
-        sampleOK = true;
-      }
-      else
-      {
-        sampleOK = false;
-      }
+      this->m_FixedImage->TransformIndexToPhysicalPoint( fixedIteratorx.GetIndex(), point );
+      sampleOK = fixedMask->IsInside( point );
     }
 
-    if( sampleOK )
+    if( sampleOK && computeMeasure )
     {
-      NmovedGradient[ 0 ]      = movedIteratorx.Get() - this->m_MeanMovedGradient[ 0 ];
-      NfixedGradient[ 0 ]      = fixedIteratorx.Get() - this->m_MeanFixedGradient[ 0 ];
-      NmovedGradient[ 1 ]      = movedIteratory.Get() - this->m_MeanMovedGradient[ 1 ];
-      NfixedGradient[ 1 ]      = fixedIteratory.Get() - this->m_MeanFixedGradient[ 1 ];
-      NGcrosscorrelation      += NmovedGradient[ 0 ] * NfixedGradient[ 0 ] + NmovedGradient[ 1 ] * NfixedGradient[ 1 ];
-      NGautocorrelationmoving += NmovedGradient[ 0 ] * NmovedGradient[ 0 ] + NmovedGradient[ 1 ] * NmovedGradient[ 1 ];
-      NGautocorrelationfixed  += NfixedGradient[ 0 ] * NfixedGradient[ 0 ] + NfixedGradient[ 1 ] * NfixedGradient[ 1 ];
-
-    } // end if sampleOK
+      const MeasureType NmovedGradientx = movedIteratorx.Get() - this->m_MeanMovedGradient[ 0 ];
+      const MeasureType NfixedGradientx = fixedIteratorx.Get() - this->m_MeanFixedGradient[ 0 ];
+      const MeasureType NmovedGradienty = movedIteratory.Get() - this->m_MeanMovedGradient[ 1 ];
+      const MeasureType NfixedGradienty = fixedIteratory.Get() - this->m_MeanFixedGradient[ 1 ];
+      sums[ 0 ] += NmovedGradientx * NfixedGradientx + NmovedGradienty * NfixedGradienty;
+      sums[ 1 ] += NmovedGradientx * NmovedGradientx + NmovedGradienty * NmovedGradienty;
+      sums[ 2 ] += NfixedGradientx * NfixedGradientx + NfixedGradienty * NfixedGradienty;
+      sums[ 3 ] += 1.0;
+    }
+    else if( sampleOK )
+    {
+      sums[ 0 ] += movedIteratorx.Get();
+      sums[ 1 ] += movedIteratory.Get();
+      sums[ 2 ] += 1.0;
+    }
 
     ++fixedIteratorx;
     ++fixedIteratory;
     ++movedIteratorx;
     ++movedIteratory;
-
   } // end while
 
-  measure = -1.0 * ( NGcrosscorrelation
-    / ( vcl_sqrt( NGautocorrelationfixed ) * vcl_sqrt( NGautocorrelationmoving ) ) );
-  return measure;
+  /** Only update the shared sums at the end to prevent "false sharing". */
+  for( unsigned int k = 0; k < NumberOfThreaderSums; ++k )
+  {
+    this->m_ThreaderSums[ threadId * NumberOfThreaderSums + k ] = sums[ k ];
+  }
 
-} // end ComputeMeasure()
+} // end ThreadedAccumulateGradients()
 
 
 /**
@@ -423,8 +410,10 @@ NormalizedGradientCorrelationImageToImageMetric< TFixedImage, TMovingImage >
    * - Now you can call GetValueAndDerivative multi-threaded.
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
-  //this->SetTransformParameters( parameters );
 
+  /** Project the moving image once, and update its gradients. The resample
+   * filter itself is multi-threaded over the fixed image.
+   */
   unsigned int iFilter;
   this->m_TransformMovingImageFilter->Modified();
   this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
@@ -64,6 +64,13 @@ namespace elastix
  *    useful if you use high order B-spline interpolator for the moving image.\n
  *    example: <tt>(MovingLimitRangeRatio 0.001 0.01 0.01)</tt> \n
  *    The default value is 0.01. Can be given for each resolution, or for all resolutions at once.
+ * \parameter UseFastAndLowMemoryVersion: Switch between a version that explicitly
+ *    computes the derivatives of the joint histogram to each transformation
+ *    parameter (false) and a multi-threaded version that avoids this large
+ *    matrix, as in the AdvancedMattesMutualInformation metric (true).
+ *    Can be given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(UseFastAndLowMemoryVersion "false")</tt> \n
+ *    The default is "true".
  *
  * \sa ParzenWindowNormalizedMutualInformationImageToImageMetric
  * \ingroup Metrics
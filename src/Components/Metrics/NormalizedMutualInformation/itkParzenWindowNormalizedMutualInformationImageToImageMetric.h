@@ -19,7 +19,7 @@
 #ifndef __itkParzenWindowNormalizedMutualInformationImageToImageMetric_H__
 #define __itkParzenWindowNormalizedMutualInformationImageToImageMetric_H__
 
-#include "itkParzenWindowHistogramImageToImageMetric.h"
+#include "itkParzenWindowMutualInformationImageToImageMetric.h"
 
 namespace itk
 {
@@ -37,7 +37,10 @@ namespace itk
  * derivative is derived following [3].
  *
  * Construction of the PDFs is implemented in the superclass
- * ParzenWindowHistogramImageToImageMetric.
+ * ParzenWindowHistogramImageToImageMetric. When UseExplicitPDFDerivatives
+ * is false, the multi-threaded low memory derivative of the
+ * ParzenWindowMutualInformationImageToImageMetric is used, with the
+ * histogram ratios of the normalized mutual information.
  *
  * This implementation of the NormalizedMutualInformation is based on the
  * AdvancedImageToImageMetric, which means that:
@@ -65,18 +68,18 @@ namespace itk
  *      IEEE Transactions in Image Processing, 9(12) December 2000.\n
  *
  * \ingroup Metrics
- * \sa ParzenWindowHistogramImageToImageMetric
+ * \sa ParzenWindowHistogramImageToImageMetric, ParzenWindowMutualInformationImageToImageMetric
  */
 
 template< class TFixedImage, class TMovingImage >
 class ParzenWindowNormalizedMutualInformationImageToImageMetric :
-  public ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+  public ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 {
 public:
 
   /** Standard class typedefs. */
   typedef ParzenWindowNormalizedMutualInformationImageToImageMetric Self;
-  typedef ParzenWindowHistogramImageToImageMetric<
+  typedef ParzenWindowMutualInformationImageToImageMetric<
     TFixedImage, TMovingImage >                                       Superclass;
   typedef SmartPointer< Self >       Pointer;
   typedef SmartPointer< const Self > ConstPointer;
@@ -87,7 +90,7 @@ public:
   /** Run-time type information (and related methods). */
   itkTypeMacro(
     ParzenWindowNormalizedMutualInformationImageToImageMetric,
-    ParzenWindowHistogramImageToImageMetric );
+    ParzenWindowMutualInformationImageToImageMetric );
 
   /** Typedefs from the superclass. */
   typedef typename
@@ -146,7 +149,10 @@ public:
   /**  Get the value: the negative normalized mutual information. */
   MeasureType GetValue( const ParametersType & parameters ) const;
 
-  /**  Get the value and derivatives for single valued optimizers. */
+  /**  Get the value and derivatives for single valued optimizers.
+   * A finite difference derivative is not implemented, so this always
+   * calls GetValueAndAnalyticDerivative().
+   */
   void GetValueAndDerivative( const ParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const;
 
@@ -187,6 +193,7 @@ protected:
   typedef typename Superclass::ParzenValueContainerType            ParzenValueContainerType;
   typedef typename Superclass::KernelFunctionType                  KernelFunctionType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::PRatioType                          PRatioType;
 
   /** Replace the marginal probabilities by log(probabilities)
    * Changes the input pdf since they are not needed anymore! */
@@ -200,6 +207,19 @@ protected:
    */
   virtual MeasureType ComputeNormalizedMutualInformation( MeasureType & jointEntropy ) const;
 
+  /** Get the value and analytic derivative, using the explicit joint
+   * histogram derivatives. Calls GetValueAndAnalyticDerivativeLowMemory()
+   * of the superclass when UseExplicitPDFDerivatives == false.
+   */
+  virtual void GetValueAndAnalyticDerivative( const ParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Compute the normalized mutual information and m_PRatioArray for the
+   * low memory derivative of the superclass:
+   * PRatio(i,k) = alpha ( NMI log(p(i,k)) - log(pf(k)) - log(pm(i)) ) / Ej
+   */
+  virtual void ComputeValueAndPRatioArray( double & nMI ) const;
+
 private:
 
   /** The private constructor. */
@@ -181,6 +181,31 @@ ParzenWindowNormalizedMutualInformationImageToImageMetric< TFixedImage, TMovingI
   MeasureType & value,
   DerivativeType & derivative ) const
 {
+  this->GetValueAndAnalyticDerivative( parameters, value, derivative );
+
+}   // end GetValueAndDerivative
+
+
+/**
+ * ******************** GetValueAndAnalyticDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage  >
+void
+ParzenWindowNormalizedMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndAnalyticDerivative(
+  const ParametersType & parameters,
+  MeasureType & value,
+  DerivativeType & derivative ) const
+{
+  /** Low memory variant, multi-threaded. */
+  if( !this->GetUseExplicitPDFDerivatives() )
+  {
+    this->GetValueAndAnalyticDerivativeLowMemory(
+      parameters, value, derivative );
+    return;
+  }
+
   /** Initialize some variables */
   value      = NumericTraits< MeasureType >::Zero;
   derivative = DerivativeType( this->GetNumberOfParameters() );
@@ -277,7 +302,71 @@ ParzenWindowNormalizedMutualInformationImageToImageMetric< TFixedImage, TMovingI
     jointPDFconstit.NextLine();
   }    // end while-loop over fixed index
 
-}   // end GetValueAndDerivative
+}   // end GetValueAndAnalyticDerivative
+
+
+/**
+ * ******************** ComputeValueAndPRatioArray *******************
+ */
+
+template< class TFixedImage, class TMovingImage  >
+void
+ParzenWindowNormalizedMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeValueAndPRatioArray( double & nMI ) const
+{
+  /** Replace the probabilities by log(probabilities) */
+  this->ComputeLogMarginalPDF( this->m_FixedImageMarginalPDF );
+  this->ComputeLogMarginalPDF( this->m_MovingImageMarginalPDF );
+
+  /** Compute the measure and joint entropy (which we both need to compute the derivative) */
+  MeasureType jointEntropy = 0.0;
+  nMI = this->ComputeNormalizedMutualInformation( jointEntropy );
+
+  /** Setup iterators */
+  typedef ImageLinearConstIteratorWithIndex< JointPDFType > JointPDFConstIteratorType;
+  typedef typename MarginalPDFType::const_iterator          MarginalPDFConstIteratorType;
+
+  JointPDFConstIteratorType jointPDFconstit(
+  this->m_JointPDF, this->m_JointPDF->GetLargestPossibleRegion() );
+  jointPDFconstit.SetDirection( 0 );
+  jointPDFconstit.GoToBegin();
+  MarginalPDFConstIteratorType       fixedPDFconstit  = this->m_FixedImageMarginalPDF.begin();
+  MarginalPDFConstIteratorType       movingPDFconstit = this->m_MovingImageMarginalPDF.begin();
+  const MarginalPDFConstIteratorType fixedPDFend      = this->m_FixedImageMarginalPDF.end();
+  const MarginalPDFConstIteratorType movingPDFend     = this->m_MovingImageMarginalPDF.end();
+
+  /** Initialize */
+  this->m_PRatioArray.Fill( itk::NumericTraits< PRatioType >::ZeroValue() );
+
+  /** Loop over histogram to compute the same ratios as in GetValueAndAnalyticDerivative() */
+  unsigned int fixedIndex = 0;
+  while( fixedPDFconstit != fixedPDFend )
+  {
+    const double logFixedImagePDFValue = *fixedPDFconstit;
+    movingPDFconstit = this->m_MovingImageMarginalPDF.begin();
+    unsigned int movingIndex = 0;
+    while( movingPDFconstit != movingPDFend )
+    {
+      const double logMovingImagePDFValue = *movingPDFconstit;
+      const double jointPDFValue          = jointPDFconstit.Get();
+      /** check for non-zero bin contribution */
+      if( jointPDFValue > 1e-16 )
+      {
+        const double pRatio = ( nMI * vcl_log( jointPDFValue )
+          - logFixedImagePDFValue - logMovingImagePDFValue ) / jointEntropy;
+        this->m_PRatioArray[ fixedIndex ][ movingIndex ]
+          = static_cast< PRatioType >( this->m_Alpha * pRatio );
+      }
+      ++movingPDFconstit;
+      ++jointPDFconstit;
+      ++movingIndex;
+    }    // end while-loop over moving index
+    ++fixedPDFconstit;
+    jointPDFconstit.NextLine();
+    ++fixedIndex;
+  }    // end while-loop over fixed index
+
+}   // end ComputeValueAndPRatioArray
 
 
 } // end namespace itk
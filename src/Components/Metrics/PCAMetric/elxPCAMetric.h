@@ -54,6 +54,12 @@ namespace elastix
  *    image, without using a fixed image. Possible values are "true" or "false".
  * \parameter NumEigenValues: number of eigenvalues used in the metric: sum(e) - e, where sum(e)
  *  is the sum of all eigenvalues and e is the sum of the first highest NumEigenValues eigenvalues.
+ * \parameter NumberOfSubspaceIterations: when larger than zero, the eigenvectors of the previous
+ *    iteration are updated with this number of subspace iterations, instead of computing a full
+ *    eigen-decomposition. When the update is not accurate, the full eigen-decomposition is used
+ *    anyway. This saves time for long time series. Only used in the multi-threaded code. \n
+ *    <tt>(NumberOfSubspaceIterations 2)</tt> \n
+ *    The default is 0 for all resolutions.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
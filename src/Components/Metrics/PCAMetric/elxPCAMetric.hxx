@@ -61,6 +61,12 @@ PCAMetric< TElastix >
     this->GetComponentLabel(), level, 0 );
   this->SetNumEigenValues( NumEigenValues );
 
+  /** Get and set the number of subspace iterations to update the eigenvectors. */
+  unsigned int numberOfSubspaceIterations = 0;
+  this->GetConfiguration()->ReadParameter( numberOfSubspaceIterations,
+    "NumberOfSubspaceIterations", this->GetComponentLabel(), level, 0 );
+  this->SetNumberOfSubspaceIterations( numberOfSubspaceIterations );
+
   /** Get and set if we want to subtract the mean from the derivative. */
   bool subtractMean = false;
   this->GetConfiguration()->ReadParameter( subtractMean,
@@ -55,6 +55,14 @@ public:
   itkSetMacro( TransformIsStackTransform, bool );
   itkSetMacro( NumEigenValues, unsigned int );
 
+  /** Set/Get the number of subspace iterations used to update the
+   * eigenvectors of the previous iteration. When the updated eigenvectors are
+   * not accurate enough, or when this number is zero, a full
+   * eigen-decomposition is computed instead. Default: 0.
+   */
+  itkSetMacro( NumberOfSubspaceIterations, unsigned int );
+  itkGetConstMacro( NumberOfSubspaceIterations, unsigned int );
+
   /** Typedefs from the superclass. */
   typedef typename
     Superclass::CoordinateRepresentationType              CoordinateRepresentationType;
@@ -174,10 +182,14 @@ protected:
 
   PCAMetricMultiThreaderParameterType m_PCAMetricThreaderParameters;
 
+  /** The threads do not store the intensities of the samples. Instead, they
+   * accumulate the mean and the scatter matrix, the sum of the outer products
+   * of the centered intensities, of their own samples. */
   struct PCAMetricGetSamplesPerThreadStruct
   {
     SizeValueType                      st_NumberOfPixelsCounted;
-    MatrixType                         st_DataBlock;
+    vnl_vector< RealType >             st_Mean;
+    MatrixType                         st_Scatter;
     std::vector< FixedImagePointType > st_ApprovedSamples;
     DerivativeType                     st_Derivative;
   };
@@ -215,6 +227,18 @@ protected:
   /** Initialize some multi-threading related parameters. */
   virtual void InitializeThreadingParameters( void ) const;
 
+  /** Compute the m_NumEigenValues largest eigenvalues and the corresponding
+   * eigenvectors of the symmetric matrix K. The eigenvectors of the previous
+   * call are refined with subspace iterations if possible.
+   */
+  void ComputeLargestEigenVectors( const MatrixType & K,
+    vnl_vector< RealType > & eigenValues, MatrixType & eigenVectors ) const;
+
+  /** Refine the eigenvectors of the previous call with subspace iterations.
+   * Returns false if they could not be refined to sufficient accuracy. */
+  bool UpdatePreviousEigenVectors( const MatrixType & K,
+    vnl_vector< RealType > & eigenValues, MatrixType & eigenVectors ) const;
+
 private:
 
   PCAMetric( const Self & );      // purposely not implemented
@@ -235,13 +259,16 @@ private:
   /** Integer to indicate how many eigenvalues you want to use in the metric */
   unsigned int m_NumEigenValues;
 
+  /** The number of subspace iterations, and the eigenvectors of the previous iteration. */
+  unsigned int       m_NumberOfSubspaceIterations;
+  mutable MatrixType m_PreviousEigenVectors;
+
   /** Matrices, needed for derivative calculation */
-  mutable std::vector< unsigned int > m_PixelStartIndex;
-  mutable MatrixType                  m_Atmm;
-  mutable DerivativeMatrixType        m_vSAtmm;
-  mutable DerivativeMatrixType        m_CSv;
-  mutable DerivativeMatrixType        m_Sv;
-  mutable DerivativeMatrixType        m_vdSdmu_part1;
+  mutable vnl_vector< RealType > m_Mean;
+  mutable DerivativeMatrixType   m_vS;
+  mutable DerivativeMatrixType   m_CSv;
+  mutable DerivativeMatrixType   m_Sv;
+  mutable DerivativeMatrixType   m_vdSdmu_part1;
 
 };
 
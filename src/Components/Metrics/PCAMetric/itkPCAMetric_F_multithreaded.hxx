@@ -44,7 +44,8 @@ PCAMetric< TFixedImage, TMovingImage >
 ::PCAMetric() :
   m_SubtractMean( false ),
   m_TransformIsStackTransform( false ),
-  m_NumEigenValues( 6 )
+  m_NumEigenValues( 6 ),
+  m_NumberOfSubspaceIterations( 0 )
 {
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( false );
@@ -106,6 +107,10 @@ PCAMetric< TFixedImage, TMovingImage >
 {
   Superclass::PrintSelf( os, indent );
 
+  os << indent << "NumEigenValues: " << this->m_NumEigenValues << std::endl;
+  os << indent << "NumberOfSubspaceIterations: "
+     << this->m_NumberOfSubspaceIterations << std::endl;
+
 } // end PrintSelf
 
 
@@ -141,11 +146,113 @@ PCAMetric< TFixedImage, TMovingImage >
     this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_Derivative.SetSize( this->GetNumberOfParameters() );
   }
 
-  this->m_PixelStartIndex.resize( this->m_NumberOfThreads );
-
 } // end InitializeThreadingParameters()
 
 
+/**
+ * *************** ComputeLargestEigenVectors ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+PCAMetric< TFixedImage, TMovingImage >
+::ComputeLargestEigenVectors( const MatrixType & K,
+  vnl_vector< RealType > & eigenValues, MatrixType & eigenVectors ) const
+{
+  /** Try to refine the eigenvectors of the previous iteration. */
+  if( !this->UpdatePreviousEigenVectors( K, eigenValues, eigenVectors ) )
+  {
+    /** Full eigen-decomposition of K, with ascending eigenvalues. */
+    vnl_symmetric_eigensystem< RealType > eig( K );
+
+    eigenValues.set_size( this->m_NumEigenValues );
+    eigenVectors.set_size( this->m_G, this->m_NumEigenValues );
+    for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
+    {
+      eigenValues[ i - 1 ] = eig.get_eigenvalue( this->m_G - i );
+      eigenVectors.set_column( i - 1, ( eig.get_eigenvector( this->m_G - i ) ).normalize() );
+    }
+  }
+
+  /** Remember the eigenvectors for the next iteration. */
+  if( this->m_NumberOfSubspaceIterations > 0 )
+  {
+    this->m_PreviousEigenVectors = eigenVectors;
+  }
+
+} // end ComputeLargestEigenVectors()
+
+
+/**
+ * *************** UpdatePreviousEigenVectors ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+PCAMetric< TFixedImage, TMovingImage >
+::UpdatePreviousEigenVectors( const MatrixType & K,
+  vnl_vector< RealType > & eigenValues, MatrixType & eigenVectors ) const
+{
+  const unsigned int G = this->m_G;
+  const unsigned int k = this->m_NumEigenValues;
+  if( this->m_NumberOfSubspaceIterations == 0 || k == 0
+    || this->m_PreviousEigenVectors.rows() != G
+    || this->m_PreviousEigenVectors.cols() != k )
+  {
+    return false;
+  }
+
+  /** Subspace iterations: V = orth( K V ), with modified Gram-Schmidt. */
+  MatrixType V( this->m_PreviousEigenVectors );
+  for( unsigned int iter = 0; iter < this->m_NumberOfSubspaceIterations; ++iter )
+  {
+    V = K * V;
+    for( unsigned int j = 0; j < k; ++j )
+    {
+      vnl_vector< RealType > column = V.get_column( j );
+      for( unsigned int i = 0; i < j; ++i )
+      {
+        const vnl_vector< RealType > previousColumn = V.get_column( i );
+        column -= previousColumn * dot_product( previousColumn, column );
+      }
+      const RealType norm = column.two_norm();
+      if( !( norm > 1e-12 ) )
+      {
+        return false;
+      }
+      V.set_column( j, column / norm );
+    }
+  }
+
+  /** Rayleigh-Ritz: the eigen-decomposition of the small matrix V^T K V. */
+  const MatrixType                      KV( K * V );
+  vnl_symmetric_eigensystem< RealType > eig( V.transpose() * KV );
+
+  eigenValues.set_size( k );
+  MatrixType Y( k, k );
+  for( unsigned int i = 0; i < k; ++i )
+  {
+    eigenValues[ i ] = eig.get_eigenvalue( k - 1 - i );
+    Y.set_column( i, eig.get_eigenvector( k - 1 - i ) );
+  }
+  eigenVectors = V * Y;
+
+  /** Accept the result when the residuals || K v - lambda v || are small. */
+  const MatrixType residual( KV * Y - eigenVectors * vnl_diag_matrix< RealType >( eigenValues ) );
+  const RealType   tolerance = 1e-6 * vnl_math_max( vnl_math_abs( eigenValues[ 0 ] ), static_cast< RealType >( 1.0 ) );
+  for( unsigned int i = 0; i < k; ++i )
+  {
+    if( !( residual.get_column( i ).two_norm() < tolerance ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+
+} // end UpdatePreviousEigenVectors()
+
+
 /**
  * *************** EvaluateTransformJacobianInnerProduct ****************
  */
@@ -758,8 +865,12 @@ PCAMetric< TFixedImage, TMovingImage >
   threader_fbegin                                                 += (int)pos_begin;
   threader_fend                                                   += (int)pos_end;
 
+  /** The running mean and scatter matrix of the intensities of this thread. */
   std::vector< FixedImagePointType > SamplesOK;
-  MatrixType                         datablock( nrOfSamplesPerThreads, this->m_G );
+  vnl_vector< RealType >             values( this->m_G );
+  vnl_vector< RealType >             delta( this->m_G );
+  vnl_vector< RealType >             mean( this->m_G, NumericTraits< RealType >::Zero );
+  MatrixType                         scatter( this->m_G, this->m_G, NumericTraits< RealType >::Zero );
 
   unsigned int pixelIndex = 0;
   for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
@@ -804,7 +915,7 @@ PCAMetric< TFixedImage, TMovingImage >
       if( sampleOk )
       {
         numSamplesOk++;
-        datablock( pixelIndex, d ) = movingImageValue;
+        values[ d ] = movingImageValue;
       } // end if sampleOk
 
     } // end loop over t
@@ -812,13 +923,34 @@ PCAMetric< TFixedImage, TMovingImage >
     {
       SamplesOK.push_back( fixedPoint );
       pixelIndex++;
+
+      /** Welford update of the mean and the upper triangle of the scatter matrix. */
+      delta = values - mean;
+      mean += delta / static_cast< RealType >( pixelIndex );
+      for( unsigned int i = 0; i < this->m_G; ++i )
+      {
+        for( unsigned int j = i; j < this->m_G; ++j )
+        {
+          scatter( i, j ) += delta[ i ] * ( values[ j ] - mean[ j ] );
+        }
+      }
     }
 
   } /** end first loop over image sample container */
 
+  /** Copy the upper triangle of the scatter matrix to the lower triangle. */
+  for( unsigned int i = 1; i < this->m_G; ++i )
+  {
+    for( unsigned int j = 0; j < i; ++j )
+    {
+      scatter( i, j ) = scatter( j, i );
+    }
+  }
+
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_NumberOfPixelsCounted = pixelIndex;
-  this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_DataBlock             = datablock.extract( pixelIndex, this->m_G );
+  this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_Mean                  = mean;
+  this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_Scatter               = scatter;
   this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples       = SamplesOK;
 
 } // end ThreadedGetSamples()
@@ -845,42 +977,33 @@ PCAMetric< TFixedImage, TMovingImage >
   this->CheckNumberOfSamples(
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
 
-  MatrixType   A( this->m_NumberOfPixelsCounted, this->m_G );
-  unsigned int row_start = 0;
+  /** Merge the means and scatter matrices of the threads. The scatter of
+   * each thread is taken around its own mean, which is corrected for here. */
+  const RealType numberOfPixels = static_cast< RealType >( this->m_NumberOfPixelsCounted );
+  this->m_Mean.set_size( this->m_G );
+  this->m_Mean.fill( NumericTraits< RealType >::Zero );
   for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
   {
-    A.update( this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_DataBlock, row_start, 0 );
-    this->m_PixelStartIndex[ i ] = row_start;
-    row_start                   += this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_DataBlock.rows();
-  }
-
-  /** Calculate mean of from columns */
-  vnl_vector< RealType > mean( this->m_G );
-  mean.fill( NumericTraits< RealType >::Zero );
-  for( unsigned int i = 0; i < this->m_NumberOfPixelsCounted; i++ )
-  {
-    for( unsigned int j = 0; j < this->m_G; j++ )
-    {
-      mean( j ) += A( i, j );
-    }
+    const RealType n = static_cast< RealType >(
+      this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted );
+    this->m_Mean += this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_Mean * ( n / numberOfPixels );
   }
-  mean /= RealType( this->m_NumberOfPixelsCounted );
 
-  /** Calculate standard deviation from columns */
-  MatrixType Amm( this->m_NumberOfPixelsCounted, this->m_G );
-  Amm.fill( NumericTraits< RealType >::Zero );
-  for( unsigned int i = 0; i < this->m_NumberOfPixelsCounted; i++ )
+  /** Compute covariance matrix C */
+  MatrixType C( this->m_G, this->m_G, NumericTraits< RealType >::Zero );
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
   {
-    for( unsigned int j = 0; j < this->m_G; j++ )
+    const SizeValueType n = this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted;
+    if( n == 0 )
     {
-      Amm( i, j ) = A( i, j ) - mean( j );
+      continue;
     }
+    const vnl_vector< RealType > meanDiff
+      = this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_Mean - this->m_Mean;
+    C += this->m_PCAMetricGetSamplesPerThreadVariables[ i ].st_Scatter;
+    C += outer_product( meanDiff, meanDiff ) * static_cast< RealType >( n );
   }
-
-  /** Compute covariancematrix C */
-  this->m_Atmm = Amm.transpose();
-  MatrixType C( this->m_Atmm * Amm );
-  C /= static_cast< RealType >( RealType( this->m_NumberOfPixelsCounted ) - 1.0 );
+  C /= static_cast< RealType >( numberOfPixels - 1.0 );
 
   vnl_diag_matrix< RealType > S( this->m_G );
   S.fill( NumericTraits< RealType >::Zero );
@@ -891,15 +1014,15 @@ PCAMetric< TFixedImage, TMovingImage >
 
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute the largest eigenvalues and eigenvectors of K */
+  vnl_vector< RealType > eigenValues;
+  MatrixType             eigenVectorMatrix;
+  this->ComputeLargestEigenVectors( K, eigenValues, eigenVectorMatrix );
 
-  RealType   sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
-  MatrixType eigenVectorMatrix( this->m_G, this->m_NumEigenValues );
-  for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
+  RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
+  for( unsigned int i = 0; i < this->m_NumEigenValues; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( this->m_G - i );
-    eigenVectorMatrix.set_column( i - 1, ( eig.get_eigenvector( this->m_G - i ) ).normalize() );
+    sumEigenValuesUsed += eigenValues[ i ];
   }
 
   value = this->m_G - sumEigenValuesUsed;
@@ -916,7 +1039,7 @@ PCAMetric< TFixedImage, TMovingImage >
     dSdmu_part1( d, d ) = -S_qub;
   }
 
-  this->m_vSAtmm       = eigenVectorMatrixTranspose * S * this->m_Atmm;
+  this->m_vS           = eigenVectorMatrixTranspose * S;
   this->m_CSv          = C * S * eigenVectorMatrix;
   this->m_Sv           = S * eigenVectorMatrix;
   this->m_vdSdmu_part1 = eigenVectorMatrixTranspose * dSdmu_part1;
@@ -983,22 +1106,29 @@ PCAMetric< TFixedImage, TMovingImage >
   derivative.Fill( 0.0 );
 
   /** Initialize some variables. */
-  RealType                  movingImageValue;
-  MovingImagePointType      mappedPoint;
-  MovingImageDerivativeType movingImageDerivative;
+  RealType             movingImageValue;
+  MovingImagePointType mappedPoint;
 
   TransformJacobianType      jacobian;
   DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
   NonZeroJacobianIndicesType nzjis( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
 
-  unsigned int dummyindex = 0;
+  /** The centered intensities, moving image derivatives and points of one
+   * sample, for all t. The intensities are recomputed here, instead of
+   * being stored for all samples in ThreadedGetSamples(). */
+  vnl_vector< RealType >                   centered( this->m_G );
+  vnl_vector< RealType >                   projection( this->m_NumEigenValues );
+  std::vector< MovingImageDerivativeType > movingImageDerivatives( this->m_G );
+  std::vector< FixedImagePointType >       fixedPoints( this->m_G );
+
+  const std::vector< FixedImagePointType > & approvedSamples
+    = this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples;
+
   /** Second loop over fixed image samples. */
-  for( unsigned int pixelIndex = this->m_PixelStartIndex[ threadId ];
-    pixelIndex < ( this->m_PixelStartIndex[ threadId ] + this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples.size() );
-    ++pixelIndex )
+  for( unsigned int pixelIndex = 0; pixelIndex < approvedSamples.size(); ++pixelIndex )
   {
     /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples[ dummyindex ];
+    FixedImagePointType fixedPoint = approvedSamples[ pixelIndex ];
 
     /** Transform sampled point to voxel coordinates. */
     FixedImageContinuousIndexType voxelCoord;
@@ -1010,33 +1140,41 @@ PCAMetric< TFixedImage, TMovingImage >
       voxelCoord[ this->m_LastDimIndex ] = d;
 
       /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-      this->TransformPoint( fixedPoint, mappedPoint );
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+      this->TransformPoint( fixedPoints[ d ], mappedPoint );
 
       this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
+        mappedPoint, movingImageValue, &movingImageDerivatives[ d ] );
+      centered[ d ] = movingImageValue - this->m_Mean[ d ];
+    }
 
+    /** Project the centered intensities on the scaled eigenvectors. */
+    projection = this->m_vS * centered;
+
+    for( unsigned int d = 0; d < this->m_G; ++d )
+    {
       /** Get the TransformJacobian dT/dmu */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzjis );
+      this->EvaluateTransformJacobian( fixedPoints[ d ], jacobian, nzjis );
 
       /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
+        jacobian, movingImageDerivatives[ d ], imageJacobian );
+
+      /** The factor of dM/dmu does not depend on the parameter. */
+      DerivativeValueType factor = 0.0;
+      for( unsigned int z = 0; z < this->m_NumEigenValues; z++ )
+      {
+        factor += projection[ z ] * this->m_Sv[ d ][ z ]
+          + this->m_vdSdmu_part1[ z ][ d ] * centered[ d ] * this->m_CSv[ d ][ z ];
+      } //end loop over eigenvalues
 
       /** build metric derivative components */
       for( unsigned int p = 0; p < nzjis.size(); ++p )
       {
-        DerivativeValueType tmp = 0.0;
-        for( unsigned int z = 0; z < this->m_NumEigenValues; z++ )
-        {
-          tmp += this->m_vSAtmm[ z ][ pixelIndex ] * imageJacobian[ p ] * this->m_Sv[ d ][ z ]
-            + this->m_vdSdmu_part1[ z ][ d ] * this->m_Atmm[ d ][ pixelIndex ] * imageJacobian[ p ] * this->m_CSv[ d ][ z ];
-        } //end loop over eigenvalues
-        derivative[ nzjis[ p ] ] += tmp;
+        derivative[ nzjis[ p ] ] += factor * imageJacobian[ p ];
       } //end loop over non-zero jacobian indices
 
     } //end loop over last dimension
-    dummyindex++;
 
   } // end second for loop over sample container
 
@@ -29,6 +29,7 @@
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkAdvancedCombinationTransform.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include <vector>
 
 namespace itk
 {
@@ -94,6 +95,8 @@ public:
   typedef typename Superclass::ParametersType             ParametersType;
   typedef typename Superclass::FixedImagePixelType        FixedImagePixelType;
   typedef typename Superclass::MovingImageRegionType      MovingImageRegionType;
+  typedef typename Superclass::FixedImageRegionType       FixedImageRegionType;
+  typedef typename Superclass::ThreadInfoType             ThreadInfoType;
   typedef typename Superclass::ImageSamplerType           ImageSamplerType;
   typedef typename Superclass::ImageSamplerPointer        ImageSamplerPointer;
   typedef typename Superclass::ImageSampleContainerType   ImageSampleContainerType;
@@ -183,9 +186,19 @@ protected:
   /** Compute the pattern intensity fixed image*/
   MeasureType ComputePIFixed( void ) const;
 
-  /** Compute the pattern intensity difference image. */
+  /** Compute the pattern intensity difference image, from the current
+   * projection of the moving image.
+   */
   MeasureType ComputePIDiff( const TransformParametersType & parameters, float scalingfactor ) const;
 
+  /** The loop of ComputePIDiff() runs multi-threaded; every thread adds up
+   * a slab of the difference image into its own entry of m_ThreaderMeasures.
+   */
+  void ThreadedComputePIDiff( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Static callback for the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputePIDiffThreaderCallback( void * arg );
+
 private:
 
   PatternIntensityImageToImageMetric( const Self & ); // purposely not implemented
@@ -205,6 +218,9 @@ private:
   MeasureType                        m_FixedMeasure;
   CombinationTransformPointer        m_CombinationTransform;
 
+  /** The measures of the threads, see ThreadedComputePIDiff(). */
+  mutable std::vector< MeasureType > m_ThreaderMeasures;
+
 };
 
 } // end namespace itk
@@ -232,27 +232,61 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
 template< class TFixedImage, class TMovingImage >
 typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
 PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
-::ComputePIDiff( const TransformParametersType & parameters, float scalingfactor ) const
+::ComputePIDiff( const TransformParametersType & itkNotUsed( parameters ), float scalingfactor ) const
 {
-  /** Call non-thread-safe stuff, such as:
-   *   this->SetTransformParameters( parameters );
-   *   this->GetImageSampler()->Update();
-   * Because of these calls GetValueAndDerivative itself is not thread-safe,
-   * so cannot be called multiple times simultaneously.
-   * This is however needed in the CombinationImageToImageMetric.
-   * In that case, you need to:
-   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
-   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
-   *   calling GetValueAndDerivative
-   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
-   * - Now you can call GetValueAndDerivative multi-threaded.
+  /** The moving image is already projected, see GetValue(); only the
+   * difference image depends on the scaling factor.
    */
-  this->BeforeThreadedGetValueAndDerivative( parameters );
-  //this->SetTransformParameters( parameters );
-
-  this->m_TransformMovingImageFilter->Modified();
   this->m_MultiplyImageFilter->SetConstant( scalingfactor );
   this->m_DifferenceImageFilter->UpdateLargestPossibleRegion();
+
+  /** Let the threads add up the pattern intensity of their slabs. */
+  const ThreadIdType numberOfThreads = this->m_NumberOfThreads;
+  this->m_ThreaderMeasures.assign( numberOfThreads, NumericTraits< MeasureType >::Zero );
+
+  this->ExecuteThreaderCallback( this->ComputePIDiffThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( this ) ) );
+
+  /** Add the measures of the threads in a fixed order. */
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    measure += this->m_ThreaderMeasures[ i ];
+  }
+
+  return measure;
+
+} // end ComputePIDiff()
+
+
+/**
+ * ********************* ComputePIDiffThreaderCallback ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePIDiffThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const Self *     self       = static_cast< const Self * >( infoStruct->UserData );
+
+  self->ThreadedComputePIDiff( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputePIDiffThreaderCallback()
+
+
+/**
+ * ********************* ThreadedComputePIDiff ******************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputePIDiff( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
   MeasureType measure = NumericTraits< MeasureType >::Zero;
   MeasureType diff    = NumericTraits< MeasureType >::Zero;
 
@@ -270,14 +304,20 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
     neighborIterationSize[ i ] = static_cast< int >( 2 * this->m_NeighborhoodRadius + 1 );
   }
 
-  typename FixedImageType::RegionType iterationRegion, neighboriterationRegion;
+  typename FixedImageType::RegionType iterationRegion, threadRegion, neighboriterationRegion;
   iterationRegion.SetIndex( iterationStartIndex );
   iterationRegion.SetSize( iterationSize );
 
+  /** Get the slab of the iteration region of this thread. */
+  if( !this->SplitFixedImageRegionForThread( iterationRegion, threadId, numberOfThreads, threadRegion ) )
+  {
+    return;
+  }
+
   typedef itk::ImageRegionConstIteratorWithIndex< TransformedMovingImageType >
     DifferenceImageIteratorType;
   DifferenceImageIteratorType differenceImageIt(
-  this->m_DifferenceImageFilter->GetOutput(), iterationRegion );
+  this->m_DifferenceImageFilter->GetOutput(), threadRegion );
   differenceImageIt.GoToBegin();
 
   neighboriterationRegion.SetSize( neighborIterationSize );
@@ -333,9 +373,9 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
     ++differenceImageIt;
   } // end while differenceImageIt
 
-  return measure;
+  this->m_ThreaderMeasures[ threadId ] = measure;
 
-} // end ComputePIDiff()
+} // end ThreadedComputePIDiff()
 
 
 /**
@@ -363,8 +403,11 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
   this->BeforeThreadedGetValueAndDerivative( parameters );
   //this->SetTransformParameters( parameters );
 
+  /** Project the moving image once, also when the normalization factor is
+   * optimized below. The resample filter itself is multi-threaded.
+   */
   this->m_TransformMovingImageFilter->Modified();
-  this->m_DifferenceImageFilter->UpdateLargestPossibleRegion();
+  this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
   MeasureType measure        = 1e10;
   MeasureType currentMeasure = 1e10;
 
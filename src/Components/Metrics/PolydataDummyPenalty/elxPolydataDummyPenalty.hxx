@@ -29,7 +29,8 @@ namespace elastix
 
 template< class TElastix >
 PolydataDummyPenalty< TElastix >
-::PolydataDummyPenalty()
+::PolydataDummyPenalty() :
+  m_WriteResultMeshAfterEachIteration( "WriteResultMeshAfterEachIteration", false )
 {
   this->m_NumberOfMeshes = 0;
 }
@@ -175,9 +176,8 @@ PolydataDummyPenalty< TElastix >
   const unsigned int iter = this->m_Elastix->GetIterationCounter();
 
   /** Decide whether or not to write the result mesh this iteration. */
-  bool writeResultMeshThisIteration = false;
-  this->m_Configuration->ReadParameter( writeResultMeshThisIteration,
-    "WriteResultMeshAfterEachIteration", "", level, 0, false );
+  const bool writeResultMeshThisIteration
+    = this->m_WriteResultMeshAfterEachIteration.Get( this->m_Configuration, level );
 
   /** Writing result mesh. */
   if( writeResultMeshThisIteration )
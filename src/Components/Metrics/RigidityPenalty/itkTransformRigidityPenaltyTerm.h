@@ -326,6 +326,67 @@ private:
   CoefficientImagePointer FilterSeparable( const CoefficientImageType *,
     const std::vector< NeighborhoodType > & Operators ) const;
 
+  /** Typedefs for multi-threading. */
+  typedef typename Superclass::ThreadInfoType ThreadInfoType;
+
+  /** The intermediate images and operators, shared by the threads. */
+  struct RigidityPenaltyTermWorkspaceType
+  {
+    std::vector< CoefficientImagePointer > st_ui_FA, st_ui_FB, st_ui_FC,
+      st_ui_FD, st_ui_FE, st_ui_FF, st_ui_FG, st_ui_FH, st_ui_FI;
+    std::vector< std::vector< CoefficientImagePointer > > st_OCparts;
+    std::vector< std::vector< CoefficientImagePointer > > st_PCparts;
+    std::vector< std::vector< CoefficientImagePointer > > st_LCparts;
+    NeighborhoodType st_Operator_A, st_Operator_B, st_Operator_C,
+      st_Operator_D, st_Operator_E, st_Operator_F,
+      st_Operator_G, st_Operator_H, st_Operator_I;
+    ScalarType            st_RigidityCoefficientSum;
+    DerivativeValueType * st_DerivativePointer;
+
+    RigidityPenaltyTermWorkspaceType() :
+      st_RigidityCoefficientSum( 0.0 ), st_DerivativePointer( NULL ) {}
+  };
+
+  mutable RigidityPenaltyTermWorkspaceType m_Workspace;
+
+  /** The values and gradient magnitudes of the threads. */
+  struct RigidityPenaltyTermPerThreadStruct
+  {
+    MeasureType st_LinearityConditionValue;
+    MeasureType st_OrthonormalityConditionValue;
+    MeasureType st_PropernessConditionValue;
+    MeasureType st_LinearityConditionGradientMagnitude;
+    MeasureType st_OrthonormalityConditionGradientMagnitude;
+    MeasureType st_PropernessConditionGradientMagnitude;
+  };
+
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, RigidityPenaltyTermPerThreadStruct,
+    PaddedRigidityPenaltyTermPerThreadStruct );
+
+  mutable std::vector< PaddedRigidityPenaltyTermPerThreadStruct > m_RigidityPenaltyTermPerThreadVariables;
+
+  struct RigidityPenaltyTermMultiThreaderParameterType
+  {
+    Self * m_Metric;
+  };
+
+  RigidityPenaltyTermMultiThreaderParameterType m_RigidityPenaltyTermThreaderParameters;
+
+  /** Get the slab of the B-spline grid of a thread. Returns false if empty. */
+  bool GetThreadRegion( ThreadIdType threadId, ThreadIdType numberOfThreads,
+    RigidityImageRegionType & region ) const;
+
+  /** Compute the subparts and the values of the conditions for the slab of a thread. */
+  void ThreadedComputeSubparts( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Filter the subparts and compute the derivative for the slab of a thread. */
+  void ThreadedComputeDerivative( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Multi-threaded callbacks. */
+  static ITK_THREAD_RETURN_TYPE ComputeSubpartsThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeDerivativeThreaderCallback( void * arg );
+
   /** Member variables. */
   BSplineTransformPointer m_BSplineTransform;
   ScalarType              m_LinearityConditionWeight;
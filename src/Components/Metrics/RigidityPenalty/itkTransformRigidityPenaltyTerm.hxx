@@ -87,6 +87,9 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
 
   this->m_BSplineTransform = NULL;
 
+  /** Initialize the threader parameters. */
+  this->m_RigidityPenaltyTermThreaderParameters.m_Metric = this;
+
 } // end Constructor
 
 
@@ -1090,43 +1093,10 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
   }
 
   /** TASK 3:
-   * Create subparts and iterators.
+   * Create subparts and share the images with the threads.
    *
    ************************************************************************* */
 
-  /** Create iterators over ui_F?. */
-  std::vector< CoefficientImageIteratorType > itA( ImageDimension ),
-  itB( ImageDimension ), itC( ImageDimension ),
-  itD( ImageDimension ), itE( ImageDimension ),
-  itF( ImageDimension ), itG( ImageDimension ),
-  itH( ImageDimension ), itI( ImageDimension );
-
-  /** Create iterators. */
-  for( unsigned int i = 0; i < ImageDimension; i++ )
-  {
-    /** Create iterators. */
-    itA[ i ] = CoefficientImageIteratorType( ui_FA[ i ], ui_FA[ i ]->GetLargestPossibleRegion() );
-    itB[ i ] = CoefficientImageIteratorType( ui_FB[ i ], ui_FB[ i ]->GetLargestPossibleRegion() );
-    itD[ i ] = CoefficientImageIteratorType( ui_FD[ i ], ui_FD[ i ]->GetLargestPossibleRegion() );
-    itE[ i ] = CoefficientImageIteratorType( ui_FE[ i ], ui_FE[ i ]->GetLargestPossibleRegion() );
-    itG[ i ] = CoefficientImageIteratorType( ui_FG[ i ], ui_FG[ i ]->GetLargestPossibleRegion() );
-    if( ImageDimension == 3 )
-    {
-      itC[ i ] = CoefficientImageIteratorType( ui_FC[ i ], ui_FC[ i ]->GetLargestPossibleRegion() );
-      itF[ i ] = CoefficientImageIteratorType( ui_FF[ i ], ui_FF[ i ]->GetLargestPossibleRegion() );
-      itH[ i ] = CoefficientImageIteratorType( ui_FH[ i ], ui_FH[ i ]->GetLargestPossibleRegion() );
-      itI[ i ] = CoefficientImageIteratorType( ui_FI[ i ], ui_FI[ i ]->GetLargestPossibleRegion() );
-    }
-    /** Reset iterators. */
-    itA[ i ].GoToBegin(); itB[ i ].GoToBegin();
-    itD[ i ].GoToBegin(); itE[ i ].GoToBegin(); itG[ i ].GoToBegin();
-    if( ImageDimension == 3 )
-    {
-      itC[ i ].GoToBegin(); itF[ i ].GoToBegin();
-      itH[ i ].GoToBegin(); itI[ i ].GoToBegin();
-    }
-  }
-
   /** Create orthonormality and properness parts. */
   std::vector< std::vector< CoefficientImagePointer > > OCparts( ImageDimension );
   std::vector< std::vector< CoefficientImagePointer > > PCparts( ImageDimension );
@@ -1159,6 +1129,220 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
     }
   }
 
+  /** The images are shared with the threads through the workspace. */
+  this->m_Workspace.st_ui_FA = ui_FA; this->m_Workspace.st_ui_FB = ui_FB;
+  this->m_Workspace.st_ui_FC = ui_FC; this->m_Workspace.st_ui_FD = ui_FD;
+  this->m_Workspace.st_ui_FE = ui_FE; this->m_Workspace.st_ui_FF = ui_FF;
+  this->m_Workspace.st_ui_FG = ui_FG; this->m_Workspace.st_ui_FH = ui_FH;
+  this->m_Workspace.st_ui_FI = ui_FI;
+  this->m_Workspace.st_OCparts = OCparts;
+  this->m_Workspace.st_PCparts = PCparts;
+  this->m_Workspace.st_LCparts = LCparts;
+
+  /** Reset the per-thread results. */
+  const ThreadIdType numberOfThreads = this->m_UseMultiThread ? this->m_NumberOfThreads : 1;
+  this->m_RigidityPenaltyTermPerThreadVariables.resize( numberOfThreads );
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_OrthonormalityConditionValue             = NumericTraits< MeasureType >::Zero;
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_PropernessConditionValue                 = NumericTraits< MeasureType >::Zero;
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_LinearityConditionValue                  = NumericTraits< MeasureType >::Zero;
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_OrthonormalityConditionGradientMagnitude = NumericTraits< MeasureType >::Zero;
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_PropernessConditionGradientMagnitude     = NumericTraits< MeasureType >::Zero;
+    this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_LinearityConditionGradientMagnitude      = NumericTraits< MeasureType >::Zero;
+  }
+
+  /** TASK 4:
+   * Do the calculation of the orthonormality, properness and linearity
+   * subparts. Every thread handles a slab of the B-spline grid.
+   *
+   ************************************************************************* */
+
+  if( this->m_UseMultiThread )
+  {
+    this->ExecuteThreaderCallback( this->ComputeSubpartsThreaderCallback,
+      const_cast< void * >( static_cast< const void * >(
+        &this->m_RigidityPenaltyTermThreaderParameters ) ) );
+  }
+  else
+  {
+    this->ThreadedComputeSubparts( 0, 1 );
+  }
+
+  /** Gather the values of the threads. */
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    this->m_OrthonormalityConditionValue += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_OrthonormalityConditionValue;
+    this->m_PropernessConditionValue     += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_PropernessConditionValue;
+    this->m_LinearityConditionValue      += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_LinearityConditionValue;
+  }
+
+  /** TASK 5:
+   * Do the actual calculation of the rigidity penalty term value.
+   *
+   ************************************************************************* */
+
+  /** Calculate the rigidity penalty term value. */
+  if( this->m_CalculateLinearityCondition )
+  {
+    this->m_LinearityConditionValue /= rigidityCoefficientSum;
+  }
+  if( this->m_CalculateOrthonormalityCondition )
+  {
+    this->m_OrthonormalityConditionValue /= rigidityCoefficientSum;
+  }
+  if( this->m_CalculatePropernessCondition )
+  {
+    this->m_PropernessConditionValue /= rigidityCoefficientSum;
+  }
+
+  if( this->m_UseLinearityCondition )
+  {
+    this->m_RigidityPenaltyTermValue
+      += this->m_LinearityConditionWeight * this->m_LinearityConditionValue;
+  }
+  if( this->m_UseOrthonormalityCondition )
+  {
+    this->m_RigidityPenaltyTermValue
+      += this->m_OrthonormalityConditionWeight * this->m_OrthonormalityConditionValue;
+  }
+  if( this->m_UsePropernessCondition )
+  {
+    this->m_RigidityPenaltyTermValue
+      += this->m_PropernessConditionWeight * this->m_PropernessConditionValue;
+  }
+  value = this->m_RigidityPenaltyTermValue;
+
+  /** TASK 6:
+   * Create the operators for the filtering of the subparts.
+   ************************************************************************* */
+
+  /** Create ND operators. */
+  NeighborhoodType & Operator_A = this->m_Workspace.st_Operator_A;
+  NeighborhoodType & Operator_B = this->m_Workspace.st_Operator_B;
+  NeighborhoodType & Operator_C = this->m_Workspace.st_Operator_C;
+  NeighborhoodType & Operator_D = this->m_Workspace.st_Operator_D;
+  NeighborhoodType & Operator_E = this->m_Workspace.st_Operator_E;
+  NeighborhoodType & Operator_F = this->m_Workspace.st_Operator_F;
+  NeighborhoodType & Operator_G = this->m_Workspace.st_Operator_G;
+  NeighborhoodType & Operator_H = this->m_Workspace.st_Operator_H;
+  NeighborhoodType & Operator_I = this->m_Workspace.st_Operator_I;
+  this->CreateNDOperator( Operator_A, "FA", spacing );
+  this->CreateNDOperator( Operator_B, "FB", spacing );
+  if( ImageDimension == 3 )
+  {
+    this->CreateNDOperator( Operator_C, "FC", spacing );
+  }
+
+  if( this->m_CalculateLinearityCondition )
+  {
+    this->CreateNDOperator( Operator_D, "FD", spacing );
+    this->CreateNDOperator( Operator_E, "FE", spacing );
+    this->CreateNDOperator( Operator_G, "FG", spacing );
+    if( ImageDimension == 3 )
+    {
+      this->CreateNDOperator( Operator_F, "FF", spacing );
+      this->CreateNDOperator( Operator_H, "FH", spacing );
+      this->CreateNDOperator( Operator_I, "FI", spacing );
+    }
+  }
+
+  /** TASK 7 and 8:
+   * Filter the subparts and add them to create the final derivative.
+   * Every thread handles a slab of the B-spline grid.
+   ************************************************************************* */
+
+  this->m_Workspace.st_DerivativePointer     = derivative.data_block();
+  this->m_Workspace.st_RigidityCoefficientSum = rigidityCoefficientSum;
+  if( this->m_UseMultiThread )
+  {
+    this->ExecuteThreaderCallback( this->ComputeDerivativeThreaderCallback,
+      const_cast< void * >( static_cast< const void * >(
+        &this->m_RigidityPenaltyTermThreaderParameters ) ) );
+  }
+  else
+  {
+    this->ThreadedComputeDerivative( 0, 1 );
+  }
+
+  /** Set the gradient magnitudes of the several terms. */
+  MeasureType gradMagLC = NumericTraits< MeasureType >::Zero;
+  MeasureType gradMagOC = NumericTraits< MeasureType >::Zero;
+  MeasureType gradMagPC = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    gradMagLC += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_LinearityConditionGradientMagnitude;
+    gradMagOC += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_OrthonormalityConditionGradientMagnitude;
+    gradMagPC += this->m_RigidityPenaltyTermPerThreadVariables[ t ].st_PropernessConditionGradientMagnitude;
+  }
+  this->m_LinearityConditionGradientMagnitude      = vcl_sqrt( gradMagLC );
+  this->m_OrthonormalityConditionGradientMagnitude = vcl_sqrt( gradMagOC );
+  this->m_PropernessConditionGradientMagnitude     = vcl_sqrt( gradMagPC );
+
+  /** Release the intermediate images. */
+  this->m_Workspace = RigidityPenaltyTermWorkspaceType();
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* ThreadedComputeSubparts *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedComputeSubparts( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Get the part of the B-spline grid of this thread. */
+  RigidityImageRegionType region;
+  if( !this->GetThreadRegion( threadId, numberOfThreads, region ) )
+  {
+    return;
+  }
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  const unsigned int NofLParts                    = 3 * ImageDimension - 3;
+  MeasureType        orthonormalityConditionValue = NumericTraits< MeasureType >::Zero;
+  MeasureType        propernessConditionValue     = NumericTraits< MeasureType >::Zero;
+  MeasureType        linearityConditionValue      = NumericTraits< MeasureType >::Zero;
+
+  /** Create iterator over the rigidity coeficient image. */
+  CoefficientImageIteratorType it_RCI( this->m_RigidityCoefficientImage, region );
+
+  /** Create iterators over ui_F?. */
+  std::vector< CoefficientImageIteratorType > itA( ImageDimension ),
+  itB( ImageDimension ), itC( ImageDimension ),
+  itD( ImageDimension ), itE( ImageDimension ),
+  itF( ImageDimension ), itG( ImageDimension ),
+  itH( ImageDimension ), itI( ImageDimension );
+
+  /** Create iterators. */
+  for( unsigned int i = 0; i < ImageDimension; i++ )
+  {
+    /** Create iterators. */
+    itA[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FA[ i ], region );
+    itB[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FB[ i ], region );
+    itD[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FD[ i ], region );
+    itE[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FE[ i ], region );
+    itG[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FG[ i ], region );
+    if( ImageDimension == 3 )
+    {
+      itC[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FC[ i ], region );
+      itF[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FF[ i ], region );
+      itH[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FH[ i ], region );
+      itI[ i ] = CoefficientImageIteratorType( this->m_Workspace.st_ui_FI[ i ], region );
+    }
+    /** Reset iterators. */
+    itA[ i ].GoToBegin(); itB[ i ].GoToBegin();
+    itD[ i ].GoToBegin(); itE[ i ].GoToBegin(); itG[ i ].GoToBegin();
+    if( ImageDimension == 3 )
+    {
+      itC[ i ].GoToBegin(); itF[ i ].GoToBegin();
+      itH[ i ].GoToBegin(); itI[ i ].GoToBegin();
+    }
+  }
+
   /** Create iterators over all parts. */
   std::vector< std::vector< CoefficientImageIteratorType > > itOCp( ImageDimension );
   std::vector< std::vector< CoefficientImageIteratorType > > itPCp( ImageDimension );
@@ -1170,17 +1354,17 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
     itLCp[ i ].resize( NofLParts );
     for( unsigned int j = 0; j < ImageDimension; j++ )
     {
-      itOCp[ i ][ j ] = CoefficientImageIteratorType( OCparts[ i ][ j ],
-        OCparts[ i ][ j ]->GetLargestPossibleRegion() );
+      itOCp[ i ][ j ] = CoefficientImageIteratorType(
+        this->m_Workspace.st_OCparts[ i ][ j ], region );
       itOCp[ i ][ j ].GoToBegin();
-      itPCp[ i ][ j ] = CoefficientImageIteratorType( PCparts[ i ][ j ],
-        PCparts[ i ][ j ]->GetLargestPossibleRegion() );
+      itPCp[ i ][ j ] = CoefficientImageIteratorType(
+        this->m_Workspace.st_PCparts[ i ][ j ], region );
       itPCp[ i ][ j ].GoToBegin();
     }
     for( unsigned int j = 0; j < NofLParts; j++ )
     {
-      itLCp[ i ][ j ] = CoefficientImageIteratorType( LCparts[ i ][ j ],
-        LCparts[ i ][ j ]->GetLargestPossibleRegion() );
+      itLCp[ i ][ j ] = CoefficientImageIteratorType(
+        this->m_Workspace.st_LCparts[ i ][ j ], region );
       itLCp[ i ][ j ].GoToBegin();
     }
   }
@@ -1212,7 +1396,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       if( ImageDimension == 2 )
       {
         /** Calculate the value of the orthonormality condition. */
-        this->m_OrthonormalityConditionValue
+        orthonormalityConditionValue
           += it_RCI.Get() * (
           vcl_pow(
           +( 1.0 + mu1_A ) * ( 1.0 + mu1_A )
@@ -1266,7 +1450,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       else if( ImageDimension == 3 )
       {
         /** Calculate the value of the orthonormality condition. */
-        this->m_OrthonormalityConditionValue
+        orthonormalityConditionValue
           += it_RCI.Get() * (
           vcl_pow(
           +( 1.0 + mu1_A ) * ( 1.0 + mu1_A )
@@ -1468,7 +1652,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       if( ImageDimension == 2 )
       {
         /** Calculate the value of the properness condition. */
-        this->m_PropernessConditionValue
+        propernessConditionValue
           += it_RCI.Get() * (
           vcl_pow(
           +( 1.0 + mu1_A ) * ( 1.0 + mu2_B )
@@ -1505,7 +1689,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       else if( ImageDimension == 3 )
       {
         /** Calculate the value of the properness condition. */
-        this->m_PropernessConditionValue
+        propernessConditionValue
           += it_RCI.Get() * (
           vcl_pow(
           -mu1_C * ( 1.0 + mu2_B ) * mu3_A
@@ -1695,7 +1879,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       for( unsigned int i = 0; i < ImageDimension; i++ )
       {
         /** Calculate the value of the linearity condition. */
-        this->m_LinearityConditionValue
+        linearityConditionValue
           += it_RCI.Get() * (
           +itD[ i ].Get() * itD[ i ].Get()
           + itE[ i ].Get() * itE[ i ].Get()
@@ -1703,7 +1887,7 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
           );
         if( ImageDimension == 3 )
         {
-          this->m_LinearityConditionValue
+          linearityConditionValue
             += it_RCI.Get() * (
             +itF[ i ].Get() * itF[ i ].Get()
             + itH[ i ].Get() * itH[ i ].Get()
@@ -1762,64 +1946,32 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
     } // end while
   }   // end if do linearity
 
-  /** TASK 5:
-   * Do the actual calculation of the rigidity penalty term value.
-   *
-   ************************************************************************* */
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_OrthonormalityConditionValue = orthonormalityConditionValue;
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_PropernessConditionValue     = propernessConditionValue;
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_LinearityConditionValue      = linearityConditionValue;
 
-  /** Calculate the rigidity penalty term value. */
-  if( this->m_CalculateLinearityCondition )
-  {
-    this->m_LinearityConditionValue /= rigidityCoefficientSum;
-  }
-  if( this->m_CalculateOrthonormalityCondition )
-  {
-    this->m_OrthonormalityConditionValue /= rigidityCoefficientSum;
-  }
-  if( this->m_CalculatePropernessCondition )
-  {
-    this->m_PropernessConditionValue /= rigidityCoefficientSum;
-  }
+} // end ThreadedComputeSubparts()
 
-  if( this->m_UseLinearityCondition )
-  {
-    this->m_RigidityPenaltyTermValue
-      += this->m_LinearityConditionWeight * this->m_LinearityConditionValue;
-  }
-  if( this->m_UseOrthonormalityCondition )
-  {
-    this->m_RigidityPenaltyTermValue
-      += this->m_OrthonormalityConditionWeight * this->m_OrthonormalityConditionValue;
-  }
-  if( this->m_UsePropernessCondition )
-  {
-    this->m_RigidityPenaltyTermValue
-      += this->m_PropernessConditionWeight * this->m_PropernessConditionValue;
-  }
-  value = this->m_RigidityPenaltyTermValue;
 
-  /** TASK 6:
-   * Create filtered versions of the subparts.
-   * Create all necessary iterators and operators.
-   ************************************************************************* */
+/**
+ * ******************* ThreadedComputeDerivative *******************
+ */
 
-  /** Create filtered orthonormality, properness and linearity parts. */
-  std::vector< CoefficientImagePointer > OCpartsF( ImageDimension );
-  std::vector< CoefficientImagePointer > PCpartsF( ImageDimension );
-  std::vector< CoefficientImagePointer > LCpartsF( ImageDimension );
-  for( unsigned int i = 0; i < ImageDimension; i++ )
+template< class TFixedImage, class TScalarType >
+void
+TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedComputeDerivative( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Get the part of the B-spline grid of this thread. */
+  RigidityImageRegionType region;
+  if( !this->GetThreadRegion( threadId, numberOfThreads, region ) )
   {
-    OCpartsF[ i ] = CoefficientImageType::New();
-    OCpartsF[ i ]->SetRegions( inputImages[ 0 ]->GetLargestPossibleRegion() );
-    OCpartsF[ i ]->Allocate();
-    PCpartsF[ i ] = CoefficientImageType::New();
-    PCpartsF[ i ]->SetRegions( inputImages[ 0 ]->GetLargestPossibleRegion() );
-    PCpartsF[ i ]->Allocate();
-    LCpartsF[ i ] = CoefficientImageType::New();
-    LCpartsF[ i ]->SetRegions( inputImages[ 0 ]->GetLargestPossibleRegion() );
-    LCpartsF[ i ]->Allocate();
+    return;
   }
 
+  const unsigned int NofLParts = 3 * ImageDimension - 3;
+
   /** Create neighborhood iterators over the subparts. */
   std::vector< std::vector< NeighborhoodIteratorType > > nitOCp( ImageDimension );
   std::vector< std::vector< NeighborhoodIteratorType > > nitPCp( ImageDimension );
@@ -1834,280 +1986,122 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
     for( unsigned int j = 0; j < ImageDimension; j++ )
     {
       nitOCp[ i ][ j ] = NeighborhoodIteratorType( radius,
-        OCparts[ i ][ j ], OCparts[ i ][ j ]->GetLargestPossibleRegion() );
+        this->m_Workspace.st_OCparts[ i ][ j ], region );
       nitOCp[ i ][ j ].GoToBegin();
       nitPCp[ i ][ j ] = NeighborhoodIteratorType( radius,
-        PCparts[ i ][ j ], PCparts[ i ][ j ]->GetLargestPossibleRegion() );
+        this->m_Workspace.st_PCparts[ i ][ j ], region );
       nitPCp[ i ][ j ].GoToBegin();
     }
     for( unsigned int j = 0; j < NofLParts; j++ )
     {
       nitLCp[ i ][ j ] = NeighborhoodIteratorType( radius,
-        LCparts[ i ][ j ], LCparts[ i ][ j ]->GetLargestPossibleRegion() );
+        this->m_Workspace.st_LCparts[ i ][ j ], region );
       nitLCp[ i ][ j ].GoToBegin();
     }
   }
 
-  /** Create iterators over the filtered parts. */
-  std::vector< CoefficientImageIteratorType > itOCpf( ImageDimension );
-  std::vector< CoefficientImageIteratorType > itPCpf( ImageDimension );
-  std::vector< CoefficientImageIteratorType > itLCpf( ImageDimension );
-  for( unsigned int i = 0; i < ImageDimension; i++ )
-  {
-    itOCpf[ i ] = CoefficientImageIteratorType( OCpartsF[ i ],
-      OCpartsF[ i ]->GetLargestPossibleRegion() );
-    itOCpf[ i ].GoToBegin();
-    itPCpf[ i ] = CoefficientImageIteratorType( PCpartsF[ i ],
-      PCpartsF[ i ]->GetLargestPossibleRegion() );
-    itPCpf[ i ].GoToBegin();
-    itLCpf[ i ] = CoefficientImageIteratorType( LCpartsF[ i ],
-      LCpartsF[ i ]->GetLargestPossibleRegion() );
-    itLCpf[ i ].GoToBegin();
-  }
-
   /** Create a neigborhood iterator over the rigidity image. */
-  NeighborhoodIteratorType nit_RCI( radius, this->m_RigidityCoefficientImage,
-  this->m_RigidityCoefficientImage->GetLargestPossibleRegion() );
+  NeighborhoodIteratorType nit_RCI( radius, this->m_RigidityCoefficientImage, region );
   nit_RCI.GoToBegin();
-  unsigned int neighborhoodSize = nit_RCI.Size();
-
-  /** Create ND operators. */
-  NeighborhoodType Operator_A, Operator_B, Operator_C,
-    Operator_D, Operator_E, Operator_F,
-    Operator_G, Operator_H, Operator_I;
-  this->CreateNDOperator( Operator_A, "FA", spacing );
-  this->CreateNDOperator( Operator_B, "FB", spacing );
-  if( ImageDimension == 3 )
-  {
-    this->CreateNDOperator( Operator_C, "FC", spacing );
-  }
-
-  if( this->m_CalculateLinearityCondition )
-  {
-    this->CreateNDOperator( Operator_D, "FD", spacing );
-    this->CreateNDOperator( Operator_E, "FE", spacing );
-    this->CreateNDOperator( Operator_G, "FG", spacing );
-    if( ImageDimension == 3 )
-    {
-      this->CreateNDOperator( Operator_F, "FF", spacing );
-      this->CreateNDOperator( Operator_H, "FH", spacing );
-      this->CreateNDOperator( Operator_I, "FI", spacing );
-    }
-  }
-
-  /** TASK 7A:
-   * Calculate the filtered versions of the orthonormality subparts.
-   * These are F_A * {subpart_0} + F_B * {subpart_1},
-   * and (for 3D) + F_C * {subpart_2}, for all dimensions.
-   ************************************************************************* */
+  const unsigned int neighborhoodSize = nit_RCI.Size();
+
+  /** Get the operators. */
+  const NeighborhoodType & Operator_A = this->m_Workspace.st_Operator_A;
+  const NeighborhoodType & Operator_B = this->m_Workspace.st_Operator_B;
+  const NeighborhoodType & Operator_C = this->m_Workspace.st_Operator_C;
+  const NeighborhoodType & Operator_D = this->m_Workspace.st_Operator_D;
+  const NeighborhoodType & Operator_E = this->m_Workspace.st_Operator_E;
+  const NeighborhoodType & Operator_F = this->m_Workspace.st_Operator_F;
+  const NeighborhoodType & Operator_G = this->m_Workspace.st_Operator_G;
+  const NeighborhoodType & Operator_H = this->m_Workspace.st_Operator_H;
+  const NeighborhoodType & Operator_I = this->m_Workspace.st_Operator_I;
+
+  /** The derivative is ordered as [ dimension ][ voxel ], with the voxels in
+   * buffer order. The slab of this thread is contiguous in that order.
+   */
+  const SizeValueType numberOfVoxels
+    = this->m_RigidityCoefficientImage->GetLargestPossibleRegion().GetNumberOfPixels();
+  SizeValueType         offset = this->m_RigidityCoefficientImage->ComputeOffset( region.GetIndex() );
+  DerivativeValueType * derivative = this->m_Workspace.st_DerivativePointer;
 
-  if( this->m_CalculateOrthonormalityCondition )
+  /** Create variables to store intermediate results. circumvent false sharing */
+  // NOTE: unlike the values, for the derivatives weight * derivative is returned.
+  const double rigidityCoefficientSum    = this->m_Workspace.st_RigidityCoefficientSum;
+  const double rigidityCoefficientSumSqr = rigidityCoefficientSum * rigidityCoefficientSum;
+  MeasureType  gradMagLC                 = NumericTraits< MeasureType >::Zero;
+  MeasureType  gradMagOC                 = NumericTraits< MeasureType >::Zero;
+  MeasureType  gradMagPC                 = NumericTraits< MeasureType >::Zero;
+
+  /** TASK 7 and 8 are fused: the filtered versions of the subparts
+   * are computed per voxel and directly added to the derivative,
+   * so that no filtered part images are needed.
+   */
+  while( !nit_RCI.IsAtEnd() )
   {
-    while( !itOCpf[ 0 ].IsAtEnd() )
+    /** Loop over all dimensions. */
+    for( unsigned int i = 0; i < ImageDimension; i++ )
     {
-      /** Create and reset tmp with zeros. */
-      std::vector< double > tmp( ImageDimension, 0.0 );
+      double tmpOCf = 0.0, tmpPCf = 0.0, tmpLCf = 0.0;
 
-      /** Loop over all dimensions. */
-      for( unsigned int i = 0; i < ImageDimension; i++ )
+      /** Loop over the neighborhood. */
+      for( unsigned int k = 0; k < neighborhoodSize; ++k )
       {
-        /** Loop over the neighborhood. */
-        for( unsigned int k = 0; k < neighborhoodSize; ++k )
+        const double c = nit_RCI.GetPixel( k );               // c(k)
+
+        /** The orthonormality part F_A * {subpart_0} + F_B * {subpart_1},
+         * and (for 3D) + F_C * {subpart_2}.
+         */
+        if( this->m_CalculateOrthonormalityCondition )
         {
-          /** Calculation of the inner product. */
-          tmp[ i ] += Operator_A.GetElement( k )      // FA *
-            * nitOCp[ i ][ 0 ].GetPixel( k )          // subpart[ i ][ 0 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
-          tmp[ i ] += Operator_B.GetElement( k )      // FB *
-            * nitOCp[ i ][ 1 ].GetPixel( k )          // subpart[ i ][ 1 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
+          double tmp = Operator_A.GetElement( k ) * nitOCp[ i ][ 0 ].GetPixel( k )
+            + Operator_B.GetElement( k ) * nitOCp[ i ][ 1 ].GetPixel( k );
           if( ImageDimension == 3 )
           {
-            tmp[ i ] += Operator_C.GetElement( k )    // FC *
-              * nitOCp[ i ][ 2 ].GetPixel( k )        // subpart[ i ][ 2 ]
-              * nit_RCI.GetPixel( k );                // c(k)
+            tmp += Operator_C.GetElement( k ) * nitOCp[ i ][ 2 ].GetPixel( k );
           }
-        } // end loop over neighborhood
-
-        /** Set the result in the filtered part. */
-        itOCpf[ i ].Set( tmp[ i ] );
-
-      } // end loop over dimension i
-
-      /** Increase all iterators. */
-      ++nit_RCI;
-      for( unsigned int i = 0; i < ImageDimension; i++ )
-      {
-        ++itOCpf[ i ];
-        for( unsigned int j = 0; j < ImageDimension; j++ )
-        {
-          ++nitOCp[ i ][ j ];
+          tmpOCf += tmp * c;
         }
-      }
-    } // end while
-  }   // end if do orthonormality
-
-  /** TASK 7B:
-   * Calculate the filtered versions of the properness subparts.
-   * These are F_A * {subpart_0} + F_B * {subpart_1},
-   * and (for 3D) + F_C * {subpart_2}, for all dimensions.
-   ************************************************************************* */
-
-  nit_RCI.GoToBegin();
-  if( this->m_CalculatePropernessCondition )
-  {
-    while( !itPCpf[ 0 ].IsAtEnd() )
-    {
-      /** Create and reset tmp with zeros. */
-      std::vector< double > tmp( ImageDimension, 0.0 );
 
-      /** Loop over all dimensions. */
-      for( unsigned int i = 0; i < ImageDimension; i++ )
-      {
-        /** Loop over the neighborhood. */
-        for( unsigned int k = 0; k < neighborhoodSize; ++k )
+        /** The properness part, with the same operators. */
+        if( this->m_CalculatePropernessCondition )
         {
-          /** Calculation of the inner product. */
-          tmp[ i ] += Operator_A.GetElement( k )      // FA *
-            * nitPCp[ i ][ 0 ].GetPixel( k )          // subpart[ i ][ 0 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
-          tmp[ i ] += Operator_B.GetElement( k )      // FB *
-            * nitPCp[ i ][ 1 ].GetPixel( k )          // subpart[ i ][ 1 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
+          double tmp = Operator_A.GetElement( k ) * nitPCp[ i ][ 0 ].GetPixel( k )
+            + Operator_B.GetElement( k ) * nitPCp[ i ][ 1 ].GetPixel( k );
           if( ImageDimension == 3 )
           {
-            tmp[ i ] += Operator_C.GetElement( k )    // FC *
-              * nitPCp[ i ][ 2 ].GetPixel( k )        // subpart[ i ][ 2 ]
-              * nit_RCI.GetPixel( k );                // c(k)
+            tmp += Operator_C.GetElement( k ) * nitPCp[ i ][ 2 ].GetPixel( k );
           }
-        } // end loop over neighborhood
-
-        /** Set the result in the filtered part. */
-        itPCpf[ i ].Set( tmp[ i ] );
-
-      } // end loop over dimension i
-
-      /** Increase all iterators. */
-      ++nit_RCI;
-      for( unsigned int i = 0; i < ImageDimension; i++ )
-      {
-        ++itPCpf[ i ];
-        for( unsigned int j = 0; j < ImageDimension; j++ )
-        {
-          ++nitPCp[ i ][ j ];
+          tmpPCf += tmp * c;
         }
-      }
-    } // end while
-  }   // end if do properness
-
-  /** TASK 7C:
-   * Calculate the filtered versions of the linearity subparts.
-   * These are sum_{i=1}^{NofLParts} F_{D,E,G,F,H,I} * {subpart_i}.
-   ************************************************************************* */
 
-  nit_RCI.GoToBegin();
-  if( this->m_CalculateLinearityCondition )
-  {
-    while( !itLCpf[ 0 ].IsAtEnd() )
-    {
-      /** Create and reset tmp with zeros. */
-      std::vector< double > tmp( ImageDimension, 0.0 );
-
-      /** Loop over all dimensions. */
-      for( unsigned int i = 0; i < ImageDimension; i++ )
-      {
-        /** Loop over the neighborhood. */
-        for( unsigned int k = 0; k < neighborhoodSize; ++k )
+        /** The linearity part sum_{i=1}^{NofLParts} F_{D,E,G,F,H,I} * {subpart_i}. */
+        if( this->m_CalculateLinearityCondition )
         {
-          /** Calculation of the inner product. */
-          tmp[ i ] += Operator_D.GetElement( k )      // FD *
-            * nitLCp[ i ][ 0 ].GetPixel( k )          // subpart[ i ][ 0 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
-          tmp[ i ] += Operator_E.GetElement( k )      // FE *
-            * nitLCp[ i ][ 1 ].GetPixel( k )          // subpart[ i ][ 1 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
-          tmp[ i ] += Operator_G.GetElement( k )      // FG *
-            * nitLCp[ i ][ 2 ].GetPixel( k )          // subpart[ i ][ 1 ]
-            * nit_RCI.GetPixel( k );                  // c(k)
+          double tmp = Operator_D.GetElement( k ) * nitLCp[ i ][ 0 ].GetPixel( k )
+            + Operator_E.GetElement( k ) * nitLCp[ i ][ 1 ].GetPixel( k )
+            + Operator_G.GetElement( k ) * nitLCp[ i ][ 2 ].GetPixel( k );
           if( ImageDimension == 3 )
           {
-            tmp[ i ] += Operator_F.GetElement( k )    // FF *
-              * nitLCp[ i ][ 3 ].GetPixel( k )        // subpart[ i ][ 1 ]
-              * nit_RCI.GetPixel( k );                // c(k)
-            tmp[ i ] += Operator_H.GetElement( k )    // FH *
-              * nitLCp[ i ][ 4 ].GetPixel( k )        // subpart[ i ][ 1 ]
-              * nit_RCI.GetPixel( k );                // c(k)
-            tmp[ i ] += Operator_I.GetElement( k )    // FI *
-              * nitLCp[ i ][ 5 ].GetPixel( k )        // subpart[ i ][ 1 ]
-              * nit_RCI.GetPixel( k );                // c(k)
+            tmp += Operator_F.GetElement( k ) * nitLCp[ i ][ 3 ].GetPixel( k )
+              + Operator_H.GetElement( k ) * nitLCp[ i ][ 4 ].GetPixel( k )
+              + Operator_I.GetElement( k ) * nitLCp[ i ][ 5 ].GetPixel( k );
           }
-        } // end loop over neighborhood
-
-        /** Set the result in the filtered part. */
-        itLCpf[ i ].Set( tmp[ i ] );
-
-      } // end loop over dimension i
-
-      /** Increase all iterators. */
-      ++nit_RCI;
-      for( unsigned int i = 0; i < ImageDimension; i++ )
-      {
-        ++itLCpf[ i ];
-        for( unsigned int j = 0; j < NofLParts; j++ )
-        {
-          ++nitLCp[ i ][ j ];
+          tmpLCf += tmp * c;
         }
-      }
-    } // end while
-  }   // end if do linearity
-
-  /** TASK 8:
-   * Add it all to create the final derivative images.
-   ************************************************************************* */
-
-  /** Create derivative images, each holding a component of the vector field. */
-  std::vector< CoefficientImagePointer > derivativeImages( ImageDimension );
-  for( unsigned int i = 0; i < ImageDimension; i++ )
-  {
-    derivativeImages[ i ] = CoefficientImageType::New();
-    derivativeImages[ i ]->SetRegions( inputImages[ i ]->GetLargestPossibleRegion() );
-    derivativeImages[ i ]->Allocate();
-  }
+      } // end loop over neighborhood
 
-  /** Create iterators over the derivative images. */
-  std::vector< CoefficientImageIteratorType > itDIs( ImageDimension );
-  for( unsigned int i = 0; i < ImageDimension; i++ )
-  {
-    itDIs[ i ] = CoefficientImageIteratorType( derivativeImages[ i ],
-      derivativeImages[ i ]->GetLargestPossibleRegion() );
-    itDIs[ i ].GoToBegin();
-    itOCpf[ i ].GoToBegin();
-    itPCpf[ i ].GoToBegin();
-    itLCpf[ i ].GoToBegin();
-  }
-
-  /** Do the addition. */
-  // NOTE: unlike the values, for the derivatives weight * derivative is returned.
-  MeasureType gradMagLC                 = NumericTraits< MeasureType >::Zero;
-  MeasureType gradMagOC                 = NumericTraits< MeasureType >::Zero;
-  MeasureType gradMagPC                 = NumericTraits< MeasureType >::Zero;
-  double      rigidityCoefficientSumSqr = rigidityCoefficientSum * rigidityCoefficientSum;
-  while( !itDIs[ 0 ].IsAtEnd() )
-  {
-    for( unsigned int i = 0; i < ImageDimension; i++ )
-    {
       ScalarType tmpDIs = NumericTraits< ScalarType >::Zero;
 
       /** Compute gradient magnitude of LC. */
-      ScalarType tmpLC = this->m_LinearityConditionWeight * itLCpf[ i ].Get();
+      ScalarType tmpLC = this->m_LinearityConditionWeight * tmpLCf;
       gradMagLC += tmpLC * tmpLC / rigidityCoefficientSumSqr;
 
       /** Compute gradient magnitude of OC. */
-      ScalarType tmpOC = this->m_OrthonormalityConditionWeight * itOCpf[ i ].Get();
+      ScalarType tmpOC = this->m_OrthonormalityConditionWeight * tmpOCf;
       gradMagOC += tmpOC * tmpOC / rigidityCoefficientSumSqr;
 
       /** Compute gradient magnitude of PC. */
-      ScalarType tmpPC = this->m_PropernessConditionWeight * itPCpf[ i ].Get();
+      ScalarType tmpPC = this->m_PropernessConditionWeight * tmpPCf;
       gradMagPC += tmpPC * tmpPC / rigidityCoefficientSumSqr;
 
       /** Compute derivative contribution. */
@@ -2123,32 +2117,109 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
       {
         tmpDIs += tmpPC;
       }
-      itDIs[ i ].Set( tmpDIs );
+      derivative[ i * numberOfVoxels + offset ] = tmpDIs / rigidityCoefficientSum;
+
+    } // end loop over dimension i
 
-      /** Update iterators. */
-      ++itDIs[ i ]; ++itOCpf[ i ]; ++itPCpf[ i ]; ++itLCpf[ i ];
+    /** Increase all iterators. */
+    ++nit_RCI;
+    ++offset;
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+    {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        ++nitOCp[ i ][ j ];
+        ++nitPCp[ i ][ j ];
+      }
+      for( unsigned int j = 0; j < NofLParts; j++ )
+      {
+        ++nitLCp[ i ][ j ];
+      }
     }
   } // end while
 
-  /** Set the gradient magnitudes of the several terms. */
-  this->m_LinearityConditionGradientMagnitude      = vcl_sqrt( gradMagLC );
-  this->m_OrthonormalityConditionGradientMagnitude = vcl_sqrt( gradMagOC );
-  this->m_PropernessConditionGradientMagnitude     = vcl_sqrt( gradMagPC );
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_LinearityConditionGradientMagnitude      = gradMagLC;
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_OrthonormalityConditionGradientMagnitude = gradMagOC;
+  this->m_RigidityPenaltyTermPerThreadVariables[ threadId ].st_PropernessConditionGradientMagnitude     = gradMagPC;
 
-  /** Rearrange to create a derivative. */
-  unsigned int j = 0;
-  for( unsigned int i = 0; i < ImageDimension; i++ )
+} // end ThreadedComputeDerivative()
+
+
+/**
+ * ********************* GetThreadRegion ****************************
+ */
+
+template< class TFixedImage, class TScalarType >
+bool
+TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
+::GetThreadRegion( ThreadIdType threadId, ThreadIdType numberOfThreads,
+  RigidityImageRegionType & region ) const
+{
+  /** Split the B-spline grid in slabs along the last dimension. */
+  region = this->m_RigidityCoefficientImage->GetLargestPossibleRegion();
+  const unsigned int  splitAxis     = ImageDimension - 1;
+  const SizeValueType size          = region.GetSize()[ splitAxis ];
+  const SizeValueType sizePerThread = static_cast< SizeValueType >(
+    vcl_ceil( static_cast< double >( size ) / static_cast< double >( numberOfThreads ) ) );
+  const SizeValueType begin = vnl_math_min( threadId * sizePerThread, size );
+  const SizeValueType end   = vnl_math_min( ( threadId + 1 ) * sizePerThread, size );
+  if( begin == end )
   {
-    itDIs[ i ].GoToBegin();
-    while( !itDIs[ i ].IsAtEnd() )
-    {
-      derivative[ j ] = itDIs[ i ].Get() / rigidityCoefficientSum;
-      ++itDIs[ i ];
-      j++;
-    } // end while
-  }   // end for
+    return false;
+  }
 
-} // end GetValueAndDerivative()
+  region.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + static_cast< IndexValueType >( begin ) );
+  region.SetSize( splitAxis, end - begin );
+  return true;
+
+} // end GetThreadRegion()
+
+
+/**
+ * **************** ComputeSubpartsThreaderCallback *******
+ */
+
+template< class TFixedImage, class TScalarType >
+ITK_THREAD_RETURN_TYPE
+TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ComputeSubpartsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId        = infoStruct->ThreadID;
+  ThreadIdType     numberOfThreads = infoStruct->NumberOfThreads;
+
+  RigidityPenaltyTermMultiThreaderParameterType * temp
+    = static_cast< RigidityPenaltyTermMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputeSubparts( threadId, numberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeSubpartsThreaderCallback()
+
+
+/**
+ * **************** ComputeDerivativeThreaderCallback *******
+ */
+
+template< class TFixedImage, class TScalarType >
+ITK_THREAD_RETURN_TYPE
+TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ComputeDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId        = infoStruct->ThreadID;
+  ThreadIdType     numberOfThreads = infoStruct->NumberOfThreads;
+
+  RigidityPenaltyTermMultiThreaderParameterType * temp
+    = static_cast< RigidityPenaltyTermMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputeDerivative( threadId, numberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeDerivativeThreaderCallback()
 
 
 /**
@@ -44,6 +44,11 @@ using namespace itk;
  * \parameter BaseVariance: The width ($\sigma_0^2$) of the non-informative prior.
  *   Can be defined for each resolution\n
  *    example: <tt>(BaseVariance 1000.0)</tt>
+ * \parameter NumberOfShapeModes: The number of leading modes of the shape model
+ *   that are used with ShapeModelCalculation 1 or 2. The default, 0, uses all
+ *   modes with a nonzero eigenvalue. Fewer modes make the penalty cheaper.
+ *   Can be defined for each resolution\n
+ *    example: <tt>(NumberOfShapeModes 20)</tt>
  *
  * \author F.F. Berendsen, Image Sciences Institute, UMC Utrecht, The Netherlands
  * \note This work was funded by the projects Care4Me and Mediate.
@@ -274,6 +274,12 @@ StatisticalShapePenalty< TElastix >
     "CutOffSharpness", this->GetComponentLabel(), level, 0 );
   this->SetCutOffSharpness( cutOffSharpness );
 
+  /** Get and set NumberOfShapeModes. Default 0, meaning all modes. */
+  unsigned int numberOfShapeModes = 0;
+  this->GetConfiguration()->ReadParameter( numberOfShapeModes,
+    "NumberOfShapeModes", this->GetComponentLabel(), level, 0 );
+  this->SetNumberOfShapeModes( numberOfShapeModes );
+
 } // end BeforeEachResolution()
 
 
@@ -37,6 +37,10 @@
 #include <vcl_iostream.h>
 #include <string>
 
+#ifdef ELASTIX_USE_EIGEN
+#include <Eigen/Core>
+#endif
+
 namespace itk
 {
 /** \class StatisticalShapePointPenalty
@@ -50,6 +54,20 @@ namespace itk
  * application to organ segmentation in cervical MR, Comput. Vis. Image Understand. (2013),
  * http://dx.doi.org/10.1016/j.cviu.2012.12.006
  *
+ * The points are transformed, and their Jacobians computed, by multiple
+ * threads with the batched TransformPoints() and GetJacobians() of the
+ * transform. The derivatives of the proposal vector, one for every parameter
+ * that affects the shape, are normalized and projected on the shape model by
+ * multiple threads as well, each thread for its own range of parameters.
+ *
+ * With the decomposed covariance (ShapeModelCalculation 1 and 2), the
+ * transposed eigenvectors of the shape modes that are used are stored once,
+ * in Initialize(), as a row-major ShapeModes x ProposalLength matrix, so that
+ * both the projection on the modes and the back projection stream through
+ * memory. When elastix is built with ELASTIX_USE_EIGEN these matrix vector
+ * products are done by Eigen. SetNumberOfShapeModes() truncates the model to
+ * its leading modes.
+ *
  * \ingroup RegistrationMetrics
  */
 
@@ -79,6 +97,7 @@ public:
   typedef typename Superclass::TransformParametersType    TransformParametersType;
   typedef typename Superclass::TransformJacobianType      TransformJacobianType;
   typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename Superclass::ThreadInfoType             ThreadInfoType;
 
   typedef typename Superclass::MeasureType                MeasureType;
   typedef typename Superclass::DerivativeType             DerivativeType;
@@ -88,6 +107,8 @@ public:
   typedef typename Superclass::FixedPointSetConstPointer  FixedPointSetConstPointer;
   typedef typename Superclass::MovingPointSetConstPointer MovingPointSetConstPointer;
 
+  typedef typename Superclass::TransformParametersValueType TransformParametersValueType;
+
   typedef typename Superclass::PointIterator     PointIterator;
   typedef typename Superclass::PointDataIterator PointDataIterator;
 
@@ -161,6 +182,13 @@ public:
   itkSetMacro( ShapeModelCalculation, int );
   itkGetConstReferenceMacro( ShapeModelCalculation, int );
 
+  /** Set/Get the number of leading shape modes that are used with the
+   * decomposed covariance, ShapeModelCalculation 1 or 2. The default, 0,
+   * uses all modes with a nonzero eigenvalue. Takes effect in Initialize().
+   */
+  itkSetMacro( NumberOfShapeModes, unsigned int );
+  itkGetConstMacro( NumberOfShapeModes, unsigned int );
+
   itkSetMacro( NormalizedShapeModel, bool );
   itkGetConstReferenceMacro( NormalizedShapeModel, bool );
   itkBooleanMacro( NormalizedShapeModel );
@@ -184,31 +212,95 @@ private:
   StatisticalShapePointPenalty( const Self & );  // purposely not implemented
   void operator=( const Self & );                // purposely not implemented
 
-  void FillProposalVector( const OutputPointType & fixedPoint,
-    const unsigned int vertexindex ) const;
-
-  void FillProposalDerivative( const OutputPointType & fixedPoint,
-    const unsigned int vertexindex ) const;
+  /** The number of points that is passed at once to the transform. */
+  itkStaticConstMacro( PointChunkSize, unsigned int, 32 );
+
+  /** Helper struct for the threads. */
+  struct ShapeThreaderParameterType
+  {
+    const Self *          st_Metric;
+    bool                  st_ComputeDerivative;
+    unsigned int          st_ShapeLength;
+    MeasureType           st_Value;
+    const VnlVectorType * st_DerivativeWeights;
+    DerivativeValueType * st_DerivativePointer;
+  };
+  mutable ShapeThreaderParameterType m_ShapeThreaderParameters;
+
+  /** Copy the mapped positions of the part of the points of this thread in
+   * the proposal vector and, if st_ComputeDerivative is true, store their
+   * Jacobians in m_PointJacobians.
+   */
+  void ThreadedFillProposal( const ThreadIdType threadId,
+    const ThreadIdType numberOfThreads, const bool computeDerivative ) const;
+
+  /** Multi-threaded version of ThreadedFillProposal(). */
+  static ITK_THREAD_RETURN_TYPE FillProposalThreaderCallback( void * arg );
+
+  /** Copy the Jacobians of m_PointJacobians in the proposal derivative,
+   * creating the vector of every parameter that affects the shape.
+   */
+  void FillProposalDerivative( const unsigned int numberOfPoints ) const;
 
   void UpdateCentroidAndAlignProposalVector(
     const unsigned int shapeLength ) const;
 
-  void UpdateCentroidAndAlignProposalDerivative(
-    const unsigned int shapeLength ) const;
+  /** Update the proposal derivatives of the parameters [ muBegin, muEnd [. */
+  void UpdateCentroidAndAlignProposalDerivative( const unsigned int shapeLength,
+    const SizeValueType muBegin, const SizeValueType muEnd ) const;
 
   void UpdateL2( const unsigned int shapeLength ) const;
 
   void NormalizeProposalVector( const unsigned int shapeLength ) const;
 
-  void UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength ) const;
+  /** Update the proposal derivatives of the parameters [ muBegin, muEnd [. */
+  void UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength,
+    const SizeValueType muBegin, const SizeValueType muEnd ) const;
+
+  /** Centroid alignment and size normalization of the proposal derivatives,
+   * multi-threaded over the parameters.
+   */
+  static ITK_THREAD_RETURN_TYPE NormalizeProposalDerivativeThreaderCallback( void * arg );
 
   void CalculateValue( MeasureType & value, VnlVectorType & differenceVector,
     VnlVectorType & centerrotated, VnlVectorType & eigrot ) const;
 
-  void CalculateDerivative( DerivativeType & derivative, const MeasureType & value,
+  /** The derivative of the value with respect to parameter mu is the inner
+   * product of these weights with the proposal derivative of mu, divided by
+   * the value. Computing them once replaces a projection of every proposal
+   * derivative on the eigenvectors, or the inverse covariance matrix.
+   */
+  void CalculateDerivativeWeights( VnlVectorType & weights,
     const VnlVectorType & differenceVector, const VnlVectorType & centerrotated,
     const VnlVectorType & eigrot, const unsigned int shapeLength ) const;
 
+  /** Store the projection on the shape modes that are used. */
+  void UpdateShapeModeProjection( void );
+
+  /** y = A x, for a row-major matrix A. */
+  static void MultiplyMatrixVector( const VnlMatrixType & A,
+    const VnlVectorType & x, VnlVectorType & y );
+
+  /** y = A^T x, for a row-major matrix A. */
+  static void MultiplyTransposedMatrixVector( const VnlMatrixType & A,
+    const VnlVectorType & x, VnlVectorType & y );
+
+  /** Compute the derivative of the parameters [ muBegin, muEnd [, and
+   * delete their proposal derivatives.
+   */
+  void CalculateDerivative( DerivativeValueType * derivative, const MeasureType & value,
+    const VnlVectorType & weights, const SizeValueType muBegin, const SizeValueType muEnd ) const;
+
+  /** Multi-threaded version of CalculateDerivative(). */
+  static ITK_THREAD_RETURN_TYPE CalculateDerivativeThreaderCallback( void * arg );
+
+  /** Get the number of threads for the loops over the parameters. */
+  ThreadIdType GetNumberOfThreadsForParameters( void ) const
+  {
+    return this->m_UseMultiThread ? this->m_NumberOfThreads : 1;
+  }
+
+
   void CalculateCutOffValue( MeasureType & value ) const;
 
   void CalculateCutOffDerivative(
@@ -246,6 +338,17 @@ private:
   double                           m_BaseStd;
   mutable VnlVectorType            m_ProposalVector;
   mutable VnlVectorType            m_MeanValues;
+  unsigned int                     m_NumberOfShapeModes;
+
+  /** The transposed eigenvectors and the regularized eigenvalues of the
+   * shape modes that are used. */
+  VnlMatrixType m_ShapeModeProjection;
+  VnlVectorType m_ShapeModeEigenValuesRegularized;
+
+  /** The Jacobians and nonzero Jacobian indices of all points, see
+   * TransformType::GetJacobians(). */
+  mutable std::vector< TransformParametersValueType > m_PointJacobians;
+  mutable std::vector< unsigned long >                m_PointNonZeroJacobianIndices;
 
   double m_CutOffValue;
   double m_CutOffSharpness;
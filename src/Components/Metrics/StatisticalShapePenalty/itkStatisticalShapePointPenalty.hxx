@@ -41,6 +41,15 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   this->m_BaseVarianceNeedsUpdate       = true;
   this->m_VariancesNeedsUpdate          = true;
 
+  this->m_NumberOfShapeModes = 0;
+
+  this->m_ShapeThreaderParameters.st_Metric            = this;
+  this->m_ShapeThreaderParameters.st_ComputeDerivative = false;
+  this->m_ShapeThreaderParameters.st_ShapeLength       = 0;
+  this->m_ShapeThreaderParameters.st_Value             = NumericTraits< MeasureType >::Zero;
+  this->m_ShapeThreaderParameters.st_DerivativeWeights = NULL;
+  this->m_ShapeThreaderParameters.st_DerivativePointer = NULL;
+
 } // end Constructor
 
 
@@ -343,9 +352,156 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
       this->m_EigenValuesRegularized  = NULL;
   }
 
+  this->UpdateShapeModeProjection();
+
 } // end Initialize()
 
 
+/**
+ * ******************* UpdateShapeModeProjection *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::UpdateShapeModeProjection( void )
+{
+  if( ( this->m_ShapeModelCalculation != 1 && this->m_ShapeModelCalculation != 2 )
+    || this->m_EigenVectors == NULL || this->m_EigenValuesRegularized == NULL )
+  {
+    this->m_ShapeModeProjection.set_size( 0, 0 );
+    this->m_ShapeModeEigenValuesRegularized.set_size( 0 );
+    return;
+  }
+
+  /** The eigenvalues are sorted in decreasing order. */
+  unsigned int numberOfModes = this->m_EigenVectors->cols();
+  if( this->m_NumberOfShapeModes > 0 && this->m_NumberOfShapeModes < numberOfModes )
+  {
+    numberOfModes = this->m_NumberOfShapeModes;
+  }
+
+  this->m_ShapeModeProjection
+    = this->m_EigenVectors->get_n_columns( 0, numberOfModes ).transpose();
+  this->m_ShapeModeEigenValuesRegularized
+    = this->m_EigenValuesRegularized->extract( numberOfModes );
+
+} // end UpdateShapeModeProjection()
+
+
+/**
+ * ******************* MultiplyMatrixVector *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::MultiplyMatrixVector( const VnlMatrixType & A,
+  const VnlVectorType & x, VnlVectorType & y )
+{
+  const unsigned int rows = A.rows();
+  const unsigned int cols = A.cols();
+  y.set_size( rows );
+
+#ifdef ELASTIX_USE_EIGEN
+  typedef Eigen::Matrix< CoordRepType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor > EigenMatrixType;
+  typedef Eigen::Matrix< CoordRepType, Eigen::Dynamic, 1 >                              EigenVectorType;
+  Eigen::Map< const EigenMatrixType > AE( A.data_block(), rows, cols );
+  Eigen::Map< const EigenVectorType > xE( x.data_block(), cols );
+  Eigen::Map< EigenVectorType >       yE( y.data_block(), rows );
+  yE.noalias() = AE * xE;
+#else
+  /** Four rows at a time, so that every element of x is loaded once per
+   * four rows. */
+  const CoordRepType * xp = x.data_block();
+  unsigned int         i  = 0;
+  for(; i + 4 <= rows; i += 4 )
+  {
+    const CoordRepType * a0 = A[ i ];
+    const CoordRepType * a1 = A[ i + 1 ];
+    const CoordRepType * a2 = A[ i + 2 ];
+    const CoordRepType * a3 = A[ i + 3 ];
+    CoordRepType         s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    for( unsigned int j = 0; j < cols; ++j )
+    {
+      s0 += a0[ j ] * xp[ j ];
+      s1 += a1[ j ] * xp[ j ];
+      s2 += a2[ j ] * xp[ j ];
+      s3 += a3[ j ] * xp[ j ];
+    }
+    y[ i ]     = s0;
+    y[ i + 1 ] = s1;
+    y[ i + 2 ] = s2;
+    y[ i + 3 ] = s3;
+  }
+  for(; i < rows; ++i )
+  {
+    const CoordRepType * a = A[ i ];
+    CoordRepType         s = 0.0;
+    for( unsigned int j = 0; j < cols; ++j )
+    {
+      s += a[ j ] * xp[ j ];
+    }
+    y[ i ] = s;
+  }
+#endif
+
+} // end MultiplyMatrixVector()
+
+
+/**
+ * ******************* MultiplyTransposedMatrixVector *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::MultiplyTransposedMatrixVector( const VnlMatrixType & A,
+  const VnlVectorType & x, VnlVectorType & y )
+{
+  const unsigned int rows = A.rows();
+  const unsigned int cols = A.cols();
+  y.set_size( cols );
+
+#ifdef ELASTIX_USE_EIGEN
+  typedef Eigen::Matrix< CoordRepType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor > EigenMatrixType;
+  typedef Eigen::Matrix< CoordRepType, Eigen::Dynamic, 1 >                              EigenVectorType;
+  Eigen::Map< const EigenMatrixType > AE( A.data_block(), rows, cols );
+  Eigen::Map< const EigenVectorType > xE( x.data_block(), rows );
+  Eigen::Map< EigenVectorType >       yE( y.data_block(), cols );
+  yE.noalias() = AE.transpose() * xE;
+#else
+  /** Add four rows at a time, scaled by their element of x, so that every
+   * element of y is loaded and stored once per four rows. */
+  y.fill( 0.0 );
+  CoordRepType * yp = y.data_block();
+  unsigned int   i  = 0;
+  for(; i + 4 <= rows; i += 4 )
+  {
+    const CoordRepType * a0 = A[ i ];
+    const CoordRepType * a1 = A[ i + 1 ];
+    const CoordRepType * a2 = A[ i + 2 ];
+    const CoordRepType * a3 = A[ i + 3 ];
+    const CoordRepType   x0 = x[ i ], x1 = x[ i + 1 ], x2 = x[ i + 2 ], x3 = x[ i + 3 ];
+    for( unsigned int j = 0; j < cols; ++j )
+    {
+      yp[ j ] += x0 * a0[ j ] + x1 * a1[ j ] + x2 * a2[ j ] + x3 * a3[ j ];
+    }
+  }
+  for(; i < rows; ++i )
+  {
+    const CoordRepType * a  = A[ i ];
+    const CoordRepType   xi = x[ i ];
+    for( unsigned int j = 0; j < cols; ++j )
+    {
+      yp[ j ] += xi * a[ j ];
+    }
+  }
+#endif
+
+} // end MultiplyTransposedMatrixVector()
+
+
 /**
  * ******************* GetValue *******************
  */
@@ -366,9 +522,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   //this->m_NumberOfPointsCounted = 0;
   MeasureType value = NumericTraits< MeasureType >::Zero;
 
-  //InputPointType movingPoint;
-  OutputPointType fixedPoint;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
@@ -379,22 +532,11 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   /** Part 1:
    * - Copy point positions in proposal vector
    */
-
-  /** Create iterators. */
-  PointIterator pointItFixed = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointEnd     = fixedPointSet->GetPoints()->End();
-
-  unsigned int vertexindex = 0;
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
-  {
-    fixedPoint = pointItFixed.Value();
-    this->FillProposalVector( fixedPoint, vertexindex );
-
-    this->m_NumberOfPointsCounted++;
-    ++pointItFixed;
-    vertexindex += Self::FixedPointSetDimension;
-  } // end loop over all corresponding points
+  const unsigned int numberOfPoints = fixedPointSet->GetNumberOfPoints();
+  this->m_ShapeThreaderParameters.st_ComputeDerivative = false;
+  this->ExecuteThreaderCallback( Self::FillProposalThreaderCallback,
+    &this->m_ShapeThreaderParameters, this->GetNumberOfThreadsForPoints( numberOfPoints ) );
+  this->m_NumberOfPointsCounted += numberOfPoints;
 
   if( this->m_NormalizedShapeModel )
   {
@@ -469,9 +611,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   derivative = DerivativeType( this->GetNumberOfParameters() );
   derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
 
-  //InputPointType movingPoint;
-  OutputPointType fixedPoint;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
@@ -484,24 +623,22 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   /** Part 1:
    * - Copy point positions in proposal vector
    * - Copy point derivatives in proposal derivative vector
+   *
+   * The threads transform the points and compute their Jacobians; copying
+   * the Jacobians creates the proposal derivatives, and is done serially.
    */
-
-  /** Create iterators. */
-  PointIterator pointItFixed = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointEnd     = fixedPointSet->GetPoints()->End();
-
-  unsigned int vertexindex = 0;
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
-  {
-    fixedPoint = pointItFixed.Value();
-    this->FillProposalVector( fixedPoint, vertexindex );
-    this->FillProposalDerivative( fixedPoint, vertexindex );
-
-    this->m_NumberOfPointsCounted++;
-    ++pointItFixed;
-    vertexindex += Self::FixedPointSetDimension;
-  } // end loop over all corresponding points
+  const unsigned int  numberOfPoints = fixedPointSet->GetNumberOfPoints();
+  const unsigned long nnzji          = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  this->m_PointJacobians.resize( numberOfPoints * Self::MovingPointSetDimension * nnzji );
+  this->m_PointNonZeroJacobianIndices.resize( numberOfPoints * nnzji );
+  this->m_ShapeThreaderParameters.st_ComputeDerivative = true;
+  this->ExecuteThreaderCallback( Self::FillProposalThreaderCallback,
+    &this->m_ShapeThreaderParameters, this->GetNumberOfThreadsForPoints( numberOfPoints ) );
+  this->FillProposalDerivative( numberOfPoints );
+  this->m_NumberOfPointsCounted += numberOfPoints;
+
+  const ThreadIdType numberOfThreadsForParameters = this->GetNumberOfThreadsForParameters();
+  this->m_ShapeThreaderParameters.st_ShapeLength = shapeLength;
 
   if( this->m_NormalizedShapeModel )
   {
@@ -514,7 +651,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
      * - update proposal derivatives
      */
     this->UpdateCentroidAndAlignProposalVector( shapeLength );
-    this->UpdateCentroidAndAlignProposalDerivative( shapeLength );
 
     /** Part 3:
      * - Calculate l2-norm from aligned shapes
@@ -525,7 +661,8 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
      * - update proposal derivatives
      */
     this->UpdateL2( shapeLength );
-    this->UpdateL2AndNormalizeProposalDerivative( shapeLength );
+    this->ExecuteThreaderCallback( Self::NormalizeProposalDerivativeThreaderCallback,
+      &this->m_ShapeThreaderParameters, numberOfThreadsForParameters );
     this->NormalizeProposalVector( shapeLength );
 
   } // end if(m_NormalizedShapeModel)
@@ -539,7 +676,15 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 
   if( value != 0.0 )
   {
-    this->CalculateDerivative( derivative, value, differenceVector, centerrotated, eigrot, shapeLength );
+    VnlVectorType weights;
+    this->CalculateDerivativeWeights( weights, differenceVector, centerrotated, eigrot, shapeLength );
+    this->m_ShapeThreaderParameters.st_Value             = value;
+    this->m_ShapeThreaderParameters.st_DerivativeWeights = &weights;
+    this->m_ShapeThreaderParameters.st_DerivativePointer = derivative.data_block();
+    this->ExecuteThreaderCallback( Self::CalculateDerivativeThreaderCallback,
+      &this->m_ShapeThreaderParameters, numberOfThreadsForParameters );
+    this->m_ShapeThreaderParameters.st_DerivativeWeights = NULL;
+    this->m_ShapeThreaderParameters.st_DerivativePointer = NULL;
   }
   else
   {
@@ -562,25 +707,80 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 
 
 /**
- * ******************* FillProposalVector *******************
+ * ******************* FillProposalThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::FillProposalThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const ShapeThreaderParameterType * temp
+    = static_cast< const ShapeThreaderParameterType * >( infoStruct->UserData );
+
+  temp->st_Metric->ThreadedFillProposal( infoStruct->ThreadID,
+    infoStruct->NumberOfThreads, temp->st_ComputeDerivative );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end FillProposalThreaderCallback()
+
+
+/**
+ * ******************* ThreadedFillProposal *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::FillProposalVector( const OutputPointType & fixedPoint,
-  const unsigned int vertexindex ) const
+::ThreadedFillProposal( const ThreadIdType threadId,
+  const ThreadIdType numberOfThreads, const bool computeDerivative ) const
 {
-  OutputPointType mappedPoint;
-  /** Get the current corresponding points. */
-  mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
+  const typename FixedPointSetType::PointsContainer * fixedPoints
+    = this->GetFixedPointSet()->GetPoints();
 
-  /** Copy n-D coordinates into big Shape vector. Aligning the centroids is done later. */
-  for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
+  /** Get the part of the points of this thread. */
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  this->SplitRangeForThread( this->GetFixedPointSet()->GetNumberOfPoints(),
+    threadId, numberOfThreads, begin, end );
+
+  const unsigned long nnzji        = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const unsigned long jacobianSize = Self::MovingPointSetDimension * nnzji;
+
+  InputPointType  fixedChunk[ PointChunkSize ];
+  OutputPointType mappedChunk[ PointChunkSize ];
+  for( SizeValueType chunkBegin = begin; chunkBegin < end; chunkBegin += PointChunkSize )
   {
-    this->m_ProposalVector[ vertexindex + d ] = mappedPoint[ d ];
+    const SizeValueType chunkSize = vnl_math_min(
+      end - chunkBegin, static_cast< SizeValueType >( PointChunkSize ) );
+    for( SizeValueType i = 0; i < chunkSize; ++i )
+    {
+      fixedChunk[ i ] = fixedPoints->ElementAt( chunkBegin + i );
+    }
+
+    /** Copy n-D coordinates into big Shape vector. Aligning the centroids is done later. */
+    this->m_Transform->TransformPoints( fixedChunk, chunkSize, mappedChunk );
+    for( SizeValueType i = 0; i < chunkSize; ++i )
+    {
+      const SizeValueType vertexindex = ( chunkBegin + i ) * Self::FixedPointSetDimension;
+      for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
+      {
+        this->m_ProposalVector[ vertexindex + d ] = mappedChunk[ i ][ d ];
+      }
+    }
+
+    /** Get the TransformJacobians dT/dmu. */
+    if( computeDerivative )
+    {
+      this->m_Transform->GetJacobians( fixedChunk, chunkSize,
+        &( this->m_PointJacobians[ chunkBegin * jacobianSize ] ),
+        &( this->m_PointNonZeroJacobianIndices[ chunkBegin * nnzji ] ) );
+    }
   }
-} // end FillProposalVector()
+
+} // end ThreadedFillProposal()
 
 
 /**
@@ -590,8 +790,7 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::FillProposalDerivative( const OutputPointType & fixedPoint,
-  const unsigned int vertexindex ) const
+::FillProposalDerivative( const unsigned int numberOfPoints ) const
 {
   /**
    * A (column) vector is constructed for each mu, only if that mu affects the shape penalty.
@@ -605,32 +804,34 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
    * mu3: [ [ 0 , 0 , 0 ] , [ dx2/dmu3 , dy2/dmu3 , dz2/dmu3 ] , [ dx3/dmu3 , dy3/dmu3 , dz3/dmu3 ] , [...] ]^T
    *
    */
+  const unsigned long nnzji        = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const unsigned long jacobianSize = Self::MovingPointSetDimension * nnzji;
 
-  NonZeroJacobianIndicesType nzji(
-  this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-
-  /** Get the TransformJacobian dT/dmu. */
-  TransformJacobianType jacobian;
-  this->m_Transform->GetJacobian( fixedPoint, jacobian, nzji );
-
-  for( unsigned int i = 0; i < nzji.size(); ++i )
+  for( unsigned int p = 0; p < numberOfPoints; ++p )
   {
-    const unsigned int mu = nzji[ i ];
-    if( ( *this->m_ProposalDerivative )[ mu ] == NULL )
+    const unsigned int                   vertexindex = p * Self::FixedPointSetDimension;
+    const TransformParametersValueType * jacobian    = &( this->m_PointJacobians[ p * jacobianSize ] );
+    const unsigned long *                nzji        = &( this->m_PointNonZeroJacobianIndices[ p * nnzji ] );
+    for( unsigned long i = 0; i < nnzji; ++i )
     {
-      /** Create the big column vector if it does not yet exist for this mu*/
-      ( *this->m_ProposalDerivative )[ mu ] = new VnlVectorType( this->m_ProposalLength, 0.0 );
-      // memory will be freed in CalculateDerivative()
-    }
+      const unsigned long mu = nzji[ i ];
+      if( ( *this->m_ProposalDerivative )[ mu ] == NULL )
+      {
+        /** Create the big column vector if it does not yet exist for this mu*/
+        ( *this->m_ProposalDerivative )[ mu ] = new VnlVectorType( this->m_ProposalLength, 0.0 );
+        // memory will be freed in CalculateDerivative()
+      }
 
-    /** The column vector exists for this mu, so copy the jacobians for this point into the big vector. */
-    for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
-    {
-      ( *( *this->m_ProposalDerivative )[ mu ] )[ vertexindex + d ] = jacobian.get_column( i )[ d ];
+      /** The column vector exists for this mu, so copy the jacobians for this point into the big vector. */
+      VnlVectorType & column = *( *this->m_ProposalDerivative )[ mu ];
+      for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
+      {
+        column[ vertexindex + d ] = jacobian[ d * nnzji + i ];
+      }
     }
   }
 
-} // end FillProposalVector()
+} // end FillProposalDerivative()
 
 
 /**
@@ -676,10 +877,11 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::UpdateCentroidAndAlignProposalDerivative( const unsigned int shapeLength ) const
+::UpdateCentroidAndAlignProposalDerivative( const unsigned int shapeLength,
+  const SizeValueType muBegin, const SizeValueType muEnd ) const
 {
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = m_ProposalDerivative->end();
+  typename ProposalDerivativeType::iterator proposalDerivativeIt  = m_ProposalDerivative->begin() + muBegin;
+  typename ProposalDerivativeType::iterator proposalDerivativeEnd = m_ProposalDerivative->begin() + muEnd;
   while( proposalDerivativeIt != proposalDerivativeEnd )
   {
     if( *proposalDerivativeIt != NULL )
@@ -758,12 +960,13 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength ) const
+::UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength,
+  const SizeValueType muBegin, const SizeValueType muEnd ) const
 {
-  double & l2norm = this->m_ProposalVector[ shapeLength + Self::FixedPointSetDimension ];
+  const double & l2norm = this->m_ProposalVector[ shapeLength + Self::FixedPointSetDimension ];
 
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->end();
+  typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin() + muBegin;
+  typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->begin() + muEnd;
 
   while( proposalDerivativeIt != proposalDerivativeEnd )
   {
@@ -792,6 +995,34 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 } //end UpdateL2AndNormalizeProposalDerivative()
 
 
+/**
+ * ******************* NormalizeProposalDerivativeThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::NormalizeProposalDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const ShapeThreaderParameterType * temp
+    = static_cast< const ShapeThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = temp->st_Metric;
+
+  /** Every proposal derivative only depends on the proposal vector. */
+  SizeValueType muBegin = 0;
+  SizeValueType muEnd   = 0;
+  metric->SplitRangeForThread( metric->m_ProposalDerivative->size(),
+    infoStruct->ThreadID, infoStruct->NumberOfThreads, muBegin, muEnd );
+
+  metric->UpdateCentroidAndAlignProposalDerivative( temp->st_ShapeLength, muBegin, muEnd );
+  metric->UpdateL2AndNormalizeProposalDerivative( temp->st_ShapeLength, muBegin, muEnd );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end NormalizeProposalDerivativeThreaderCallback()
+
+
 /**
  * ******************* CalculateValue *******************
  */
@@ -810,13 +1041,15 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   {
     case 0: // full covariance
     {
-      value = sqrt( bracket( differenceVector, *this->m_InverseCovarianceMatrix, differenceVector ) );
+      /** centerrotated = diff^T * Sigma^-1, which is reused for the derivative. */
+      MultiplyTransposedMatrixVector( *this->m_InverseCovarianceMatrix, differenceVector, centerrotated );
+      value = sqrt( dot_product( centerrotated, differenceVector ) );
       break;
     }
     case 1: // decomposed covariance (uniform regularization)
     {
-      centerrotated = differenceVector * ( *m_EigenVectors );                       /** diff^T * V */
-      eigrot        = element_quotient( centerrotated, *m_EigenValuesRegularized ); /** diff^T * V * Lambda^-1 */
+      MultiplyMatrixVector( this->m_ShapeModeProjection, differenceVector, centerrotated ); /** diff^T * V */
+      eigrot = element_quotient( centerrotated, this->m_ShapeModeEigenValuesRegularized );  /** diff^T * V * Lambda^-1 */
       if( this->m_ShrinkageIntensity != 0 )
       {
         /** innerproduct diff^T * V * Lambda^-1 * V^T * diff  +  1/(sigma_0*Beta)* diff^T*diff*/
@@ -844,8 +1077,8 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
       differenceVector[ shapeLength + 2 ] /= this->m_CentroidZStd;
       differenceVector[ shapeLength + 3 ] /= this->m_SizeStd;
 
-      centerrotated = differenceVector * ( *this->m_EigenVectors );                       /** diff^T * V */
-      eigrot        = element_quotient( centerrotated, *this->m_EigenValuesRegularized ); /** diff^T * V * Lambda^-1 */
+      MultiplyMatrixVector( this->m_ShapeModeProjection, differenceVector, centerrotated ); /** diff^T * V */
+      eigrot = element_quotient( centerrotated, this->m_ShapeModeEigenValuesRegularized );  /** diff^T * V * Lambda^-1 */
       if( this->m_ShrinkageIntensity != 0 )
       {
         /** innerproduct diff^T * ~V * I * ~V^T * diff  +  1/(Beta)* diff^T*diff*/
@@ -868,103 +1101,131 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 
 
 /**
- * ******************* CalculateDerivative *******************
+ * ******************* CalculateDerivativeWeights *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::CalculateDerivative( DerivativeType & derivative,
-  const MeasureType & value,
+::CalculateDerivativeWeights( VnlVectorType & weights,
   const VnlVectorType & differenceVector,
   const VnlVectorType & centerrotated,
   const VnlVectorType & eigrot,
   const unsigned int shapeLength ) const
 {
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->end();
+  switch( this->m_ShapeModelCalculation )
+  {
+    case 0: // full covariance
+    {
+      /** innerproduct diff^T * Sigma^-1 * d/dmu (diff) = ( diff^T * Sigma^-1 ) * d/dmu (diff),
+       * where diff^T * Sigma^-1 was computed by CalculateValue(). */
+      weights = centerrotated;
+      break;
+    }
+    case 1: // decomposed covariance (uniform regularization)
+    {
+      /** innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
+       * + 1/(Beta*sigma_0^2)*diff^T* d/dmu(diff), where iterated over mu-s
+       */
+      MultiplyTransposedMatrixVector( this->m_ShapeModeProjection, eigrot, weights );
+      if( this->m_ShrinkageIntensity != 0 )
+      {
+        weights += differenceVector / ( this->m_ShrinkageIntensity * this->m_BaseVariance );
+      }
+      break;
+    }
+    case 2: // decomposed scaled covariance (element specific regularization)
+    {
+      /** innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
+       * + 1/(Beta)*diff^T* d/dmu(diff), where the proposal derivatives are
+       * scaled with their sigma's, in order to evaluate with the EigenValues
+       * and EigenVectors of the scaled CovarianceMatrix. That scaling is
+       * applied to the weights instead.
+       */
+      MultiplyTransposedMatrixVector( this->m_ShapeModeProjection, eigrot, weights );
+      if( this->m_ShrinkageIntensity != 0 )
+      {
+        weights += differenceVector / this->m_ShrinkageIntensity;
+      }
+      typename VnlVectorType::iterator weightIt = weights.begin();
+      for( unsigned int weightIndex = 0; weightIndex < shapeLength; ++weightIndex, ++weightIt )
+      {
+        ( *weightIt ) /= this->m_BaseStd;
+      }
+      weights[ shapeLength     ] /= this->m_CentroidXStd;
+      weights[ shapeLength + 1 ] /= this->m_CentroidYStd;
+      weights[ shapeLength + 2 ] /= this->m_CentroidZStd;
+      weights[ shapeLength + 3 ] /= this->m_SizeStd;
+      break;
+    }
+    default:
+    {
+      /** The derivative is zero. */
+      weights.set_size( 0 );
+    }
+  }
+
+} // end CalculateDerivativeWeights()
+
 
-  typename DerivativeType::iterator derivativeIt = derivative.begin();
+/**
+ * ******************* CalculateDerivative *******************
+ */
 
-  for(; proposalDerivativeIt != proposalDerivativeEnd; ++proposalDerivativeIt, ++derivativeIt )
+template< class TFixedPointSet, class TMovingPointSet >
+void
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::CalculateDerivative( DerivativeValueType * derivative,
+  const MeasureType & value,
+  const VnlVectorType & weights,
+  const SizeValueType muBegin, const SizeValueType muEnd ) const
+{
+  for( SizeValueType mu = muBegin; mu < muEnd; ++mu )
   {
-    if( *proposalDerivativeIt != NULL )
+    VnlVectorType * & proposalDerivative = ( *this->m_ProposalDerivative )[ mu ];
+    if( proposalDerivative != NULL )
     {
-      switch( this->m_ShapeModelCalculation )
+      if( weights.size() != 0 )
       {
-        case 0: // full covariance
-        {
-          /**innerproduct diff^T * Sigma^-1 * d/dmu (diff), where iterated over mu-s*/
-          *derivativeIt = bracket( differenceVector, *m_InverseCovarianceMatrix, ( **proposalDerivativeIt ) ) / value;
-          this->CalculateCutOffDerivative( *derivativeIt, value );
-          break;
-        }
-        case 1: // decomposed covariance (uniform regularization)
-        {
-          if( this->m_ShrinkageIntensity != 0 )
-          {
-            /** Innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
-             * + 1/(Beta*sigma_0^2)*diff^T* d/dmu(diff), where iterated over mu-s
-             */
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose() * ( **proposalDerivativeIt ) )
-              + dot_product( differenceVector, **proposalDerivativeIt )
-              / ( this->m_ShrinkageIntensity * this->m_BaseVariance ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          else //m_ShrinkageIntensity==0
-          {
-            /**innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu (diff), where iterated over mu-s*/
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose()
-              * ( **proposalDerivativeIt ) ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          break;
-        }
-        case 2: // decomposed scaled covariance (element specific regularization)
-        {
-          // first scale proposalDerivatives with their sigma's in order to evaluate
-          // with the EigenValues and EigenVectors of the scaled CovarianceMatrix
-          typename VnlVectorType::iterator propDerivElementIt = ( *proposalDerivativeIt )->begin();
-          for( unsigned int propDerivElementIndex = 0; propDerivElementIndex < shapeLength;
-            ++propDerivElementIndex, ++propDerivElementIt )
-          {
-            ( *propDerivElementIt ) /= this->m_BaseStd;
-          }
-          ( **proposalDerivativeIt )[ shapeLength     ] /= this->m_CentroidXStd;
-          ( **proposalDerivativeIt )[ shapeLength + 1 ] /= this->m_CentroidYStd;
-          ( **proposalDerivativeIt )[ shapeLength + 2 ] /= this->m_CentroidZStd;
-          ( **proposalDerivativeIt )[ shapeLength + 3 ] /= this->m_SizeStd;
-          if( this->m_ShrinkageIntensity != 0 )
-          {
-            /** innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
-             * + 1/(Beta*sigma_0^2)*diff^T* d/dmu(diff), where iterated over mu-s
-             */
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose() * ( **proposalDerivativeIt ) )
-              + dot_product( differenceVector, **proposalDerivativeIt )
-              / this->m_ShrinkageIntensity ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          else //m_ShrinkageIntensity==0
-          {
-            /**innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu (diff), where iterated over mu-s*/
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose()
-              * ( **proposalDerivativeIt ) ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          break;
-        }
-        default:
-        {}
-
-          delete ( *proposalDerivativeIt );
-          // nzjacs++;
+        derivative[ mu ] = dot_product( weights, *proposalDerivative ) / value;
+        this->CalculateCutOffDerivative( derivative[ mu ], value );
       }
+
+      delete proposalDerivative;
+      proposalDerivative = NULL;
     }
   }
 
 } // end CalculateDerivative()
 
 
+/**
+ * ******************* CalculateDerivativeThreaderCallback *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ITK_THREAD_RETURN_TYPE
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::CalculateDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const ShapeThreaderParameterType * temp
+    = static_cast< const ShapeThreaderParameterType * >( infoStruct->UserData );
+  const Self * metric = temp->st_Metric;
+
+  SizeValueType muBegin = 0;
+  SizeValueType muEnd   = 0;
+  metric->SplitRangeForThread( metric->m_ProposalDerivative->size(),
+    infoStruct->ThreadID, infoStruct->NumberOfThreads, muBegin, muEnd );
+
+  metric->CalculateDerivative( temp->st_DerivativePointer, temp->st_Value,
+    *temp->st_DerivativeWeights, muBegin, muEnd );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end CalculateDerivativeThreaderCallback()
+
+
 /**
  * ******************* CalculateCutOffValue *******************
  */
@@ -1012,6 +1273,8 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 ::PrintSelf( std::ostream & os, Indent indent ) const
 {
   Superclass::PrintSelf( os, indent );
+  os << indent << "NumberOfShapeModes: " << this->m_NumberOfShapeModes << std::endl;
+  os << indent << "NumberOfUsedShapeModes: " << this->m_ShapeModeProjection.rows() << std::endl;
   // \todo complete it
 //
 //   if ( this->m_ComputeSquaredDistance )
@@ -102,6 +102,11 @@ public:
     Superclass::MovingImageLimiterOutputType              MovingImageLimiterOutputType;
   typedef typename
     Superclass::MovingImageDerivativeScalesType           MovingImageDerivativeScalesType;
+  typedef typename DerivativeType::ValueType              DerivativeValueType;
+  typedef typename Superclass::ThreadInfoType             ThreadInfoType;
+
+  typedef vnl_matrix< RealType >            MatrixType;
+  typedef vnl_matrix< DerivativeValueType > DerivativeMatrixType;
 
   /** The fixed image dimension. */
   itkStaticConstMacro( FixedImageDimension, unsigned int,
@@ -112,6 +117,8 @@ public:
     MovingImageType::ImageDimension );
 
   /** Get the value for single valued optimizers. */
+  virtual MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
   virtual MeasureType GetValue( const TransformParametersType & parameters ) const;
 
   /** Get the derivatives of the match measure. */
@@ -119,6 +126,9 @@ public:
     DerivativeType & derivative ) const;
 
   /** Get value and derivatives for multiple valued optimizers. */
+  void GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
+    MeasureType & Value, DerivativeType & Derivative ) const;
+
   virtual void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const;
 
@@ -131,7 +141,7 @@ public:
 protected:
 
   SumOfPairwiseCorrelationCoefficientsMetric();
-  virtual ~SumOfPairwiseCorrelationCoefficientsMetric() {}
+  virtual ~SumOfPairwiseCorrelationCoefficientsMetric();
   void PrintSelf( std::ostream & os, Indent indent ) const;
 
   /** Protected Typedefs ******************/
@@ -158,6 +168,58 @@ protected:
     const MovingImageDerivativeType & movingImageDerivative,
     DerivativeType & imageJacobian ) const;
 
+  struct SPCMetricMultiThreaderParameterType
+  {
+    Self * m_Metric;
+  };
+
+  SPCMetricMultiThreaderParameterType m_SPCMetricThreaderParameters;
+
+  /** The threads do not store the intensities of the samples. Instead, they
+   * accumulate the mean and the scatter matrix of their own samples. */
+  struct SPCMetricGetSamplesPerThreadStruct
+  {
+    SizeValueType                      st_NumberOfPixelsCounted;
+    vnl_vector< RealType >             st_Mean;
+    MatrixType                         st_Scatter;
+    std::vector< FixedImagePointType > st_ApprovedSamples;
+  };
+
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, SPCMetricGetSamplesPerThreadStruct,
+    PaddedSPCMetricGetSamplesPerThreadStruct );
+
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT,
+    PaddedSPCMetricGetSamplesPerThreadStruct,
+    AlignedSPCMetricGetSamplesPerThreadStruct );
+
+  mutable AlignedSPCMetricGetSamplesPerThreadStruct * m_SPCMetricGetSamplesPerThreadVariables;
+  mutable ThreadIdType                                m_SPCMetricGetSamplesPerThreadVariablesSize;
+
+  /** Get the samples and compute the derivatives for each thread. */
+  inline void ThreadedGetSamples( ThreadIdType threadID );
+
+  inline void ThreadedComputeDerivative( ThreadIdType threadID );
+
+  /** Gather the values and derivatives from all threads. */
+  inline void AfterThreadedGetSamples( MeasureType & value ) const;
+
+  inline void AfterThreadedComputeDerivative( DerivativeType & derivative ) const;
+
+  /** Helper functions to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE GetSamplesThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeDerivativeThreaderCallback( void * arg );
+
+  void LaunchGetSamplesThreaderCallback( void ) const;
+
+  void LaunchComputeDerivativeThreaderCallback( void ) const;
+
+  /** Initialize some multi-threading related parameters. */
+  virtual void InitializeThreadingParameters( void ) const;
+
+  /** Subtract the mean over the last dimension from the derivative. */
+  void SubtractMeanFromDerivative( DerivativeType & derivative ) const;
+
 private:
 
   SumOfPairwiseCorrelationCoefficientsMetric( const Self & ); // purposely not implemented
@@ -179,6 +241,15 @@ private:
   /** Bool to indicate if the transform used is a stacktransform. Set by elx files. */
   bool m_TransformIsStackTransform;
 
+  /** Quantities of the multi-threaded derivative computation: the mean
+   * intensities, K S, the diagonal of S, and the coefficients of the
+   * derivative of S. */
+  mutable vnl_vector< RealType >            m_Mean;
+  mutable DerivativeMatrixType              m_KS;
+  mutable vnl_vector< DerivativeValueType > m_S;
+  mutable vnl_vector< DerivativeValueType > m_dSdmuCoefficients;
+  mutable DerivativeValueType               m_DerivativeNormalization;
+
 };
 
 } // end namespace itk
@@ -40,9 +40,30 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( false );
   this->SetUseMovingImageLimiter( false );
+
+  /** The threads only touch the support regions of their samples. */
+  this->m_SupportsSparseDerivativeAccumulation = true;
+
+  // Multi-threading structs
+  this->m_SPCMetricGetSamplesPerThreadVariables     = NULL;
+  this->m_SPCMetricGetSamplesPerThreadVariablesSize = 0;
+  this->m_SPCMetricThreaderParameters.m_Metric      = this;
+
 } // end constructor
 
 
+/**
+ * ******************* Destructor *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::~SumOfPairwiseCorrelationCoefficientsMetric()
+{
+  delete[] this->m_SPCMetricGetSamplesPerThreadVariables;
+} // end Destructor
+
+
 /**
  * ******************* Initialize *******************
  */
@@ -70,6 +91,36 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 } // end PrintSelf()
 
 
+/**
+ * ********************* InitializeThreadingParameters ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::InitializeThreadingParameters( void ) const
+{
+  /** Initialize the per-thread derivatives of the superclass. */
+  Superclass::InitializeThreadingParameters();
+
+  /** Only resize the array of structs when needed. */
+  if( this->m_SPCMetricGetSamplesPerThreadVariablesSize != this->m_NumberOfThreads )
+  {
+    delete[] this->m_SPCMetricGetSamplesPerThreadVariables;
+    this->m_SPCMetricGetSamplesPerThreadVariables
+      = new AlignedSPCMetricGetSamplesPerThreadStruct[ this->m_NumberOfThreads ];
+    this->m_SPCMetricGetSamplesPerThreadVariablesSize = this->m_NumberOfThreads;
+  }
+
+  /** Some initialization. */
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+  }
+
+} // end InitializeThreadingParameters()
+
+
 /**
  * ******************* SampleRandom *******************
  */
@@ -106,6 +157,86 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 } // end SampleRandom()
 
 
+/**
+ * ******************* SubtractMeanFromDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::SubtractMeanFromDerivative( DerivativeType & derivative ) const
+{
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  if( !this->m_TransformIsStackTransform )
+  {
+    /** Update derivative per dimension.
+     * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
+     * per dimension xyz.
+     */
+    const unsigned int lastDimGridSize = this->m_GridSize[ lastDim ];
+    const unsigned int numParametersPerDimension
+      = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
+    const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
+    DerivativeType     mean( numControlPointsPerDimension );
+    for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
+    {
+      /** Compute mean per dimension. */
+      mean.Fill( 0.0 );
+      const unsigned int starti = numParametersPerDimension * d;
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        mean[ index ] += derivative[ i ];
+      }
+      mean /= static_cast< double >( lastDimGridSize );
+
+      /** Update derivative for every control point per dimension. */
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        derivative[ i ] -= mean[ index ];
+      }
+    }
+  }
+  else
+  {
+    /** Update derivative per dimension.
+     * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
+     * the number the time point index.
+     */
+    const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / G;
+    DerivativeType     mean( numParametersPerLastDimension );
+    mean.Fill( 0.0 );
+
+    /** Compute mean per control point. */
+    for( unsigned int t = 0; t < G; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        mean[ index ] += derivative[ c ];
+      }
+    }
+    mean /= static_cast< double >( G );
+
+    /** Update derivative per control point. */
+    for( unsigned int t = 0; t < G; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        derivative[ c ] -= mean[ index ];
+      }
+    }
+  }
+} // end SubtractMeanFromDerivative()
+
+
 /**
  * *************** EvaluateTransformJacobianInnerProduct ****************
  */
@@ -139,13 +270,13 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValue *******************
+ * ******************* GetValueSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 typename SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >::MeasureType
 SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
-::GetValue( const TransformParametersType & parameters ) const
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
 {
   itkDebugMacro( "GetValue( " << parameters << " ) " );
 
@@ -284,7 +415,7 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   /** Return the measure value. */
   return measure;
 
-} // end GetValue()
+} // end GetValueSingleThreaded()
 
 
 /**
@@ -310,13 +441,13 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValueAndDerivative *******************
+ * ******************* GetValueAndDerivativeSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
-::GetValueAndDerivative( const TransformParametersType & parameters,
+::GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
   itkDebugMacro( "GetValueAndDerivative( " << parameters << " ) " );
@@ -543,76 +674,492 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   /** Subtract mean from derivative elements. */
   if( this->m_SubtractMean )
   {
-    if( !this->m_TransformIsStackTransform )
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+  /** Return the measure value. */
+  value = measure;
+
+} // end GetValueAndDerivativeSingleThreaded()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >::MeasureType
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading GetSamples */
+  this->LaunchGetSamplesThreaderCallback();
+
+  /** Get the metric value contributions from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetSamples( value );
+
+  return value;
+
+} // end GetValue()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueAndDerivativeSingleThreaded(
+      parameters, value, derivative );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading GetSamples */
+  this->LaunchGetSamplesThreaderCallback();
+
+  /** Get the metric value contributions from all threads. */
+  this->AfterThreadedGetSamples( value );
+
+  /** Launch multi-threading ComputeDerivative */
+  this->LaunchComputeDerivativeThreaderCallback();
+
+  /** Sum derivative contributions from all threads */
+  this->AfterThreadedComputeDerivative( derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* ThreadedGetSamples *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::ThreadedGetSamples( ThreadIdType threadId )
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( this->m_NumberOfThreads ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create iterator over the sample container. */
+  typename ImageSampleContainerType::ConstIterator threader_fiter;
+  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
+
+  threader_fbegin += (int)pos_begin;
+  threader_fend   += (int)pos_end;
+
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** The running mean and scatter matrix of the intensities of this thread. */
+  std::vector< FixedImagePointType > SamplesOK;
+  vnl_vector< RealType >             values( G );
+  vnl_vector< RealType >             delta( G );
+  vnl_vector< RealType >             mean( G, NumericTraits< RealType >::Zero );
+  MatrixType                         scatter( G, G, NumericTraits< RealType >::Zero );
+
+  unsigned int pixelIndex = 0;
+  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  {
+    /** Read fixed coordinates. */
+    FixedImagePointType fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
+
+    /** Transform sampled point to voxel coordinates. */
+    FixedImageContinuousIndexType voxelCoord;
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+    unsigned int numSamplesOk = 0;
+
+    /** Loop over t */
+    for( unsigned int d = 0; d < G; ++d )
     {
-      /** Update derivative per dimension.
-       * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
-       * per dimension xyz.
-       */
-      const unsigned int lastDimGridSize = this->m_GridSize[ lastDim ];
-      const unsigned int numParametersPerDimension
-        = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
-      const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
-      DerivativeType     mean( numControlPointsPerDimension );
-      for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
-      {
-        /** Compute mean per dimension. */
-        mean.Fill( 0.0 );
-        const unsigned int starti = numParametersPerDimension * d;
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
-        {
-          const unsigned int index = i % numControlPointsPerDimension;
-          mean[ index ] += derivative[ i ];
-        }
-        mean /= static_cast< double >( lastDimGridSize );
+      /** Initialize some variables. */
+      RealType             movingImageValue;
+      MovingImagePointType mappedPoint;
 
-        /** Update derivative for every control point per dimension. */
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
-        {
-          const unsigned int index = i % numControlPointsPerDimension;
-          derivative[ i ] -= mean[ index ];
-        }
+      /** Set fixed point's last dimension to lastDimPosition. */
+      voxelCoord[ lastDim ] = d;
+
+      /** Transform sampled point back to world coordinates. */
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
+
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint );
       }
-    }
-    else
-    {
-      /** Update derivative per dimension.
-       * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
-       * the number the time point index.
-       */
-      const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / G;
-      DerivativeType     mean( numParametersPerLastDimension );
-      mean.Fill( 0.0 );
 
-      /** Compute mean per control point. */
-      for( unsigned int t = 0; t < G; ++t )
+      if( sampleOk )
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
-        {
-          const unsigned int index = c % numParametersPerLastDimension;
-          mean[ index ] += derivative[ c ];
-        }
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, 0 );
       }
-      mean /= static_cast< double >( G );
 
-      /** Update derivative per control point. */
-      for( unsigned int t = 0; t < G; ++t )
+      if( sampleOk )
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+        numSamplesOk++;
+        values[ d ] = movingImageValue;
+      } // end if sampleOk
+
+    } // end loop over t
+
+    if( numSamplesOk == G )
+    {
+      SamplesOK.push_back( fixedPoint );
+      pixelIndex++;
+
+      /** Welford update of the mean and the upper triangle of the scatter matrix. */
+      delta = values - mean;
+      mean += delta / static_cast< RealType >( pixelIndex );
+      for( unsigned int i = 0; i < G; ++i )
+      {
+        for( unsigned int j = i; j < G; ++j )
         {
-          const unsigned int index = c % numParametersPerLastDimension;
-          derivative[ c ] -= mean[ index ];
+          scatter( i, j ) += delta[ i ] * ( values[ j ] - mean[ j ] );
         }
       }
     }
+
+  } /** end first loop over image sample container */
+
+  /** Copy the upper triangle of the scatter matrix to the lower triangle. */
+  for( unsigned int i = 1; i < G; ++i )
+  {
+    for( unsigned int j = 0; j < i; ++j )
+    {
+      scatter( i, j ) = scatter( j, i );
+    }
   }
 
-  /** Return the measure value. */
-  value = measure;
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_SPCMetricGetSamplesPerThreadVariables[ threadId ].st_NumberOfPixelsCounted = pixelIndex;
+  this->m_SPCMetricGetSamplesPerThreadVariables[ threadId ].st_Mean                  = mean;
+  this->m_SPCMetricGetSamplesPerThreadVariables[ threadId ].st_Scatter               = scatter;
+  this->m_SPCMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples       = SamplesOK;
 
-} // end GetValueAndDerivative()
+} // end ThreadedGetSamples()
+
+
+/**
+ * ******************* AfterThreadedGetSamples *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetSamples( MeasureType & value ) const
+{
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = this->m_SPCMetricGetSamplesPerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** Merge the means and scatter matrices of the threads. The scatter of
+   * each thread is taken around its own mean, which is corrected for here. */
+  const RealType numberOfPixels = static_cast< RealType >( this->m_NumberOfPixelsCounted );
+  this->m_Mean.set_size( G );
+  this->m_Mean.fill( NumericTraits< RealType >::Zero );
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    const RealType n = static_cast< RealType >(
+      this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted );
+    this->m_Mean += this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_Mean * ( n / numberOfPixels );
+  }
+
+  /** Compute covariance matrix C */
+  MatrixType C( G, G, NumericTraits< RealType >::Zero );
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    const SizeValueType n = this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_NumberOfPixelsCounted;
+    if( n == 0 )
+    {
+      continue;
+    }
+    const vnl_vector< RealType > meanDiff
+      = this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_Mean - this->m_Mean;
+    C += this->m_SPCMetricGetSamplesPerThreadVariables[ i ].st_Scatter;
+    C += outer_product( meanDiff, meanDiff ) * static_cast< RealType >( n );
+  }
+  C /= static_cast< RealType >( numberOfPixels - 1.0 );
+
+  vnl_diag_matrix< RealType > S( G );
+  S.fill( NumericTraits< RealType >::Zero );
+  for( unsigned int j = 0; j < G; j++ )
+  {
+    S( j, j ) = 1.0 / sqrt( C( j, j ) );
+  }
+
+  DerivativeMatrixType K( S * C * S );
+  const RealType       froK = K.fro_norm();
+
+  value = RealType( 1.0 - ( froK / RealType( G ) ) );
+
+  /** Sub components of the metric derivative. The column of K (Amm S)^T of
+   * a sample equals K S times its centered intensities, and the diagonal
+   * of K (Amm S)^T Amm equals (N - 1) times that of K S C. */
+  this->m_KS = K * S;
+  const DerivativeMatrixType KSC( this->m_KS * C );
+  this->m_S.set_size( G );
+  this->m_dSdmuCoefficients.set_size( G );
+  for( unsigned int d = 0; d < G; d++ )
+  {
+    const double S_qub = S( d, d ) * S( d, d ) * S( d, d );
+    this->m_S[ d ]                 = S( d, d );
+    this->m_dSdmuCoefficients[ d ] = -S_qub * KSC( d, d );
+  }
+
+  /** The derivative is normalized by -2 / ( ( N - 1 ) |K| G ). */
+  this->m_DerivativeNormalization = -( numberOfPixels - 1.0 ) * froK * RealType( G ) / 2.0;
+
+} // end AfterThreadedGetSamples()
+
+
+/**
+ * **************** GetSamplesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetSamplesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  SPCMetricMultiThreaderParameterType * temp
+    = static_cast< SPCMetricMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedGetSamples( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end GetSamplesThreaderCallback()
+
+
+/**
+ * *********************** LaunchGetSamplesThreaderCallback***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::LaunchGetSamplesThreaderCallback( void ) const
+{
+  /** Launch. */
+  this->ExecuteThreaderCallback( this->GetSamplesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >(
+      &this->m_SPCMetricThreaderParameters ) ) );
+
+} // end LaunchGetSamplesThreaderCallback()
+
+
+/**
+ * ******************* ThreadedComputeDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::ThreadedComputeDerivative( ThreadIdType threadId )
+{
+  /** Get a handle to the pre-allocated derivative for the current thread.
+   * It is reset by AccumulateDerivativesThreaderCallback(). */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** Initialize some variables. */
+  RealType             movingImageValue;
+  MovingImagePointType mappedPoint;
+
+  TransformJacobianType      jacobian;
+  DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  NonZeroJacobianIndicesType nzjis( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+
+  /** The centered intensities, moving image derivatives and points of one
+   * sample, for all t. The intensities are recomputed here, instead of
+   * being stored for all samples in ThreadedGetSamples(). */
+  vnl_vector< RealType >                   centered( G );
+  vnl_vector< DerivativeValueType >        KAtZscore( G );
+  std::vector< MovingImageDerivativeType > movingImageDerivatives( G );
+  std::vector< FixedImagePointType >       fixedPoints( G );
+
+  const std::vector< FixedImagePointType > & approvedSamples
+    = this->m_SPCMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples;
+
+  /** Second loop over fixed image samples. */
+  for( unsigned int pixelIndex = 0; pixelIndex < approvedSamples.size(); ++pixelIndex )
+  {
+    /** Read fixed coordinates. */
+    FixedImagePointType fixedPoint = approvedSamples[ pixelIndex ];
+
+    /** Transform sampled point to voxel coordinates. */
+    FixedImageContinuousIndexType voxelCoord;
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+    for( unsigned int d = 0; d < G; ++d )
+    {
+      /** Set fixed point's last dimension to lastDimPosition. */
+      voxelCoord[ lastDim ] = d;
+
+      /** Transform sampled point back to world coordinates. */
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+      this->TransformPoint( fixedPoints[ d ], mappedPoint );
+
+      this->EvaluateMovingImageValueAndDerivative(
+        mappedPoint, movingImageValue, &movingImageDerivatives[ d ] );
+      centered[ d ] = movingImageValue - this->m_Mean[ d ];
+    }
+
+    /** The column of K (Amm S)^T of this sample. */
+    KAtZscore = this->m_KS * centered;
+
+    for( unsigned int d = 0; d < G; ++d )
+    {
+      /** Get the TransformJacobian dT/dmu */
+      this->EvaluateTransformJacobian( fixedPoints[ d ], jacobian, nzjis );
+
+      /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+      this->EvaluateTransformJacobianInnerProduct(
+        jacobian, movingImageDerivatives[ d ], imageJacobian );
+
+      /** The factor of dM/dmu does not depend on the parameter. */
+      const DerivativeValueType factor = KAtZscore[ d ] * this->m_S[ d ]
+        + this->m_dSdmuCoefficients[ d ] * centered[ d ];
+
+      /** build metric derivative components */
+      for( unsigned int p = 0; p < nzjis.size(); ++p )
+      {
+        derivative[ nzjis[ p ] ] += factor * imageJacobian[ p ];
+      } //end loop over non-zero jacobian indices
+
+      this->MarkTouchedDerivativeBlocks( threadId, nzjis );
+
+    } // end loop over t
+
+  } // end second for loop over sample container
+
+} // end ThreadedComputeDerivative()
+
+
+/**
+ * ******************* AfterThreadedComputeDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::AfterThreadedComputeDerivative( DerivativeType & derivative ) const
+{
+  /** Accumulate and normalize the derivatives multi-threadedly,
+   * which also resets them. */
+  derivative.SetSize( this->GetNumberOfParameters() );
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor = this->m_DerivativeNormalization;
+
+  this->ExecuteThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+
+  /** Subtract mean from derivative elements. */
+  if( this->m_SubtractMean )
+  {
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+} // end AfterThreadedComputeDerivative()
+
+
+/**
+ * **************** ComputeDerivativeThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::ComputeDerivativeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  SPCMetricMultiThreaderParameterType * temp
+    = static_cast< SPCMetricMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputeDerivative( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeDerivativeThreaderCallback()
+
+
+/**
+ * ************** LaunchComputeDerivativeThreaderCallback **********
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::LaunchComputeDerivativeThreaderCallback( void ) const
+{
+  /** Launch. */
+  this->ExecuteThreaderCallback( this->ComputeDerivativeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >(
+      &this->m_SPCMetricThreaderParameters ) ) );
+
+} // end LaunchComputeDerivativeThreaderCallback()
 
 
 } // end namespace itk
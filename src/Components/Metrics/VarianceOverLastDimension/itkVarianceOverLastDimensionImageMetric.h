@@ -43,6 +43,8 @@ namespace itk
  * \li Image derivatives are computed using either the B-spline interpolator's implementation
  * or by nearest neighbor interpolation of a precomputed central difference image.
  * \li A minimum number of samples that should map within the moving image (mask) can be specified.
+ * \li The samples are divided over the threads, each thread accumulating the
+ * variances and derivatives of its own samples.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
@@ -137,6 +139,8 @@ public:
     MovingImageType::ImageDimension );
 
   /** Get the value for single valued optimizers. */
+  virtual MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
   virtual MeasureType GetValue( const TransformParametersType & parameters ) const;
 
   /** Get the derivatives of the match measure. */
@@ -144,6 +148,9 @@ public:
     DerivativeType & derivative ) const;
 
   /** Get value and derivatives for multiple valued optimizers. */
+  void GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
+    MeasureType & Value, DerivativeType & Derivative ) const;
+
   virtual void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const;
 
@@ -182,6 +189,19 @@ protected:
     const MovingImageDerivativeType & movingImageDerivative,
     DerivativeType & imageJacobian ) const;
 
+  /** Get value for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID );
+
+  /** Gather the values from all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const;
+
+  /** Get value and derivatives for each thread. */
+  inline void ThreadedGetValueAndDerivative( ThreadIdType threadID );
+
+  /** Gather the values and derivatives from all threads. */
+  inline void AfterThreadedGetValueAndDerivative(
+    MeasureType & value, DerivativeType & derivative ) const;
+
 private:
 
   VarianceOverLastDimensionImageMetric( const Self & ); // purposely not implemented
@@ -190,6 +210,23 @@ private:
   /** Sample n random numbers from 0..m and add them to the vector. */
   void SampleRandom( const int n, const int m, std::vector< int > & numbers ) const;
 
+  /** Fill m_LastDimPositions with the last dimension positions of all samples.
+   * The random positions are drawn before the threads are launched, in the
+   * same order as in the single-threaded code, because the random generator
+   * is not thread-safe. */
+  void InitializeLastDimPositions( void ) const;
+
+  /** Get the last dimension positions of sample i. */
+  const int * GetLastDimPositions( const unsigned long i ) const
+  {
+    return &( this->m_LastDimPositions[ this->m_SampleLastDimensionRandomly
+           ? i * this->m_NumberOfLastDimPositions : 0 ] );
+  }
+
+
+  /** Subtract the mean over the last dimension from the derivative. */
+  void SubtractMeanFromDerivative( DerivativeType & derivative ) const;
+
   /** Variables to control random sampling in last dimension. */
   bool         m_SampleLastDimensionRandomly;
   unsigned int m_NumSamplesLastDimension;
@@ -208,6 +245,10 @@ private:
   /** Bool to indicate if the transform used is a stacktransform. Set by elx files. */
   bool m_TransformIsStackTransform;
 
+  /** The last dimension positions of the samples, for the multi-threaded code. */
+  mutable std::vector< int > m_LastDimPositions;
+  mutable unsigned int       m_NumberOfLastDimPositions;
+
 };
 
 } // end namespace itk
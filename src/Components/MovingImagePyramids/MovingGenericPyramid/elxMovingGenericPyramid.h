@@ -58,9 +58,16 @@ namespace elastix
  *    If ImagePyramidSmoothingSchedule is specified, that schedule is used for both moving and moving image pyramid.
  * \parameter ImagePyramidSmoothingSchedule: smoothing schedule for both pyramids
  * \parameter ComputePyramidImagesPerResolution: Flag to specify if all resolution levels are computed
- *    at once, or per resolution. Latter saves memory.\n
+ *    at once, or per resolution. Latter saves memory: the images of a resolution are
+ *    computed at the start of that resolution and released when it is finished.\n
  *    example: <tt>(ComputePyramidImagesPerResolution "true")</tt>\n
  *    Default false.
+ * \parameter ComputePyramidImagesInBackground: Flag to specify if, when the images are
+ *    computed per resolution, the images of the next resolution are computed by a background
+ *    thread while the current resolution is running. This removes the wait between the
+ *    resolutions, at the cost of the memory of one more level.\n
+ *    example: <tt>(ComputePyramidImagesInBackground "true")</tt>\n
+ *    Default false.
  * \parameter ImagePyramidUseShrinkImageFilter: Flag to specify if the ShrinkingImageFilter is used
  *    for rescaling the image, or the ResampleImageFilter. Shrinker is faster.\n
  *    example: <tt>(ImagePyramidUseShrinkImageFilter "true")</tt>\n
@@ -129,6 +136,9 @@ public:
   /** Update the current resolution level. */
   virtual void BeforeEachResolution( void );
 
+  /** Release the images of the current resolution level, if they are computed per resolution. */
+  virtual void AfterEachResolution( void );
+
 protected:
 
   /** The constructor. */
@@ -24,6 +24,7 @@
 // GPU includes
 #include "itkGPUImageFactory.h"
 #include "itkOpenCLLogger.h"
+#include "itkOpenCLProfilingReport.h"
 
 // GPU factory includes
 #include "itkGPURecursiveGaussianImageFilterFactory.h"
@@ -156,10 +157,15 @@ OpenCLMovingGenericPyramid< TElastix >
     return;
   }
 
+  // Tag the uploads and kernels of this pyramid in the profiling report
+  itk::OpenCLProfilingReport::Pointer report = itk::OpenCLProfilingReport::GetInstance();
+  report->SetStage( "OpenCLMovingGenericPyramid" );
+
   // First execute BeforeGenerateData to configure GPU pyramid
   this->BeforeGenerateData();
   if( !this->m_GPUPyramidReady )
   {
+    report->SetStage( "" );
     Superclass1::GenerateData();
     return;
   }
@@ -198,6 +204,7 @@ OpenCLMovingGenericPyramid< TElastix >
 
   // Unregister factories
   this->UnregisterFactories();
+  report->SetStage( "" );
 
   if( computedUsingOpenCL )
   {
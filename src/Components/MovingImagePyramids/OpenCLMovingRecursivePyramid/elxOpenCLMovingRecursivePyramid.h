@@ -0,0 +1,104 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLMovingRecursivePyramid_h
+#define __elxOpenCLMovingRecursivePyramid_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxMovingRecursivePyramid.h"
+#include "elxOpenCLImagePyramidBase.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLMovingRecursivePyramid
+ * \brief The MovingRecursivePyramid, computed with OpenCL.
+ *
+ * The recursive pyramid smooths with a discrete Gaussian that has no GPU version,
+ * so the smoothing runs on the CPU, and the shrinking and resampling on the GPU.
+ * Without OpenCL, for 2D images, or when the GPU fails, the MovingRecursivePyramid is
+ * computed on the CPU.
+ *
+ * The parameters used in this class are:
+ * \parameter MovingImagePyramid: Select this pyramid as follows:\n
+ *    <tt>(MovingImagePyramid "OpenCLMovingRecursiveImagePyramid")</tt>
+ * \parameter OpenCLMovingRecursiveImagePyramidUseOpenCL: Enable the OpenCL pyramid as follows:\n
+ *    <tt>(OpenCLMovingRecursiveImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa MovingRecursivePyramid, OpenCLImagePyramidBase
+ * \ingroup ImagePyramids
+ */
+
+template< class TElastix >
+class OpenCLMovingRecursivePyramid :
+  public OpenCLImagePyramidBase<
+  MovingRecursivePyramid< TElastix >,
+  itk::RecursiveMultiResolutionPyramidImageFilter<
+  itk::GPUImage< typename MovingRecursivePyramid< TElastix >::InputImageType::PixelType,
+  MovingRecursivePyramid< TElastix >::ImageDimension >,
+  itk::GPUImage< typename MovingRecursivePyramid< TElastix >::OutputImageType::PixelType,
+  MovingRecursivePyramid< TElastix >::ImageDimension > > >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLMovingRecursivePyramid Self;
+  typedef OpenCLImagePyramidBase<
+    MovingRecursivePyramid< TElastix >,
+    itk::RecursiveMultiResolutionPyramidImageFilter<
+    itk::GPUImage< typename MovingRecursivePyramid< TElastix >::InputImageType::PixelType,
+    MovingRecursivePyramid< TElastix >::ImageDimension >,
+    itk::GPUImage< typename MovingRecursivePyramid< TElastix >::OutputImageType::PixelType,
+    MovingRecursivePyramid< TElastix >::ImageDimension > > > Superclass;
+  typedef typename Superclass::Superclass1 Superclass1;
+  typedef typename Superclass::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >        Pointer;
+  typedef itk::SmartPointer< const Self >  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLMovingRecursivePyramid, OpenCLImagePyramidBase );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific pyramid. \n
+   * example: <tt>(MovingImagePyramid "OpenCLMovingRecursiveImagePyramid")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLMovingRecursiveImagePyramid" );
+
+protected:
+
+  /** The constructor. */
+  OpenCLMovingRecursivePyramid() {}
+  /** The destructor. */
+  virtual ~OpenCLMovingRecursivePyramid() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLMovingRecursivePyramid( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLMovingRecursivePyramid_h
@@ -0,0 +1,103 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLMovingShrinkingPyramid_h
+#define __elxOpenCLMovingShrinkingPyramid_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxMovingShrinkingPyramid.h"
+#include "elxOpenCLImagePyramidBase.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLMovingShrinkingPyramid
+ * \brief The MovingShrinkingPyramid, computed with OpenCL.
+ *
+ * The shrinking of all levels runs on the GPU.
+ * Without OpenCL, for 2D images, or when the GPU fails, the MovingShrinkingPyramid is
+ * computed on the CPU.
+ *
+ * The parameters used in this class are:
+ * \parameter MovingImagePyramid: Select this pyramid as follows:\n
+ *    <tt>(MovingImagePyramid "OpenCLMovingShrinkingImagePyramid")</tt>
+ * \parameter OpenCLMovingShrinkingImagePyramidUseOpenCL: Enable the OpenCL pyramid as follows:\n
+ *    <tt>(OpenCLMovingShrinkingImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa MovingShrinkingPyramid, OpenCLImagePyramidBase
+ * \ingroup ImagePyramids
+ */
+
+template< class TElastix >
+class OpenCLMovingShrinkingPyramid :
+  public OpenCLImagePyramidBase<
+  MovingShrinkingPyramid< TElastix >,
+  itk::MultiResolutionShrinkPyramidImageFilter<
+  itk::GPUImage< typename MovingShrinkingPyramid< TElastix >::InputImageType::PixelType,
+  MovingShrinkingPyramid< TElastix >::ImageDimension >,
+  itk::GPUImage< typename MovingShrinkingPyramid< TElastix >::OutputImageType::PixelType,
+  MovingShrinkingPyramid< TElastix >::ImageDimension > > >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLMovingShrinkingPyramid Self;
+  typedef OpenCLImagePyramidBase<
+    MovingShrinkingPyramid< TElastix >,
+    itk::MultiResolutionShrinkPyramidImageFilter<
+    itk::GPUImage< typename MovingShrinkingPyramid< TElastix >::InputImageType::PixelType,
+    MovingShrinkingPyramid< TElastix >::ImageDimension >,
+    itk::GPUImage< typename MovingShrinkingPyramid< TElastix >::OutputImageType::PixelType,
+    MovingShrinkingPyramid< TElastix >::ImageDimension > > > Superclass;
+  typedef typename Superclass::Superclass1 Superclass1;
+  typedef typename Superclass::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >        Pointer;
+  typedef itk::SmartPointer< const Self >  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLMovingShrinkingPyramid, OpenCLImagePyramidBase );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific pyramid. \n
+   * example: <tt>(MovingImagePyramid "OpenCLMovingShrinkingImagePyramid")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLMovingShrinkingImagePyramid" );
+
+protected:
+
+  /** The constructor. */
+  OpenCLMovingShrinkingPyramid() {}
+  /** The destructor. */
+  virtual ~OpenCLMovingShrinkingPyramid() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLMovingShrinkingPyramid( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLMovingShrinkingPyramid_h
@@ -0,0 +1,103 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLMovingSmoothingPyramid_h
+#define __elxOpenCLMovingSmoothingPyramid_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxMovingSmoothingPyramid.h"
+#include "elxOpenCLImagePyramidBase.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLMovingSmoothingPyramid
+ * \brief The MovingSmoothingPyramid, computed with OpenCL.
+ *
+ * The Gaussian smoothing of all levels runs on the GPU.
+ * Without OpenCL, for 2D images, or when the GPU fails, the MovingSmoothingPyramid is
+ * computed on the CPU.
+ *
+ * The parameters used in this class are:
+ * \parameter MovingImagePyramid: Select this pyramid as follows:\n
+ *    <tt>(MovingImagePyramid "OpenCLMovingSmoothingImagePyramid")</tt>
+ * \parameter OpenCLMovingSmoothingImagePyramidUseOpenCL: Enable the OpenCL pyramid as follows:\n
+ *    <tt>(OpenCLMovingSmoothingImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa MovingSmoothingPyramid, OpenCLImagePyramidBase
+ * \ingroup ImagePyramids
+ */
+
+template< class TElastix >
+class OpenCLMovingSmoothingPyramid :
+  public OpenCLImagePyramidBase<
+  MovingSmoothingPyramid< TElastix >,
+  itk::MultiResolutionGaussianSmoothingPyramidImageFilter<
+  itk::GPUImage< typename MovingSmoothingPyramid< TElastix >::InputImageType::PixelType,
+  MovingSmoothingPyramid< TElastix >::ImageDimension >,
+  itk::GPUImage< typename MovingSmoothingPyramid< TElastix >::OutputImageType::PixelType,
+  MovingSmoothingPyramid< TElastix >::ImageDimension > > >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLMovingSmoothingPyramid Self;
+  typedef OpenCLImagePyramidBase<
+    MovingSmoothingPyramid< TElastix >,
+    itk::MultiResolutionGaussianSmoothingPyramidImageFilter<
+    itk::GPUImage< typename MovingSmoothingPyramid< TElastix >::InputImageType::PixelType,
+    MovingSmoothingPyramid< TElastix >::ImageDimension >,
+    itk::GPUImage< typename MovingSmoothingPyramid< TElastix >::OutputImageType::PixelType,
+    MovingSmoothingPyramid< TElastix >::ImageDimension > > > Superclass;
+  typedef typename Superclass::Superclass1 Superclass1;
+  typedef typename Superclass::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >        Pointer;
+  typedef itk::SmartPointer< const Self >  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLMovingSmoothingPyramid, OpenCLImagePyramidBase );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific pyramid. \n
+   * example: <tt>(MovingImagePyramid "OpenCLMovingSmoothingImagePyramid")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLMovingSmoothingImagePyramid" );
+
+protected:
+
+  /** The constructor. */
+  OpenCLMovingSmoothingPyramid() {}
+  /** The destructor. */
+  virtual ~OpenCLMovingSmoothingPyramid() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLMovingSmoothingPyramid( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLMovingSmoothingPyramid_h
@@ -22,6 +22,7 @@
 #include "itkAdaptiveStochasticGradientDescentOptimizer.h"
 #include "itkComputeJacobianTerms.h"
 #include "itkComputeDisplacementDistribution.h"
+#include "itkComputeActiveParameters.h"
 #include "elxProgressCommand.h"
 #include "itkAdvancedTransform.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
@@ -157,6 +158,13 @@ namespace elastix
  *   number of transform parameters. This is a rather crude rule of thumb,
  *   which seems to work in practice. In principle, the more the better, but the slower.
  *   The parameter has only influence when AutomaticParameterEstimation is used.
+ * \parameter UseSparseBandCovariance: Whether the multi-threaded estimation of the
+ *   covariance matrix stores the band rows of each thread only for the parameters
+ *   touched by that thread. This saves memory for transforms with many parameters.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(UseSparseBandCovariance "true")</tt>\n
+ *   Default value: false.
+ *   The parameter has only influence when AutomaticParameterEstimation is used.
  * \parameter NumberOfSamplesForExactGradient: The number of image samples used to compute
  *   the 'exact' gradient. The samples are chosen on a uniform grid.
  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
@@ -180,6 +188,65 @@ namespace elastix
  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
  *   example: <tt>(NoiseCompensation "true")</tt>\n
  *   Default/recommended: true.
+ * \parameter UseAutomaticParameterEstimationCache: Whether the results of the automatic
+ *   parameter estimation are stored in a cache file, and read from it by later jobs with
+ *   the same settings, which then skip the estimation. The key of an entry is the
+ *   resolution, the estimation method and its settings, the geometry of the fixed image,
+ *   the transform, its fixed parameters (such as the B-spline grid) and scales, and the
+ *   metrics and their samplers. The moving image and the initial transform parameters
+ *   are not part of the key: the cache is meant for a series of registrations that only
+ *   differ in those, such as the images of a cohort registered to one atlas.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(UseAutomaticParameterEstimationCache "true")</tt>\n
+ *   Default: false.
+ * \parameter AutomaticParameterEstimationCacheDirectory: The directory of the cache
+ *   files, which may be shared by several jobs.\n
+ *   example: <tt>(AutomaticParameterEstimationCacheDirectory "/data/cohort/asgdcache")</tt>\n
+ *   Default: the output directory.
+ * \parameter UseActiveParameterSubset: Whether the position is only updated for the
+ *   parameters that can have a nonzero derivative, such as the B-spline coefficients whose
+ *   support overlaps the fixed image mask. The others are left out of the vector operations
+ *   of every iteration. Only has influence with a fixed image mask and a B-spline transform,
+ *   and only with metrics that sample inside the fixed image mask; do not use it with
+ *   metrics that use points outside the mask, such as CorrespondingPointsEuclideanDistanceMetric.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(UseActiveParameterSubset "true")</tt>\n
+ *   Default: false.
+ * \parameter ActiveParameterGradientFraction: With UseActiveParameterSubset, from the second
+ *   resolution on, only this fraction of the control points is optimized: those with the
+ *   largest magnitude of the metric gradient at the start of the resolution. The other
+ *   control points keep the smooth deformation of the coarser resolutions, so the grid is
+ *   in effect only refined where the images still disagree. The gradient is measured with
+ *   the samples of the image sampler. Should be in ( 0, 1 ].
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(ActiveParameterGradientFraction 0.3)</tt>\n
+ *   Default: 1.0, all control points.
+ * \parameter AdaptiveNumberOfSamples: Whether the number of samples of the random
+ *   image samplers is adapted during the optimization. The adaptive step size mechanism
+ *   already detects when the noise in the gradient dominates: two successive gradients
+ *   then point in opposite directions and the time \f$t_k\f$ increases. The number of
+ *   samples is multiplied by NumberOfSamplesGrowthFactor when \f$t_k\f$ increases,
+ *   and divided by it otherwise, so it settles where half of the steps oscillate.
+ *   When AutomaticParameterEstimation is used, the measured noise of the gradient
+ *   determines the initial number of samples: the number at which the expected noise
+ *   equals the gradient magnitude. Only has influence with UseAdaptiveStepSizes "true"
+ *   and NewSamplesEveryIteration "true".
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(AdaptiveNumberOfSamples "true")</tt>\n
+ *   Default: false.
+ * \parameter MinimumNumberOfSamples: The lower bound of the adapted number of samples.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(MinimumNumberOfSamples 500)</tt>\n
+ *   Default: a quarter of the NumberOfSpatialSamples of the sampler.
+ * \parameter MaximumNumberOfSamples: The upper bound of the adapted number of samples.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(MaximumNumberOfSamples 10000)</tt>\n
+ *   Default: four times the NumberOfSpatialSamples of the sampler.
+ * \parameter NumberOfSamplesGrowthFactor: The factor by which the number of samples
+ *   changes in each iteration. Should be larger than 1.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(NumberOfSamplesGrowthFactor 1.05)</tt>\n
+ *   Default: 1.05.
  *
  * \todo: this class contains a lot of functional code, which actually does not belong here.
  *
@@ -215,9 +282,11 @@ public:
   elxClassNameMacro( "AdaptiveStochasticGradientDescent" );
 
   /** Typedef's inherited from Superclass1. */
-  typedef Superclass1::CostFunctionType    CostFunctionType;
-  typedef Superclass1::CostFunctionPointer CostFunctionPointer;
-  typedef Superclass1::StopConditionType   StopConditionType;
+  typedef Superclass1::CostFunctionType          CostFunctionType;
+  typedef Superclass1::CostFunctionPointer       CostFunctionPointer;
+  typedef Superclass1::StopConditionType         StopConditionType;
+  typedef Superclass1::ActiveParameterRangeType  ActiveParameterRangeType;
+  typedef Superclass1::ActiveParameterRangesType ActiveParameterRangesType;
 
   /** Typedef's inherited from Superclass2. */
   typedef typename Superclass2::ElastixType          ElastixType;
@@ -259,6 +328,13 @@ public:
   /** Stop optimization and pass on exception. */
   virtual void MetricErrorResponse( itk::ExceptionObject & err );
 
+  /** The state for the resolution checkpoints: the settings of the finished
+   * resolutions, and the time and step size at the end of the last one.
+   */
+  virtual void GetResolutionCheckpointState( std::vector< double > & state ) const;
+
+  virtual void SetResolutionCheckpointState( const std::vector< double > & state );
+
   /** Set/Get whether automatic parameter estimation is desired.
    * If true, make sure to set the maximum step length.
    *
@@ -301,6 +377,8 @@ protected:
 
   typedef itk::ComputeDisplacementDistribution<
     FixedImageType, TransformType >                    ComputeDisplacementDistributionType;
+  typedef itk::ComputeActiveParameters<
+    FixedImageType, TransformType >                    ComputeActiveParametersType;
 
   /** Samplers: */
   typedef itk::ImageSamplerBase< FixedImageType >       ImageSamplerBaseType;
@@ -379,12 +457,31 @@ protected:
    */
   virtual void AutomaticParameterEstimationUsingDisplacementDistribution( void );
 
+  /** The key of the automatic parameter estimation in the cache: a single line
+   * with all settings that the estimates depend on, see
+   * UseAutomaticParameterEstimationCache.
+   */
+  virtual std::string GetParameterEstimationCacheKey( const std::string & method ) const;
+
+  /** Read the estimates of a key from the cache, and set them. Returns false
+   * if the cache has no entry with this key.
+   */
+  virtual bool ReadParameterEstimationCache( const std::string & key );
+
+  /** Store the current estimates under a key in the cache. */
+  virtual void WriteParameterEstimationCache( const std::string & key ) const;
+
+  /** The name of the cache file of a key. */
+  std::string GetParameterEstimationCacheFileName( const std::string & key ) const;
+
   /** Measure some derivatives, exact and approximated. Returns
    * the squared magnitude of the gradient and approximation error.
    * Needed for the automatic parameter estimation.
    * Gradients are measured at position mu_n, which are generated according to:
    * mu_n - mu_0 ~ N(0, perturbationSigma^2 I );
    * gg = g^T g, etc.
+   * Random samplers that support sample prefetching select their next sample
+   * set in the background while the exact gradient is computed.
    */
   virtual void SampleGradients( const ParametersType & mu0,
     double perturbationSigma, double & gg, double & ee );
@@ -400,6 +497,23 @@ protected:
    */
   virtual void AddRandomPerturbation( ParametersType & parameters, double sigma );
 
+  /** Set up the adaptive number of samples of the random samplers: the bounds,
+   * and the initial number, using the gradient noise measured by SampleGradients.
+   * Called by ResumeOptimization.
+   */
+  virtual void InitializeAdaptiveNumberOfSamples( void );
+
+  /** Grow or shrink the number of samples of the random samplers, depending on
+   * whether the last step increased the time. Called by AfterEachIteration,
+   * before new samples are selected.
+   */
+  virtual void UpdateAdaptiveNumberOfSamples( void );
+
+  /** Compute the active parameters from the fixed image masks of the
+   * metrics, and pass them to the optimizer. Called by ResumeOptimization.
+   */
+  virtual void InitializeActiveParameterSubset( void );
+
 private:
 
   AdaptiveStochasticGradientDescent( const Self & );  // purposely not implemented
@@ -417,11 +531,34 @@ private:
   /** Private variables for band size estimation of covariance matrix. */
   SizeValueType m_MaxBandCovSize;
   SizeValueType m_NumberOfBandStructureSamples;
+  bool          m_UseSparseBandCovariance;
 
   /** The flag of using noise compensation. */
   bool m_UseNoiseCompensation;
   bool m_OriginalButSigmoidToDefault;
 
+  /** Private variables for the active parameter subset. */
+  bool   m_UseActiveParameterSubset;
+  bool   m_ActiveParameterSubsetInitialized;
+  double m_ActiveParameterGradientFraction;
+
+  /** Private variables for the cache of the automatic parameter estimation. */
+  bool        m_UseParameterEstimationCache;
+  std::string m_ParameterEstimationCacheDirectory;
+
+  /** Private variables for the adaptive number of samples. */
+  bool                                         m_UseAdaptiveNumberOfSamples;
+  bool                                         m_AdaptiveNumberOfSamplesInitialized;
+  SizeValueType                                m_MinimumNumberOfSamples;
+  SizeValueType                                m_MaximumNumberOfSamples;
+  double                                       m_NumberOfSamplesGrowthFactor;
+  double                                       m_GradientNoiseRatio;
+  double                                       m_PreviousTime;
+  std::vector< ImageRandomSamplerBasePointer > m_AdaptiveSamplers;
+  std::vector< double >                        m_AdaptiveNumberOfSamples;
+  std::vector< SizeValueType >                 m_AdaptiveMinimumNumberOfSamples;
+  std::vector< SizeValueType >                 m_AdaptiveMaximumNumberOfSamples;
+
 };
 
 } // end namespace elastix
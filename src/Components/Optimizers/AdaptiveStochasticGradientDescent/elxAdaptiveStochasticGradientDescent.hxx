@@ -26,8 +26,12 @@
 #include <sstream>
 #include <algorithm>
 #include <utility>
+#include <fstream>
+#include <cstdio>
 #include "itkAdvancedImageToImageMetric.h"
 #include "itkTimeProbe.h"
+#include "itkProcessId.h"
+#include <itksys/SystemTools.hxx>
 
 namespace elastix
 {
@@ -59,6 +63,20 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->m_UseNoiseCompensation        = true;
   this->m_OriginalButSigmoidToDefault = false;
 
+  this->m_UseParameterEstimationCache = false;
+
+  this->m_UseActiveParameterSubset         = false;
+  this->m_ActiveParameterSubsetInitialized = false;
+  this->m_ActiveParameterGradientFraction  = 1.0;
+
+  this->m_UseAdaptiveNumberOfSamples         = false;
+  this->m_AdaptiveNumberOfSamplesInitialized = false;
+  this->m_MinimumNumberOfSamples             = 0;
+  this->m_MaximumNumberOfSamples             = 0;
+  this->m_NumberOfSamplesGrowthFactor        = 1.05;
+  this->m_GradientNoiseRatio                 = -1.0;
+  this->m_PreviousTime                       = 0.0;
+
 } // Constructor
 
 
@@ -148,6 +166,11 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->GetConfiguration()->ReadParameter( this->m_NumberOfBandStructureSamples,
     "NumberOfBandStructureSamples", this->GetComponentLabel(), level, 0 );
 
+  /** Set whether the band of the covariance matrix is stored sparsely per thread. */
+  this->m_UseSparseBandCovariance = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseSparseBandCovariance,
+    "UseSparseBandCovariance", this->GetComponentLabel(), level, 0 );
+
   /** Set/Get whether the adaptive step size mechanism is desired. Default: true
    * NB: the setting is turned of in case of UseRandomSampleRegion=true.
    * Deprecated alias UseCruzAcceleration is also still supported.
@@ -169,6 +192,46 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->GetConfiguration()->ReadParameter( this->m_UseConstantStep,
     "UseConstantStep", this->GetComponentLabel(), level, 0 );
 
+  /** Set whether only the active parameters are updated; default: false. */
+  this->m_UseActiveParameterSubset = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseActiveParameterSubset,
+    "UseActiveParameterSubset", this->GetComponentLabel(), level, 0 );
+  this->m_ActiveParameterGradientFraction = 1.0;
+  this->GetConfiguration()->ReadParameter( this->m_ActiveParameterGradientFraction,
+    "ActiveParameterGradientFraction", this->GetComponentLabel(), level, 0 );
+  if( this->m_ActiveParameterGradientFraction <= 0.0 || this->m_ActiveParameterGradientFraction > 1.0 )
+  {
+    itkExceptionMacro( << "ERROR: ActiveParameterGradientFraction should be in ( 0, 1 ], "
+                       << "but is " << this->m_ActiveParameterGradientFraction << "." );
+  }
+  this->SetActiveParameterRanges( ActiveParameterRangesType() );
+
+  /** Set whether the number of samples is adapted; default: false.
+   * A bound of 0 means: derived from the number of samples of the sampler.
+   */
+  this->m_UseAdaptiveNumberOfSamples = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseAdaptiveNumberOfSamples,
+    "AdaptiveNumberOfSamples", this->GetComponentLabel(), level, 0 );
+  this->m_MinimumNumberOfSamples = 0;
+  this->GetConfiguration()->ReadParameter( this->m_MinimumNumberOfSamples,
+    "MinimumNumberOfSamples", this->GetComponentLabel(), level, 0 );
+  this->m_MaximumNumberOfSamples = 0;
+  this->GetConfiguration()->ReadParameter( this->m_MaximumNumberOfSamples,
+    "MaximumNumberOfSamples", this->GetComponentLabel(), level, 0 );
+  this->m_NumberOfSamplesGrowthFactor = 1.05;
+  this->GetConfiguration()->ReadParameter( this->m_NumberOfSamplesGrowthFactor,
+    "NumberOfSamplesGrowthFactor", this->GetComponentLabel(), level, 0 );
+  if( this->m_NumberOfSamplesGrowthFactor <= 1.0 )
+  {
+    itkExceptionMacro( << "ERROR: NumberOfSamplesGrowthFactor should be larger than 1, "
+                       << "but is " << this->m_NumberOfSamplesGrowthFactor << "." );
+  }
+  this->m_GradientNoiseRatio = -1.0;
+  this->m_AdaptiveSamplers.clear();
+  this->m_AdaptiveNumberOfSamples.clear();
+  this->m_AdaptiveMinimumNumberOfSamples.clear();
+  this->m_AdaptiveMaximumNumberOfSamples.clear();
+
   if( this->m_AutomaticParameterEstimation )
   {
     /** Set the maximum step length: the maximum displacement of a voxel in mm.
@@ -231,6 +294,15 @@ AdaptiveStochasticGradientDescent< TElastix >
       "SigmoidScaleFactor", this->GetComponentLabel(), level, 0 );
     this->m_SigmoidScaleFactor = sigmoidScaleFactor;
 
+    /** Set the cache of the estimates. */
+    this->m_UseParameterEstimationCache = false;
+    this->GetConfiguration()->ReadParameter( this->m_UseParameterEstimationCache,
+      "UseAutomaticParameterEstimationCache", this->GetComponentLabel(), level, 0 );
+    this->m_ParameterEstimationCacheDirectory
+      = this->m_Configuration->GetCommandLineArgument( "-out" );
+    this->GetConfiguration()->ReadParameter( this->m_ParameterEstimationCacheDirectory,
+      "AutomaticParameterEstimationCacheDirectory", this->GetComponentLabel(), 0, 0 );
+
   } // end if automatic parameter estimation
   else
   {
@@ -292,9 +364,27 @@ AdaptiveStochasticGradientDescent< TElastix >
     xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradient().magnitude();
   }
 
-  /** Select new spatial samples for the computation of the metric. */
+  /** Stop when the convergence test of the OptimizerBase passes. */
+  if( this->CheckConvergence( this->GetValue(),
+    this->GetScaledCurrentPosition(), this->GetGradient().magnitude() ) )
+  {
+    this->m_StopCondition = ConvergenceDetected;
+    this->StopOptimization();
+  }
+
+  /** Stop when the next iteration would exceed the time budget. */
+  if( this->CheckTimeBudget() )
+  {
+    this->m_StopCondition = MaximumTimeExceeded;
+    this->StopOptimization();
+  }
+
+  /** Select new spatial samples for the computation of the metric,
+   * possibly of a different number.
+   */
   if( this->GetNewSamplesEveryIteration() )
   {
+    this->UpdateAdaptiveNumberOfSamples();
     this->SelectNewSamples();
   }
 
@@ -318,7 +408,9 @@ AdaptiveStochasticGradientDescent< TElastix >
    * typedef enum {
    *   MaximumNumberOfIterations,
    *   MetricError,
-   *   MinimumStepSize } StopConditionType;
+   *   MinimumStepSize,
+   *   ConvergenceDetected,
+   *   MaximumTimeExceeded } StopConditionType;
    */
   std::string stopcondition;
 
@@ -336,6 +428,14 @@ AdaptiveStochasticGradientDescent< TElastix >
       stopcondition = "The minimum step length has been reached";
       break;
 
+    case ConvergenceDetected:
+      stopcondition = "The convergence criteria have been satisfied";
+      break;
+
+    case MaximumTimeExceeded:
+      stopcondition = "The maximum registration time has been reached";
+      break;
+
     default:
       stopcondition = "Unknown";
       break;
@@ -344,6 +444,14 @@ AdaptiveStochasticGradientDescent< TElastix >
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
+  /** Print the final adapted number of samples, and release the samplers. */
+  for( unsigned int i = 0; i < this->m_AdaptiveSamplers.size(); ++i )
+  {
+    elxout << "Final number of samples of random sampler " << i << ": "
+           << this->m_AdaptiveSamplers[ i ]->GetNumberOfSamples() << std::endl;
+  }
+  this->m_AdaptiveSamplers.clear();
+
   /** Store the used parameters, for later printing to screen. */
   SettingsType settings;
   settings.a     = this->GetParam_a();
@@ -412,7 +520,9 @@ AdaptiveStochasticGradientDescent< TElastix >
     }
   }
 
-  this->m_AutomaticParameterEstimationDone = false;
+  this->m_AutomaticParameterEstimationDone   = false;
+  this->m_AdaptiveNumberOfSamplesInitialized = false;
+  this->m_ActiveParameterSubsetInitialized   = false;
 
   this->Superclass1::StartOptimization();
 
@@ -433,6 +543,13 @@ AdaptiveStochasticGradientDescent< TElastix >
    * position has been set, so must be called in this
    * function. */
 
+  if( this->m_UseActiveParameterSubset
+    && !this->m_ActiveParameterSubsetInitialized )
+  {
+    this->InitializeActiveParameterSubset();
+    this->m_ActiveParameterSubsetInitialized = true;
+  }
+
   if( this->GetAutomaticParameterEstimation()
     && !this->m_AutomaticParameterEstimationDone )
   {
@@ -441,6 +558,13 @@ AdaptiveStochasticGradientDescent< TElastix >
     this->m_AutomaticParameterEstimationDone = true;
   }
 
+  if( this->m_UseAdaptiveNumberOfSamples
+    && !this->m_AdaptiveNumberOfSamplesInitialized )
+  {
+    this->InitializeAdaptiveNumberOfSamples();
+    this->m_AdaptiveNumberOfSamplesInitialized = true;
+  }
+
   this->Superclass1::ResumeOptimization();
 
 } // end ResumeOptimization()
@@ -500,6 +624,20 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->GetConfiguration()->ReadParameter( asgdParameterEstimationMethod,
     "ASGDParameterEstimationMethod", this->GetComponentLabel(), 0, 0 );
 
+  /** Skip the estimation if the cache has the estimates of these settings. */
+  std::string cacheKey;
+  if( this->m_UseParameterEstimationCache )
+  {
+    cacheKey = this->GetParameterEstimationCacheKey( asgdParameterEstimationMethod );
+    if( this->ReadParameterEstimationCache( cacheKey ) )
+    {
+      timer1.Stop();
+      elxout << "  Read the estimates from the cache file "
+             << this->GetParameterEstimationCacheFileName( cacheKey ) << std::endl;
+      return;
+    }
+  }
+
   /** Perform automatic optimizer parameter estimation by the desired method. */
   if( asgdParameterEstimationMethod == "Original" )
   {
@@ -519,6 +657,12 @@ AdaptiveStochasticGradientDescent< TElastix >
     this->AutomaticParameterEstimationUsingDisplacementDistribution();
   }
 
+  /** Store the estimates for the next jobs. */
+  if( this->m_UseParameterEstimationCache )
+  {
+    this->WriteParameterEstimationCache( cacheKey );
+  }
+
   /** Print the elapsed time. */
   timer1.Stop();
   elxout << "Automatic parameter estimation took "
@@ -527,6 +671,212 @@ AdaptiveStochasticGradientDescent< TElastix >
 } // end AutomaticParameterEstimation()
 
 
+/**
+ * ******************* GetParameterEstimationCacheKey **********************
+ */
+
+template< class TElastix >
+std::string
+AdaptiveStochasticGradientDescent< TElastix >
+::GetParameterEstimationCacheKey( const std::string & method ) const
+{
+  std::ostringstream key;
+  key << std::setprecision( 17 );
+
+  /** The estimation method and its settings. */
+  const unsigned int level = static_cast< unsigned int >(
+    this->m_Registration->GetAsITKBaseType()->GetCurrentLevel() );
+  bool noiseCompensation = true;
+  this->GetConfiguration()->ReadParameter( noiseCompensation,
+    "NoiseCompensation", this->GetComponentLabel(), 0, 0, false );
+  std::string maximumDisplacementEstimationMethod = "2sigma";
+  this->GetConfiguration()->ReadParameter( maximumDisplacementEstimationMethod,
+    "MaximumDisplacementEstimationMethod", this->GetComponentLabel(), 0, 0, false );
+  key << "ASGD1 level " << level
+      << " method " << method
+      << " delta " << this->m_MaximumStepLength
+      << " A " << this->GetParam_A()
+      << " jacobians " << this->m_NumberOfJacobianMeasurements
+      << " gradients " << this->m_NumberOfGradientMeasurements
+      << " exact " << this->m_NumberOfSamplesForExactGradient
+      << " zeta " << this->m_SigmoidScaleFactor
+      << " band " << this->m_MaxBandCovSize << " " << this->m_NumberOfBandStructureSamples
+      << " " << this->m_UseSparseBandCovariance
+      << " noise " << noiseCompensation << " " << maximumDisplacementEstimationMethod;
+
+  /** The geometry of the fixed image. */
+  const typename ElastixType::FixedImageType * fixedImage = this->GetElastix()->GetFixedImage();
+  const unsigned int fixdim = ElastixType::FixedDimension;
+  key << " fixed";
+  for( unsigned int d = 0; d < fixdim; ++d )
+  {
+    key << " " << fixedImage->GetLargestPossibleRegion().GetSize()[ d ];
+  }
+  for( unsigned int d = 0; d < fixdim; ++d )
+  {
+    key << " " << fixedImage->GetSpacing()[ d ] << " " << fixedImage->GetOrigin()[ d ];
+  }
+  for( unsigned int d = 0; d < fixdim * fixdim; ++d )
+  {
+    key << " " << fixedImage->GetDirection()( d / fixdim, d % fixdim );
+  }
+
+  /** The transform, and the scales. */
+  const TransformType * transform = this->GetRegistration()->GetAsITKBaseType()->GetTransform();
+  const typename TransformType::ParametersType & fixedParameters = transform->GetFixedParameters();
+  key << " transform " << this->GetElastix()->GetElxTransformBase()->elxGetClassName()
+      << " " << transform->GetNumberOfParameters();
+  for( unsigned int i = 0; i < fixedParameters.GetSize(); ++i )
+  {
+    key << " " << fixedParameters[ i ];
+  }
+  double sumScales = 0.0, sumSquaredScales = 0.0;
+  if( this->GetUseScales() )
+  {
+    const ScalesType & scales = this->GetScales();
+    for( unsigned int i = 0; i < scales.GetSize(); ++i )
+    {
+      sumScales        += scales[ i ];
+      sumSquaredScales += scales[ i ] * scales[ i ];
+    }
+  }
+  key << " scales " << this->GetUseScales() << " " << sumScales << " " << sumSquaredScales;
+
+  /** The metrics and their samplers. */
+  typedef typename ElastixType::MetricBaseType::AdvancedMetricType MetricType;
+  for( unsigned int m = 0; m < this->GetElastix()->GetNumberOfMetrics(); ++m )
+  {
+    key << " metric " << this->GetElastix()->GetElxMetricBase( m )->elxGetClassName();
+    const MetricType * metric = dynamic_cast< const MetricType * >(
+      this->GetElastix()->GetElxMetricBase( m )->GetAsITKBaseType() );
+    if( metric && metric->GetImageSampler() )
+    {
+      key << " " << metric->GetImageSampler()->GetNameOfClass()
+          << " " << metric->GetImageSampler()->GetNumberOfSamples();
+    }
+  }
+
+  return key.str();
+
+} // end GetParameterEstimationCacheKey()
+
+
+/**
+ * ******************* GetParameterEstimationCacheFileName **********************
+ */
+
+template< class TElastix >
+std::string
+AdaptiveStochasticGradientDescent< TElastix >
+::GetParameterEstimationCacheFileName( const std::string & key ) const
+{
+  /** The file name is a 32 bit FNV-1a hash of the key; the key itself is
+   * stored in the file, so collisions are detected.
+   */
+  unsigned long hash = 2166136261UL;
+  for( std::string::size_type i = 0; i < key.size(); ++i )
+  {
+    hash ^= static_cast< unsigned char >( key[ i ] );
+    hash  = ( hash * 16777619UL ) & 0xffffffffUL;
+  }
+
+  std::ostringstream fileName;
+  fileName << this->m_ParameterEstimationCacheDirectory;
+  if( !this->m_ParameterEstimationCacheDirectory.empty() )
+  {
+    const char last = this->m_ParameterEstimationCacheDirectory[
+      this->m_ParameterEstimationCacheDirectory.size() - 1 ];
+    if( last != '/' && last != '\\' )
+    {
+      fileName << "/";
+    }
+  }
+  fileName << "ASGDParameterEstimation." << std::hex << std::setw( 8 )
+           << std::setfill( '0' ) << hash << ".txt";
+  return fileName.str();
+
+} // end GetParameterEstimationCacheFileName()
+
+
+/**
+ * ******************* ReadParameterEstimationCache **********************
+ */
+
+template< class TElastix >
+bool
+AdaptiveStochasticGradientDescent< TElastix >
+::ReadParameterEstimationCache( const std::string & key )
+{
+  std::ifstream file( this->GetParameterEstimationCacheFileName( key ).c_str() );
+  if( !file.is_open() )
+  {
+    return false;
+  }
+
+  std::string storedKey;
+  std::getline( file, storedKey );
+  if( storedKey != key )
+  {
+    return false;
+  }
+
+  double a, alpha, sigmoidMax, sigmoidMin, sigmoidScale, gradientNoiseRatio;
+  if( !( file >> a >> alpha >> sigmoidMax >> sigmoidMin >> sigmoidScale >> gradientNoiseRatio ) )
+  {
+    return false;
+  }
+
+  this->SetParam_a( a );
+  this->SetParam_alpha( alpha );
+  this->SetSigmoidMax( sigmoidMax );
+  this->SetSigmoidMin( sigmoidMin );
+  this->SetSigmoidScale( sigmoidScale );
+  this->m_GradientNoiseRatio = gradientNoiseRatio;
+  return true;
+
+} // end ReadParameterEstimationCache()
+
+
+/**
+ * ******************* WriteParameterEstimationCache **********************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::WriteParameterEstimationCache( const std::string & key ) const
+{
+  /** Write to a temporary file first, and rename it, so that other jobs that
+   * share the directory never read a partly written file. The temporary file
+   * is unique for every writer, also for the concurrent registrations of
+   * -slices and -sweep in this process.
+   */
+  const std::string fileName          = this->GetParameterEstimationCacheFileName( key );
+  const std::string temporaryFileName = itk::GetUniqueTemporaryFileName( fileName );
+
+  itksys::SystemTools::MakeDirectory( this->m_ParameterEstimationCacheDirectory.c_str() );
+  std::ofstream file( temporaryFileName.c_str() );
+  if( !file.is_open() )
+  {
+    xl::xout[ "warning" ] << "WARNING: could not write the automatic parameter estimation cache file "
+                          << fileName << std::endl;
+    return;
+  }
+
+  file << key << "\n" << std::setprecision( 17 )
+       << this->GetParam_a() << " " << this->GetParam_alpha() << " "
+       << this->GetSigmoidMax() << " " << this->GetSigmoidMin() << " "
+       << this->GetSigmoidScale() << " " << this->m_GradientNoiseRatio << std::endl;
+  file.close();
+
+  if( !itksys::SystemTools::RenameFile( temporaryFileName.c_str(), fileName.c_str() ) )
+  {
+    itksys::SystemTools::RemoveFile( temporaryFileName.c_str() );
+  }
+
+} // end WriteParameterEstimationCache()
+
+
 /**
  * ******************* AutomaticParameterEstimationOriginal **********************
  */
@@ -571,6 +921,7 @@ AdaptiveStochasticGradientDescent< TElastix >
   computeJacobianTerms->SetMaxBandCovSize( this->m_MaxBandCovSize );
   computeJacobianTerms->SetNumberOfBandStructureSamples(
     this->m_NumberOfBandStructureSamples );
+  computeJacobianTerms->SetUseSparseBandCovariance( this->m_UseSparseBandCovariance );
   computeJacobianTerms->SetNumberOfJacobianMeasurements(
     this->m_NumberOfJacobianMeasurements );
 
@@ -820,6 +1171,7 @@ AdaptiveStochasticGradientDescent< TElastix >
   std::vector< ImageRandomSamplerBasePointer >       randomSamplerVec( M, 0 );
   std::vector< ImageRandomCoordinateSamplerPointer > randomCoordinateSamplerVec( M, 0 );
   std::vector< ImageGridSamplerPointer >             gridSamplerVec( M, 0 );
+  std::vector< bool >                                useSamplePrefetchingVec( M, false );
 
   /** If new samples every iteration, get each sampler, and check if it is
    * a kind of random sampler. If yes, prepare an additional grid sampler
@@ -887,15 +1239,36 @@ AdaptiveStochasticGradientDescent< TElastix >
 
     } // end for loop over metrics
 
-    /** Start a second loop over all metrics to turn off the random region sampling. */
+    /** Start a second loop over all metrics to turn off the random region sampling.
+     * Also remember whether the random samplers prefetch their samples. This is
+     * done before changing anything, since multiple metrics may share a sampler.
+     */
     for( unsigned int m = 0; m < M; ++m )
     {
       if( randomCoordinateSamplerVec[ m ].IsNotNull() )
       {
         randomCoordinateSamplerVec[ m ]->SetUseRandomSampleRegion( false );
       }
+      if( randomSamplerVec[ m ].IsNotNull() )
+      {
+        useSamplePrefetchingVec[ m ] = randomSamplerVec[ m ]->GetUseSamplePrefetching();
+      }
     } // end loop over metrics
 
+    /** The exact and approximate gradients are computed alternately. Let the
+     * random samplers that support it select the next sample set in a
+     * background thread, while the exact gradient is computed. The sample
+     * sets are the same as without prefetching.
+     */
+    for( unsigned int m = 0; m < M; ++m )
+    {
+      if( randomSamplerVec[ m ].IsNotNull()
+        && randomSamplerVec[ m ]->SamplePrefetchingSupported() )
+      {
+        randomSamplerVec[ m ]->SetUseSamplePrefetching( true );
+      }
+    }
+
   }   // end if NewSamplesEveryIteration.
 
 #ifndef _ELASTIX_BUILD_LIBRARY
@@ -989,7 +1362,17 @@ AdaptiveStochasticGradientDescent< TElastix >
   gg = exactgg;
   ee = diffgg;
 
-  /** Set back useRandomSampleRegion flag to what it was. */
+  /** Remember the relative noise of the stochastic gradient,
+   * for the initial adaptive number of samples.
+   */
+  if( stochasticgradients && exactgg > 1e-14 )
+  {
+    this->m_GradientNoiseRatio = diffgg / exactgg;
+  }
+
+  /** Set back useRandomSampleRegion and useSamplePrefetching flags to what they were.
+   * Changing the prefetching flag discards a pending prefetch, if any.
+   */
   for( unsigned int m = 0; m < M; ++m )
   {
     if( randomCoordinateSamplerVec[ m ].IsNotNull() )
@@ -997,6 +1380,10 @@ AdaptiveStochasticGradientDescent< TElastix >
       randomCoordinateSamplerVec[ m ]
       ->SetUseRandomSampleRegion( useRandomSampleRegionVec[ m ] );
     }
+    if( randomSamplerVec[ m ].IsNotNull() )
+    {
+      randomSamplerVec[ m ]->SetUseSamplePrefetching( useSamplePrefetchingVec[ m ] );
+    }
   }
 
 } // end SampleGradients()
@@ -1061,6 +1448,76 @@ AdaptiveStochasticGradientDescent< TElastix >
 } // end PrintSettingsVector()
 
 
+/**
+ * ****************** GetResolutionCheckpointState ****************************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::GetResolutionCheckpointState( std::vector< double > & state ) const
+{
+  /** The number of settings, the settings, the time and the step size. */
+  state.clear();
+  state.push_back( static_cast< double >( this->m_SettingsVector.size() ) );
+  for( unsigned int i = 0; i < this->m_SettingsVector.size(); ++i )
+  {
+    const SettingsType & settings = this->m_SettingsVector[ i ];
+    state.push_back( settings.a );
+    state.push_back( settings.A );
+    state.push_back( settings.alpha );
+    state.push_back( settings.fmax );
+    state.push_back( settings.fmin );
+    state.push_back( settings.omega );
+  }
+  state.push_back( this->GetCurrentTime() );
+  state.push_back( this->GetLearningRate() );
+
+} // end GetResolutionCheckpointState()
+
+
+/**
+ * ****************** SetResolutionCheckpointState ****************************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::SetResolutionCheckpointState( const std::vector< double > & state )
+{
+  const std::size_t numberOfSettings
+    = state.empty() ? 0 : static_cast< std::size_t >( state[ 0 ] );
+  if( state.size() != 1 + 6 * numberOfSettings + 2 )
+  {
+    itkExceptionMacro( << "The resolution checkpoint has no valid state of "
+                       << this->elxGetClassName() );
+  }
+
+  /** The settings of the finished resolutions are printed at the end. The
+   * time starts at SigmoidInitialTime in every resolution, so the time and
+   * step size of the checkpoint are only reported.
+   */
+  this->m_SettingsVector.clear();
+  for( std::size_t i = 0; i < numberOfSettings; ++i )
+  {
+    const double * values = &state[ 1 + 6 * i ];
+    SettingsType   settings;
+    settings.a     = values[ 0 ];
+    settings.A     = values[ 1 ];
+    settings.alpha = values[ 2 ];
+    settings.fmax  = values[ 3 ];
+    settings.fmin  = values[ 4 ];
+    settings.omega = values[ 5 ];
+    this->m_SettingsVector.push_back( settings );
+  }
+
+  elxout << "  " << this->elxGetClassName() << " ended the last completed resolution at time "
+         << state[ state.size() - 2 ] << ", with step size " << state[ state.size() - 1 ]
+         << "." << std::endl;
+
+} // end SetResolutionCheckpointState()
+
+
 /**
  * ****************** CheckForAdvancedTransform **********************
  */
@@ -1134,6 +1591,258 @@ AdaptiveStochasticGradientDescent< TElastix >
 } // end AddRandomPerturbation()
 
 
+/**
+ * *************** InitializeAdaptiveNumberOfSamples ***************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::InitializeAdaptiveNumberOfSamples( void )
+{
+  this->m_AdaptiveSamplers.clear();
+  this->m_AdaptiveNumberOfSamples.clear();
+  this->m_AdaptiveMinimumNumberOfSamples.clear();
+  this->m_AdaptiveMaximumNumberOfSamples.clear();
+  this->m_PreviousTime = this->GetCurrentTime();
+
+  /** The time only reflects the gradient noise with adaptive step sizes. */
+  if( !this->GetNewSamplesEveryIteration() || !this->GetUseAdaptiveStepSizes() )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: AdaptiveNumberOfSamples is ignored, because it needs "
+      << "(NewSamplesEveryIteration \"true\") and (UseAdaptiveStepSizes \"true\")."
+      << std::endl;
+    return;
+  }
+
+  /** Collect the random samplers, once each, since metrics may share a sampler. */
+  const unsigned int M = this->GetElastix()->GetNumberOfMetrics();
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    ImageSamplerBasePointer sampler
+      = this->GetElastix()->GetElxMetricBase( m )->GetAdvancedMetricImageSampler();
+    ImageRandomSamplerBasePointer randomSampler
+      = dynamic_cast< ImageRandomSamplerBaseType * >( sampler.GetPointer() );
+    if( randomSampler.IsNull()
+      || std::find( this->m_AdaptiveSamplers.begin(), this->m_AdaptiveSamplers.end(),
+      randomSampler ) != this->m_AdaptiveSamplers.end() )
+    {
+      continue;
+    }
+
+    /** Determine the bounds, relative to the user-given number of samples. */
+    const SizeValueType n0 = randomSampler->GetNumberOfSamples();
+    SizeValueType       minimum = this->m_MinimumNumberOfSamples;
+    SizeValueType       maximum = this->m_MaximumNumberOfSamples;
+    if( minimum == 0 )
+    {
+      minimum = vnl_math_max( n0 / 4, static_cast< SizeValueType >( 1 ) );
+    }
+    if( maximum == 0 )
+    {
+      maximum = 4 * n0;
+    }
+    maximum = vnl_math_max( maximum, minimum );
+
+    /** The variance of the gradient noise is inversely proportional to the number
+     * of samples. Start with the number at which the noise equals the gradient.
+     */
+    double n = static_cast< double >( n0 );
+    if( this->m_GradientNoiseRatio > 0.0 )
+    {
+      n *= this->m_GradientNoiseRatio;
+    }
+    n = vnl_math_min( vnl_math_max( n, static_cast< double >( minimum ) ),
+      static_cast< double >( maximum ) );
+    randomSampler->SetNumberOfSamples( static_cast< unsigned long >( n + 0.5 ) );
+
+    elxout << "Adaptive number of samples of random sampler "
+           << this->m_AdaptiveSamplers.size() << ": initially "
+           << randomSampler->GetNumberOfSamples() << ", between "
+           << minimum << " and " << maximum << "." << std::endl;
+
+    this->m_AdaptiveSamplers.push_back( randomSampler );
+    this->m_AdaptiveNumberOfSamples.push_back( n );
+    this->m_AdaptiveMinimumNumberOfSamples.push_back( minimum );
+    this->m_AdaptiveMaximumNumberOfSamples.push_back( maximum );
+  }
+
+} // end InitializeAdaptiveNumberOfSamples()
+
+
+/**
+ * *************** UpdateAdaptiveNumberOfSamples ***************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::UpdateAdaptiveNumberOfSamples( void )
+{
+  if( this->m_AdaptiveSamplers.empty() )
+  {
+    return;
+  }
+
+  /** The time increases when two successive gradients point in opposite
+   * directions, i.e. when the noise dominates: then take more samples.
+   */
+  const double time = this->GetCurrentTime();
+  const double factor = ( time > this->m_PreviousTime )
+    ? this->m_NumberOfSamplesGrowthFactor : 1.0 / this->m_NumberOfSamplesGrowthFactor;
+  this->m_PreviousTime = time;
+
+  for( unsigned int i = 0; i < this->m_AdaptiveSamplers.size(); ++i )
+  {
+    double & n = this->m_AdaptiveNumberOfSamples[ i ];
+    n = vnl_math_min( vnl_math_max( n * factor,
+      static_cast< double >( this->m_AdaptiveMinimumNumberOfSamples[ i ] ) ),
+      static_cast< double >( this->m_AdaptiveMaximumNumberOfSamples[ i ] ) );
+
+    /** Only touch the sampler when the number changes, since that discards
+     * prefetched samples.
+     */
+    const unsigned long rounded = static_cast< unsigned long >( n + 0.5 );
+    if( rounded != this->m_AdaptiveSamplers[ i ]->GetNumberOfSamples() )
+    {
+      this->m_AdaptiveSamplers[ i ]->SetNumberOfSamples( rounded );
+    }
+  }
+
+} // end UpdateAdaptiveNumberOfSamples()
+
+
+/**
+ * ***************** InitializeActiveParameterSubset *************************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::InitializeActiveParameterSubset( void )
+{
+  itk::TimeProbe timer;
+  timer.Start();
+
+  /** The union of the active parameters of all metrics. A metric without
+   * a fixed image mask makes all parameters active.
+   */
+  typedef typename ElastixType::MetricBaseType::AdvancedMetricType MetricType;
+  typedef typename ComputeActiveParametersType::ActiveParameterRangesType RangesType;
+  const unsigned long          numberOfParameters = this->GetScaledCurrentPosition().GetSize();
+  std::vector< unsigned char > active( numberOfParameters, 0 );
+  bool                         allActive = false;
+  for( unsigned int m = 0; m < this->GetElastix()->GetNumberOfMetrics() && !allActive; ++m )
+  {
+    const MetricType * metric = dynamic_cast< const MetricType * >(
+      this->GetElastix()->GetElxMetricBase( m )->GetAsITKBaseType() );
+    RangesType ranges;
+    if( metric )
+    {
+      typename ComputeActiveParametersType::Pointer computeActiveParameters
+        = ComputeActiveParametersType::New();
+      computeActiveParameters->SetFixedImage( metric->GetFixedImage() );
+      computeActiveParameters->SetFixedImageRegion( metric->GetFixedImageRegion() );
+      computeActiveParameters->SetFixedImageMask( metric->GetFixedImageMask() );
+      computeActiveParameters->SetTransform(
+        this->GetRegistration()->GetAsITKBaseType()->GetTransform() );
+      computeActiveParameters->Compute( ranges );
+    }
+    allActive = ranges.empty();
+    for( std::size_t r = 0; r < ranges.size(); ++r )
+    {
+      std::fill( active.begin() + ranges[ r ].first, active.begin() + ranges[ r ].second, 1 );
+    }
+  }
+  if( allActive )
+  {
+    std::fill( active.begin(), active.end(), 1 );
+  }
+
+  /** Refine only where the gradient is large: of the active control points,
+   * keep the fraction with the largest gradient magnitude, over all
+   * dimensions. Not in the first resolution, which is optimized everywhere.
+   */
+  const unsigned int level = static_cast< unsigned int >(
+    this->m_Registration->GetAsITKBaseType()->GetCurrentLevel() );
+  const unsigned int dim = ElastixType::FixedDimension;
+  if( this->m_ActiveParameterGradientFraction < 1.0 && level > 0
+    && numberOfParameters % dim == 0 )
+  {
+    const unsigned long parametersPerDimension = numberOfParameters / dim;
+    DerivativeType      gradient;
+    this->GetScaledDerivativeWithExceptionHandling( this->GetScaledCurrentPosition(), gradient );
+
+    std::vector< double > magnitudes;
+    magnitudes.reserve( parametersPerDimension );
+    for( unsigned long j = 0; j < parametersPerDimension; ++j )
+    {
+      if( active[ j ] )
+      {
+        double magnitude = 0.0;
+        for( unsigned int d = 0; d < dim; ++d )
+        {
+          magnitude += gradient[ d * parametersPerDimension + j ] * gradient[ d * parametersPerDimension + j ];
+        }
+        magnitudes.push_back( magnitude );
+      }
+    }
+
+    const std::size_t numberToKeep = static_cast< std::size_t >( vcl_ceil(
+      this->m_ActiveParameterGradientFraction * magnitudes.size() ) );
+    if( numberToKeep > 0 && numberToKeep < magnitudes.size() )
+    {
+      std::vector< double > sorted( magnitudes );
+      std::nth_element( sorted.begin(), sorted.begin() + ( sorted.size() - numberToKeep ), sorted.end() );
+      const double threshold = sorted[ sorted.size() - numberToKeep ];
+      for( unsigned long j = 0, k = 0; j < parametersPerDimension; ++j )
+      {
+        if( active[ j ] )
+        {
+          const unsigned char keep = magnitudes[ k++ ] >= threshold ? 1 : 0;
+          for( unsigned int d = 0; d < dim; ++d )
+          {
+            active[ d * parametersPerDimension + j ] = keep;
+          }
+        }
+      }
+    }
+  }
+
+  /** Convert the flags to ranges. */
+  ActiveParameterRangesType ranges;
+  unsigned long             numberOfActiveParameters = 0;
+  for( unsigned long j = 0; j < numberOfParameters; )
+  {
+    if( !active[ j ] )
+    {
+      ++j;
+      continue;
+    }
+    const unsigned long begin = j;
+    while( j < numberOfParameters && active[ j ] )
+    {
+      ++j;
+    }
+    ranges.push_back( ActiveParameterRangeType( begin, j ) );
+    numberOfActiveParameters += j - begin;
+  }
+  if( numberOfActiveParameters == numberOfParameters || numberOfActiveParameters == 0 )
+  {
+    ranges.clear();
+    numberOfActiveParameters = numberOfParameters;
+  }
+  this->SetActiveParameterRanges( ranges );
+
+  timer.Stop();
+  elxout << "  Active parameters: " << numberOfActiveParameters << " of "
+         << numberOfParameters << ", in " << ranges.size() << " ranges, computed in "
+         << this->ConvertSecondsToDHMS( timer.GetMean(), 6 ) << std::endl;
+
+} // end InitializeActiveParameterSubset()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxAdaptiveStochasticGradientDescent_hxx
@@ -65,7 +65,7 @@ AdaptiveStochasticGradientDescentOptimizer
       sigmoid.SetBeta( beta );
 
       /** Formula (2) in Cruz */
-      const double inprod = inner_product(
+      const double inprod = this->ActiveInnerProduct(
         this->m_PreviousGradient, this->GetGradient() );
       this->m_CurrentTime += sigmoid( -inprod );
       this->m_CurrentTime  = vnl_math_max( 0.0, this->m_CurrentTime );
@@ -121,6 +121,14 @@ ConjugateGradient< TElastix >::LineSearch(
   MeasureType & f,
   DerivativeType & g )
 {
+  /** Let the metrics cache the mapped samples along the search direction.
+   * The metrics work in the unscaled parameter space. */
+  ParametersType position  = x;
+  ParametersType direction = searchDir;
+  this->GetScaledCostFunction()->ConvertScaledToUnscaledParameters( position );
+  this->GetScaledCostFunction()->ConvertScaledToUnscaledParameters( direction );
+  this->BeginLineSearch( position, direction );
+
   /** Call the superclass's implementation and ignore a
    * LineSearchError. Just report the error and assume convergence. */
   try
@@ -129,6 +137,7 @@ ConjugateGradient< TElastix >::LineSearch(
   }
   catch( itk::ExceptionObject & err )
   {
+    this->EndLineSearch();
     if( this->GetLineSearchOptimizer() == 0 )
     {
       throw err;
@@ -147,6 +156,8 @@ ConjugateGradient< TElastix >::LineSearch(
       g    = this->GetCurrentGradient();
     }
   }
+  this->EndLineSearch();
+
 }   // end LineSearch
 
 
@@ -0,0 +1,155 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxPreconditionedStochasticGradientDescent_h
+#define __elxPreconditionedStochasticGradientDescent_h
+
+#include "../AdaptiveStochasticGradientDescent/elxAdaptiveStochasticGradientDescent.h"
+
+namespace elastix
+{
+/**
+ * \class PreconditionedStochasticGradientDescent
+ * \brief An adaptive stochastic gradient descent optimizer, preconditioned
+ * with the self Hessian of the metric.
+ *
+ * This optimizer is the AdaptiveStochasticGradientDescent optimizer, including its
+ * automatic parameter estimation, with the stochastic gradient \f$g_k\f$ replaced by
+ *
+ * \f[ \bar{h} ( H + \lambda \bar{h} I )^{-1} g_k, \f]
+ *
+ * with \f$H\f$ the diagonal or the block diagonal of the self Hessian of the
+ * metric, see GetSelfHessianBlocks() of the metrics, \f$\bar{h}\f$ the mean of
+ * its diagonal, and \f$\lambda\f$ the PreconditionerRegularization. The factor
+ * \f$\bar{h}\f$ keeps the preconditioned gradient in the units of the gradient,
+ * so that the automatic estimation of the step size still applies. Parameters
+ * whose self Hessian is small, such as control points in homogeneous regions,
+ * take larger steps, and parameters in regions with strong edges smaller ones.
+ *
+ * The self Hessian is computed once per resolution, at the start, with the
+ * NumberOfSamplesForSelfHessian, SelfHessianSmoothingSigma and
+ * SelfHessianNoiseRange parameters of the metric. Only the AdvancedMeanSquares
+ * metric implements it; other metrics contribute identity blocks.
+ *
+ * The parameters used in this class are those of AdaptiveStochasticGradientDescent, and:
+ * \parameter Optimizer: Select this optimizer as follows:\n
+ *   <tt>(Optimizer "PreconditionedStochasticGradientDescent")</tt>
+ * \parameter PreconditionerType: "Diagonal" uses the diagonal of the self Hessian;
+ *   "BlockDiagonal" uses the blocks that couple the coefficients of one control
+ *   point of a B-spline transform, one coefficient for each dimension. The
+ *   parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(PreconditionerType "BlockDiagonal")</tt>\n
+ *   Default value: "Diagonal".
+ * \parameter PreconditionerRegularization: \f$\lambda\f$, which bounds the steps of
+ *   the parameters with a small self Hessian. The parameter can be specified for
+ *   each resolution, or for all resolutions at once.\n
+ *   example: <tt>(PreconditionerRegularization 0.1)</tt>\n
+ *   Default value: 0.01.
+ *
+ * \sa AdaptiveStochasticGradientDescent
+ * \ingroup Optimizers
+ */
+
+template< class TElastix >
+class PreconditionedStochasticGradientDescent :
+  public AdaptiveStochasticGradientDescent< TElastix >
+{
+public:
+
+  /** Standard ITK. */
+  typedef PreconditionedStochasticGradientDescent       Self;
+  typedef AdaptiveStochasticGradientDescent< TElastix > Superclass;
+  typedef itk::SmartPointer< Self >                     Pointer;
+  typedef itk::SmartPointer< const Self >               ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( PreconditionedStochasticGradientDescent,
+    AdaptiveStochasticGradientDescent );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific optimizer.
+   * example: <tt>(Optimizer "PreconditionedStochasticGradientDescent")</tt>\n
+   */
+  elxClassNameMacro( "PreconditionedStochasticGradientDescent" );
+
+  /** Typedef's inherited from Superclass. */
+  typedef typename Superclass::ParametersType ParametersType;
+  typedef typename Superclass::DerivativeType DerivativeType;
+  typedef typename Superclass::ScalesType     ScalesType;
+  typedef typename Superclass::SizeValueType  SizeValueType;
+
+  /** Methods invoked by elastix, in which parameters can be set and
+   * progress information can be printed.
+   */
+  virtual void BeforeEachResolution( void );
+
+  virtual void AfterEachResolution( void );
+
+  /** Precondition the stochastic gradient, after that call the
+   * Superclass' implementation.
+   */
+  virtual void AdvanceOneStep( void );
+
+  /** Set/Get the regularization of the preconditioner. */
+  itkSetClampMacro( PreconditionerRegularization, double,
+    0.0, itk::NumericTraits< double >::max() );
+  itkGetConstMacro( PreconditionerRegularization, double );
+
+protected:
+
+  /** Protected typedefs. */
+  typedef typename Superclass::itkRegistrationType   itkRegistrationType;
+  typedef typename itkRegistrationType::MetricType   MetricType;
+  typedef typename MetricType::SelfHessianBlocksType SelfHessianBlocksType;
+
+  PreconditionedStochasticGradientDescent();
+  virtual ~PreconditionedStochasticGradientDescent() {}
+
+  /** Compute the self Hessian blocks at the current position, and store
+   * the inverses of the regularized blocks. Returns false if there is no
+   * metric that supports the self Hessian. */
+  virtual bool ComputePreconditioner( void );
+
+  /** Replace m_Gradient by the preconditioned gradient, in place. */
+  virtual void PreconditionGradient( void );
+
+  unsigned int m_PreconditionerBlockSize;
+  double       m_PreconditionerRegularization;
+
+private:
+
+  PreconditionedStochasticGradientDescent( const Self & ); // purposely not implemented
+  void operator=( const Self & );                          // purposely not implemented
+
+  /** The inverse blocks, in the layout of SelfHessianBlocksType. */
+  SelfHessianBlocksType m_InversePreconditionerBlocks;
+
+  bool m_UsePreconditioner;
+  bool m_PreconditionerInitialized;
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxPreconditionedStochasticGradientDescent.hxx"
+#endif
+
+#endif // end #ifndef __elxPreconditionedStochasticGradientDescent_h
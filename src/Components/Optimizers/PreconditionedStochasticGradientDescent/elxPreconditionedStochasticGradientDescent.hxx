@@ -0,0 +1,292 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxPreconditionedStochasticGradientDescent_hxx
+#define __elxPreconditionedStochasticGradientDescent_hxx
+
+#include "elxPreconditionedStochasticGradientDescent.h"
+#include "vnl/algo/vnl_matrix_inverse.h"
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * ********************** Constructor ***********************
+ */
+
+template< class TElastix >
+PreconditionedStochasticGradientDescent< TElastix >
+::PreconditionedStochasticGradientDescent()
+{
+  this->m_PreconditionerBlockSize      = 1;
+  this->m_PreconditionerRegularization = 0.01;
+  this->m_UsePreconditioner            = false;
+  this->m_PreconditionerInitialized    = false;
+
+} // end Constructor()
+
+
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+PreconditionedStochasticGradientDescent< TElastix >
+::BeforeEachResolution( void )
+{
+  /** Call the Superclass' implementation. */
+  this->Superclass::BeforeEachResolution();
+
+  /** Get the current resolution level. */
+  unsigned int level = static_cast< unsigned int >(
+    this->m_Registration->GetAsITKBaseType()->GetCurrentLevel() );
+
+  /** Set the type of preconditioner. */
+  std::string preconditionerType = "Diagonal";
+  this->GetConfiguration()->ReadParameter( preconditionerType,
+    "PreconditionerType", this->GetComponentLabel(), level, 0 );
+  if( preconditionerType == "BlockDiagonal" )
+  {
+    this->m_PreconditionerBlockSize = TElastix::FixedDimension;
+  }
+  else if( preconditionerType == "Diagonal" )
+  {
+    this->m_PreconditionerBlockSize = 1;
+  }
+  else
+  {
+    itkExceptionMacro( << "ERROR: unknown PreconditionerType \"" << preconditionerType
+                       << "\". Choose \"Diagonal\" or \"BlockDiagonal\"." );
+  }
+
+  /** Set the regularization of the preconditioner. */
+  double regularization = 0.01;
+  this->GetConfiguration()->ReadParameter( regularization,
+    "PreconditionerRegularization", this->GetComponentLabel(), level, 0 );
+  this->SetPreconditionerRegularization( regularization );
+
+  /** The preconditioner is computed at the first iteration, when the metrics are ready. */
+  this->m_UsePreconditioner         = false;
+  this->m_PreconditionerInitialized = false;
+
+} // end BeforeEachResolution()
+
+
+/**
+ * ***************** AfterEachResolution *************************
+ */
+
+template< class TElastix >
+void
+PreconditionedStochasticGradientDescent< TElastix >
+::AfterEachResolution( void )
+{
+  /** Call the Superclass' implementation. */
+  this->Superclass::AfterEachResolution();
+
+  /** Release the preconditioner. */
+  this->m_InversePreconditionerBlocks.SetSize( 0 );
+
+} // end AfterEachResolution()
+
+
+/**
+ * ***************** ComputePreconditioner *************************
+ */
+
+template< class TElastix >
+bool
+PreconditionedStochasticGradientDescent< TElastix >
+::ComputePreconditioner( void )
+{
+  MetricType * metric = this->m_Registration->GetAsITKBaseType()->GetMetric();
+  if( metric == 0 )
+  {
+    return false;
+  }
+
+  /** The blocks need a block size that divides the number of parameters. */
+  const unsigned int N = this->GetScaledCurrentPosition().GetSize();
+  unsigned int       B = this->m_PreconditionerBlockSize;
+  if( N % B != 0 )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: the number of parameters is not a multiple of the dimension.\n"
+      << "  The diagonal preconditioner is used instead of the block diagonal one." << std::endl;
+    B = 1;
+  }
+  const unsigned int numberOfBlocks = N / B;
+
+  /** Compute the self Hessian blocks at the current, unscaled, position. */
+  elxout << "Computing the self Hessian for the preconditioner ..." << std::endl;
+  SelfHessianBlocksType blocks;
+  metric->GetSelfHessianBlocks( this->GetCurrentPosition(), B, blocks );
+
+  /** Transform to the scaled parameters y = x s, where the ITK convention
+   * is to store s^2: H_y(i,j) = H_x(i,j) / ( s_i s_j ).
+   */
+  if( this->GetUseScales() )
+  {
+    const ScalesType & scales = this->GetScales();
+    for( unsigned int b = 0; b < numberOfBlocks; ++b )
+    {
+      for( unsigned int k = 0; k < B; ++k )
+      {
+        for( unsigned int l = 0; l < B; ++l )
+        {
+          blocks[ ( b * B + k ) * B + l ] /= vcl_sqrt(
+            scales[ b + k * numberOfBlocks ] * scales[ b + l * numberOfBlocks ] );
+        }
+      }
+    }
+  }
+
+  /** The mean of the diagonal, which sets the level of the regularization
+   * and keeps the preconditioned gradient in the units of the gradient.
+   */
+  double meanDiagonal = 0.0;
+  for( unsigned int b = 0; b < numberOfBlocks; ++b )
+  {
+    for( unsigned int k = 0; k < B; ++k )
+    {
+      meanDiagonal += blocks[ ( b * B + k ) * B + k ];
+    }
+  }
+  meanDiagonal /= static_cast< double >( N );
+  if( !( meanDiagonal > 0.0 ) )
+  {
+    return false;
+  }
+
+  /** Store hbar ( H_b + lambda hbar I )^{-1} for every block. */
+  const double lambda = this->m_PreconditionerRegularization * meanDiagonal;
+  this->m_InversePreconditionerBlocks.SetSize( N * B );
+  vnl_matrix< double > block( B, B );
+  for( unsigned int b = 0; b < numberOfBlocks; ++b )
+  {
+    const double * H = blocks.data_block() + b * B * B;
+    double *       P = this->m_InversePreconditionerBlocks.data_block() + b * B * B;
+    if( B == 1 )
+    {
+      const double h = H[ 0 ] + lambda;
+      P[ 0 ] = h > 0.0 ? meanDiagonal / h : 1.0;
+      continue;
+    }
+
+    block.copy_in( H );
+    for( unsigned int k = 0; k < B; ++k )
+    {
+      block( k, k ) += lambda;
+    }
+    const vnl_matrix< double > inverse = vnl_matrix_inverse< double >( block ).inverse();
+    for( unsigned int i = 0; i < B * B; ++i )
+    {
+      P[ i ] = meanDiagonal * inverse.data_block()[ i ];
+    }
+  }
+
+  this->m_PreconditionerBlockSize = B;
+  elxout << "  mean diagonal of the self Hessian: " << meanDiagonal << std::endl;
+  return true;
+
+} // end ComputePreconditioner()
+
+
+/**
+ * ***************** PreconditionGradient *************************
+ */
+
+template< class TElastix >
+void
+PreconditionedStochasticGradientDescent< TElastix >
+::PreconditionGradient( void )
+{
+  const unsigned int B              = this->m_PreconditionerBlockSize;
+  const unsigned int N              = this->m_Gradient.GetSize();
+  const unsigned int numberOfBlocks = N / B;
+  double *           g              = this->m_Gradient.data_block();
+  const double *     P              = this->m_InversePreconditionerBlocks.data_block();
+
+  /** The diagonal: an element-wise product. */
+  if( B == 1 )
+  {
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      g[ i ] *= P[ i ];
+    }
+    return;
+  }
+
+  /** Multiply the part of the gradient of every block by its inverse. */
+  std::vector< double > gb( B );
+  for( unsigned int b = 0; b < numberOfBlocks; ++b, P += B * B )
+  {
+    for( unsigned int k = 0; k < B; ++k )
+    {
+      gb[ k ] = g[ b + k * numberOfBlocks ];
+    }
+    for( unsigned int k = 0; k < B; ++k )
+    {
+      double sum = 0.0;
+      for( unsigned int l = 0; l < B; ++l )
+      {
+        sum += P[ k * B + l ] * gb[ l ];
+      }
+      g[ b + k * numberOfBlocks ] = sum;
+    }
+  }
+
+} // end PreconditionGradient()
+
+
+/**
+ * ***************** AdvanceOneStep *************************
+ */
+
+template< class TElastix >
+void
+PreconditionedStochasticGradientDescent< TElastix >
+::AdvanceOneStep( void )
+{
+  if( !this->m_PreconditionerInitialized )
+  {
+    this->m_UsePreconditioner         = this->ComputePreconditioner();
+    this->m_PreconditionerInitialized = true;
+    if( !this->m_UsePreconditioner )
+    {
+      xl::xout[ "warning" ]
+        << "WARNING: PreconditionedStochasticGradientDescent could not compute a self Hessian.\n"
+        << "  The preconditioner is switched off in this resolution." << std::endl;
+    }
+  }
+
+  if( this->m_UsePreconditioner )
+  {
+    this->PreconditionGradient();
+  }
+
+  /** Call the Superclass' implementation. */
+  this->Superclass::AdvanceOneStep();
+
+} // end AdvanceOneStep()
+
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxPreconditionedStochasticGradientDescent_hxx
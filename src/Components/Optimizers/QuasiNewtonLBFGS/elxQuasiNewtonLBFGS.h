@@ -75,6 +75,12 @@ namespace elastix
  *    line search.\n
  *    example: <tt>(LBFGSUpdateAccuracy 5 10 20)</tt> \n
  *    Default value: 5.\n
+ * \parameter LBFGSSinglePrecisionHistory: Whether to store the past iterations
+ *    in single precision. This halves the memory used by LBFGSUpdateAccuracy,
+ *    which matters for large B-spline grids; the search direction is still
+ *    computed in double precision.\n
+ *    example: <tt>(LBFGSSinglePrecisionHistory "false" "true")</tt> \n
+ *    Default value: "false".\n
  * \parameter StopIfWolfeNotSatisfied: Whether to stop the optimisation if in one iteration
  *    the Wolfe conditions can not be satisfied by the itk::MoreThuenteLineSearchOptimizer.\n
  *    In general it is wise to do so.\n
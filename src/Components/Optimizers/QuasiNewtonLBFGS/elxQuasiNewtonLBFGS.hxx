@@ -121,6 +121,14 @@ QuasiNewtonLBFGS< TElastix >::LineSearch(
   MeasureType & f,
   DerivativeType & g )
 {
+  /** Let the metrics cache the mapped samples along the search direction.
+   * The metrics work in the unscaled parameter space. */
+  ParametersType position  = x;
+  ParametersType direction = searchDir;
+  this->GetScaledCostFunction()->ConvertScaledToUnscaledParameters( position );
+  this->GetScaledCostFunction()->ConvertScaledToUnscaledParameters( direction );
+  this->BeginLineSearch( position, direction );
+
   /** Call the superclass's implementation and ignore a
    * LineSearchError. Just report the error and assume convergence. */
   try
@@ -129,6 +137,7 @@ QuasiNewtonLBFGS< TElastix >::LineSearch(
   }
   catch( itk::ExceptionObject & err )
   {
+    this->EndLineSearch();
     if( this->GetLineSearchOptimizer() == 0 )
     {
       throw err;
@@ -147,6 +156,8 @@ QuasiNewtonLBFGS< TElastix >::LineSearch(
       g    = this->GetCurrentGradient();
     }
   }
+  this->EndLineSearch();
+
 }   // end LineSearch
 
 
@@ -272,6 +283,12 @@ QuasiNewtonLBFGS< TElastix >
     "LBFGSUpdateAccuracy", this->GetComponentLabel(), level, 0 );
   this->SetMemory( LBFGSUpdateAccuracy );
 
+  /** Set the precision of the stored past iterations. */
+  bool singlePrecisionHistory = false;
+  this->m_Configuration->ReadParameter( singlePrecisionHistory,
+    "LBFGSSinglePrecisionHistory", this->GetComponentLabel(), level, 0 );
+  this->SetUseSinglePrecisionHistory( singlePrecisionHistory );
+
   /** Check whether to stop optimisation if Wolfe conditions are not satisfied. */
   this->m_StopIfWolfeNotSatisfied = true;
   std::string stopIfWolfeNotSatisfied = "true";
@@ -21,11 +21,108 @@
 
 #include "itkQuasiNewtonLBFGSOptimizer.h"
 #include "itkArray.h"
+#include "itkCPUDispatch.h"
+#include "itkPersistentThreadPool.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
+namespace
+{
+
+/** One pass of the two-loop recursion over r: r *= h when h is given,
+ * r += a * x when x is given, and otherwise only the inner product.
+ * The pass returns the inner product of z with the updated r, or 0 if z is NULL.
+ */
+template< class THistoryValue >
+struct TwoLoopPassType
+{
+  double *              m_R;
+  const THistoryValue * m_X;
+  const double *        m_H;
+  double                m_A;
+  const THistoryValue * m_Z;
+  SizeValueType         m_Size;
+  std::vector< double > m_PartialSums;
+};
+
+/** Below this number of parameters per thread, splitting a pass over the
+ * threads costs more than it saves. */
+const SizeValueType TwoLoopMinimumNumberOfParametersPerThread = 32768;
+
+template< class THistoryValue >
+double
+ExecuteTwoLoopPassRange( const TwoLoopPassType< THistoryValue > & pass,
+  const SizeValueType begin, const SizeValueType end )
+{
+  const SizeValueType   n = end - begin;
+  const THistoryValue * z = pass.m_Z ? pass.m_Z + begin : 0;
+  if( pass.m_H )
+  {
+    return CPUDispatch::MultiplyAndDot( pass.m_R + begin, pass.m_H + begin, z, n );
+  }
+  if( pass.m_X )
+  {
+    return CPUDispatch::AddScaledAndDot( pass.m_R + begin, pass.m_X + begin, pass.m_A, z, n );
+  }
+  return z ? CPUDispatch::Dot( z, pass.m_R + begin, n ) : 0.0;
+}
+
+
+template< class THistoryValue >
+ITK_THREAD_RETURN_TYPE
+TwoLoopPassThreaderCallback( void * arg )
+{
+  typedef PersistentThreadPool::ThreadInfoType ThreadInfoType;
+  ThreadInfoType *                   infoStruct = static_cast< ThreadInfoType * >( arg );
+  TwoLoopPassType< THistoryValue > * pass
+    = static_cast< TwoLoopPassType< THistoryValue > * >( infoStruct->UserData );
+
+  /** A contiguous range for each thread, a multiple of four long. */
+  const SizeValueType size            = pass->m_Size;
+  const SizeValueType numberOfThreads = infoStruct->NumberOfThreads;
+  const SizeValueType chunk
+    = ( ( size + numberOfThreads - 1 ) / numberOfThreads + 3 ) & ~static_cast< SizeValueType >( 3 );
+  const SizeValueType begin = std::min( infoStruct->ThreadID * chunk, size );
+  const SizeValueType end   = std::min( begin + chunk, size );
+
+  pass->m_PartialSums[ infoStruct->ThreadID ]
+    = begin < end ? ExecuteTwoLoopPassRange( *pass, begin, end ) : 0.0;
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** The partial sums of the threads are added in the order of the threads,
+ * so the result does not depend on their timing. */
+template< class THistoryValue >
+double
+ExecuteTwoLoopPass( TwoLoopPassType< THistoryValue > & pass,
+  const ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads < 2 )
+  {
+    return ExecuteTwoLoopPassRange( pass, 0, pass.m_Size );
+  }
+
+  pass.m_PartialSums.assign( numberOfThreads, 0.0 );
+  PersistentThreadPool::GetGlobalThreadPool()->SingleMethodExecute(
+    TwoLoopPassThreaderCallback< THistoryValue >, &pass, numberOfThreads );
+
+  double sum = 0.0;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    sum += pass.m_PartialSums[ i ];
+  }
+  return sum;
+}
+
+
+} // end namespace
+
 /**
  * ******************** Constructor *************************
  */
@@ -43,11 +140,14 @@ QuasiNewtonLBFGSOptimizer::QuasiNewtonLBFGSOptimizer()
   this->m_Point             = 0;
   this->m_PreviousPoint     = 0;
   this->m_Bound             = 0;
+  this->m_NumberOfParameters = 0;
 
   this->m_MaximumNumberOfIterations  = 100;
   this->m_GradientMagnitudeTolerance = 1e-5;
   this->m_LineSearchOptimizer        = 0;
   this->m_Memory                     = 5;
+  this->m_UseSinglePrecisionHistory  = false;
+  this->m_UseMultiThread             = true;
 
 }   // end constructor
 
@@ -80,10 +180,23 @@ QuasiNewtonLBFGSOptimizer::StartOptimization()
   this->m_CurrentGradient.SetSize( numberOfParameters );
   this->m_CurrentGradient.Fill( 0.0 );
 
-  /** Resize Rho, Alpha, S and Y. */
+  /** Resize Rho and YY, and allocate the history in the requested precision;
+   * the other buffer is freed. */
+  this->m_NumberOfParameters = numberOfParameters;
   this->m_Rho.SetSize( this->GetMemory() );
-  this->m_S.resize( this->GetMemory() );
-  this->m_Y.resize( this->GetMemory() );
+  this->m_YY.SetSize( this->GetMemory() );
+  const SizeValueType historySize
+    = 2 * static_cast< SizeValueType >( this->GetMemory() ) * numberOfParameters;
+  if( this->m_UseSinglePrecisionHistory )
+  {
+    std::vector< double >().swap( this->m_History );
+    this->m_SinglePrecisionHistory.resize( historySize );
+  }
+  else
+  {
+    std::vector< float >().swap( this->m_SinglePrecisionHistory );
+    this->m_History.resize( historySize );
+  }
 
   /** Initialize the scaledCostFunction with the currently set scales */
   this->InitializeScales();
@@ -244,9 +357,8 @@ QuasiNewtonLBFGSOptimizer::ComputeDiagonalMatrix( DiagonalMatrixType & diag_H0 )
 
   if( this->m_Bound > 0 )
   {
-    const DerivativeType & y  = this->m_Y[ this->m_PreviousPoint ];
-    const double           ys = 1.0 / this->m_Rho[ this->m_PreviousPoint ];
-    const double           yy = y.squared_magnitude();
+    const double ys = 1.0 / this->m_Rho[ this->m_PreviousPoint ];
+    const double yy = this->m_YY[ this->m_PreviousPoint ];
     fill_value = ys / yy;
     if( fill_value <= 0. )
     {
@@ -271,65 +383,115 @@ QuasiNewtonLBFGSOptimizer::ComputeSearchDirection(
 {
   itkDebugMacro( "ComputeSearchDirection" );
 
-  /** Assumes m_Rho, m_S, and m_Y are up-to-date at m_PreviousPoint */
+  /** Assumes m_Rho and the history are up-to-date at m_PreviousPoint */
 
-  typedef Array< double > AlphaType;
-  AlphaType alpha( this->GetMemory() );
-
-  const unsigned int numberOfParameters = gradient.GetSize();
   DiagonalMatrixType H0;
   this->ComputeDiagonalMatrix( H0 );
 
   searchDir = -gradient;
 
-  int cp = static_cast< int >( this->m_Point );
+  if( this->m_UseSinglePrecisionHistory )
+  {
+    this->ComputeSearchDirectionTwoLoop( this->m_SinglePrecisionHistory.empty()
+      ? 0 : &this->m_SinglePrecisionHistory[ 0 ], H0, searchDir.data_block() );
+  }
+  else
+  {
+    this->ComputeSearchDirectionTwoLoop( this->m_History.empty()
+      ? 0 : &this->m_History[ 0 ], H0, searchDir.data_block() );
+  }
 
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
+  /** Normalize if no information about previous steps is available yet */
+  if( this->m_Bound == 0 )
   {
-    --cp;
-    if( cp == -1 )
-    {
-      cp = this->GetMemory() - 1;
-    }
-    const double sq = inner_product( this->m_S[ cp ], searchDir );
-    alpha[ cp ] = this->m_Rho[ cp ] * sq;
-    const double &         alpha_cp = alpha[ cp ];
-    const DerivativeType & y        = this->m_Y[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] -= alpha_cp * y[ j ];
-    }
+    searchDir /= gradient.magnitude();
   }
 
-  for( unsigned int j = 0; j < numberOfParameters; ++j )
+}   // end ComputeSearchDirection
+
+
+/**
+ * *********************** ComputeSearchDirectionTwoLoop ************************
+ */
+
+template< class THistoryValue >
+void
+QuasiNewtonLBFGSOptimizer::ComputeSearchDirectionTwoLoop(
+  const THistoryValue * history,
+  const DiagonalMatrixType & H0,
+  double * searchDir )
+{
+  const SizeValueType   numberOfParameters = this->m_NumberOfParameters;
+  const unsigned int    memory             = this->GetMemory();
+  const unsigned int    bound              = this->m_Bound;
+  const THistoryValue * S                  = history;
+  const THistoryValue * Y                  = history + memory * numberOfParameters;
+
+  /** The entries from the newest to the oldest. */
+  std::vector< SizeValueType > order( bound );
+  for( unsigned int i = 0; i < bound; ++i )
   {
-    searchDir[ j ] *= H0[ j ];
+    order[ i ] = ( this->m_Point + memory - 1 - i ) % memory;
   }
 
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
+  /** The number of threads of each pass. */
+  ThreadIdType numberOfThreads = 1;
+  if( this->m_UseMultiThread )
   {
-    const double           yr             = inner_product( this->m_Y[ cp ], searchDir );
-    const double           beta           = this->m_Rho[ cp ] * yr;
-    const double           alpha_min_beta = alpha[ cp ] - beta;
-    const ParametersType & s              = this->m_S[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] += alpha_min_beta * s[ j ];
-    }
-    ++cp;
-    if( static_cast< unsigned int >( cp ) == this->GetMemory() )
-    {
-      cp = 0;
-    }
+    numberOfThreads = static_cast< ThreadIdType >( std::min(
+      static_cast< SizeValueType >( PersistentThreadPool::GetGlobalThreadPool()->GetNumberOfThreads() ),
+      std::max( numberOfParameters / TwoLoopMinimumNumberOfParametersPerThread,
+      static_cast< SizeValueType >( 1 ) ) ) );
   }
 
-  /** Normalize if no information about previous steps is available yet */
-  if( this->m_Bound == 0 )
+  TwoLoopPassType< THistoryValue > pass;
+  pass.m_R    = searchDir;
+  pass.m_X    = 0;
+  pass.m_H    = 0;
+  pass.m_A    = 0.0;
+  pass.m_Z    = 0;
+  pass.m_Size = numberOfParameters;
+
+  /** First loop, from the newest entry to the oldest: alpha_i = rho_i s_i'q,
+   * and q -= alpha_i y_i. Each update of q also computes s'q of the next entry. */
+  Array< double > alpha( memory );
+  double          sq = 0.0;
+  if( bound > 0 )
   {
-    searchDir /= gradient.magnitude();
+    pass.m_Z = S + order[ 0 ] * numberOfParameters;
+    sq       = ExecuteTwoLoopPass( pass, numberOfThreads );
+  }
+  for( unsigned int i = 0; i < bound; ++i )
+  {
+    const SizeValueType cp = order[ i ];
+    alpha[ cp ] = this->m_Rho[ cp ] * sq;
+    pass.m_X    = Y + cp * numberOfParameters;
+    pass.m_A    = -alpha[ cp ];
+    pass.m_Z    = ( i + 1 < bound ) ? S + order[ i + 1 ] * numberOfParameters : 0;
+    sq          = ExecuteTwoLoopPass( pass, numberOfThreads );
   }
 
-}   // end ComputeSearchDirection
+  /** r = H0 q, which also computes y'r of the oldest entry. */
+  pass.m_X = 0;
+  pass.m_H = H0.data_block();
+  pass.m_Z = ( bound > 0 ) ? Y + order[ bound - 1 ] * numberOfParameters : 0;
+  double yr = ExecuteTwoLoopPass( pass, numberOfThreads );
+  pass.m_H = 0;
+
+  /** Second loop, from the oldest entry to the newest: beta_i = rho_i y_i'r,
+   * and r += ( alpha_i - beta_i ) s_i. Each update of r also computes y'r
+   * of the next entry. */
+  for( unsigned int i = bound; i > 0; --i )
+  {
+    const SizeValueType cp   = order[ i - 1 ];
+    const double        beta = this->m_Rho[ cp ] * yr;
+    pass.m_X = S + cp * numberOfParameters;
+    pass.m_A = alpha[ cp ] - beta;
+    pass.m_Z = ( i > 1 ) ? Y + order[ i - 2 ] * numberOfParameters : 0;
+    yr       = ExecuteTwoLoopPass( pass, numberOfThreads );
+  }
+
+}   // end ComputeSearchDirectionTwoLoop
 
 
 /**
@@ -407,9 +569,28 @@ QuasiNewtonLBFGSOptimizer::StoreCurrentPoint(
 {
   itkDebugMacro( "StoreCurrentPoint" );
 
-  this->m_S[ this->m_Point ]   = step;                                  // s
-  this->m_Y[ this->m_Point ]   = grad_dif;                              // y
+  const SizeValueType numberOfParameters = this->m_NumberOfParameters;
+  const SizeValueType sOffset            = this->m_Point * numberOfParameters;
+  const SizeValueType yOffset            = ( this->GetMemory() + this->m_Point ) * numberOfParameters;
+  if( this->m_UseSinglePrecisionHistory )
+  {
+    float * s = &this->m_SinglePrecisionHistory[ sOffset ];
+    float * y = &this->m_SinglePrecisionHistory[ yOffset ];
+    for( SizeValueType j = 0; j < numberOfParameters; ++j )
+    {
+      s[ j ] = static_cast< float >( step[ j ] );
+      y[ j ] = static_cast< float >( grad_dif[ j ] );
+    }
+  }
+  else
+  {
+    std::copy( step.begin(), step.end(), this->m_History.begin() + sOffset );
+    std::copy( grad_dif.begin(), grad_dif.end(), this->m_History.begin() + yOffset );
+  }
+
+  /** In double precision, also with a single precision history. */
   this->m_Rho[ this->m_Point ] = 1.0 / inner_product( step, grad_dif ); // 1/ys
+  this->m_YY[ this->m_Point ]  = grad_dif.squared_magnitude();          // yy
 
 }   // end StoreCurrentPoint
 
@@ -454,6 +635,19 @@ QuasiNewtonLBFGSOptimizer::TestConvergence( bool firstLineSearchDone )
 }   // end TestConvergence
 
 
+/**
+ * ********************* GetHistoryMemoryUsage ************************
+ */
+
+SizeValueType
+QuasiNewtonLBFGSOptimizer::GetHistoryMemoryUsage( void ) const
+{
+  return this->m_History.capacity() * sizeof( double )
+         + this->m_SinglePrecisionHistory.capacity() * sizeof( float );
+
+}   // end GetHistoryMemoryUsage
+
+
 } // end namespace itk
 
 #endif // #ifndef __itkQuasiNewtonLBFGSOptimizer_cxx
@@ -21,6 +21,7 @@
 
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "itkLineSearchOptimizer.h"
+#include "itkIntTypes.h"
 #include <vector>
 
 namespace itk
@@ -51,6 +52,13 @@ namespace itk
  * The steplength is determined at each iteration by means of a
  * line search routine. The itk::MoreThuenteLineSearchOptimizer works well.
  *
+ * The \f$M\f$ pairs of steps \f$s\f$ and gradient differences \f$y\f$ are
+ * kept in one contiguous ring buffer, optionally in single precision, see
+ * SetUseSinglePrecisionHistory(). The two-loop recursion fuses each update of
+ * the search direction with the inner product of the next step, so that it
+ * passes over the history once, and splits these passes over the threads of
+ * the itk::PersistentThreadPool for large numbers of parameters.
+ *
  *
  * \ingroup Numerics Optimizers
  */
@@ -74,11 +82,9 @@ public:
   typedef Superclass::MeasureType            MeasureType;
   typedef Superclass::ScalesType             ScalesType;
 
-  typedef Array< double >               RhoType;
-  typedef std::vector< ParametersType > SType;
-  typedef std::vector< DerivativeType > YType;
-  typedef Array< double >               DiagonalMatrixType;
-  typedef LineSearchOptimizer           LineSearchOptimizerType;
+  typedef Array< double >     RhoType;
+  typedef Array< double >     DiagonalMatrixType;
+  typedef LineSearchOptimizer LineSearchOptimizerType;
 
   typedef LineSearchOptimizerType::Pointer LineSearchOptimizerPointer;
 
@@ -129,6 +135,23 @@ public:
   itkSetClampMacro( Memory, unsigned int, 0, NumericTraits< unsigned int >::max() );
   itkGetConstMacro( Memory, unsigned int );
 
+  /** Setting: store the steps s and gradient differences y in single
+   * precision. This halves the memory of the history, and the memory traffic
+   * of the search direction computation, which is still done in double
+   * precision. False by default. Takes effect in StartOptimization(). */
+  itkSetMacro( UseSinglePrecisionHistory, bool );
+  itkGetConstMacro( UseSinglePrecisionHistory, bool );
+  itkBooleanMacro( UseSinglePrecisionHistory );
+
+  /** Setting: split the search direction computation over threads, when
+   * there are many parameters. True by default. */
+  itkSetMacro( UseMultiThread, bool );
+  itkGetConstMacro( UseMultiThread, bool );
+  itkBooleanMacro( UseMultiThread );
+
+  /** The memory of the history, in bytes. */
+  SizeValueType GetHistoryMemoryUsage( void ) const;
+
 protected:
 
   QuasiNewtonLBFGSOptimizer();
@@ -147,9 +170,16 @@ protected:
   /** Is true when the LineSearchOptimizer has been started. */
   bool m_InLineSearch;
 
+  /** 1/(ys) and yy of each entry of the history. */
   RhoType m_Rho;
-  SType   m_S;
-  YType   m_Y;
+  RhoType m_YY;
+
+  /** The history: Memory steps s followed by Memory gradient differences y,
+   * each of length m_NumberOfParameters. Only one of the two buffers is used,
+   * depending on UseSinglePrecisionHistory. */
+  std::vector< double > m_History;
+  std::vector< float >  m_SinglePrecisionHistory;
+  SizeValueType         m_NumberOfParameters;
 
   unsigned int m_Point;
   unsigned int m_PreviousPoint;
@@ -184,7 +214,7 @@ protected:
     MeasureType & f,
     DerivativeType & g );
 
-  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in m_S and m_Y,
+  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in the history at m_Point,
    * and store 1/(ys) in m_Rho. */
   virtual void StoreCurrentPoint(
     const ParametersType & step,
@@ -205,6 +235,13 @@ private:
   double                     m_GradientMagnitudeTolerance;
   LineSearchOptimizerPointer m_LineSearchOptimizer;
   unsigned int               m_Memory;
+  bool                       m_UseSinglePrecisionHistory;
+  bool                       m_UseMultiThread;
+
+  /** The two-loop recursion, for a history in double or single precision. */
+  template< class THistoryValue >
+  void ComputeSearchDirectionTwoLoop( const THistoryValue * history,
+    const DiagonalMatrixType & H0, double * searchDir );
 
 };
 
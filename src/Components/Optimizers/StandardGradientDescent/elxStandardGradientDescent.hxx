@@ -123,7 +123,23 @@ StandardGradientDescent< TElastix >
   /** Print some information */
   xl::xout[ "iteration" ][ "2:Metric" ] << this->GetValue();
   xl::xout[ "iteration" ][ "3:StepSize" ] << this->GetLearningRate();
-  xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradient().magnitude();
+  const double gradientMagnitude = this->GetGradient().magnitude();
+  xl::xout[ "iteration" ][ "4:||Gradient||" ] << gradientMagnitude;
+
+  /** Stop when the convergence test of the OptimizerBase passes. */
+  if( this->CheckConvergence( this->GetValue(),
+    this->GetScaledCurrentPosition(), gradientMagnitude ) )
+  {
+    this->m_StopCondition = ConvergenceDetected;
+    this->StopOptimization();
+  }
+
+  /** Stop when the next iteration would exceed the time budget. */
+  if( this->CheckTimeBudget() )
+  {
+    this->m_StopCondition = MaximumTimeExceeded;
+    this->StopOptimization();
+  }
 
   /** Select new spatial samples for the computation of the metric */
   if( this->GetNewSamplesEveryIteration() )
@@ -144,7 +160,8 @@ StandardGradientDescent< TElastix >
 ::AfterEachResolution( void )
 {
   /**
-   * enum   StopConditionType {  MaximumNumberOfIterations, MetricError }
+   * enum   StopConditionType {  MaximumNumberOfIterations, MetricError,
+   *   MinimumStepSize, ConvergenceDetected, MaximumTimeExceeded }
    */
   std::string stopcondition;
   switch( this->GetStopCondition() )
@@ -158,6 +175,14 @@ StandardGradientDescent< TElastix >
       stopcondition = "Error in metric";
       break;
 
+    case ConvergenceDetected:
+      stopcondition = "The convergence criteria have been satisfied";
+      break;
+
+    case MaximumTimeExceeded:
+      stopcondition = "The maximum registration time has been reached";
+      break;
+
     default:
       stopcondition = "Unknown";
       break;
@@ -21,6 +21,10 @@
 #include "itkCommand.h"
 #include "itkEventObject.h"
 #include "itkExceptionObject.h"
+#include "itkPersistentThreadPool.h"
+#include "itkCPUDispatch.h"
+
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -81,6 +85,7 @@ GradientDescentOptimizer2
   os << std::endl;
   os << indent << "Gradient: " << this->m_Gradient;
   os << std::endl;
+  os << indent << "NumberOfActiveParameterRanges: " << this->m_ActiveParameterRanges.size() << std::endl;
 
 } // end PrintSelf()
 
@@ -218,15 +223,33 @@ GradientDescentOptimizer2
 
   /** Advance one step. */
 #ifndef ELASTIX_USE_OPENMP // If no OpenMP detected then use single-threaded code
-  /** Get a reference to the current position. */
-  const ParametersType & currentPosition = this->GetScaledCurrentPosition();
-
-  /** Update the new position. */
-  for( unsigned int j = 0; j < spaceDimension; ++j )
+  if( this->m_UseMultiThread && this->m_Threader->GetNumberOfThreads() > 1 )
   {
-    newPosition[ j ] = currentPosition[ j ] - this->m_LearningRate * this->m_Gradient[ j ];
+    /** Fill the threader parameter struct with information. */
+    MultiThreaderParameterType temp;
+    temp.t_NewPosition = &newPosition;
+    temp.t_Optimizer   = this;
+
+    /** Call multi-threaded AdvanceOneStep(). The persistent pool avoids
+     * creating threads in every iteration. */
+    PersistentThreadPool::GetGlobalThreadPool()->SingleMethodExecute(
+      AdvanceOneStepThreaderCallback, &temp, this->m_Threader->GetNumberOfThreads() );
+  }
+  else
+  {
+    /** Update the position in place, mu_{k+1} = mu_k - a_k * gradient_k.
+     * newPosition is the current position, so the kernel reads and writes
+     * the same array, in the variant that fits the CPU. */
+    this->SubtractScaledGradient( newPosition, 0, spaceDimension );
   }
 #else // Otherwise use OpenMP
+  if( !this->m_ActiveParameterRanges.empty() )
+  {
+    this->SubtractScaledGradient( newPosition, 0, spaceDimension );
+    this->InvokeEvent( IterationEvent() );
+    return;
+  }
+
   /** Get a reference to the current position. */
   const ParametersType & currentPosition = this->GetScaledCurrentPosition();
 
@@ -349,18 +372,74 @@ GradientDescentOptimizer2
   unsigned int       jmax = ( threadId + 1 ) * subSize;
   jmax = ( jmax > spaceDimension ) ? spaceDimension : jmax;
 
-  /** Get a reference to the current position. */
-  const ParametersType & currentPosition = this->GetScaledCurrentPosition();
-  const double           learningRate    = this->m_LearningRate;
-  const DerivativeType & gradient        = this->m_Gradient;
+  /** Advance one step in place: mu_{k+1} = mu_k - a_k * gradient_k.
+   * newPosition is the current position. */
+  this->SubtractScaledGradient( newPosition, jmin, jmax );
+
+} // end ThreadedAdvanceOneStep()
+
 
-  /** Advance one step: mu_{k+1} = mu_k - a_k * gradient_k */
-  for( unsigned int j = jmin; j < jmax; j++ )
+/**
+ * ************ SubtractScaledGradient ****************************
+ */
+
+void
+GradientDescentOptimizer2
+::SubtractScaledGradient( ParametersType & position,
+  const unsigned long jmin, const unsigned long jmax ) const
+{
+  if( this->m_ActiveParameterRanges.empty() )
   {
-    newPosition[ j ] = currentPosition[ j ] - learningRate * gradient[ j ];
+    if( jmin < jmax )
+    {
+      CPUDispatch::SubtractScaled( position.data_block() + jmin,
+        this->m_Gradient.data_block() + jmin, this->m_LearningRate, jmax - jmin );
+    }
+    return;
   }
 
-} // end ThreadedAdvanceOneStep()
+  /** Only the parts of the active ranges inside [ jmin, jmax [. */
+  for( std::size_t r = 0; r < this->m_ActiveParameterRanges.size(); ++r )
+  {
+    const unsigned long begin = std::max( this->m_ActiveParameterRanges[ r ].first, jmin );
+    const unsigned long end   = std::min( this->m_ActiveParameterRanges[ r ].second, jmax );
+    if( begin < end )
+    {
+      CPUDispatch::SubtractScaled( position.data_block() + begin,
+        this->m_Gradient.data_block() + begin, this->m_LearningRate, end - begin );
+    }
+  }
+
+} // end SubtractScaledGradient()
+
+
+/**
+ * ************ ActiveInnerProduct ****************************
+ */
+
+double
+GradientDescentOptimizer2
+::ActiveInnerProduct( const DerivativeType & a, const DerivativeType & b ) const
+{
+  if( this->m_ActiveParameterRanges.empty() )
+  {
+    return CPUDispatch::Dot( a.data_block(), b.data_block(), a.GetSize() );
+  }
+
+  double sum = 0.0;
+  for( std::size_t r = 0; r < this->m_ActiveParameterRanges.size(); ++r )
+  {
+    const unsigned long begin = this->m_ActiveParameterRanges[ r ].first;
+    const unsigned long end   = std::min(
+      this->m_ActiveParameterRanges[ r ].second, static_cast< unsigned long >( a.GetSize() ) );
+    if( begin < end )
+    {
+      sum += CPUDispatch::Dot( a.data_block() + begin, b.data_block() + begin, end - begin );
+    }
+  }
+  return sum;
+
+} // end ActiveInnerProduct()
 
 
 } // end namespace itk
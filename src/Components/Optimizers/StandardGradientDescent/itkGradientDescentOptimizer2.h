@@ -21,6 +21,9 @@
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "itkMultiThreader.h"
 
+#include <utility>
+#include <vector>
+
 namespace itk
 {
 
@@ -76,13 +79,19 @@ public:
   typedef Superclass::ScaledCostFunctionType    ScaledCostFunctionType;
   typedef Superclass::ScaledCostFunctionPointer ScaledCostFunctionPointer;
 
+  /** The active parameters, as sorted, disjoint ranges [ begin, end [. */
+  typedef std::pair< unsigned long, unsigned long > ActiveParameterRangeType;
+  typedef std::vector< ActiveParameterRangeType >   ActiveParameterRangesType;
+
   /** Codes of stopping conditions
-   * The MinimumStepSize stopcondition never occurs, but may
-   * be implemented in inheriting classes */
+   * The MinimumStepSize, ConvergenceDetected and MaximumTimeExceeded
+   * stopconditions never occur, but may be implemented in inheriting classes */
   typedef enum {
     MaximumNumberOfIterations,
     MetricError,
-    MinimumStepSize
+    MinimumStepSize,
+    ConvergenceDetected,
+    MaximumTimeExceeded
   } StopConditionType;
 
   /** Advance one step following the gradient direction. */
@@ -137,10 +146,30 @@ public:
 
 
   //itkGetConstReferenceMacro( NumberOfThreads, ThreadIdType );
+
+  /** Use the threads of the persistent thread pool to update the position.
+   * Only worthwhile for very large parameter vectors; ignored when elastix
+   * is compiled with OpenMP, which is used instead. Default: false. */
   itkSetMacro( UseMultiThread, bool );
+  itkGetConstMacro( UseMultiThread, bool );
   itkSetMacro( UseOpenMP, bool );
   itkSetMacro( UseEigen, bool );
 
+  /** Restrict the updates of the position to the active parameters. The
+   * other parameters are kept fixed, and left out of the vector operations
+   * of every iteration; typically their gradient is zero, because no sample
+   * lies in the support of these B-spline coefficients. An empty container,
+   * the default, means that all parameters are active.
+   */
+  void SetActiveParameterRanges( const ActiveParameterRangesType & ranges )
+  {
+    this->m_ActiveParameterRanges = ranges;
+    this->Modified();
+  }
+
+
+  itkGetConstReferenceMacro( ActiveParameterRanges, ActiveParameterRangesType );
+
 protected:
 
   GradientDescentOptimizer2();
@@ -164,6 +193,15 @@ protected:
   unsigned long m_NumberOfIterations;
   unsigned long m_CurrentIteration;
 
+  ActiveParameterRangesType m_ActiveParameterRanges;
+
+  /** position -= learningRate * gradient, for the active parameters in [ jmin, jmax [. */
+  void SubtractScaledGradient( ParametersType & position,
+    const unsigned long jmin, const unsigned long jmax ) const;
+
+  /** The inner product of two vectors, over the active parameters only. */
+  double ActiveInnerProduct( const DerivativeType & a, const DerivativeType & b ) const;
+
 private:
 
   GradientDescentOptimizer2( const Self & ); // purposely not implemented
@@ -0,0 +1,160 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxVarianceReducedStochasticGradientDescent_h
+#define __elxVarianceReducedStochasticGradientDescent_h
+
+#include "../AdaptiveStochasticGradientDescent/elxAdaptiveStochasticGradientDescent.h"
+
+namespace elastix
+{
+/**
+ * \class VarianceReducedStochasticGradientDescent
+ * \brief An adaptive stochastic gradient descent optimizer with a
+ * variance-reduced gradient.
+ *
+ * This optimizer is the AdaptiveStochasticGradientDescent optimizer, including its
+ * automatic parameter estimation, with the stochastic gradient replaced by the
+ * variance-reduced gradient of SVRG:
+ *
+ * \f[ g_k = \nabla f_{S_k}( \mu_k ) - \nabla f_{S_k}( \tilde{\mu} ) + \nabla f( \tilde{\mu} ), \f]
+ *
+ * with \f$S_k\f$ the random samples of iteration \f$k\f$, \f$\tilde{\mu}\f$ the
+ * anchor position, and \f$\nabla f( \tilde{\mu} )\f$ the anchor gradient. Every
+ * VarianceReductionAnchorPeriod iterations the current position becomes the anchor,
+ * and the anchor gradient is computed with samples on a uniform grid, like the
+ * 'exact' gradient of the automatic parameter estimation. The correction
+ * \f$\nabla f_{S_k}( \mu_k ) - \nabla f_{S_k}( \tilde{\mu} )\f$ uses the same samples
+ * at both positions, so its noise vanishes as \f$\mu_k\f$ approaches the anchor.
+ *
+ * Each iteration evaluates the metric derivative twice, and each anchor once on the
+ * grid samples. In return, fewer iterations are needed for the same accuracy.
+ * The optimizer only makes sense with a random sampler and
+ * (NewSamplesEveryIteration "true"). Otherwise it behaves like AdaptiveStochasticGradientDescent.
+ *
+ * The parameters used in this class are those of AdaptiveStochasticGradientDescent, and:
+ * \parameter Optimizer: Select this optimizer as follows:\n
+ *   <tt>(Optimizer "VarianceReducedStochasticGradientDescent")</tt>
+ * \parameter VarianceReductionAnchorPeriod: The number of iterations after which
+ *   a new anchor is chosen. The parameter can be specified for each resolution,
+ *   or for all resolutions at once.\n
+ *   example: <tt>(VarianceReductionAnchorPeriod 50 50 100)</tt>\n
+ *   Default value: 50.
+ * \parameter NumberOfSamplesForAnchorGradient: The number of image samples used to
+ *   compute the anchor gradient. The samples are chosen on a uniform grid.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(NumberOfSamplesForAnchorGradient 100000)</tt>\n
+ *   Default: the value of NumberOfSamplesForExactGradient, 100000.
+ *
+ * \sa AdaptiveStochasticGradientDescent
+ * \ingroup Optimizers
+ */
+
+template< class TElastix >
+class VarianceReducedStochasticGradientDescent :
+  public AdaptiveStochasticGradientDescent< TElastix >
+{
+public:
+
+  /** Standard ITK. */
+  typedef VarianceReducedStochasticGradientDescent    Self;
+  typedef AdaptiveStochasticGradientDescent< TElastix > Superclass;
+  typedef itk::SmartPointer< Self >                   Pointer;
+  typedef itk::SmartPointer< const Self >             ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( VarianceReducedStochasticGradientDescent,
+    AdaptiveStochasticGradientDescent );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific optimizer.
+   * example: <tt>(Optimizer "VarianceReducedStochasticGradientDescent")</tt>\n
+   */
+  elxClassNameMacro( "VarianceReducedStochasticGradientDescent" );
+
+  /** Typedef's inherited from Superclass. */
+  typedef typename Superclass::ParametersType ParametersType;
+  typedef typename Superclass::DerivativeType DerivativeType;
+  typedef typename Superclass::SizeValueType  SizeValueType;
+
+  /** Methods invoked by elastix, in which parameters can be set and
+   * progress information can be printed.
+   */
+  virtual void BeforeEachResolution( void );
+
+  virtual void AfterEachResolution( void );
+
+  /** Replace the stochastic gradient by the variance-reduced gradient,
+   * after that call the Superclass' implementation.
+   */
+  virtual void AdvanceOneStep( void );
+
+  /** Set/Get the number of iterations between two anchors. */
+  itkSetClampMacro( AnchorPeriod, SizeValueType, 1, itk::NumericTraits< SizeValueType >::max() );
+  itkGetConstMacro( AnchorPeriod, SizeValueType );
+
+protected:
+
+  /** Protected typedefs. */
+  typedef typename Superclass::ImageRandomSamplerBasePointer ImageRandomSamplerBasePointer;
+  typedef typename Superclass::ImageRandomSamplerBaseType    ImageRandomSamplerBaseType;
+  typedef typename Superclass::ImageGridSamplerType          ImageGridSamplerType;
+  typedef typename Superclass::ImageGridSamplerPointer       ImageGridSamplerPointer;
+  typedef typename Superclass::ImageSamplerBasePointer       ImageSamplerBasePointer;
+
+  VarianceReducedStochasticGradientDescent();
+  virtual ~VarianceReducedStochasticGradientDescent() {}
+
+  /** Set up the grid samplers for the anchor gradient, one for each metric
+   * with a random sampler. Returns false if no metric has one. */
+  virtual bool InitializeAnchorSamplers( void );
+
+  /** Make the given position the anchor and compute the anchor gradient. */
+  virtual void ComputeAnchorGradient( const ParametersType & position );
+
+  SizeValueType m_AnchorPeriod;
+  SizeValueType m_NumberOfSamplesForAnchorGradient;
+
+private:
+
+  VarianceReducedStochasticGradientDescent( const Self & ); // purposely not implemented
+  void operator=( const Self & );                           // purposely not implemented
+
+  /** The random and grid samplers of each metric; NULL if the metric has
+   * no random sampler. */
+  std::vector< ImageRandomSamplerBasePointer > m_AnchorRandomSamplers;
+  std::vector< ImageGridSamplerPointer >       m_AnchorGridSamplers;
+
+  bool           m_UseVarianceReduction;
+  bool           m_AnchorSamplersInitialized;
+  ParametersType m_AnchorPosition;
+  DerivativeType m_AnchorGradient;
+  DerivativeType m_AnchorStochasticGradient;
+  SizeValueType  m_NumberOfAnchors;
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxVarianceReducedStochasticGradientDescent.hxx"
+#endif
+
+#endif // end #ifndef __elxVarianceReducedStochasticGradientDescent_h
@@ -0,0 +1,272 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxVarianceReducedStochasticGradientDescent_hxx
+#define __elxVarianceReducedStochasticGradientDescent_hxx
+
+#include "elxVarianceReducedStochasticGradientDescent.h"
+
+namespace elastix
+{
+
+/**
+ * ********************** Constructor ***********************
+ */
+
+template< class TElastix >
+VarianceReducedStochasticGradientDescent< TElastix >
+::VarianceReducedStochasticGradientDescent()
+{
+  this->m_AnchorPeriod                     = 50;
+  this->m_NumberOfSamplesForAnchorGradient = 100000;
+  this->m_UseVarianceReduction             = false;
+  this->m_AnchorSamplersInitialized        = false;
+  this->m_NumberOfAnchors                  = 0;
+
+} // end Constructor()
+
+
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+VarianceReducedStochasticGradientDescent< TElastix >
+::BeforeEachResolution( void )
+{
+  /** Call the Superclass' implementation. */
+  this->Superclass::BeforeEachResolution();
+
+  /** Get the current resolution level. */
+  unsigned int level = static_cast< unsigned int >(
+    this->m_Registration->GetAsITKBaseType()->GetCurrentLevel() );
+
+  /** Set the number of iterations between two anchors. */
+  SizeValueType anchorPeriod = 50;
+  this->GetConfiguration()->ReadParameter( anchorPeriod,
+    "VarianceReductionAnchorPeriod", this->GetComponentLabel(), level, 0 );
+  this->SetAnchorPeriod( anchorPeriod );
+
+  /** Set the number of samples for the anchor gradient. */
+  this->m_NumberOfSamplesForAnchorGradient = this->m_NumberOfSamplesForExactGradient;
+  this->GetConfiguration()->ReadParameter( this->m_NumberOfSamplesForAnchorGradient,
+    "NumberOfSamplesForAnchorGradient", this->GetComponentLabel(), level, 0 );
+
+  /** The samplers are set up at the first iteration, when the metrics are ready. */
+  this->m_AnchorRandomSamplers.clear();
+  this->m_AnchorGridSamplers.clear();
+  this->m_AnchorSamplersInitialized = false;
+  this->m_UseVarianceReduction      = false;
+  this->m_NumberOfAnchors           = 0;
+
+} // end BeforeEachResolution()
+
+
+/**
+ * ***************** AfterEachResolution *************************
+ */
+
+template< class TElastix >
+void
+VarianceReducedStochasticGradientDescent< TElastix >
+::AfterEachResolution( void )
+{
+  /** Call the Superclass' implementation. */
+  this->Superclass::AfterEachResolution();
+
+  if( this->m_UseVarianceReduction )
+  {
+    elxout << "Number of anchor gradients computed: "
+           << this->m_NumberOfAnchors << std::endl;
+  }
+
+  /** Release the grid samples and the anchor vectors. */
+  this->m_AnchorRandomSamplers.clear();
+  this->m_AnchorGridSamplers.clear();
+  this->m_AnchorPosition.SetSize( 0 );
+  this->m_AnchorGradient.SetSize( 0 );
+  this->m_AnchorStochasticGradient.SetSize( 0 );
+
+} // end AfterEachResolution()
+
+
+/**
+ * ***************** InitializeAnchorSamplers *************************
+ */
+
+template< class TElastix >
+bool
+VarianceReducedStochasticGradientDescent< TElastix >
+::InitializeAnchorSamplers( void )
+{
+  /** Without new samples every iteration the gradient is not stochastic. */
+  if( !this->GetNewSamplesEveryIteration() )
+  {
+    return false;
+  }
+
+  /** Get each sampler, and check if it is a kind of random sampler. If yes,
+   * prepare a grid sampler for the anchor gradient, like SampleGradients().
+   */
+  const unsigned int M = this->GetElastix()->GetNumberOfMetrics();
+  this->m_AnchorRandomSamplers.assign( M, 0 );
+  this->m_AnchorGridSamplers.assign( M, 0 );
+  bool stochasticgradients = false;
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    ImageSamplerBasePointer sampler
+      = this->GetElastix()->GetElxMetricBase( m )->GetAdvancedMetricImageSampler();
+    ImageRandomSamplerBasePointer randomSampler
+      = dynamic_cast< ImageRandomSamplerBaseType * >( sampler.GetPointer() );
+    if( randomSampler.IsNull() )
+    {
+      continue;
+    }
+    stochasticgradients = true;
+
+    ImageGridSamplerPointer gridSampler = ImageGridSamplerType::New();
+    gridSampler->SetInput( randomSampler->GetInput() );
+    gridSampler->SetInputImageRegion( randomSampler->GetInputImageRegion() );
+    gridSampler->SetMask( randomSampler->GetMask() );
+    gridSampler->SetNumberOfSamples( this->m_NumberOfSamplesForAnchorGradient );
+    gridSampler->Update();
+
+    this->m_AnchorRandomSamplers[ m ] = randomSampler;
+    this->m_AnchorGridSamplers[ m ]   = gridSampler;
+  }
+
+  return stochasticgradients;
+
+} // end InitializeAnchorSamplers()
+
+
+/**
+ * ***************** ComputeAnchorGradient *************************
+ */
+
+template< class TElastix >
+void
+VarianceReducedStochasticGradientDescent< TElastix >
+::ComputeAnchorGradient( const ParametersType & position )
+{
+  this->m_AnchorPosition = position;
+
+  /** Set the grid sampler(s) and get the anchor gradient. */
+  const unsigned int M = static_cast< unsigned int >( this->m_AnchorGridSamplers.size() );
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    if( this->m_AnchorGridSamplers[ m ].IsNotNull() )
+    {
+      this->GetElastix()->GetElxMetricBase( m )
+      ->SetAdvancedMetricImageSampler( this->m_AnchorGridSamplers[ m ] );
+    }
+  }
+
+  try
+  {
+    this->GetScaledDerivativeWithExceptionHandling(
+      this->m_AnchorPosition, this->m_AnchorGradient );
+  }
+  catch( itk::ExceptionObject & )
+  {
+    /** Restore the random samplers before passing on the error. */
+    for( unsigned int m = 0; m < M; ++m )
+    {
+      if( this->m_AnchorRandomSamplers[ m ].IsNotNull() )
+      {
+        this->GetElastix()->GetElxMetricBase( m )
+        ->SetAdvancedMetricImageSampler( this->m_AnchorRandomSamplers[ m ] );
+      }
+    }
+    throw;
+  }
+
+  /** Set the random sampler(s) back. Their current samples are unchanged. */
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    if( this->m_AnchorRandomSamplers[ m ].IsNotNull() )
+    {
+      this->GetElastix()->GetElxMetricBase( m )
+      ->SetAdvancedMetricImageSampler( this->m_AnchorRandomSamplers[ m ] );
+    }
+  }
+
+  ++this->m_NumberOfAnchors;
+
+} // end ComputeAnchorGradient()
+
+
+/**
+ * ***************** AdvanceOneStep *************************
+ */
+
+template< class TElastix >
+void
+VarianceReducedStochasticGradientDescent< TElastix >
+::AdvanceOneStep( void )
+{
+  if( !this->m_AnchorSamplersInitialized )
+  {
+    this->m_UseVarianceReduction      = this->InitializeAnchorSamplers();
+    this->m_AnchorSamplersInitialized = true;
+    if( !this->m_UseVarianceReduction )
+    {
+      xl::xout[ "warning" ]
+        << "WARNING: VarianceReducedStochasticGradientDescent needs a random sampler "
+        << "and (NewSamplesEveryIteration \"true\").\n"
+        << "  The variance reduction is switched off in this resolution." << std::endl;
+    }
+  }
+
+  if( this->m_UseVarianceReduction )
+  {
+    if( this->GetCurrentIteration() % this->m_AnchorPeriod == 0 )
+    {
+      /** At the anchor both stochastic gradients are equal, so the
+       * variance-reduced gradient is just the anchor gradient.
+       */
+      this->ComputeAnchorGradient( this->GetScaledCurrentPosition() );
+      this->m_Gradient = this->m_AnchorGradient;
+    }
+    else
+    {
+      /** The stochastic gradient at the anchor, with the current samples. */
+      this->GetScaledDerivativeWithExceptionHandling(
+        this->m_AnchorPosition, this->m_AnchorStochasticGradient );
+
+      /** m_Gradient += anchorGradient - anchorStochasticGradient, in place. */
+      const unsigned int P = this->m_Gradient.GetSize();
+      double *           g = this->m_Gradient.data_block();
+      const double *     a = this->m_AnchorGradient.data_block();
+      const double *     s = this->m_AnchorStochasticGradient.data_block();
+      for( unsigned int i = 0; i < P; ++i )
+      {
+        g[ i ] += a[ i ] - s[ i ];
+      }
+    }
+  }
+
+  /** Call the Superclass' implementation. */
+  this->Superclass::AdvanceOneStep();
+
+} // end AdvanceOneStep()
+
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxVarianceReducedStochasticGradientDescent_hxx
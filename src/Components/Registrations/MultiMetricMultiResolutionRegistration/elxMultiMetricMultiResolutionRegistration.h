@@ -88,6 +88,21 @@ namespace elastix
  *    example: <tt>(Metric0Use "false" "true")</tt> \n
  *    example: <tt>(Metric1Use "true" "false")</tt> \n
  *    The default is "true".
+ * \parameter EvaluateMetricsConcurrently: Whether cheap metrics, like
+ *    penalty terms, are evaluated single-threaded alongside the most
+ *    expensive metric, instead of one after the other. This requires that
+ *    all metrics support it, otherwise the setting is ignored. \n
+ *    example: <tt>(EvaluateMetricsConcurrently "true")</tt> \n
+ *    The default is "false". Can be specified for each resolution.
+ * \parameter CombineDerivativesMultiThreaded: Whether the weighted metric
+ *    derivatives are combined multi-threaded. \n
+ *    example: <tt>(CombineDerivativesMultiThreaded "true")</tt> \n
+ *    The default is "false". Can be specified for each resolution.
+ * \parameter ShareTransformEvaluation: Whether metrics that use the same
+ *    image sampler, and so the same samples, share the transformed points
+ *    and Jacobians, instead of each evaluating the transform. \n
+ *    example: <tt>(ShareTransformEvaluation "false")</tt> \n
+ *    The default is "true". Can be specified for each resolution.
  *
  * \ingroup Registrations
  */
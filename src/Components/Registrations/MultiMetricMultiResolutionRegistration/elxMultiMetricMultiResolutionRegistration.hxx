@@ -197,6 +197,24 @@ MultiMetricMultiResolutionRegistration< TElastix >
   this->GetConfiguration()->ReadParameter( useRelativeWeights, "UseRelativeWeights", 0 );
   this->GetCombinationMetric()->SetUseRelativeWeights( useRelativeWeights );
 
+  /** Set the concurrent evaluation of the metrics. */
+  bool evaluateMetricsConcurrently = false;
+  this->GetConfiguration()->ReadParameter( evaluateMetricsConcurrently,
+    "EvaluateMetricsConcurrently", "", level, 0 );
+  this->GetCombinationMetric()->SetEvaluateMetricsConcurrently( evaluateMetricsConcurrently );
+
+  /** Set the multi-threaded combination of the metric derivatives. */
+  bool combineDerivativesMultiThreaded = false;
+  this->GetConfiguration()->ReadParameter( combineDerivativesMultiThreaded,
+    "CombineDerivativesMultiThreaded", "", level, 0 );
+  this->GetCombinationMetric()->SetCombineDerivativesMultiThreaded( combineDerivativesMultiThreaded );
+
+  /** Set the sharing of the transform evaluation between the metrics. */
+  bool shareTransformEvaluation = true;
+  this->GetConfiguration()->ReadParameter( shareTransformEvaluation,
+    "ShareTransformEvaluation", "", level, 0 );
+  this->GetCombinationMetric()->SetShareTransformEvaluation( shareTransformEvaluation );
+
   /** Set the metric weights. The default metric weight is 1.0 / nrOfMetrics. */
   if( !useRelativeWeights )
   {
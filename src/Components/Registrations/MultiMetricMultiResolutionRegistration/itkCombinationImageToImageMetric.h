@@ -50,6 +50,17 @@ namespace itk
  * why we chose to reimplement the Get{Transform,Interpolator}()
  * methods.
  *
+ * Optionally, the sub metrics are evaluated concurrently, see
+ * SetEvaluateMetricsConcurrently(). The most expensive metric is then
+ * evaluated multi-threaded as usual, while cheap metrics, like penalty
+ * terms, are each evaluated single-threaded in a thread of their own at
+ * the same time. This requires that all sub metrics support concurrent
+ * evaluation, see AdvancedImageToImageMetric::GetSupportsConcurrentEvaluation().
+ *
+ * When several image metrics share the image sampler and the transform,
+ * the samples are transformed only once per iteration, together with their
+ * Jacobians if these fit in memory, see SetShareTransformEvaluation().
+ *
  *
  * \ingroup RegistrationMetrics
  *
@@ -116,6 +127,8 @@ public:
   /** Some typedefs for computing the SelfHessian */
   typedef typename Superclass::HessianValueType HessianValueType;
   typedef typename Superclass::HessianType      HessianType;
+  typedef typename
+    Superclass::SelfHessianBlocksType SelfHessianBlocksType;
 
   /**
   typedef typename Superclass::ImageSamplerType             ImageSamplerType;
@@ -165,6 +178,10 @@ public:
   typedef typename Superclass::ThreaderType   ThreaderType;
   typedef typename Superclass::ThreadInfoType ThreadInfoType;
 
+  /** Typedefs for the shared transform evaluation. */
+  typedef typename Superclass::TransformEvaluationCacheType TransformEvaluationCacheType;
+  typedef typename TransformEvaluationCacheType::Pointer    TransformEvaluationCachePointer;
+
   /**
    * Get and set the metrics and their weights.
    **/
@@ -203,6 +220,40 @@ public:
   /** \todo: Temporary, should think about interface. */
   itkSetMacro( UseMultiThread, bool );
 
+  /** Select whether the sub metrics are evaluated concurrently in
+   * GetValueAndDerivative(). Based on the computation times of the previous
+   * iteration, a metric is evaluated single-threaded alongside the others
+   * when this is not expected to take longer than the multi-threaded
+   * evaluation of the most expensive metric. Default: false.
+   */
+  itkSetMacro( EvaluateMetricsConcurrently, bool );
+  itkGetConstMacro( EvaluateMetricsConcurrently, bool );
+  itkBooleanMacro( EvaluateMetricsConcurrently );
+
+  /** Select whether the weighted metric derivatives are combined, and their
+   * magnitudes computed, multi-threaded. This requires UseMultiThread as
+   * well. The combination used to crash on some systems when threaded, so it
+   * is opt-in. Default: false.
+   */
+  itkSetMacro( CombineDerivativesMultiThreaded, bool );
+  itkGetConstMacro( CombineDerivativesMultiThreaded, bool );
+  itkBooleanMacro( CombineDerivativesMultiThreaded );
+
+  /** Select whether image metrics that share the image sampler and the
+   * transform share the evaluation of the transform as well. The mapped
+   * points, and the Jacobians if they fit in the memory budget, are then
+   * computed once per call of GetValueAndDerivative(). Default: true.
+   */
+  itkSetMacro( ShareTransformEvaluation, bool );
+  itkGetConstMacro( ShareTransformEvaluation, bool );
+  itkBooleanMacro( ShareTransformEvaluation );
+
+  /** Set/Get the memory budget for the shared Jacobians in bytes. When more
+   * is needed, only the mapped points are shared. Default: 512 MB.
+   */
+  itkSetMacro( MaximumSharedTransformEvaluationCacheSize, SizeValueType );
+  itkGetConstMacro( MaximumSharedTransformEvaluationCacheSize, SizeValueType );
+
   /** Select which metrics are used.
    * This is useful in case you want to compute a certain measure, but not
    * actually use it during the registration.
@@ -398,6 +449,13 @@ public:
     const TransformParametersType & parameters,
     HessianType & H ) const;
 
+  /** Experimental feature: compute the diagonal blocks of the SelfHessian,
+   * as the weighted sum of those of the submetrics. */
+  virtual void GetSelfHessianBlocks(
+    const TransformParametersType & parameters,
+    const unsigned int blockSize,
+    SelfHessianBlocksType & blocks ) const;
+
   /** Method to return the latest modified time of this object or any of its
    * cached ivars.
    */
@@ -450,24 +508,72 @@ private:
    */
   double GetFinalMetricWeight( unsigned int pos ) const;
 
-  /** For threading: store thread data. */
+  /** Select the metrics that are evaluated concurrently with the others,
+   * based on the computation times of the previous iteration. Returns an
+   * empty list when all metrics should be evaluated one after the other.
+   */
+  void SelectConcurrentMetrics( std::vector< unsigned int > & concurrentMetrics ) const;
+
+  /** Compute the derivative magnitudes and the weighted sum of the metric
+   * derivatives. With fixed weights this is done in a single pass over
+   * the derivatives.
+   */
+  void CombineDerivatives( DerivativeType & derivative ) const;
+
+  /** Compute the derivative magnitudes from the partial sums of squares,
+   * which are stored thread by thread, metric by metric.
+   */
+  void GatherDerivativesMagnitude( const std::vector< double > & sumsOfSquares ) const;
+
+  /** Evaluate the transform once for each group of image metrics that share
+   * the image sampler and the transform, and give the result to these metrics.
+   */
+  void UpdateSharedTransformEvaluationCaches( void ) const;
+
+  /** Remove the shared transform evaluation caches from the metrics. */
+  void ReleaseSharedTransformEvaluationCaches( void ) const;
+
+  /** Evaluate the shared transform evaluation cache threader callback function. */
+  static ITK_THREAD_RETURN_TYPE EvaluateTransformEvaluationCacheThreaderCallback( void * arg );
+
+  /** For threading: store thread data. Thread 0 evaluates all metrics
+   * that are not in st_ConcurrentMetrics, thread i > 0 evaluates metric
+   * st_ConcurrentMetrics[ i - 1 ].
+   */
   struct MultiThreaderComboMetricsType
   {
-    std::vector< SingleValuedCostFunctionPointer > st_MetricsIterator;
-    typename std::vector< MeasureType >::iterator st_MetricValuesIterator;
-    typename std::vector< DerivativeType >::iterator st_MetricDerivativesIterator;
-    std::vector< double > st_MetricComputationTime;
-    ParametersType *      st_Parameters;
+    const Self *                   st_ThisComboMetric;
+    const ParametersType *         st_Parameters;
+    std::vector< unsigned int >    st_ConcurrentMetrics;
+    std::vector< unsigned char >   st_IsConcurrentMetric;
+    std::vector< double >          st_MetricComputationTime;
+    std::vector< unsigned char >   st_ExceptionOccurred;
+    std::vector< ExceptionObject > st_Exceptions;
+  };
+
+  struct MultiThreaderTransformEvaluationCacheType
+  {
+    TransformEvaluationCacheType * st_Cache;
+    const TransformType *          st_Transform;
   };
 
   struct MultiThreaderCombineDerivativeType
   {
     Self *                st_ThisComboMetric;
     std::vector< double > st_DerivativesSumOfSquares;
+    std::vector< double > st_Weights;
+    bool                  st_ComputeSumOfSquares;
     DerivativeValueType * st_Derivative;
   };
 
-  bool m_UseMultiThread;
+  bool                        m_UseMultiThread;
+  bool                        m_EvaluateMetricsConcurrently;
+  bool                        m_CombineDerivativesMultiThreaded;
+  mutable std::vector< bool > m_MetricEvaluatedConcurrently;
+
+  bool                                                   m_ShareTransformEvaluation;
+  SizeValueType                                          m_MaximumSharedTransformEvaluationCacheSize;
+  mutable std::vector< TransformEvaluationCachePointer > m_TransformEvaluationCaches;
 
 };
 
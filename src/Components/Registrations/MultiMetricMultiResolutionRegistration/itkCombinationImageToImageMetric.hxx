@@ -21,6 +21,9 @@
 #include "itkCombinationImageToImageMetric.h"
 #include "itkTimeProbe.h"
 #include "itkMath.h"
+#include "itkDistributedEvaluation.h"
+
+#include <algorithm>
 
 /** Macros to reduce some copy-paste work.
  * These macros provide the implementation of
@@ -164,7 +167,12 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_UseRelativeWeights = false;
   this->ComputeGradientOff();
 
-  this->m_UseMultiThread = true;
+  this->m_UseMultiThread                  = true;
+  this->m_EvaluateMetricsConcurrently     = false;
+  this->m_CombineDerivativesMultiThreaded = false;
+
+  this->m_ShareTransformEvaluation                  = true;
+  this->m_MaximumSharedTransformEvaluationCacheSize = 512 * 1024 * 1024;
 
 } // end Constructor
 
@@ -183,6 +191,14 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Add debugging information. */
   os << "NumberOfMetrics: " << this->m_NumberOfMetrics << std::endl;
+  os << "EvaluateMetricsConcurrently: "
+     << ( this->m_EvaluateMetricsConcurrently ? "true" : "false" ) << std::endl;
+  os << "CombineDerivativesMultiThreaded: "
+     << ( this->m_CombineDerivativesMultiThreaded ? "true" : "false" ) << std::endl;
+  os << "ShareTransformEvaluation: "
+     << ( this->m_ShareTransformEvaluation ? "true" : "false" ) << std::endl;
+  os << "MaximumSharedTransformEvaluationCacheSize: "
+     << this->m_MaximumSharedTransformEvaluationCacheSize << std::endl;
   for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
     os << "Metric " << i << ":\n";
@@ -282,6 +298,7 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_MetricDerivatives.resize( count );
     this->m_MetricDerivativesMagnitude.resize( count );
     this->m_MetricComputationTime.resize( count );
+    this->m_MetricEvaluatedConcurrently.resize( count, false );
     this->Modified();
   }
 
@@ -830,7 +847,7 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & derivative ) const
 {
   /** Declare timer and multi-threader. */
-  itk::TimeProbe timer;
+  itk::TimeProbe                 timer;
   typename ThreaderType::Pointer local_threader = ThreaderType::New();
 
   /** This function must be called before the multi-threaded code.
@@ -857,105 +874,120 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   /** Initialize some threading related parameters. */
   this->InitializeThreadingParameters();
 
-  /** Decide whether or not to use multi-threading.
-   * If the global maximum number of threads is smaller than the number
-   * of metrics, then setting the number of threads to the number of
-   * threads will result in a bug: all metrics after the max will not be
-   * run. For now we decide to run this metric single-threadedly in that case.
-   *
-   * Actually we should sum the number of threads of each metric and check that
-   * it does not surpass the global maximum. But for now we don't.
-   */
-  bool useMultiThread = this->m_UseMultiThread;
-  if( MultiThreader::GetGlobalMaximumNumberOfThreads() < this->m_NumberOfMetrics )
-  {
-    useMultiThread = false;
-  }
+  /** Transform the shared samples once for all metrics that use them. */
+  this->UpdateSharedTransformEvaluationCaches();
 
-  // For now we disable multi-threading of the combo metric, since the MacMini build
-  // segfaults with it. Have to investigate this issue later
-  useMultiThread = false;
+  /** Select the metrics that are evaluated concurrently. */
+  std::vector< unsigned int > concurrentMetrics;
+  this->SelectConcurrentMetrics( concurrentMetrics );
+  this->m_MetricEvaluatedConcurrently.assign( this->m_NumberOfMetrics, false );
 
-  /** Compute all metric values and derivatives, single-threadedly. */
-  if( !useMultiThread )
+  /** Compute all metric values and derivatives, one after the other. */
+  if( concurrentMetrics.empty() )
   {
     for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
     {
       /** Compute ... */
       timer.Reset();
       timer.Start();
-      this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
-        this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
+      try
+      {
+        this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
+          this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
+      }
+      catch( ExceptionObject & )
+      {
+        this->ReleaseSharedTransformEvaluationCaches();
+        throw;
+      }
       timer.Stop();
 
       /** Store computation time. */
       this->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
     }
   }
-  /** Compute all metric values and derivatives, multi-threadedly. */
+  /** Compute the metric values and derivatives, partly concurrently. */
   else
   {
-    /** Setup struct with multi-threading information. */
-    MultiThreaderComboMetricsType * temp_c = new MultiThreaderComboMetricsType;
-    temp_c->st_MetricsIterator           = this->m_Metrics;
-    temp_c->st_MetricDerivativesIterator = this->m_MetricDerivatives.begin();
-    temp_c->st_MetricValuesIterator      = this->m_MetricValues.begin();
-    temp_c->st_MetricComputationTime.resize( this->m_NumberOfMetrics, 0 );
-    temp_c->st_Parameters = const_cast< ParametersType * >( &parameters );
-
-    /** GetValueAndDerivative */
-    local_threader->SetNumberOfThreads( this->m_NumberOfMetrics );
-    local_threader->SetSingleMethod( GetValueAndDerivativeComboThreaderCallback, temp_c );
-    local_threader->SingleMethodExecute();
+    const unsigned int numberOfConcurrentMetrics = concurrentMetrics.size();
 
-    /** Store computation time. */
-    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    /** Setup struct with multi-threading information. */
+    MultiThreaderComboMetricsType temp_c;
+    temp_c.st_ThisComboMetric   = this;
+    temp_c.st_Parameters        = &parameters;
+    temp_c.st_ConcurrentMetrics = concurrentMetrics;
+    temp_c.st_IsConcurrentMetric.resize( this->m_NumberOfMetrics, 0 );
+    temp_c.st_MetricComputationTime.resize( this->m_NumberOfMetrics, 0.0 );
+    temp_c.st_ExceptionOccurred.resize( numberOfConcurrentMetrics + 1, 0 );
+    temp_c.st_Exceptions.resize( numberOfConcurrentMetrics + 1 );
+
+    /** The concurrent metrics run single-threaded, the image metrics as well
+     * as the point set metrics, which would otherwise wait for the thread
+     * pool of the main metric. Switching this is not thread-safe, so it is
+     * done here, and restored afterwards.
+     */
+    std::vector< bool > useMultiThread( this->m_NumberOfMetrics, false );
+    for( unsigned int j = 0; j < numberOfConcurrentMetrics; j++ )
     {
-      this->m_MetricComputationTime[ i ] = temp_c->st_MetricComputationTime[ i ];
+      const unsigned int i = concurrentMetrics[ j ];
+      temp_c.st_IsConcurrentMetric[ i ] = 1;
+      ImageMetricType *    testPtr1 = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+      PointSetMetricType * testPtr2 = dynamic_cast< PointSetMetricType * >( this->GetMetric( i ) );
+      if( testPtr1 && testPtr1->GetUseMultiThread() )
+      {
+        useMultiThread[ i ] = true;
+        testPtr1->SetUseMultiThread( false );
+      }
+      if( testPtr2 && testPtr2->GetUseMultiThread() )
+      {
+        useMultiThread[ i ] = true;
+        testPtr2->SetUseMultiThread( false );
+      }
     }
 
-    delete temp_c;
-  }
+    /** GetValueAndDerivative. The metrics of thread 0 use the thread pool. */
+    local_threader->SetNumberOfThreads( numberOfConcurrentMetrics + 1 );
+    local_threader->SetSingleMethod( GetValueAndDerivativeComboThreaderCallback, &temp_c );
+    local_threader->SingleMethodExecute();
 
-  /** Compute the derivative magnitude, single-threadedly. */
-  // I get random segfaults on the Linux or Mac systems when this is enabled.
-  // For now disable multi-threading and force single-threaded:
-  //if( !this->m_UseMultiThread )
-  if( true )
-  {
+    /** Restore the multi-threading settings and store computation time. */
     for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
     {
-      this->m_MetricDerivativesMagnitude[ i ] = this->m_MetricDerivatives[ i ].magnitude();
+      if( useMultiThread[ i ] )
+      {
+        ImageMetricType *    testPtr1 = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+        PointSetMetricType * testPtr2 = dynamic_cast< PointSetMetricType * >( this->GetMetric( i ) );
+        if( testPtr1 )
+        {
+          testPtr1->SetUseMultiThread( true );
+        }
+        if( testPtr2 )
+        {
+          testPtr2->SetUseMultiThread( true );
+        }
+      }
+      this->m_MetricComputationTime[ i ]       = temp_c.st_MetricComputationTime[ i ];
+      this->m_MetricEvaluatedConcurrently[ i ] = temp_c.st_IsConcurrentMetric[ i ] != 0;
     }
-  }
-  /** Compute the derivative magnitude, multi-threadedly. */
-  else
-  {
-    /** Setup struct with multi-threading information. */
-    ThreadIdType                         numberOfThreads = this->GetNumberOfThreads();
-    MultiThreaderCombineDerivativeType * temp_m          = new MultiThreaderCombineDerivativeType;
-    temp_m->st_ThisComboMetric = const_cast< Self * >( this );
-    temp_m->st_DerivativesSumOfSquares.resize( numberOfThreads * this->m_NumberOfMetrics );
-
-    /** Compute derivatives magnitude multi-threadedly. */
-    local_threader->SetNumberOfThreads( numberOfThreads );
-    local_threader->SetSingleMethod( ComputeDerivativesMagnitudeThreaderCallback, temp_m );
-    local_threader->SingleMethodExecute();
 
-    /** Gather the results. */
-    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    /** Rethrow an exception from any of the threads. */
+    for( unsigned int j = 0; j <= numberOfConcurrentMetrics; j++ )
     {
-      double mag = 0.0;
-      for( unsigned int j = 0; j < numberOfThreads; j++ )
+      if( temp_c.st_ExceptionOccurred[ j ] )
       {
-        mag += temp_m->st_DerivativesSumOfSquares[ i * numberOfThreads + j ];
+        this->ReleaseSharedTransformEvaluationCaches();
+        throw temp_c.st_Exceptions[ j ];
       }
-      this->m_MetricDerivativesMagnitude[ i ] = vcl_sqrt( mag );
     }
-
-    delete temp_m;
   }
 
+  /** The caches are only valid for the current parameters. */
+  this->ReleaseSharedTransformEvaluationCaches();
+
+  /** Compute the derivative magnitudes and combine the metric derivatives. */
+  derivative.SetSize( this->GetNumberOfParameters() );
+  this->CombineDerivatives( derivative );
+
   /** Combine the metric values, single-threadedly. */
   value = NumericTraits< MeasureType >::Zero;
   for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
@@ -967,52 +999,325 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     } // end if m_UseMetric[i]
   }   // end of combine metrics
 
-  /** Combine the metric derivatives, single-threadedly. */
-  // I get random segfaults on the linux or Mac systems when this is enabled.
-  // For now disable multi-threading and force single-threaded:
-  //if( !this->m_UseMultiThread )
-  if( true )
+} // end GetValueAndDerivative()
+
+
+/**
+ * ********************* SelectConcurrentMetrics ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::SelectConcurrentMetrics( std::vector< unsigned int > & concurrentMetrics ) const
+{
+  concurrentMetrics.clear();
+  if( !this->m_EvaluateMetricsConcurrently || this->m_NumberOfMetrics < 2 )
+  {
+    return;
+  }
+
+  /** The selection depends on timings, which differ between MPI processes,
+   * whereas the processes must sum the metric results in the same order.
+   */
+  if( DistributedEvaluation::GetNumberOfProcesses() > 1 )
+  {
+    return;
+  }
+
+  /** Estimate the single-threaded and multi-threaded computation time of
+   * each metric from the previous iteration, assuming that multi-threaded
+   * metrics scale linearly with the number of threads.
+   */
+  std::vector< double > serialTime( this->m_NumberOfMetrics );
+  std::vector< double > parallelTime( this->m_NumberOfMetrics );
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
-    /** The first derivative. */
-    if( this->m_UseMetric[ 0 ] )
+    ImageMetricType *    testPtr1        = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    PointSetMetricType * testPtr2        = dynamic_cast< PointSetMetricType * >( this->GetMetric( i ) );
+    bool                 supported       = false;
+    double               numberOfThreads = 1.0;
+    if( testPtr1 )
+    {
+      supported = testPtr1->GetSupportsConcurrentEvaluation();
+      if( testPtr1->GetUseMultiThread() )
+      {
+        numberOfThreads = static_cast< double >( testPtr1->GetNumberOfThreads() );
+      }
+    }
+    else if( testPtr2 )
     {
-      double weight = this->GetFinalMetricWeight( 0 );
-      derivative = weight * this->m_MetricDerivatives[ 0 ];
+      supported = testPtr2->GetSupportsConcurrentEvaluation();
+      if( testPtr2->GetUseMultiThread() )
+      {
+        numberOfThreads = static_cast< double >( testPtr2->GetNumberOfThreads() );
+      }
+    }
+
+    /** All metrics run at the same time, so all of them must support it.
+     * In the first iteration no timings are available yet.
+     */
+    const double time = this->m_MetricComputationTime[ i ];
+    if( !supported || time <= 0.0 )
+    {
+      return;
+    }
+
+    serialTime[ i ] = this->m_MetricEvaluatedConcurrently[ i ]
+      ? time : time * numberOfThreads;
+    parallelTime[ i ] = serialTime[ i ] / numberOfThreads;
+  }
+
+  /** The most expensive metric keeps all threads. The others are evaluated
+   * single-threaded alongside it, if they are expected to finish in time.
+   * The MultiThreader supports a limited number of threads.
+   */
+  const unsigned int mainMetric = std::max_element(
+    parallelTime.begin(), parallelTime.end() ) - parallelTime.begin();
+  const unsigned int maximumNumberOfConcurrentMetrics
+    = MultiThreader::GetGlobalMaximumNumberOfThreads() - 1;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( i != mainMetric && serialTime[ i ] <= parallelTime[ mainMetric ]
+      && concurrentMetrics.size() < maximumNumberOfConcurrentMetrics )
+    {
+      concurrentMetrics.push_back( i );
+    }
+  }
+
+} // end SelectConcurrentMetrics()
+
+
+/**
+ * ********************* CombineDerivatives ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::CombineDerivatives( DerivativeType & derivative ) const
+{
+  /** Setup struct with multi-threading information. The partial sums of
+   * squares are stored per thread, metric by metric. The threaded
+   * combination is opt-in, see SetCombineDerivativesMultiThreaded().
+   */
+  const bool useMultiThread
+    = this->m_UseMultiThread && this->m_CombineDerivativesMultiThreaded;
+  const ThreadIdType numberOfThreads = useMultiThread ? this->m_NumberOfThreads : 1;
+  MultiThreaderCombineDerivativeType temp_d;
+  temp_d.st_ThisComboMetric = const_cast< Self * >( this );
+  temp_d.st_DerivativesSumOfSquares.resize( numberOfThreads * this->m_NumberOfMetrics, 0.0 );
+  temp_d.st_Weights.resize( this->m_NumberOfMetrics, 0.0 );
+  temp_d.st_Derivative = derivative.data_block();
+
+  ThreadInfoType infoStruct;
+  infoStruct.ThreadID        = 0;
+  infoStruct.NumberOfThreads = 1;
+  infoStruct.UserData        = &temp_d;
+
+  /** With relative weights the magnitudes determine the weights, which
+   * requires a separate pass over the derivatives. Otherwise the magnitudes
+   * are computed while combining.
+   */
+  if( this->m_UseRelativeWeights )
+  {
+    if( useMultiThread )
+    {
+      this->ExecuteThreaderCallback( ComputeDerivativesMagnitudeThreaderCallback, &temp_d );
     }
     else
     {
-      derivative.Fill( 0 );
+      ComputeDerivativesMagnitudeThreaderCallback( &infoStruct );
     }
+    this->GatherDerivativesMagnitude( temp_d.st_DerivativesSumOfSquares );
+  }
 
-    /** The remaining derivatives. */
-    for( unsigned int i = 1; i < this->m_NumberOfMetrics; i++ )
+  /** Combine the derivatives. */
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( this->m_UseMetric[ i ] )
     {
-      /** and combine. */
-      if( this->m_UseMetric[ i ] )
-      {
-        double weight = this->GetFinalMetricWeight( i );
-        derivative += weight * this->m_MetricDerivatives[ i ];
-      } // end if m_UseMetric[i]
-    }   // end of combine metrics
+      temp_d.st_Weights[ i ] = this->GetFinalMetricWeight( i );
+    }
+  }
+  temp_d.st_ComputeSumOfSquares = !this->m_UseRelativeWeights;
+  if( useMultiThread )
+  {
+    this->ExecuteThreaderCallback( CombineDerivativesThreaderCallback, &temp_d );
   }
-  /** Combine the derivatives, multi-threadedly. */
   else
   {
-    /** Setup struct with multi-threading information. */
-    ThreadIdType                         numberOfThreads = this->GetNumberOfThreads();
-    MultiThreaderCombineDerivativeType * temp_d          = new MultiThreaderCombineDerivativeType;
-    temp_d->st_ThisComboMetric = const_cast< Self * >( this );
-    temp_d->st_Derivative      = &derivative[ 0 ];
-
-    /** Combine derivatives */
-    local_threader->SetNumberOfThreads( numberOfThreads );
-    local_threader->SetSingleMethod( CombineDerivativesThreaderCallback, temp_d );
-    local_threader->SingleMethodExecute();
+    CombineDerivativesThreaderCallback( &infoStruct );
+  }
 
-    delete temp_d;
+  if( !this->m_UseRelativeWeights )
+  {
+    this->GatherDerivativesMagnitude( temp_d.st_DerivativesSumOfSquares );
   }
 
-} // end GetValueAndDerivative()
+} // end CombineDerivatives()
+
+
+/**
+ * ********************* GatherDerivativesMagnitude ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::GatherDerivativesMagnitude( const std::vector< double > & sumsOfSquares ) const
+{
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    double mag = 0.0;
+    for( unsigned int j = i; j < sumsOfSquares.size(); j += this->m_NumberOfMetrics )
+    {
+      mag += sumsOfSquares[ j ];
+    }
+    this->m_MetricDerivativesMagnitude[ i ] = vcl_sqrt( mag );
+  }
+
+} // end GatherDerivativesMagnitude()
+
+
+/**
+ * ********************* UpdateSharedTransformEvaluationCaches ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateSharedTransformEvaluationCaches( void ) const
+{
+  if( !this->m_ShareTransformEvaluation || this->m_NumberOfMetrics < 2 )
+  {
+    return;
+  }
+
+  /** Find the image metrics that can use a shared cache. */
+  std::vector< ImageMetricType * >       metrics( this->m_NumberOfMetrics, 0 );
+  std::vector< const TransformType * > transforms( this->m_NumberOfMetrics, 0 );
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    ImageMetricType * testPtr = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( testPtr && testPtr->GetSupportsSharedTransformEvaluationCache()
+      && testPtr->GetUseImageSampler() && testPtr->GetImageSampler() )
+    {
+      metrics[ i ]    = testPtr;
+      transforms[ i ] = dynamic_cast< const TransformType * >( testPtr->GetTransform() );
+    }
+  }
+
+  /** Group the metrics by image sampler and transform. */
+  unsigned int numberOfCaches = 0;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( !metrics[ i ] || !transforms[ i ] )
+    {
+      continue;
+    }
+    std::vector< unsigned int > group( 1, i );
+    for( unsigned int j = i + 1; j < this->m_NumberOfMetrics; j++ )
+    {
+      if( metrics[ j ] && metrics[ j ]->GetImageSampler() == metrics[ i ]->GetImageSampler()
+        && transforms[ j ] == transforms[ i ] )
+      {
+        group.push_back( j );
+        metrics[ j ] = 0;
+      }
+    }
+    if( group.size() < 2 )
+    {
+      continue;
+    }
+
+    /** Allocate the cache, with Jacobians if they fit in the memory budget. */
+    if( numberOfCaches == this->m_TransformEvaluationCaches.size() )
+    {
+      this->m_TransformEvaluationCaches.push_back( TransformEvaluationCacheType::New() );
+    }
+    TransformEvaluationCacheType * cache = this->m_TransformEvaluationCaches[ numberOfCaches ];
+    ++numberOfCaches;
+
+    const ImageSampleContainerType * sampleContainer = metrics[ i ]->GetImageSampler()->GetOutput();
+    const SizeValueType              numberOfSamples = sampleContainer->Size();
+    const SizeValueType              nnzji           = transforms[ i ]->GetNumberOfNonZeroJacobianIndices();
+    const bool                       withJacobians   = TransformEvaluationCacheType::GetMemoryUsage(
+      numberOfSamples, nnzji, true ) <= this->m_MaximumSharedTransformEvaluationCacheSize;
+    cache->Resize( numberOfSamples, nnzji, withJacobians );
+    for( SizeValueType k = 0; k < numberOfSamples; ++k )
+    {
+      cache->GetInputPoints()[ k ] = sampleContainer->ElementAt( k ).m_ImageCoordinates;
+    }
+
+    /** Transform the samples, multi-threaded. */
+    MultiThreaderTransformEvaluationCacheType temp;
+    temp.st_Cache     = cache;
+    temp.st_Transform = transforms[ i ];
+    this->ExecuteThreaderCallback( EvaluateTransformEvaluationCacheThreaderCallback, &temp );
+
+    /** The metrics of the group read from the cache. */
+    for( unsigned int j = 0; j < group.size(); j++ )
+    {
+      dynamic_cast< ImageMetricType * >( this->GetMetric( group[ j ] ) )
+        ->SetSharedTransformEvaluationCache( cache );
+    }
+  }
+
+} // end UpdateSharedTransformEvaluationCaches()
+
+
+/**
+ * ********************* ReleaseSharedTransformEvaluationCaches ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::ReleaseSharedTransformEvaluationCaches( void ) const
+{
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    ImageMetricType * testPtr = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( testPtr )
+    {
+      testPtr->SetSharedTransformEvaluationCache( 0 );
+    }
+  }
+
+} // end ReleaseSharedTransformEvaluationCaches()
+
+
+/**
+ *********** EvaluateTransformEvaluationCacheThreaderCallback *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateTransformEvaluationCacheThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  MultiThreaderTransformEvaluationCacheType * temp
+    = static_cast< MultiThreaderTransformEvaluationCacheType * >( infoStruct->UserData );
+
+  /** Determine the samples of this thread. */
+  const SizeValueType numberOfSamples = temp->st_Cache->Size();
+  const SizeValueType subSize         = static_cast< SizeValueType >(
+    vcl_ceil( static_cast< double >( numberOfSamples ) / static_cast< double >( nrOfThreads ) ) );
+  SizeValueType pos_begin = subSize * threadId;
+  SizeValueType pos_end   = subSize * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfSamples ) ? numberOfSamples : pos_begin;
+  pos_end   = ( pos_end > numberOfSamples ) ? numberOfSamples : pos_end;
+
+  temp->st_Cache->Evaluate( temp->st_Transform, pos_begin, pos_end );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end EvaluateTransformEvaluationCacheThreaderCallback()
 
 
 /**
@@ -1029,15 +1334,37 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 
   MultiThreaderComboMetricsType * temp
     = static_cast< MultiThreaderComboMetricsType * >( infoStruct->UserData );
+  const Self * metric = temp->st_ThisComboMetric;
 
-  itk::TimeProbe timer;
-  timer.Start();
-  temp->st_MetricsIterator[ threadID ]->GetValueAndDerivative(
-    *temp->st_Parameters,
-    temp->st_MetricValuesIterator[ threadID ],
-    temp->st_MetricDerivativesIterator[ threadID ] );
-  timer.Stop();
-  temp->st_MetricComputationTime[ threadID ] = timer.GetMean() * 1000.0;
+  /** Thread 0 evaluates the remaining metrics in order, the others one
+   * concurrent metric each. Exceptions can not leave a spawned thread,
+   * so they are stored and rethrown by GetValueAndDerivative().
+   */
+  try
+  {
+    for( unsigned int i = 0; i < metric->m_NumberOfMetrics; i++ )
+    {
+      const bool isMine = threadID == 0
+        ? !temp->st_IsConcurrentMetric[ i ]
+        : i == temp->st_ConcurrentMetrics[ threadID - 1 ];
+      if( !isMine )
+      {
+        continue;
+      }
+
+      itk::TimeProbe timer;
+      timer.Start();
+      metric->m_Metrics[ i ]->GetValueAndDerivative( *temp->st_Parameters,
+        metric->m_MetricValues[ i ], metric->m_MetricDerivatives[ i ] );
+      timer.Stop();
+      temp->st_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
+    }
+  }
+  catch( ExceptionObject & err )
+  {
+    temp->st_ExceptionOccurred[ threadID ] = 1;
+    temp->st_Exceptions[ threadID ]        = err;
+  }
 
   return ITK_THREAD_RETURN_VALUE;
 
@@ -1075,17 +1402,14 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   double derivativeValue = 0.0;
   for( unsigned int i = 0; i < numberOfMetrics; i++ )
   {
-    if( temp->st_ThisComboMetric->m_UseMetric[ i ] )
+    const DerivativeType & derivative   = temp->st_ThisComboMetric->m_MetricDerivatives[ i ];
+    double                 sumOfSquares = 0.0;
+    for( unsigned int j = jmin; j < jmax; j++ )
     {
-      const DerivativeType & derivative   = temp->st_ThisComboMetric->m_MetricDerivatives[ i ];
-      double                 sumOfSquares = 0.0;
-      for( unsigned int j = jmin; j < jmax; j++ )
-      {
-        derivativeValue = derivative[ j ];
-        sumOfSquares   += derivativeValue * derivativeValue;
-      }
-      temp->st_DerivativesSumOfSquares[ i * nrOfThreads + threadId ] = sumOfSquares;
+      derivativeValue = derivative[ j ];
+      sumOfSquares   += derivativeValue * derivativeValue;
     }
+    temp->st_DerivativesSumOfSquares[ threadId * numberOfMetrics + i ] = sumOfSquares;
   }
 
   return ITK_THREAD_RETURN_VALUE;
@@ -1120,28 +1444,61 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   unsigned int jmax = ( threadId + 1 ) * subSize;
   jmax = ( jmax > numberOfParameters ) ? numberOfParameters : jmax;
 
-  // First metric, assign
-  if( temp->st_ThisComboMetric->m_UseMetric[ 0 ] )
+  /** Gather pointers to the metric derivatives, and to those of the used
+   * metrics with their weights. The unused metrics are left out of the
+   * combination, so that a NaN or Inf in their derivative does not end up
+   * in the combined derivative.
+   */
+  std::vector< const DerivativeValueType * > metricDerivatives( numberOfMetrics );
+  std::vector< const DerivativeValueType * > usedMetricDerivatives;
+  std::vector< double >                      usedMetricWeights;
+  std::vector< double >                      sumOfSquares( numberOfMetrics, 0.0 );
+  for( unsigned int i = 0; i < numberOfMetrics; i++ )
   {
-    double                 weight           = temp->st_ThisComboMetric->GetFinalMetricWeight( 0 );
-    const DerivativeType & metricDerivative = temp->st_ThisComboMetric->m_MetricDerivatives[ 0 ];
-    for( unsigned int j = jmin; j < jmax; j++ )
+    metricDerivatives[ i ] = temp->st_ThisComboMetric->m_MetricDerivatives[ i ].data_block();
+    if( temp->st_ThisComboMetric->m_UseMetric[ i ] )
     {
-      temp->st_Derivative[ j ] = weight * metricDerivative[ j ];
+      usedMetricDerivatives.push_back( metricDerivatives[ i ] );
+      usedMetricWeights.push_back( temp->st_Weights[ i ] );
     }
   }
+  const unsigned int numberOfUsedMetrics = usedMetricDerivatives.size();
 
-  // Other metrics, add
-  for( unsigned int i = 1; i < numberOfMetrics; i++ )
+  /** Combine the used metrics in a single pass, so that the output derivative
+   * is written only once and need not be zeroed. Also accumulate the sums
+   * of squares of all metrics when requested.
+   */
+  if( temp->st_ComputeSumOfSquares )
   {
-    if( temp->st_ThisComboMetric->m_UseMetric[ i ] )
+    for( unsigned int j = jmin; j < jmax; j++ )
+    {
+      for( unsigned int i = 0; i < numberOfMetrics; i++ )
+      {
+        const double derivativeValue = metricDerivatives[ i ][ j ];
+        sumOfSquares[ i ] += derivativeValue * derivativeValue;
+      }
+      double sum = 0.0;
+      for( unsigned int i = 0; i < numberOfUsedMetrics; i++ )
+      {
+        sum += usedMetricWeights[ i ] * usedMetricDerivatives[ i ][ j ];
+      }
+      temp->st_Derivative[ j ] = sum;
+    }
+    for( unsigned int i = 0; i < numberOfMetrics; i++ )
+    {
+      temp->st_DerivativesSumOfSquares[ threadId * numberOfMetrics + i ] = sumOfSquares[ i ];
+    }
+  }
+  else
+  {
+    for( unsigned int j = jmin; j < jmax; j++ )
     {
-      double                 weight           = temp->st_ThisComboMetric->GetFinalMetricWeight( i );
-      const DerivativeType & metricDerivative = temp->st_ThisComboMetric->m_MetricDerivatives[ i ];
-      for( unsigned int j = jmin; j < jmax; j++ )
+      double sum = 0.0;
+      for( unsigned int i = 0; i < numberOfUsedMetrics; i++ )
       {
-        temp->st_Derivative[ j ] += weight * metricDerivative[ j ];
+        sum += usedMetricWeights[ i ] * usedMetricDerivatives[ i ][ j ];
       }
+      temp->st_Derivative[ j ] = sum;
     }
   }
 
@@ -1205,6 +1562,52 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetSelfHessian()
 
 
+/**
+ * ********************* GetSelfHessianBlocks ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::GetSelfHessianBlocks( const TransformParametersType & parameters,
+  const unsigned int blockSize, SelfHessianBlocksType & blocks ) const
+{
+  /** Add all metrics' self Hessian blocks. */
+  SelfHessianBlocksType tmpBlocks;
+  bool                  initialized = false;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( this->m_UseMetric[ i ] )
+    {
+      const double      w      = this->m_MetricWeights[ i ];
+      ImageMetricType * metric = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+      if( metric )
+      {
+        metric->GetSelfHessianBlocks( parameters, blockSize, tmpBlocks );
+        if( !initialized )
+        {
+          blocks = tmpBlocks * w;
+          initialized = true;
+        }
+        else
+        {
+          blocks += tmpBlocks * w;
+        }
+
+      } // end if metric i exists
+    }   // end if use metric i
+  }     // end for metrics
+
+  /** If none of the submetrics has a valid implementation of
+   * GetSelfHessianBlocks, then return identity blocks. */
+  if( !initialized )
+  {
+    this->Superclass::GetSelfHessianBlocks( parameters, blockSize, blocks );
+  }
+
+} // end GetSelfHessianBlocks()
+
+
 /**
  * ********************* GetMTime ****************************
  */
@@ -400,6 +400,12 @@ MultiMetricMultiResolutionImageRegistrationMethod< TFixedImage, TMovingImage >
       break;
     }
 
+    // Skip the levels that were completed before a resume
+    if( this->SkipResumedLevel( this->m_LastTransformParameters ) )
+    {
+      continue;
+    }
+
     try
     {
       // initialize the interconnects between components
@@ -417,7 +423,7 @@ MultiMetricMultiResolutionImageRegistrationMethod< TFixedImage, TMovingImage >
     try
     {
       // do the optimization
-      this->GetOptimizer()->StartOptimization();
+      this->OptimizeCurrentLevel();
     }
     catch( ExceptionObject & err )
     {
@@ -430,7 +436,6 @@ MultiMetricMultiResolutionImageRegistrationMethod< TFixedImage, TMovingImage >
     }
 
     // get the results
-    this->m_LastTransformParameters = this->GetOptimizer()->GetCurrentPosition();
     this->GetTransform()->SetParameters( this->m_LastTransformParameters );
 
     // setup the initial parameters for next level
@@ -500,6 +500,12 @@ MultiInputMultiResolutionImageRegistrationMethodBase< TFixedImage, TMovingImage
       break;
     }
 
+    // Skip the levels that were completed before a resume
+    if( this->SkipResumedLevel( this->m_LastTransformParameters ) )
+    {
+      continue;
+    }
+
     try
     {
       // initialize the interconnects between components
@@ -517,7 +523,7 @@ MultiInputMultiResolutionImageRegistrationMethodBase< TFixedImage, TMovingImage
     try
     {
       // do the optimization
-      this->GetOptimizer()->StartOptimization();
+      this->OptimizeCurrentLevel();
     }
     catch( ExceptionObject & err )
     {
@@ -530,7 +536,6 @@ MultiInputMultiResolutionImageRegistrationMethodBase< TFixedImage, TMovingImage
     }
 
     /** Get the results. */
-    this->m_LastTransformParameters = this->GetOptimizer()->GetCurrentPosition();
     this->GetTransform()->SetParameters( this->m_LastTransformParameters );
 
     /** Setup the initial parameters for next level. */
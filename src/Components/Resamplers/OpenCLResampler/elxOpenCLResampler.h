@@ -24,6 +24,7 @@
 #include "itkGPUResampleImageFilter.h"
 #include "itkGPUAdvancedCombinationTransformCopier.h"
 #include "itkGPUInterpolatorCopier.h"
+#include "itkGPUNearestNeighborInterpolateImageFunction.h"
 
 namespace elastix
 {
@@ -37,6 +38,23 @@ namespace elastix
  * \parameter Resampler: Enable the OpenCL resampler as follows:\n
  *    <tt>(OpenCLResamplerUseOpenCL "true")</tt>
  *
+ * The identity, translation, all matrix-offset (including the AffineLog) and
+ * all B-spline (including the RecursiveBSpline) transforms, and compositions
+ * of them, are resampled on the GPU. Other transforms, such as the deformation
+ * field and the stack transforms, and combinations by addition, are resampled
+ * on the CPU. The log tells which one was used, and why.
+ *
+ * \parameter OpenCLResamplerComputeTransformOutputs: Compute the deformation
+ *    field (transformix -def all) and the determinant of the spatial Jacobian
+ *    (transformix -jac all) on the GPU as well. Note that these are
+ *    approximations: the GPU computes in single precision, and it takes the
+ *    determinant of the spatial Jacobian from central differences of the
+ *    deformation, whereas the CPU evaluates the analytic spatial Jacobian of
+ *    the transform. The spatial Jacobian matrix (transformix -jacmat) is
+ *    always computed on the CPU. \n
+ *    example: <tt>(OpenCLResamplerComputeTransformOutputs "true")</tt> \n
+ *    Default value: "false".
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -119,6 +137,21 @@ public:
   /** Function to write parameters to a file. */
   virtual void WriteToFile( void ) const;
 
+  /** Typedefs for the transform outputs, inherited from the ResamplerBase. */
+  typedef typename Superclass2::DeformationFieldImageType DeformationFieldImageType;
+  typedef typename Superclass2::DeterminantImageType      DeterminantImageType;
+
+  /** Compute the deformation field and/or det(dT/dx) on the output grid on
+   * the GPU. No interpolation of the input image is needed for this, so it is
+   * a separate pass with a dummy input image. Returns false if OpenCL is not
+   * used or configuring the GPU failed, the caller then uses the CPU.
+   */
+  virtual bool GenerateTransformOutputs(
+    const bool computeDeformationField,
+    const bool computeDeterminantOfSpatialJacobian,
+    typename DeformationFieldImageType::Pointer & deformationField,
+    typename DeterminantImageType::Pointer & determinant );
+
 protected:
 
   /** The constructor. */
@@ -166,6 +199,9 @@ private:
   /** Helper method to report to elastix log. */
   void ReportToLog( void );
 
+  /** Helper method to report resampling on the CPU to elastix log. */
+  void ReportCPUToLog( const std::string & reason ) const;
+
   TransformCopierPointer   m_TransformCopier;
   InterpolateCopierPointer m_InterpolatorCopier;
   GPUResamplerPointer      m_GPUResampler;
@@ -173,6 +209,8 @@ private:
   bool                     m_GPUResamplerCreated;
   bool                     m_ContextCreated;
   bool                     m_UseOpenCL;
+  bool                     m_ComputeTransformOutputs;
+  std::string              m_CPUReason;
 };
 
 // end class OpenCLResampler
@@ -20,6 +20,7 @@
 
 #include "elxOpenCLResampler.h"
 #include "itkOpenCLLogger.h"
+#include "itkOpenCLProfilingReport.h"
 
 namespace elastix
 {
@@ -71,8 +72,9 @@ elastix::OpenCLResampler< TElastix >
     this->SwitchingToCPUAndReport( false );
   }
 
-  this->m_UseOpenCL    = true;
-  this->m_ShowProgress = false;
+  this->m_UseOpenCL               = true;
+  this->m_ComputeTransformOutputs = false;
+  this->m_ShowProgress            = false;
 
 } // end Constructor
 
@@ -130,6 +132,7 @@ OpenCLResampler< TElastix >
 {
   // Set it to true, if something goes wrong during configuration, it will be false
   this->m_GPUResamplerReady = true;
+  this->m_CPUReason         = "configuring the GPU failed";
 
   // Local GPU transform, GPU interpolator and GPU input image
   GPUTransformPointer            gpuTransform;
@@ -144,8 +147,18 @@ OpenCLResampler< TElastix >
   }
   catch( itk::ExceptionObject & e )
   {
-    xl::xout[ "error" ] << "ERROR: Exception during making GPU copy of the transform: " << e << std::endl;
-    this->SwitchingToCPUAndReport( true );
+    // An unsupported transform is expected, and not an error
+    const std::string reason = this->m_TransformCopier->GetUnsupportedReason();
+    if( !reason.empty() )
+    {
+      this->m_CPUReason         = reason;
+      this->m_GPUResamplerReady = false;
+    }
+    else
+    {
+      xl::xout[ "error" ] << "ERROR: Exception during making GPU copy of the transform: " << e << std::endl;
+      this->SwitchingToCPUAndReport( true );
+    }
   }
 
   if( this->m_GPUResamplerReady )
@@ -235,14 +248,23 @@ OpenCLResampler< TElastix >
   if( !this->m_ContextCreated || !this->m_GPUResamplerCreated || !this->m_UseOpenCL )
   {
     // Switch to CPU version
+    if( !this->m_UseOpenCL ) { this->ReportCPUToLog( "OpenCLResamplerUseOpenCL is false" ); }
+    else if( !this->m_ContextCreated ) { this->ReportCPUToLog( "the OpenCL context could not be created" ); }
+    else { this->ReportCPUToLog( "the GPU resampler could not be created" ); }
     Superclass1::GenerateData();
     return;
   }
 
+  // Tag the uploads and kernels of the resampler in the profiling report
+  itk::OpenCLProfilingReport::Pointer report = itk::OpenCLProfilingReport::GetInstance();
+  report->SetStage( "OpenCLResampler" );
+
   // First execute BeforeGenerateData to configure GPU resampler
   this->BeforeGenerateData();
   if( !this->m_GPUResamplerReady )
   {
+    report->SetStage( "" );
+    this->ReportCPUToLog( this->m_CPUReason );
     Superclass1::GenerateData();
     return;
   }
@@ -252,6 +274,7 @@ OpenCLResampler< TElastix >
 
   // Perform GPU resampler execution
   this->m_GPUResampler->Update();
+  report->SetStage( "" );
 
   // Perform GPU explicit sync and graft the output to this filter
   //itk::GPUExplicitSync< GPUResamplerType, GPUOutputImageType >( this->m_GPUResampler, false );
@@ -262,6 +285,107 @@ OpenCLResampler< TElastix >
 } // end GenerateData()
 
 
+/**
+ * ******************* GenerateTransformOutputs ***********************
+ */
+
+template< class TElastix >
+bool
+OpenCLResampler< TElastix >
+::GenerateTransformOutputs(
+  const bool computeDeformationField,
+  const bool computeDeterminantOfSpatialJacobian,
+  typename DeformationFieldImageType::Pointer & deformationField,
+  typename DeterminantImageType::Pointer & determinant )
+{
+  if( !this->m_ContextCreated || !this->m_GPUResamplerCreated
+    || !this->m_UseOpenCL || !this->m_ComputeTransformOutputs )
+  {
+    return false;
+  }
+
+  itk::OpenCLProfilingReport::Pointer report = itk::OpenCLProfilingReport::GetInstance();
+  report->SetStage( "OpenCLResampler/TransformOutputs" );
+
+  bool success = true;
+  try
+  {
+    // Perform transform copy
+    this->m_TransformCopier->Update();
+    GPUTransformPointer gpuTransform = this->m_TransformCopier->GetModifiableOutput();
+
+    // The post kernel needs an input image and an interpolator, but only
+    // the transform is evaluated. Use a single voxel and nearest neighbor.
+    typename GPUInputImageType::RegionType dummyRegion;
+    dummyRegion.SetSize( typename GPUInputImageType::SizeType::Filled( 1 ) );
+    GPUInputImagePointer dummyImage = GPUInputImageType::New();
+    dummyImage->SetRegions( dummyRegion );
+    dummyImage->Allocate();
+    dummyImage->FillBuffer( itk::NumericTraits< InputImagePixelType >::Zero );
+    dummyImage->GetGPUDataManager()->SetGPUDirtyFlag( true );
+    dummyImage->GetGPUDataManager()->UpdateGPUBuffer();
+
+    typedef itk::GPUNearestNeighborInterpolateImageFunction<
+      GPUInputImageType, GPUInterpolatorPrecisionType > DummyInterpolatorType;
+    typename DummyInterpolatorType::Pointer dummyInterpolator = DummyInterpolatorType::New();
+
+    this->m_GPUResampler->SetSize( this->GetSize() );
+    this->m_GPUResampler->SetDefaultPixelValue( this->GetDefaultPixelValue() );
+    this->m_GPUResampler->SetOutputSpacing( this->GetOutputSpacing() );
+    this->m_GPUResampler->SetOutputOrigin( this->GetOutputOrigin() );
+    this->m_GPUResampler->SetOutputDirection( this->GetOutputDirection() );
+    this->m_GPUResampler->SetOutputStartIndex( this->GetOutputStartIndex() );
+    this->m_GPUResampler->SetInput( dummyImage );
+    this->m_GPUResampler->SetTransform( gpuTransform );
+    this->m_GPUResampler->SetInterpolator( dummyInterpolator );
+
+    this->m_GPUResampler->SetComputeDeformationField( computeDeformationField );
+    this->m_GPUResampler->SetComputeDeterminantOfSpatialJacobian(
+      computeDeterminantOfSpatialJacobian );
+    this->m_GPUResampler->Update();
+
+    deformationField = this->m_GPUResampler->GetDeformationFieldOutput();
+    determinant      = this->m_GPUResampler->GetDeterminantOfSpatialJacobianOutput();
+  }
+  catch( itk::OpenCLCompileError & e )
+  {
+    // First log then report OpenCL compile error
+    itk::OpenCLLogger::Pointer logger = itk::OpenCLLogger::GetInstance();
+    logger->Write( itk::LoggerBase::CRITICAL, e.GetDescription() );
+
+    xl::xout[ "warning" ] << "WARNING: OpenCL program has not been compiled"
+                          << " during computing the transform outputs." << std::endl
+                          << "  Please check the '" << logger->GetLogFileName()
+                          << "' in output directory." << std::endl;
+    success = false;
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    xl::xout[ "warning" ] << "WARNING: Exception during computing the transform outputs"
+                          << " on the GPU: " << e << std::endl;
+    success = false;
+  }
+
+  // Do not compute the transform outputs during normal resampling
+  this->m_GPUResampler->SetComputeDeformationField( false );
+  this->m_GPUResampler->SetComputeDeterminantOfSpatialJacobian( false );
+  this->m_GPUResampler->Modified();
+  report->SetStage( "" );
+
+  if( !success )
+  {
+    xl::xout[ "warning" ] << "  The transform outputs are computed on the CPU." << std::endl;
+    deformationField = NULL;
+    determinant      = NULL;
+    return false;
+  }
+
+  elxout << "  The transform outputs were computed on the GPU." << std::endl;
+  return true;
+
+} // end GenerateTransformOutputs()
+
+
 /**
  * ******************* BeforeRegistration ***********************
  */
@@ -275,6 +399,10 @@ OpenCLResampler< TElastix >
   this->m_UseOpenCL = true;
   this->m_Configuration->ReadParameter( this->m_UseOpenCL, "OpenCLResamplerUseOpenCL", 0, false );
 
+  this->m_ComputeTransformOutputs = false;
+  this->m_Configuration->ReadParameter( this->m_ComputeTransformOutputs,
+    "OpenCLResamplerComputeTransformOutputs", 0, false );
+
 } // end BeforeRegistration()
 
 
@@ -294,6 +422,10 @@ OpenCLResampler< TElastix >
   this->m_UseOpenCL = true;
   this->m_Configuration->ReadParameter( this->m_UseOpenCL, "OpenCLResamplerUseOpenCL", 0 );
 
+  this->m_ComputeTransformOutputs = false;
+  this->m_Configuration->ReadParameter( this->m_ComputeTransformOutputs,
+    "OpenCLResamplerComputeTransformOutputs", 0, false );
+
 } // end ReadFromFile()
 
 
@@ -360,6 +492,20 @@ OpenCLResampler< TElastix >
 } // end ReportToLog()
 
 
+/**
+ * ************************* ReportCPUToLog ************************************
+ */
+
+template< class TElastix >
+void
+OpenCLResampler< TElastix >
+::ReportCPUToLog( const std::string & reason ) const
+{
+  elxout << "  Applying final transform was performed on the CPU, because "
+         << reason << "." << std::endl;
+} // end ReportCPUToLog()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxOpenCLResampler_hxx
@@ -62,6 +62,11 @@ namespace elastix
  *    transform. Should be one of {GeometricalCenter, CenterOfGravity, Origins, GeometryTop}.\n
  *    example: <tt>(AutomaticTransformInitializationMethod "CenterOfGravity")</tt> \n
  *    By default "GeometricalCenter" is assumed.\n
+ * \parameter AutomaticTransformInitializationSamplingStep: with the CenterOfGravity method,
+ *    use only every n-th voxel along every axis to compute the centers of gravity.
+ *    This saves time for large images.\n
+ *    example: <tt>(AutomaticTransformInitializationSamplingStep 4)</tt> \n
+ *    By default 1 is assumed, so all voxels are used.\n
  *
  * The transform parameters necessary for transformix, additionally defined by this class, are:
  * \transformparameter CenterOfRotation: stores the center of rotation as an index. \n
@@ -291,6 +291,11 @@ AdvancedAffineTransformElastix< TElastix >
     if( method == "CenterOfGravity" )
     {
       transformInitializer->MomentsOn();
+
+      unsigned int samplingStep = 1;
+      this->m_Configuration->ReadParameter( samplingStep,
+        "AutomaticTransformInitializationSamplingStep", 0, false );
+      transformInitializer->SetCenterOfGravitySamplingStep( samplingStep );
     }
     else if( method == "Origins" )
     {
@@ -37,9 +37,11 @@
 #include "itkObject.h"
 #include "itkObjectFactory.h"
 #include "itkSpatialObject.h"
-#include "itkImageMomentsCalculator.h"
+#include "itkImage.h"
+#include "itkMultiThreader.h"
 
 #include <iostream>
+#include <vector>
 
 namespace itk
 {
@@ -73,6 +75,8 @@ namespace itk
  * are similar for both images and hence the best initial guess for
  * registration is to superimpose both mass centers.  Note that this
  * assumption will probably not hold in multi-modality registration.
+ * The centers of mass are computed multi-threaded, and optionally on a
+ * subsampled grid of voxels, see SetCenterOfGravitySamplingStep().
  *
  * In the third mode, the vector from the coordinates (0,0,0) of the
  * fixed image to the coordinates (0,0,0) of the moving image is passed as the
@@ -127,17 +131,6 @@ public:
   typedef typename FixedImageMaskType::ConstPointer    FixedImageMaskPointer;
   typedef typename MovingImageMaskType::ConstPointer   MovingImageMaskPointer;
 
-  /** Moment calculators */
-  typedef ImageMomentsCalculator< FixedImageType >
-    FixedImageCalculatorType;
-  typedef ImageMomentsCalculator< MovingImageType >
-    MovingImageCalculatorType;
-
-  typedef typename FixedImageCalculatorType::Pointer
-    FixedImageCalculatorPointer;
-  typedef typename MovingImageCalculatorType::Pointer
-    MovingImageCalculatorPointer;
-
   /** Offset type. */
   typedef typename TransformType::OffsetType OffsetType;
 
@@ -170,9 +163,23 @@ public:
   void OriginsOn()     { m_UseMoments = false; m_UseOrigins = true; m_UseTop = false; }
   void GeometryTopOn() { m_UseMoments = false; m_UseOrigins = false; m_UseTop = true; }
 
-  /** Get() access to the moments calculators */
-  itkGetConstObjectMacro( FixedCalculator,  FixedImageCalculatorType  );
-  itkGetConstObjectMacro( MovingCalculator, MovingImageCalculatorType );
+  /** Get the centers of gravity, as computed by InitializeTransform() with MomentsOn(). */
+  itkGetConstReferenceMacro( FixedImageCenterOfGravity, InputPointType );
+  itkGetConstReferenceMacro( MovingImageCenterOfGravity, InputPointType );
+
+  /** Set/Get the sampling step of the center of gravity computation. With a
+   * step of s only every s-th voxel along every axis is used, which for large
+   * images gives nearly the same center in a fraction of the time. Default: 1.
+   */
+  itkSetClampMacro( CenterOfGravitySamplingStep, unsigned int,
+    1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( CenterOfGravitySamplingStep, unsigned int );
+
+  /** Set/Get the number of threads of the center of gravity computation.
+   * Default: the global default number of threads of the MultiThreader.
+   */
+  itkSetClampMacro( NumberOfThreads, ThreadIdType, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
 
 protected:
 
@@ -183,6 +190,32 @@ protected:
 
   itkGetObjectMacro( Transform, TransformType );
 
+  /** Compute the center of gravity of the gray values of an image, inside
+   * the mask if there is one. Every thread accumulates the sum of the gray
+   * values and the gray value weighted sum of the voxel indices of a slab of
+   * the image. The index sums are converted to a physical point at the end,
+   * which is exact, because that conversion is affine.
+   */
+  template< class TImage, class TMask >
+  void ComputeCenterOfGravity( const TImage * image, const TMask * mask,
+    typename TImage::PointType & center ) const;
+
+  /** The parameters and the per-thread results of ComputeCenterOfGravity(). */
+  template< class TImage, class TMask >
+  struct CenterOfGravityThreaderParameterType
+  {
+    const TImage *                       m_Image;
+    const TMask *                        m_Mask;
+    bool                                 m_MaskHasImageGeometry;
+    unsigned int                         m_SamplingStep;
+    std::vector< double >                m_SumsOfWeights;
+    std::vector< std::vector< double > > m_WeightedIndexSums;
+  };
+
+  /** ComputeCenterOfGravity() threader callback function. */
+  template< class TImage, class TMask >
+  static ITK_THREAD_RETURN_TYPE CenterOfGravityThreaderCallback( void * arg );
+
 private:
 
   CenteredTransformInitializer2( const Self & ); // purposely not implemented
@@ -199,8 +232,10 @@ private:
   bool m_UseOrigins;
   bool m_UseTop;
 
-  FixedImageCalculatorPointer  m_FixedCalculator;
-  MovingImageCalculatorPointer m_MovingCalculator;
+  InputPointType m_FixedImageCenterOfGravity;
+  InputPointType m_MovingImageCenterOfGravity;
+  unsigned int   m_CenterOfGravitySamplingStep;
+  ThreadIdType   m_NumberOfThreads;
 
 };
 
@@ -36,6 +36,7 @@
 
 #include "itkCenteredTransformInitializer2.h"
 #include "itkImageMaskSpatialObject.h"
+#include "itkImageLinearConstIteratorWithIndex.h"
 
 namespace itk
 {
@@ -44,11 +45,13 @@ template< class TTransform, class TFixedImage, class TMovingImage >
 CenteredTransformInitializer2< TTransform, TFixedImage, TMovingImage >
 ::CenteredTransformInitializer2()
 {
-  m_FixedCalculator  = FixedImageCalculatorType::New();
-  m_MovingCalculator = MovingImageCalculatorType::New();
-  m_UseMoments       = false;
-  m_UseOrigins       = false;
-  m_UseTop           = false;
+  m_UseMoments                  = false;
+  m_UseOrigins                  = false;
+  m_UseTop                      = false;
+  m_CenterOfGravitySamplingStep = 1;
+  m_NumberOfThreads             = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  m_FixedImageCenterOfGravity.Fill( 0.0 );
+  m_MovingImageCenterOfGravity.Fill( 0.0 );
 }
 
 
@@ -93,38 +96,21 @@ CenteredTransformInitializer2< TTransform, TFixedImage, TMovingImage >
 
   if( m_UseMoments )
   {
-    // Convert the masks to spatial objects
-    typename FixedMaskSpatialObjectType::Pointer fixedMaskAsSpatialObject = 0;
-    if( this->m_FixedImageMask )
-    {
-      fixedMaskAsSpatialObject = FixedMaskSpatialObjectType::New();
-      fixedMaskAsSpatialObject->SetImage( this->m_FixedImageMask );
-    }
-
-    typename MovingMaskSpatialObjectType::Pointer movingMaskAsSpatialObject = 0;
-    if( this->m_MovingImageMask )
-    {
-      movingMaskAsSpatialObject = MovingMaskSpatialObjectType::New();
-      movingMaskAsSpatialObject->SetImage( this->m_MovingImageMask );
-    }
-
-    // Moments
-    m_FixedCalculator->SetImage(  m_FixedImage );
-    m_FixedCalculator->SetSpatialObjectMask( fixedMaskAsSpatialObject );
-    m_FixedCalculator->Compute();
-
-    m_MovingCalculator->SetImage( m_MovingImage );
-    m_MovingCalculator->SetSpatialObjectMask( movingMaskAsSpatialObject );
-    m_MovingCalculator->Compute();
-
-    typename FixedImageCalculatorType::VectorType fixedCenter = m_FixedCalculator->GetCenterOfGravity();
+    // Centers of gravity, inside the masks
+    typename FixedImageType::PointType fixedCenter;
+    this->ComputeCenterOfGravity( this->m_FixedImage.GetPointer(),
+      this->m_FixedImageMask.GetPointer(), fixedCenter );
 
-    typename MovingImageCalculatorType::VectorType movingCenter = m_MovingCalculator->GetCenterOfGravity();
+    typename MovingImageType::PointType movingCenter;
+    this->ComputeCenterOfGravity( this->m_MovingImage.GetPointer(),
+      this->m_MovingImageMask.GetPointer(), movingCenter );
 
     for( unsigned int i = 0; i < InputSpaceDimension; i++ )
     {
-      rotationCenter[ i ]    = fixedCenter[ i ];
-      translationVector[ i ] = movingCenter[ i ] - fixedCenter[ i ];
+      m_FixedImageCenterOfGravity[ i ]  = fixedCenter[ i ];
+      m_MovingImageCenterOfGravity[ i ] = movingCenter[ i ];
+      rotationCenter[ i ]               = fixedCenter[ i ];
+      translationVector[ i ]            = movingCenter[ i ] - fixedCenter[ i ];
     }
   }
   else if( m_UseOrigins )
@@ -369,33 +355,190 @@ CenteredTransformInitializer2< TTransform, TFixedImage, TMovingImage >
     os << indent << "None" << std::endl;
   }
 
-  os << indent << "MovingMomentCalculator   = " << std::endl;
-  if( m_UseMoments && m_MovingCalculator )
+  if( m_UseMoments )
   {
-    os << indent << m_MovingCalculator  << std::endl;
+    os << indent << "FixedImageCenterOfGravity   = " << m_FixedImageCenterOfGravity << std::endl;
+    os << indent << "MovingImageCenterOfGravity   = " << m_MovingImageCenterOfGravity << std::endl;
   }
-  else if( m_UseOrigins && m_MovingCalculator )
+  os << indent << "CenterOfGravitySamplingStep   = " << m_CenterOfGravitySamplingStep << std::endl;
+  os << indent << "NumberOfThreads   = " << m_NumberOfThreads << std::endl;
+
+}
+
+
+/** Compute the center of gravity of an image, inside its mask */
+template< class TTransform, class TFixedImage, class TMovingImage >
+template< class TImage, class TMask >
+void
+CenteredTransformInitializer2< TTransform, TFixedImage, TMovingImage >
+::ComputeCenterOfGravity( const TImage * image, const TMask * mask,
+  typename TImage::PointType & center ) const
+{
+  const unsigned int Dimension = TImage::ImageDimension;
+
+  // A mask on the voxel grid of the image is indexed directly; otherwise
+  // every voxel center is mapped to the nearest voxel of the mask.
+  CenterOfGravityThreaderParameterType< TImage, TMask > parameters;
+  parameters.m_Image                = image;
+  parameters.m_Mask                 = mask;
+  parameters.m_MaskHasImageGeometry = mask
+    && mask->GetOrigin() == image->GetOrigin()
+    && mask->GetSpacing() == image->GetSpacing()
+    && mask->GetDirection() == image->GetDirection();
+  parameters.m_SamplingStep = m_CenterOfGravitySamplingStep;
+  parameters.m_SumsOfWeights.assign( m_NumberOfThreads, 0.0 );
+  parameters.m_WeightedIndexSums.assign( m_NumberOfThreads,
+    std::vector< double >( Dimension, 0.0 ) );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( m_NumberOfThreads );
+  threader->SetSingleMethod(
+    &Self::template CenterOfGravityThreaderCallback< TImage, TMask >, &parameters );
+  threader->SingleMethodExecute();
+
+  // Combine the results of the threads
+  double                sumOfWeights = 0.0;
+  std::vector< double > weightedIndexSum( Dimension, 0.0 );
+  for( ThreadIdType t = 0; t < m_NumberOfThreads; ++t )
   {
-    os << indent << m_MovingCalculator  << std::endl;
+    sumOfWeights += parameters.m_SumsOfWeights[ t ];
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      weightedIndexSum[ d ] += parameters.m_WeightedIndexSums[ t ][ d ];
+    }
   }
-  else
+
+  if( sumOfWeights == 0.0 )
   {
-    os << indent << "None" << std::endl;
+    itkExceptionMacro( << "ERROR: the total mass of the image is zero, "
+                       << "so its center of gravity is not defined." );
   }
 
-  os << indent << "FixedMomentCalculator   = " << std::endl;
-  if( m_UseMoments && m_FixedCalculator )
+  ContinuousIndex< double, TImage::ImageDimension > centerIndex;
+  for( unsigned int d = 0; d < Dimension; ++d )
   {
-    os << indent << m_FixedCalculator  << std::endl;
+    centerIndex[ d ] = weightedIndexSum[ d ] / sumOfWeights;
   }
-  else if( m_UseOrigins && m_FixedCalculator )
+  image->TransformContinuousIndexToPhysicalPoint( centerIndex, center );
+
+}
+
+
+/** The threader callback of ComputeCenterOfGravity() */
+template< class TTransform, class TFixedImage, class TMovingImage >
+template< class TImage, class TMask >
+ITK_THREAD_RETURN_TYPE
+CenteredTransformInitializer2< TTransform, TFixedImage, TMovingImage >
+::CenterOfGravityThreaderCallback( void * arg )
+{
+  typedef typename TImage::RegionType                           RegionType;
+  typedef typename TImage::IndexType                            IndexType;
+  typedef typename TImage::PointType                            PointType;
+  typedef ImageLinearConstIteratorWithIndex< TImage >           IteratorType;
+  typedef CenterOfGravityThreaderParameterType< TImage, TMask > ParameterType;
+
+  const unsigned int Dimension = TImage::ImageDimension;
+
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  const ThreadIdType threadId    = infoStruct->ThreadID;
+  const ThreadIdType nrOfThreads = infoStruct->NumberOfThreads;
+  ParameterType *    parameters  = static_cast< ParameterType * >( infoStruct->UserData );
+  if( threadId >= parameters->m_SumsOfWeights.size() )
   {
-    os << indent << m_FixedCalculator  << std::endl;
+    return ITK_THREAD_RETURN_VALUE;
   }
-  else
+
+  const TImage *     image = parameters->m_Image;
+  const TMask *      mask  = parameters->m_Mask;
+  const unsigned int step  = parameters->m_SamplingStep;
+
+  // Split the buffered region in slabs along its outermost axis of more than one voxel
+  const RegionType & fullRegion = image->GetBufferedRegion();
+  RegionType         region     = fullRegion;
+  unsigned int       splitAxis  = Dimension - 1;
+  while( splitAxis > 0 && region.GetSize()[ splitAxis ] <= 1 )
   {
-    os << indent << "None" << std::endl;
+    --splitAxis;
+  }
+  const SizeValueType range     = region.GetSize()[ splitAxis ];
+  const SizeValueType chunkSize = ( range + nrOfThreads - 1 ) / nrOfThreads;
+  const SizeValueType begin     = vnl_math_min( range, threadId * chunkSize );
+  const SizeValueType end       = vnl_math_min( range, begin + chunkSize );
+  if( end <= begin )
+  {
+    return ITK_THREAD_RETURN_VALUE;
   }
+  region.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + static_cast< OffsetValueType >( begin ) );
+  region.SetSize( splitAxis, end - begin );
+
+  // Accumulate line by line. Along a line only the weight and the first index
+  // change, so the inner loop is a plain multiply-add; the other indices are
+  // multiplied by the sum of the weights of the line.
+  double                sumOfWeights = 0.0;
+  std::vector< double > weightedIndexSum( Dimension, 0.0 );
+  const IndexType &     start      = fullRegion.GetIndex();
+  const RegionType &    maskRegion = mask ? mask->GetBufferedRegion() : region;
+
+  IteratorType it( image, region );
+  it.SetDirection( 0 );
+  PointType point;
+  IndexType maskIndex;
+  for( it.GoToBegin(); !it.IsAtEnd(); it.NextLine() )
+  {
+    // Skip the lines that are not on the sampling grid
+    const IndexType   lineIndex = it.GetIndex();
+    bool              onGrid    = true;
+    for( unsigned int d = 1; d < Dimension; ++d )
+    {
+      onGrid &= ( lineIndex[ d ] - start[ d ] ) % step == 0;
+    }
+    if( !onGrid )
+    {
+      continue;
+    }
+
+    double lineWeight      = 0.0;
+    double lineWeightedSum = 0.0;
+    for( OffsetValueType x = it.GetIndex()[ 0 ]; !it.IsAtEndOfLine(); ++it, ++x )
+    {
+      if( ( x - start[ 0 ] ) % step != 0 )
+      {
+        continue;
+      }
+      if( mask )
+      {
+        if( parameters->m_MaskHasImageGeometry )
+        {
+          maskIndex = it.GetIndex();
+        }
+        else
+        {
+          image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+          mask->TransformPhysicalPointToIndex( point, maskIndex );
+        }
+        if( !maskRegion.IsInside( maskIndex ) || mask->GetPixel( maskIndex ) == 0 )
+        {
+          continue;
+        }
+      }
+      const double weight = static_cast< double >( it.Get() );
+      lineWeight      += weight;
+      lineWeightedSum += weight * x;
+    }
+
+    sumOfWeights          += lineWeight;
+    weightedIndexSum[ 0 ] += lineWeightedSum;
+    for( unsigned int d = 1; d < Dimension; ++d )
+    {
+      weightedIndexSum[ d ] += lineWeight * lineIndex[ d ];
+    }
+  }
+
+  parameters->m_SumsOfWeights[ threadId ]     = sumOfWeights;
+  parameters->m_WeightedIndexSums[ threadId ] = weightedIndexSum;
+
+  return ITK_THREAD_RETURN_VALUE;
 
 }
 
@@ -67,6 +67,20 @@ namespace elastix
  *   The default is zero for all resolutions. A value of 4 will avoid all deformations
  *   at the edge of the image. Make sure that 2*PassiveEdgeWidth < ControlPointGridSize
  *   in each dimension.
+ * \parameter UseInterleavedBSplineCoefficients: store a copy of the B-spline coefficients
+ *   with the coefficients of one control point next to each other, which reduces the
+ *   memory traffic of transforming points. It costs a copy of the coefficients each time
+ *   the parameters are set. Can be specified for each resolution. \n
+ *   example: <tt>(UseInterleavedBSplineCoefficients "true")</tt> \n
+ *   The default is "false".
+ * \parameter UseDyadicBSplineRefinement: compute the coefficients of the next
+ *   resolution directly with the B-spline refinement mask, when the grid spacing halves
+ *   and the new control points lie on or halfway between the current ones. This
+ *   reproduces the current deformation exactly, whereas by default it is interpolated at
+ *   the new control points, which gives slightly different results near the grid border.
+ *   Only used for odd spline orders. Can be specified for each resolution. \n
+ *   example: <tt>(UseDyadicBSplineRefinement "true")</tt> \n
+ *   The default is "false".
  * \parameter UseCyclicTransform: use the cyclic version of the B-spline transform which
  *   ensures that the B-spline polynomials wrap around in the slowest varying dimension.
  *   This is useful for dynamic imaging data in which the motion is assumed to be cyclic,
@@ -211,6 +211,12 @@ AdvancedBSplineTransform< TElastix >
     "PassiveEdgeWidth", this->GetComponentLabel(), level, 0, false );
   this->SetOptimizerScales( passiveEdgeWidth );
 
+  /** Check if the coefficients are interleaved for transforming points. */
+  bool useInterleavedCoefficients = false;
+  this->GetConfiguration()->ReadParameter( useInterleavedCoefficients,
+    "UseInterleavedBSplineCoefficients", this->GetComponentLabel(), level, 0, false );
+  this->m_BSplineTransform->SetUseInterleavedCoefficients( useInterleavedCoefficients );
+
 } // end BeforeEachResolution()
 
 
@@ -446,7 +452,13 @@ AdvancedBSplineTransform< TElastix >
   ParametersType latestParameters
     = this->m_Registration->GetAsITKBaseType()->GetLastTransformParameters();
 
+  /** Check if the coefficients are refined directly. */
+  bool useDyadicRefinement = false;
+  this->GetConfiguration()->ReadParameter( useDyadicRefinement,
+    "UseDyadicBSplineRefinement", this->GetComponentLabel(), level, 0, false );
+
   /** Setup the GridUpsampler. */
+  this->m_GridUpsampler->SetUseDyadicRefinement( useDyadicRefinement );
   this->m_GridUpsampler->SetCurrentGridOrigin( currentGridOrigin );
   this->m_GridUpsampler->SetCurrentGridSpacing( currentGridSpacing );
   this->m_GridUpsampler->SetCurrentGridRegion( currentGridRegion );
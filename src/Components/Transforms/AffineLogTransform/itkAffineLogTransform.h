@@ -20,12 +20,16 @@
 
 #include <iostream>
 #include "itkAdvancedMatrixOffsetTransformBase.h"
+#include "itkMatrixExponential.h"
 
 namespace itk
 {
 
 /** \class AffineLogTransform
  *
+ * The matrix is the exponential of the matrix parameters. The exponential
+ * and its derivatives are only recomputed in SetParameters() when the
+ * matrix parameters changed, see MatrixExponential.
  *
  * \ingroup Transforms
  */
@@ -84,6 +88,8 @@ public:
 
   typedef FixedArray< ScalarType > ScalarArrayType;
 
+  typedef MatrixExponential< ScalarType, Dimension > MatrixExponentialType;
+
   void SetParameters( const ParametersType & parameters );
 
   const ParametersType & GetParameters( void ) const;
@@ -118,6 +124,10 @@ private:
 
   MatrixType m_MatrixLogDomain;
 
+  /** exp( m_MatrixLogDomain ), valid if m_MatrixExponentialIsValid. */
+  MatrixType m_MatrixExponential;
+  bool       m_MatrixExponentialIsValid;
+
 };
 
 }  // namespace itk
@@ -18,7 +18,6 @@
 #ifndef __itkAffineLogTransform_hxx
 #define __itkAffineLogTransform_hxx
 
-#include "vnl/vnl_matrix_exp.h"
 #include "itkMath.h"
 #include "itkAffineLogTransform.h"
 
@@ -32,6 +31,8 @@ AffineLogTransform< TScalarType, Dimension >
   Superclass( ParametersDimension )
 {
   this->m_MatrixLogDomain.Fill( itk::NumericTraits< ScalarType >::Zero );
+  this->m_MatrixExponential.SetIdentity();
+  this->m_MatrixExponentialIsValid = true;
   this->PrecomputeJacobianOfSpatialJacobian();
 }
 
@@ -42,6 +43,8 @@ AffineLogTransform< TScalarType, Dimension >
 ::AffineLogTransform( const MatrixType & matrix,
   const OutputPointType & offset )
 {
+  this->m_MatrixLogDomain.Fill( itk::NumericTraits< ScalarType >::Zero );
+  this->m_MatrixExponentialIsValid = false;
   this->SetMatrix( matrix );
 
   OffsetType off;
@@ -63,6 +66,8 @@ AffineLogTransform< TScalarType, Dimension >
   Superclass( spaceDimension, parametersDimension )
 {
   this->m_MatrixLogDomain.Fill( itk::NumericTraits< ScalarType >::Zero );
+  this->m_MatrixExponential.SetIdentity();
+  this->m_MatrixExponentialIsValid = true;
   this->PrecomputeJacobianOfSpatialJacobian();
 }
 
@@ -76,22 +81,30 @@ AffineLogTransform< TScalarType, Dimension >
   itkDebugMacro( << "Setting parameters " << parameters );
   unsigned int k = 0; //Dummy loop index
 
-  MatrixType exponentMatrix;
+  MatrixType matrixLogDomain;
 
   for( unsigned int i = 0; i < Dimension; i++ )
   {
     for( unsigned int j = 0; j < Dimension; j++ )
     {
-      this->m_MatrixLogDomain( i, j ) = parameters[ k ];
-      k                              += 1;
+      matrixLogDomain( i, j ) = parameters[ k ];
+      k                      += 1;
     }
   }
 
-  exponentMatrix = vnl_matrix_exp( this->m_MatrixLogDomain.GetVnlMatrix() );
-
-  this->PrecomputeJacobianOfSpatialJacobian();
+  /** The exponential and its derivatives only depend on the matrix
+   * parameters, which often do not change, e.g. in a stack transform
+   * or when only the translation is optimized.
+   */
+  if( !this->m_MatrixExponentialIsValid || matrixLogDomain != this->m_MatrixLogDomain )
+  {
+    this->m_MatrixLogDomain          = matrixLogDomain;
+    this->m_MatrixExponential        = MatrixExponentialType::Compute( matrixLogDomain );
+    this->m_MatrixExponentialIsValid = true;
+    this->PrecomputeJacobianOfSpatialJacobian();
+  }
 
-  this->SetVarMatrix( exponentMatrix );
+  this->SetVarMatrix( this->m_MatrixExponential );
 
   OutputVectorType off;
 
@@ -146,6 +159,8 @@ AffineLogTransform< TScalarType, Dimension >
 {
   Superclass::SetIdentity();
   this->m_MatrixLogDomain.Fill( itk::NumericTraits< ScalarType >::Zero );
+  this->m_MatrixExponential.SetIdentity();
+  this->m_MatrixExponentialIsValid = true;
   this->PrecomputeJacobianOfSpatialJacobian();
 }
 
@@ -198,60 +213,19 @@ AffineLogTransform< TScalarType, Dimension >
 
   jsj.resize( ParametersDimension );
 
-  vnl_matrix< ScalarType > dA( d, d );
-
-  vnl_matrix< ScalarType > dummymatrix( d, d );
-
-  vnl_matrix< ScalarType > A_bar( 2 * d, 2 * d );
-
-  vnl_matrix< ScalarType > B_bar( 2 * d, 2 * d );
-
-  dA.fill( itk::NumericTraits< ScalarType >::Zero );
-  dummymatrix.fill( itk::NumericTraits< ScalarType >::Zero );
-  A_bar.fill( itk::NumericTraits< ScalarType >::Zero );
-
-  // Fill A_bar top left and bottom right with A
-  for( unsigned int k = 0; k < d; k++ )
-  {
-    for( unsigned int l = 0; l < d; l++ )
-    {
-      A_bar( k, l ) = this->m_MatrixLogDomain( k, l );
-    }
-  }
-  for( unsigned int k = d; k < 2 * d; k++ )
-  {
-    for( unsigned int l = d; l < 2 * d; l++ )
-    {
-      A_bar( k, l ) = this->m_MatrixLogDomain( k - d, l - d );
-    }
-  }
-
+  /** Non-translation derivatives: the derivative of exp( A ) with respect to
+   * A(i,j) is its Frechet derivative in the direction of the unit matrix E_ij.
+   */
+  MatrixType   dA;
   unsigned int m = 0; //Dummy loop index
-
-  //Non-translation derivatives
   for( unsigned int i = 0; i < d; i++ )
   {
     for( unsigned int j = 0; j < d; j++ )
     {
+      dA.Fill( itk::NumericTraits< ScalarType >::Zero );
       dA( i, j ) = 1;
-      for( unsigned int k = 0; k < d; k++ )
-      {
-        for( unsigned int l = d; l < 2 * d; l++ )
-        {
-          A_bar( k, l ) = dA( k, ( l - d ) );
-        }
-      }
-      B_bar = vnl_matrix_exp( A_bar );
-      for( unsigned int k = 0; k < d; k++ )
-      {
-        for( unsigned int l = d; l < 2 * d; l++ )
-        {
-          dummymatrix( k, ( l - d ) ) = B_bar( k, l );
-        }
-      }
-      jsj[ m ] = dummymatrix;
-      dA.fill( itk::NumericTraits< ScalarType >::Zero );
-      m += 1;
+      jsj[ m ]   = MatrixExponentialType::ComputeDerivative( this->m_MatrixLogDomain, dA );
+      m         += 1;
     }
   }
 
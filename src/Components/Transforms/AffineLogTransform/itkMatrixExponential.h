@@ -0,0 +1,239 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMatrixExponential_h
+#define __itkMatrixExponential_h
+
+#include "itkMatrix.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/** \class MatrixExponential
+ *
+ * \brief The exponential of a small fixed-size matrix, and its Frechet
+ * derivative.
+ *
+ * The exponential is computed by scaling and squaring: the matrix is
+ * scaled by a power of two until its 1-norm is below 0.5, then the (6,6)
+ * Pade approximant is evaluated, which is accurate to double precision
+ * for such a norm, and the result is squared back. The Frechet derivative
+ * in the direction E is the upper right block of the exponential of
+ * [ A E ; 0 A ].
+ *
+ * All loops have bounds known at compile time, and nothing is allocated
+ * on the heap, unlike vnl_matrix_exp.
+ *
+ * \ingroup Transforms
+ */
+
+template< class TScalarType, unsigned int NDimension >
+class MatrixExponential
+{
+public:
+
+  typedef Matrix< TScalarType, NDimension, NDimension >         MatrixType;
+  typedef Matrix< TScalarType, 2 * NDimension, 2 * NDimension >         BlockMatrixType;
+
+  /** Compute exp( A ). */
+  static MatrixType Compute( const MatrixType & A )
+  {
+    return ComputeExponential< NDimension >( A );
+  }
+
+
+  /** Compute the Frechet derivative of exp in A, in the direction E. */
+  static MatrixType ComputeDerivative( const MatrixType & A, const MatrixType & E )
+  {
+    BlockMatrixType block;
+    block.Fill( 0.0 );
+    for( unsigned int i = 0; i < NDimension; ++i )
+    {
+      for( unsigned int j = 0; j < NDimension; ++j )
+      {
+        block[ i ][ j ]                           = A[ i ][ j ];
+        block[ i + NDimension ][ j + NDimension ] = A[ i ][ j ];
+        block[ i ][ j + NDimension ]              = E[ i ][ j ];
+      }
+    }
+
+    const BlockMatrixType expBlock = ComputeExponential< 2 * NDimension >( block );
+    MatrixType            derivative;
+    for( unsigned int i = 0; i < NDimension; ++i )
+    {
+      for( unsigned int j = 0; j < NDimension; ++j )
+      {
+        derivative[ i ][ j ] = expBlock[ i ][ j + NDimension ];
+      }
+    }
+    return derivative;
+  }
+
+
+private:
+
+  /** out = a * b. */
+  template< unsigned int N >
+  static void Multiply( const Matrix< TScalarType, N, N > & a,
+    const Matrix< TScalarType, N, N > & b, Matrix< TScalarType, N, N > & out )
+  {
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      for( unsigned int j = 0; j < N; ++j )
+      {
+        TScalarType sum = 0.0;
+        for( unsigned int k = 0; k < N; ++k )
+        {
+          sum += a[ i ][ k ] * b[ k ][ j ];
+        }
+        out[ i ][ j ] = sum;
+      }
+    }
+  }
+
+
+  /** Scaling and squaring with the (6,6) Pade approximant. */
+  template< unsigned int N >
+  static Matrix< TScalarType, N, N > ComputeExponential( const Matrix< TScalarType, N, N > & A )
+  {
+    typedef Matrix< TScalarType, N, N > SquareMatrixType;
+
+    /** Scale A such that its 1-norm is at most 0.5. */
+    double norm = 0.0;
+    for( unsigned int j = 0; j < N; ++j )
+    {
+      double columnSum = 0.0;
+      for( unsigned int i = 0; i < N; ++i )
+      {
+        columnSum += std::abs( static_cast< double >( A[ i ][ j ] ) );
+      }
+      norm = columnSum > norm ? columnSum : norm;
+    }
+    int squarings = 0;
+    if( norm > 0.5 )
+    {
+      squarings = static_cast< int >( std::ceil( std::log( norm / 0.5 ) / std::log( 2.0 ) ) );
+    }
+    const TScalarType scale = static_cast< TScalarType >( std::ldexp( 1.0, -squarings ) );
+
+    SquareMatrixType X;
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      for( unsigned int j = 0; j < N; ++j )
+      {
+        X[ i ][ j ] = A[ i ][ j ] * scale;
+      }
+    }
+
+    /** The Pade coefficients c_k = (12-k)! 6! / ( 12! k! (6-k)! ). */
+    const TScalarType c1 = 1.0 / 2.0;
+    const TScalarType c2 = 5.0 / 44.0;
+    const TScalarType c3 = 1.0 / 66.0;
+    const TScalarType c4 = 1.0 / 792.0;
+    const TScalarType c5 = 1.0 / 15840.0;
+    const TScalarType c6 = 1.0 / 665280.0;
+
+    SquareMatrixType X2, X4, X6;
+    Multiply< N >( X, X, X2 );
+    Multiply< N >( X2, X2, X4 );
+    Multiply< N >( X4, X2, X6 );
+
+    /** U holds the odd terms, V the even terms: exp( X ) ~ ( V - U )^-1 ( V + U ). */
+    SquareMatrixType oddPart, U, V;
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      for( unsigned int j = 0; j < N; ++j )
+      {
+        const TScalarType identity = i == j ? 1.0 : 0.0;
+        oddPart[ i ][ j ] = c1 * identity + c3 * X2[ i ][ j ] + c5 * X4[ i ][ j ];
+        V[ i ][ j ]       = identity + c2 * X2[ i ][ j ] + c4 * X4[ i ][ j ] + c6 * X6[ i ][ j ];
+      }
+    }
+    Multiply< N >( X, oddPart, U );
+
+    SquareMatrixType P, Q;
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      for( unsigned int j = 0; j < N; ++j )
+      {
+        P[ i ][ j ] = V[ i ][ j ] + U[ i ][ j ];
+        Q[ i ][ j ] = V[ i ][ j ] - U[ i ][ j ];
+      }
+    }
+
+    /** Solve Q R = P by Gaussian elimination with partial pivoting; Q is
+     * well conditioned for the scaled matrix. The result overwrites P.
+     */
+    for( unsigned int k = 0; k < N; ++k )
+    {
+      unsigned int pivot = k;
+      for( unsigned int i = k + 1; i < N; ++i )
+      {
+        if( std::abs( Q[ i ][ k ] ) > std::abs( Q[ pivot ][ k ] ) ) { pivot = i; }
+      }
+      if( pivot != k )
+      {
+        for( unsigned int j = 0; j < N; ++j )
+        {
+          std::swap( Q[ k ][ j ], Q[ pivot ][ j ] );
+          std::swap( P[ k ][ j ], P[ pivot ][ j ] );
+        }
+      }
+      for( unsigned int i = k + 1; i < N; ++i )
+      {
+        const TScalarType factor = Q[ i ][ k ] / Q[ k ][ k ];
+        for( unsigned int j = k; j < N; ++j )
+        {
+          Q[ i ][ j ] -= factor * Q[ k ][ j ];
+        }
+        for( unsigned int j = 0; j < N; ++j )
+        {
+          P[ i ][ j ] -= factor * P[ k ][ j ];
+        }
+      }
+    }
+    for( unsigned int k = N; k-- > 0; )
+    {
+      for( unsigned int j = 0; j < N; ++j )
+      {
+        TScalarType sum = P[ k ][ j ];
+        for( unsigned int i = k + 1; i < N; ++i )
+        {
+          sum -= Q[ k ][ i ] * P[ i ][ j ];
+        }
+        P[ k ][ j ] = sum / Q[ k ][ k ];
+      }
+    }
+
+    /** Square back. */
+    SquareMatrixType squared;
+    for( int s = 0; s < squarings; ++s )
+    {
+      Multiply< N >( P, P, squared );
+      P = squared;
+    }
+    return P;
+  }
+
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMatrixExponential_h
@@ -25,6 +25,9 @@
 #include "itkNumericTraits.h"
 
 #include "itkRescaleIntensityImageFilter.h"
+#include "itkMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+#include <vector>
 
 namespace itk
 {
@@ -37,6 +40,14 @@ namespace itk
  *
  * A mean filter is one of the family of linear filters.
  *
+ * Every iteration computes y = (1 - c) x + c mean, with mean the average of
+ * x over the box neighbourhood, weighted by the coefficient image c. The
+ * weighted sums are computed separably, with running sums along the
+ * image lines, so that the cost does not depend on the radius. The coefficient
+ * sums are computed once for all iterations. The lines are distributed over
+ * the threads of the PersistentThreadPool. The boundary condition is zero
+ * flux Neumann.
+ *
  * \sa Image
  * \sa Neighborhood
  * \sa NeighborhoodOperator
@@ -158,6 +169,39 @@ private:
   /** For calculating a feature image from the input m_GrayValueImage. */
   void FilterGrayValueImage( void );
 
+  /** The parts of GenerateData() that are distributed over the threads. */
+  typedef enum { MultiplyPhase, BoxSumPhase, UpdatePhase } ThreaderPhaseType;
+
+  /** Run a phase on the threads, in chunks of [0, size[. */
+  void ThreadedExecute( ThreaderPhaseType phase, SizeValueType size );
+
+  /** Box sum along every dimension; source and scratch are swapped, and
+   * the returned buffer holds the result. */
+  double * BoxSum( double * source, double * scratch, unsigned int numberOfComponents );
+
+  /** Box sum along the lines [firstLine, endLine[ of one dimension. */
+  void BoxSumLines( SizeValueType firstLine, SizeValueType endLine ) const;
+
+  /** The multiply and update steps for the voxels [first, end[. */
+  void MultiplyVoxels( SizeValueType first, SizeValueType end ) const;
+  void UpdateVoxels( SizeValueType first, SizeValueType end ) const;
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void * arg );
+
+  /** The state shared with the threads. */
+  InputSizeType     m_BufferSize;
+  InputPixelType *  m_OutputBuffer;
+  const double *    m_CoefficientBuffer;
+  const double *    m_CoefficientSums;
+  const double *    m_ThreaderSource;
+  double *          m_ThreaderDestination;
+  unsigned int      m_ThreaderComponents;
+  unsigned int      m_ThreaderDimension;
+  ThreaderPhaseType m_ThreaderPhase;
+
+  /** The chunks of the current phase, handed out to the threads. */
+  mutable PersistentThreadPool::WorkChunks m_WorkChunks;
+
 };
 
 } // end namespace itk
@@ -21,11 +21,10 @@
 
 #include "itkVectorMeanDiffusionImageFilter.h"
 
-#include "itkNeighborhoodIterator.h"
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
-#include "itkZeroFluxNeumannBoundaryCondition.h"
-#include "itkProgressReporter.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -45,6 +44,15 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
   this->m_GrayValueImage = 0;
   this->m_Cx             = 0;
 
+  this->m_OutputBuffer        = 0;
+  this->m_CoefficientBuffer   = 0;
+  this->m_CoefficientSums     = 0;
+  this->m_ThreaderSource      = 0;
+  this->m_ThreaderDestination = 0;
+  this->m_ThreaderComponents  = 0;
+  this->m_ThreaderDimension   = 0;
+  this->m_ThreaderPhase       = MultiplyPhase;
+
 } // end Constructor
 
 
@@ -115,30 +123,12 @@ void
 VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
 ::GenerateData( void )
 {
-  // \todo to avoid all the copying we can create a vector of
-  // outputs of size this->GetNumberOfIterations(). The last
-  // output should point to this->GetOutput(). In order to avoid
-  // a big memory footprint, at some iteration k, memory of the
-  // former iteration should be released: output[ k - 1 ] = 0,
-  // and memory of the current iteration should only now be created:
-  // output[ k ] = InputImageType::New(); ...; output[ k ]->Allocate().
-  // Only for the last iteration: output[ k ]( this->GetOutput() ).
-
   /** Create feature image. */
   this->FilterGrayValueImage();
 
-  /** Declare things. */
-  unsigned int                                        i, j;
-  ZeroFluxNeumannBoundaryCondition< InputImageType >  nbc;
-  ZeroFluxNeumannBoundaryCondition< DoubleImageType > nbc2;
-  NeighborhoodIterator< InputImageType >              nit;
-  NeighborhoodIterator< DoubleImageType >             nit2;
-  VectorRealType                                      sum;
-
   /** Allocate output. */
   typename InputImageType::ConstPointer input( this->GetInput() );
   typename InputImageType::Pointer      output( this->GetOutput() );
-  typename InputImageType::Pointer outputtmp = InputImageType::New();
   output->SetRegions( input->GetLargestPossibleRegion() );
 
   try
@@ -155,28 +145,6 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
     throw excp;
   }
 
-  /** Allocate a temporary output image. */
-  outputtmp->SetSpacing( input->GetSpacing() );
-  outputtmp->SetOrigin( input->GetOrigin() );
-  outputtmp->SetRegions( input->GetLargestPossibleRegion() );
-
-  try
-  {
-    outputtmp->Allocate();
-  }
-  catch( itk::ExceptionObject & excp )
-  {
-    /** Add information to the exception and throw again. */
-    excp.SetLocation( "VectorMeanDiffusionImageFilter - GenerateData()" );
-    std::string err_str = excp.GetDescription();
-    err_str += "\nError occurred while allocating a temporary copy.\n";
-    excp.SetDescription( err_str );
-    throw excp;
-  }
-
-  // support progress methods/callbacks
-  //ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
-
   /** Copy input to output. */
   ImageRegionConstIterator< InputImageType > in_it(
   input, input->GetLargestPossibleRegion() );
@@ -191,115 +159,259 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
     ++out_it;
   }
 
-  /** Setup neighborhood iterator for the output deformation image. */
-  nit = NeighborhoodIterator< InputImageType >(
-    this->m_Radius, output, output->GetLargestPossibleRegion() );
-  unsigned int neighborhoodSize = nit.Size();
-  nit.OverrideBoundaryCondition( &nbc );
+  if( this->GetNumberOfIterations() == 0 )
+  {
+    return;
+  }
+
+  /** The coefficient image should cover the deformation field. */
+  const InputImageRegionType & region = input->GetLargestPossibleRegion();
+  if( this->m_Cx->GetLargestPossibleRegion().GetSize() != region.GetSize()
+    || this->m_Cx->GetBufferedRegion() != this->m_Cx->GetLargestPossibleRegion() )
+  {
+    itkExceptionMacro( << "ERROR: the grayValue image should have the size of the input image." );
+  }
 
-  /** Setup neighborhood iterator for the "stiffness coefficient" image. */
-  nit2 = NeighborhoodIterator< DoubleImageType >(
-    this->m_Radius, this->m_Cx, this->m_Cx->GetLargestPossibleRegion() );
-  nit2.OverrideBoundaryCondition( &nbc2 );
+  /** Allocate the buffers for the weighted sums. */
+  const SizeValueType   numberOfVoxels = region.GetNumberOfPixels();
+  std::vector< double > buffer1;
+  std::vector< double > buffer2;
+  std::vector< double > coefficientSums;
+  try
+  {
+    buffer1.resize( numberOfVoxels * InputImageDimension );
+    buffer2.resize( numberOfVoxels * InputImageDimension );
+    coefficientSums.resize( numberOfVoxels );
+  }
+  catch( std::bad_alloc & )
+  {
+    itkExceptionMacro( << "ERROR: failed to allocate memory for the diffusion." );
+  }
 
-  /** Setup iterator over outputtmp. */
-  ImageRegionIterator< InputImageType > oit(
-  outputtmp, input->GetLargestPossibleRegion() );
+  this->m_BufferSize        = region.GetSize();
+  this->m_OutputBuffer      = output->GetBufferPointer();
+  this->m_CoefficientBuffer = this->m_Cx->GetBufferPointer();
 
-  /** Initialize c and ci. */
-  double c  = 0.0;
-  double ci = 0.0;
+  /** The sums of c over the neighbourhoods do not change over the iterations. */
+  std::copy( this->m_CoefficientBuffer, this->m_CoefficientBuffer + numberOfVoxels, buffer1.begin() );
+  const double * sums = this->BoxSum( &buffer1[ 0 ], &buffer2[ 0 ], 1 );
+  std::copy( sums, sums + numberOfVoxels, coefficientSums.begin() );
+  this->m_CoefficientSums = &coefficientSums[ 0 ];
 
   /** Loop over the number of iterations. */
   for( unsigned int k = 0; k < this->GetNumberOfIterations(); k++ )
   {
-    /** Reset the iterators. */
-    nit.GoToBegin();
-    nit2.GoToBegin();
-    oit.GoToBegin();
+    /** Compute c x, and then the sums of c x over the neighbourhoods. */
+    this->m_ThreaderDestination = &buffer1[ 0 ];
+    this->ThreadedExecute( MultiplyPhase, numberOfVoxels );
+    this->m_ThreaderSource = this->BoxSum( &buffer1[ 0 ], &buffer2[ 0 ], InputImageDimension );
+
+    /** Set 'y = (1 - c) * x + c * mean' to the output. */
+    this->ThreadedExecute( UpdatePhase, numberOfVoxels );
+  }
+
+  this->m_OutputBuffer      = 0;
+  this->m_CoefficientBuffer = 0;
+  this->m_CoefficientSums   = 0;
+  this->m_ThreaderSource    = 0;
+
+} // end GenerateData()
+
+
+/**
+ * ********************** ThreadedExecute **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+void
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::ThreadedExecute( ThreaderPhaseType phase, SizeValueType size )
+{
+  /** Lines are handed out a few at the time, voxels in larger chunks. */
+  const SizeValueType chunkSize = phase == BoxSumPhase ? 16 : 4096;
+
+  this->m_ThreaderPhase = phase;
+  PersistentThreadPool * pool = PersistentThreadPool::GetGlobalThreadPool();
+  this->m_WorkChunks.Initialize( size, chunkSize );
+  pool->SingleMethodExecute( Self::ThreaderCallback, this, this->GetNumberOfThreads() );
+
+} // end ThreadedExecute()
+
+
+/**
+ * ********************** ThreaderCallback **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+ITK_THREAD_RETURN_TYPE
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::ThreaderCallback( void * arg )
+{
+  typedef PersistentThreadPool::ThreadInfoType ThreadInfoType;
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const Self *     self       = static_cast< const Self * >( infoStruct->UserData );
+
+  SizeValueType begin = 0;
+  SizeValueType end   = 0;
+  while( self->m_WorkChunks.GetNext( begin, end ) )
+  {
+    switch( self->m_ThreaderPhase )
+    {
+      case MultiplyPhase:
+        self->MultiplyVoxels( begin, end );
+        break;
+      case BoxSumPhase:
+        self->BoxSumLines( begin, end );
+        break;
+      case UpdatePhase:
+        self->UpdateVoxels( begin, end );
+        break;
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ThreaderCallback()
+
+
+/**
+ * ********************** BoxSum **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+double *
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::BoxSum( double * source, double * scratch, unsigned int numberOfComponents )
+{
+  this->m_ThreaderComponents = numberOfComponents;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    this->m_ThreaderDimension   = d;
+    this->m_ThreaderSource      = source;
+    this->m_ThreaderDestination = scratch;
+    this->ThreadedExecute( BoxSumPhase,
+      this->m_BufferSize.CalculateProductOfElements() / this->m_BufferSize[ d ] );
+    std::swap( source, scratch );
+  }
+  return source;
+
+} // end BoxSum()
 
-    /** The actual work. */
-    while( !nit.IsAtEnd() )
+
+/**
+ * ********************** BoxSumLines **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+void
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::BoxSumLines( SizeValueType firstLine, SizeValueType endLine ) const
+{
+  const unsigned int  dimension          = this->m_ThreaderDimension;
+  const unsigned int  numberOfComponents = this->m_ThreaderComponents;
+  const long          length             = static_cast< long >( this->m_BufferSize[ dimension ] );
+  const long          radius             = static_cast< long >( this->m_Radius[ dimension ] );
+  SizeValueType       stride             = 1;
+  for( unsigned int d = 0; d < dimension; ++d )
+  {
+    stride *= this->m_BufferSize[ d ];
+  }
+  const SizeValueType step = stride * numberOfComponents;
+
+  /** The neighbours outside the image are replaced by the border voxel. */
+  double sum[ InputImageDimension ];
+  for( SizeValueType line = firstLine; line < endLine; ++line )
+  {
+    const SizeValueType first
+      = ( ( line / stride ) * stride * length + line % stride ) * numberOfComponents;
+    const double * in  = this->m_ThreaderSource + first;
+    double *       out = this->m_ThreaderDestination + first;
+
+    /** The sum of the first window. */
+    std::fill( sum, sum + numberOfComponents, 0.0 );
+    for( long o = -radius; o <= radius; ++o )
     {
-      /** Speed up: do not filter locations where c(x) = 0. */
-      if( nit2.GetCenterPixel() < 0.000001 )
+      const double * value = in + std::max( 0L, std::min( o, length - 1 ) ) * step;
+      for( unsigned int j = 0; j < numberOfComponents; ++j )
       {
-        /** Just copy input to output. */
-        oit.Set( nit.GetCenterPixel() );
+        sum[ j ] += value[ j ];
       }
-      else
-      {
-        /** Initialize the sum to 0. */
-        for( j = 0; j < InputImageDimension; j++ )
-        {
-          sum[ j ] = NumericTraits< double >::Zero;
-        }
-
-        /** Initialize sumc. */
-        double sumc = 0.0;
-
-        /** Calculate the weighted mean over the neighborhood.
-         * mean = SUthis->m_i{ ci * x_i } / SUthis->m_i{ ci }
-         */
-        for( i = 0; i < neighborhoodSize; ++i )
-        {
-          /** Get current pixel in this neighborhood. */
-          InputPixelType pix = nit.GetPixel( i );
-
-          /** Get ci-value on current index. */
-          ci = nit2.GetPixel( i );
-
-          /** Calculate SUthis->m_i{ ci } and SUthis->m_i{ ci * x_i }. */
-          sumc += ci;
-          for( j = 0; j < InputImageDimension; j++ )
-          {
-            sum[ j ] += ci * static_cast< double >( pix[ j ] );
-          }
-        }
-
-        /** Get the mean value by dividing by sumc. */
-        InputPixelType mean;
-        for( j = 0; j < InputImageDimension; j++ )
-        {
-          if( sumc < 0.00001 ) { mean[ j ] = 0.0; }
-          else { mean[ j ] = static_cast< ValueType >( sum[ j ] / sumc ); }
-        }
-
-        /** Get c. */
-        c = nit2.GetCenterPixel();
-
-        /** Set 'y = (1 - c) * x + c * mean' to the temporary output. */
-        InputPixelType value = nit.GetCenterPixel() * ( 1.0 - c ) + mean * c;
-
-        /** Set it. */
-        oit.Set( value );
-
-      } // end if c < 0.000001
-
-      /** Increase all iterators. */
-      ++nit;
-      ++nit2;
-      ++oit;
-      //progress.CompletedPixel();
-
-    } // end while
-
-    /** Copy outputtmp to output. */
-    if( this->GetNumberOfIterations() > 0 )
+    }
+
+    /** Slide the window along the line. */
+    for( long t = 0; t < length; ++t )
     {
-      out_it.GoToBegin();
-      oit.GoToBegin();
-      while( !out_it.IsAtEnd() )
+      double * result = out + t * step;
+      for( unsigned int j = 0; j < numberOfComponents; ++j )
       {
-        out_it.Set( oit.Get() );
-        ++out_it;
-        ++oit;
+        result[ j ] = sum[ j ];
       }
-    } // end if GetNumberOfIterations() > 0
 
-  } // end for NumberOfIterations
+      const double * entering = in + std::min( t + radius + 1, length - 1 ) * step;
+      const double * leaving  = in + std::max( t - radius, 0L ) * step;
+      for( unsigned int j = 0; j < numberOfComponents; ++j )
+      {
+        sum[ j ] += entering[ j ] - leaving[ j ];
+      }
+    }
+  }
 
-} // end GenerateData()
+} // end BoxSumLines()
+
+
+/**
+ * ********************** MultiplyVoxels **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+void
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::MultiplyVoxels( SizeValueType first, SizeValueType end ) const
+{
+  for( SizeValueType i = first; i < end; ++i )
+  {
+    const double           c   = this->m_CoefficientBuffer[ i ];
+    const InputPixelType & pix = this->m_OutputBuffer[ i ];
+    double *               cx  = this->m_ThreaderDestination + i * InputImageDimension;
+    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    {
+      cx[ j ] = c * static_cast< double >( pix[ j ] );
+    }
+  }
+
+} // end MultiplyVoxels()
+
+
+/**
+ * ********************** UpdateVoxels **************************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+void
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::UpdateVoxels( SizeValueType first, SizeValueType end ) const
+{
+  for( SizeValueType i = first; i < end; ++i )
+  {
+    /** Speed up: do not filter locations where c(x) = 0. */
+    const double c = this->m_CoefficientBuffer[ i ];
+    if( c < 0.000001 )
+    {
+      continue;
+    }
+
+    /** mean = SUM_i{ ci * x_i } / SUM_i{ ci }. */
+    const double   sumc = this->m_CoefficientSums[ i ];
+    const double * sum  = this->m_ThreaderSource + i * InputImageDimension;
+    InputPixelType & pix = this->m_OutputBuffer[ i ];
+    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    {
+      const double mean = sumc < 0.00001 ? 0.0 : sum[ j ] / sumc;
+      pix[ j ] = static_cast< ValueType >( ( 1.0 - c ) * pix[ j ] + c * mean );
+    }
+  }
+
+} // end UpdateVoxels()
 
 
 /**
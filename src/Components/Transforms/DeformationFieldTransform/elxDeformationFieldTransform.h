@@ -21,6 +21,7 @@
 #include "elxIncludes.h" // include first to avoid MSVS warning
 #include "itkDeformationFieldInterpolatingTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkDeformationFieldQuantizer.h"
 
 namespace elastix
 {
@@ -43,6 +44,11 @@ namespace elastix
  * \transformparameter DeformationFieldInterpolationOrder: The interpolation order used for interpolating the deformation field:\n
  *    example: <tt>(DeformationFieldInterpolationOrder 0)</tt>\n
  *    The default value is 0. Choose from the allowed values 0 or 1.
+ * \transformparameter DeformationFieldOutputType: "float", or "quantized" to write
+ *    the deformation field as 16 bit integers, see TransformBase. Quantized fields
+ *    are recognized, and rescaled, when they are read.\n
+ *    example: <tt>(DeformationFieldOutputType "quantized")</tt>\n
+ *    The default value is "float".
  *
  *
  * \sa DeformationFieldInterpolatingTransform
@@ -149,7 +155,8 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );             // purposely not implemented
 
-  typedef typename DeformationFieldType::DirectionType DirectionType;
+  typedef typename DeformationFieldType::DirectionType           DirectionType;
+  typedef itk::DeformationFieldQuantizer< DeformationFieldType > QuantizerType;
 
   /** The transform that is set as current transform in the
    * CcombinationTransform */
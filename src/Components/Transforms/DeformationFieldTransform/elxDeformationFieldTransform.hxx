@@ -115,6 +115,13 @@ DeformationFieldTransform< TElastix >::ReadFromFile( void )
   this->m_OriginalDeformationFieldDirection
     = vectorReader->GetOutput()->GetDirection();
 
+  /** Rescale a quantized field. */
+  if( QuantizerType::Dequantize( infoChanger->GetOutput(),
+    vectorReader->GetOutput()->GetMetaDataDictionary() ) )
+  {
+    elxout << "  The deformation field was stored quantized." << std::endl;
+  }
+
   /** Set the deformationFieldImage in the
    * itkDeformationFieldInterpolatingTransform.
    */
@@ -215,8 +222,14 @@ DeformationFieldTransform< TElastix >
   infoChanger->SetChangeDirection( !this->GetElastix()->GetUseDirectionCosines() );
   infoChanger->SetInput( this->m_DeformationFieldInterpolatingTransform->GetDeformationField() );
 
+  /** Check if the field is stored quantized. */
+  std::string outputType = "float";
+  this->m_Configuration->ReadParameter( outputType, "DeformationFieldOutputType", 0, false );
+
   /** Write the deformation field image. */
   typedef itk::ImageFileWriter< DeformationFieldType > VectorWriterType;
+  typedef itk::ImageFileWriter<
+    typename QuantizerType::QuantizedImageType >       QuantizedWriterType;
   typename VectorWriterType::Pointer writer
     = VectorWriterType::New();
   writer->SetFileName( makeFileName.str().c_str() );
@@ -225,7 +238,18 @@ DeformationFieldTransform< TElastix >
   /** Do the writing. */
   try
   {
-    writer->Update();
+    if( outputType == "quantized" )
+    {
+      infoChanger->Update();
+      typename QuantizedWriterType::Pointer quantizedWriter = QuantizedWriterType::New();
+      quantizedWriter->SetInput( QuantizerType::Quantize( infoChanger->GetOutput() ) );
+      quantizedWriter->SetFileName( makeFileName.str().c_str() );
+      quantizedWriter->Update();
+    }
+    else
+    {
+      writer->Update();
+    }
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -19,6 +19,7 @@
 #define _itkDeformationFieldInterpolatingTransform_hxx
 
 #include "itkDeformationFieldInterpolatingTransform.h"
+#include <cmath>
 
 namespace itk
 {
@@ -28,8 +29,10 @@ template< class TScalarType, unsigned int NDimensions, class TComponentType >
 DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >::DeformationFieldInterpolatingTransform() :
   Superclass( OutputSpaceDimension )
 {
-  this->m_DeformationField     = 0;
-  this->m_ZeroDeformationField = DeformationFieldType::New();
+  this->m_DeformationField       = 0;
+  this->m_UseLinearInterpolation = false;
+  this->m_FieldBuffer            = 0;
+  this->m_ZeroDeformationField   = DeformationFieldType::New();
   typename DeformationFieldType::SizeType dummySize;
   dummySize.Fill( 0 );
   this->m_ZeroDeformationField->SetRegions( dummySize );
@@ -51,6 +54,11 @@ OutputPointType
 DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
 ::TransformPoint( const InputPointType & point ) const
 {
+  if( this->m_UseLinearInterpolation )
+  {
+    return this->TransformPointLinear( point );
+  }
+
   InputContinuousIndexType cindex;
   this->m_DeformationFieldInterpolator->ConvertPointToContinuousIndex(
     point, cindex );
@@ -74,6 +82,144 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
 }
 
 
+// Transform an array of points
+template< class TScalarType, unsigned int NDimensions, class TComponentType >
+void
+DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
+::TransformPoints( const InputPointType * inputPoints,
+  const SizeValueType numberOfPoints, OutputPointType * outputPoints ) const
+{
+  if( !this->m_UseLinearInterpolation )
+  {
+    this->Superclass::TransformPoints( inputPoints, numberOfPoints, outputPoints );
+    return;
+  }
+
+  for( SizeValueType p = 0; p < numberOfPoints; ++p )
+  {
+    outputPoints[ p ] = this->TransformPointLinear( inputPoints[ p ] );
+  }
+
+} // end TransformPoints()
+
+
+// Transform a point with linear interpolation
+template< class TScalarType, unsigned int NDimensions, class TComponentType >
+typename DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >::
+OutputPointType
+DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
+::TransformPointLinear( const InputPointType & point ) const
+{
+  /** The continuous index, and the check of IsInsideBuffer(). */
+  ScalarType      cindex[ NDimensions ];
+  OffsetValueType base[ NDimensions ];
+  ScalarType      weight1[ NDimensions ];
+  for( unsigned int i = 0; i < NDimensions; ++i )
+  {
+    ScalarType c = 0.0;
+    for( unsigned int j = 0; j < NDimensions; ++j )
+    {
+      c += this->m_FieldPointToIndex( i, j ) * ( point[ j ] - this->m_FieldOrigin[ j ] );
+    }
+    if( !( c >= this->m_FieldStartIndex[ i ] - 0.5 && c < this->m_FieldEndIndex[ i ] + 0.5 ) )
+    {
+      return point;
+    }
+    cindex[ i ]  = c;
+    base[ i ]    = static_cast< OffsetValueType >( std::floor( c ) );
+    weight1[ i ] = c - static_cast< ScalarType >( base[ i ] );
+  }
+
+  /** Accumulate the neighbours; neighbours outside the buffer are replaced
+   * by the nearest voxel on the border, as in the interpolator. */
+  ScalarType displacement[ NDimensions ];
+  for( unsigned int d = 0; d < NDimensions; ++d )
+  {
+    displacement[ d ] = 0.0;
+  }
+  const unsigned int numberOfNeighbours = 1u << NDimensions;
+  for( unsigned int n = 0; n < numberOfNeighbours; ++n )
+  {
+    ScalarType      weight = 1.0;
+    OffsetValueType offset = 0;
+    for( unsigned int i = 0; i < NDimensions; ++i )
+    {
+      OffsetValueType index = base[ i ];
+      if( n & ( 1u << i ) )
+      {
+        ++index;
+        weight *= weight1[ i ];
+      }
+      else
+      {
+        weight *= 1.0 - weight1[ i ];
+      }
+      if( index < this->m_FieldStartIndex[ i ] ) { index = this->m_FieldStartIndex[ i ]; }
+      if( index > this->m_FieldEndIndex[ i ] ) { index = this->m_FieldEndIndex[ i ]; }
+      offset += ( index - this->m_FieldStartIndex[ i ] ) * this->m_FieldStrides[ i ];
+    }
+    if( weight == 0.0 ) { continue; }
+
+    const DeformationFieldComponentType * vector = this->m_FieldBuffer[ offset ].GetDataPointer();
+    for( unsigned int d = 0; d < NDimensions; ++d )
+    {
+      displacement[ d ] += weight * static_cast< ScalarType >( vector[ d ] );
+    }
+  }
+
+  OutputPointType outpoint;
+  for( unsigned int d = 0; d < NDimensions; ++d )
+  {
+    outpoint[ d ] = point[ d ] + displacement[ d ];
+  }
+  return outpoint;
+
+} // end TransformPointLinear()
+
+
+// Cache the field for the linear interpolation
+template< class TScalarType, unsigned int NDimensions, class TComponentType >
+void
+DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
+::UpdateLinearInterpolation( void )
+{
+  this->m_UseLinearInterpolation = false;
+  const DeformationFieldType * field = this->m_DeformationField;
+  if( field == 0 || field->GetBufferPointer() == 0
+    || dynamic_cast< LinearDeformationFieldInterpolatorType * >(
+    this->m_DeformationFieldInterpolator.GetPointer() ) == 0 )
+  {
+    return;
+  }
+
+  const typename DeformationFieldType::RegionType region = field->GetBufferedRegion();
+  if( region.GetNumberOfPixels() == 0 ) { return; }
+
+  this->m_FieldBuffer = field->GetBufferPointer();
+  this->m_FieldOrigin = field->GetOrigin();
+  this->m_FieldStartIndex = region.GetIndex();
+  OffsetValueType stride = 1;
+  for( unsigned int i = 0; i < NDimensions; ++i )
+  {
+    this->m_FieldEndIndex[ i ] = this->m_FieldStartIndex[ i ]
+      + static_cast< OffsetValueType >( region.GetSize()[ i ] ) - 1;
+    this->m_FieldStrides[ i ] = stride;
+    stride *= static_cast< OffsetValueType >( region.GetSize()[ i ] );
+  }
+
+  /** The inverse of direction times spacing, as in the image. */
+  for( unsigned int i = 0; i < NDimensions; ++i )
+  {
+    for( unsigned int j = 0; j < NDimensions; ++j )
+    {
+      this->m_FieldPointToIndex( i, j ) = field->GetInverseDirection()( i, j ) / field->GetSpacing()[ i ];
+    }
+  }
+  this->m_UseLinearInterpolation = true;
+
+} // end UpdateLinearInterpolation()
+
+
 // Set the deformation field
 template< class TScalarType, unsigned int NDimensions, class TComponentType >
 void
@@ -91,6 +237,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
     this->m_DeformationFieldInterpolator->SetInputImage(
       this->m_DeformationField );
   }
+  this->UpdateLinearInterpolation();
 }
 
 
@@ -111,6 +258,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
     this->m_DeformationFieldInterpolator->SetInputImage(
       this->m_DeformationField );
   }
+  this->UpdateLinearInterpolation();
 }
 
 
@@ -124,6 +272,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
   os << indent << "DeformationField: " << this->m_DeformationField << std::endl;
   os << indent << "ZeroDeformationField: " << this->m_ZeroDeformationField << std::endl;
   os << indent << "DeformationFieldInterpolator: " << this->m_DeformationFieldInterpolator << std::endl;
+  os << indent << "UseLinearInterpolation: " << this->m_UseLinearInterpolation << std::endl;
 }
 
 
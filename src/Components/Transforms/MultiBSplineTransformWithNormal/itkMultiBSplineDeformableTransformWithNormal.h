@@ -19,6 +19,7 @@
 #define __itkMultiBSplineDeformableTransformWithNormal_h
 
 #include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkRecursiveBSplineTransform.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 
 namespace itk
@@ -30,6 +31,11 @@ namespace itk
  *
  * Detailed explanation ...
  *
+ * The B-splines are RecursiveBSplineTransform's. For every label a B-spline
+ * with the summed coefficients of the normal and the label B-spline is
+ * kept, so that TransformPoint() evaluates a single B-spline. GetJacobian()
+ * computes the B-spline weights once, since all B-splines share the grid.
+ *
  * \author Vivien Delmon
  *
  * \ingroup Transforms
@@ -479,7 +485,7 @@ protected:
   /** Internal parameters buffer. */
   ParametersType m_InternalParametersBuffer;
 
-  typedef AdvancedBSplineDeformableTransform< TScalarType,
+  typedef RecursiveBSplineTransform< TScalarType,
     itkGetStaticConstMacro( SpaceDimension ),
     itkGetStaticConstMacro( SplineOrder ) >          TransformType;
 
@@ -492,6 +498,12 @@ protected:
   mutable int                                    m_LastJacobian;
   ImageBasePointer                               m_LocalBases;
 
+  /** Per label, the B-spline with the coefficients of the normal B-spline
+   * plus those of the label B-spline. Index 0 is not used.
+   */
+  std::vector< typename TransformType::Pointer > m_CombinedTrans;
+  std::vector< ParametersType >                  m_CombinedPara;
+
 private:
 
   MultiBSplineDeformableTransformWithNormal( const Self & ); // purposely not implemented
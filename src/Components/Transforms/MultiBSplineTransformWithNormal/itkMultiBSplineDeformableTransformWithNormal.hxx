@@ -172,6 +172,8 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
     {
       this->m_Trans[ i ] = TransformType::New();
     }
+    this->m_CombinedTrans.clear();
+    this->m_CombinedPara.clear();
     this->m_LabelsInterpolator = ImageLabelInterpolator::New();
     this->m_LabelsInterpolator->SetInputImage( this->m_Labels );
     // Restore settings
@@ -527,6 +529,27 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
   {
     m_Trans[ i ]->SetParameters( m_Para[ i ] );
   }
+
+  /** By linearity, the B-spline with the summed coefficients gives the
+   * displacement of the normal plus the label B-spline at once.
+   */
+  this->m_CombinedTrans.resize( m_NbLabels + 1 );
+  this->m_CombinedPara.resize( m_NbLabels + 1 );
+  const ParametersType & fixedParameters = m_Trans[ 0 ]->GetFixedParameters();
+  for( unsigned l = 1; l <= m_NbLabels; ++l )
+  {
+    if( this->m_CombinedTrans[ l ].IsNull() )
+    {
+      this->m_CombinedTrans[ l ] = TransformType::New();
+    }
+    if( this->m_CombinedTrans[ l ]->GetFixedParameters() != fixedParameters )
+    {
+      this->m_CombinedTrans[ l ]->SetFixedParameters( fixedParameters );
+    }
+    this->m_CombinedPara[ l ]  = m_Para[ 0 ];
+    this->m_CombinedPara[ l ] += m_Para[ l ];
+    this->m_CombinedTrans[ l ]->SetParameters( this->m_CombinedPara[ l ] );
+  }
 }
 
 
@@ -659,13 +682,13 @@ inline void
 MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
 ::PointToLabel( const InputPointType & p, int & l ) const
 {
+  /** Look up the nearest voxel directly; the label image is fully buffered. */
   l = 0;
   assert( this->m_Labels );
-  typename ImageLabelInterpolator::IndexType idx;
-  this->m_LabelsInterpolator->ConvertPointToNearestIndex( p, idx );
-  if( this->m_LabelsInterpolator->IsInsideBuffer( idx ) )
+  typename ImageLabelType::IndexType idx;
+  if( this->m_Labels->TransformPhysicalPointToIndex( p, idx ) )
   {
-    l = static_cast< int >( this->m_LabelsInterpolator->EvaluateAtIndex( idx ) ) + 1;
+    l = static_cast< int >( this->m_Labels->GetPixel( idx ) ) + 1;
   }
 }
 
@@ -682,6 +705,11 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
     return point;
   }
 
+  if( static_cast< unsigned int >( lidx ) < this->m_CombinedTrans.size() )
+  {
+    return this->m_CombinedTrans[ lidx ]->TransformPoint( point );
+  }
+
   OutputPointType res = m_Trans[ 0 ]->TransformPoint( point ) + ( m_Trans[ lidx ]->TransformPoint( point ) - point );
   return res;
 }
@@ -728,7 +756,6 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
   {
     jacobian.SetSize( SpaceDimension, nnzji );
   }
-  jacobian.Fill( 0.0 );
 
   // This implements a sparse version of the Jacobian.
   // Can only compute Jacobian if parameters are set via
@@ -741,53 +768,47 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
   int lidx = 0;
   PointToLabel( ipp, lidx );
 
-  if( lidx == 0 )
+  // Convert the physical point to a continuous index; all B-splines
+  // share the grid.
+  typename TransformType::ContinuousIndexType cindex;
+  if( lidx != 0 )
   {
-    // Return some dummy
-    nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
-    for( unsigned int i = 0; i < this->GetNumberOfNonZeroJacobianIndices(); ++i )
-    {
-      nonZeroJacobianIndices[ i ] = i;
-    }
-    return;
+    m_Trans[ 0 ]->TransformPointToContinuousGridIndex( ipp, cindex );
   }
 
-  JacobianType njac, ljac;
-  njac.SetSize( SpaceDimension, nnzji );
-  ljac.SetSize( SpaceDimension, nnzji );
-
-  // nzji should be the same so keep only one
-  m_Trans[ 0 ]->GetJacobian( ipp, njac, nonZeroJacobianIndices );
-  m_Trans[ lidx ]->GetJacobian( ipp, ljac, nonZeroJacobianIndices );
-
-  // Convert the physical point to a continuous index, which
-  // is needed for the 'Evaluate()' functions below.
-  typename TransformType::ContinuousIndexType cindex;
-  m_Trans[ lidx ]->TransformPointToContinuousGridIndex( ipp, cindex );
-
   // NOTE: if the support region does not lie totally within the grid
   // we assume zero displacement and zero Jacobian
-  if( !m_Trans[ lidx ]->InsideValidRegion( cindex ) )
+  if( lidx == 0 || !m_Trans[ 0 ]->InsideValidRegion( cindex ) )
   {
     // Return some dummy
-    nonZeroJacobianIndices.resize( m_Trans[ lidx ]->GetNumberOfNonZeroJacobianIndices() );
-    for( unsigned int i = 0; i < m_Trans[ lidx ]->GetNumberOfNonZeroJacobianIndices(); ++i )
+    jacobian.Fill( 0.0 );
+    nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
+    for( unsigned int i = 0; i < this->GetNumberOfNonZeroJacobianIndices(); ++i )
     {
       nonZeroJacobianIndices[ i ] = i;
     }
     return;
   }
 
+  // The B-spline Jacobian holds the weights w_i at ( j, i + j * nweights ),
+  // for all B-splines alike, so compute it once, in place.
+  m_Trans[ 0 ]->GetJacobian( ipp, jacobian, nonZeroJacobianIndices );
+  const unsigned nweights = this->GetNumberOfWeights();
+  ScalarType     weights[ WeightsFunctionType::NumberOfWeights ];
+  for( unsigned i = 0; i < nweights; ++i )
+  {
+    weights[ i ] = jacobian[ 0 ][ i ];
+  }
+
   typedef typename ImageBaseType::PixelContainer BaseContainer;
   const BaseContainer & bases = *m_LocalBases->GetPixelContainer();
 
-  const unsigned nweights = this->GetNumberOfWeights();
   for( unsigned i = 0; i < nweights; ++i )
   {
     VectorType tmp = bases[ nonZeroJacobianIndices[ i ] ][ 0 ];
     for( unsigned j = 0; j < SpaceDimension; ++j )
     {
-      jacobian[ j ][ i ] = tmp[ j ] * njac[ j ][ i + j * nweights ];
+      jacobian[ j ][ i ] = tmp[ j ] * weights[ i ];
     }
 
     for( unsigned d = 1; d < SpaceDimension; ++d )
@@ -795,7 +816,7 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
       tmp = bases[ nonZeroJacobianIndices[ i ] ][ d ];
       for( unsigned j = 0; j < SpaceDimension; ++j )
       {
-        jacobian[ j ][ i + d * nweights ] = tmp[ j ] * ljac[ j ][ i + j * nweights ];
+        jacobian[ j ][ i + d * nweights ] = tmp[ j ] * weights[ i ];
       }
     }
   }
@@ -881,6 +902,12 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
     return;
   }
 
+  if( static_cast< unsigned int >( lidx ) < this->m_CombinedTrans.size() )
+  {
+    this->m_CombinedTrans[ lidx ]->GetSpatialHessian( ipp, sh );
+    return;
+  }
+
   SpatialHessianType nsh, lsh;
   m_Trans[ 0 ]->GetSpatialHessian( ipp, nsh );
   m_Trans[ lidx ]->GetSpatialHessian( ipp, lsh );
@@ -107,6 +107,11 @@ namespace elastix
  * \transformparameter FixedImageLandmarks: The landmark positions in the
  * fixed image, in world coordinates. Positions written as x1 y1 [z1] x2 y2 [z2] etc.\n
  *   example: <tt>(FixedImageLandmarks 10.0 11.0 12.0 4.0 4.0 4.0 6.0 6.0 6.0 )</tt>
+ * \transformparameter SplineKernelCoefficients: The solved coefficients of the
+ * spline, written by elastix: ( N + d + 1 ) * d values, N being the number of
+ * landmarks and d the dimension. When present, transformix does not solve
+ * the landmark system again, which saves O(N^3) time and O(N^2) memory.
+ * Remove this line after editing the landmarks or the spline settings.\n
  *
  * \ingroup Transforms
  */
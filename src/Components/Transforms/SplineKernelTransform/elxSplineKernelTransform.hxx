@@ -22,6 +22,7 @@
 #include "itkTransformixInputPointFileReader.h"
 #include "vnl/vnl_math.h"
 #include "itkTimeProbe.h"
+#include <iomanip>
 
 namespace elastix
 {
@@ -449,6 +450,26 @@ SplineKernelTransform< TElastix >
     itkExceptionMacro( << "ERROR: unable to configure transform." );
   }
 
+  /** Read the kernel coefficients that were solved when this file was
+   * written. They are only used if their number matches the landmarks;
+   * otherwise the coefficients are solved again from the landmarks.
+   */
+  const unsigned int numberOfCoefficients = this->GetConfiguration()
+    ->CountNumberOfParameterEntries( "SplineKernelCoefficients" );
+  if( numberOfCoefficients > 0 )
+  {
+    std::vector< CoordRepType > coefficients( numberOfCoefficients,
+      itk::NumericTraits< CoordRepType >::ZeroValue() );
+    this->GetConfiguration()->ReadParameter( coefficients,
+      "SplineKernelCoefficients", 0, numberOfCoefficients - 1, true );
+    ParametersType precomputedCoefficients( numberOfCoefficients );
+    for( unsigned int i = 0; i < numberOfCoefficients; ++i )
+    {
+      precomputedCoefficients[ i ] = coefficients[ i ];
+    }
+    this->m_KernelTransform->SetPrecomputedKernelCoefficients( precomputedCoefficients );
+  }
+
   /** Convert to fixedParameters type and set in transform. */
   ParametersType fixedParams( numberOfParameters );
   for( unsigned int i = 0; i < numberOfParameters; ++i )
@@ -502,6 +523,27 @@ SplineKernelTransform< TElastix >
   }
   xl::xout[ "transpar" ] << fixedParams[ fixedParams.GetSize() - 1 ] << ")" << std::endl;
 
+  /** Write the solved kernel coefficients, so that transformix does not
+   * need to solve the landmark system again. Full precision is needed,
+   * since the coefficients of nearby landmarks largely cancel out.
+   * They only belong to the written parameters if these are the current
+   * parameters of the transform.
+   */
+  if( param != this->m_KernelTransform->GetParameters() )
+  {
+    return;
+  }
+  const ParametersType coefficients = this->m_KernelTransform->GetKernelCoefficients();
+  xl::xout[ "transpar" ] << std::setprecision( 17 );
+  xl::xout[ "transpar" ] << "(SplineKernelCoefficients ";
+  for( unsigned int i = 0; i < coefficients.GetSize() - 1; ++i )
+  {
+    xl::xout[ "transpar" ] << coefficients[ i ] << " ";
+  }
+  xl::xout[ "transpar" ] << coefficients[ coefficients.GetSize() - 1 ] << ")" << std::endl;
+  xl::xout[ "transpar" ] << std::setprecision(
+    this->m_Elastix->GetDefaultOutputPrecision() );
+
 } // end WriteToFile()
 
 
@@ -39,7 +39,9 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkVector.h"
 #include "itkMatrix.h"
 #include "itkPointSet.h"
+#include "itkSimpleFastMutexLock.h"
 #include <deque>
+#include <vector>
 #include <math.h>
 #include "vnl/vnl_matrix_fixed.h"
 #include "vnl/vnl_matrix.h"
@@ -292,6 +294,24 @@ public:
   }
 
 
+  /** Get the solved kernel coefficients: the deformable coefficients of all
+   * landmarks, followed by the affine matrix and the translation, in the
+   * order of the W matrix. Their number is ( N + NDimensions + 1 ) * NDimensions,
+   * with N the number of landmarks.
+   */
+  virtual ParametersType GetKernelCoefficients( void ) const;
+
+  /** Provide previously solved kernel coefficients, see GetKernelCoefficients().
+   * This should be called before SetFixedParameters() and SetParameters().
+   * When the number of coefficients matches the number of landmarks, the L
+   * matrix is then not computed and inverted, and the next call to
+   * SetParameters() uses the given coefficients instead of solving the
+   * system. The coefficients are used only once. The inverse of the L
+   * matrix, which the Jacobian needs, is then computed on the first call
+   * to GetJacobian().
+   */
+  virtual void SetPrecomputedKernelCoefficients( const ParametersType & coefficients );
+
   /** Matrix inversion by SVD or QR decomposition. */
   itkSetMacro( MatrixInversionMethod, std::string );
   itkGetConstReferenceMacro( MatrixInversionMethod, std::string );
@@ -441,6 +461,17 @@ protected:
    */
   void ReorganizeW( void );
 
+  /** Whether valid precomputed kernel coefficients are available. */
+  bool HasPrecomputedKernelCoefficients( void ) const;
+
+  /** Copy the source landmarks and the deformable coefficients to the
+   * contiguous array m_LandmarkKernelData, see there. */
+  void UpdateLandmarkKernelData( void );
+
+  /** Compute the inverse of the L matrix if that was skipped because of
+   * precomputed kernel coefficients. Safe to call from multiple threads. */
+  void ComputeLInverseIfNeeded( void ) const;
+
   /** Stiffness parameter. */
   double m_Stiffness;
 
@@ -474,6 +505,18 @@ protected:
    */
   DMatrixType m_DMatrix;
 
+  /** The source landmarks and the matching columns of the D matrix,
+   * interleaved in one contiguous array: for landmark i the elements
+   * [ 2 * NDimensions * i, 2 * NDimensions * ( i + 1 ) [ hold the landmark
+   * position, followed by its coefficients. The kernels with a diagonal
+   * G matrix use it to sum over the landmarks in a tight loop, without
+   * point set iterators and with a single memory stream.
+   */
+  std::vector< TScalarType > m_LandmarkKernelData;
+
+  /** Precomputed kernel coefficients, see SetPrecomputedKernelCoefficients(). */
+  ParametersType m_PrecomputedKernelCoefficients;
+
   /** Rotational/Shearing part of the Affine component of the Transformation. */
   AMatrixType m_AMatrix;
 
@@ -496,6 +539,10 @@ protected:
   /** Has the L matrix decomposition been computed? */
   bool m_LMatrixDecompositionComputed;
 
+  /** Guards the deferred computation of the L inverse, see
+   * ComputeLInverseIfNeeded(). */
+  mutable SimpleFastMutexLock m_LInverseMutex;
+
   /** Decompositions, needed for the L matrix.
    * These decompositions are cached for performance reasons during registration.
    * During registration, in every iteration SetParameters() is called, which in
@@ -514,9 +561,6 @@ protected:
   /** Precomputed nonzero Jacobian indices (simply all params) */
   NonZeroJacobianIndicesType m_NonZeroJacobianIndices;
 
-  /** for old GetJacobian() method: */
-  mutable NonZeroJacobianIndicesType m_NonZeroJacobianIndicesTemp;
-
   /** The Jacobian can be computed much faster for some of the
    * derived kerbel transforms, most notably the TPS.
    */
@@ -35,6 +35,7 @@ PURPOSE.  See the above copyright notices for more information.
 #define _itkKernelTransform2_hxx
 
 #include "itkKernelTransform2.h"
+#include "itkMutexLockHolder.h"
 
 namespace itk
 {
@@ -524,9 +525,126 @@ KernelTransform2< TScalarType, NDimensions >
   this->m_WMatrix         = WMatrixType( 1, 1 );
   this->m_WMatrixComputed = true;
 
+  this->UpdateLandmarkKernelData();
+
 } // end ReorganizeW()
 
 
+/**
+ * ******************* UpdateLandmarkKernelData *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::UpdateLandmarkKernelData( void )
+{
+  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
+  this->m_LandmarkKernelData.resize( 2 * NDimensions * numberOfLandmarks );
+
+  PointsIterator sp   = this->m_SourceLandmarks->GetPoints()->Begin();
+  TScalarType *  data = numberOfLandmarks > 0 ? &( this->m_LandmarkKernelData[ 0 ] ) : 0;
+  for( unsigned long lnd = 0; lnd < numberOfLandmarks; lnd++ )
+  {
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      data[ dim ]               = sp->Value()[ dim ];
+      data[ NDimensions + dim ] = this->m_DMatrix( dim, lnd );
+    }
+    data += 2 * NDimensions;
+    ++sp;
+  }
+
+} // end UpdateLandmarkKernelData()
+
+
+/**
+ * ******************* GetKernelCoefficients *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+typename KernelTransform2< TScalarType, NDimensions >::ParametersType
+KernelTransform2< TScalarType, NDimensions >
+::GetKernelCoefficients( void ) const
+{
+  const unsigned long numberOfLandmarks = this->m_DMatrix.cols();
+  ParametersType      coefficients( ( numberOfLandmarks + NDimensions + 1 ) * NDimensions );
+  unsigned int        ci = 0;
+
+  /** Same order as in ReorganizeW(). */
+  for( unsigned long lnd = 0; lnd < numberOfLandmarks; lnd++ )
+  {
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      coefficients[ ci++ ] = this->m_DMatrix( dim, lnd );
+    }
+  }
+  for( unsigned int j = 0; j < NDimensions; j++ )
+  {
+    for( unsigned int i = 0; i < NDimensions; i++ )
+    {
+      coefficients[ ci++ ] = this->m_AMatrix( i, j );
+    }
+  }
+  for( unsigned int k = 0; k < NDimensions; k++ )
+  {
+    coefficients[ ci++ ] = this->m_BVector( k );
+  }
+
+  return coefficients;
+
+} // end GetKernelCoefficients()
+
+
+/**
+ * ******************* SetPrecomputedKernelCoefficients *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::SetPrecomputedKernelCoefficients( const ParametersType & coefficients )
+{
+  this->m_PrecomputedKernelCoefficients = coefficients;
+
+} // end SetPrecomputedKernelCoefficients()
+
+
+/**
+ * ******************* HasPrecomputedKernelCoefficients *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+bool
+KernelTransform2< TScalarType, NDimensions >
+::HasPrecomputedKernelCoefficients( void ) const
+{
+  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
+  return this->m_PrecomputedKernelCoefficients.GetSize() > 0
+         && this->m_PrecomputedKernelCoefficients.GetSize()
+         == ( numberOfLandmarks + NDimensions + 1 ) * NDimensions;
+
+} // end HasPrecomputedKernelCoefficients()
+
+
+/**
+ * ******************* ComputeLInverseIfNeeded *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::ComputeLInverseIfNeeded( void ) const
+{
+  MutexLockHolder< SimpleFastMutexLock > lock( this->m_LInverseMutex );
+  if( !this->m_LInverseComputed )
+  {
+    const_cast< Self * >( this )->ComputeLInverse();
+  }
+
+} // end ComputeLInverseIfNeeded()
+
+
 /**
  * ******************* TransformPoint *******************
  */
@@ -614,8 +732,24 @@ KernelTransform2< TScalarType, NDimensions >
 
   this->m_TargetLandmarks->SetPoints( landmarks );
 
-  // W MUST be recomputed if the target lms are set
-  this->ComputeWMatrix();
+  // W MUST be recomputed if the target lms are set, unless the
+  // coefficients were solved before and provided by the user
+  if( this->HasPrecomputedKernelCoefficients() )
+  {
+    const unsigned int numberOfCoefficients
+      = this->m_PrecomputedKernelCoefficients.GetSize();
+    this->m_WMatrix.set_size( numberOfCoefficients, 1 );
+    for( unsigned int i = 0; i < numberOfCoefficients; ++i )
+    {
+      this->m_WMatrix( i, 0 ) = this->m_PrecomputedKernelCoefficients[ i ];
+    }
+    this->ReorganizeW();
+    this->m_PrecomputedKernelCoefficients = ParametersType( 0 );
+  }
+  else
+  {
+    this->ComputeWMatrix();
+  }
 
   // Modified is always called since we just have a pointer to the
   // parameters and cannot know if the parameters have changed.
@@ -666,8 +800,21 @@ KernelTransform2< TScalarType, NDimensions >
   this->m_LInverseComputed             = false;
   this->m_LMatrixDecompositionComputed = false;
 
-  // you must recompute L and Linv - this does not require the targ lms
-  this->ComputeLInverse();
+  // you must recompute L and Linv - this does not require the targ lms.
+  // Skip this expensive step if the coefficients do not need to be solved;
+  // GetJacobian() then computes Linv when it is first needed.
+  if( !this->HasPrecomputedKernelCoefficients() )
+  {
+    this->ComputeLInverse();
+  }
+
+  // Precompute the nonzerojacobianindices vector, as in SetSourceLandmarks()
+  const NumberOfParametersType nrParams = this->GetNumberOfParameters();
+  this->m_NonZeroJacobianIndices.resize( nrParams );
+  for( unsigned int i = 0; i < nrParams; ++i )
+  {
+    this->m_NonZeroJacobianIndices[ i ] = i;
+  }
 
 } // end SetFixedParameters()
 
@@ -754,6 +901,8 @@ KernelTransform2< TScalarType, NDimensions >
 ::GetJacobian( const InputPointType & p, JacobianType & jac,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
+  this->ComputeLInverseIfNeeded();
+
   const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
   jac.SetSize( NDimensions, numberOfLandmarks * NDimensions );
   jac.Fill( 0.0 );
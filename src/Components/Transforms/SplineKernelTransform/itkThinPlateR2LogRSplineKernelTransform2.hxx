@@ -57,21 +57,26 @@ void
 ThinPlateR2LogRSplineKernelTransform2< TScalarType, NDimensions >::ComputeDeformationContribution( const InputPointType  & thisPoint,
   OutputPointType & result     ) const
 {
-  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
+  /** Loop over the contiguous landmark data, see m_LandmarkKernelData. */
+  const unsigned long numberOfLandmarks = this->m_LandmarkKernelData.size() / ( 2 * NDimensions );
+  const TScalarType * data              = numberOfLandmarks > 0 ? &( this->m_LandmarkKernelData[ 0 ] ) : 0;
 
-  PointsIterator sp = this->m_SourceLandmarks->GetPoints()->Begin();
-
-  for( unsigned int lnd = 0; lnd < numberOfLandmarks; lnd++ )
+  for( unsigned long lnd = 0; lnd < numberOfLandmarks; lnd++ )
   {
-    InputVectorType            position = thisPoint - sp->Value();
-    const TScalarType          r        = position.GetNorm();
-    const TScalarType          R2logR
-      = ( r > 1e-8 ) ? r * r * vcl_log( r ) : NumericTraits< TScalarType >::Zero;
+    TScalarType r2 = NumericTraits< TScalarType >::ZeroValue();
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      const TScalarType diff = thisPoint[ dim ] - data[ dim ];
+      r2 += diff * diff;
+    }
+    // r^2 log(r) = 0.5 r^2 log(r^2)
+    const TScalarType G
+      = ( r2 > 1e-16 ) ? 0.5 * r2 * vcl_log( r2 ) : NumericTraits< TScalarType >::Zero;
     for( unsigned int odim = 0; odim < NDimensions; odim++ )
     {
-      result[ odim ] += R2logR * this->m_DMatrix( odim, lnd );
+      result[ odim ] += G * data[ NDimensions + odim ];
     }
-    ++sp;
+    data += 2 * NDimensions;
   }
 
 }
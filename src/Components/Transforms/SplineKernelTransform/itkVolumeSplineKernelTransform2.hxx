@@ -62,20 +62,25 @@ VolumeSplineKernelTransform2< TScalarType, NDimensions >
 ::ComputeDeformationContribution(
   const InputPointType  & thisPoint, OutputPointType & opp ) const
 {
-  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
-  PointsIterator      sp                = this->m_SourceLandmarks->GetPoints()->Begin();
+  /** Loop over the contiguous landmark data, see m_LandmarkKernelData. */
+  const unsigned long numberOfLandmarks = this->m_LandmarkKernelData.size() / ( 2 * NDimensions );
+  const TScalarType * data              = numberOfLandmarks > 0 ? &( this->m_LandmarkKernelData[ 0 ] ) : 0;
 
-  for( unsigned int lnd = 0; lnd < numberOfLandmarks; lnd++ )
+  for( unsigned long lnd = 0; lnd < numberOfLandmarks; lnd++ )
   {
-    InputVectorType   position = thisPoint - sp->Value();
-    const TScalarType r        = position.GetNorm();
-    const TScalarType r3       = r * r * r;
-
+    TScalarType r2 = NumericTraits< TScalarType >::ZeroValue();
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      const TScalarType diff = thisPoint[ dim ] - data[ dim ];
+      r2 += diff * diff;
+    }
+    const TScalarType r = vcl_sqrt( r2 );
+    const TScalarType G = r2 * r;
     for( unsigned int odim = 0; odim < NDimensions; odim++ )
     {
-      opp[ odim ] += r3 * this->m_DMatrix( odim, lnd );
+      opp[ odim ] += G * data[ NDimensions + odim ];
     }
-    ++sp;
+    data += 2 * NDimensions;
   }
 
 } // end ComputeDeformationContribution()
@@ -64,6 +64,12 @@ namespace elastix
  *    you may want this.
  *    example: <tt>(Scales 1.0 1.0 10.0) </tt> \n
  *    Default: 1 for each parameter. See also AutomaticScalesEstimation, which is more convenient.
+ * \parameter CacheSubTransformDisplacements: sample the displacements of all subtransforms
+ *    once at the voxels of the fixed image, and interpolate them linearly during the
+ *    registration. This makes the cost per sample independent of the subtransforms, at
+ *    the cost of 4 * #voxels * #subtransforms * dimension bytes of memory. \n
+ *    example: <tt>(CacheSubTransformDisplacements "true") </tt> \n
+ *    Default: "false".
  *
  * The transform parameters necessary for transformix, additionally defined by this class, are:
  * \transformparameter NormalizeCombinationWeights: use the normalized expression
@@ -20,6 +20,7 @@
 #define __elxWeightedCombinationTransform_HXX_
 
 #include "elxWeightedCombinationTransform.h"
+#include "itkTimeProbe.h"
 
 namespace elastix
 {
@@ -57,6 +58,21 @@ WeightedCombinationTransformElastix< TElastix >
   /** Give initial parameters to this->m_Registration.*/
   this->InitializeTransform();
 
+  /** Sample the subtransforms on the fixed image grid, if requested. */
+  bool cacheDisplacements = false;
+  this->m_Configuration->ReadParameter( cacheDisplacements,
+    "CacheSubTransformDisplacements", 0 );
+  if( cacheDisplacements )
+  {
+    itk::TimeProbe timer;
+    timer.Start();
+    this->m_WeightedCombinationTransform->CacheSubTransformDisplacements(
+      this->GetElastix()->GetFixedImage() );
+    timer.Stop();
+    elxout << "Caching the subtransform displacements took "
+           << this->ConvertSecondsToDHMS( timer.GetMean(), 2 ) << std::endl;
+  }
+
   /** Set the scales. */
   this->SetScales();
 
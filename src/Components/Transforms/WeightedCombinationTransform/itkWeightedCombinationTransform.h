@@ -19,6 +19,10 @@
 #define __itkWeightedCombinationTransform_h
 
 #include "itkAdvancedTransform.h"
+#include "itkImageBase.h"
+#include "itkMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+#include <vector>
 
 namespace itk
 {
@@ -35,6 +39,11 @@ namespace itk
  * the transformation is as follows:
  * \f[T(x) = \sum_i w_i T_i(x) / \sum_i w_i\f]
  *
+ * Since the sub-transforms are fixed, their displacements can be sampled
+ * once on a grid, see CacheSubTransformDisplacements(). The cost of
+ * TransformPoint() and GetJacobian() then no longer depends on the
+ * complexity of the sub-transforms.
+ *
  * \ingroup Transforms
  *
  */
@@ -96,6 +105,13 @@ public:
   typedef typename TransformType::Pointer TransformPointer;
   typedef std::vector< TransformPointer > TransformContainerType;
 
+  /** The grid on which the sub-transform displacements can be cached. */
+  typedef ImageBase< NInputDimensions >               DisplacementGridType;
+  typedef typename DisplacementGridType::ConstPointer DisplacementGridConstPointer;
+
+  /** The number of corners of a grid cell. */
+  itkStaticConstMacro( NumberOfGridCellCorners, unsigned int, 1 << NInputDimensions );
+
   /**  Method to transform a point. */
   virtual OutputPointType TransformPoint( const InputPointType & ipp ) const;
 
@@ -173,10 +189,32 @@ public:
   virtual void SetTransformContainer( const TransformContainerType & transformContainer )
   {
     this->m_TransformContainer = transformContainer;
+    this->ClearSubTransformDisplacements();
     this->Modified();
   }
 
 
+  /** Sample the displacements T_i(x) - x of all sub-transforms at the
+   * voxels of the grid, typically the fixed image. Afterwards,
+   * TransformPoint() and GetJacobian() interpolate the cached displacements
+   * linearly inside the grid, and evaluate the sub-transforms outside of it.
+   * The displacements are stored in single precision, so this takes
+   * 4 * #voxels * #sub-transforms * dimension bytes. The sub-transforms
+   * should not change afterwards; setting a new transform container clears
+   * the cache. The grid should have at least two voxels in every direction.
+   */
+  virtual void CacheSubTransformDisplacements( const DisplacementGridType * grid );
+
+  /** Release the cached displacements. */
+  virtual void ClearSubTransformDisplacements( void );
+
+  /** Returns whether the sub-transform displacements are cached. */
+  bool GetSubTransformDisplacementsAreCached( void ) const
+  {
+    return !this->m_CachedDisplacements.empty();
+  }
+
+
   /** Return the vector of sub-transforms by const reference.
    * So, if you want to add a sub-transform, you should do something
    * like this:
@@ -252,6 +290,25 @@ protected:
   /** Precomputed nonzero Jacobian indices (simply all params) */
   NonZeroJacobianIndicesType m_NonZeroJacobianIndices;
 
+  /** Compute the voxel offsets and the linear interpolation weights of the
+   * corners of the grid cell that contains ipp. Returns false if ipp is
+   * outside the grid of the cached displacements.
+   */
+  bool ComputeGridCellCorners( const InputPointType & ipp,
+    SizeValueType * offsets, double * weights ) const;
+
+  /** Fill the cache for the voxels handed out by the thread pool. */
+  static ITK_THREAD_RETURN_TYPE CacheDisplacementsThreaderCallback( void * arg );
+
+  /** The cached displacements: component d of sub-transform i at voxel v
+   * is at ( v * #sub-transforms + i ) * OutputSpaceDimension + d.
+   */
+  DisplacementGridConstPointer m_DisplacementGrid;
+  std::vector< float >         m_CachedDisplacements;
+
+  /** The voxels of the grid, handed out to the threads that fill the cache. */
+  PersistentThreadPool::WorkChunks m_WorkChunks;
+
 private:
 
   WeightedCombinationTransform( const Self & ); // purposely not implemented
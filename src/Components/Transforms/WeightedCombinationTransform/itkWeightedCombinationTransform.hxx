@@ -19,6 +19,10 @@
 #define _itkWeightedCombinationTransform_hxx
 
 #include "itkWeightedCombinationTransform.h"
+#include "itkPersistentThreadPool.h"
+#include "itkContinuousIndex.h"
+#include <algorithm>
+#include <cmath>
 
 namespace itk
 {
@@ -93,11 +97,43 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
   const unsigned int             N     = tc.size();
   const ParametersType &         param = this->m_Parameters;
 
-  /** Calculate sum_i w_i T_i(x) */
+  /** With cached displacements: T(x) = x + s \sum_i w_i u_i(x), with
+   * s = 1 / \sum_i w_i for normalized weights, and 1 otherwise.
+   */
+  SizeValueType offsets[ NumberOfGridCellCorners ];
+  double        weights[ NumberOfGridCellCorners ];
+  if( !this->m_CachedDisplacements.empty()
+    && this->ComputeGridCellCorners( ipp, offsets, weights ) )
+  {
+    const double scale = this->m_NormalizeWeights ? 1.0 / this->m_SumOfWeights : 1.0;
+    double       displacement[ OutputSpaceDimension ];
+    std::fill( displacement, displacement + OutputSpaceDimension, 0.0 );
+    for( unsigned int c = 0; c < NumberOfGridCellCorners; ++c )
+    {
+      const float * u = &this->m_CachedDisplacements[ offsets[ c ] * N * OutputSpaceDimension ];
+      for( unsigned int i = 0; i < N; ++i, u += OutputSpaceDimension )
+      {
+        const double w = weights[ c ] * param[ i ];
+        if( w == 0.0 ) { continue; }
+        for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+        {
+          displacement[ d ] += w * u[ d ];
+        }
+      }
+    }
+    for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+    {
+      opp[ d ] = ipp[ d ] + scale * displacement[ d ];
+    }
+    return opp;
+  }
+
+  /** Calculate sum_i w_i T_i(x); sub-transforms without weight are skipped. */
   for( unsigned int i = 0; i < N; ++i )
   {
-    tempopp = tc[ i ]->TransformPoint( ipp );
     const double w = param[ i ];
+    if( w == 0.0 ) { continue; }
+    tempopp = tc[ i ]->TransformPoint( ipp );
     for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
     {
       opp[ d ] += w * tempopp[ d ];
@@ -147,6 +183,46 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
   /** This transform has only nonzero jacobians. */
   nzji = this->m_NonZeroJacobianIndices;
 
+  /** With cached displacements: dT/dmu_i = u_i(x), or for normalized
+   * weights ( u_i(x) - \sum_j w_j u_j(x) / \sum_j w_j ) / \sum_j w_j.
+   */
+  SizeValueType offsets[ NumberOfGridCellCorners ];
+  double        weights[ NumberOfGridCellCorners ];
+  if( !this->m_CachedDisplacements.empty()
+    && this->ComputeGridCellCorners( ipp, offsets, weights ) )
+  {
+    jac.Fill( 0.0 );
+    for( unsigned int c = 0; c < NumberOfGridCellCorners; ++c )
+    {
+      const float * u = &this->m_CachedDisplacements[ offsets[ c ] * N * OutputSpaceDimension ];
+      for( unsigned int i = 0; i < N; ++i, u += OutputSpaceDimension )
+      {
+        for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+        {
+          jac( d, i ) += weights[ c ] * u[ d ];
+        }
+      }
+    }
+
+    if( this->m_NormalizeWeights )
+    {
+      for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+      {
+        double meanDisplacement = 0.0;
+        for( unsigned int i = 0; i < N; ++i )
+        {
+          meanDisplacement += param[ i ] * jac( d, i );
+        }
+        meanDisplacement /= this->m_SumOfWeights;
+        for( unsigned int i = 0; i < N; ++i )
+        {
+          jac( d, i ) = ( jac( d, i ) - meanDisplacement ) / this->m_SumOfWeights;
+        }
+      }
+    }
+    return;
+  }
+
   if( this->m_NormalizeWeights )
   {
     /** dT/dmu_i = ( T_i(x) - T(x) ) / ( \sum_i w_i ) */
@@ -191,6 +267,187 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* CacheSubTransformDisplacements ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::CacheSubTransformDisplacements( const DisplacementGridType * grid )
+{
+  this->ClearSubTransformDisplacements();
+
+  if( NInputDimensions != NOutputDimensions )
+  {
+    itkExceptionMacro( << "Caching the sub-transform displacements requires equal input and output dimensions." );
+  }
+  if( grid == 0 )
+  {
+    itkExceptionMacro( << "No grid given to cache the sub-transform displacements." );
+  }
+  const typename DisplacementGridType::RegionType region = grid->GetLargestPossibleRegion();
+  for( unsigned int d = 0; d < InputSpaceDimension; ++d )
+  {
+    if( region.GetSize()[ d ] < 2 )
+    {
+      itkExceptionMacro( << "The grid to cache the sub-transform displacements should have at least two voxels in every direction." );
+    }
+  }
+
+  const SizeValueType numberOfVoxels = region.GetNumberOfPixels();
+  try
+  {
+    this->m_CachedDisplacements.resize(
+      numberOfVoxels * this->m_TransformContainer.size() * OutputSpaceDimension );
+  }
+  catch( std::bad_alloc & )
+  {
+    this->m_CachedDisplacements.clear();
+    itkExceptionMacro( << "Not enough memory to cache the sub-transform displacements." );
+  }
+  this->m_DisplacementGrid = grid;
+
+  /** Evaluate the sub-transforms in parallel; they are not modified. */
+  PersistentThreadPool * pool = PersistentThreadPool::GetGlobalThreadPool();
+  this->m_WorkChunks.Initialize( numberOfVoxels, 1024 );
+  try
+  {
+    pool->SingleMethodExecute( Self::CacheDisplacementsThreaderCallback, this );
+  }
+  catch( ExceptionObject & )
+  {
+    this->ClearSubTransformDisplacements();
+    throw;
+  }
+
+} // end CacheSubTransformDisplacements()
+
+
+/**
+ * ********************* CacheDisplacementsThreaderCallback ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+ITK_THREAD_RETURN_TYPE
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::CacheDisplacementsThreaderCallback( void * arg )
+{
+  typedef PersistentThreadPool::ThreadInfoType ThreadInfoType;
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  Self *           self       = static_cast< Self * >( infoStruct->UserData );
+
+  const TransformContainerType &                  tc     = self->m_TransformContainer;
+  const unsigned int                              N      = tc.size();
+  const DisplacementGridType *                    grid   = self->m_DisplacementGrid;
+  const typename DisplacementGridType::RegionType region = grid->GetLargestPossibleRegion();
+
+  SizeValueType                                 begin = 0;
+  SizeValueType                                 end   = 0;
+  typename DisplacementGridType::IndexType      index;
+  InputPointType                                ipp;
+  while( self->m_WorkChunks.GetNext( begin, end ) )
+  {
+    for( SizeValueType v = begin; v < end; ++v )
+    {
+      /** The index and physical point of voxel v. */
+      SizeValueType rest = v;
+      for( unsigned int d = 0; d < InputSpaceDimension; ++d )
+      {
+        index[ d ] = region.GetIndex()[ d ] + static_cast< IndexValueType >( rest % region.GetSize()[ d ] );
+        rest      /= region.GetSize()[ d ];
+      }
+      grid->TransformIndexToPhysicalPoint( index, ipp );
+
+      float * u = &self->m_CachedDisplacements[ v * N * OutputSpaceDimension ];
+      for( unsigned int i = 0; i < N; ++i, u += OutputSpaceDimension )
+      {
+        const OutputPointType opp = tc[ i ]->TransformPoint( ipp );
+        for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+        {
+          u[ d ] = static_cast< float >( opp[ d ] - ipp[ d ] );
+        }
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end CacheDisplacementsThreaderCallback()
+
+
+/**
+ * ********************* ClearSubTransformDisplacements ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::ClearSubTransformDisplacements( void )
+{
+  std::vector< float >().swap( this->m_CachedDisplacements );
+  this->m_DisplacementGrid = 0;
+
+} // end ClearSubTransformDisplacements()
+
+
+/**
+ * ********************* ComputeGridCellCorners ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+bool
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::ComputeGridCellCorners( const InputPointType & ipp,
+  SizeValueType * offsets, double * weights ) const
+{
+  const DisplacementGridType *                    grid   = this->m_DisplacementGrid;
+  const typename DisplacementGridType::RegionType region = grid->GetLargestPossibleRegion();
+  ContinuousIndex< TScalarType, NInputDimensions > cindex;
+  grid->TransformPhysicalPointToContinuousIndex( ipp, cindex );
+
+  /** The first corner, and the fractions and strides per direction. */
+  SizeValueType first = 0;
+  SizeValueType stride = 1;
+  SizeValueType strides[ NInputDimensions ];
+  double        fractions[ NInputDimensions ];
+  for( unsigned int d = 0; d < InputSpaceDimension; ++d )
+  {
+    const double x      = cindex[ d ] - region.GetIndex()[ d ];
+    const long   length = static_cast< long >( region.GetSize()[ d ] );
+    if( !( x >= 0.0 && x <= length - 1 ) )
+    {
+      return false;
+    }
+    const long i = std::min( static_cast< long >( std::floor( x ) ), length - 2 );
+    fractions[ d ] = x - i;
+    strides[ d ]   = stride;
+    first         += static_cast< SizeValueType >( i ) * stride;
+    stride        *= static_cast< SizeValueType >( length );
+  }
+
+  for( unsigned int c = 0; c < NumberOfGridCellCorners; ++c )
+  {
+    offsets[ c ] = first;
+    weights[ c ] = 1.0;
+    for( unsigned int d = 0; d < InputSpaceDimension; ++d )
+    {
+      if( ( c >> d ) & 1 )
+      {
+        offsets[ c ] += strides[ d ];
+        weights[ c ] *= fractions[ d ];
+      }
+      else
+      {
+        weights[ c ] *= 1.0 - fractions[ d ];
+      }
+    }
+  }
+  return true;
+
+} // end ComputeGridCellCorners()
+
+
 } // end namespace itk
 
 #endif
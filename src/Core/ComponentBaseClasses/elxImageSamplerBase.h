@@ -25,6 +25,7 @@
 #include "elxBaseComponentSE.h"
 
 #include "itkImageSamplerBase.h"
+#include "itkImageRandomSamplerBase.h"
 
 namespace elastix
 {
@@ -36,6 +37,27 @@ namespace elastix
  *
  * This class contains all the common functionality for ImageSamplers.
  *
+ * The parameters used in this class are:
+ * \parameter UseCounterBasedRandomGenerator: Flag that can be set to "true" or
+ *    "false". If "true", the random samplers draw every sample from its own
+ *    stream of a counter-based random number generator. The samples are then
+ *    drawn multi-threaded, and do not depend on the number of threads. The
+ *    RandomSeed parameter sets the seed. Only used by the "Random" and
+ *    "RandomCoordinate" samplers.
+ *    Can be given for each resolution or for all resolutions at once. \n
+ *    example: <tt>(UseCounterBasedRandomGenerator "true")</tt> \n
+ *    The default is "false", which uses the Mersenne Twister.
+ *
+ * \parameter UseSamplePrefetching: Flag that can be set to "true" or "false".
+ *    If "true", in combination with (NewSamplesEveryIteration "true"), the
+ *    sampler draws the sample set of the next iteration in a background
+ *    thread, while the metric is evaluated on the current one. The selected
+ *    samples are the same as without prefetching. Requires the "Random" or
+ *    "RandomCoordinate" sampler with (UseCounterBasedRandomGenerator "true").
+ *    Can be given for each resolution or for all resolutions at once. \n
+ *    example: <tt>(UseSamplePrefetching "true")</tt> \n
+ *    The default is "false".
+ *
  * \ingroup ImageSamplers
  * \ingroup ComponentBaseClasses
  */
@@ -86,6 +108,11 @@ public:
    */
   virtual void BeforeEachResolutionBase( void );
 
+  /** Execute stuff after each resolution:
+   * \li Stop the sample prefetching, before the images are changed.
+   */
+  virtual void AfterEachResolutionBase( void );
+
 protected:
 
   /** The constructor. */
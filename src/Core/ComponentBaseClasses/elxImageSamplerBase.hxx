@@ -64,9 +64,71 @@ ImageSamplerBase< TElastix >
   }
   else { this->GetAsITKBaseType()->SetUseMultiThread( false ); }
 
+  /** Random samplers may use a counter-based random number generator, which
+   * allows to draw the samples multi-threaded and reproducibly.
+   */
+  typedef itk::ImageRandomSamplerBase< InputImageType > RandomSamplerType;
+  RandomSamplerType * randomSampler
+    = dynamic_cast< RandomSamplerType * >( this->GetAsITKBaseType() );
+  if( randomSampler != 0 )
+  {
+    bool useCounterBasedRandomGenerator = false;
+    this->m_Configuration->ReadParameter( useCounterBasedRandomGenerator,
+      "UseCounterBasedRandomGenerator", this->GetComponentLabel(), level, 0 );
+    randomSampler->SetUseCounterBasedRandomGenerator( useCounterBasedRandomGenerator );
+
+    /** Use the same seed as the Mersenne Twister, see elxElastixBase.
+     * The seed is set once, so that every resolution gets new samples.
+     */
+    if( level == 0 )
+    {
+      unsigned int randomSeed = 121212;
+      this->m_Configuration->ReadParameter( randomSeed, "RandomSeed", 0, false );
+      randomSampler->SetSeed( randomSeed );
+    }
+    if( useCounterBasedRandomGenerator )
+    {
+      randomSampler->SetUseMultiThread( true );
+    }
+  }
+
+  /** Prefetch the samples of the next iteration, if possible. */
+  bool useSamplePrefetching = false;
+  if( newSamples )
+  {
+    this->m_Configuration->ReadParameter( useSamplePrefetching,
+      "UseSamplePrefetching", this->GetComponentLabel(), level, 0 );
+  }
+  this->GetAsITKBaseType()->SetUseSamplePrefetching( useSamplePrefetching );
+  if( useSamplePrefetching && !this->GetAsITKBaseType()->SamplePrefetchingSupported() )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: UseSamplePrefetching is set to \"true\", but the selected\n"
+      << "ImageSampler does not support it. Use the Random or RandomCoordinate\n"
+      << "sampler, with (UseCounterBasedRandomGenerator \"true\")."
+      << std::endl;
+  }
+
 } // end BeforeEachResolutionBase()
 
 
+/**
+ * ******************* AfterEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+ImageSamplerBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  /** The images of the next resolution may not be changed while the
+   * background thread is still reading the current ones.
+   */
+  this->GetAsITKBaseType()->DiscardPrefetchedSamples();
+
+} // end AfterEachResolutionBase()
+
+
 } // end namespace elastix
 
 #endif //#ifndef __elxImageSamplerBase_hxx
@@ -81,6 +81,16 @@ public:
   }
 
 
+  /** Get the memory in bytes that the interpolator allocates for an input
+   * image of numberOfPixels pixels, such as B-spline coefficients. Used
+   * for the memory accounting of ElastixTemplate. Default: 0.
+   */
+  virtual itk::SizeValueType GetMemoryUsage( const itk::SizeValueType itkNotUsed( numberOfPixels ) ) const
+  {
+    return 0;
+  }
+
+
 protected:
 
   /** The constructor. */
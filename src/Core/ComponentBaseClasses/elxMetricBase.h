@@ -23,6 +23,7 @@
 
 #include "elxBaseComponentSE.h"
 #include "itkAdvancedImageToImageMetric.h"
+#include "itkSingleValuedPointSetToPointSetMetric.h"
 #include "itkImageGridSampler.h"
 #include "itkPointSet.h"
 
@@ -63,6 +64,111 @@ namespace elastix
  *    CheckNumberOfSamples. \n
  *    example: <tt>(RequiredRatioOfValidSamples 0.1)</tt> \n
  *    The default is 0.25.
+ * \parameter UseMultiThreadingForMetrics: Whether the metric is computed by
+ *    multiple threads. Used by the advanced image metrics and by the point set
+ *    metrics, such as the CorrespondingPointsEuclideanDistanceMetric. The number
+ *    of threads is set with the -threads command line argument.
+ *    Can be given for each resolution. \n
+ *    example: <tt>(UseMultiThreadingForMetrics "false")</tt> \n
+ *    The default is "true".
+ * \parameter UseThreadPoolForMetrics: Whether the multi-threaded metrics use a
+ *    persistent pool of worker threads, instead of creating new threads at
+ *    every evaluation. Can be given for each resolution. \n
+ *    example: <tt>(UseThreadPoolForMetrics "false")</tt> \n
+ *    The default is "true".
+ * \parameter UseNUMAAwareThreadingForMetrics: Whether the per-thread buffers of
+ *    the multi-threaded metrics are allocated and first touched by the threads
+ *    that use them. Useful on multi-socket machines, together with the
+ *    -threadaffinity command line option of elastix, which pins the workers
+ *    of the thread pool to a processor. Can be given for each resolution. \n
+ *    example: <tt>(UseNUMAAwareThreadingForMetrics "true")</tt> \n
+ *    The default is "false".
+ * \parameter AutomaticNumberOfThreadsForMetrics: Whether the multi-threaded
+ *    metrics tune their number of threads at the start of every resolution, by
+ *    timing a few evaluations with N, N/2, ..., 1 threads. The selected number
+ *    and the measured times are written to the log. Can be given for each
+ *    resolution. \n
+ *    example: <tt>(AutomaticNumberOfThreadsForMetrics "true")</tt> \n
+ *    The default is "false".
+ * \parameter NumberOfThreadsTuningEvaluations: The number of timed evaluations
+ *    per number of threads, see AutomaticNumberOfThreadsForMetrics. Can be
+ *    given for each resolution. \n
+ *    example: <tt>(NumberOfThreadsTuningEvaluations 3)</tt> \n
+ *    The default is 2.
+ * \parameter NumberOfThreadsForMetrics: A fixed number of threads for the metric,
+ *    which overrides AutomaticNumberOfThreadsForMetrics. Can be given for each
+ *    resolution, and for each metric with the prefix "Metric<i>". \n
+ *    example: <tt>(Metric1NumberOfThreadsForMetrics 4 8 16)</tt> \n
+ *    The default is the number of threads of the -threads command line argument.
+ * \parameter UseSampleArrays: Whether the metric reads the samples from a
+ *    structure-of-arrays copy of the sample container, and transforms them in
+ *    batches. Currently only used by the AdvancedMeanSquares metric. Can be
+ *    given for each resolution. \n
+ *    example: <tt>(UseSampleArrays "true")</tt> \n
+ *    The default is "false".
+ * \parameter CacheTransformJacobianStructure: Whether the metric caches the part
+ *    of the transform Jacobian that does not depend on the transform parameters,
+ *    i.e. the B-spline support region and 1D weights of each sample. Only useful
+ *    for samplers that do not select new samples every iteration, such as the
+ *    Full and Grid samplers, and only for B-spline transforms that are not
+ *    composed with an initial transform. Currently only used by the
+ *    AdvancedMeanSquares metric. Can be given for each resolution. \n
+ *    example: <tt>(CacheTransformJacobianStructure "true")</tt> \n
+ *    The default is "false".
+ * \parameter MaximumTransformJacobianStructureCacheSize: The memory budget of this
+ *    cache in megabytes. The cache is not built when it would need more.
+ *    Can be given for each resolution. \n
+ *    example: <tt>(MaximumTransformJacobianStructureCacheSize 1024)</tt> \n
+ *    The default is 512.
+ * \parameter CacheMovingImageGradient: Whether the metric precomputes the differences
+ *    of neighbouring B-spline coefficients, when a BSplineInterpolator or
+ *    BSplineInterpolatorFloat of order n from 2 to 5 is used. The gradient is then
+ *    evaluated from these differences with B-spline kernels of order n - 1,
+ *    which gives the exact gradient of the interpolant. The cache needs
+ *    UseRecursiveBSplineInterpolation, and it is computed at the start of each
+ *    resolution. Can be given for each resolution. \n
+ *    example: <tt>(CacheMovingImageGradient "true")</tt> \n
+ *    The default is "false".
+ * \parameter MaximumMovingImageGradientCacheSize: The memory budget of this cache
+ *    in megabytes. The cache is not built when it would need more.
+ *    Can be given for each resolution. \n
+ *    example: <tt>(MaximumMovingImageGradientCacheSize 1024)</tt> \n
+ *    The default is 512.
+ * \parameter UseRecursiveBSplineInterpolation: Whether the metric evaluates a
+ *    BSplineInterpolator or BSplineInterpolatorFloat of order 1 to 5 itself, with
+ *    a recursive implementation on a copy of the B-spline coefficients that is
+ *    padded at the image boundaries. This gives the same values and gradients
+ *    as the interpolator, faster, but needs the memory of the coefficients once
+ *    more. Can be given for each resolution. \n
+ *    example: <tt>(UseRecursiveBSplineInterpolation "false")</tt> \n
+ *    The default is "true".
+ * \parameter RestrictSamplingToMovingImageOverlap: Whether the image sampler only draws
+ *    samples in the part of the fixed image that the transform maps into the moving
+ *    image, or into the bounding box of the moving mask. Samples outside would be
+ *    rejected after the transform has been evaluated, which wastes time and may
+ *    leave too few valid samples with a partial overlap, such as a different field
+ *    of view. The overlap is estimated at the start of each resolution, with a margin.
+ *    Can be given for each resolution. \n
+ *    example: <tt>(RestrictSamplingToMovingImageOverlap "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseLineSearchTransformCache: Whether the metric caches the mapped samples
+ *    during the line searches of the QuasiNewtonLBFGS and ConjugateGradient optimizers.
+ *    For transforms that are linear in their parameters, such as the B-spline and
+ *    translation transforms, the samples are then mapped twice at the start of a line
+ *    search, and each trial step computes the mapped points from those, instead of
+ *    evaluating the transform. Currently used by the AdvancedMeanSquares,
+ *    AdvancedNormalizedCorrelation, AdvancedKappaStatistic and AdvancedMattesMutualInformation
+ *    metrics. Can be given for each resolution. \n
+ *    example: <tt>(UseLineSearchTransformCache "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseTransformDispatch: Whether the metric maps the samples and computes
+ *    the transform Jacobian products without virtual calls, for the B-spline (order 3),
+ *    recursive B-spline (order 3), affine and Euler transforms, also when these are
+ *    composed with an initial transform. Also checks the moving image buffer inline
+ *    for the linear and B-spline interpolators. The results are the same; set to "false"
+ *    to compare. Can be given for each resolution. \n
+ *    example: <tt>(UseTransformDispatch "false")</tt> \n
+ *    The default is "true".
  *
  * \ingroup Metrics
  * \ingroup ComponentBaseClasses
@@ -123,6 +229,8 @@ public:
     MovingImageDimension, MovingImageDimension,
     CoordinateRepresentationType, CoordinateRepresentationType,
     CoordinateRepresentationType > >                MovingPointSetType;
+  typedef itk::SingleValuedPointSetToPointSetMetric<
+    FixedPointSetType, MovingPointSetType >         PointSetMetricType;
 
   /** Typedefs for sampler support. */
   typedef typename AdvancedMetricType::ImageSamplerType ImageSamplerBaseType;
@@ -150,6 +258,18 @@ public:
    */
   virtual void BeforeEachResolutionBase( void );
 
+  /** Execute stuff after each resolution:
+   * \li Report the memory used by the transform Jacobian structure cache.
+   */
+  virtual void AfterEachResolutionBase( void );
+
+  /** Release the memory that the metric only needs during a resolution, see
+   * AdvancedImageToImageMetric::ReleaseMemory(). Called between the
+   * resolutions in the LowMemoryMode of ElastixTemplate. When the metric is
+   * not of AdvancedMetricType, the function does nothing.
+   */
+  virtual void ReleaseMemory( void );
+
   /** Execute stuff after each iteration:
    * \li Optionally compute the exact metric value and plot it to screen.
    */
@@ -160,6 +280,16 @@ public:
    */
   virtual void SelectNewSamples( void );
 
+  /** Start and end a line search of the optimizer, from position along
+   * direction, in the unscaled parameter space. The metric may then cache
+   * the mapped samples, see the UseLineSearchTransformCache parameter. When the
+   * metric is not of AdvancedMetricType, the functions do nothing.
+   */
+  virtual void BeginLineSearch( const typename ITKBaseType::ParametersType & position,
+    const typename ITKBaseType::ParametersType & direction );
+
+  virtual void EndLineSearch( void );
+
   /** Returns whether the metric uses a sampler. When the metric is not of
    * AdvancedMetricType, the function returns false immediately.
    */
@@ -177,13 +177,229 @@ MetricBase< TElastix >
         const unsigned int nrOfThreads = atoi( tmp.c_str() );
         thisAsAdvanced->SetNumberOfThreads( nrOfThreads );
       }
+
+      /** Should the number of threads be tuned automatically? It starts from
+       * the maximum in every resolution, not from the previous choice. */
+      bool automaticNumberOfThreads = false;
+      this->GetConfiguration()->ReadParameter( automaticNumberOfThreads,
+        "AutomaticNumberOfThreadsForMetrics", this->GetComponentLabel(), level, 0 );
+      if( automaticNumberOfThreads && tmp == "" )
+      {
+        thisAsAdvanced->SetNumberOfThreads(
+          itk::MultiThreader::GetGlobalDefaultNumberOfThreads() );
+      }
+
+      unsigned int tuningEvaluations = 2;
+      this->GetConfiguration()->ReadParameter( tuningEvaluations,
+        "NumberOfThreadsTuningEvaluations", this->GetComponentLabel(), level, 0, false );
+      thisAsAdvanced->SetNumberOfThreadsTuningEvaluations( tuningEvaluations );
+
+      /** A fixed number of threads for this metric and resolution overrides
+       * the tuning. */
+      unsigned int nrOfThreadsForMetric = 0;
+      this->GetConfiguration()->ReadParameter( nrOfThreadsForMetric,
+        "NumberOfThreadsForMetrics", this->GetComponentLabel(), level, 0, false );
+      if( nrOfThreadsForMetric > 0 )
+      {
+        thisAsAdvanced->SetNumberOfThreads( nrOfThreadsForMetric );
+        automaticNumberOfThreads = false;
+      }
+      thisAsAdvanced->SetAutomaticNumberOfThreads( automaticNumberOfThreads );
+
+      /** Should the metric reuse its threads between evaluations? */
+      bool useThreadPool = true;
+      this->GetConfiguration()->ReadParameter( useThreadPool,
+        "UseThreadPoolForMetrics", this->GetComponentLabel(), level, 0 );
+      thisAsAdvanced->SetUseThreadPool( useThreadPool );
+
+      /** Should the per-thread buffers be placed near their threads? */
+      bool useNUMAAwareThreading = false;
+      this->GetConfiguration()->ReadParameter( useNUMAAwareThreading,
+        "UseNUMAAwareThreadingForMetrics", this->GetComponentLabel(), level, 0 );
+      thisAsAdvanced->SetUseNUMAAwareThreading( useNUMAAwareThreading );
+
+      /** Should the metric use the structure-of-arrays sample container? */
+      bool useSampleArrays = false;
+      this->GetConfiguration()->ReadParameter( useSampleArrays,
+        "UseSampleArrays", this->GetComponentLabel(), level, 0 );
+      thisAsAdvanced->SetUseSampleArrays( useSampleArrays );
     }
 
+    /** Should the metric cache the structure of the transform Jacobian? */
+    bool cacheJacobianStructure = false;
+    this->GetConfiguration()->ReadParameter( cacheJacobianStructure,
+      "CacheTransformJacobianStructure", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetCacheTransformJacobianStructure( cacheJacobianStructure );
+
+    /** Get the memory budget of this cache, in MB. */
+    double maximumCacheSize = 512.0;
+    this->GetConfiguration()->ReadParameter( maximumCacheSize,
+      "MaximumTransformJacobianStructureCacheSize", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetMaximumJacobianStructureCacheSize(
+      static_cast< SizeValueType >( maximumCacheSize * 1024.0 * 1024.0 ) );
+
+    /** Should the metric cache the moving image gradient? */
+    bool cacheMovingImageGradient = false;
+    this->GetConfiguration()->ReadParameter( cacheMovingImageGradient,
+      "CacheMovingImageGradient", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetCacheMovingImageGradient( cacheMovingImageGradient );
+
+    /** Get the memory budget of this cache, in MB. */
+    double maximumGradientCacheSize = 512.0;
+    this->GetConfiguration()->ReadParameter( maximumGradientCacheSize,
+      "MaximumMovingImageGradientCacheSize", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetMaximumMovingImageGradientCacheSize(
+      static_cast< SizeValueType >( maximumGradientCacheSize * 1024.0 * 1024.0 ) );
+
+    /** Should the metric evaluate the B-spline interpolator recursively? */
+    bool useRecursiveBSplineInterpolation = true;
+    this->GetConfiguration()->ReadParameter( useRecursiveBSplineInterpolation,
+      "UseRecursiveBSplineInterpolation", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetUseRecursiveBSplineInterpolation( useRecursiveBSplineInterpolation );
+    thisAsAdvanced->SetArtifactCacheDirectory(
+      this->GetConfiguration()->GetCommandLineArgument( "-artifactcache" ) );
+
+    /** Should the samples be restricted to the overlap with the moving image? */
+    bool restrictSamplingToMovingImageOverlap = false;
+    this->GetConfiguration()->ReadParameter( restrictSamplingToMovingImageOverlap,
+      "RestrictSamplingToMovingImageOverlap", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetRestrictSamplingToMovingImageOverlap( restrictSamplingToMovingImageOverlap );
+
+    /** Should the metric cache the mapped samples during line searches? */
+    bool useLineSearchTransformCache = false;
+    this->GetConfiguration()->ReadParameter( useLineSearchTransformCache,
+      "UseLineSearchTransformCache", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetUseLineSearchTransformCache( useLineSearchTransformCache );
+
+    /** Should the metric evaluate the common transforms without virtual calls? */
+    bool useTransformDispatch = true;
+    this->GetConfiguration()->ReadParameter( useTransformDispatch,
+      "UseTransformDispatch", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetUseTransformDispatch( useTransformDispatch );
+
   } // end advanced metric
 
+  /** Cast this to PointSetMetricType. */
+  PointSetMetricType * thisAsPointSetMetric
+    = dynamic_cast< PointSetMetricType * >( this );
+
+  /** Point set metrics can use multi-threading as well. */
+  if( thisAsPointSetMetric != 0 )
+  {
+    bool useMultiThreading = true;
+    this->GetConfiguration()->ReadParameter( useMultiThreading,
+      "UseMultiThreadingForMetrics", this->GetComponentLabel(), level, 0 );
+
+    thisAsPointSetMetric->SetUseMultiThread( useMultiThreading );
+    if( useMultiThreading )
+    {
+      std::string tmp = this->m_Configuration->GetCommandLineArgument( "-threads" );
+      if( tmp != "" )
+      {
+        const unsigned int nrOfThreads = atoi( tmp.c_str() );
+        thisAsPointSetMetric->SetNumberOfThreads( nrOfThreads );
+      }
+    }
+  } // end point set metric
+
 } // end BeforeEachResolutionBase()
 
 
+/**
+ * ******************* AfterEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  /** Report the memory used by the transform Jacobian structure cache. */
+  AdvancedMetricType * thisAsAdvanced
+    = dynamic_cast< AdvancedMetricType * >( this );
+  if( thisAsAdvanced != 0 && thisAsAdvanced->GetCacheTransformJacobianStructure() )
+  {
+    const SizeValueType memoryUsage = thisAsAdvanced->GetJacobianStructureCacheMemoryUsage();
+    if( memoryUsage > 0 )
+    {
+      elxout << "Memory used by the transform Jacobian structure cache: "
+             << static_cast< double >( memoryUsage ) / ( 1024.0 * 1024.0 )
+             << " MB" << std::endl;
+    }
+    else
+    {
+      elxout << "The transform Jacobian structure cache was not used, because "
+             << "the samples changed every iteration, the metric or the transform "
+             << "does not support it, or it would exceed "
+             << "MaximumTransformJacobianStructureCacheSize." << std::endl;
+    }
+  }
+
+  /** Report the tuned number of threads. */
+  if( thisAsAdvanced != 0 && thisAsAdvanced->GetAutomaticNumberOfThreads() )
+  {
+    if( thisAsAdvanced->GetNumberOfThreadsTuningFinished() )
+    {
+      const std::vector< itk::ThreadIdType > & candidates
+        = thisAsAdvanced->GetNumberOfThreadsTuningCandidates();
+      const std::vector< double > & times = thisAsAdvanced->GetNumberOfThreadsTuningTimes();
+      elxout << "Time per metric evaluation, for each number of threads:";
+      for( std::size_t i = 0; i < candidates.size(); ++i )
+      {
+        elxout << " " << candidates[ i ] << ": " << times[ i ] * 1000.0 << " ms";
+      }
+      elxout << "\nNumber of threads selected for the metric: "
+             << thisAsAdvanced->GetNumberOfThreads() << std::endl;
+    }
+    else
+    {
+      elxout << "The number of threads of the metric was not tuned, because "
+             << "there were too few iterations." << std::endl;
+    }
+  }
+
+  /** Report the memory used by the moving image gradient cache. */
+  if( thisAsAdvanced != 0 && thisAsAdvanced->GetCacheMovingImageGradient() )
+  {
+    const SizeValueType memoryUsage = thisAsAdvanced->GetMovingImageGradientCacheMemoryUsage();
+    if( memoryUsage > 0 )
+    {
+      elxout << "Memory used by the moving image gradient cache: "
+             << static_cast< double >( memoryUsage ) / ( 1024.0 * 1024.0 )
+             << " MB" << std::endl;
+    }
+    else
+    {
+      elxout << "The moving image gradient cache was not used, because "
+             << "the interpolator is not a B-spline interpolator of order 2 to 5, "
+             << "UseRecursiveBSplineInterpolation is false, or it would exceed "
+             << "MaximumMovingImageGradientCacheSize."
+             << std::endl;
+    }
+  }
+
+} // end AfterEachResolutionBase()
+
+
+/**
+ * ******************* ReleaseMemory ******************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::ReleaseMemory( void )
+{
+  AdvancedMetricType * thisAsAdvanced
+    = dynamic_cast< AdvancedMetricType * >( this );
+  if( thisAsAdvanced != 0 )
+  {
+    thisAsAdvanced->ReleaseMemory();
+  }
+
+} // end ReleaseMemory()
+
+
 /**
  * ******************* AfterEachIterationBase ******************
  */
@@ -244,6 +460,43 @@ MetricBase< TElastix >
 } // end SelectNewSamples()
 
 
+/**
+ * ********************* BeginLineSearch ************************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::BeginLineSearch( const typename ITKBaseType::ParametersType & position,
+  const typename ITKBaseType::ParametersType & direction )
+{
+  AdvancedMetricType * thisAsAdvanced = dynamic_cast< AdvancedMetricType * >( this );
+  if( thisAsAdvanced != 0 )
+  {
+    thisAsAdvanced->BeginLineSearch( position, direction );
+  }
+
+} // end BeginLineSearch()
+
+
+/**
+ * ********************* EndLineSearch ************************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::EndLineSearch( void )
+{
+  AdvancedMetricType * thisAsAdvanced = dynamic_cast< AdvancedMetricType * >( this );
+  if( thisAsAdvanced != 0 )
+  {
+    thisAsAdvanced->EndLineSearch();
+  }
+
+} // end EndLineSearch()
+
+
 /**
  * ********************* GetExactValue ************************
  */
@@ -0,0 +1,139 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLImagePyramidBase_h
+#define __elxOpenCLImagePyramidBase_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "itkGPUImage.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLImagePyramidBase
+ * \brief Runs the pyramid filter of a CPU pyramid component with OpenCL.
+ *
+ * This class derives from a CPU pyramid component, such as FixedRecursivePyramid,
+ * and computes its pyramid with the same ITK pyramid filter, instantiated for
+ * GPU images. While the filter is updated, the GPU factories are registered, so
+ * that the internal cast, recursive Gaussian, shrink and resample filters are
+ * created as their GPU versions. Filters without a GPU version, such as the
+ * discrete Gaussian of the recursive pyramid, run on the CPU. The schedule of
+ * the CPU component is copied to the GPU filter.
+ *
+ * When no OpenCL context is available, for 2D images, or when any step on the
+ * GPU fails, the CPU pyramid of the component is computed instead.
+ *
+ * The parameters used in this class are:
+ * \parameter <ClassName>UseOpenCL: Enable the OpenCL pyramid, with <ClassName>
+ *    the name of the component, for example:\n
+ *    <tt>(OpenCLFixedRecursiveImagePyramidUseOpenCL "true")</tt>\n
+ *    The default is "true".
+ *
+ * \sa OpenCLFixedGenericPyramid
+ * \ingroup ImagePyramids
+ */
+
+template< class TCPUPyramid, class TGPUPyramidFilter >
+class OpenCLImagePyramidBase :
+  public TCPUPyramid
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLImagePyramidBase                Self;
+  typedef TCPUPyramid                           Superclass;
+  typedef typename TCPUPyramid::Superclass1     Superclass1;
+  typedef typename TCPUPyramid::Superclass2     Superclass2;
+  typedef itk::SmartPointer< Self >             Pointer;
+  typedef itk::SmartPointer< const Self >       ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLImagePyramidBase, TCPUPyramid );
+
+  /** Get the ImageDimension. */
+  itkStaticConstMacro( ImageDimension, unsigned int, Superclass1::ImageDimension );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass1::InputImageType  InputImageType;
+  typedef typename Superclass1::OutputImageType OutputImageType;
+
+  /** Typedefs for factory. */
+  typedef typename itk::ObjectFactoryBase::Pointer ObjectFactoryBasePointer;
+
+  /** GPU Typedefs for GPU image and GPU filter. */
+  typedef typename TGPUPyramidFilter::InputImageType GPUInputImageType;
+  typedef typename GPUInputImageType::Pointer        GPUInputImagePointer;
+  typedef TGPUPyramidFilter                          GPUPyramidType;
+  typedef typename GPUPyramidType::Pointer           GPUPyramidPointer;
+
+  /** Do some things before registration. */
+  virtual void BeforeRegistration( void );
+
+  /** Function to read parameters from a file. */
+  virtual void ReadFromFile( void );
+
+protected:
+
+  /** This method performs all configuration for GPU pyramid. */
+  void BeforeGenerateData( void );
+
+  /** Executes GPU pyramid. */
+  virtual void GenerateData( void );
+
+  /** The constructor. */
+  OpenCLImagePyramidBase();
+  /** The destructor. */
+  virtual ~OpenCLImagePyramidBase() {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLImagePyramidBase( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & ); // purposely not implemented
+
+  /** Register/Unregister factories. */
+  void RegisterFactories( void );
+
+  void UnregisterFactories( void );
+
+  /** Read the UseOpenCL parameter of this component. */
+  void ReadUseOpenCL( void );
+
+  /** Helper method to report switching to CPU mode. */
+  void SwitchingToCPUAndReport( const bool configError );
+
+  /** Helper method to report to elastix log. */
+  void ReportToLog( void );
+
+  GPUPyramidPointer                       m_GPUPyramid;
+  bool                                    m_GPUPyramidReady;
+  bool                                    m_GPUPyramidCreated;
+  bool                                    m_ContextCreated;
+  bool                                    m_UseOpenCL;
+  std::vector< ObjectFactoryBasePointer > m_Factories;
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxOpenCLImagePyramidBase.hxx"
+#endif
+
+#endif // end #ifndef __elxOpenCLImagePyramidBase_h
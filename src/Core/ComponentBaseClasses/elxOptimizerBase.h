@@ -24,6 +24,9 @@
 
 #include "elxBaseComponentSE.h"
 #include "itkOptimizer.h"
+#include "itkRealTimeClock.h"
+
+#include <vector>
 
 namespace elastix
 {
@@ -44,6 +47,36 @@ namespace elastix
  *    Choose one from {"true", "false"} for every resolution.\n
  *    example: <tt>(NewSamplesEveryIteration "true" "true" "true")</tt> \n
  *    Default is "false" for every resolution.\n
+ * \parameter ConvergenceWindowSize: the number of iterations of the windows in which
+ *    optimizers that support it test for convergence, to stop before the maximum number
+ *    of iterations. At the end of each window the tests below are done; the optimization
+ *    stops when all enabled tests pass. Must be 0 or at least 2.\n
+ *    example: <tt>(ConvergenceWindowSize 50 50 100)</tt> \n
+ *    Default is 0 for every resolution, which means: no convergence test.\n
+ * \parameter ConvergenceMetricSlopeTolerance: the metric values in a window are fitted
+ *    by a line. The test passes when the change of the line over the window, relative to
+ *    the mean metric value, is smaller than this tolerance. 0 disables the test.\n
+ *    example: <tt>(ConvergenceMetricSlopeTolerance 1e-4)</tt> \n
+ *    Default is 1e-4 for every resolution.\n
+ * \parameter ConvergenceParameterChangeTolerance: the test passes when the change of the
+ *    scaled parameters over a window, relative to their magnitude, is smaller than this
+ *    tolerance. 0 disables the test.\n
+ *    example: <tt>(ConvergenceParameterChangeTolerance 1e-3)</tt> \n
+ *    Default is 0 for every resolution.\n
+ * \parameter ConvergenceGradientTolerance: the test passes when the magnitude of the
+ *    scaled gradient at the end of a window is smaller than this tolerance.
+ *    0 disables the test.\n
+ *    example: <tt>(ConvergenceGradientTolerance 1e-6)</tt> \n
+ *    Default is 0 for every resolution.\n
+ * \parameter MaximumRegistrationTime: a wall-clock budget, in seconds, for the
+ *    optimization of all resolutions together, for optimizers that support it. At the
+ *    start of each resolution the remaining time is divided equally over the remaining
+ *    resolutions, so time left by a resolution that stopped early goes to the next ones.
+ *    A resolution stops when its next iteration, at the mean cost per iteration so far,
+ *    would exceed its share. The transform and the result are written as usual.
+ *    0 disables the budget.\n
+ *    example: <tt>(MaximumRegistrationTime 30)</tt> \n
+ *    Default is 0.\n
  *
  * \ingroup Optimizers
  * \ingroup ComponentBaseClasses
@@ -94,9 +127,15 @@ public:
 
   /** Execute stuff before each new pyramid resolution:
    * \li Find out if new samples are used every new iteration in this resolution.
+   * \li Read the settings of the convergence test.
    */
   virtual void BeforeEachResolutionBase() ITK_OVERRIDE;
 
+  /** Execute stuff before the registration:
+   * \li Read the time budget and start its clock.
+   */
+  virtual void BeforeRegistrationBase( void ) ITK_OVERRIDE;
+
   /** Execute stuff after registration:
    * \li Compute and print MD5 hash of the transform parameters.
    */
@@ -108,6 +147,22 @@ public:
   virtual void SetSinusScales( double amplitude, double frequency,
     unsigned long numberOfParameters );
 
+  /** Get the state of the optimizer at the end of a resolution that matters
+   * for the next resolutions, for the resolution checkpoints of elastix, see
+   * the parameter WriteResolutionCheckpoint of the ElastixTemplate. The
+   * default optimizer has no such state.
+   */
+  virtual void GetResolutionCheckpointState( std::vector< double > & state ) const
+  {
+    state.clear();
+  }
+
+
+  /** Restore the state of GetResolutionCheckpointState(), after the
+   * BeforeRegistration() of the optimizer, when elastix resumes.
+   */
+  virtual void SetResolutionCheckpointState( const std::vector< double > & /** state */ ) {}
+
 protected:
 
   /** The constructor. */
@@ -123,6 +178,29 @@ protected:
   /** Check whether the user asked to select new samples every iteration. */
   virtual bool GetNewSamplesEveryIteration( void ) const;
 
+  /** Tell the metrics that a line search starts from position along
+   * direction, both in the unscaled parameter space, or that it ended.
+   * See the UseLineSearchTransformCache parameter of the metrics.
+   */
+  virtual void BeginLineSearch( const ParametersType & position,
+    const ParametersType & direction );
+
+  virtual void EndLineSearch( void );
+
+  /** Convergence test, to be called once per iteration by optimizers that want
+   * to stop early. The position and gradient magnitude are those in the scaled
+   * space of the optimizer. Returns true when the window of ConvergenceWindowSize
+   * iterations that ends in this iteration passes all enabled tests.
+   */
+  virtual bool CheckConvergence( const double value,
+    const ParametersType & scaledPosition, const double scaledGradientMagnitude );
+
+  /** Time budget test, to be called once per iteration by optimizers that
+   * can stop early. Returns true when the next iteration is expected to
+   * exceed the share of the MaximumRegistrationTime of this resolution.
+   */
+  virtual bool CheckTimeBudget( void );
+
 private:
 
   /** The private constructor. */
@@ -135,6 +213,29 @@ private:
    */
   bool m_NewSamplesEveryIteration;
 
+  /** Settings and state of the convergence test. The metric values of the
+   * current window are kept as sums for a least squares line fit.
+   */
+  unsigned long  m_ConvergenceWindowSize;
+  double         m_ConvergenceMetricSlopeTolerance;
+  double         m_ConvergenceParameterChangeTolerance;
+  double         m_ConvergenceGradientTolerance;
+  unsigned long  m_ConvergenceIterationCount;
+  double         m_ConvergenceSumX;
+  double         m_ConvergenceSumY;
+  double         m_ConvergenceSumXX;
+  double         m_ConvergenceSumXY;
+  ParametersType m_ConvergenceWindowStartPosition;
+
+  /** Settings and state of the time budget, in seconds. */
+  double                      m_MaximumRegistrationTime;
+  double                      m_RegistrationStartTime;
+  double                      m_ResolutionTimeBudget;
+  double                      m_ResolutionStartTime;
+  double                      m_FirstIterationEndTime;
+  unsigned long               m_TimeBudgetIterationCount;
+  itk::RealTimeClock::Pointer m_TimeBudgetClock;
+
 };
 
 } // end namespace elastix
@@ -22,6 +22,7 @@
 
 #include "itkSingleValuedNonLinearOptimizer.h"
 #include "itk_zlib.h"
+#include <algorithm>
 
 namespace elastix
 {
@@ -36,6 +37,24 @@ OptimizerBase< TElastix >
 {
   this->m_NewSamplesEveryIteration = false;
 
+  this->m_ConvergenceWindowSize               = 0;
+  this->m_ConvergenceMetricSlopeTolerance     = 1e-4;
+  this->m_ConvergenceParameterChangeTolerance = 0.0;
+  this->m_ConvergenceGradientTolerance        = 0.0;
+  this->m_ConvergenceIterationCount           = 0;
+  this->m_ConvergenceSumX                     = 0.0;
+  this->m_ConvergenceSumY                     = 0.0;
+  this->m_ConvergenceSumXX                    = 0.0;
+  this->m_ConvergenceSumXY                    = 0.0;
+
+  this->m_MaximumRegistrationTime  = 0.0;
+  this->m_RegistrationStartTime    = 0.0;
+  this->m_ResolutionTimeBudget     = 0.0;
+  this->m_ResolutionStartTime      = 0.0;
+  this->m_FirstIterationEndTime    = 0.0;
+  this->m_TimeBudgetIterationCount = 0;
+  this->m_TimeBudgetClock          = itk::RealTimeClock::New();
+
 } // end Constructor
 
 
@@ -79,9 +98,66 @@ OptimizerBase< TElastix >
   this->GetConfiguration()->ReadParameter( this->m_NewSamplesEveryIteration,
     "NewSamplesEveryIteration", this->GetComponentLabel(), level, 0 );
 
+  /** Read the settings of the convergence test. */
+  this->m_ConvergenceWindowSize = 0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceWindowSize,
+    "ConvergenceWindowSize", this->GetComponentLabel(), level, 0 );
+  if( this->m_ConvergenceWindowSize == 1 )
+  {
+    itkExceptionMacro( << "ERROR: ConvergenceWindowSize should be 0 or at least 2." );
+  }
+  this->m_ConvergenceMetricSlopeTolerance = 1e-4;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceMetricSlopeTolerance,
+    "ConvergenceMetricSlopeTolerance", this->GetComponentLabel(), level, 0 );
+  this->m_ConvergenceParameterChangeTolerance = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceParameterChangeTolerance,
+    "ConvergenceParameterChangeTolerance", this->GetComponentLabel(), level, 0 );
+  this->m_ConvergenceGradientTolerance = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceGradientTolerance,
+    "ConvergenceGradientTolerance", this->GetComponentLabel(), level, 0 );
+
+  /** Start with an empty window. */
+  this->m_ConvergenceIterationCount = 0;
+  this->m_ConvergenceWindowStartPosition.SetSize( 0 );
+
+  /** Give this resolution an equal share of the remaining time. */
+  this->m_TimeBudgetIterationCount = 0;
+  if( this->m_MaximumRegistrationTime > 0.0 )
+  {
+    const unsigned int numberOfLevels
+      = this->GetRegistration()->GetAsITKBaseType()->GetNumberOfLevels();
+    const unsigned int remainingLevels = numberOfLevels > level ? numberOfLevels - level : 1;
+    this->m_ResolutionStartTime  = this->m_TimeBudgetClock->GetTimeInSeconds();
+    this->m_ResolutionTimeBudget = std::max( 0.0, this->m_MaximumRegistrationTime
+      - ( this->m_ResolutionStartTime - this->m_RegistrationStartTime ) ) / remainingLevels;
+    elxout << "  Time budget of this resolution: "
+           << this->m_ResolutionTimeBudget << " s" << std::endl;
+  }
+
 } // end BeforeEachResolutionBase()
 
 
+/**
+ * ****************** BeforeRegistrationBase **********************
+ */
+
+template< class TElastix >
+void
+OptimizerBase< TElastix >
+::BeforeRegistrationBase( void )
+{
+  this->m_MaximumRegistrationTime = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_MaximumRegistrationTime,
+    "MaximumRegistrationTime", this->GetComponentLabel(), 0, -1, false );
+  if( this->m_MaximumRegistrationTime < 0.0 )
+  {
+    itkExceptionMacro( << "ERROR: MaximumRegistrationTime should not be negative." );
+  }
+  this->m_RegistrationStartTime = this->m_TimeBudgetClock->GetTimeInSeconds();
+
+} // end BeforeRegistrationBase()
+
+
 /**
  * ****************** AfterRegistrationBase **********************
  */
@@ -136,6 +212,40 @@ OptimizerBase< TElastix >
 } // end SelectNewSamples()
 
 
+/**
+ * ****************** BeginLineSearch ****************************
+ */
+
+template< class TElastix >
+void
+OptimizerBase< TElastix >
+::BeginLineSearch( const ParametersType & position, const ParametersType & direction )
+{
+  for( unsigned int i = 0; i < this->GetElastix()->GetNumberOfMetrics(); ++i )
+  {
+    this->GetElastix()->GetElxMetricBase( i )->BeginLineSearch( position, direction );
+  }
+
+} // end BeginLineSearch()
+
+
+/**
+ * ****************** EndLineSearch ****************************
+ */
+
+template< class TElastix >
+void
+OptimizerBase< TElastix >
+::EndLineSearch( void )
+{
+  for( unsigned int i = 0; i < this->GetElastix()->GetNumberOfMetrics(); ++i )
+  {
+    this->GetElastix()->GetElxMetricBase( i )->EndLineSearch();
+  }
+
+} // end EndLineSearch()
+
+
 /**
  * ****************** GetNewSamplesEveryIteration ********************
  */
@@ -151,6 +261,137 @@ OptimizerBase< TElastix >
 } // end GetNewSamplesEveryIteration()
 
 
+/**
+ * ****************** CheckConvergence ********************
+ */
+
+template< class TElastix >
+bool
+OptimizerBase< TElastix >
+::CheckConvergence( const double value,
+  const ParametersType & scaledPosition, const double scaledGradientMagnitude )
+{
+  if( this->m_ConvergenceWindowSize == 0 )
+  {
+    return false;
+  }
+
+  /** Start a new window. */
+  if( this->m_ConvergenceIterationCount == 0 )
+  {
+    this->m_ConvergenceSumX  = 0.0;
+    this->m_ConvergenceSumY  = 0.0;
+    this->m_ConvergenceSumXX = 0.0;
+    this->m_ConvergenceSumXY = 0.0;
+    if( this->m_ConvergenceWindowStartPosition.GetSize() != scaledPosition.GetSize() )
+    {
+      this->m_ConvergenceWindowStartPosition = scaledPosition;
+    }
+  }
+
+  /** Add the metric value to the sums of the line fit. */
+  const double x = static_cast< double >( this->m_ConvergenceIterationCount );
+  this->m_ConvergenceSumX  += x;
+  this->m_ConvergenceSumY  += value;
+  this->m_ConvergenceSumXX += x * x;
+  this->m_ConvergenceSumXY += x * value;
+  ++this->m_ConvergenceIterationCount;
+
+  /** Only test at the end of a window. */
+  const unsigned long n = this->m_ConvergenceWindowSize;
+  if( this->m_ConvergenceIterationCount < n )
+  {
+    return false;
+  }
+  this->m_ConvergenceIterationCount = 0;
+
+  /** Without any enabled test there is no convergence. */
+  bool converged = this->m_ConvergenceMetricSlopeTolerance > 0.0
+    || this->m_ConvergenceParameterChangeTolerance > 0.0
+    || this->m_ConvergenceGradientTolerance > 0.0;
+
+  /** The change of the fitted line over the window, relative to the mean value. */
+  if( this->m_ConvergenceMetricSlopeTolerance > 0.0 )
+  {
+    const double dn    = static_cast< double >( n );
+    const double slope = ( dn * this->m_ConvergenceSumXY
+      - this->m_ConvergenceSumX * this->m_ConvergenceSumY )
+      / ( dn * this->m_ConvergenceSumXX
+      - this->m_ConvergenceSumX * this->m_ConvergenceSumX );
+    const double mean = this->m_ConvergenceSumY / dn;
+    converged &= vcl_abs( slope ) * dn
+      <= this->m_ConvergenceMetricSlopeTolerance * vcl_abs( mean );
+  }
+
+  /** The change of the parameters over the window, relative to their magnitude. */
+  if( this->m_ConvergenceParameterChangeTolerance > 0.0 )
+  {
+    double changeSquared = 0.0;
+    for( unsigned int i = 0; i < scaledPosition.GetSize(); ++i )
+    {
+      const double d = scaledPosition[ i ] - this->m_ConvergenceWindowStartPosition[ i ];
+      changeSquared += d * d;
+    }
+    converged &= vcl_sqrt( changeSquared )
+      <= this->m_ConvergenceParameterChangeTolerance * scaledPosition.magnitude();
+  }
+
+  /** The magnitude of the gradient. */
+  if( this->m_ConvergenceGradientTolerance > 0.0 )
+  {
+    converged &= scaledGradientMagnitude <= this->m_ConvergenceGradientTolerance;
+  }
+
+  this->m_ConvergenceWindowStartPosition = scaledPosition;
+
+  if( converged )
+  {
+    elxout << "Convergence detected at the end of a window of "
+           << n << " iterations." << std::endl;
+  }
+
+  return converged;
+
+} // end CheckConvergence()
+
+
+/**
+ * ****************** CheckTimeBudget ********************
+ */
+
+template< class TElastix >
+bool
+OptimizerBase< TElastix >
+::CheckTimeBudget( void )
+{
+  if( this->m_MaximumRegistrationTime <= 0.0 )
+  {
+    return false;
+  }
+
+  /** The first iteration includes the initialization of the resolution, such
+   * as the automatic parameter estimation, so the cost of an iteration is
+   * measured from the end of the first one.
+   */
+  const double now     = this->m_TimeBudgetClock->GetTimeInSeconds();
+  const double elapsed = now - this->m_ResolutionStartTime;
+  ++this->m_TimeBudgetIterationCount;
+  double costPerIteration = elapsed;
+  if( this->m_TimeBudgetIterationCount == 1 )
+  {
+    this->m_FirstIterationEndTime = now;
+  }
+  else
+  {
+    costPerIteration = ( now - this->m_FirstIterationEndTime )
+      / static_cast< double >( this->m_TimeBudgetIterationCount - 1 );
+  }
+
+  return elapsed + costPerIteration > this->m_ResolutionTimeBudget;
+
+} // end CheckTimeBudget()
+
+
 /**
  * ****************** SetSinusScales ********************
  */
@@ -27,6 +27,7 @@
 /** Mask support. */
 #include "itkImageMaskSpatialObject2.h"
 #include "itkErodeMaskImageFilter.h"
+#include <map>
 
 namespace elastix
 {
@@ -66,6 +67,19 @@ namespace elastix
  *    from one resolution level to another. Choose from {"true", "false"} \n
  *    example: <tt>(ErodeMovingMask2 "true" "false")</tt>
  *    This setting overrules ErodeMask and ErodeMovingMask.\n
+ * \parameter MultiStartInitialTransformParameters: additional candidates for the
+ *    initial transform parameters, for hard initial alignments: the parameter vectors
+ *    of the candidates one after another. The initial transform is the first candidate.
+ *    In the first resolution all candidates are ranked on their metric value, the best
+ *    MultiStartNumberOfSurvivors candidates are optimized, and the optimized candidate
+ *    with the lowest metric value continues to the next resolutions. The candidates
+ *    share the image pyramids. \n
+ *    example: <tt>(MultiStartInitialTransformParameters 0 0 0 10 0 0 0 0 -10)</tt> \n
+ *    Default: no additional candidates.\n
+ * \parameter MultiStartNumberOfSurvivors: the number of multi-start candidates that
+ *    are optimized in the first resolution. \n
+ *    example: <tt>(MultiStartNumberOfSurvivors 2)</tt> \n
+ *    Default: 1.\n
  *
  * \ingroup Registrations
  * \ingroup ComponentBaseClasses
@@ -147,6 +161,22 @@ public:
     const std::string & whichMask,
     const unsigned int level ) const;
 
+  /** Execute stuff before the actual registration:
+   * \li Read the multi-start candidates.
+   */
+  virtual void BeforeRegistrationBase( void ) ITK_OVERRIDE;
+
+  /** Execute stuff after each resolution:
+   * \li Release the eroded masks in LowMemoryMode.
+   */
+  virtual void AfterEachResolutionBase( void ) ITK_OVERRIDE;
+
+  /** Execute stuff after the registration:
+   * \li Print which multi-start candidate was continued.
+   * \li Release the cached eroded masks.
+   */
+  virtual void AfterRegistrationBase( void ) ITK_OVERRIDE;
+
 protected:
 
   /** The constructor. */
@@ -210,6 +240,17 @@ protected:
     const MovingMaskImageType * maskImage, bool useMaskErosion,
     const MovingImagePyramidType * pyramid, unsigned int level ) const;
 
+  /** The erosion filters, one per mask. They cache the eroded masks of all
+   * resolution levels, which are computed incrementally on first use, unless
+   * the LowMemoryMode of ElastixTemplate is on.
+   */
+  typedef std::map< const FixedMaskImageType *,
+    FixedMaskErodeFilterPointer >                       FixedMaskErodeFilterMapType;
+  typedef std::map< const MovingMaskImageType *,
+    MovingMaskErodeFilterPointer >                      MovingMaskErodeFilterMapType;
+  mutable FixedMaskErodeFilterMapType  m_FixedMaskErodeFilters;
+  mutable MovingMaskErodeFilterMapType m_MovingMaskErodeFilters;
+
 private:
 
   /** The private constructor. */
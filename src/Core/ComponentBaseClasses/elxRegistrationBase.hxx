@@ -23,6 +23,82 @@
 namespace elastix
 {
 
+/**
+ * ********************* BeforeRegistrationBase ************************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::BeforeRegistrationBase( void )
+{
+  typedef typename ITKBaseType::ParametersType ParametersType;
+
+  /** Read the additional initial transform parameters of a multi-start. */
+  const std::size_t numberOfEntries = this->GetConfiguration()
+    ->CountNumberOfParameterEntries( "MultiStartInitialTransformParameters" );
+  ParametersType candidates( numberOfEntries );
+  if( numberOfEntries > 0 )
+  {
+    std::vector< double > values;
+    this->GetConfiguration()->ReadParameter( values,
+      "MultiStartInitialTransformParameters", 0, numberOfEntries - 1, true );
+    for( std::size_t i = 0; i < numberOfEntries; ++i )
+    {
+      candidates[ i ] = values[ i ];
+    }
+  }
+  this->GetAsITKBaseType()->SetMultiStartInitialTransformParameters( candidates );
+
+  unsigned long numberOfSurvivors = 1;
+  this->GetConfiguration()->ReadParameter( numberOfSurvivors,
+    "MultiStartNumberOfSurvivors", 0, false );
+  this->GetAsITKBaseType()->SetMultiStartNumberOfSurvivors( numberOfSurvivors );
+
+} // end BeforeRegistrationBase()
+
+
+/**
+ * ********************* AfterEachResolutionBase ************************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  /** The next resolution erodes its masks again. */
+  if( this->GetElastix()->GetLowMemoryMode() )
+  {
+    this->m_FixedMaskErodeFilters.clear();
+    this->m_MovingMaskErodeFilters.clear();
+  }
+
+} // end AfterEachResolutionBase()
+
+
+/**
+ * ********************* AfterRegistrationBase ************************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::AfterRegistrationBase( void )
+{
+  if( this->GetAsITKBaseType()->GetMultiStartInitialTransformParameters().Size() > 0 )
+  {
+    elxout << "Multi-start: candidate "
+           << this->GetAsITKBaseType()->GetMultiStartWinner()
+           << " was continued after the first resolution." << std::endl;
+  }
+
+  this->m_FixedMaskErodeFilters.clear();
+  this->m_MovingMaskErodeFilters.clear();
+
+} // end AfterRegistrationBase()
+
+
 /**
  * ********************* ReadMaskParameters ************************
  */
@@ -118,8 +194,15 @@ RegistrationBase< TElastix >
     return fixedMaskSpatialObject;
   }
 
-  /** Erode, and convert to spatial object. */
-  FixedMaskErodeFilterPointer erosion = FixedMaskErodeFilterType::New();
+  /** Erode, and convert to spatial object. The filter is kept per mask,
+   * so that the eroded masks of all levels are computed only once.
+   */
+  FixedMaskErodeFilterPointer & erosion = this->m_FixedMaskErodeFilters[ maskImage ];
+  if( erosion.IsNull() )
+  {
+    erosion = FixedMaskErodeFilterType::New();
+    erosion->SetCacheErodedMasks( !this->GetElastix()->GetLowMemoryMode() );
+  }
   erosion->SetInput( maskImage );
   erosion->SetSchedule( pyramid->GetSchedule() );
   erosion->SetIsMovingMask( false );
@@ -178,8 +261,15 @@ RegistrationBase< TElastix >
     return movingMaskSpatialObject;
   }
 
-  /** Erode, and convert to spatial object. */
-  MovingMaskErodeFilterPointer erosion = MovingMaskErodeFilterType::New();
+  /** Erode, and convert to spatial object. The filter is kept per mask,
+   * so that the eroded masks of all levels are computed only once.
+   */
+  MovingMaskErodeFilterPointer & erosion = this->m_MovingMaskErodeFilters[ maskImage ];
+  if( erosion.IsNull() )
+  {
+    erosion = MovingMaskErodeFilterType::New();
+    erosion->SetCacheErodedMasks( !this->GetElastix()->GetLowMemoryMode() );
+  }
   erosion->SetInput( maskImage );
   erosion->SetSchedule( pyramid->GetSchedule() );
   erosion->SetIsMovingMask( true );
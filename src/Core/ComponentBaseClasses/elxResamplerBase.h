@@ -24,6 +24,8 @@
 #include "elxBaseComponentSE.h"
 #include "itkResampleImageFilter.h"
 #include "elxProgressCommand.h"
+#include "elxPixelType.h"
+#include "itkBackgroundWriter.h"
 
 namespace elastix
 {
@@ -59,10 +61,68 @@ namespace elastix
  *    or from float to char).\n
  *    Choose from (unsigned) char, (unsigned) short, float, double, etc.\n
  *    example: <tt>(ResultImagePixelType "unsigned short")</tt> \n
- *    The default is "short".
+ *    The default is "short". When elastix is used as a library and this
+ *    equals the internal pixel type, the result image shares the buffer
+ *    of the resampler output instead of being copied. When transformix is
+ *    given several input images, the pixel type can be given for each image.\n
+ *    example: <tt>(ResultImagePixelType "short" "unsigned char" "float")</tt> \n
+ * \parameter ResultImageInterpolator: the interpolator with which each input
+ *    image of transformix is resampled. Choose from "Default", which uses the
+ *    ResampleInterpolator, "NearestNeighbor", for example for label maps, and
+ *    "Linear". The parameter can be given for each input image.\n
+ *    example: <tt>(ResultImageInterpolator "Default" "NearestNeighbor")</tt> \n
+ *    The default is "Default".
  * \parameter CompressResultImage: parameter to set if (lossless) compression
  *    of the written image is desired.\n
  *    example: <tt>(CompressResultImage "true")</tt> \n
+ *    The default is "false". MetaImages (mha, mhd) that are not streamed are
+ *    compressed with all threads.
+ * \parameter ResultImageCompressionLevel: the zlib compression level, from 0
+ *    to 9, of the compressed MetaImages, or -1 for the zlib default. Lower
+ *    levels are faster.\n
+ *    example: <tt>(ResultImageCompressionLevel 1)</tt> \n
+ *    The default is -1.
+ * \parameter ResultImageMemoryLimit: the maximum amount of memory, in megabytes,
+ *    to be used for the resampled image while it is written. When the output
+ *    image is larger, it is resampled, cast and written in slabs, which requires
+ *    a file format that supports streamed writing, such as mha, mhd or nrrd. For
+ *    other formats the image is written in one piece. Note that the moving image
+ *    and the transform are always kept in memory completely. This option is only
+ *    used when the result image is written to disk.\n
+ *    example: <tt>(ResultImageMemoryLimit 1024)</tt> \n
+ *    The default is 0, which means no limit.
+ * \parameter ResampleUsingDeformationField: flag to determine if the transform
+ *    is first evaluated on the whole output grid, in parallel, after which the
+ *    image is resampled using the resulting deformation field. This pays off for
+ *    expensive transforms, such as a B-spline on top of several initial transforms,
+ *    especially in combination with "-def all" in transformix, which then reuses
+ *    the same deformation field. Note that the field takes D times the memory of
+ *    a double precision output image. The option is ignored for the
+ *    RayCastResampleInterpolator.\n
+ *    example: <tt>(ResampleUsingDeformationField "true")</tt> \n
+ *    The default is "false", or "true" when transformix is given several
+ *    input images, which then share the deformation field.
+ * \parameter OutputRegionIndex: transformix only. The start index of the region
+ *    of the output grid, given by Size, Index, Spacing, Origin and Direction, that
+ *    is resampled. The result image, the deformation field and the determinant of
+ *    the spatial Jacobian are computed in this region only.\n
+ *    example: <tt>(OutputRegionIndex 40 60 20)</tt> \n
+ *    The default is the start of the output grid.
+ * \parameter OutputRegionSize: transformix only. The size of that region.\n
+ *    example: <tt>(OutputRegionSize 64 64 32)</tt> \n
+ *    The default is the size of the output grid.
+ * \parameter OutputRegionMaskFileName: transformix only. A mask image, of which
+ *    the bounding box of the nonzero voxels, in physical space, determines the
+ *    region. It overrules OutputRegionIndex and OutputRegionSize.\n
+ *    example: <tt>(OutputRegionMaskFileName "tumour.mha")</tt> \n
+ *    The default is no mask.
+ * \parameter WriteIntermediateResultsInBackground: flag to determine if the
+ *    result images of each resolution and each iteration are written by a
+ *    background thread. The resampling is done in the foreground; the copy of
+ *    the resampled image is cast, compressed and written while the registration
+ *    continues. Images that are streamed, see ResultImageMemoryLimit, and images
+ *    of the RayCastResampleInterpolator are written in the foreground.\n
+ *    example: <tt>(WriteIntermediateResultsInBackground "true")</tt> \n
  *    The default is "false".
  *
  * \ingroup Resamplers
@@ -120,6 +180,14 @@ public:
   itkStaticConstMacro( ImageDimension, unsigned int,
     OutputImageType::ImageDimension );
 
+  /** Typedef's for the deformation field and det(dT/dx) outputs of transformix. */
+  typedef itk::Vector< float,
+    itkGetStaticConstMacro( ImageDimension ) >      DeformationVectorType;
+  typedef itk::Image< DeformationVectorType,
+    itkGetStaticConstMacro( ImageDimension ) >      DeformationFieldImageType;
+  typedef itk::Image< float,
+    itkGetStaticConstMacro( ImageDimension ) >      DeterminantImageType;
+
   /** Cast to ITKBaseType. */
   virtual ITKBaseType * GetAsITKBaseType( void )
   {
@@ -171,8 +239,21 @@ public:
   /** Function to create transform-parameters map. */
   virtual void CreateTransformParametersMap( ParameterMapType * paramsMap ) const;
 
-  /** Function to perform resample and write the result output image to a file. */
-  virtual void ResampleAndWriteResultImage( const char * filename, const bool & showProgress = true );
+  /** Function to perform resample and write the result output image to a file.
+   * If inBackground is true, the resampled image may be written by the
+   * itk::BackgroundWriter, after this function returns.
+   */
+  virtual void ResampleAndWriteResultImage( const char * filename, const bool & showProgress = true,
+    const bool inBackground = false );
+
+  /** Function to resample all input images of transformix, given by -in0,
+   * -in1, etc., and write them to result.<i>.<format>, or result.<format>
+   * for a single image. The transform is evaluated only once, see
+   * ResampleUsingDeformationField, and every image is interpolated with
+   * its own ResultImageInterpolator and written with its own
+   * ResultImagePixelType.
+   */
+  virtual void ResampleAndWriteInputImages( void );
 
   /** Function to write the result output image to a file. */
   virtual void WriteResultImage( OutputImageType * imageimage,
@@ -181,6 +262,20 @@ public:
   /** Function to create the result image in the format of an itk::Image. */
   virtual void CreateItkResultImage( void );
 
+  /** Function to compute the deformation field and/or det(dT/dx) of the
+   * transform on the output grid of the resampler, in a single pass of an
+   * accelerated implementation. Returns false if that is not supported, in
+   * which case the transform computes them. The default returns false.
+   */
+  virtual bool GenerateTransformOutputs(
+    const bool itkNotUsed( computeDeformationField ),
+    const bool itkNotUsed( computeDeterminantOfSpatialJacobian ),
+    typename DeformationFieldImageType::Pointer & itkNotUsed( deformationField ),
+    typename DeterminantImageType::Pointer & itkNotUsed( determinant ) )
+  {
+    return false;
+  }
+
 protected:
 
   /** The constructor. */
@@ -191,9 +286,74 @@ protected:
   /** Method that sets the transform, the interpolator and the inputImage. */
   virtual void SetComponents( void );
 
+  /** Method that replaces the transform of the resampler by a displacement
+   * field transform, if ResampleUsingDeformationField is "true". Returns
+   * true if the transform was replaced, in which case originalTransform
+   * should be set back after resampling.
+   */
+  virtual bool SetDeformationFieldTransform( typename TransformType::ConstPointer & originalTransform );
+
+  /** Method that restricts the output grid of the resampler to the region
+   * of interest, see OutputRegionIndex, OutputRegionSize and
+   * OutputRegionMaskFileName. The origin is moved to the first voxel of the
+   * region. Used by transformix.
+   */
+  virtual void SetOutputRegionOfInterest( void );
+
+  /** Method that returns the number of slabs in which the result image
+   * is written, based on ResultImageMemoryLimit.
+   */
+  virtual unsigned int GetNumberOfStreamDivisions( void ) const;
+
+  /** Method that reads the settings of the written result image: the pixel
+   * type, the compression, and the direction cosines to write.
+   */
+  virtual void GetResultImageWriteSettings( std::string & pixelType, bool & doCompression,
+    int & compressionLevel, DirectionType & direction, bool & changeDirection );
+
+  /** Write an image with the given settings. */
+  static void WriteImage( OutputImageType * image, const std::string & filename,
+    const std::string & pixelType, const bool doCompression, const int compressionLevel,
+    const DirectionType & direction, const bool changeDirection,
+    const unsigned int numberOfStreamDivisions );
+
+  /** The task that writes a resampled image in the background. */
+  class WriteImageTask : public itk::BackgroundWriter::Task
+  {
+public:
+
+    virtual void Execute( void )
+    {
+      Self::WriteImage( this->m_Image, this->m_FileName, this->m_PixelType,
+        this->m_DoCompression, this->m_CompressionLevel,
+        this->m_Direction, this->m_ChangeDirection, 1 );
+    }
+
+
+    typename OutputImageType::Pointer m_Image;
+    std::string                       m_FileName;
+    std::string                       m_PixelType;
+    bool                              m_DoCompression;
+    int                               m_CompressionLevel;
+    DirectionType                     m_Direction;
+    bool                              m_ChangeDirection;
+  };
+
   /** Variable that defines to print the progress or not. */
   bool m_ShowProgress;
 
+  /** The WriteResultImageAfterEachIteration parameter, read every iteration. */
+  CachedParameter< bool > m_WriteResultImageAfterEachIteration;
+
+  /** The WriteIntermediateResultsInBackground parameter. */
+  bool m_WriteIntermediateResultsInBackground;
+
+  /** The index of the input image that is resampled, and the number of
+   * input images, see ResampleAndWriteInputImages().
+   */
+  unsigned int m_ResultImageIndex;
+  unsigned int m_NumberOfResultImages;
+
 private:
 
   /** The private constructor. */
@@ -23,7 +23,14 @@
 #include "itkImageFileCastWriter.h"
 #include "itkChangeInformationImageFilter.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkDisplacementFieldTransform.h"
+#include "itkNearestNeighborInterpolateImageFunction.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkTimeProbe.h"
+#include "vnl/vnl_math.h"
+#include "vcl_cmath.h"
 
 namespace elastix
 {
@@ -34,9 +41,13 @@ namespace elastix
 
 template< class TElastix >
 ResamplerBase< TElastix >
-::ResamplerBase()
+::ResamplerBase() :
+  m_WriteResultImageAfterEachIteration( "WriteResultImageAfterEachIteration", false )
 {
-  this->m_ShowProgress = true;
+  this->m_ShowProgress                         = true;
+  this->m_WriteIntermediateResultsInBackground = false;
+  this->m_ResultImageIndex                     = 0;
+  this->m_NumberOfResultImages                 = 1;
 } // end Constructor
 
 
@@ -78,6 +89,11 @@ ResamplerBase< TElastix >
   this->GetAsITKBaseType()->SetDefaultPixelValue(
     static_cast< OutputPixelType >( defaultPixelValue ) );
 
+  /** Check if the intermediate result images are written in the background. */
+  this->m_WriteIntermediateResultsInBackground = false;
+  this->m_Configuration->ReadParameter( this->m_WriteIntermediateResultsInBackground,
+    "WriteIntermediateResultsInBackground", 0, false );
+
 } // end BeforeRegistrationBase()
 
 
@@ -123,7 +139,8 @@ ResamplerBase< TElastix >
     elxout << "Applying transform this resolution ..." << std::endl;
     try
     {
-      this->ResampleAndWriteResultImage( makeFileName.str().c_str() );
+      this->ResampleAndWriteResultImage( makeFileName.str().c_str(), true,
+        this->m_WriteIntermediateResultsInBackground );
     }
     catch( itk::ExceptionObject & excp )
     {
@@ -158,9 +175,8 @@ ResamplerBase< TElastix >
   const unsigned int iter = this->m_Elastix->GetIterationCounter();
 
   /** Decide whether or not to write the result image this iteration. */
-  bool writeResultImageThisIteration = false;
-  this->m_Configuration->ReadParameter( writeResultImageThisIteration,
-    "WriteResultImageAfterEachIteration", "", level, 0, false );
+  const bool writeResultImageThisIteration
+    = this->m_WriteResultImageAfterEachIteration.Get( this->m_Configuration, level );
 
   /** Writing result image. */
   if( writeResultImageThisIteration )
@@ -183,7 +199,8 @@ ResamplerBase< TElastix >
     /** Apply the final transform, and save the result. */
     try
     {
-      this->ResampleAndWriteResultImage( makeFileName.str().c_str(), false );
+      this->ResampleAndWriteResultImage( makeFileName.str().c_str(), false,
+        this->m_WriteIntermediateResultsInBackground );
     }
     catch( itk::ExceptionObject & excp )
     {
@@ -314,6 +331,202 @@ ResamplerBase< TElastix >
 } // end SetComponents()
 
 
+/**
+ * ******************* SetDeformationFieldTransform ********************
+ */
+
+template< class TElastix >
+bool
+ResamplerBase< TElastix >
+::SetDeformationFieldTransform( typename TransformType::ConstPointer & originalTransform )
+{
+  /** Check if the deformation field should be used. Several input images
+   * share it by default.
+   */
+  bool useDeformationField = this->m_NumberOfResultImages > 1;
+  this->m_Configuration->ReadParameter( useDeformationField,
+    "ResampleUsingDeformationField", 0, false );
+  if( !useDeformationField )
+  {
+    return false;
+  }
+
+  /** The RayCastResampleInterpolator needs the original transform. */
+  typedef itk::AdvancedRayCastInterpolateImageFunction<  InputImageType,
+    CoordRepType > RayCastInterpolatorType;
+  const RayCastInterpolatorType * testptr = dynamic_cast< const
+    RayCastInterpolatorType * >( this->GetAsITKBaseType()->GetInterpolator() );
+  if( testptr )
+  {
+    return false;
+  }
+
+  /** Compute the deformation field and wrap it in a transform. */
+  typedef itk::DisplacementFieldTransform<
+    CoordRepType, ImageDimension >                   DisplacementFieldTransformType;
+  typename DisplacementFieldTransformType::Pointer fieldTransform
+    = DisplacementFieldTransformType::New();
+  elxout << "  Computing the deformation field for resampling ..." << std::endl;
+  fieldTransform->SetDisplacementField(
+    this->m_Elastix->GetElxTransformBase()->GenerateDisplacementField() );
+
+  originalTransform = this->GetAsITKBaseType()->GetTransform();
+  this->GetAsITKBaseType()->SetTransform( fieldTransform );
+  return true;
+
+} // end SetDeformationFieldTransform()
+
+
+/**
+ * ******************* SetOutputRegionOfInterest ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::SetOutputRegionOfInterest( void )
+{
+  ITKBaseType * resampler = this->GetAsITKBaseType();
+  const SizeType  gridSize  = resampler->GetSize();
+  const IndexType gridIndex = resampler->GetOutputStartIndex();
+
+  /** An image without buffer, to convert between the grid and physical space. */
+  typename OutputImageType::Pointer grid = OutputImageType::New();
+  grid->SetOrigin( resampler->GetOutputOrigin() );
+  grid->SetSpacing( resampler->GetOutputSpacing() );
+  grid->SetDirection( resampler->GetOutputDirection() );
+
+  /** Read the region from the parameter file. */
+  IndexType roiIndex = gridIndex;
+  SizeType  roiSize  = gridSize;
+  bool      found    = false;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    found |= this->m_Configuration->ReadParameter( roiIndex[ i ], "OutputRegionIndex", i, false );
+    found |= this->m_Configuration->ReadParameter( roiSize[ i ], "OutputRegionSize", i, false );
+  }
+
+  /** Or take the bounding box of a mask. */
+  std::string maskFileName = "";
+  this->m_Configuration->ReadParameter( maskFileName, "OutputRegionMaskFileName", 0, false );
+  if( !maskFileName.empty() )
+  {
+    typedef itk::Image< unsigned char, ImageDimension > MaskImageType;
+    typedef itk::ImageFileReader< MaskImageType >       MaskReaderType;
+    typename MaskReaderType::Pointer maskReader = MaskReaderType::New();
+    maskReader->SetFileName( maskFileName );
+    try
+    {
+      maskReader->Update();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << excp << std::endl;
+      xl::xout[ "error" ] << "ERROR: the OutputRegionMaskFileName could not be read, "
+                          << "the whole output grid is used." << std::endl;
+      return;
+    }
+
+    IndexType minIndex;
+    IndexType maxIndex;
+    bool      empty = true;
+    typedef itk::ImageRegionConstIteratorWithIndex< MaskImageType > MaskIteratorType;
+    MaskIteratorType it( maskReader->GetOutput(), maskReader->GetOutput()->GetBufferedRegion() );
+    typename MaskImageType::PointType                    point;
+    itk::ContinuousIndex< CoordRepType, ImageDimension > cindex;
+    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+      if( it.Get() == 0 ) { continue; }
+      maskReader->GetOutput()->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+      grid->TransformPhysicalPointToContinuousIndex( point, cindex );
+      for( unsigned int i = 0; i < ImageDimension; ++i )
+      {
+        const itk::IndexValueType lower = static_cast< itk::IndexValueType >( vcl_floor( cindex[ i ] ) );
+        const itk::IndexValueType upper = static_cast< itk::IndexValueType >( vcl_ceil( cindex[ i ] ) );
+        minIndex[ i ] = empty ? lower : vnl_math_min( minIndex[ i ], lower );
+        maxIndex[ i ] = empty ? upper : vnl_math_max( maxIndex[ i ], upper );
+      }
+      empty = false;
+    }
+    if( empty )
+    {
+      xl::xout[ "error" ] << "ERROR: the OutputRegionMaskFileName is empty, "
+                          << "the whole output grid is used." << std::endl;
+      return;
+    }
+    for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+      roiIndex[ i ] = minIndex[ i ];
+      roiSize[ i ]  = maxIndex[ i ] - minIndex[ i ] + 1;
+    }
+    found = true;
+  }
+  if( !found ) { return; }
+
+  /** Clip the region to the output grid. */
+  typename OutputImageType::RegionType gridRegion( gridIndex, gridSize );
+  typename OutputImageType::RegionType roi( roiIndex, roiSize );
+  if( !roi.Crop( gridRegion ) )
+  {
+    xl::xout[ "error" ] << "ERROR: the output region of interest is outside the output grid, "
+                        << "the whole output grid is used." << std::endl;
+    return;
+  }
+
+  /** Move the origin to the first voxel of the region, and keep the start index. */
+  OriginPointType                                      origin;
+  itk::ContinuousIndex< CoordRepType, ImageDimension > shifted;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    shifted[ i ] = static_cast< CoordRepType >( roi.GetIndex()[ i ] - gridIndex[ i ] );
+  }
+  grid->TransformContinuousIndexToPhysicalPoint( shifted, origin );
+  resampler->SetOutputOrigin( origin );
+  resampler->SetSize( roi.GetSize() );
+
+  elxout << "  Resampling in the output region of interest with index "
+         << roi.GetIndex() << " and size " << roi.GetSize() << std::endl;
+
+} // end SetOutputRegionOfInterest()
+
+
+/**
+ * ******************* GetNumberOfStreamDivisions ********************
+ */
+
+template< class TElastix >
+unsigned int
+ResamplerBase< TElastix >
+::GetNumberOfStreamDivisions( void ) const
+{
+  /** Read the memory limit in megabytes. */
+  double memoryLimit = 0.0;
+  this->m_Configuration->ReadParameter( memoryLimit,
+    "ResultImageMemoryLimit", 0, false );
+  if( memoryLimit <= 0.0 )
+  {
+    return 1;
+  }
+
+  /** The resampled image and its cast copy are in memory at the same time. */
+  const SizeType size = this->GetAsITKBaseType()->GetSize();
+  double         numberOfPixels = 1.0;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    numberOfPixels *= static_cast< double >( size[ i ] );
+  }
+  const double bytesPerPixel = sizeof( OutputPixelType ) + sizeof( double );
+  const double divisions
+    = vcl_ceil( numberOfPixels * bytesPerPixel / ( memoryLimit * 1024.0 * 1024.0 ) );
+
+  /** Never use more slabs than there are slices. */
+  const double maximumDivisions = static_cast< double >( size[ ImageDimension - 1 ] );
+  return static_cast< unsigned int >(
+    vnl_math_max( 1.0, vnl_math_min( divisions, maximumDivisions ) ) );
+
+} // end GetNumberOfStreamDivisions()
+
+
 /**
  * ******************* ResampleAndWriteResultImage ********************
  */
@@ -321,8 +534,24 @@ ResamplerBase< TElastix >
 template< class TElastix >
 void
 ResamplerBase< TElastix >
-::ResampleAndWriteResultImage( const char * filename, const bool & showProgress )
+::ResampleAndWriteResultImage( const char * filename, const bool & showProgress,
+  const bool inBackground )
 {
+  /** Possibly resample using the deformation field. */
+  typename TransformType::ConstPointer originalTransform;
+  const bool useDeformationField = this->SetDeformationFieldTransform( originalTransform );
+
+  /** Streamed images are pulled through the resampler by the writer, and the
+   * RayCastResampleInterpolator changes the transform of the resampler while
+   * writing, so those are written in the foreground.
+   */
+  typedef itk::AdvancedRayCastInterpolateImageFunction<  InputImageType,
+    CoordRepType > RayCastInterpolatorType;
+  const bool writeInBackground = inBackground
+    && this->GetNumberOfStreamDivisions() == 1
+    && dynamic_cast< const RayCastInterpolatorType * >(
+    this->GetAsITKBaseType()->GetInterpolator() ) == 0;
+
   /** Make sure the resampler is updated. */
   this->GetAsITKBaseType()->Modified();
 
@@ -337,10 +566,14 @@ ResamplerBase< TElastix >
   }
 #endif
 
-  /** Do the resampling. */
+  /** Do the resampling. When streaming, the writer pulls the slabs
+   * through the resampler one by one. */
   try
   {
-    this->GetAsITKBaseType()->Update();
+    if( this->GetNumberOfStreamDivisions() == 1 )
+    {
+      this->GetAsITKBaseType()->Update();
+    }
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -354,8 +587,23 @@ ResamplerBase< TElastix >
     throw excp;
   }
 
-  /** Perform the writing. */
-  this->WriteResultImage( this->GetAsITKBaseType()->GetOutput(), filename, showProgress );
+  /** Perform the writing. In the background, the writer takes the resampled
+   * image, and the resampler creates a new output for the next resampling.
+   */
+  if( writeInBackground )
+  {
+    WriteImageTask * task = new WriteImageTask;
+    this->GetResultImageWriteSettings( task->m_PixelType, task->m_DoCompression,
+      task->m_CompressionLevel, task->m_Direction, task->m_ChangeDirection );
+    task->m_Image    = this->GetAsITKBaseType()->GetOutput();
+    task->m_FileName = filename;
+    task->m_Image->DisconnectPipeline();
+    itk::BackgroundWriter::GetGlobalBackgroundWriter()->Submit( task );
+  }
+  else
+  {
+    this->WriteResultImage( this->GetAsITKBaseType()->GetOutput(), filename, showProgress );
+  }
 
   /** Disconnect from the resampler. */
 #ifndef _ELASTIX_BUILD_LIBRARY
@@ -365,9 +613,102 @@ ResamplerBase< TElastix >
   }
 #endif
 
+  /** Set back the original transform. */
+  if( useDeformationField )
+  {
+    this->GetAsITKBaseType()->SetTransform( originalTransform );
+  }
+
 } // end ResampleAndWriteResultImage()
 
 
+/**
+ * ******************* ResampleAndWriteInputImages ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::ResampleAndWriteInputImages( void )
+{
+  const unsigned int numberOfImages = this->m_Elastix->GetNumberOfMovingImages();
+
+  std::string resultImageFormat = "mhd";
+  this->m_Configuration->ReadParameter( resultImageFormat,
+    "ResultImageFormat", 0, false );
+
+  /** The interpolators that may replace the ResampleInterpolator. */
+  typedef itk::NearestNeighborInterpolateImageFunction<
+    InputImageType, CoordRepType >                   NearestNeighborInterpolatorType;
+  typedef itk::LinearInterpolateImageFunction<
+    InputImageType, CoordRepType >                   LinearInterpolatorType;
+  typename InterpolatorType::Pointer defaultInterpolator = const_cast< InterpolatorType * >(
+    this->GetAsITKBaseType()->GetInterpolator() );
+
+  this->m_NumberOfResultImages = numberOfImages;
+  for( unsigned int i = 0; i < numberOfImages; ++i )
+  {
+    this->m_ResultImageIndex = i;
+    this->GetAsITKBaseType()->SetInput( dynamic_cast< InputImageType * >(
+        this->m_Elastix->GetMovingImage( i ) ) );
+
+    /** Select the interpolator of this image. */
+    std::string interpolatorName = "Default";
+    this->m_Configuration->ReadParameter( interpolatorName,
+      "ResultImageInterpolator", "", i, 0, false );
+    if( interpolatorName == "NearestNeighbor" )
+    {
+      this->GetAsITKBaseType()->SetInterpolator( NearestNeighborInterpolatorType::New() );
+    }
+    else if( interpolatorName == "Linear" )
+    {
+      this->GetAsITKBaseType()->SetInterpolator( LinearInterpolatorType::New() );
+    }
+    else
+    {
+      if( interpolatorName != "Default" )
+      {
+        xl::xout[ "warning" ] << "WARNING: unknown ResultImageInterpolator \""
+                              << interpolatorName << "\", the ResampleInterpolator is used."
+                              << std::endl;
+      }
+      this->GetAsITKBaseType()->SetInterpolator( defaultInterpolator );
+    }
+
+    /** Create a name for the result. */
+    std::ostringstream makeFileName( "" );
+    makeFileName << this->m_Configuration->GetCommandLineArgument( "-out" ) << "result.";
+    if( numberOfImages > 1 )
+    {
+      makeFileName << i << ".";
+    }
+    makeFileName << resultImageFormat;
+
+    if( numberOfImages > 1 )
+    {
+      elxout << "  Resampling input image " << i << " ..." << std::endl;
+    }
+    try
+    {
+      this->ResampleAndWriteResultImage( makeFileName.str().c_str() );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << excp << std::endl;
+      xl::xout[ "error" ] << "However, transformix continues anyway." << std::endl;
+    }
+  }
+
+  /** Restore the first image and the ResampleInterpolator. */
+  this->m_ResultImageIndex     = 0;
+  this->m_NumberOfResultImages = 1;
+  this->GetAsITKBaseType()->SetInterpolator( defaultInterpolator );
+  this->GetAsITKBaseType()->SetInput( dynamic_cast< InputImageType * >(
+      this->m_Elastix->GetMovingImage( 0 ) ) );
+
+} // end ResampleAndWriteInputImages()
+
+
 /**
  * ******************* WriteResultImage ********************
  */
@@ -394,44 +735,14 @@ ResamplerBase< TElastix >
       ( const_cast< RayCastInterpolatorType * >( testptr ) )->GetTransform() );
   }
 
-  /** Read output pixeltype from parameter the file. Replace possible " " with "_". */
-  std::string resultImagePixelType = "short";
-  this->m_Configuration->ReadParameter( resultImagePixelType,
-    "ResultImagePixelType", 0, false );
-  std::basic_string< char >::size_type       pos  = resultImagePixelType.find( " " );
-  const std::basic_string< char >::size_type npos = std::basic_string< char >::npos;
-  if( pos != npos ) { resultImagePixelType.replace( pos, 1, "_" ); }
-
-  /** Read from the parameter file if compression is desired. */
-  bool doCompression = false;
-  this->m_Configuration->ReadParameter(
-    doCompression, "CompressResultImage", 0, false );
-
-  /** Typedef's for writing the output image. */
-  typedef itk::ImageFileCastWriter< OutputImageType > WriterType;
-  typedef typename WriterType::Pointer                WriterPointer;
-  typedef itk::ChangeInformationImageFilter<
-    OutputImageType >                                 ChangeInfoFilterType;
-
-  /** Possibly change direction cosines to their original value, as specified
-   * in the tp-file, or by the fixed image. This is only necessary when
-   * the UseDirectionCosines flag was set to false.
-   */
-  typename ChangeInfoFilterType::Pointer infoChanger = ChangeInfoFilterType::New();
+  /** Read the settings of the written image. */
+  std::string   resultImagePixelType;
+  bool          doCompression    = false;
+  int           compressionLevel = -1;
   DirectionType originalDirection;
-  bool          retdc = this->GetElastix()->GetOriginalFixedImageDirection( originalDirection );
-  infoChanger->SetOutputDirection( originalDirection );
-  infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
-  infoChanger->SetInput( image );
-
-  /** Create writer. */
-  WriterPointer writer = WriterType::New();
-
-  /** Setup the pipeline. */
-  writer->SetInput( infoChanger->GetOutput() );
-  writer->SetFileName( filename );
-  writer->SetOutputComponentType( resultImagePixelType.c_str() );
-  writer->SetUseCompression( doCompression );
+  bool          changeDirection = false;
+  this->GetResultImageWriteSettings( resultImagePixelType, doCompression,
+    compressionLevel, originalDirection, changeDirection );
 
   /** Do the writing. */
   if( showProgress )
@@ -441,7 +752,9 @@ ResamplerBase< TElastix >
   }
   try
   {
-    writer->Update();
+    Self::WriteImage( image, filename, resultImagePixelType, doCompression,
+      compressionLevel, originalDirection, changeDirection,
+      this->GetNumberOfStreamDivisions() );
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -457,6 +770,80 @@ ResamplerBase< TElastix >
 } // end WriteResultImage()
 
 
+/**
+ * ******************* GetResultImageWriteSettings ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::GetResultImageWriteSettings( std::string & pixelType, bool & doCompression,
+  int & compressionLevel, DirectionType & direction, bool & changeDirection )
+{
+  /** Read output pixeltype from parameter the file. Replace possible " " with "_". */
+  pixelType = "short";
+  this->m_Configuration->ReadParameter( pixelType,
+    "ResultImagePixelType", "", this->m_ResultImageIndex, 0, false );
+  std::basic_string< char >::size_type       pos  = pixelType.find( " " );
+  const std::basic_string< char >::size_type npos = std::basic_string< char >::npos;
+  if( pos != npos ) { pixelType.replace( pos, 1, "_" ); }
+
+  /** Read from the parameter file if compression is desired. */
+  doCompression = false;
+  this->m_Configuration->ReadParameter(
+    doCompression, "CompressResultImage", 0, false );
+  compressionLevel = -1;
+  this->m_Configuration->ReadParameter(
+    compressionLevel, "ResultImageCompressionLevel", 0, false );
+
+  /** Possibly change direction cosines to their original value, as specified
+   * in the tp-file, or by the fixed image. This is only necessary when
+   * the UseDirectionCosines flag was set to false.
+   */
+  const bool retdc = this->GetElastix()->GetOriginalFixedImageDirection( direction );
+  changeDirection = retdc & !this->GetElastix()->GetUseDirectionCosines();
+
+} // end GetResultImageWriteSettings()
+
+
+/**
+ * ******************* WriteImage ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::WriteImage( OutputImageType * image, const std::string & filename,
+  const std::string & pixelType, const bool doCompression, const int compressionLevel,
+  const DirectionType & direction, const bool changeDirection,
+  const unsigned int numberOfStreamDivisions )
+{
+  /** Typedef's for writing the output image. */
+  typedef itk::ImageFileCastWriter< OutputImageType > WriterType;
+  typedef typename WriterType::Pointer                WriterPointer;
+  typedef itk::ChangeInformationImageFilter<
+    OutputImageType >                                 ChangeInfoFilterType;
+
+  /** Setup the pipeline. */
+  typename ChangeInfoFilterType::Pointer infoChanger = ChangeInfoFilterType::New();
+  infoChanger->SetOutputDirection( direction );
+  infoChanger->SetChangeDirection( changeDirection );
+  infoChanger->SetInput( image );
+
+  WriterPointer writer = WriterType::New();
+  writer->SetInput( infoChanger->GetOutput() );
+  writer->SetFileName( filename.c_str() );
+  writer->SetOutputComponentType( pixelType.c_str() );
+  writer->SetUseCompression( doCompression );
+  writer->SetCompressionLevel( compressionLevel );
+  writer->SetNumberOfStreamDivisions( numberOfStreamDivisions );
+
+  /** Do the writing. */
+  writer->Update();
+
+} // end WriteImage()
+
+
 /*
  * ******************* CreateItkResultImage ********************
  * \todo: avoid code duplication with WriteResultImage function
@@ -469,6 +856,10 @@ ResamplerBase< TElastix >
 {
   itk::DataObject::Pointer resultImage;
 
+  /** Possibly resample using the deformation field. */
+  typename TransformType::ConstPointer originalTransform;
+  const bool useDeformationField = this->SetDeformationFieldTransform( originalTransform );
+
   /** Make sure the resampler is updated. */
   this->GetAsITKBaseType()->Modified();
 
@@ -554,15 +945,25 @@ ResamplerBase< TElastix >
   typedef itk::CastImageFilter< InputImageType,
     itk::Image< double, InputImageType::ImageDimension > >          CastFilterDouble;
 
+  /** Without a cast, the result image takes over the buffer of the
+   * resampler output, so that no copy is made.
+   */
+  if( resultImagePixelType == elastix::PixelType< OutputPixelType >::ToString() )
+  {
+    infoChanger->Update();
+    resultImage = infoChanger->GetOutput();
+    resultImage->DisconnectPipeline();
+    this->GetAsITKBaseType()->GetOutput()->ReleaseData();
+  }
   /** cast the image to the correct output image Type */
-  if( resultImagePixelType.compare( "char" ) == 0 )
+  else if( resultImagePixelType.compare( "char" ) == 0 )
   {
     typename CastFilterChar::Pointer castFilter = CastFilterChar::New();
     castFilter->SetInput( infoChanger->GetOutput() );
     castFilter->Update();
     resultImage = castFilter->GetOutput();
   }
-  if( resultImagePixelType.compare( "unsigned char" ) == 0 )
+  else if( resultImagePixelType.compare( "unsigned char" ) == 0 )
   {
     typename CastFilterUChar::Pointer castFilter = CastFilterUChar::New();
     castFilter->SetInput( infoChanger->GetOutput() );
@@ -641,6 +1042,13 @@ ResamplerBase< TElastix >
   /** Disconnect from the resampler. */
   progressObserver->DisconnectObserver( this->GetAsITKBaseType() );
 #endif
+
+  /** Set back the original transform. */
+  if( useDeformationField )
+  {
+    this->GetAsITKBaseType()->SetTransform( originalTransform );
+  }
+
 } // end CreateItkResultImage()
 
 
@@ -716,6 +1124,9 @@ ResamplerBase< TElastix >
   }
   this->GetAsITKBaseType()->SetOutputDirection( direction );
 
+  /** Possibly restrict the output grid to a region of interest. */
+  this->SetOutputRegionOfInterest();
+
   /** Set the DefaultPixelValue (for pixels in the resampled image
    * that come from outside the original (moving) image.
    */
@@ -26,9 +26,17 @@
 #include "itkAdvancedCombinationTransform.h"
 #include "elxComponentDatabase.h"
 #include "elxProgressCommand.h"
+#include "elxPixelType.h"
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkTransformToDisplacementFieldFilter.h"
+#include "itkTransformToDeformationFieldAndSpatialJacobianSource.h"
+#include "itkMultiThreader.h"
+#include "itkMemoryMappedFile.h"
 
 #include <fstream>
 #include <iomanip>
+#include <vector>
 
 namespace elastix
 {
@@ -51,6 +59,13 @@ namespace elastix
  *   "Compose" by composition: \f$T(x) = T_1 ( T_0(x) )\f$.\n
  *   example: <tt>(HowToCombineTransforms "Add")</tt>\n
  *   Default: "Add".
+ * \parameter WriteTransformParametersAsBinary: Write the transform parameters to
+ *   a raw binary file next to the transform parameter file, instead of as text in
+ *   the TransformParameters entry. For large B-spline transforms this is much
+ *   faster to write and to read. The binary file gets the name of the transform
+ *   parameter file with the extension ".bin".\n
+ *   example: <tt>(WriteTransformParametersAsBinary "true")</tt>\n
+ *   Default: "false".
  *
  * \transformparameter UseDirectionCosines: Controls whether to use or ignore the
  * direction cosines (world matrix, transform matrix) set in the images.
@@ -99,6 +114,31 @@ namespace elastix
  * The number of entries is stored the NumberOfParameters entry.
  * \transformparameter NumberOfParameters: the length of the transform parameter vector.\n
  * example <tt>(NumberOfParameters 722)</tt>\n
+ * \transformparameter TransformParametersBinaryFileName: a raw binary file with the
+ * NumberOfParameters transform parameters as doubles, used instead of the
+ * TransformParameters entry. A relative name is relative to the directory of the
+ * transform parameter file. The file is memory mapped, not parsed.\n
+ * example <tt>(TransformParametersBinaryFileName "TransformParameters.0.bin")</tt>\n
+ * \transformparameter TransformParametersByteOrder: the byte order of the
+ * TransformParametersBinaryFile, "LittleEndian" or "BigEndian".\n
+ * example <tt>(TransformParametersByteOrder "LittleEndian")</tt>\n
+ * Default: "LittleEndian".
+ * \transformparameter WriteOutputPointsAsBinary: When transforming the points of
+ *   an input point file (transformix -def), write the transformed points also to
+ *   a binary file outputpoints.bin, next to outputpoints.txt. The binary file has
+ *   the format that the TransformixInputPointFileReader reads, so it can be used
+ *   directly as input point file.\n
+ *   example <tt>(WriteOutputPointsAsBinary "true")</tt>\n
+ *   Default: "false".
+ * \transformparameter DeformationFieldOutputType: The storage of the deformation
+ *   field of transformix -def all, and of the DeformationFieldTransform: "float",
+ *   or "quantized", which stores 16 bit integers with a scale and an offset in the
+ *   header, see itk::DeformationFieldQuantizer. That halves the size of the file,
+ *   with an error of at most half the scale. It requires a format that stores the
+ *   header fields, such as mhd, mha or nrrd. The DeformationFieldTransform reads
+ *   both.\n
+ *   example <tt>(DeformationFieldOutputType "quantized")</tt>\n
+ *   Default: "float".
  * \transformparameter InitialTransformParametersFileName: The location/name of an initial
  * transform that will be loaded when loading the current transform parameter file. Note
  * that transform parameter file can also contain an initial transform. Recursively all
@@ -122,6 +162,8 @@ namespace elastix
  *    It is also possible to deform all points, thereby generating a deformation field
  *    image. This is done by:\n
  *    example: <tt>-def all</tt> \n
+ *    When <tt>(ResampleUsingDeformationField "true")</tt> is set, see the ResamplerBase,
+ *    the deformation field that was used for resampling is reused.\n
  *
  * \ingroup Transforms
  * \ingroup ComponentBaseClasses
@@ -192,6 +234,18 @@ public:
   typedef typename ITKBaseType::InputPointType  InputPointType;
   typedef typename ITKBaseType::OutputPointType OutputPointType;
 
+  /** Typedef's for the deformation field on the output grid of the resampler. */
+  typedef itk::Vector< CoordRepType,
+    itkGetStaticConstMacro( FixedImageDimension ) >   DisplacementVectorType;
+  typedef itk::Image< DisplacementVectorType,
+    itkGetStaticConstMacro( FixedImageDimension ) >   DisplacementFieldType;
+  typedef itk::TransformToDisplacementFieldFilter<
+    DisplacementFieldType, CoordRepType >             DisplacementFieldGeneratorType;
+
+  /** Typedef for the source of the -def, -jac and -jacmat outputs. */
+  typedef itk::TransformToDeformationFieldAndSpatialJacobianSource<
+    itkGetStaticConstMacro( FixedImageDimension ), CoordRepType, float > TransformOutputsSourceType;
+
   /** Typedefs needed for AutomaticScalesEstimation function */
   typedef typename RegistrationType::ITKBaseType      ITKRegistrationType;
   typedef typename ITKRegistrationType::OptimizerType OptimizerType;
@@ -295,6 +349,13 @@ public:
   /** Function to transform all coordinates from fixed to moving image. */
   virtual void TransformPointsAllPoints( void ) const;
 
+  /** Function to compute the deformation field on the output grid of the
+   * resampler. The field is computed in parallel and kept, so that a next
+   * call with the same transform and output grid returns it immediately.
+   * It is used when the parameter ResampleUsingDeformationField is "true".
+   */
+  virtual DisplacementFieldType * GenerateDisplacementField( void ) const;
+
   /** Function to compute the determinant of the spatial Jacobian. */
   virtual void ComputeDeterminantOfSpatialJacobian( void ) const;
 
@@ -316,7 +377,7 @@ protected:
   /** Estimate a scales vector
    * AutomaticScalesEstimation works like this:
    * \li N=10000 points are sampled on a uniform grid on the fixed image.
-   * \li Jacobians dT/dmu are computed
+   * \li Jacobians dT/dmu are computed, using multiple threads
    * \li Scales_i = 1/N sum_x || dT / dmu_i ||^2
    */
   void AutomaticScalesEstimation( ScalesType & scales ) const;
@@ -325,17 +386,62 @@ protected:
    * elxAffineStackTransform, ...) Instead of sampling along the n dimensions of the
    * fixed image, it samples along n-1 dimensions. Then
    * \li N=10000 points are sampled.
-   * \li Jacobians dT/dmu are computed
+   * \li Jacobians dT/dmu are computed, using multiple threads
    * \li Scales_i = 1/N sum_x || dT / dmu_i ||^2
    */
   void AutomaticScalesEstimationStackTransform(
     const unsigned int & numSubTransforms, ScalesType & scales ) const;
 
+  /** Compute sum_x || dT / dmu_i ||^2 over an array of points, for the
+   * AutomaticScalesEstimation functions. Every thread sums over a chunk of
+   * the points; the partial sums are added in a fixed order.
+   */
+  void ComputeSumsOfSquaredJacobiansMultiThreaded(
+    const std::vector< InputPointType > & points, ScalesType & sums ) const;
+
+  /** Transform an array of points, using multiple threads. This is used
+   * by TransformPointsSomePoints() and TransformPointsSomePointsVTK(), which
+   * may be given millions of points.
+   */
+  void TransformPointsMultiThreaded( const InputPointType * inputPoints,
+    const itk::SizeValueType numberOfPoints, OutputPointType * outputPoints ) const;
+
+  /** Get the source that computes the deformation field, det(dT/dx) and
+   * dT/dx in a single pass over the output grid of the resampler. All
+   * outputs requested on the command line ("-def all", "-jac all" and
+   * "-jacmat all") are switched on, so the first output that is written
+   * computes the others as well.
+   */
+  TransformOutputsSourceType * GetTransformOutputsSource( void ) const;
+
+  /** Let the resampler compute the deformation field and det(dT/dx) that are
+   * requested on the command line, if it supports that, e.g. on the GPU. This
+   * is tried only once, the outputs are stored for TransformPointsAllPoints()
+   * and ComputeDeterminantOfSpatialJacobian().
+   */
+  void GenerateTransformOutputsUsingResampler( void ) const;
+
+  /** Write the parameters to a binary file next to the transform parameter
+   * file, see the WriteTransformParametersAsBinary parameter. Returns the
+   * name of the binary file relative to the transform parameter file, or an
+   * empty string if it could not be written.
+   */
+  std::string WriteTransformParametersToBinaryFile( const ParametersType & param ) const;
+
+  /** Let m_TransformParametersPointer refer to the parameters in the memory
+   * mapped binary file, see the TransformParametersBinaryFileName entry.
+   */
+  void ReadTransformParametersFromBinaryFile(
+    const std::string & fileName, const unsigned int numberOfParameters );
+
   /** Member variables. */
   ParametersType * m_TransformParametersPointer;
   std::string      m_TransformParametersFileName;
   ParametersType   m_FinalParameters;
 
+  /** The binary parameter file, mapped as long as the parameters are used. */
+  itk::MemoryMappedFile::Pointer m_TransformParametersMappedFile;
+
 private:
 
   /** The private constructor. */
@@ -345,6 +451,42 @@ private:
 
   /** Boolean to decide whether or not the transform parameters are written. */
   bool m_ReadWriteTransformParameters;
+
+  /** The threader callback of TransformPointsMultiThreaded(). */
+  static ITK_THREAD_RETURN_TYPE TransformPointsThreaderCallback( void * arg );
+
+  /** The threader callback of ComputeSumsOfSquaredJacobiansMultiThreaded(). */
+  static ITK_THREAD_RETURN_TYPE SumsOfSquaredJacobiansThreaderCallback( void * arg );
+
+  /** The struct passed to SumsOfSquaredJacobiansThreaderCallback(). */
+  struct SumsOfSquaredJacobiansThreaderParameterType
+  {
+    const ITKBaseType *                   st_Transform;
+    const std::vector< InputPointType > * st_Points;
+    std::vector< ScalesType >             st_PartialSums;
+  };
+
+  /** The struct passed to TransformPointsThreaderCallback(). */
+  struct TransformPointsThreaderParameterType
+  {
+    const ITKBaseType *    st_Transform;
+    const InputPointType * st_InputPoints;
+    OutputPointType *      st_OutputPoints;
+    itk::SizeValueType     st_NumberOfPoints;
+  };
+
+  /** The source of the -def, -jac and -jacmat outputs. */
+  mutable typename TransformOutputsSourceType::Pointer m_TransformOutputsSource;
+
+  /** The generator of the cached deformation field. */
+  mutable typename DisplacementFieldGeneratorType::Pointer m_DisplacementFieldGenerator;
+
+  /** The -def and -jac outputs computed by the resampler, if any. */
+  mutable bool m_TransformOutputsUsingResamplerTried;
+  mutable typename TransformOutputsSourceType::DeformationFieldImageType::Pointer
+    m_ResamplerDeformationField;
+  mutable typename TransformOutputsSourceType::DeterminantImageType::Pointer
+    m_ResamplerDeterminantOfSpatialJacobian;
   
   std::string GetInitialTransformParametersFileName() const
   {
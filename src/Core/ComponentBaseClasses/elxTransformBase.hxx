@@ -24,19 +24,23 @@
 #include "itkDefaultStaticMeshTraits.h"
 #include "itkTransformixInputPointFileReader.h"
 #include "vnl/vnl_math.h"
+#include "vcl_cmath.h"
 #include <itksys/SystemTools.hxx>
 #include "itkVector.h"
 #include "itkTransformToDisplacementFieldFilter.h"
-#include "itkTransformToDeterminantOfSpatialJacobianSource.h"
-#include "itkTransformToSpatialJacobianSource.h"
 #include "itkImageFileWriter.h"
 #include "itkImageGridSampler.h"
 #include "itkContinuousIndex.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkCastImageFilter.h"
+#include "itkDeformationFieldQuantizer.h"
 #include "itkMesh.h"
 #include "itkMeshFileReader.h"
 #include "itkMeshFileWriter.h"
-#include "itkTransformMeshFilter.h"
+#include "itkByteSwapper.h"
+#include "itkIntTypes.h"
+#include <cstdio>
+#include <cstring>
 
 namespace itk
 {
@@ -110,8 +114,9 @@ TransformBase< TElastix >
 ::TransformBase()
 {
   /** Initialize. */
-  this->m_TransformParametersPointer   = 0;
-  this->m_ReadWriteTransformParameters = true;
+  this->m_TransformParametersPointer          = 0;
+  this->m_ReadWriteTransformParameters        = true;
+  this->m_TransformOutputsUsingResamplerTried = false;
 
 } // end Constructor()
 
@@ -286,6 +291,15 @@ TransformBase< TElastix >
         itkExceptionMacro( << "ERROR: the file " << fileName << " does not exist!" );
       }
     }
+    else if( this->m_Elastix->GetNumberOfConfigurations() > 0 )
+    {
+      /** The initial transform was passed as transform parameter maps,
+       * see ElastixMain::SetInitialTransformParameterMaps(). The last
+       * one is the initial transform of this registration.
+       */
+      this->ReadInitialTransformFromVector(
+        this->m_Elastix->GetNumberOfConfigurations() - 1 );
+    }
   }
 
 } // end BeforeRegistrationBase()
@@ -401,51 +415,67 @@ TransformBase< TElastix >
     {
       delete this->m_TransformParametersPointer;
     }
-    this->m_TransformParametersPointer = new ParametersType( numberOfParameters );
-
-    /** Read the TransformParameters. */
-    std::vector< ValueType > vecPar( numberOfParameters,
-      itk::NumericTraits< ValueType >::ZeroValue() );
-    this->m_Configuration->ReadParameter( vecPar, "TransformParameters",
-      0, numberOfParameters - 1, true );
-
-    /** Sanity check. Are the number of found parameters the same as
-     * the number of specified parameters?
-     * Do not rely on vecPar.size(), since it is unchanged by ReadParameter(),
-     * so we cannot use: numberOfParametersFound = vecPar.size().
+
+    /** The parameters are either in a binary file or in the
+     * TransformParameters entry.
      */
-    const std::size_t numberOfParametersFound
-      = this->m_Configuration->CountNumberOfParameterEntries( "TransformParameters" );
+    std::string binaryFileName = "";
+    this->m_Configuration->ReadParameter( binaryFileName,
+      "TransformParametersBinaryFileName", 0, false );
 
-    if( numberOfParametersFound != numberOfParameters )
+    if( !binaryFileName.empty() )
     {
-      std::ostringstream makeMessage( "" );
-      makeMessage << "\nERROR: Invalid transform parameter file!\n"
-                  << "The number of parameters in \"TransformParameters\" is "
-                  << numberOfParametersFound
-                  << ", which does not match the number specified in \"NumberOfParameters\" ("
-                  << numberOfParameters << ").\n"
-                  << "The transform parameters should be specified as:\n"
-                  << "  (TransformParameters num num ... num)\n"
-                  << "with " << numberOfParameters << " parameters." << std::endl;
-      itkExceptionMacro( << makeMessage.str().c_str() );
-
-      /** Historical note:
-       * The old way of specifying parameters was
-       *  - for less than 20 parameters:
-       *      (TransformParameters num num ... num)
-       *  - Otherwise:
-       *      // (TransformParameters)
-       *      // num num ... num
-       *
-       * This behavior was deprecated since elastix 4.2, and removed in elastix 4.5.
-       */
+      this->m_TransformParametersPointer = new ParametersType();
+      this->ReadTransformParametersFromBinaryFile( binaryFileName, numberOfParameters );
     }
-
-    /** Copy to m_TransformParametersPointer. */
-    for( unsigned int i = 0; i < numberOfParameters; i++ )
+    else
     {
-      ( *( this->m_TransformParametersPointer ) )[ i ] = vecPar[ i ];
+      this->m_TransformParametersPointer = new ParametersType( numberOfParameters );
+
+      /** Read the TransformParameters. */
+      std::vector< ValueType > vecPar( numberOfParameters,
+        itk::NumericTraits< ValueType >::ZeroValue() );
+      this->m_Configuration->ReadParameter( vecPar, "TransformParameters",
+        0, numberOfParameters - 1, true );
+
+      /** Sanity check. Are the number of found parameters the same as
+       * the number of specified parameters?
+       * Do not rely on vecPar.size(), since it is unchanged by ReadParameter(),
+       * so we cannot use: numberOfParametersFound = vecPar.size().
+       */
+      const std::size_t numberOfParametersFound
+        = this->m_Configuration->CountNumberOfParameterEntries( "TransformParameters" );
+
+      if( numberOfParametersFound != numberOfParameters )
+      {
+        std::ostringstream makeMessage( "" );
+        makeMessage << "\nERROR: Invalid transform parameter file!\n"
+                    << "The number of parameters in \"TransformParameters\" is "
+                    << numberOfParametersFound
+                    << ", which does not match the number specified in \"NumberOfParameters\" ("
+                    << numberOfParameters << ").\n"
+                    << "The transform parameters should be specified as:\n"
+                    << "  (TransformParameters num num ... num)\n"
+                    << "with " << numberOfParameters << " parameters." << std::endl;
+        itkExceptionMacro( << makeMessage.str().c_str() );
+
+        /** Historical note:
+         * The old way of specifying parameters was
+         *  - for less than 20 parameters:
+         *      (TransformParameters num num ... num)
+         *  - Otherwise:
+         *      // (TransformParameters)
+         *      // num num ... num
+         *
+         * This behavior was deprecated since elastix 4.2, and removed in elastix 4.5.
+         */
+      }
+
+      /** Copy to m_TransformParametersPointer. */
+      for( unsigned int i = 0; i < numberOfParameters; i++ )
+      {
+        ( *( this->m_TransformParametersPointer ) )[ i ] = vecPar[ i ];
+      }
     }
 
     /** Set the parameters into this transform. */
@@ -638,6 +668,109 @@ TransformBase< TElastix >
 } // end ReadInitialTransformFromFile()
 
 
+/**
+ * ************ WriteTransformParametersToBinaryFile ************
+ */
+
+template< class TElastix >
+std::string
+TransformBase< TElastix >
+::WriteTransformParametersToBinaryFile( const ParametersType & param ) const
+{
+  /** The binary file is written next to the transform parameter file. */
+  const std::string tpFileName = this->m_TransformParametersFileName;
+  if( tpFileName.empty() )
+  {
+    return "";
+  }
+
+  const std::string path = itksys::SystemTools::GetFilenamePath( tpFileName );
+  const std::string name
+    = itksys::SystemTools::GetFilenameWithoutLastExtension( tpFileName ) + ".bin";
+  const std::string fullName = path.empty() ? name : path + "/" + name;
+
+  std::ofstream binaryFile( fullName.c_str(), std::ios::out | std::ios::binary );
+  if( !binaryFile.is_open() )
+  {
+    xl::xout[ "error" ] << "ERROR: File \"" << fullName << "\" could not be opened!\n"
+                        << "  The transform parameters are written as text." << std::endl;
+    return "";
+  }
+
+  binaryFile.write( reinterpret_cast< const char * >( param.data_block() ),
+    param.GetSize() * sizeof( ValueType ) );
+  if( !binaryFile )
+  {
+    xl::xout[ "error" ] << "ERROR: Writing \"" << fullName << "\" failed!\n"
+                        << "  The transform parameters are written as text." << std::endl;
+    return "";
+  }
+
+  return name;
+
+} // end WriteTransformParametersToBinaryFile()
+
+
+/**
+ * ************ ReadTransformParametersFromBinaryFile ***********
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::ReadTransformParametersFromBinaryFile(
+  const std::string & fileName, const unsigned int numberOfParameters )
+{
+  /** A relative file name is relative to the transform parameter file. */
+  std::string       fullFileName = fileName;
+  const std::string tpFileName = this->m_Configuration->GetCommandLineArgument( "-tp" );
+  if( !tpFileName.empty() && !itksys::SystemTools::FileIsFullPath( fileName.c_str() ) )
+  {
+    const std::string path = itksys::SystemTools::GetFilenamePath( tpFileName );
+    if( !path.empty() )
+    {
+      fullFileName = path + "/" + fileName;
+    }
+  }
+
+  /** Map the file, instead of reading it. Only the pages that are used,
+   * or byte swapped, are loaded.
+   */
+  this->m_TransformParametersMappedFile = itk::MemoryMappedFile::New();
+  this->m_TransformParametersMappedFile->Map( fullFileName );
+
+  const itk::SizeValueType expectedSize = numberOfParameters * sizeof( ValueType );
+  if( this->m_TransformParametersMappedFile->GetSize() != expectedSize )
+  {
+    itkExceptionMacro( << "ERROR: The size of the transform parameter file \""
+                       << fullFileName << "\" is "
+                       << this->m_TransformParametersMappedFile->GetSize()
+                       << " bytes, which does not match the " << numberOfParameters
+                       << " parameters specified in \"NumberOfParameters\"." );
+  }
+
+  ValueType * data = static_cast< ValueType * >(
+    this->m_TransformParametersMappedFile->GetData() );
+
+  /** Convert to the byte order of this system, if needed. */
+  std::string byteOrder = "LittleEndian";
+  this->m_Configuration->ReadParameter( byteOrder,
+    "TransformParametersByteOrder", 0, false );
+  if( byteOrder == "BigEndian" )
+  {
+    itk::ByteSwapper< ValueType >::SwapRangeFromSystemToBigEndian( data, numberOfParameters );
+  }
+  else
+  {
+    itk::ByteSwapper< ValueType >::SwapRangeFromSystemToLittleEndian( data, numberOfParameters );
+  }
+
+  /** Refer to the mapped data, without copying it. */
+  this->m_TransformParametersPointer->SetData( data, numberOfParameters, false );
+
+} // end ReadTransformParametersFromBinaryFile()
+
+
 /**
  * ******************* WriteToFile ******************************
  */
@@ -678,13 +811,35 @@ TransformBase< TElastix >
   /** Write the parameters of this transform. */
   if( this->m_ReadWriteTransformParameters )
   {
-    /** In this case, write in a normal way to the parameter file. */
-    xout[ "transpar" ] << "(TransformParameters ";
-    for( unsigned int i = 0; i < nrP - 1; i++ )
+    /** Possibly write the parameters to a binary file, and refer to it. */
+    bool writeBinary = false;
+    this->m_Configuration->ReadParameter( writeBinary,
+      "WriteTransformParametersAsBinary", 0, false );
+    std::string binaryFileName = "";
+    if( writeBinary )
     {
-      xout[ "transpar" ] << param[ i ] << " ";
+      binaryFileName = this->WriteTransformParametersToBinaryFile( param );
+    }
+
+    if( !binaryFileName.empty() )
+    {
+      const std::string byteOrder
+        = itk::ByteSwapper< ValueType >::SystemIsBigEndian() ? "BigEndian" : "LittleEndian";
+      xout[ "transpar" ] << "(TransformParametersBinaryFileName \""
+                         << binaryFileName << "\")" << std::endl;
+      xout[ "transpar" ] << "(TransformParametersByteOrder \""
+                         << byteOrder << "\")" << std::endl;
+    }
+    else
+    {
+      /** In this case, write in a normal way to the parameter file. */
+      xout[ "transpar" ] << "(TransformParameters ";
+      for( unsigned int i = 0; i < nrP - 1; i++ )
+      {
+        xout[ "transpar" ] << param[ i ] << " ";
+      }
+      xout[ "transpar" ] << param[ nrP - 1 ] << ")" << std::endl;
     }
-    xout[ "transpar" ] << param[ nrP - 1 ] << ")" << std::endl;
   }
 
   /** Write the name of the parameters-file of the initial transform. */
@@ -719,11 +874,13 @@ TransformBase< TElastix >
   xout[ "transpar" ] << "(MovingImageDimension "
                      << MovDim << ")" << std::endl;
 
-  /** Write image pixel types. */
-  std::string fixpix = "float";
-  std::string movpix = "float";
-  this->m_Configuration->ReadParameter( fixpix, "FixedInternalImagePixelType", 0 );
-  this->m_Configuration->ReadParameter( movpix, "MovingInternalImagePixelType", 0 );
+  /** Write image pixel types. These are the types elastix ran with, also
+   * when the parameter file asked for the "native" types.
+   */
+  const std::string fixpix
+    = elx::PixelType< typename FixedImageType::PixelType >::ToString();
+  const std::string movpix
+    = elx::PixelType< typename MovingImageType::PixelType >::ToString();
   xout[ "transpar" ] << "(FixedInternalImagePixelType \""
                      << fixpix << "\")" << std::endl;
   xout[ "transpar" ] << "(MovingInternalImagePixelType \""
@@ -901,11 +1058,13 @@ TransformBase< TElastix >
   paramsMap->insert( make_pair( parameterName, parameterValues ) );
   parameterValues.clear();
 
-  /** Write image pixel types. */
-  std::string fixpix = "float";
-  std::string movpix = "float";
-  this->m_Configuration->ReadParameter( fixpix, "FixedInternalImagePixelType", 0 );
-  this->m_Configuration->ReadParameter( movpix, "MovingInternalImagePixelType", 0 );
+  /** Write image pixel types. These are the types elastix ran with, also
+   * when the parameter file asked for the "native" types.
+   */
+  const std::string fixpix
+    = elx::PixelType< typename FixedImageType::PixelType >::ToString();
+  const std::string movpix
+    = elx::PixelType< typename MovingImageType::PixelType >::ToString();
 
   parameterName = "FixedInternalImagePixelType";
   parameterValues.push_back( fixpix );
@@ -1233,11 +1392,12 @@ TransformBase< TElastix >
 
   /** Apply the transform. */
   elxout << "  The input points are transformed." << std::endl;
+  if( nrofpoints > 0 )
+  {
+    this->TransformPointsMultiThreaded( &inputpointvec[ 0 ], nrofpoints, &outputpointvec[ 0 ] );
+  }
   for( unsigned int j = 0; j < nrofpoints; j++ )
   {
-    /** Call TransformPoint. */
-    outputpointvec[ j ] = this->GetAsITKBaseType()->TransformPoint( inputpointvec[ j ] );
-
     /** Transform back to index in fixed image domain. */
     dummyImage->TransformPhysicalPointToContinuousIndex(
       outputpointvec[ j ], fixedcindex );
@@ -1266,62 +1426,137 @@ TransformBase< TElastix >
   /** Create filename and file stream. */
   std::string outputPointsFileName = this->m_Configuration
     ->GetCommandLineArgument( "-out" );
+  std::string outputPointsBinaryFileName = outputPointsFileName + "outputpoints.bin";
   outputPointsFileName += "outputpoints.txt";
   std::ofstream outputPointsFile( outputPointsFileName.c_str() );
-  outputPointsFile << std::showpoint << std::fixed;
   elxout << "  The transformed points are saved in: "
          <<  outputPointsFileName << std::endl;
 
-  /** Print the results. */
+  /** Print the results. The lines are formatted into a buffer, which is
+   * written in large blocks; formatting with the stream operators is slow
+   * for millions of points. The format is that of std::fixed.
+   */
+  const std::size_t bufferFlushSize = 1 << 20;
+  std::string       buffer;
+  buffer.reserve( bufferFlushSize + 1024 );
+  char number[ 512 ];  // large enough for any double in %f format
   for( unsigned int j = 0; j < nrofpoints; j++ )
   {
     /** The input index. */
-    outputPointsFile << "Point\t" << j << "\t; InputIndex = [ ";
+    std::sprintf( number, "Point\t%u\t; InputIndex = [ ", j );
+    buffer += number;
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << inputindexvec[ j ][ i ] << " ";
+      std::sprintf( number, "%ld ", static_cast< long >( inputindexvec[ j ][ i ] ) );
+      buffer += number;
     }
 
     /** The input point. */
-    outputPointsFile << "]\t; InputPoint = [ ";
+    buffer += "]\t; InputPoint = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << inputpointvec[ j ][ i ] << " ";
+      std::sprintf( number, "%f ", static_cast< double >( inputpointvec[ j ][ i ] ) );
+      buffer += number;
     }
 
     /** The output index in fixed image. */
-    outputPointsFile << "]\t; OutputIndexFixed = [ ";
+    buffer += "]\t; OutputIndexFixed = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << outputindexfixedvec[ j ][ i ] << " ";
+      std::sprintf( number, "%ld ", static_cast< long >( outputindexfixedvec[ j ][ i ] ) );
+      buffer += number;
     }
 
     /** The output point. */
-    outputPointsFile << "]\t; OutputPoint = [ ";
+    buffer += "]\t; OutputPoint = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << outputpointvec[ j ][ i ] << " ";
+      std::sprintf( number, "%f ", static_cast< double >( outputpointvec[ j ][ i ] ) );
+      buffer += number;
     }
 
     /** The output point minus the input point. */
-    outputPointsFile << "]\t; Deformation = [ ";
+    buffer += "]\t; Deformation = [ ";
     for( unsigned int i = 0; i < MovingImageDimension; i++ )
     {
-      outputPointsFile << deformationvec[ j ][ i ] << " ";
+      std::sprintf( number, "%f ", static_cast< double >( deformationvec[ j ][ i ] ) );
+      buffer += number;
     }
 
     if( alsoMovingIndices )
     {
       /** The output index in moving image. */
-      outputPointsFile << "]\t; OutputIndexMoving = [ ";
+      buffer += "]\t; OutputIndexMoving = [ ";
       for( unsigned int i = 0; i < MovingImageDimension; i++ )
       {
-        outputPointsFile << outputindexmovingvec[ j ][ i ] << " ";
+        std::sprintf( number, "%ld ", static_cast< long >( outputindexmovingvec[ j ][ i ] ) );
+        buffer += number;
       }
     }
 
-    outputPointsFile << "]" << std::endl;
+    buffer += "]\n";
+    if( buffer.size() >= bufferFlushSize )
+    {
+      outputPointsFile.write( buffer.data(), buffer.size() );
+      buffer.clear();
+    }
   } // end for nrofpoints
+  outputPointsFile.write( buffer.data(), buffer.size() );
+  outputPointsFile.flush();
+
+  /** Possibly also write the output points to a binary point file. */
+  bool writeBinary = false;
+  this->m_Configuration->ReadParameter( writeBinary,
+    "WriteOutputPointsAsBinary", 0, false );
+  if( writeBinary )
+  {
+    std::ofstream binaryFile( outputPointsBinaryFileName.c_str(),
+      std::ios::out | std::ios::binary );
+    if( !binaryFile.is_open() )
+    {
+      xl::xout[ "error" ] << "ERROR: File \"" << outputPointsBinaryFileName
+                          << "\" could not be opened!" << std::endl;
+      return;
+    }
+    elxout << "  The transformed points are also saved in: "
+           <<  outputPointsBinaryFileName << std::endl;
+
+    /** The header, see the TransformixInputPointFileReader. */
+    char          header[ IPPReaderType::BinaryFileHeaderSize ];
+    itk::uint32_t dimension        = FixedImageDimension;
+    itk::uint32_t pointsAreIndices = 0;
+    itk::uint64_t numberOfPoints   = nrofpoints;
+    itk::ByteSwapper< itk::uint32_t >::SwapFromSystemToLittleEndian( &dimension );
+    itk::ByteSwapper< itk::uint64_t >::SwapFromSystemToLittleEndian( &numberOfPoints );
+    std::memcpy( header, IPPReaderType::GetBinaryFileMagic(), IPPReaderType::BinaryFileMagicSize );
+    std::memcpy( header + 8, &dimension, 4 );
+    std::memcpy( header + 12, &pointsAreIndices, 4 );
+    std::memcpy( header + 16, &numberOfPoints, 8 );
+    binaryFile.write( header, sizeof( header ) );
+
+    /** The output points as float32. */
+    std::vector< float > coordinates( nrofpoints * FixedImageDimension );
+    for( unsigned int j = 0; j < nrofpoints; j++ )
+    {
+      for( unsigned int i = 0; i < FixedImageDimension; i++ )
+      {
+        coordinates[ j * FixedImageDimension + i ]
+          = static_cast< float >( outputpointvec[ j ][ i ] );
+      }
+    }
+    if( !coordinates.empty() )
+    {
+      itk::ByteSwapper< float >::SwapRangeFromSystemToLittleEndian(
+        &coordinates[ 0 ], coordinates.size() );
+      binaryFile.write( reinterpret_cast< const char * >( &coordinates[ 0 ] ),
+        coordinates.size() * sizeof( float ) );
+    }
+    if( !binaryFile )
+    {
+      xl::xout[ "error" ] << "ERROR: Writing \"" << outputPointsBinaryFileName
+                          << "\" failed!" << std::endl;
+    }
+  }
 
 } // end TransformPointsSomePoints()
 
@@ -1351,8 +1586,7 @@ TransformBase< TElastix >
     DummyIPPPixelType, FixedImageDimension, MeshTraitsType > MeshType;
   typedef itk::MeshFileReader< MeshType > MeshReaderType;
   typedef itk::MeshFileWriter< MeshType > MeshWriterType;
-  typedef itk::TransformMeshFilter<
-    MeshType, MeshType, CombinationTransformType >       TransformMeshFilterType;
+  typedef typename MeshType::PointsContainer PointsContainerType;
 
   /** Read the input points. */
   typename MeshReaderType::Pointer meshReader = MeshReaderType::New();
@@ -1373,20 +1607,26 @@ TransformBase< TElastix >
   unsigned long nrofpoints = meshReader->GetOutput()->GetNumberOfPoints();
   elxout << "  Number of specified input points: " << nrofpoints << std::endl;
 
-  /** Apply the transform. */
+  /** Apply the transform. The points of the mesh are replaced in place,
+   * so that the cells and the point data need not be copied. */
   elxout << "  The input points are transformed." << std::endl;
-  typename TransformMeshFilterType::Pointer meshTransformer = TransformMeshFilterType::New();
-  meshTransformer->SetTransform(
-    const_cast< CombinationTransformType * >( this->GetAsCombinationTransform() ) );
-  meshTransformer->SetInput( meshReader->GetOutput() );
-  try
-  {
-    meshTransformer->Update();
-  }
-  catch( itk::ExceptionObject & err )
-  {
-    xl::xout[ "error" ] << "  Error while transforming points." << std::endl;
-    xl::xout[ "error" ] << err << std::endl;
+  typename MeshType::Pointer mesh = meshReader->GetOutput();
+  mesh->DisconnectPipeline();
+  PointsContainerType * points = mesh->GetPoints();
+  if( points != 0 && nrofpoints > 0 )
+  {
+    std::vector< InputPointType > inputpointvec(
+      points->CastToSTLContainer().begin(), points->CastToSTLContainer().end() );
+    try
+    {
+      this->TransformPointsMultiThreaded( &inputpointvec[ 0 ], nrofpoints,
+        &( points->CastToSTLContainer()[ 0 ] ) );
+    }
+    catch( itk::ExceptionObject & err )
+    {
+      xl::xout[ "error" ] << "  Error while transforming points." << std::endl;
+      xl::xout[ "error" ] << err << std::endl;
+    }
   }
 
   /** Create filename and file stream. */
@@ -1397,7 +1637,7 @@ TransformBase< TElastix >
          <<  outputPointsFileName << std::endl;
   typename MeshWriterType::Pointer meshWriter = MeshWriterType::New();
   meshWriter->SetFileName( outputPointsFileName.c_str() );
-  meshWriter->SetInput( meshTransformer->GetOutput() );
+  meshWriter->SetInput( mesh );
 
   try
   {
@@ -1412,6 +1652,70 @@ TransformBase< TElastix >
 } // end TransformPointsSomePointsVTK()
 
 
+/**
+ * ************** TransformPointsMultiThreaded *********************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::TransformPointsMultiThreaded( const InputPointType * inputPoints,
+  const itk::SizeValueType numberOfPoints, OutputPointType * outputPoints ) const
+{
+  TransformPointsThreaderParameterType userData;
+  userData.st_Transform      = this->GetAsITKBaseType();
+  userData.st_InputPoints    = inputPoints;
+  userData.st_OutputPoints   = outputPoints;
+  userData.st_NumberOfPoints = numberOfPoints;
+
+  /** Use a single thread for small point sets. */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::SizeValueType minimumPointsPerThread = 1000;
+  const itk::ThreadIdType  numberOfThreads        = static_cast< itk::ThreadIdType >(
+    vnl_math_max< itk::SizeValueType >( 1, vnl_math_min< itk::SizeValueType >(
+    threader->GetNumberOfThreads(), numberOfPoints / minimumPointsPerThread ) ) );
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( TransformPointsThreaderCallback, &userData );
+  threader->SingleMethodExecute();
+
+} // end TransformPointsMultiThreaded()
+
+
+/**
+ * ************** TransformPointsThreaderCallback *********************
+ */
+
+template< class TElastix >
+ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::TransformPointsThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  const itk::ThreadIdType threadId    = infoStruct->ThreadID;
+  const itk::ThreadIdType nrOfThreads = infoStruct->NumberOfThreads;
+
+  TransformPointsThreaderParameterType * userData
+    = static_cast< TransformPointsThreaderParameterType * >( infoStruct->UserData );
+
+  /** Determine the chunk of points of this thread. */
+  const itk::SizeValueType nrOfPoints = userData->st_NumberOfPoints;
+  const itk::SizeValueType chunkSize  = static_cast< itk::SizeValueType >(
+    vcl_ceil( static_cast< double >( nrOfPoints ) / static_cast< double >( nrOfThreads ) ) );
+  const itk::SizeValueType begin = vnl_math_min( threadId * chunkSize, nrOfPoints );
+  const itk::SizeValueType end   = vnl_math_min( begin + chunkSize, nrOfPoints );
+
+  if( end > begin )
+  {
+    userData->st_Transform->TransformPoints( userData->st_InputPoints + begin,
+      end - begin, userData->st_OutputPoints + begin );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TransformPointsThreaderCallback()
+
+
 /**
  * ************** TransformPointsAllPoints **********************
  *
@@ -1427,31 +1731,23 @@ TransformBase< TElastix >
 {
   /** Typedef's. */
   typedef typename FixedImageType::DirectionType FixedImageDirectionType;
-  typedef itk::Vector<
-    float, FixedImageDimension >                      VectorPixelType;
-  typedef itk::Image<
-    VectorPixelType, FixedImageDimension >            DeformationFieldImageType;
-  typedef itk::TransformToDisplacementFieldFilter<
-    DeformationFieldImageType, CoordRepType >         DeformationFieldGeneratorType;
+  typedef typename TransformOutputsSourceType
+    ::DeformationFieldImageType                       DeformationFieldImageType;
   typedef itk::ChangeInformationImageFilter<
     DeformationFieldImageType >                       ChangeInfoFilterType;
   typedef itk::ImageFileWriter<
     DeformationFieldImageType >                       DeformationFieldWriterType;
+  typedef itk::CastImageFilter<
+    DisplacementFieldType, DeformationFieldImageType > CastFilterType;
 
-  /** Create an setup deformation field generator. */
-  typename DeformationFieldGeneratorType::Pointer defGenerator
-    = DeformationFieldGeneratorType::New();
-  defGenerator->SetSize(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
-  defGenerator->SetOutputSpacing(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
-  defGenerator->SetOutputOrigin(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
-  defGenerator->SetOutputStartIndex(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
-  defGenerator->SetOutputDirection(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
-  defGenerator->SetTransform( const_cast< const ITKBaseType * >( this->GetAsITKBaseType() ) );
+  /** Check whether the deformation field used for resampling should be reused. */
+  bool reuseDeformationField = false;
+  this->m_Configuration->ReadParameter( reuseDeformationField,
+    "ResampleUsingDeformationField", 0, false );
+
+  /** Get the deformation field generator. */
+  TransformOutputsSourceType *     defGenerator = this->GetTransformOutputsSource();
+  typename CastFilterType::Pointer castFilter   = CastFilterType::New();
 
   /** Possibly change direction cosines to their original value, as specified
    * in the tp-file, or by the fixed image. This is only necessary when
@@ -1461,14 +1757,31 @@ TransformBase< TElastix >
   bool                    retdc = this->GetElastix()->GetOriginalFixedImageDirection( originalDirection );
   infoChanger->SetOutputDirection( originalDirection );
   infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
-  infoChanger->SetInput( defGenerator->GetOutput() );
+  this->GenerateTransformOutputsUsingResampler();
+  const bool computedByResampler = this->m_ResamplerDeformationField.IsNotNull();
+  if( reuseDeformationField )
+  {
+    castFilter->SetInput( this->GenerateDisplacementField() );
+    infoChanger->SetInput( castFilter->GetOutput() );
+  }
+  else if( computedByResampler )
+  {
+    infoChanger->SetInput( this->m_ResamplerDeformationField );
+  }
+  else
+  {
+    infoChanger->SetInput( defGenerator->GetDeformationFieldOutput() );
+  }
 
   /** Track the progress of the generation of the deformation field. */
 #ifndef _ELASTIX_BUILD_LIBRARY
   typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
-  progressObserver->ConnectObserver( defGenerator );
-  progressObserver->SetStartString( "  Progress: " );
-  progressObserver->SetEndString( "%" );
+  if( !reuseDeformationField && !computedByResampler )
+  {
+    progressObserver->ConnectObserver( defGenerator );
+    progressObserver->SetStartString( "  Progress: " );
+    progressObserver->SetEndString( "%" );
+  }
 #endif
 
   /** Create a name for the deformation field file. */
@@ -1478,6 +1791,13 @@ TransformBase< TElastix >
   makeFileName << this->m_Configuration->GetCommandLineArgument( "-out" )
                << "deformationField." << resultImageFormat;
 
+  /** Check if the field is stored quantized. */
+  std::string outputType = "float";
+  this->m_Configuration->ReadParameter( outputType, "DeformationFieldOutputType", 0, false );
+  typedef itk::DeformationFieldQuantizer< DeformationFieldImageType > QuantizerType;
+  typedef itk::ImageFileWriter<
+    typename QuantizerType::QuantizedImageType >                    QuantizedWriterType;
+
   /** Write outputImage to disk. */
   typename DeformationFieldWriterType::Pointer defWriter
     = DeformationFieldWriterType::New();
@@ -1488,7 +1808,18 @@ TransformBase< TElastix >
   elxout << "  Computing and writing the deformation field ..." << std::endl;
   try
   {
-    defWriter->Update();
+    if( outputType == "quantized" )
+    {
+      infoChanger->Update();
+      typename QuantizedWriterType::Pointer quantizedWriter = QuantizedWriterType::New();
+      quantizedWriter->SetInput( QuantizerType::Quantize( infoChanger->GetOutput() ) );
+      quantizedWriter->SetFileName( makeFileName.str().c_str() );
+      quantizedWriter->Update();
+    }
+    else
+    {
+      defWriter->Update();
+    }
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -1502,9 +1833,176 @@ TransformBase< TElastix >
     throw excp;
   }
 
+#ifndef _ELASTIX_BUILD_LIBRARY
+  if( !reuseDeformationField && !computedByResampler )
+  {
+    progressObserver->DisconnectObserver( defGenerator );
+  }
+#endif
+
+  /** The deformation field is written, release it. */
+  this->m_ResamplerDeformationField = NULL;
+
 } // end TransformPointsAllPoints()
 
 
+/**
+ * ************** GetTransformOutputsSource **********************
+ */
+
+template< class TElastix >
+typename TransformBase< TElastix >::TransformOutputsSourceType *
+TransformBase< TElastix >
+::GetTransformOutputsSource( void ) const
+{
+  if( this->m_TransformOutputsSource.IsNull() )
+  {
+    this->m_TransformOutputsSource = TransformOutputsSourceType::New();
+  }
+
+  /** Switch on all outputs that are requested on the command line. The
+   * deformation field is not needed when the one used for resampling is
+   * reused, see TransformPointsAllPoints(). */
+  bool reuseDeformationField = false;
+  this->m_Configuration->ReadParameter( reuseDeformationField,
+    "ResampleUsingDeformationField", 0, false );
+  const std::string def = this->m_Configuration->GetCommandLineArgument( "-def" );
+  const std::string ipp = this->m_Configuration->GetCommandLineArgument( "-ipp" );
+  const bool        defAll = ( def == "all" || ( def == "" && ipp == "all" ) );
+
+  /** Setup the source. It is only modified when the settings change. */
+  TransformOutputsSourceType * source = this->m_TransformOutputsSource;
+  source->SetComputeDeformationField( defAll && !reuseDeformationField );
+  source->SetComputeDeterminantOfSpatialJacobian(
+    this->m_Configuration->GetCommandLineArgument( "-jac" ) == "all" );
+  source->SetComputeSpatialJacobian(
+    this->m_Configuration->GetCommandLineArgument( "-jacmat" ) == "all" );
+  source->SetTransform( const_cast< const ITKBaseType * >( this->GetAsITKBaseType() ) );
+  source->SetOutputSize(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
+  source->SetOutputSpacing(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
+  source->SetOutputOrigin(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
+  source->SetOutputIndex(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
+  source->SetOutputDirection(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
+
+  return source;
+
+} // end GetTransformOutputsSource()
+
+
+/**
+ * ************** GenerateTransformOutputsUsingResampler **********************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::GenerateTransformOutputsUsingResampler( void ) const
+{
+  if( this->m_TransformOutputsUsingResamplerTried )
+  {
+    return;
+  }
+  this->m_TransformOutputsUsingResamplerTried = true;
+
+  /** Check which outputs are requested, see GetTransformOutputsSource(). */
+  bool reuseDeformationField = false;
+  this->m_Configuration->ReadParameter( reuseDeformationField,
+    "ResampleUsingDeformationField", 0, false );
+  const std::string def = this->m_Configuration->GetCommandLineArgument( "-def" );
+  const std::string ipp = this->m_Configuration->GetCommandLineArgument( "-ipp" );
+  const bool        defAll = ( def == "all" || ( def == "" && ipp == "all" ) );
+  const bool        computeDeformationField = defAll && !reuseDeformationField;
+  const bool        computeDeterminant
+    = this->m_Configuration->GetCommandLineArgument( "-jac" ) == "all";
+  if( !computeDeformationField && !computeDeterminant )
+  {
+    return;
+  }
+
+  /** Both outputs are computed in one pass, if the resampler supports it. */
+  typename TransformOutputsSourceType::DeformationFieldImageType::Pointer deformationField;
+  typename TransformOutputsSourceType::DeterminantImageType::Pointer      determinant;
+  if( this->m_Elastix->GetElxResamplerBase()->GenerateTransformOutputs(
+    computeDeformationField, computeDeterminant, deformationField, determinant ) )
+  {
+    this->m_ResamplerDeformationField             = deformationField;
+    this->m_ResamplerDeterminantOfSpatialJacobian = determinant;
+  }
+
+} // end GenerateTransformOutputsUsingResampler()
+
+
+/**
+ * ************** GenerateDisplacementField **********************
+ *
+ * This function computes the deformation field on the output grid
+ * of the resampler. The generator is kept, so the field is only
+ * recomputed when the transform or the output grid changed.
+ */
+
+template< class TElastix >
+typename TransformBase< TElastix >::DisplacementFieldType *
+TransformBase< TElastix >
+::GenerateDisplacementField( void ) const
+{
+  if( this->m_DisplacementFieldGenerator.IsNull() )
+  {
+    this->m_DisplacementFieldGenerator = DisplacementFieldGeneratorType::New();
+  }
+
+  /** Setup the generator. It is only modified when the settings change. */
+  DisplacementFieldGeneratorType * defGenerator = this->m_DisplacementFieldGenerator;
+  defGenerator->SetSize(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
+  defGenerator->SetOutputSpacing(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
+  defGenerator->SetOutputOrigin(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
+  defGenerator->SetOutputStartIndex(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
+  defGenerator->SetOutputDirection(
+    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
+  defGenerator->SetTransform( const_cast< const ITKBaseType * >( this->GetAsITKBaseType() ) );
+
+  /** Track the progress of the generation of the deformation field. */
+#ifndef _ELASTIX_BUILD_LIBRARY
+  typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
+  progressObserver->ConnectObserver( defGenerator );
+  progressObserver->SetStartString( "  Progress: " );
+  progressObserver->SetEndString( "%" );
+#endif
+
+  /** Compute the deformation field, if it is not up to date. */
+  try
+  {
+    defGenerator->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    /** Add information to the exception. */
+    excp.SetLocation( "TransformBase - GenerateDisplacementField()" );
+    std::string err_str = excp.GetDescription();
+    err_str += "\nError occurred while generating the deformation field.\n";
+    excp.SetDescription( err_str );
+
+    /** Pass the exception to an higher level. */
+    throw excp;
+  }
+
+#ifndef _ELASTIX_BUILD_LIBRARY
+  progressObserver->DisconnectObserver( defGenerator );
+#endif
+
+  return defGenerator->GetOutput();
+
+} // end GenerateDisplacementField()
+
+
 /**
  * ************** ComputeDeterminantOfSpatialJacobian **********************
  */
@@ -1533,31 +2031,17 @@ TransformBase< TElastix >
   }
 
   /** Typedef's. */
-  typedef itk::Image< float, FixedImageDimension > JacobianImageType;
-  typedef itk::TransformToDeterminantOfSpatialJacobianSource<
-    JacobianImageType, CoordRepType >                 JacobianGeneratorType;
+  typedef typename TransformOutputsSourceType
+    ::DeterminantImageType                            JacobianImageType;
   typedef itk::ImageFileWriter< JacobianImageType > JacobianWriterType;
   typedef itk::ChangeInformationImageFilter<
     JacobianImageType >                               ChangeInfoFilterType;
   typedef typename FixedImageType::DirectionType FixedImageDirectionType;
 
-  /** Create an setup Jacobian generator. */
-  typename JacobianGeneratorType::Pointer jacGenerator = JacobianGeneratorType::New();
-  jacGenerator->SetTransform( const_cast< const ITKBaseType * >(
-      this->GetAsITKBaseType() ) );
-  jacGenerator->SetOutputSize(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
-  jacGenerator->SetOutputSpacing(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
-  jacGenerator->SetOutputOrigin(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
-  jacGenerator->SetOutputIndex(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
-  jacGenerator->SetOutputDirection(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
-  // NOTE: We can not use the following, since the fixed image does not exist in transformix
-  //   jacGenerator->SetOutputParametersFromImage(
-  //     this->GetRegistration()->GetAsITKBaseType()->GetFixedImage() );
+  /** Get the Jacobian generator, which is shared with the -def and -jacmat outputs. */
+  TransformOutputsSourceType * jacGenerator = this->GetTransformOutputsSource();
+  this->GenerateTransformOutputsUsingResampler();
+  const bool computedByResampler = this->m_ResamplerDeterminantOfSpatialJacobian.IsNotNull();
 
   /** Possibly change direction cosines to their original value, as specified
    * in the tp-file, or by the fixed image. This is only necessary when
@@ -1567,13 +2051,23 @@ TransformBase< TElastix >
   bool                    retdc = this->GetElastix()->GetOriginalFixedImageDirection( originalDirection );
   infoChanger->SetOutputDirection( originalDirection );
   infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
-  infoChanger->SetInput( jacGenerator->GetOutput() );
+  if( computedByResampler )
+  {
+    infoChanger->SetInput( this->m_ResamplerDeterminantOfSpatialJacobian );
+  }
+  else
+  {
+    infoChanger->SetInput( jacGenerator->GetDeterminantOfSpatialJacobianOutput() );
+  }
 #ifndef _ELASTIX_BUILD_LIBRARY
   /** Track the progress of the generation of the deformation field. */
   typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
-  progressObserver->ConnectObserver( jacGenerator );
-  progressObserver->SetStartString( "  Progress: " );
-  progressObserver->SetEndString( "%" );
+  if( !computedByResampler )
+  {
+    progressObserver->ConnectObserver( jacGenerator );
+    progressObserver->SetStartString( "  Progress: " );
+    progressObserver->SetEndString( "%" );
+  }
 #endif
   /** Create a name for the deformation field file. */
   std::string resultImageFormat = "mhd";
@@ -1605,6 +2099,16 @@ TransformBase< TElastix >
     throw excp;
   }
 
+#ifndef _ELASTIX_BUILD_LIBRARY
+  if( !computedByResampler )
+  {
+    progressObserver->DisconnectObserver( jacGenerator );
+  }
+#endif
+
+  /** The determinant image is written, release it. */
+  this->m_ResamplerDeterminantOfSpatialJacobian = NULL;
+
 } // end ComputeDeterminantOfSpatialJacobian()
 
 
@@ -1629,13 +2133,8 @@ TransformBase< TElastix >
   }
 
   /** Typedef's. */
-  typedef float SpatialJacobianComponentType;
-  typedef itk::Matrix< SpatialJacobianComponentType,
-    MovingImageDimension, FixedImageDimension >        OutputSpatialJacobianType;
-  typedef itk::Image< OutputSpatialJacobianType,
-    FixedImageDimension >                              JacobianImageType;
-  typedef itk::TransformToSpatialJacobianSource<
-    JacobianImageType, CoordRepType >                 JacobianGeneratorType;
+  typedef typename TransformOutputsSourceType
+    ::SpatialJacobianImageType                        JacobianImageType;
   typedef itk::ImageFileWriter< JacobianImageType > JacobianWriterType;
   typedef itk::ChangeInformationImageFilter<
     JacobianImageType >                               ChangeInfoFilterType;
@@ -1643,23 +2142,8 @@ TransformBase< TElastix >
   typedef itk::PixelTypeChangeCommand<
     JacobianWriterType >                              PixelTypeChangeCommandType;
 
-  /** Create an setup Jacobian generator. */
-  typename JacobianGeneratorType::Pointer jacGenerator = JacobianGeneratorType::New();
-  jacGenerator->SetTransform( const_cast< const ITKBaseType * >(
-      this->GetAsITKBaseType() ) );
-  jacGenerator->SetOutputSize(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
-  jacGenerator->SetOutputSpacing(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
-  jacGenerator->SetOutputOrigin(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
-  jacGenerator->SetOutputIndex(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
-  jacGenerator->SetOutputDirection(
-    this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
-  // NOTE: We can not use the following, since the fixed image does not exist in transformix
-  //   jacGenerator->SetOutputParametersFromImage(
-  //     this->GetRegistration()->GetAsITKBaseType()->GetFixedImage() );
+  /** Get the Jacobian generator, which is shared with the -def and -jac outputs. */
+  TransformOutputsSourceType * jacGenerator = this->GetTransformOutputsSource();
 
   /** Possibly change direction cosines to their original value, as specified
    * in the tp-file, or by the fixed image. This is only necessary when
@@ -1670,7 +2154,7 @@ TransformBase< TElastix >
   bool                    retdc = this->GetElastix()->GetOriginalFixedImageDirection( originalDirection );
   infoChanger->SetOutputDirection( originalDirection );
   infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
-  infoChanger->SetInput( jacGenerator->GetOutput() );
+  infoChanger->SetInput( jacGenerator->GetSpatialJacobianOutput() );
 #ifndef _ELASTIX_BUILD_LIBRARY
   /** Track the progress of the generation of the deformation field. */
   typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
@@ -1715,6 +2199,10 @@ TransformBase< TElastix >
     throw excp;
   }
 
+#ifndef _ELASTIX_BUILD_LIBRARY
+  progressObserver->DisconnectObserver( jacGenerator );
+#endif
+
 } // end ComputeSpatialJacobian()
 
 
@@ -1779,14 +2267,7 @@ TransformBase< TElastix >
   typedef typename ImageSamplerType::Pointer      ImageSamplerPointer;
   typedef typename
     ImageSamplerType::ImageSampleContainerType ImageSampleContainerType;
-  typedef typename ImageSampleContainerType::Pointer       ImageSampleContainerPointer;
-  typedef typename ITKBaseType::JacobianType               JacobianType;
-  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
-
-  const ITKBaseType * const thisITK = this->GetAsITKBaseType();
-  const unsigned int        outdim  = MovingImageDimension;
-  const unsigned int        N       = thisITK->GetNumberOfParameters();
-  scales = ScalesType( N );
+  typedef typename ImageSampleContainerType::Pointer ImageSampleContainerPointer;
 
   /** Set up grid sampler. */
   ImageSamplerPointer sampler = ImageSamplerType::New();
@@ -1809,31 +2290,15 @@ TransformBase< TElastix >
     itkExceptionMacro( << "No valid voxels found to estimate the scales." );
   }
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-
-  /** initialize */
-  scales.Fill( 0.0 );
-
-  /** Read fixed coordinates and get Jacobian. */
-  for( iter = begin; iter != end; ++iter )
+  /** Read the fixed coordinates. */
+  std::vector< InputPointType > points( nrofsamples );
+  for( unsigned long i = 0; i < nrofsamples; ++i )
   {
-    const InputPointType & point = ( *iter ).Value().m_ImageCoordinates;
-    //const JacobianType & jacobian = thisITK->GetJacobian( point );
-    JacobianType jacobian; NonZeroJacobianIndicesType nzji;
-    thisITK->GetJacobian( point, jacobian, nzji );
-
-    /** Square each element of the Jacobian and add each row
-     * to the newscales.
-     */
-    for( unsigned int d = 0; d < outdim; ++d )
-    {
-      ScalesType jacd( jacobian[ d ], N, false );
-      scales += element_product( jacd, jacd );
-    }
+    points[ i ] = sampleContainer->ElementAt( i ).m_ImageCoordinates;
   }
+
+  /** Sum the squared Jacobians, and take the mean. */
+  this->ComputeSumsOfSquaredJacobiansMultiThreaded( points, scales );
   scales /= static_cast< double >( nrofsamples );
 
 } // end AutomaticScalesEstimation()
@@ -1857,18 +2322,11 @@ TransformBase< TElastix >
   typedef typename ImageSamplerType::Pointer      ImageSamplerPointer;
   typedef typename
     ImageSamplerType::ImageSampleContainerType ImageSampleContainerType;
-  typedef typename ImageSampleContainerType::Pointer       ImageSampleContainerPointer;
-  typedef typename ITKBaseType::JacobianType               JacobianType;
-  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename ImageSampleContainerType::Pointer ImageSampleContainerPointer;
 
   const ITKBaseType * const thisITK = this->GetAsITKBaseType();
-  const unsigned int        outdim  = FixedImageDimension;
   const unsigned int        N       = thisITK->GetNumberOfParameters();
 
-  /** initialize */
-  scales = ScalesType( N );
-  scales.Fill( 0.0 );
-
   /** Get fixed image region from registration. */
   const FixedImageRegionType & inputRegion = this->GetRegistration()->GetAsITKBaseType()->GetFixedImageRegion();
   SizeType                     size        = inputRegion.GetSize();
@@ -1906,27 +2364,15 @@ TransformBase< TElastix >
     itkExceptionMacro( << "No valid voxels found to estimate the scales." );
   }
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-
-  /** Read fixed coordinates and get Jacobian. */
-  JacobianType               jacobian;
-  NonZeroJacobianIndicesType nzji;
-  for( iter = begin; iter != end; ++iter )
+  /** Read the fixed coordinates. */
+  std::vector< InputPointType > points( nrofsamples );
+  for( unsigned long i = 0; i < nrofsamples; ++i )
   {
-    const InputPointType & point = ( *iter ).Value().m_ImageCoordinates;
-    //const JacobianType & jacobian = thisITK->GetJacobian( point );
-    thisITK->GetJacobian( point, jacobian, nzji );
-
-    /** Square each element of the Jacobian and add each row to the new scales. */
-    for( unsigned int d = 0; d < outdim; ++d )
-    {
-      ScalesType jacd( jacobian[ d ], N, false );
-      scales += element_product( jacd, jacd );
-    }
+    points[ i ] = sampleContainer->ElementAt( i ).m_ImageCoordinates;
   }
+
+  /** Sum the squared Jacobians, and take the mean. */
+  this->ComputeSumsOfSquaredJacobiansMultiThreaded( points, scales );
   scales /= static_cast< double >( nrofsamples );
 
   const unsigned int numberOfScalesSubTransform = N / numberOfSubTransforms; //(FixedImageDimension)*(FixedImageDimension - 1);
@@ -1942,6 +2388,112 @@ TransformBase< TElastix >
 } // end AutomaticScalesEstimationStackTransform()
 
 
+/**
+ * ************** ComputeSumsOfSquaredJacobiansMultiThreaded ***************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::ComputeSumsOfSquaredJacobiansMultiThreaded(
+  const std::vector< InputPointType > & points, ScalesType & sums ) const
+{
+  const ITKBaseType * const thisITK = this->GetAsITKBaseType();
+  const unsigned int        N       = thisITK->GetNumberOfParameters();
+
+  /** Use a single thread for small point sets. */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::SizeValueType minimumPointsPerThread = 500;
+  const itk::ThreadIdType  numberOfThreads        = static_cast< itk::ThreadIdType >(
+    vnl_math_max< itk::SizeValueType >( 1, vnl_math_min< itk::SizeValueType >(
+    threader->GetNumberOfThreads(), points.size() / minimumPointsPerThread ) ) );
+
+  SumsOfSquaredJacobiansThreaderParameterType userData;
+  userData.st_Transform = thisITK;
+  userData.st_Points    = &points;
+  userData.st_PartialSums.resize( numberOfThreads );
+
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( SumsOfSquaredJacobiansThreaderCallback, &userData );
+  threader->SingleMethodExecute();
+
+  /** Add the partial sums in the order of the threads, so that the result
+   * does not depend on the scheduling of the threads.
+   */
+  sums = ScalesType( N );
+  sums.Fill( 0.0 );
+  for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    if( userData.st_PartialSums[ t ].GetSize() == N )
+    {
+      sums += userData.st_PartialSums[ t ];
+    }
+  }
+
+} // end ComputeSumsOfSquaredJacobiansMultiThreaded()
+
+
+/**
+ * ************** SumsOfSquaredJacobiansThreaderCallback *********************
+ */
+
+template< class TElastix >
+ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::SumsOfSquaredJacobiansThreaderCallback( void * arg )
+{
+  typedef typename ITKBaseType::JacobianType               JacobianType;
+  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  const itk::ThreadIdType threadId    = infoStruct->ThreadID;
+  const itk::ThreadIdType nrOfThreads = infoStruct->NumberOfThreads;
+
+  SumsOfSquaredJacobiansThreaderParameterType * userData
+    = static_cast< SumsOfSquaredJacobiansThreaderParameterType * >( infoStruct->UserData );
+  if( threadId >= userData->st_PartialSums.size() )
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  const ITKBaseType * const transform = userData->st_Transform;
+  const unsigned int        N         = transform->GetNumberOfParameters();
+  ScalesType &              sums      = userData->st_PartialSums[ threadId ];
+  sums = ScalesType( N );
+  sums.Fill( 0.0 );
+
+  /** Determine the chunk of points of this thread. */
+  const std::vector< InputPointType > & points = *userData->st_Points;
+  const itk::SizeValueType nrOfPoints = points.size();
+  const itk::SizeValueType chunkSize  = static_cast< itk::SizeValueType >(
+    vcl_ceil( static_cast< double >( nrOfPoints ) / static_cast< double >( nrOfThreads ) ) );
+  const itk::SizeValueType begin = vnl_math_min( threadId * chunkSize, nrOfPoints );
+  const itk::SizeValueType end   = vnl_math_min( begin + chunkSize, nrOfPoints );
+
+  /** Square each element of the Jacobian and add it to the sum of its
+   * parameter. The Jacobian and the indices are reused for all points.
+   */
+  JacobianType               jacobian;
+  NonZeroJacobianIndicesType nzji;
+  for( itk::SizeValueType i = begin; i < end; ++i )
+  {
+    transform->GetJacobian( points[ i ], jacobian, nzji );
+    for( unsigned int d = 0; d < jacobian.rows(); ++d )
+    {
+      for( unsigned int j = 0; j < nzji.size(); ++j )
+      {
+        const double jac = jacobian[ d ][ j ];
+        sums[ nzji[ j ] ] += jac * jac;
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end SumsOfSquaredJacobiansThreaderCallback()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxTransformBase_hxx
@@ -41,6 +41,57 @@ Configuration::Configuration()
 } // end Constructor()
 
 
+/**
+ * ******************** PrintErrorMessage ***************************
+ */
+
+void
+Configuration
+::PrintErrorMessage( const std::string & errorMessage ) const
+{
+  /** Print a warning only once, but count how often it occurs. */
+  std::map< std::string, unsigned int >::iterator it
+    = this->m_ErrorMessageCounts.find( errorMessage );
+  if( it == this->m_ErrorMessageCounts.end() )
+  {
+    this->m_ErrorMessageCounts.insert( std::make_pair( errorMessage, 1u ) );
+    xl::xout[ "error" ] << errorMessage;
+  }
+  else
+  {
+    ++( it->second );
+  }
+
+} // end PrintErrorMessage()
+
+
+/**
+ * ******************** PrintRepeatedErrorMessages ***************************
+ */
+
+void
+Configuration
+::PrintRepeatedErrorMessages( void ) const
+{
+  std::map< std::string, unsigned int >::const_iterator it;
+  bool headerPrinted = false;
+  for( it = this->m_ErrorMessageCounts.begin(); it != this->m_ErrorMessageCounts.end(); ++it )
+  {
+    if( it->second < 2 )
+    {
+      continue;
+    }
+    if( !headerPrinted )
+    {
+      xl::xout[ "error" ] << "\nThe following warnings were given more than once:\n";
+      headerPrinted = true;
+    }
+    xl::xout[ "error" ] << "  (" << it->second << " times) " << it->first;
+  }
+
+} // end PrintRepeatedErrorMessages()
+
+
 /**
  * ******************** PrintParameterFile ***************************
  */
@@ -44,6 +44,10 @@ namespace elastix
  * example: <tt>(PrintErrorMessages "false")</tt>\n
  * Default: "true"
  *
+ * A warning, e.g. about a missing parameter, is printed only the first time
+ * it occurs. PrintRepeatedErrorMessages() reports how often each warning was
+ * repeated.
+ *
  * \ingroup Configuration
  */
 
@@ -152,7 +156,7 @@ public:
       printThisErrorMessage, errorMessage );
     if( errorMessage != "" )
     {
-      xl::xout[ "error" ] << errorMessage;
+      this->PrintErrorMessage( errorMessage );
     }
 
     return found;
@@ -169,7 +173,7 @@ public:
       parameterValue, parameterName, entry_nr, errorMessage );
     if( errorMessage != "" )
     {
-      xl::xout[ "error" ] << errorMessage;
+      this->PrintErrorMessage( errorMessage );
     }
 
     return found;
@@ -189,7 +193,7 @@ public:
       printThisErrorMessage, errorMessage );
     if( errorMessage != "" )
     {
-      xl::xout[ "error" ] << errorMessage;
+      this->PrintErrorMessage( errorMessage );
     }
 
     return found;
@@ -208,7 +212,7 @@ public:
       errorMessage );
     if( errorMessage != "" )
     {
-      xl::xout[ "error" ] << errorMessage;
+      this->PrintErrorMessage( errorMessage );
     }
 
     return found;
@@ -229,18 +233,26 @@ public:
       printThisErrorMessage, errorMessage );
     if( errorMessage != "" )
     {
-      xl::xout[ "error" ] << errorMessage;
+      this->PrintErrorMessage( errorMessage );
     }
 
     return found;
   }
 
 
+  /** Print a summary of the warnings that were given more than once while
+   * reading parameters. Only the first occurrence is printed directly.
+   */
+  void PrintRepeatedErrorMessages( void ) const;
+
 protected:
 
   Configuration();
   virtual ~Configuration() {}
 
+  /** Print a warning of ReadParameter(), if it was not printed before. */
+  void PrintErrorMessage( const std::string & errorMessage ) const;
+
   /** Print the parameter file to the log file. Called by BeforeAll().
    * This function is not really generic. It's just added because it needs to be
    * called by both BeforeAll and BeforeAllTransformix.
@@ -261,6 +273,79 @@ private:
   unsigned int m_ElastixLevel;
   unsigned int m_TotalNumberOfElastixLevels;
 
+  /** The warnings that were printed, and how often they occurred. */
+  mutable std::map< std::string, unsigned int > m_ErrorMessageCounts;
+
+};
+
+/**
+ * \class CachedParameter
+ * \brief A typed handle to a parameter, for parameters that are queried often.
+ *
+ * Get() reads the parameter with Configuration::ReadParameter() for the given
+ * entry number, usually the resolution level, and keeps the converted value.
+ * The map is only searched again when the entry number or the configuration
+ * changes. This makes it cheap to query a parameter in every iteration:
+ *
+ * \code
+ * CachedParameter< bool > m_WriteEachIteration; // member
+ * m_WriteEachIteration( "WriteResultImageAfterEachIteration", false ) // constructor
+ * if( this->m_WriteEachIteration.Get( this->m_Configuration, level ) ) ...
+ * \endcode
+ *
+ * \ingroup Configuration
+ */
+
+template< class T >
+class CachedParameter
+{
+public:
+
+  CachedParameter( const std::string & parameterName, const T & defaultValue,
+    const std::string & prefix = "", const bool printErrorMessage = false ) :
+    m_ParameterName( parameterName ),
+    m_Prefix( prefix ),
+    m_DefaultValue( defaultValue ),
+    m_Value( defaultValue ),
+    m_PrintErrorMessage( printErrorMessage ),
+    m_Configuration( 0 ),
+    m_ConfigurationMTime( 0 ),
+    m_EntryNumber( 0 )
+  {}
+
+  /** Get the value at entry_nr, or at entry 0 if it is not specified there. */
+  const T & Get( const Configuration * configuration, const unsigned int entry_nr )
+  {
+    if( configuration != this->m_Configuration
+      || configuration->GetMTime() != this->m_ConfigurationMTime
+      || entry_nr != this->m_EntryNumber )
+    {
+      this->m_Value = this->m_DefaultValue;
+      configuration->ReadParameter( this->m_Value, this->m_ParameterName,
+        this->m_Prefix, entry_nr, 0, this->m_PrintErrorMessage );
+
+      this->m_Configuration      = configuration;
+      this->m_ConfigurationMTime = configuration->GetMTime();
+      this->m_EntryNumber        = entry_nr;
+    }
+    return this->m_Value;
+  }
+
+
+  /** Forget the cached value. */
+  void Reset( void ) { this->m_Configuration = 0; }
+
+private:
+
+  std::string           m_ParameterName;
+  std::string           m_Prefix;
+  T                     m_DefaultValue;
+  T                     m_Value;
+  bool                  m_PrintErrorMessage;
+  const Configuration * m_Configuration;
+  unsigned long         m_ConfigurationMTime;
+  unsigned int          m_EntryNumber;
+
 };
 
 } // end namespace elastix
@@ -26,6 +26,7 @@
 
 #include "elxComponentDatabase.h"
 #include "xoutmain.h"
+#include "itkMutexLockHolder.h"
 
 namespace elastix
 {
@@ -127,6 +128,33 @@ ComponentDatabase::SetIndex(
 }   // end SetIndex
 
 
+/**
+ * *********************** SetInstaller *************************
+ */
+
+int
+ComponentDatabase::SetInstaller(
+  const ComponentDescriptionType & name,
+  PtrToInstaller installer )
+{
+  /** Check if this name has been registered already.
+   * If not, insert the name + installer in the map.
+   */
+  if( this->InstallerMap.count( name ) )
+  {
+    xout[ "error" ] << "Error: " << std::endl;
+    xout[ "error" ] << name << " - This component has already been installed!" << std::endl;
+    return 1;
+  }
+  else
+  {
+    this->InstallerMap.insert( InstallerMapEntryType( name, installer ) );
+    return 0;
+  }
+
+}   // end SetInstaller
+
+
 /**
  * *********************** GetCreator ***************************
  */
@@ -136,16 +164,26 @@ ComponentDatabase::GetCreator(
   const ComponentDescriptionType & name,
   IndexType i )
 {
-  /** Get the map */
-  CreatorMapType map = GetCreatorMap();
+  itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( this->m_CreatorMutex );
 
   /** Make a key with the input arguments */
   CreatorMapKeyType key( name, i );
 
-  /** Check if this key has been defined. If yes, return the 'creator'
-   * that is linked to it.
+  /** Check if this key has been defined. If not, install the creator
+   * if there is an installer for this name.
    */
-  if( map.count( key ) == 0 )    // of gewoon !map.count( key ) als boven??
+  CreatorMapType::const_iterator it = this->CreatorMap.find( key );
+  if( it == this->CreatorMap.end() )
+  {
+    InstallerMapType::const_iterator installer = this->InstallerMap.find( name );
+    if( installer != this->InstallerMap.end() && installer->second( this, i ) == 0 )
+    {
+      it = this->CreatorMap.find( key );
+    }
+  }
+
+  /** If the key has been defined, return the 'creator' that is linked to it. */
+  if( it == this->CreatorMap.end() )
   {
     xout[ "error" ] << "Error: " << std::endl;
     xout[ "error" ] << name << "(index " << i << ") - This component is not installed!" << std::endl;
@@ -153,7 +191,7 @@ ComponentDatabase::GetCreator(
   }
   else
   {
-    return map[ key ];
+    return it->second;
   }
 
 }   // end GetCreator
@@ -171,7 +209,7 @@ ComponentDatabase::GetIndex(
   ImageDimensionType movingDimension )
 {
   /** Get the map */
-  IndexMapType map = GetIndexMap();
+  const IndexMapType & map = GetIndexMap();
 
   /** Make a key with the input arguments */
   ImageTypeDescriptionType fixedImage( fixedPixelType, fixedDimension );
@@ -181,7 +219,8 @@ ComponentDatabase::GetIndex(
   /** Check if this key has been defined. If yes, return the 'index'
    * that is linked to it.
    */
-  if( map.count( key ) == 0 )
+  IndexMapType::const_iterator it = map.find( key );
+  if( it == map.end() )
   {
     xout[ "error" ] << "ERROR:\n"
                     << "  FixedImageType:  " << fixedDimension << "D " << fixedPixelType << std::endl
@@ -196,7 +235,7 @@ ComponentDatabase::GetIndex(
   }
   else
   {
-    return map[ key ];
+    return it->second;
   }
 
 }   // end GetIndex
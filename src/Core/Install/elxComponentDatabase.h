@@ -21,6 +21,7 @@
 
 #include "itkObject.h"
 #include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
 #include <iostream>
 #include <string>
 #include <utility>
@@ -45,6 +46,11 @@ namespace elastix
  * known" by calling the elxInstallMacro, which is defined in
  * elxMacro.h .
  *
+ * The creators are installed on demand: at startup each component only
+ * registers an installer function under its name. The first GetCreator()
+ * call for a name and image type index installs the creator for that
+ * combination only. GetCreator() may be called from multiple threads.
+ *
  * \sa elxInstallFunctions
  * \ingroup Install
  */
@@ -84,6 +90,15 @@ public:
     CreatorMapValueType >              CreatorMapType;
   typedef CreatorMapType::value_type CreatorMapEntryType;
 
+  /** PtrToInstaller is a pointer to a function which installs the creator
+   * of a component for index i, and returns 0 when successful.
+   */
+  typedef int (* PtrToInstaller)( ComponentDatabase *, IndexType );
+  typedef std::map<
+    ComponentDescriptionType,
+    PtrToInstaller >                   InstallerMapType;
+  typedef InstallerMapType::value_type InstallerMapEntryType;
+
   /** Typedefs for the IndexMap.*/
 
   /** The ImageTypeDescription contains the pixeltype (as a string)
@@ -125,7 +140,14 @@ public:
     ImageDimensionType movingDimension,
     IndexType i );
 
-  /** Functions to get an entry in a map */
+  /** Register the function that installs the creators of a component,
+   * see elxInstallMacro. */
+  int SetInstaller(
+    const ComponentDescriptionType & name,
+    PtrToInstaller installer );
+
+  /** Functions to get an entry in a map. GetCreator() installs the
+   * creator first, if it has not been installed yet. */
   PtrToCreator GetCreator(
     const ComponentDescriptionType & name,
     IndexType i );
@@ -141,8 +163,12 @@ protected:
   ComponentDatabase(){}
   virtual ~ComponentDatabase(){}
 
-  CreatorMapType CreatorMap;
-  IndexMapType   IndexMap;
+  CreatorMapType   CreatorMap;
+  IndexMapType     IndexMap;
+  InstallerMapType InstallerMap;
+
+  /** Guards the on demand installation in GetCreator(). */
+  itk::SimpleFastMutexLock m_CreatorMutex;
 
 private:
 
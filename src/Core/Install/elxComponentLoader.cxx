@@ -154,7 +154,7 @@ ComponentLoader::LoadComponents( const char * /** argv0 */ )
     }
   }   //end if !ImageTypeSupportInstalled
 
-  elxout << "Installing all components." << std::endl;
+  elxout << "Registering all components." << std::endl;
 
   /** Fill the component database */
   installReturnCode = InstallAllComponents( this->m_ComponentDatabase );
@@ -166,7 +166,7 @@ ComponentLoader::LoadComponents( const char * /** argv0 */ )
     return installReturnCode;
   }
 
-  elxout << "InstallingComponents was successful.\n" << std::endl;
+  elxout << "Registering the components was successful.\n" << std::endl;
 
   return 0;
 
@@ -83,10 +83,12 @@
  * not less.
  *
  * Details: a function "int _classname##InstallComponent( _cdb )" is defined.
- * In this function a template is defined, _classname##_install<VIndex>.
- * It contains the ElastixTypedef<VIndex>, and recursive function DO(cdb).
- * DO installs the component for all defined ElastixTypedefs (so for all
- * supported image types).
+ * It registers the recursive function DO(cdb, index) of the template
+ * _classname##_install<VIndex> as the installer of the component.
+ * DO installs the component for the ElastixTypedef with the given index
+ * only. The ComponentDatabase calls it when the component is first
+ * asked for with that index, so the components that are not used are
+ * never installed.
  *
  */
 #define elxInstallMacro( _classname ) \
@@ -96,13 +98,16 @@
 public: \
     typedef typename::elx::ElastixTypedef< VIndex >::ElastixType ElastixType; \
     typedef::elx::ComponentDatabase::ComponentDescriptionType    ComponentDescriptionType; \
-    static int DO( ::elx::ComponentDatabase * cdb ) \
+    static int DO( ::elx::ComponentDatabase * cdb, ::elx::ComponentDatabase::IndexType index ) \
     { \
-      ComponentDescriptionType name  = ::elx::_classname< ElastixType >::elxGetClassNameStatic(); \
-      int                      dummy = ::elx::InstallFunctions< ::elx::_classname< ElastixType > >::InstallComponent( name, VIndex, cdb ); \
+      if( index == VIndex ) \
+      { \
+        ComponentDescriptionType name = ::elx::_classname< ElastixType >::elxGetClassNameStatic(); \
+        return ::elx::InstallFunctions< ::elx::_classname< ElastixType > >::InstallComponent( name, VIndex, cdb ); \
+      } \
       if( ::elx::ElastixTypedef< VIndex + 1 >::Defined() ) \
-      { return _classname##_install< VIndex + 1 >::DO( cdb ); } \
-      return dummy;  \
+      { return _classname##_install< VIndex + 1 >::DO( cdb, index ); } \
+      return 1;  \
     } \
   }; \
   template< > \
@@ -110,14 +115,16 @@ public: \
   { \
 public: \
     typedef::elx::ComponentDatabase::ComponentDescriptionType ComponentDescriptionType; \
-    static int DO( ::elx::ComponentDatabase * /** cdb */ ) \
-    { return 0; } \
+    static int DO( ::elx::ComponentDatabase * /** cdb */, ::elx::ComponentDatabase::IndexType /** index */ ) \
+    { return 1; } \
   }; \
   extern "C" int _classname##InstallComponent( \
   ::elx::ComponentDatabase * _cdb ) \
   { \
-    int _InstallDummy##_classname = _classname##_install< 1 >::DO( _cdb  ); \
-    return _InstallDummy##_classname; \
+    typedef::elx::ElastixTypedef< 1 >::ElastixType ElastixType1; \
+    return _cdb->SetInstaller( \
+      ::elx::_classname< ElastixType1 >::elxGetClassNameStatic(), \
+      _classname##_install< 1 >::DO ); \
   } //ignore semicolon
 
 /**
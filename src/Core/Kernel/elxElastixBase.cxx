@@ -61,6 +61,10 @@ ElastixBase::ElastixBase()
 
   this->m_ResultImageContainer = DataObjectContainerType::New();
 
+  /** No fixed image pyramid cache by default. */
+  this->m_FixedImagePyramidCacheContainer = 0;
+  this->m_FixedImagePyramidCacheKey       = "";
+
   /** Initialize initialTransform and final transform. */
   this->m_InitialTransform = 0;
   this->m_FinalTransform   = 0;
@@ -346,8 +350,22 @@ ElastixBase::BeforeRegistrationBase( void )
   using namespace xl;
 
   /** Set up the "iteration" writing field. */
-  this->m_IterationInfo.SetOutputs( xout.GetCOutputs() );
-  this->m_IterationInfo.SetOutputs( xout.GetXOutputs() );
+  bool showIterationInfo = true;
+  this->GetConfiguration()->ReadParameter( showIterationInfo,
+    "ShowIterationInfo", 0, false );
+  bool writeIterationInfo = true;
+  this->GetConfiguration()->ReadParameter( writeIterationInfo,
+    "WriteIterationInfo", 0, false );
+
+  showIterationInfo &= !( xout.GetCOutputs().empty() && xout.GetXOutputs().empty() );
+  if( showIterationInfo )
+  {
+    this->m_IterationInfo.SetOutputs( xout.GetCOutputs() );
+    this->m_IterationInfo.SetOutputs( xout.GetXOutputs() );
+  }
+
+  /** Without any output the table is not composed at all. */
+  this->m_IterationInfo.SetQuiet( !showIterationInfo && !writeIterationInfo );
 
   xout.AddTargetCell( "iteration", &this->m_IterationInfo );
 
@@ -37,6 +37,7 @@
 #include "xoutmain.h"
 #include "itkVectorContainer.h"
 #include "itkImageFileReader.h"
+#include "itkImageFileCache.h"
 #include "itkChangeInformationImageFilter.h"
 
 #include <fstream>
@@ -252,6 +253,27 @@ public:
   elxGetObjectMacro( ResultImageContainer, DataObjectContainerType );
   elxSetObjectMacro( ResultImageContainer, DataObjectContainerType );
 
+  /** Set/Get the cache for the fixed image pyramid outputs, one image per
+   * level. It is kept by the caller across runs, e.g. by a registration
+   * session of the library, so that a run with the same fixed image and
+   * pyramid settings does not compute the pyramid again. The key describes
+   * the fixed image and settings of the cached outputs. Nothing is cached
+   * if no container is set, which is the default.
+   */
+  elxGetObjectMacro( FixedImagePyramidCacheContainer, DataObjectContainerType );
+  elxSetObjectMacro( FixedImagePyramidCacheContainer, DataObjectContainerType );
+  virtual void SetFixedImagePyramidCacheKey( const std::string & key )
+  {
+    this->m_FixedImagePyramidCacheKey = key;
+  }
+
+
+  virtual const std::string & GetFixedImagePyramidCacheKey( void ) const
+  {
+    return this->m_FixedImagePyramidCacheKey;
+  }
+
+
   /** Set/Get The Image FileName containers.
    * Normally, these are filled in the BeforeAllBase function.
    */
@@ -381,6 +403,10 @@ protected:
    * The useDirection option is built in as a means to ignore the direction
    * cosines. Set it to false to force the direction cosines to identity.
    * The original direction cosines are returned separately.
+   *
+   * If a cache directory is given, the images are loaded from the
+   * ImageFileCache in that directory when possible, and stored in it after
+   * reading otherwise. See the command line argument -imagecache.
    */
   template< class TImage >
   class MultipleImageLoader
@@ -394,25 +420,40 @@ public:
     typedef typename ImageType::DirectionType              DirectionType;
     typedef itk::ChangeInformationImageFilter< ImageType > ChangeInfoFilterType;
     typedef typename ChangeInfoFilterType::Pointer         ChangeInfoFilterPointer;
+    typedef itk::ImageFileCache< ImageType >               ImageFileCacheType;
 
     static DataObjectContainerPointer GenerateImageContainer(
       FileNameContainerType * fileNameContainer, const std::string & imageDescription,
-      bool useDirectionCosines, DirectionType * originalDirectionCosines = NULL )
+      bool useDirectionCosines, DirectionType * originalDirectionCosines = NULL,
+      const std::string & cacheDirectory = "" )
     {
       DataObjectContainerPointer imageContainer = DataObjectContainerType::New();
 
       /** Loop over all image filenames. */
       for( unsigned int i = 0; i < fileNameContainer->Size(); ++i )
       {
-        /** Setup reader. */
+        /** Setup reader, or take the image from the cache. */
+        const std::string  fileName    = fileNameContainer->ElementAt( i );
         ImageReaderPointer imageReader = ImageReaderType::New();
-        imageReader->SetFileName( fileNameContainer->ElementAt( i ).c_str() );
+        imageReader->SetFileName( fileName.c_str() );
+        ImagePointer cachedImage;
+        if( !cacheDirectory.empty() )
+        {
+          cachedImage = ImageFileCacheType::Load( cacheDirectory, fileName );
+        }
         ChangeInfoFilterPointer infoChanger = ChangeInfoFilterType::New();
         DirectionType           direction;
         direction.SetIdentity();
         infoChanger->SetOutputDirection( direction );
         infoChanger->SetChangeDirection( !useDirectionCosines );
-        infoChanger->SetInput( imageReader->GetOutput() );
+        if( cachedImage.IsNotNull() )
+        {
+          infoChanger->SetInput( cachedImage );
+        }
+        else
+        {
+          infoChanger->SetInput( imageReader->GetOutput() );
+        }
 
         /** Do the reading. */
         try
@@ -430,6 +471,14 @@ public:
           throw excp;
         }
 
+        /** Store the decoded image for later processes. A failure only
+         * costs the next process the time to read the file again.
+         */
+        if( !cacheDirectory.empty() && cachedImage.IsNull() )
+        {
+          ImageFileCacheType::Store( cacheDirectory, fileName, imageReader->GetOutput() );
+        }
+
         /** Store loaded image in the image container, as a DataObjectPointer. */
         ImagePointer image = infoChanger->GetOutput();
         imageContainer->CreateElementAt( i ) = image.GetPointer();
@@ -437,7 +486,8 @@ public:
         /** Store the original direction cosines */
         if( originalDirectionCosines )
         {
-          *originalDirectionCosines = imageReader->GetOutput()->GetDirection();
+          *originalDirectionCosines = cachedImage.IsNotNull()
+            ? cachedImage->GetDirection() : imageReader->GetOutput()->GetDirection();
         }
 
       } // end for i
@@ -525,6 +575,10 @@ private:
   /** The result image container. These are stored as pointers to itk::DataObject. */
   DataObjectContainerPointer m_ResultImageContainer;
 
+  /** The fixed image pyramid cache and the key of its contents. */
+  DataObjectContainerPointer m_FixedImagePyramidCacheContainer;
+  std::string                m_FixedImagePyramidCacheKey;
+
   /** The image and mask FileNameContainers. */
   FileNameContainerPointer m_FixedImageFileNameContainer;
   FileNameContainerPointer m_MovingImageFileNameContainer;
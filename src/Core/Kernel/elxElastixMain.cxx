@@ -28,9 +28,13 @@
 
 #include "elxMacro.h"
 #include "itkMultiThreader.h"
+#include "itkMutexLockHolder.h"
+#include "itkRegistrationMonitor.h"
 
 #ifdef ELASTIX_USE_OPENCL
 #include "itkOpenCLSetup.h"
+#include <algorithm>
+#include <sstream>
 #endif
 
 namespace elastix
@@ -45,16 +49,8 @@ using namespace xl;
  * by xoutSetup.
  */
 
-/** \todo move to ElastixMain class, as static vars? */
-
-/** xout TargetCells. */
-xoutbase_type   g_xout;
-xoutsimple_type g_WarningXout;
-xoutsimple_type g_ErrorXout;
-xoutsimple_type g_StandardXout;
-xoutsimple_type g_CoutOnlyXout;
-xoutsimple_type g_LogOnlyXout;
-std::ofstream   g_LogFileStream;
+/** xout TargetCells, used by xoutSetup() without an xoutManager. */
+xoutManager g_xoutManager;
 
 /**
  * ********************* xoutSetup ******************************
@@ -65,18 +61,33 @@ std::ofstream   g_LogFileStream;
 
 int
 xoutSetup( const char * logfilename, bool setupLogging, bool setupCout )
+{
+  /** The global instance is also the xout of threads without their own. */
+  xl::set_default_xout( &g_xoutManager.m_Xout );
+  return xoutSetup( g_xoutManager, logfilename, setupLogging, setupCout );
+
+} // end xoutSetup()
+
+
+/**
+ * ********************* xoutSetup ******************************
+ */
+
+int
+xoutSetup( xoutManager & manager, const char * logfilename,
+  bool setupLogging, bool setupCout )
 {
   /** The namespace of xout. */
   using namespace xl;
 
   int returndummy = 0;
-  set_xout( &g_xout );
+  set_xout( &manager.m_Xout );
 
   if( setupLogging )
   {
     /** Open the logfile for writing. */
-    g_LogFileStream.open( logfilename );
-    if( !g_LogFileStream.is_open() )
+    manager.m_LogFileStream.open( logfilename );
+    if( !manager.m_LogFileStream.is_open() )
     {
       std::cerr << "ERROR: LogFile cannot be opened!" << std::endl;
       return 1;
@@ -86,7 +97,7 @@ xoutSetup( const char * logfilename, bool setupLogging, bool setupCout )
   /** Set std::cout and the logfile as outputs of xout. */
   if( setupLogging )
   {
-    returndummy |= xout.AddOutput( "log", &g_LogFileStream );
+    returndummy |= xout.AddOutput( "log", &manager.m_LogStream );
   }
   if( setupCout )
   {
@@ -94,24 +105,24 @@ xoutSetup( const char * logfilename, bool setupLogging, bool setupCout )
   }
 
   /** Set outputs of LogOnly and CoutOnly. */
-  returndummy |= g_LogOnlyXout.AddOutput( "log", &g_LogFileStream );
-  returndummy |= g_CoutOnlyXout.AddOutput( "cout", &std::cout );
+  returndummy |= manager.m_LogOnlyXout.AddOutput( "log", &manager.m_LogStream );
+  returndummy |= manager.m_CoutOnlyXout.AddOutput( "cout", &std::cout );
 
   /** Copy the outputs to the warning-, error- and standard-xouts. */
-  g_WarningXout.SetOutputs( xout.GetCOutputs() );
-  g_ErrorXout.SetOutputs( xout.GetCOutputs() );
-  g_StandardXout.SetOutputs( xout.GetCOutputs() );
+  manager.m_WarningXout.SetOutputs( xout.GetCOutputs() );
+  manager.m_ErrorXout.SetOutputs( xout.GetCOutputs() );
+  manager.m_StandardXout.SetOutputs( xout.GetCOutputs() );
 
-  g_WarningXout.SetOutputs( xout.GetXOutputs() );
-  g_ErrorXout.SetOutputs( xout.GetXOutputs() );
-  g_StandardXout.SetOutputs( xout.GetXOutputs() );
+  manager.m_WarningXout.SetOutputs( xout.GetXOutputs() );
+  manager.m_ErrorXout.SetOutputs( xout.GetXOutputs() );
+  manager.m_StandardXout.SetOutputs( xout.GetXOutputs() );
 
   /** Link the warning-, error- and standard-xouts to xout. */
-  returndummy |= xout.AddTargetCell( "warning", &g_WarningXout );
-  returndummy |= xout.AddTargetCell( "error", &g_ErrorXout );
-  returndummy |= xout.AddTargetCell( "standard", &g_StandardXout );
-  returndummy |= xout.AddTargetCell( "logonly", &g_LogOnlyXout );
-  returndummy |= xout.AddTargetCell( "coutonly", &g_CoutOnlyXout );
+  returndummy |= xout.AddTargetCell( "warning", &manager.m_WarningXout );
+  returndummy |= xout.AddTargetCell( "error", &manager.m_ErrorXout );
+  returndummy |= xout.AddTargetCell( "standard", &manager.m_StandardXout );
+  returndummy |= xout.AddTargetCell( "logonly", &manager.m_LogOnlyXout );
+  returndummy |= xout.AddTargetCell( "coutonly", &manager.m_CoutOnlyXout );
 
   /** Format the output. */
   xout[ "standard" ] << std::fixed;
@@ -123,6 +134,23 @@ xoutSetup( const char * logfilename, bool setupLogging, bool setupCout )
 } // end xoutSetup()
 
 
+/**
+ * ********************* xoutManager ******************************
+ */
+
+xoutManager::xoutManager() :
+  m_LogFileBuffer( m_LogFileStream.rdbuf() ),
+  m_LogStream( &m_LogFileBuffer )
+{} // end Constructor
+
+
+xoutManager::~xoutManager()
+{
+  xl::unset_xout( &this->m_Xout );
+  this->m_LogFileBuffer.Flush();
+} // end Destructor
+
+
 /**
  * ********************* Constructor ****************************
  */
@@ -150,6 +178,9 @@ ElastixMain::ElastixMain()
 
   this->m_ResultImageContainer = 0;
 
+  this->m_FixedImagePyramidCacheContainer = 0;
+  this->m_FixedImagePyramidCacheKey       = "";
+
   this->m_FinalTransform   = 0;
   this->m_InitialTransform = 0;
   this->m_TransformParametersMap.clear();
@@ -163,6 +194,7 @@ ElastixMain::ElastixMain()
 
 ElastixMain::ComponentDatabasePointer ElastixMain::s_CDB             = 0;
 ElastixMain::ComponentLoaderPointer   ElastixMain::s_ComponentLoader = 0;
+itk::SimpleFastMutexLock              ElastixMain::s_CDBMutex;
 
 /**
  * ********************** Destructor ****************************
@@ -300,9 +332,40 @@ ElastixMain::Run( void )
   this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceID,
     "OpenCLDeviceID", 0, false );
 
+  /** Multiple device IDs create a multi-device context. */
+  const std::size_t numberOfOpenCLDeviceIDs
+    = this->m_Configuration->CountNumberOfParameterEntries( "OpenCLDeviceID" );
+
   std::string errorMessage              = "";
-  const bool  creatingContextSuccessful = itk::CreateOpenCLContext(
-    errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
+  bool        creatingContextSuccessful = false;
+  if( numberOfOpenCLDeviceIDs > 1 )
+  {
+    std::vector< int > userSuppliedOpenCLDeviceIDs( numberOfOpenCLDeviceIDs, -1 );
+    for( std::size_t i = 0; i < numberOfOpenCLDeviceIDs; ++i )
+    {
+      this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceIDs[ i ],
+        "OpenCLDeviceID", i, false );
+    }
+    creatingContextSuccessful = itk::CreateOpenCLContext(
+      errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceIDs );
+  }
+  else
+  {
+    creatingContextSuccessful = itk::CreateOpenCLContext(
+      errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
+  }
+
+  /** Pin this run to one device of a multi-device context. By default the
+   * devices are used round-robin by consecutive runs in this process. */
+  if( creatingContextSuccessful )
+  {
+    int userSuppliedOpenCLDeviceIndex = -1;
+    this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceIndex,
+      "OpenCLDeviceIndex", 0, false );
+    creatingContextSuccessful = itk::SelectOpenCLDevice(
+      errorMessage, userSuppliedOpenCLDeviceIndex );
+  }
+
   if( !creatingContextSuccessful )
   {
     /** Report and disable the GPU by releasing the context. */
@@ -322,6 +385,27 @@ ElastixMain::Run( void )
   this->GetElastixBase()->SetComponentDatabase( this->s_CDB );
   this->GetElastixBase()->SetDBIndex( this->m_DBIndex );
 
+  /** Pass the initial transform parameter maps as configurations, from which
+   * the transform creates its initial transform, see
+   * TransformBase::BeforeRegistrationBase().
+   */
+  if( !this->m_InitialTransformParameterMaps.empty() )
+  {
+    ArgumentMapType argmapInitialTransform;
+    argmapInitialTransform.insert( ArgumentMapType::value_type(
+      "-out", this->m_Configuration->GetCommandLineArgument( "-out" ) ) );
+
+    std::vector< ConfigurationPointer > configurations(
+      this->m_InitialTransformParameterMaps.size() );
+    for( std::size_t i = 0; i < configurations.size(); ++i )
+    {
+      configurations[ i ] = ConfigurationType::New();
+      configurations[ i ]->Initialize( argmapInitialTransform,
+        this->m_InitialTransformParameterMaps[ i ] );
+    }
+    this->GetElastixBase()->SetConfigurations( configurations );
+  }
+
   /** Populate the component containers. ImageSampler is not mandatory.
    * No defaults are specified for ImageSampler, Metric, Transform
    * and Optimizer.
@@ -378,6 +462,10 @@ ElastixMain::Run( void )
   this->GetElastixBase()->SetFixedMaskContainer( this->GetFixedMaskContainer() );
   this->GetElastixBase()->SetMovingMaskContainer( this->GetMovingMaskContainer() );
   this->GetElastixBase()->SetResultImageContainer( this->GetResultImageContainer() );
+  this->GetElastixBase()->SetFixedImagePyramidCacheContainer(
+    this->GetFixedImagePyramidCacheContainer() );
+  this->GetElastixBase()->SetFixedImagePyramidCacheKey(
+    this->m_FixedImagePyramidCacheKey );
 
   /** Set the initial transform, if it happens to be there. */
   this->GetElastixBase()->SetInitialTransform( this->GetInitialTransform() );
@@ -395,9 +483,18 @@ ElastixMain::Run( void )
   }
   catch( itk::ExceptionObject & excp1 )
   {
-    /** We just print the itk::exception and let the program quit. */
-    xl::xout[ "error" ] << excp1 << std::endl;
-    errorCode = 1;
+    /** A cancelled asynchronous registration is not an error. Otherwise,
+     * we just print the itk::exception and let the program quit. */
+    if( itk::RegistrationMonitor::IsActiveCancelRequested() )
+    {
+      elxout << "\nThe registration was cancelled." << std::endl;
+      errorCode = -3;
+    }
+    else
+    {
+      xl::xout[ "error" ] << excp1 << std::endl;
+      errorCode = 1;
+    }
   }
   catch( std::exception & excp2 )
   {
@@ -413,6 +510,16 @@ ElastixMain::Run( void )
     errorCode = 1;
   }
 
+#ifdef ELASTIX_USE_OPENCL
+  /** Report the OpenCL kernel and transfer times of this run. */
+  std::ostringstream openCLProfilingReport;
+  if( itk::WriteOpenCLProfilingReport( openCLProfilingReport, "elastix",
+    this->m_Configuration->GetCommandLineArgument( "-out" ) ) )
+  {
+    elxout << openCLProfilingReport.str() << std::endl;
+  }
+#endif
+
   /** Return the final transform. */
   this->m_FinalTransform = this->GetElastixBase()->GetFinalTransform();
 
@@ -425,6 +532,8 @@ ElastixMain::Run( void )
   this->SetFixedMaskContainer( this->GetElastixBase()->GetFixedMaskContainer() );
   this->SetMovingMaskContainer( this->GetElastixBase()->GetMovingMaskContainer() );
   this->SetResultImageContainer( this->GetElastixBase()->GetResultImageContainer() );
+  this->SetFixedImagePyramidCacheKey(
+    this->GetElastixBase()->GetFixedImagePyramidCacheKey() );
 
   /** Store the original fixed image direction cosines (relevant in case the
    * UseDirectionCosines parameter was set to false. */
@@ -635,14 +744,45 @@ ElastixMain::InitDBIndex( void )
     }
 
     /** Load the components. */
-    if( this->s_CDB.IsNull() )
+    int loadReturnCode = this->LoadComponents();
+    if( loadReturnCode != 0 )
     {
-      int loadReturnCode = this->LoadComponents();
-      if( loadReturnCode != 0 )
+      xout[ "error" ] << "Loading components failed" << std::endl;
+      return loadReturnCode;
+    }
+
+    /** Resolve the internal pixel type "native" to the pixel type of the
+     * image file. If elastix is not compiled for that combination of image
+     * types, fall back to float, the type elastix is always compiled for.
+     */
+    if( this->s_CDB.IsNotNull()
+      && ( this->m_FixedImagePixelType == "native" || this->m_MovingImagePixelType == "native" ) )
+    {
+      std::string fixedPixelType  = this->m_FixedImagePixelType;
+      std::string movingPixelType = this->m_MovingImagePixelType;
+      if( fixedPixelType == "native" )
       {
-        xout[ "error" ] << "Loading components failed" << std::endl;
-        return loadReturnCode;
+        fixedPixelType = this->GetNativePixelType( "-f" );
       }
+      if( movingPixelType == "native" )
+      {
+        movingPixelType = this->GetNativePixelType( "-m" );
+      }
+
+      const ComponentDatabase::IndexMapKeyType key(
+        ComponentDatabase::ImageTypeDescriptionType( fixedPixelType, this->m_FixedImageDimension ),
+        ComponentDatabase::ImageTypeDescriptionType( movingPixelType, this->m_MovingImageDimension ) );
+      if( this->s_CDB->GetIndexMap().count( key ) == 0 )
+      {
+        xl::xout[ "warning" ] << "WARNING: elastix is not compiled for the native pixel types ("
+                              << fixedPixelType << ", " << movingPixelType
+                              << ") of the images.\n  The native internal pixel types are replaced by float."
+                              << std::endl;
+        fixedPixelType  = this->m_FixedImagePixelType == "native" ? "float" : this->m_FixedImagePixelType;
+        movingPixelType = this->m_MovingImagePixelType == "native" ? "float" : this->m_MovingImagePixelType;
+      }
+      this->m_FixedImagePixelType  = fixedPixelType;
+      this->m_MovingImagePixelType = movingPixelType;
     }
 
     if( this->s_CDB.IsNotNull() )
@@ -731,31 +871,38 @@ ElastixMain::GetTotalNumberOfElastixLevels( void )
  * ********************* LoadComponents **************************
  *
  * Store the install function of each component in the
- * component database.
+ * component database. The database is only published in s_CDB
+ * after all components are installed, so other threads never
+ * see a partially filled database.
  */
 
 int
 ElastixMain::LoadComponents( void )
 {
-  /** Create a ComponentDatabase. */
-  if( this->s_CDB.IsNull() )
-  {
-    this->s_CDB = ComponentDatabaseType::New();
-  }
+  itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( s_CDBMutex );
 
-  /** Create a ComponentLoader and set the database. */
-  if( this->s_ComponentLoader.IsNull() )
+  /** Nothing to do if another run already loaded the components. */
+  if( this->s_CDB.IsNotNull() )
   {
-    this->s_ComponentLoader = ComponentLoaderType::New();
-    this->s_ComponentLoader->SetComponentDatabase( s_CDB );
+    return 0;
   }
 
+  /** Create a ComponentDatabase and a ComponentLoader. */
+  ComponentDatabasePointer cdb = ComponentDatabaseType::New();
+  this->s_ComponentLoader = ComponentLoaderType::New();
+  this->s_ComponentLoader->SetComponentDatabase( cdb );
+
   /** Get the current program. */
   const char * argv0
     = this->m_Configuration->GetCommandLineArgument( "-argv0" ).c_str();
 
   /** Load the components. */
-  return this->s_ComponentLoader->LoadComponents( argv0 );
+  const int loadReturnCode = this->s_ComponentLoader->LoadComponents( argv0 );
+  if( loadReturnCode == 0 )
+  {
+    this->s_CDB = cdb;
+  }
+  return loadReturnCode;
 
 } // end LoadComponents()
 
@@ -767,11 +914,13 @@ ElastixMain::LoadComponents( void )
 void
 ElastixMain::UnloadComponents( void )
 {
+  itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( s_CDBMutex );
+
   s_CDB = 0;
-  s_ComponentLoader->SetComponentDatabase( 0 );
 
   if( s_ComponentLoader )
   {
+    s_ComponentLoader->SetComponentDatabase( 0 );
     s_ComponentLoader->UnloadComponents();
   }
 
@@ -780,6 +929,32 @@ ElastixMain::UnloadComponents( void )
 } // end UnloadComponents()
 
 
+/**
+ * ************** SetInitialTransformParameterMaps ******************
+ */
+
+void
+ElastixMain::SetInitialTransformParameterMaps(
+  const std::vector< ParameterMapType > & maps )
+{
+  this->m_InitialTransformParameterMaps = maps;
+  this->Modified();
+
+} // end SetInitialTransformParameterMaps()
+
+
+/**
+ * ************** GetInitialTransformParameterMaps ******************
+ */
+
+const std::vector< ElastixMain::ParameterMapType > &
+ElastixMain::GetInitialTransformParameterMaps( void ) const
+{
+  return this->m_InitialTransformParameterMaps;
+
+} // end GetInitialTransformParameterMaps()
+
+
 /**
  * ************************* GetElastixBase ***************************
  */
@@ -1027,7 +1202,7 @@ ElastixMain::GetTransformParametersMap( void ) const
 void
 ElastixMain::GetImageInformationFromFile(
   const std::string & filename,
-  ImageDimensionType & imageDimension ) const
+  ImageDimensionType & imageDimension, std::string * pixelType ) const
 {
   if( filename != "" )
   {
@@ -1046,8 +1221,6 @@ ElastixMain::GetImageInformationFromFile(
 
     /** Extract the required information. */
     itk::ImageIOBase::Pointer testImageIO = testReader->GetImageIO();
-    //itk::ImageIOBase::IOComponentType componentType = testImageIO->GetComponentType();
-    //pixelType = itk::ImageIOBase::GetComponentTypeAsString( componentType );
     if( testImageIO.IsNull() )
     {
       /** Extra check. In principal, ITK the testreader should already have thrown an exception
@@ -1055,9 +1228,48 @@ ElastixMain::GetImageInformationFromFile(
       itkExceptionMacro( << "ERROR: ImageIO object was not created, but no exception was thrown." );
     }
     imageDimension = testImageIO->GetNumberOfDimensions();
+
+    /** ITK writes "unsigned_char", the ComponentDatabase "unsigned char". */
+    if( pixelType )
+    {
+      *pixelType = itk::ImageIOBase::GetComponentTypeAsString( testImageIO->GetComponentType() );
+      std::replace( pixelType->begin(), pixelType->end(), '_', ' ' );
+    }
   } // end if
 
 } // end GetImageInformationFromFile()
 
 
+/**
+ * ******************** GetNativePixelType ********************
+ */
+
+std::string
+ElastixMain::GetNativePixelType( const std::string & argument ) const
+{
+  std::string fileName = this->m_Configuration->GetCommandLineArgument( argument );
+  if( fileName == "" )
+  {
+    fileName = this->m_Configuration->GetCommandLineArgument( argument + "0" );
+  }
+
+  std::string        pixelType = "float";
+  ImageDimensionType dimension = 0;
+  if( fileName != "" )
+  {
+    try
+    {
+      this->GetImageInformationFromFile( fileName, dimension, &pixelType );
+    }
+    catch( itk::ExceptionObject & )
+    {
+      pixelType = "float";
+    }
+  }
+
+  return pixelType;
+
+} // end GetNativePixelType()
+
+
 } // end namespace elastix
@@ -23,6 +23,7 @@
 
 #include "elxElastixBase.h"
 #include "itkObject.h"
+#include "itkSimpleFastMutexLock.h"
 
 #include <iostream>
 #include <fstream>
@@ -54,6 +55,49 @@ namespace elastix
  */
 extern int xoutSetup( const char * logfilename, bool setupLogging, bool setupCout );
 
+/**
+ * \class xoutManager
+ * \brief The xout channels and log file of one elastix or transformix run.
+ *
+ * The xoutSetup() function above uses a global instance. Runs that execute
+ * concurrently in different threads of one process, like ElastixFilter and
+ * TransformixFilter objects, each use their own instance, so that their
+ * logs and iteration tables are kept apart. xl::xout refers to the instance
+ * of the calling thread, see xl::set_xout(). Threads without their own
+ * instance use the global one, see xl::set_default_xout(). The destructor
+ * detaches the instance from xl::xout.
+ */
+class xoutManager
+{
+public:
+
+  xoutManager();
+  ~xoutManager();
+
+  xl::xoutbase_type   m_Xout;
+  xl::xoutsimple_type m_WarningXout;
+  xl::xoutsimple_type m_ErrorXout;
+  xl::xoutsimple_type m_StandardXout;
+  xl::xoutsimple_type m_CoutOnlyXout;
+  xl::xoutsimple_type m_LogOnlyXout;
+  std::ofstream       m_LogFileStream;
+
+  /** The log file is written through m_LogStream, which batches the
+   * flushes of m_LogFileStream, see xl::xoutbuffer. */
+  xl::xoutbuffer_type m_LogFileBuffer;
+  std::ostream        m_LogStream;
+
+private:
+
+  xoutManager( const xoutManager & );     // purposely not implemented
+  void operator=( const xoutManager & );  // purposely not implemented
+};
+
+/** Configure the xout of the calling thread to use the channels of
+ * \a manager, see xoutSetup() above. */
+extern int xoutSetup( xoutManager & manager, const char * logfilename,
+  bool setupLogging, bool setupCout );
+
 /**
  * \class ElastixMain
  * \brief A class with all functionality to configure elastix.
@@ -68,12 +112,17 @@ extern int xoutSetup( const char * logfilename, bool setupLogging, bool setupCou
  * example: <tt>(MovingImageDimension 2)</tt>\n
  * \parameter FixedInternalImagePixelType: the pixel type of the internal
  * fixed image representation. The fixed image is automatically converted
- * to this type.\n
+ * to this type. With "native" the pixel type of the fixed image file is used,
+ * if elastix was compiled for it (see ELASTIX_IMAGE_3D_PIXELTYPES in CMake),
+ * and "float" otherwise. For 8 and 16 bit images this halves or quarters the
+ * memory of the full resolution images; the interpolators convert the pixel
+ * values to double on the fly.\n
  * example: <tt>(FixedInternalImagePixelType "float")</tt>\n
  * Default/recommended: "float"\n
  * \parameter MovingInternalImagePixelType: the pixel type of the internal
  * moving image representation. The moving image is automatically converted
- * to this type.\n
+ * to this type. With "native" the pixel type of the moving image file is used,
+ * see FixedInternalImagePixelType.\n
  * example: <tt>(MovingInternalImagePixelType "float")</tt>\n
  * Default/recommended: "float"\n
  *
@@ -183,6 +232,15 @@ public:
   itkSetObjectMacro( ResultImageContainer, DataObjectContainerType );
   itkGetObjectMacro( ResultImageContainer, DataObjectContainerType );
 
+  /** Set/Get the cache for the fixed image pyramid outputs and its key,
+   * see ElastixBase::SetFixedImagePyramidCacheContainer(). Pass the same
+   * container to consecutive runs to reuse the fixed image pyramid.
+   */
+  itkSetObjectMacro( FixedImagePyramidCacheContainer, DataObjectContainerType );
+  itkGetObjectMacro( FixedImagePyramidCacheContainer, DataObjectContainerType );
+  itkSetStringMacro( FixedImagePyramidCacheKey );
+  itkGetStringMacro( FixedImagePyramidCacheKey );
+
   /** Set/Get the configuration object. */
   itkSetObjectMacro( Configuration, ConfigurationType );
   itkGetObjectMacro( Configuration, ConfigurationType );
@@ -212,6 +270,18 @@ public:
   itkSetObjectMacro( InitialTransform, ObjectType );
   itkGetObjectMacro( InitialTransform, ObjectType );
 
+  /** Set/Get the initial transform as transform parameter maps, an in-memory
+   * alternative to the -t0 command line argument. Each map refers to its own
+   * initial transform by index ("InitialTransformParametersFileName" "0"),
+   * like the maps in the TransformParameterObject of ElastixFilter. The last
+   * map is the initial transform of this registration. Only used when no
+   * InitialTransform object is set. Library only.
+   */
+  virtual void SetInitialTransformParameterMaps(
+    const std::vector< ParameterMapType > & maps );
+
+  virtual const std::vector< ParameterMapType > & GetInitialTransformParameterMaps( void ) const;
+
   /** Set/Get the original fixed image direction as a flat array
    * (d11 d21 d31 d21 d22 etc ) */
   virtual void SetOriginalFixedImageDirectionFlat(
@@ -309,6 +379,9 @@ protected:
   /** A vector of configuration objects, needed when transformix is used as library. */
   std::vector< ConfigurationPointer > m_Configurations;
 
+  /** The initial transform, given as transform parameter maps. */
+  std::vector< ParameterMapType > m_InitialTransformParameterMaps;
+
   /** Description of the ImageTypes. */
   PixelTypeDescriptionType m_FixedImagePixelType;
   ImageDimensionType       m_FixedImageDimension;
@@ -323,6 +396,8 @@ protected:
   DataObjectContainerPointer m_FixedMaskContainer;
   DataObjectContainerPointer m_MovingMaskContainer;
   DataObjectContainerPointer m_ResultImageContainer;
+  DataObjectContainerPointer m_FixedImagePyramidCacheContainer;
+  std::string                m_FixedImagePyramidCacheKey;
 
   /** A transform that is the result of registration. */
   ObjectPointer m_FinalTransform;
@@ -338,6 +413,14 @@ protected:
 
   static ComponentDatabasePointer s_CDB;
   static ComponentLoaderPointer   s_ComponentLoader;
+
+  /** Serialises loading and unloading of the component database, so that
+   * several ElastixMain/TransformixMain objects may be run from different
+   * threads. Once loaded, the database is only read.
+   */
+  static itk::SimpleFastMutexLock s_CDBMutex;
+
+  /** Load the components, if not done already. Thread safe. */
   virtual int LoadComponents( void );
 
   /** InitDBIndex sets m_DBIndex by asking the ImageTypes
@@ -372,9 +455,18 @@ protected:
     int & errorcode,
     bool mandatoryComponent = true );
 
-  /** Helper function to obtain information from images on disk. */
+  /** Helper function to obtain information from images on disk. If a
+   * pixelType is given, it is set to the component type of the image, in
+   * the notation of the ComponentDatabase, for example "unsigned char".
+   */
   void GetImageInformationFromFile( const std::string & filename,
-    ImageDimensionType & imageDimension ) const;
+    ImageDimensionType & imageDimension, std::string * pixelType = NULL ) const;
+
+  /** The pixel type of the image file given by a command line argument,
+   * for example "-f", or by the same argument followed by "0".
+   * Returns "float" if the pixel type cannot be determined.
+   */
+  std::string GetNativePixelType( const std::string & argument ) const;
 
 private:
 
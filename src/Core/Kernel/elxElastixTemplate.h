@@ -37,9 +37,20 @@
 #include "elxResamplerBase.h"
 #include "elxResampleInterpolatorBase.h"
 #include "elxTransformBase.h"
+#include "elxPerformanceTrace.h"
+#include "elxStatusFile.h"
 
 #include "itkTimeProbe.h"
-
+#include "itkMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+#include "itkScaledSingleValuedNonLinearOptimizer.h"
+#include "itkTraceEventRecorder.h"
+#include "itkHardwareCounters.h"
+#include "itkRegistrationMonitor.h"
+#include "itkImageRandomSamplerBase.h"
+#include <itksys/SystemInformation.hxx>
+
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 
@@ -89,11 +100,93 @@ namespace elastix
  *    example: <tt>(WriteTransformParametersEachIteration "true")</tt>\n
  *    This parameter can not be specified for each resolution separately.
  *    Default value: "false".
+ * \parameter ShowIterationInfo: Controls whether the table with iteration
+ *    information is printed to the screen and to the log file.\n
+ *    example: <tt>(ShowIterationInfo "false")</tt>\n
+ *    When the table is neither shown nor written to a file, see
+ *    WriteIterationInfo, it is not composed at all.
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "true".
+ * \parameter WriteIterationInfo: Controls whether the table with iteration
+ *    information is written to IterationInfo.<level>.R<resolution>.txt.\n
+ *    example: <tt>(WriteIterationInfo "false")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "true".
+ * \parameter WritePerformanceTrace: Controls whether a machine readable
+ *    trace with the timings, number of samples, number of threads and memory
+ *    usage of every iteration is written to PerformanceTrace.<level>.csv,
+ *    see elx::PerformanceTrace.\n
+ *    example: <tt>(WritePerformanceTrace "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter PerformanceTraceFormat: The format of the performance trace,
+ *    "csv", or "json" for one JSON object per line, written to
+ *    PerformanceTrace.<level>.json.\n
+ *    example: <tt>(PerformanceTraceFormat "json")</tt>\n
+ *    Default value: "csv".
  * \parameter WriteTransformParametersEachResolution: Controls whether
  *    to save a transform parameter file to disk in every resolution.\n
  *    example: <tt>(WriteTransformParametersEachResolution "true")</tt>\n
  *    This parameter can not be specified for each resolution separately.
  *    Default value: "false".
+ * \parameter WriteResolutionCheckpoint: Controls whether a checkpoint is
+ *    written after each resolution but the last, to
+ *    ResolutionCheckpoint.<level>.bin, replacing the checkpoint of the previous
+ *    resolution. It holds the resolution, the transform parameters and the
+ *    state of the optimizer that carries over to the next resolutions, such as
+ *    the settings of the AdaptiveStochasticGradientDescent. An interrupted
+ *    registration is resumed from the next resolution with the command line
+ *    option <tt>-resume ResolutionCheckpoint.<level>.bin</tt> and the same
+ *    parameter files; with several parameter files, only the one of the
+ *    checkpoint is resumed.\n
+ *    example: <tt>(WriteResolutionCheckpoint "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter WriteIntermediateResultsInBackground: Controls whether the
+ *    transform parameter files and result images of each iteration and each
+ *    resolution are written by a background thread, while the registration
+ *    continues. The resampling itself is still done in the foreground. All
+ *    writes are finished before the final results are written.\n
+ *    example: <tt>(WriteIntermediateResultsInBackground "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter LowMemoryMode: Controls whether the data that is only needed
+ *    during a resolution is released after each resolution: the outputs of
+ *    the image pyramids of the finished levels, the samples of the image
+ *    samplers, the eroded masks, the B-spline coefficients of the
+ *    interpolators, and the per-thread buffers and caches of the metrics.
+ *    They are recomputed when needed, and the eroded masks are computed per
+ *    level instead of all at once. The fixed image pyramid is then not kept
+ *    for a next run either. The peak memory usage of the process is reported
+ *    after the initialization, after each resolution and at the end.\n
+ *    example: <tt>(LowMemoryMode "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter ReportMemoryUsage: Controls whether the memory accounting is
+ *    printed at the start of each resolution: the memory held by the image
+ *    pyramids, the transform parameters, the interpolators, the image samplers
+ *    and the metrics, and the memory they are expected to hold during the
+ *    resolution, such as the B-spline coefficients, the samples, the per-thread
+ *    derivatives and the joint histograms, which are allocated after that.
+ *    With WritePerformanceTrace and the json PerformanceTraceFormat, the
+ *    accounting is written to the trace as well. Independent of this
+ *    parameter, a warning is printed when the expected allocations exceed the
+ *    available physical memory.\n
+ *    example: <tt>(ReportMemoryUsage "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter ReportHardwareCounters: Controls whether the hardware counters
+ *    of the metric evaluations, the derivative accumulation, the image samplers
+ *    and the image pyramids are printed after each resolution: the instructions
+ *    per cycle, the last level cache misses per 1000 instructions and the
+ *    memory bandwidth estimated from the cache misses, which tell whether a
+ *    phase is compute-bound or memory-bound. With WritePerformanceTrace and the
+ *    json PerformanceTraceFormat, the counts of every phase and thread are
+ *    written to the trace as well; see itk::HardwareCounters. The counters are
+ *    only available on Linux, when perf_event is permitted.\n
+ *    example: <tt>(ReportHardwareCounters "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
  * \parameter UseDirectionCosines: Controls whether to use or ignore the
  * direction cosines (world matrix, transform matrix) set in the images.
  * Voxel spacing and image origin are always taken into account, regardless
@@ -106,6 +199,37 @@ namespace elastix
  *  image, which relates voxel coordinates to world coordinates. Ignoring it
  *  may easily lead to left/right swaps for example, which could skrew up a
  *  (medical) analysis.
+ * \parameter ShareImagePyramids: Controls whether the fixed image pyramid is
+ *    also used as the moving image pyramid when this gives exactly the same
+ *    result, i.e. when the fixed and moving image are the same file, as in
+ *    group-wise registration, and both pyramids are of the same type and use
+ *    the same schedules. The image is then also read only once. Only
+ *    supported by the MultiResolutionRegistration component.\n
+ *    example: <tt>(ShareImagePyramids "false")</tt>\n
+ *    Default value: "true".
+ * \parameter ReadImagesConcurrently: Controls whether the fixed image, the
+ *    moving image and the masks are read at the same time, each by its own
+ *    thread. This mostly helps for compressed images, which are decoded on
+ *    one thread.\n
+ *    example: <tt>(ReadImagesConcurrently "false")</tt>\n
+ *    Default value: "true".
+ * \parameter CropImagesToMasks: Controls whether the registration only uses
+ *    the part of the fixed and moving image around the bounding box of their
+ *    mask. The box is enlarged by the support of the pyramid smoothing and of
+ *    the interpolation at the coarsest resolution, and by MaskBoundingBoxMargin.
+ *    The image pyramids and the B-spline coefficients of the interpolator are
+ *    then computed for this part only, which saves memory and time when the
+ *    masks are small compared to the field of view. The physical coordinates
+ *    are not changed, so the transform and the result image still refer to
+ *    the whole fixed image. Only supported by the MultiResolutionRegistration
+ *    component, with one fixed and one moving image, and not with shared image
+ *    pyramids.\n
+ *    example: <tt>(CropImagesToMasks "true")</tt>\n
+ *    Default value: "false".
+ * \parameter MaskBoundingBoxMargin: The number of voxels that is added to
+ *    the enlarged bounding box of the masks on each side, see CropImagesToMasks.\n
+ *    example: <tt>(MaskBoundingBoxMargin 10)</tt>\n
+ *    Default value: 0.
  *
  * \ingroup Kernel
  */
@@ -199,6 +323,9 @@ public:
   /** Typedef's for Timer class. */
   typedef itk::TimeProbe TimerType;
 
+  /** Typedef for the transform parameters. */
+  typedef itk::Optimizer::ParametersType ParametersType;
+
   /** Typedef's for ApplyTransform.
    * \todo How useful is this? It is not consequently supported, since the
    * the input image is stored in the MovingImageContainer anyway.
@@ -303,12 +430,18 @@ public:
   /** Get the name of the current transform parameter file. */
   itkGetStringMacro( CurrentTransformParameterFileName );
 
+  /** Get the LowMemoryMode parameter, read in BeforeRegistration(). */
+  itkGetConstMacro( LowMemoryMode, bool );
+
   /** Set configuration vector. Library only. */
   virtual void SetConfigurations( std::vector< ConfigurationPointer > & configurations );
 
   /** Return configuration from vector of configurations. Library only. */
   virtual ConfigurationPointer GetConfiguration( const size_t index );
 
+  /** Return the size of the vector of configurations. Library only. */
+  virtual size_t GetNumberOfConfigurations( void ) const;
+
   virtual ConfigurationPointer GetConfiguration()
   {
     return Superclass2::GetConfiguration();
@@ -324,7 +457,7 @@ public:
 protected:
 
   ElastixTemplate();
-  virtual ~ElastixTemplate(){}
+  virtual ~ElastixTemplate();
 
   /** Classes that contain a function to load multiple images, given a filename container. */
   typedef typename Superclass2::MultipleImageLoader< FixedImageType >  FixedImageLoaderType;
@@ -342,6 +475,11 @@ protected:
   TimerType m_IterationTimer;
   TimerType m_ResolutionTimer;
 
+  /** Start times of the current resolution and iteration, for the trace
+   * events of the itk::TraceEventRecorder. */
+  double m_ResolutionTraceStart;
+  double m_IterationTraceStart;
+
   /** Store the CurrentTransformParameterFileName. */
   std::string m_CurrentTransformParameterFileName;
 
@@ -351,9 +489,81 @@ protected:
   /** Count the number of iterations. */
   unsigned int m_IterationCounter;
 
-  /** CreateTransformParameterFile. */
+  /** The WriteTransformParametersEachIteration parameter, read every iteration. */
+  CachedParameter< bool > m_WriteTransformParametersEachIteration;
+
+  /** The trace written when WritePerformanceTrace is "true". */
+  PerformanceTrace m_PerformanceTrace;
+
+  /** The status file of the command line argument -statusfile, and the
+   * MaximumNumberOfIterations of every resolution, for its ETA. */
+  StatusFile                   m_StatusFile;
+  std::vector< unsigned long > m_StatusMaximumNumberOfIterations;
+
+  /** Open the status file, if requested with -statusfile, and write the
+   * first status. The minimum interval between writes is -statusinterval
+   * seconds, default 1. */
+  virtual void OpenStatusFile( void );
+
+  /** Write the status file, if it is open. Unless force is true, it is
+   * only written when the interval since the previous write has passed. */
+  virtual void UpdateStatusFile( const std::string & state, const bool force );
+
+  /** CreateTransformParameterFile. If InBackground is true, the file is
+   * written by the itk::BackgroundWriter. */
   virtual void CreateTransformParameterFile( const std::string FileName,
-    const bool ToLog );
+    const bool ToLog, const bool InBackground = false );
+
+  /** The WriteIntermediateResultsInBackground parameter. */
+  bool m_WriteIntermediateResultsInBackground;
+
+  /** The LowMemoryMode parameter. */
+  bool m_LowMemoryMode;
+
+  /** The keys of the pyramids that are to be stored in the artifact cache,
+   * see SetupImagePyramidFileCache(). Empty if there is nothing to store. */
+  std::string m_FixedImagePyramidFileCacheKey;
+  std::string m_MovingImagePyramidFileCacheKey;
+
+  /** Release the data of the finished resolution level, see the
+   * parameter LowMemoryMode. */
+  virtual void ReleaseResolutionMemory( const unsigned int level );
+
+  /** Print the peak memory usage of the process after a stage. */
+  void PrintPeakMemoryUsage( const std::string & stage ) const;
+
+  /** The ReportMemoryUsage parameter. */
+  bool m_ReportMemoryUsage;
+
+  /** Account the memory of the components at the start of a resolution,
+   * see the parameter ReportMemoryUsage. */
+  virtual void ReportMemoryAccounting( const unsigned int level );
+
+  /** The ReportHardwareCounters parameter. */
+  bool m_ReportHardwareCounters;
+
+  /** Print the hardware counters of a finished resolution, see the
+   * parameter ReportHardwareCounters. */
+  virtual void ReportHardwareCounters( const unsigned int level );
+
+  /** The WriteResolutionCheckpoint parameter. */
+  bool m_WriteResolutionCheckpoint;
+
+  /** The checkpoint of the first resolution is written at the start of the
+   * second, when the multi-start winner is known. */
+  bool m_ResolutionCheckpointPending;
+
+  /** The number of resolutions that were restored by -resume. */
+  unsigned long m_ResumeLevel;
+
+  /** Write the checkpoint of a finished resolution, see the parameter
+   * WriteResolutionCheckpoint. */
+  virtual void WriteResolutionCheckpoint( const unsigned int level,
+    const ParametersType & parameters );
+
+  /** Read the checkpoint given by -resume, and pass it to the registration
+   * and the optimizer. */
+  virtual void ReadResolutionCheckpoint( void );
 
   /** CreateTransformParametersMap. */
   virtual void CreateTransformParametersMap( void );
@@ -369,6 +579,11 @@ protected:
 
   std::ofstream m_IterationInfoFile;
 
+  /** The iteration info file is written through this stream, which batches
+   * the flushes of the rows, see xl::xoutbuffer. */
+  xl::xoutbuffer_type m_IterationInfoFileBuffer;
+  std::ostream        m_IterationInfoFileStream;
+
   /** Used by the callback functions, BeforeEachResolution() etc.).
    * This method calls a function in each component, in the following order:
    * \li Registration
@@ -395,6 +610,85 @@ protected:
   /** Set the direction in the superclass' m_OriginalFixedImageDirection variable */
   virtual void SetOriginalFixedImageDirection( const FixedImageDirectionType & arg );
 
+  /** Returns true if the moving image file names equal the fixed image
+   * file names, so that the fixed images can be used as moving images.
+   */
+  virtual bool MovingImageFilesAreFixedImageFiles( void ) const;
+
+  /** Let the registration use the fixed image pyramid for the moving image
+   * too, if both pyramids compute the same images. See the parameter
+   * ShareImagePyramids.
+   */
+  virtual void SetupImagePyramidSharing( void );
+
+  /** Let the registration use the cached fixed image pyramid outputs of an
+   * earlier run, if the fixed image and pyramid settings are the same, see
+   * ElastixBase::SetFixedImagePyramidCacheContainer(). Otherwise the cache
+   * is emptied, and it is filled after the registration if possible.
+   */
+  virtual void SetupFixedImagePyramidCache( void );
+
+  /** Store the fixed image pyramid outputs in the cache. */
+  virtual void StoreFixedImagePyramidCache( void );
+
+  /** Let the registration use fixed and moving image pyramid outputs from
+   * the artifact cache on disk, see the command line argument -artifactcache.
+   * The outputs are found by the content of the image and the pyramid
+   * settings. Pyramids that are not found are stored after the registration,
+   * by StoreImagePyramidFileCache().
+   */
+  virtual void SetupImagePyramidFileCache( void );
+
+  virtual void StoreImagePyramidFileCache( void );
+
+  /** The key of the outputs of a pyramid for an input image, for
+   * itk::ImageFileCache::LoadWithKey(). Returns an empty string if the
+   * pyramid can not be cached.
+   */
+  template< class TImage, class TPyramid >
+  std::string CreateImagePyramidFileCacheKey( const TImage * image,
+    const TPyramid * pyramid, const char * className ) const;
+
+  /** Let the registration use the fixed and moving image cropped to the
+   * bounding box of their mask, see the parameter CropImagesToMasks.
+   */
+  virtual void SetupMaskBoundedImages( void );
+
+  /** Crop an image to the bounding box of a mask, enlarged by the support of
+   * the smoothing and the interpolation at the coarsest level of the pyramid,
+   * and by an extra margin in voxels. Returns a null pointer if the box
+   * covers the whole image.
+   */
+  template< class TImage, class TPyramid, class TMask >
+  typename TImage::Pointer CropImageToMaskBoundingBox( const TImage * image,
+    const TPyramid * pyramid, const TMask * mask,
+    const unsigned int extraMargin ) const;
+
+  /** Read the images and masks that have not been set already, see the
+   * parameter ReadImagesConcurrently.
+   */
+  virtual void ReadImages( void );
+
+  /** The images to read, and the results, for ReadImagesThreaderCallback(). */
+  struct ReadImagesTaskType
+  {
+    Self *                                m_Self;
+    bool                                  m_UseDirectionCosines;
+    std::string                           m_ImageCache;
+    bool                                  m_Read[ 4 ];
+    DataObjectContainerPointer            m_Containers[ 4 ];
+    FixedImageDirectionType               m_FixedImageDirection;
+    itk::PersistentThreadPool::WorkChunks m_WorkChunks;
+  };
+
+  /** Read the fixed image (task 0), moving image (1), fixed mask (2) and
+   * moving mask (3), as far as needed.
+   */
+  static void ReadImage( ReadImagesTaskType & task, unsigned int taskId );
+
+  /** Let the threads of the pool take the reading tasks one by one. */
+  static ITK_THREAD_RETURN_TYPE ReadImagesThreaderCallback( void * arg );
+
 private:
 
   ElastixTemplate( const Self & ); // purposely not implemented
@@ -19,6 +19,16 @@
 #define __elxElastixTemplate_hxx
 
 #include "elxElastixTemplate.h"
+#include "itkPersistentThreadPool.h"
+#include "itkImageIOFactory.h"
+#include "itkGenericMultiResolutionPyramidImageFilter.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkImageMaskSpatialObject2.h"
+#include "itkBackgroundWriter.h"
+#include "itkImageFileCache.h"
+
+#include <cstdio>
+#include <cstdlib>
 
 #define elxCheckAndSetComponentMacro( _name ) \
   _name##BaseType * base = this->GetElx##_name##Base( i ); \
@@ -46,7 +56,10 @@ using namespace xl;
 
 template< class TFixedImage, class TMovingImage >
 ElastixTemplate< TFixedImage, TMovingImage >
-::ElastixTemplate()
+::ElastixTemplate() :
+  m_WriteTransformParametersEachIteration( "WriteTransformParametersEachIteration", false ),
+  m_IterationInfoFileBuffer( m_IterationInfoFile.rdbuf() ),
+  m_IterationInfoFileStream( &m_IterationInfoFileBuffer )
 {
   /** Initialize CallBack commands. */
   this->m_BeforeEachResolutionCommand = 0;
@@ -56,10 +69,20 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->m_Timer0.Reset();
   this->m_IterationTimer.Reset();
   this->m_ResolutionTimer.Reset();
+  this->m_ResolutionTraceStart = 0.0;
+  this->m_IterationTraceStart  = 0.0;
 
   /** Initialize the this->m_IterationCounter. */
   this->m_IterationCounter = 0;
 
+  this->m_WriteIntermediateResultsInBackground = false;
+  this->m_LowMemoryMode                        = false;
+  this->m_ReportMemoryUsage                    = false;
+  this->m_ReportHardwareCounters               = false;
+  this->m_WriteResolutionCheckpoint            = false;
+  this->m_ResolutionCheckpointPending          = false;
+  this->m_ResumeLevel                          = 0;
+
   /** Initialize CurrentTransformParameterFileName. */
   this->m_CurrentTransformParameterFileName = "";
   this->m_TransformParametersMap.clear();
@@ -67,6 +90,23 @@ ElastixTemplate< TFixedImage, TMovingImage >
 } // end Constructor
 
 
+/**
+ * ********************** Destructor ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ElastixTemplate< TFixedImage, TMovingImage >
+::~ElastixTemplate()
+{
+  /** The status file is closed after a successful registration. */
+  if( this->m_StatusFile.IsOpen() )
+  {
+    this->m_StatusFile.WriteState( "aborted" );
+  }
+
+} // end Destructor
+
+
 /**
  * ********************** GetFixedImage *************************
  */
@@ -222,46 +262,7 @@ ElastixTemplate< TFixedImage, TMovingImage >
   elxout << "\nReading images..." << std::endl;
 
   /** Read images and masks, if not set already. */
-  const bool              useDirCos = this->GetUseDirectionCosines();
-  FixedImageDirectionType fixDirCos;
-  if( this->GetFixedImage() == 0 )
-  {
-    this->SetFixedImageContainer(
-      FixedImageLoaderType::GenerateImageContainer(
-      this->GetFixedImageFileNameContainer(), "Fixed Image", useDirCos, &fixDirCos ) );
-    this->SetOriginalFixedImageDirection( fixDirCos );
-  }
-  else
-  {
-    /**
-     *  images are set in elastixlib.cxx
-     *  just set direction cosines
-     *  in case images are imported for executable it does not matter
-     *  because the InfoChanger has changed these images.
-     */
-    FixedImageType * fixedIm = this->GetFixedImage( 0 );
-    fixDirCos = fixedIm->GetDirection();
-    this->SetOriginalFixedImageDirection( fixDirCos );
-  }
-
-  if( this->GetMovingImage() == 0 )
-  {
-    this->SetMovingImageContainer(
-      MovingImageLoaderType::GenerateImageContainer(
-      this->GetMovingImageFileNameContainer(), "Moving Image", useDirCos ) );
-  }
-  if( this->GetFixedMask() == 0 )
-  {
-    this->SetFixedMaskContainer(
-      FixedMaskLoaderType::GenerateImageContainer(
-      this->GetFixedMaskFileNameContainer(), "Fixed Mask", useDirCos ) );
-  }
-  if( this->GetMovingMask() == 0 )
-  {
-    this->SetMovingMaskContainer(
-      MovingMaskLoaderType::GenerateImageContainer(
-      this->GetMovingMaskFileNameContainer(), "Moving Mask", useDirCos ) );
-  }
+  this->ReadImages();
 
   /** Print the time spent on reading images. */
   this->m_Timer0.Stop();
@@ -355,12 +356,13 @@ ElastixTemplate< TFixedImage, TMovingImage >
     elxout << std::endl << "Reading input image ..." << std::endl;
 
     /** Load the image from disk, if it wasn't set already by the user. */
-    const bool useDirCos = this->GetUseDirectionCosines();
+    const bool        useDirCos  = this->GetUseDirectionCosines();
+    const std::string imageCache = this->GetConfiguration()->GetCommandLineArgument( "-imagecache" );
     if( this->GetMovingImage() == 0 )
     {
       this->SetMovingImageContainer(
         MovingImageLoaderType::GenerateImageContainer(
-        this->GetMovingImageFileNameContainer(), "Input Image", useDirCos ) );
+        this->GetMovingImageFileNameContainer(), "Input Image", useDirCos, NULL, imageCache ) );
     } // end if !moving image
 
     /** Tell the user. */
@@ -452,20 +454,12 @@ ElastixTemplate< TFixedImage, TMovingImage >
     timer.Start();
     elxout << "Resampling image and writing to disk ..." << std::endl;
 
-    /** Create a name for the final result. */
-    std::string resultImageFormat = "mhd";
-    this->GetConfiguration()->ReadParameter( resultImageFormat,
-      "ResultImageFormat", 0, false );
-    std::ostringstream makeFileName( "" );
-    makeFileName << this->GetConfiguration()->GetCommandLineArgument( "-out" )
-                 << "result." << resultImageFormat;
-
-    /** Write the resampled image to disk.
+    /** Write the resampled images to disk.
      * Actually we could loop over all resamplers.
      * But for now, there seems to be no use yet for that.
      */
 #ifndef _ELASTIX_BUILD_LIBRARY
-    this->GetElxResamplerBase()->ResampleAndWriteResultImage( makeFileName.str().c_str() );
+    this->GetElxResamplerBase()->ResampleAndWriteInputImages();
 #else
     this->GetElxResamplerBase()->CreateItkResultImage();
 #endif
@@ -476,6 +470,9 @@ ElastixTemplate< TFixedImage, TMovingImage >
            << this->ConvertSecondsToDHMS( timer.GetMean(), 2 ) << std::endl;
   }
 
+  /** Report the warnings that were suppressed after their first occurrence. */
+  this->GetConfiguration()->PrintRepeatedErrorMessages();
+
   /** Return a value. */
   return 0;
 
@@ -558,11 +555,22 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->m_Timer0.Reset();
   this->m_Timer0.Start();
 
+  /** Read the LowMemoryMode before the components need it. */
+  this->m_LowMemoryMode = false;
+  this->GetConfiguration()->ReadParameter( this->m_LowMemoryMode,
+    "LowMemoryMode", 0, false );
+
   /** Call all the BeforeRegistration() functions. */
   this->BeforeRegistrationBase();
   CallInEachComponent( &BaseComponentType::BeforeRegistrationBase );
   CallInEachComponent( &BaseComponentType::BeforeRegistration );
 
+  /** The pyramid schedules are known now. */
+  this->SetupImagePyramidSharing();
+  this->SetupMaskBoundedImages();
+  this->SetupFixedImagePyramidCache();
+  this->SetupImagePyramidFileCache();
+
   /** Add a column to iteration with the iteration number. */
   xout[ "iteration" ].AddTargetCell( "1:ItNr" );
 
@@ -570,11 +578,88 @@ ElastixTemplate< TFixedImage, TMovingImage >
   xout[ "iteration" ].AddTargetCell( "Time[ms]" );
   xout[ "iteration" ][ "Time[ms]" ] << std::showpoint << std::fixed << std::setprecision( 1 );
 
+  /** Check if the intermediate results are written in the background. */
+  this->m_WriteIntermediateResultsInBackground = false;
+  this->GetConfiguration()->ReadParameter( this->m_WriteIntermediateResultsInBackground,
+    "WriteIntermediateResultsInBackground", 0, false );
+
+  /** Check if the memory accounting is printed. */
+  this->m_ReportMemoryUsage = false;
+  this->GetConfiguration()->ReadParameter( this->m_ReportMemoryUsage,
+    "ReportMemoryUsage", 0, false );
+
+  /** Check if the hardware counters are printed. */
+  this->m_ReportHardwareCounters = false;
+  this->GetConfiguration()->ReadParameter( this->m_ReportHardwareCounters,
+    "ReportHardwareCounters", 0, false );
+  if( this->m_ReportHardwareCounters && !itk::HardwareCounters::Enable() )
+  {
+    xout[ "warning" ] << "WARNING: ReportHardwareCounters is ignored, "
+                      << "because the hardware counters are not available." << std::endl;
+    this->m_ReportHardwareCounters = false;
+  }
+  itk::HardwareCounters::GetAndClear();
+
+  /** Check if the resolution checkpoints are written, and resume from one. */
+  this->m_WriteResolutionCheckpoint = false;
+  this->GetConfiguration()->ReadParameter( this->m_WriteResolutionCheckpoint,
+    "WriteResolutionCheckpoint", 0, false );
+  this->m_ResolutionCheckpointPending = false;
+  this->ReadResolutionCheckpoint();
+
+  /** Open the performance trace, if requested. */
+  bool writePerformanceTrace = false;
+  this->GetConfiguration()->ReadParameter( writePerformanceTrace,
+    "WritePerformanceTrace", 0, false );
+  const std::string outputDirectory
+    = this->GetConfiguration()->GetCommandLineArgument( "-out" );
+  if( writePerformanceTrace && outputDirectory.empty() )
+  {
+    xout[ "warning" ] << "WARNING: WritePerformanceTrace is ignored, "
+                      << "because there is no output directory." << std::endl;
+  }
+  else if( writePerformanceTrace )
+  {
+    std::string format = "csv";
+    this->GetConfiguration()->ReadParameter( format,
+      "PerformanceTraceFormat", 0, false );
+    const bool json = ( format == "json" );
+
+    std::ostringstream makeFileName( "" );
+    makeFileName << outputDirectory
+                 << "PerformanceTrace."
+                 << this->GetConfiguration()->GetElastixLevel()
+                 << ( json ? ".json" : ".csv" );
+    const std::string fileName = makeFileName.str();
+
+    if( !this->m_PerformanceTrace.Open( fileName, json ) )
+    {
+      xout[ "error" ] << "ERROR: File \"" << fileName << "\" could not be opened!" << std::endl;
+    }
+  }
+
+  /** Open the status file, if requested. */
+  this->OpenStatusFile();
+
+  /** The trace observes the samplers, for the timings and the counters. */
+  if( this->m_PerformanceTrace.IsOpen() || this->m_ReportHardwareCounters )
+  {
+    for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+    {
+      this->m_PerformanceTrace.ObserveSampler(
+        this->GetElxImageSamplerBase( i )->GetAsITKBaseType() );
+    }
+  }
+
   /** Print time for initializing. */
   this->m_Timer0.Stop();
   elxout << "Initialization of all components (before registration) took: "
          << static_cast< unsigned long >( this->m_Timer0.GetMean() * 1000 )
          << " ms.\n";
+  if( this->m_LowMemoryMode )
+  {
+    this->PrintPeakMemoryUsage( "the initialization" );
+  }
 
   /** Start Timer0 here, to make it possible to measure the time needed for
    * preparation of the first resolution.
@@ -608,40 +693,76 @@ ElastixTemplate< TFixedImage, TMovingImage >
     this->m_Timer0.Start();
   }
 
+  /** Write the checkpoint of the first resolution, now that the
+   * registration knows the winner of the multi-start. */
+  if( this->m_ResolutionCheckpointPending )
+  {
+    this->WriteResolutionCheckpoint( level - 1,
+      this->GetElxRegistrationBase()->GetAsITKBaseType()->GetLastTransformParameters() );
+    this->m_ResolutionCheckpointPending = false;
+  }
+
   /** Reset the this->m_IterationCounter. */
   this->m_IterationCounter = 0;
 
   /** Print the current resolution. */
-  elxout << "\nResolution: " << level << std::endl;
+  const bool resumed = level < this->m_ResumeLevel;
+  elxout << "\nResolution: " << level
+         << ( resumed ? " (restored from the resolution checkpoint)" : "" ) << std::endl;
 
   /** Create a TransformParameter-file for the current resolution. */
   bool writeIterationInfo = true;
   this->GetConfiguration()->ReadParameter( writeIterationInfo,
     "WriteIterationInfo", 0, false );
-  if( writeIterationInfo )
+  if( writeIterationInfo && !resumed )
   {
     this->OpenIterationInfoFile();
   }
 
-  /** Call all the BeforeEachResolution() functions. */
+  /** Call all the BeforeEachResolution() functions. The components also
+   * set up the restored resolutions, for example the B-spline grid.
+   */
   this->BeforeEachResolutionBase();
   CallInEachComponent( &BaseComponentType::BeforeEachResolutionBase );
   CallInEachComponent( &BaseComponentType::BeforeEachResolution );
 
+  /** The registration skips the optimization of a restored resolution. */
+  if( resumed )
+  {
+    return;
+  }
+
+  /** The components are configured, but did not allocate yet. */
+  this->ReportMemoryAccounting( level );
+
   /** Print the extra preparation time needed for this resolution. */
   this->m_Timer0.Stop();
   elxout << "Elastix initialization of all components (for this resolution) took: "
          << static_cast< unsigned long >( this->m_Timer0.GetMean() * 1000 ) << " ms.\n";
 
+  /** The cost function evaluations are timed by the scaled cost function of the optimizer. */
+  if( this->m_PerformanceTrace.IsOpen() )
+  {
+    typedef itk::ScaledSingleValuedNonLinearOptimizer ScaledOptimizerType;
+    const ScaledOptimizerType * scaledOptimizer = dynamic_cast< const ScaledOptimizerType * >(
+      this->GetElxOptimizerBase()->GetAsITKBaseType() );
+    this->m_PerformanceTrace.StartResolution(
+      scaledOptimizer ? scaledOptimizer->GetScaledCostFunction() : 0 );
+  }
+
   /** Start ResolutionTimer, which measures the total iteration time in this resolution. */
   this->m_ResolutionTimer.Reset();
   this->m_ResolutionTimer.Start();
+  this->m_ResolutionTraceStart = itk::TraceEventRecorder::GetTimeStamp();
+  this->m_StatusFile.StartResolution();
+  this->UpdateStatusFile( "running", true );
 
   /** Start IterationTimer here, to make it possible to measure the time
    * of the first iteration.
    */
   this->m_IterationTimer.Reset();
   this->m_IterationTimer.Start();
+  this->m_IterationTraceStart = itk::TraceEventRecorder::GetTimeStamp();
 
 } // end BeforeEachResolution()
 
@@ -659,6 +780,15 @@ ElastixTemplate< TFixedImage, TMovingImage >
   unsigned long level
     = this->GetElxRegistrationBase()->GetAsITKBaseType()->GetCurrentLevel();
 
+  if( itk::TraceEventRecorder::IsEnabled() )
+  {
+    std::ostringstream makeEventName( "" );
+    makeEventName << "Resolution " << level;
+    itk::TraceEventRecorder::AddCompleteEvent( makeEventName.str(), "registration",
+      this->m_ResolutionTraceStart,
+      itk::TraceEventRecorder::GetTimeStamp() - this->m_ResolutionTraceStart );
+  }
+
   /** Print the total iteration time. */
   elxout << std::setprecision( 3 );
   this->m_ResolutionTimer.Stop();
@@ -670,6 +800,11 @@ ElastixTemplate< TFixedImage, TMovingImage >
     << " s.\n";
   elxout << std::setprecision( this->GetDefaultOutputPrecision() );
 
+  if( this->m_ReportHardwareCounters )
+  {
+    this->ReportHardwareCounters( level );
+  }
+
   /** Call all the AfterEachResolution() functions. */
   this->AfterEachResolutionBase();
   CallInEachComponent( &BaseComponentType::AfterEachResolutionBase );
@@ -690,8 +825,38 @@ ElastixTemplate< TFixedImage, TMovingImage >
                  << ".txt";
     std::string fileName = makeFileName.str();
 
-    /** Create a TransformParameterFile for this iteration. */
-    this->CreateTransformParameterFile( fileName, false );
+    /** Create a TransformParameterFile for this resolution. */
+    this->CreateTransformParameterFile( fileName, false,
+      this->m_WriteIntermediateResultsInBackground );
+  }
+
+  /** Write the checkpoint of this resolution, if it is not the last. With a
+   * multi-start, the optimizer ends once for every candidate, so the
+   * checkpoint of the first resolution waits for the winner.
+   */
+  typedef typename RegistrationBaseType::ITKBaseType ITKRegistrationType;
+  const ITKRegistrationType * registration
+    = this->GetElxRegistrationBase()->GetAsITKBaseType();
+  if( this->m_WriteResolutionCheckpoint && level + 1 < registration->GetNumberOfLevels() )
+  {
+    if( level == 0 && registration->GetMultiStartInitialTransformParameters().Size() > 0 )
+    {
+      this->m_ResolutionCheckpointPending = true;
+    }
+    else
+    {
+      this->WriteResolutionCheckpoint( level,
+        this->GetElxOptimizerBase()->GetAsITKBaseType()->GetCurrentPosition() );
+    }
+  }
+
+  /** Release the data of this resolution. */
+  if( this->m_LowMemoryMode )
+  {
+    std::ostringstream makeStageName( "" );
+    makeStageName << "resolution " << level;
+    this->PrintPeakMemoryUsage( makeStageName.str() );
+    this->ReleaseResolutionMemory( level );
   }
 
   /** Start Timer0 here, to make it possible to measure the time needed for:
@@ -730,15 +895,38 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** Time in this iteration. */
   this->m_IterationTimer.Stop();
   xout[ "iteration" ][ "Time[ms]" ] << this->m_IterationTimer.GetMean() * 1000.0;
+  if( itk::TraceEventRecorder::IsEnabled() )
+  {
+    itk::TraceEventRecorder::AddCompleteEvent( "Iteration", "registration",
+      this->m_IterationTraceStart,
+      itk::TraceEventRecorder::GetTimeStamp() - this->m_IterationTraceStart );
+  }
 
   /** Write the iteration info of this iteration. */
-  xout[ "iteration" ].WriteBufferedData();
+  TimerType logTimer;
+  logTimer.Start();
+  {
+    itk::TraceEventScope traceScope( "WriteIterationInfo", "log" );
+    xout[ "iteration" ].WriteBufferedData();
+  }
+  logTimer.Stop();
+
+  /** Write the performance record of this iteration. */
+  if( this->m_PerformanceTrace.IsOpen() )
+  {
+    unsigned long numberOfSamples = 0;
+    for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+    {
+      numberOfSamples += this->GetElxImageSamplerBase( i )->GetAsITKBaseType()->GetOutput()->Size();
+    }
+    this->m_PerformanceTrace.WriteIteration(
+      this->GetElxRegistrationBase()->GetAsITKBaseType()->GetCurrentLevel(),
+      this->m_IterationCounter, this->m_IterationTimer.GetMean(),
+      logTimer.GetMean(), numberOfSamples );
+  }
 
   /** Create a TransformParameter-file for the current iteration. */
-  bool writeTansformParametersThisIteration = false;
-  this->GetConfiguration()->ReadParameter( writeTansformParametersThisIteration,
-    "WriteTransformParametersEachIteration", 0, false );
-  if( writeTansformParametersThisIteration )
+  if( this->m_WriteTransformParametersEachIteration.Get( this->GetConfiguration(), 0 ) )
   {
     /** Add zeros to the number of iterations, to make sure
      * it always consists of 7 digits.
@@ -773,15 +961,47 @@ ElastixTemplate< TFixedImage, TMovingImage >
     std::string tpFileName = makeFileName.str();
 
     /** Create a TransformParameterFile for this iteration. */
-    this->CreateTransformParameterFile( tpFileName, false );
+    this->CreateTransformParameterFile( tpFileName, false,
+      this->m_WriteIntermediateResultsInBackground );
+  }
+
+  /** Report the progress to the monitor of an asynchronous registration,
+   * and stop if it asks to cancel. */
+  itk::RegistrationMonitor * monitor = itk::RegistrationMonitor::GetActiveMonitor();
+  if( monitor )
+  {
+    typedef itk::ScaledSingleValuedNonLinearOptimizer ScaledOptimizerType;
+    const ScaledOptimizerType * scaledOptimizer = dynamic_cast< const ScaledOptimizerType * >(
+      this->GetElxOptimizerBase()->GetAsITKBaseType() );
+
+    itk::RegistrationMonitor::ProgressType progress;
+    progress.m_ElastixLevel          = this->GetConfiguration()->GetElastixLevel();
+    progress.m_NumberOfElastixLevels = this->GetConfiguration()->GetTotalNumberOfElastixLevels();
+    progress.m_Resolution            = static_cast< unsigned int >(
+      this->GetElxRegistrationBase()->GetAsITKBaseType()->GetCurrentLevel() );
+    progress.m_NumberOfResolutions = static_cast< unsigned int >(
+      this->GetElxRegistrationBase()->GetAsITKBaseType()->GetNumberOfLevels() );
+    progress.m_Iteration   = this->m_IterationCounter;
+    progress.m_MetricValue = scaledOptimizer
+      ? scaledOptimizer->GetScaledCostFunction()->GetLastValue() : 0.0;
+    monitor->SetProgress( progress );
+
+    if( monitor->GetCancelRequested() )
+    {
+      itk::ProcessAborted excp( __FILE__, __LINE__ );
+      excp.SetDescription( "The registration was cancelled." );
+      throw excp;
+    }
   }
 
   /** Count the number of iterations. */
   this->m_IterationCounter++;
+  this->UpdateStatusFile( "running", false );
 
   /** Start timer for next iteration. */
   this->m_IterationTimer.Reset();
   this->m_IterationTimer.Start();
+  this->m_IterationTraceStart = itk::TraceEventRecorder::GetTimeStamp();
 
 } // end AfterEachIteration()
 
@@ -801,6 +1021,24 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** A white line. */
   elxout << std::endl;
 
+  /** Keep the image pyramids for a next run, if requested. The file cache
+   * goes first, because the memory cache takes the outputs out of the
+   * pyramid. */
+  this->StoreImagePyramidFileCache();
+  this->StoreFixedImagePyramidCache();
+
+  /** Finish the intermediate results that are written in the background. */
+  if( this->m_WriteIntermediateResultsInBackground )
+  {
+    const std::vector< std::string > errorMessages
+      = itk::BackgroundWriter::GetGlobalBackgroundWriter()->WaitForAllTasks();
+    for( std::size_t i = 0; i < errorMessages.size(); ++i )
+    {
+      xout[ "error" ] << "ERROR: writing an intermediate result failed:\n"
+                      << errorMessages[ i ] << std::endl;
+    }
+  }
+
   /** Create the final TransformParameters filename. */
   bool writeFinalTansformParameters = true;
   this->GetConfiguration()->ReadParameter( writeFinalTansformParameters,
@@ -837,20 +1075,141 @@ ElastixTemplate< TFixedImage, TMovingImage >
   elxout << "Time spent on saving the results, applying the final transform etc.: "
          << static_cast< unsigned long >( this->m_Timer0.GetMean() * 1000 ) << " ms.\n";
 
+  if( this->m_LowMemoryMode )
+  {
+    this->PrintPeakMemoryUsage( "the registration" );
+  }
+
+  /** Report the warnings that were suppressed after their first occurrence. */
+  this->GetConfiguration()->PrintRepeatedErrorMessages();
+
+  if( this->m_ReportHardwareCounters )
+  {
+    itk::HardwareCounters::Disable();
+    itk::HardwareCounters::GetAndClear();
+  }
+  this->m_PerformanceTrace.Close();
+
+  /** The run is finished after the last parameter file. */
+  const bool lastElastixLevel = this->GetConfiguration()->GetElastixLevel() + 1
+    >= this->GetConfiguration()->GetTotalNumberOfElastixLevels();
+  this->UpdateStatusFile( lastElastixLevel ? "finished" : "running", true );
+  this->m_StatusFile.Close();
+
 } // end AfterRegistration()
 
 
+/**
+ * ****************** OpenStatusFile ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::OpenStatusFile( void )
+{
+  const std::string fileName
+    = this->GetConfiguration()->GetCommandLineArgument( "-statusfile" );
+  if( fileName.empty() )
+  {
+    return;
+  }
+
+  double            interval         = 1.0;
+  const std::string intervalArgument
+    = this->GetConfiguration()->GetCommandLineArgument( "-statusinterval" );
+  if( !intervalArgument.empty() )
+  {
+    interval = atof( intervalArgument.c_str() );
+  }
+
+  if( !this->m_StatusFile.Open( fileName, interval ) )
+  {
+    xout[ "warning" ] << "WARNING: the status file \"" << fileName
+                      << "\" could not be written." << std::endl;
+    return;
+  }
+
+  /** The MaximumNumberOfIterations of every resolution, 0 if not given. */
+  const unsigned int numberOfLevels = static_cast< unsigned int >(
+    this->GetElxRegistrationBase()->GetAsITKBaseType()->GetNumberOfLevels() );
+  this->m_StatusMaximumNumberOfIterations.assign( numberOfLevels, 0 );
+  for( unsigned int level = 0; level < numberOfLevels; ++level )
+  {
+    this->GetConfiguration()->ReadParameter( this->m_StatusMaximumNumberOfIterations[ level ],
+      "MaximumNumberOfIterations", this->GetElxOptimizerBase()->GetComponentLabel(),
+      level, 0, false );
+  }
+
+  this->UpdateStatusFile( "initializing", true );
+
+} // end OpenStatusFile()
+
+
+/**
+ * ****************** UpdateStatusFile ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::UpdateStatusFile( const std::string & state, const bool force )
+{
+  if( !this->m_StatusFile.IsOpen() || ( !force && !this->m_StatusFile.IsDue() ) )
+  {
+    return;
+  }
+
+  typedef itk::ScaledSingleValuedNonLinearOptimizer ScaledOptimizerType;
+  const ScaledOptimizerType * scaledOptimizer = dynamic_cast< const ScaledOptimizerType * >(
+    this->GetElxOptimizerBase()->GetAsITKBaseType() );
+  const unsigned int level = static_cast< unsigned int >(
+    this->GetElxRegistrationBase()->GetAsITKBaseType()->GetCurrentLevel() );
+
+  StatusFile::StatusType status;
+  status.m_State                                      = state;
+  status.m_ElastixLevel                               = this->GetConfiguration()->GetElastixLevel();
+  status.m_NumberOfElastixLevels                      = this->GetConfiguration()->GetTotalNumberOfElastixLevels();
+  status.m_Resolution                                 = level;
+  status.m_NumberOfResolutions                        = static_cast< unsigned int >(
+    this->m_StatusMaximumNumberOfIterations.size() );
+  status.m_Iteration                                  = this->m_IterationCounter;
+  status.m_MaximumNumberOfIterations                  = 0;
+  status.m_MaximumNumberOfIterationsOfLaterResolutions = 0;
+  for( unsigned int i = level; i < this->m_StatusMaximumNumberOfIterations.size(); ++i )
+  {
+    if( i == level )
+    {
+      status.m_MaximumNumberOfIterations = this->m_StatusMaximumNumberOfIterations[ i ];
+    }
+    else
+    {
+      status.m_MaximumNumberOfIterationsOfLaterResolutions
+        += this->m_StatusMaximumNumberOfIterations[ i ];
+    }
+  }
+  status.m_MetricValue = ( scaledOptimizer && scaledOptimizer->GetScaledCostFunction() )
+    ? scaledOptimizer->GetScaledCostFunction()->GetLastValue() : 0.0;
+
+  this->m_StatusFile.Write( status );
+
+} // end UpdateStatusFile()
+
+
 /**
  * ************** CreateTransformParameterFile ******************
  *
  * Setup the xout transform parameter file, which will
- * contain the final transform parameters.
+ * contain the final transform parameters. In the background
+ * the file is composed in memory, and written by the
+ * itk::BackgroundWriter.
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 ElastixTemplate< TFixedImage, TMovingImage >
-::CreateTransformParameterFile( const std::string fileName, const bool toLog )
+::CreateTransformParameterFile( const std::string fileName, const bool toLog,
+  const bool inBackground )
 {
   using namespace xl;
 
@@ -858,8 +1217,9 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->m_CurrentTransformParameterFileName = fileName;
 
   /** Create transformParameterFile and xout["transpar"]. */
-  xoutsimple_type transformationParameterInfo;
-  std::ofstream   transformParameterFile;
+  xoutsimple_type    transformationParameterInfo;
+  std::ofstream      transformParameterFile;
+  std::ostringstream transformParameterText;
 
   /** Set up the "TransformationParameters" writing field. */
   transformationParameterInfo.SetOutputs( xout.GetCOutputs() );
@@ -871,15 +1231,25 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->GetElxTransformBase()->SetTransformParametersFileName( fileName.c_str() );
 
   /** Open the TransformParameter file. */
-  transformParameterFile.open( fileName.c_str() );
-  if( !transformParameterFile.is_open() )
+  if( !inBackground )
   {
-    xout[ "error" ] << "ERROR: File \"" << fileName << "\" could not be opened!" << std::endl;
+    transformParameterFile.open( fileName.c_str() );
+    if( !transformParameterFile.is_open() )
+    {
+      xout[ "error" ] << "ERROR: File \"" << fileName << "\" could not be opened!" << std::endl;
+    }
   }
 
   /** This xout["transpar"] writes to the log and to the TransformParameter file. */
   transformationParameterInfo.RemoveOutput( "cout" );
-  transformationParameterInfo.AddOutput( "tpf", &transformParameterFile );
+  if( inBackground )
+  {
+    transformationParameterInfo.AddOutput( "tpf", &transformParameterText );
+  }
+  else
+  {
+    transformationParameterInfo.AddOutput( "tpf", &transformParameterFile );
+  }
   if( !toLog )
   {
     transformationParameterInfo.RemoveOutput( "log" );
@@ -916,6 +1286,13 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** Remove the "transpar" writing field. */
   xout.RemoveTargetCell( "transpar" );
 
+  /** Hand the composed file to the background writer. */
+  if( inBackground )
+  {
+    itk::BackgroundWriter::GetGlobalBackgroundWriter()->Submit(
+      new itk::BackgroundWriter::TextFileTask( fileName, transformParameterText.str() ) );
+  }
+
 } // end CreateTransformParameterFile()
 
 
@@ -954,142 +1331,1434 @@ ElastixTemplate< TFixedImage, TMovingImage >
 
 
 /**
- * ****************** CallInEachComponent ***********************
+ * ************** MovingImageFilesAreFixedImageFiles ****************
  */
 
 template< class TFixedImage, class TMovingImage >
-void
+bool
 ElastixTemplate< TFixedImage, TMovingImage >
-::CallInEachComponent( PtrToMemberFunction func )
+::MovingImageFilesAreFixedImageFiles( void ) const
 {
-  /** Call the memberfunction 'func' of all components. */
-  ( ( *( this->GetConfiguration() ) ).*func )();
-
-  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
-  {
-    ( ( *( this->GetElxRegistrationBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
-  {
-    ( ( *( this->GetElxTransformBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
-  {
-    ( ( *( this->GetElxImageSamplerBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
-  {
-    ( ( *( this->GetElxMetricBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
-  {
-    ( ( *( this->GetElxInterpolatorBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfOptimizers(); ++i )
-  {
-    ( ( *( this->GetElxOptimizerBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
-  {
-    ( ( *( this->GetElxFixedImagePyramidBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
-  {
-    ( ( *( this->GetElxMovingImagePyramidBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfResampleInterpolators(); ++i )
+  const FileNameContainerType * fixedFileNames  = this->GetFixedImageFileNameContainer();
+  const FileNameContainerType * movingFileNames = this->GetMovingImageFileNameContainer();
+  if( fixedFileNames == 0 || movingFileNames == 0
+    || fixedFileNames->Size() == 0
+    || fixedFileNames->Size() != movingFileNames->Size()
+    || this->GetNumberOfFixedImages() != fixedFileNames->Size() )
   {
-    ( ( *( this->GetElxResampleInterpolatorBase( i ) ) ).*func )();
+    return false;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfResamplers(); ++i )
+
+  for( unsigned int i = 0; i < fixedFileNames->Size(); ++i )
   {
-    ( ( *( this->GetElxResamplerBase( i ) ) ).*func )();
+    if( fixedFileNames->ElementAt( i ) != movingFileNames->ElementAt( i ) )
+    {
+      return false;
+    }
   }
+  return true;
 
-} // end CallInEachComponent()
+} // end MovingImageFilesAreFixedImageFiles()
 
 
 /**
- * ****************** CallInEachComponentInt ********************
+ * ****************** SetupImagePyramidSharing ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
-int
+void
 ElastixTemplate< TFixedImage, TMovingImage >
-::CallInEachComponentInt( PtrToMemberFunction2 func )
+::SetupImagePyramidSharing( void )
 {
-  /** Declare the return value and initialize it. */
-  int returndummy = 0;
+  typedef typename RegistrationBaseType::ITKBaseType       ITKRegistrationType;
+  typedef typename FixedImagePyramidBaseType::ITKBaseType  ITKFixedPyramidType;
+  typedef typename MovingImagePyramidBaseType::ITKBaseType ITKMovingPyramidType;
+  typedef itk::GenericMultiResolutionPyramidImageFilter<
+    FixedImageType, FixedImageType >                       GenericPyramidType;
 
-  /** Call the memberfunction 'func' of all components. */
-  returndummy |= ( ( *( this->GetConfiguration() ) ).*func )();
-
-  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
-  {
-    returndummy |= ( ( *( this->GetElxRegistrationBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
-  {
-    returndummy |= ( ( *( this->GetElxTransformBase( i ) ) ).*func )();
-  }
-  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+  /** Only a single registration with one fixed and one moving pyramid. */
+  if( this->GetNumberOfRegistrations() != 1
+    || this->GetNumberOfFixedImagePyramids() != 1
+    || this->GetNumberOfMovingImagePyramids() != 1 )
   {
-    returndummy |= ( ( *( this->GetElxImageSamplerBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+
+  ITKRegistrationType * registration = this->GetElxRegistrationBase()->GetAsITKBaseType();
+  registration->SetShareImagePyramids( false );
+
+  bool shareImagePyramids = true;
+  this->GetConfiguration()->ReadParameter( shareImagePyramids,
+    "ShareImagePyramids", 0, false );
+  if( !shareImagePyramids
+    || std::string( this->GetElxRegistrationBase()->elxGetClassName() )
+    != "MultiResolutionRegistration" )
   {
-    returndummy |= ( ( *( this->GetElxMetricBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+
+  /** The fixed and moving image have to be the same object. */
+  if( this->GetFixedImage() == 0
+    || static_cast< itk::DataObject * >( this->GetFixedImage() )
+    != static_cast< itk::DataObject * >( this->GetMovingImage() ) )
   {
-    returndummy |= ( ( *( this->GetElxInterpolatorBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfOptimizers(); ++i )
+
+  /** The pyramids have to be of the same kind, e.g. FixedGenericImagePyramid
+   * and MovingGenericImagePyramid.
+   */
+  std::string fixedName  = this->GetElxFixedImagePyramidBase()->elxGetClassName();
+  std::string movingName = this->GetElxMovingImagePyramidBase()->elxGetClassName();
+  const std::string::size_type fixedPos  = fixedName.find( "Fixed" );
+  const std::string::size_type movingPos = movingName.find( "Moving" );
+  if( fixedPos == std::string::npos || movingPos == std::string::npos )
   {
-    returndummy |= ( ( *( this->GetElxOptimizerBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  fixedName.erase( fixedPos, 5 );
+  movingName.erase( movingPos, 6 );
+  if( fixedName != movingName )
   {
-    returndummy |= ( ( *( this->GetElxFixedImagePyramidBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+
+  /** And they have to compute the same images. */
+  ITKFixedPyramidType *  fixedPyramid  = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType();
+  ITKMovingPyramidType * movingPyramid = this->GetElxMovingImagePyramidBase()->GetAsITKBaseType();
+  if( fixedPyramid->GetNumberOfLevels() != movingPyramid->GetNumberOfLevels()
+    || !( fixedPyramid->GetSchedule() == movingPyramid->GetSchedule() )
+    || fixedPyramid->GetUseShrinkImageFilter() != movingPyramid->GetUseShrinkImageFilter() )
   {
-    returndummy |= ( ( *( this->GetElxMovingImagePyramidBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfResampleInterpolators(); ++i )
+
+  GenericPyramidType * fixedGeneric  = dynamic_cast< GenericPyramidType * >( fixedPyramid );
+  GenericPyramidType * movingGeneric = dynamic_cast< GenericPyramidType * >( movingPyramid );
+  if( ( fixedGeneric == 0 ) != ( movingGeneric == 0 ) )
   {
-    returndummy |= ( ( *( this->GetElxResampleInterpolatorBase( i ) ) ).*func )();
+    return;
   }
-  for( unsigned int i = 0; i < this->GetNumberOfResamplers(); ++i )
+  if( fixedGeneric
+    && ( !( fixedGeneric->GetSmoothingSchedule() == movingGeneric->GetSmoothingSchedule() )
+    || fixedGeneric->GetComputeOnlyForCurrentLevel() != movingGeneric->GetComputeOnlyForCurrentLevel() ) )
   {
-    returndummy |= ( ( *( this->GetElxResamplerBase( i ) ) ).*func )();
+    return;
   }
 
-  /** Return a value. */
-  return returndummy;
+  registration->SetShareImagePyramids( true );
+  elxout << "The fixed and moving image pyramids are identical, "
+         << "the fixed image pyramid is used for both." << std::endl;
 
-} // end CallInEachComponent()
+} // end SetupImagePyramidSharing()
 
 
 /**
- * ****************** ConfigureComponents *******************
+ * ****************** SetupFixedImagePyramidCache ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 ElastixTemplate< TFixedImage, TMovingImage >
-::ConfigureComponents( Self * This )
+::SetupFixedImagePyramidCache( void )
 {
-  this->GetConfiguration()->SetComponentLabel( "Configuration", 0 );
+  typedef typename RegistrationBaseType::ITKBaseType      ITKRegistrationType;
+  typedef typename ITKRegistrationType::FixedImagePointer FixedImagePointer;
+  typedef typename FixedImagePyramidBaseType::ITKBaseType ITKFixedPyramidType;
+  typedef itk::GenericMultiResolutionPyramidImageFilter<
+    FixedImageType, FixedImageType >                      GenericPyramidType;
 
-  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
+  DataObjectContainerType * cache = this->GetFixedImagePyramidCacheContainer();
+  if( cache == 0 )
   {
-    elxCheckAndSetComponentMacro( Registration );
+    return;
   }
 
-  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
+  if( this->GetNumberOfRegistrations() != 1
+    || this->GetNumberOfFixedImagePyramids() != 1
+    || this->GetNumberOfFixedImages() != 1
+    || std::string( this->GetElxRegistrationBase()->elxGetClassName() )
+    != "MultiResolutionRegistration" )
   {
-    elxCheckAndSetComponentMacro( Transform );
+    this->SetFixedImagePyramidCacheKey( "" );
+    cache->Initialize();
+    return;
+  }
+
+  /** A pyramid that computes one level at a time can not be cached, and in
+   * LowMemoryMode the pyramid outputs are released after each level.
+   */
+  ITKFixedPyramidType * fixedPyramid = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType();
+  GenericPyramidType *  fixedGeneric = dynamic_cast< GenericPyramidType * >( fixedPyramid );
+  if( ( fixedGeneric && fixedGeneric->GetComputeOnlyForCurrentLevel() )
+    || this->m_LowMemoryMode )
+  {
+    this->SetFixedImagePyramidCacheKey( "" );
+    cache->Initialize();
+    return;
+  }
+
+  /** The key identifies the fixed image and everything the pyramid uses.
+   * The image of the registration is used, which differs from the fixed
+   * image if it is cropped to the mask, see SetupMaskBoundedImages().
+   */
+  const FixedImageType * fixedImage
+    = this->GetElxRegistrationBase()->GetAsITKBaseType()->GetFixedImage();
+  std::ostringstream     key;
+  key << fixedImage << " " << fixedImage->GetMTime() << " "
+      << this->GetElxFixedImagePyramidBase()->elxGetClassName() << " "
+      << fixedPyramid->GetNumberOfLevels() << " "
+      << fixedPyramid->GetUseShrinkImageFilter() << "\n"
+      << fixedPyramid->GetSchedule();
+  if( fixedGeneric )
+  {
+    key << fixedGeneric->GetSmoothingSchedule();
+  }
+
+  if( key.str() != this->GetFixedImagePyramidCacheKey()
+    || cache->Size() != fixedPyramid->GetNumberOfLevels() )
+  {
+    this->SetFixedImagePyramidCacheKey( key.str() );
+    cache->Initialize();
+    return;
+  }
+
+  /** Use the cached images. */
+  typename ITKRegistrationType::FixedImagePyramidOutputsType outputs;
+  for( unsigned int level = 0; level < cache->Size(); ++level )
+  {
+    FixedImageType * output = dynamic_cast< FixedImageType * >( cache->ElementAt( level ).GetPointer() );
+    if( output == 0 )
+    {
+      cache->Initialize();
+      return;
+    }
+    outputs.push_back( FixedImagePointer( output ) );
+  }
+  this->GetElxRegistrationBase()->GetAsITKBaseType()->SetFixedImagePyramidOutputs( outputs );
+  elxout << "The fixed image pyramid of the previous run is reused." << std::endl;
+
+} // end SetupFixedImagePyramidCache()
+
+
+/**
+ * ****************** StoreFixedImagePyramidCache ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::StoreFixedImagePyramidCache( void )
+{
+  DataObjectContainerType * cache = this->GetFixedImagePyramidCacheContainer();
+  if( cache == 0 || this->GetFixedImagePyramidCacheKey().empty()
+    || cache->Size() > 0 )
+  {
+    return;
+  }
+
+  /** The key was only kept if the pyramid can be cached, see
+   * SetupFixedImagePyramidCache(). Take the outputs out of the pipeline,
+   * so that they survive the pyramid component.
+   */
+  typedef typename FixedImagePyramidBaseType::ITKBaseType ITKFixedPyramidType;
+  ITKFixedPyramidType * fixedPyramid = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType();
+  for( unsigned int level = 0; level < fixedPyramid->GetNumberOfLevels(); ++level )
+  {
+    typename FixedImageType::Pointer output = fixedPyramid->GetOutput( level );
+    if( output.IsNull() || output->GetBufferedRegion().GetNumberOfPixels() == 0 )
+    {
+      cache->Initialize();
+      return;
+    }
+    output->DisconnectPipeline();
+    cache->InsertElement( level, output.GetPointer() );
+  }
+
+} // end StoreFixedImagePyramidCache()
+
+
+/**
+ * ****************** CreateImagePyramidFileCacheKey ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage, class TPyramid >
+std::string
+ElastixTemplate< TFixedImage, TMovingImage >
+::CreateImagePyramidFileCacheKey( const TImage * image,
+  const TPyramid * pyramid, const char * className ) const
+{
+  typedef itk::GenericMultiResolutionPyramidImageFilter< TImage, TImage > GenericPyramidType;
+  typedef itk::ImageFileCache< TImage >                                   ImageFileCacheType;
+
+  /** As for SetupFixedImagePyramidCache(): a pyramid that computes one level
+   * at a time has no outputs to store.
+   */
+  const GenericPyramidType * generic = dynamic_cast< const GenericPyramidType * >( pyramid );
+  if( image == 0 || ( generic && generic->GetComputeOnlyForCurrentLevel() ) )
+  {
+    return "";
+  }
+
+  std::ostringstream description;
+  description.precision( 17 );
+  description << className << "|" << pyramid->GetNumberOfLevels() << "|"
+              << pyramid->GetUseShrinkImageFilter() << "\n" << pyramid->GetSchedule();
+  if( generic )
+  {
+    description << generic->GetSmoothingSchedule();
+  }
+  return ImageFileCacheType::CreateContentKey( image, description.str() );
+
+} // end CreateImagePyramidFileCacheKey()
+
+
+/**
+ * ****************** SetupImagePyramidFileCache ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::SetupImagePyramidFileCache( void )
+{
+  typedef typename RegistrationBaseType::ITKBaseType ITKRegistrationType;
+  typedef itk::ImageFileCache< FixedImageType >      FixedImageFileCacheType;
+  typedef itk::ImageFileCache< MovingImageType >     MovingImageFileCacheType;
+
+  this->m_FixedImagePyramidFileCacheKey  = "";
+  this->m_MovingImagePyramidFileCacheKey = "";
+  const std::string cacheDirectory
+    = this->GetConfiguration()->GetCommandLineArgument( "-artifactcache" );
+  if( cacheDirectory.empty() )
+  {
+    return;
+  }
+
+  /** The registration takes precomputed outputs of one fixed and one
+   * moving pyramid only, and in LowMemoryMode the outputs are released
+   * after each level.
+   */
+  if( this->GetNumberOfRegistrations() != 1
+    || this->GetNumberOfFixedImagePyramids() != 1
+    || this->GetNumberOfMovingImagePyramids() != 1
+    || this->GetNumberOfFixedImages() != 1
+    || this->GetNumberOfMovingImages() != 1
+    || std::string( this->GetElxRegistrationBase()->elxGetClassName() )
+    != "MultiResolutionRegistration"
+    || this->m_LowMemoryMode )
+  {
+    return;
+  }
+  ITKRegistrationType * registration = this->GetElxRegistrationBase()->GetAsITKBaseType();
+
+  /** The fixed image pyramid, unless it is taken from the memory cache. The
+   * image of the registration is used, which differs from the fixed image if
+   * it is cropped to the mask.
+   */
+  typename FixedImagePyramidBaseType::ITKBaseType * fixedPyramid
+    = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType();
+  if( registration->GetFixedImagePyramidOutputs().size() != fixedPyramid->GetNumberOfLevels() )
+  {
+    const std::string key = this->CreateImagePyramidFileCacheKey(
+      registration->GetFixedImage(), fixedPyramid,
+      this->GetElxFixedImagePyramidBase()->elxGetClassName() );
+    typename ITKRegistrationType::FixedImagePyramidOutputsType outputs;
+    for( unsigned int level = 0; !key.empty() && level < fixedPyramid->GetNumberOfLevels(); ++level )
+    {
+      std::ostringstream levelKey;
+      levelKey << key << "|level|" << level;
+      typename FixedImageType::Pointer output
+        = FixedImageFileCacheType::LoadWithKey( cacheDirectory, levelKey.str() );
+      if( output.IsNull() )
+      {
+        break;
+      }
+      outputs.push_back( output );
+    }
+    if( !key.empty() && outputs.size() == fixedPyramid->GetNumberOfLevels() )
+    {
+      registration->SetFixedImagePyramidOutputs( outputs );
+      elxout << "The fixed image pyramid is read from the artifact cache." << std::endl;
+    }
+    else
+    {
+      this->m_FixedImagePyramidFileCacheKey = key;
+    }
+  }
+
+  /** The moving image pyramid, unless the fixed image pyramid is used for it. */
+  typename MovingImagePyramidBaseType::ITKBaseType * movingPyramid
+    = this->GetElxMovingImagePyramidBase()->GetAsITKBaseType();
+  if( !registration->GetShareImagePyramids() )
+  {
+    const std::string key = this->CreateImagePyramidFileCacheKey(
+      registration->GetMovingImage(), movingPyramid,
+      this->GetElxMovingImagePyramidBase()->elxGetClassName() );
+    typename ITKRegistrationType::MovingImagePyramidOutputsType outputs;
+    for( unsigned int level = 0; !key.empty() && level < movingPyramid->GetNumberOfLevels(); ++level )
+    {
+      std::ostringstream levelKey;
+      levelKey << key << "|level|" << level;
+      typename MovingImageType::Pointer output
+        = MovingImageFileCacheType::LoadWithKey( cacheDirectory, levelKey.str() );
+      if( output.IsNull() )
+      {
+        break;
+      }
+      outputs.push_back( output );
+    }
+    if( !key.empty() && outputs.size() == movingPyramid->GetNumberOfLevels() )
+    {
+      registration->SetMovingImagePyramidOutputs( outputs );
+      elxout << "The moving image pyramid is read from the artifact cache." << std::endl;
+    }
+    else
+    {
+      this->m_MovingImagePyramidFileCacheKey = key;
+    }
+  }
+
+} // end SetupImagePyramidFileCache()
+
+
+/**
+ * ****************** StoreImagePyramidFileCache ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::StoreImagePyramidFileCache( void )
+{
+  typedef itk::ImageFileCache< FixedImageType >  FixedImageFileCacheType;
+  typedef itk::ImageFileCache< MovingImageType > MovingImageFileCacheType;
+
+  const std::string cacheDirectory
+    = this->GetConfiguration()->GetCommandLineArgument( "-artifactcache" );
+
+  /** A failure only costs a later run the time to compute the pyramid. */
+  if( !this->m_FixedImagePyramidFileCacheKey.empty() )
+  {
+    typename FixedImagePyramidBaseType::ITKBaseType * fixedPyramid
+      = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType();
+    for( unsigned int level = 0; level < fixedPyramid->GetNumberOfLevels(); ++level )
+    {
+      std::ostringstream levelKey;
+      levelKey << this->m_FixedImagePyramidFileCacheKey << "|level|" << level;
+      const FixedImageType * output = fixedPyramid->GetOutput( level );
+      if( output && output->GetBufferedRegion().GetNumberOfPixels() > 0
+        && !FixedImageFileCacheType::Contains( cacheDirectory, levelKey.str() ) )
+      {
+        FixedImageFileCacheType::StoreWithKey( cacheDirectory, levelKey.str(), output );
+      }
+    }
+  }
+
+  if( !this->m_MovingImagePyramidFileCacheKey.empty() )
+  {
+    typename MovingImagePyramidBaseType::ITKBaseType * movingPyramid
+      = this->GetElxMovingImagePyramidBase()->GetAsITKBaseType();
+    for( unsigned int level = 0; level < movingPyramid->GetNumberOfLevels(); ++level )
+    {
+      std::ostringstream levelKey;
+      levelKey << this->m_MovingImagePyramidFileCacheKey << "|level|" << level;
+      const MovingImageType * output = movingPyramid->GetOutput( level );
+      if( output && output->GetBufferedRegion().GetNumberOfPixels() > 0
+        && !MovingImageFileCacheType::Contains( cacheDirectory, levelKey.str() ) )
+      {
+        MovingImageFileCacheType::StoreWithKey( cacheDirectory, levelKey.str(), output );
+      }
+    }
+  }
+  this->m_FixedImagePyramidFileCacheKey  = "";
+  this->m_MovingImagePyramidFileCacheKey = "";
+
+} // end StoreImagePyramidFileCache()
+
+
+/**
+ * ****************** SetupMaskBoundedImages ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::SetupMaskBoundedImages( void )
+{
+  typedef typename RegistrationBaseType::ITKBaseType ITKRegistrationType;
+
+  bool cropImagesToMasks = false;
+  this->GetConfiguration()->ReadParameter( cropImagesToMasks,
+    "CropImagesToMasks", 0, false );
+  if( !cropImagesToMasks )
+  {
+    return;
+  }
+
+  /** Only a single registration with one fixed and one moving image. */
+  if( this->GetNumberOfRegistrations() != 1
+    || this->GetNumberOfFixedImagePyramids() != 1
+    || this->GetNumberOfMovingImagePyramids() != 1
+    || this->GetNumberOfFixedImages() != 1
+    || this->GetNumberOfMovingImages() != 1
+    || std::string( this->GetElxRegistrationBase()->elxGetClassName() )
+    != "MultiResolutionRegistration" )
+  {
+    xout[ "warning" ] << "WARNING: CropImagesToMasks is ignored, because it is only "
+                      << "supported for one fixed and one moving image and the "
+                      << "MultiResolutionRegistration." << std::endl;
+    return;
+  }
+
+  /** With shared pyramids the fixed and moving image have to stay the same. */
+  ITKRegistrationType * registration = this->GetElxRegistrationBase()->GetAsITKBaseType();
+  if( registration->GetShareImagePyramids() )
+  {
+    xout[ "warning" ] << "WARNING: CropImagesToMasks is ignored, because the "
+                      << "image pyramids are shared." << std::endl;
+    return;
+  }
+
+  unsigned int extraMargin = 0;
+  this->GetConfiguration()->ReadParameter( extraMargin,
+    "MaskBoundingBoxMargin", 0, false );
+
+  /** Crop the fixed image. The fixed image region follows the cropped image. */
+  if( this->GetFixedMask() )
+  {
+    FixedImagePointer fixedImage = this->CropImageToMaskBoundingBox(
+      this->GetFixedImage(), this->GetElxFixedImagePyramidBase()->GetAsITKBaseType(),
+      this->GetFixedMask(), extraMargin );
+    if( fixedImage.IsNotNull() )
+    {
+      registration->SetFixedImage( fixedImage );
+      registration->SetFixedImageRegion( fixedImage->GetBufferedRegion() );
+      elxout << "The fixed image is cropped to the mask, size: "
+             << fixedImage->GetBufferedRegion().GetSize() << std::endl;
+    }
+  }
+
+  /** Crop the moving image. */
+  if( this->GetMovingMask() )
+  {
+    MovingImagePointer movingImage = this->CropImageToMaskBoundingBox(
+      this->GetMovingImage(), this->GetElxMovingImagePyramidBase()->GetAsITKBaseType(),
+      this->GetMovingMask(), extraMargin );
+    if( movingImage.IsNotNull() )
+    {
+      registration->SetMovingImage( movingImage );
+      elxout << "The moving image is cropped to the mask, size: "
+             << movingImage->GetBufferedRegion().GetSize() << std::endl;
+    }
+  }
+
+} // end SetupMaskBoundedImages()
+
+
+/**
+ * ****************** CropImageToMaskBoundingBox ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage, class TPyramid, class TMask >
+typename TImage::Pointer
+ElastixTemplate< TFixedImage, TMovingImage >
+::CropImageToMaskBoundingBox( const TImage * image, const TPyramid * pyramid,
+  const TMask * mask, const unsigned int extraMargin ) const
+{
+  typedef typename TImage::RegionType                   RegionType;
+  typedef typename TImage::IndexType                    IndexType;
+  typedef typename TImage::SizeType                     SizeType;
+  typedef typename TImage::PointType                    PointType;
+  typedef typename IndexType::IndexValueType            IndexValueType;
+  typedef typename TPyramid::ScheduleType               ScheduleType;
+  typedef itk::ContinuousIndex< double,
+    TImage::ImageDimension >                            ContinuousIndexType;
+  typedef itk::ContinuousIndex< double,
+    TMask::ImageDimension >                             MaskContinuousIndexType;
+  typedef itk::ImageMaskSpatialObject2<
+    TMask::ImageDimension >                             MaskSpatialObjectType;
+  typedef itk::GenericMultiResolutionPyramidImageFilter<
+    TImage, TImage >                                    GenericPyramidType;
+  typedef itk::RegionOfInterestImageFilter< TImage, TImage > CropFilterType;
+  const unsigned int dimension = TImage::ImageDimension;
+
+  /** The bounding box of the mask, in the index space of the mask. */
+  typename MaskSpatialObjectType::Pointer maskSpatialObject = MaskSpatialObjectType::New();
+  maskSpatialObject->SetImage( mask );
+  const typename TMask::RegionType maskRegion
+    = maskSpatialObject->GetAxisAlignedBoundingBoxRegion();
+  if( maskRegion.GetNumberOfPixels() == 0 )
+  {
+    return 0;
+  }
+
+  /** Map its corners to the index space of the image. The voxels of the
+   * mask extend half a voxel beyond their index.
+   */
+  double lower[ dimension ];
+  double upper[ dimension ];
+  std::fill( lower, lower + dimension, itk::NumericTraits< double >::max() );
+  std::fill( upper, upper + dimension, itk::NumericTraits< double >::NonpositiveMin() );
+  for( unsigned int corner = 0; corner < ( 1u << dimension ); ++corner )
+  {
+    MaskContinuousIndexType maskIndex;
+    for( unsigned int d = 0; d < dimension; ++d )
+    {
+      maskIndex[ d ] = static_cast< double >( maskRegion.GetIndex()[ d ] ) - 0.5;
+      if( corner & ( 1u << d ) )
+      {
+        maskIndex[ d ] += static_cast< double >( maskRegion.GetSize()[ d ] );
+      }
+    }
+    PointType           point;
+    ContinuousIndexType index;
+    mask->TransformContinuousIndexToPhysicalPoint( maskIndex, point );
+    image->TransformPhysicalPointToContinuousIndex( point, index );
+    for( unsigned int d = 0; d < dimension; ++d )
+    {
+      lower[ d ] = std::min( lower[ d ], static_cast< double >( index[ d ] ) );
+      upper[ d ] = std::max( upper[ d ], static_cast< double >( index[ d ] ) );
+    }
+  }
+
+  /** The margin covers the support of the smoothing of the pyramid, with
+   * sigma in voxels, and of the interpolation at the coarsest level, at which
+   * a voxel covers the largest shrink factor.
+   */
+  const ScheduleType &       schedule = pyramid->GetSchedule();
+  const GenericPyramidType * generic  = dynamic_cast< const GenericPyramidType * >( pyramid );
+  const bool                 useSmoothingSchedule = generic
+    && generic->GetSmoothingSchedule().rows() == schedule.rows();
+  const RegionType & largestRegion = image->GetLargestPossibleRegion();
+  IndexType          start;
+  SizeType           size;
+  for( unsigned int d = 0; d < dimension; ++d )
+  {
+    double maximumFactor = 1.0;
+    double maximumSigma  = 0.0;
+    for( unsigned int level = 0; level < schedule.rows(); ++level )
+    {
+      const double factor = static_cast< double >( schedule[ level ][ d ] );
+      const double sigma  = useSmoothingSchedule
+        ? generic->GetSmoothingSchedule()[ level ][ d ] / image->GetSpacing()[ d ]
+        : 0.5 * factor;
+      maximumFactor = std::max( maximumFactor, factor );
+      maximumSigma  = std::max( maximumSigma, sigma );
+    }
+    const IndexValueType margin = static_cast< IndexValueType >(
+      vcl_ceil( 4.0 * maximumSigma + 4.0 * maximumFactor ) )
+      + static_cast< IndexValueType >( extraMargin );
+
+    /** The voxels that overlap the box, plus the margin, inside the image. */
+    const IndexValueType largestStart = largestRegion.GetIndex()[ d ];
+    const IndexValueType largestEnd   = largestStart
+      + static_cast< IndexValueType >( largestRegion.GetSize()[ d ] ) - 1;
+    const IndexValueType first = std::max( largestStart,
+      static_cast< IndexValueType >( vcl_floor( lower[ d ] + 0.5 ) ) - margin );
+    const IndexValueType last = std::min( largestEnd,
+      static_cast< IndexValueType >( vcl_ceil( upper[ d ] - 0.5 ) ) + margin );
+    if( last < first )
+    {
+      return 0;
+    }
+    start[ d ] = first;
+    size[ d ]  = static_cast< typename SizeType::SizeValueType >( last - first + 1 );
+  }
+
+  const RegionType region( start, size );
+  if( region == largestRegion )
+  {
+    return 0;
+  }
+
+  /** Crop the image. The origin of the output is moved, so that the
+   * physical coordinates of the voxels do not change.
+   */
+  typename CropFilterType::Pointer cropFilter = CropFilterType::New();
+  cropFilter->SetInput( image );
+  cropFilter->SetRegionOfInterest( region );
+  cropFilter->Update();
+
+  typename TImage::Pointer output = cropFilter->GetOutput();
+  output->DisconnectPipeline();
+  return output;
+
+} // end CropImageToMaskBoundingBox()
+
+
+/**
+ * ****************** ReleaseResolutionMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReleaseResolutionMemory( const unsigned int level )
+{
+  /** The outputs of the finished levels. The pyramids do not execute again,
+   * since the outputs of the next levels are still up to date.
+   */
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  {
+    typename FixedImagePyramidBaseType::ITKBaseType * pyramid
+      = this->GetElxFixedImagePyramidBase( i )->GetAsITKBaseType();
+    for( unsigned int l = 0; l <= level && l < pyramid->GetNumberOfLevels(); ++l )
+    {
+      pyramid->GetOutput( l )->ReleaseData();
+    }
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+  {
+    typename MovingImagePyramidBaseType::ITKBaseType * pyramid
+      = this->GetElxMovingImagePyramidBase( i )->GetAsITKBaseType();
+    for( unsigned int l = 0; l <= level && l < pyramid->GetNumberOfLevels(); ++l )
+    {
+      pyramid->GetOutput( l )->ReleaseData();
+    }
+  }
+
+  /** The samples, which are generated again for the next level. */
+  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+  {
+    this->GetElxImageSamplerBase( i )->GetAsITKBaseType()->ReleaseMemory();
+  }
+
+  /** The B-spline coefficients; the metric sets the input of the
+   * interpolator again when it is initialized for the next level.
+   */
+  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+  {
+    this->GetElxInterpolatorBase( i )->GetAsITKBaseType()->SetInputImage( 0 );
+  }
+
+  /** The per-thread buffers and caches of the metrics. */
+  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+  {
+    this->GetElxMetricBase( i )->ReleaseMemory();
+  }
+
+  /** The eroded masks are released by RegistrationBase::AfterEachResolutionBase(). */
+
+} // end ReleaseResolutionMemory()
+
+
+/**
+ * ****************** ReportMemoryAccounting ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReportMemoryAccounting( const unsigned int level )
+{
+  typedef PerformanceTrace::MemoryAccountingType                  MemoryAccountingType;
+  typedef PerformanceTrace::MemoryAccountingEntryType             MemoryAccountingEntryType;
+  typedef typename FixedImagePyramidBaseType::ITKBaseType         ITKFixedPyramidType;
+  typedef typename MovingImagePyramidBaseType::ITKBaseType        ITKMovingPyramidType;
+  typedef typename ImageSamplerBaseType::ITKBaseType              ITKImageSamplerType;
+  typedef itk::ImageRandomSamplerBase< FixedImageType >           RandomImageSamplerType;
+  typedef typename MetricBaseType::AdvancedMetricType             AdvancedMetricType;
+
+  MemoryAccountingType accounting;
+  MemoryAccountingEntryType entry;
+
+  /** The pyramids hold the images of all levels. */
+  itk::SizeValueType fixedLevelPixels = 0;
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  {
+    ITKFixedPyramidType * pyramid = this->GetElxFixedImagePyramidBase( i )->GetAsITKBaseType();
+    std::ostringstream name( "" );
+    name << "FixedImagePyramid" << i;
+    entry.m_Name    = name.str();
+    entry.m_Current = 0.0;
+    for( unsigned int l = 0; l < pyramid->GetNumberOfLevels(); ++l )
+    {
+      const itk::SizeValueType pixels = pyramid->GetOutput( l )->GetBufferedRegion().GetNumberOfPixels();
+      entry.m_Current += static_cast< double >( pixels ) * sizeof( typename FixedImageType::PixelType );
+      if( i == 0 && l == level ) { fixedLevelPixels = pixels; }
+    }
+    entry.m_Projected = entry.m_Current;
+    accounting.push_back( entry );
+  }
+  std::vector< itk::SizeValueType > movingLevelPixels;
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+  {
+    ITKMovingPyramidType * pyramid = this->GetElxMovingImagePyramidBase( i )->GetAsITKBaseType();
+    std::ostringstream name( "" );
+    name << "MovingImagePyramid" << i;
+    entry.m_Name    = name.str();
+    entry.m_Current = 0.0;
+    movingLevelPixels.push_back( 0 );
+    for( unsigned int l = 0; l < pyramid->GetNumberOfLevels(); ++l )
+    {
+      const itk::SizeValueType pixels = pyramid->GetOutput( l )->GetBufferedRegion().GetNumberOfPixels();
+      entry.m_Current += static_cast< double >( pixels ) * sizeof( typename MovingImageType::PixelType );
+      if( l == level ) { movingLevelPixels[ i ] = pixels; }
+    }
+    entry.m_Projected = entry.m_Current;
+    accounting.push_back( entry );
+  }
+
+  /** The transform parameters, which the B-spline coefficient images wrap. */
+  const itk::SizeValueType numberOfParameters
+    = this->GetElxTransformBase()->GetAsITKBaseType()->GetNumberOfParameters();
+  entry.m_Name      = "Transform";
+  entry.m_Current   = static_cast< double >( numberOfParameters ) * sizeof( double )
+    + this->GetElxTransformBase()->GetAsITKBaseType()->GetJacobianStructureMemoryUsage();
+  entry.m_Projected = entry.m_Current;
+  accounting.push_back( entry );
+
+  /** The interpolators compute their coefficients for the moving image of
+   * this level, or the fixed image when the pyramids are shared. */
+  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+  {
+    const InterpolatorBaseType * interpolator = this->GetElxInterpolatorBase( i );
+    const MovingImageType *      input        = interpolator->GetAsITKBaseType()->GetInputImage();
+    itk::SizeValueType           pixels       = movingLevelPixels.empty()
+      ? 0 : movingLevelPixels[ std::min< std::size_t >( i, movingLevelPixels.size() - 1 ) ];
+    if( pixels == 0 ) { pixels = fixedLevelPixels; }
+    std::ostringstream name( "" );
+    name << "Interpolator" << i;
+    entry.m_Name      = name.str();
+    entry.m_Current   = input ? interpolator->GetMemoryUsage( input->GetBufferedRegion().GetNumberOfPixels() ) : 0;
+    entry.m_Projected = interpolator->GetMemoryUsage( pixels );
+    accounting.push_back( entry );
+  }
+
+  /** The random samplers draw their number of samples, the others at most
+   * all voxels of the fixed image of this level. */
+  std::vector< itk::SizeValueType > numberOfSamples;
+  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+  {
+    const ITKImageSamplerType *    sampler = this->GetElxImageSamplerBase( i )->GetAsITKBaseType();
+    const RandomImageSamplerType * random  = dynamic_cast< const RandomImageSamplerType * >( sampler );
+    numberOfSamples.push_back( random ? random->GetNumberOfSamples() : fixedLevelPixels );
+    std::ostringstream name( "" );
+    name << "ImageSampler" << i;
+    entry.m_Name      = name.str();
+    entry.m_Current   = sampler->GetMemoryUsage();
+    entry.m_Projected = static_cast< double >( numberOfSamples[ i ] )
+      * sizeof( typename ITKImageSamplerType::ImageSampleType );
+    accounting.push_back( entry );
+  }
+
+  /** The metrics allocate their per-thread buffers and histograms. */
+  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+  {
+    const AdvancedMetricType * metric = dynamic_cast< const AdvancedMetricType * >(
+      this->GetElxMetricBase( i )->GetAsITKBaseType() );
+    if( metric == 0 ) { continue; }
+    const itk::SizeValueType samples = numberOfSamples.empty()
+      ? fixedLevelPixels : numberOfSamples[ std::min< std::size_t >( i, numberOfSamples.size() - 1 ) ];
+    std::ostringstream name( "" );
+    name << "Metric" << i;
+    entry.m_Name      = name.str();
+    entry.m_Current   = metric->GetMemoryUsage();
+    entry.m_Projected = metric->GetProjectedMemoryUsage( numberOfParameters, samples );
+    accounting.push_back( entry );
+  }
+
+  /** The allocations that are still to come, and the expected peak. */
+  double allocations = 0.0;
+  for( std::size_t i = 0; i < accounting.size(); ++i )
+  {
+    if( accounting[ i ].m_Projected > accounting[ i ].m_Current )
+    {
+      allocations += accounting[ i ].m_Projected - accounting[ i ].m_Current;
+    }
+  }
+  const double projectedPeak
+    = static_cast< double >( PerformanceTrace::GetMemoryUsage() ) * 1024.0 + allocations;
+
+  if( this->m_ReportMemoryUsage )
+  {
+    elxout << "Memory accounting for resolution " << level
+           << " (held now / expected during the resolution):\n";
+    for( std::size_t i = 0; i < accounting.size(); ++i )
+    {
+      elxout << "  " << accounting[ i ].m_Name << ": "
+             << accounting[ i ].m_Current / ( 1024.0 * 1024.0 ) << " / "
+             << accounting[ i ].m_Projected / ( 1024.0 * 1024.0 ) << " MB\n";
+    }
+    elxout << "  Expected peak memory usage: "
+           << projectedPeak / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+  }
+  this->m_PerformanceTrace.WriteMemoryAccounting( level, accounting, projectedPeak );
+
+  /** Warn before the allocations are made. */
+  itksys::SystemInformation info;
+  info.RunMemoryCheck();
+  const double available = static_cast< double >( info.GetAvailablePhysicalMemory() ) * 1024.0 * 1024.0;
+  if( available > 0.0 && allocations > available )
+  {
+    xout[ "warning" ] << "WARNING: resolution " << level << " is expected to allocate "
+                      << allocations / ( 1024.0 * 1024.0 ) << " MB, but only "
+                      << available / ( 1024.0 * 1024.0 ) << " MB of physical memory is available.\n"
+                      << "  Consider fewer samples or threads, a coarser B-spline grid, "
+                      << "UseExplicitPDFDerivatives \"false\", or LowMemoryMode \"true\"."
+                      << std::endl;
+  }
+
+} // end ReportMemoryAccounting()
+
+
+/**
+ * ************** ReportHardwareCounters ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReportHardwareCounters( const unsigned int level )
+{
+  typedef itk::HardwareCounters::TableType  TableType;
+  typedef itk::HardwareCounters::CountsType CountsType;
+  typedef typename TableType::const_iterator TableIteratorType;
+
+  const TableType table = itk::HardwareCounters::GetAndClear();
+  this->m_PerformanceTrace.WriteHardwareCounters( level, table );
+
+  /** Sum the threads of every phase. The threads of a phase run at the same
+   * time, so the longest thread estimates the elapsed time of the phase.
+   */
+  typedef std::map< std::string, CountsType > PhaseTableType;
+  PhaseTableType phases;
+  std::map< std::string, double > elapsed;
+  for( TableIteratorType it = table.begin(); it != table.end(); ++it )
+  {
+    phases[ it->first.first ] += it->second;
+    double & phaseElapsed = elapsed[ it->first.first ];
+    phaseElapsed = std::max( phaseElapsed, it->second.m_Time );
+  }
+
+  elxout << "Hardware counters of resolution " << level << ":\n";
+  for( typename PhaseTableType::const_iterator it = phases.begin(); it != phases.end(); ++it )
+  {
+    const CountsType & counts = it->second;
+    const double       ipc    = counts.m_Cycles > 0.0
+      ? counts.m_Instructions / counts.m_Cycles : 0.0;
+    const double missesPerKiloInstruction = counts.m_Instructions > 0.0
+      ? 1000.0 * counts.m_CacheMisses / counts.m_Instructions : 0.0;
+    const double time      = elapsed[ it->first ];
+    const double bandwidth = time > 0.0
+      ? counts.m_CacheMisses * itk::HardwareCounters::GetCacheLineSize() / time : 0.0;
+
+    elxout << "  " << it->first << ": "
+           << static_cast< unsigned long >( counts.m_NumberOfScopes ) << " times, "
+           << static_cast< unsigned long >( time * 1000.0 ) << " ms, "
+           << ipc << " instructions per cycle, "
+           << missesPerKiloInstruction << " cache misses per 1000 instructions, ~"
+           << bandwidth / ( 1024.0 * 1024.0 ) << " MB/s\n";
+  }
+  elxout << std::flush;
+
+} // end ReportHardwareCounters()
+
+
+/**
+ * ************** WriteResolutionCheckpoint ******************
+ *
+ * The checkpoint is a small binary file in the native byte order:
+ * the magic "ELXCKPT1", the elastix level, the finished resolution,
+ * the number of resolutions, the name of the optimizer, the transform
+ * parameters and the state of the optimizer. It is written to a temporary
+ * file first, so an interrupted write leaves the previous checkpoint intact.
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::WriteResolutionCheckpoint( const unsigned int level,
+  const ParametersType & parameters )
+{
+  std::ostringstream makeFileName( "" );
+  makeFileName << this->GetConfiguration()->GetCommandLineArgument( "-out" )
+               << "ResolutionCheckpoint."
+               << this->GetConfiguration()->GetElastixLevel()
+               << ".bin";
+  const std::string fileName     = makeFileName.str();
+  const std::string tempFileName = fileName + ".tmp";
+
+  std::vector< double > state;
+  this->GetElxOptimizerBase()->GetResolutionCheckpointState( state );
+  const std::string optimizerName = this->GetElxOptimizerBase()->elxGetClassName();
+
+  const unsigned int header[ 6 ] = {
+    this->GetConfiguration()->GetElastixLevel(),
+    level,
+    static_cast< unsigned int >(
+    this->GetElxRegistrationBase()->GetAsITKBaseType()->GetNumberOfLevels() ),
+    static_cast< unsigned int >( optimizerName.size() ),
+    static_cast< unsigned int >( parameters.Size() ),
+    static_cast< unsigned int >( state.size() )
+  };
+
+  std::ofstream file( tempFileName.c_str(), std::ios::out | std::ios::binary );
+  file.write( "ELXCKPT1", 8 );
+  file.write( reinterpret_cast< const char * >( header ), sizeof( header ) );
+  file.write( optimizerName.data(), optimizerName.size() );
+  if( parameters.Size() > 0 )
+  {
+    file.write( reinterpret_cast< const char * >( parameters.data_block() ),
+      parameters.Size() * sizeof( double ) );
+  }
+  if( !state.empty() )
+  {
+    file.write( reinterpret_cast< const char * >( &state[ 0 ] ),
+      state.size() * sizeof( double ) );
+  }
+  file.close();
+
+  /** Replace the checkpoint of the previous resolution. */
+  std::remove( fileName.c_str() );
+  if( !file || std::rename( tempFileName.c_str(), fileName.c_str() ) != 0 )
+  {
+    std::remove( tempFileName.c_str() );
+    xout[ "error" ] << "ERROR: The resolution checkpoint \"" << fileName
+                    << "\" could not be written!" << std::endl;
+    return;
+  }
+
+  elxout << "The resolution checkpoint of resolution " << level
+         << " is written to \"" << fileName << "\"." << std::endl;
+
+} // end WriteResolutionCheckpoint()
+
+
+/**
+ * ************** ReadResolutionCheckpoint ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReadResolutionCheckpoint( void )
+{
+  this->m_ResumeLevel = 0;
+  const std::string fileName
+    = this->GetConfiguration()->GetCommandLineArgument( "-resume" );
+  if( fileName.empty() )
+  {
+    return;
+  }
+
+  /** Read the header, see WriteResolutionCheckpoint(). */
+  std::ifstream file( fileName.c_str(), std::ios::in | std::ios::binary );
+  char          magic[ 8 ];
+  unsigned int  header[ 6 ];
+  file.read( magic, 8 );
+  file.read( reinterpret_cast< char * >( header ), sizeof( header ) );
+  if( !file || std::string( magic, 8 ) != "ELXCKPT1" )
+  {
+    itkExceptionMacro( << "ERROR: \"" << fileName
+                       << "\" is not a resolution checkpoint of elastix." );
+  }
+
+  const unsigned int elastixLevel = this->GetConfiguration()->GetElastixLevel();
+  if( header[ 0 ] != elastixLevel )
+  {
+    elxout << "The resolution checkpoint \"" << fileName << "\" is of parameter file "
+           << header[ 0 ] << ", so parameter file " << elastixLevel
+           << " runs from the start." << std::endl;
+    return;
+  }
+
+  std::string           optimizerName( header[ 3 ], '\0' );
+  ParametersType        parameters( header[ 4 ] );
+  std::vector< double > state( header[ 5 ] );
+  if( header[ 3 ] > 0 )
+  {
+    file.read( &optimizerName[ 0 ], header[ 3 ] );
+  }
+  if( header[ 4 ] > 0 )
+  {
+    file.read( reinterpret_cast< char * >( parameters.data_block() ),
+      header[ 4 ] * sizeof( double ) );
+  }
+  if( header[ 5 ] > 0 )
+  {
+    file.read( reinterpret_cast< char * >( &state[ 0 ] ), header[ 5 ] * sizeof( double ) );
+  }
+  if( !file )
+  {
+    itkExceptionMacro( << "ERROR: The resolution checkpoint \"" << fileName
+                       << "\" is truncated." );
+  }
+
+  /** The checkpoint must fit the registration of the parameter file. */
+  typedef typename RegistrationBaseType::ITKBaseType ITKRegistrationType;
+  ITKRegistrationType * registration = this->GetElxRegistrationBase()->GetAsITKBaseType();
+  const unsigned int    resumeLevel  = header[ 1 ] + 1;
+  if( header[ 2 ] != registration->GetNumberOfLevels() )
+  {
+    itkExceptionMacro( << "ERROR: The resolution checkpoint \"" << fileName
+                       << "\" has " << header[ 2 ] << " resolutions, but the registration has "
+                       << registration->GetNumberOfLevels() << "." );
+  }
+  if( optimizerName != this->GetElxOptimizerBase()->elxGetClassName() )
+  {
+    itkExceptionMacro( << "ERROR: The resolution checkpoint \"" << fileName
+                       << "\" was written by the optimizer " << optimizerName
+                       << ", but the optimizer is "
+                       << this->GetElxOptimizerBase()->elxGetClassName() << "." );
+  }
+  if( resumeLevel >= registration->GetNumberOfLevels() )
+  {
+    itkExceptionMacro( << "ERROR: The resolution checkpoint \"" << fileName
+                       << "\" is of the last resolution; there is nothing to resume." );
+  }
+
+  /** The transform parameters are checked by the registration, at the level
+   * where they are used. */
+  this->GetElxOptimizerBase()->SetResolutionCheckpointState( state );
+  registration->SetResumeTransformParameters( parameters );
+  registration->SetResumeLevel( resumeLevel );
+  this->m_ResumeLevel = resumeLevel;
+
+  elxout << "Resuming from the resolution checkpoint \"" << fileName
+         << "\": resolutions 0 to " << header[ 1 ] << " are restored." << std::endl;
+
+} // end ReadResolutionCheckpoint()
+
+
+/**
+ * ****************** PrintPeakMemoryUsage ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::PrintPeakMemoryUsage( const std::string & stage ) const
+{
+  elxout << "Peak memory usage after " << stage << ": "
+         << PerformanceTrace::GetPeakMemoryUsage() / 1024 << " MB, current memory usage: "
+         << PerformanceTrace::GetMemoryUsage() / 1024 << " MB." << std::endl;
+
+} // end PrintPeakMemoryUsage()
+
+
+/**
+ * ************** ReadImages ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReadImages( void )
+{
+  ReadImagesTaskType task;
+  task.m_Self                = this;
+  task.m_UseDirectionCosines = this->GetUseDirectionCosines();
+  task.m_ImageCache          = this->GetConfiguration()->GetCommandLineArgument( "-imagecache" );
+
+  /** In group-wise registration the fixed and moving image are the same
+   * file. The moving image is then not read together with the fixed image,
+   * but taken from it afterwards, if the image types allow it.
+   */
+  const FileNameContainerType * fixedFileNames  = this->GetFixedImageFileNameContainer();
+  const FileNameContainerType * movingFileNames = this->GetMovingImageFileNameContainer();
+  bool                          sameFileNames   = fixedFileNames && movingFileNames
+    && fixedFileNames->Size() > 0 && fixedFileNames->Size() == movingFileNames->Size();
+  for( unsigned int i = 0; sameFileNames && i < fixedFileNames->Size(); ++i )
+  {
+    sameFileNames = fixedFileNames->ElementAt( i ) == movingFileNames->ElementAt( i );
+  }
+  task.m_Read[ 0 ] = this->GetFixedImage() == 0;
+  task.m_Read[ 1 ] = this->GetMovingImage() == 0 && !sameFileNames;
+  task.m_Read[ 2 ] = this->GetFixedMask() == 0;
+  task.m_Read[ 3 ] = this->GetMovingMask() == 0;
+
+  bool readImagesConcurrently = true;
+  this->GetConfiguration()->ReadParameter( readImagesConcurrently,
+    "ReadImagesConcurrently", 0, false );
+
+  unsigned int numberOfTasks = 0;
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    if( task.m_Read[ i ] ) { ++numberOfTasks; }
+  }
+
+  if( readImagesConcurrently && numberOfTasks > 1 )
+  {
+    /** Register the image IO factories in this thread, before the readers
+     * look them up concurrently.
+     */
+    if( fixedFileNames && fixedFileNames->Size() > 0 )
+    {
+      itk::ImageIOFactory::CreateImageIO(
+        fixedFileNames->ElementAt( 0 ).c_str(), itk::ImageIOFactory::ReadMode );
+    }
+
+    itk::PersistentThreadPool * pool = itk::PersistentThreadPool::GetGlobalThreadPool();
+    task.m_WorkChunks.Initialize( 4, 1 );
+    pool->SingleMethodExecute( Self::ReadImagesThreaderCallback, &task, numberOfTasks );
+  }
+  else
+  {
+    for( unsigned int i = 0; i < 4; ++i )
+    {
+      Self::ReadImage( task, i );
+    }
+  }
+
+  /** Store the results. */
+  if( task.m_Read[ 0 ] )
+  {
+    this->SetFixedImageContainer( task.m_Containers[ 0 ] );
+    this->SetOriginalFixedImageDirection( task.m_FixedImageDirection );
+  }
+  else
+  {
+    /**
+     *  images are set in elastixlib.cxx
+     *  just set direction cosines
+     *  in case images are imported for executable it does not matter
+     *  because the InfoChanger has changed these images.
+     */
+    FixedImageType * fixedIm = this->GetFixedImage( 0 );
+    this->SetOriginalFixedImageDirection( fixedIm->GetDirection() );
+  }
+
+  if( task.m_Read[ 1 ] )
+  {
+    this->SetMovingImageContainer( task.m_Containers[ 1 ] );
+  }
+  else if( this->GetMovingImage() == 0 )
+  {
+    if( this->MovingImageFilesAreFixedImageFiles()
+      && dynamic_cast< MovingImageType * >( this->GetFixedImageContainer()->ElementAt( 0 ).GetPointer() ) )
+    {
+      this->SetMovingImageContainer( this->GetFixedImageContainer() );
+    }
+    else
+    {
+      this->SetMovingImageContainer(
+        MovingImageLoaderType::GenerateImageContainer(
+        this->GetMovingImageFileNameContainer(), "Moving Image",
+        task.m_UseDirectionCosines, NULL, task.m_ImageCache ) );
+    }
+  }
+
+  if( task.m_Read[ 2 ] )
+  {
+    this->SetFixedMaskContainer( task.m_Containers[ 2 ] );
+  }
+  if( task.m_Read[ 3 ] )
+  {
+    this->SetMovingMaskContainer( task.m_Containers[ 3 ] );
+  }
+
+} // end ReadImages()
+
+
+/**
+ * ************** ReadImage ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReadImage( ReadImagesTaskType & task, unsigned int taskId )
+{
+  if( !task.m_Read[ taskId ] )
+  {
+    return;
+  }
+
+  Self *              self      = task.m_Self;
+  const bool          useDirCos = task.m_UseDirectionCosines;
+  const std::string & cache     = task.m_ImageCache;
+  switch( taskId )
+  {
+    case 0:
+      task.m_Containers[ 0 ] = FixedImageLoaderType::GenerateImageContainer(
+        self->GetFixedImageFileNameContainer(), "Fixed Image",
+        useDirCos, &task.m_FixedImageDirection, cache );
+      break;
+    case 1:
+      task.m_Containers[ 1 ] = MovingImageLoaderType::GenerateImageContainer(
+        self->GetMovingImageFileNameContainer(), "Moving Image", useDirCos, NULL, cache );
+      break;
+    case 2:
+      task.m_Containers[ 2 ] = FixedMaskLoaderType::GenerateImageContainer(
+        self->GetFixedMaskFileNameContainer(), "Fixed Mask", useDirCos, NULL, cache );
+      break;
+    case 3:
+      task.m_Containers[ 3 ] = MovingMaskLoaderType::GenerateImageContainer(
+        self->GetMovingMaskFileNameContainer(), "Moving Mask", useDirCos, NULL, cache );
+      break;
+  }
+
+} // end ReadImage()
+
+
+/**
+ * ************** ReadImagesThreaderCallback ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReadImagesThreaderCallback( void * arg )
+{
+  typedef itk::PersistentThreadPool::ThreadInfoType ThreadInfoType;
+  ThreadInfoType *     infoStruct = static_cast< ThreadInfoType * >( arg );
+  ReadImagesTaskType * task       = static_cast< ReadImagesTaskType * >( infoStruct->UserData );
+
+  itk::SizeValueType begin, end;
+  while( task->m_WorkChunks.GetNext( begin, end ) )
+  {
+    for( itk::SizeValueType i = begin; i < end; ++i )
+    {
+      Self::ReadImage( *task, static_cast< unsigned int >( i ) );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ReadImagesThreaderCallback()
+
+
+/**
+ * ****************** CallInEachComponent ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::CallInEachComponent( PtrToMemberFunction func )
+{
+  /** Call the memberfunction 'func' of all components. */
+  ( ( *( this->GetConfiguration() ) ).*func )();
+
+  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
+  {
+    ( ( *( this->GetElxRegistrationBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
+  {
+    ( ( *( this->GetElxTransformBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+  {
+    ( ( *( this->GetElxImageSamplerBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+  {
+    ( ( *( this->GetElxMetricBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+  {
+    ( ( *( this->GetElxInterpolatorBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfOptimizers(); ++i )
+  {
+    ( ( *( this->GetElxOptimizerBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  {
+    ( ( *( this->GetElxFixedImagePyramidBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+  {
+    ( ( *( this->GetElxMovingImagePyramidBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfResampleInterpolators(); ++i )
+  {
+    ( ( *( this->GetElxResampleInterpolatorBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfResamplers(); ++i )
+  {
+    ( ( *( this->GetElxResamplerBase( i ) ) ).*func )();
+  }
+
+} // end CallInEachComponent()
+
+
+/**
+ * ****************** CallInEachComponentInt ********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+int
+ElastixTemplate< TFixedImage, TMovingImage >
+::CallInEachComponentInt( PtrToMemberFunction2 func )
+{
+  /** Declare the return value and initialize it. */
+  int returndummy = 0;
+
+  /** Call the memberfunction 'func' of all components. */
+  returndummy |= ( ( *( this->GetConfiguration() ) ).*func )();
+
+  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxRegistrationBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxTransformBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxImageSamplerBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxMetricBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxInterpolatorBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfOptimizers(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxOptimizerBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxFixedImagePyramidBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxMovingImagePyramidBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfResampleInterpolators(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxResampleInterpolatorBase( i ) ) ).*func )();
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfResamplers(); ++i )
+  {
+    returndummy |= ( ( *( this->GetElxResamplerBase( i ) ) ).*func )();
+  }
+
+  /** Return a value. */
+  return returndummy;
+
+} // end CallInEachComponent()
+
+
+/**
+ * ****************** ConfigureComponents *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ConfigureComponents( Self * This )
+{
+  this->GetConfiguration()->SetComponentLabel( "Configuration", 0 );
+
+  for( unsigned int i = 0; i < this->GetNumberOfRegistrations(); ++i )
+  {
+    elxCheckAndSetComponentMacro( Registration );
+  }
+
+  for( unsigned int i = 0; i < this->GetNumberOfTransforms(); ++i )
+  {
+    elxCheckAndSetComponentMacro( Transform );
   }
 
   for( unsigned int i = 0; i < this->GetNumberOfImageSamplers(); ++i )
@@ -1154,6 +2823,7 @@ ElastixTemplate< TFixedImage, TMovingImage >
 
   if( this->m_IterationInfoFile.is_open() )
   {
+    this->m_IterationInfoFileBuffer.Flush();
     this->m_IterationInfoFile.close();
   }
 
@@ -1175,7 +2845,7 @@ ElastixTemplate< TFixedImage, TMovingImage >
   else
   {
     /** Add this file to the list of outputs of xout["iteration"]. */
-    xout[ "iteration" ].AddOutput( "IterationInfoFile", &( this->m_IterationInfoFile ) );
+    xout[ "iteration" ].AddOutput( "IterationInfoFile", &( this->m_IterationInfoFileStream ) );
   }
 
 } // end OpenIterationInfoFile()
@@ -1281,6 +2951,19 @@ ElastixTemplate< TFixedImage, TMovingImage >::GetConfiguration( const size_t ind
 }
 
 
+/**
+ * ************** GetNumberOfConfigurations *********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+size_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::GetNumberOfConfigurations( void ) const
+{
+  return this->m_Configurations.size();
+}
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxElastixTemplate_hxx
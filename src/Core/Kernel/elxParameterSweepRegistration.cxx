@@ -0,0 +1,732 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxParameterSweepRegistration.h"
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkParameterFileParser.h"
+#include "itkTimeProbe.h"
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace elastix
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+ParameterSweepRegistration::ParameterSweepRegistration()
+{
+  this->m_NumberOfWorkers = 0;
+  this->m_ImageDimension  = 0;
+  this->m_NextWorkUnit    = 0;
+  this->m_EntryFinished   = itk::ConditionVariable::New();
+
+} // end Constructor
+
+
+/**
+ * ********************* Run ****************************
+ */
+
+int
+ParameterSweepRegistration::Run( const ArgumentMapType & argMap,
+  const std::vector< std::string > & parameterFileNames )
+{
+  if( !this->ReadInput( argMap, parameterFileNames ) )
+  {
+    return -1;
+  }
+
+  const unsigned int numberOfEntries = this->m_Entries.size();
+  unsigned int       numberOfWorkers = this->m_NumberOfWorkers;
+  if( numberOfWorkers == 0 )
+  {
+    numberOfWorkers = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  }
+  numberOfWorkers = std::min( numberOfWorkers, numberOfEntries );
+  numberOfWorkers = std::min( numberOfWorkers, static_cast< unsigned int >( ITK_MAX_THREADS ) );
+  numberOfWorkers = std::max( numberOfWorkers, 1u );
+
+  this->MakeWorkUnits( numberOfWorkers );
+  numberOfWorkers = std::min( numberOfWorkers,
+    static_cast< unsigned int >( this->m_WorkUnits.size() ) );
+
+  /** Divide the threads among the registrations. Each registration sets the
+   * maximum number of threads of ITK to the same value. */
+  unsigned int numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  ArgumentMapType::const_iterator threadsArgument = argMap.find( "-threads" );
+  if( threadsArgument != argMap.end() && atoi( threadsArgument->second.c_str() ) > 0 )
+  {
+    numberOfThreads = atoi( threadsArgument->second.c_str() );
+  }
+  const unsigned int threadsPerRegistration = std::max( numberOfThreads / numberOfWorkers, 1u );
+  std::ostringstream threads( "" );
+  threads << threadsPerRegistration;
+  this->m_EntryArgumentMap[ "-threads" ] = threads.str();
+
+  elxout << "Running " << numberOfEntries << " registrations in "
+         << this->m_WorkUnits.size() << " groups, with " << numberOfWorkers
+         << " concurrent registrations of " << threadsPerRegistration
+         << " threads.\n" << std::endl;
+
+  /** Start the workers, see SliceBatchRegistration. */
+  this->m_NextWorkUnit = 0;
+  this->m_FinishedEntries.clear();
+  itk::MultiThreader::Pointer      spawner = itk::MultiThreader::New();
+  std::vector< itk::ThreadIdType > threadIds;
+  for( unsigned int i = 0; i < numberOfWorkers; ++i )
+  {
+    threadIds.push_back( spawner->SpawnThread(
+      ParameterSweepRegistration::WorkerThreadCallback, this ) );
+  }
+
+  /** Report the entries as they finish. */
+  std::vector< EntryResultType > results( numberOfEntries );
+  unsigned int                   numberOfFailedEntries   = 0;
+  unsigned int                   numberOfReportedEntries = 0;
+  this->m_Mutex.Lock();
+  while( numberOfReportedEntries < numberOfEntries )
+  {
+    while( this->m_FinishedEntries.empty() )
+    {
+      this->m_EntryFinished->Wait( &this->m_Mutex );
+    }
+    const EntryResultType result = this->m_FinishedEntries.front();
+    this->m_FinishedEntries.pop_front();
+    this->m_Mutex.Unlock();
+
+    results[ result.m_Entry ] = result;
+    ++numberOfReportedEntries;
+    const EntryType & entry = this->m_Entries[ result.m_Entry ];
+    elxout << "Entry " << result.m_Entry << " ("
+           << numberOfReportedEntries << "/" << numberOfEntries << "), "
+           << entry.m_ParameterFileName;
+    if( !entry.m_Overrides.empty() )
+    {
+      elxout << " with " << entry.m_Overrides;
+    }
+    if( result.m_ErrorCode == 0 )
+    {
+      std::ostringstream time( "" );
+      time << std::fixed << std::setprecision( 2 ) << result.m_Time;
+      elxout << ", was registered in " << time.str() << " s." << std::endl;
+    }
+    else
+    {
+      ++numberOfFailedEntries;
+      elxout << ", failed with error code " << result.m_ErrorCode
+             << ", see its elastix.log." << std::endl;
+    }
+
+    this->m_Mutex.Lock();
+  }
+  this->m_Mutex.Unlock();
+
+  /** TerminateThread() joins the thread. */
+  for( std::size_t i = 0; i < threadIds.size(); ++i )
+  {
+    spawner->TerminateThread( threadIds[ i ] );
+  }
+
+  this->WriteSummary( results );
+
+  if( numberOfFailedEntries > 0 )
+  {
+    xl::xout[ "error" ] << "ERROR: " << numberOfFailedEntries << " of the "
+                        << numberOfEntries << " registrations failed." << std::endl;
+  }
+
+  this->m_FixedImage  = 0;
+  this->m_MovingImage = 0;
+  this->m_FixedMask   = 0;
+  this->m_MovingMask  = 0;
+  return static_cast< int >( numberOfFailedEntries );
+
+} // end Run()
+
+
+/**
+ * ********************* ReadInput ****************************
+ */
+
+bool
+ParameterSweepRegistration::ReadInput( const ArgumentMapType & argMap,
+  const std::vector< std::string > & parameterFileNames )
+{
+  typedef ArgumentMapType::const_iterator ArgumentIteratorType;
+
+  ArgumentIteratorType outArgument = argMap.find( "-out" );
+  if( argMap.find( "-f" ) == argMap.end() || argMap.find( "-m" ) == argMap.end()
+    || outArgument == argMap.end() )
+  {
+    xl::xout[ "error" ] << "ERROR: -sweep requires a fixed image \"-f\", "
+                        << "a moving image \"-m\" and \"-out\"." << std::endl;
+    return false;
+  }
+  this->m_OutputDirectory = outArgument->second;
+
+  GridType grid;
+  if( !this->ReadGrid( grid ) )
+  {
+    return false;
+  }
+
+  /** Make the entries: every parameter file with every point of the grid.
+   * The images are float images. */
+  this->m_Entries.clear();
+  this->m_ImageDimension = 0;
+  for( std::size_t i = 0; i < parameterFileNames.size(); ++i )
+  {
+    itk::ParameterFileParser::Pointer parser = itk::ParameterFileParser::New();
+    parser->SetParameterFileName( parameterFileNames[ i ] );
+    try
+    {
+      parser->ReadParameterFile();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << "ERROR: the parameter file \"" << parameterFileNames[ i ]
+                          << "\" could not be read.\n" << excp << std::endl;
+      return false;
+    }
+
+    ParameterMapType parameterMap = parser->GetParameterMap();
+    parameterMap[ "FixedInternalImagePixelType" ]  = std::vector< std::string >( 1, "float" );
+    parameterMap[ "MovingInternalImagePixelType" ] = std::vector< std::string >( 1, "float" );
+
+    /** The image dimension of all entries must be the same. */
+    const ParameterMapType::const_iterator fixedDimension  = parameterMap.find( "FixedImageDimension" );
+    const ParameterMapType::const_iterator movingDimension = parameterMap.find( "MovingImageDimension" );
+    unsigned int                           dimension       = 0;
+    if( fixedDimension != parameterMap.end() && movingDimension != parameterMap.end()
+      && fixedDimension->second.size() == 1 && fixedDimension->second == movingDimension->second )
+    {
+      dimension = atoi( fixedDimension->second[ 0 ].c_str() );
+    }
+    if( ( dimension != 2 && dimension != 3 )
+      || ( this->m_ImageDimension != 0 && dimension != this->m_ImageDimension ) )
+    {
+      xl::xout[ "error" ] << "ERROR: the parameter file \"" << parameterFileNames[ i ]
+                          << "\" has another image dimension than 2 or 3, or than the other"
+                          << " parameter files of the sweep." << std::endl;
+      return false;
+    }
+    this->m_ImageDimension = dimension;
+
+    /** Walk through the points of the grid, with the last parameter
+     * changing fastest. */
+    std::vector< std::size_t > point( grid.size(), 0 );
+    while( true )
+    {
+      EntryType entry;
+      entry.m_ParameterFileName = parameterFileNames[ i ];
+      entry.m_ParameterMap      = parameterMap;
+      for( std::size_t j = 0; j < grid.size(); ++j )
+      {
+        const std::string & value = grid[ j ].second[ point[ j ] ];
+        std::vector< std::string > values;
+        std::istringstream         valueStream( value );
+        std::string                word;
+        while( valueStream >> word )
+        {
+          values.push_back( word );
+        }
+        entry.m_ParameterMap[ grid[ j ].first ] = values;
+        entry.m_Overrides += ( j > 0 ? " " : "" ) + ( "(" + grid[ j ].first + " " + value + ")" );
+      }
+      this->m_Entries.push_back( entry );
+
+      std::size_t j = grid.size();
+      while( j > 0 && ++point[ j - 1 ] == grid[ j - 1 ].second.size() )
+      {
+        point[ j - 1 ] = 0;
+        --j;
+      }
+      if( j == 0 )
+      {
+        break;
+      }
+    }
+  }
+  if( this->m_Entries.empty() )
+  {
+    xl::xout[ "error" ] << "ERROR: the sweep has no registrations." << std::endl;
+    return false;
+  }
+
+  /** Read the images once. */
+  const bool imagesRead = this->m_ImageDimension == 2
+    ? this->ReadImages< 2 >( argMap ) : this->ReadImages< 3 >( argMap );
+  if( !imagesRead )
+  {
+    return false;
+  }
+
+  /** The arguments of every entry. The images are given in memory; -f and
+   * -m are kept for the log, but the images are not read again. The
+   * arguments of the sweep itself are left out. */
+  this->m_EntryArgumentMap.clear();
+  for( ArgumentIteratorType it = argMap.begin(); it != argMap.end(); ++it )
+  {
+    const std::string & key = it->first;
+    if( key == "-fMask" || key == "-mMask" || key == "-out" || key == "-threads" || key == "-sweep"
+      || key == "-sweepgrid" || key == "-trace" || key == "-resume" || key == "-resultcache"
+      || key == "-resultcachesize" || key == "-statusfile" || key == "-statusinterval"
+      || key == "-p" || key.compare( 0, 3, "-p(" ) == 0 )
+    {
+      continue;
+    }
+    this->m_EntryArgumentMap.insert( *it );
+  }
+
+  return true;
+
+} // end ReadInput()
+
+
+/**
+ * ********************* ReadGrid ****************************
+ */
+
+bool
+ParameterSweepRegistration::ReadGrid( GridType & grid ) const
+{
+  grid.clear();
+  if( this->m_GridFileName.empty() )
+  {
+    return true;
+  }
+
+  itk::ParameterFileParser::Pointer parser = itk::ParameterFileParser::New();
+  parser->SetParameterFileName( this->m_GridFileName );
+  try
+  {
+    parser->ReadParameterFile();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    xl::xout[ "error" ] << "ERROR: the grid file \"" << this->m_GridFileName
+                        << "\" could not be read.\n" << excp << std::endl;
+    return false;
+  }
+
+  const ParameterMapType & gridMap = parser->GetParameterMap();
+  for( ParameterMapType::const_iterator it = gridMap.begin(); it != gridMap.end(); ++it )
+  {
+    if( it->second.empty() )
+    {
+      xl::xout[ "error" ] << "ERROR: the parameter " << it->first << " of the grid file \""
+                          << this->m_GridFileName << "\" has no values." << std::endl;
+      return false;
+    }
+    grid.push_back( OverrideType( it->first, it->second ) );
+  }
+  return true;
+
+} // end ReadGrid()
+
+
+/**
+ * ********************* ReadImages ****************************
+ */
+
+template< unsigned int VDimension >
+bool
+ParameterSweepRegistration::ReadImages( const ArgumentMapType & argMap )
+{
+  typedef itk::Image< float, VDimension >         ImageType;
+  typedef itk::Image< unsigned char, VDimension > MaskType;
+  typedef itk::ImageFileReader< ImageType >       ImageReaderType;
+  typedef itk::ImageFileReader< MaskType >        MaskReaderType;
+  typedef ArgumentMapType::const_iterator         ArgumentIteratorType;
+
+  this->m_FixedMask  = 0;
+  this->m_MovingMask = 0;
+  try
+  {
+    typename ImageReaderType::Pointer fixedReader = ImageReaderType::New();
+    fixedReader->SetFileName( argMap.find( "-f" )->second );
+    fixedReader->Update();
+    this->m_FixedImage = fixedReader->GetOutput();
+    this->m_FixedImage->DisconnectPipeline();
+
+    typename ImageReaderType::Pointer movingReader = ImageReaderType::New();
+    movingReader->SetFileName( argMap.find( "-m" )->second );
+    movingReader->Update();
+    this->m_MovingImage = movingReader->GetOutput();
+    this->m_MovingImage->DisconnectPipeline();
+
+    ArgumentIteratorType fixedMaskArgument = argMap.find( "-fMask" );
+    if( fixedMaskArgument != argMap.end() )
+    {
+      typename MaskReaderType::Pointer maskReader = MaskReaderType::New();
+      maskReader->SetFileName( fixedMaskArgument->second );
+      maskReader->Update();
+      this->m_FixedMask = maskReader->GetOutput();
+      this->m_FixedMask->DisconnectPipeline();
+    }
+
+    ArgumentIteratorType movingMaskArgument = argMap.find( "-mMask" );
+    if( movingMaskArgument != argMap.end() )
+    {
+      typename MaskReaderType::Pointer maskReader = MaskReaderType::New();
+      maskReader->SetFileName( movingMaskArgument->second );
+      maskReader->Update();
+      this->m_MovingMask = maskReader->GetOutput();
+      this->m_MovingMask->DisconnectPipeline();
+    }
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    xl::xout[ "error" ] << "ERROR: the images could not be read.\n" << excp << std::endl;
+    return false;
+  }
+  return true;
+
+} // end ReadImages()
+
+
+/**
+ * ********************* ShallowCopy ****************************
+ */
+
+template< class TImage >
+itk::DataObject::Pointer
+ParameterSweepRegistration::ShallowCopy( const itk::DataObject * object )
+{
+  const TImage *           image = static_cast< const TImage * >( object );
+  typename TImage::Pointer copy  = TImage::New();
+  copy->CopyInformation( image );
+  copy->SetRegions( image->GetLargestPossibleRegion() );
+  copy->SetPixelContainer( const_cast< typename TImage::PixelContainer * >(
+    image->GetPixelContainer() ) );
+  return copy.GetPointer();
+
+} // end ShallowCopy()
+
+
+/**
+ * ********************* ShallowCopyImage ****************************
+ */
+
+itk::DataObject::Pointer
+ParameterSweepRegistration::ShallowCopyImage( const itk::DataObject * object ) const
+{
+  if( this->m_ImageDimension == 2 )
+  {
+    return ShallowCopy< itk::Image< float, 2 > >( object );
+  }
+  return ShallowCopy< itk::Image< float, 3 > >( object );
+
+} // end ShallowCopyImage()
+
+
+/**
+ * ********************* ShallowCopyMask ****************************
+ */
+
+itk::DataObject::Pointer
+ParameterSweepRegistration::ShallowCopyMask( const itk::DataObject * object ) const
+{
+  if( this->m_ImageDimension == 2 )
+  {
+    return ShallowCopy< itk::Image< unsigned char, 2 > >( object );
+  }
+  return ShallowCopy< itk::Image< unsigned char, 3 > >( object );
+
+} // end ShallowCopyMask()
+
+
+/**
+ * ********************* GetGroupKey ****************************
+ */
+
+std::string
+ParameterSweepRegistration::GetGroupKey( const ParameterMapType & parameterMap )
+{
+  /** The parameters of the fixed image pyramid and of the masks; the
+   * pyramid cache itself checks the schedules, see ElastixTemplate. */
+  std::ostringstream key( "" );
+  for( ParameterMapType::const_iterator it = parameterMap.begin(); it != parameterMap.end(); ++it )
+  {
+    const std::string & name = it->first;
+    if( name.find( "Pyramid" ) != std::string::npos
+      || name == "NumberOfResolutions" || name == "FixedImageDimension"
+      || name.compare( 0, 5, "Erode" ) == 0 || name == "CropImagesToMasks"
+      || name == "MaskBoundingBoxMargin" )
+    {
+      key << "(" << name;
+      for( std::size_t i = 0; i < it->second.size(); ++i )
+      {
+        key << " " << it->second[ i ];
+      }
+      key << ")";
+    }
+  }
+  return key.str();
+
+} // end GetGroupKey()
+
+
+/**
+ * ********************* MakeWorkUnits ****************************
+ */
+
+void
+ParameterSweepRegistration::MakeWorkUnits( const unsigned int numberOfWorkers )
+{
+  /** Group the entries, in the order of their first entry. */
+  std::map< std::string, std::size_t > groups;
+  this->m_WorkUnits.clear();
+  for( unsigned int i = 0; i < this->m_Entries.size(); ++i )
+  {
+    const std::string key = GetGroupKey( this->m_Entries[ i ].m_ParameterMap );
+    std::map< std::string, std::size_t >::const_iterator group = groups.find( key );
+    if( group == groups.end() )
+    {
+      groups[ key ] = this->m_WorkUnits.size();
+      this->m_WorkUnits.push_back( std::vector< unsigned int >( 1, i ) );
+    }
+    else
+    {
+      this->m_WorkUnits[ group->second ].push_back( i );
+    }
+  }
+
+  /** Keep the workers busy: split the largest unit in halves, which costs
+   * one more computation of its pyramid. */
+  while( this->m_WorkUnits.size() < numberOfWorkers )
+  {
+    std::size_t largest = 0;
+    for( std::size_t i = 1; i < this->m_WorkUnits.size(); ++i )
+    {
+      if( this->m_WorkUnits[ i ].size() > this->m_WorkUnits[ largest ].size() )
+      {
+        largest = i;
+      }
+    }
+    std::vector< unsigned int > & unit = this->m_WorkUnits[ largest ];
+    if( unit.size() < 2 )
+    {
+      break;
+    }
+    const std::size_t           half = unit.size() / 2;
+    std::vector< unsigned int > secondHalf( unit.begin() + half, unit.end() );
+    unit.resize( half );
+    this->m_WorkUnits.push_back( secondHalf );
+  }
+
+} // end MakeWorkUnits()
+
+
+/**
+ * ********************* RegisterEntry ****************************
+ */
+
+int
+ParameterSweepRegistration::RegisterEntry( const unsigned int entry,
+  const DataObjectContainerPointer & fixedImageContainer,
+  const DataObjectContainerPointer & movingImageContainer,
+  const DataObjectContainerPointer & fixedMaskContainer,
+  const DataObjectContainerPointer & movingMaskContainer,
+  const DataObjectContainerPointer & pyramidCache, std::string & pyramidCacheKey )
+{
+  /** The output directory of the entry. */
+  std::ostringstream makeDirectory( "" );
+  makeDirectory << this->m_OutputDirectory << "sweep"
+                << std::setfill( '0' ) << std::setw( 4 ) << entry << "/";
+  const std::string directory = makeDirectory.str();
+  if( !itksys::SystemTools::MakeDirectory( directory.c_str() ) )
+  {
+    return 1;
+  }
+
+  /** The log of the entry is kept apart from the others. */
+  xoutManager       manager;
+  const std::string logFileName = directory + "elastix.log";
+  if( xoutSetup( manager, logFileName.c_str(), true, false ) )
+  {
+    return 1;
+  }
+
+  ArgumentMapType argMap = this->m_EntryArgumentMap;
+  argMap[ "-out" ] = directory;
+  argMap[ "-p" ]   = this->m_Entries[ entry ].m_ParameterFileName;
+  ParameterMapType parameterMap = this->m_Entries[ entry ].m_ParameterMap;
+  if( !this->m_Entries[ entry ].m_Overrides.empty() )
+  {
+    elxout << "The parameters are overridden by the sweep grid: "
+           << this->m_Entries[ entry ].m_Overrides << "\n" << std::endl;
+  }
+
+  ElastixMain::Pointer elastix = ElastixMain::New();
+  elastix->SetFixedImageContainer( fixedImageContainer );
+  elastix->SetMovingImageContainer( movingImageContainer );
+  elastix->SetFixedMaskContainer( fixedMaskContainer );
+  elastix->SetMovingMaskContainer( movingMaskContainer );
+  elastix->SetFixedImagePyramidCacheContainer( pyramidCache );
+  elastix->SetFixedImagePyramidCacheKey( pyramidCacheKey );
+
+  int errorCode = 0;
+  try
+  {
+    errorCode = elastix->Run( argMap, parameterMap );
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    xl::xout[ "error" ] << "Exception while running entry " << entry << " of the sweep:\n"
+                        << excp << std::endl;
+    errorCode = 1;
+  }
+
+  /** A failed run may leave an incomplete cache behind. */
+  if( errorCode == 0 )
+  {
+    pyramidCacheKey = elastix->GetFixedImagePyramidCacheKey();
+  }
+  else
+  {
+    pyramidCacheKey = "";
+    pyramidCache->Initialize();
+  }
+  return errorCode;
+
+} // end RegisterEntry()
+
+
+/**
+ * ********************* WriteSummary ****************************
+ */
+
+void
+ParameterSweepRegistration::WriteSummary( const std::vector< EntryResultType > & results ) const
+{
+  const std::string fileName = this->m_OutputDirectory + "Sweep.txt";
+  std::ofstream     summary( fileName.c_str() );
+  if( !summary.is_open() )
+  {
+    xl::xout[ "warning" ] << "WARNING: the summary of the sweep could not be written to \""
+                          << fileName << "\"." << std::endl;
+    return;
+  }
+
+  summary << "entry\tparameter file\toverrides\terror code\ttime (s)\n";
+  for( std::size_t i = 0; i < results.size(); ++i )
+  {
+    const EntryType & entry = this->m_Entries[ i ];
+    summary << "sweep" << std::setfill( '0' ) << std::setw( 4 ) << i << std::setfill( ' ' )
+            << "\t" << entry.m_ParameterFileName << "\t" << entry.m_Overrides
+            << "\t" << results[ i ].m_ErrorCode << "\t"
+            << std::fixed << std::setprecision( 2 ) << results[ i ].m_Time << "\n";
+  }
+
+} // end WriteSummary()
+
+
+/**
+ * ********************* WorkerThreadCallback ****************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+ParameterSweepRegistration::WorkerThreadCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  static_cast< ParameterSweepRegistration * >( infoStruct->UserData )->WorkerLoop();
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WorkerThreadCallback()
+
+
+/**
+ * ********************* WorkerLoop ****************************
+ */
+
+void
+ParameterSweepRegistration::WorkerLoop( void )
+{
+  const unsigned int numberOfWorkUnits = this->m_WorkUnits.size();
+  while( true )
+  {
+    this->m_Mutex.Lock();
+    const unsigned int workUnit = this->m_NextWorkUnit;
+    if( workUnit < numberOfWorkUnits )
+    {
+      ++this->m_NextWorkUnit;
+    }
+    this->m_Mutex.Unlock();
+    if( workUnit >= numberOfWorkUnits )
+    {
+      break;
+    }
+
+    /** The images of the work unit share the pixels with the other units,
+     * and are the same for all its entries, so that the pyramid cache,
+     * which is keyed by the fixed image, is hit. */
+    DataObjectContainerPointer fixedImageContainer  = DataObjectContainerType::New();
+    DataObjectContainerPointer movingImageContainer = DataObjectContainerType::New();
+    DataObjectContainerPointer fixedMaskContainer   = 0;
+    DataObjectContainerPointer movingMaskContainer  = 0;
+    DataObjectContainerPointer pyramidCache         = DataObjectContainerType::New();
+    std::string                pyramidCacheKey      = "";
+    fixedImageContainer->CreateElementAt( 0 )  = this->ShallowCopyImage( this->m_FixedImage );
+    movingImageContainer->CreateElementAt( 0 ) = this->ShallowCopyImage( this->m_MovingImage );
+    if( this->m_FixedMask.IsNotNull() )
+    {
+      fixedMaskContainer = DataObjectContainerType::New();
+      fixedMaskContainer->CreateElementAt( 0 ) = this->ShallowCopyMask( this->m_FixedMask );
+    }
+    if( this->m_MovingMask.IsNotNull() )
+    {
+      movingMaskContainer = DataObjectContainerType::New();
+      movingMaskContainer->CreateElementAt( 0 ) = this->ShallowCopyMask( this->m_MovingMask );
+    }
+
+    const std::vector< unsigned int > & entries = this->m_WorkUnits[ workUnit ];
+    for( std::size_t i = 0; i < entries.size(); ++i )
+    {
+      EntryResultType result;
+      result.m_Entry = entries[ i ];
+      itk::TimeProbe timer;
+      timer.Start();
+      result.m_ErrorCode = this->RegisterEntry( entries[ i ], fixedImageContainer,
+        movingImageContainer, fixedMaskContainer, movingMaskContainer,
+        pyramidCache, pyramidCacheKey );
+      timer.Stop();
+      result.m_Time = timer.GetTotal();
+
+      this->m_Mutex.Lock();
+      this->m_FinishedEntries.push_back( result );
+      this->m_EntryFinished->Signal();
+      this->m_Mutex.Unlock();
+    }
+  }
+
+} // end WorkerLoop()
+
+
+} // end namespace elastix
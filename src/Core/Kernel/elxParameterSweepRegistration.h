@@ -0,0 +1,199 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxParameterSweepRegistration_h
+#define __elxParameterSweepRegistration_h
+
+#include "elxElastixMain.h"
+
+#include "itkMultiThreader.h"
+#include "itkSimpleMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * \class ParameterSweepRegistration
+ * \brief Registers one image pair with many parameter files, in one process.
+ *
+ * When parameter files are tuned, elastix is run many times on the same
+ * images with different settings. In a sweep every parameter file is an
+ * independent registration, rather than a step of a chain, and optionally
+ * every parameter file is combined with every point of a grid of parameter
+ * overrides. The images and masks are read and cast once, and the
+ * registrations run concurrently, with the threads of the machine divided
+ * among them.
+ *
+ * Registrations whose fixed image pyramid is the same, as far as the
+ * parameters with "Pyramid" in their name, NumberOfResolutions, and the
+ * mask settings tell, are put in one group. A group is registered by one
+ * worker, one after the other, so that the fixed image pyramid of the first
+ * is reused by the others, see ElastixMain::SetFixedImagePyramidCacheContainer().
+ * Large groups are split when there are fewer groups than workers.
+ *
+ * The results of entry k, such as TransformParameters.0.txt, the result
+ * image and the log file, are written to the subdirectory sweep<k> of the
+ * output directory, with k in four digits. A table of the entries, with
+ * their parameter file, overrides, error code and time, is written to
+ * Sweep.txt in the output directory. The images are registered as float,
+ * whatever FixedInternalImagePixelType says, and all parameter files must
+ * have the same image dimension, 2 or 3.
+ *
+ * The grid file has the syntax of a parameter file. Each value of a
+ * parameter is an alternative, and a value with spaces holds the values
+ * of one alternative:\n
+ *   <tt>(MaximumNumberOfIterations "250" "500" "1000")</tt>\n
+ *   <tt>(FinalGridSpacingInVoxels "8 8 8" "16 16 16")</tt>\n
+ * gives six overrides for every parameter file.
+ *
+ * The elastix executable uses this class when the -sweep command line
+ * argument is given, with the number of concurrent registrations, or 0
+ * for the number of CPUs, and optionally -sweepgrid with the grid file.
+ */
+
+class ParameterSweepRegistration
+{
+public:
+
+  typedef ElastixMain::ArgumentMapType  ArgumentMapType;
+  typedef ElastixMain::ParameterMapType ParameterMapType;
+
+  ParameterSweepRegistration();
+  ~ParameterSweepRegistration() {}
+
+  /** The number of concurrent registrations; 0 for the default number of
+   * threads of ITK, which is the number of CPUs. Default: 0. */
+  void SetNumberOfWorkers( const unsigned int n ) { this->m_NumberOfWorkers = n; }
+  unsigned int GetNumberOfWorkers( void ) const { return this->m_NumberOfWorkers; }
+
+  /** The file with the grid of parameter overrides; empty for none.
+   * Default: empty. */
+  void SetGridFileName( const std::string & name ) { this->m_GridFileName = name; }
+  const std::string & GetGridFileName( void ) const { return this->m_GridFileName; }
+
+  /** Run all registrations of the sweep. The argument map holds the command
+   * line arguments: -f, -m, -out, and optionally -fMask, -mMask, -t0 and
+   * -threads, the number of threads of the whole sweep. Progress is written
+   * to xout. Returns 0 when all registrations succeeded, the number of
+   * failed registrations otherwise, or -1 if the input could not be read.
+   */
+  int Run( const ArgumentMapType & argMap,
+    const std::vector< std::string > & parameterFileNames );
+
+private:
+
+  ParameterSweepRegistration( const ParameterSweepRegistration & ); // purposely not implemented
+  void operator=( const ParameterSweepRegistration & );             // purposely not implemented
+
+  typedef ElastixMain::DataObjectContainerType    DataObjectContainerType;
+  typedef ElastixMain::DataObjectContainerPointer DataObjectContainerPointer;
+  typedef std::pair< std::string, std::vector< std::string > > OverrideType;
+  typedef std::vector< OverrideType >                          GridType;
+
+  /** A registration of the sweep: a parameter file with overrides. */
+  struct EntryType
+  {
+    std::string      m_ParameterFileName;
+    std::string      m_Overrides;
+    ParameterMapType m_ParameterMap;
+  };
+
+  /** The outcome of the registration of an entry. */
+  struct EntryResultType
+  {
+    unsigned int m_Entry;
+    int          m_ErrorCode;
+    double       m_Time;
+  };
+
+  /** Read the parameter files, the grid and the images, and make the
+   * entries. Returns false on failure, after writing the error to xout. */
+  bool ReadInput( const ArgumentMapType & argMap,
+    const std::vector< std::string > & parameterFileNames );
+
+  /** Read the grid file into a list of parameters with their alternatives. */
+  bool ReadGrid( GridType & grid ) const;
+
+  /** Read the images and masks as float and unsigned char images. */
+  template< unsigned int VDimension >
+  bool ReadImages( const ArgumentMapType & argMap );
+
+  /** An image that shares the pixels of the given one, but not its
+   * information, so that registrations may change the latter. */
+  template< class TImage >
+  static itk::DataObject::Pointer ShallowCopy( const itk::DataObject * object );
+
+  itk::DataObject::Pointer ShallowCopyImage( const itk::DataObject * object ) const;
+
+  itk::DataObject::Pointer ShallowCopyMask( const itk::DataObject * object ) const;
+
+  /** A string that is equal for entries with the same fixed image pyramid. */
+  static std::string GetGroupKey( const ParameterMapType & parameterMap );
+
+  /** Divide the entries into work units of equal group keys. */
+  void MakeWorkUnits( const unsigned int numberOfWorkers );
+
+  /** Run the registration of one entry, in the calling thread. Returns the
+   * error code of elastix. */
+  int RegisterEntry( const unsigned int entry,
+    const DataObjectContainerPointer & fixedImageContainer,
+    const DataObjectContainerPointer & movingImageContainer,
+    const DataObjectContainerPointer & fixedMaskContainer,
+    const DataObjectContainerPointer & movingMaskContainer,
+    const DataObjectContainerPointer & pyramidCache, std::string & pyramidCacheKey );
+
+  /** Write the table of the entries to Sweep.txt. */
+  void WriteSummary( const std::vector< EntryResultType > & results ) const;
+
+  /** The loop of a worker thread, which registers work units until there
+   * are none left. */
+  static ITK_THREAD_RETURN_TYPE WorkerThreadCallback( void * arg );
+
+  void WorkerLoop( void );
+
+  unsigned int m_NumberOfWorkers;
+  std::string  m_GridFileName;
+
+  /** The input, shared read-only by the workers. */
+  unsigned int                              m_ImageDimension;
+  itk::DataObject::Pointer                  m_FixedImage;
+  itk::DataObject::Pointer                  m_MovingImage;
+  itk::DataObject::Pointer                  m_FixedMask;
+  itk::DataObject::Pointer                  m_MovingMask;
+  std::vector< EntryType >                  m_Entries;
+  std::vector< std::vector< unsigned int > > m_WorkUnits;
+  ArgumentMapType                           m_EntryArgumentMap;
+  std::string                               m_OutputDirectory;
+
+  /** The next work unit to register, and the finished entries, guarded
+   * by m_Mutex. */
+  unsigned int                    m_NextWorkUnit;
+  std::deque< EntryResultType >   m_FinishedEntries;
+  itk::SimpleMutexLock            m_Mutex;
+  itk::ConditionVariable::Pointer m_EntryFinished;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxParameterSweepRegistration_h
@@ -0,0 +1,391 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxPerformanceTrace.h"
+
+#include "itkCommand.h"
+#include "itkEventObject.h"
+#include "itkMultiThreader.h"
+
+#if !defined( _WIN32 )
+#include <sys/resource.h>
+#endif
+
+namespace elastix
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+PerformanceTrace::PerformanceTrace()
+{
+  this->m_JSON                           = false;
+  this->m_PreviousSamplerTime            = 0.0;
+  this->m_SamplerCountsStarted           = false;
+  this->m_PreviousValueTime              = 0.0;
+  this->m_PreviousDerivativeTime         = 0.0;
+  this->m_PreviousValueAndDerivativeTime = 0.0;
+  this->m_PreviousNumberOfEvaluations    = 0;
+  this->m_PeakMemory                     = 0;
+
+} // end Constructor
+
+
+/**
+ * ********************* Destructor ****************************
+ */
+
+PerformanceTrace::~PerformanceTrace()
+{
+  this->Close();
+
+} // end Destructor
+
+
+/**
+ * ********************* Open ****************************
+ */
+
+bool
+PerformanceTrace::Open( const std::string & fileName, const bool json )
+{
+  this->Close();
+
+  this->m_File.open( fileName.c_str() );
+  if( !this->m_File.is_open() )
+  {
+    return false;
+  }
+
+  this->m_JSON = json;
+  if( !json )
+  {
+    this->m_File << "resolution,iteration,time,value,derivative,valueAndDerivative,"
+                 << "evaluations,sampler,optimizer,log,samples,threads,memory,peakMemory\n";
+  }
+  return true;
+
+} // end Open()
+
+
+/**
+ * ********************* Close ****************************
+ */
+
+void
+PerformanceTrace::Close( void )
+{
+  for( std::size_t i = 0; i < this->m_Samplers.size(); ++i )
+  {
+    this->m_Samplers[ i ]->RemoveObserver( this->m_SamplerObserverTags[ 2 * i ] );
+    this->m_Samplers[ i ]->RemoveObserver( this->m_SamplerObserverTags[ 2 * i + 1 ] );
+  }
+  this->m_Samplers.clear();
+  this->m_SamplerObserverTags.clear();
+  this->m_CostFunction = 0;
+
+  if( this->m_File.is_open() )
+  {
+    this->m_File.close();
+  }
+
+} // end Close()
+
+
+/**
+ * ********************* ObserveSampler ****************************
+ */
+
+void
+PerformanceTrace::ObserveSampler( itk::Object * sampler )
+{
+  if( sampler == 0 )
+  {
+    return;
+  }
+
+  typedef itk::SimpleMemberCommand< PerformanceTrace > CommandType;
+  CommandType::Pointer startCommand = CommandType::New();
+  startCommand->SetCallbackFunction( this, &PerformanceTrace::SamplerStarted );
+  CommandType::Pointer endCommand = CommandType::New();
+  endCommand->SetCallbackFunction( this, &PerformanceTrace::SamplerEnded );
+
+  this->m_Samplers.push_back( sampler );
+  this->m_SamplerObserverTags.push_back( sampler->AddObserver( itk::StartEvent(), startCommand ) );
+  this->m_SamplerObserverTags.push_back( sampler->AddObserver( itk::EndEvent(), endCommand ) );
+
+} // end ObserveSampler()
+
+
+/**
+ * ********************* SamplerStarted ****************************
+ */
+
+void
+PerformanceTrace::SamplerStarted( void )
+{
+  this->m_SamplerTimer.Start();
+  this->m_SamplerCountsStarted = itk::HardwareCounters::IsEnabled()
+    && itk::HardwareCounters::Read( this->m_SamplerCountsStart );
+
+} // end SamplerStarted()
+
+
+/**
+ * ********************* SamplerEnded ****************************
+ */
+
+void
+PerformanceTrace::SamplerEnded( void )
+{
+  this->m_SamplerTimer.Stop();
+  if( this->m_SamplerCountsStarted )
+  {
+    itk::HardwareCounters::AddSince( "ImageSampler", 0, this->m_SamplerCountsStart );
+    this->m_SamplerCountsStarted = false;
+  }
+
+} // end SamplerEnded()
+
+
+/**
+ * ********************* StartResolution ****************************
+ */
+
+void
+PerformanceTrace::StartResolution( const CostFunctionType * costFunction )
+{
+  this->m_PreviousSamplerTime = this->m_SamplerTimer.GetTotal();
+  this->m_CostFunction        = costFunction;
+  if( costFunction )
+  {
+    this->m_PreviousValueTime              = costFunction->GetValueTimer().GetTotal();
+    this->m_PreviousDerivativeTime         = costFunction->GetDerivativeTimer().GetTotal();
+    this->m_PreviousValueAndDerivativeTime = costFunction->GetValueAndDerivativeTimer().GetTotal();
+    this->m_PreviousNumberOfEvaluations    = static_cast< unsigned long >(
+      costFunction->GetValueTimer().GetNumberOfStops()
+      + costFunction->GetDerivativeTimer().GetNumberOfStops()
+      + costFunction->GetValueAndDerivativeTimer().GetNumberOfStops() );
+  }
+
+} // end StartResolution()
+
+
+/**
+ * ********************* WriteIteration ****************************
+ */
+
+void
+PerformanceTrace::WriteIteration( const unsigned int resolution, const unsigned int iteration,
+  const double iterationTime, const double logTime,
+  const unsigned long numberOfSamples )
+{
+  if( !this->m_File.is_open() )
+  {
+    return;
+  }
+
+  /** The timings since the previous record, in seconds. */
+  const double samplerTotal = this->m_SamplerTimer.GetTotal();
+  const double samplerTime  = samplerTotal - this->m_PreviousSamplerTime;
+  this->m_PreviousSamplerTime = samplerTotal;
+
+  double        valueTime              = 0.0;
+  double        derivativeTime         = 0.0;
+  double        valueAndDerivativeTime = 0.0;
+  unsigned long numberOfEvaluations    = 0;
+  if( this->m_CostFunction.IsNotNull() )
+  {
+    const CostFunctionType * costFunction = this->m_CostFunction.GetPointer();
+    const double valueTotal              = costFunction->GetValueTimer().GetTotal();
+    const double derivativeTotal         = costFunction->GetDerivativeTimer().GetTotal();
+    const double valueAndDerivativeTotal = costFunction->GetValueAndDerivativeTimer().GetTotal();
+    const unsigned long evaluationsTotal = static_cast< unsigned long >(
+      costFunction->GetValueTimer().GetNumberOfStops()
+      + costFunction->GetDerivativeTimer().GetNumberOfStops()
+      + costFunction->GetValueAndDerivativeTimer().GetNumberOfStops() );
+
+    valueTime              = valueTotal - this->m_PreviousValueTime;
+    derivativeTime         = derivativeTotal - this->m_PreviousDerivativeTime;
+    valueAndDerivativeTime = valueAndDerivativeTotal - this->m_PreviousValueAndDerivativeTime;
+    numberOfEvaluations    = evaluationsTotal - this->m_PreviousNumberOfEvaluations;
+
+    this->m_PreviousValueTime              = valueTotal;
+    this->m_PreviousDerivativeTime         = derivativeTotal;
+    this->m_PreviousValueAndDerivativeTime = valueAndDerivativeTotal;
+    this->m_PreviousNumberOfEvaluations    = evaluationsTotal;
+  }
+
+  /** The samplers are usually updated inside the cost function. */
+  const double evaluationTime = valueTime + derivativeTime + valueAndDerivativeTime;
+  double       optimizerTime  = iterationTime - evaluationTime;
+  if( this->m_CostFunction.IsNull() )
+  {
+    optimizerTime -= samplerTime;
+  }
+  if( optimizerTime < 0.0 )
+  {
+    optimizerTime = 0.0;
+  }
+
+  const unsigned int numberOfThreads
+    = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  const MemoryLoadType memory = this->m_MemoryUsageObserver.GetMemoryUsage();
+  if( memory > this->m_PeakMemory )
+  {
+    this->m_PeakMemory = memory;
+  }
+
+  if( this->m_JSON )
+  {
+    this->m_File
+      << "{\"resolution\":" << resolution
+      << ",\"iteration\":" << iteration
+      << ",\"time\":" << iterationTime * 1000.0
+      << ",\"value\":" << valueTime * 1000.0
+      << ",\"derivative\":" << derivativeTime * 1000.0
+      << ",\"valueAndDerivative\":" << valueAndDerivativeTime * 1000.0
+      << ",\"evaluations\":" << numberOfEvaluations
+      << ",\"sampler\":" << samplerTime * 1000.0
+      << ",\"optimizer\":" << optimizerTime * 1000.0
+      << ",\"log\":" << logTime * 1000.0
+      << ",\"samples\":" << numberOfSamples
+      << ",\"threads\":" << numberOfThreads
+      << ",\"memory\":" << memory
+      << ",\"peakMemory\":" << this->m_PeakMemory
+      << "}\n";
+  }
+  else
+  {
+    this->m_File
+      << resolution << ',' << iteration << ','
+      << iterationTime * 1000.0 << ','
+      << valueTime * 1000.0 << ','
+      << derivativeTime * 1000.0 << ','
+      << valueAndDerivativeTime * 1000.0 << ','
+      << numberOfEvaluations << ','
+      << samplerTime * 1000.0 << ','
+      << optimizerTime * 1000.0 << ','
+      << logTime * 1000.0 << ','
+      << numberOfSamples << ','
+      << numberOfThreads << ','
+      << memory << ','
+      << this->m_PeakMemory << '\n';
+  }
+
+} // end WriteIteration()
+
+
+/**
+ * ********************* WriteMemoryAccounting ****************************
+ */
+
+void
+PerformanceTrace::WriteMemoryAccounting( const unsigned int resolution,
+  const MemoryAccountingType & accounting, const double projectedPeak )
+{
+  if( !this->m_File.is_open() || !this->m_JSON )
+  {
+    return;
+  }
+
+  this->m_File << "{\"resolution\":" << resolution << ",\"memoryAccounting\":{";
+  for( std::size_t i = 0; i < accounting.size(); ++i )
+  {
+    this->m_File
+      << ( i > 0 ? "," : "" )
+      << '"' << accounting[ i ].m_Name << "\":{\"current\":" << accounting[ i ].m_Current / 1024.0
+      << ",\"projected\":" << accounting[ i ].m_Projected / 1024.0 << '}';
+  }
+  this->m_File << "},\"projectedPeak\":" << projectedPeak / 1024.0 << "}\n";
+
+} // end WriteMemoryAccounting()
+
+
+/**
+ * ********************* WriteHardwareCounters ****************************
+ */
+
+void
+PerformanceTrace::WriteHardwareCounters( const unsigned int resolution,
+  const itk::HardwareCounters::TableType & table )
+{
+  if( !this->m_File.is_open() || !this->m_JSON )
+  {
+    return;
+  }
+
+  /** The counts are integers of up to 15 digits. */
+  const std::streamsize precision = this->m_File.precision( 15 );
+  typedef itk::HardwareCounters::TableType::const_iterator IteratorType;
+  for( IteratorType it = table.begin(); it != table.end(); ++it )
+  {
+    const itk::HardwareCounters::CountsType & counts = it->second;
+    this->m_File
+      << "{\"resolution\":" << resolution
+      << ",\"phase\":\"" << it->first.first << '"'
+      << ",\"thread\":" << it->first.second
+      << ",\"cycles\":" << counts.m_Cycles
+      << ",\"instructions\":" << counts.m_Instructions
+      << ",\"cacheMisses\":" << counts.m_CacheMisses
+      << ",\"time\":" << counts.m_Time * 1000.0
+      << ",\"scopes\":" << counts.m_NumberOfScopes << "}\n";
+  }
+  this->m_File.precision( precision );
+
+} // end WriteHardwareCounters()
+
+
+/**
+ * ********************* GetMemoryUsage ****************************
+ */
+
+PerformanceTrace::MemoryLoadType
+PerformanceTrace::GetMemoryUsage( void )
+{
+  itk::MemoryUsageObserver observer;
+  return observer.GetMemoryUsage();
+
+} // end GetMemoryUsage()
+
+
+/**
+ * ********************* GetPeakMemoryUsage ****************************
+ */
+
+PerformanceTrace::MemoryLoadType
+PerformanceTrace::GetPeakMemoryUsage( void )
+{
+#if !defined( _WIN32 )
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) == 0 && usage.ru_maxrss > 0 )
+  {
+#if defined( __APPLE__ )
+    /** In bytes on Mac OS X, in kB elsewhere. */
+    return static_cast< MemoryLoadType >( usage.ru_maxrss / 1024 );
+#else
+    return static_cast< MemoryLoadType >( usage.ru_maxrss );
+#endif
+  }
+#endif
+  return GetMemoryUsage();
+
+} // end GetPeakMemoryUsage()
+
+
+} // end namespace elastix
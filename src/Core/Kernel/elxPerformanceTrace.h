@@ -0,0 +1,165 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxPerformanceTrace_h
+#define __elxPerformanceTrace_h
+
+#include "itkObject.h"
+#include "itkTimeProbe.h"
+#include "itkMemoryUsageObserver.h"
+#include "itkScaledSingleValuedCostFunction.h"
+#include "itkHardwareCounters.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * \class PerformanceTrace
+ * \brief Writes a machine readable table with timings of every iteration.
+ *
+ * For every iteration one record is written, either as a line of a CSV
+ * file, or as a JSON object on a line of its own ("JSON lines"). A record
+ * contains:
+ * \li resolution, iteration: the resolution level and iteration number.
+ * \li time: the total time of the iteration, in ms, as in the Time[ms] column.
+ * \li value, derivative, valueAndDerivative: the time spent in the
+ *   evaluations of the cost function, in ms, and evaluations: their number.
+ *   Only available for optimizers that use a ScaledSingleValuedCostFunction.
+ * \li sampler: the time spent in updating the image samplers, in ms.
+ * \li optimizer: the remaining time of the iteration, spent in the optimizer
+ *   step and in the other components, in ms.
+ * \li log: the time spent in writing the iteration info, in ms. This time is
+ *   not part of the iteration time.
+ * \li samples: the number of samples in the image samplers.
+ * \li threads: the number of threads.
+ * \li memory, peakMemory: the memory usage of the process and the highest
+ *   memory usage seen in the trace so far, in kB.
+ *
+ * In JSON traces, ElastixTemplate also writes the memory accounting of every
+ * resolution, before the resolution starts, as a record with the fields
+ * resolution, memoryAccounting: for every component the memory it holds
+ * ("current") and the memory it is expected to hold during the resolution
+ * ("projected"), in kB, and projectedPeak: the expected peak memory usage of
+ * the process, in kB. CSV traces have fixed columns, so there it is left out.
+ * With WriteHardwareCounters, the hardware counters of every resolution are
+ * written to JSON traces as well, after the resolution, as one record per
+ * phase and thread with the fields resolution, phase, thread, cycles,
+ * instructions, cacheMisses, time (in ms) and scopes, the number of times
+ * the phase was run; see itk::HardwareCounters.
+ *
+ * ElastixTemplate uses this class when WritePerformanceTrace is "true".
+ */
+
+class PerformanceTrace
+{
+public:
+
+  typedef itk::ScaledSingleValuedCostFunction CostFunctionType;
+  typedef itk::MemoryUsageObserver::MemoryLoadType MemoryLoadType;
+
+  /** The memory of one component in the memory accounting, in bytes. */
+  struct MemoryAccountingEntryType
+  {
+    std::string m_Name;
+    double      m_Current;
+    double      m_Projected;
+  };
+  typedef std::vector< MemoryAccountingEntryType > MemoryAccountingType;
+
+  PerformanceTrace();
+  ~PerformanceTrace();
+
+  /** Open the trace file. With json == false a CSV file is written.
+   * Returns false when the file cannot be opened.
+   */
+  bool Open( const std::string & fileName, const bool json );
+
+  /** Close the trace file, and stop observing the samplers. */
+  void Close( void );
+
+  bool IsOpen( void ) const { return this->m_File.is_open(); }
+
+  /** Measure the time spent in updating this image sampler. */
+  void ObserveSampler( itk::Object * sampler );
+
+  /** Start measuring a new resolution, in which the evaluation timers of
+   * this cost function are read, if any. Work done before, like the
+   * initialization of the components, does not count for the first iteration.
+   */
+  void StartResolution( const CostFunctionType * costFunction );
+
+  /** Write the record of an iteration. The timings of the cost function and
+   * samplers are those since the previous record.
+   */
+  void WriteIteration( const unsigned int resolution, const unsigned int iteration,
+    const double iterationTime, const double logTime,
+    const unsigned long numberOfSamples );
+
+  /** Write the memory accounting of a resolution, only in JSON traces. */
+  void WriteMemoryAccounting( const unsigned int resolution,
+    const MemoryAccountingType & accounting, const double projectedPeak );
+
+  /** Write the hardware counters of a resolution, only in JSON traces. */
+  void WriteHardwareCounters( const unsigned int resolution,
+    const itk::HardwareCounters::TableType & table );
+
+  /** The current memory usage of the process, and the highest memory usage
+   * of the process since it started, in kB. The latter is only known on
+   * POSIX systems; elsewhere the current memory usage is returned. */
+  static MemoryLoadType GetMemoryUsage( void );
+  static MemoryLoadType GetPeakMemoryUsage( void );
+
+  /** Callbacks of the sampler observers. The samplers are also counted as
+   * the "ImageSampler" phase of the itk::HardwareCounters, when enabled. */
+  void SamplerStarted( void );
+
+  void SamplerEnded( void );
+
+private:
+
+  PerformanceTrace( const PerformanceTrace & ); // purposely not implemented
+  void operator=( const PerformanceTrace & );   // purposely not implemented
+
+  std::ofstream m_File;
+  bool          m_JSON;
+
+  /** The observed samplers and the tags of their start and end observers. */
+  std::vector< itk::Object::Pointer > m_Samplers;
+  std::vector< unsigned long >        m_SamplerObserverTags;
+  itk::TimeProbe                      m_SamplerTimer;
+  double                              m_PreviousSamplerTime;
+  itk::HardwareCounters::CountsType   m_SamplerCountsStart;
+  bool                                m_SamplerCountsStarted;
+
+  CostFunctionType::ConstPointer m_CostFunction;
+  double                         m_PreviousValueTime;
+  double                         m_PreviousDerivativeTime;
+  double                         m_PreviousValueAndDerivativeTime;
+  unsigned long                  m_PreviousNumberOfEvaluations;
+
+  itk::MemoryUsageObserver m_MemoryUsageObserver;
+  MemoryLoadType           m_PeakMemory;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxPerformanceTrace_h
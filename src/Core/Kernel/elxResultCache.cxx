@@ -0,0 +1,465 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "elxResultCache.h"
+#include "itkProcessId.h"
+
+#include <itksys/Directory.hxx>
+#include <itksys/SystemTools.hxx>
+#include "itksys/MD5.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+namespace elastix
+{
+
+namespace
+{
+
+/** The file in an entry that marks it as complete. Its modification time is
+ * the time the entry was last used. */
+const char * const EntryMarkerFileName = "elxresultcache.txt";
+
+/** The MD5 hash of a string, as hex digits. */
+std::string
+HashString( const std::string & text )
+{
+  itksysMD5 * md5 = itksysMD5_New();
+  itksysMD5_Initialize( md5 );
+  itksysMD5_Append( md5, (const unsigned char *)text.c_str(), static_cast< int >( text.size() ) );
+  char digest[ 33 ];
+  itksysMD5_FinalizeHex( md5, digest );
+  digest[ 32 ] = '\0';
+  itksysMD5_Delete( md5 );
+  return std::string( digest );
+}
+
+
+/** Add a trailing slash to a directory name. */
+std::string
+AsDirectory( const std::string & directory )
+{
+  if( !directory.empty() && directory[ directory.size() - 1 ] != '/'
+    && directory[ directory.size() - 1 ] != '\\' )
+  {
+    return directory + "/";
+  }
+  return directory;
+}
+
+
+/** The regular files in a directory, without the path. */
+std::vector< std::string >
+GetFilesInDirectory( const std::string & directory )
+{
+  std::vector< std::string > files;
+  itksys::Directory          dir;
+  if( !dir.Load( directory.c_str() ) ) { return files; }
+
+  for( unsigned long i = 0; i < dir.GetNumberOfFiles(); ++i )
+  {
+    const std::string name = dir.GetFile( i );
+    if( name == "." || name == ".." ) { continue; }
+    const std::string path = AsDirectory( directory ) + name;
+    if( itksys::SystemTools::FileExists( path.c_str(), true ) )
+    {
+      files.push_back( name );
+    }
+  }
+  return files;
+}
+
+
+/** Copy the regular files of one directory to another. */
+bool
+CopyFiles( const std::string & from, const std::vector< std::string > & files, const std::string & to )
+{
+  for( std::size_t i = 0; i < files.size(); ++i )
+  {
+    const std::string source      = AsDirectory( from ) + files[ i ];
+    const std::string destination = AsDirectory( to ) + files[ i ];
+    if( !itksys::SystemTools::CopyFileAlways( source.c_str(), destination.c_str() ) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+} // end namespace
+
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+ResultCache::ResultCache()
+{
+  this->m_MaximumSize  = 10240.0;
+  this->m_RunStartTime = 0;
+
+} // end Constructor
+
+
+/**
+ * ********************* SetCacheDirectory ****************************
+ */
+
+void
+ResultCache::SetCacheDirectory( const std::string & directory )
+{
+  this->m_CacheDirectory = AsDirectory( directory );
+
+} // end SetCacheDirectory()
+
+
+/**
+ * ********************* ComputeKey ****************************
+ */
+
+void
+ResultCache::ComputeKey( const std::string & program, const std::string & version,
+  const ArgumentMapType & argMap )
+{
+  /** The arguments that do not change the results. */
+  static const char * const ignoredArguments[] = {
+    "-out", "-argv0", "-priority", "-imagecache", "-artifactcache", "-trace",
+    "-resultcache", "-resultcachesize", "-statusfile", "-statusinterval"
+  };
+  const std::size_t numberOfIgnoredArguments
+    = sizeof( ignoredArguments ) / sizeof( ignoredArguments[ 0 ] );
+
+  std::ostringstream description;
+  description << program << "|" << version;
+  for( ArgumentMapType::const_iterator it = argMap.begin(); it != argMap.end(); ++it )
+  {
+    if( std::find( ignoredArguments, ignoredArguments + numberOfIgnoredArguments,
+      it->first ) != ignoredArguments + numberOfIgnoredArguments )
+    {
+      continue;
+    }
+
+    /** Files by their content, other values as they are. */
+    description << "|" << it->first << "=";
+    if( itksys::SystemTools::FileExists( it->second.c_str(), true ) )
+    {
+      description << "file:" << HashFile( it->second );
+    }
+    else
+    {
+      description << "value:" << it->second;
+    }
+  }
+
+  this->m_Key = HashString( description.str() );
+
+} // end ComputeKey()
+
+
+/**
+ * ********************* HashFile ****************************
+ */
+
+std::string
+ResultCache::HashFile( const std::string & fileName )
+{
+  return HashFile( fileName, 0 );
+
+} // end HashFile()
+
+
+/**
+ * ********************* HashFile ****************************
+ */
+
+std::string
+ResultCache::HashFile( const std::string & fileName, const unsigned int depth )
+{
+  /** The content of the file. */
+  itksysMD5 * md5 = itksysMD5_New();
+  itksysMD5_Initialize( md5 );
+
+  std::ifstream file( fileName.c_str(), std::ios::binary );
+  std::vector< char > buffer( 1 << 20 );
+  while( file )
+  {
+    file.read( &buffer[ 0 ], buffer.size() );
+    const std::streamsize numberOfBytes = file.gcount();
+    if( numberOfBytes <= 0 ) { break; }
+    itksysMD5_Append( md5, reinterpret_cast< const unsigned char * >( &buffer[ 0 ] ),
+      static_cast< int >( numberOfBytes ) );
+  }
+
+  /** The files it refers to. The depth breaks cycles of references. */
+  if( depth < 8 )
+  {
+    const std::vector< std::string > referencedFiles = GetReferencedFiles( fileName );
+    for( std::size_t i = 0; i < referencedFiles.size(); ++i )
+    {
+      const std::string hash = HashFile( referencedFiles[ i ], depth + 1 );
+      itksysMD5_Append( md5, (const unsigned char *)hash.c_str(), static_cast< int >( hash.size() ) );
+    }
+  }
+
+  char digest[ 33 ];
+  itksysMD5_FinalizeHex( md5, digest );
+  digest[ 32 ] = '\0';
+  itksysMD5_Delete( md5 );
+  return std::string( digest );
+
+} // end HashFile()
+
+
+/**
+ * ********************* GetReferencedFiles ****************************
+ */
+
+std::vector< std::string >
+ResultCache::GetReferencedFiles( const std::string & fileName )
+{
+  std::vector< std::string > referencedFiles;
+
+  /** Only parameter files and image headers refer to other files. */
+  const std::string extension = itksys::SystemTools::LowerCase(
+    itksys::SystemTools::GetFilenameLastExtension( fileName ) );
+  const std::string path = AsDirectory( itksys::SystemTools::GetFilenamePath( fileName ) );
+  if( extension == ".hdr" )
+  {
+    /** The Analyze and NIfTI pair: the data is in the .img file. */
+    const std::string imageFile
+      = itksys::SystemTools::GetFilenameWithoutLastExtension( fileName ) + ".img";
+    const std::string imagePath = path + imageFile;
+    if( itksys::SystemTools::FileExists( imagePath.c_str(), true ) )
+    {
+      referencedFiles.push_back( imagePath );
+    }
+    return referencedFiles;
+  }
+  if( extension != ".txt" && extension != ".mhd" ) { return referencedFiles; }
+
+  std::ifstream file( fileName.c_str() );
+  std::string   line;
+  while( std::getline( file, line ) )
+  {
+    std::vector< std::string > candidates;
+
+    /** The data file of an .mhd header, relative to the header. */
+    if( extension == ".mhd" )
+    {
+      const std::string::size_type pos = line.find( "ElementDataFile" );
+      const std::string::size_type eq  = line.find( '=' );
+      if( pos != std::string::npos && eq != std::string::npos )
+      {
+        const std::string dataFile = itksys::SystemTools::TrimWhitespace( line.substr( eq + 1 ) );
+        candidates.push_back( path + dataFile );
+      }
+    }
+
+    /** Quoted strings in a parameter file, such as the
+     * InitialTransformParametersFileName. */
+    std::string::size_type begin = line.find( '"' );
+    while( begin != std::string::npos )
+    {
+      const std::string::size_type end = line.find( '"', begin + 1 );
+      if( end == std::string::npos ) { break; }
+      candidates.push_back( line.substr( begin + 1, end - begin - 1 ) );
+      begin = line.find( '"', end + 1 );
+    }
+
+    for( std::size_t i = 0; i < candidates.size(); ++i )
+    {
+      if( !candidates[ i ].empty() && candidates[ i ] != fileName
+        && itksys::SystemTools::FileExists( candidates[ i ].c_str(), true ) )
+      {
+        referencedFiles.push_back( candidates[ i ] );
+      }
+    }
+  }
+
+  return referencedFiles;
+
+} // end GetReferencedFiles()
+
+
+/**
+ * ********************* GetEntryDirectory ****************************
+ */
+
+std::string
+ResultCache::GetEntryDirectory( void ) const
+{
+  return this->m_CacheDirectory + this->m_Key + "/";
+
+} // end GetEntryDirectory()
+
+
+/**
+ * ********************* Restore ****************************
+ */
+
+bool
+ResultCache::Restore( const std::string & outFolder ) const
+{
+  if( this->m_Key.empty() ) { return false; }
+
+  /** Only complete entries have the marker file. */
+  const std::string entry  = this->GetEntryDirectory();
+  const std::string marker = entry + EntryMarkerFileName;
+  if( !itksys::SystemTools::FileExists( marker.c_str(), true ) ) { return false; }
+
+  std::vector< std::string > files = GetFilesInDirectory( entry );
+  files.erase( std::remove( files.begin(), files.end(), std::string( EntryMarkerFileName ) ), files.end() );
+  if( !CopyFiles( entry, files, outFolder ) ) { return false; }
+
+  /** Mark the entry as recently used. */
+  itksys::SystemTools::Touch( marker, false );
+  return true;
+
+} // end Restore()
+
+
+/**
+ * ********************* BeginRun ****************************
+ */
+
+void
+ResultCache::BeginRun( const std::string & outFolder )
+{
+  this->m_RunStartTime = static_cast< long >( std::time( 0 ) );
+  this->m_FilesBeforeRun.clear();
+
+  const std::vector< std::string > files = GetFilesInDirectory( outFolder );
+  for( std::size_t i = 0; i < files.size(); ++i )
+  {
+    const std::string path = AsDirectory( outFolder ) + files[ i ];
+    this->m_FilesBeforeRun[ files[ i ] ] = itksys::SystemTools::ModifiedTime( path.c_str() );
+  }
+
+} // end BeginRun()
+
+
+/**
+ * ********************* Store ****************************
+ */
+
+bool
+ResultCache::Store( const std::string & outFolder, const std::string & logFileName )
+{
+  if( this->m_Key.empty() ) { return false; }
+
+  /** The files written by the run: new files, and files modified since the
+   * start of the run. */
+  const std::string                logName = itksys::SystemTools::GetFilenameName( logFileName );
+  const std::vector< std::string > files   = GetFilesInDirectory( outFolder );
+  std::vector< std::string >       writtenFiles;
+  for( std::size_t i = 0; i < files.size(); ++i )
+  {
+    if( files[ i ] == logName ) { continue; }
+    const std::string path  = AsDirectory( outFolder ) + files[ i ];
+    const long        mtime = itksys::SystemTools::ModifiedTime( path.c_str() );
+    std::map< std::string, long >::const_iterator before = this->m_FilesBeforeRun.find( files[ i ] );
+    if( before == this->m_FilesBeforeRun.end() || mtime != before->second
+      || mtime >= this->m_RunStartTime )
+    {
+      writtenFiles.push_back( files[ i ] );
+    }
+  }
+
+  /** Write the entry to a temporary directory, which is renamed when it is
+   * complete. Another process may have stored the same entry meanwhile. */
+  const std::string entry = this->GetEntryDirectory();
+  std::ostringstream temporaryName;
+  temporaryName << this->m_CacheDirectory << this->m_Key << "." << itk::GetProcessIdentifier() << ".tmp/";
+  const std::string temporary = temporaryName.str();
+
+  bool success = itksys::SystemTools::MakeDirectory( temporary.c_str() )
+    && CopyFiles( outFolder, writtenFiles, temporary );
+  if( success )
+  {
+    const std::string marker = temporary + EntryMarkerFileName;
+    std::ofstream     markerFile( marker.c_str() );
+    markerFile << this->m_Key << std::endl;
+    success = markerFile.good();
+  }
+  if( success && !itksys::SystemTools::FileIsDirectory( entry.c_str() ) )
+  {
+    const std::string from = temporary.substr( 0, temporary.size() - 1 );
+    const std::string to   = entry.substr( 0, entry.size() - 1 );
+    success = std::rename( from.c_str(), to.c_str() ) == 0
+      || itksys::SystemTools::FileIsDirectory( entry.c_str() );
+  }
+  itksys::SystemTools::RemoveADirectory( temporary.c_str() );
+
+  this->RemoveLeastRecentlyUsedEntries();
+  return success;
+
+} // end Store()
+
+
+/**
+ * ********************* RemoveLeastRecentlyUsedEntries ****************************
+ */
+
+void
+ResultCache::RemoveLeastRecentlyUsedEntries( void ) const
+{
+  /** The complete entries, by the time they were last used, and their size. */
+  typedef std::pair< long, std::string > EntryType;
+  std::vector< EntryType >         entries;
+  std::map< std::string, double >  entrySizes;
+  double                           totalSize = 0.0;
+
+  itksys::Directory dir;
+  if( !dir.Load( this->m_CacheDirectory.c_str() ) ) { return; }
+  for( unsigned long i = 0; i < dir.GetNumberOfFiles(); ++i )
+  {
+    const std::string name = dir.GetFile( i );
+    if( name == "." || name == ".." ) { continue; }
+    const std::string entry  = this->m_CacheDirectory + name + "/";
+    const std::string marker = entry + EntryMarkerFileName;
+    if( !itksys::SystemTools::FileExists( marker.c_str(), true ) ) { continue; }
+
+    double                           size  = 0.0;
+    const std::vector< std::string > files = GetFilesInDirectory( entry );
+    for( std::size_t j = 0; j < files.size(); ++j )
+    {
+      size += static_cast< double >( itksys::SystemTools::FileLength( ( entry + files[ j ] ).c_str() ) );
+    }
+    entries.push_back( EntryType( itksys::SystemTools::ModifiedTime( marker.c_str() ), entry ) );
+    entrySizes[ entry ] = size;
+    totalSize          += size;
+  }
+
+  /** Remove the oldest entries first. */
+  std::sort( entries.begin(), entries.end() );
+  const double maximumSize = this->m_MaximumSize * 1024.0 * 1024.0;
+  for( std::size_t i = 0; i < entries.size() && totalSize > maximumSize; ++i )
+  {
+    itksys::SystemTools::RemoveADirectory( entries[ i ].second.c_str() );
+    totalSize -= entrySizes[ entries[ i ].second ];
+  }
+
+} // end RemoveLeastRecentlyUsedEntries()
+
+
+} // end namespace elastix
@@ -0,0 +1,124 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxResultCache_h
+#define __elxResultCache_h
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * \class ResultCache
+ * \brief Returns the results of an identical earlier elastix or transformix run.
+ *
+ * A run is identified by a key: the MD5 hash of the program, its version,
+ * and the command line arguments. Arguments that are files, such as the
+ * images, masks, point sets and parameter files, are represented by the
+ * hash of their content, not by their name. The files that they refer to,
+ * such as the initial transform of a transform parameter file, or the data
+ * file of an .mhd header, are hashed as well. Arguments that do not change
+ * the results, such as -out, are left out.
+ *
+ * The results of a run are the files that it wrote to the output directory,
+ * except the log file. They are stored in a subdirectory of the cache
+ * directory, named after the key. The entry is written to a temporary
+ * directory first, and then renamed, so that other processes never see a
+ * partial entry. When the cache is larger than its maximum size, the least
+ * recently used entries are removed.
+ *
+ * The elastix and transformix executables use this class when the
+ * -resultcache command line argument is given.
+ */
+
+class ResultCache
+{
+public:
+
+  typedef std::map< std::string, std::string > ArgumentMapType;
+
+  ResultCache();
+  ~ResultCache() {}
+
+  /** The directory that holds the cache entries. */
+  void SetCacheDirectory( const std::string & directory );
+  const std::string & GetCacheDirectory( void ) const { return this->m_CacheDirectory; }
+
+  /** The maximum total size of the entries, in MB. Default: 10240. */
+  void SetMaximumSize( const double megabytes ) { this->m_MaximumSize = megabytes; }
+  double GetMaximumSize( void ) const { return this->m_MaximumSize; }
+
+  /** Compute the key of a run from the program name, its version and its
+   * command line arguments.
+   */
+  void ComputeKey( const std::string & program, const std::string & version,
+    const ArgumentMapType & argMap );
+
+  const std::string & GetKey( void ) const { return this->m_Key; }
+
+  /** Copy the results of the entry of the key to the output directory.
+   * Returns false if there is no such entry.
+   */
+  bool Restore( const std::string & outFolder ) const;
+
+  /** Remember the files in the output directory, before the run, so that
+   * Store() can tell which files the run wrote.
+   */
+  void BeginRun( const std::string & outFolder );
+
+  /** Store the files that the run wrote to the output directory, except
+   * the log file, as the entry of the key, and remove the least recently
+   * used entries. Returns false on failure.
+   */
+  bool Store( const std::string & outFolder, const std::string & logFileName );
+
+  /** The hash of the content of a file, and of the files it refers to. */
+  static std::string HashFile( const std::string & fileName );
+
+private:
+
+  ResultCache( const ResultCache & );    // purposely not implemented
+  void operator=( const ResultCache & ); // purposely not implemented
+
+  /** Helper for HashFile(), which stops at a given depth of references. */
+  static std::string HashFile( const std::string & fileName, const unsigned int depth );
+
+  /** The files that a text file refers to: quoted strings, and the data
+   * file of an .mhd header, that are existing files.
+   */
+  static std::vector< std::string > GetReferencedFiles( const std::string & fileName );
+
+  /** The directory of the entry of the key. */
+  std::string GetEntryDirectory( void ) const;
+
+  /** Remove the least recently used entries until the cache fits. */
+  void RemoveLeastRecentlyUsedEntries( void ) const;
+
+  std::string                   m_CacheDirectory;
+  double                        m_MaximumSize;
+  std::string                   m_Key;
+  long                          m_RunStartTime;
+  std::map< std::string, long > m_FilesBeforeRun;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxResultCache_h
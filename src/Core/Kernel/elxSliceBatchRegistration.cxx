@@ -0,0 +1,451 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxSliceBatchRegistration.h"
+
+#include "itkImageFileReader.h"
+#include "itkExtractImageFilter.h"
+#include "itkParameterFileParser.h"
+#include "itkTimeProbe.h"
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace elastix
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+SliceBatchRegistration::SliceBatchRegistration()
+{
+  this->m_NumberOfWorkers = 0;
+  this->m_NextSlice       = 0;
+  this->m_SliceFinished   = itk::ConditionVariable::New();
+
+} // end Constructor
+
+
+/**
+ * ********************* Run ****************************
+ */
+
+int
+SliceBatchRegistration::Run( const ArgumentMapType & argMap,
+  const std::vector< std::string > & parameterFileNames )
+{
+  if( !this->ReadInput( argMap, parameterFileNames ) )
+  {
+    return -1;
+  }
+
+  const unsigned int numberOfSlices = this->m_FixedSlices.size();
+  unsigned int       numberOfWorkers = this->m_NumberOfWorkers;
+  if( numberOfWorkers == 0 )
+  {
+    numberOfWorkers = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  }
+  numberOfWorkers = std::min( numberOfWorkers, numberOfSlices );
+  numberOfWorkers = std::min( numberOfWorkers, static_cast< unsigned int >( ITK_MAX_THREADS ) );
+  numberOfWorkers = std::max( numberOfWorkers, 1u );
+
+  elxout << "Registering " << numberOfSlices << " slices with "
+         << numberOfWorkers << " concurrent registrations.\n" << std::endl;
+
+  /** Start the workers. Each registration sets the maximum number of threads
+   * of ITK to one, so they are spawned rather than run by a MultiThreader,
+   * which would obey that maximum. */
+  this->m_NextSlice = 0;
+  this->m_FinishedSlices.clear();
+  itk::MultiThreader::Pointer      spawner = itk::MultiThreader::New();
+  std::vector< itk::ThreadIdType > threadIds;
+  for( unsigned int i = 0; i < numberOfWorkers; ++i )
+  {
+    threadIds.push_back( spawner->SpawnThread(
+      SliceBatchRegistration::WorkerThreadCallback, this ) );
+  }
+
+  /** Report the slices as they finish. */
+  unsigned int numberOfFailedSlices   = 0;
+  unsigned int numberOfReportedSlices = 0;
+  this->m_Mutex.Lock();
+  while( numberOfReportedSlices < numberOfSlices )
+  {
+    while( this->m_FinishedSlices.empty() )
+    {
+      this->m_SliceFinished->Wait( &this->m_Mutex );
+    }
+    const SliceResultType result = this->m_FinishedSlices.front();
+    this->m_FinishedSlices.pop_front();
+    this->m_Mutex.Unlock();
+
+    ++numberOfReportedSlices;
+    elxout << "Slice " << result.m_Slice << " ("
+           << numberOfReportedSlices << "/" << numberOfSlices << ") ";
+    if( result.m_ErrorCode == 0 )
+    {
+      std::ostringstream time( "" );
+      time << std::fixed << std::setprecision( 2 ) << result.m_Time;
+      elxout << "was registered in " << time.str() << " s." << std::endl;
+    }
+    else
+    {
+      ++numberOfFailedSlices;
+      elxout << "failed with error code " << result.m_ErrorCode
+             << ", see its elastix.log." << std::endl;
+    }
+
+    this->m_Mutex.Lock();
+  }
+  this->m_Mutex.Unlock();
+
+  /** TerminateThread() joins the thread. */
+  for( std::size_t i = 0; i < threadIds.size(); ++i )
+  {
+    spawner->TerminateThread( threadIds[ i ] );
+  }
+
+  if( numberOfFailedSlices > 0 )
+  {
+    xl::xout[ "error" ] << "ERROR: " << numberOfFailedSlices << " of the "
+                        << numberOfSlices << " slices could not be registered." << std::endl;
+  }
+
+  this->m_FixedSlices.clear();
+  this->m_MovingSlices.clear();
+  this->m_FixedMaskSlices.clear();
+  this->m_MovingMaskSlices.clear();
+  return static_cast< int >( numberOfFailedSlices );
+
+} // end Run()
+
+
+/**
+ * ********************* ReadInput ****************************
+ */
+
+bool
+SliceBatchRegistration::ReadInput( const ArgumentMapType & argMap,
+  const std::vector< std::string > & parameterFileNames )
+{
+  typedef itk::ImageFileReader< StackType >     StackReaderType;
+  typedef itk::ImageFileReader< MaskStackType > MaskReaderType;
+  typedef ArgumentMapType::const_iterator       ArgumentIteratorType;
+
+  ArgumentIteratorType fixedArgument  = argMap.find( "-f" );
+  ArgumentIteratorType movingArgument = argMap.find( "-m" );
+  ArgumentIteratorType outArgument    = argMap.find( "-out" );
+  if( fixedArgument == argMap.end() || movingArgument == argMap.end()
+    || outArgument == argMap.end() )
+  {
+    xl::xout[ "error" ] << "ERROR: -slices requires a fixed stack \"-f\", "
+                        << "a moving stack \"-m\" and \"-out\"." << std::endl;
+    return false;
+  }
+  this->m_OutputDirectory = outArgument->second;
+
+  /** Read the stacks and the masks, and split them. */
+  try
+  {
+    StackReaderType::Pointer fixedReader = StackReaderType::New();
+    fixedReader->SetFileName( fixedArgument->second );
+    fixedReader->Update();
+    ExtractSlices< StackType, SliceType >( fixedReader->GetOutput(), this->m_FixedSlices );
+
+    StackReaderType::Pointer movingReader = StackReaderType::New();
+    movingReader->SetFileName( movingArgument->second );
+    movingReader->Update();
+    ExtractSlices< StackType, SliceType >( movingReader->GetOutput(), this->m_MovingSlices );
+
+    ArgumentIteratorType fixedMaskArgument = argMap.find( "-fMask" );
+    if( fixedMaskArgument != argMap.end() )
+    {
+      MaskReaderType::Pointer maskReader = MaskReaderType::New();
+      maskReader->SetFileName( fixedMaskArgument->second );
+      maskReader->Update();
+      ExtractSlices< MaskStackType, MaskSliceType >( maskReader->GetOutput(), this->m_FixedMaskSlices );
+    }
+
+    ArgumentIteratorType movingMaskArgument = argMap.find( "-mMask" );
+    if( movingMaskArgument != argMap.end() )
+    {
+      MaskReaderType::Pointer maskReader = MaskReaderType::New();
+      maskReader->SetFileName( movingMaskArgument->second );
+      maskReader->Update();
+      ExtractSlices< MaskStackType, MaskSliceType >( maskReader->GetOutput(), this->m_MovingMaskSlices );
+    }
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    xl::xout[ "error" ] << "ERROR: the stacks could not be read.\n" << excp << std::endl;
+    return false;
+  }
+
+  const std::size_t numberOfSlices = this->m_FixedSlices.size();
+  if( numberOfSlices == 0
+    || this->m_MovingSlices.size() != numberOfSlices
+    || ( !this->m_FixedMaskSlices.empty() && this->m_FixedMaskSlices.size() != numberOfSlices )
+    || ( !this->m_MovingMaskSlices.empty() && this->m_MovingMaskSlices.size() != numberOfSlices ) )
+  {
+    xl::xout[ "error" ] << "ERROR: the fixed stack has " << numberOfSlices
+                        << " slices, the moving stack " << this->m_MovingSlices.size()
+                        << "; the stacks and masks must have the same number of slices." << std::endl;
+    return false;
+  }
+
+  /** Parse the parameter files once. The slices are 2D float images, and
+   * each registration has one thread. */
+  this->m_ParameterMaps.clear();
+  this->m_ParameterFileNames = parameterFileNames;
+  for( std::size_t i = 0; i < parameterFileNames.size(); ++i )
+  {
+    itk::ParameterFileParser::Pointer parser = itk::ParameterFileParser::New();
+    parser->SetParameterFileName( parameterFileNames[ i ] );
+    try
+    {
+      parser->ReadParameterFile();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << "ERROR: the parameter file \"" << parameterFileNames[ i ]
+                          << "\" could not be read.\n" << excp << std::endl;
+      return false;
+    }
+
+    ParameterMapType parameterMap = parser->GetParameterMap();
+    parameterMap[ "FixedImageDimension" ]          = std::vector< std::string >( 1, "2" );
+    parameterMap[ "MovingImageDimension" ]         = std::vector< std::string >( 1, "2" );
+    parameterMap[ "FixedInternalImagePixelType" ]  = std::vector< std::string >( 1, "float" );
+    parameterMap[ "MovingInternalImagePixelType" ] = std::vector< std::string >( 1, "float" );
+    parameterMap[ "UseMultiThreadingForMetrics" ]  = std::vector< std::string >( 1, "false" );
+    this->m_ParameterMaps.push_back( parameterMap );
+  }
+
+  /** The arguments of every slice. The images are given in memory; -f and
+   * -m are kept for the log, but the stacks are not read again. The
+   * arguments of the batch itself are left out. */
+  this->m_SliceArgumentMap.clear();
+  for( ArgumentIteratorType it = argMap.begin(); it != argMap.end(); ++it )
+  {
+    const std::string & key = it->first;
+    if( key == "-fMask" || key == "-mMask" || key == "-out" || key == "-threads" || key == "-slices" || key == "-trace"
+      || key == "-resume" || key == "-resultcache" || key == "-resultcachesize"
+      || key == "-statusfile" || key == "-statusinterval"
+      || key == "-p" || key.compare( 0, 3, "-p(" ) == 0 )
+    {
+      continue;
+    }
+    this->m_SliceArgumentMap.insert( *it );
+  }
+  this->m_SliceArgumentMap[ "-threads" ] = "1";
+
+  return true;
+
+} // end ReadInput()
+
+
+/**
+ * ********************* ExtractSlices ****************************
+ */
+
+template< class TStack, class TSlice >
+void
+SliceBatchRegistration::ExtractSlices( TStack * stack,
+  std::vector< typename TSlice::Pointer > & slices )
+{
+  typedef itk::ExtractImageFilter< TStack, TSlice > ExtractorType;
+
+  const typename TStack::RegionType region = stack->GetLargestPossibleRegion();
+  slices.clear();
+  for( unsigned int k = 0; k < region.GetSize()[ 2 ]; ++k )
+  {
+    typename TStack::RegionType sliceRegion = region;
+    sliceRegion.SetIndex( 2, region.GetIndex()[ 2 ] + k );
+    sliceRegion.SetSize( 2, 0 );
+
+    typename ExtractorType::Pointer extractor = ExtractorType::New();
+    extractor->SetInput( stack );
+    extractor->SetExtractionRegion( sliceRegion );
+    extractor->SetDirectionCollapseToSubmatrix();
+    extractor->Update();
+
+    typename TSlice::Pointer slice = extractor->GetOutput();
+    slice->DisconnectPipeline();
+    slices.push_back( slice );
+  }
+
+} // end ExtractSlices()
+
+
+/**
+ * ********************* RegisterSlice ****************************
+ */
+
+int
+SliceBatchRegistration::RegisterSlice( const unsigned int slice )
+{
+  typedef ElastixMain::Pointer                    ElastixMainPointer;
+  typedef ElastixMain::ObjectPointer              ObjectPointer;
+  typedef ElastixMain::DataObjectContainerType    DataObjectContainerType;
+  typedef ElastixMain::DataObjectContainerPointer DataObjectContainerPointer;
+  typedef ElastixMain::FlatDirectionCosinesType   FlatDirectionCosinesType;
+
+  /** The output directory of the slice. */
+  std::ostringstream makeDirectory( "" );
+  makeDirectory << this->m_OutputDirectory << "slice"
+                << std::setfill( '0' ) << std::setw( 4 ) << slice << "/";
+  const std::string directory = makeDirectory.str();
+  if( !itksys::SystemTools::MakeDirectory( directory.c_str() ) )
+  {
+    return 1;
+  }
+
+  /** The log of the slice is kept apart from the others. */
+  xoutManager manager;
+  const std::string logFileName = directory + "elastix.log";
+  if( xoutSetup( manager, logFileName.c_str(), true, false ) )
+  {
+    return 1;
+  }
+
+  ArgumentMapType argMap = this->m_SliceArgumentMap;
+  argMap[ "-out" ] = directory;
+
+  DataObjectContainerPointer fixedImageContainer  = DataObjectContainerType::New();
+  DataObjectContainerPointer movingImageContainer = DataObjectContainerType::New();
+  DataObjectContainerPointer fixedMaskContainer   = 0;
+  DataObjectContainerPointer movingMaskContainer  = 0;
+  fixedImageContainer->CreateElementAt( 0 )  = this->m_FixedSlices[ slice ].GetPointer();
+  movingImageContainer->CreateElementAt( 0 ) = this->m_MovingSlices[ slice ].GetPointer();
+  if( !this->m_FixedMaskSlices.empty() )
+  {
+    fixedMaskContainer = DataObjectContainerType::New();
+    fixedMaskContainer->CreateElementAt( 0 ) = this->m_FixedMaskSlices[ slice ].GetPointer();
+  }
+  if( !this->m_MovingMaskSlices.empty() )
+  {
+    movingMaskContainer = DataObjectContainerType::New();
+    movingMaskContainer->CreateElementAt( 0 ) = this->m_MovingMaskSlices[ slice ].GetPointer();
+  }
+
+  ObjectPointer            transform = 0;
+  FlatDirectionCosinesType fixedImageOriginalDirection;
+
+  /** Run the chain of registrations, as elastix does for several -p. */
+  for( std::size_t i = 0; i < this->m_ParameterMaps.size(); ++i )
+  {
+    ElastixMainPointer elastix = ElastixMain::New();
+    elastix->SetElastixLevel( static_cast< unsigned int >( i ) );
+    elastix->SetTotalNumberOfElastixLevels(
+      static_cast< unsigned int >( this->m_ParameterMaps.size() ) );
+    elastix->SetInitialTransform( transform );
+    elastix->SetFixedImageContainer( fixedImageContainer );
+    elastix->SetMovingImageContainer( movingImageContainer );
+    elastix->SetFixedMaskContainer( fixedMaskContainer );
+    elastix->SetMovingMaskContainer( movingMaskContainer );
+    elastix->SetOriginalFixedImageDirectionFlat( fixedImageOriginalDirection );
+
+    argMap[ "-p" ] = this->m_ParameterFileNames[ i ];
+    ParameterMapType parameterMap = this->m_ParameterMaps[ i ];
+
+    int errorCode = 0;
+    try
+    {
+      errorCode = elastix->Run( argMap, parameterMap );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << "Exception while registering slice " << slice << ":\n"
+                          << excp << std::endl;
+      errorCode = 1;
+    }
+    if( errorCode != 0 )
+    {
+      return errorCode;
+    }
+
+    transform                   = elastix->GetFinalTransform();
+    fixedImageContainer         = elastix->GetFixedImageContainer();
+    movingImageContainer        = elastix->GetMovingImageContainer();
+    fixedMaskContainer          = elastix->GetFixedMaskContainer();
+    movingMaskContainer         = elastix->GetMovingMaskContainer();
+    fixedImageOriginalDirection = elastix->GetOriginalFixedImageDirectionFlat();
+  }
+  return 0;
+
+} // end RegisterSlice()
+
+
+/**
+ * ********************* WorkerThreadCallback ****************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+SliceBatchRegistration::WorkerThreadCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  static_cast< SliceBatchRegistration * >( infoStruct->UserData )->WorkerLoop();
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WorkerThreadCallback()
+
+
+/**
+ * ********************* WorkerLoop ****************************
+ */
+
+void
+SliceBatchRegistration::WorkerLoop( void )
+{
+  const unsigned int numberOfSlices = this->m_FixedSlices.size();
+  while( true )
+  {
+    this->m_Mutex.Lock();
+    const unsigned int slice = this->m_NextSlice;
+    if( slice < numberOfSlices )
+    {
+      ++this->m_NextSlice;
+    }
+    this->m_Mutex.Unlock();
+    if( slice >= numberOfSlices )
+    {
+      break;
+    }
+
+    SliceResultType result;
+    result.m_Slice = slice;
+    itk::TimeProbe timer;
+    timer.Start();
+    result.m_ErrorCode = this->RegisterSlice( slice );
+    timer.Stop();
+    result.m_Time = timer.GetTotal();
+
+    this->m_Mutex.Lock();
+    this->m_FinishedSlices.push_back( result );
+    this->m_SliceFinished->Signal();
+    this->m_Mutex.Unlock();
+  }
+
+} // end WorkerLoop()
+
+
+} // end namespace elastix
@@ -0,0 +1,143 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxSliceBatchRegistration_h
+#define __elxSliceBatchRegistration_h
+
+#include "elxElastixMain.h"
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * \class SliceBatchRegistration
+ * \brief Registers the slices of two 3D stacks independently, in one process.
+ *
+ * Slice k of the fixed stack is registered to slice k of the moving stack,
+ * as a 2D registration, for all slices. The registrations run concurrently,
+ * each in a worker thread of its own, with single-threaded components, so
+ * that many small registrations are limited by the computations rather than
+ * by the start-up of a process per slice: the components are installed and
+ * the parameter files are parsed once, and the stacks are read once.
+ *
+ * The results of slice k, such as TransformParameters.0.txt, the result
+ * image and the log file, are written to the subdirectory slice<k> of the
+ * output directory, with k in four digits. The parameter files apply to
+ * every slice, as a chain when there are several. The images are registered
+ * as float, whatever FixedInternalImagePixelType says, and the masks, if
+ * any, must be stacks as well. The initial transform of -t0, if given, is
+ * used for every slice.
+ *
+ * The elastix executable uses this class when the -slices command line
+ * argument is given, with the number of concurrent registrations, or 0
+ * for the number of CPUs.
+ */
+
+class SliceBatchRegistration
+{
+public:
+
+  typedef ElastixMain::ArgumentMapType  ArgumentMapType;
+  typedef ElastixMain::ParameterMapType ParameterMapType;
+
+  typedef itk::Image< float, 3 >         StackType;
+  typedef itk::Image< float, 2 >         SliceType;
+  typedef itk::Image< unsigned char, 3 > MaskStackType;
+  typedef itk::Image< unsigned char, 2 > MaskSliceType;
+
+  SliceBatchRegistration();
+  ~SliceBatchRegistration() {}
+
+  /** The number of concurrent registrations; 0 for the default number of
+   * threads of ITK, which is the number of CPUs. Default: 0. */
+  void SetNumberOfWorkers( const unsigned int n ) { this->m_NumberOfWorkers = n; }
+  unsigned int GetNumberOfWorkers( void ) const { return this->m_NumberOfWorkers; }
+
+  /** Register all slices. The argument map holds the command line
+   * arguments: -f, -m, -out, and optionally -fMask, -mMask and -t0.
+   * Progress is written to xout. Returns 0 when all slices were registered,
+   * the number of failed slices otherwise, or -1 if the input could not be
+   * read.
+   */
+  int Run( const ArgumentMapType & argMap,
+    const std::vector< std::string > & parameterFileNames );
+
+private:
+
+  SliceBatchRegistration( const SliceBatchRegistration & ); // purposely not implemented
+  void operator=( const SliceBatchRegistration & );         // purposely not implemented
+
+  /** The outcome of the registration of a slice. */
+  struct SliceResultType
+  {
+    unsigned int m_Slice;
+    int          m_ErrorCode;
+    double       m_Time;
+  };
+
+  /** Read the stacks and the parameter files, and split the stacks into
+   * slices. Returns false on failure, after writing the error to xout. */
+  bool ReadInput( const ArgumentMapType & argMap,
+    const std::vector< std::string > & parameterFileNames );
+
+  /** Split a stack into its slices along the last dimension. */
+  template< class TStack, class TSlice >
+  static void ExtractSlices( TStack * stack,
+    std::vector< typename TSlice::Pointer > & slices );
+
+  /** Run the chain of registrations of one slice, in the calling thread.
+   * Returns the error code of elastix. */
+  int RegisterSlice( const unsigned int slice );
+
+  /** The loop of a worker thread, which registers slices until there are
+   * none left. */
+  static ITK_THREAD_RETURN_TYPE WorkerThreadCallback( void * arg );
+
+  void WorkerLoop( void );
+
+  unsigned int m_NumberOfWorkers;
+
+  /** The input, shared read-only by the workers. */
+  std::vector< SliceType::Pointer >     m_FixedSlices;
+  std::vector< SliceType::Pointer >     m_MovingSlices;
+  std::vector< MaskSliceType::Pointer > m_FixedMaskSlices;
+  std::vector< MaskSliceType::Pointer > m_MovingMaskSlices;
+  std::vector< ParameterMapType >       m_ParameterMaps;
+  std::vector< std::string >            m_ParameterFileNames;
+  ArgumentMapType                       m_SliceArgumentMap;
+  std::string                           m_OutputDirectory;
+
+  /** The next slice to register, and the finished ones, guarded by m_Mutex. */
+  unsigned int                      m_NextSlice;
+  std::deque< SliceResultType >     m_FinishedSlices;
+  itk::SimpleMutexLock              m_Mutex;
+  itk::ConditionVariable::Pointer   m_SliceFinished;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxSliceBatchRegistration_h
@@ -0,0 +1,289 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxStatusFile.h"
+#include "elxPerformanceTrace.h"
+
+#include "itkMultiThreader.h"
+#include "itkProcessId.h"
+#include <itksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace elastix
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+StatusFile::StatusFile()
+{
+  this->m_Prometheus          = false;
+  this->m_Interval            = 1.0;
+  this->m_StartTime           = 0.0;
+  this->m_ResolutionStartTime = 0.0;
+  this->m_LastWriteTime       = 0.0;
+  this->m_LastProcessorTime   = 0.0;
+
+  this->m_LastStatus.m_State                                       = "initializing";
+  this->m_LastStatus.m_ElastixLevel                                = 0;
+  this->m_LastStatus.m_NumberOfElastixLevels                       = 0;
+  this->m_LastStatus.m_Resolution                                  = 0;
+  this->m_LastStatus.m_NumberOfResolutions                         = 0;
+  this->m_LastStatus.m_Iteration                                   = 0;
+  this->m_LastStatus.m_MaximumNumberOfIterations                   = 0;
+  this->m_LastStatus.m_MaximumNumberOfIterationsOfLaterResolutions = 0;
+  this->m_LastStatus.m_MetricValue                                 = 0.0;
+
+} // end Constructor
+
+
+/**
+ * ********************* Open ****************************
+ */
+
+bool
+StatusFile::Open( const std::string & fileName, const double interval )
+{
+  this->m_FileName   = fileName;
+  this->m_Interval   = interval;
+  this->m_Prometheus = fileName.size() >= 5
+    && fileName.compare( fileName.size() - 5, 5, ".prom" ) == 0;
+
+  this->m_StartTime           = itksys::SystemTools::GetTime();
+  this->m_ResolutionStartTime = this->m_StartTime;
+  this->m_LastWriteTime       = this->m_StartTime;
+  this->m_LastProcessorTime   = GetProcessorTime();
+
+  /** Check that the file can be written. */
+  std::ofstream file( ( fileName + ".tmp" ).c_str() );
+  if( !file.is_open() )
+  {
+    this->m_FileName = "";
+    return false;
+  }
+  file.close();
+  std::remove( ( fileName + ".tmp" ).c_str() );
+  return true;
+
+} // end Open()
+
+
+/**
+ * ********************* IsDue ****************************
+ */
+
+bool
+StatusFile::IsDue( void ) const
+{
+  return this->IsOpen()
+         && itksys::SystemTools::GetTime() - this->m_LastWriteTime >= this->m_Interval;
+
+} // end IsDue()
+
+
+/**
+ * ********************* StartResolution ****************************
+ */
+
+void
+StatusFile::StartResolution( void )
+{
+  this->m_ResolutionStartTime = itksys::SystemTools::GetTime();
+
+} // end StartResolution()
+
+
+/**
+ * ********************* Write ****************************
+ */
+
+bool
+StatusFile::Write( const StatusType & status )
+{
+  if( !this->IsOpen() )
+  {
+    return false;
+  }
+
+  /** The rates since the start of the resolution and the previous write. */
+  const double now                = itksys::SystemTools::GetTime();
+  const double processorTime      = GetProcessorTime();
+  const double resolutionTime     = now - this->m_ResolutionStartTime;
+  const double timeSinceLastWrite = now - this->m_LastWriteTime;
+  double       iterationsPerSecond = 0.0;
+  if( status.m_Iteration > 0 && resolutionTime > 0.0 )
+  {
+    iterationsPerSecond = static_cast< double >( status.m_Iteration ) / resolutionTime;
+  }
+  double cpuUtilization = 0.0;
+  if( timeSinceLastWrite > 0.0 )
+  {
+    cpuUtilization = ( processorTime - this->m_LastProcessorTime ) / timeSinceLastWrite;
+  }
+  double eta = -1.0;
+  if( status.m_State == "finished" )
+  {
+    eta = 0.0;
+  }
+  else if( iterationsPerSecond > 0.0 && status.m_MaximumNumberOfIterations > 0 )
+  {
+    const double remaining = ( status.m_Iteration < status.m_MaximumNumberOfIterations
+      ? static_cast< double >( status.m_MaximumNumberOfIterations - status.m_Iteration ) : 0.0 )
+      + static_cast< double >( status.m_MaximumNumberOfIterationsOfLaterResolutions );
+    eta = remaining / iterationsPerSecond;
+  }
+  this->m_LastWriteTime     = now;
+  this->m_LastProcessorTime = processorTime;
+  this->m_LastStatus        = status;
+
+  const unsigned int   threads    = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  const MemoryLoadType memory     = PerformanceTrace::GetMemoryUsage();
+  const MemoryLoadType peakMemory = PerformanceTrace::GetPeakMemoryUsage();
+
+  std::ostringstream text;
+  text.precision( 10 );
+  if( this->m_Prometheus )
+  {
+    const char * const states[] = { "initializing", "running", "finished", "aborted" };
+    text << "# TYPE elastix_state gauge\n";
+    for( unsigned int i = 0; i < 4; ++i )
+    {
+      text << "elastix_state{state=\"" << states[ i ] << "\"} "
+           << ( status.m_State == states[ i ] ? 1 : 0 ) << "\n";
+    }
+    text << "# TYPE elastix_pid gauge\nelastix_pid " << itk::GetProcessIdentifier() << "\n"
+         << "# TYPE elastix_time_seconds gauge\nelastix_time_seconds " << now << "\n"
+         << "# TYPE elastix_elapsed_seconds gauge\nelastix_elapsed_seconds " << now - this->m_StartTime << "\n"
+         << "# TYPE elastix_elastix_level gauge\nelastix_elastix_level " << status.m_ElastixLevel << "\n"
+         << "# TYPE elastix_elastix_levels gauge\nelastix_elastix_levels " << status.m_NumberOfElastixLevels << "\n"
+         << "# TYPE elastix_resolution gauge\nelastix_resolution " << status.m_Resolution << "\n"
+         << "# TYPE elastix_resolutions gauge\nelastix_resolutions " << status.m_NumberOfResolutions << "\n"
+         << "# TYPE elastix_iteration gauge\nelastix_iteration " << status.m_Iteration << "\n"
+         << "# TYPE elastix_maximum_iterations gauge\nelastix_maximum_iterations "
+         << status.m_MaximumNumberOfIterations << "\n"
+         << "# TYPE elastix_metric_value gauge\nelastix_metric_value " << status.m_MetricValue << "\n"
+         << "# TYPE elastix_iterations_per_second gauge\nelastix_iterations_per_second "
+         << iterationsPerSecond << "\n"
+         << "# TYPE elastix_eta_seconds gauge\nelastix_eta_seconds " << eta << "\n"
+         << "# TYPE elastix_threads gauge\nelastix_threads " << threads << "\n"
+         << "# TYPE elastix_cpu_utilization gauge\nelastix_cpu_utilization " << cpuUtilization << "\n"
+         << "# TYPE elastix_memory_bytes gauge\nelastix_memory_bytes " << memory * 1024.0 << "\n"
+         << "# TYPE elastix_peak_memory_bytes gauge\nelastix_peak_memory_bytes " << peakMemory * 1024.0 << "\n";
+  }
+  else
+  {
+    text << "{\"state\":\"" << status.m_State << "\""
+         << ",\"pid\":" << itk::GetProcessIdentifier()
+         << ",\"time\":" << now
+         << ",\"elapsed\":" << now - this->m_StartTime
+         << ",\"elastixLevel\":" << status.m_ElastixLevel
+         << ",\"numberOfElastixLevels\":" << status.m_NumberOfElastixLevels
+         << ",\"resolution\":" << status.m_Resolution
+         << ",\"numberOfResolutions\":" << status.m_NumberOfResolutions
+         << ",\"iteration\":" << status.m_Iteration
+         << ",\"maximumNumberOfIterations\":" << status.m_MaximumNumberOfIterations
+         << ",\"metricValue\":" << status.m_MetricValue
+         << ",\"iterationsPerSecond\":" << iterationsPerSecond
+         << ",\"eta\":" << eta
+         << ",\"threads\":" << threads
+         << ",\"cpuUtilization\":" << cpuUtilization
+         << ",\"memory\":" << memory
+         << ",\"peakMemory\":" << peakMemory
+         << "}\n";
+  }
+
+  /** Write a temporary file, and rename it. Windows does not rename onto
+   * an existing file, so there the old file is removed first.
+   */
+  const std::string temporaryFileName = this->m_FileName + ".tmp";
+  {
+    std::ofstream file( temporaryFileName.c_str() );
+    if( !file.is_open() )
+    {
+      return false;
+    }
+    file << text.str();
+    if( !file )
+    {
+      return false;
+    }
+  }
+#if defined( _WIN32 )
+  std::remove( this->m_FileName.c_str() );
+#endif
+  return std::rename( temporaryFileName.c_str(), this->m_FileName.c_str() ) == 0;
+
+} // end Write()
+
+
+/**
+ * ********************* WriteState ****************************
+ */
+
+bool
+StatusFile::WriteState( const std::string & state )
+{
+  StatusType status = this->m_LastStatus;
+  status.m_State = state;
+  return this->Write( status );
+
+} // end WriteState()
+
+
+/**
+ * ********************* GetProcessorTime ****************************
+ */
+
+double
+StatusFile::GetProcessorTime( void )
+{
+#if defined( _WIN32 )
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if( GetProcessTimes( GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+  {
+    /** In units of 100 ns. */
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+    return static_cast< double >( kernel.QuadPart + user.QuadPart ) * 1.0e-7;
+  }
+#else
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+  {
+    return static_cast< double >( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec )
+           + 1.0e-6 * static_cast< double >( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec );
+  }
+#endif
+  return 0.0;
+
+} // end GetProcessorTime()
+
+
+} // end namespace elastix
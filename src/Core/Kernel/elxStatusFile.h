@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxStatusFile_h
+#define __elxStatusFile_h
+
+#include "itkMemoryUsageObserver.h"
+
+#include <string>
+
+namespace elastix
+{
+
+/**
+ * \class StatusFile
+ * \brief Keeps a machine readable file with the status of a running registration.
+ *
+ * The file is rewritten at most once per interval during the registration,
+ * and at the start of every resolution and at the end. It is written to a
+ * temporary file that is then renamed, so a reader never sees a partial
+ * file. A scheduler can poll it to see whether a job is progressing: the
+ * time field is updated with every write, also when nothing else changes.
+ *
+ * By default the file is a JSON object with the fields:
+ * \li state: "initializing", "running", "finished", or "aborted" if the
+ *   registration stopped with an error.
+ * \li pid: the process id.
+ * \li time: the time of the write, in seconds since 1970, and elapsed: the
+ *   seconds since the status file was opened.
+ * \li elastixLevel, numberOfElastixLevels: the parameter file in the chain
+ *   of -p arguments, counting from 0, and the number of parameter files.
+ * \li resolution, numberOfResolutions: the resolution level, from 0.
+ * \li iteration, maximumNumberOfIterations: the iteration in the resolution,
+ *   and the MaximumNumberOfIterations of the resolution, 0 if unknown.
+ * \li metricValue: the last value of the cost function.
+ * \li iterationsPerSecond: the mean rate of the current resolution.
+ * \li eta: the estimated seconds until the end of this parameter file, or
+ *   -1 if unknown. It assumes that the remaining resolutions run all their
+ *   MaximumNumberOfIterations at the rate of the current resolution, so it
+ *   is an overestimate for optimizers that stop early.
+ * \li threads: the number of threads, and cpuUtilization: the processor
+ *   time of the process per second since the previous write, i.e. the
+ *   number of busy threads.
+ * \li memory, peakMemory: the memory usage of the process and the highest
+ *   memory usage of the process, in kB.
+ *
+ * If the file name ends with ".prom", the same values are written as gauges
+ * in the Prometheus text format, with the prefix "elastix_", for example for
+ * the textfile collector of the Prometheus node exporter.
+ *
+ * ElastixTemplate uses this class for the command line argument -statusfile.
+ */
+
+class StatusFile
+{
+public:
+
+  typedef itk::MemoryUsageObserver::MemoryLoadType MemoryLoadType;
+
+  /** The status of the registration, as far as ElastixTemplate knows it. */
+  struct StatusType
+  {
+    std::string   m_State;
+    unsigned int  m_ElastixLevel;
+    unsigned int  m_NumberOfElastixLevels;
+    unsigned int  m_Resolution;
+    unsigned int  m_NumberOfResolutions;
+    unsigned long m_Iteration;
+    unsigned long m_MaximumNumberOfIterations;
+    unsigned long m_MaximumNumberOfIterationsOfLaterResolutions;
+    double        m_MetricValue;
+  };
+
+  StatusFile();
+  ~StatusFile() {}
+
+  /** Set the file name and the minimum interval between writes, in seconds.
+   * Returns false if the file cannot be written. */
+  bool Open( const std::string & fileName, const double interval );
+
+  /** Stop writing the file. The file itself is kept. */
+  void Close( void ) { this->m_FileName = ""; }
+
+  bool IsOpen( void ) const { return !this->m_FileName.empty(); }
+
+  /** Returns true if the interval has passed since the previous write. */
+  bool IsDue( void ) const;
+
+  /** Restart the measurement of the iteration rate. */
+  void StartResolution( void );
+
+  /** Write the status. Returns false if the file could not be written. */
+  bool Write( const StatusType & status );
+
+  /** Write the last status again, with another state. */
+  bool WriteState( const std::string & state );
+
+  /** The processor time used by the process, in seconds. */
+  static double GetProcessorTime( void );
+
+private:
+
+  StatusFile( const StatusFile & );     // purposely not implemented
+  void operator=( const StatusFile & ); // purposely not implemented
+
+  std::string m_FileName;
+  bool        m_Prometheus;
+  double      m_Interval;
+  double      m_StartTime;
+  double      m_ResolutionStartTime;
+  double      m_LastWriteTime;
+  double      m_LastProcessorTime;
+  StatusType  m_LastStatus;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxStatusFile_h
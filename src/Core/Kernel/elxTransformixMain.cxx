@@ -30,6 +30,7 @@
 
 #ifdef ELASTIX_USE_OPENCL
 #include "itkOpenCLSetup.h"
+#include <sstream>
 #endif
 
 namespace elastix
@@ -81,9 +82,40 @@ TransformixMain::Run( void )
   this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceID,
     "OpenCLDeviceID", 0, false );
 
+  /** Multiple device IDs create a multi-device context. */
+  const std::size_t numberOfOpenCLDeviceIDs
+    = this->m_Configuration->CountNumberOfParameterEntries( "OpenCLDeviceID" );
+
   std::string errorMessage              = "";
-  const bool  creatingContextSuccessful = itk::CreateOpenCLContext(
-    errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
+  bool        creatingContextSuccessful = false;
+  if( numberOfOpenCLDeviceIDs > 1 )
+  {
+    std::vector< int > userSuppliedOpenCLDeviceIDs( numberOfOpenCLDeviceIDs, -1 );
+    for( std::size_t i = 0; i < numberOfOpenCLDeviceIDs; ++i )
+    {
+      this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceIDs[ i ],
+        "OpenCLDeviceID", i, false );
+    }
+    creatingContextSuccessful = itk::CreateOpenCLContext(
+      errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceIDs );
+  }
+  else
+  {
+    creatingContextSuccessful = itk::CreateOpenCLContext(
+      errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
+  }
+
+  /** Pin this run to one device of a multi-device context. By default the
+   * devices are used round-robin by consecutive runs in this process. */
+  if( creatingContextSuccessful )
+  {
+    int userSuppliedOpenCLDeviceIndex = -1;
+    this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceIndex,
+      "OpenCLDeviceIndex", 0, false );
+    creatingContextSuccessful = itk::SelectOpenCLDevice(
+      errorMessage, userSuppliedOpenCLDeviceIndex );
+  }
+
   if( !creatingContextSuccessful )
   {
     /** Report and disable the GPU by releasing the context. */
@@ -152,6 +184,16 @@ TransformixMain::Run( void )
     errorCode = 1;
   }
 
+#ifdef ELASTIX_USE_OPENCL
+  /** Report the OpenCL kernel and transfer times of this run. */
+  std::ostringstream openCLProfilingReport;
+  if( itk::WriteOpenCLProfilingReport( openCLProfilingReport, "transformix",
+    this->m_Configuration->GetCommandLineArgument( "-out" ) ) )
+  {
+    elxout << openCLProfilingReport.str() << std::endl;
+  }
+#endif
+
   /** Save the image container. */
   this->SetMovingImageContainer(
     this->GetElastixBase()->GetMovingImageContainer() );
@@ -284,14 +326,11 @@ TransformixMain::InitDBIndex( void )
     }
 
     /** Load the components. */
-    if( this->s_CDB.IsNull() )
+    int loadReturnCode = this->LoadComponents();
+    if( loadReturnCode != 0 )
     {
-      int loadReturnCode = this->LoadComponents();
-      if( loadReturnCode != 0 )
-      {
-        xl::xout[ "error" ] << "Loading components failed" << std::endl;
-        return loadReturnCode;
-      }
+      xl::xout[ "error" ] << "Loading components failed" << std::endl;
+      return loadReturnCode;
     }
 
     if( this->s_CDB.IsNotNull() )
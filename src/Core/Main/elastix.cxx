@@ -18,10 +18,18 @@
 
 #include "elastix.h"
 #include "elxElastixMain.h"
+#include "itkCPUDispatch.h"
+#include "elxResultCache.h"
+#include "elxParameterSweepRegistration.h"
+#include "elxSliceBatchRegistration.h"
+#include "itkDistributedEvaluation.h"
+#include "itkPersistentThreadPool.h"
 
 int
 main( int argc, char ** argv )
 {
+  /** With MPI, all processes run this registration together. */
+  itk::DistributedEvaluation::Session distributedSession( &argc, &argv );
 
   /** Check if "--help" or "--version" was asked for. */
   if( argc == 1 )
@@ -86,6 +94,7 @@ main( int argc, char ** argv )
   bool                       outFolderPresent = false;
   std::string                outFolder        = "";
   std::string                logFileName      = "";
+  std::string                traceFileName    = "";
 
   /** Put command line parameters into parameterFileList. */
   for( unsigned int i = 1; static_cast< long >( i ) < ( argc - 1 ); i += 2 )
@@ -125,6 +134,18 @@ main( int argc, char ** argv )
           value = value.substr( 1, value.length() - 2 );
         }
 
+        /** The processes other than the first write their output to a
+         * subdirectory, so that they do not overwrite each other's files.
+         */
+        const unsigned int rank = itk::DistributedEvaluation::GetRank();
+        if( rank > 0 )
+        {
+          std::ostringstream rankFolder( "" );
+          rankFolder << value << "rank" << rank << "/";
+          value = rankFolder.str();
+          itksys::SystemTools::MakeDirectory( value.c_str() );
+        }
+
         /** Save this information. */
         outFolderPresent = true;
         outFolder        = value;
@@ -151,6 +172,24 @@ main( int argc, char ** argv )
   /** The argv0 argument, required for finding the component.dll/so's. */
   argMap.insert( ArgumentMapEntryType( "-argv0", argv[ 0 ] ) );
 
+  /** Record a timeline of the run, if asked for. */
+  if( argMap.count( "-trace" ) )
+  {
+    traceFileName = argMap[ "-trace" ];
+    itk::TraceEventRecorder::Enable();
+  }
+
+  /** Pin the workers of the process-wide thread pool, if asked for. This is
+   * done once, before any registration uses the pool, because the pool is
+   * shared by all registrations of this process, also by those of -slices
+   * and -sweep.
+   */
+  if( argMap.count( "-threadaffinity" ) )
+  {
+    itk::PersistentThreadPool::GetGlobalThreadPool()->SetUseThreadAffinity(
+      argMap[ "-threadaffinity" ] == "true" );
+  }
+
   /** Check if at least once the option "-p" is given. */
   if( nrOfParameterFiles == 0 )
   {
@@ -214,6 +253,89 @@ main( int argc, char ** argv )
          << info.GetNumberOfPhysicalCPU() << " cores @ "
          << static_cast< unsigned int >( info.GetProcessorClockFrequency() )
          << " MHz." << std::endl;
+  elxout << "  using the "
+         << itk::CPUDispatch::GetInstructionSetName( itk::CPUDispatch::GetInstructionSet() )
+         << " kernels." << std::endl;
+
+  /** Register the slices of two stacks independently, if asked for. */
+  if( argMap.count( "-slices" ) )
+  {
+    std::vector< std::string > parameterFileNames;
+    while( !parameterFileList.empty() )
+    {
+      parameterFileNames.push_back( parameterFileList.front().second );
+      parameterFileList.pop();
+    }
+
+    {
+      elx::SliceBatchRegistration batch;
+      batch.SetNumberOfWorkers( atoi( argMap[ "-slices" ].c_str() ) );
+      returndummy = batch.Run( argMap, parameterFileNames );
+    }
+
+    totaltimer.Stop();
+    elxout << "\nTotal time elapsed: "
+           << ConvertSecondsToDHMS( totaltimer.GetMean(), 1 ) << ".\n" << std::endl;
+    ElastixMainType::UnloadComponents();
+    WriteTraceEvents( traceFileName );
+    return returndummy;
+  }
+
+  /** Run every parameter file as an independent registration, if asked for. */
+  if( argMap.count( "-sweep" ) )
+  {
+    std::vector< std::string > parameterFileNames;
+    while( !parameterFileList.empty() )
+    {
+      parameterFileNames.push_back( parameterFileList.front().second );
+      parameterFileList.pop();
+    }
+
+    {
+      elx::ParameterSweepRegistration sweep;
+      sweep.SetNumberOfWorkers( atoi( argMap[ "-sweep" ].c_str() ) );
+      if( argMap.count( "-sweepgrid" ) )
+      {
+        sweep.SetGridFileName( argMap[ "-sweepgrid" ] );
+      }
+      returndummy = sweep.Run( argMap, parameterFileNames );
+    }
+
+    totaltimer.Stop();
+    elxout << "\nTotal time elapsed: "
+           << ConvertSecondsToDHMS( totaltimer.GetMean(), 1 ) << ".\n" << std::endl;
+    ElastixMainType::UnloadComponents();
+    WriteTraceEvents( traceFileName );
+    return returndummy;
+  }
+
+  /** Return the results of an identical earlier run, if they are cached. */
+  elx::ResultCache resultCache;
+  const bool       useResultCache = argMap.count( "-resultcache" ) > 0
+    && itk::DistributedEvaluation::GetNumberOfProcesses() == 1;
+  if( useResultCache )
+  {
+    resultCache.SetCacheDirectory( argMap[ "-resultcache" ] );
+    if( argMap.count( "-resultcachesize" ) )
+    {
+      resultCache.SetMaximumSize( atof( argMap[ "-resultcachesize" ].c_str() ) );
+    }
+    std::ostringstream version;
+    version << std::fixed << std::setprecision( 3 ) << __ELASTIX_VERSION;
+    resultCache.ComputeKey( "elastix", version.str(), argMap );
+
+    if( resultCache.Restore( outFolder ) )
+    {
+      elxout << "\nThe results of an identical earlier run were copied from the\n"
+             << "  result cache entry \"" << resultCache.GetCacheDirectory()
+             << resultCache.GetKey() << "\".\n" << std::endl;
+      WriteTraceEvents( traceFileName );
+      return 0;
+    }
+    resultCache.BeginRun( outFolder );
+    elxout << "The results will be stored in the result cache with key "
+           << resultCache.GetKey() << "." << std::endl;
+  }
 
   /**
    * ********************* START REGISTRATION *********************
@@ -268,6 +390,7 @@ main( int argc, char ** argv )
     if( returndummy != 0 )
     {
       xl::xout[ "error" ] << "Errors occurred!" << std::endl;
+      WriteTraceEvents( traceFileName );
       return returndummy;
     }
 
@@ -298,6 +421,13 @@ main( int argc, char ** argv )
 
   elxout << "-------------------------------------------------------------------------" << "\n" << std::endl;
 
+  /** Store the results in the result cache. */
+  if( useResultCache && !resultCache.Store( outFolder, logFileName ) )
+  {
+    xl::xout[ "warning" ] << "WARNING: The results could not be stored in the result cache \""
+                          << resultCache.GetCacheDirectory() << "\"." << std::endl;
+  }
+
   /** Stop totaltimer and print it. */
   totaltimer.Stop();
   elxout << "Total time elapsed: "
@@ -322,6 +452,9 @@ main( int argc, char ** argv )
   /** Close the modules. */
   ElastixMainType::UnloadComponents();
 
+  /** Write the timeline. */
+  WriteTraceEvents( traceFileName );
+
   /** Exit and return the error code. */
   return returndummy;
 
@@ -360,9 +493,35 @@ PrintHelp( void )
   std::cout << "  -fMask    mask for fixed image\n";
   std::cout << "  -mMask    mask for moving image\n";
   std::cout << "  -t0       parameter file for initial transform\n";
+  std::cout << "  -resume   resolution checkpoint of an interrupted run, written with\n"
+            << "            (WriteResolutionCheckpoint \"true\"), to continue from the next resolution\n";
   std::cout << "  -priority set the process priority to high, abovenormal, normal (default),\n"
             << "            belownormal, or idle (Windows only option)\n";
-  std::cout << "  -threads  set the maximum number of threads of elastix\n"
+  std::cout << "  -threads  set the maximum number of threads of elastix\n";
+  std::cout << "  -threadaffinity \"true\" pins the threads of elastix to a processor each;\n"
+            << "            useful on multi-socket machines, default \"false\"\n";
+  std::cout << "  -slices   register each slice of the 3D stacks -f and -m independently,\n"
+            << "            with this number of concurrent registrations (0: one per CPU);\n"
+            << "            the results of slice k are written to the subdirectory slice<k>\n";
+  std::cout << "  -sweep    register -f and -m with each \"-p\" independently, rather than as a\n"
+            << "            chain, with this number of concurrent registrations (0: one per CPU);\n"
+            << "            the results of entry k are written to the subdirectory sweep<k>\n";
+  std::cout << "  -sweepgrid file with alternative values of parameters, combined with each \"-p\"\n"
+            << "            of -sweep; see ParameterSweepRegistration\n";
+  std::cout << "  -imagecache directory in which decoded input images are cached, to be\n"
+            << "            shared by later elastix runs on this machine\n";
+  std::cout << "  -artifactcache directory in which the image pyramids and B-spline\n"
+            << "            coefficients are cached, by the content of the images and the\n"
+            << "            settings, so that later runs on the same images skip computing them\n";
+  std::cout << "  -resultcache directory in which the results of runs are cached; an identical\n"
+            << "            later run, with the same input files and arguments, copies them\n"
+            << "            to its output directory instead of running elastix\n";
+  std::cout << "  -resultcachesize the maximum size of the result cache in MB, default 10240\n";
+  std::cout << "  -statusfile keep the status of the run in this JSON file, or in the Prometheus\n"
+            << "            text format if it ends with .prom, for schedulers; see StatusFile\n";
+  std::cout << "  -statusinterval the minimum time between updates of the status file in\n"
+            << "            seconds, default 1\n";
+  std::cout << "  -trace    write a timeline of the run to this Chrome trace JSON file\n"
             << std::endl;
 
   /** The parameter file.*/
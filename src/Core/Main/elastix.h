@@ -30,6 +30,7 @@
 #include <itksys/SystemTools.hxx>
 #include <itksys/SystemInformation.hxx>
 #include "itkTimeProbe.h"
+#include "itkTraceEventRecorder.h"
 #include <time.h>
 
 /** Declare PrintHelp function.
@@ -102,4 +103,31 @@ GetCurrentDateAndTime( void )
 } // end GetCurrentDateAndTime()
 
 
+/** Write the events recorded by the itk::TraceEventRecorder, when
+ * enabled by the -trace command line argument.
+ *
+ * \commandlinearg -trace: optional argument for elastix and transformix
+ *    with the name of a Chrome trace JSON file, to which a timeline of the
+ *    resolutions, iterations, pyramids, B-spline decompositions and metric
+ *    threads is written. It can be viewed in chrome://tracing or
+ *    https://ui.perfetto.dev. \n
+ *    example: <tt>-trace trace.json</tt> \n
+ */
+void
+WriteTraceEvents( const std::string & traceFileName )
+{
+  if( traceFileName.empty() )
+  {
+    return;
+  }
+
+  itk::TraceEventRecorder::Disable();
+  if( !itk::TraceEventRecorder::WriteToFile( traceFileName ) )
+  {
+    std::cerr << "ERROR: the trace file \"" << traceFileName << "\" could not be written." << std::endl;
+  }
+
+} // end WriteTraceEvents()
+
+
 #endif
@@ -37,17 +37,29 @@
 #include <itksys/SystemInformation.hxx>
 
 #include "itkTimeProbe.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
 #include <time.h>
 
 namespace elastix
 {
 
+/** The asynchronous registrations of the process run one after the other. */
+static itk::SimpleFastMutexLock AsyncRegistrationMutex;
+
 /**
  * ******************* Constructor ***********************
  */
 
 ELASTIX::ELASTIX() :
-  m_ResultImage( 0 )
+  m_ResultImage( 0 ),
+  m_SessionStarted( false ),
+  m_SessionFixedImage( 0 ),
+  m_SessionFixedMask( 0 ),
+  m_MaximumNumberOfThreads( 0 ),
+  m_AsyncMonitor( 0 ),
+  m_AsyncThreader( 0 ),
+  m_AsyncThreadId( 0 )
 {} // end Constructor
 
 
@@ -57,6 +69,15 @@ ELASTIX::ELASTIX() :
 
 ELASTIX::~ELASTIX()
 {
+  if( this->m_AsyncMonitor.IsNotNull() )
+  {
+    this->m_AsyncMonitor->RequestCancel();
+    this->WaitForRegistration();
+  }
+  if( this->m_SessionStarted )
+  {
+    this->EndSession();
+  }
   this->m_ResultImage = 0;
   this->m_TransformParametersList.clear();
 } // end Destructor
@@ -239,6 +260,27 @@ ELASTIX::RegisterImages(
   /** The argv0 argument, required for finding the component.dll/so's. */
   argMap.insert( ArgumentMapEntryType( "-argv0", "elastix" ) );
 
+  /** The thread budget of this registration. */
+  if( this->m_MaximumNumberOfThreads > 0 )
+  {
+    std::ostringstream threads;
+    threads << this->m_MaximumNumberOfThreads;
+    argMap.insert( ArgumentMapEntryType( "-threads", threads.str() ) );
+  }
+
+  /** In a session, each parameter map has its own fixed image pyramid cache. */
+  if( this->m_SessionStarted
+    && this->m_FixedImagePyramidCaches.size() != nrOfParameterFiles )
+  {
+    this->m_FixedImagePyramidCaches.resize( nrOfParameterFiles );
+    this->m_FixedImagePyramidCacheKeys.resize( nrOfParameterFiles );
+    for( i = 0; i < nrOfParameterFiles; i++ )
+    {
+      this->m_FixedImagePyramidCaches[ i ]    = ImageContainerType::New();
+      this->m_FixedImagePyramidCacheKeys[ i ] = "";
+    }
+  }
+
   /** Setup xout. */
   returndummy = elx::xoutSetup( logFileName.c_str(), performLogging, performCout );
   if( returndummy && performCout )
@@ -303,6 +345,11 @@ ELASTIX::RegisterImages(
     elastices[ i ]->SetMovingMaskContainer( movingMaskContainer );
     elastices[ i ]->SetResultImageContainer( resultImageContainer );
     elastices[ i ]->SetOriginalFixedImageDirectionFlat( fixedImageOriginalDirection );
+    if( this->m_SessionStarted )
+    {
+      elastices[ i ]->SetFixedImagePyramidCacheContainer( this->m_FixedImagePyramidCaches[ i ] );
+      elastices[ i ]->SetFixedImagePyramidCacheKey( this->m_FixedImagePyramidCacheKeys[ i ] );
+    }
 
     /** Set the current elastix-level. */
     elastices[ i ]->SetElastixLevel( i );
@@ -326,7 +373,11 @@ ELASTIX::RegisterImages(
     /** Start registration. */
     returndummy = elastices[ i ]->Run( argMap, parameterMaps[ i ] );
 
-    /** Check for errors. */
+    /** Check for errors. A cancel is not an error. */
+    if( returndummy == -3 )
+    {
+      return returndummy;
+    }
     if( returndummy != 0 )
     {
       xl::xout[ "error" ] << "Errors occurred!" << std::endl;
@@ -343,6 +394,10 @@ ELASTIX::RegisterImages(
     movingMaskContainer         = elastices[ i ]->GetMovingMaskContainer();
     resultImageContainer        = elastices[ i ]->GetResultImageContainer();
     fixedImageOriginalDirection = elastices[ i ]->GetOriginalFixedImageDirectionFlat();
+    if( this->m_SessionStarted )
+    {
+      this->m_FixedImagePyramidCacheKeys[ i ] = elastices[ i ]->GetFixedImagePyramidCacheKey();
+    }
 
     /** Stop timer and print it. */
     timer.Stop();
@@ -403,8 +458,11 @@ ELASTIX::RegisterImages(
   movingMaskContainer  = 0;
   resultImageContainer = 0;
 
-  /** Close the modules. */
-  ElastixMainType::UnloadComponents();
+  /** Close the modules, unless they are kept for the next run of a session. */
+  if( !this->m_SessionStarted )
+  {
+    ElastixMainType::UnloadComponents();
+  }
 
   /** Exit and return the error code. */
   return 0;
@@ -412,6 +470,201 @@ ELASTIX::RegisterImages(
 } // end RegisterImages()
 
 
+/**
+ * ******************* RegisterImagesAsync ***********************
+ */
+
+ELASTIX::MonitorPointer
+ELASTIX::RegisterImagesAsync(
+  ImagePointer fixedImage,
+  ImagePointer movingImage,
+  const std::vector< ParameterMapType > & parameterMaps,
+  std::string outputPath,
+  bool performLogging,
+  bool performCout,
+  ImagePointer fixedMask,
+  ImagePointer movingMask )
+{
+  if( this->m_AsyncMonitor.IsNotNull() )
+  {
+    return 0;
+  }
+
+  /** The thread gets copies, so the caller may change its arguments. */
+  this->m_AsyncArguments.m_FixedImage     = fixedImage;
+  this->m_AsyncArguments.m_MovingImage    = movingImage;
+  this->m_AsyncArguments.m_ParameterMaps  = parameterMaps;
+  this->m_AsyncArguments.m_OutputPath     = outputPath;
+  this->m_AsyncArguments.m_PerformLogging = performLogging;
+  this->m_AsyncArguments.m_PerformCout    = performCout;
+  this->m_AsyncArguments.m_FixedMask      = fixedMask;
+  this->m_AsyncArguments.m_MovingMask     = movingMask;
+
+  this->m_AsyncMonitor  = MonitorType::New();
+  this->m_AsyncThreader = itk::MultiThreader::New();
+  this->m_AsyncThreadId = this->m_AsyncThreader->SpawnThread(
+    ELASTIX::AsyncThreadCallback, this );
+
+  return this->m_AsyncMonitor;
+
+} // end RegisterImagesAsync()
+
+
+/**
+ * ******************* AsyncThreadCallback ***********************
+ */
+
+ITK_THREAD_RETURN_TYPE
+ELASTIX::AsyncThreadCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  ELASTIX *            self      = static_cast< ELASTIX * >( infoStruct->UserData );
+  AsyncArgumentsType & arguments = self->m_AsyncArguments;
+
+  int returnValue = 1;
+  {
+    itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( AsyncRegistrationMutex );
+    MonitorType::ActiveMonitorScope activeMonitor( self->m_AsyncMonitor );
+
+    /** A run that was cancelled while it waited does not start. */
+    if( self->m_AsyncMonitor->GetCancelRequested() )
+    {
+      returnValue = -3;
+    }
+    else
+    {
+      try
+      {
+        returnValue = self->RegisterImages( arguments.m_FixedImage,
+          arguments.m_MovingImage, arguments.m_ParameterMaps,
+          arguments.m_OutputPath, arguments.m_PerformLogging,
+          arguments.m_PerformCout, arguments.m_FixedMask, arguments.m_MovingMask );
+      }
+      catch( ... )
+      {
+        returnValue = 1;
+      }
+    }
+  }
+
+  /** Release the inputs before the caller is woken up. */
+  arguments = AsyncArgumentsType();
+  self->m_AsyncMonitor->SetFinished( returnValue );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end AsyncThreadCallback()
+
+
+/**
+ * ******************* WaitForRegistration ***********************
+ */
+
+int
+ELASTIX::WaitForRegistration( void )
+{
+  if( this->m_AsyncMonitor.IsNull() )
+  {
+    return 1;
+  }
+
+  const int returnValue = this->m_AsyncMonitor->WaitForFinished();
+
+  /** TerminateThread() joins the thread. */
+  this->m_AsyncThreader->TerminateThread( this->m_AsyncThreadId );
+  this->m_AsyncThreader = 0;
+  this->m_AsyncMonitor  = 0;
+
+  return returnValue;
+
+} // end WaitForRegistration()
+
+
+/**
+ * ******************* StartSession ***********************
+ */
+
+int
+ELASTIX::StartSession( ImagePointer fixedImage, ImagePointer fixedMask )
+{
+  if( !fixedImage )
+  {
+    return 1;
+  }
+
+  if( this->m_SessionStarted )
+  {
+    this->EndSession();
+  }
+
+  this->m_SessionStarted    = true;
+  this->m_SessionFixedImage = fixedImage;
+  this->m_SessionFixedMask  = fixedMask;
+  this->m_FixedImagePyramidCaches.clear();
+  this->m_FixedImagePyramidCacheKeys.clear();
+
+  return 0;
+
+} // end StartSession()
+
+
+/**
+ * ******************* RegisterMovingImage ***********************
+ */
+
+int
+ELASTIX::RegisterMovingImage(
+  ImagePointer movingImage,
+  std::vector< ParameterMapType > & parameterMaps,
+  std::string outputPath,
+  bool performLogging,
+  bool performCout,
+  ImagePointer movingMask )
+{
+  if( !this->m_SessionStarted )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: RegisterMovingImage() requires StartSession()." << std::endl;
+    }
+    return 1;
+  }
+
+  return this->RegisterImages(
+    this->m_SessionFixedImage, movingImage,
+    parameterMaps,
+    outputPath,
+    performLogging, performCout,
+    this->m_SessionFixedMask, movingMask );
+
+} // end RegisterMovingImage()
+
+
+/**
+ * ******************* EndSession ***********************
+ */
+
+void
+ELASTIX::EndSession( void )
+{
+  if( !this->m_SessionStarted )
+  {
+    return;
+  }
+
+  this->m_SessionStarted    = false;
+  this->m_SessionFixedImage = 0;
+  this->m_SessionFixedMask  = 0;
+  this->m_FixedImagePyramidCaches.clear();
+  this->m_FixedImagePyramidCacheKeys.clear();
+
+  /** Close the modules that were kept during the session. */
+  elx::ElastixMain::UnloadComponents();
+
+} // end EndSession()
+
+
 /** ConvertSecondsToDHMS
  *
  */
@@ -22,7 +22,10 @@
  *  Includes
  */
 #include <itkDataObject.h>
+#include <itkVectorContainer.h>
+#include <itkMultiThreader.h>
 #include "itkParameterFileParser.h"
+#include "itkRegistrationMonitor.h"
 #include "elxMacro.h"
 
 /********************************************************************************
@@ -47,6 +50,14 @@ public:
   typedef itk::ParameterFileParser::ParameterMapType                ParameterMapType;
   typedef std::vector< itk::ParameterFileParser::ParameterMapType > ParameterMapListType;
 
+  //typedefs for the fixed image pyramid caches of a session
+  typedef itk::VectorContainer< unsigned int, ImagePointer > ImageContainerType;
+  typedef ImageContainerType::Pointer                        ImageContainerPointer;
+
+  //typedefs for the monitor of an asynchronous registration
+  typedef itk::RegistrationMonitor  MonitorType;
+  typedef MonitorType::Pointer      MonitorPointer;
+
   /**
    *  Constructor and destructor
    */
@@ -75,6 +86,7 @@ public:
    *     0 = success
    *     1 = error
    *    -2 = output folder does not exist
+   *    -3 = cancelled, see RegisterImagesAsync()
    *    \todo generate file elastix_errors.h containing error codedefines
    *      (e.g. #define ELASTIX_NO_ERROR 0)
    */
@@ -96,6 +108,83 @@ public:
     ImagePointer fixedMask = 0,
     ImagePointer movingMask = 0 );
 
+  /**
+   *  Registration session functionality, for registering many moving images
+   *  to the same fixed image, e.g. an atlas.
+   *  StartSession() stores the fixed image and mask. RegisterMovingImage()
+   *  then registers one moving image, like RegisterImages(), but:
+   *    - the components are loaded once and kept until EndSession();
+   *    - the fixed image pyramid of each parameter map is computed once and
+   *      reused by the following moving images, if possible, see
+   *      ElastixBase::SetFixedImagePyramidCacheContainer().
+   *  The results are available through the getters below after each call.
+   *  Registrations in a session run one after the other: logging and the
+   *  component database are global in elastix. Use SetMaximumNumberOfThreads()
+   *  to bound the threads used by each registration.
+   *  return value: as RegisterImages(), StartSession() returns 1 if the
+   *    fixed image is not set.
+   */
+  int StartSession( ImagePointer fixedImage, ImagePointer fixedMask = 0 );
+
+  int RegisterMovingImage( ImagePointer movingImage,
+    std::vector< ParameterMapType > & parameterMaps,
+    std::string outputPath,
+    bool performLogging,
+    bool performCout,
+    ImagePointer movingMask = 0 );
+
+  void EndSession( void );
+
+  /**
+   *  Asynchronous registration. RegisterImagesAsync() copies the parameter
+   *  maps, starts RegisterImages() in a background thread, and returns at
+   *  once with the monitor of the run, or a null pointer while a previous
+   *  run of this object is not finished with WaitForRegistration().
+   *  The monitor reports the parameter map, the resolution, the iteration
+   *  and the metric values of the current resolution, and invokes an
+   *  itk::ProgressEvent in every iteration, from the registration thread.
+   *  RequestCancel() on the monitor stops the run after the current
+   *  iteration, or at the next threaded metric evaluation; the run then
+   *  returns -3. The reading of the images and the preparation of the
+   *  pyramids are not interrupted.
+   *  WaitForRegistration() blocks until the run is finished and returns the
+   *  return value of RegisterImages(); after that the results are available
+   *  through the getters below.
+   *  Asynchronous registrations run one after the other, also those of
+   *  different ELASTIX objects, because logging and the component database
+   *  are global in elastix: a run that is started while another one is busy
+   *  waits for it. For the same reason, do not call RegisterImages() while an
+   *  asynchronous registration runs.
+   */
+  MonitorPointer RegisterImagesAsync( ImagePointer fixedImage,
+    ImagePointer movingImage,
+    const std::vector< ParameterMapType > & parameterMaps,
+    std::string outputPath,
+    bool performLogging,
+    bool performCout,
+    ImagePointer fixedMask = 0,
+    ImagePointer movingMask = 0 );
+
+  int WaitForRegistration( void );
+
+  bool IsSessionStarted( void ) const { return this->m_SessionStarted; }
+
+  /** Set the maximum number of threads that a registration may use, which
+   *  is the same as the -threads command line argument. 0 means no maximum,
+   *  which is the default.
+   */
+  void SetMaximumNumberOfThreads( const unsigned int threads )
+  {
+    this->m_MaximumNumberOfThreads = threads;
+  }
+
+
+  unsigned int GetMaximumNumberOfThreads( void ) const
+  {
+    return this->m_MaximumNumberOfThreads;
+  }
+
+
   /** Getter for result image. */
   ImagePointer GetResultImage( void );
 
@@ -117,6 +206,38 @@ private:
   /* Final transformation*/
   ParameterMapListType m_TransformParametersList;
 
+  /* Session state: the fixed image and mask, and per parameter map the
+   * cached fixed image pyramid and its key. */
+  bool                                 m_SessionStarted;
+  ImagePointer                         m_SessionFixedImage;
+  ImagePointer                         m_SessionFixedMask;
+  std::vector< ImageContainerPointer > m_FixedImagePyramidCaches;
+  std::vector< std::string >           m_FixedImagePyramidCacheKeys;
+
+  /* Maximum number of threads, 0 means no maximum. */
+  unsigned int m_MaximumNumberOfThreads;
+
+  /* The arguments of RegisterImages() for the asynchronous run. */
+  struct AsyncArgumentsType
+  {
+    ImagePointer                    m_FixedImage;
+    ImagePointer                    m_MovingImage;
+    std::vector< ParameterMapType > m_ParameterMaps;
+    std::string                     m_OutputPath;
+    bool                            m_PerformLogging;
+    bool                            m_PerformCout;
+    ImagePointer                    m_FixedMask;
+    ImagePointer                    m_MovingMask;
+  };
+
+  /* The thread and the monitor of the asynchronous run. */
+  static ITK_THREAD_RETURN_TYPE AsyncThreadCallback( void * arg );
+
+  AsyncArgumentsType          m_AsyncArguments;
+  MonitorPointer              m_AsyncMonitor;
+  itk::MultiThreader::Pointer m_AsyncThreader;
+  itk::ThreadIdType           m_AsyncThreadId;
+
 };
 
 // end class ELASTIX
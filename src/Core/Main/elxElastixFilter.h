@@ -27,6 +27,11 @@
 /**
  * \class ElastixFilter
  * \brief ITK Filter interface to the Elastix registration library.
+ *
+ * Without an output directory the filter runs strictly in memory: no
+ * intermediate result images, transform parameter files or iteration
+ * info files are written, and the initial transform can be given as a
+ * ParameterObject, see SetInitialTransformParameterObject().
  */
 
 namespace elastix
@@ -131,6 +136,16 @@ public:
   itkGetMacro( InitialTransformParameterFileName, std::string );
   virtual void RemoveInitialTransformParameterFileName( void ) { this->SetInitialTransformParameterFileName( "" ); }
 
+  /** Set/Get/Remove the initial transform as a parameter object, for example
+   * the transform parameter object of another ElastixFilter. This avoids
+   * the round-trip through an initial transform parameter file. The maps
+   * refer to their initial transform by index, the last map is applied
+   * first. Do not combine with an initial transform parameter filename.
+   */
+  virtual void SetInitialTransformParameterObject( ParameterObjectType * parameterObject );
+  const ParameterObjectType * GetInitialTransformParameterObject( void ) const;
+  virtual void RemoveInitialTransformParameterObject( void );
+
   /** Set/Get/Remove fixed point set filename. */
   itkSetMacro( FixedPointSetFileName, std::string );
   itkGetMacro( FixedPointSetFileName, std::string );
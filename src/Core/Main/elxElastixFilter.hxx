@@ -128,9 +128,44 @@ ElastixFilter< TFixedImage, TMovingImage >
     itkExceptionMacro( "Empty parameter map in parameter object." );
   }
 
-  // Elastix must always write result image to guarantee that the ITK pipeline is in a consistent state
+  // Elastix must always write result image to guarantee that the ITK pipeline is in a consistent state.
+  // The result images of the other registrations are never used, so skip resampling them.
+  for( unsigned int i = 0; i + 1 < parameterMapVector.size(); ++i )
+  {
+    parameterMapVector[ i ][ "WriteResultImage" ] = ParameterValueVectorType( 1, "false" );
+  }
   parameterMapVector[ parameterMapVector.size() - 1 ][ "WriteResultImage" ] = ParameterValueVectorType( 1, "true" );
 
+  // Without an output directory, elastix runs in memory only: do not write
+  // intermediate images, transform parameter files or iteration info files.
+  if( this->GetOutputDirectory().empty() )
+  {
+    const ParameterValueVectorType falseValue( 1, "false" );
+    for( unsigned int i = 0; i < parameterMapVector.size(); ++i )
+    {
+      parameterMapVector[ i ][ "WriteFinalTransformParameters" ]          = falseValue;
+      parameterMapVector[ i ][ "WriteTransformParametersEachResolution" ] = falseValue;
+      parameterMapVector[ i ][ "WriteTransformParametersEachIteration" ]  = falseValue;
+      parameterMapVector[ i ][ "WriteResultImageAfterEachResolution" ]    = falseValue;
+      parameterMapVector[ i ][ "WriteResultImageAfterEachIteration" ]     = falseValue;
+      parameterMapVector[ i ][ "WritePyramidImagesAfterEachResolution" ]  = falseValue;
+      parameterMapVector[ i ][ "WriteIterationInfo" ]                     = falseValue;
+    }
+  }
+
+  // Get the initial transform parameter maps, if given
+  ParameterMapVectorType      initialTransformParameterMapVector;
+  ParameterObjectConstPointer initialTransformParameterObject = this->GetInitialTransformParameterObject();
+  if( initialTransformParameterObject.IsNotNull() )
+  {
+    if( !this->m_InitialTransformParameterFileName.empty() )
+    {
+      itkExceptionMacro( "Set either an initial transform parameter filename or an initial transform parameter object, not both." );
+    }
+
+    initialTransformParameterMapVector = initialTransformParameterObject->GetParameterMap();
+  }
+
   // Setup argument map
   ArgumentMapType argumentMap;
 
@@ -190,13 +225,20 @@ ElastixFilter< TFixedImage, TMovingImage >
     }
   }
 
-  // Setup xout
-  if( elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
+  // Setup xout. Each run owns its xout objects and log file, so that
+  // filters may run concurrently in different threads. The manager
+  // detaches itself from xout when it goes out of scope.
+  elx::xoutManager xoutManager;
+  if( elx::xoutSetup( xoutManager, logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
   {
     itkExceptionMacro( "Error while setting up xout" );
   }
 
   // Run the (possibly multiple) registration(s)
+  // The transform parameter object starts with the initial transform, so that it describes the full transform
+  const unsigned int numberOfInitialTransforms = initialTransformParameterMapVector.size();
+  transformParameterMapVector = initialTransformParameterMapVector;
+
   for( unsigned int i = 0; i < parameterMapVector.size(); ++i )
   {
     // Set image dimension from input images, override user settings
@@ -214,6 +256,10 @@ ElastixFilter< TFixedImage, TMovingImage >
 
     // Set stuff we get from a previous registration
     elastix->SetInitialTransform( transform );
+    if( i == 0 )
+    {
+      elastix->SetInitialTransformParameterMaps( initialTransformParameterMapVector );
+    }
     elastix->SetFixedImageContainer( fixedImageContainer );
     elastix->SetMovingImageContainer( movingImageContainer );
     elastix->SetFixedMaskContainer( fixedMaskContainer );
@@ -253,11 +299,12 @@ ElastixFilter< TFixedImage, TMovingImage >
       = parameterMapVector[ i ][ "DefaultPixelValue" ];
 
     // Set initial transform to an index number instead of a parameter filename
-    if( i > 0 )
+    if( numberOfInitialTransforms + i > 0 )
     {
       std::stringstream index;
-      index << ( i - 1 ); // MS: Can this be done in the constructor of stringstream?
-      transformParameterMapVector[ i ][ "InitialTransformParametersFileName" ][ 0 ] = index.str();
+      index << ( numberOfInitialTransforms + i - 1 ); // MS: Can this be done in the constructor of stringstream?
+      transformParameterMapVector[ numberOfInitialTransforms + i ][ "InitialTransformParametersFileName" ]
+        = ParameterValueVectorType( 1, index.str() );
     }
   } // End loop over registrations
 
@@ -315,6 +362,45 @@ ElastixFilter< TFixedImage, TMovingImage >
   return itkDynamicCastInDebugMode< const ParameterObjectType * >( itk::ProcessObject::GetInput( "ParameterObject" ) );
 }
 
+/**
+ * ********************* SetInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+ElastixFilter< TFixedImage, TMovingImage >
+::SetInitialTransformParameterObject( ParameterObjectType * parameterObject )
+{
+  this->SetInput( "InitialTransformParameterObject", parameterObject );
+} // end SetInitialTransformParameterObject()
+
+
+/**
+ * ********************* GetInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+const typename ElastixFilter< TFixedImage, TMovingImage >::ParameterObjectType *
+ElastixFilter< TFixedImage, TMovingImage >
+::GetInitialTransformParameterObject( void ) const
+{
+  return itkDynamicCastInDebugMode< const ParameterObjectType * >( itk::ProcessObject::GetInput( "InitialTransformParameterObject" ) );
+} // end GetInitialTransformParameterObject()
+
+
+/**
+ * ********************* RemoveInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+ElastixFilter< TFixedImage, TMovingImage >
+::RemoveInitialTransformParameterObject( void )
+{
+  this->RemoveInput( "InitialTransformParameterObject" );
+} // end RemoveInitialTransformParameterObject()
+
+
 /**
  * ********************* GetTransformParameterObject *********************
  */
@@ -157,8 +157,11 @@ TransformixFilter< TMovingImage >
     }
   }
 
-  // Setup xout
-  if( elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
+  // Setup xout. Each run owns its xout objects and log file, so that
+  // filters may run concurrently in different threads. The manager
+  // detaches itself from xout when it goes out of scope.
+  elx::xoutManager xoutManager;
+  if( elx::xoutSetup( xoutManager, logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
   {
     itkExceptionMacro( "Error while setting up xout" );
   }
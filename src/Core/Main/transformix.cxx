@@ -18,6 +18,8 @@
 
 #include "elastix.h"
 #include "elxTransformixMain.h"
+#include "itkCPUDispatch.h"
+#include "elxResultCache.h"
 
 int
 main( int argc, char ** argv )
@@ -69,6 +71,7 @@ main( int argc, char ** argv )
   bool            outFolderPresent = false;
   std::string     outFolder        = "";
   std::string     logFileName      = "";
+  std::string     traceFileName    = "";
 
   /** Put command line parameters into parameterFileList. */
   for( unsigned int i = 1; static_cast< long >( i ) < argc - 1; i += 2 )
@@ -117,6 +120,13 @@ main( int argc, char ** argv )
   /** The argv0 argument, required for finding the component.dll/so's. */
   argMap.insert( ArgumentMapEntryType( "-argv0", argv[ 0 ] ) );
 
+  /** Record a timeline of the run, if asked for. */
+  if( argMap.count( "-trace" ) )
+  {
+    traceFileName = argMap[ "-trace" ];
+    itk::TraceEventRecorder::Enable();
+  }
+
   /** Check that the option "-tp" is given. */
   if( argMap.count( "-tp" ) == 0 )
   {
@@ -126,6 +136,7 @@ main( int argc, char ** argv )
 
   /** Check that at least one of the following options is given. */
   if( argMap.count( "-in" ) == 0
+    && argMap.count( "-in0" ) == 0
     && argMap.count( "-ipp" ) == 0
     && argMap.count( "-def" ) == 0
     && argMap.count( "-jac" ) == 0
@@ -192,6 +203,36 @@ main( int argc, char ** argv )
          << info.GetNumberOfPhysicalCPU() << " cores @ "
          << static_cast< unsigned int >( info.GetProcessorClockFrequency() )
          << " MHz." << std::endl;
+  elxout << "  using the "
+         << itk::CPUDispatch::GetInstructionSetName( itk::CPUDispatch::GetInstructionSet() )
+         << " kernels." << std::endl;
+
+  /** Return the results of an identical earlier run, if they are cached. */
+  elx::ResultCache resultCache;
+  const bool       useResultCache = argMap.count( "-resultcache" ) > 0;
+  if( useResultCache )
+  {
+    resultCache.SetCacheDirectory( argMap[ "-resultcache" ] );
+    if( argMap.count( "-resultcachesize" ) )
+    {
+      resultCache.SetMaximumSize( atof( argMap[ "-resultcachesize" ].c_str() ) );
+    }
+    std::ostringstream version;
+    version << std::fixed << std::setprecision( 3 ) << __ELASTIX_VERSION;
+    resultCache.ComputeKey( "transformix", version.str(), argMap );
+
+    if( resultCache.Restore( outFolder ) )
+    {
+      elxout << "\nThe results of an identical earlier run were copied from the\n"
+             << "  result cache entry \"" << resultCache.GetCacheDirectory()
+             << resultCache.GetKey() << "\".\n" << std::endl;
+      WriteTraceEvents( traceFileName );
+      return 0;
+    }
+    resultCache.BeginRun( outFolder );
+    elxout << "The results will be stored in the result cache with key "
+           << resultCache.GetKey() << "." << std::endl;
+  }
 
   /**
    * ********************* START TRANSFORMATION *******************
@@ -211,9 +252,17 @@ main( int argc, char ** argv )
   if( returndummy != 0 )
   {
     xl::xout[ "error" ] << "Errors occurred" << std::endl;
+    WriteTraceEvents( traceFileName );
     return returndummy;
   }
 
+  /** Store the results in the result cache. */
+  if( useResultCache && !resultCache.Store( outFolder, logFileName ) )
+  {
+    xl::xout[ "warning" ] << "WARNING: The results could not be stored in the result cache \""
+                          << resultCache.GetCacheDirectory() << "\"." << std::endl;
+  }
+
   /** Stop timer and print it. */
   totaltimer.Stop();
   elxout << "\ntransformix has finished at " << GetCurrentDateAndTime() << "." << std::endl;
@@ -224,6 +273,9 @@ main( int argc, char ** argv )
   transformix = 0;
   TransformixMainType::UnloadComponents();
 
+  /** Write the timeline. */
+  WriteTraceEvents( traceFileName );
+
   /** Exit and return the error code. */
   return returndummy;
 
@@ -258,6 +310,9 @@ PrintHelp( void )
   /** Optional arguments. */
   std::cout << "Optional extra commands:\n";
   std::cout << "  -in       input image to deform\n";
+  std::cout << "  -in0, -in1, etc.\n"
+            << "            several input images, deformed with one evaluation of the\n"
+            << "            transform, and written to result.0, result.1, etc.\n";
   std::cout << "  -def      file containing input-image points; the point are transformed\n"
             << "            according to the specified transform-parameter file\n";
   std::cout << "            use \"-def all\" to transform all points from the input-image, which\n"
@@ -269,6 +324,13 @@ PrintHelp( void )
   std::cout << "  -priority set the process priority to high, abovenormal, normal (default),\n"
             << "            belownormal, or idle (Windows only option)\n";
   std::cout << "  -threads  set the maximum number of threads of transformix\n";
+  std::cout << "  -imagecache directory in which decoded input images are cached, to be\n"
+            << "            shared by later transformix runs on this machine\n";
+  std::cout << "  -resultcache directory in which the results of runs are cached; an identical\n"
+            << "            later run, with the same input files and arguments, copies them\n"
+            << "            to its output directory instead of running transformix\n";
+  std::cout << "  -resultcachesize the maximum size of the result cache in MB, default 10240\n";
+  std::cout << "  -trace    write a timeline of the run to this Chrome trace JSON file\n";
   std::cout << "\nAt least one of the options \"-in\", \"-def\", \"-jac\", or \"-jacmat\" should be given.\n"
             << std::endl;
 
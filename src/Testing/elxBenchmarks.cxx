@@ -0,0 +1,854 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+/** \file
+ \brief Benchmark the hot code of elastix: metrics, samplers, interpolators and transforms.
+
+ Every benchmark is run for all combinations of the requested image sizes,
+ numbers of threads and B-spline grid sizes that it depends on. The fastest
+ of a number of repetitions is reported, and written to a JSON file. When a
+ baseline file, written by an earlier run on the same machine, is given,
+ the benchmarks that became slower than allowed make the program fail.
+ */
+#include "itkCommandLineArgumentParser.h"
+
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+#include "itkTimeProbe.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+/** Transforms. */
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkRecursiveBSplineTransform.h"
+
+/** Interpolators. */
+#include "itkAdvancedLinearInterpolateImageFunction.h"
+#include "itkBSplineInterpolateImageFunction.h"
+
+/** Samplers. */
+#include "itkImageFullSampler.h"
+#include "itkImageGridSampler.h"
+#include "itkImageRandomSampler.h"
+#include "itkImageRandomCoordinateSampler.h"
+
+/** Metrics. */
+#include "AdvancedMeanSquares/itkAdvancedMeanSquaresImageToImageMetric.h"
+#include "AdvancedNormalizedCorrelation/itkAdvancedNormalizedCorrelationImageToImageMetric.h"
+#include "AdvancedMattesMutualInformation/itkParzenWindowMutualInformationImageToImageMetric.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+/** The types of all benchmarks. */
+const unsigned int Dimension   = 3;
+const unsigned int SplineOrder = 3;
+
+typedef float                                                           PixelType;
+typedef itk::Image< PixelType, Dimension >                              ImageType;
+typedef ImageType::SizeType                                             SizeType;
+typedef ImageType::PointType                                            PointType;
+typedef ImageType::SpacingType                                          SpacingType;
+typedef itk::ContinuousIndex< double, Dimension >                       ContinuousIndexType;
+typedef itk::RecursiveBSplineTransform< double, Dimension, SplineOrder > RecursiveTransformType;
+typedef itk::AdvancedBSplineDeformableTransform<
+  double, Dimension, SplineOrder >                                      BSplineTransformType;
+typedef RecursiveTransformType::ParametersType                          ParametersType;
+typedef RecursiveTransformType::DerivativeType                          DerivativeType;
+typedef itk::ImageSamplerBase< ImageType >                              ImageSamplerType;
+typedef itk::Statistics::MersenneTwisterRandomVariateGenerator          RandomGeneratorType;
+
+/** The number of points for the interpolator and transform benchmarks,
+ * and the number of samples for the metrics. Distinguish between Debug
+ * and Release mode.
+ */
+#ifndef NDEBUG
+const unsigned int NumberOfPoints  = 5000;
+const unsigned int NumberOfSamples = 2000;
+#else
+const unsigned int NumberOfPoints  = 100000;
+const unsigned int NumberOfSamples = 20000;
+#endif
+
+/** Avoid that the compiler optimizes the benchmarked code away. */
+static double benchmarkSink = 0.0;
+
+/**
+ * ******************* GetHelpString *******************
+ */
+
+std::string
+GetHelpString( void )
+{
+  std::stringstream ss;
+  ss << "Usage:" << std::endl
+     << "elastix_benchmarks" << std::endl
+     << "  [-out]       JSON file to write the results to\n"
+     << "  [-base]      JSON file with the baseline results, from an earlier run\n"
+     << "  [-t]         allowed slow down with respect to the baseline, default 0.25\n"
+     << "  [-size]      image sizes, the number of voxels along each axis, default 32 64\n"
+     << "  [-threads]   numbers of threads, default 1 and the number of cores\n"
+     << "  [-grid]      B-spline grid sizes, along each axis, default 8 16\n"
+     << "  [-r]         number of repetitions of which the fastest is reported, default 5\n"
+     << "  [-filter]    only run the benchmarks whose name contains this string\n"
+     << "Benchmarks GetValueAndDerivative() of the metrics, the samplers, the\n"
+     << "interpolators and the batched calls of the B-spline transforms.";
+  return ss.str();
+
+} // end GetHelpString()
+
+
+/**
+ * ******************* BenchmarkCase *******************
+ *
+ * The code that is timed, and the name under which it is reported.
+ */
+
+class BenchmarkCase
+{
+public:
+
+  virtual ~BenchmarkCase() {}
+
+  /** Prepare everything that should not be timed. */
+  virtual void SetUp( void ) {}
+
+  /** The code that is timed. */
+  virtual void Run( void ) = 0;
+
+  std::string m_Name;
+};
+
+/**
+ * ******************* Helpers *******************
+ */
+
+/** A smooth test image: a blob, shifted along the first axis. */
+ImageType::Pointer
+CreateImage( const unsigned int size, const double shift )
+{
+  SizeType imageSize;
+  imageSize.Fill( size );
+  SpacingType spacing;
+  spacing.Fill( 1.0 );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( imageSize );
+  image->SetSpacing( spacing );
+  image->Allocate();
+
+  const double center = 0.5 * ( size - 1 );
+  const double sigma  = 0.25 * size;
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    double r2 = 0.0;
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      const double x = it.GetIndex()[ d ] - center - ( d == 0 ? shift : 0.0 );
+      r2 += x * x;
+    }
+    it.Set( static_cast< PixelType >( 100.0 * vcl_exp( -r2 / ( 2.0 * sigma * sigma ) ) ) );
+  }
+
+  return image;
+
+} // end CreateImage()
+
+
+/** Place a B-spline grid of gridSize control points per axis over the
+ * image, and give the coefficients smooth random values.
+ */
+template< class TTransform >
+void
+InitializeTransform( TTransform * transform, const ImageType * image,
+  const unsigned int gridSize, ParametersType & parameters )
+{
+  typename TTransform::RegionType gridRegion;
+  typename TTransform::SizeType   size;
+  size.Fill( gridSize );
+  gridRegion.SetSize( size );
+
+  typename TTransform::SpacingType gridSpacing;
+  typename TTransform::OriginType  gridOrigin;
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    const double extent = image->GetLargestPossibleRegion().GetSize()[ d ] * image->GetSpacing()[ d ];
+    gridSpacing[ d ] = extent / ( gridSize - SplineOrder );
+    gridOrigin[ d ]  = image->GetOrigin()[ d ] - gridSpacing[ d ];
+  }
+  typename TTransform::DirectionType gridDirection;
+  gridDirection.SetIdentity();
+
+  transform->SetGridOrigin( gridOrigin );
+  transform->SetGridSpacing( gridSpacing );
+  transform->SetGridRegion( gridRegion );
+  transform->SetGridDirection( gridDirection );
+
+  RandomGeneratorType::Pointer random = RandomGeneratorType::New();
+  random->SetSeed( 12345 );
+  parameters.SetSize( transform->GetNumberOfParameters() );
+  for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+  {
+    parameters[ i ] = random->GetUniformVariate( -1.0, 1.0 );
+  }
+  transform->SetParameters( parameters );
+
+} // end InitializeTransform()
+
+
+/** Random points inside the image. */
+void
+CreatePoints( const ImageType * image, std::vector< PointType > & points )
+{
+  RandomGeneratorType::Pointer random = RandomGeneratorType::New();
+  random->SetSeed( 54321 );
+  points.resize( NumberOfPoints );
+  for( unsigned int i = 0; i < NumberOfPoints; ++i )
+  {
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      const double size = image->GetLargestPossibleRegion().GetSize()[ d ] - 1;
+      points[ i ][ d ] = image->GetOrigin()[ d ] + random->GetUniformVariate( 0.0, size );
+    }
+  }
+
+} // end CreatePoints()
+
+
+/** The name of a benchmark with its configuration. */
+std::string
+MakeName( const std::string & name, const int size, const int threads, const int grid )
+{
+  std::ostringstream ss;
+  ss << name;
+  if( size > 0 ) { ss << "/size=" << size; }
+  if( threads > 0 ) { ss << "/threads=" << threads; }
+  if( grid > 0 ) { ss << "/grid=" << grid; }
+  return ss.str();
+
+} // end MakeName()
+
+
+/**
+ * ******************* Metric benchmarks *******************
+ */
+
+template< class TMetric >
+class MetricBenchmark : public BenchmarkCase
+{
+public:
+
+  typedef itk::ImageRandomSampler< ImageType >                          SamplerType;
+  typedef itk::AdvancedLinearInterpolateImageFunction< ImageType, double > InterpolatorType;
+
+  MetricBenchmark( const std::string & name, const unsigned int size,
+    const unsigned int threads, const unsigned int grid )
+  {
+    this->m_Name    = MakeName( name + "/GetValueAndDerivative", size, threads, grid );
+    this->m_Size    = size;
+    this->m_Threads = threads;
+    this->m_Grid    = grid;
+  }
+
+
+  virtual void SetUp( void )
+  {
+    this->m_FixedImage  = CreateImage( this->m_Size, 0.0 );
+    this->m_MovingImage = CreateImage( this->m_Size, 0.1 * this->m_Size );
+
+    this->m_Transform = RecursiveTransformType::New();
+    InitializeTransform( this->m_Transform.GetPointer(), this->m_FixedImage.GetPointer(),
+      this->m_Grid, this->m_Parameters );
+
+    typename SamplerType::Pointer sampler = SamplerType::New();
+    sampler->SetNumberOfSamples( NumberOfSamples );
+
+    typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+
+    this->m_Metric = TMetric::New();
+    this->m_Metric->SetFixedImage( this->m_FixedImage );
+    this->m_Metric->SetMovingImage( this->m_MovingImage );
+    this->m_Metric->SetFixedImageRegion( this->m_FixedImage->GetLargestPossibleRegion() );
+    this->m_Metric->SetTransform( this->m_Transform );
+    this->m_Metric->SetInterpolator( interpolator );
+    this->m_Metric->SetImageSampler( sampler );
+    this->m_Metric->SetUseImageSampler( true );
+    this->m_Metric->SetNumberOfThreads( this->m_Threads );
+    this->m_Metric->SetUseMultiThread( this->m_Threads > 1 );
+    this->m_Metric->SetUseMetricSingleThreaded( this->m_Threads == 1 );
+    this->Configure( this->m_Metric );
+    this->m_Metric->Initialize();
+
+    /** Draw the samples once, so only the metric itself is timed. */
+    sampler->Update();
+  }
+
+
+  virtual void Run( void )
+  {
+    typename TMetric::MeasureType value = 0.0;
+    DerivativeType                derivative;
+    this->m_Metric->GetValueAndDerivative( this->m_Parameters, value, derivative );
+    benchmarkSink += value;
+  }
+
+
+  /** Metric specific settings. */
+  virtual void Configure( TMetric * ) {}
+
+protected:
+
+  unsigned int                     m_Size;
+  unsigned int                     m_Threads;
+  unsigned int                     m_Grid;
+  ImageType::Pointer               m_FixedImage;
+  ImageType::Pointer               m_MovingImage;
+  RecursiveTransformType::Pointer  m_Transform;
+  ParametersType                   m_Parameters;
+  typename TMetric::Pointer        m_Metric;
+};
+
+typedef itk::AdvancedMeanSquaresImageToImageMetric< ImageType, ImageType >           MeanSquaresMetricType;
+typedef itk::AdvancedNormalizedCorrelationImageToImageMetric< ImageType, ImageType > NormalizedCorrelationMetricType;
+typedef itk::ParzenWindowMutualInformationImageToImageMetric< ImageType, ImageType > MutualInformationMetricType;
+
+class MutualInformationBenchmark : public MetricBenchmark< MutualInformationMetricType >
+{
+public:
+
+  MutualInformationBenchmark( const unsigned int size, const unsigned int threads,
+    const unsigned int grid ) :
+    MetricBenchmark< MutualInformationMetricType >( "AdvancedMattesMutualInformation", size, threads, grid )
+  {}
+
+  virtual void Configure( MutualInformationMetricType * metric )
+  {
+    metric->SetNumberOfFixedHistogramBins( 32 );
+    metric->SetNumberOfMovingHistogramBins( 32 );
+  }
+};
+
+/**
+ * ******************* Sampler benchmarks *******************
+ */
+
+class SamplerBenchmark : public BenchmarkCase
+{
+public:
+
+  SamplerBenchmark( const std::string & name, ImageSamplerType * sampler,
+    const unsigned int size, const unsigned int threads )
+  {
+    this->m_Name    = MakeName( name + "/Update", size, threads, 0 );
+    this->m_Sampler = sampler;
+    this->m_Size    = size;
+    this->m_Threads = threads;
+  }
+
+
+  virtual void SetUp( void )
+  {
+    this->m_Image = CreateImage( this->m_Size, 0.0 );
+    this->m_Sampler->SetInput( this->m_Image );
+    this->m_Sampler->SetInputImageRegion( this->m_Image->GetLargestPossibleRegion() );
+    this->m_Sampler->SetNumberOfThreads( this->m_Threads );
+    this->m_Sampler->SetUseMultiThread( this->m_Threads > 1 );
+  }
+
+
+  virtual void Run( void )
+  {
+    /** Force new samples in every repetition. */
+    this->m_Sampler->Modified();
+    this->m_Sampler->Update();
+    benchmarkSink += this->m_Sampler->GetOutput()->Size();
+  }
+
+protected:
+
+  ImageSamplerType::Pointer m_Sampler;
+  ImageType::Pointer        m_Image;
+  unsigned int              m_Size;
+  unsigned int              m_Threads;
+};
+
+/**
+ * ******************* Interpolator benchmarks *******************
+ */
+
+template< class TInterpolator >
+class InterpolatorBenchmark : public BenchmarkCase
+{
+public:
+
+  InterpolatorBenchmark( const std::string & name, const unsigned int size )
+  {
+    this->m_Name = MakeName( name + "/EvaluateValueAndDerivative", size, 0, 0 );
+    this->m_Size = size;
+  }
+
+
+  virtual void SetUp( void )
+  {
+    this->m_Image        = CreateImage( this->m_Size, 0.0 );
+    this->m_Interpolator = TInterpolator::New();
+    this->Configure( this->m_Interpolator );
+    this->m_Interpolator->SetInputImage( this->m_Image );
+
+    std::vector< PointType > points;
+    CreatePoints( this->m_Image, points );
+    this->m_Indices.resize( points.size() );
+    for( unsigned int i = 0; i < points.size(); ++i )
+    {
+      this->m_Image->TransformPhysicalPointToContinuousIndex( points[ i ], this->m_Indices[ i ] );
+    }
+  }
+
+
+  virtual void Run( void )
+  {
+    typename TInterpolator::OutputType          value;
+    typename TInterpolator::CovariantVectorType derivative;
+    for( unsigned int i = 0; i < this->m_Indices.size(); ++i )
+    {
+      this->m_Interpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+        this->m_Indices[ i ], value, derivative );
+      benchmarkSink += value;
+    }
+  }
+
+
+  virtual void Configure( TInterpolator * ) {}
+
+protected:
+
+  unsigned int                        m_Size;
+  ImageType::Pointer                  m_Image;
+  typename TInterpolator::Pointer     m_Interpolator;
+  std::vector< ContinuousIndexType >  m_Indices;
+};
+
+typedef itk::AdvancedLinearInterpolateImageFunction< ImageType, double > LinearInterpolatorType;
+typedef itk::BSplineInterpolateImageFunction< ImageType, double, double > BSplineInterpolatorType;
+
+class BSplineInterpolatorBenchmark : public InterpolatorBenchmark< BSplineInterpolatorType >
+{
+public:
+
+  BSplineInterpolatorBenchmark( const unsigned int order, const unsigned int size ) :
+    InterpolatorBenchmark< BSplineInterpolatorType >( "BSplineInterpolator", size )
+  {
+    std::ostringstream ss;
+    ss << "BSplineInterpolator/order=" << order;
+    this->m_Name  = MakeName( ss.str() + "/EvaluateValueAndDerivative", size, 0, 0 );
+    this->m_Order = order;
+  }
+
+  virtual void Configure( BSplineInterpolatorType * interpolator )
+  {
+    interpolator->SetSplineOrder( this->m_Order );
+  }
+
+protected:
+
+  unsigned int m_Order;
+};
+
+/**
+ * ******************* Transform benchmarks *******************
+ */
+
+template< class TTransform >
+class TransformBenchmark : public BenchmarkCase
+{
+public:
+
+  typedef typename TTransform::OutputPointType            OutputPointType;
+  typedef typename TTransform::ParametersValueType        ParametersValueType;
+  typedef typename TTransform::MovingImageGradientType    MovingImageGradientType;
+  typedef typename TTransform::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+
+  typedef enum { TransformPoints, GetJacobians, JacobianWithImageGradientProduct } CallType;
+
+  TransformBenchmark( const std::string & name, const CallType call, const unsigned int grid )
+  {
+    const char * calls[] = { "TransformPoints", "GetJacobians", "EvaluateJacobianWithImageGradientProduct" };
+    this->m_Name = MakeName( name + "/" + calls[ call ], 0, 0, grid );
+    this->m_Call = call;
+    this->m_Grid = grid;
+  }
+
+
+  virtual void SetUp( void )
+  {
+    ImageType::Pointer image = CreateImage( 64, 0.0 );
+    this->m_Transform = TTransform::New();
+    InitializeTransform( this->m_Transform.GetPointer(), image.GetPointer(),
+      this->m_Grid, this->m_Parameters );
+    CreatePoints( image, this->m_Points );
+
+    const unsigned long nnzji = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+    if( this->m_Call == TransformPoints )
+    {
+      this->m_OutputPoints.resize( this->m_Points.size() );
+    }
+    else if( this->m_Call == GetJacobians )
+    {
+      /** The Jacobians of all points may not fit in memory, so compute them
+       * in blocks of 1000 points.
+       */
+      this->m_Jacobians.resize( 1000 * Dimension * nnzji );
+      this->m_NonZeroJacobianIndices.resize( 1000 * nnzji );
+    }
+    else
+    {
+      this->m_ImageJacobian.SetSize( nnzji );
+      this->m_NonZeroJacobianIndicesOfPoint.resize( nnzji );
+    }
+  }
+
+
+  virtual void Run( void )
+  {
+    const unsigned long numberOfPoints = this->m_Points.size();
+    if( this->m_Call == TransformPoints )
+    {
+      this->m_Transform->TransformPoints( &this->m_Points[ 0 ], numberOfPoints, &this->m_OutputPoints[ 0 ] );
+      benchmarkSink += this->m_OutputPoints[ 0 ][ 0 ];
+    }
+    else if( this->m_Call == GetJacobians )
+    {
+      for( unsigned long i = 0; i < numberOfPoints; i += 1000 )
+      {
+        const unsigned long n = std::min( 1000ul, numberOfPoints - i );
+        this->m_Transform->GetJacobians( &this->m_Points[ i ], n,
+          &this->m_Jacobians[ 0 ], &this->m_NonZeroJacobianIndices[ 0 ] );
+        benchmarkSink += this->m_Jacobians[ 0 ];
+      }
+    }
+    else
+    {
+      MovingImageGradientType gradient;
+      gradient[ 0 ] = 29.43; gradient[ 1 ] = 18.21; gradient[ 2 ] = 1.7;
+      for( unsigned long i = 0; i < numberOfPoints; ++i )
+      {
+        this->m_Transform->EvaluateJacobianWithImageGradientProduct(
+          this->m_Points[ i ], gradient, this->m_ImageJacobian, this->m_NonZeroJacobianIndicesOfPoint );
+        benchmarkSink += this->m_ImageJacobian[ 0 ];
+      }
+    }
+  }
+
+protected:
+
+  CallType                           m_Call;
+  unsigned int                       m_Grid;
+  typename TTransform::Pointer       m_Transform;
+  ParametersType                     m_Parameters;
+  std::vector< PointType >           m_Points;
+  std::vector< OutputPointType >     m_OutputPoints;
+  std::vector< ParametersValueType > m_Jacobians;
+  std::vector< unsigned long >       m_NonZeroJacobianIndices;
+  DerivativeType                     m_ImageJacobian;
+  NonZeroJacobianIndicesType         m_NonZeroJacobianIndicesOfPoint;
+};
+
+/**
+ * ******************* RunBenchmark *******************
+ *
+ * Returns the fastest of a number of repetitions, in seconds.
+ */
+
+double
+RunBenchmark( BenchmarkCase & benchmark, const unsigned int repetitions )
+{
+  benchmark.SetUp();
+
+  /** A first, untimed run, to warm up the caches. */
+  benchmark.Run();
+
+  double fastest = 0.0;
+  for( unsigned int r = 0; r < repetitions; ++r )
+  {
+    itk::TimeProbe timer;
+    timer.Start();
+    benchmark.Run();
+    timer.Stop();
+    if( r == 0 || timer.GetTotal() < fastest )
+    {
+      fastest = timer.GetTotal();
+    }
+  }
+  return fastest;
+
+} // end RunBenchmark()
+
+
+/**
+ * ******************* WriteResults *******************
+ *
+ * Writes one benchmark per line, which ReadResults() relies on.
+ */
+
+bool
+WriteResults( const std::string & fileName,
+  const std::vector< std::pair< std::string, double > > & results )
+{
+  std::ofstream output( fileName.c_str() );
+  if( !output.is_open() )
+  {
+    return false;
+  }
+
+  output << "{\n  \"benchmarks\": [\n";
+  output << std::setprecision( 6 ) << std::scientific;
+  for( unsigned int i = 0; i < results.size(); ++i )
+  {
+    output << "    { \"name\": \"" << results[ i ].first
+           << "\", \"seconds\": " << results[ i ].second
+           << ( i + 1 < results.size() ? " },\n" : " }\n" );
+  }
+  output << "  ]\n}\n";
+  return output.good();
+
+} // end WriteResults()
+
+
+/**
+ * ******************* ReadResults *******************
+ *
+ * Reads a file written by WriteResults(). This is not a general JSON reader.
+ */
+
+bool
+ReadResults( const std::string & fileName, std::map< std::string, double > & results )
+{
+  std::ifstream input( fileName.c_str() );
+  if( !input.is_open() )
+  {
+    return false;
+  }
+
+  const std::string nameKey    = "\"name\": \"";
+  const std::string secondsKey = "\"seconds\": ";
+  std::string       line;
+  while( std::getline( input, line ) )
+  {
+    const std::string::size_type namePos    = line.find( nameKey );
+    const std::string::size_type secondsPos = line.find( secondsKey );
+    if( namePos == std::string::npos || secondsPos == std::string::npos )
+    {
+      continue;
+    }
+    const std::string::size_type nameBegin = namePos + nameKey.size();
+    const std::string::size_type nameEnd   = line.find( '"', nameBegin );
+    std::istringstream           seconds( line.substr( secondsPos + secondsKey.size() ) );
+    double                       value = 0.0;
+    if( nameEnd != std::string::npos && ( seconds >> value ) )
+    {
+      results[ line.substr( nameBegin, nameEnd - nameBegin ) ] = value;
+    }
+  }
+  return true;
+
+} // end ReadResults()
+
+
+/**
+ * ******************* main *******************
+ */
+
+int
+main( int argc, char ** argv )
+{
+  /** Create command line argument parser. */
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    return EXIT_SUCCESS;
+  }
+
+  std::string outputFileName;
+  parser->GetCommandLineArgument( "-out", outputFileName );
+  std::string baselineFileName;
+  parser->GetCommandLineArgument( "-base", baselineFileName );
+  double allowedSlowDown = 0.25;
+  parser->GetCommandLineArgument( "-t", allowedSlowDown );
+  unsigned int repetitions = 5;
+  parser->GetCommandLineArgument( "-r", repetitions );
+  std::string filter;
+  parser->GetCommandLineArgument( "-filter", filter );
+
+  std::vector< unsigned int > sizes;
+  sizes.push_back( 32 ); sizes.push_back( 64 );
+  parser->GetCommandLineArgument( "-size", sizes );
+  std::vector< unsigned int > grids;
+  grids.push_back( 8 ); grids.push_back( 16 );
+  parser->GetCommandLineArgument( "-grid", grids );
+  std::vector< unsigned int > threads;
+  threads.push_back( 1 );
+  const unsigned int cores = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if( cores > 1 ) { threads.push_back( cores ); }
+  parser->GetCommandLineArgument( "-threads", threads );
+
+  if( allowedSlowDown < 0.0 || repetitions == 0 )
+  {
+    std::cerr << "ERROR: -t should be non-negative and -r positive." << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( unsigned int i = 0; i < grids.size(); ++i )
+  {
+    if( grids[ i ] <= SplineOrder )
+    {
+      std::cerr << "ERROR: the B-spline grid sizes should be larger than " << SplineOrder << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** Collect the benchmarks. */
+  std::vector< BenchmarkCase * > benchmarks;
+  for( unsigned int s = 0; s < sizes.size(); ++s )
+  {
+    for( unsigned int t = 0; t < threads.size(); ++t )
+    {
+      for( unsigned int g = 0; g < grids.size(); ++g )
+      {
+        benchmarks.push_back( new MetricBenchmark< MeanSquaresMetricType >(
+          "AdvancedMeanSquares", sizes[ s ], threads[ t ], grids[ g ] ) );
+        benchmarks.push_back( new MetricBenchmark< NormalizedCorrelationMetricType >(
+          "AdvancedNormalizedCorrelation", sizes[ s ], threads[ t ], grids[ g ] ) );
+        benchmarks.push_back( new MutualInformationBenchmark( sizes[ s ], threads[ t ], grids[ g ] ) );
+      }
+
+      itk::ImageFullSampler< ImageType >::Pointer fullSampler = itk::ImageFullSampler< ImageType >::New();
+      benchmarks.push_back( new SamplerBenchmark( "ImageFullSampler", fullSampler, sizes[ s ], threads[ t ] ) );
+
+      itk::ImageGridSampler< ImageType >::Pointer gridSampler = itk::ImageGridSampler< ImageType >::New();
+      gridSampler->SetNumberOfSamples( NumberOfSamples );
+      benchmarks.push_back( new SamplerBenchmark( "ImageGridSampler", gridSampler, sizes[ s ], threads[ t ] ) );
+
+      itk::ImageRandomSampler< ImageType >::Pointer randomSampler = itk::ImageRandomSampler< ImageType >::New();
+      randomSampler->SetNumberOfSamples( NumberOfSamples );
+      benchmarks.push_back( new SamplerBenchmark( "ImageRandomSampler", randomSampler, sizes[ s ], threads[ t ] ) );
+
+      itk::ImageRandomCoordinateSampler< ImageType >::Pointer coordinateSampler
+        = itk::ImageRandomCoordinateSampler< ImageType >::New();
+      coordinateSampler->SetNumberOfSamples( NumberOfSamples );
+      benchmarks.push_back( new SamplerBenchmark( "ImageRandomCoordinateSampler", coordinateSampler,
+        sizes[ s ], threads[ t ] ) );
+    }
+
+    benchmarks.push_back( new InterpolatorBenchmark< LinearInterpolatorType >(
+      "AdvancedLinearInterpolator", sizes[ s ] ) );
+    benchmarks.push_back( new BSplineInterpolatorBenchmark( 1, sizes[ s ] ) );
+    benchmarks.push_back( new BSplineInterpolatorBenchmark( 3, sizes[ s ] ) );
+  }
+
+  typedef TransformBenchmark< RecursiveTransformType > RecursiveTransformBenchmarkType;
+  typedef TransformBenchmark< BSplineTransformType >   BSplineTransformBenchmarkType;
+  for( unsigned int g = 0; g < grids.size(); ++g )
+  {
+    for( unsigned int c = 0; c < 3; ++c )
+    {
+      benchmarks.push_back( new RecursiveTransformBenchmarkType( "RecursiveBSplineTransform",
+        static_cast< RecursiveTransformBenchmarkType::CallType >( c ), grids[ g ] ) );
+      benchmarks.push_back( new BSplineTransformBenchmarkType( "AdvancedBSplineTransform",
+        static_cast< BSplineTransformBenchmarkType::CallType >( c ), grids[ g ] ) );
+    }
+  }
+
+  /** Run them. */
+  std::vector< std::pair< std::string, double > > results;
+  bool                                            success = true;
+  for( unsigned int i = 0; i < benchmarks.size(); ++i )
+  {
+    if( benchmarks[ i ]->m_Name.find( filter ) != std::string::npos )
+    {
+      try
+      {
+        const double seconds = RunBenchmark( *benchmarks[ i ], repetitions );
+        results.push_back( std::make_pair( benchmarks[ i ]->m_Name, seconds ) );
+        std::cout << std::left << std::setw( 72 ) << benchmarks[ i ]->m_Name
+                  << std::setprecision( 6 ) << seconds << " s" << std::endl;
+      }
+      catch( itk::ExceptionObject & err )
+      {
+        std::cerr << "ERROR in " << benchmarks[ i ]->m_Name << ":\n" << err << std::endl;
+        success = false;
+      }
+    }
+    delete benchmarks[ i ];
+  }
+  benchmarks.clear();
+
+  if( !outputFileName.empty() && !WriteResults( outputFileName, results ) )
+  {
+    std::cerr << "ERROR: could not write \"" << outputFileName << "\"." << std::endl;
+    success = false;
+  }
+
+  /** Compare with the baseline. */
+  if( !baselineFileName.empty() )
+  {
+    std::map< std::string, double > baseline;
+    if( !ReadResults( baselineFileName, baseline ) )
+    {
+      std::cerr << "ERROR: could not read \"" << baselineFileName << "\"." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    unsigned int numberOfRegressions = 0;
+    for( unsigned int i = 0; i < results.size(); ++i )
+    {
+      std::map< std::string, double >::const_iterator it = baseline.find( results[ i ].first );
+      if( it == baseline.end() )
+      {
+        std::cout << "No baseline for " << results[ i ].first << std::endl;
+        continue;
+      }
+      if( results[ i ].second > ( 1.0 + allowedSlowDown ) * it->second )
+      {
+        std::cerr << "REGRESSION: " << results[ i ].first << " takes " << results[ i ].second
+                  << " s, the baseline " << it->second << " s." << std::endl;
+        ++numberOfRegressions;
+      }
+    }
+    if( numberOfRegressions > 0 )
+    {
+      std::cerr << numberOfRegressions << " benchmarks are more than "
+                << 100.0 * allowedSlowDown << "% slower than the baseline." << std::endl;
+      success = false;
+    }
+  }
+
+  std::cerr << "(" << benchmarkSink << ")" << std::endl;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+
+} // end main
@@ -0,0 +1,904 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+/** \file
+ \brief Benchmark the OpenCL filters of elastix against their CPU versions.
+
+ Every filter is run for the requested image sizes, and the resample filter
+ also for all combinations of the transforms and interpolators that have an
+ OpenCL version. All filters are first timed on the CPU. After that, the GPU
+ factories are registered and the same filters are timed on the device. The
+ GPU time is split into the host-to-device transfer of the input, the
+ filter itself, and the device-to-host transfer of the output. The fastest
+ of a number of repetitions is reported with the speedup, the throughput
+ and the RMSE with respect to the CPU output. The results are written to a
+ JSON file that is named after the device by default, so runs on different
+ types of nodes can be compared.
+ */
+#include "itkTestHelper.h"
+#include "itkCommandLineArgumentParser.h"
+
+// GPU include files
+#include "itkGPUImage.h"
+#include "itkGPUDataManager.h"
+
+// GPU copiers
+#include "itkGPUTransformCopier.h"
+#include "itkGPUInterpolatorCopier.h"
+
+// GPU factory includes
+#include "itkGPUImageFactory.h"
+#include "itkGPUResampleImageFilterFactory.h"
+#include "itkGPUCastImageFilterFactory.h"
+#include "itkGPUShrinkImageFilterFactory.h"
+#include "itkGPURecursiveGaussianImageFilterFactory.h"
+#include "itkGPUBSplineDecompositionImageFilterFactory.h"
+#include "itkGPUAffineTransformFactory.h"
+#include "itkGPUTranslationTransformFactory.h"
+#include "itkGPUBSplineTransformFactory.h"
+#include "itkGPUEuler3DTransformFactory.h"
+#include "itkGPUNearestNeighborInterpolateImageFunctionFactory.h"
+#include "itkGPULinearInterpolateImageFunctionFactory.h"
+#include "itkGPUBSplineInterpolateImageFunctionFactory.h"
+
+// ITK include files
+#include "itkResampleImageFilter.h"
+#include "itkShrinkImageFilter.h"
+#include "itkRecursiveGaussianImageFilter.h"
+#include "itkBSplineDecompositionImageFilter.h"
+#include "itkAffineTransform.h"
+#include "itkTranslationTransform.h"
+#include "itkEuler3DTransform.h"
+#include "itkBSplineTransform.h"
+#include "itkNearestNeighborInterpolateImageFunction.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkMultiThreader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+/** The types of all benchmarks. */
+const unsigned int Dimension = 3;
+
+typedef float                                                  PixelType;
+typedef float                                                  ScalarType;
+typedef itk::Image< PixelType, Dimension >                     ImageType;
+typedef itk::GPUImage< PixelType, Dimension >                  GPUImageType;
+typedef itk::ImageToImageFilter< ImageType, ImageType >        FilterBaseType;
+typedef typelist::MakeTypeList< PixelType >::Type              OCLImageTypes;
+typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+
+typedef itk::Transform< ScalarType, Dimension, Dimension >    TransformType;
+typedef itk::InterpolateImageFunction< ImageType, ScalarType > InterpolatorType;
+typedef itk::GPUTransformCopier<
+  OCLImageTypes, OCLImageDims, TransformType, ScalarType >    TransformCopierType;
+typedef itk::GPUInterpolatorCopier<
+  OCLImageTypes, OCLImageDims, InterpolatorType, ScalarType > InterpolatorCopierType;
+
+/**
+ * ******************* GetHelpString *******************
+ */
+
+std::string
+GetHelpString( void )
+{
+  std::stringstream ss;
+  ss << "Usage:" << std::endl
+     << "elastix_gpu_benchmarks" << std::endl
+     << "  [-out]       JSON file to write the results to, default\n"
+     << "               gpu_benchmarks_<device>.json\n"
+     << "  [-size]      image sizes, the number of voxels along each axis, default 64 128\n"
+     << "  [-threads]   number of threads of the CPU filters, default the number of cores\n"
+     << "  [-r]         number of repetitions of which the fastest is reported, default 3\n"
+     << "  [-filter]    only run the benchmarks whose name contains this string\n"
+     << "Benchmarks the OpenCL resample, shrink, recursive Gaussian and B-spline\n"
+     << "decomposition filters against their CPU versions.";
+  return ss.str();
+
+} // end GetHelpString()
+
+
+/**
+ * ******************* Helpers *******************
+ */
+
+/** A smooth test image: a blob with some noise. After the GPU factories are
+ * registered, New() returns a GPUImage.
+ */
+ImageType::Pointer
+CreateImage( const unsigned int size )
+{
+  ImageType::SizeType imageSize;
+  imageSize.Fill( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( imageSize );
+  image->Allocate();
+
+  RandomGeneratorType::Pointer random = RandomGeneratorType::New();
+  random->SetSeed( 12345 );
+
+  const double center = 0.5 * ( size - 1 );
+  const double sigma  = 0.25 * size;
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    double r2 = 0.0;
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      const double x = it.GetIndex()[ d ] - center;
+      r2 += x * x;
+    }
+    it.Set( static_cast< PixelType >( 100.0 * vcl_exp( -r2 / ( 2.0 * sigma * sigma ) )
+      + random->GetUniformVariate( 0.0, 1.0 ) ) );
+  }
+
+  return image;
+
+} // end CreateImage()
+
+
+/** The name of a benchmark with its configuration. */
+std::string
+MakeName( const std::string & name, const unsigned int size )
+{
+  std::ostringstream ss;
+  ss << name << "/size=" << size;
+  return ss.str();
+
+} // end MakeName()
+
+
+/** The number of bytes of the buffer of an image. */
+double
+GetImageBytes( const ImageType * image )
+{
+  return static_cast< double >( image->GetBufferedRegion().GetNumberOfPixels() )
+         * sizeof( PixelType );
+
+} // end GetImageBytes()
+
+
+/**
+ * ******************* GPUBenchmarkCase *******************
+ *
+ * A filter with its input, and the name under which it is reported.
+ */
+
+class GPUBenchmarkCase
+{
+public:
+
+  GPUBenchmarkCase( const std::string & name, const unsigned int size )
+  {
+    this->m_Name = MakeName( name, size );
+    this->m_Size = size;
+  }
+
+
+  virtual ~GPUBenchmarkCase() {}
+
+  /** Create the input and the filter. Before the GPU factories are
+   * registered these are the CPU versions, after that the GPU versions.
+   */
+  virtual void SetUp( const bool onGPU ) = 0;
+
+  /** The filter that is timed. */
+  virtual FilterBaseType * GetFilter( void ) = 0;
+
+  std::string        m_Name;
+  unsigned int       m_Size;
+  ImageType::Pointer m_Input;
+
+  /** The output of the CPU filter, to compare the GPU output with. */
+  ImageType::Pointer m_CPUOutput;
+};
+
+/**
+ * ******************* FilterBenchmark *******************
+ */
+
+template< class TFilter >
+class FilterBenchmark : public GPUBenchmarkCase
+{
+public:
+
+  FilterBenchmark( const std::string & name, const unsigned int size ) :
+    GPUBenchmarkCase( name, size )
+  {}
+
+  virtual void SetUp( const bool onGPU )
+  {
+    this->m_Input  = CreateImage( this->m_Size );
+    this->m_Filter = TFilter::New();
+    this->Configure( this->m_Filter, onGPU );
+    this->m_Filter->SetInput( this->m_Input );
+  }
+
+
+  virtual FilterBaseType * GetFilter( void )
+  {
+    return this->m_Filter.GetPointer();
+  }
+
+
+  /** Filter specific settings. */
+  virtual void Configure( TFilter *, const bool ) {}
+
+protected:
+
+  typename TFilter::Pointer m_Filter;
+};
+
+typedef itk::ResampleImageFilter< ImageType, ImageType, ScalarType > ResampleFilterType;
+typedef itk::ShrinkImageFilter< ImageType, ImageType >               ShrinkFilterType;
+typedef itk::RecursiveGaussianImageFilter< ImageType, ImageType >    RecursiveGaussianFilterType;
+typedef itk::BSplineDecompositionImageFilter< ImageType, ImageType > BSplineDecompositionFilterType;
+
+class ShrinkBenchmark : public FilterBenchmark< ShrinkFilterType >
+{
+public:
+
+  ShrinkBenchmark( const unsigned int size ) :
+    FilterBenchmark< ShrinkFilterType >( "ShrinkImageFilter/factor=2", size )
+  {}
+
+  virtual void Configure( ShrinkFilterType * filter, const bool )
+  {
+    filter->SetShrinkFactors( 2 );
+  }
+};
+
+class RecursiveGaussianBenchmark : public FilterBenchmark< RecursiveGaussianFilterType >
+{
+public:
+
+  RecursiveGaussianBenchmark( const unsigned int size ) :
+    FilterBenchmark< RecursiveGaussianFilterType >( "RecursiveGaussianImageFilter/sigma=3", size )
+  {}
+
+  virtual void Configure( RecursiveGaussianFilterType * filter, const bool )
+  {
+    filter->SetSigma( 3.0 );
+    filter->SetDirection( 0 );
+  }
+};
+
+class BSplineDecompositionBenchmark : public FilterBenchmark< BSplineDecompositionFilterType >
+{
+public:
+
+  BSplineDecompositionBenchmark( const unsigned int size ) :
+    FilterBenchmark< BSplineDecompositionFilterType >( "BSplineDecompositionImageFilter/order=3", size )
+  {}
+
+  virtual void Configure( BSplineDecompositionFilterType * filter, const bool )
+  {
+    filter->SetSplineOrder( 3 );
+  }
+};
+
+/**
+ * ******************* ResampleBenchmark *******************
+ *
+ * The transform and the interpolator are created in the constructor, so
+ * before the GPU factories are registered. On the GPU they are copied by
+ * the GPU copiers, as in the GPUResampleImageFilterTest.
+ */
+
+class ResampleBenchmark : public FilterBenchmark< ResampleFilterType >
+{
+public:
+
+  ResampleBenchmark( const std::string & transformName,
+    const std::string & interpolatorName, const unsigned int size ) :
+    FilterBenchmark< ResampleFilterType >( "ResampleImageFilter/transform=" + transformName
+      + "/interpolator=" + interpolatorName, size )
+  {
+    this->m_Transform    = CreateTransform( transformName, size );
+    this->m_Interpolator = CreateInterpolator( interpolatorName );
+  }
+
+
+  virtual void Configure( ResampleFilterType * filter, const bool onGPU )
+  {
+    filter->SetDefaultPixelValue( -1.0 );
+    filter->SetSize( this->m_Input->GetLargestPossibleRegion().GetSize() );
+    filter->SetOutputOrigin( this->m_Input->GetOrigin() );
+    filter->SetOutputSpacing( this->m_Input->GetSpacing() );
+    filter->SetOutputDirection( this->m_Input->GetDirection() );
+
+    if( !onGPU )
+    {
+      filter->SetTransform( this->m_Transform );
+      filter->SetInterpolator( this->m_Interpolator );
+      return;
+    }
+
+    TransformCopierType::Pointer transformCopier = TransformCopierType::New();
+    transformCopier->SetInputTransform( this->m_Transform );
+    transformCopier->SetExplicitMode( false );
+    transformCopier->Update();
+    filter->SetTransform( transformCopier->GetModifiableOutput() );
+
+    InterpolatorCopierType::Pointer interpolatorCopier = InterpolatorCopierType::New();
+    interpolatorCopier->SetInputInterpolator( this->m_Interpolator );
+    interpolatorCopier->SetExplicitMode( false );
+    interpolatorCopier->Update();
+    filter->SetInterpolator( interpolatorCopier->GetModifiableOutput() );
+  }
+
+
+  /** A transform that moves the image by a few voxels. */
+  static TransformType::Pointer CreateTransform( const std::string & name, const unsigned int size )
+  {
+    typedef itk::AffineTransform< ScalarType, Dimension >      AffineTransformType;
+    typedef itk::TranslationTransform< ScalarType, Dimension > TranslationTransformType;
+    typedef itk::Euler3DTransform< ScalarType >                EulerTransformType;
+    typedef itk::BSplineTransform< ScalarType, Dimension, 3 >  BSplineTransformType;
+
+    TransformType::InputPointType center;
+    center.Fill( 0.5 * ( size - 1 ) );
+
+    if( name == "Affine" )
+    {
+      AffineTransformType::Pointer transform = AffineTransformType::New();
+      transform->SetCenter( center );
+      AffineTransformType::OutputVectorType scale;
+      scale.Fill( 0.95 );
+      transform->Scale( scale );
+      AffineTransformType::OutputVectorType axis;
+      axis.Fill( 1.0 );
+      transform->Rotate3D( axis, 0.1 );
+      return transform.GetPointer();
+    }
+    else if( name == "Translation" )
+    {
+      TranslationTransformType::Pointer    transform = TranslationTransformType::New();
+      TranslationTransformType::OutputVectorType offset;
+      offset.Fill( 2.5 );
+      transform->SetOffset( offset );
+      return transform.GetPointer();
+    }
+    else if( name == "Euler" )
+    {
+      EulerTransformType::Pointer transform = EulerTransformType::New();
+      transform->SetCenter( center );
+      transform->SetRotation( 0.05, 0.03, 0.02 );
+      EulerTransformType::OutputVectorType translation;
+      translation.Fill( 1.5 );
+      transform->SetTranslation( translation );
+      return transform.GetPointer();
+    }
+
+    /** A B-spline transform with smooth random coefficients. */
+    BSplineTransformType::Pointer                 transform = BSplineTransformType::New();
+    BSplineTransformType::MeshSizeType            meshSize;
+    BSplineTransformType::PhysicalDimensionsType  physicalDimensions;
+    BSplineTransformType::OriginType              origin;
+    BSplineTransformType::DirectionType           direction;
+    meshSize.Fill( 8 );
+    physicalDimensions.Fill( size - 1.0 );
+    origin.Fill( 0.0 );
+    direction.SetIdentity();
+    transform->SetTransformDomainOrigin( origin );
+    transform->SetTransformDomainPhysicalDimensions( physicalDimensions );
+    transform->SetTransformDomainMeshSize( meshSize );
+    transform->SetTransformDomainDirection( direction );
+
+    RandomGeneratorType::Pointer random = RandomGeneratorType::New();
+    random->SetSeed( 54321 );
+    BSplineTransformType::ParametersType parameters( transform->GetNumberOfParameters() );
+    for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+    {
+      parameters[ i ] = random->GetUniformVariate( -2.0, 2.0 );
+    }
+    transform->SetParametersByValue( parameters );
+    return transform.GetPointer();
+  }
+
+
+  static InterpolatorType::Pointer CreateInterpolator( const std::string & name )
+  {
+    typedef itk::NearestNeighborInterpolateImageFunction< ImageType, ScalarType >        NearestNeighborType;
+    typedef itk::LinearInterpolateImageFunction< ImageType, ScalarType >                 LinearType;
+    typedef itk::BSplineInterpolateImageFunction< ImageType, ScalarType, ScalarType >    BSplineType;
+
+    if( name == "NearestNeighbor" )
+    {
+      return NearestNeighborType::New().GetPointer();
+    }
+    else if( name == "Linear" )
+    {
+      return LinearType::New().GetPointer();
+    }
+    BSplineType::Pointer interpolator = BSplineType::New();
+    interpolator->SetSplineOrder( 3 );
+    return interpolator.GetPointer();
+  }
+
+protected:
+
+  TransformType::Pointer    m_Transform;
+  InterpolatorType::Pointer m_Interpolator;
+};
+
+/**
+ * ******************* Results *******************
+ */
+
+struct GPUBenchmarkResult
+{
+  std::string m_Name;
+  double      m_CPUSeconds;
+  double      m_UploadSeconds;
+  double      m_ComputeSeconds;
+  double      m_DownloadSeconds;
+  double      m_InputBytes;
+  double      m_OutputBytes;
+  double      m_RMSE;
+  bool        m_GPUSucceeded;
+  std::string m_Error;
+
+  double GetGPUSeconds( void ) const
+  {
+    return this->m_UploadSeconds + this->m_ComputeSeconds + this->m_DownloadSeconds;
+  }
+};
+
+/** Bytes per second, or zero for a zero time. */
+double
+GetBytesPerSecond( const double bytes, const double seconds )
+{
+  return seconds > 0.0 ? bytes / seconds : 0.0;
+
+} // end GetBytesPerSecond()
+
+
+/**
+ * ******************* RunCPU *******************
+ *
+ * Returns the fastest of a number of repetitions, in seconds, and keeps
+ * the output for the comparison with the GPU.
+ */
+
+void
+RunCPU( GPUBenchmarkCase & benchmark, const unsigned int repetitions,
+  GPUBenchmarkResult & result )
+{
+  benchmark.SetUp( false );
+  FilterBaseType * filter = benchmark.GetFilter();
+
+  /** A first, untimed run, to warm up the caches. */
+  filter->Update();
+
+  for( unsigned int r = 0; r < repetitions; ++r )
+  {
+    filter->Modified();
+    itk::TimeProbe timer;
+    timer.Start();
+    filter->Update();
+    timer.Stop();
+    if( r == 0 || timer.GetTotal() < result.m_CPUSeconds )
+    {
+      result.m_CPUSeconds = timer.GetTotal();
+    }
+  }
+
+  result.m_InputBytes  = GetImageBytes( benchmark.m_Input );
+  result.m_OutputBytes = GetImageBytes( filter->GetOutput() );
+
+  benchmark.m_CPUOutput = filter->GetOutput();
+  benchmark.m_CPUOutput->DisconnectPipeline();
+  benchmark.m_Input = 0;
+
+} // end RunCPU()
+
+
+/**
+ * ******************* RunGPUOnce *******************
+ *
+ * Uploads the input, runs the filter and downloads the output, each up to
+ * the end of the command queue.
+ */
+
+void
+RunGPUOnce( GPUBenchmarkCase & benchmark, double & upload, double & compute, double & download )
+{
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  FilterBaseType *            filter  = benchmark.GetFilter();
+
+  GPUImageType * input = dynamic_cast< GPUImageType * >( benchmark.m_Input.GetPointer() );
+  if( input == 0 )
+  {
+    itkGenericExceptionMacro( << "The input is not a GPUImage, the GPU factories are not registered." );
+  }
+
+  /** Make the device copy of the input stale, so it is transferred again. */
+  input->GetGPUDataManager()->SetGPUBufferDirty();
+  filter->Modified();
+
+  itk::TimeProbe uploadTimer;
+  uploadTimer.Start();
+  input->UpdateGPUBuffer();
+  context->Finish();
+  uploadTimer.Stop();
+
+  itk::TimeProbe computeTimer;
+  computeTimer.Start();
+  filter->Update();
+  context->Finish();
+  computeTimer.Stop();
+
+  GPUImageType * output = dynamic_cast< GPUImageType * >( filter->GetOutput() );
+  if( output == 0 )
+  {
+    itkGenericExceptionMacro( << "The filter " << filter->GetNameOfClass() << " has no GPU output." );
+  }
+
+  itk::TimeProbe downloadTimer;
+  downloadTimer.Start();
+  output->UpdateCPUBuffer();
+  context->Finish();
+  downloadTimer.Stop();
+
+  upload   = uploadTimer.GetTotal();
+  compute  = computeTimer.GetTotal();
+  download = downloadTimer.GetTotal();
+
+} // end RunGPUOnce()
+
+
+/**
+ * ******************* RunGPU *******************
+ *
+ * Reports the repetition with the fastest total time.
+ */
+
+void
+RunGPU( GPUBenchmarkCase & benchmark, const unsigned int repetitions,
+  GPUBenchmarkResult & result )
+{
+  /** Constructing the GPU filter compiles its kernels, which may fail. */
+  benchmark.SetUp( true );
+
+  /** A first, untimed run, which also builds the programs. */
+  double upload = 0.0, compute = 0.0, download = 0.0;
+  RunGPUOnce( benchmark, upload, compute, download );
+
+  for( unsigned int r = 0; r < repetitions; ++r )
+  {
+    RunGPUOnce( benchmark, upload, compute, download );
+    if( r == 0 || upload + compute + download < result.GetGPUSeconds() )
+    {
+      result.m_UploadSeconds   = upload;
+      result.m_ComputeSeconds  = compute;
+      result.m_DownloadSeconds = download;
+    }
+  }
+
+  double rmsRelative = 0.0;
+  result.m_RMSE = itk::ComputeRMSE< double, ImageType, ImageType >(
+    benchmark.m_CPUOutput, benchmark.GetFilter()->GetOutput(), rmsRelative );
+  result.m_GPUSucceeded = true;
+
+  benchmark.m_Input     = 0;
+  benchmark.m_CPUOutput = 0;
+
+} // end RunGPU()
+
+
+/**
+ * ******************* RegisterGPUFactories *******************
+ *
+ * All filters, images, transforms and interpolators that are constructed
+ * after this point are the GPU versions.
+ */
+
+void
+RegisterGPUFactories( void )
+{
+  itk::GPUImageFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPUResampleImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPUCastImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPUShrinkImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPURecursiveGaussianImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPUBSplineDecompositionImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+
+  itk::GPUAffineTransformFactory2< OCLImageDims >::RegisterOneFactory();
+  itk::GPUTranslationTransformFactory2< OCLImageDims >::RegisterOneFactory();
+  itk::GPUBSplineTransformFactory2< OCLImageDims >::RegisterOneFactory();
+  itk::GPUEuler3DTransformFactory2< OCLImageDims >::RegisterOneFactory();
+
+  itk::GPUNearestNeighborInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPULinearInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+  itk::GPUBSplineInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+
+} // end RegisterGPUFactories()
+
+
+/**
+ * ******************* GetDeviceFileName *******************
+ *
+ * gpu_benchmarks_<device>.json, with the characters of the device name
+ * that do not belong in a file name replaced by underscores.
+ */
+
+std::string
+GetDeviceFileName( const itk::OpenCLDevice & device )
+{
+  std::string name = device.GetName();
+  for( std::string::iterator it = name.begin(); it != name.end(); ++it )
+  {
+    if( !std::isalnum( static_cast< unsigned char >( *it ) ) && *it != '-' && *it != '.' )
+    {
+      *it = '_';
+    }
+  }
+  return "gpu_benchmarks_" + name + ".json";
+
+} // end GetDeviceFileName()
+
+
+/** Escape the characters that may not appear unescaped in a JSON string. */
+std::string
+EscapeJSON( const std::string & s )
+{
+  std::string escaped;
+  for( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+  {
+    if( *it == '"' || *it == '\\' )
+    {
+      escaped += '\\';
+    }
+    if( *it != '\n' && *it != '\r' )
+    {
+      escaped += *it;
+    }
+  }
+  return escaped;
+
+} // end EscapeJSON()
+
+
+/**
+ * ******************* WriteResults *******************
+ */
+
+bool
+WriteResults( const std::string & fileName, const itk::OpenCLDevice & device,
+  const unsigned int threads, const std::vector< GPUBenchmarkResult > & results )
+{
+  std::ofstream output( fileName.c_str() );
+  if( !output.is_open() )
+  {
+    return false;
+  }
+
+  output << "{\n  \"device\": { \"name\": \"" << EscapeJSON( device.GetName() )
+         << "\", \"vendor\": \"" << EscapeJSON( device.GetVendor() )
+         << "\", \"version\": \"" << EscapeJSON( device.GetVersion() )
+         << "\", \"driver\": \"" << EscapeJSON( device.GetDriverVersion() )
+         << "\", \"computeUnits\": " << device.GetComputeUnits() << " },\n"
+         << "  \"cpuThreads\": " << threads << ",\n"
+         << "  \"benchmarks\": [\n";
+  output << std::setprecision( 6 ) << std::scientific;
+  for( unsigned int i = 0; i < results.size(); ++i )
+  {
+    const GPUBenchmarkResult & r = results[ i ];
+    output << "    { \"name\": \"" << r.m_Name << "\""
+           << ", \"cpuSeconds\": " << r.m_CPUSeconds
+           << ", \"cpuBytesPerSecond\": "
+           << GetBytesPerSecond( r.m_InputBytes + r.m_OutputBytes, r.m_CPUSeconds );
+    if( r.m_GPUSucceeded )
+    {
+      output << ", \"gpuSeconds\": " << r.GetGPUSeconds()
+             << ", \"uploadSeconds\": " << r.m_UploadSeconds
+             << ", \"computeSeconds\": " << r.m_ComputeSeconds
+             << ", \"downloadSeconds\": " << r.m_DownloadSeconds
+             << ", \"speedup\": " << r.m_CPUSeconds / r.GetGPUSeconds()
+             << ", \"computeSpeedup\": " << r.m_CPUSeconds / r.m_ComputeSeconds
+             << ", \"gpuBytesPerSecond\": "
+             << GetBytesPerSecond( r.m_InputBytes + r.m_OutputBytes, r.m_ComputeSeconds )
+             << ", \"uploadBytesPerSecond\": " << GetBytesPerSecond( r.m_InputBytes, r.m_UploadSeconds )
+             << ", \"downloadBytesPerSecond\": " << GetBytesPerSecond( r.m_OutputBytes, r.m_DownloadSeconds )
+             << ", \"rmse\": " << r.m_RMSE;
+    }
+    else
+    {
+      output << ", \"error\": \"" << EscapeJSON( r.m_Error ) << "\"";
+    }
+    output << ( i + 1 < results.size() ? " },\n" : " }\n" );
+  }
+  output << "  ]\n}\n";
+  return output.good();
+
+} // end WriteResults()
+
+
+/**
+ * ******************* main *******************
+ */
+
+int
+main( int argc, char ** argv )
+{
+  /** Create command line argument parser. */
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    return EXIT_SUCCESS;
+  }
+
+  std::string outputFileName;
+  parser->GetCommandLineArgument( "-out", outputFileName );
+  unsigned int repetitions = 3;
+  parser->GetCommandLineArgument( "-r", repetitions );
+  std::string filter;
+  parser->GetCommandLineArgument( "-filter", filter );
+  std::vector< unsigned int > sizes;
+  sizes.push_back( 64 ); sizes.push_back( 128 );
+  parser->GetCommandLineArgument( "-size", sizes );
+  unsigned int threads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  parser->GetCommandLineArgument( "-threads", threads );
+  itk::MultiThreader::SetGlobalMaximumNumberOfThreads( threads );
+
+  if( repetitions == 0 )
+  {
+    std::cerr << "ERROR: -r should be positive." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Create and check the OpenCL context. */
+  if( !itk::CreateContext() )
+  {
+    return EXIT_FAILURE;
+  }
+  const itk::OpenCLDevice device = itk::OpenCLContext::GetInstance()->GetDefaultDevice();
+  if( outputFileName.empty() )
+  {
+    outputFileName = GetDeviceFileName( device );
+  }
+
+  /** Collect the benchmarks. */
+  const char * transforms[]    = { "Translation", "Affine", "Euler", "BSpline" };
+  const char * interpolators[] = { "NearestNeighbor", "Linear", "BSpline" };
+  std::vector< GPUBenchmarkCase * > benchmarks;
+  for( unsigned int s = 0; s < sizes.size(); ++s )
+  {
+    for( unsigned int t = 0; t < 4; ++t )
+    {
+      for( unsigned int i = 0; i < 3; ++i )
+      {
+        benchmarks.push_back( new ResampleBenchmark( transforms[ t ], interpolators[ i ], sizes[ s ] ) );
+      }
+    }
+    benchmarks.push_back( new ShrinkBenchmark( sizes[ s ] ) );
+    benchmarks.push_back( new RecursiveGaussianBenchmark( sizes[ s ] ) );
+    benchmarks.push_back( new BSplineDecompositionBenchmark( sizes[ s ] ) );
+  }
+
+  std::vector< GPUBenchmarkCase * > selected;
+  for( unsigned int i = 0; i < benchmarks.size(); ++i )
+  {
+    if( benchmarks[ i ]->m_Name.find( filter ) != std::string::npos )
+    {
+      selected.push_back( benchmarks[ i ] );
+    }
+    else
+    {
+      delete benchmarks[ i ];
+    }
+  }
+  benchmarks.clear();
+
+  /** Run all benchmarks on the CPU, before the GPU factories are registered. */
+  std::vector< GPUBenchmarkResult > results( selected.size() );
+  bool                              success = true;
+  for( unsigned int i = 0; i < selected.size(); ++i )
+  {
+    results[ i ].m_Name         = selected[ i ]->m_Name;
+    results[ i ].m_CPUSeconds   = 0.0;
+    results[ i ].m_GPUSucceeded = false;
+    try
+    {
+      RunCPU( *selected[ i ], repetitions, results[ i ] );
+    }
+    catch( itk::ExceptionObject & err )
+    {
+      std::cerr << "ERROR in " << selected[ i ]->m_Name << " on the CPU:\n" << err << std::endl;
+      success = false;
+    }
+  }
+
+  /** Run them on the GPU. */
+  RegisterGPUFactories();
+  std::cout << "Device: " << device.GetName() << std::endl;
+  std::cout << std::left << std::setw( 72 ) << "benchmark"
+            << "CPU [s]    GPU [s]    upload     compute    download   speedup  RMSE" << std::endl;
+  for( unsigned int i = 0; i < selected.size(); ++i )
+  {
+    GPUBenchmarkResult & result = results[ i ];
+    result.m_UploadSeconds = result.m_ComputeSeconds = result.m_DownloadSeconds = 0.0;
+    result.m_RMSE          = 0.0;
+    if( selected[ i ]->m_CPUOutput.IsNotNull() )
+    {
+      try
+      {
+        RunGPU( *selected[ i ], repetitions, result );
+      }
+      catch( itk::ExceptionObject & err )
+      {
+        std::cerr << "ERROR in " << selected[ i ]->m_Name << " on the GPU:\n" << err << std::endl;
+        result.m_Error = err.GetDescription();
+        success        = false;
+      }
+    }
+    else
+    {
+      result.m_Error = "failed on the CPU";
+    }
+
+    std::cout << std::left << std::setw( 72 ) << result.m_Name
+              << std::setprecision( 4 ) << std::setw( 11 ) << result.m_CPUSeconds;
+    if( result.m_GPUSucceeded )
+    {
+      std::cout << std::setw( 11 ) << result.GetGPUSeconds()
+                << std::setw( 11 ) << result.m_UploadSeconds
+                << std::setw( 11 ) << result.m_ComputeSeconds
+                << std::setw( 11 ) << result.m_DownloadSeconds
+                << std::setw( 9 ) << result.m_CPUSeconds / result.GetGPUSeconds()
+                << result.m_RMSE;
+    }
+    else
+    {
+      std::cout << result.m_Error;
+    }
+    std::cout << std::endl;
+    delete selected[ i ];
+  }
+  selected.clear();
+
+  if( !WriteResults( outputFileName, device, threads, results ) )
+  {
+    std::cerr << "ERROR: could not write \"" << outputFileName << "\"." << std::endl;
+    success = false;
+  }
+  else
+  {
+    std::cout << "Results written to \"" << outputFileName << "\"." << std::endl;
+  }
+
+  itk::ReleaseContext();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+
+} // end main
@@ -0,0 +1,266 @@
+import sys, subprocess
+import os
+import os.path
+import re
+import math
+import time
+import json
+from optparse import OptionParser
+
+#-------------------------------------------------------------------------------
+# The reference registrations. The data is in Testing/Data. The fixed and
+# moving landmarks are corresponding points, in voxel indices.
+def get_default_cases( dataDir ):
+  fixed  = os.path.join( dataDir, "3DCT_lung_baseline.mha" )
+  moving = os.path.join( dataDir, "3DCT_lung_followup.mha" )
+  fixedLandmarks  = os.path.join( dataDir, "3DCT_lung_baseline.txt" )
+  movingLandmarks = os.path.join( dataDir, "3DCT_lung_followup.txt" )
+  cases = []
+  for name, parameterFile in [
+      ( "rigid.MI",              "parameters.3D.MI.euler.ASGD.001.txt" ),
+      ( "affine.NC",             "parameters.3D.NC.affine.ASGD.001.txt" ),
+      ( "bspline.MI.ASGD",       "parameters.3D.MI.bspline.ASGD.001.txt" ),
+      ( "bspline.MI.ASGD.bending", "parameters.3D.MI.bspline.ASGD.bending.001.txt" ) ] :
+    cases.append( { "name" : name,
+      "fixed" : fixed, "moving" : moving,
+      "parameters" : [ os.path.join( dataDir, parameterFile ) ],
+      "fixedlandmarks" : fixedLandmarks, "movinglandmarks" : movingLandmarks } )
+  return cases
+
+#-------------------------------------------------------------------------------
+# Run a program, and return the wall time in seconds and the peak resident
+# set size in MB, or None where that is not available (Windows).
+def run_and_measure( command, logFileName ):
+  log = open( logFileName, 'w' )
+  start = time.time()
+  try :
+    process = subprocess.Popen( command, stdout=log, stderr=subprocess.STDOUT )
+  except OSError as e :
+    log.close()
+    print( "ERROR: could not run " + command[ 0 ] + ": " + str( e ) )
+    return 1, 0.0, None
+  peakRSS = None
+  if hasattr( os, "wait4" ) :
+    pid, status, usage = os.wait4( process.pid, 0 )
+    returnCode = os.WEXITSTATUS( status ) if os.WIFEXITED( status ) else 1
+    # ru_maxrss is in kilobytes on Linux and in bytes on Mac OS X
+    peakRSS = usage.ru_maxrss / 1024.0
+    if sys.platform == "darwin" : peakRSS = peakRSS / 1024.0
+  else :
+    returnCode = process.wait()
+  wallTime = time.time() - start
+  log.close()
+  return returnCode, wallTime, peakRSS
+
+#-------------------------------------------------------------------------------
+# Get the time per phase from elastix.log, in seconds.
+def get_phase_times( logFileName ):
+  patterns = [
+    ( "reading",        r"Reading images took (\d+) ms", 0.001 ),
+    ( "initialization", r"Initialization of all components \(before registration\) took: (\d+) ms", 0.001 ),
+    ( "pyramids",       r"Preparation of the image pyramids took: (\d+) ms", 0.001 ),
+    ( "resolution",     r"Time spent in resolution (\d+) \(ITK initialization and iterating\): ([0-9.eE+-]+) s", 1.0 ),
+    ( "finalization",   r"Time spent on saving the results, applying the final transform etc\.: (\d+) ms", 0.001 ) ]
+  phases = {}
+  if not os.path.exists( logFileName ) :
+    return phases
+  for line in open( logFileName, 'r' ) :
+    for phase, pattern, scale in patterns :
+      match = re.search( pattern, line )
+      if match == None : continue
+      # with more than one parameter file the phases occur several times
+      if phase == "resolution" :
+        phase = "resolution " + match.group( 1 )
+        value = float( match.group( 2 ) ) * scale
+      else :
+        value = float( match.group( 1 ) ) * scale
+      phases[ phase ] = phases.get( phase, 0.0 ) + value
+  return phases
+
+#-------------------------------------------------------------------------------
+# Get the final metric value from the last IterationInfo file.
+def get_final_metric_value( directory ):
+  latestFile = None
+  latestKey  = None
+  for fileName in os.listdir( directory ) :
+    match = re.match( r"IterationInfo\.(\d+)\.R(\d+)\.txt$", fileName )
+    if match == None : continue
+    key = ( int( match.group( 1 ) ), int( match.group( 2 ) ) )
+    if latestKey == None or key > latestKey :
+      latestKey  = key
+      latestFile = fileName
+  if latestFile == None :
+    return None
+  lines = open( os.path.join( directory, latestFile ), 'r' ).readlines()
+  values = lines[ -1 ].split()
+  if len( values ) < 2 :
+    return None
+  return float( values[ 1 ] )
+
+#-------------------------------------------------------------------------------
+# Read the voxel to physical mapping from a MetaImage header.
+def read_meta_image_geometry( fileName ):
+  header = {}
+  f = open( fileName, 'rb' )
+  for line in f :
+    line = line.decode( 'latin-1' )
+    if '=' not in line : break
+    key, value = line.split( '=', 1 )
+    header[ key.strip() ] = value.strip()
+    if key.strip() == "ElementDataFile" : break
+  f.close()
+  dimension = int( header[ "NDims" ] )
+  spacing = [ float( x ) for x in header.get( "ElementSpacing", "1 " * dimension ).split() ]
+  offset  = [ float( x ) for x in header.get( "Offset", header.get( "Origin", "0 " * dimension ) ).split() ]
+  identity = " ".join( [ "1" if i % ( dimension + 1 ) == 0 else "0" for i in range( dimension * dimension ) ] )
+  matrix  = [ float( x ) for x in header.get( "TransformMatrix", identity ).split() ]
+  return dimension, spacing, offset, matrix
+
+#-------------------------------------------------------------------------------
+# Read an elastix point file; indices are converted to physical points.
+def read_points( fileName, imageFileName ):
+  tokens = open( fileName, 'r' ).read().split()
+  isIndex = False
+  if tokens[ 0 ] in [ "index", "point" ] :
+    isIndex = tokens[ 0 ] == "index"
+    tokens = tokens[ 1: ]
+  numberOfPoints = int( tokens[ 0 ] )
+  values = [ float( x ) for x in tokens[ 1: ] ]
+  dimension = len( values ) // numberOfPoints
+  points = [ values[ i * dimension : ( i + 1 ) * dimension ] for i in range( numberOfPoints ) ]
+  if isIndex :
+    dim, spacing, offset, matrix = read_meta_image_geometry( imageFileName )
+    # the MetaImage TransformMatrix is stored column by column
+    points = [ [ offset[ r ] + sum( [ matrix[ c * dim + r ] * spacing[ c ] * p[ c ] for c in range( dim ) ] )
+      for r in range( dim ) ] for p in points ]
+  return points
+
+#-------------------------------------------------------------------------------
+# Transform the fixed landmarks with transformix, and compute the distances
+# to the moving landmarks, in mm.
+def get_landmark_errors( case, directory, transformix ):
+  tpFileName = os.path.join( directory, "TransformParameters.%d.txt" % ( len( case[ "parameters" ] ) - 1 ) )
+  subprocess.call( [ transformix, "-def", case[ "fixedlandmarks" ], "-out", directory, "-tp", tpFileName ],
+    stdout=subprocess.PIPE, stderr=subprocess.STDOUT )
+  outputPointsFileName = os.path.join( directory, "outputpoints.txt" )
+  if not os.path.exists( outputPointsFileName ) :
+    return None
+  transformed = []
+  for line in open( outputPointsFileName, 'r' ) :
+    field = line.strip().split( ';' )[ 4 ]
+    transformed.append( [ float( x ) for x in field.split( '[' )[ 1 ].split( ']' )[ 0 ].split() ] )
+  moving = read_points( case[ "movinglandmarks" ], case[ "moving" ] )
+  return [ math.sqrt( sum( [ ( a - b ) * ( a - b ) for a, b in zip( p, q ) ] ) ) for p, q in zip( transformed, moving ) ]
+
+#-------------------------------------------------------------------------------
+# the main function
+def main():
+  # usage, parse parameters
+  usage = "usage: %prog [options]\n\n" \
+    "Runs reference registrations to completion, and reports the wall time, the peak\n" \
+    "memory use, the time per phase, the final metric value and the landmark error."
+  parser = OptionParser( usage )
+
+  parser.add_option( "-e", "--bindirectory", dest="bindirectory", help="directory of the elastix and transformix executables" )
+  parser.add_option( "-d", "--datadirectory", dest="datadirectory", help="data directory, default Testing/Data" )
+  parser.add_option( "-o", "--outputdirectory", dest="outputdirectory", help="output directory" )
+  parser.add_option( "-c", "--cases", dest="cases", help="JSON file with the cases, instead of the reference cases" )
+  parser.add_option( "-s", "--select", dest="select", help="comma separated names of the cases to run" )
+  parser.add_option( "-j", "--json", dest="json", help="JSON file to write the results to" )
+  parser.add_option( "-b", "--baseline", dest="baseline", help="JSON file with the results of an earlier run" )
+  parser.add_option( "-t", "--timetolerance", dest="timetolerance", type="float", default=0.25,
+    help="allowed slow down with respect to the baseline, default 0.25" )
+  parser.add_option( "-l", "--landmarktolerance", dest="landmarktolerance", type="float", default=0.1,
+    help="allowed increase of the mean landmark error in mm, default 0.1" )
+  parser.add_option( "--threads", dest="threads", help="number of threads passed to elastix" )
+
+  (options, args) = parser.parse_args()
+
+  if options.outputdirectory == None :
+    parser.error( "The option output directory (-o) should be given" )
+
+  dataDir = options.datadirectory
+  if dataDir == None :
+    dataDir = os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), "Data" )
+  elastix = "elastix"
+  transformix = "transformix"
+  if options.bindirectory != None :
+    elastix = os.path.join( options.bindirectory, "elastix" )
+    transformix = os.path.join( options.bindirectory, "transformix" )
+
+  # A case file contains a list of objects like the reference cases, with
+  # optional entries for the landmarks and extra elastix arguments "args",
+  # for example for a group-wise registration of a 4D stack.
+  if options.cases != None :
+    cases = json.load( open( options.cases, 'r' ) )
+  else :
+    cases = get_default_cases( dataDir )
+  if options.select != None :
+    selected = options.select.split( ',' )
+    cases = [ case for case in cases if case[ "name" ] in selected ]
+
+  results = []
+  success = True
+  for case in cases :
+    directory = os.path.join( options.outputdirectory, case[ "name" ] )
+    if not os.path.exists( directory ) : os.makedirs( directory )
+
+    command = [ elastix, "-f", case[ "fixed" ], "-out", directory ]
+    if "moving" in case : command += [ "-m", case[ "moving" ] ]
+    for parameterFile in case[ "parameters" ] : command += [ "-p", parameterFile ]
+    if options.threads != None : command += [ "-threads", options.threads ]
+    command += case.get( "args", [] )
+
+    print( "Running " + case[ "name" ] )
+    returnCode, wallTime, peakRSS = run_and_measure( command, os.path.join( directory, "stdout.txt" ) )
+    result = { "name" : case[ "name" ], "returncode" : returnCode, "walltime" : wallTime,
+      "peakrss" : peakRSS, "phases" : get_phase_times( os.path.join( directory, "elastix.log" ) ),
+      "finalmetricvalue" : get_final_metric_value( directory ) }
+    if returnCode != 0 :
+      print( "ERROR: elastix failed for " + case[ "name" ] + ", see " + directory )
+      success = False
+    elif "fixedlandmarks" in case and "movinglandmarks" in case :
+      errors = get_landmark_errors( case, directory, transformix )
+      if errors :
+        result[ "landmarkerror" ] = { "mean" : sum( errors ) / len( errors ), "max" : max( errors ) }
+    results.append( result )
+
+    # Report
+    line = "  wall time %.2f s" % wallTime
+    if peakRSS != None : line += ", peak RSS %.0f MB" % peakRSS
+    if result[ "finalmetricvalue" ] != None : line += ", final metric %.6g" % result[ "finalmetricvalue" ]
+    if "landmarkerror" in result :
+      line += ", landmark error mean %.3f max %.3f mm" % ( result[ "landmarkerror" ][ "mean" ], result[ "landmarkerror" ][ "max" ] )
+    print( line )
+    for phase in sorted( result[ "phases" ].keys() ) :
+      print( "    %-16s %8.2f s" % ( phase, result[ "phases" ][ phase ] ) )
+
+  if options.json != None :
+    f = open( options.json, 'w' )
+    json.dump( { "registrations" : results }, f, indent=2, sort_keys=True )
+    f.close()
+
+  # Compare cost and accuracy with the baseline
+  if options.baseline != None :
+    baseline = {}
+    for result in json.load( open( options.baseline, 'r' ) )[ "registrations" ] :
+      baseline[ result[ "name" ] ] = result
+    for result in results :
+      if result[ "name" ] not in baseline : continue
+      base = baseline[ result[ "name" ] ]
+      if result[ "walltime" ] > ( 1.0 + options.timetolerance ) * base[ "walltime" ] :
+        print( "REGRESSION: %s takes %.2f s, the baseline %.2f s" % ( result[ "name" ], result[ "walltime" ], base[ "walltime" ] ) )
+        success = False
+      if "landmarkerror" in result and "landmarkerror" in base :
+        if result[ "landmarkerror" ][ "mean" ] > base[ "landmarkerror" ][ "mean" ] + options.landmarktolerance :
+          print( "REGRESSION: %s has a mean landmark error of %.3f mm, the baseline %.3f mm"
+            % ( result[ "name" ], result[ "landmarkerror" ][ "mean" ], base[ "landmarkerror" ][ "mean" ] ) )
+          success = False
+
+  if success :
+    return 0
+  return 1
+
+#-------------------------------------------------------------------------------
+if __name__ == '__main__':
+    sys.exit(main())
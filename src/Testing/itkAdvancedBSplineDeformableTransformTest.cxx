@@ -366,6 +366,27 @@ main( int argc, char * argv[] )
     return 1;
   }
 
+  /** Check the compact nonzero Jacobian indices against the full ones. */
+  typedef TransformType::NonZeroJacobianIndicesDescriptorType NonZeroJacobianIndicesDescriptorType;
+  typedef TransformType::MovingImageGradientType              MovingImageGradientType;
+  typedef TransformType::DerivativeType                       DerivativeType;
+  MovingImageGradientType movingImageGradient;
+  movingImageGradient[ 0 ] = 0.3; movingImageGradient[ 1 ] = -1.2; movingImageGradient[ 2 ] = 2.1;
+  DerivativeType                       imageJacobian( nonzji ), compactImageJacobian( nonzji );
+  NonZeroJacobianIndicesType           expandedNzji;
+  NonZeroJacobianIndicesDescriptorType descriptor;
+  transform->EvaluateJacobianWithImageGradientProduct( inputPoint, movingImageGradient, imageJacobian, nzji );
+  transform->EvaluateCompactJacobianWithImageGradientProduct(
+    inputPoint, movingImageGradient, compactImageJacobian, descriptor );
+  TransformType::ExpandNonZeroJacobianIndices( descriptor, expandedNzji );
+  if( !transform->GetHasNonZeroJacobianIndicesDescriptor() || expandedNzji != nzji
+    || ( imageJacobian - compactImageJacobian ).two_norm() > 1e-10 )
+  {
+    std::cerr << "ERROR: Advanced B-spline EvaluateCompactJacobianWithImageGradientProduct() "
+              << "returning incorrect result." << std::endl;
+    return 1;
+  }
+
   //// Check
   //JacobianType jacobian1, jacobian2;
   //jacobian1.SetSize( Dimension, nzji.size() ); jacobian2.SetSize( Dimension, nzji.size() );
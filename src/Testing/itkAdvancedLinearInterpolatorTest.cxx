@@ -30,6 +30,8 @@
 #include "vnl/vnl_math.h"
 #include "itkTimeProbe.h"
 
+#include <vector>
+
 //-------------------------------------------------------------------------------------
 
 // Test function templated over the dimension
@@ -213,6 +215,27 @@ TestInterpolators( void )
     }
   }
 
+  /** The batch version should give the same results as the single version. */
+  std::vector< ContinuousIndexType > cindices( count );
+  std::vector< OutputType >          valuesBatch( count );
+  std::vector< CovariantVectorType > derivsBatch( count );
+  for( unsigned int i = 0; i < count; i++ )
+  {
+    cindices[ i ] = ContinuousIndexType( &darray1[ i ][ 0 ] );
+  }
+  linearA->EvaluateValueAndDerivativeAtContinuousIndices(
+    count, &cindices[ 0 ], &valuesBatch[ 0 ], &derivsBatch[ 0 ] );
+  for( unsigned int i = 0; i < count; i++ )
+  {
+    linearA->EvaluateValueAndDerivativeAtContinuousIndex( cindices[ i ], valueLinA, derivLinA );
+    if( valuesBatch[ i ] != valueLinA || derivsBatch[ i ] != derivLinA )
+    {
+      std::cerr << "ERROR: there is a difference between the batch and the single "
+                << "evaluation of the advanced linear interpolator." << std::endl;
+      return false;
+    }
+  }
+
   /** Measure the run times, but only in release mode. */
 #ifdef NDEBUG
   std::cout << std::endl;
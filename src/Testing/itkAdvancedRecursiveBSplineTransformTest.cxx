@@ -501,6 +501,127 @@ main( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  /** The combined versions share the weights, and should give the same results. */
+  SpatialJacobianType sjCombined;
+  SpatialHessianType  shCombined;
+  recursiveTransform->GetJacobianOfSpatialJacobian( inputPoint, sjCombined, jsj, nzji );
+  recursiveTransform->GetJacobianOfSpatialHessian( inputPoint, shCombined, jsh, nzji );
+  double combinedDifference = ( sjCombined - sjRecursive ).GetVnlMatrix().frobenius_norm();
+  for( unsigned int i = 0; i < jsj.size(); ++i )
+  {
+    combinedDifference += ( jsj[ i ] - jsjRecursive[ i ] ).GetVnlMatrix().frobenius_norm();
+  }
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    combinedDifference += ( shCombined[ i ] - shRecursive[ i ] ).GetVnlMatrix().frobenius_norm();
+  }
+  for( unsigned int i = 0; i < jsh.size(); ++i )
+  {
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      combinedDifference += ( jsh[ i ][ j ] - jshRecursive[ i ][ j ] ).GetVnlMatrix().frobenius_norm();
+    }
+  }
+  std::cerr << "The combined spatial derivatives difference is " << combinedDifference << std::endl;
+  if( combinedDifference > 1e-8 )
+  {
+    std::cerr << "ERROR: Recursive B-spline combined spatial derivatives returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Batch TransformPoints() and GetJacobians(). */
+  const unsigned int           numberOfBatchPoints = N < 10 ? N : 10;
+  const NumberOfParametersType nnzji               = transform->GetNumberOfNonZeroJacobianIndices();
+  std::vector< OutputPointType > batchPoints( numberOfBatchPoints );
+  std::vector< OutputPointType > batchPointsRecursive( numberOfBatchPoints );
+  std::vector< double >          batchJacobians( numberOfBatchPoints * Dimension * nnzji );
+  std::vector< double >          batchJacobiansRecursive( numberOfBatchPoints * Dimension * nnzji );
+  std::vector< unsigned long >   batchNzji( numberOfBatchPoints * nnzji );
+  std::vector< unsigned long >   batchNzjiRecursive( numberOfBatchPoints * nnzji );
+  transform->TransformPoints( &pointList[ 0 ], numberOfBatchPoints, &batchPoints[ 0 ] );
+  recursiveTransform->TransformPoints( &pointList[ 0 ], numberOfBatchPoints, &batchPointsRecursive[ 0 ] );
+  transform->GetJacobians( &pointList[ 0 ], numberOfBatchPoints, &batchJacobians[ 0 ], &batchNzji[ 0 ] );
+  recursiveTransform->GetJacobians( &pointList[ 0 ], numberOfBatchPoints,
+    &batchJacobiansRecursive[ 0 ], &batchNzjiRecursive[ 0 ] );
+
+  double batchDifference = 0.0;
+  for( unsigned int i = 0; i < numberOfBatchPoints; ++i )
+  {
+    const OutputPointType opp = transform->TransformPoint( pointList[ i ] );
+    batchDifference += opp.EuclideanDistanceTo( batchPoints[ i ] );
+    batchDifference += opp.EuclideanDistanceTo( batchPointsRecursive[ i ] );
+
+    transform->GetJacobian( pointList[ i ], jacobianElastix, nzjiElastix );
+    for( unsigned int j = 0; j < nnzji; ++j )
+    {
+      batchDifference += vcl_abs( static_cast< double >( nzjiElastix[ j ] ) - batchNzji[ i * nnzji + j ] );
+      batchDifference += vcl_abs( static_cast< double >( nzjiElastix[ j ] ) - batchNzjiRecursive[ i * nnzji + j ] );
+      for( unsigned int d = 0; d < Dimension; ++d )
+      {
+        const unsigned int k = ( i * Dimension + d ) * nnzji + j;
+        batchDifference += vcl_abs( jacobianElastix[ d ][ j ] - batchJacobians[ k ] );
+        batchDifference += vcl_abs( jacobianElastix[ d ][ j ] - batchJacobiansRecursive[ k ] );
+      }
+    }
+  }
+  std::cerr << "The batch TransformPoints() and GetJacobians() difference is " << batchDifference << std::endl;
+  if( batchDifference > 1e-8 )
+  {
+    std::cerr << "ERROR: batch TransformPoints() or GetJacobians() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Cached EvaluateJacobianWithImageGradientProduct(). */
+  typedef TransformType::MovingImageGradientType MovingImageGradientType;
+  typedef TransformType::DerivativeType          DerivativeType;
+  MovingImageGradientType movingImageGradient;
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    movingImageGradient[ d ] = d + 1.0;
+  }
+  if( transform->PrecomputeJacobianStructure( &pointList[ 0 ], numberOfBatchPoints, 0 )
+    || transform->GetNumberOfPrecomputedJacobianStructures() != 0 )
+  {
+    std::cerr << "ERROR: PrecomputeJacobianStructure() does not respect the memory budget." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !transform->PrecomputeJacobianStructure( &pointList[ 0 ], numberOfBatchPoints, 1024 * 1024 )
+    || !recursiveTransform->PrecomputeJacobianStructure( &pointList[ 0 ], numberOfBatchPoints, 1024 * 1024 ) )
+  {
+    std::cerr << "ERROR: PrecomputeJacobianStructure() failed." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  DerivativeType             imageJacobian( nnzji ), imageJacobianCached( nnzji );
+  NonZeroJacobianIndicesType nzjiCached;
+  double                     cachedDifference = 0.0;
+  for( unsigned int i = 0; i < numberOfBatchPoints; ++i )
+  {
+    for( unsigned int t = 0; t < 2; ++t )
+    {
+      const TransformType * currentTransform = t == 0
+        ? transform.GetPointer() : recursiveTransform.GetPointer();
+      imageJacobian.Fill( 0.0 );
+      imageJacobianCached.Fill( 0.0 );
+      currentTransform->EvaluateJacobianWithImageGradientProduct(
+        pointList[ i ], movingImageGradient, imageJacobian, nzjiElastix );
+      currentTransform->EvaluateCachedJacobianWithImageGradientProduct(
+        i, pointList[ i ], movingImageGradient, imageJacobianCached, nzjiCached );
+      for( unsigned int j = 0; j < nnzji; ++j )
+      {
+        cachedDifference += vcl_abs( imageJacobian[ j ] - imageJacobianCached[ j ] );
+        cachedDifference += vcl_abs( static_cast< double >( nzjiElastix[ j ] ) - nzjiCached[ j ] );
+      }
+    }
+  }
+  std::cerr << "The cached EvaluateJacobianWithImageGradientProduct() difference is "
+            << cachedDifference << std::endl;
+  if( cachedDifference > 1e-8 )
+  {
+    std::cerr << "ERROR: cached EvaluateJacobianWithImageGradientProduct() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   /** Exercise PrintSelf(). */
   std::cerr << std::endl;
   recursiveTransform->Print( std::cerr );
@@ -20,6 +20,7 @@
 
 #include <ctime>
 #include <iomanip>
+#include <vector>
 
 //-------------------------------------------------------------------------------------
 // This test tests the itkBSplineInterpolationWeightFunction2 and compares
@@ -285,6 +286,43 @@ main( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  /** Check that the batch evaluation gives the same result as evaluating
+   * the points one by one.
+   */
+  const unsigned int                              numberOfPoints    = 5;
+  const unsigned long                             numberOfWeights3D = weight2Function3D->GetNumberOfWeights();
+  std::vector< ContinuousIndexType3D >            cindices3D( numberOfPoints );
+  std::vector< WeightFunction2Type3D::IndexType > startIndices3D( numberOfPoints );
+  std::vector< double >                           batchWeights3D( numberOfPoints * numberOfWeights3D );
+  for( unsigned int p = 0; p < numberOfPoints; ++p )
+  {
+    for( unsigned int d = 0; d < 3; ++d )
+    {
+      cindices3D[ p ][ d ] = 0.37 * p + 1.1 * d - 0.6;
+    }
+  }
+  weight2Function3D->EvaluateBatch( &cindices3D[ 0 ], numberOfPoints,
+    &startIndices3D[ 0 ], &batchWeights3D[ 0 ] );
+  for( unsigned int p = 0; p < numberOfPoints; ++p )
+  {
+    WeightFunction2Type3D::IndexType startIndex3D;
+    weight2Function3D->ComputeStartIndex( cindices3D[ p ], startIndex3D );
+    WeightsType3D singleWeights3D = weight2Function3D->Evaluate( cindices3D[ p ] );
+    if( startIndex3D != startIndices3D[ p ] )
+    {
+      std::cerr << "ERROR: EvaluateBatch() computed a wrong start index." << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( unsigned int k = 0; k < numberOfWeights3D; ++k )
+    {
+      if( vcl_abs( singleWeights3D[ k ] - batchWeights3D[ p * numberOfWeights3D + k ] ) > 1e-12 )
+      {
+        std::cerr << "ERROR: EvaluateBatch() differs from Evaluate()." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
   std::cerr << "All public functions returned valid output." << std::endl;
 
   /**
@@ -0,0 +1,236 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkPhiloxRandomNumberGenerator.h"
+#include "itkImageRandomSampler.h"
+#include "itkImageRandomCoordinateSampler.h"
+#include "itkImage.h"
+#include "itkImageRegionIterator.h"
+
+#include <iostream>
+#include <vector>
+
+// Run a sampler with the given number of threads and copy the sample points
+template< class TSampler >
+void
+GetSamplePoints( TSampler * sampler, const itk::ThreadIdType numberOfThreads,
+  std::vector< typename TSampler::InputImagePointType > & points )
+{
+  sampler->SetNumberOfThreads( numberOfThreads );
+  sampler->SetSeed( 1234 );
+  sampler->Modified();
+  sampler->Update();
+
+  typename TSampler::ImageSampleContainerType * samples = sampler->GetOutput();
+  points.resize( samples->Size() );
+  for( unsigned long i = 0; i < samples->Size(); ++i )
+  {
+    points[ i ] = samples->ElementAt( i ).m_ImageCoordinates;
+  }
+}
+
+
+// Check that the sampler output does not depend on the number of threads
+template< class TSampler >
+bool
+CheckThreadIndependence( TSampler * sampler, const char * name )
+{
+  typedef typename TSampler::InputImagePointType PointType;
+  std::vector< PointType > reference, points;
+  GetSamplePoints( sampler, 1, reference );
+  const itk::ThreadIdType threadCounts[ 3 ] = { 2, 3, 8 };
+  for( unsigned int t = 0; t < 3; ++t )
+  {
+    GetSamplePoints( sampler, threadCounts[ t ], points );
+    if( points.size() != reference.size() )
+    {
+      std::cerr << "ERROR: " << name << " returned " << points.size()
+                << " instead of " << reference.size() << " samples." << std::endl;
+      return false;
+    }
+    for( unsigned long i = 0; i < points.size(); ++i )
+    {
+      if( points[ i ] != reference[ i ] )
+      {
+        std::cerr << "ERROR: " << name << " sample " << i << " differs for "
+                  << threadCounts[ t ] << " threads." << std::endl;
+        return false;
+      }
+    }
+  }
+
+  /** The next sample set should be different. */
+  sampler->Modified();
+  sampler->Update();
+  if( sampler->GetOutput()->ElementAt( 0 ).m_ImageCoordinates == reference[ 0 ] )
+  {
+    std::cerr << "ERROR: " << name << " did not draw a new sample set." << std::endl;
+    return false;
+  }
+
+  std::cerr << name << ": samples are independent of the number of threads." << std::endl;
+  return true;
+}
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** Known-answer tests of Random123 for Philox4x32-10. */
+  typedef itk::PhiloxRandomNumberGenerator GeneratorType;
+  typedef GeneratorType::WordType          WordType;
+  const WordType counters[ 3 ][ 4 ] = {
+    { 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u },
+    { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu },
+    { 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u } };
+  const WordType keys[ 3 ][ 2 ] = {
+    { 0x00000000u, 0x00000000u },
+    { 0xffffffffu, 0xffffffffu },
+    { 0xa4093822u, 0x299f31d0u } };
+  const WordType answers[ 3 ][ 4 ] = {
+    { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u },
+    { 0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu },
+    { 0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u } };
+  for( unsigned int i = 0; i < 3; ++i )
+  {
+    WordType result[ 4 ];
+    GeneratorType::Philox4x32( counters[ i ], keys[ i ], result );
+    for( unsigned int j = 0; j < 4; ++j )
+    {
+      if( result[ j ] != answers[ i ][ j ] )
+      {
+        std::cerr << "ERROR: Philox4x32 known-answer test " << i << " failed." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  /** The variates should be in [0, 1) and streams should be reproducible. */
+  GeneratorType generator( 1234 ), generator2( 1234 );
+  generator.SetStream( 17, 3 );
+  generator2.SetStream( 17, 3 );
+  for( unsigned int i = 0; i < 1000; ++i )
+  {
+    const double u = generator.GetVariate();
+    if( u < 0.0 || u >= 1.0 || u != generator2.GetVariate() )
+    {
+      std::cerr << "ERROR: GetVariate() returned an invalid value." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** Create an image. */
+  const unsigned int Dimension = 3;
+  typedef itk::Image< float, Dimension > ImageType;
+  ImageType::Pointer    image = ImageType::New();
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size[ 0 ] = 40; size[ 1 ] = 30; size[ 2 ] = 20;
+  region.SetSize( size );
+  image->SetRegions( region );
+  image->Allocate();
+  itk::ImageRegionIterator< ImageType > it( image, region );
+  float value = 0.0f;
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it, value += 1.0f )
+  {
+    it.Set( value );
+  }
+
+  /** Test the samplers. */
+  typedef itk::ImageRandomSampler< ImageType >           RandomSamplerType;
+  typedef itk::ImageRandomCoordinateSampler< ImageType > RandomCoordinateSamplerType;
+
+  RandomSamplerType::Pointer randomSampler = RandomSamplerType::New();
+  randomSampler->SetInput( image );
+  randomSampler->SetInputImageRegion( region );
+  randomSampler->SetNumberOfSamples( 1001 );
+  randomSampler->SetUseMultiThread( true );
+  randomSampler->UseCounterBasedRandomGeneratorOn();
+  if( !CheckThreadIndependence( randomSampler.GetPointer(), "ImageRandomSampler" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  RandomCoordinateSamplerType::Pointer coordinateSampler = RandomCoordinateSamplerType::New();
+  coordinateSampler->SetInput( image );
+  coordinateSampler->SetInputImageRegion( region );
+  coordinateSampler->SetNumberOfSamples( 1001 );
+  coordinateSampler->SetUseMultiThread( true );
+  coordinateSampler->UseCounterBasedRandomGeneratorOn();
+  if( !CheckThreadIndependence( coordinateSampler.GetPointer(), "ImageRandomCoordinateSampler" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  /** The serial code path should give the same samples as the threaded one. */
+  std::vector< RandomSamplerType::InputImagePointType > threaded, serial;
+  GetSamplePoints( randomSampler.GetPointer(), 4, threaded );
+  randomSampler->SetUseMultiThread( false );
+  GetSamplePoints( randomSampler.GetPointer(), 4, serial );
+  if( threaded != serial )
+  {
+    std::cerr << "ERROR: the serial and threaded samples differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Sample prefetching should select the same sample sets. */
+  RandomCoordinateSamplerType::Pointer prefetchSampler = RandomCoordinateSamplerType::New();
+  prefetchSampler->SetInput( image );
+  prefetchSampler->SetInputImageRegion( region );
+  prefetchSampler->SetNumberOfSamples( 1001 );
+  prefetchSampler->SetUseMultiThread( true );
+  prefetchSampler->UseCounterBasedRandomGeneratorOn();
+  prefetchSampler->UseSamplePrefetchingOn();
+  prefetchSampler->SetSeed( 4321 );
+  coordinateSampler->SetSeed( 4321 );
+  for( unsigned int iteration = 0; iteration < 5; ++iteration )
+  {
+    coordinateSampler->SelectNewSamplesOnUpdate();
+    coordinateSampler->Update();
+    prefetchSampler->SelectNewSamplesOnUpdate();
+    prefetchSampler->Update();
+
+    /** An update without a request for new samples keeps the samples. */
+    prefetchSampler->Update();
+
+    const RandomCoordinateSamplerType::ImageSampleContainerType * reference
+      = coordinateSampler->GetOutput();
+    const RandomCoordinateSamplerType::ImageSampleContainerType * prefetched
+      = prefetchSampler->GetOutput();
+    if( reference->Size() != prefetched->Size() )
+    {
+      std::cerr << "ERROR: prefetching changed the number of samples." << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( unsigned long i = 0; i < reference->Size(); ++i )
+    {
+      if( reference->ElementAt( i ).m_ImageCoordinates
+        != prefetched->ElementAt( i ).m_ImageCoordinates )
+      {
+        std::cerr << "ERROR: prefetching changed sample " << i
+                  << " in iteration " << iteration << "." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  prefetchSampler->DiscardPrefetchedSamples();
+
+  /** Return a value. */
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,274 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkPersistentThreadPool.h"
+#include "itkTimeProbe.h"
+
+#include <iostream>
+#include <vector>
+
+// Data shared by the threads
+struct PoolTestData
+{
+  itk::PersistentThreadPool *           m_Pool;
+  std::vector< double >                 m_PerThreadSum;
+  unsigned long                         m_Size;
+  bool                                  m_Throw;
+  bool                                  m_Failed;
+  itk::PersistentThreadPool::WorkChunks m_WorkChunks;
+};
+
+// Check the per-thread sums of a static or dynamic job
+bool
+CheckSum( const PoolTestData & data, itk::ThreadIdType numberOfThreads, const char * name )
+{
+  const double expected = 0.5 * static_cast< double >( data.m_Size )
+    * static_cast< double >( data.m_Size - 1 );
+  double sum = 0.0;
+  for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t ) { sum += data.m_PerThreadSum[ t ]; }
+  if( sum != expected )
+  {
+    std::cerr << "ERROR: " << name << " gives " << sum
+              << " instead of " << expected << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Static scheduling: each thread sums its own part of [0, size[
+ITK_THREAD_RETURN_TYPE
+StaticCallback( void * arg )
+{
+  itk::PersistentThreadPool::ThreadInfoType * info
+    = static_cast< itk::PersistentThreadPool::ThreadInfoType * >( arg );
+  PoolTestData * data = static_cast< PoolTestData * >( info->UserData );
+
+  const unsigned long chunk = ( data->m_Size + info->NumberOfThreads - 1 ) / info->NumberOfThreads;
+  unsigned long       begin = info->ThreadID * chunk;
+  unsigned long       end   = begin + chunk;
+  if( begin > data->m_Size ) { begin = data->m_Size; }
+  if( end > data->m_Size ) { end = data->m_Size; }
+
+  double sum = 0.0;
+  for( unsigned long i = begin; i < end; ++i ) { sum += static_cast< double >( i ); }
+  data->m_PerThreadSum[ info->ThreadID ] = sum;
+
+  if( data->m_Throw && info->ThreadID == info->NumberOfThreads - 1 )
+  {
+    itkGenericExceptionMacro( << "Expected exception" );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// Dynamic scheduling: threads grab chunks from the pool
+ITK_THREAD_RETURN_TYPE
+DynamicCallback( void * arg )
+{
+  itk::PersistentThreadPool::ThreadInfoType * info
+    = static_cast< itk::PersistentThreadPool::ThreadInfoType * >( arg );
+  PoolTestData * data = static_cast< PoolTestData * >( info->UserData );
+
+  double             sum = 0.0;
+  itk::SizeValueType begin, end;
+  while( data->m_WorkChunks.GetNext( begin, end ) )
+  {
+    for( itk::SizeValueType i = begin; i < end; ++i ) { sum += static_cast< double >( i ); }
+  }
+  data->m_PerThreadSum[ info->ThreadID ] = sum;
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// Nested execution: every thread runs a static job of its own on the same pool
+ITK_THREAD_RETURN_TYPE
+NestedCallback( void * arg )
+{
+  itk::PersistentThreadPool::ThreadInfoType * info
+    = static_cast< itk::PersistentThreadPool::ThreadInfoType * >( arg );
+  PoolTestData * data = static_cast< PoolTestData * >( info->UserData ) + info->ThreadID;
+
+  data->m_Pool->SingleMethodExecute( StaticCallback, data, 2 );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// Jobs from another thread: runs static jobs while the settings change
+ITK_THREAD_RETURN_TYPE
+JobLoopCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  PoolTestData * data = static_cast< PoolTestData * >( info->UserData );
+
+  for( unsigned int rep = 0; rep < 500 && !data->m_Failed; ++rep )
+  {
+    const itk::ThreadIdType nrOfThreads = 1 + rep % 4;
+    try
+    {
+      data->m_Pool->SingleMethodExecute( StaticCallback, data, nrOfThreads );
+      data->m_Failed = !CheckSum( *data, nrOfThreads, "execution while changing the settings" );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      std::cerr << "ERROR: execution while changing the settings failed: " << excp << std::endl;
+      data->m_Failed = true;
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// Changing the settings from a callback of the pool should throw, not hang
+ITK_THREAD_RETURN_TYPE
+SetterCallback( void * arg )
+{
+  itk::PersistentThreadPool::ThreadInfoType * info
+    = static_cast< itk::PersistentThreadPool::ThreadInfoType * >( arg );
+  PoolTestData * data = static_cast< PoolTestData * >( info->UserData );
+
+  if( info->ThreadID == 0 )
+  {
+    data->m_Failed = true;
+    try
+    {
+      data->m_Pool->SetNumberOfThreads( data->m_Pool->GetNumberOfThreads() + 1 );
+    }
+    catch( itk::ExceptionObject & )
+    {
+      data->m_Failed = false;
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  typedef itk::PersistentThreadPool PoolType;
+  PoolType::Pointer pool = PoolType::New();
+  pool->SetNumberOfThreads( 4 );
+
+  PoolTestData data;
+  data.m_Pool  = pool.GetPointer();
+  data.m_Size   = 100000;
+  data.m_Throw  = false;
+  data.m_Failed = false;
+  data.m_PerThreadSum.resize( ITK_MAX_THREADS );
+
+  /** Test repeated static execution with different thread counts. */
+  itk::TimeProbe timer;
+  timer.Start();
+  for( unsigned int rep = 0; rep < 1000; ++rep )
+  {
+    const itk::ThreadIdType nrOfThreads = 1 + rep % 4;
+    pool->SingleMethodExecute( StaticCallback, &data, nrOfThreads );
+    if( !CheckSum( data, nrOfThreads, "static scheduling" ) ) { return EXIT_FAILURE; }
+  }
+  timer.Stop();
+  std::cout << "Static scheduling, 1000 executions: " << timer.GetMean() << " s." << std::endl;
+
+  /** Test dynamic scheduling. */
+  data.m_WorkChunks.Initialize( data.m_Size, 1000 );
+  pool->SingleMethodExecute( DynamicCallback, &data );
+  if( !CheckSum( data, pool->GetNumberOfThreads(), "dynamic scheduling" ) ) { return EXIT_FAILURE; }
+
+  /** Test nested execution: the jobs started inside a callback should run
+   * on threads of their own, not wait for the pool they are running on.
+   */
+  PoolTestData nestedData[ 4 ];
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    nestedData[ i ].m_Pool  = pool.GetPointer();
+    nestedData[ i ].m_Size  = data.m_Size;
+    nestedData[ i ].m_Throw  = false;
+    nestedData[ i ].m_Failed = false;
+    nestedData[ i ].m_PerThreadSum.resize( ITK_MAX_THREADS );
+  }
+  pool->SingleMethodExecute( NestedCallback, nestedData, 4 );
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    if( !CheckSum( nestedData[ i ], 2, "nested execution" ) ) { return EXIT_FAILURE; }
+  }
+
+  /** Test concurrent execution: calls from other threads wait for the pool. */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( 4 );
+  threader->SetSingleMethod( NestedCallback, nestedData );
+  threader->SingleMethodExecute();
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    if( !CheckSum( nestedData[ i ], 2, "concurrent execution" ) ) { return EXIT_FAILURE; }
+  }
+
+  /** Test that exceptions are passed to the caller. */
+  data.m_Throw = true;
+  bool caught = false;
+  try
+  {
+    pool->SingleMethodExecute( StaticCallback, &data );
+  }
+  catch( itk::ExceptionObject & )
+  {
+    caught = true;
+  }
+  if( !caught )
+  {
+    std::cerr << "ERROR: exception was not passed on." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The pool should still be usable after an exception. */
+  data.m_Throw = false;
+  pool->SingleMethodExecute( StaticCallback, &data );
+
+  /** Test changing the settings while another thread runs jobs: the setters
+   * should wait for the current job instead of restarting its workers.
+   */
+  threader->SetNumberOfThreads( 2 );
+  const int jobLoopThreadId = threader->SpawnThread( JobLoopCallback, &data );
+  for( unsigned int rep = 0; rep < 100; ++rep )
+  {
+    pool->SetNumberOfThreads( 2 + rep % 3 );
+    pool->SetUseThreadAffinity( rep % 2 == 0 );
+  }
+  threader->TerminateThread( jobLoopThreadId );
+  if( data.m_Failed ) { return EXIT_FAILURE; }
+  pool->SetUseThreadAffinity( false );
+
+  /** Test that a setter called from a callback of the pool throws. */
+  pool->SingleMethodExecute( SetterCallback, &data );
+  if( data.m_Failed )
+  {
+    std::cerr << "ERROR: SetNumberOfThreads() from a callback did not throw." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Test the global pool. */
+  PoolType * globalPool = PoolType::GetGlobalThreadPool();
+  if( globalPool == 0 || globalPool != PoolType::GetGlobalThreadPool() )
+  {
+    std::cerr << "ERROR: global thread pool is not unique." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -147,6 +147,53 @@ main( int argc, char * argv[] )
   std::cerr << "GetJacobian() computation took: "
             << clock() - startClock << " ms." << std::endl;
 
+  /** Test GetJacobian() on a transform that is set up from the stored
+   * kernel coefficients, which skips the inversion of the L matrix.
+   */
+  TransformType::Pointer precomputedTransform = TransformType::New();
+  precomputedTransform->SetStiffness( 0.0 );
+  precomputedTransform->SetMatrixInversionMethod( "QR" );
+  precomputedTransform->SetPrecomputedKernelCoefficients(
+    kernelTransform->GetKernelCoefficients() );
+  precomputedTransform->SetFixedParameters( kernelTransform->GetFixedParameters() );
+  precomputedTransform->SetParameters( kernelTransform->GetParameters() );
+
+  JacobianType jacPrecomputed; NonZeroJacobianIndicesType nzjiPrecomputed;
+  try
+  {
+    precomputedTransform->GetJacobian( ipp, jacPrecomputed, nzjiPrecomputed );
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: GetJacobian() failed with precomputed coefficients." << std::endl;
+    std::cerr << excp << std::endl;
+    return 1;
+  }
+
+  if( jacPrecomputed.rows() != jac.rows() || jacPrecomputed.cols() != jac.cols()
+    || nzjiPrecomputed.size() != nzji.size() )
+  {
+    std::cerr << "ERROR: GetJacobian() with precomputed coefficients returns "
+              << "a Jacobian of the wrong size." << std::endl;
+    return 1;
+  }
+  const double jacobianDifference = ( jacPrecomputed - jac ).frobenius_norm();
+  std::cerr << "Jacobian difference with precomputed coefficients: "
+            << jacobianDifference << std::endl;
+  if( jacobianDifference > 1e-8 * ( 1.0 + jac.frobenius_norm() ) )
+  {
+    std::cerr << "ERROR: GetJacobian() with precomputed coefficients differs "
+              << "from the solved transform." << std::endl;
+    return 1;
+  }
+  if( precomputedTransform->TransformPoint( ipp ).EuclideanDistanceTo(
+    kernelTransform->TransformPoint( ipp ) ) > 1e-8 )
+  {
+    std::cerr << "ERROR: TransformPoint() with precomputed coefficients differs "
+              << "from the solved transform." << std::endl;
+    return 1;
+  }
+
   /** Additional checks. */
   if( !kernelTransform->GetHasNonZeroSpatialHessian() )
   {
@@ -0,0 +1,217 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkListSampleCArray.h"
+#include "itkANNBruteForceTree.h"
+#include "itkANNStandardTreeSearch.h"
+#include "itkTiledBruteForceTree.h"
+#include "itkTiledBruteForceTreeSearch.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <iostream>
+#include <cmath>
+
+/** Known-answer test of the TiledBruteForceTreeSearch: the exact ANN brute
+ * force search, which inserts in the same order, also keeps the lowest index
+ * among equal distances, and also skips the points at distance zero unless
+ * ANN_ALLOW_SELF_MATCH is set, gives the reference neighbours.
+ */
+
+typedef itk::Array< double > MeasurementVectorType;
+typedef itk::Statistics::ListSampleCArray<
+  MeasurementVectorType, double >                              ListSampleType;
+typedef itk::ANNBruteForceTree< ListSampleType >               ANNTreeType;
+typedef itk::ANNStandardTreeSearch< ListSampleType >           ANNSearchType;
+typedef itk::TiledBruteForceTree< ListSampleType >             TiledTreeType;
+typedef itk::TiledBruteForceTreeSearch< ListSampleType >       TiledSearchType;
+typedef ANNSearchType::IndexArrayType                          IndexArrayType;
+typedef ANNSearchType::DistanceArrayType                       DistanceArrayType;
+typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+
+//-------------------------------------------------------------------------------------
+
+/** Fill a list sample with nop points of dimension dim. With integer
+ * coordinates the points lie on a small grid, so that there are many
+ * duplicate points and equal distances, which are computed exactly.
+ * The list sample is allocated larger than the actual size, to check that
+ * the unused points are not searched.
+ */
+ListSampleType::Pointer
+CreateListSample( RandomGeneratorType * generator,
+  const unsigned int dim, const unsigned long nop, const bool integerCoordinates )
+{
+  ListSampleType::Pointer listSample = ListSampleType::New();
+  listSample->SetMeasurementVectorSize( dim );
+  listSample->Resize( nop + 7 );
+
+  MeasurementVectorType mv( dim );
+  for( unsigned long i = 0; i < nop + 7; ++i )
+  {
+    for( unsigned int d = 0; d < dim; ++d )
+    {
+      mv[ d ] = integerCoordinates
+        ? static_cast< double >( generator->GetIntegerVariate( 3 ) )
+        : generator->GetNormalVariate( 0.0, 1.0 );
+    }
+    listSample->SetMeasurementVector( i, mv );
+  }
+  listSample->SetActualSize( nop );
+
+  return listSample;
+
+} // end CreateListSample()
+
+
+//-------------------------------------------------------------------------------------
+
+/** Compare the k nearest neighbours of both searches, for all points of the
+ * sample, which then are or are not found themselves, and for random query
+ * points. With many duplicate points less than k neighbours may be found.
+ * With real valued coordinates the distances do not need to be bitwise
+ * equal, and points at nearly equal distances may be swapped.
+ */
+bool
+CompareSearches( RandomGeneratorType * generator,
+  const unsigned int dim, const unsigned long nop, const unsigned int k,
+  const bool integerCoordinates )
+{
+  std::cerr << "Dimension " << dim << ", " << nop << " points, k = " << k
+            << ( integerCoordinates ? ", integer coordinates" : "" ) << std::endl;
+
+  ListSampleType::Pointer listSample
+    = CreateListSample( generator, dim, nop, integerCoordinates );
+
+  ANNTreeType::Pointer annTree = ANNTreeType::New();
+  annTree->SetSample( listSample );
+  annTree->GenerateTree();
+  ANNSearchType::Pointer annSearch = ANNSearchType::New();
+  annSearch->SetKNearestNeighbors( k );
+  annSearch->SetErrorBound( 0.0 );
+  annSearch->SetBinaryTree( annTree );
+
+  TiledTreeType::Pointer tiledTree = TiledTreeType::New();
+  tiledTree->SetSample( listSample );
+  tiledTree->GenerateTree();
+  TiledSearchType::Pointer tiledSearch = TiledSearchType::New();
+  tiledSearch->SetKNearestNeighbors( k );
+  tiledSearch->SetBinaryTree( tiledTree );
+
+  if( tiledTree->GetNumberOfPoints() != nop
+    || tiledTree->GetPaddedNumberOfPoints() % TiledTreeType::TileSize != 0 )
+  {
+    std::cerr << "ERROR: the tiled tree has " << tiledTree->GetNumberOfPoints()
+              << " points, padded to " << tiledTree->GetPaddedNumberOfPoints()
+              << "." << std::endl;
+    return false;
+  }
+
+  const double          tolerance = integerCoordinates ? 0.0 : 1e-12;
+  MeasurementVectorType qp( dim );
+  IndexArrayType        annIndices, tiledIndices;
+  DistanceArrayType     annDistances, tiledDistances;
+  for( unsigned long q = 0; q < 2 * nop; ++q )
+  {
+    if( q < nop )
+    {
+      listSample->GetMeasurementVector( q, qp );
+    }
+    else
+    {
+      for( unsigned int d = 0; d < dim; ++d )
+      {
+        qp[ d ] = integerCoordinates
+          ? static_cast< double >( generator->GetIntegerVariate( 3 ) )
+          : generator->GetNormalVariate( 0.0, 1.0 );
+      }
+    }
+
+    annSearch->Search( qp, annIndices, annDistances );
+    tiledSearch->Search( qp, tiledIndices, tiledDistances );
+
+    if( tiledIndices.GetSize() != k || tiledDistances.GetSize() != k )
+    {
+      std::cerr << "ERROR: the tiled search did not return k neighbours." << std::endl;
+      return false;
+    }
+    for( unsigned int i = 0; i < k; ++i )
+    {
+      const double difference = std::abs( tiledDistances[ i ] - annDistances[ i ] );
+      const bool   distanceOk = difference <= tolerance * ( 1.0 + annDistances[ i ] );
+      if( !distanceOk || ( tiledIndices[ i ] != annIndices[ i ] && tolerance == 0.0 ) )
+      {
+        std::cerr << "ERROR: query " << q << ", neighbour " << i << ": the tiled search "
+                  << "found point " << tiledIndices[ i ] << " at squared distance "
+                  << tiledDistances[ i ] << ", ANN found point " << annIndices[ i ]
+                  << " at squared distance " << annDistances[ i ] << "." << std::endl;
+        return false;
+      }
+    }
+
+    /** A point of the sample is its own nearest neighbour, or a duplicate is. */
+    if( q < nop && ( tiledDistances[ 0 ] == 0.0 ) != static_cast< bool >( ANN_ALLOW_SELF_MATCH ) )
+    {
+      std::cerr << "ERROR: point " << q << ( ANN_ALLOW_SELF_MATCH ? " was not" : " was" )
+                << " found itself." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+
+} // end CompareSearches()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  RandomGeneratorType::Pointer generator = RandomGeneratorType::New();
+  generator->Initialize( 140377 );
+
+  /** Real valued coordinates: the number of points is not a multiple of the
+   * tile size, and k is smaller and larger than the tile size.
+   */
+  const unsigned int tileSize = TiledTreeType::TileSize;
+  bool ok = true;
+  ok &= CompareSearches( generator, 1, 150, 5, false );
+  ok &= CompareSearches( generator, 3, 200, 5, false );
+  ok &= CompareSearches( generator, 3, 200, tileSize + 11, false );
+  ok &= CompareSearches( generator, 7, 3 * tileSize, 2 * tileSize, false );
+
+  /** Integer coordinates, with many equal distances: the lowest index has to
+   * come first, as in ANN, also when k is larger than the tile size.
+   */
+  ok &= CompareSearches( generator, 2, 150, 10, true );
+  ok &= CompareSearches( generator, 2, 150, tileSize + 6, true );
+  ok &= CompareSearches( generator, 3, 2 * tileSize + 1, 2 * tileSize + 1, true );
+
+  /** Less points than a single tile, and k equal to the number of points. */
+  ok &= CompareSearches( generator, 4, 10, 10, false );
+  ok &= CompareSearches( generator, 4, 10, 10, true );
+
+  if( !ok )
+  {
+    return 1;
+  }
+
+  /** Exercise PrintSelf() method. */
+  TiledTreeType::New()->Print( std::cerr );
+
+  return 0;
+
+} // end main